@@ -21,6 +21,7 @@
 #include <isc/buffer.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/net.h>
 #include <isc/region.h>
 #include <isc/result.h>
@@ -104,6 +105,11 @@ static isc_logcategory_t categories[] = { { "", 0 },
 					  { "unmatched", 0 },
 					  { NULL, 0 } };
 
+/*
+ * 'symtab' records the names already reported by the checks, which
+ * may run for several zones at once in named-checkzone's batch mode.
+ */
+static isc_mutex_t symtab_lock = ISC_MUTEX_INITIALIZER;
 static isc_symtab_t *symtab = NULL;
 static isc_mem_t *sym_mctx;
 
@@ -119,6 +125,7 @@ add(char *key, int value) {
 	isc_result_t result;
 	isc_symvalue_t symvalue;
 
+	LOCK(&symtab_lock);
 	if (sym_mctx == NULL) {
 		isc_mem_create(&sym_mctx);
 	}
@@ -127,7 +134,7 @@ add(char *key, int value) {
 		result = isc_symtab_create(sym_mctx, 100, freekey, sym_mctx,
 					   false, &symtab);
 		if (result != ISC_R_SUCCESS) {
-			return;
+			goto unlock;
 		}
 	}
 
@@ -139,21 +146,22 @@ add(char *key, int value) {
 	if (result != ISC_R_SUCCESS) {
 		isc_mem_free(sym_mctx, key);
 	}
+
+unlock:
+	UNLOCK(&symtab_lock);
 }
 
 static bool
 logged(char *key, int value) {
-	isc_result_t result;
+	isc_result_t result = ISC_R_NOTFOUND;
 
-	if (symtab == NULL) {
-		return (false);
+	LOCK(&symtab_lock);
+	if (symtab != NULL) {
+		result = isc_symtab_lookup(symtab, key, value, NULL);
 	}
+	UNLOCK(&symtab_lock);
 
-	result = isc_symtab_lookup(symtab, key, value, NULL);
-	if (result == ISC_R_SUCCESS) {
-		return (true);
-	}
-	return (false);
+	return (result == ISC_R_SUCCESS);
 }
 
 static bool
@@ -14,6 +14,7 @@
 /*! \file */
 
 #include <inttypes.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdlib.h>
 
@@ -24,8 +25,11 @@
 #include <isc/hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/result.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/timer.h>
 #include <isc/util.h>
 
@@ -51,6 +55,29 @@ static const char *output_filename;
 static const char *prog_name = NULL;
 static const dns_master_style_t *outputstyle = NULL;
 static enum { progmode_check, progmode_compile } progmode;
+static const char *classname = "IN";
+static dns_masterformat_t inputformat = dns_masterformat_text;
+static dns_masterformat_t outputformat = dns_masterformat_text;
+static uint32_t rawversion = 1, serialnum = 0;
+static dns_ttl_t maxttl = 0;
+static bool snset = false;
+static bool logdump = false;
+static FILE *errout = NULL;
+
+/*%
+ * A zone listed in the batch file given with -b.
+ */
+typedef struct batchzone {
+	char *origin;
+	char *filename;
+	char *output;
+	isc_result_t result;
+} batchzone_t;
+
+static batchzone_t *batch = NULL;
+static size_t nbatch = 0;
+static size_t batchsize = 0;
+static atomic_size_t batchnext = 0;
 
 #define ERRRET(result, function)                                              \
 	do {                                                                  \
@@ -76,9 +103,11 @@ usage(void) {
 		"[-i (full|full-sibling|local|local-sibling|none)] "
 		"[-M (ignore|warn|fail)] [-S (ignore|warn|fail)] "
 		"[-W (ignore|warn)] "
-		"%s zonename [ (filename|-) ]\n",
+		"%s zonename [ (filename|-) ]\n"
+		"       %s [options] [-P threads] -b (listfile|-)\n",
 		prog_name,
-		progmode == progmode_check ? "[-o filename]" : "-o filename");
+		progmode == progmode_check ? "[-o filename]" : "-o filename",
+		prog_name);
 	exit(EXIT_FAILURE);
 }
 
@@ -87,6 +116,209 @@ destroy(void) {
 	if (zone != NULL) {
 		dns_zone_detach(&zone);
 	}
+	for (size_t i = 0; i < nbatch; i++) {
+		isc_mem_free(mctx, batch[i].origin);
+		isc_mem_free(mctx, batch[i].filename);
+		if (batch[i].output != NULL) {
+			isc_mem_free(mctx, batch[i].output);
+		}
+	}
+	if (batch != NULL) {
+		isc_mem_cput(mctx, batch, batchsize, sizeof(batch[0]));
+	}
+}
+
+/*%
+ * Load the zone 'origin' from 'filename' into '*zonep', and if
+ * 'dumpzone' is set, dump it to 'output'.
+ */
+static isc_result_t
+process_zone(const char *origin, const char *filename, const char *output,
+	     dns_zone_t **zonep) {
+	isc_result_t result;
+	dns_masterrawheader_t header;
+
+	result = load_zone(mctx, origin, filename, inputformat, classname,
+			   maxttl, zonep);
+
+	if (result == ISC_R_SUCCESS && snset) {
+		dns_master_initrawheader(&header);
+		header.flags = DNS_MASTERRAW_SOURCESERIALSET;
+		header.sourceserial = serialnum;
+		dns_zone_setrawdata(*zonep, &header);
+	}
+
+	if (result == ISC_R_SUCCESS && dumpzone) {
+		if (logdump) {
+			fprintf(errout, "dump zone to %s...", output);
+			fflush(errout);
+		}
+		result = dump_zone(origin, *zonep, output, outputformat,
+				   outputstyle, rawversion);
+		if (logdump) {
+			fprintf(errout, "done\n");
+		}
+	}
+
+	return (result);
+}
+
+/*%
+ * Read the zones to check from 'listfile', one per line as
+ * "zonename filename [outputfile]".  Empty lines and lines starting
+ * with '#' are ignored.
+ */
+static isc_result_t
+read_batch(const char *listfile) {
+	isc_result_t result = ISC_R_SUCCESS;
+	FILE *fp = stdin;
+	char line[4096];
+	unsigned int lineno = 0;
+
+	if (strcmp(listfile, "-") != 0) {
+		result = isc_stdio_open(listfile, "r", &fp);
+		if (result != ISC_R_SUCCESS) {
+			fprintf(stderr, "%s: %s\n", listfile,
+				isc_result_totext(result));
+			return (result);
+		}
+	}
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		char *field[4] = { NULL };
+		size_t nfields = 0;
+		char *last = NULL;
+
+		lineno++;
+		if (strchr(line, '\n') == NULL && !feof(fp)) {
+			fprintf(stderr, "%s:%u: line too long\n", listfile,
+				lineno);
+			result = ISC_R_RANGE;
+			break;
+		}
+
+		for (char *tok = strtok_r(line, " \t\r\n", &last);
+		     tok != NULL && nfields < ARRAY_SIZE(field);
+		     tok = strtok_r(NULL, " \t\r\n", &last))
+		{
+			field[nfields++] = tok;
+		}
+		if (nfields == 0 || field[0][0] == '#') {
+			continue;
+		}
+
+		/*
+		 * The zones are loaded concurrently, so none of them
+		 * can be read from or written to the standard streams.
+		 */
+		if (nfields < 2 || nfields > 3 ||
+		    (progmode == progmode_compile && nfields < 3) ||
+		    strcmp(field[1], "-") == 0 ||
+		    (nfields == 3 && strcmp(field[2], "-") == 0))
+		{
+			fprintf(stderr, "%s:%u: invalid zone entry\n",
+				listfile, lineno);
+			result = ISC_R_FAILURE;
+			break;
+		}
+
+		if (nbatch == batchsize) {
+			size_t newsize = (batchsize == 0) ? 16 : batchsize * 2;
+			batch = isc_mem_creget(mctx, batch, batchsize, newsize,
+					       sizeof(batch[0]));
+			batchsize = newsize;
+		}
+		batch[nbatch] = (batchzone_t){
+			.origin = isc_mem_strdup(mctx, field[0]),
+			.filename = isc_mem_strdup(mctx, field[1]),
+		};
+		if (nfields == 3) {
+			batch[nbatch].output = isc_mem_strdup(mctx, field[2]);
+		}
+		nbatch++;
+	}
+
+	if (result == ISC_R_SUCCESS && ferror(fp)) {
+		fprintf(stderr, "%s: read error\n", listfile);
+		result = ISC_R_FAILURE;
+	}
+	if (fp != stdin) {
+		(void)isc_stdio_close(fp);
+	}
+
+	return (result);
+}
+
+/*%
+ * Take zones from the batch until it is exhausted.  A zone is dumped
+ * only if its entry names an output file.
+ */
+static void *
+batch_worker(void *arg) {
+	size_t i;
+
+	UNUSED(arg);
+
+	while ((i = atomic_fetch_add_relaxed(&batchnext, 1)) < nbatch) {
+		batchzone_t *bz = &batch[i];
+		dns_zone_t *bzone = NULL;
+
+		if (bz->output != NULL) {
+			bz->result = process_zone(bz->origin, bz->filename,
+						  bz->output, &bzone);
+		} else {
+			bz->result = load_zone(mctx, bz->origin, bz->filename,
+					       inputformat, classname, maxttl,
+					       NULL);
+		}
+		if (bzone != NULL) {
+			dns_zone_detach(&bzone);
+		}
+
+		if (!quiet) {
+			fprintf(errout, "%s %s: %s\n", bz->origin,
+				bz->filename,
+				bz->result == ISC_R_SUCCESS
+					? "OK"
+					: isc_result_totext(bz->result));
+		}
+	}
+
+	return (NULL);
+}
+
+/*%
+ * Check all the zones in the batch with 'nthreads' threads, and
+ * return the number of zones which failed.
+ */
+static size_t
+run_batch(unsigned int nthreads) {
+	isc_thread_t *threads = NULL;
+	size_t failed = 0;
+
+	if (nthreads > nbatch) {
+		nthreads = nbatch;
+	}
+	if (nthreads == 0) {
+		return (0);
+	}
+
+	threads = isc_mem_cget(mctx, nthreads, sizeof(threads[0]));
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_create(batch_worker, NULL, &threads[i]);
+	}
+	for (unsigned int i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	isc_mem_cput(mctx, threads, nthreads, sizeof(threads[0]));
+
+	for (size_t i = 0; i < nbatch; i++) {
+		if (batch[i].result != ISC_R_SUCCESS) {
+			failed++;
+		}
+	}
+
+	return (failed);
 }
 
 /*% main processing routine */
@@ -97,19 +329,11 @@ main(int argc, char **argv) {
 	const char *filename = NULL;
 	isc_log_t *lctx = NULL;
 	isc_result_t result;
-	char classname_in[] = "IN";
-	char *classname = classname_in;
 	const char *workdir = NULL;
 	const char *inputformatstr = NULL;
 	const char *outputformatstr = NULL;
-	dns_masterformat_t inputformat = dns_masterformat_text;
-	dns_masterformat_t outputformat = dns_masterformat_text;
-	dns_masterrawheader_t header;
-	uint32_t rawversion = 1, serialnum = 0;
-	dns_ttl_t maxttl = 0;
-	bool snset = false;
-	bool logdump = false;
-	FILE *errout = stdout;
+	const char *batchfile = NULL;
+	unsigned int nthreads = 0;
 	char *endp;
 
 	/*
@@ -118,6 +342,7 @@ main(int argc, char **argv) {
 	 */
 
 	outputstyle = &dns_master_style_full;
+	errout = stdout;
 
 	prog_name = strrchr(argv[0], '/');
 	if (prog_name == NULL) {
@@ -160,10 +385,14 @@ main(int argc, char **argv) {
 	isc_commandline_errprint = false;
 
 	while ((c = isc_commandline_parse(argc, argv,
-					  "c:df:hi:jJ:k:L:l:m:n:qr:s:t:o:vw:C:"
-					  "DF:M:S:T:W:")) != EOF)
+					  "b:c:df:hi:jJ:k:L:l:m:n:qr:s:t:o:vw:"
+					  "C:DF:M:P:S:T:W:")) != EOF)
 	{
 		switch (c) {
+		case 'b':
+			batchfile = isc_commandline_argument;
+			break;
+
 		case 'c':
 			classname = isc_commandline_argument;
 			break;
@@ -389,6 +618,16 @@ main(int argc, char **argv) {
 			}
 			break;
 
+		case 'P':
+			endp = NULL;
+			nthreads = strtoul(isc_commandline_argument, &endp, 0);
+			if (*endp != '\0' || nthreads == 0) {
+				fprintf(stderr, "number of threads "
+						"must be a positive number\n");
+				exit(EXIT_FAILURE);
+			}
+			break;
+
 		case 'S':
 			if (ARGCMP("fail")) {
 				zone_options &= ~DNS_ZONEOPT_WARNSRVCNAME;
@@ -490,6 +729,47 @@ main(int argc, char **argv) {
 		}
 	}
 
+	if (batchfile != NULL) {
+		if (argc != isc_commandline_index || dumpzone != 0 ||
+		    output_filename != NULL || journal != NULL)
+		{
+			fprintf(stderr, "-b cannot be used with -D, -J, -o "
+					"or a zone name\n");
+			usage();
+		}
+
+		isc_mem_create(&mctx);
+		if (!quiet) {
+			RUNTIME_CHECK(setup_logging(mctx, errout, &lctx) ==
+				      ISC_R_SUCCESS);
+		}
+
+		result = read_batch(batchfile);
+		if (result == ISC_R_SUCCESS) {
+			size_t failed;
+
+			dumpzone = 1;
+			failed = run_batch(nthreads != 0 ? nthreads
+							 : isc_os_ncpus());
+			if (!quiet) {
+				fprintf(errout,
+					"%zu zones checked, %zu failed\n",
+					nbatch, failed);
+			}
+			if (failed != 0) {
+				result = ISC_R_FAILURE;
+			}
+		}
+
+		destroy();
+		if (lctx != NULL) {
+			isc_log_destroy(&lctx);
+		}
+		isc_mem_destroy(&mctx);
+
+		return ((result == ISC_R_SUCCESS) ? 0 : 1);
+	}
+
 	if (progmode == progmode_compile) {
 		dumpzone = 1; /* always dump */
 		logdump = !quiet;
@@ -540,27 +820,7 @@ main(int argc, char **argv) {
 
 	isc_commandline_index++;
 
-	result = load_zone(mctx, origin, filename, inputformat, classname,
-			   maxttl, &zone);
-
-	if (snset) {
-		dns_master_initrawheader(&header);
-		header.flags = DNS_MASTERRAW_SOURCESERIALSET;
-		header.sourceserial = serialnum;
-		dns_zone_setrawdata(zone, &header);
-	}
-
-	if (result == ISC_R_SUCCESS && dumpzone) {
-		if (logdump) {
-			fprintf(errout, "dump zone to %s...", output_filename);
-			fflush(errout);
-		}
-		result = dump_zone(origin, zone, output_filename, outputformat,
-				   outputstyle, rawversion);
-		if (logdump) {
-			fprintf(errout, "done\n");
-		}
-	}
+	result = process_zone(origin, filename, output_filename, &zone);
 
 	if (!quiet && result == ISC_R_SUCCESS) {
 		fprintf(errout, "OK\n");
@@ -40,6 +40,7 @@
 #include <isc/result.h>
 #include <isc/sockaddr.h>
 #include <isc/string.h>
+#include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/tls.h>
 #include <isc/util.h>
@@ -118,6 +119,8 @@ static uint32_t destport = 53;
 static isc_sockaddr_t *srcaddr4 = NULL, *srcaddr6 = NULL;
 static isc_sockaddr_t a4, a6;
 static char *curqname = NULL, *qname = NULL;
+static const char *batchname = NULL;
+static FILE *batchfp = NULL;
 static bool classset = false;
 static dns_rdatatype_t qtype = dns_rdatatype_none;
 static bool typeset = false;
@@ -186,6 +189,7 @@ usage(void) {
 		"                 -c class            (option included for "
 		"compatibility;\n"
 		"                 -d level            (set debugging level)\n"
+		"                 -f filename         (batch mode)\n"
 		"                 -h                  (print help and exit)\n"
 		"                 -i                  (disable DNSSEC "
 		"validation)\n"
@@ -1384,7 +1388,7 @@ plus_option(char *option) {
  * options: "46a:b:c:d:himp:q:t:vx:";
  */
 static const char *single_dash_opts = "46himv";
-static const char *dash_opts = "46abcdhimpqtvx";
+static const char *dash_opts = "46abcdfhimpqtvx";
 
 static bool
 dash_option(char *option, char *next, bool *open_type_class) {
@@ -1526,6 +1530,9 @@ dash_option(char *option, char *next, bool *open_type_class) {
 		}
 		loglevel = num;
 		return (value_from_next);
+	case 'f':
+		batchname = value;
+		return (value_from_next);
 	case 'p':
 		port = value;
 		result = parse_uint(&destport, port, 0xffff, "port");
@@ -1729,6 +1736,9 @@ parse_args(int argc, char **argv) {
 	if (qmin && !fulltrace) {
 		fatal("'+qmin' cannot be used without '+ns'");
 	}
+	if (batchname != NULL && fulltrace) {
+		fatal("'-f' cannot be used with '+ns'");
+	}
 
 	/*
 	 * If no qname or qtype specified, search for root/NS
@@ -1741,7 +1751,7 @@ parse_args(int argc, char **argv) {
 	if (curqname == NULL) {
 		qname = isc_mem_strdup(mctx, ".");
 
-		if (!typeset) {
+		if (!typeset && batchname == NULL) {
 			qtype = dns_rdatatype_ns;
 		}
 	} else {
@@ -1826,21 +1836,67 @@ get_reverse(char *reverse, size_t len, char *value, bool strict) {
 	}
 }
 
+/*
+ * A resolution in progress.  In batch mode (-f), up to MAXINFLIGHT
+ * names are resolved at once, sharing the client's cache and
+ * validator.
+ */
+typedef struct lookup {
+	dns_namelist_t namelist; /* must be first, see resolve_cb() */
+	dns_fixedname_t fname;
+	dns_rdatatype_t qtype;
+	isc_nanosecs_t start;
+} lookup_t;
+
+#define MAXINFLIGHT 100
+
+static dns_client_t *resclient = NULL;
+static unsigned int resopt = 0;
+static unsigned int inflight = 0;
+
+static void
+read_batch(void);
+
 static void
 resolve_cb(dns_client_t *client, const dns_name_t *query_name,
 	   dns_namelist_t *namelist, isc_result_t result) {
+	lookup_t *lookup = (lookup_t *)namelist;
 	char namestr[DNS_NAME_FORMATSIZE];
+	char typestr[DNS_RDATATYPE_FORMATSIZE] = { 0 };
 	dns_rdataset_t *rdataset;
+	uint64_t msec = 0;
 
 	if (result != ISC_R_SUCCESS && !yaml) {
-		delv_log(ISC_LOG_ERROR, "resolution failed: %s",
-			 isc_result_totext(result));
+		if (batchname != NULL) {
+			dns_name_format(query_name, namestr, sizeof(namestr));
+			delv_log(ISC_LOG_ERROR, "resolution of %s failed: %s",
+				 namestr, isc_result_totext(result));
+		} else {
+			delv_log(ISC_LOG_ERROR, "resolution failed: %s",
+				 isc_result_totext(result));
+		}
+	}
+
+	if (batchname != NULL) {
+		msec = (isc_time_monotonic() - lookup->start) / NS_PER_MS;
+		dns_name_format(query_name, namestr, sizeof(namestr));
+		dns_rdatatype_format(lookup->qtype, typestr, sizeof(typestr));
+		if (yaml) {
+			printf("---\n");
+		} else {
+			printf("; %s/%s: %s, %" PRIu64 " msec\n", namestr,
+			       typestr, isc_result_totext(result), msec);
+		}
 	}
 
 	if (yaml) {
 		printf("type: DELV_RESULT\n");
 		dns_name_format(query_name, namestr, sizeof(namestr));
 		printf("query_name: %s\n", namestr);
+		if (batchname != NULL) {
+			printf("query_type: %s\n", typestr);
+			printf("query_time_msec: %" PRIu64 "\n", msec);
+		}
 		printf("status: %s\n", isc_result_totext(result));
 		printf("records:\n");
 	}
@@ -1857,28 +1913,99 @@ resolve_cb(dns_client_t *client, const dns_name_t *query_name,
 	}
 
 	dns_client_freeresanswer(client, namelist);
-	isc_mem_put(mctx, namelist, sizeof(*namelist));
+	isc_mem_put(mctx, lookup, sizeof(*lookup));
 
-	dns_client_detach(&client);
+	inflight--;
+	if (batchfp != NULL) {
+		read_batch();
+	}
+	if (inflight == 0) {
+		dns_client_detach(&resclient);
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
 
-	isc_loopmgr_shutdown(loopmgr);
+static isc_result_t
+start_lookup(const char *name, dns_rdatatype_t type) {
+	isc_result_t result;
+	lookup_t *lookup = NULL;
+	dns_name_t *query_name = NULL;
+
+	lookup = isc_mem_get(mctx, sizeof(*lookup));
+	*lookup = (lookup_t){
+		.namelist = ISC_LIST_INITIALIZER,
+		.qtype = type,
+		.start = isc_time_monotonic(),
+	};
+
+	/* Construct QNAME */
+	result = convert_name(&lookup->fname, &query_name, name);
+	if (result == ISC_R_SUCCESS) {
+		/* Perform resolution */
+		result = dns_client_resolve(resclient, query_name,
+					    dns_rdataclass_in, type, resopt,
+					    &lookup->namelist, resolve_cb);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_put(mctx, lookup, sizeof(*lookup));
+		return (result);
+	}
+
+	inflight++;
+	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * Start resolving names from the batch file, one per line with an
+ * optional type, until MAXINFLIGHT are in progress.
+ */
 static void
-run_resolve(void *arg) {
-	dns_client_t *client = NULL;
-	dns_namelist_t *namelist = NULL;
-	unsigned int resopt;
+read_batch(void) {
+	char line[MAXNAME + 64];
+	char *name = NULL, *type = NULL, *last = NULL;
+	dns_rdatatype_t rdtype;
+	isc_textregion_t tr;
 	isc_result_t result;
-	dns_name_t *query_name = NULL;
 
-	UNUSED(arg);
+	while (inflight < MAXINFLIGHT) {
+		if (fgets(line, sizeof(line), batchfp) == NULL) {
+			if (batchfp != stdin) {
+				fclose(batchfp);
+			}
+			batchfp = NULL;
+			return;
+		}
 
-	namelist = isc_mem_get(mctx, sizeof(*namelist));
-	ISC_LIST_INIT(*namelist);
+		name = strtok_r(line, " \t\r\n", &last);
+		if (name == NULL || name[0] == '#' || name[0] == ';') {
+			continue;
+		}
 
-	/* Construct QNAME */
-	CHECK(convert_name(&qfn, &query_name, qname));
+		rdtype = qtype;
+		type = strtok_r(NULL, " \t\r\n", &last);
+		if (type != NULL) {
+			tr.base = type;
+			tr.length = strlen(type);
+			result = dns_rdatatype_fromtext(&rdtype, &tr);
+			if (result != ISC_R_SUCCESS) {
+				warn("'%s' is not a valid type", type);
+				continue;
+			}
+		}
+
+		result = start_lookup(name, rdtype);
+		if (result != ISC_R_SUCCESS) {
+			delv_log(ISC_LOG_ERROR, "resolution of %s failed: %s",
+				 name, isc_result_totext(result));
+		}
+	}
+}
+
+static void
+run_resolve(void *arg) {
+	isc_result_t result;
+
+	UNUSED(arg);
 
 	/* Set up resolution options */
 	resopt = DNS_CLIENTRESOPT_NOCDFLAG;
@@ -1897,31 +2024,46 @@ run_resolve(void *arg) {
 
 	/* Create client */
 	CHECK(dns_client_create(mctx, loopmgr, netmgr, 0, tlsctx_client_cache,
-				&client, srcaddr4, srcaddr6));
+				&resclient, srcaddr4, srcaddr6));
 
 	/* Set the nameserver */
 	if (server != NULL) {
-		addserver(client);
+		addserver(resclient);
 	} else {
-		findserver(client);
+		findserver(resclient);
 	}
 
-	CHECK(setup_dnsseckeys(client, NULL));
+	CHECK(setup_dnsseckeys(resclient, NULL));
+
+	if (batchname != NULL) {
+		if (strcmp(batchname, "-") == 0) {
+			batchfp = stdin;
+		} else {
+			batchfp = fopen(batchname, "r");
+		}
+		if (batchfp == NULL) {
+			fatal("couldn't open batch file '%s'", batchname);
+		}
+		read_batch();
+		result = ISC_R_SUCCESS;
+	} else {
+		result = start_lookup(qname, qtype);
+	}
+	if (result == ISC_R_SUCCESS && inflight > 0) {
+		return;
+	}
 
-	/* Perform resolution */
-	CHECK(dns_client_resolve(client, query_name, dns_rdataclass_in, qtype,
-				 resopt, namelist, resolve_cb));
-	return;
 cleanup:
-	if (!yaml) {
+	if (result != ISC_R_SUCCESS && !yaml) {
 		delv_log(ISC_LOG_ERROR, "resolution failed: %s",
 			 isc_result_totext(result));
 	}
 
-	isc_mem_put(mctx, namelist, sizeof(*namelist));
 	isc_loopmgr_shutdown(loopmgr);
 
-	dns_client_detach(&client);
+	if (resclient != NULL) {
+		dns_client_detach(&resclient);
+	}
 }
 
 static void
@@ -28,6 +28,7 @@
 /*! \file */
 
 #include <inttypes.h>
+#include <stdarg.h>
 #include <stdbool.h>
 #include <stdlib.h>
 #include <time.h>
@@ -58,10 +59,12 @@
 #include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
+#include <dns/callbacks.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
 #include <dns/diff.h>
@@ -181,6 +184,9 @@ static bool set_maxttl = false;
 static dns_ttl_t maxttl = 0;
 static bool no_max_check = false;
 static const char *sync_records = "cdnskey,cds:sha-256";
+static unsigned int batchsize = 0;
+static dns_db_t *apexdb = NULL; /* Streaming mode only. */
+static dns_dbversion_t *apexversion = NULL;
 
 #define INCSTAT(counter)            \
 	if (printstats) {           \
@@ -446,8 +452,18 @@ expecttofindkey(dns_name_t *name) {
 	char namestr[DNS_NAME_FORMATSIZE];
 
 	dns_fixedname_init(&fname);
-	result = dns_db_find(gdb, name, gversion, dns_rdatatype_dnskey, options,
-			     0, NULL, dns_fixedname_name(&fname), NULL, NULL);
+	/*
+	 * In streaming mode gdb only holds part of the zone.
+	 */
+	if (apexdb != NULL) {
+		result = dns_db_find(apexdb, name, apexversion,
+				     dns_rdatatype_dnskey, options, 0, NULL,
+				     dns_fixedname_name(&fname), NULL, NULL);
+	} else {
+		result = dns_db_find(gdb, name, gversion, dns_rdatatype_dnskey,
+				     options, 0, NULL,
+				     dns_fixedname_name(&fname), NULL, NULL);
+	}
 	switch (result) {
 	case ISC_R_SUCCESS:
 	case DNS_R_NXDOMAIN:
@@ -2550,6 +2566,422 @@ nsec3ify(unsigned int hashalg, dns_iterations_t iterations,
 	dns_dbiterator_destroy(&dbiter);
 }
 
+/*
+ * Streaming mode (-B).
+ *
+ * The apex is loaded on its own before anything else happens, so that
+ * the keys, serial and DS/keyset files are handled as usual.  The rest
+ * of the zone, which must be in DNSSEC canonical order, is then read a
+ * second time and gathered into batches of about 'batchsize' names.
+ * Each NSEC record is added as soon as the next name in the chain has
+ * been seen; a batch is signed by 'nloops' threads and written out once
+ * every name in it has its NSEC, and the database holding it is thrown
+ * away.  Only the name at the end of a batch, which is still waiting
+ * for its successor, is carried over to the next one.
+ */
+typedef struct apexload {
+	dns_db_t *db;
+	dns_dbversion_t *version;
+	bool seen;
+	bool done;
+} apexload_t;
+
+typedef struct stream {
+	dns_fixedname_t fcurrent;
+	dns_name_t *current;   /* the last name read */
+	dns_dbnode_t *curnode; /* its node in gdb */
+	bool occluded;	       /* it is below 'zonecut' */
+	dns_dbnode_t *pendnode; /* the last name needing an NSEC */
+	dns_fixedname_t fzonecut;
+	dns_name_t *zonecut;
+	unsigned int names; /* names in the current batch */
+	dns_dbiterator_t *dbiter;
+	bool signed_all;
+} stream_t;
+
+static isc_result_t
+stream_addrdataset(dns_db_t *db, dns_dbversion_t *version, dns_dbnode_t *node,
+		   const dns_name_t *name, dns_rdataset_t *rdataset) {
+	isc_result_t result;
+
+	result = dns_db_addrdataset(db, node, version, 0, rdataset,
+				    DNS_DBADD_MERGE, NULL);
+	if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	}
+	if (result != ISC_R_SUCCESS) {
+		char namestr[DNS_NAME_FORMATSIZE];
+		char typestr[DNS_RDATATYPE_FORMATSIZE];
+
+		dns_name_format(name, namestr, sizeof(namestr));
+		dns_rdatatype_format(rdataset->type, typestr, sizeof(typestr));
+		fatal("failed to add '%s/%s': %s", namestr, typestr,
+		      isc_result_totext(result));
+	}
+	return (result);
+}
+
+static isc_result_t
+apex_add(void *arg, const dns_name_t *name,
+	 dns_rdataset_t *rdataset DNS__DB_FLARG) {
+	apexload_t *al = arg;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+
+	if (!dns_name_equal(name, dns_db_origin(al->db))) {
+		if (!al->seen) {
+			fatal("the zone apex must be the first name in the "
+			      "zone file when using -B");
+		}
+		/*
+		 * The apex is complete; stop the load here.
+		 */
+		al->done = true;
+		return (ISC_R_COMPLETE);
+	}
+
+	al->seen = true;
+	result = dns_db_findnode(al->db, name, true, &node);
+	check_result(result, "dns_db_findnode()");
+	result = stream_addrdataset(al->db, al->version, node, name, rdataset);
+	dns_db_detachnode(al->db, &node);
+	return (result);
+}
+
+static void
+apex_error(dns_rdatacallbacks_t *callbacks, const char *fmt, ...) {
+	apexload_t *al = callbacks->add_private;
+	va_list ap;
+
+	/*
+	 * Errors reported after the apex is done are caused by our own
+	 * early return and are not interesting.
+	 */
+	if (al->done) {
+		return;
+	}
+
+	fprintf(stderr, "%s: ", program);
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	va_end(ap);
+	fprintf(stderr, "\n");
+}
+
+/*%
+ * Load only the apex of the zone in 'file' into 'db'.
+ */
+static void
+loadapex(dns_db_t *db, const char *file) {
+	dns_rdatacallbacks_t callbacks;
+	apexload_t al = { .db = db };
+	isc_result_t result;
+
+	result = dns_db_newversion(db, &al.version);
+	check_result(result, "dns_db_newversion()");
+
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = apex_add;
+	callbacks.add_private = &al;
+	callbacks.error = apex_error;
+
+	result = dns_master_loadfile(file, dns_db_origin(db),
+				     dns_db_origin(db), dns_db_class(db), 0, 0,
+				     &callbacks, NULL, NULL, mctx, inputformat,
+				     0);
+	if (result != ISC_R_SUCCESS && result != ISC_R_COMPLETE &&
+	    result != DNS_R_SEENINCLUDE)
+	{
+		fatal("failed loading zone apex from '%s': %s", file,
+		      isc_result_totext(result));
+	}
+	if (!al.seen) {
+		fatal("no data found at the zone apex in '%s'", file);
+	}
+
+	dns_db_closeversion(db, &al.version, true);
+}
+
+/*%
+ * Sign the names of the current batch that are part of the NSEC chain.
+ */
+static void *
+stream_worker(void *arg) {
+	stream_t *st = arg;
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_rdataset_t nsec;
+	isc_result_t result;
+
+	for (;;) {
+		dns_dbnode_t *node = NULL;
+
+		LOCK(&namelock);
+		while (!st->signed_all && node == NULL) {
+			result = dns_dbiterator_current(st->dbiter, &node,
+							name);
+			check_dns_dbiterator_current(result);
+
+			dns_rdataset_init(&nsec);
+			result = dns_db_findrdataset(gdb, node, gversion,
+						     nsec_datatype, 0, 0, &nsec,
+						     NULL);
+			if (dns_rdataset_isassociated(&nsec)) {
+				dns_rdataset_disassociate(&nsec);
+			}
+			if (result != ISC_R_SUCCESS) {
+				dns_db_detachnode(gdb, &node);
+			}
+
+			result = dns_dbiterator_next(st->dbiter);
+			if (result == ISC_R_NOMORE) {
+				st->signed_all = true;
+			} else if (result != ISC_R_SUCCESS) {
+				fatal("failure iterating database: %s",
+				      isc_result_totext(result));
+			}
+		}
+		dns_dbiterator_pause(st->dbiter);
+		UNLOCK(&namelock);
+
+		if (node == NULL) {
+			break;
+		}
+
+		signname(node, name);
+		dns_db_detachnode(gdb, &node);
+	}
+
+	return (NULL);
+}
+
+/*%
+ * Sign and write out the current batch.  Unless this is the last batch,
+ * the current name is moved into a new database which becomes the next
+ * batch.
+ */
+static void
+stream_flush(stream_t *st, bool last) {
+	dns_db_t *db = NULL;
+	dns_dbversion_t *version = NULL;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_rdataset_t rdataset;
+	isc_thread_t *threads = NULL;
+	isc_result_t result;
+
+	if (!last) {
+		dns_dbnode_t *node = NULL;
+
+		result = dns_db_create(mctx, ZONEDB_DEFAULT, gorigin,
+				       dns_dbtype_zone, gclass, 0, NULL, &db);
+		check_result(result, "dns_db_create()");
+		result = dns_db_newversion(db, &version);
+		check_result(result, "dns_db_newversion()");
+		result = dns_db_findnode(db, st->current, true, &node);
+		check_result(result, "dns_db_findnode()");
+
+		dns_rdataset_init(&rdataset);
+		result = dns_db_allrdatasets(gdb, st->curnode, gversion, 0, 0,
+					     &rdsiter);
+		check_result(result, "dns_db_allrdatasets()");
+		for (result = dns_rdatasetiter_first(rdsiter);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdatasetiter_next(rdsiter))
+		{
+			dns_rdatasetiter_current(rdsiter, &rdataset);
+			(void)stream_addrdataset(db, version, node, st->current,
+						 &rdataset);
+			result = dns_db_deleterdataset(gdb, st->curnode,
+						       gversion, rdataset.type,
+						       rdataset.covers);
+			check_result(result, "dns_db_deleterdataset()");
+			dns_rdataset_disassociate(&rdataset);
+		}
+		if (result != ISC_R_NOMORE) {
+			fatal("rdataset iteration failed: %s",
+			      isc_result_totext(result));
+		}
+		dns_rdatasetiter_destroy(&rdsiter);
+		dns_db_detachnode(gdb, &st->curnode);
+		st->curnode = node;
+	}
+
+	/* Remove duplicates and cap TTLs at maxttl */
+	cleanup_zone();
+
+	result = dns_db_createiterator(gdb, DNS_DB_NONSEC3, &st->dbiter);
+	check_result(result, "dns_db_createiterator()");
+	result = dns_dbiterator_first(st->dbiter);
+	st->signed_all = (result == ISC_R_NOMORE);
+	if (!st->signed_all) {
+		check_result(result, "dns_dbiterator_first()");
+		dns_dbiterator_pause(st->dbiter);
+	}
+	threads = isc_mem_cget(mctx, nloops, sizeof(threads[0]));
+	for (unsigned int i = 0; i < nloops; i++) {
+		isc_thread_create(stream_worker, st, &threads[i]);
+	}
+	for (unsigned int i = 0; i < nloops; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+	isc_mem_cput(mctx, threads, nloops, sizeof(threads[0]));
+	dns_dbiterator_destroy(&st->dbiter);
+
+	result = dns_master_dumptostream(mctx, gdb, gversion, masterstyle,
+					 dns_masterformat_text, NULL, outfp);
+	check_result(result, "dns_master_dumptostream");
+
+	if (gdb != apexdb) {
+		dns_db_closeversion(gdb, &gversion, false);
+		dns_db_detach(&gdb);
+	}
+	if (!last) {
+		gdb = db;
+		gversion = version;
+		st->names = 1;
+	} else {
+		gdb = apexdb;
+		gversion = apexversion;
+	}
+}
+
+/*%
+ * All the data for the current name has been read: decide whether it is
+ * part of the NSEC chain, and if so link the previous name in the chain
+ * to it.
+ */
+static void
+stream_endname(stream_t *st) {
+	isc_result_t result;
+	uint32_t nsttl = 0;
+
+	if (st->occluded) {
+		remove_sigs(st->curnode, false, 0);
+		remove_records(st->curnode, dns_rdatatype_nsec, false);
+		return;
+	}
+
+	if (!active_node(st->curnode)) {
+		return;
+	}
+
+	if (is_delegation(gdb, gversion, gorigin, st->current, st->curnode,
+			  &nsttl))
+	{
+		st->zonecut = savezonecut(&st->fzonecut, st->current);
+		remove_sigs(st->curnode, true, 0);
+		if (generateds) {
+			add_ds(st->current, st->curnode, nsttl);
+		}
+	} else if (has_dname(gdb, gversion, st->curnode)) {
+		st->zonecut = savezonecut(&st->fzonecut, st->current);
+	}
+
+	if (st->pendnode != NULL) {
+		result = dns_nsec_build(gdb, gversion, st->pendnode,
+					st->current, zone_soa_min_ttl);
+		check_result(result, "dns_nsec_build()");
+		dns_db_detachnode(gdb, &st->pendnode);
+
+		/*
+		 * The apex is always written out on its own.
+		 */
+		if (gdb == apexdb || st->names >= batchsize) {
+			stream_flush(st, false);
+		}
+	}
+	dns_db_attachnode(gdb, st->curnode, &st->pendnode);
+}
+
+static isc_result_t
+stream_add(void *arg, const dns_name_t *name,
+	   dns_rdataset_t *rdataset DNS__DB_FLARG) {
+	stream_t *st = arg;
+	char namestr[DNS_NAME_FORMATSIZE];
+	isc_result_t result;
+	int order;
+
+	/*
+	 * The apex was loaded by loadapex(), and any NSEC3 chain is
+	 * replaced by an NSEC chain.
+	 */
+	if (dns_name_equal(name, gorigin) ||
+	    rdataset->type == dns_rdatatype_nsec3 ||
+	    (rdataset->type == dns_rdatatype_rrsig &&
+	     rdataset->covers == dns_rdatatype_nsec3))
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	order = dns_name_compare(name, st->current);
+	if (order < 0 || !dns_name_issubdomain(name, gorigin)) {
+		dns_name_format(name, namestr, sizeof(namestr));
+		fatal("'%s': %s", namestr,
+		      order < 0 ? "zone file is not in DNSSEC canonical order"
+				: "name is not within the zone");
+	}
+	if (order > 0) {
+		stream_endname(st);
+
+		dns_db_detachnode(gdb, &st->curnode);
+		dns_name_copy(name, st->current);
+		st->occluded = (st->zonecut != NULL &&
+				dns_name_issubdomain(name, st->zonecut));
+		st->names++;
+		result = dns_db_findnode(gdb, name, true, &st->curnode);
+		check_result(result, "dns_db_findnode()");
+	}
+
+	return (stream_addrdataset(gdb, gversion, st->curnode, name,
+				   rdataset));
+}
+
+/*%
+ * Read the zone in 'file' again, then NSEC, sign and write it out in
+ * batches.  On entry gdb only holds the apex.
+ */
+static void
+stream_signzone(const char *file) {
+	dns_rdatacallbacks_t callbacks;
+	stream_t st = { .names = 1 };
+	isc_result_t result;
+
+	apexdb = gdb;
+	apexversion = gversion;
+
+	st.current = dns_fixedname_initname(&st.fcurrent);
+	dns_name_copy(gorigin, st.current);
+	result = dns_db_findnode(gdb, gorigin, false, &st.curnode);
+	check_result(result, "dns_db_findnode()");
+	remove_records(st.curnode, dns_rdatatype_nsec3param, true);
+
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = stream_add;
+	callbacks.add_private = &st;
+
+	result = dns_master_loadfile(file, gorigin, gorigin, gclass, 0, 0,
+				     &callbacks, NULL, NULL, mctx, inputformat,
+				     0);
+	if (result != ISC_R_SUCCESS && result != DNS_R_SEENINCLUDE) {
+		fatal("failed loading zone from '%s': %s", file,
+		      isc_result_totext(result));
+	}
+
+	/*
+	 * The last name in the chain points back at the apex.
+	 */
+	stream_endname(&st);
+	result = dns_nsec_build(gdb, gversion, st.pendnode, gorigin,
+				zone_soa_min_ttl);
+	check_result(result, "dns_nsec_build()");
+	dns_db_detachnode(gdb, &st.pendnode);
+	dns_db_detachnode(gdb, &st.curnode);
+	stream_flush(&st, true);
+
+	apexdb = NULL;
+	apexversion = NULL;
+}
+
 /*%
  * Load the zone file from disk
  */
@@ -2576,6 +3008,11 @@ loadzone(char *file, char *origin, dns_rdataclass_t rdclass, dns_db_t **db) {
 			       rdclass, 0, NULL, db);
 	check_result(result, "dns_db_create()");
 
+	if (batchsize != 0) {
+		loadapex(*db, file);
+		return;
+	}
+
 	result = dns_db_load(*db, file, inputformat, 0);
 	if (result != ISC_R_SUCCESS && result != DNS_R_SEENINCLUDE) {
 		fatal("failed loading zone from '%s': %s", file,
@@ -3269,6 +3706,9 @@ usage(void) {
 	fprintf(stderr, "\t\toutput only DNSSEC-related records\n");
 	fprintf(stderr, "\t-a:\t");
 	fprintf(stderr, "verify generated signatures\n");
+	fprintf(stderr, "\t-B batchsize:\n");
+	fprintf(stderr, "\t\tstream a sorted zone, signing it in batches "
+			"of this many names\n");
 	fprintf(stderr, "\t-c class (IN)\n");
 	fprintf(stderr, "\t-E engine:\n");
 	fprintf(stderr, "\t\tname of an OpenSSL engine to use\n");
@@ -3378,10 +3818,10 @@ main(int argc, char *argv[]) {
 	atomic_init(&shuttingdown, false);
 	atomic_init(&finished, false);
 
-	/* Unused letters: Bb G J q Yy (and F is reserved). */
+	/* Unused letters: b Yy (and F is reserved). */
 #define CMDLINE_FLAGS                                                          \
-	"3:AaCc:Dd:E:e:f:FgG:hH:i:I:j:J:K:k:L:l:m:M:n:N:o:O:PpQqRr:s:ST:tuUv:" \
-	"VX:xzZ:"
+	"3:AaB:Cc:Dd:E:e:f:FgG:hH:i:I:j:J:K:k:L:l:m:M:n:N:o:O:PpQqRr:s:ST:t"   \
+	"uUv:VX:xzZ:"
 
 	/*
 	 * Process memory debugging argument first.
@@ -3443,6 +3883,16 @@ main(int argc, char *argv[]) {
 			tryverify = true;
 			break;
 
+		case 'B':
+			endp = NULL;
+			batchsize = strtoul(isc_commandline_argument, &endp, 0);
+			if (*endp != '\0' || batchsize == 0 ||
+			    batchsize > INT32_MAX)
+			{
+				fatal("batch size must be a positive number");
+			}
+			break;
+
 		case 'C':
 			make_keyset = true;
 			break;
@@ -3853,6 +4303,24 @@ main(int argc, char *argv[]) {
 		fatal("option -D cannot be used with -M");
 	}
 
+	if (batchsize != 0) {
+		if (inputformat != dns_masterformat_text ||
+		    outputformat != dns_masterformat_text)
+		{
+			fatal("option -B can only be used with text input "
+			      "and output");
+		}
+		if (output_dnssec_only) {
+			fatal("option -B cannot be used with -D");
+		}
+		if (journal != NULL) {
+			fatal("option -B cannot be used with -J");
+		}
+		if (IS_NSEC3) {
+			fatal("option -B cannot be used with NSEC3");
+		}
+	}
+
 	result = dns_master_stylecreate(&dsstyle, DNS_STYLEFLAG_NO_TTL, 0, 24,
 					0, 0, 0, 8, 0xffffffff, mctx);
 	check_result(result, "dns_master_stylecreate");
@@ -3889,6 +4357,11 @@ main(int argc, char *argv[]) {
 		set_nsec3params(update_chain, set_salt, set_optout, set_iter);
 	}
 
+	if (batchsize != 0 && IS_NSEC3) {
+		fatal("option -B cannot be used with NSEC3; use -u to replace "
+		      "the NSEC3 chain with NSEC");
+	}
+
 	/*
 	 * We need to do this early on, as we start messing with the list
 	 * of keys rather early.
@@ -4001,7 +4474,7 @@ main(int argc, char *argv[]) {
 	/* Remove duplicates and cap TTLs at maxttl */
 	cleanup_zone();
 
-	if (!nonsecify) {
+	if (!nonsecify && batchsize == 0) {
 		if (IS_NSEC3) {
 			nsec3ify(dns_hash_sha1, nsec3iter, gsalt, salt_length,
 				 &hashlist);
@@ -4047,26 +4520,33 @@ main(int argc, char *argv[]) {
 		isc_mutex_init(&statslock);
 	}
 
-	presign();
 	sign_start = isc_time_now();
-	signapex();
-	if (!atomic_load(&finished)) {
-		/*
-		 * There is more work to do.  Spread it out over multiple
-		 * processors if possible.
-		 */
-		isc_loopmgr_setup(loopmgr, assignwork, NULL);
-		isc_loopmgr_teardown(loopmgr, abortwork, NULL);
-		isc_loopmgr_run(loopmgr);
-
+	if (batchsize != 0) {
+		stream_signzone(file);
+	} else {
+		presign();
+		signapex();
 		if (!atomic_load(&finished)) {
-			fatal("process aborted by user");
+			/*
+			 * There is more work to do.  Spread it out over
+			 * multiple processors if possible.
+			 */
+			isc_loopmgr_setup(loopmgr, assignwork, NULL);
+			isc_loopmgr_teardown(loopmgr, abortwork, NULL);
+			isc_loopmgr_run(loopmgr);
+
+			if (!atomic_load(&finished)) {
+				fatal("process aborted by user");
+			}
 		}
+		postsign();
 	}
-	postsign();
 	sign_finish = isc_time_now();
 
-	if (disable_zone_check) {
+	/*
+	 * A streamed zone is not kept in memory, so it cannot be verified.
+	 */
+	if (disable_zone_check || batchsize != 0) {
 		vresult = ISC_R_SUCCESS;
 	} else {
 		vresult = dns_zoneverify_dnssec(NULL, gdb, gversion, gorigin,
@@ -4079,7 +4559,7 @@ main(int argc, char *argv[]) {
 		}
 	}
 
-	if (!output_dnssec_only) {
+	if (!output_dnssec_only && batchsize == 0) {
 		dns_masterrawheader_t header;
 		dns_master_initrawheader(&header);
 		if (rawversion == 0U) {
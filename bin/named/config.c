@@ -50,6 +50,7 @@ options {\n\
 	answer-cookie true;\n\
 	automatic-interface-scan yes;\n\
 #	blackhole {none;};\n\
+	cache-snapshot-interval 3600; /* 1 hour */\n\
 	cookie-algorithm siphash24;\n\
 #	directory <none>\n\
 	dnssec-policy \"none\";\n\
@@ -67,12 +68,14 @@ options {\n\
 	interface-interval 60;\n\
 	listen-on {any;};\n\
 	listen-on-v6 {any;};\n\
+	log-queue-size 0;\n\
 	match-mapped-addresses no;\n\
 	max-ixfr-ratio 100%;\n\
 	max-rsa-exponent-size 0; /* no limit */\n\
 	max-udp-size 1232;\n\
 	memstatistics-file \"named.memstats\";\n\
 	nocookie-udp-size 4096;\n\
+	notify-pipelining no;\n\
 	notify-rate 20;\n\
 	nta-lifetime 3600;\n\
 	nta-recheck 300;\n\
@@ -86,6 +89,7 @@ options {\n\
 	reuseport no;\n"
 #endif
 			    "\
+	reuseport-cpu-steering no;\n\
 	tls-port 853;\n"
 #if HAVE_LIBNGHTTP2
 			    "\
@@ -99,27 +103,36 @@ options {\n\
 	recursing-file \"named.recursing\";\n\
 	recursive-clients 1000;\n\
 	request-nsid false;\n\
+	resolver-hedge-percentile 0;\n\
+	resolver-hedge-quota 100;\n\
 	resolver-query-timeout 10;\n\
 	rrset-order { order random; };\n\
 	secroots-file \"named.secroots\";\n\
 	send-cookie true;\n\
+	serial-query-pipelining no;\n\
 	serial-query-rate 20;\n\
 	server-id none;\n\
 	session-keyalg hmac-sha256;\n\
 #	session-keyfile \"" NAMED_LOCALSTATEDIR "/run/named/session.key\";\n\
 	session-keyname local-ddns;\n\
+	slow-query-threshold 0;\n\
 	startup-notify-rate 20;\n\
 	statistics-file \"named.stats\";\n\
 	tcp-advertised-timeout 300;\n\
 	tcp-clients 150;\n\
+	tcp-defer-accept 0;\n\
+	tcp-fastopen-queue 0;\n\
 	tcp-idle-timeout 300;\n\
 	tcp-initial-timeout 300;\n\
 	tcp-keepalive-timeout 300;\n\
 	tcp-listen-queue 10;\n\
 	tcp-receive-buffer 0;\n\
+	tcp-reuse-timeout 50;\n\
 	tcp-send-buffer 0;\n\
 #	tkey-domain <none>\n\
 #	tkey-gssapi-credential <none>\n\
+	tls-ticket-key-lifetime 3600; /* 1 hour */\n\
+	transfer-cache-size 0;\n\
 	transfer-message-size 20480;\n\
 	transfers-in 10;\n\
 	transfers-out 10;\n\
@@ -127,6 +140,7 @@ options {\n\
 	trust-anchor-telemetry yes;\n\
 	udp-receive-buffer 0;\n\
 	udp-send-buffer 0;\n\
+	udp-socket-reuse 1;\n\
 	update-quota 100;\n\
 \n\
 	/* view */\n\
@@ -140,6 +154,7 @@ options {\n\
 	allow-recursion-on { any; };\n\
 	allow-update-forwarding {none;};\n\
 	auth-nxdomain false;\n\
+	cache-rendered-answers no;\n\
 	check-dup-records warn;\n\
 	check-mx warn;\n\
 	check-names primary fail;\n\
@@ -167,9 +182,12 @@ options {\n\
 			    "	max-cache-size 90%;\n\
 	max-cache-ttl 604800; /* 1 week */\n\
 	max-clients-per-query 100;\n\
+	max-delegation-cache-size 0;\n\
 	max-ncache-ttl 10800; /* 3 hours */\n\
+	max-prefetches 0;\n\
 	max-recursion-depth 7;\n\
 	max-recursion-queries 100;\n\
+	max-stale-refreshes 100;\n\
 	max-stale-ttl 86400; /* 1 day */\n\
 	message-compression yes;\n\
 	min-ncache-ttl 0; /* 0 hours */\n\
@@ -220,6 +238,8 @@ options {\n\
 #	forwarders <none>\n\
 #	inline-signing no;\n\
 	ixfr-from-differences false;\n\
+	load-on-demand no;\n\
+	load-on-demand-idle-time 3600; /* 1 hour */\n\
 	max-journal-size default;\n\
 	max-records 0;\n\
 	max-refresh-time 2419200; /* 4 weeks */\n\
@@ -240,7 +260,9 @@ options {\n\
 	sig-signing-type 65534;\n\
 	transfer-source *;\n\
 	transfer-source-v6 *;\n\
+	trie-replicas 0;\n\
 	try-tcp-refresh yes; /* BIND 8 compat */\n\
+	update-group-commit no;\n\
 	zero-no-soa-ttl yes;\n\
 	zone-statistics terse;\n\
 };\n\
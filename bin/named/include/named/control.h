@@ -55,6 +55,7 @@
 #define NAMED_COMMAND_SIGN	   "sign"
 #define NAMED_COMMAND_LOADKEYS	   "loadkeys"
 #define NAMED_COMMAND_ADDZONE	   "addzone"
+#define NAMED_COMMAND_ADDZONES	   "addzones"
 #define NAMED_COMMAND_MODZONE	   "modzone"
 #define NAMED_COMMAND_DELZONE	   "delzone"
 #define NAMED_COMMAND_SHOWZONE	   "showzone"
@@ -28,6 +28,7 @@
 
 #include <dns/acl.h>
 #include <dns/dnstap.h>
+#include <dns/iptable.h>
 #include <dns/stats.h>
 #include <dns/types.h>
 
@@ -64,6 +65,15 @@ struct named_server {
 	dns_loadmgr_t	  *loadmgr;
 	dns_zonemgr_t	  *zonemgr;
 	dns_viewlist_t	   viewlist;
+	/*%
+	 * The match-clients and match-destinations ACLs of the 'nviews'
+	 * views in 'viewlist', compiled for get_matching_view();
+	 * 'viewacls' flags the views whose ACLs could be compiled.
+	 */
+	size_t		   nviews;
+	uint8_t		  *viewacls;
+	dns_iptableset_t  *matchclients;
+	dns_iptableset_t  *matchdestinations;
 	dns_kasplist_t	   kasplist;
 	dns_keystorelist_t keystorelist;
 	ns_interfacemgr_t *interfacemgr;
@@ -73,9 +83,11 @@ struct named_server {
 	isc_timer_t *heartbeat_timer;
 	isc_timer_t *pps_timer;
 	isc_timer_t *tat_timer;
+	isc_timer_t *snapshot_timer;
 
 	uint32_t interface_interval;
 	uint32_t heartbeat_interval;
+	uint32_t snapshot_interval;
 
 	atomic_int reload_status;
 
@@ -104,8 +116,9 @@ struct named_server {
 
 	dns_dtenv_t *dtenv; /*%< Dnstap environment */
 
-	isc_tlsctx_cache_t *tlsctx_server_cache;
-	isc_tlsctx_cache_t *tlsctx_client_cache;
+	isc_tlsctx_cache_t	*tlsctx_server_cache;
+	isc_tlsctx_cache_t	*tlsctx_client_cache;
+	isc_tlsctx_ticketkeys_t *tls_ticketkeys;
 
 	isc_signal_t *sighup;
 };
@@ -291,6 +304,13 @@ isc_result_t
 named_server_changezone(named_server_t *server, char *command,
 			isc_buffer_t **text);
 
+/*%
+ * Adds a list of zones to a view of a running process at once
+ */
+isc_result_t
+named_server_addzones(named_server_t *server, char *command,
+		      isc_buffer_t **text);
+
 /*%
  * Deletes a zone from a running process
  */
@@ -217,11 +217,13 @@ channel_fromconf(const cfg_obj_t *channel, isc_logconfig_t *logconfig) {
 		const cfg_obj_t *printsev = NULL;
 		const cfg_obj_t *printtime = NULL;
 		const cfg_obj_t *buffered = NULL;
+		const cfg_obj_t *binary = NULL;
 
 		(void)cfg_map_get(channel, "print-category", &printcat);
 		(void)cfg_map_get(channel, "print-severity", &printsev);
 		(void)cfg_map_get(channel, "print-time", &printtime);
 		(void)cfg_map_get(channel, "buffered", &buffered);
+		(void)cfg_map_get(channel, "binary", &binary);
 
 		if (printcat != NULL && cfg_obj_asboolean(printcat)) {
 			flags |= ISC_LOG_PRINTCATEGORY;
@@ -232,6 +234,17 @@ channel_fromconf(const cfg_obj_t *channel, isc_logconfig_t *logconfig) {
 		if (buffered != NULL && cfg_obj_asboolean(buffered)) {
 			flags |= ISC_LOG_BUFFERED;
 		}
+		if (binary != NULL && cfg_obj_asboolean(binary)) {
+			if (type != ISC_LOG_TOFILE) {
+				cfg_obj_log(channel, named_g_lctx,
+					    ISC_LOG_ERROR,
+					    "channel '%s': binary requires "
+					    "a file destination",
+					    channelname);
+				return (ISC_R_FAILURE);
+			}
+			flags |= ISC_LOG_BINARY;
+		}
 		if (printtime != NULL && cfg_obj_isboolean(printtime)) {
 			if (cfg_obj_asboolean(printtime)) {
 				flags |= ISC_LOG_PRINTTIME;
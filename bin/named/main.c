@@ -15,6 +15,7 @@
 
 #include <ctype.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <locale.h>
 #include <stdbool.h>
 #include <stdlib.h>
@@ -32,6 +33,7 @@
 #include <isc/fips.h>
 #include <isc/hash.h>
 #include <isc/httpd.h>
+#include <isc/loop.h>
 #include <isc/managers.h>
 #include <isc/netmgr.h>
 #include <isc/os.h>
@@ -128,6 +130,13 @@ static char ellipsis[5] = { 0 };
 static char version[512];
 static int maxudp = 0;
 
+/*
+ * Processors to bind the worker threads to (-n #cpus:cpulist).
+ */
+#define MAX_CPULIST 1024
+static int cpulist[MAX_CPULIST];
+static unsigned int ncpulist = 0;
+
 /*
  * -T options:
  */
@@ -308,8 +317,8 @@ static void
 usage(void) {
 	fprintf(stderr, "usage: named [-4|-6] [-c conffile] [-d debuglevel] "
 			"[-D comment] [-E engine]\n"
-			"             [-f|-g] [-L logfile] [-n number_of_cpus] "
-			"[-p port] [-s]\n"
+			"             [-f|-g] [-L logfile] "
+			"[-n #cpus[:cpulist]] [-p port] [-s]\n"
 			"             [-S sockets] [-t chrootdir] [-u "
 			"username] [-U listeners]\n"
 			"             [-m "
@@ -420,6 +429,7 @@ static struct flag_def {
 			{ NULL, 0, false } },
   mem_context_flags[] = { { "fill", ISC_MEMFLAG_FILL, false },
 			  { "nofill", ISC_MEMFLAG_FILL, true },
+			  { "arenas", ISC_MEMFLAG_ARENAS, false },
 			  { NULL, 0, false } };
 
 static void
@@ -842,6 +852,76 @@ parse_port(char *arg) {
 	}
 }
 
+/*
+ * Parse "-n #cpus[:cpulist]", where 'cpulist' is a comma separated list
+ * of processor numbers and ranges, e.g. "0-7,16-23".  The worker threads
+ * are bound to the listed processors in turn.  If '#cpus' is omitted,
+ * one worker thread is created for each listed processor.
+ */
+static void
+parse_cpus(const char *arg) {
+	const char *list = strchr(arg, ':');
+	char count[32];
+	const char *p = NULL;
+
+	if (list == NULL) {
+		named_g_cpus = parse_int((char *)arg, "number of cpus");
+		if (named_g_cpus == 0) {
+			named_g_cpus = 1;
+		}
+		return;
+	}
+
+	p = list + 1;
+	ncpulist = 0;
+	do {
+		unsigned long first, last;
+		char *endp = NULL;
+
+		if (!isdigit((unsigned char)*p)) {
+			goto invalid;
+		}
+		first = last = strtoul(p, &endp, 10);
+		if (*endp == '-') {
+			p = endp + 1;
+			if (!isdigit((unsigned char)*p)) {
+				goto invalid;
+			}
+			last = strtoul(p, &endp, 10);
+		}
+		if (first > last || last > INT_MAX ||
+		    last - first >= MAX_CPULIST - ncpulist)
+		{
+			goto invalid;
+		}
+		for (unsigned long cpu = first; cpu <= last; cpu++) {
+			cpulist[ncpulist++] = (int)cpu;
+		}
+		p = endp;
+	} while (*p++ == ',');
+
+	if (p[-1] != '\0') {
+		goto invalid;
+	}
+
+	if (list == arg) {
+		named_g_cpus = ncpulist;
+	} else if ((size_t)(list - arg) < sizeof(count)) {
+		memmove(count, arg, list - arg);
+		count[list - arg] = '\0';
+		named_g_cpus = parse_int(count, "number of cpus");
+		if (named_g_cpus == 0) {
+			named_g_cpus = 1;
+		}
+	} else {
+		named_main_earlyfatal("number of cpus '%s' out of range", arg);
+	}
+	return;
+
+invalid:
+	named_main_earlyfatal("invalid list of cpus '%s'", list + 1);
+}
+
 static void
 parse_command_line(int argc, char *argv[]) {
 	int ch;
@@ -924,11 +1004,7 @@ parse_command_line(int argc, char *argv[]) {
 			break;
 		case 'N': /* Deprecated. */
 		case 'n':
-			named_g_cpus = parse_int(isc_commandline_argument,
-						 "number of cpus");
-			if (named_g_cpus == 0) {
-				named_g_cpus = 1;
-			}
+			parse_cpus(isc_commandline_argument);
 			break;
 		case 'p':
 			parse_port(isc_commandline_argument);
@@ -1040,6 +1116,22 @@ create_managers(void) {
 	isc_managers_create(&named_g_mctx, named_g_cpus, &named_g_loopmgr,
 			    &named_g_netmgr);
 
+	if (ncpulist > 0) {
+		int *cpus = isc_mem_cget(named_g_mctx, named_g_cpus,
+					 sizeof(cpus[0]));
+		for (size_t i = 0; i < named_g_cpus; i++) {
+			cpus[i] = cpulist[i % ncpulist];
+		}
+		isc_loopmgr_setaffinity(named_g_loopmgr, cpus);
+		isc_mem_cput(named_g_mctx, cpus, named_g_cpus,
+			     sizeof(cpus[0]));
+
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+			      "binding worker threads to %u listed CPU%s",
+			      ncpulist, ncpulist == 1 ? "" : "s");
+	}
+
 	isc_nm_maxudp(named_g_netmgr, maxudp);
 
 	return (ISC_R_SUCCESS);
@@ -60,7 +60,9 @@
 #include <isc/string.h>
 #include <isc/time.h>
 #include <isc/timer.h>
+#include <isc/work.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/adb.h>
 #include <dns/badcache.h>
@@ -98,6 +100,7 @@
 #include <dns/resolver.h>
 #include <dns/rootns.h>
 #include <dns/rriterator.h>
+#include <dns/sdlz.h>
 #include <dns/secalg.h>
 #include <dns/soa.h>
 #include <dns/stats.h>
@@ -120,6 +123,7 @@
 #include <ns/hooks.h>
 #include <ns/interfacemgr.h>
 #include <ns/listenlist.h>
+#include <ns/xfrout.h>
 
 #include <named/config.h>
 #include <named/control.h>
@@ -171,6 +175,8 @@
 #define MAX_KEEPALIVE_TIMEOUT  UINT32_C(UINT16_MAX * 100)
 #define MIN_ADVERTISED_TIMEOUT UINT32_C(0) /* No minimum */
 #define MAX_ADVERTISED_TIMEOUT UINT32_C(UINT16_MAX * 100)
+#define MAX_REUSE_TIMEOUT      UINT32_C(120000) /* 2 minutes */
+#define MAX_UDP_SOCKET_REUSE   UINT32_C(100)
 
 /*%
  * Check an operation for failure.  Assumes that the function
@@ -245,9 +251,18 @@ struct named_cache {
 	bool needflush;
 	bool adbsizeadjusted;
 	dns_rdataclass_t rdclass;
+	char *snapshotfile;
 	ISC_LINK(named_cache_t) link;
 };
 
+typedef struct cache_snapshot {
+	isc_mem_t *mctx;
+	dns_cache_t *cache;
+	char *filename;
+	bool restore;
+	isc_result_t result;
+} cache_snapshot_t;
+
 struct dumpcontext {
 	isc_mem_t *mctx;
 	bool dumpcache;
@@ -3234,7 +3249,6 @@ configure_rrl(dns_view_t *view, const cfg_obj_t *config, const cfg_obj_t *map) {
 		CHECK_RRL(i >= 1, "invalid 'qps-scale %d'%s", i, "");
 	}
 	rrl->qps_scale = i;
-	rrl->qps = 1.0;
 
 	i = 24;
 	obj = NULL;
@@ -3857,6 +3871,17 @@ configure_dnstap(const cfg_obj_t **maps, dns_view_t *view) {
 				   cfg_obj_asstring(obj));
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "dnstap-sample", &obj);
+	dns_dt_setsample(named_g_server->dtenv,
+			 result == ISC_R_SUCCESS ? cfg_obj_asuint32(obj) : 0);
+
+	obj = NULL;
+	result = named_config_get(maps, "dnstap-summary-interval", &obj);
+	dns_dt_setsummary(named_g_server->dtenv,
+			  result == ISC_R_SUCCESS ? cfg_obj_asduration(obj)
+						  : 0);
+
 	dns_dt_attach(named_g_server->dtenv, &view->dtenv);
 	view->dttypes = dttypes;
 
@@ -4182,6 +4207,8 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		if (obj != NULL) {
 			dns_dlzdb_t *dlzdb = NULL;
 			const cfg_obj_t *name, *search = NULL;
+			const cfg_obj_t *cacheobj = NULL;
+			dns_ttl_t cachettl = 60, ncachettl = 10;
 			char *s = isc_mem_strdup(mctx, cfg_obj_asstring(obj));
 
 			if (s == NULL) {
@@ -4206,6 +4233,29 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 				goto cleanup;
 			}
 
+			/*
+			 * Set up the lookup cache, if one is wanted, before
+			 * the database can be searched.
+			 */
+			(void)cfg_map_get(dlz, "lookup-cache-max-ttl",
+					  &cacheobj);
+			if (cacheobj != NULL) {
+				cachettl = cfg_obj_asduration(cacheobj);
+			}
+			cacheobj = NULL;
+			(void)cfg_map_get(dlz, "lookup-cache-negative-ttl",
+					  &cacheobj);
+			if (cacheobj != NULL) {
+				ncachettl = cfg_obj_asduration(cacheobj);
+			}
+			cacheobj = NULL;
+			(void)cfg_map_get(dlz, "lookup-cache-size", &cacheobj);
+			if (cacheobj != NULL) {
+				dns_sdlz_setcache(dlzdb,
+						  cfg_obj_asuint32(cacheobj),
+						  cachettl, ncachettl);
+			}
+
 			/*
 			 * If the DLZ backend supports configuration,
 			 * and is searchable, then call its configure
@@ -4666,6 +4716,13 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		nsc->needflush = false;
 		nsc->adbsizeadjusted = false;
 		nsc->rdclass = view->rdclass;
+		nsc->snapshotfile = NULL;
+		obj = NULL;
+		result = named_config_get(maps, "cache-snapshot-file", &obj);
+		if (result == ISC_R_SUCCESS) {
+			nsc->snapshotfile = isc_mem_strdup(
+				named_g_mctx, cfg_obj_asstring(obj));
+		}
 		ISC_LINK_INIT(nsc, link);
 		ISC_LIST_APPEND(*cachelist, nsc, link);
 	}
@@ -4682,6 +4739,21 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	INSIST(result == ISC_R_SUCCESS);
 	view->staleanswerttl = ISC_MAX(cfg_obj_asduration(obj), 1);
 
+	/*
+	 * Delegation cache.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "max-delegation-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	if (cfg_obj_asuint64(obj) != 0) {
+		uint64_t value = ISC_MIN(cfg_obj_asuint64(obj), SIZE_MAX);
+		CHECK(dns_cache_create(named_g_loopmgr, view->rdclass,
+				       "_delegation", &cache));
+		dns_cache_setcachesize(cache, (size_t)value);
+		dns_view_setdelegationcache(view, cache);
+		dns_cache_detach(&cache);
+	}
+
 	/*
 	 * Resolver.
 	 */
@@ -4702,6 +4774,15 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		view, named_g_loopmgr, named_g_netmgr, resopts,
 		named_g_server->tlsctx_client_cache, dispatch4, dispatch6));
 
+	/*
+	 * Views that share a cache also share the in-progress fetches,
+	 * so a name that is missing from the cache is only fetched once.
+	 */
+	if (shared_cache && nsc->primaryview->resolver != NULL) {
+		dns_resolver_sharefetches(view->resolver,
+					  nsc->primaryview->resolver);
+	}
+
 	if (resstats == NULL) {
 		isc_stats_create(mctx, &resstats, dns_resstatscounter_max);
 	}
@@ -4819,6 +4900,18 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 	query_timeout = cfg_obj_asuint32(obj);
 	dns_resolver_settimeout(view->resolver, query_timeout);
 
+	/*
+	 * Set up hedged queries.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "resolver-hedge-percentile", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	obj2 = NULL;
+	result = named_config_get(maps, "resolver-hedge-quota", &obj2);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_resolver_sethedging(view->resolver, cfg_obj_asuint32(obj),
+				cfg_obj_asuint32(obj2));
+
 	/* Specify whether to use 0-TTL for negative response for SOA query */
 	dns_resolver_setzeronosoattl(view->resolver, zero_no_soattl);
 
@@ -5514,6 +5607,16 @@ configure_view(dns_view_t *view, dns_viewlist_t *viewlist, cfg_obj_t *config,
 		view->prefetch_eligible = view->prefetch_trigger + 6;
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "max-prefetches", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_quota_max(&view->prefetchquota, cfg_obj_asuint32(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "max-stale-refreshes", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_quota_max(&view->stalerefreshquota, cfg_obj_asuint32(obj));
+
 	/*
 	 * For now, there is only one kind of trusted keys, the
 	 * "security roots".
@@ -7010,6 +7113,80 @@ interface_timer_tick(void *arg) {
 	(void)ns_interfacemgr_scan(server->interfacemgr, false, false);
 }
 
+static void
+cache_snapshot_work(void *arg) {
+	cache_snapshot_t *snap = arg;
+
+	if (snap->restore) {
+		snap->result = dns_cache_restore(snap->cache, snap->filename);
+	} else {
+		snap->result = dns_cache_save(snap->cache, snap->filename);
+	}
+}
+
+static void
+cache_snapshot_log(dns_cache_t *cache, const char *filename, bool restore,
+		   isc_result_t result) {
+	int level = ISC_LOG_INFO;
+
+	/* A missing snapshot is normal on the first start. */
+	if (result != ISC_R_SUCCESS &&
+	    !(restore && result == ISC_R_FILENOTFOUND))
+	{
+		level = ISC_LOG_ERROR;
+	}
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, level,
+		      "%s cache '%s' %s snapshot '%s': %s",
+		      restore ? "restoring" : "saving",
+		      dns_cache_getname(cache), restore ? "from" : "to",
+		      filename, isc_result_totext(result));
+}
+
+static void
+cache_snapshot_done(void *arg) {
+	cache_snapshot_t *snap = arg;
+
+	cache_snapshot_log(snap->cache, snap->filename, snap->restore,
+			   snap->result);
+
+	isc_mem_free(snap->mctx, snap->filename);
+	dns_cache_detach(&snap->cache);
+	isc_mem_putanddetach(&snap->mctx, snap, sizeof(*snap));
+}
+
+/*
+ * Save or restore a cache snapshot in the thread pool, so that
+ * neither a large cache nor a slow disk holds up the main loop.
+ */
+static void
+cache_snapshot(named_cache_t *nsc, bool restore) {
+	cache_snapshot_t *snap = isc_mem_get(named_g_mctx, sizeof(*snap));
+
+	*snap = (cache_snapshot_t){
+		.filename = isc_mem_strdup(named_g_mctx, nsc->snapshotfile),
+		.restore = restore,
+	};
+	isc_mem_attach(named_g_mctx, &snap->mctx);
+	dns_cache_attach(nsc->cache, &snap->cache);
+
+	isc_work_enqueueclass(named_g_mainloop, isc_workclass_bulk,
+			      cache_snapshot_work, cache_snapshot_done, snap);
+}
+
+static void
+snapshot_timer_tick(void *arg) {
+	named_server_t *server = (named_server_t *)arg;
+
+	for (named_cache_t *nsc = ISC_LIST_HEAD(server->cachelist);
+	     nsc != NULL; nsc = ISC_LIST_NEXT(nsc, link))
+	{
+		if (nsc->snapshotfile != NULL) {
+			cache_snapshot(nsc, false);
+		}
+	}
+}
+
 static void
 heartbeat_timer_tick(void *arg) {
 	named_server_t *server = (named_server_t *)arg;
@@ -8129,6 +8306,90 @@ cleanup:
 
 #endif /* HAVE_LMDB */
 
+#define VIEWACL_CLIENTS	     0x01 /*%< match-clients is compiled */
+#define VIEWACL_DESTINATIONS 0x02 /*%< match-destinations is compiled */
+
+/*%
+ * The IP table of 'acl' if it decides the match on the address alone,
+ * or NULL if the ACL has to be matched by dns_acl_match().
+ */
+static dns_iptable_t *
+viewacl_iptable(const dns_acl_t *acl) {
+	if (acl == NULL || acl->length != 0) {
+		return (NULL);
+	}
+	return (acl->iptable);
+}
+
+static void
+clear_viewmatch(named_server_t *server) {
+	if (server->viewacls != NULL) {
+		isc_mem_cput(server->mctx, server->viewacls, server->nviews,
+			     sizeof(server->viewacls[0]));
+		server->viewacls = NULL;
+	}
+	if (server->matchclients != NULL) {
+		dns_iptableset_destroy(&server->matchclients);
+	}
+	if (server->matchdestinations != NULL) {
+		dns_iptableset_destroy(&server->matchdestinations);
+	}
+	server->nviews = 0;
+}
+
+/*%
+ * Compile the match-clients and match-destinations ACLs of all views
+ * into two IP table sets, so that get_matching_view() can tell from one
+ * lookup per address which views cannot match, instead of matching
+ * the ACLs of every view in turn.  ACLs that also depend on keys,
+ * nested negated ACLs and the like are still matched one at a time.
+ */
+static void
+configure_viewmatch(named_server_t *server) {
+	dns_iptable_t **clients = NULL, **destinations = NULL;
+	size_t i = 0;
+
+	clear_viewmatch(server);
+
+	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link))
+	{
+		server->nviews++;
+	}
+	if (server->nviews == 0) {
+		return;
+	}
+
+	server->viewacls = isc_mem_cget(server->mctx, server->nviews,
+					sizeof(server->viewacls[0]));
+	clients = isc_mem_cget(server->mctx, server->nviews,
+			       sizeof(clients[0]));
+	destinations = isc_mem_cget(server->mctx, server->nviews,
+				    sizeof(destinations[0]));
+
+	for (dns_view_t *view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link), i++)
+	{
+		clients[i] = viewacl_iptable(view->matchclients);
+		if (clients[i] != NULL) {
+			server->viewacls[i] |= VIEWACL_CLIENTS;
+		}
+		destinations[i] = viewacl_iptable(view->matchdestinations);
+		if (destinations[i] != NULL) {
+			server->viewacls[i] |= VIEWACL_DESTINATIONS;
+		}
+	}
+
+	dns_iptableset_create(server->mctx, clients, server->nviews,
+			      &server->matchclients);
+	dns_iptableset_create(server->mctx, destinations, server->nviews,
+			      &server->matchdestinations);
+
+	isc_mem_cput(server->mctx, clients, server->nviews, sizeof(clients[0]));
+	isc_mem_cput(server->mctx, destinations, server->nviews,
+		     sizeof(destinations[0]));
+}
+
 static isc_result_t
 load_configuration(const char *filename, named_server_t *server,
 		   bool first_time) {
@@ -8163,6 +8424,7 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_result_t result;
 	uint32_t heartbeat_interval;
 	uint32_t interface_interval;
+	uint32_t snapshot_interval;
 	uint32_t udpsize;
 	uint32_t transfer_message_size;
 	uint32_t recv_tcp_buffer_size;
@@ -8176,8 +8438,12 @@ load_configuration(const char *filename, named_server_t *server,
 	uint32_t softquota = 0;
 	uint32_t max;
 	uint64_t initial, idle, keepalive, advertised;
+	uint32_t reuse;
+	uint32_t ticket_lifetime;
 	bool loadbalancesockets;
-	bool exclusive = true;
+	bool cpusteering;
+	uint32_t deferaccept, fastopen;
+	bool exclusive = false;
 	dns_aclenv_t *env =
 		ns_interfacemgr_getaclenv(named_g_server->interfacemgr);
 
@@ -8193,40 +8459,13 @@ load_configuration(const char *filename, named_server_t *server,
 	ISC_LIST_INIT(cachelist);
 	ISC_LIST_INIT(altsecrets);
 
-	/* Ensure exclusive access to configuration data. */
-	isc_loopmgr_pause(named_g_loopmgr);
-
-	/* Create the ACL configuration context */
-	if (named_g_aclconfctx != NULL) {
-		cfg_aclconfctx_detach(&named_g_aclconfctx);
-	}
-	result = cfg_aclconfctx_create(named_g_mctx, &named_g_aclconfctx);
-	if (result != ISC_R_SUCCESS) {
-		goto cleanup_exclusive;
-	}
-
-	/*
-	 * Shut down all dyndb instances.
-	 */
-	dns_dyndb_cleanup(false);
-
-	/*
-	 * Parse the global default pseudo-config file.
-	 */
-	if (first_time) {
-		result = named_config_parsedefaults(named_g_parser,
-						    &named_g_config);
-		if (result != ISC_R_SUCCESS) {
-			named_main_earlyfatal("unable to load "
-					      "internal defaults: %s",
-					      isc_result_totext(result));
-		}
-		RUNTIME_CHECK(cfg_map_get(named_g_config, "options",
-					  &named_g_defaults) == ISC_R_SUCCESS);
-	}
-
 	/*
 	 * Parse the configuration file using the new config code.
+	 *
+	 * Parsing and checking only build a new, private object tree,
+	 * so they are done before the loops are paused: with a large
+	 * configuration they take most of the time of a reconfiguration,
+	 * and there is no reason to stop answering queries meanwhile.
 	 */
 	config = NULL;
 	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
@@ -8257,6 +8496,39 @@ load_configuration(const char *filename, named_server_t *server,
 		goto cleanup_config;
 	}
 
+	/* Ensure exclusive access to configuration data. */
+	isc_loopmgr_pause(named_g_loopmgr);
+	exclusive = true;
+
+	/* Create the ACL configuration context */
+	if (named_g_aclconfctx != NULL) {
+		cfg_aclconfctx_detach(&named_g_aclconfctx);
+	}
+	result = cfg_aclconfctx_create(named_g_mctx, &named_g_aclconfctx);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup_config;
+	}
+
+	/*
+	 * Shut down all dyndb instances.
+	 */
+	dns_dyndb_cleanup(false);
+
+	/*
+	 * Parse the global default pseudo-config file.
+	 */
+	if (first_time) {
+		result = named_config_parsedefaults(named_g_parser,
+						    &named_g_config);
+		if (result != ISC_R_SUCCESS) {
+			named_main_earlyfatal("unable to load "
+					      "internal defaults: %s",
+					      isc_result_totext(result));
+		}
+		RUNTIME_CHECK(cfg_map_get(named_g_config, "options",
+					  &named_g_defaults) == ISC_R_SUCCESS);
+	}
+
 	/* Let's recreate the TLS context cache */
 	if (server->tlsctx_server_cache != NULL) {
 		isc_tlsctx_cache_detach(&server->tlsctx_server_cache);
@@ -8494,6 +8766,45 @@ load_configuration(const char *filename, named_server_t *server,
 	isc_nm_settimeouts(named_g_netmgr, initial, idle, keepalive,
 			   advertised);
 
+	obj = NULL;
+	result = named_config_get(maps, "tcp-reuse-timeout", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	reuse = cfg_obj_asuint32(obj);
+	if (reuse > MAX_REUSE_TIMEOUT / 100) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "tcp-reuse-timeout value is out of range: "
+			    "lowering to %" PRIu32,
+			    MAX_REUSE_TIMEOUT / 100);
+		reuse = MAX_REUSE_TIMEOUT / 100;
+	}
+	dns_dispatchmgr_settcpreuse(named_g_dispatchmgr, reuse * 100);
+
+	obj = NULL;
+	result = named_config_get(maps, "udp-socket-reuse", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	reuse = cfg_obj_asuint32(obj);
+	if (reuse > MAX_UDP_SOCKET_REUSE) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "udp-socket-reuse value is out of range: "
+			    "lowering to %" PRIu32,
+			    MAX_UDP_SOCKET_REUSE);
+		reuse = MAX_UDP_SOCKET_REUSE;
+	}
+	dns_dispatchmgr_setudpreuse(named_g_dispatchmgr, reuse);
+
+	obj = NULL;
+	result = named_config_get(maps, "tls-ticket-key-lifetime", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ticket_lifetime = cfg_obj_asduration(obj);
+	if (ticket_lifetime == 0) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "tls-ticket-key-lifetime value is out of range: "
+			    "raising to 1");
+		ticket_lifetime = 1;
+	}
+	isc_tlsctx_ticketkeys_setlifetime(server->tls_ticketkeys,
+					  ticket_lifetime);
+
 #define CAP_IF_NOT_ZERO(v, min, max) \
 	if (v > 0 && v < min) {      \
 		v = min;             \
@@ -8653,6 +8964,17 @@ load_configuration(const char *filename, named_server_t *server,
 	server->sctx->transfer_tcp_message_size =
 		(uint16_t)transfer_message_size;
 
+	/* Set the memory limit for reusing outgoing AXFR messages */
+	obj = NULL;
+	result = named_config_get(maps, "transfer-cache-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	ns_xfr_setcachesize(server->sctx, (size_t)cfg_obj_asuint64(obj));
+
+	obj = NULL;
+	result = named_config_get(maps, "slow-query-threshold", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	server->sctx->slowquery_ms = cfg_obj_asuint32(obj);
+
 	/*
 	 * Configure the zone manager.
 	 */
@@ -8671,6 +8993,12 @@ load_configuration(const char *filename, named_server_t *server,
 	INSIST(result == ISC_R_SUCCESS);
 	dns_zonemgr_setnotifyrate(server->zonemgr, cfg_obj_asuint32(obj));
 
+	obj = NULL;
+	result = named_config_get(maps, "notify-pipelining", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_zonemgr_setnotifypipelining(server->zonemgr,
+					cfg_obj_asboolean(obj));
+
 	obj = NULL;
 	result = named_config_get(maps, "startup-notify-rate", &obj);
 	INSIST(result == ISC_R_SUCCESS);
@@ -8682,6 +9010,12 @@ load_configuration(const char *filename, named_server_t *server,
 	INSIST(result == ISC_R_SUCCESS);
 	dns_zonemgr_setserialqueryrate(server->zonemgr, cfg_obj_asuint32(obj));
 
+	obj = NULL;
+	result = named_config_get(maps, "serial-query-pipelining", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	dns_zonemgr_setserialquerypipelining(server->zonemgr,
+					     cfg_obj_asboolean(obj));
+
 	/*
 	 * Determine which port to use for listening for incoming connections.
 	 */
@@ -8727,6 +9061,54 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 #endif
 
+	obj = NULL;
+	result = named_config_get(maps, "reuseport-cpu-steering", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	cpusteering = cfg_obj_asboolean(obj);
+#if HAVE_SO_ATTACH_REUSEPORT_CBPF
+	if (first_time) {
+		isc_nm_setcpusteering(named_g_netmgr, cpusteering);
+	} else if (cpusteering != isc_nm_getcpusteering(named_g_netmgr)) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "changing reuseport-cpu-steering value requires "
+			    "server restart");
+	}
+#else
+	if (cpusteering) {
+		cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+			    "reuseport-cpu-steering has no effect on this "
+			    "system");
+	}
+#endif
+
+	/*
+	 * The TCP listening socket options are set when the listeners
+	 * are created, and an existing listener is kept across
+	 * reconfigurations.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "tcp-defer-accept", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	deferaccept = cfg_obj_asuint32(obj);
+	obj = NULL;
+	result = named_config_get(maps, "tcp-fastopen-queue", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	fastopen = cfg_obj_asuint32(obj);
+	if (first_time) {
+		isc_nm_settcplistenopts(named_g_netmgr, deferaccept, fastopen);
+	} else {
+		uint32_t olddeferaccept, oldfastopen;
+
+		isc_nm_gettcplistenopts(named_g_netmgr, &olddeferaccept,
+					&oldfastopen);
+		if (deferaccept != olddeferaccept || fastopen != oldfastopen) {
+			cfg_obj_log(obj, named_g_lctx, ISC_LOG_WARNING,
+				    "changing tcp-defer-accept or "
+				    "tcp-fastopen-queue requires server "
+				    "restart");
+		}
+	}
+
 	/*
 	 * Configure the interface manager according to the "listen-on"
 	 * statement.
@@ -8867,6 +9249,22 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 	server->heartbeat_interval = heartbeat_interval;
 
+	/*
+	 * Configure the cache snapshot timer.
+	 */
+	obj = NULL;
+	result = named_config_get(maps, "cache-snapshot-interval", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	snapshot_interval = cfg_obj_asduration(obj);
+	if (snapshot_interval == 0) {
+		isc_timer_stop(server->snapshot_timer);
+	} else if (server->snapshot_interval != snapshot_interval) {
+		isc_interval_set(&interval, snapshot_interval, 0);
+		isc_timer_start(server->snapshot_timer, isc_timertype_ticker,
+				&interval);
+	}
+	server->snapshot_interval = snapshot_interval;
+
 	isc_interval_set(&interval, 1200, 0);
 	isc_timer_start(server->pps_timer, isc_timertype_ticker, &interval);
 
@@ -9175,6 +9573,8 @@ load_configuration(const char *filename, named_server_t *server,
 		view->viewlist = &server->viewlist;
 	}
 
+	configure_viewmatch(server);
+
 	/* Swap our new cache list with the production one. */
 	tmpcachelist = server->cachelist;
 	server->cachelist = cachelist;
@@ -9246,6 +9646,20 @@ load_configuration(const char *filename, named_server_t *server,
 	}
 #endif /* HAVE_LMDB */
 
+	/*
+	 * Warm up the caches from the snapshots saved when the server
+	 * last ran.
+	 */
+	if (first_time) {
+		for (nsc = ISC_LIST_HEAD(server->cachelist); nsc != NULL;
+		     nsc = ISC_LIST_NEXT(nsc, link))
+		{
+			if (nsc->snapshotfile != NULL) {
+				cache_snapshot(nsc, true);
+			}
+		}
+	}
+
 	/*
 	 * Configure the logging system.
 	 *
@@ -9326,6 +9740,11 @@ load_configuration(const char *filename, named_server_t *server,
 			      "config file");
 	}
 
+	obj = NULL;
+	result = named_config_get(maps, "log-queue-size", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	isc_log_setasync(named_g_lctx, cfg_obj_asuint32(obj));
+
 	/*
 	 * Set the default value of the query logging flag depending
 	 * whether a "queries" category has been defined.  This is
@@ -9611,6 +10030,9 @@ cleanup_logc:
 cleanup_cachelist:
 	while ((nsc = ISC_LIST_HEAD(cachelist)) != NULL) {
 		ISC_LIST_UNLINK(cachelist, nsc, link);
+		if (nsc->snapshotfile != NULL) {
+			isc_mem_free(named_g_mctx, nsc->snapshotfile);
+		}
 		dns_cache_detach(&nsc->cache);
 		isc_mem_put(server->mctx, nsc, sizeof(*nsc));
 	}
@@ -9882,6 +10304,9 @@ run_server(void *arg) {
 	isc_timer_create(named_g_mainloop, pps_timer_tick, server,
 			 &server->pps_timer);
 
+	isc_timer_create(named_g_mainloop, snapshot_timer_tick, server,
+			 &server->snapshot_timer);
+
 	CHECKFATAL(
 		cfg_parser_create(named_g_mctx, named_g_lctx, &named_g_parser),
 		"creating default configuration parser");
@@ -9966,6 +10391,7 @@ shutdown_server(void *arg) {
 		dns_keystore_detach(&keystore);
 	}
 
+	clear_viewmatch(server);
 	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
 	     view = view_next)
 	{
@@ -9982,6 +10408,12 @@ shutdown_server(void *arg) {
 
 	while ((nsc = ISC_LIST_HEAD(server->cachelist)) != NULL) {
 		ISC_LIST_UNLINK(server->cachelist, nsc, link);
+		if (nsc->snapshotfile != NULL) {
+			cache_snapshot_log(
+				nsc->cache, nsc->snapshotfile, false,
+				dns_cache_save(nsc->cache, nsc->snapshotfile));
+			isc_mem_free(named_g_mctx, nsc->snapshotfile);
+		}
 		dns_cache_detach(&nsc->cache);
 		isc_mem_put(server->mctx, nsc, sizeof(*nsc));
 	}
@@ -9992,6 +10424,7 @@ shutdown_server(void *arg) {
 	isc_timer_destroy(&server->heartbeat_timer);
 	isc_timer_destroy(&server->pps_timer);
 	isc_timer_destroy(&server->tat_timer);
+	isc_timer_destroy(&server->snapshot_timer);
 
 	ns_interfacemgr_detach(&server->interfacemgr);
 
@@ -10013,26 +10446,69 @@ shutdown_server(void *arg) {
 }
 
 /*%
- * Find a view that matches the source and destination addresses of a query.
+ * The address an ACL is matched against, as in dns_acl_match().
  */
-static isc_result_t
-get_matching_view(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
-		  dns_message_t *message, dns_aclenv_t *env,
-		  isc_result_t *sigresult, dns_view_t **viewp) {
+static const isc_netaddr_t *
+viewacl_addr(const isc_netaddr_t *addr, const dns_aclenv_t *env,
+	     isc_netaddr_t *v4addr) {
+	if (env != NULL && env->match_mapped && addr->family == AF_INET6 &&
+	    IN6_IS_ADDR_V4MAPPED(&addr->type.in6))
+	{
+		isc_netaddr_fromv4mapped(v4addr, addr);
+		return (v4addr);
+	}
+	return (addr);
+}
+
+/*%
+ * Find a view that matches the source and destination addresses of a query.
+ */
+static isc_result_t
+get_matching_view(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
+		  dns_message_t *message, dns_aclenv_t *env,
+		  isc_result_t *sigresult, dns_view_t **viewp) {
+	named_server_t *server = named_g_server;
+	const int8_t *clients = NULL, *destinations = NULL;
+	isc_netaddr_t v4addr;
 	dns_view_t *view;
+	size_t i = 0;
 
 	REQUIRE(message != NULL);
 	REQUIRE(sigresult != NULL);
 	REQUIRE(viewp != NULL && *viewp == NULL);
 
-	for (view = ISC_LIST_HEAD(named_g_server->viewlist); view != NULL;
-	     view = ISC_LIST_NEXT(view, link))
+	if (server->nviews != 0) {
+		clients = dns_iptableset_match(
+			server->matchclients,
+			viewacl_addr(srcaddr, env, &v4addr));
+		destinations = dns_iptableset_match(
+			server->matchdestinations,
+			viewacl_addr(destaddr, env, &v4addr));
+	}
+
+	for (view = ISC_LIST_HEAD(server->viewlist); view != NULL;
+	     view = ISC_LIST_NEXT(view, link), i++)
 	{
+		uint8_t compiled = (i < server->nviews) ? server->viewacls[i]
+							: 0;
+
 		if (message->rdclass == view->rdclass ||
 		    message->rdclass == dns_rdataclass_any)
 		{
 			const dns_name_t *tsig = NULL;
 
+			/*
+			 * Skip the signature check of views whose
+			 * compiled ACLs already rule them out.
+			 */
+			if (((compiled & VIEWACL_CLIENTS) != 0 &&
+			     clients[i] <= 0) ||
+			    ((compiled & VIEWACL_DESTINATIONS) != 0 &&
+			     destinations[i] <= 0))
+			{
+				continue;
+			}
+
 			*sigresult = dns_message_rechecksig(message, view);
 			if (*sigresult == ISC_R_SUCCESS) {
 				dns_tsigkey_t *tsigkey;
@@ -10041,10 +10517,12 @@ get_matching_view(isc_netaddr_t *srcaddr, isc_netaddr_t *destaddr,
 				tsig = dns_tsigkey_identity(tsigkey);
 			}
 
-			if (dns_acl_allowed(srcaddr, tsig, view->matchclients,
-					    env) &&
-			    dns_acl_allowed(destaddr, tsig,
-					    view->matchdestinations, env) &&
+			if (((compiled & VIEWACL_CLIENTS) != 0 ||
+			     dns_acl_allowed(srcaddr, tsig, view->matchclients,
+					     env)) &&
+			    ((compiled & VIEWACL_DESTINATIONS) != 0 ||
+			     dns_acl_allowed(destaddr, tsig,
+					     view->matchdestinations, env)) &&
 			    !(view->matchrecursiveonly &&
 			      (message->flags & DNS_MESSAGEFLAG_RD) == 0))
 			{
@@ -10114,6 +10592,12 @@ named_server_create(isc_mem_t *mctx, named_server_t **serverp) {
 			 isc_sockstatscounter_max);
 	isc_nm_setstats(named_g_netmgr, server->sockstats);
 
+	/*
+	 * The session ticket keys outlive reconfigurations, so that
+	 * clients can keep resuming their sessions across reloads.
+	 */
+	isc_tlsctx_ticketkeys_create(mctx, 3600, &server->tls_ticketkeys);
+
 	isc_stats_create(named_g_mctx, &server->zonestats,
 			 dns_zonestatscounter_max);
 
@@ -10193,6 +10677,8 @@ named_server_destroy(named_server_t **serverp) {
 		isc_tlsctx_cache_detach(&server->tlsctx_client_cache);
 	}
 
+	isc_tlsctx_ticketkeys_detach(&server->tls_ticketkeys);
+
 	server->magic = 0;
 	isc_mem_put(server->mctx, server, sizeof(*server));
 	*serverp = NULL;
@@ -10985,7 +11471,8 @@ listenelt_fromconfig(const cfg_obj_t *listener, const cfg_obj_t *config,
 		.prefer_server_ciphers = tls_prefer_server_ciphers,
 		.prefer_server_ciphers_set = tls_prefer_server_ciphers_set,
 		.session_tickets = tls_session_tickets,
-		.session_tickets_set = tls_session_tickets_set
+		.session_tickets_set = tls_session_tickets_set,
+		.ticketkeys = named_g_server->tls_ticketkeys,
 	};
 
 	httpobj = cfg_tuple_get(ltup, "http");
@@ -12070,7 +12557,8 @@ isc_result_t
 named_server_status(named_server_t *server, isc_buffer_t **text) {
 	isc_result_t result;
 	unsigned int zonecount, xferrunning, xferdeferred, xferfirstrefresh;
-	unsigned int soaqueries, automatic;
+	unsigned int soaqueries, automatic, loading;
+	uint32_t running, waiting;
 	const char *ob = "", *cb = "", *alt = "";
 	char boottime[ISC_FORMATHTTPTIMESTAMP_SIZE];
 	char configtime[ISC_FORMATHTTPTIMESTAMP_SIZE];
@@ -12099,6 +12587,7 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 					  DNS_ZONESTATE_SOAQUERY);
 	automatic = dns_zonemgr_getcount(server->zonemgr,
 					 DNS_ZONESTATE_AUTOMATIC);
+	loading = dns_zonemgr_getcount(server->zonemgr, DNS_ZONESTATE_LOADING);
 
 	isc_time_formathttptimestamp(&named_g_boottime, boottime,
 				     sizeof(boottime));
@@ -12138,10 +12627,32 @@ named_server_status(named_server_t *server, isc_buffer_t **text) {
 	snprintf(line, sizeof(line), "worker threads: %u\n", named_g_cpus);
 	CHECK(putstr(text, line));
 
+	isc_work_stats(named_g_loopmgr, isc_workclass_interactive, &running,
+		       &waiting);
+	snprintf(line, sizeof(line),
+		 "offloaded work: %" PRIu32 " interactive, ", running);
+	CHECK(putstr(text, line));
+	isc_work_stats(named_g_loopmgr, isc_workclass_bulk, &running,
+		       &waiting);
+	snprintf(line, sizeof(line),
+		 "%" PRIu32 " bulk (%" PRIu32 " waiting), ", running, waiting);
+	CHECK(putstr(text, line));
+	isc_work_stats(named_g_loopmgr, isc_workclass_background, &running,
+		       &waiting);
+	snprintf(line, sizeof(line),
+		 "%" PRIu32 " background (%" PRIu32 " waiting)\n", running,
+		 waiting);
+	CHECK(putstr(text, line));
+
 	snprintf(line, sizeof(line), "number of zones: %u (%u automatic)\n",
 		 zonecount, automatic);
 	CHECK(putstr(text, line));
 
+	if (loading > 0) {
+		snprintf(line, sizeof(line), "zones loading: %u\n", loading);
+		CHECK(putstr(text, line));
+	}
+
 	snprintf(line, sizeof(line), "debug level: %u\n", named_g_debuglevel);
 	CHECK(putstr(text, line));
 
@@ -12720,13 +13231,17 @@ dumpzone(void *arg, const char *buf, int len) {
 	}
 }
 
+/*
+ * Write the configuration of 'zone' into the NZD transaction 'txn', or
+ * delete it if 'zconfig' is NULL, without committing the transaction.
+ * Returns ISC_R_NOTFOUND if there was nothing to delete.
+ */
 static isc_result_t
-nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
-	 const cfg_obj_t *zconfig) {
+nzd_put(MDB_txn *txn, MDB_dbi dbi, dns_zone_t *zone,
+	const cfg_obj_t *zconfig) {
 	isc_result_t result;
 	int status;
 	dns_view_t *view;
-	bool commit = false;
 	isc_buffer_t *text = NULL;
 	char namebuf[1024];
 	MDB_val key, data;
@@ -12738,8 +13253,11 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 
 	if (zconfig == NULL) {
 		/* We're deleting the zone from the database */
-		status = mdb_del(*txnp, dbi, &key, NULL);
-		if (status != MDB_SUCCESS && status != MDB_NOTFOUND) {
+		status = mdb_del(txn, dbi, &key, NULL);
+		if (status == MDB_NOTFOUND) {
+			result = ISC_R_NOTFOUND;
+			goto cleanup;
+		} else if (status != MDB_SUCCESS) {
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
 				      "Error deleting zone %s "
@@ -12747,8 +13265,6 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 				      namebuf, mdb_strerror(status));
 			result = ISC_R_FAILURE;
 			goto cleanup;
-		} else if (status != MDB_NOTFOUND) {
-			commit = true;
 		}
 	} else {
 		/* We're creating or overwriting the zone */
@@ -12783,7 +13299,7 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 		data.mv_data = isc_buffer_base(text);
 		data.mv_size = isc_buffer_usedlength(text);
 
-		status = mdb_put(*txnp, dbi, &key, &data, 0);
+		status = mdb_put(txn, dbi, &key, &data, 0);
 		if (status != MDB_SUCCESS) {
 			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
 				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
@@ -12793,28 +13309,11 @@ nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
 			result = ISC_R_FAILURE;
 			goto cleanup;
 		}
-
-		commit = true;
 	}
 
 	result = ISC_R_SUCCESS;
 
 cleanup:
-	if (!commit || result != ISC_R_SUCCESS) {
-		(void)mdb_txn_abort(*txnp);
-	} else {
-		status = mdb_txn_commit(*txnp);
-		if (status != MDB_SUCCESS) {
-			isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
-				      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
-				      "Error committing "
-				      "NZD database: %s",
-				      mdb_strerror(status));
-			result = ISC_R_FAILURE;
-		}
-	}
-	*txnp = NULL;
-
 	if (text != NULL) {
 		isc_buffer_free(&text);
 	}
@@ -12822,6 +13321,38 @@ cleanup:
 	return (result);
 }
 
+static isc_result_t
+nzd_commit(MDB_txn **txnp) {
+	int status;
+
+	status = mdb_txn_commit(*txnp);
+	*txnp = NULL;
+	if (status != MDB_SUCCESS) {
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "Error committing NZD database: %s",
+			      mdb_strerror(status));
+		return (ISC_R_FAILURE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+nzd_save(MDB_txn **txnp, MDB_dbi dbi, dns_zone_t *zone,
+	 const cfg_obj_t *zconfig) {
+	isc_result_t result;
+
+	result = nzd_put(*txnp, dbi, zone, zconfig);
+	if (result != ISC_R_SUCCESS) {
+		(void)mdb_txn_abort(*txnp);
+		*txnp = NULL;
+		return (result == ISC_R_NOTFOUND ? ISC_R_SUCCESS : result);
+	}
+
+	return (nzd_commit(txnp));
+}
+
 /*
  * Check whether the new zone database for 'view' can be opened for writing.
  *
@@ -13181,57 +13712,23 @@ cleanup:
 }
 #endif /* HAVE_LMDB */
 
+/*
+ * Check that the zone statement 'zoneobj' can be given to the 'bn'
+ * command ("addzone", "modzone" or "addzones"), and find its view.
+ */
 static isc_result_t
-newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
-	      cfg_obj_t **zoneconfp, const cfg_obj_t **zoneobjp,
-	      bool *redirectp, isc_buffer_t **text) {
+newzone_check(named_server_t *server, const char *bn,
+	      const cfg_obj_t *zoneobj, dns_view_t **viewp, bool *redirectp,
+	      isc_buffer_t **text) {
 	isc_result_t result;
-	isc_buffer_t argbuf;
-	bool redirect = false;
-	cfg_obj_t *zoneconf = NULL;
-	const cfg_obj_t *zlist = NULL;
-	const cfg_obj_t *zoneobj = NULL;
 	const cfg_obj_t *zoptions = NULL;
 	const cfg_obj_t *obj = NULL;
 	const char *viewname = NULL;
 	dns_rdataclass_t rdclass;
-	dns_view_t *view = NULL;
-	const char *bn = NULL;
 
 	REQUIRE(viewp != NULL && *viewp == NULL);
-	REQUIRE(zoneobjp != NULL && *zoneobjp == NULL);
-	REQUIRE(zoneconfp != NULL && *zoneconfp == NULL);
 	REQUIRE(redirectp != NULL);
 
-	/* Try to parse the argument string */
-	isc_buffer_init(&argbuf, command, (unsigned int)strlen(command));
-	isc_buffer_add(&argbuf, strlen(command));
-
-	if (strncasecmp(command, "add", 3) == 0) {
-		bn = "addzone";
-	} else if (strncasecmp(command, "mod", 3) == 0) {
-		bn = "modzone";
-	} else {
-		UNREACHABLE();
-	}
-
-	/*
-	 * Convert the "addzone" or "modzone" to just "zone", for
-	 * the benefit of the parser
-	 */
-	isc_buffer_forward(&argbuf, 3);
-
-	cfg_parser_reset(named_g_addparser);
-	CHECK(cfg_parse_buffer(named_g_addparser, &argbuf, bn, 0,
-			       &cfg_type_addzoneconf, 0, &zoneconf));
-	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
-	if (!cfg_obj_islist(zlist)) {
-		CHECK(ISC_R_FAILURE);
-	}
-
-	/* For now we only support adding one zone at a time */
-	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
-
 	/* Check the zone type for ones that are not supported by addzone. */
 	zoptions = cfg_tuple_get(zoneobj, "options");
 
@@ -13245,7 +13742,7 @@ newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 		} else {
 			(void)putstr(text, "zone type not specified");
 		}
-		CHECK(ISC_R_FAILURE);
+		return (ISC_R_FAILURE);
 	}
 
 	if (strcasecmp(cfg_obj_asstring(obj), "hint") == 0 ||
@@ -13255,16 +13752,17 @@ newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 		(void)putstr(text, cfg_obj_asstring(obj));
 		(void)putstr(text, "' zones not supported by ");
 		(void)putstr(text, bn);
-		CHECK(ISC_R_FAILURE);
+		return (ISC_R_FAILURE);
 	}
 
-	if (strcasecmp(cfg_obj_asstring(obj), "redirect") == 0) {
-		redirect = true;
-	}
+	*redirectp = (strcasecmp(cfg_obj_asstring(obj), "redirect") == 0);
 
 	/* Make sense of optional class argument */
 	obj = cfg_tuple_get(zoneobj, "class");
-	CHECK(named_config_getclass(obj, dns_rdataclass_in, &rdclass));
+	result = named_config_getclass(obj, dns_rdataclass_in, &rdclass);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
 
 	/* Make sense of optional view argument */
 	obj = cfg_tuple_get(zoneobj, "view");
@@ -13274,20 +13772,68 @@ newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
 	if (viewname == NULL || *viewname == '\0') {
 		viewname = "_default";
 	}
-	result = dns_viewlist_find(&server->viewlist, viewname, rdclass, &view);
+	result = dns_viewlist_find(&server->viewlist, viewname, rdclass, viewp);
 	if (result == ISC_R_NOTFOUND) {
 		(void)putstr(text, "no matching view found for '");
 		(void)putstr(text, viewname);
 		(void)putstr(text, "'");
-		goto cleanup;
-	} else if (result != ISC_R_SUCCESS) {
-		goto cleanup;
 	}
 
-	*viewp = view;
+	return (result);
+}
+
+static isc_result_t
+newzone_parse(named_server_t *server, char *command, dns_view_t **viewp,
+	      cfg_obj_t **zoneconfp, const cfg_obj_t **zoneobjp,
+	      bool *redirectp, isc_buffer_t **text) {
+	isc_result_t result;
+	isc_buffer_t argbuf;
+	cfg_obj_t *zoneconf = NULL;
+	const cfg_obj_t *zlist = NULL;
+	const cfg_obj_t *zoneobj = NULL;
+	const char *bn = NULL;
+
+	REQUIRE(viewp != NULL && *viewp == NULL);
+	REQUIRE(zoneobjp != NULL && *zoneobjp == NULL);
+	REQUIRE(zoneconfp != NULL && *zoneconfp == NULL);
+	REQUIRE(redirectp != NULL);
+
+	/* Try to parse the argument string */
+	isc_buffer_init(&argbuf, command, (unsigned int)strlen(command));
+	isc_buffer_add(&argbuf, strlen(command));
+
+	if (strncasecmp(command, "add", 3) == 0) {
+		bn = "addzone";
+	} else if (strncasecmp(command, "mod", 3) == 0) {
+		bn = "modzone";
+	} else {
+		UNREACHABLE();
+	}
+
+	/*
+	 * Convert the "addzone" or "modzone" to just "zone", for
+	 * the benefit of the parser
+	 */
+	isc_buffer_forward(&argbuf, 3);
+
+	cfg_parser_reset(named_g_addparser);
+	CHECK(cfg_parse_buffer(named_g_addparser, &argbuf, bn, 0,
+			       &cfg_type_addzoneconf, 0, &zoneconf));
+	CHECK(cfg_map_get(zoneconf, "zone", &zlist));
+	if (!cfg_obj_islist(zlist)) {
+		CHECK(ISC_R_FAILURE);
+	}
+
+	/*
+	 * Only one zone at a time is supported here; see
+	 * named_server_addzones() for adding many.
+	 */
+	zoneobj = cfg_listelt_value(cfg_list_first(zlist));
+
+	CHECK(newzone_check(server, bn, zoneobj, viewp, redirectp, text));
+
 	*zoneobjp = zoneobj;
 	*zoneconfp = zoneconf;
-	*redirectp = redirect;
 
 	return (ISC_R_SUCCESS);
 
@@ -13295,9 +13841,6 @@ cleanup:
 	if (zoneconf != NULL) {
 		cfg_obj_destroy(named_g_addparser, &zoneconf);
 	}
-	if (view != NULL) {
-		dns_view_detach(&view);
-	}
 
 	return (result);
 }
@@ -13857,6 +14400,358 @@ cleanup:
 	return (result);
 }
 
+/*
+ * Add all the zones in 'zlist' to 'view' in one go: the loops are
+ * paused and the view is thawed only once, and the configurations are
+ * saved with a single NZD transaction.  Either all of the zones are
+ * added, or none of them.
+ */
+static isc_result_t
+do_addzones(named_server_t *server, ns_cfgctx_t *cfg, dns_view_t *view,
+	    cfg_obj_t *zoneconf, const cfg_obj_t *zlist, size_t nzones,
+	    isc_buffer_t **text) {
+	isc_result_t result = ISC_R_SUCCESS, tresult;
+	const cfg_listelt_t *element = NULL;
+	dns_zone_t **zones = NULL;
+	size_t i, added = 0;
+#ifndef HAVE_LMDB
+	FILE *fp = NULL;
+	bool cleanup_config = false;
+#else /* HAVE_LMDB */
+	MDB_txn *txn = NULL;
+	MDB_dbi dbi;
+	bool locked = false;
+
+	UNUSED(zoneconf);
+#endif /* HAVE_LMDB */
+
+	zones = isc_mem_cget(server->mctx, nzones, sizeof(zones[0]));
+
+	/* None of the zones should exist yet */
+	for (element = cfg_list_first(zlist); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		const cfg_obj_t *zoneobj = cfg_listelt_value(element);
+		const char *zonename = NULL;
+		dns_fixedname_t fname;
+		dns_name_t *name = dns_fixedname_initname(&fname);
+		dns_zone_t *zone = NULL;
+
+		zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
+		result = dns_name_fromstring(name, zonename, dns_rootname, 0,
+					     NULL);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_view_findzone(view, name, DNS_ZTFIND_EXACT,
+						   &zone);
+			if (result == ISC_R_SUCCESS) {
+				dns_zone_detach(&zone);
+				result = ISC_R_EXISTS;
+			} else if (result == ISC_R_NOTFOUND) {
+				result = ISC_R_SUCCESS;
+			}
+		}
+		if (result != ISC_R_SUCCESS) {
+			TCHECK(putstr(text, "zone '"));
+			TCHECK(putstr(text, zonename));
+			TCHECK(putstr(text, "': "));
+			TCHECK(putstr(text, isc_result_totext(result)));
+			goto cleanup;
+		}
+	}
+
+	isc_loopmgr_pause(named_g_loopmgr);
+
+#ifndef HAVE_LMDB
+	/*
+	 * Make sure we can open the configuration save file
+	 */
+	result = isc_stdio_open(view->new_zone_file, "a", &fp);
+	if (result != ISC_R_SUCCESS) {
+		isc_loopmgr_resume(named_g_loopmgr);
+		TCHECK(putstr(text, "unable to create '"));
+		TCHECK(putstr(text, view->new_zone_file));
+		TCHECK(putstr(text, "': "));
+		TCHECK(putstr(text, isc_result_totext(result)));
+		goto cleanup;
+	}
+
+	(void)isc_stdio_close(fp);
+	fp = NULL;
+#else  /* HAVE_LMDB */
+	LOCK(&view->new_zone_lock);
+	locked = true;
+	/* Make sure we can open the NZD database */
+	result = nzd_writable(view);
+	if (result != ISC_R_SUCCESS) {
+		isc_loopmgr_resume(named_g_loopmgr);
+		TCHECK(putstr(text, "unable to open NZD database for '"));
+		TCHECK(putstr(text, view->new_zone_db));
+		TCHECK(putstr(text, "'"));
+		result = ISC_R_FAILURE;
+		goto cleanup;
+	}
+#endif /* HAVE_LMDB */
+
+	/* Mark view unfrozen and configure the zones */
+	dns_view_thaw(view);
+	for (element = cfg_list_first(zlist); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		const cfg_obj_t *zoneobj = cfg_listelt_value(element);
+		const char *zonename = NULL;
+		dns_fixedname_t fname;
+		dns_name_t *name = dns_fixedname_initname(&fname);
+
+		zonename = cfg_obj_asstring(cfg_tuple_get(zoneobj, "name"));
+		result = configure_zone(cfg->config, zoneobj, cfg->vconfig,
+					view, &server->viewlist,
+					&server->kasplist,
+					&server->keystorelist, cfg->actx, true,
+					false, false);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_name_fromstring(name, zonename,
+						     dns_rootname, 0, NULL);
+		}
+		if (result == ISC_R_SUCCESS) {
+			INSIST(added < nzones);
+			result = dns_view_findzone(view, name, DNS_ZTFIND_EXACT,
+						   &zones[added]);
+		}
+		if (result != ISC_R_SUCCESS) {
+			(void)putstr(text, "configure_zone failed for '");
+			(void)putstr(text, zonename);
+			(void)putstr(text, "': ");
+			(void)putstr(text, isc_result_totext(result));
+			break;
+		}
+		added++;
+	}
+	dns_view_freeze(view);
+
+	isc_loopmgr_resume(named_g_loopmgr);
+
+	if (result != ISC_R_SUCCESS) {
+		goto revert;
+	}
+
+#ifndef HAVE_LMDB
+	/*
+	 * If there wasn't a previous newzone config, just save the one
+	 * we've created. If there was a previous one, merge the new
+	 * zones into it.
+	 */
+	cleanup_config = true;
+	if (cfg->nzf_config == NULL) {
+		cfg_obj_attach(zoneconf, &cfg->nzf_config);
+	} else {
+		for (element = cfg_list_first(zlist); element != NULL;
+		     element = cfg_list_next(element))
+		{
+			cfg_obj_t *z = UNCONST(cfg_listelt_value(element));
+			result = cfg_parser_mapadd(cfg->add_parser,
+						   cfg->nzf_config, z, "zone");
+			if (result != ISC_R_SUCCESS) {
+				goto revert;
+			}
+		}
+	}
+#endif /* HAVE_LMDB */
+
+	/*
+	 * Load the zones from their master files.  If any of them fails,
+	 * all of them are removed again.
+	 */
+	for (i = 0; i < added; i++) {
+		result = dns_zone_load(zones[i], true);
+		if (result != ISC_R_SUCCESS) {
+			char zname[DNS_NAME_FORMATSIZE];
+
+			dns_name_format(dns_zone_getorigin(zones[i]), zname,
+					sizeof(zname));
+			(void)putstr(text, "dns_zone_loadnew failed for '");
+			(void)putstr(text, zname);
+			(void)putstr(text, "': ");
+			(void)putstr(text, isc_result_totext(result));
+			goto revert;
+		}
+	}
+
+	/* Flag the zones as having been added at runtime */
+	for (i = 0; i < added; i++) {
+		dns_zone_setadded(zones[i], true);
+	}
+
+#ifdef HAVE_LMDB
+	/* Save the new zone configurations into the NZD */
+	CHECK(nzd_open(view, 0, &txn, &dbi));
+	for (element = cfg_list_first(zlist), i = 0; element != NULL;
+	     element = cfg_list_next(element), i++)
+	{
+		CHECK(nzd_put(txn, dbi, zones[i], cfg_listelt_value(element)));
+	}
+	CHECK(nzd_commit(&txn));
+#else  /* ifdef HAVE_LMDB */
+	/* Append the zone configurations to the NZF */
+	for (element = cfg_list_first(zlist); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		CHECK(nzf_append(view, cfg_listelt_value(element)));
+	}
+#endif /* HAVE_LMDB */
+
+	goto cleanup;
+
+revert:
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "addzones failed; reverting.");
+
+	for (i = 0; i < added; i++) {
+		dns_db_t *dbp = NULL;
+
+		/* If the zone loaded partially, unload it */
+		if (dns_zone_getdb(zones[i], &dbp) == ISC_R_SUCCESS) {
+			dns_db_detach(&dbp);
+			dns_zone_unload(zones[i]);
+		}
+
+		/* Remove the zone from the zone table */
+		dns_view_delzone(view, zones[i]);
+	}
+
+cleanup:
+#ifndef HAVE_LMDB
+	if (fp != NULL) {
+		(void)isc_stdio_close(fp);
+	}
+	if (result != ISC_R_SUCCESS && cleanup_config) {
+		for (i = 0; i < added; i++) {
+			tresult = delete_zoneconf(
+				view, cfg->add_parser, cfg->nzf_config,
+				dns_zone_getorigin(zones[i]), NULL);
+			RUNTIME_CHECK(tresult == ISC_R_SUCCESS ||
+				      tresult == ISC_R_NOTFOUND);
+		}
+	}
+#else  /* HAVE_LMDB */
+	if (txn != NULL) {
+		(void)nzd_close(&txn, false);
+	}
+	if (locked) {
+		UNLOCK(&view->new_zone_lock);
+	}
+#endif /* HAVE_LMDB */
+
+	for (i = 0; i < added; i++) {
+		dns_zone_detach(&zones[i]);
+	}
+	isc_mem_cput(server->mctx, zones, nzones, sizeof(zones[0]));
+
+	return (result);
+}
+
+isc_result_t
+named_server_addzones(named_server_t *server, char *command,
+		      isc_buffer_t **text) {
+	isc_result_t result;
+	isc_buffer_t argbuf;
+	cfg_obj_t *zoneconf = NULL;
+	const cfg_obj_t *zlist = NULL;
+	const cfg_listelt_t *element = NULL;
+	ns_cfgctx_t *cfg = NULL;
+	dns_view_t *view = NULL;
+	size_t nzones = 0;
+
+	REQUIRE(text != NULL);
+
+	/* Skip the command name; the rest is a list of zone statements */
+	INSIST(strncasecmp(command, NAMED_COMMAND_ADDZONES,
+			   strlen(NAMED_COMMAND_ADDZONES)) == 0);
+	isc_buffer_init(&argbuf, command, (unsigned int)strlen(command));
+	isc_buffer_add(&argbuf, strlen(command));
+	isc_buffer_forward(&argbuf, strlen(NAMED_COMMAND_ADDZONES));
+
+	cfg_parser_reset(named_g_addparser);
+	CHECK(cfg_parse_buffer(named_g_addparser, &argbuf,
+			       NAMED_COMMAND_ADDZONES, 0, &cfg_type_addzoneconf,
+			       0, &zoneconf));
+	result = cfg_map_get(zoneconf, "zone", &zlist);
+	if (result != ISC_R_SUCCESS || !cfg_obj_islist(zlist)) {
+		(void)putstr(text, "no zones specified");
+		CHECK(ISC_R_FAILURE);
+	}
+
+	for (element = cfg_list_first(zlist); element != NULL;
+	     element = cfg_list_next(element))
+	{
+		const cfg_obj_t *zoneobj = cfg_listelt_value(element);
+		dns_view_t *zview = NULL;
+		bool redirect = false;
+
+		CHECK(newzone_check(server, NAMED_COMMAND_ADDZONES, zoneobj,
+				    &zview, &redirect, text));
+		if (view == NULL) {
+			dns_view_attach(zview, &view);
+		}
+		if (zview != view) {
+			dns_view_detach(&zview);
+			(void)putstr(text, "all zones must be in the same "
+					   "view");
+			CHECK(ISC_R_FAILURE);
+		}
+		dns_view_detach(&zview);
+		if (redirect) {
+			(void)putstr(text, "'redirect' zones not supported "
+					   "by " NAMED_COMMAND_ADDZONES);
+			CHECK(ISC_R_FAILURE);
+		}
+		nzones++;
+	}
+
+	/* Are we accepting new zones in this view? */
+#ifdef HAVE_LMDB
+	if (view->new_zone_db == NULL)
+#else  /* ifdef HAVE_LMDB */
+	if (view->new_zone_file == NULL)
+#endif /* HAVE_LMDB */
+	{
+		(void)putstr(text, "Not allowing new zones in view '");
+		(void)putstr(text, view->name);
+		(void)putstr(text, "'");
+		result = ISC_R_NOPERM;
+		goto cleanup;
+	}
+
+	cfg = (ns_cfgctx_t *)view->new_zone_config;
+	if (cfg == NULL) {
+		result = ISC_R_FAILURE;
+		goto cleanup;
+	}
+
+	CHECK(do_addzones(server, cfg, view, zoneconf, zlist, nzones, text));
+
+	isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+		      NAMED_LOGMODULE_SERVER, ISC_LOG_INFO,
+		      "added %zu zones in view %s via %s", nzones, view->name,
+		      NAMED_COMMAND_ADDZONES);
+
+	/* Changing zones counts as reconfiguration */
+	named_g_configtime = isc_time_now();
+
+cleanup:
+	if (isc_buffer_usedlength(*text) > 0) {
+		(void)putnull(text);
+	}
+	if (zoneconf != NULL) {
+		cfg_obj_destroy(named_g_addparser, &zoneconf);
+	}
+	if (view != NULL) {
+		dns_view_detach(&view);
+	}
+
+	return (result);
+}
+
 static bool
 inuse(const char *file, bool first, isc_buffer_t **text) {
 	if (file != NULL && isc_file_exists(file)) {
@@ -57,11 +57,11 @@
 #include "xsl_p.h"
 
 #define STATS_XML_VERSION_MAJOR "3"
-#define STATS_XML_VERSION_MINOR "14"
+#define STATS_XML_VERSION_MINOR "17"
 #define STATS_XML_VERSION	STATS_XML_VERSION_MAJOR "." STATS_XML_VERSION_MINOR
 
 #define STATS_JSON_VERSION_MAJOR "1"
-#define STATS_JSON_VERSION_MINOR "8"
+#define STATS_JSON_VERSION_MINOR "11"
 #define STATS_JSON_VERSION	 STATS_JSON_VERSION_MAJOR "." STATS_JSON_VERSION_MINOR
 
 #define CHECK(m)                               \
@@ -470,6 +470,13 @@ init_desc(void) {
 			"ClientQuota");
 	SET_RESSTATDESC(nextitem, "waited for next item", "NextItem");
 	SET_RESSTATDESC(priming, "priming queries", "Priming");
+	SET_RESSTATDESC(tcpreuse, "TCP connections reused", "TCPReuse");
+	SET_RESSTATDESC(tcpidleclose, "idle TCP connections closed",
+			"TCPIdleClose");
+	SET_RESSTATDESC(udpreuse, "UDP sockets reused", "UDPReuse");
+	SET_RESSTATDESC(hedge, "hedged queries sent", "Hedged");
+	SET_RESSTATDESC(failcache, "fetches failed from the fail cache",
+			"FailCache");
 
 	INSIST(i == dns_resstatscounter_max);
 
@@ -615,6 +622,10 @@ init_desc(void) {
 			 "TCP4Clients");
 	SET_SOCKSTATDESC(tcp6clients, "TCP/IPv6 clients currently connected",
 			 "TCP6Clients");
+	SET_SOCKSTATDESC(tlshandshake, "TLS server handshakes completed",
+			 "TLSHandshake");
+	SET_SOCKSTATDESC(tlsresumed, "TLS server sessions resumed",
+			 "TLSResumed");
 	INSIST(i == isc_sockstatscounter_max);
 
 	/* Initialize DNSSEC statistics */
@@ -832,6 +843,37 @@ dump_histo(isc_histomulti_t *hm, isc_statsformat_t type, void *arg,
 	return (dump_counters(type, arg, category, desc, ncounters, indices,
 			      values, options));
 }
+
+static const char *latency_names[ns_latency_max] = {
+	"setup", "lookup", "recursion", "send", "total",
+};
+
+/*
+ * Query processing latency in microseconds, as quantiles of the
+ * histogram; the fractions must be in decreasing order.
+ */
+static isc_result_t
+dump_latency(isc_histomulti_t *hm, isc_statsformat_t type, void *arg) {
+	static const double fraction[] = { 0.999, 0.99, 0.9, 0.5 };
+	static const char *desc[] = { "p99.9", "p99", "p90", "p50", "count" };
+	int indices[] = { 4, 3, 2, 1, 0 };
+	uint64_t values[ARRAY_SIZE(desc)] = { 0 };
+	isc_histo_t *hg = NULL;
+	double count = 0;
+
+	isc_histomulti_merge(&hg, hm);
+	isc_histo_moments(hg, &count, NULL, NULL);
+	values[4] = (uint64_t)count;
+	if (values[4] > 0) {
+		RUNTIME_CHECK(isc_histo_quantiles(hg, ARRAY_SIZE(fraction),
+						  fraction,
+						  values) == ISC_R_SUCCESS);
+	}
+	isc_histo_destroy(&hg);
+
+	return (dump_counters(type, arg, NULL, desc, ARRAY_SIZE(desc),
+			      indices, values, ISC_STATSDUMP_VERBOSE));
+}
 #endif /* defined(EXTENDED_STATS) */
 
 static isc_result_t
@@ -1263,6 +1305,25 @@ cleanup:
 }
 #endif /* defined(EXTENDED_STATS) */
 
+#if defined(HAVE_LIBXML2) || defined(HAVE_JSON_C)
+/*
+ * Bytes of record data in the zone's current database, or 0 if the
+ * zone is not loaded.
+ */
+static size_t
+zone_memoryusage(dns_zone_t *zone) {
+	dns_db_t *db = NULL;
+	size_t memory = 0;
+
+	if (dns_zone_getdb(zone, &db) == ISC_R_SUCCESS) {
+		memory = dns_db_memoryusage(db);
+		dns_db_detach(&db);
+	}
+
+	return (memory);
+}
+#endif /* if defined(HAVE_LIBXML2) || defined(HAVE_JSON_C) */
+
 #ifdef HAVE_LIBXML2
 /*
  * Which statistics to include when rendering to XML
@@ -1325,6 +1386,11 @@ zone_xmlrender(dns_zone_t *zone, void *arg) {
 	}
 	TRY0(xmlTextWriterEndElement(writer)); /* serial */
 
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "memory"));
+	TRY0(xmlTextWriterWriteFormatString(writer, "%zu",
+					    zone_memoryusage(zone)));
+	TRY0(xmlTextWriterEndElement(writer)); /* memory */
+
 	/*
 	 * Export zone timers to the statistics channel in XML format.  For
 	 * primary zones, only include the loaded time.  For secondary zones,
@@ -1839,6 +1905,20 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 
 		TRY0(xmlTextWriterEndElement(writer)); /* /nsstat */
 
+		for (int i = 0; i < ns_latency_max; i++) {
+			char type[64];
+
+			snprintf(type, sizeof(type), "latency-%s",
+				 latency_names[i]);
+			TRY0(xmlTextWriterStartElement(writer,
+						       ISC_XMLCHAR "counters"));
+			TRY0(xmlTextWriterWriteAttribute(
+				writer, ISC_XMLCHAR "type", ISC_XMLCHAR type));
+			CHECK(dump_latency(server->sctx->latency[i],
+					   isc_statsformat_xml, writer));
+			TRY0(xmlTextWriterEndElement(writer)); /* /latency */
+		}
+
 		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "counters"));
 		TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
 						 ISC_XMLCHAR "zonestat"));
@@ -2107,6 +2187,11 @@ generatexml(named_server_t *server, uint32_t flags, int *buflen,
 		TRY0(dns_cache_renderxml(view->cache, writer));
 		TRY0(xmlTextWriterEndElement(writer)); /* </cachestats> */
 
+		/* <latency> */
+		TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "latency"));
+		TRY0(dns_resolver_renderxml(view->resolver, writer));
+		TRY0(xmlTextWriterEndElement(writer)); /* </latency> */
+
 		TRY0(xmlTextWriterEndElement(writer)); /* view */
 
 		view = ISC_LIST_NEXT(view, link);
@@ -2359,6 +2444,9 @@ zone_jsonrender(dns_zone_t *zone, void *arg) {
 		return (ISC_R_NOMEMORY);
 	}
 
+	json_object_object_add(zoneobj, "memory",
+			       json_object_new_int64(zone_memoryusage(zone)));
+
 	/*
 	 * Export zone timers to the statistics channel in JSON format.
 	 * For primary zones, only include the loaded time.  For secondary
@@ -2927,6 +3015,29 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 			json_object_put(counters);
 		}
 
+		/* query processing latency, in microseconds */
+		counters = json_object_new_object();
+		CHECKMEM(counters);
+
+		for (int i = 0; i < ns_latency_max; i++) {
+			json_object *stage = json_object_new_object();
+			if (stage == NULL) {
+				json_object_put(counters);
+				result = ISC_R_NOMEMORY;
+				goto cleanup;
+			}
+			json_object_object_add(counters, latency_names[i],
+					       stage);
+			result = dump_latency(server->sctx->latency[i],
+					      isc_statsformat_json, stage);
+			if (result != ISC_R_SUCCESS) {
+				json_object_put(counters);
+				goto cleanup;
+			}
+		}
+
+		json_object_object_add(bindstats, "latency", counters);
+
 		/* zone stat counters */
 		counters = json_object_new_object();
 
@@ -3130,6 +3241,19 @@ generatejson(named_server_t *server, size_t *msglen, const char **msg,
 				json_object_object_add(res, "cachestats",
 						       counters);
 
+				counters = json_object_new_object();
+				CHECKMEM(counters);
+
+				result = dns_resolver_renderjson(view->resolver,
+								 counters);
+				if (result != ISC_R_SUCCESS) {
+					json_object_put(counters);
+					goto cleanup;
+				}
+
+				json_object_object_add(res, "latency",
+						       counters);
+
 				dns_view_getadb(view, &adb);
 				if (adb != NULL) {
 					istats = dns_adb_getstats(adb);
@@ -3472,6 +3596,206 @@ render_json_traffic(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
 
 #endif /* HAVE_JSON_C */
 
+#if defined(EXTENDED_STATS)
+/*
+ * OpenMetrics text exposition. The text is printed straight into a
+ * growing buffer, without building a document tree first.
+ */
+typedef struct {
+	isc_buffer_t *b;
+	const char *family;
+	const char **desc;
+	isc_result_t result;
+} metrics_dumparg_t;
+
+static void
+metrics_counter(isc_statscounter_t counter, uint64_t value, void *arg) {
+	metrics_dumparg_t *dumparg = arg;
+
+	if (dumparg->result != ISC_R_SUCCESS || dumparg->desc[counter] == NULL)
+	{
+		return;
+	}
+
+	dumparg->result = isc_buffer_printf(
+		dumparg->b, "%s_total{counter=\"%s\"} %" PRIu64 "\n",
+		dumparg->family, dumparg->desc[counter], value);
+}
+
+static isc_result_t
+metrics_counters(isc_buffer_t *b, isc_stats_t *stats, const char *family,
+		 const char *help, const char **desc) {
+	metrics_dumparg_t dumparg = {
+		.b = b,
+		.family = family,
+		.desc = desc,
+		.result = ISC_R_SUCCESS,
+	};
+	isc_result_t result;
+
+	if (stats == NULL) {
+		return (ISC_R_SUCCESS);
+	}
+
+	result = isc_buffer_printf(b, "# TYPE %s counter\n# HELP %s %s\n",
+				   family, family, help);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	isc_stats_dump(stats, metrics_counter, &dumparg, ISC_STATSDUMP_VERBOSE);
+
+	return (dumparg.result);
+}
+
+/*
+ * Print the buckets of one labelled histogram. A bucket holding values
+ * up to 'max' has the upper bound ((max + 1) * unit - 1) * scale, and
+ * values from 'overflow' upwards are only counted in the +Inf bucket.
+ */
+static isc_result_t
+metrics_histo(isc_buffer_t *b, isc_histomulti_t *hm, const char *family,
+	      const char *labels, uint64_t unit, uint64_t overflow,
+	      double scale) {
+	isc_result_t result = ISC_R_SUCCESS;
+	isc_histo_t *hg = NULL;
+	uint64_t min, max, count, total = 0;
+
+	isc_histomulti_merge(&hg, hm);
+	for (unsigned int key = 0;
+	     isc_histo_get(hg, key, &min, &max, &count) == ISC_R_SUCCESS;
+	     isc_histo_next(hg, &key))
+	{
+		total += count;
+		if (max >= overflow) {
+			continue;
+		}
+		CHECK(isc_buffer_printf(
+			b, "%s_bucket{%s,le=\"%.9g\"} %" PRIu64 "\n", family,
+			labels, (double)((max + 1) * unit - 1) * scale, total));
+	}
+	CHECK(isc_buffer_printf(b, "%s_bucket{%s,le=\"+Inf\"} %" PRIu64 "\n",
+				family, labels, total));
+	CHECK(isc_buffer_printf(b, "%s_count{%s} %" PRIu64 "\n", family,
+				labels, total));
+
+cleanup:
+	isc_histo_destroy(&hg);
+	return (result);
+}
+
+static isc_result_t
+generatemetrics(named_server_t *server, isc_buffer_t *b) {
+	ns_server_t *sctx = server->sctx;
+	const struct {
+		isc_histomulti_t *in, *out;
+		const char *labels;
+	} traffic[] = {
+		{ sctx->udpinstats4, sctx->udpoutstats4,
+		  "transport=\"udp\",family=\"ipv4\"" },
+		{ sctx->udpinstats6, sctx->udpoutstats6,
+		  "transport=\"udp\",family=\"ipv6\"" },
+		{ sctx->tcpinstats4, sctx->tcpoutstats4,
+		  "transport=\"tcp\",family=\"ipv4\"" },
+		{ sctx->tcpinstats6, sctx->tcpoutstats6,
+		  "transport=\"tcp\",family=\"ipv6\"" },
+	};
+	isc_result_t result;
+	char labels[64];
+
+	CHECK(metrics_counters(b, ns_stats_get(sctx->nsstats), "bind_server",
+			       "Name server statistics.", nsstats_xmldesc));
+	CHECK(metrics_counters(b, server->zonestats, "bind_zone",
+			       "Zone maintenance statistics.",
+			       zonestats_xmldesc));
+	CHECK(metrics_counters(b, server->resolverstats, "bind_resolver",
+			       "Resolver statistics.", resstats_xmldesc));
+	CHECK(metrics_counters(b, server->sockstats, "bind_socket",
+			       "Socket I/O statistics.", sockstats_xmldesc));
+
+	CHECK(isc_buffer_printf(b, "# TYPE bind_request_size_bytes histogram\n"
+				   "# HELP bind_request_size_bytes "
+				   "Sizes of requests received.\n"));
+	for (size_t i = 0; i < ARRAY_SIZE(traffic); i++) {
+		CHECK(metrics_histo(b, traffic[i].in, "bind_request_size_bytes",
+				    traffic[i].labels, DNS_SIZEHISTO_QUANTUM,
+				    DNS_SIZEHISTO_MAXIN, 1.0));
+	}
+
+	CHECK(isc_buffer_printf(b, "# TYPE bind_response_size_bytes histogram\n"
+				   "# HELP bind_response_size_bytes "
+				   "Sizes of responses sent.\n"));
+	for (size_t i = 0; i < ARRAY_SIZE(traffic); i++) {
+		CHECK(metrics_histo(b, traffic[i].out,
+				    "bind_response_size_bytes",
+				    traffic[i].labels, DNS_SIZEHISTO_QUANTUM,
+				    DNS_SIZEHISTO_MAXOUT, 1.0));
+	}
+
+	CHECK(isc_buffer_printf(b, "# TYPE bind_query_latency_seconds "
+				   "histogram\n"
+				   "# HELP bind_query_latency_seconds "
+				   "Time spent in each stage of a query.\n"));
+	for (int i = 0; i < ns_latency_max; i++) {
+		snprintf(labels, sizeof(labels), "stage=\"%s\"",
+			 latency_names[i]);
+		CHECK(metrics_histo(b, sctx->latency[i],
+				    "bind_query_latency_seconds", labels, 1,
+				    UINT64_MAX, 1.0 / US_PER_SEC));
+	}
+
+	CHECK(isc_buffer_printf(b, "# EOF\n"));
+
+cleanup:
+	return (result);
+}
+
+static void
+wrap_buffree(isc_buffer_t *buffer, void *arg) {
+	isc_buffer_t *dbuf = arg;
+
+	UNUSED(buffer);
+
+	isc_buffer_free(&dbuf);
+}
+
+static isc_result_t
+render_metrics(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo,
+	       void *arg, unsigned int *retcode, const char **retmsg,
+	       const char **mimetype, isc_buffer_t *b, isc_httpdfree_t **freecb,
+	       void **freecb_args) {
+	named_server_t *server = arg;
+	isc_buffer_t *dbuf = NULL;
+	unsigned int length;
+	isc_result_t result;
+
+	UNUSED(httpd);
+	UNUSED(urlinfo);
+
+	isc_buffer_allocate(server->mctx, &dbuf, 64 * 1024);
+	result = generatemetrics(server, dbuf);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(named_g_lctx, NAMED_LOGCATEGORY_GENERAL,
+			      NAMED_LOGMODULE_SERVER, ISC_LOG_ERROR,
+			      "failed at rendering metrics");
+		isc_buffer_free(&dbuf);
+		return (result);
+	}
+
+	*retcode = 200;
+	*retmsg = "OK";
+	*mimetype = "application/openmetrics-text; version=1.0.0; "
+		    "charset=utf-8";
+	length = isc_buffer_usedlength(dbuf);
+	isc_buffer_reinit(b, isc_buffer_base(dbuf), length);
+	isc_buffer_add(b, length);
+	*freecb = wrap_buffree;
+	*freecb_args = dbuf;
+
+	return (ISC_R_SUCCESS);
+}
+#endif /* defined(EXTENDED_STATS) */
+
 static isc_result_t
 render_xsl(const isc_httpd_t *httpd, const isc_httpdurl_t *urlinfo, void *args,
 	   unsigned int *retcode, const char **retmsg, const char **mimetype,
@@ -3683,6 +4007,10 @@ add_listener(named_server_t *server, named_statschannel_t **listenerp,
 			    "/json/v" STATS_JSON_VERSION_MAJOR "/traffic",
 			    false, render_json_traffic, server);
 #endif /* ifdef HAVE_JSON_C */
+#if defined(EXTENDED_STATS)
+	isc_httpdmgr_addurl(listener->httpdmgr, "/metrics", false,
+			    render_metrics, server);
+#endif /* if defined(EXTENDED_STATS) */
 	isc_httpdmgr_addurl(listener->httpdmgr, "/bind9.xsl", true, render_xsl,
 			    server);
 
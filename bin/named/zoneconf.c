@@ -1306,6 +1306,19 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		dns_zone_setoption(zone, DNS_ZONEOPT_NOTIFYTOSOA,
 				   cfg_obj_asboolean(obj));
 
+		obj = NULL;
+		result = named_config_get(maps, "cache-rendered-answers",
+					  &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_CACHERENDERED,
+				   cfg_obj_asboolean(obj));
+
+		obj = NULL;
+		result = named_config_get(maps, "update-group-commit", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_UPDGROUPCOMMIT,
+				   cfg_obj_asboolean(obj));
+
 		dns_zone_setisself(zone, isself, NULL);
 
 		CHECK(configure_zone_acl(
@@ -1437,6 +1450,11 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
 		dns_zone_setnotifydelay(zone, cfg_obj_asuint32(obj));
 
+		obj = NULL;
+		result = named_config_get(maps, "trie-replicas", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_settriereplicas(zone, cfg_obj_asuint32(obj));
+
 		obj = NULL;
 		result = named_config_get(maps, "check-sibling", &obj);
 		INSIST(result == ISC_R_SUCCESS && obj != NULL);
@@ -1762,6 +1780,23 @@ named_zone_configure(const cfg_obj_t *config, const cfg_obj_t *vconfig,
 			dns_zone_setserialupdatemethod(
 				zone, dns_updatemethod_increment);
 		}
+
+		/*
+		 * Inline-signing zones keep a signed copy that cannot
+		 * be thrown away and rebuilt cheaply, so they are
+		 * always loaded.
+		 */
+		obj = NULL;
+		result = named_config_get(maps, "load-on-demand", &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setoption(zone, DNS_ZONEOPT_LOADONDEMAND,
+				   cfg_obj_asboolean(obj) && raw == NULL);
+
+		obj = NULL;
+		result = named_config_get(maps, "load-on-demand-idle-time",
+					  &obj);
+		INSIST(result == ISC_R_SUCCESS && obj != NULL);
+		dns_zone_setidletime(zone, cfg_obj_asduration(obj));
 	}
 
 	/*
@@ -0,0 +1,1080 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+/* aliases for the exported symbols */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/async.h>
+#include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
+#include <isc/list.h>
+#include <isc/log.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/netmgr.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/stdtime.h>
+#include <isc/tid.h>
+#include <isc/types.h>
+#include <isc/util.h>
+
+#include <dns/name.h>
+#include <dns/rdatatype.h>
+#include <dns/types.h>
+
+#include <isccfg/cfg.h>
+#include <isccfg/grammar.h>
+
+#include <ns/client.h>
+#include <ns/hooks.h>
+#include <ns/log.h>
+#include <ns/query.h>
+#include <ns/types.h>
+
+#define CHECK(op)                              \
+	do {                                   \
+		result = (op);                 \
+		if (result != ISC_R_SUCCESS) { \
+			goto cleanup;          \
+		}                              \
+	} while (0)
+
+/*
+ * Defaults for the module parameters.
+ */
+#define DEFAULT_TIMEOUT	   500 /* milliseconds */
+#define DEFAULT_BATCHSIZE  32
+#define DEFAULT_CACHETTL   60 /* seconds */
+#define DEFAULT_CACHESIZE  10000
+#define MAX_BATCHSIZE	   256
+#define MAX_REQUESTSIZE	   (32 * 1024)
+#define CACHE_HASHMAP_BITS 12
+
+/*
+ * What to do with a query, as decided by the policy service.
+ */
+typedef enum {
+	POLICY_ALLOW = 0,
+	POLICY_REFUSE = 1,
+	POLICY_DROP = 2,
+} policy_verdict_t;
+
+typedef struct policy_instance policy_instance_t;
+typedef struct policy_loop policy_loop_t;
+typedef struct policy_item policy_item_t;
+typedef struct policy_batch policy_batch_t;
+typedef struct policy_cached policy_cached_t;
+
+/*
+ * Persistent data for use by this module. This will be stored with
+ * the client object (see ns_client_sethookdata()), and will remain
+ * accessible until the client object is detached.
+ */
+typedef struct policy_state {
+	bool decided;
+	policy_verdict_t verdict;
+} policy_state_t;
+
+/*
+ * A query waiting for a verdict.  'key' is both the line sent to the
+ * policy service and the key of the verdict in the cache.
+ */
+struct policy_item {
+	ISC_LINK(policy_item_t) link;
+	policy_loop_t *pl;
+	policy_state_t *state;
+	ns_hook_resume_t *rev;
+	size_t keylen;
+	char key[];
+};
+
+/*
+ * One request to the policy service, carrying the queries of one
+ * loop that were waiting when it was sent.
+ */
+struct policy_batch {
+	policy_loop_t *pl;
+	isc_nmhandle_t *handle;
+	unsigned int references;
+	uint32_t id;
+	isc_result_t result;
+	ISC_LIST(policy_item_t) items;
+	size_t nitems;
+	policy_verdict_t *verdicts;
+	uint32_t *ttls;
+	isc_buffer_t *request;
+};
+
+/*
+ * A cached verdict.
+ */
+struct policy_cached {
+	ISC_LINK(policy_cached_t) link;
+	isc_stdtime_t expire;
+	policy_verdict_t verdict;
+	size_t keylen;
+	char key[];
+};
+
+/*
+ * Per-loop state.  It is only ever used from its own loop, so none of
+ * it is locked.
+ */
+struct policy_loop {
+	policy_instance_t *inst;
+	isc_nm_t *netmgr;
+	ISC_LIST(policy_item_t) pending;
+	bool flushing;
+	uint32_t nextid;
+
+	isc_hashmap_t *cache;
+	ISC_LIST(policy_cached_t) lru;
+	size_t ncached;
+};
+
+struct policy_instance {
+	ns_plugin_t *module;
+	isc_mem_t *mctx;
+
+	/*
+	 * Values configured when the module is loaded.
+	 */
+	isc_sockaddr_t server;
+	uint32_t timeout;
+	uint32_t batchsize;
+	uint32_t cachettl;
+	uint32_t cachesize;
+	policy_verdict_t onfailure;
+
+	uint32_t nloops;
+	policy_loop_t *loops;
+};
+
+/*
+ * Forward declarations of functions referenced in install_hooks().
+ */
+static ns_hookresult_t
+policy_qctx_initialize(void *arg, void *cbdata, isc_result_t *resp);
+static ns_hookresult_t
+policy_start_begin(void *arg, void *cbdata, isc_result_t *resp);
+static ns_hookresult_t
+policy_qctx_destroy(void *arg, void *cbdata, isc_result_t *resp);
+
+/*%
+ * Register the functions to be called at each hook point in 'hooktable', using
+ * memory context 'mctx' for allocating copies of stack-allocated structures
+ * passed to ns_hook_add().  Make sure 'inst' will be passed as the 'cbdata'
+ * argument to every callback.
+ */
+static void
+install_hooks(ns_hooktable_t *hooktable, isc_mem_t *mctx,
+	      policy_instance_t *inst) {
+	const ns_hook_t policy_init = {
+		.action = policy_qctx_initialize,
+		.action_data = inst,
+	};
+
+	const ns_hook_t policy_start = {
+		.action = policy_start_begin,
+		.action_data = inst,
+	};
+
+	const ns_hook_t policy_destroy = {
+		.action = policy_qctx_destroy,
+		.action_data = inst,
+	};
+
+	ns_hook_add(hooktable, mctx, NS_QUERY_QCTX_INITIALIZED, &policy_init);
+	ns_hook_add(hooktable, mctx, NS_QUERY_START_BEGIN, &policy_start);
+	ns_hook_add(hooktable, mctx, NS_QUERY_QCTX_DESTROYED,
+		    &policy_destroy);
+}
+
+/**
+** Support for parsing of parameters and configuration of the module.
+**/
+
+static const char *verdict_enums[] = { "allow", "refuse", "drop", NULL };
+
+static cfg_type_t cfg_type_verdict = {
+	"verdict",    cfg_parse_enum,  cfg_print_ustring,
+	cfg_doc_enum, &cfg_rep_string, verdict_enums,
+};
+
+static cfg_clausedef_t param_clauses[] = {
+	{ "batch-size", &cfg_type_uint32, 0 },
+	{ "cache-size", &cfg_type_uint32, 0 },
+	{ "cache-ttl", &cfg_type_uint32, 0 },
+	{ "policy-failure", &cfg_type_verdict, 0 },
+	{ "policy-server", &cfg_type_sockaddr, 0 },
+	{ "policy-timeout", &cfg_type_uint32, 0 },
+	{ NULL, NULL, 0 },
+};
+
+static cfg_clausedef_t *param_clausesets[] = { param_clauses, NULL };
+
+static cfg_type_t cfg_type_parameters = {
+	"external-policy-params", cfg_parse_mapbody, cfg_print_mapbody,
+	cfg_doc_mapbody,	  &cfg_rep_map,	     param_clausesets
+};
+
+static policy_verdict_t
+verdict_fromtext(const char *str) {
+	if (strcasecmp(str, "refuse") == 0) {
+		return (POLICY_REFUSE);
+	} else if (strcasecmp(str, "drop") == 0) {
+		return (POLICY_DROP);
+	}
+	return (POLICY_ALLOW);
+}
+
+static isc_result_t
+check_syntax(cfg_obj_t *fmap, isc_log_t *lctx) {
+	const cfg_obj_t *obj = NULL;
+
+	cfg_map_get(fmap, "policy-server", &obj);
+	if (obj == NULL) {
+		cfg_obj_log(fmap, lctx, ISC_LOG_ERROR,
+			    "\"policy-server\" must be set");
+		return (ISC_R_FAILURE);
+	}
+	if (isc_sockaddr_getport(cfg_obj_assockaddr(obj)) == 0) {
+		cfg_obj_log(obj, lctx, ISC_LOG_ERROR,
+			    "\"policy-server\" requires a port");
+		return (ISC_R_FAILURE);
+	}
+
+	obj = NULL;
+	cfg_map_get(fmap, "batch-size", &obj);
+	if (obj != NULL && (cfg_obj_asuint32(obj) == 0 ||
+			    cfg_obj_asuint32(obj) > MAX_BATCHSIZE))
+	{
+		cfg_obj_log(obj, lctx, ISC_LOG_ERROR,
+			    "\"batch-size\" must be between 1 and %u",
+			    MAX_BATCHSIZE);
+		return (ISC_R_RANGE);
+	}
+
+	obj = NULL;
+	cfg_map_get(fmap, "policy-timeout", &obj);
+	if (obj != NULL && cfg_obj_asuint32(obj) == 0) {
+		cfg_obj_log(obj, lctx, ISC_LOG_ERROR,
+			    "\"policy-timeout\" must not be 0");
+		return (ISC_R_RANGE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static uint32_t
+get_uint32(const cfg_obj_t *param_obj, const char *name, uint32_t dflt) {
+	const cfg_obj_t *obj = NULL;
+
+	if (cfg_map_get(param_obj, name, &obj) != ISC_R_SUCCESS) {
+		return (dflt);
+	}
+	return (cfg_obj_asuint32(obj));
+}
+
+static isc_result_t
+parse_parameters(policy_instance_t *inst, const char *parameters,
+		 const char *cfg_file, unsigned long cfg_line, isc_mem_t *mctx,
+		 isc_log_t *lctx) {
+	isc_result_t result = ISC_R_SUCCESS;
+	cfg_parser_t *parser = NULL;
+	cfg_obj_t *param_obj = NULL;
+	const cfg_obj_t *obj = NULL;
+	isc_buffer_t b;
+
+	CHECK(cfg_parser_create(mctx, lctx, &parser));
+
+	isc_buffer_constinit(&b, parameters, strlen(parameters));
+	isc_buffer_add(&b, strlen(parameters));
+	CHECK(cfg_parse_buffer(parser, &b, cfg_file, cfg_line,
+			       &cfg_type_parameters, 0, &param_obj));
+
+	CHECK(check_syntax(param_obj, lctx));
+
+	result = cfg_map_get(param_obj, "policy-server", &obj);
+	INSIST(result == ISC_R_SUCCESS);
+	inst->server = *cfg_obj_assockaddr(obj);
+
+	inst->timeout = get_uint32(param_obj, "policy-timeout",
+				   DEFAULT_TIMEOUT);
+	inst->batchsize = get_uint32(param_obj, "batch-size",
+				     DEFAULT_BATCHSIZE);
+	inst->cachettl = get_uint32(param_obj, "cache-ttl", DEFAULT_CACHETTL);
+	inst->cachesize = get_uint32(param_obj, "cache-size",
+				     DEFAULT_CACHESIZE);
+
+	obj = NULL;
+	if (cfg_map_get(param_obj, "policy-failure", &obj) == ISC_R_SUCCESS) {
+		inst->onfailure = verdict_fromtext(cfg_obj_asstring(obj));
+	}
+
+cleanup:
+	if (param_obj != NULL) {
+		cfg_obj_destroy(parser, &param_obj);
+	}
+	if (parser != NULL) {
+		cfg_parser_destroy(&parser);
+	}
+	return (result);
+}
+
+/**
+** Mandatory plugin API functions:
+**
+** - plugin_destroy
+** - plugin_register
+** - plugin_version
+** - plugin_check
+**/
+
+/*
+ * Called by ns_plugin_register() to initialize the plugin and
+ * register hook functions into the view hook table.
+ */
+isc_result_t
+plugin_register(const char *parameters, const void *cfg, const char *cfg_file,
+		unsigned long cfg_line, isc_mem_t *mctx, isc_log_t *lctx,
+		void *actx, ns_hooktable_t *hooktable, void **instp) {
+	policy_instance_t *inst = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	UNUSED(cfg);
+	UNUSED(actx);
+
+	isc_log_write(lctx, NS_LOGCATEGORY_GENERAL, NS_LOGMODULE_HOOKS,
+		      ISC_LOG_INFO,
+		      "registering 'external-policy' "
+		      "module from %s:%lu, %s parameters",
+		      cfg_file, cfg_line, parameters != NULL ? "with" : "no");
+
+	if (parameters == NULL) {
+		isc_log_write(lctx, NS_LOGCATEGORY_GENERAL, NS_LOGMODULE_HOOKS,
+			      ISC_LOG_ERROR,
+			      "'external-policy' module requires parameters");
+		return (ISC_R_FAILURE);
+	}
+
+	inst = isc_mem_get(mctx, sizeof(*inst));
+	*inst = (policy_instance_t){
+		.onfailure = POLICY_ALLOW,
+		.nloops = isc_tid_count(),
+	};
+	isc_mem_attach(mctx, &inst->mctx);
+
+	inst->loops = isc_mem_cget(mctx, inst->nloops, sizeof(inst->loops[0]));
+	for (size_t i = 0; i < inst->nloops; i++) {
+		policy_loop_t *pl = &inst->loops[i];
+
+		*pl = (policy_loop_t){
+			.inst = inst,
+			.pending = ISC_LIST_INITIALIZER,
+			.lru = ISC_LIST_INITIALIZER,
+		};
+		isc_hashmap_create(mctx, CACHE_HASHMAP_BITS, &pl->cache);
+	}
+
+	CHECK(parse_parameters(inst, parameters, cfg_file, cfg_line, mctx,
+			       lctx));
+
+	/*
+	 * Set hook points in the view's hooktable.
+	 */
+	install_hooks(hooktable, mctx, inst);
+
+	*instp = inst;
+
+cleanup:
+	if (result != ISC_R_SUCCESS) {
+		plugin_destroy((void **)&inst);
+	}
+
+	return (result);
+}
+
+isc_result_t
+plugin_check(const char *parameters, const void *cfg, const char *cfg_file,
+	     unsigned long cfg_line, isc_mem_t *mctx, isc_log_t *lctx,
+	     void *actx) {
+	isc_result_t result = ISC_R_SUCCESS;
+	cfg_parser_t *parser = NULL;
+	cfg_obj_t *param_obj = NULL;
+	isc_buffer_t b;
+
+	UNUSED(cfg);
+	UNUSED(actx);
+
+	if (parameters == NULL) {
+		isc_log_write(lctx, NS_LOGCATEGORY_GENERAL, NS_LOGMODULE_HOOKS,
+			      ISC_LOG_ERROR,
+			      "'external-policy' module requires parameters");
+		return (ISC_R_FAILURE);
+	}
+
+	CHECK(cfg_parser_create(mctx, lctx, &parser));
+
+	isc_buffer_constinit(&b, parameters, strlen(parameters));
+	isc_buffer_add(&b, strlen(parameters));
+	CHECK(cfg_parse_buffer(parser, &b, cfg_file, cfg_line,
+			       &cfg_type_parameters, 0, &param_obj));
+
+	CHECK(check_syntax(param_obj, lctx));
+
+cleanup:
+	if (param_obj != NULL) {
+		cfg_obj_destroy(parser, &param_obj);
+	}
+	if (parser != NULL) {
+		cfg_parser_destroy(&parser);
+	}
+	return (result);
+}
+
+/*
+ * Called by ns_plugins_free(); frees memory allocated by
+ * the module when it was registered.
+ */
+void
+plugin_destroy(void **instp) {
+	policy_instance_t *inst = (policy_instance_t *)*instp;
+
+	for (size_t i = 0; i < inst->nloops; i++) {
+		policy_loop_t *pl = &inst->loops[i];
+		policy_cached_t *entry = NULL, *next = NULL;
+
+		INSIST(ISC_LIST_EMPTY(pl->pending));
+
+		for (entry = ISC_LIST_HEAD(pl->lru); entry != NULL;
+		     entry = next)
+		{
+			next = ISC_LIST_NEXT(entry, link);
+			isc_mem_put(inst->mctx, entry,
+				    sizeof(*entry) + entry->keylen + 1);
+		}
+		isc_hashmap_destroy(&pl->cache);
+	}
+	isc_mem_cput(inst->mctx, inst->loops, inst->nloops,
+		     sizeof(inst->loops[0]));
+
+	isc_mem_putanddetach(&inst->mctx, inst, sizeof(*inst));
+	*instp = NULL;
+
+	return;
+}
+
+/*
+ * Returns plugin API version for compatibility checks.
+ */
+int
+plugin_version(void) {
+	return (NS_PLUGIN_VERSION);
+}
+
+/**
+** "external-policy" feature implementation begins here.
+**/
+
+static void
+logmsg(int level, const char *fmt, ...) ISC_FORMAT_PRINTF(2, 3);
+
+static void
+logmsg(int level, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	isc_log_vwrite(ns_lctx, NS_LOGCATEGORY_GENERAL, NS_LOGMODULE_HOOKS,
+		       level, fmt, ap);
+	va_end(ap);
+}
+
+/*
+ * Verdict cache.  Each loop keeps its own, bounded by 'cache-size'
+ * entries; the least recently used entry is evicted first.
+ */
+static bool
+cache_match(void *node, const void *key) {
+	const policy_cached_t *entry = node;
+
+	return (strcasecmp(entry->key, key) == 0);
+}
+
+static uint32_t
+cache_hash(const char *key, size_t keylen) {
+	return (isc_hash32(key, keylen, false));
+}
+
+static void
+cache_remove(policy_loop_t *pl, policy_cached_t *entry) {
+	isc_result_t result;
+
+	result = isc_hashmap_delete(pl->cache,
+				    cache_hash(entry->key, entry->keylen),
+				    cache_match, entry->key);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_UNLINK(pl->lru, entry, link);
+	pl->ncached--;
+	isc_mem_put(pl->inst->mctx, entry, sizeof(*entry) + entry->keylen + 1);
+}
+
+static bool
+cache_find(policy_loop_t *pl, const char *key, size_t keylen,
+	   policy_verdict_t *verdictp) {
+	policy_cached_t *entry = NULL;
+	isc_result_t result;
+
+	result = isc_hashmap_find(pl->cache, cache_hash(key, keylen),
+				  cache_match, key, (void **)&entry);
+	if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+
+	if (entry->expire <= isc_stdtime_now()) {
+		cache_remove(pl, entry);
+		return (false);
+	}
+
+	ISC_LIST_UNLINK(pl->lru, entry, link);
+	ISC_LIST_PREPEND(pl->lru, entry, link);
+	*verdictp = entry->verdict;
+	return (true);
+}
+
+static void
+cache_add(policy_loop_t *pl, const char *key, size_t keylen,
+	  policy_verdict_t verdict, uint32_t ttl) {
+	policy_instance_t *inst = pl->inst;
+	policy_cached_t *entry = NULL, *found = NULL;
+	isc_result_t result;
+
+	if (ttl == 0 || inst->cachesize == 0) {
+		return;
+	}
+
+	result = isc_hashmap_find(pl->cache, cache_hash(key, keylen),
+				  cache_match, key, (void **)&found);
+	if (result == ISC_R_SUCCESS) {
+		cache_remove(pl, found);
+	}
+
+	while (pl->ncached >= inst->cachesize) {
+		cache_remove(pl, ISC_LIST_TAIL(pl->lru));
+	}
+
+	entry = isc_mem_get(inst->mctx, sizeof(*entry) + keylen + 1);
+	*entry = (policy_cached_t){
+		.link = ISC_LINK_INITIALIZER,
+		.expire = isc_stdtime_now() + ttl,
+		.verdict = verdict,
+		.keylen = keylen,
+	};
+	memmove(entry->key, key, keylen + 1);
+
+	result = isc_hashmap_add(pl->cache, cache_hash(key, keylen),
+				 cache_match, entry->key, entry, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_PREPEND(pl->lru, entry, link);
+	pl->ncached++;
+}
+
+/*
+ * Batches.  Queries that need a verdict are queued on their loop;
+ * the queue is flushed from an asynchronous job on the same loop,
+ * so every query that arrived while the loop was busy is sent to the
+ * policy service in the same request.
+ *
+ * The request is a single UDP datagram: a line with the batch ID,
+ * followed by one line per query holding the client address, the
+ * query name and the query type.  The response repeats the batch ID
+ * and then has one line per query, in the same order, holding the
+ * verdict ("allow", "refuse" or "drop") optionally followed by the
+ * number of seconds the verdict may be cached for.
+ */
+static void
+batch_parse(policy_batch_t *batch, isc_region_t *region) {
+	policy_instance_t *inst = batch->pl->inst;
+	char *text = NULL, *line = NULL, *next = NULL, *end = NULL;
+	size_t i = 0;
+
+	batch->result = ISC_R_UNEXPECTEDEND;
+
+	text = isc_mem_get(inst->mctx, region->length + 1);
+	memmove(text, region->base, region->length);
+	text[region->length] = '\0';
+
+	line = text;
+	next = strchr(line, '\n');
+	if (next == NULL) {
+		goto cleanup;
+	}
+	*next++ = '\0';
+	if (strtoul(line, &end, 10) != batch->id || *end != '\0') {
+		batch->result = ISC_R_BADNUMBER;
+		goto cleanup;
+	}
+
+	for (i = 0; i < batch->nitems; i++) {
+		char *verdict = NULL, *ttl = NULL, *last = NULL;
+
+		line = next;
+		next = strchr(line, '\n');
+		if (next == NULL) {
+			goto cleanup;
+		}
+		*next++ = '\0';
+
+		verdict = strtok_r(line, " \t", &last);
+		if (verdict == NULL) {
+			batch->result = ISC_R_UNEXPECTEDTOKEN;
+			goto cleanup;
+		}
+		if (strcasecmp(verdict, "allow") == 0) {
+			batch->verdicts[i] = POLICY_ALLOW;
+		} else if (strcasecmp(verdict, "refuse") == 0) {
+			batch->verdicts[i] = POLICY_REFUSE;
+		} else if (strcasecmp(verdict, "drop") == 0) {
+			batch->verdicts[i] = POLICY_DROP;
+		} else {
+			batch->result = ISC_R_UNEXPECTEDTOKEN;
+			goto cleanup;
+		}
+
+		batch->ttls[i] = inst->cachettl;
+		ttl = strtok_r(NULL, " \t", &last);
+		if (ttl != NULL) {
+			batch->ttls[i] = strtoul(ttl, &end, 10);
+			if (*end != '\0') {
+				batch->result = ISC_R_BADNUMBER;
+				goto cleanup;
+			}
+		}
+	}
+
+	batch->result = ISC_R_SUCCESS;
+
+cleanup:
+	isc_mem_put(inst->mctx, text, region->length + 1);
+}
+
+static void
+batch_done(policy_batch_t *batch) {
+	policy_loop_t *pl = batch->pl;
+	policy_instance_t *inst = pl->inst;
+	policy_item_t *item = NULL;
+	size_t i = 0;
+
+	if (batch->handle != NULL) {
+		isc_nmhandle_detach(&batch->handle);
+	}
+
+	if (batch->result != ISC_R_SUCCESS) {
+		logmsg(ISC_LOG_DEBUG(1),
+		       "external-policy: batch %" PRIu32 " of %zu queries "
+		       "failed: %s",
+		       batch->id, batch->nitems,
+		       isc_result_totext(batch->result));
+	}
+
+	while ((item = ISC_LIST_HEAD(batch->items)) != NULL) {
+		ISC_LIST_UNLINK(batch->items, item, link);
+
+		if (batch->result == ISC_R_SUCCESS) {
+			item->state->verdict = batch->verdicts[i];
+			cache_add(pl, item->key, item->keylen,
+				  batch->verdicts[i], batch->ttls[i]);
+		} else {
+			item->state->verdict = inst->onfailure;
+		}
+		item->state->decided = true;
+		i++;
+
+		isc_async_run(item->rev->loop, item->rev->cb, item->rev);
+		isc_mem_put(inst->mctx, item, sizeof(*item) + item->keylen + 1);
+	}
+
+	isc_buffer_free(&batch->request);
+	isc_mem_cput(inst->mctx, batch->verdicts, batch->nitems,
+		     sizeof(batch->verdicts[0]));
+	isc_mem_cput(inst->mctx, batch->ttls, batch->nitems,
+		     sizeof(batch->ttls[0]));
+	isc_mem_put(inst->mctx, batch, sizeof(*batch));
+}
+
+/*
+ * A batch is finished once both the send and the read callbacks have
+ * run, so that no callback can be pending when the queries resume.
+ */
+static void
+batch_detach(policy_batch_t *batch) {
+	INSIST(batch->references > 0);
+	if (--batch->references == 0) {
+		batch_done(batch);
+	}
+}
+
+static void
+batch_read(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	   void *arg) {
+	policy_batch_t *batch = arg;
+
+	UNUSED(handle);
+
+	if (eresult == ISC_R_SUCCESS) {
+		batch_parse(batch, region);
+	} else {
+		batch->result = eresult;
+	}
+
+	batch_detach(batch);
+}
+
+static void
+batch_sent(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	policy_batch_t *batch = arg;
+
+	UNUSED(handle);
+
+	if (eresult != ISC_R_SUCCESS) {
+		logmsg(ISC_LOG_DEBUG(1),
+		       "external-policy: sending batch %" PRIu32 ": %s",
+		       batch->id, isc_result_totext(eresult));
+	}
+
+	batch_detach(batch);
+}
+
+static void
+batch_connected(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
+	policy_batch_t *batch = arg;
+	isc_region_t r;
+
+	if (eresult != ISC_R_SUCCESS) {
+		batch->result = eresult;
+		batch_done(batch);
+		return;
+	}
+
+	isc_nmhandle_attach(handle, &batch->handle);
+	batch->references = 2;
+
+	isc_buffer_usedregion(batch->request, &r);
+	isc_nm_read(handle, batch_read, batch);
+	isc_nm_send(handle, &r, batch_sent, batch);
+}
+
+static void
+batch_send(policy_loop_t *pl) {
+	policy_instance_t *inst = pl->inst;
+	policy_batch_t *batch = NULL;
+	policy_item_t *item = NULL;
+	isc_sockaddr_t local;
+	char idbuf[sizeof("4294967295\n")];
+
+	batch = isc_mem_get(inst->mctx, sizeof(*batch));
+	*batch = (policy_batch_t){
+		.pl = pl,
+		.id = pl->nextid++,
+		.result = ISC_R_UNSET,
+		.items = ISC_LIST_INITIALIZER,
+	};
+
+	isc_buffer_allocate(inst->mctx, &batch->request, MAX_REQUESTSIZE);
+	snprintf(idbuf, sizeof(idbuf), "%" PRIu32 "\n", batch->id);
+	isc_buffer_putstr(batch->request, idbuf);
+
+	while ((item = ISC_LIST_HEAD(pl->pending)) != NULL &&
+	       batch->nitems < inst->batchsize &&
+	       isc_buffer_availablelength(batch->request) > item->keylen)
+	{
+		ISC_LIST_UNLINK(pl->pending, item, link);
+		ISC_LIST_APPEND(batch->items, item, link);
+		isc_buffer_putmem(batch->request, (unsigned char *)item->key,
+				  item->keylen);
+		isc_buffer_putuint8(batch->request, '\n');
+		batch->nitems++;
+	}
+	INSIST(batch->nitems > 0);
+
+	batch->verdicts = isc_mem_cget(inst->mctx, batch->nitems,
+				       sizeof(batch->verdicts[0]));
+	batch->ttls = isc_mem_cget(inst->mctx, batch->nitems,
+				   sizeof(batch->ttls[0]));
+
+	isc_sockaddr_anyofpf(&local, isc_sockaddr_pf(&inst->server));
+	isc_nm_udpconnect(pl->netmgr, &local, &inst->server, batch_connected,
+			  batch, inst->timeout);
+}
+
+static void
+policy_flush(void *arg) {
+	policy_loop_t *pl = arg;
+
+	pl->flushing = false;
+	while (!ISC_LIST_EMPTY(pl->pending)) {
+		batch_send(pl);
+	}
+}
+
+/*
+ * Asynchronous hook processing, as described in <ns/hooks.h>.  The
+ * queued item owns the resume event; batch_done() sends it back to
+ * the client's loop once the verdict is known or the batch failed.
+ * A canceled query still waits for its batch, which always ends
+ * within 'policy-timeout'.
+ */
+static void
+cancelasync(ns_hookasync_t *hctx) {
+	UNUSED(hctx);
+}
+
+static void
+destroyasync(ns_hookasync_t **ctxp) {
+	ns_hookasync_t *ctx = *ctxp;
+
+	*ctxp = NULL;
+	isc_mem_putanddetach(&ctx->mctx, ctx, sizeof(*ctx));
+}
+
+static isc_result_t
+doasync(query_ctx_t *qctx, isc_mem_t *mctx, void *arg, isc_loop_t *loop,
+	isc_job_cb cb, void *evarg, ns_hookasync_t **ctxp) {
+	policy_item_t *item = arg;
+	policy_loop_t *pl = item->pl;
+	ns_hook_resume_t *rev = isc_mem_get(mctx, sizeof(*rev));
+	ns_hookasync_t *ctx = isc_mem_get(mctx, sizeof(*ctx));
+
+	*ctx = (ns_hookasync_t){
+		.cancel = cancelasync,
+		.destroy = destroyasync,
+	};
+	isc_mem_attach(mctx, &ctx->mctx);
+
+	*rev = (ns_hook_resume_t){
+		.hookpoint = NS_QUERY_START_BEGIN,
+		.origresult = ISC_R_UNSET,
+		.saved_qctx = qctx,
+		.ctx = ctx,
+		.loop = loop,
+		.cb = cb,
+		.arg = evarg,
+	};
+	item->rev = rev;
+
+	ISC_LIST_APPEND(pl->pending, item, link);
+	if (!pl->flushing) {
+		pl->flushing = true;
+		isc_async_run(loop, policy_flush, pl);
+	}
+
+	*ctxp = ctx;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Per-client state, created when the query context is initialized.
+ */
+static policy_state_t *
+client_state_get(const query_ctx_t *qctx, policy_instance_t *inst) {
+	return (ns_client_gethookdata(qctx->client, inst));
+}
+
+static void
+client_state_free(const void *key, void *data) {
+	policy_instance_t *inst = UNCONST(key);
+
+	isc_mem_put(inst->mctx, data, sizeof(policy_state_t));
+}
+
+static void
+client_state_create(const query_ctx_t *qctx, policy_instance_t *inst) {
+	policy_state_t *state = NULL;
+	isc_result_t result;
+
+	state = isc_mem_get(inst->mctx, sizeof(*state));
+	*state = (policy_state_t){ .decided = false };
+
+	result = ns_client_sethookdata(qctx->client, inst, state,
+				       client_state_free);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+}
+
+static void
+client_state_destroy(const query_ctx_t *qctx, policy_instance_t *inst) {
+	policy_state_t *state = client_state_get(qctx, inst);
+	isc_result_t result;
+
+	if (state == NULL) {
+		return;
+	}
+
+	result = ns_client_sethookdata(qctx->client, inst, NULL, NULL);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+	isc_mem_put(inst->mctx, state, sizeof(*state));
+}
+
+/*
+ * Build the line describing this query: client address, query name
+ * and query type.
+ */
+static policy_item_t *
+item_create(query_ctx_t *qctx, policy_instance_t *inst) {
+	ns_client_t *client = qctx->client;
+	char addrbuf[ISC_NETADDR_FORMATSIZE];
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+	policy_item_t *item = NULL;
+	isc_netaddr_t netaddr;
+	size_t keylen;
+
+	isc_netaddr_fromsockaddr(&netaddr, &client->peeraddr);
+	isc_netaddr_format(&netaddr, addrbuf, sizeof(addrbuf));
+	dns_name_format(client->query.qname, namebuf, sizeof(namebuf));
+	dns_rdatatype_format(qctx->qtype, typebuf, sizeof(typebuf));
+
+	keylen = strlen(addrbuf) + strlen(namebuf) + strlen(typebuf) + 2;
+	item = isc_mem_get(inst->mctx, sizeof(*item) + keylen + 1);
+	*item = (policy_item_t){
+		.link = ISC_LINK_INITIALIZER,
+		.pl = &inst->loops[isc_tid()],
+		.keylen = keylen,
+	};
+	snprintf(item->key, keylen + 1, "%s %s %s", addrbuf, namebuf,
+		 typebuf);
+
+	return (item);
+}
+
+/*
+ * Apply a verdict to the query: either let it continue, or end it
+ * with REFUSED or with no response at all.
+ */
+static ns_hookresult_t
+apply_verdict(query_ctx_t *qctx, policy_verdict_t verdict,
+	      isc_result_t *resp) {
+	switch (verdict) {
+	case POLICY_ALLOW:
+		return (NS_HOOK_CONTINUE);
+	case POLICY_REFUSE:
+		qctx->result = DNS_R_REFUSED;
+		break;
+	case POLICY_DROP:
+		qctx->result = DNS_R_DROP;
+		break;
+	default:
+		UNREACHABLE();
+	}
+
+	qctx->want_restart = false;
+	qctx->line = __LINE__;
+	*resp = ns_query_done(qctx);
+	return (NS_HOOK_RETURN);
+}
+
+/*
+ * Initialize hook data in the query context, fetching from a memory
+ * pool if necessary.
+ */
+static ns_hookresult_t
+policy_qctx_initialize(void *arg, void *cbdata, isc_result_t *resp) {
+	query_ctx_t *qctx = (query_ctx_t *)arg;
+	policy_instance_t *inst = (policy_instance_t *)cbdata;
+
+	*resp = ISC_R_UNSET;
+
+	if (client_state_get(qctx, inst) == NULL) {
+		client_state_create(qctx, inst);
+	}
+
+	return (NS_HOOK_CONTINUE);
+}
+
+/*
+ * Ask for a verdict before any work is done on the query.  A cached
+ * verdict is applied at once; otherwise the query is suspended until
+ * its batch is answered, and this hook is called again on resumption.
+ */
+static ns_hookresult_t
+policy_start_begin(void *arg, void *cbdata, isc_result_t *resp) {
+	query_ctx_t *qctx = (query_ctx_t *)arg;
+	policy_instance_t *inst = (policy_instance_t *)cbdata;
+	policy_state_t *state = client_state_get(qctx, inst);
+	policy_item_t *item = NULL;
+	policy_verdict_t verdict;
+	isc_result_t result;
+
+	*resp = ISC_R_UNSET;
+
+	if (state == NULL || qctx->client->query.restarts > 0) {
+		return (NS_HOOK_CONTINUE);
+	}
+
+	if (state->decided) {
+		/* resuming */
+		return (apply_verdict(qctx, state->verdict, resp));
+	}
+
+	item = item_create(qctx, inst);
+	if (cache_find(item->pl, item->key, item->keylen, &verdict)) {
+		isc_mem_put(inst->mctx, item, sizeof(*item) + item->keylen + 1);
+		state->decided = true;
+		state->verdict = verdict;
+		return (apply_verdict(qctx, verdict, resp));
+	}
+
+	if (item->pl->netmgr == NULL) {
+		item->pl->netmgr = isc_nmhandle_netmgr(qctx->client->handle);
+	}
+	item->state = state;
+
+	result = ns_query_hookasync(qctx, doasync, item);
+	if (result != ISC_R_SUCCESS) {
+		/*
+		 * The query has already been answered with SERVFAIL.
+		 */
+		isc_mem_put(inst->mctx, item, sizeof(*item) + item->keylen + 1);
+	}
+
+	*resp = result;
+	return (NS_HOOK_RETURN);
+}
+
+/*
+ * Free hook data when the client is detached.
+ */
+static ns_hookresult_t
+policy_qctx_destroy(void *arg, void *cbdata, isc_result_t *resp) {
+	query_ctx_t *qctx = (query_ctx_t *)arg;
+	policy_instance_t *inst = (policy_instance_t *)cbdata;
+
+	*resp = ISC_R_UNSET;
+
+	if (!qctx->detach_client) {
+		return (NS_HOOK_CONTINUE);
+	}
+
+	client_state_destroy(qctx, inst);
+
+	return (NS_HOOK_CONTINUE);
+}
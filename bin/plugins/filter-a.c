@@ -21,7 +21,6 @@
 
 #include <isc/buffer.h>
 #include <isc/hash.h>
-#include <isc/ht.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/netaddr.h>
@@ -64,9 +63,10 @@
 typedef enum { NONE = 0, FILTER = 1, BREAK_DNSSEC = 2 } filter_a_t;
 
 /*
- * Persistent data for use by this module. This will be associated
- * with client object address in the hash table, and will remain
- * accessible until the client object is detached.
+ * Persistent data for use by this module. This will be stored with
+ * the client object (see ns_client_sethookdata()), and will remain
+ * accessible until the client object is detached; if it is still
+ * there when the query state is reset, client_state_free() frees it.
  */
 typedef struct filter_data {
 	filter_a_t mode;
@@ -77,12 +77,6 @@ typedef struct filter_instance {
 	ns_plugin_t *module;
 	isc_mem_t *mctx;
 
-	/*
-	 * Hash table associating a client object with its persistent data.
-	 */
-	isc_ht_t *ht;
-	isc_mutex_t hlock;
-
 	/*
 	 * Values configured when the module is loaded.
 	 */
@@ -347,9 +341,6 @@ plugin_register(const char *parameters, const void *cfg, const char *cfg_file,
 				       cfg_line, mctx, lctx, actx));
 	}
 
-	isc_ht_init(&inst->ht, mctx, 1, ISC_HT_CASE_SENSITIVE);
-	isc_mutex_init(&inst->hlock);
-
 	/*
 	 * Set hook points in the view's hooktable.
 	 */
@@ -401,10 +392,6 @@ void
 plugin_destroy(void **instp) {
 	filter_instance_t *inst = (filter_instance_t *)*instp;
 
-	if (inst->ht != NULL) {
-		isc_ht_destroy(&inst->ht);
-		isc_mutex_destroy(&inst->hlock);
-	}
 	if (inst->a_acl != NULL) {
 		dns_acl_detach(&inst->a_acl);
 	}
@@ -470,15 +457,14 @@ is_v6_client(ns_client_t *client) {
 
 static filter_data_t *
 client_state_get(const query_ctx_t *qctx, filter_instance_t *inst) {
-	filter_data_t *client_state = NULL;
-	isc_result_t result;
+	return (ns_client_gethookdata(qctx->client, inst));
+}
 
-	LOCK(&inst->hlock);
-	result = isc_ht_find(inst->ht, (const unsigned char *)&qctx->client,
-			     sizeof(qctx->client), (void **)&client_state);
-	UNLOCK(&inst->hlock);
+static void
+client_state_free(const void *key, void *data) {
+	filter_instance_t *inst = UNCONST(key);
 
-	return (result == ISC_R_SUCCESS ? client_state : NULL);
+	isc_mem_put(inst->mctx, data, sizeof(filter_data_t));
 }
 
 static void
@@ -491,10 +477,8 @@ client_state_create(const query_ctx_t *qctx, filter_instance_t *inst) {
 	client_state->mode = NONE;
 	client_state->flags = 0;
 
-	LOCK(&inst->hlock);
-	result = isc_ht_add(inst->ht, (const unsigned char *)&qctx->client,
-			    sizeof(qctx->client), client_state);
-	UNLOCK(&inst->hlock);
+	result = ns_client_sethookdata(qctx->client, inst, client_state,
+				       client_state_free);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 }
 
@@ -507,10 +491,7 @@ client_state_destroy(const query_ctx_t *qctx, filter_instance_t *inst) {
 		return;
 	}
 
-	LOCK(&inst->hlock);
-	result = isc_ht_delete(inst->ht, (const unsigned char *)&qctx->client,
-			       sizeof(qctx->client));
-	UNLOCK(&inst->hlock);
+	result = ns_client_sethookdata(qctx->client, inst, NULL, NULL);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
 	isc_mem_put(inst->mctx, client_state, sizeof(*client_state));
@@ -628,9 +609,9 @@ process_section(const section_filter_t *filter) {
 
 /*
  * Initialize filter state, fetching it from a memory pool and storing it
- * in a hash table keyed according to the client object; this enables us to
- * retrieve persistent data related to a client query for as long as the
- * object persists.
+ * with the client object, keyed by this module instance; this enables us
+ * to retrieve persistent data related to a client query for as long as
+ * the object persists.
  */
 static ns_hookresult_t
 filter_qctx_initialize(void *arg, void *cbdata, isc_result_t *resp) {
@@ -860,7 +841,7 @@ filter_query_done_send(void *arg, void *cbdata, isc_result_t *resp) {
 
 /*
  * If the client is being detached, then we can delete our persistent data
- * from hash table and return it to the memory pool.
+ * from the client object and return it to the memory pool.
  */
 static ns_hookresult_t
 filter_qctx_destroy(void *arg, void *cbdata, isc_result_t *resp) {
@@ -100,6 +100,9 @@ command is one of the following:\n\
 \n\
   addzone zone [class [view]] { zone-options }\n\
 		Add zone to given view. Requires allow-new-zones option.\n\
+  addzones 'zone name [class [view]] { zone-options }; ...'\n\
+		Add several zones to the same view at once.\n\
+		Requires allow-new-zones option.\n\
   delzone [-clean] zone [class [view]]\n\
 		Removes zone from given view.\n\
   dnssec -checkds [-key id [-alg algorithm]] [-when time] (published|withdrawn) zone [class [view]]\n\
@@ -22,7 +22,7 @@
 #include <isc/async.h>
 #include <isc/buffer.h>
 #include <isc/hash.h>
-#include <isc/ht.h>
+#include <isc/hashmap.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/netaddr.h>
@@ -52,12 +52,13 @@
 typedef struct async_instance {
 	ns_plugin_t *module;
 	isc_mem_t *mctx;
-	isc_ht_t *ht;
+	isc_hashmap_t *ht;
 	isc_mutex_t hlock;
 	isc_log_t *lctx;
 } async_instance_t;
 
 typedef struct state {
+	const ns_client_t *client;
 	bool async;
 	ns_hook_resume_t *rev;
 	ns_hookpoint_t hookpoint;
@@ -143,7 +144,7 @@ plugin_register(const char *parameters, const void *cfg, const char *cfg_file,
 	*inst = (async_instance_t){ .mctx = NULL };
 	isc_mem_attach(mctx, &inst->mctx);
 
-	isc_ht_init(&inst->ht, mctx, 1, ISC_HT_CASE_SENSITIVE);
+	isc_hashmap_create(mctx, 1, &inst->ht);
 	isc_mutex_init(&inst->hlock);
 
 	/*
@@ -180,7 +181,7 @@ plugin_destroy(void **instp) {
 	async_instance_t *inst = (async_instance_t *)*instp;
 
 	if (inst->ht != NULL) {
-		isc_ht_destroy(&inst->ht);
+		isc_hashmap_destroy(&inst->ht);
 		isc_mutex_destroy(&inst->hlock);
 	}
 
@@ -198,14 +199,27 @@ plugin_version(void) {
 	return (NS_PLUGIN_VERSION);
 }
 
+static bool
+client_state_match(void *node, const void *key) {
+	const state_t *state = node;
+
+	return (state->client == key);
+}
+
+static uint32_t
+client_state_hash(const query_ctx_t *qctx) {
+	return (isc_hash32(&qctx->client, sizeof(qctx->client), true));
+}
+
 static state_t *
 client_state_get(const query_ctx_t *qctx, async_instance_t *inst) {
 	state_t *state = NULL;
 	isc_result_t result;
 
 	LOCK(&inst->hlock);
-	result = isc_ht_find(inst->ht, (const unsigned char *)&qctx->client,
-			     sizeof(qctx->client), (void **)&state);
+	result = isc_hashmap_find(inst->ht, client_state_hash(qctx),
+				  client_state_match, qctx->client,
+				  (void **)&state);
 	UNLOCK(&inst->hlock);
 
 	return (result == ISC_R_SUCCESS ? state : NULL);
@@ -217,11 +231,11 @@ client_state_create(const query_ctx_t *qctx, async_instance_t *inst) {
 	isc_result_t result;
 
 	state = isc_mem_get(inst->mctx, sizeof(*state));
-	*state = (state_t){ .async = false };
+	*state = (state_t){ .client = qctx->client };
 
 	LOCK(&inst->hlock);
-	result = isc_ht_add(inst->ht, (const unsigned char *)&qctx->client,
-			    sizeof(qctx->client), state);
+	result = isc_hashmap_add(inst->ht, client_state_hash(qctx),
+				 client_state_match, qctx->client, state, NULL);
 	UNLOCK(&inst->hlock);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 }
@@ -236,8 +250,8 @@ client_state_destroy(const query_ctx_t *qctx, async_instance_t *inst) {
 	}
 
 	LOCK(&inst->hlock);
-	result = isc_ht_delete(inst->ht, (const unsigned char *)&qctx->client,
-			       sizeof(qctx->client));
+	result = isc_hashmap_delete(inst->ht, client_state_hash(qctx),
+				    client_state_match, qctx->client);
 	UNLOCK(&inst->hlock);
 	RUNTIME_CHECK(result == ISC_R_SUCCESS);
 
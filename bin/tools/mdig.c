@@ -85,6 +85,7 @@ static isc_loopmgr_t *loopmgr = NULL;
 static dns_requestmgr_t *requestmgr = NULL;
 static const char *batchname = NULL;
 static FILE *batchfp = NULL;
+static char *progname = NULL;
 static bool burst = false;
 static bool have_ipv4 = false;
 static bool have_ipv6 = false;
@@ -114,6 +115,7 @@ static isc_sockaddr_t dstaddr;
 static in_port_t port = 53;
 static unsigned char cookie_secret[33];
 static int onfly = 0;
+static uint32_t parallel = 0;
 static char hexcookie[81];
 
 static isc_sockaddr_t bind_any;
@@ -186,6 +188,12 @@ rcode_totext(dns_rcode_t rcode) {
 	return (totext.deconsttext);
 }
 
+static bool
+read_batchline(void);
+
+static void
+sendmore(void);
+
 static void
 recvresponse(void *arg) {
 	dns_request_t *request = (dns_request_t *)arg;
@@ -543,7 +551,9 @@ cleanup:
 	}
 	dns_request_destroy(&request);
 
-	if (--onfly == 0) {
+	onfly--;
+	sendmore();
+	if (onfly == 0) {
 		isc_loopmgr_shutdown(loopmgr);
 	}
 	return;
@@ -761,15 +771,48 @@ sendquery(struct query *query) {
 }
 
 static void
-sendqueries(void *arg) {
-	struct query *query = (struct query *)arg;
+free_query(struct query *query) {
+	if (query->ednsopts != NULL) {
+		for (unsigned int i = 0; i < EDNSOPTS; i++) {
+			if (query->ednsopts[i].value != NULL) {
+				isc_mem_free(mctx, query->ednsopts[i].value);
+			}
+		}
+		isc_mem_free(mctx, query->ednsopts);
+	}
+	if (query->ecs_addr != NULL) {
+		isc_mem_free(mctx, query->ecs_addr);
+		query->ecs_addr = NULL;
+	}
+	isc_mem_free(mctx, query);
+}
+
+/*%
+ * Send queries until 'parallel' of them are waiting for a response,
+ * reading more from the batch file as they are needed.  A query is
+ * no longer needed once it has been sent.
+ */
+static void
+sendmore(void) {
+	while (parallel == 0 || onfly < (int)parallel) {
+		struct query *query = ISC_LIST_HEAD(queries);
 
-	while (query != NULL) {
-		struct query *next = ISC_LIST_NEXT(query, link);
+		if (query == NULL) {
+			if (batchfp == NULL || !read_batchline()) {
+				break;
+			}
+			continue;
+		}
 
+		ISC_LIST_UNLINK(queries, query, link);
 		sendquery(query);
-		query = next;
+		free_query(query);
 	}
+}
+
+static void
+sendqueries(void *arg ISC_ATTR_UNUSED) {
+	sendmore();
 
 	if (onfly == 0) {
 		isc_loopmgr_shutdown(loopmgr);
@@ -846,6 +889,8 @@ help(void) {
 	       "flags)\n"
 	       "                 +[no]multiline      (Print records in an "
 	       "expanded format)\n"
+	       "                 +parallel=###       (Limit the number of "
+	       "queries in flight)\n"
 	       "                 +[no]split=##       (Split hex/base64 fields "
 	       "into chunks)\n"
 	       " local opt       is one of:\n"
@@ -1412,6 +1457,19 @@ plus_option(char *option, struct query *query, bool global) {
 		}
 		query->nsid = state;
 		break;
+	case 'p': /* parallel */
+		FULLCHECK("parallel");
+		GLOBAL();
+		if (!state) {
+			parallel = 0;
+			break;
+		}
+		if (value == NULL) {
+			goto need_value;
+		}
+		result = parse_uint(&parallel, value, MAXTRIES, "parallel");
+		CHECK("parse_uint(parallel)", result);
+		break;
 	case 'q':
 		FULLCHECK("question");
 		GLOBAL();
@@ -1881,15 +1939,50 @@ preparse_args(int argc, char **argv) {
 }
 
 static void
-parse_args(bool is_batchfile, int argc, char **argv) {
-	struct query *query = NULL;
-	char batchline[MXNAME];
+parse_args(bool is_batchfile, int argc, char **argv);
+
+/*%
+ * Read the next query from the batch file, closing it at the end.
+ */
+static bool
+read_batchline(void) {
+	static char batchline[MXNAME];
 	int bargc;
 	char *bargv[64];
+	char *last;
+
+	while (fgets(batchline, sizeof(batchline), batchfp) != 0) {
+		if (batchline[0] == '\r' || batchline[0] == '\n' ||
+		    batchline[0] == '#' || batchline[0] == ';')
+		{
+			continue;
+		}
+		for (bargc = 1, bargv[bargc] = strtok_r(batchline, " \t\r\n",
+							 &last);
+		     (bargc < 14) && bargv[bargc]; bargc++,
+		    bargv[bargc] = strtok_r(NULL, " \t\r\n", &last))
+		{
+			/* empty body */
+		}
+
+		bargv[0] = progname;
+		parse_args(true, bargc, (char **)bargv);
+		return (true);
+	}
+
+	if (batchfp != stdin) {
+		fclose(batchfp);
+	}
+	batchfp = NULL;
+	return (false);
+}
+
+static void
+parse_args(bool is_batchfile, int argc, char **argv) {
+	struct query *query = NULL;
 	int rc;
 	char **rv;
 	bool global = true;
-	char *last;
 
 	/*
 	 * The semantics for parsing the args is a bit complex; if
@@ -1995,7 +2088,10 @@ parse_args(bool is_batchfile, int argc, char **argv) {
 	}
 
 	/*
-	 * If we have a batchfile, read the query list from it.
+	 * If we have a batchfile, read the query list from it.  When the
+	 * number of queries in flight is limited, it is read as the
+	 * queries are sent instead, so that a long batch file does not
+	 * have to be held in memory.
 	 */
 	if ((batchname != NULL) && !is_batchfile) {
 		if (strcmp(batchname, "-") == 0) {
@@ -2007,25 +2103,11 @@ parse_args(bool is_batchfile, int argc, char **argv) {
 			perror(batchname);
 			fatal("couldn't open batch file '%s'", batchname);
 		}
-		while (fgets(batchline, sizeof(batchline), batchfp) != 0) {
-			if (batchline[0] == '\r' || batchline[0] == '\n' ||
-			    batchline[0] == '#' || batchline[0] == ';')
-			{
-				continue;
-			}
-			for (bargc = 1, bargv[bargc] = strtok_r(
-						batchline, " \t\r\n", &last);
-			     (bargc < 14) && bargv[bargc]; bargc++,
-			    bargv[bargc] = strtok_r(NULL, " \t\r\n", &last))
-			{
+		progname = argv[0];
+		if (parallel == 0) {
+			while (read_batchline()) {
 				/* empty body */
 			}
-
-			bargv[0] = argv[0];
-			parse_args(true, bargc, (char **)bargv);
-		}
-		if (batchfp != stdin) {
-			fclose(batchfp);
 		}
 	}
 	if (query != &default_query) {
@@ -2114,7 +2196,6 @@ main(int argc, char *argv[]) {
 	isc_result_t result;
 	isc_log_t *lctx = NULL;
 	isc_logconfig_t *lcfg = NULL;
-	unsigned int i;
 	int ns;
 
 	if (isc_net_probeipv4() == ISC_R_SUCCESS) {
@@ -2159,9 +2240,8 @@ main(int argc, char *argv[]) {
 		fatal("can't choose between IPv4 and IPv6");
 	}
 
-	query = ISC_LIST_HEAD(queries);
 	isc_loopmgr_setup(loopmgr, setup, NULL);
-	isc_loopmgr_setup(loopmgr, sendqueries, query);
+	isc_loopmgr_setup(loopmgr, sendqueries, NULL);
 	isc_loopmgr_teardown(loopmgr, teardown, NULL);
 
 	/*
@@ -2196,25 +2276,12 @@ main(int argc, char *argv[]) {
 
 	isc_log_destroy(&lctx);
 
-	query = ISC_LIST_HEAD(queries);
-	while (query != NULL) {
-		struct query *next = ISC_LIST_NEXT(query, link);
-
-		if (query->ednsopts != NULL) {
-			for (i = 0; i < EDNSOPTS; i++) {
-				if (query->ednsopts[i].value != NULL) {
-					isc_mem_free(mctx,
-						     query->ednsopts[i].value);
-				}
-			}
-			isc_mem_free(mctx, query->ednsopts);
-		}
-		if (query->ecs_addr != NULL) {
-			isc_mem_free(mctx, query->ecs_addr);
-			query->ecs_addr = NULL;
-		}
-		isc_mem_free(mctx, query);
-		query = next;
+	while ((query = ISC_LIST_HEAD(queries)) != NULL) {
+		ISC_LIST_UNLINK(queries, query, link);
+		free_query(query);
+	}
+	if (batchfp != NULL && batchfp != stdin) {
+		fclose(batchfp);
 	}
 
 	if (default_query.ecs_addr != NULL) {
@@ -0,0 +1,977 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <errno.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <isc/atomic.h>
+#include <isc/attributes.h>
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/histo.h>
+#include <isc/loop.h>
+#include <isc/managers.h>
+#include <isc/mem.h>
+#include <isc/net.h>
+#include <isc/netmgr.h>
+#include <isc/os.h>
+#include <isc/parseint.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/string.h>
+#include <isc/tid.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/tls.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rcode.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+
+#define BENCH_LATENCY_SIGBITS 5
+#define BENCH_TICK	      (NS_PER_MS)
+#define BENCH_SCAN	      (10 * NS_PER_MS)
+#define BENCH_RECONNECT	      (NS_PER_SEC)
+#define BENCH_EDNSLEN	      11
+#define BENCH_MAXQUERY \
+	(DNS_MESSAGE_HEADERLEN + DNS_NAME_MAXWIRE + 4 + BENCH_EDNSLEN)
+
+typedef enum {
+	UDP,
+	TCP,
+	DOT,
+	HTTPS_POST,
+	HTTPS_GET,
+	HTTP_POST,
+	HTTP_GET
+} protocol_t;
+
+static const char *protocols[] = { "udp",	    "tcp",
+				   "dot",	    "https-post",
+				   "https-get",	    "http-plain-post",
+				   "http-plain-get" };
+
+typedef enum { CONN_CLOSED, CONN_CONNECTING, CONN_CONNECTED } connstate_t;
+
+typedef struct bench_worker bench_worker_t;
+typedef struct bench_conn bench_conn_t;
+typedef struct bench_slot bench_slot_t;
+
+/*
+ * One query in flight.  The message ID encodes the slot index, so a
+ * response finds its slot without a lookup; 'gen' changes the ID each
+ * time the slot is reused, so late responses are not mistaken for
+ * the current query.
+ */
+struct bench_slot {
+	bench_conn_t *conn;
+	isc_nanosecs_t sent; /* 0 when not waiting for a response */
+	uint16_t index;
+	uint16_t gen;
+	uint16_t id;
+	bool sending;
+	unsigned char wire[BENCH_MAXQUERY];
+};
+
+struct bench_conn {
+	bench_worker_t *worker;
+	isc_nmhandle_t *handle;
+	connstate_t state;
+	bool reading;
+	isc_nanosecs_t retry;
+	unsigned int outstanding;
+	unsigned int nfree;
+	bench_slot_t **free;
+	bench_slot_t *slots;
+};
+
+struct bench_worker {
+	uint32_t tid;
+	isc_timer_t *timer;
+	bench_conn_t *conns;
+	unsigned int cursor;
+	size_t next;
+	uint32_t qps;
+	bool stopping;
+	bool done;
+	isc_nanosecs_t start;
+	isc_nanosecs_t end;
+	isc_nanosecs_t stopped;
+	isc_nanosecs_t nextscan;
+	uint64_t issued;
+
+	/* Statistics */
+	uint64_t sent;
+	uint64_t received;
+	uint64_t lost;
+	uint64_t errors;
+	uint64_t unexpected;
+	uint64_t rcodes[16];
+};
+
+/* Pre-rendered question sections, one per name */
+typedef struct {
+	size_t offset;
+	uint16_t length;
+} bench_question_t;
+
+static isc_mem_t *mctx = NULL;
+static isc_loopmgr_t *loopmgr = NULL;
+static isc_nm_t *netmgr = NULL;
+static const char *program = "named-bench";
+
+static protocol_t protocol = UDP;
+static isc_sockaddr_t server;
+static isc_sockaddr_t local;
+static isc_tlsctx_t *tlsctx = NULL;
+#if HAVE_LIBNGHTTP2
+static char uri[256];
+#endif /* HAVE_LIBNGHTTP2 */
+static uint32_t nworkers = 0;
+static uint32_t nconns = 1;
+static uint32_t window = 100;
+static uint32_t qps = 0;
+static uint32_t duration = 10;
+static uint32_t timeout = 5;
+static bool edns = true;
+static bool recursion = true;
+
+static unsigned char *arena = NULL;
+static size_t arenasize = 0, arenaused = 0;
+static bench_question_t *questions = NULL;
+static size_t nquestions = 0, maxquestions = 0;
+
+static bench_worker_t *workers = NULL;
+static atomic_uint_fast32_t running;
+static isc_histomulti_t *latency = NULL;
+
+noreturn static void
+fatal(const char *format, ...);
+
+static void
+fatal(const char *format, ...) {
+	va_list args;
+
+	fprintf(stderr, "%s: fatal: ", program);
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+	_exit(EXIT_FAILURE);
+}
+
+noreturn static void
+usage(void);
+
+static void
+usage(void) {
+	fprintf(stderr,
+		"Usage: %s [-ER] [-c connections] [-d duration] "
+		"[-o outstanding] [-p port] [-P protocol] [-q qps] "
+		"[-t timeout] [-T type] [-w workers] server [namefile]\n",
+		program);
+	fprintf(stderr, "\t-c\tconnections per worker (default 1)\n");
+	fprintf(stderr, "\t-d\tsend queries for this many seconds "
+			"(default 10)\n");
+	fprintf(stderr, "\t-E\tdo not add an EDNS OPT record\n");
+	fprintf(stderr, "\t-o\tqueries in flight per connection "
+			"(default 100)\n");
+	fprintf(stderr, "\t-p\tsend the queries to this port\n");
+	fprintf(stderr, "\t-P\tudp, tcp, dot, https-post, https-get, "
+			"http-plain-post or http-plain-get\n");
+	fprintf(stderr, "\t-q\ttotal queries per second (default: as "
+			"many as the windows allow)\n");
+	fprintf(stderr, "\t-R\tclear the RD bit\n");
+	fprintf(stderr, "\t-t\tcount a query as lost after this many "
+			"seconds (default 5)\n");
+	fprintf(stderr, "\t-T\tquery type for names without one "
+			"(default A)\n");
+	fprintf(stderr, "\t-w\tnumber of worker threads (default: one "
+			"per CPU)\n");
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Add the question section for one line of the name file.  Lines are
+ * "name [type]", optionally prefixed by "number," as in
+ * tests/bench/names.csv.
+ */
+static void
+add_question(char *line, dns_rdatatype_t deftype, unsigned long lineno) {
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_rdatatype_t type = deftype;
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+	char *text = NULL, *typetext = NULL, *comma = NULL;
+
+	text = strtok(line, " \t\r\n");
+	if (text == NULL || text[0] == '#' || text[0] == ';') {
+		return;
+	}
+	comma = strchr(text, ',');
+	if (comma != NULL) {
+		text = comma + 1;
+	}
+	typetext = strtok(NULL, " \t\r\n");
+	if (typetext != NULL) {
+		isc_textregion_t tr = { typetext, strlen(typetext) };
+		result = dns_rdatatype_fromtext(&type, &tr);
+		if (result != ISC_R_SUCCESS) {
+			fatal("line %lu: bad type '%s'", lineno, typetext);
+		}
+	}
+
+	result = dns_name_fromstring(name, text, dns_rootname, 0, NULL);
+	if (result != ISC_R_SUCCESS) {
+		fatal("line %lu: bad name '%s': %s", lineno, text,
+		      isc_result_totext(result));
+	}
+	dns_name_toregion(name, &r);
+
+	if (arenaused + r.length + 4 > arenasize) {
+		size_t newsize = ISC_MAX(arenasize * 2, 65536);
+		arena = isc_mem_reget(mctx, arena, arenasize, newsize);
+		arenasize = newsize;
+	}
+	if (nquestions == maxquestions) {
+		size_t newmax = ISC_MAX(maxquestions * 2, 1024);
+		questions = isc_mem_creget(mctx, questions, maxquestions,
+					   newmax, sizeof(questions[0]));
+		maxquestions = newmax;
+	}
+
+	isc_buffer_init(&b, arena + arenaused, r.length + 4);
+	isc_buffer_putmem(&b, r.base, r.length);
+	isc_buffer_putuint16(&b, type);
+	isc_buffer_putuint16(&b, dns_rdataclass_in);
+
+	questions[nquestions++] = (bench_question_t){
+		.offset = arenaused,
+		.length = r.length + 4,
+	};
+	arenaused += r.length + 4;
+}
+
+static void
+load_names(FILE *fp, const char *filename, dns_rdatatype_t deftype) {
+	char line[2048];
+	unsigned long lineno = 0;
+
+	while (fgets(line, sizeof(line), fp) != NULL) {
+		add_question(line, deftype, ++lineno);
+	}
+	if (ferror(fp)) {
+		fatal("%s: %s", filename, strerror(errno));
+	}
+	if (nquestions == 0) {
+		fatal("%s: no names", filename);
+	}
+}
+
+static void
+slot_finish(bench_slot_t *slot) {
+	bench_conn_t *conn = slot->conn;
+
+	INSIST(slot->sent != 0);
+	INSIST(conn->outstanding > 0);
+
+	slot->sent = 0;
+	conn->outstanding--;
+	if (!slot->sending) {
+		conn->free[conn->nfree++] = slot;
+	}
+}
+
+static void
+read_cb(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	void *cbarg);
+
+static void
+conn_close(bench_conn_t *conn, isc_nanosecs_t now) {
+	for (uint32_t i = 0; i < window; i++) {
+		if (conn->slots[i].sent != 0) {
+			conn->worker->lost++;
+			slot_finish(&conn->slots[i]);
+		}
+	}
+
+	if (conn->handle != NULL) {
+		isc_nmhandle_detach(&conn->handle);
+	}
+	conn->state = CONN_CLOSED;
+	conn->reading = false;
+	conn->retry = now + BENCH_RECONNECT;
+}
+
+static void
+conn_read(bench_conn_t *conn) {
+	if (!conn->reading) {
+		conn->reading = true;
+		isc_nm_read(conn->handle, read_cb, conn);
+	}
+}
+
+static void
+send_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
+	bench_slot_t *slot = cbarg;
+	bench_conn_t *conn = slot->conn;
+
+	UNUSED(handle);
+
+	slot->sending = false;
+	if (slot->sent == 0) {
+		/* Answered, expired or abandoned while being sent */
+		conn->free[conn->nfree++] = slot;
+	} else if (eresult != ISC_R_SUCCESS) {
+		conn->worker->errors++;
+		slot_finish(slot);
+	}
+}
+
+/*
+ * Send the next query on 'conn', if it has room for one.
+ */
+static bool
+conn_send(bench_conn_t *conn, isc_nanosecs_t now) {
+	bench_worker_t *worker = conn->worker;
+	const bench_question_t *question = NULL;
+	bench_slot_t *slot = NULL;
+	isc_region_t r;
+	isc_buffer_t b;
+
+	if (conn->state != CONN_CONNECTED || conn->nfree == 0) {
+		return (false);
+	}
+
+	slot = conn->free[--conn->nfree];
+	question = &questions[worker->next];
+	worker->next = (worker->next + nworkers) % nquestions;
+
+	slot->id = slot->index + window * slot->gen;
+	slot->gen = (slot->gen + 1) % (65536 / window);
+
+	isc_buffer_init(&b, slot->wire, sizeof(slot->wire));
+	isc_buffer_putuint16(&b, slot->id);
+	isc_buffer_putuint16(&b, recursion ? DNS_MESSAGEFLAG_RD : 0);
+	isc_buffer_putuint16(&b, 1);
+	isc_buffer_putuint16(&b, 0);
+	isc_buffer_putuint16(&b, 0);
+	isc_buffer_putuint16(&b, edns ? 1 : 0);
+	isc_buffer_putmem(&b, arena + question->offset, question->length);
+	if (edns) {
+		isc_buffer_putuint8(&b, 0);
+		isc_buffer_putuint16(&b, dns_rdatatype_opt);
+		isc_buffer_putuint16(&b, 1232);
+		isc_buffer_putuint32(&b, 0);
+		isc_buffer_putuint16(&b, 0);
+	}
+	isc_buffer_usedregion(&b, &r);
+
+	slot->sent = now;
+	slot->sending = true;
+	conn->outstanding++;
+	worker->sent++;
+
+	if (protocol >= HTTPS_POST) {
+		/* Every DoH request has a stream, and a read, of its own */
+		isc_nm_read(conn->handle, read_cb, conn);
+	} else {
+		conn_read(conn);
+	}
+	isc_nm_send(conn->handle, &r, send_cb, slot);
+
+	return (true);
+}
+
+/*
+ * Send up to 'count' queries, spreading them over the connections.
+ */
+static uint64_t
+worker_send(bench_worker_t *worker, uint64_t count, isc_nanosecs_t now) {
+	uint64_t done = 0;
+	unsigned int idle = 0;
+
+	while (done < count && idle < nconns) {
+		bench_conn_t *conn = &worker->conns[worker->cursor];
+		worker->cursor = (worker->cursor + 1) % nconns;
+		if (conn_send(conn, now)) {
+			done++;
+			idle = 0;
+		} else {
+			idle++;
+		}
+	}
+
+	return (done);
+}
+
+static void
+read_cb(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
+	void *cbarg) {
+	bench_conn_t *conn = cbarg;
+	bench_worker_t *worker = conn->worker;
+	bench_slot_t *slot = NULL;
+	isc_nanosecs_t now;
+	uint16_t id;
+
+	if (handle != conn->handle) {
+		/* A read on a connection that has already been closed */
+		return;
+	}
+	conn->reading = false;
+
+	now = isc_time_monotonic();
+
+	switch (eresult) {
+	case ISC_R_SUCCESS:
+		break;
+	case ISC_R_TIMEDOUT:
+		/* The slot scan counts the queries that were lost */
+		if (protocol < HTTPS_POST && conn->outstanding > 0) {
+			conn_read(conn);
+		}
+		return;
+	default:
+		worker->errors++;
+		conn_close(conn, now);
+		return;
+	}
+
+	if (region->length < DNS_MESSAGE_HEADERLEN) {
+		worker->unexpected++;
+		goto next;
+	}
+
+	id = (region->base[0] << 8) | region->base[1];
+	slot = &conn->slots[id % window];
+	if (slot->sent == 0 || slot->id != id) {
+		worker->unexpected++;
+		goto next;
+	}
+
+	isc_histomulti_inc(latency, (now - slot->sent) / NS_PER_US);
+	worker->rcodes[region->base[3] & 0x0f]++;
+	worker->received++;
+	slot_finish(slot);
+
+next:
+	if (protocol < HTTPS_POST && !worker->done) {
+		conn_read(conn);
+	}
+	if (qps == 0 && !worker->stopping) {
+		worker_send(worker, 1, now);
+	}
+}
+
+static void
+connect_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *cbarg) {
+	bench_conn_t *conn = cbarg;
+	bench_worker_t *worker = conn->worker;
+	isc_nanosecs_t now = isc_time_monotonic();
+
+	INSIST(conn->state == CONN_CONNECTING);
+
+	if (eresult != ISC_R_SUCCESS) {
+		worker->errors++;
+		conn->state = CONN_CLOSED;
+		conn->retry = now + BENCH_RECONNECT;
+		return;
+	}
+
+	if (worker->done) {
+		conn->state = CONN_CLOSED;
+		return;
+	}
+
+	isc_nmhandle_attach(handle, &conn->handle);
+	isc_nmhandle_settimeout(handle, timeout * 1000);
+	conn->state = CONN_CONNECTED;
+
+	if (qps == 0 && !worker->stopping) {
+		while (conn_send(conn, now)) {
+			/* fill the window */
+		}
+	}
+}
+
+static void
+conn_connect(bench_conn_t *conn) {
+	unsigned int ms = timeout * 1000;
+
+	conn->state = CONN_CONNECTING;
+
+	switch (protocol) {
+	case UDP:
+		isc_nm_udpconnect(netmgr, &local, &server, connect_cb, conn,
+				  ms);
+		break;
+	case TCP:
+	case DOT:
+		isc_nm_streamdnsconnect(netmgr, &local, &server, connect_cb,
+					conn, ms, tlsctx, NULL,
+					ISC_NM_PROXY_NONE, NULL);
+		break;
+#if HAVE_LIBNGHTTP2
+	case HTTPS_POST:
+	case HTTPS_GET:
+	case HTTP_POST:
+	case HTTP_GET:
+		isc_nm_httpconnect(netmgr, &local, &server, uri,
+				   protocol == HTTPS_POST ||
+					   protocol == HTTP_POST,
+				   connect_cb, conn, tlsctx, NULL, ms,
+				   ISC_NM_PROXY_NONE, NULL);
+		break;
+#endif /* HAVE_LIBNGHTTP2 */
+	default:
+		UNREACHABLE();
+	}
+}
+
+static void
+worker_stop(bench_worker_t *worker) {
+	isc_nanosecs_t now = isc_time_monotonic();
+
+	if (worker->done) {
+		return;
+	}
+	worker->done = true;
+	if (worker->stopped == 0) {
+		worker->stopped = now;
+	}
+
+	isc_timer_stop(worker->timer);
+	isc_timer_destroy(&worker->timer);
+
+	for (uint32_t i = 0; i < nconns; i++) {
+		conn_close(&worker->conns[i], now);
+	}
+
+	if (atomic_fetch_sub_release(&running, 1) == 1) {
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+worker_tick(void *arg) {
+	bench_worker_t *worker = arg;
+	isc_nanosecs_t now = isc_time_monotonic();
+	isc_nanosecs_t expire = (isc_nanosecs_t)timeout * NS_PER_SEC;
+	unsigned int outstanding = 0;
+
+	if (now >= worker->nextscan) {
+		worker->nextscan = now + BENCH_SCAN;
+		for (uint32_t i = 0; i < nconns; i++) {
+			bench_conn_t *conn = &worker->conns[i];
+			for (uint32_t j = 0;
+			     conn->outstanding > 0 && j < window; j++)
+			{
+				bench_slot_t *slot = &conn->slots[j];
+				if (slot->sent != 0 &&
+				    now - slot->sent >= expire)
+				{
+					worker->lost++;
+					slot_finish(slot);
+				}
+			}
+		}
+	}
+
+	if (!worker->stopping && now >= worker->end) {
+		worker->stopping = true;
+		worker->stopped = now;
+	}
+
+	for (uint32_t i = 0; i < nconns; i++) {
+		bench_conn_t *conn = &worker->conns[i];
+		if (!worker->stopping && conn->state == CONN_CLOSED &&
+		    now >= conn->retry)
+		{
+			conn_connect(conn);
+		}
+		outstanding += conn->outstanding;
+	}
+
+	if (worker->stopping) {
+		if (outstanding == 0) {
+			worker_stop(worker);
+		}
+		return;
+	}
+
+	if (worker->qps == 0) {
+		worker_send(worker, UINT64_MAX, now);
+	} else {
+		uint64_t due = (uint64_t)(now - worker->start) * worker->qps /
+			       NS_PER_SEC;
+		if (due > worker->issued) {
+			worker_send(worker, due - worker->issued, now);
+			/* Don't let a backlog build up behind full windows */
+			worker->issued = due;
+		}
+	}
+}
+
+static void
+worker_setup(void *arg) {
+	bench_worker_t *worker = &workers[isc_tid()];
+	isc_interval_t interval;
+
+	UNUSED(arg);
+
+	worker->start = isc_time_monotonic();
+	worker->end = worker->start + (isc_nanosecs_t)duration * NS_PER_SEC;
+	worker->nextscan = worker->start + BENCH_SCAN;
+
+	for (uint32_t i = 0; i < nconns; i++) {
+		conn_connect(&worker->conns[i]);
+	}
+
+	isc_timer_create(isc_loop_current(loopmgr), worker_tick, worker,
+			 &worker->timer);
+	isc_interval_set(&interval, 0, BENCH_TICK);
+	isc_timer_start(worker->timer, isc_timertype_ticker, &interval);
+}
+
+static void
+worker_teardown(void *arg) {
+	UNUSED(arg);
+
+	worker_stop(&workers[isc_tid()]);
+}
+
+static void
+workers_create(void) {
+	workers = isc_mem_cget(mctx, nworkers, sizeof(workers[0]));
+	for (uint32_t i = 0; i < nworkers; i++) {
+		bench_worker_t *worker = &workers[i];
+
+		*worker = (bench_worker_t){
+			.tid = i,
+			.next = i % nquestions,
+			.qps = qps / nworkers + (i < qps % nworkers ? 1 : 0),
+		};
+		worker->conns = isc_mem_cget(mctx, nconns,
+					     sizeof(worker->conns[0]));
+		for (uint32_t j = 0; j < nconns; j++) {
+			bench_conn_t *conn = &worker->conns[j];
+
+			*conn = (bench_conn_t){
+				.worker = worker,
+				.nfree = window,
+			};
+			conn->slots = isc_mem_cget(mctx, window,
+						   sizeof(conn->slots[0]));
+			conn->free = isc_mem_cget(mctx, window,
+						  sizeof(conn->free[0]));
+			for (uint32_t k = 0; k < window; k++) {
+				conn->slots[k].conn = conn;
+				conn->slots[k].index = k;
+				conn->free[k] = &conn->slots[window - k - 1];
+			}
+		}
+	}
+
+	atomic_init(&running, nworkers);
+}
+
+static void
+workers_destroy(void) {
+	for (uint32_t i = 0; i < nworkers; i++) {
+		bench_worker_t *worker = &workers[i];
+		for (uint32_t j = 0; j < nconns; j++) {
+			bench_conn_t *conn = &worker->conns[j];
+			isc_mem_cput(mctx, conn->slots, window,
+				     sizeof(conn->slots[0]));
+			isc_mem_cput(mctx, conn->free, window,
+				     sizeof(conn->free[0]));
+		}
+		isc_mem_cput(mctx, worker->conns, nconns,
+			     sizeof(worker->conns[0]));
+	}
+	isc_mem_cput(mctx, workers, nworkers, sizeof(workers[0]));
+}
+
+static void
+report(void) {
+	static const double fractions[] = { 0.999, 0.99, 0.90, 0.50 };
+	uint64_t quantiles[ARRAY_SIZE(fractions)];
+	uint64_t sent = 0, received = 0, lost = 0, errors = 0;
+	uint64_t unexpected = 0, rcodes[16] = { 0 };
+	isc_nanosecs_t elapsed = 0;
+	isc_histo_t *hg = NULL;
+	double count, mean, sd;
+	char rcodebuf[64];
+	isc_buffer_t b;
+
+	for (uint32_t i = 0; i < nworkers; i++) {
+		bench_worker_t *worker = &workers[i];
+		sent += worker->sent;
+		received += worker->received;
+		lost += worker->lost;
+		errors += worker->errors;
+		unexpected += worker->unexpected;
+		for (size_t j = 0; j < ARRAY_SIZE(rcodes); j++) {
+			rcodes[j] += worker->rcodes[j];
+		}
+		elapsed = ISC_MAX(elapsed, worker->stopped - worker->start);
+	}
+
+	printf("protocol %s, %" PRIu32 " workers, %" PRIu32
+	       " connections, %" PRIu32 " in flight\n",
+	       protocols[protocol], nworkers, nworkers * nconns, window);
+	printf("sent %" PRIu64 ", received %" PRIu64 ", lost %" PRIu64
+	       ", errors %" PRIu64 ", unexpected %" PRIu64 "\n",
+	       sent, received, lost, errors, unexpected);
+	if (elapsed > 0) {
+		printf("%.3f seconds, %.1f responses per second\n",
+		       (double)elapsed / NS_PER_SEC,
+		       (double)received * NS_PER_SEC / elapsed);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(rcodes); i++) {
+		if (rcodes[i] == 0) {
+			continue;
+		}
+		isc_buffer_init(&b, rcodebuf, sizeof(rcodebuf) - 1);
+		if (dns_rcode_totext(i, &b) != ISC_R_SUCCESS) {
+			continue;
+		}
+		isc_buffer_putuint8(&b, 0);
+		printf("%s %" PRIu64 "\n", rcodebuf, rcodes[i]);
+	}
+
+	isc_histomulti_merge(&hg, latency);
+	isc_histo_moments(hg, &count, &mean, &sd);
+	if (isc_histo_quantiles(hg, ARRAY_SIZE(fractions), fractions,
+				quantiles) == ISC_R_SUCCESS)
+	{
+		printf("latency mean %.0fus, stddev %.0fus\n", mean, sd);
+		printf("latency median %" PRIu64 "us, 90%% %" PRIu64
+		       "us, 99%% %" PRIu64 "us, 99.9%% %" PRIu64 "us\n",
+		       quantiles[3], quantiles[2], quantiles[1],
+		       quantiles[0]);
+	}
+	isc_histo_destroy(&hg);
+}
+
+static void
+parse_uint32(uint32_t *value, const char *what, uint32_t min,
+	     uint32_t max) {
+	isc_result_t result = isc_parse_uint32(value,
+					       isc_commandline_argument, 10);
+	if (result != ISC_R_SUCCESS || *value < min || *value > max) {
+		fatal("bad %s '%s'", what, isc_commandline_argument);
+	}
+}
+
+int
+main(int argc, char *argv[]) {
+	isc_result_t result;
+	struct in_addr in4;
+	struct in6_addr in6;
+	dns_rdatatype_t deftype = dns_rdatatype_a;
+	uint16_t port = 0;
+	FILE *fp = stdin;
+	const char *filename = "stdin";
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv,
+					   "c:d:Eo:p:P:q:Rt:T:w:")) != -1)
+	{
+		switch (ch) {
+		case 'c':
+			parse_uint32(&nconns, "connection count", 1, 10000);
+			break;
+		case 'd':
+			parse_uint32(&duration, "duration", 1, UINT32_MAX);
+			break;
+		case 'E':
+			edns = false;
+			break;
+		case 'o':
+			parse_uint32(&window, "outstanding query count", 1,
+				     256);
+			break;
+		case 'p':
+			result = isc_parse_uint16(&port,
+						  isc_commandline_argument, 10);
+			if (result != ISC_R_SUCCESS || port == 0) {
+				fatal("bad port '%s'",
+				      isc_commandline_argument);
+			}
+			break;
+		case 'P': {
+			size_t i;
+			for (i = 0; i < ARRAY_SIZE(protocols); i++) {
+				if (strcasecmp(isc_commandline_argument,
+					       protocols[i]) == 0)
+				{
+					break;
+				}
+			}
+			if (i == ARRAY_SIZE(protocols)) {
+				fatal("bad protocol '%s'",
+				      isc_commandline_argument);
+			}
+			protocol = i;
+			break;
+		}
+		case 'q':
+			parse_uint32(&qps, "rate", 0, UINT32_MAX);
+			break;
+		case 'R':
+			recursion = false;
+			break;
+		case 't':
+			parse_uint32(&timeout, "timeout", 1, 3600);
+			break;
+		case 'T': {
+			isc_textregion_t tr = {
+				isc_commandline_argument,
+				strlen(isc_commandline_argument),
+			};
+			result = dns_rdatatype_fromtext(&deftype, &tr);
+			if (result != ISC_R_SUCCESS) {
+				fatal("bad type '%s'",
+				      isc_commandline_argument);
+			}
+			break;
+		}
+		case 'w':
+			parse_uint32(&nworkers, "worker count", 1, 1024);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+	if (argc < 1 || argc > 2) {
+		usage();
+	}
+
+#if !HAVE_LIBNGHTTP2
+	if (protocol >= HTTPS_POST) {
+		fatal("DNS over HTTP is not supported in this build");
+	}
+#endif /* !HAVE_LIBNGHTTP2 */
+
+	/* An HTTP/2 stream carries one query at a time */
+	if (protocol >= HTTPS_POST) {
+		window = 1;
+	}
+	if (port == 0) {
+		switch (protocol) {
+		case DOT:
+			port = 853;
+			break;
+		case HTTPS_POST:
+		case HTTPS_GET:
+			port = 443;
+			break;
+		case HTTP_POST:
+		case HTTP_GET:
+			port = 80;
+			break;
+		default:
+			port = 53;
+		}
+	}
+
+	if (inet_pton(AF_INET, argv[0], &in4) == 1) {
+		isc_sockaddr_fromin(&server, &in4, port);
+	} else if (inet_pton(AF_INET6, argv[0], &in6) == 1) {
+		isc_sockaddr_fromin6(&server, &in6, port);
+	} else {
+		fatal("bad server address '%s'", argv[0]);
+	}
+	isc_sockaddr_anyofpf(&local, isc_sockaddr_pf(&server));
+
+	if (nworkers == 0) {
+		nworkers = isc_os_ncpus();
+	}
+
+	isc_managers_create(&mctx, nworkers, &loopmgr, &netmgr);
+	isc_nm_settimeouts(netmgr, timeout * 1000, timeout * 1000,
+			   timeout * 1000, timeout * 1000);
+
+	if (argc == 2) {
+		filename = argv[1];
+		fp = fopen(filename, "r");
+		if (fp == NULL) {
+			fatal("%s: %s", filename, strerror(errno));
+		}
+	}
+	load_names(fp, filename, deftype);
+	if (fp != stdin) {
+		fclose(fp);
+	}
+
+	switch (protocol) {
+	case DOT:
+		isc_tlsctx_createclient(&tlsctx);
+		isc_tlsctx_enable_dot_client_alpn(tlsctx);
+		break;
+#if HAVE_LIBNGHTTP2
+	case HTTPS_POST:
+	case HTTPS_GET:
+		isc_tlsctx_createclient(&tlsctx);
+		isc_tlsctx_enable_http2client_alpn(tlsctx);
+		FALLTHROUGH;
+	case HTTP_POST:
+	case HTTP_GET:
+		isc_nm_http_makeuri(tlsctx != NULL, &server, NULL, 0,
+				    ISC_NM_HTTP_DEFAULT_PATH, uri,
+				    sizeof(uri));
+		break;
+#endif /* HAVE_LIBNGHTTP2 */
+	default:
+		break;
+	}
+
+	isc_histomulti_create(mctx, BENCH_LATENCY_SIGBITS, &latency);
+	workers_create();
+
+	isc_loopmgr_setup(loopmgr, worker_setup, NULL);
+	isc_loopmgr_teardown(loopmgr, worker_teardown, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	report();
+
+	workers_destroy();
+	isc_histomulti_destroy(&latency);
+	if (tlsctx != NULL) {
+		isc_tlsctx_free(&tlsctx);
+	}
+	isc_mem_cput(mctx, questions, maxquestions, sizeof(questions[0]));
+	isc_mem_put(mctx, arena, arenasize);
+
+	isc_managers_destroy(&mctx, &loopmgr, &netmgr);
+
+	return (0);
+}
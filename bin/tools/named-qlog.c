@@ -0,0 +1,404 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <poll.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <isc/attributes.h>
+#include <isc/buffer.h>
+#include <isc/commandline.h>
+#include <isc/histo.h>
+#include <isc/mem.h>
+#include <isc/net.h>
+#include <isc/parseint.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/string.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/qlog.h>
+#include <dns/rcode.h>
+#include <dns/rdataclass.h>
+#include <dns/rdatatype.h>
+
+#define QLOG_LATENCY_SIGBITS 4
+
+static isc_mem_t *mctx = NULL;
+static const char *program = "named-qlog";
+
+/* Replay settings and state */
+static bool replay = false;
+static isc_sockaddr_t server;
+static uint32_t qps = 0;
+static uint32_t timeout = 5;
+static int sock = -1;
+static uint16_t nextid = 0;
+static isc_nanosecs_t pending[65536]; /* send times, 0 if not pending */
+static uint64_t sent = 0, received = 0, mismatched = 0;
+static uint64_t rcodes[16];
+static isc_histo_t *latency = NULL;
+
+noreturn static void
+fatal(const char *format, ...);
+
+static void
+fatal(const char *format, ...) {
+	va_list args;
+
+	fprintf(stderr, "%s: fatal: ", program);
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+	fprintf(stderr, "\n");
+	_exit(EXIT_FAILURE);
+}
+
+noreturn static void
+usage(void);
+
+static void
+usage(void) {
+	fprintf(stderr, "Usage: %s [-s server] [-p port] [-q qps] "
+			"[-t timeout] [filename...]\n",
+		program);
+	fprintf(stderr, "\t-s\treplay the queries against this server "
+			"address\n");
+	fprintf(stderr, "\t-p\tsend the queries to this port (default 53)\n");
+	fprintf(stderr, "\t-q\tsend at most this many queries per second\n");
+	fprintf(stderr, "\t-t\twait this many seconds for the last responses "
+			"(default 5)\n");
+	exit(EXIT_FAILURE);
+}
+
+/*
+ * Read the next record from 'fp' into 'b'.
+ */
+static isc_result_t
+read_record(FILE *fp, isc_buffer_t *b) {
+	unsigned char *base = isc_buffer_base(b);
+	size_t length;
+
+	isc_buffer_clear(b);
+	if (fread(base, 1, 2, fp) != 2) {
+		return (feof(fp) ? ISC_R_NOMORE : ISC_R_IOERROR);
+	}
+	length = (base[0] << 8) | base[1];
+	if (length + 2 > isc_buffer_length(b)) {
+		return (ISC_R_RANGE);
+	}
+	if (fread(base + 2, 1, length, fp) != length) {
+		return (feof(fp) ? ISC_R_UNEXPECTEDEND : ISC_R_IOERROR);
+	}
+	isc_buffer_add(b, length + 2);
+
+	return (ISC_R_SUCCESS);
+}
+
+static void
+print_record(const dns_qlogrecord_t *record) {
+	static const struct {
+		uint16_t flag;
+		const char *text;
+	} flags[] = {
+		{ DNS_MESSAGEFLAG_AA, "aa" }, { DNS_MESSAGEFLAG_TC, "tc" },
+		{ DNS_MESSAGEFLAG_RD, "rd" }, { DNS_MESSAGEFLAG_RA, "ra" },
+		{ DNS_MESSAGEFLAG_AD, "ad" }, { DNS_MESSAGEFLAG_CD, "cd" },
+	};
+	char timebuf[64];
+	char addrbuf[ISC_SOCKADDR_FORMATSIZE];
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+	char classbuf[DNS_RDATACLASS_FORMATSIZE];
+	char rcodebuf[64];
+	char flagbuf[32] = "";
+	isc_buffer_t b;
+
+	isc_time_formatISO8601us(&record->time, timebuf, sizeof(timebuf));
+	isc_sockaddr_format(&record->client, addrbuf, sizeof(addrbuf));
+	dns_name_format(record->qname, namebuf, sizeof(namebuf));
+	dns_rdatatype_format(record->qtype, typebuf, sizeof(typebuf));
+	dns_rdataclass_format(record->qclass, classbuf, sizeof(classbuf));
+
+	isc_buffer_init(&b, rcodebuf, sizeof(rcodebuf) - 1);
+	if (dns_rcode_totext(record->rcode, &b) != ISC_R_SUCCESS) {
+		isc_buffer_clear(&b);
+	}
+	isc_buffer_putuint8(&b, 0);
+
+	for (size_t i = 0; i < ARRAY_SIZE(flags); i++) {
+		if ((record->flags & flags[i].flag) != 0) {
+			if (flagbuf[0] != '\0') {
+				strlcat(flagbuf, ",", sizeof(flagbuf));
+			}
+			strlcat(flagbuf, flags[i].text, sizeof(flagbuf));
+		}
+	}
+
+	printf("%s %s%s %s %s %s %s %s %" PRIu32 "us\n", timebuf, addrbuf,
+	       record->tcp ? " TCP" : "", namebuf, classbuf, typebuf,
+	       flagbuf[0] != '\0' ? flagbuf : "-", rcodebuf, record->latency);
+}
+
+static void
+replay_open(void) {
+	sock = socket(isc_sockaddr_pf(&server), SOCK_DGRAM, 0);
+	if (sock < 0) {
+		fatal("socket: %s", strerror(errno));
+	}
+	if (connect(sock, &server.type.sa, server.length) < 0) {
+		fatal("connect: %s", strerror(errno));
+	}
+	if (fcntl(sock, F_SETFL, fcntl(sock, F_GETFL) | O_NONBLOCK) < 0) {
+		fatal("fcntl: %s", strerror(errno));
+	}
+
+	isc_histo_create(mctx, QLOG_LATENCY_SIGBITS, &latency);
+}
+
+/*
+ * Read the responses which have arrived, waiting at most 'wait'
+ * milliseconds for the first one.
+ */
+static void
+replay_receive(int wait) {
+	struct pollfd pfd = { .fd = sock, .events = POLLIN };
+	unsigned char buf[4096];
+	isc_nanosecs_t now;
+	ssize_t n;
+	uint16_t id;
+
+	if (poll(&pfd, 1, wait) <= 0) {
+		return;
+	}
+
+	while ((n = recv(sock, buf, sizeof(buf), 0)) >= 0) {
+		if (n < DNS_MESSAGE_HEADERLEN) {
+			mismatched++;
+			continue;
+		}
+		id = (buf[0] << 8) | buf[1];
+		if (pending[id] == 0) {
+			mismatched++;
+			continue;
+		}
+
+		now = isc_time_monotonic();
+		isc_histo_inc(latency, (now - pending[id]) / NS_PER_US);
+		pending[id] = 0;
+		rcodes[buf[3] & 0x0f]++;
+		received++;
+	}
+}
+
+static void
+replay_send(const dns_qlogrecord_t *record, isc_nanosecs_t due) {
+	unsigned char wire[DNS_MESSAGE_HEADERLEN + DNS_NAME_MAXWIRE + 4];
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_nanosecs_t now;
+
+	/* Pace the queries, reading the responses meanwhile */
+	while ((now = isc_time_monotonic()) < due) {
+		replay_receive((due - now) / NS_PER_MS);
+	}
+
+	isc_buffer_init(&b, wire, sizeof(wire));
+	isc_buffer_putuint16(&b, nextid);
+	isc_buffer_putuint16(&b, record->flags & (DNS_MESSAGEFLAG_RD |
+						  DNS_MESSAGEFLAG_CD));
+	isc_buffer_putuint16(&b, 1);
+	isc_buffer_putuint16(&b, 0);
+	isc_buffer_putuint16(&b, 0);
+	isc_buffer_putuint16(&b, 0);
+	dns_name_toregion(record->qname, &r);
+	isc_buffer_putmem(&b, r.base, r.length);
+	isc_buffer_putuint16(&b, record->qtype);
+	isc_buffer_putuint16(&b, record->qclass);
+
+	if (send(sock, wire, isc_buffer_usedlength(&b), 0) < 0) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK &&
+		    errno != ECONNREFUSED)
+		{
+			fatal("send: %s", strerror(errno));
+		}
+	} else {
+		pending[nextid] = isc_time_monotonic();
+		sent++;
+	}
+	nextid++;
+
+	replay_receive(0);
+}
+
+static void
+replay_report(void) {
+	static const double fractions[] = { 0.99, 0.90, 0.50 };
+	uint64_t quantiles[ARRAY_SIZE(fractions)];
+	char rcodebuf[64];
+	isc_buffer_t b;
+	isc_nanosecs_t end;
+
+	end = isc_time_monotonic() + (isc_nanosecs_t)timeout * NS_PER_SEC;
+	while (received < sent && isc_time_monotonic() < end) {
+		replay_receive(10);
+	}
+
+	printf("sent %" PRIu64 ", received %" PRIu64 ", lost %" PRIu64
+	       ", unexpected %" PRIu64 "\n",
+	       sent, received, sent - received, mismatched);
+	for (size_t i = 0; i < ARRAY_SIZE(rcodes); i++) {
+		if (rcodes[i] == 0) {
+			continue;
+		}
+		isc_buffer_init(&b, rcodebuf, sizeof(rcodebuf) - 1);
+		if (dns_rcode_totext(i, &b) != ISC_R_SUCCESS) {
+			continue;
+		}
+		isc_buffer_putuint8(&b, 0);
+		printf("%s %" PRIu64 "\n", rcodebuf, rcodes[i]);
+	}
+	if (isc_histo_quantiles(latency, ARRAY_SIZE(fractions), fractions,
+				quantiles) == ISC_R_SUCCESS)
+	{
+		printf("latency median %" PRIu64 "us, 90%% %" PRIu64
+		       "us, 99%% %" PRIu64 "us\n",
+		       quantiles[2], quantiles[1], quantiles[0]);
+	}
+
+	isc_histo_destroy(&latency);
+	close(sock);
+}
+
+static void
+process(FILE *fp, const char *filename) {
+	unsigned char data[DNS_QLOG_MAXRECORD];
+	isc_buffer_t b;
+	dns_fixedname_t fixed;
+	dns_name_t *qname = dns_fixedname_initname(&fixed);
+	dns_qlogrecord_t record;
+	isc_result_t result;
+	isc_nanosecs_t interval = (qps > 0) ? NS_PER_SEC / qps : 0;
+	isc_nanosecs_t due = isc_time_monotonic();
+
+	isc_buffer_init(&b, data, sizeof(data));
+	while ((result = read_record(fp, &b)) == ISC_R_SUCCESS) {
+		result = dns_qlog_decode(&b, &record, qname);
+		if (result == ISC_R_NOTIMPLEMENTED) {
+			continue;
+		} else if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		if (replay) {
+			replay_send(&record, due);
+			due += interval;
+		} else {
+			print_record(&record);
+		}
+	}
+	if (result != ISC_R_NOMORE) {
+		fatal("%s: %s", filename, isc_result_totext(result));
+	}
+}
+
+int
+main(int argc, char *argv[]) {
+	isc_result_t result;
+	struct in_addr in4;
+	struct in6_addr in6;
+	const char *address = NULL;
+	uint16_t port = 53;
+	int ch;
+
+	while ((ch = isc_commandline_parse(argc, argv, "p:q:s:t:")) != -1) {
+		switch (ch) {
+		case 'p':
+			result = isc_parse_uint16(&port,
+						  isc_commandline_argument, 10);
+			if (result != ISC_R_SUCCESS) {
+				fatal("bad port '%s'",
+				      isc_commandline_argument);
+			}
+			break;
+		case 'q':
+			result = isc_parse_uint32(&qps,
+						  isc_commandline_argument, 10);
+			if (result != ISC_R_SUCCESS) {
+				fatal("bad rate '%s'",
+				      isc_commandline_argument);
+			}
+			break;
+		case 's':
+			address = isc_commandline_argument;
+			replay = true;
+			break;
+		case 't':
+			result = isc_parse_uint32(&timeout,
+						  isc_commandline_argument, 10);
+			if (result != ISC_R_SUCCESS) {
+				fatal("bad timeout '%s'",
+				      isc_commandline_argument);
+			}
+			break;
+		default:
+			usage();
+		}
+	}
+
+	argc -= isc_commandline_index;
+	argv += isc_commandline_index;
+
+	isc_mem_create(&mctx);
+
+	if (replay) {
+		if (inet_pton(AF_INET, address, &in4) == 1) {
+			isc_sockaddr_fromin(&server, &in4, port);
+		} else if (inet_pton(AF_INET6, address, &in6) == 1) {
+			isc_sockaddr_fromin6(&server, &in6, port);
+		} else {
+			fatal("bad server address '%s'", address);
+		}
+		replay_open();
+	}
+
+	if (argc == 0) {
+		process(stdin, "stdin");
+	}
+	for (int i = 0; i < argc; i++) {
+		FILE *fp = fopen(argv[i], "r");
+		if (fp == NULL) {
+			fatal("%s: %s", argv[i], strerror(errno));
+		}
+		process(fp, argv[i]);
+		fclose(fp);
+	}
+
+	if (replay) {
+		replay_report();
+	}
+
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
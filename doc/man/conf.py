@@ -123,6 +123,13 @@ man_pages = [
         author,
         1,
     ),
+    (
+        "external-policy",
+        "external-policy",
+        "ask an external service whether to answer queries",
+        author,
+        8,
+    ),
     (
         "filter-aaaa",
         "filter-aaaa",
@@ -139,6 +146,13 @@ man_pages = [
     ),
     ("host", "host", "DNS lookup utility", author, 1),
     ("mdig", "mdig", "DNS pipelined lookup utility", author, 1),
+    (
+        "named-bench",
+        "named-bench",
+        "DNS load generator and latency benchmark",
+        author,
+        1,
+    ),
     (
         "named-checkconf",
         "named-checkconf",
@@ -174,6 +188,13 @@ man_pages = [
         author,
         1,
     ),
+    (
+        "named-qlog",
+        "named-qlog",
+        "print or replay a binary query log",
+        author,
+        1,
+    ),
     (
         "named-rrchecker",
         "named-rrchecker",
@@ -15,6 +15,7 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
 
 #include <isc/mem.h>
 #include <isc/once.h>
@@ -149,12 +150,8 @@ isc_result_t
 dns_acl_match(const isc_netaddr_t *reqaddr, const dns_name_t *reqsigner,
 	      const dns_acl_t *acl, dns_aclenv_t *env, int *match,
 	      const dns_aclelement_t **matchelt) {
-	uint16_t bitlen;
-	isc_prefix_t pfx;
-	isc_radix_node_t *node = NULL;
 	const isc_netaddr_t *addr = reqaddr;
 	isc_netaddr_t v4addr;
-	isc_result_t result;
 	int match_num = -1;
 	unsigned int i;
 
@@ -168,29 +165,12 @@ dns_acl_match(const isc_netaddr_t *reqaddr, const dns_name_t *reqsigner,
 		addr = &v4addr;
 	}
 
-	/* Always match with host addresses. */
-	bitlen = (addr->family == AF_INET6) ? 128 : 32;
-	NETADDR_TO_PREFIX_T(addr, pfx, bitlen);
-
-	/* Assume no match. */
-	*match = 0;
-
-	/* Search radix. */
-	result = isc_radix_search(acl->iptable->radix, &node, &pfx);
-
-	/* Found a match. */
-	if (result == ISC_R_SUCCESS && node != NULL) {
-		int fam = ISC_RADIX_FAMILY(&pfx);
-		match_num = node->node_num[fam];
-		if (*(bool *)node->data[fam]) {
-			*match = match_num;
-		} else {
-			*match = -match_num;
-		}
+	/* Search the compiled IP table. */
+	*match = dns_iptable_match(acl->iptable, addr);
+	if (*match != 0) {
+		match_num = abs(*match);
 	}
 
-	isc_refcount_destroy(&pfx.refcount);
-
 	/* Now search non-radix elements for a match with a lower node_num. */
 	for (i = 0; i < acl->length; i++) {
 		dns_aclelement_t *e = &acl->elements[i];
@@ -664,6 +644,8 @@ dns_aclenv_set(dns_aclenv_t *env, dns_acl_t *localhost, dns_acl_t *localnets) {
 	localnets = rcu_xchg_pointer(&env->localnets, dns_acl_ref(localnets));
 	rcu_read_unlock();
 
+	atomic_fetch_add_release(&env->generation, 1);
+
 	dns_acl_detach(&localhost);
 	dns_acl_detach(&localnets);
 }
@@ -693,6 +675,8 @@ dns_aclenv_copy(dns_aclenv_t *target, dns_aclenv_t *source) {
 
 	rcu_read_unlock();
 
+	atomic_fetch_add_release(&target->generation, 1);
+
 	dns_acl_detach(&localhost);
 	dns_acl_detach(&localnets);
 }
@@ -44,6 +44,8 @@
 #include <dns/stats.h>
 #include <dns/transport.h>
 
+#include "probes.h"
+
 #define DNS_ADB_MAGIC		 ISC_MAGIC('D', 'a', 'd', 'b')
 #define DNS_ADB_VALID(x)	 ISC_MAGIC_VALID(x, DNS_ADB_MAGIC)
 #define DNS_ADBNAME_MAGIC	 ISC_MAGIC('a', 'd', 'b', 'N')
@@ -104,7 +106,6 @@ struct dns_adb {
 	isc_refcount_t references;
 
 	dns_adbnamelist_t names_lru;
-	isc_stdtime_t names_last_update;
 	isc_hashmap_t *names;
 	isc_rwlock_t names_lock;
 
@@ -947,6 +948,7 @@ clean_finds_at_name(dns_adbname_t *name, dns_adbstatus_t astat,
 			find->status = astat;
 
 			DP(DEF_LEVEL, "cfan: sending find %p to caller", find);
+			LIBDNS_ADB_FIND_DONE(find, astat);
 
 			isc_async_run(find->loop, find->cb, find);
 			find->flags |= FIND_EVENT_SENT;
@@ -1264,16 +1266,30 @@ hash_adbname(const dns_adbname_t *adbname) {
 	return (isc_hash32_finalize(&hash));
 }
 
+static void
+upgrade_names_lock(dns_adb_t *adb, isc_rwlocktype_t *locktypep,
+		   isc_stdtime_t now) {
+	if (*locktypep == isc_rwlocktype_read) {
+		UPGRADELOCK(&adb->names_lock, *locktypep);
+		purge_stale_names(adb, now);
+	}
+}
+
 /*
  * Search for the name in the hash table.
+ *
+ * The names lock is only held for writing when the hash table or the
+ * LRU list has to change: when the name is not found, when the name
+ * needs to be moved to the head of the LRU list (at most once per
+ * ADB_CACHE_MINIMUM seconds) or when we are over memory.  The stale
+ * names are purged every time the write lock is taken, so the cleaning
+ * keeps pace with the rate at which new names are added.
  */
 static dns_adbname_t *
 get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 			     bool start_at_zone, isc_stdtime_t now) {
 	isc_result_t result;
 	dns_adbname_t *adbname = NULL;
-	isc_time_t timenow;
-	isc_stdtime_t last_update;
 	dns_adbname_t key = {
 		.name = UNCONST(name),
 		.flags = (start_at_zone) ? DNS_ADBFIND_STARTATZONE : 0,
@@ -1281,25 +1297,16 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 	uint32_t hashval = hash_adbname(&key);
 	isc_rwlocktype_t locktype = isc_rwlocktype_read;
 
-	isc_time_set(&timenow, now, 0);
-
 	RWLOCK(&adb->names_lock, locktype);
-	last_update = adb->names_last_update;
 
-	if (last_update + ADB_STALE_MARGIN >= now ||
-	    isc_mem_isovermem(adb->mctx))
-	{
-		last_update = now;
-		UPGRADELOCK(&adb->names_lock, locktype);
-		purge_stale_names(adb, now);
-		adb->names_last_update = last_update;
+	if (isc_mem_isovermem(adb->mctx)) {
+		upgrade_names_lock(adb, &locktype, now);
 	}
 
 	result = isc_hashmap_find(adb->names, hashval, match_adbname,
 				  (void *)&key, (void **)&adbname);
-	switch (result) {
-	case ISC_R_NOTFOUND:
-		UPGRADELOCK(&adb->names_lock, locktype);
+	if (result == ISC_R_NOTFOUND) {
+		upgrade_names_lock(adb, &locktype, now);
 
 		/* Allocate a new name and add it to the hash table. */
 		adbname = new_adbname(adb, name, start_at_zone);
@@ -1307,32 +1314,39 @@ get_attached_and_locked_name(dns_adb_t *adb, const dns_name_t *name,
 		void *found = NULL;
 		result = isc_hashmap_add(adb->names, hashval, match_adbname,
 					 (void *)&key, adbname, &found);
-		if (result == ISC_R_EXISTS) {
+		if (result == ISC_R_SUCCESS) {
+			adbname->last_used = now;
+			ISC_LIST_PREPEND(adb->names_lru, adbname, link);
+		} else if (result == ISC_R_EXISTS) {
 			destroy_adbname(adbname);
 			adbname = found;
 			result = ISC_R_SUCCESS;
-			ISC_LIST_UNLINK(adb->names_lru, adbname, link);
-		}
-		INSIST(result == ISC_R_SUCCESS);
-
-		break;
-	case ISC_R_SUCCESS:
-		if (locktype == isc_rwlocktype_write) {
-			ISC_LIST_UNLINK(adb->names_lru, adbname, link);
 		}
-		break;
-	default:
-		UNREACHABLE();
 	}
+	INSIST(result == ISC_R_SUCCESS);
 
 	dns_adbname_ref(adbname);
-
 	LOCK(&adbname->lock); /* Must be unlocked by the caller */
-	if (adbname->last_used + ADB_CACHE_MINIMUM <= last_update) {
-		adbname->last_used = now;
-	}
-	if (locktype == isc_rwlocktype_write) {
-		ISC_LIST_PREPEND(adb->names_lru, adbname, link);
+
+	/* Did enough time pass to update the LRU? */
+	if (adbname->last_used + ADB_CACHE_MINIMUM <= now) {
+		if (locktype == isc_rwlocktype_read) {
+			/* We need to upgrade the LRU lock */
+			UNLOCK(&adbname->lock);
+			upgrade_names_lock(adb, &locktype, now);
+			LOCK(&adbname->lock);
+		}
+
+		/*
+		 * The name might have been expired while the lock was
+		 * being upgraded; the caller will notice NAME_DEAD() and
+		 * retry.
+		 */
+		if (!NAME_DEAD(adbname)) {
+			adbname->last_used = now;
+			ISC_LIST_UNLINK(adb->names_lru, adbname, link);
+			ISC_LIST_PREPEND(adb->names_lru, adbname, link);
+		}
 	}
 
 	/*
@@ -1965,7 +1979,7 @@ dns_adb_createfind(dns_adb_t *adb, isc_loop_t *loop, isc_job_cb cb, void *cbarg,
 	}
 
 	if (now == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	/*
@@ -2199,6 +2213,7 @@ post_copy:
 		find->flags |= (find->query_pending & DNS_ADBFIND_ADDRESSMASK);
 		DP(DEF_LEVEL, "createfind: attaching find %p to adbname %p %d",
 		   find, adbname, empty);
+		LIBDNS_ADB_FIND_WAIT(find, adbname);
 	} else {
 		/*
 		 * Remove the flag so the caller knows there will never
@@ -2290,6 +2305,7 @@ find_sendevent(dns_adbfind_t *find) {
 		find->result_v6 = ISC_R_CANCELED;
 
 		DP(DEF_LEVEL, "sending find %p to caller", find);
+		LIBDNS_ADB_FIND_DONE(find, DNS_ADB_CANCELED);
 
 		isc_async_run(find->loop, find->cb, find);
 	}
@@ -2824,7 +2840,7 @@ fetch_callback(void *arg) {
 		goto out;
 	}
 
-	now = isc_stdtime_now();
+	now = isc_loop_stdtime();
 
 	/*
 	 * If we got a negative cache response, remember it.
@@ -3035,7 +3051,7 @@ dns_adb_adjustsrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int rtt,
 
 	isc_stdtime_t now = 0;
 	if (atomic_load(&entry->expires) == 0 || factor == DNS_ADB_RTTADJAGE) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	adjustsrtt(addr, rtt, factor, now);
@@ -3052,25 +3068,41 @@ dns_adb_agesrtt(dns_adb_t *adb, dns_adbaddrinfo_t *addr, isc_stdtime_t now) {
 static void
 adjustsrtt(dns_adbaddrinfo_t *addr, unsigned int rtt, unsigned int factor,
 	   isc_stdtime_t now) {
-	unsigned int new_srtt;
+	dns_adbentry_t *entry = addr->entry;
+	unsigned int old_srtt, new_srtt;
 
+	/*
+	 * The entry is shared by all the threads resolving through the
+	 * same server, so the SRTT is updated with a compare-and-swap loop
+	 * instead of under the entry lock; plain load and store pairs
+	 * would lose concurrent updates.
+	 */
 	if (factor == DNS_ADB_RTTADJAGE) {
-		if (atomic_load(&addr->entry->lastage) != now) {
-			new_srtt = (uint64_t)atomic_load(&addr->entry->srtt) *
-				   98 / 100;
-			atomic_store(&addr->entry->lastage, now);
-			atomic_store(&addr->entry->srtt, new_srtt);
-			addr->srtt = new_srtt;
+		isc_stdtime_t lastage = atomic_load(&entry->lastage);
+
+		/* Only one thread gets to age the entry every second */
+		if (lastage == now ||
+		    !atomic_compare_exchange_strong(&entry->lastage, &lastage,
+						    now))
+		{
+			goto done;
 		}
-	} else {
-		new_srtt = ((uint64_t)atomic_load(&addr->entry->srtt) / 10 *
-			    factor) +
-			   ((uint64_t)rtt / 10 * (10 - factor));
-		atomic_store(&addr->entry->srtt, new_srtt);
-		addr->srtt = new_srtt;
 	}
 
-	(void)atomic_compare_exchange_strong(&addr->entry->expires,
+	old_srtt = atomic_load(&entry->srtt);
+	do {
+		if (factor == DNS_ADB_RTTADJAGE) {
+			new_srtt = (uint64_t)old_srtt * 98 / 100;
+		} else {
+			new_srtt = ((uint64_t)old_srtt / 10 * factor) +
+				   ((uint64_t)rtt / 10 * (10 - factor));
+		}
+	} while (!atomic_compare_exchange_weak(&entry->srtt, &old_srtt,
+					       new_srtt));
+	addr->srtt = new_srtt;
+
+done:
+	(void)atomic_compare_exchange_strong(&entry->expires,
 					     &(isc_stdtime_t){ 0 },
 					     now + ADB_ENTRY_WINDOW);
 }
@@ -3092,7 +3124,7 @@ dns_adb_changeflags(dns_adb_t *adb, dns_adbaddrinfo_t *addr, unsigned int bits,
 	}
 
 	if (atomic_load(&entry->expires) == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 		atomic_store(&entry->expires, now + ADB_ENTRY_WINDOW);
 	}
 
@@ -3387,7 +3419,7 @@ dns_adb_freeaddrinfo(dns_adb_t *adb, dns_adbaddrinfo_t **addrp) {
 
 	REQUIRE(DNS_ADBENTRY_VALID(entry));
 
-	now = isc_stdtime_now();
+	now = isc_loop_stdtime();
 	(void)atomic_compare_exchange_strong(
 		&entry->expires, &(isc_stdtime_t){ 0 }, now + ADB_ENTRY_WINDOW);
 
@@ -20,6 +20,7 @@
 #include <isc/buffer.h>
 #include <isc/hash.h>
 #include <isc/log.h>
+#include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/refcount.h>
@@ -45,6 +46,7 @@ struct dns_badcache {
 	isc_mem_t *mctx;
 	struct cds_lfht *ht;
 	atomic_bool purge_in_progress;
+	_Atomic(isc_stdtime_t) last_purge;
 };
 
 #define BADCACHE_MAGIC	  ISC_MAGIC('B', 'd', 'C', 'a')
@@ -149,8 +151,8 @@ bcentry_evict(struct cds_lfht *ht, dns_bcentry_t *bad) {
 	 * The hashtable isn't locked in a traditional sense, so multiple
 	 * threads can lookup and evict the same record at the same time.
 	 *
-	 * This is amplified by the bcentry_purge_next() that walks a few more
-	 * records in the hashtable and evicts them if they are expired.
+	 * This is amplified by badcache_purge() that walks the whole
+	 * hashtable and evicts the records that have expired.
 	 *
 	 * We need to destroy the bcentry only once - from the thread that has
 	 * deleted the entry from the hashtable, all other calls to this
@@ -173,29 +175,31 @@ bcentry_alive(struct cds_lfht *ht, dns_bcentry_t *bad, isc_stdtime_t now) {
 	return (true);
 }
 
-#define cds_lfht_for_each_entry_next(ht, iter, pos, member)     \
-	for (cds_lfht_next(ht, iter),                           \
-	     pos = cds_lfht_entry(cds_lfht_iter_get_node(iter), \
-				  __typeof__(*(pos)), member);  \
-	     pos != NULL; /**/                                  \
-	     cds_lfht_next(ht, iter),                           \
-	     pos = cds_lfht_entry(cds_lfht_iter_get_node(iter), \
-				  __typeof__(*(pos)), member))
-
+/*
+ * Lazily purge the table of expired entries, at most once a second and
+ * from one thread at a time.  This is done when adding entries, so that
+ * lookups only ever evict the entries they find expired themselves.
+ * Must be called from within a RCU read-side critical section.
+ */
 static void
-bcentry_purge_next(struct cds_lfht *ht, struct cds_lfht_iter *iter,
-		   isc_stdtime_t now) {
-	/* Lazy-purge the table */
-	size_t count = 10;
-	dns_bcentry_t *bad;
-	cds_lfht_for_each_entry_next(ht, iter, bad, ht_node) {
-		if (!bcentry_alive(ht, bad, now)) {
-			break;
-		}
-		if (--count == 0) {
-			break;
-		}
+badcache_purge(dns_badcache_t *bc, struct cds_lfht *ht, isc_stdtime_t now) {
+	struct cds_lfht_iter iter;
+	dns_bcentry_t *bad = NULL;
+	bool expected = false;
+
+	if (atomic_load_relaxed(&bc->last_purge) >= now ||
+	    !atomic_compare_exchange_strong_acq_rel(&bc->purge_in_progress,
+						    &expected, true))
+	{
+		return;
+	}
+	atomic_store_relaxed(&bc->last_purge, now);
+
+	cds_lfht_for_each_entry(ht, &iter, bad, ht_node) {
+		(void)bcentry_alive(ht, bad, now);
 	}
+
+	atomic_store_release(&bc->purge_in_progress, false);
 }
 
 void
@@ -205,7 +209,7 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 	REQUIRE(VALID_BADCACHE(bc));
 	REQUIRE(name != NULL);
 
-	isc_stdtime_t now = isc_stdtime_now();
+	isc_stdtime_t now = isc_loop_stdtime();
 	if (expire < now) {
 		expire = now;
 	}
@@ -245,6 +249,8 @@ dns_badcache_add(dns_badcache_t *bc, const dns_name_t *name,
 		atomic_store_relaxed(&found->flags, flags);
 	}
 
+	badcache_purge(bc, ht, now);
+
 	rcu_read_unlock();
 }
 
@@ -277,8 +283,6 @@ dns_badcache_find(dns_badcache_t *bc, const dns_name_t *name,
 		if (flagp != NULL) {
 			*flagp = atomic_load_relaxed(&found->flags);
 		}
-
-		bcentry_purge_next(ht, &iter, now);
 	}
 
 	rcu_read_unlock();
@@ -16,24 +16,30 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/file.h>
 #include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/stats.h>
+#include <isc/stdio.h>
 #include <isc/string.h>
 #include <isc/time.h>
 #include <isc/timer.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/cache.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/fixedname.h>
 #include <dns/log.h>
 #include <dns/masterdump.h>
 #include <dns/rdata.h>
+#include <dns/rdatalist.h>
 #include <dns/rdataset.h>
 #include <dns/rdatasetiter.h>
+#include <dns/sigcache.h>
 #include <dns/stats.h>
 
 #ifdef HAVE_JSON_C
@@ -54,6 +60,19 @@
  */
 #define DNS_CACHE_MINSIZE 2097152U /*%< Bytes.  2097152 = 2 MB */
 
+/*
+ * DNS_CACHE_SIGCACHESIZE is how many verified signatures are
+ * remembered by the cache's signature cache.
+ */
+#define DNS_CACHE_SIGCACHESIZE 16384U
+
+/*
+ * A subtree is flushed in the thread pool, releasing the tree lock
+ * after every DNS_CACHE_FLUSHSLICE so that it does not hold up the
+ * threads adding to the cache.
+ */
+#define DNS_CACHE_FLUSHSLICE (10 * NS_PER_MS)
+
 /***
  ***	Types
  ***/
@@ -71,6 +90,7 @@ struct dns_cache {
 	isc_loop_t *loop;
 	char *name;
 	isc_refcount_t references;
+	dns_sigcache_t *sigcache;
 
 	/* Locked by 'lock'. */
 	dns_rdataclass_t rdclass;
@@ -121,8 +141,10 @@ dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
 	/*
 	 * This will be the main cache memory context, which is subject
 	 * to cleaning when the configured memory limits are exceeded.
+	 * Memory freed by cleaning or flushing is handed back to the
+	 * operating system within a second instead of being kept around.
 	 */
-	isc_mem_create(&mctx);
+	isc_mem_create_decay(&mctx, 1000, 0);
 	isc_mem_setname(mctx, "cache");
 
 	/*
@@ -131,7 +153,7 @@ dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
 	 * heavy load and could otherwise cause the cache to be cleaned too
 	 * aggressively.
 	 */
-	isc_mem_create(&hmctx);
+	isc_mem_create_decay(&hmctx, 1000, 0);
 	isc_mem_setname(hmctx, "cache_heap");
 
 	cache = isc_mem_get(mctx, sizeof(*cache));
@@ -149,6 +171,8 @@ dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
 
 	isc_stats_create(mctx, &cache->stats, dns_cachestatscounter_max);
 
+	cache->sigcache = dns_sigcache_new(mctx, DNS_CACHE_SIGCACHESIZE);
+
 	/*
 	 * Create the database
 	 */
@@ -175,6 +199,7 @@ dns_cache_create(isc_loopmgr_t *loopmgr, dns_rdataclass_t rdclass,
 cleanup_db:
 	dns_db_detach(&cache->db);
 cleanup_stats:
+	dns_sigcache_destroy(&cache->sigcache);
 	isc_stats_detach(&cache->stats);
 	isc_mutex_destroy(&cache->lock);
 	isc_mem_free(mctx, cache->name);
@@ -194,6 +219,7 @@ cache_free(dns_cache_t *cache) {
 	dns_db_detach(&cache->db);
 	isc_mem_free(cache->mctx, cache->name);
 	isc_stats_detach(&cache->stats);
+	dns_sigcache_destroy(&cache->sigcache);
 
 	isc_mutex_destroy(&cache->lock);
 
@@ -350,6 +376,8 @@ dns_cache_flush(dns_cache_t *cache) {
 
 	dns_db_detach(&olddb);
 
+	dns_sigcache_flush(cache->sigcache);
+
 	return (ISC_R_SUCCESS);
 }
 
@@ -394,6 +422,7 @@ cleartree(dns_db_t *db, const dns_name_t *name) {
 	dns_dbnode_t *node = NULL, *top = NULL;
 	dns_fixedname_t fnodename;
 	dns_name_t *nodename;
+	isc_nanosecs_t deadline = isc_time_monotonic() + DNS_CACHE_FLUSHSLICE;
 
 	/*
 	 * Create the node if it doesn't exist so dns_dbiterator_seek()
@@ -439,6 +468,12 @@ cleartree(dns_db_t *db, const dns_name_t *name) {
 			answer = result;
 		}
 		dns_db_detachnode(db, &node);
+
+		if (isc_time_monotonic() >= deadline) {
+			RUNTIME_CHECK(dns_dbiterator_pause(iter) ==
+				      ISC_R_SUCCESS);
+			deadline = isc_time_monotonic() + DNS_CACHE_FLUSHSLICE;
+		}
 		result = dns_dbiterator_next(iter);
 	}
 
@@ -462,6 +497,39 @@ cleanup:
 	return (answer);
 }
 
+typedef struct cleartree_ctx {
+	isc_mem_t *mctx;
+	dns_db_t *db;
+	dns_fixedname_t fixed;
+	dns_name_t *name;
+	isc_result_t result;
+} cleartree_ctx_t;
+
+static void
+cleartree_work(void *arg) {
+	cleartree_ctx_t *ctx = arg;
+
+	ctx->result = cleartree(ctx->db, ctx->name);
+}
+
+static void
+cleartree_done(void *arg) {
+	cleartree_ctx_t *ctx = arg;
+
+	if (ctx->result != ISC_R_SUCCESS) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+
+		dns_name_format(ctx->name, namebuf, sizeof(namebuf));
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_CACHE, ISC_LOG_ERROR,
+			      "flushing cache tree '%s': %s", namebuf,
+			      isc_result_totext(ctx->result));
+	}
+
+	dns_db_detach(&ctx->db);
+	isc_mem_putanddetach(&ctx->mctx, ctx, sizeof(*ctx));
+}
+
 isc_result_t
 dns_cache_flushname(dns_cache_t *cache, const dns_name_t *name) {
 	return (dns_cache_flushnode(cache, name, false));
@@ -486,23 +554,426 @@ dns_cache_flushnode(dns_cache_t *cache, const dns_name_t *name, bool tree) {
 		return (ISC_R_SUCCESS);
 	}
 
-	if (tree) {
-		result = cleartree(cache->db, name);
+	/*
+	 * The name itself is cleared at once.
+	 */
+	result = dns_db_findnode(db, name, false, &node);
+	if (result == ISC_R_SUCCESS) {
+		result = clearnode(db, node);
+		dns_db_detachnode(db, &node);
+	} else if (result == ISC_R_NOTFOUND) {
+		result = ISC_R_SUCCESS;
+	}
+
+	if (tree && result == ISC_R_SUCCESS) {
+		/*
+		 * The names below it may be many, so they are cleared
+		 * in the background.
+		 */
+		cleartree_ctx_t *ctx = isc_mem_get(cache->mctx, sizeof(*ctx));
+
+		*ctx = (cleartree_ctx_t){ .result = ISC_R_SUCCESS };
+		isc_mem_attach(cache->mctx, &ctx->mctx);
+		dns_db_attach(db, &ctx->db);
+		ctx->name = dns_fixedname_initname(&ctx->fixed);
+		dns_name_copy(name, ctx->name);
+
+		isc_work_enqueueclass(cache->loop, isc_workclass_bulk,
+				      cleartree_work, cleartree_done, ctx);
+	}
+
+	dns_db_detach(&db);
+	return (result);
+}
+
+/*
+ * Cache snapshots.  All integers are in network byte order.  The file
+ * starts with a header holding the magic number, the format version,
+ * the class and the time the snapshot was taken.  Each record that
+ * follows is prefixed with its length, and holds the owner name (a
+ * length byte and the name in wire format), type, covered type, the
+ * TTL that remained when the snapshot was taken, trust level and
+ * number of rdatas, and then each rdata with a 16-bit length prefix.
+ * A zero record length ends the file.
+ */
+#define SNAPSHOT_MAGIC	   0x424e4353U /* "BNCS" */
+#define SNAPSHOT_VERSION   1U
+#define SNAPSHOT_HEADERLEN 14
+#define SNAPSHOT_MAXRECORD 0x1000000U
+
+static isc_result_t
+snapshot_putrecord(FILE *f, isc_buffer_t *b) {
+	uint32_t len = isc_buffer_usedlength(b) - 4;
+	unsigned char *base = isc_buffer_base(b);
+
+	base[0] = len >> 24;
+	base[1] = len >> 16;
+	base[2] = len >> 8;
+	base[3] = len;
+
+	return (isc_stdio_write(base, isc_buffer_usedlength(b), 1, f, NULL));
+}
+
+static isc_result_t
+snapshot_node(dns_db_t *db, dns_dbnode_t *node, const dns_name_t *name,
+	      isc_stdtime_t now, isc_buffer_t *b, FILE *f) {
+	isc_result_t result;
+	dns_rdatasetiter_t *iter = NULL;
+	isc_region_t r;
+
+	result = dns_db_allrdatasets(db, node, NULL, 0, now, &iter);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	for (result = dns_rdatasetiter_first(iter); result == ISC_R_SUCCESS;
+	     result = dns_rdatasetiter_next(iter))
+	{
+		dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+
+		dns_rdatasetiter_current(iter, &rdataset);
+
+		/*
+		 * Negative and stale entries are not worth carrying
+		 * over a restart.
+		 */
+		if ((rdataset.attributes &
+		     (DNS_RDATASETATTR_NEGATIVE | DNS_RDATASETATTR_STALE |
+		      DNS_RDATASETATTR_ANCIENT)) != 0 ||
+		    rdataset.ttl == 0)
+		{
+			dns_rdataset_disassociate(&rdataset);
+			continue;
+		}
+
+		isc_buffer_clear(b);
+		isc_buffer_putuint32(b, 0);
+		dns_name_toregion(name, &r);
+		isc_buffer_putuint8(b, r.length);
+		isc_buffer_putmem(b, r.base, r.length);
+		isc_buffer_putuint16(b, rdataset.type);
+		isc_buffer_putuint16(b, rdataset.covers);
+		isc_buffer_putuint32(b, rdataset.ttl);
+		isc_buffer_putuint8(b, rdataset.trust);
+		isc_buffer_putuint16(b, dns_rdataset_count(&rdataset));
+		for (result = dns_rdataset_first(&rdataset);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdataset_next(&rdataset))
+		{
+			dns_rdata_t rdata = DNS_RDATA_INIT;
+
+			dns_rdataset_current(&rdataset, &rdata);
+			isc_buffer_putuint16(b, rdata.length);
+			isc_buffer_putmem(b, rdata.data, rdata.length);
+		}
+		dns_rdataset_disassociate(&rdataset);
+
+		result = snapshot_putrecord(f, b);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+	dns_rdatasetiter_destroy(&iter);
+	return (result);
+}
+
+isc_result_t
+dns_cache_save(dns_cache_t *cache, const char *filename) {
+	isc_result_t result, tresult;
+	dns_db_t *db = NULL;
+	dns_dbiterator_t *dbiter = NULL;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	isc_buffer_t *b = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+	char *tempname = NULL;
+	size_t tempnamelen;
+	FILE *f = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	tempnamelen = strlen(filename) + 20;
+	tempname = isc_mem_allocate(cache->mctx, tempnamelen);
+	result = isc_file_mktemplate(filename, tempname, tempnamelen);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_file_openunique(tempname, &f);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_free(cache->mctx, tempname);
+		return (result);
+	}
+
+	dns_cache_attachdb(cache, &db);
+	isc_buffer_allocate(cache->mctx, &b, 1024);
+
+	isc_buffer_putuint32(b, SNAPSHOT_MAGIC);
+	isc_buffer_putuint32(b, SNAPSHOT_VERSION);
+	isc_buffer_putuint16(b, cache->rdclass);
+	isc_buffer_putuint32(b, now);
+	result = isc_stdio_write(isc_buffer_base(b), isc_buffer_usedlength(b),
+				 1, f, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	result = dns_db_createiterator(db, 0, &dbiter);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	for (result = dns_dbiterator_first(dbiter); result == ISC_R_SUCCESS;
+	     result = dns_dbiterator_next(dbiter))
+	{
+		dns_dbnode_t *node = NULL;
+
+		result = dns_dbiterator_current(dbiter, &node, name);
+		if (result != ISC_R_SUCCESS && result != DNS_R_NEWORIGIN) {
+			break;
+		}
+		dns_dbiterator_pause(dbiter);
+
+		result = snapshot_node(db, node, name, now, b, f);
+		dns_db_detachnode(db, &node);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	dns_dbiterator_destroy(&dbiter);
+	if (result != ISC_R_NOMORE) {
+		goto cleanup;
+	}
+
+	isc_buffer_clear(b);
+	isc_buffer_putuint32(b, 0);
+	result = isc_stdio_write(isc_buffer_base(b), isc_buffer_usedlength(b),
+				 1, f, NULL);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_flush(f);
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = isc_stdio_sync(f);
+	}
+
+cleanup:
+	tresult = isc_stdio_close(f);
+	if (result == ISC_R_SUCCESS) {
+		result = tresult;
+	}
+	if (result == ISC_R_SUCCESS) {
+		result = isc_file_rename(tempname, filename);
 	} else {
-		result = dns_db_findnode(cache->db, name, false, &node);
-		if (result == ISC_R_NOTFOUND) {
-			result = ISC_R_SUCCESS;
-			goto cleanup_db;
+		(void)isc_file_remove(tempname);
+	}
+
+	isc_buffer_free(&b);
+	dns_db_detach(&db);
+	isc_mem_free(cache->mctx, tempname);
+	return (result);
+}
+
+static isc_result_t
+restore_record(dns_cache_t *cache, dns_db_t *db, isc_buffer_t *source,
+	       isc_buffer_t *target, isc_stdtime_t now, uint32_t elapsed) {
+	isc_result_t result;
+	dns_fixedname_t fixed;
+	dns_name_t *name = dns_fixedname_initname(&fixed);
+	dns_dbnode_t *node = NULL;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	dns_rdata_t *rdatas = NULL;
+	isc_buffer_t namebuf;
+	unsigned int namelen, count, i;
+	dns_trust_t trust;
+	uint32_t ttl;
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = cache->rdclass;
+
+	if (isc_buffer_remaininglength(source) < 1) {
+		return (DNS_R_FORMERR);
+	}
+	namelen = isc_buffer_getuint8(source);
+	if (isc_buffer_remaininglength(source) < namelen + 11) {
+		return (DNS_R_FORMERR);
+	}
+	isc_buffer_init(&namebuf, isc_buffer_current(source), namelen);
+	isc_buffer_add(&namebuf, namelen);
+	isc_buffer_setactive(&namebuf, namelen);
+	result = dns_name_fromwire(name, &namebuf, DNS_DECOMPRESS_NEVER, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	isc_buffer_forward(source, namelen);
+
+	rdatalist.type = isc_buffer_getuint16(source);
+	rdatalist.covers = isc_buffer_getuint16(source);
+	ttl = isc_buffer_getuint32(source);
+	trust = isc_buffer_getuint8(source);
+	count = isc_buffer_getuint16(source);
+	if (dns_rdatatype_ismeta(rdatalist.type) ||
+	    trust > dns_trust_ultimate || count == 0)
+	{
+		return (DNS_R_FORMERR);
+	}
+
+	/*
+	 * Drop what would have expired while we were not running.
+	 */
+	if (ttl <= elapsed) {
+		return (ISC_R_SUCCESS);
+	}
+	rdatalist.ttl = ttl - elapsed;
+
+	rdatas = isc_mem_cget(cache->mctx, count, sizeof(rdatas[0]));
+	for (i = 0; i < count; i++) {
+		isc_buffer_t rdatabuf;
+		unsigned int len;
+
+		dns_rdata_init(&rdatas[i]);
+		if (isc_buffer_remaininglength(source) < 2) {
+			result = DNS_R_FORMERR;
+			goto cleanup;
 		}
+		len = isc_buffer_getuint16(source);
+		if (isc_buffer_remaininglength(source) < len) {
+			result = DNS_R_FORMERR;
+			goto cleanup;
+		}
+		isc_buffer_init(&rdatabuf, isc_buffer_current(source), len);
+		isc_buffer_add(&rdatabuf, len);
+		isc_buffer_setactive(&rdatabuf, len);
+		result = dns_rdata_fromwire(&rdatas[i], cache->rdclass,
+					    rdatalist.type, &rdatabuf,
+					    DNS_DECOMPRESS_NEVER, target);
 		if (result != ISC_R_SUCCESS) {
-			goto cleanup_db;
+			goto cleanup;
 		}
-		result = clearnode(cache->db, node);
-		dns_db_detachnode(cache->db, &node);
+		isc_buffer_forward(source, len);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdatas[i], link);
 	}
 
-cleanup_db:
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = trust;
+
+	result = dns_db_findnode(db, name, true, &node);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0,
+					    NULL);
+		dns_db_detachnode(db, &node);
+	}
+	dns_rdataset_disassociate(&rdataset);
+
+	/*
+	 * The cache may already hold better data for this name.
+	 */
+	if (result == DNS_R_UNCHANGED) {
+		result = ISC_R_SUCCESS;
+	}
+
+cleanup:
+	isc_mem_cput(cache->mctx, rdatas, count, sizeof(rdatas[0]));
+	return (result);
+}
+
+isc_result_t
+dns_cache_restore(dns_cache_t *cache, const char *filename) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	isc_buffer_t *source = NULL, *target = NULL;
+	unsigned char header[SNAPSHOT_HEADERLEN];
+	isc_buffer_t hb;
+	isc_stdtime_t now = isc_stdtime_now(), saved;
+	uint32_t elapsed;
+	FILE *f = NULL;
+
+	REQUIRE(VALID_CACHE(cache));
+	REQUIRE(filename != NULL);
+
+	result = isc_stdio_open(filename, "rb", &f);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = isc_stdio_read(header, sizeof(header), 1, f, NULL);
+	if (result == ISC_R_EOF) {
+		result = ISC_R_UNEXPECTEDEND;
+	}
+	if (result != ISC_R_SUCCESS) {
+		goto close;
+	}
+	isc_buffer_init(&hb, header, sizeof(header));
+	isc_buffer_add(&hb, sizeof(header));
+	if (isc_buffer_getuint32(&hb) != SNAPSHOT_MAGIC ||
+	    isc_buffer_getuint32(&hb) != SNAPSHOT_VERSION)
+	{
+		result = ISC_R_NOTIMPLEMENTED;
+		goto close;
+	}
+	if (isc_buffer_getuint16(&hb) != cache->rdclass) {
+		result = DNS_R_BADCLASS;
+		goto close;
+	}
+	saved = isc_buffer_getuint32(&hb);
+	elapsed = (now > saved) ? now - saved : 0;
+
+	dns_cache_attachdb(cache, &db);
+	isc_buffer_allocate(cache->mctx, &source, 1024);
+	isc_buffer_allocate(cache->mctx, &target, 1024);
+
+	for (;;) {
+		unsigned char lenbuf[4];
+		uint32_t len;
+
+		result = isc_stdio_read(lenbuf, sizeof(lenbuf), 1, f, NULL);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		len = (uint32_t)lenbuf[0] << 24 | (uint32_t)lenbuf[1] << 16 |
+		      (uint32_t)lenbuf[2] << 8 | lenbuf[3];
+		if (len == 0) {
+			break;
+		}
+		if (len > SNAPSHOT_MAXRECORD) {
+			result = ISC_R_RANGE;
+			break;
+		}
+
+		isc_buffer_clear(source);
+		isc_buffer_clear(target);
+		result = isc_buffer_reserve(source, len);
+		if (result == ISC_R_SUCCESS) {
+			result = isc_buffer_reserve(target, len);
+		}
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		result = isc_stdio_read(isc_buffer_base(source), len, 1, f,
+					NULL);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		isc_buffer_add(source, len);
+
+		result = restore_record(cache, db, source, target, now,
+					elapsed);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	if (result == ISC_R_EOF) {
+		result = ISC_R_UNEXPECTEDEND;
+	}
+
+	isc_buffer_free(&target);
+	isc_buffer_free(&source);
 	dns_db_detach(&db);
+
+close:
+	(void)isc_stdio_close(f);
 	return (result);
 }
 
@@ -512,6 +983,12 @@ dns_cache_getstats(dns_cache_t *cache) {
 	return (cache->stats);
 }
 
+dns_sigcache_t *
+dns_cache_getsigcache(dns_cache_t *cache) {
+	REQUIRE(VALID_CACHE(cache));
+	return (cache->sigcache);
+}
+
 void
 dns_cache_updatestats(dns_cache_t *cache, isc_result_t result) {
 	REQUIRE(VALID_CACHE(cache));
@@ -19,6 +19,8 @@
 #include <stdlib.h>
 
 #include <isc/async.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
 #include <isc/hex.h>
 #include <isc/loop.h>
 #include <isc/md.h>
@@ -30,6 +32,7 @@
 
 #include <dns/catz.h>
 #include <dns/dbiterator.h>
+#include <dns/journal.h>
 #include <dns/rdatasetiter.h>
 #include <dns/view.h>
 #include <dns/zone.h>
@@ -52,6 +55,7 @@
 struct dns_catz_coo {
 	unsigned int magic;
 	dns_name_t name;
+	dns_name_t member; /* key in coos */
 	isc_refcount_t references;
 };
 
@@ -61,6 +65,8 @@ struct dns_catz_coo {
 struct dns_catz_entry {
 	unsigned int magic;
 	dns_name_t name;
+	/* key in entries: the wire format of the unique label */
+	unsigned char mhash[DNS_NAME_LABELLEN + 1];
 	dns_catz_options_t opts;
 	isc_refcount_t references;
 };
@@ -76,9 +82,9 @@ struct dns_catz_zone {
 	dns_rdata_t soa;
 	uint32_t version;
 	/* key in entries is 'mhash', not domain name! */
-	isc_ht_t *entries;
+	isc_hashmap_t *entries;
 	/* key in coos is domain name */
-	isc_ht_t *coos;
+	isc_hashmap_t *coos;
 
 	/*
 	 * defoptions are taken from named.conf
@@ -95,6 +101,8 @@ struct dns_catz_zone {
 	dns_dbversion_t *dbversion;   /* version we will be updating to */
 	dns_db_t *updb;		      /* zones database we're working on */
 	dns_dbversion_t *updbversion; /* version we're working on */
+	uint32_t serial;	      /* serial of the last merged version */
+	bool serialvalid;	      /* 'serial' can be used for IXFR */
 
 	isc_timer_t *updatetimer;
 
@@ -124,17 +132,16 @@ static isc_result_t
 catz_process_zones_suboption(dns_catz_zone_t *catz, dns_rdataset_t *value,
 			     dns_label_t *mhash, dns_name_t *name);
 static void
-catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_ht_t *ht, unsigned char *key,
-		      size_t keysize, dns_catz_entry_t *nentry,
-		      dns_catz_entry_t *oentry, const char *msg,
-		      const char *zname, const char *czname);
+catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_hashmap_t *map,
+		      dns_catz_entry_t *nentry, dns_catz_entry_t *oentry,
+		      const char *msg, const char *zname, const char *czname);
 
 /*%
  * Collection of catalog zones for a view
  */
 struct dns_catz_zones {
 	unsigned int magic;
-	isc_ht_t *zones;
+	isc_hashmap_t *zones;
 	isc_mem_t *mctx;
 	isc_refcount_t references;
 	isc_mutex_t lock;
@@ -144,6 +151,134 @@ struct dns_catz_zones {
 	atomic_bool shuttingdown;
 };
 
+/*
+ * Catalog zones are keyed by their names, member zone entries by the
+ * wire format of their unique label, and change of ownership records
+ * by the names of the member zones.
+ */
+static bool
+catz_zone_match(void *node, const void *key) {
+	return (dns_name_equal(&((dns_catz_zone_t *)node)->name, key));
+}
+
+static isc_result_t
+catz_zone_find(isc_hashmap_t *zones, const dns_name_t *name,
+	       dns_catz_zone_t **catzp) {
+	return (isc_hashmap_find(zones, dns_name_hash(name), catz_zone_match,
+				 name, (void **)catzp));
+}
+
+static bool
+catz_entry_match(void *node, const void *key) {
+	const unsigned char *mhash = key;
+
+	return (memcmp(((dns_catz_entry_t *)node)->mhash, mhash,
+		       mhash[0] + 1) == 0);
+}
+
+static uint32_t
+catz_mhash_hash(const unsigned char *mhash) {
+	return (isc_hash32(mhash, mhash[0] + 1, true));
+}
+
+static isc_result_t
+catz_entry_find(isc_hashmap_t *entries, const unsigned char *mhash,
+		dns_catz_entry_t **entryp) {
+	return (isc_hashmap_find(entries, catz_mhash_hash(mhash),
+				 catz_entry_match, mhash, (void **)entryp));
+}
+
+static void
+catz_entry_setmhash(dns_catz_entry_t *entry, const dns_label_t *mhash) {
+	REQUIRE(mhash->length > 0 && mhash->length <= sizeof(entry->mhash));
+	REQUIRE(mhash->base[0] + 1U == mhash->length);
+
+	memmove(entry->mhash, mhash->base, mhash->length);
+}
+
+static isc_result_t
+catz_entry_insert(isc_hashmap_t *entries, dns_catz_entry_t *entry) {
+	return (isc_hashmap_add(entries, catz_mhash_hash(entry->mhash),
+				catz_entry_match, entry->mhash, entry, NULL));
+}
+
+static isc_result_t
+catz_entry_delete(isc_hashmap_t *entries, const unsigned char *mhash) {
+	return (isc_hashmap_delete(entries, catz_mhash_hash(mhash),
+				   catz_entry_match, mhash));
+}
+
+static bool
+catz_coo_match(void *node, const void *key) {
+	return (dns_name_equal(&((dns_catz_coo_t *)node)->member, key));
+}
+
+static isc_result_t
+catz_coo_find(isc_hashmap_t *coos, const dns_name_t *member,
+	      dns_catz_coo_t **coop) {
+	return (isc_hashmap_find(coos, dns_name_hash(member), catz_coo_match,
+				 member, (void **)coop));
+}
+
+static isc_result_t
+catz_coo_insert(isc_hashmap_t *coos, dns_catz_coo_t *coo) {
+	return (isc_hashmap_add(coos, dns_name_hash(&coo->member),
+				catz_coo_match, &coo->member, coo, NULL));
+}
+
+static isc_result_t
+catz_coo_delete(isc_hashmap_t *coos, const dns_name_t *member) {
+	return (isc_hashmap_delete(coos, dns_name_hash(member), catz_coo_match,
+				   member));
+}
+
+/*
+ * Sets of member zone names, used when updating from the journal.
+ */
+static bool
+catz_member_match(void *node, const void *key) {
+	return (dns_name_caseequal(node, key));
+}
+
+static void
+catz_members_add(isc_mem_t *mctx, isc_hashmap_t *members,
+		 const dns_name_t *name) {
+	isc_result_t result;
+	dns_name_t *member = NULL;
+
+	if (isc_hashmap_find(members, dns_name_hash(name), catz_member_match,
+			     name, NULL) == ISC_R_SUCCESS)
+	{
+		return;
+	}
+
+	member = isc_mem_get(mctx, sizeof(*member));
+	dns_name_init(member, NULL);
+	dns_name_dup(name, mctx, member);
+	result = isc_hashmap_add(members, dns_name_hash(member),
+				 catz_member_match, member, member, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+}
+
+static void
+catz_members_destroy(isc_mem_t *mctx, isc_hashmap_t **membersp) {
+	isc_result_t result;
+	isc_hashmap_iter_t *iter = NULL;
+
+	isc_hashmap_iter_create(*membersp, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;)
+	{
+		dns_name_t *member = NULL;
+
+		isc_hashmap_iter_current(iter, (void **)&member);
+		result = isc_hashmap_iter_delcurrent_next(iter);
+		dns_name_free(member, mctx);
+		isc_mem_put(mctx, member, sizeof(*member));
+	}
+	isc_hashmap_iter_destroy(&iter);
+	isc_hashmap_destroy(membersp);
+}
+
 void
 dns_catz_options_init(dns_catz_options_t *options) {
 	REQUIRE(options != NULL);
@@ -241,8 +376,10 @@ dns_catz_options_setdefault(isc_mem_t *mctx, const dns_catz_options_t *defaults,
 }
 
 static dns_catz_coo_t *
-catz_coo_new(isc_mem_t *mctx, const dns_name_t *domain) {
+catz_coo_new(isc_mem_t *mctx, const dns_name_t *member,
+	     const dns_name_t *domain) {
 	REQUIRE(mctx != NULL);
+	REQUIRE(member != NULL);
 	REQUIRE(domain != NULL);
 
 	dns_catz_coo_t *ncoo = isc_mem_get(mctx, sizeof(*ncoo));
@@ -251,6 +388,8 @@ catz_coo_new(isc_mem_t *mctx, const dns_name_t *domain) {
 	};
 	dns_name_init(&ncoo->name, NULL);
 	dns_name_dup(domain, mctx, &ncoo->name);
+	dns_name_init(&ncoo->member, NULL);
+	dns_name_dup(member, mctx, &ncoo->member);
 	isc_refcount_init(&ncoo->references, 1);
 
 	return (ncoo);
@@ -272,10 +411,33 @@ catz_coo_detach(dns_catz_zone_t *catz, dns_catz_coo_t **coop) {
 		if (dns_name_dynamic(&coo->name)) {
 			dns_name_free(&coo->name, mctx);
 		}
+		dns_name_free(&coo->member, mctx);
 		isc_mem_put(mctx, coo, sizeof(*coo));
 	}
 }
 
+static void
+catz_coos_destroy(dns_catz_zone_t *catz) {
+	isc_hashmap_iter_t *iter = NULL;
+	isc_result_t result;
+
+	isc_hashmap_iter_create(catz->coos, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;)
+	{
+		dns_catz_coo_t *coo = NULL;
+
+		isc_hashmap_iter_current(iter, (void **)&coo);
+		result = isc_hashmap_iter_delcurrent_next(iter);
+		catz_coo_detach(catz, &coo);
+	}
+	INSIST(result == ISC_R_NOMORE);
+	isc_hashmap_iter_destroy(&iter);
+
+	/* The hashmap has to be empty now. */
+	INSIST(isc_hashmap_count(catz->coos) == 0);
+	isc_hashmap_destroy(&catz->coos);
+}
+
 static void
 catz_coo_add(dns_catz_zone_t *catz, dns_catz_entry_t *entry,
 	     const dns_name_t *domain) {
@@ -285,12 +447,10 @@ catz_coo_add(dns_catz_zone_t *catz, dns_catz_entry_t *entry,
 
 	/* We are write locked, so the add must succeed if not found */
 	dns_catz_coo_t *coo = NULL;
-	isc_result_t result = isc_ht_find(catz->coos, entry->name.ndata,
-					  entry->name.length, (void **)&coo);
+	isc_result_t result = catz_coo_find(catz->coos, &entry->name, &coo);
 	if (result != ISC_R_SUCCESS) {
-		coo = catz_coo_new(catz->catzs->mctx, domain);
-		result = isc_ht_add(catz->coos, entry->name.ndata,
-				    entry->name.length, coo);
+		coo = catz_coo_new(catz->catzs->mctx, &entry->name, domain);
+		result = catz_coo_insert(catz->coos, coo);
 	}
 	INSIST(result == ISC_R_SUCCESS);
 }
@@ -330,6 +490,7 @@ dns_catz_entry_copy(dns_catz_zone_t *catz, const dns_catz_entry_t *entry) {
 						      &entry->name);
 
 	dns_catz_options_copy(catz->catzs->mctx, &entry->opts, &nentry->opts);
+	memmove(nentry->mhash, entry->mhash, sizeof(nentry->mhash));
 
 	return (nentry);
 }
@@ -479,6 +640,76 @@ dns_catz_zone_resetdefoptions(dns_catz_zone_t *catz) {
 	dns_catz_options_init(&catz->defoptions);
 }
 
+/*%<
+ * Look up the member zone of 'nentry' in the view.  If it currently
+ * belongs to another catalog zone that allows a change of ownership to
+ * 'catz', delete it from there.  The catalog zone that owns the member
+ * zone is returned in '*parentcatzp'.
+ *
+ * Requires 'catz->lock' to be held; it is released and reacquired
+ * while the other catalog zone is locked.
+ */
+static isc_result_t
+catz_entry_findzone(dns_catz_zone_t *catz, dns_catz_entry_t *nentry,
+		    const char *zname, const char *czname,
+		    dns_catz_zone_t **parentcatzp) {
+	isc_result_t result, find_result;
+	dns_catz_zone_t *parentcatz = NULL;
+	dns_catz_zoneop_fn_t delzone = catz->catzs->zmm->delzone;
+	dns_zone_t *zone = NULL;
+
+	/* Try to find the zone in the view */
+	find_result = dns_view_findzone(catz->catzs->view,
+					dns_catz_entry_getname(nentry),
+					DNS_ZTFIND_EXACT, &zone);
+	if (find_result == ISC_R_SUCCESS) {
+		dns_catz_coo_t *coo = NULL;
+		char pczname[DNS_NAME_FORMATSIZE];
+		bool parentcatz_locked = false;
+
+		/*
+		 * Change of ownership (coo) processing, if required
+		 */
+		parentcatz = dns_zone_get_parentcatz(zone);
+		if (parentcatz != NULL && parentcatz != catz) {
+			UNLOCK(&catz->lock);
+			LOCK(&parentcatz->lock);
+			parentcatz_locked = true;
+		}
+		if (parentcatz_locked &&
+		    catz_coo_find(parentcatz->coos, &nentry->name, &coo) ==
+			    ISC_R_SUCCESS &&
+		    dns_name_equal(&coo->name, &catz->name))
+		{
+			dns_name_format(&parentcatz->name, pczname,
+					DNS_NAME_FORMATSIZE);
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(3),
+				      "catz: zone '%s' "
+				      "change of ownership from "
+				      "'%s' to '%s'",
+				      zname, pczname, czname);
+			result = delzone(nentry, parentcatz,
+					 parentcatz->catzs->view,
+					 parentcatz->catzs->zmm->udata);
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_INFO,
+				      "catz: deleting zone '%s' "
+				      "from catalog '%s' - %s",
+				      zname, pczname,
+				      isc_result_totext(result));
+		}
+		if (parentcatz_locked) {
+			UNLOCK(&parentcatz->lock);
+			LOCK(&catz->lock);
+		}
+		dns_zone_detach(&zone);
+	}
+
+	*parentcatzp = parentcatz;
+	return (find_result);
+}
+
 /*%<
  * Merge 'newcatz' into 'catz', calling addzone/delzone/modzone
  * (from catz->catzs->zmm) for appropriate member zones.
@@ -491,9 +722,9 @@ dns_catz_zone_resetdefoptions(dns_catz_zone_t *catz) {
 static isc_result_t
 dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	isc_result_t result;
-	isc_ht_iter_t *iter1 = NULL, *iter2 = NULL;
-	isc_ht_iter_t *iteradd = NULL, *itermod = NULL;
-	isc_ht_t *toadd = NULL, *tomod = NULL;
+	isc_hashmap_iter_t *iter1 = NULL, *iter2 = NULL;
+	isc_hashmap_iter_t *iteradd = NULL, *itermod = NULL;
+	isc_hashmap_t *toadd = NULL, *tomod = NULL;
 	bool delcur = false;
 	char czname[DNS_NAME_FORMATSIZE];
 	char zname[DNS_NAME_FORMATSIZE];
@@ -520,37 +751,33 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 
 	dns_name_format(&catz->name, czname, DNS_NAME_FORMATSIZE);
 
-	isc_ht_init(&toadd, catz->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
-	isc_ht_init(&tomod, catz->catzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
-	isc_ht_iter_create(newcatz->entries, &iter1);
-	isc_ht_iter_create(catz->entries, &iter2);
+	isc_hashmap_create(catz->catzs->mctx, 1, &toadd);
+	isc_hashmap_create(catz->catzs->mctx, 1, &tomod);
+	isc_hashmap_iter_create(newcatz->entries, &iter1);
+	isc_hashmap_iter_create(catz->entries, &iter2);
 
 	/*
 	 * We can create those iterators now, even though toadd and tomod are
 	 * empty
 	 */
-	isc_ht_iter_create(toadd, &iteradd);
-	isc_ht_iter_create(tomod, &itermod);
+	isc_hashmap_iter_create(toadd, &iteradd);
+	isc_hashmap_iter_create(tomod, &itermod);
 
 	/*
 	 * First - walk the new zone and find all nodes that are not in the
 	 * old zone, or are in both zones and are modified.
 	 */
-	for (result = isc_ht_iter_first(iter1); result == ISC_R_SUCCESS;
-	     result = delcur ? isc_ht_iter_delcurrent_next(iter1)
-			     : isc_ht_iter_next(iter1))
+	for (result = isc_hashmap_iter_first(iter1); result == ISC_R_SUCCESS;
+	     result = delcur ? isc_hashmap_iter_delcurrent_next(iter1)
+			     : isc_hashmap_iter_next(iter1))
 	{
 		isc_result_t find_result;
 		dns_catz_zone_t *parentcatz = NULL;
 		dns_catz_entry_t *nentry = NULL;
 		dns_catz_entry_t *oentry = NULL;
-		dns_zone_t *zone = NULL;
-		unsigned char *key = NULL;
-		size_t keysize;
 		delcur = false;
 
-		isc_ht_iter_current(iter1, (void **)&nentry);
-		isc_ht_iter_currentkey(iter1, &key, &keysize);
+		isc_hashmap_iter_current(iter1, (void **)&nentry);
 
 		/*
 		 * Spurious record that came from suboption without main
@@ -572,60 +799,11 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 		dns_catz_options_setdefault(catz->catzs->mctx,
 					    &catz->zoneoptions, &nentry->opts);
 
-		/* Try to find the zone in the view */
-		find_result = dns_view_findzone(catz->catzs->view,
-						dns_catz_entry_getname(nentry),
-						DNS_ZTFIND_EXACT, &zone);
-		if (find_result == ISC_R_SUCCESS) {
-			dns_catz_coo_t *coo = NULL;
-			char pczname[DNS_NAME_FORMATSIZE];
-			bool parentcatz_locked = false;
-
-			/*
-			 * Change of ownership (coo) processing, if required
-			 */
-			parentcatz = dns_zone_get_parentcatz(zone);
-			if (parentcatz != NULL && parentcatz != catz) {
-				UNLOCK(&catz->lock);
-				LOCK(&parentcatz->lock);
-				parentcatz_locked = true;
-			}
-			if (parentcatz_locked &&
-			    isc_ht_find(parentcatz->coos, nentry->name.ndata,
-					nentry->name.length,
-					(void **)&coo) == ISC_R_SUCCESS &&
-			    dns_name_equal(&coo->name, &catz->name))
-			{
-				dns_name_format(&parentcatz->name, pczname,
-						DNS_NAME_FORMATSIZE);
-				isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_MASTER,
-					      ISC_LOG_DEBUG(3),
-					      "catz: zone '%s' "
-					      "change of ownership from "
-					      "'%s' to '%s'",
-					      zname, pczname, czname);
-				result = delzone(nentry, parentcatz,
-						 parentcatz->catzs->view,
-						 parentcatz->catzs->zmm->udata);
-				isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_MASTER,
-					      ISC_LOG_INFO,
-					      "catz: deleting zone '%s' "
-					      "from catalog '%s' - %s",
-					      zname, pczname,
-					      isc_result_totext(result));
-			}
-			if (parentcatz_locked) {
-				UNLOCK(&parentcatz->lock);
-				LOCK(&catz->lock);
-			}
-			dns_zone_detach(&zone);
-		}
+		find_result = catz_entry_findzone(catz, nentry, zname, czname,
+						  &parentcatz);
 
 		/* Try to find the zone in the old catalog zone */
-		result = isc_ht_find(catz->entries, key, (uint32_t)keysize,
-				     (void **)&oentry);
+		result = catz_entry_find(catz->entries, nentry->mhash, &oentry);
 		if (result != ISC_R_SUCCESS) {
 			if (find_result == ISC_R_SUCCESS && parentcatz == catz)
 			{
@@ -649,8 +827,8 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 					      zname);
 			}
 
-			catz_entry_add_or_mod(catz, toadd, key, keysize, nentry,
-					      NULL, "adding", zname, czname);
+			catz_entry_add_or_mod(catz, toadd, nentry, NULL,
+					      "adding", zname, czname);
 			continue;
 		}
 
@@ -660,15 +838,14 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 				      "catz: zone '%s' was expected to exist "
 				      "but can not be found, will be restored",
 				      zname);
-			catz_entry_add_or_mod(catz, toadd, key, keysize, nentry,
-					      oentry, "adding", zname, czname);
+			catz_entry_add_or_mod(catz, toadd, nentry, oentry,
+					      "adding", zname, czname);
 			continue;
 		}
 
 		if (dns_catz_entry_cmp(oentry, nentry) != true) {
-			catz_entry_add_or_mod(catz, tomod, key, keysize, nentry,
-					      oentry, "modifying", zname,
-					      czname);
+			catz_entry_add_or_mod(catz, tomod, nentry, oentry,
+					      "modifying", zname, czname);
 			continue;
 		}
 
@@ -676,21 +853,20 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 		 * Delete the old entry so that it won't accidentally be
 		 * removed as a non-existing entry below.
 		 */
-		dns_catz_entry_detach(catz, &oentry);
-		result = isc_ht_delete(catz->entries, key, (uint32_t)keysize);
+		result = catz_entry_delete(catz->entries, nentry->mhash);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		dns_catz_entry_detach(catz, &oentry);
 	}
 	RUNTIME_CHECK(result == ISC_R_NOMORE);
-	isc_ht_iter_destroy(&iter1);
+	isc_hashmap_iter_destroy(&iter1);
 
 	/*
 	 * Then - walk the old zone; only deleted entries should remain.
 	 */
-	for (result = isc_ht_iter_first(iter2); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(iter2))
+	for (result = isc_hashmap_iter_first(iter2); result == ISC_R_SUCCESS;)
 	{
 		dns_catz_entry_t *entry = NULL;
-		isc_ht_iter_current(iter2, (void **)&entry);
+		isc_hashmap_iter_current(iter2, (void **)&entry);
 
 		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
 		result = delzone(entry, catz, catz->catzs->view,
@@ -699,19 +875,20 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 			      DNS_LOGMODULE_MASTER, ISC_LOG_INFO,
 			      "catz: deleting zone '%s' from catalog '%s' - %s",
 			      zname, czname, isc_result_totext(result));
+		result = isc_hashmap_iter_delcurrent_next(iter2);
 		dns_catz_entry_detach(catz, &entry);
 	}
 	RUNTIME_CHECK(result == ISC_R_NOMORE);
-	isc_ht_iter_destroy(&iter2);
+	isc_hashmap_iter_destroy(&iter2);
 	/* At this moment catz->entries has to be be empty. */
-	INSIST(isc_ht_count(catz->entries) == 0);
-	isc_ht_destroy(&catz->entries);
+	INSIST(isc_hashmap_count(catz->entries) == 0);
+	isc_hashmap_destroy(&catz->entries);
 
-	for (result = isc_ht_iter_first(iteradd); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(iteradd))
+	for (result = isc_hashmap_iter_first(iteradd); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_delcurrent_next(iteradd))
 	{
 		dns_catz_entry_t *entry = NULL;
-		isc_ht_iter_current(iteradd, (void **)&entry);
+		isc_hashmap_iter_current(iteradd, (void **)&entry);
 
 		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
 		result = addzone(entry, catz, catz->catzs->view,
@@ -723,11 +900,11 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 			      zname, czname, isc_result_totext(result));
 	}
 
-	for (result = isc_ht_iter_first(itermod); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(itermod))
+	for (result = isc_hashmap_iter_first(itermod); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_delcurrent_next(itermod))
 	{
 		dns_catz_entry_t *entry = NULL;
-		isc_ht_iter_current(itermod, (void **)&entry);
+		isc_hashmap_iter_current(itermod, (void **)&entry);
 
 		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
 		result = modzone(entry, catz, catz->catzs->view,
@@ -747,38 +924,210 @@ dns__catz_zones_merge(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz) {
 	 * records with the new ones, just replace them.
 	 */
 	if (catz->coos != NULL && newcatz->coos != NULL) {
-		isc_ht_iter_t *iter = NULL;
+		catz_coos_destroy(catz);
+
+		catz->coos = newcatz->coos;
+		newcatz->coos = NULL;
+	}
+
+	result = ISC_R_SUCCESS;
+
+	isc_hashmap_iter_destroy(&iteradd);
+	isc_hashmap_iter_destroy(&itermod);
+	isc_hashmap_destroy(&toadd);
+	isc_hashmap_destroy(&tomod);
+
+	UNLOCK(&catz->lock);
+
+	return (result);
+}
+
+/*%<
+ * Like dns__catz_zones_merge(), but only for the member zones whose
+ * names are the keys in 'changed'.  'newcatz' holds the current
+ * entries and change of ownership records of those member zones;
+ * all the other entries and the zone options of 'catz' are kept.
+ *
+ * Requires:
+ * \li	'catz' is a valid dns_catz_zone_t.
+ * \li	'newcatz' is a valid dns_catz_zone_t.
+ * \li	'changed' is a valid hashmap of member zone names.
+ */
+static void
+dns__catz_zones_merge_changed(dns_catz_zone_t *catz, dns_catz_zone_t *newcatz,
+			      isc_hashmap_t *changed) {
+	isc_result_t result;
+	isc_hashmap_iter_t *iter = NULL, *iteradd = NULL, *itermod = NULL;
+	isc_hashmap_t *toadd = NULL, *tomod = NULL;
+	char czname[DNS_NAME_FORMATSIZE];
+	char zname[DNS_NAME_FORMATSIZE];
+	dns_catz_zoneop_fn_t addzone, modzone, delzone;
+
+	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
+	REQUIRE(DNS_CATZ_ZONE_VALID(newcatz));
+	REQUIRE(changed != NULL);
+
+	LOCK(&catz->lock);
+
+	addzone = catz->catzs->zmm->addzone;
+	modzone = catz->catzs->zmm->modzone;
+	delzone = catz->catzs->zmm->delzone;
+
+	dns_name_format(&catz->name, czname, DNS_NAME_FORMATSIZE);
 
-		isc_ht_iter_create(catz->coos, &iter);
-		for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
-		     result = isc_ht_iter_delcurrent_next(iter))
+	isc_hashmap_create(catz->catzs->mctx, 1, &toadd);
+	isc_hashmap_create(catz->catzs->mctx, 1, &tomod);
+
+	isc_hashmap_iter_create(changed, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(iter))
+	{
+		isc_result_t find_result;
+		dns_catz_zone_t *parentcatz = NULL;
+		dns_catz_entry_t *nentry = NULL;
+		dns_catz_entry_t *oentry = NULL;
+		dns_catz_coo_t *coo = NULL;
+		dns_name_t *member = NULL;
+		dns_label_t mhash;
+
+		isc_hashmap_iter_current(iter, (void **)&member);
+		dns_name_getlabel(member, 0, &mhash);
+
+		(void)catz_entry_find(newcatz->entries, mhash.base, &nentry);
+		if (nentry != NULL && dns_name_countlabels(&nentry->name) == 0)
 		{
-			dns_catz_coo_t *coo = NULL;
+			/* Suboptions without the member zone record. */
+			nentry = NULL;
+		}
+		(void)catz_entry_find(catz->entries, mhash.base, &oentry);
 
-			isc_ht_iter_current(iter, (void **)&coo);
+		/*
+		 * Replace the change of ownership record of the member zone.
+		 */
+		if (oentry != NULL &&
+		    catz_coo_find(catz->coos, &oentry->name, &coo) ==
+			    ISC_R_SUCCESS)
+		{
+			result = catz_coo_delete(catz->coos, &oentry->name);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
 			catz_coo_detach(catz, &coo);
 		}
-		INSIST(result == ISC_R_NOMORE);
-		isc_ht_iter_destroy(&iter);
+		if (nentry != NULL &&
+		    catz_coo_find(newcatz->coos, &nentry->name, &coo) ==
+			    ISC_R_SUCCESS)
+		{
+			result = catz_coo_delete(newcatz->coos, &nentry->name);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			result = catz_coo_insert(catz->coos, coo);
+			if (result != ISC_R_SUCCESS) {
+				catz_coo_detach(catz, &coo);
+			}
+		}
 
-		/* The hashtable has to be empty now. */
-		INSIST(isc_ht_count(catz->coos) == 0);
-		isc_ht_destroy(&catz->coos);
+		if (nentry == NULL) {
+			if (oentry == NULL) {
+				continue;
+			}
 
-		catz->coos = newcatz->coos;
-		newcatz->coos = NULL;
+			dns_name_format(&oentry->name, zname,
+					DNS_NAME_FORMATSIZE);
+			result = delzone(oentry, catz, catz->catzs->view,
+					 catz->catzs->zmm->udata);
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_INFO,
+				      "catz: deleting zone '%s' from catalog "
+				      "'%s' - %s",
+				      zname, czname, isc_result_totext(result));
+			result = catz_entry_delete(catz->entries, mhash.base);
+			RUNTIME_CHECK(result == ISC_R_SUCCESS);
+			dns_catz_entry_detach(catz, &oentry);
+			continue;
+		}
+
+		/* The entry now belongs to this function. */
+		result = catz_entry_delete(newcatz->entries, mhash.base);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		dns_name_format(&nentry->name, zname, DNS_NAME_FORMATSIZE);
+		dns_catz_options_setdefault(catz->catzs->mctx,
+					    &catz->zoneoptions, &nentry->opts);
+
+		find_result = catz_entry_findzone(catz, nentry, zname, czname,
+						  &parentcatz);
+
+		if (oentry == NULL || find_result != ISC_R_SUCCESS) {
+			if (oentry == NULL && find_result == ISC_R_SUCCESS &&
+			    parentcatz == catz)
+			{
+				isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+					      DNS_LOGMODULE_MASTER,
+					      ISC_LOG_INFO,
+					      "catz: zone '%s' unique label "
+					      "has changed, reset state",
+					      zname);
+			}
+			catz_entry_add_or_mod(catz, toadd, nentry, oentry,
+					      "adding", zname, czname);
+			continue;
+		}
+
+		if (dns_catz_entry_cmp(oentry, nentry) != true) {
+			catz_entry_add_or_mod(catz, tomod, nentry, oentry,
+					      "modifying", zname, czname);
+			continue;
+		}
+
+		dns_catz_entry_detach(catz, &nentry);
 	}
+	RUNTIME_CHECK(result == ISC_R_NOMORE);
+	isc_hashmap_iter_destroy(&iter);
 
-	result = ISC_R_SUCCESS;
+	isc_hashmap_iter_create(toadd, &iteradd);
+	for (result = isc_hashmap_iter_first(iteradd); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_delcurrent_next(iteradd))
+	{
+		dns_catz_entry_t *entry = NULL;
 
-	isc_ht_iter_destroy(&iteradd);
-	isc_ht_iter_destroy(&itermod);
-	isc_ht_destroy(&toadd);
-	isc_ht_destroy(&tomod);
+		isc_hashmap_iter_current(iteradd, (void **)&entry);
 
-	UNLOCK(&catz->lock);
+		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
+		result = addzone(entry, catz, catz->catzs->view,
+				 catz->catzs->zmm->udata);
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_INFO,
+			      "catz: adding zone '%s' from catalog "
+			      "'%s' - %s",
+			      zname, czname, isc_result_totext(result));
+		result = catz_entry_insert(catz->entries, entry);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	isc_hashmap_iter_destroy(&iteradd);
 
-	return (result);
+	isc_hashmap_iter_create(tomod, &itermod);
+	for (result = isc_hashmap_iter_first(itermod); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_delcurrent_next(itermod))
+	{
+		dns_catz_entry_t *entry = NULL;
+
+		isc_hashmap_iter_current(itermod, (void **)&entry);
+
+		dns_name_format(&entry->name, zname, DNS_NAME_FORMATSIZE);
+		result = modzone(entry, catz, catz->catzs->view,
+				 catz->catzs->zmm->udata);
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_INFO,
+			      "catz: modifying zone '%s' from catalog "
+			      "'%s' - %s",
+			      zname, czname, isc_result_totext(result));
+		result = catz_entry_insert(catz->entries, entry);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	}
+	isc_hashmap_iter_destroy(&itermod);
+
+	isc_hashmap_destroy(&toadd);
+	isc_hashmap_destroy(&tomod);
+
+	UNLOCK(&catz->lock);
 }
 
 dns_catz_zones_t *
@@ -795,7 +1144,7 @@ dns_catz_zones_new(isc_mem_t *mctx, isc_loopmgr_t *loopmgr,
 
 	isc_mutex_init(&catzs->lock);
 	isc_refcount_init(&catzs->references, 1);
-	isc_ht_init(&catzs->zones, mctx, 4, ISC_HT_CASE_SENSITIVE);
+	isc_hashmap_create(mctx, 4, &catzs->zones);
 	isc_mem_attach(mctx, &catzs->mctx);
 
 	return (catzs);
@@ -824,8 +1173,8 @@ dns_catz_zone_new(dns_catz_zones_t *catzs, const dns_name_t *name) {
 	dns_catz_zones_attach(catzs, &catz->catzs);
 	isc_mutex_init(&catz->lock);
 	isc_refcount_init(&catz->references, 1);
-	isc_ht_init(&catz->entries, catzs->mctx, 4, ISC_HT_CASE_SENSITIVE);
-	isc_ht_init(&catz->coos, catzs->mctx, 4, ISC_HT_CASE_INSENSITIVE);
+	isc_hashmap_create(catzs->mctx, 4, &catz->entries);
+	isc_hashmap_create(catzs->mctx, 4, &catz->coos);
 	isc_time_settoepoch(&catz->lastupdated);
 	dns_catz_options_init(&catz->defoptions);
 	dns_catz_options_init(&catz->zoneoptions);
@@ -904,8 +1253,7 @@ dns_catz_zone_add(dns_catz_zones_t *catzs, const dns_name_t *name,
 	INSIST(catzs->zones != NULL);
 	INSIST(!atomic_load(&catzs->shuttingdown));
 
-	result = isc_ht_find(catzs->zones, name->ndata, name->length,
-			     (void **)&catz);
+	result = catz_zone_find(catzs->zones, name, &catz);
 	switch (result) {
 	case ISC_R_SUCCESS:
 		INSIST(!catz->active);
@@ -915,8 +1263,10 @@ dns_catz_zone_add(dns_catz_zones_t *catzs, const dns_name_t *name,
 	case ISC_R_NOTFOUND:
 		catz = dns_catz_zone_new(catzs, name);
 
-		result = isc_ht_add(catzs->zones, catz->name.ndata,
-				    catz->name.length, catz);
+		result = isc_hashmap_add(catzs->zones,
+					 dns_name_hash(&catz->name),
+					 catz_zone_match, &catz->name, catz,
+					 NULL);
 		INSIST(result == ISC_R_SUCCESS);
 		break;
 	default:
@@ -943,8 +1293,7 @@ dns_catz_zone_get(dns_catz_zones_t *catzs, const dns_name_t *name) {
 		UNLOCK(&catzs->lock);
 		return (NULL);
 	}
-	result = isc_ht_find(catzs->zones, name->ndata, name->length,
-			     (void **)&found);
+	result = catz_zone_find(catzs->zones, name, &found);
 	UNLOCK(&catzs->lock);
 	if (result != ISC_R_SUCCESS) {
 		return (NULL);
@@ -971,42 +1320,27 @@ dns__catz_zone_destroy(dns_catz_zone_t *catz) {
 	isc_mem_t *mctx = catz->catzs->mctx;
 
 	if (catz->entries != NULL) {
-		isc_ht_iter_t *iter = NULL;
+		isc_hashmap_iter_t *iter = NULL;
 		isc_result_t result;
-		isc_ht_iter_create(catz->entries, &iter);
-		for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
-		     result = isc_ht_iter_delcurrent_next(iter))
+		isc_hashmap_iter_create(catz->entries, &iter);
+		for (result = isc_hashmap_iter_first(iter);
+		     result == ISC_R_SUCCESS;)
 		{
 			dns_catz_entry_t *entry = NULL;
 
-			isc_ht_iter_current(iter, (void **)&entry);
+			isc_hashmap_iter_current(iter, (void **)&entry);
+			result = isc_hashmap_iter_delcurrent_next(iter);
 			dns_catz_entry_detach(catz, &entry);
 		}
 		INSIST(result == ISC_R_NOMORE);
-		isc_ht_iter_destroy(&iter);
+		isc_hashmap_iter_destroy(&iter);
 
-		/* The hashtable has to be empty now. */
-		INSIST(isc_ht_count(catz->entries) == 0);
-		isc_ht_destroy(&catz->entries);
+		/* The hashmap has to be empty now. */
+		INSIST(isc_hashmap_count(catz->entries) == 0);
+		isc_hashmap_destroy(&catz->entries);
 	}
 	if (catz->coos != NULL) {
-		isc_ht_iter_t *iter = NULL;
-		isc_result_t result;
-		isc_ht_iter_create(catz->coos, &iter);
-		for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
-		     result = isc_ht_iter_delcurrent_next(iter))
-		{
-			dns_catz_coo_t *coo = NULL;
-
-			isc_ht_iter_current(iter, (void **)&coo);
-			catz_coo_detach(catz, &coo);
-		}
-		INSIST(result == ISC_R_NOMORE);
-		isc_ht_iter_destroy(&iter);
-
-		/* The hashtable has to be empty now. */
-		INSIST(isc_ht_count(catz->coos) == 0);
-		isc_ht_destroy(&catz->coos);
+		catz_coos_destroy(catz);
 	}
 	catz->magic = 0;
 	isc_mutex_destroy(&catz->lock);
@@ -1058,20 +1392,21 @@ dns_catz_zones_shutdown(dns_catz_zones_t *catzs) {
 
 	LOCK(&catzs->lock);
 	if (catzs->zones != NULL) {
-		isc_ht_iter_t *iter = NULL;
+		isc_hashmap_iter_t *iter = NULL;
 		isc_result_t result;
-		isc_ht_iter_create(catzs->zones, &iter);
-		for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;)
+		isc_hashmap_iter_create(catzs->zones, &iter);
+		for (result = isc_hashmap_iter_first(iter);
+		     result == ISC_R_SUCCESS;)
 		{
 			dns_catz_zone_t *catz = NULL;
-			isc_ht_iter_current(iter, (void **)&catz);
-			result = isc_ht_iter_delcurrent_next(iter);
+			isc_hashmap_iter_current(iter, (void **)&catz);
+			result = isc_hashmap_iter_delcurrent_next(iter);
 			dns__catz_zone_shutdown(catz);
 		}
 		INSIST(result == ISC_R_NOMORE);
-		isc_ht_iter_destroy(&iter);
-		INSIST(isc_ht_count(catzs->zones) == 0);
-		isc_ht_destroy(&catzs->zones);
+		isc_hashmap_iter_destroy(&iter);
+		INSIST(isc_hashmap_count(catzs->zones) == 0);
+		isc_hashmap_destroy(&catzs->zones);
 	}
 	UNLOCK(&catzs->lock);
 }
@@ -1206,8 +1541,7 @@ catz_process_coo(dns_catz_zone_t *catz, dns_label_t *mhash,
 		goto cleanup;
 	}
 
-	result = isc_ht_find(catz->entries, mhash->base, mhash->length,
-			     (void **)&entry);
+	result = catz_entry_find(catz->entries, mhash->base, &entry);
 	if (result != ISC_R_SUCCESS) {
 		/* The entry was not found .*/
 		goto cleanup;
@@ -1260,8 +1594,7 @@ catz_process_zones_entry(dns_catz_zone_t *catz, dns_rdataset_t *value,
 		return (result);
 	}
 
-	result = isc_ht_find(catz->entries, mhash->base, mhash->length,
-			     (void **)&entry);
+	result = catz_entry_find(catz->entries, mhash->base, &entry);
 	if (result == ISC_R_SUCCESS) {
 		if (dns_name_countlabels(&entry->name) != 0) {
 			/* We have a duplicate. */
@@ -1272,9 +1605,9 @@ catz_process_zones_entry(dns_catz_zone_t *catz, dns_rdataset_t *value,
 		}
 	} else {
 		entry = dns_catz_entry_new(catz->catzs->mctx, &ptr.ptr);
+		catz_entry_setmhash(entry, mhash);
 
-		result = isc_ht_add(catz->entries, mhash->base, mhash->length,
-				    entry);
+		result = catz_entry_insert(catz->entries, entry);
 	}
 	INSIST(result == ISC_R_SUCCESS);
 
@@ -1662,12 +1995,11 @@ catz_process_zones_suboption(dns_catz_zone_t *catz, dns_rdataset_t *value,
 	 * We're adding this entry now, in case the option is invalid we'll get
 	 * rid of it in verification phase.
 	 */
-	result = isc_ht_find(catz->entries, mhash->base, mhash->length,
-			     (void **)&entry);
+	result = catz_entry_find(catz->entries, mhash->base, &entry);
 	if (result != ISC_R_SUCCESS) {
 		entry = dns_catz_entry_new(catz->catzs->mctx, NULL);
-		result = isc_ht_add(catz->entries, mhash->base, mhash->length,
-				    entry);
+		catz_entry_setmhash(entry, mhash);
+		result = catz_entry_insert(catz->entries, entry);
 	}
 	INSIST(result == ISC_R_SUCCESS);
 
@@ -1699,11 +2031,10 @@ catz_process_zones_suboption(dns_catz_zone_t *catz, dns_rdataset_t *value,
 }
 
 static void
-catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_ht_t *ht, unsigned char *key,
-		      size_t keysize, dns_catz_entry_t *nentry,
-		      dns_catz_entry_t *oentry, const char *msg,
-		      const char *zname, const char *czname) {
-	isc_result_t result = isc_ht_add(ht, key, (uint32_t)keysize, nentry);
+catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_hashmap_t *map,
+		      dns_catz_entry_t *nentry, dns_catz_entry_t *oentry,
+		      const char *msg, const char *zname, const char *czname) {
+	isc_result_t result = catz_entry_insert(map, nentry);
 
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
@@ -1712,9 +2043,9 @@ catz_entry_add_or_mod(dns_catz_zone_t *catz, isc_ht_t *ht, unsigned char *key,
 			      msg, zname, czname, isc_result_totext(result));
 	}
 	if (oentry != NULL) {
-		dns_catz_entry_detach(catz, &oentry);
-		result = isc_ht_delete(catz->entries, key, (uint32_t)keysize);
+		result = catz_entry_delete(catz->entries, nentry->mhash);
 		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		dns_catz_entry_detach(catz, &oentry);
 	}
 }
 
@@ -2103,8 +2434,8 @@ dns__catz_timer_cb(void *arg) {
 		      ISC_LOG_INFO, "catz: %s: reload start", domain);
 
 	dns_catz_zone_ref(catz);
-	isc_work_enqueue(catz->loop, dns__catz_update_cb, dns__catz_done_cb,
-			 catz);
+	isc_work_enqueueclass(catz->loop, isc_workclass_bulk,
+			      dns__catz_update_cb, dns__catz_done_cb, catz);
 
 exit:
 	isc_timer_destroy(&catz->updatetimer);
@@ -2120,7 +2451,6 @@ dns_catz_dbupdate_callback(dns_db_t *db, void *fn_arg) {
 	dns_catz_zones_t *catzs = NULL;
 	dns_catz_zone_t *catz = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
-	isc_region_t r;
 
 	REQUIRE(DNS_DB_VALID(db));
 	REQUIRE(DNS_CATZ_ZONES_VALID(fn_arg));
@@ -2130,20 +2460,21 @@ dns_catz_dbupdate_callback(dns_db_t *db, void *fn_arg) {
 		return (ISC_R_SHUTTINGDOWN);
 	}
 
-	dns_name_toregion(&db->origin, &r);
-
 	LOCK(&catzs->lock);
 	if (catzs->zones == NULL) {
 		result = ISC_R_SHUTTINGDOWN;
 		goto cleanup;
 	}
-	result = isc_ht_find(catzs->zones, r.base, r.length, (void **)&catz);
+	result = catz_zone_find(catzs->zones, &db->origin, &catz);
 	if (result != ISC_R_SUCCESS) {
 		goto cleanup;
 	}
 
 	/* New zone came as AXFR */
 	if (catz->db != NULL && catz->db != db) {
+		/* The journal does not lead to the new database. */
+		catz->serialvalid = false;
+
 		/* Old db cleanup. */
 		if (catz->dbversion != NULL) {
 			dns_db_closeversion(catz->db, &catz->dbversion, false);
@@ -2206,6 +2537,276 @@ catz_rdatatype_is_processable(const dns_rdatatype_t type) {
 		type != dns_rdatatype_cdnskey && type != dns_rdatatype_zonemd);
 }
 
+/*%<
+ * Process all the rdatasets of 'node', named 'name', in 'version' of
+ * the catalog zone database 'db' into 'catz'.
+ */
+static isc_result_t
+catz_process_node(dns_catz_zone_t *catz, dns_db_t *db,
+		  dns_dbversion_t *version, dns_dbnode_t *node,
+		  dns_name_t *name) {
+	isc_result_t result;
+	dns_rdatasetiter_t *rdsiter = NULL;
+	dns_rdataset_t rdataset;
+	char cname[DNS_NAME_FORMATSIZE];
+
+	result = dns_db_allrdatasets(db, node, version, 0, 0, &rdsiter);
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
+			      "catz: failed to fetch rrdatasets - %s",
+			      isc_result_totext(result));
+		return (result);
+	}
+
+	dns_rdataset_init(&rdataset);
+	result = dns_rdatasetiter_first(rdsiter);
+	while (result == ISC_R_SUCCESS) {
+		dns_rdatasetiter_current(rdsiter, &rdataset);
+
+		/*
+		 * Skip processing DNSSEC-related and ZONEMD types,
+		 * because we are not interested in them in the context
+		 * of a catalog zone, and processing them will fail
+		 * and produce an unnecessary warning message.
+		 */
+		if (!catz_rdatatype_is_processable(rdataset.type)) {
+			goto next;
+		}
+
+		/*
+		 * Although catz->coos is accessed in catz_process_coo()
+		 * in the call-chain below, we don't need to hold the
+		 * catz->lock, because the catz is still local to the
+		 * calling thread and function and catz->coos can't be
+		 * accessed from the outside until it has been merged.
+		 */
+		result = dns__catz_update_process(catz, name, &rdataset);
+		if (result != ISC_R_SUCCESS) {
+			char typebuf[DNS_RDATATYPE_FORMATSIZE];
+			char classbuf[DNS_RDATACLASS_FORMATSIZE];
+
+			dns_name_format(name, cname, DNS_NAME_FORMATSIZE);
+			dns_rdataclass_format(rdataset.rdclass, classbuf,
+					      sizeof(classbuf));
+			dns_rdatatype_format(rdataset.type, typebuf,
+					     sizeof(typebuf));
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+				      DNS_LOGMODULE_MASTER, ISC_LOG_WARNING,
+				      "catz: invalid record in catalog "
+				      "zone - %s %s %s (%s) - ignoring",
+				      cname, classbuf, typebuf,
+				      isc_result_totext(result));
+		}
+	next:
+		dns_rdataset_disassociate(&rdataset);
+		result = dns_rdatasetiter_next(rdsiter);
+	}
+
+	dns_rdatasetiter_destroy(&rdsiter);
+
+	return (ISC_R_SUCCESS);
+}
+
+/*%<
+ * Process the records of the member zone 'member' (the
+ * '<unique-label>.zones.<catalog>' node) and of all its properties in
+ * 'version' of the catalog zone database 'db' into 'catz'.  A member
+ * zone that no longer exists leaves 'catz' unchanged.
+ */
+static isc_result_t
+catz_process_member(dns_catz_zone_t *catz, dns_db_t *db,
+		    dns_dbversion_t *version, dns_dbiterator_t *dbit,
+		    const dns_name_t *member) {
+	isc_result_t result;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+
+	result = dns_dbiterator_seek(dbit, member);
+	if (result == ISC_R_NOTFOUND || result == DNS_R_PARTIALMATCH) {
+		return (ISC_R_SUCCESS);
+	}
+
+	while (result == ISC_R_SUCCESS) {
+		dns_dbnode_t *node = NULL;
+
+		result = dns_dbiterator_current(dbit, &node, name);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		result = dns_dbiterator_pause(dbit);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		/* The properties follow the member zone in DNSSEC order. */
+		if (!dns_name_issubdomain(name, member)) {
+			dns_db_detachnode(db, &node);
+			break;
+		}
+
+		result = catz_process_node(catz, db, version, node, name);
+		dns_db_detachnode(db, &node);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_dbiterator_next(dbit);
+		}
+	}
+
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+	return (result);
+}
+
+/*%<
+ * Update 'catz' from the journal of the catalog zone instead of the
+ * whole database: only the member zones with records in the journal
+ * between the last merged serial and 'serial' are read from 'version'
+ * of 'db' and merged.  Changes to anything but member zones, like the
+ * catalog zone options or the schema version, are not handled and make
+ * this fail, as does a journal that does not cover the serials, so that
+ * the caller falls back to processing the whole catalog zone.
+ */
+static isc_result_t
+catz_update_incremental(dns_catz_zone_t *catz, dns_db_t *db,
+			dns_dbversion_t *version, uint32_t serial) {
+	isc_result_t result;
+	isc_mem_t *mctx = catz->catzs->mctx;
+	dns_zone_t *zone = NULL;
+	dns_journal_t *journal = NULL;
+	dns_dbiterator_t *dbit = NULL;
+	dns_catz_zone_t *newcatz = NULL;
+	isc_hashmap_t *changed = NULL;
+	isc_hashmap_iter_t *iter = NULL;
+	unsigned int labels = dns_name_countlabels(&catz->name);
+	char cname[DNS_NAME_FORMATSIZE];
+
+	result = dns_view_findzone(catz->catzs->view, &catz->name,
+				   DNS_ZTFIND_EXACT, &zone);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	if (dns_zone_getjournal(zone) == NULL) {
+		result = ISC_R_NOTFOUND;
+	} else {
+		result = dns_journal_open(mctx, dns_zone_getjournal(zone),
+					  DNS_JOURNAL_READ, &journal);
+	}
+	dns_zone_detach(&zone);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_journal_iter_init(journal, catz->serial, serial, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	/*
+	 * Collect the names of the member zones that have changed.
+	 */
+	isc_hashmap_create(mctx, 1, &changed);
+	for (result = dns_journal_first_rr(journal); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(journal))
+	{
+		dns_name_t *name = NULL;
+		dns_rdata_t *rdata = NULL;
+		dns_name_t member;
+		dns_label_t option;
+		uint32_t ttl;
+
+		dns_journal_current_rr(journal, &name, &ttl, &rdata);
+
+		if (!catz_rdatatype_is_processable(rdata->type) ||
+		    dns_name_equal(name, &catz->name))
+		{
+			continue;
+		}
+
+		if (!dns_name_issubdomain(name, &catz->name) ||
+		    dns_name_countlabels(name) < labels + 2)
+		{
+			result = ISC_R_NOTIMPLEMENTED;
+			break;
+		}
+
+		dns_name_getlabel(name, dns_name_countlabels(name) - labels - 1,
+				  &option);
+		if (catz_get_option(&option) != CATZ_OPT_ZONES) {
+			result = ISC_R_NOTIMPLEMENTED;
+			break;
+		}
+
+		dns_name_init(&member, NULL);
+		dns_name_split(name, labels + 2, NULL, &member);
+		catz_members_add(mctx, changed, &member);
+	}
+	if (result != ISC_R_NOMORE) {
+		goto cleanup;
+	}
+
+	/*
+	 * Read the current state of those member zones.
+	 */
+	result = dns_db_createiterator(db, DNS_DB_NONSEC3, &dbit);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	newcatz = dns_catz_zone_new(catz->catzs, &catz->name);
+	newcatz->version = catz->version;
+
+	isc_hashmap_iter_create(changed, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(iter))
+	{
+		dns_name_t *member = NULL;
+
+		if (atomic_load(&catz->catzs->shuttingdown)) {
+			result = ISC_R_SHUTTINGDOWN;
+			break;
+		}
+
+		isc_hashmap_iter_current(iter, (void **)&member);
+
+		result = catz_process_member(newcatz, db, version, dbit,
+					     member);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	isc_hashmap_iter_destroy(&iter);
+	dns_dbiterator_destroy(&dbit);
+	if (result != ISC_R_NOMORE) {
+		goto cleanup;
+	}
+
+	if (newcatz->broken) {
+		result = ISC_R_FAILURE;
+		goto cleanup;
+	}
+
+	dns__catz_zones_merge_changed(catz, newcatz, changed);
+
+	dns_name_format(&catz->name, cname, DNS_NAME_FORMATSIZE);
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL, DNS_LOGMODULE_MASTER,
+		      ISC_LOG_INFO,
+		      "catz: updated %u member zone(s) of catalog zone '%s' "
+		      "from the journal",
+		      isc_hashmap_count(changed), cname);
+	result = ISC_R_SUCCESS;
+
+cleanup:
+	if (newcatz != NULL) {
+		dns_catz_zone_detach(&newcatz);
+	}
+	if (changed != NULL) {
+		catz_members_destroy(mctx, &changed);
+	}
+	dns_journal_destroy(&journal);
+
+	return (result);
+}
+
 /*
  * Process an updated database for a catalog zone.
  * It creates a new catz, iterates over database to fill it with content, and
@@ -2218,18 +2819,15 @@ dns__catz_update_cb(void *data) {
 	dns_catz_zones_t *catzs = NULL;
 	dns_catz_zone_t *oldcatz = NULL, *newcatz = NULL;
 	isc_result_t result;
-	isc_region_t r;
 	dns_dbnode_t *node = NULL;
 	const dns_dbnode_t *vers_node = NULL;
 	dns_dbiterator_t *updbit = NULL;
 	dns_fixedname_t fixname;
 	dns_name_t *name = NULL;
-	dns_rdatasetiter_t *rdsiter = NULL;
-	dns_rdataset_t rdataset;
 	char bname[DNS_NAME_FORMATSIZE];
 	char cname[DNS_NAME_FORMATSIZE];
 	bool is_vers_processed = false;
-	bool is_active;
+	bool is_active, incremental;
 	uint32_t vers;
 	uint32_t catz_vers;
 
@@ -2250,14 +2848,13 @@ dns__catz_update_cb(void *data) {
 	/*
 	 * Create a new catz in the same context as current catz.
 	 */
-	dns_name_toregion(&updb->origin, &r);
 	LOCK(&catzs->lock);
 	if (catzs->zones == NULL) {
 		UNLOCK(&catzs->lock);
 		result = ISC_R_SHUTTINGDOWN;
 		goto exit;
 	}
-	result = isc_ht_find(catzs->zones, r.base, r.length, (void **)&oldcatz);
+	result = catz_zone_find(catzs->zones, &updb->origin, &oldcatz);
 	is_active = (result == ISC_R_SUCCESS && oldcatz->active);
 	UNLOCK(&catzs->lock);
 	if (result != ISC_R_SUCCESS) {
@@ -2292,6 +2889,27 @@ dns__catz_update_cb(void *data) {
 		      "catz: updating catalog zone '%s' with serial %" PRIu32,
 		      bname, vers);
 
+	/*
+	 * If the previous version of this database has been merged, try
+	 * to process only the member zones that changed since then.
+	 */
+	LOCK(&catzs->lock);
+	incremental = oldcatz->serialvalid && oldcatz->db == updb &&
+		      oldcatz->version != DNS_CATZ_VERSION_UNDEFINED;
+	UNLOCK(&catzs->lock);
+	if (incremental) {
+		result = catz_update_incremental(oldcatz, updb,
+						 oldcatz->updbversion, vers);
+		if (result == ISC_R_SUCCESS) {
+			goto merged;
+		}
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(1),
+			      "catz: zone '%s' can not be updated from the "
+			      "journal (%s), processing all records",
+			      bname, isc_result_totext(result));
+	}
+
 	result = dns_db_createiterator(updb, DNS_DB_NONSEC3, &updbit);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
@@ -2363,68 +2981,13 @@ dns__catz_update_cb(void *data) {
 			continue;
 		}
 
-		result = dns_db_allrdatasets(updb, node, oldcatz->updbversion,
-					     0, 0, &rdsiter);
+		result = catz_process_node(newcatz, updb, oldcatz->updbversion,
+					   node, name);
 		if (result != ISC_R_SUCCESS) {
-			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
-				      "catz: failed to fetch rrdatasets - %s",
-				      isc_result_totext(result));
 			dns_db_detachnode(updb, &node);
 			break;
 		}
 
-		dns_rdataset_init(&rdataset);
-		result = dns_rdatasetiter_first(rdsiter);
-		while (result == ISC_R_SUCCESS) {
-			dns_rdatasetiter_current(rdsiter, &rdataset);
-
-			/*
-			 * Skip processing DNSSEC-related and ZONEMD types,
-			 * because we are not interested in them in the context
-			 * of a catalog zone, and processing them will fail
-			 * and produce an unnecessary warning message.
-			 */
-			if (!catz_rdatatype_is_processable(rdataset.type)) {
-				goto next;
-			}
-
-			/*
-			 * Although newcatz->coos is accessed in
-			 * catz_process_coo() in the call-chain below, we don't
-			 * need to hold the newcatz->lock, because the newcatz
-			 * is still local to this thread and function and
-			 * newcatz->coos can't be accessed from the outside
-			 * until dns__catz_zones_merge() has been called.
-			 */
-			result = dns__catz_update_process(newcatz, name,
-							  &rdataset);
-			if (result != ISC_R_SUCCESS) {
-				char typebuf[DNS_RDATATYPE_FORMATSIZE];
-				char classbuf[DNS_RDATACLASS_FORMATSIZE];
-
-				dns_name_format(name, cname,
-						DNS_NAME_FORMATSIZE);
-				dns_rdataclass_format(rdataset.rdclass,
-						      classbuf,
-						      sizeof(classbuf));
-				dns_rdatatype_format(rdataset.type, typebuf,
-						     sizeof(typebuf));
-				isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-					      DNS_LOGMODULE_MASTER,
-					      ISC_LOG_WARNING,
-					      "catz: invalid record in catalog "
-					      "zone - %s %s %s (%s) - ignoring",
-					      cname, classbuf, typebuf,
-					      isc_result_totext(result));
-			}
-		next:
-			dns_rdataset_disassociate(&rdataset);
-			result = dns_rdatasetiter_next(rdsiter);
-		}
-
-		dns_rdatasetiter_destroy(&rdsiter);
-
 		dns_db_detachnode(updb, &node);
 
 		if (!is_vers_processed) {
@@ -2493,6 +3056,14 @@ dns__catz_update_cb(void *data) {
 		      ISC_LOG_DEBUG(3),
 		      "catz: update_from_db: new zone merged");
 
+merged:
+	LOCK(&catzs->lock);
+	if (oldcatz->db == updb) {
+		oldcatz->serial = vers;
+		oldcatz->serialvalid = true;
+	}
+	UNLOCK(&catzs->lock);
+
 exit:
 	catz->updateresult = result;
 }
@@ -2529,38 +3100,38 @@ dns__catz_done_cb(void *data) {
 void
 dns_catz_prereconfig(dns_catz_zones_t *catzs) {
 	isc_result_t result;
-	isc_ht_iter_t *iter = NULL;
+	isc_hashmap_iter_t *iter = NULL;
 
 	REQUIRE(DNS_CATZ_ZONES_VALID(catzs));
 
 	LOCK(&catzs->lock);
-	isc_ht_iter_create(catzs->zones, &iter);
-	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_next(iter))
+	isc_hashmap_iter_create(catzs->zones, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(iter))
 	{
 		dns_catz_zone_t *catz = NULL;
-		isc_ht_iter_current(iter, (void **)&catz);
+		isc_hashmap_iter_current(iter, (void **)&catz);
 		catz->active = false;
 	}
 	UNLOCK(&catzs->lock);
 	INSIST(result == ISC_R_NOMORE);
-	isc_ht_iter_destroy(&iter);
+	isc_hashmap_iter_destroy(&iter);
 }
 
 void
 dns_catz_postreconfig(dns_catz_zones_t *catzs) {
 	isc_result_t result;
 	dns_catz_zone_t *newcatz = NULL;
-	isc_ht_iter_t *iter = NULL;
+	isc_hashmap_iter_t *iter = NULL;
 
 	REQUIRE(DNS_CATZ_ZONES_VALID(catzs));
 
 	LOCK(&catzs->lock);
-	isc_ht_iter_create(catzs->zones, &iter);
-	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;) {
+	isc_hashmap_iter_create(catzs->zones, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;) {
 		dns_catz_zone_t *catz = NULL;
 
-		isc_ht_iter_current(iter, (void **)&catz);
+		isc_hashmap_iter_current(iter, (void **)&catz);
 		if (!catz->active) {
 			char cname[DNS_NAME_FORMATSIZE];
 			dns_name_format(&catz->name, cname,
@@ -2578,16 +3149,16 @@ dns_catz_postreconfig(dns_catz_zones_t *catzs) {
 			dns_catz_zone_detach(&newcatz);
 
 			/* Make sure that we have an empty catalog zone. */
-			INSIST(isc_ht_count(catz->entries) == 0);
-			result = isc_ht_iter_delcurrent_next(iter);
+			INSIST(isc_hashmap_count(catz->entries) == 0);
+			result = isc_hashmap_iter_delcurrent_next(iter);
 			dns_catz_zone_detach(&catz);
 		} else {
-			result = isc_ht_iter_next(iter);
+			result = isc_hashmap_iter_next(iter);
 		}
 	}
 	UNLOCK(&catzs->lock);
 	RUNTIME_CHECK(result == ISC_R_NOMORE);
-	isc_ht_iter_destroy(&iter);
+	isc_hashmap_iter_destroy(&iter);
 }
 
 void
@@ -2595,19 +3166,19 @@ dns_catz_zone_for_each_entry2(dns_catz_zone_t *catz, dns_catz_entry_cb2 cb,
 			      void *arg1, void *arg2) {
 	REQUIRE(DNS_CATZ_ZONE_VALID(catz));
 
-	isc_ht_iter_t *iter = NULL;
+	isc_hashmap_iter_t *iter = NULL;
 	isc_result_t result;
 
 	LOCK(&catz->catzs->lock);
-	isc_ht_iter_create(catz->entries, &iter);
-	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_next(iter))
+	isc_hashmap_iter_create(catz->entries, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(iter))
 	{
 		dns_catz_entry_t *entry = NULL;
 
-		isc_ht_iter_current(iter, (void **)&entry);
+		isc_hashmap_iter_current(iter, (void **)&entry);
 		cb(entry, arg1, arg2);
 	}
-	isc_ht_iter_destroy(&iter);
+	isc_hashmap_iter_destroy(&iter);
 	UNLOCK(&catz->catzs->lock);
 }
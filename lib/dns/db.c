@@ -26,6 +26,7 @@
 #include <isc/once.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
+#include <isc/serial.h>
 #include <isc/string.h>
 #include <isc/tid.h>
 #include <isc/urcu.h>
@@ -35,6 +36,7 @@
 #include <dns/clientinfo.h>
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/fixedname.h>
 #include <dns/log.h>
 #include <dns/master.h>
 #include <dns/rdata.h>
@@ -220,6 +222,13 @@ dns_db_isstub(dns_db_t *db) {
 	return (false);
 }
 
+bool
+dns_db_parallelupdate(dns_db_t *db) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	return ((db->attributes & DNS_DBATTR_PARALLELUPDATE) != 0);
+}
+
 bool
 dns_db_issecure(dns_db_t *db) {
 	/*
@@ -467,6 +476,39 @@ dns__db_findnodeext(dns_db_t *db, const dns_name_t *name, bool create,
 	}
 }
 
+isc_result_t
+dns__db_findnodes(dns_db_t *db, const dns_name_t **names, size_t count,
+		  dns_dbnode_t **nodes DNS__DB_FLARG) {
+	isc_result_t result = ISC_R_SUCCESS;
+
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(names != NULL && nodes != NULL);
+
+	if (db->methods->findnodes != NULL) {
+		return ((db->methods->findnodes)(db, names, count,
+						 nodes DNS__DB_FLARG_PASS));
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		REQUIRE(nodes[i] == NULL);
+		result = dns__db_findnode(db, names[i], true,
+					  &nodes[i] DNS__DB_FLARG_PASS);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	if (result != ISC_R_SUCCESS) {
+		for (size_t i = 0; i < count; i++) {
+			if (nodes[i] != NULL) {
+				dns__db_detachnode(
+					db, &nodes[i] DNS__DB_FLARG_PASS);
+			}
+		}
+	}
+
+	return (result);
+}
+
 isc_result_t
 dns__db_findnsec3node(dns_db_t *db, const dns_name_t *name, bool create,
 		      dns_dbnode_t **nodep DNS__DB_FLARG) {
@@ -812,6 +854,17 @@ dns_db_nodecount(dns_db_t *db, dns_dbtree_t tree) {
 	return (0);
 }
 
+size_t
+dns_db_memoryusage(dns_db_t *db) {
+	REQUIRE(DNS_DB_VALID(db));
+
+	if (db->methods->memoryusage == NULL) {
+		return (0);
+	}
+
+	return ((db->methods->memoryusage)(db));
+}
+
 size_t
 dns_db_hashsize(dns_db_t *db) {
 	REQUIRE(DNS_DB_VALID(db));
@@ -966,6 +1019,38 @@ dns__db_getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 	return (ISC_R_NOTFOUND);
 }
 
+isc_result_t
+dns_db_getsigningtimes(dns_db_t *db, isc_stdtime_t until,
+		       dns_dbsigning_t *entries, size_t *countp) {
+	dns_rdataset_t rdataset;
+	isc_result_t result;
+
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE(entries != NULL);
+	REQUIRE(countp != NULL && *countp > 0);
+
+	if (db->methods->getsigningtimes != NULL) {
+		return ((db->methods->getsigningtimes)(db, until, entries,
+						       countp));
+	}
+
+	*countp = 0;
+	dns_rdataset_init(&rdataset);
+	result = dns_db_getsigningtime(
+		db, &rdataset, dns_fixedname_initname(&entries[0].name));
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+	entries[0].covers = rdataset.covers;
+	entries[0].resign = rdataset.resign;
+	dns_rdataset_disassociate(&rdataset);
+	if (isc_serial_gt(entries[0].resign, until)) {
+		return (ISC_R_NOTFOUND);
+	}
+	*countp = 1;
+	return (ISC_R_SUCCESS);
+}
+
 static void
 call_updatenotify(dns_db_t *db) {
 	rcu_read_lock();
@@ -1131,6 +1216,87 @@ dns_db_addglue(dns_db_t *db, dns_dbversion_t *version, dns_rdataset_t *rdataset,
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+isc_result_t
+dns_db_getrendered(dns_db_t *db, dns_dbversion_t *version,
+		   const isc_region_t *key, isc_region_t *data) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) == 0);
+	REQUIRE(version != NULL);
+	REQUIRE(key != NULL);
+	REQUIRE(data != NULL);
+
+	if (db->methods->getrendered != NULL) {
+		return ((db->methods->getrendered)(db, version, key, data));
+	}
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_addrendered(dns_db_t *db, dns_dbversion_t *version,
+		   const isc_region_t *key, const isc_region_t *data,
+		   unsigned int ndata) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) == 0);
+	REQUIRE(version != NULL);
+	REQUIRE(key != NULL);
+	REQUIRE(data != NULL && ndata > 0);
+
+	if (db->methods->addrendered != NULL) {
+		return ((db->methods->addrendered)(db, version, key, data,
+						   ndata));
+	}
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_getnsec3hash(dns_db_t *db, dns_dbversion_t *version,
+		    const dns_name_t *name, dns_name_t *hashname) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) == 0);
+	REQUIRE(version != NULL);
+	REQUIRE(DNS_NAME_VALID(name));
+	REQUIRE(DNS_NAME_VALID(hashname));
+
+	if (db->methods->getnsec3hash != NULL) {
+		return ((db->methods->getnsec3hash)(db, version, name,
+						    hashname));
+	}
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_addnsec3hash(dns_db_t *db, dns_dbversion_t *version,
+		    const dns_name_t *name, const dns_name_t *hashname) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) == 0);
+	REQUIRE(version != NULL);
+	REQUIRE(DNS_NAME_VALID(name));
+	REQUIRE(DNS_NAME_VALID(hashname));
+
+	if (db->methods->addnsec3hash != NULL) {
+		return ((db->methods->addnsec3hash)(db, version, name,
+						    hashname));
+	}
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
+isc_result_t
+dns_db_setreplicas(dns_db_t *db, unsigned int groups) {
+	REQUIRE(DNS_DB_VALID(db));
+	REQUIRE((db->attributes & DNS_DBATTR_CACHE) == 0);
+	REQUIRE(groups > 0);
+
+	if (db->methods->setreplicas != NULL) {
+		return ((db->methods->setreplicas)(db, groups));
+	}
+
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 void
 dns_db_locknode(dns_db_t *db, dns_dbnode_t *node, isc_rwlocktype_t type) {
 	if (db->methods->locknode != NULL) {
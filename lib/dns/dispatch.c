@@ -57,10 +57,23 @@ struct dns_dispatchmgr {
 	isc_nm_t *nm;
 
 	uint32_t nloops;
+	uint32_t tcpreuse; /*%< keep idle TCP connections open (ms) */
+	uint32_t udpreuse; /*%< queries sent from one UDP socket */
 
 	struct cds_lfht **tcps;
 
-	struct cds_lfht *qids;
+	/*
+	 * Idle connected UDP sockets, one table per loop, waiting to be
+	 * picked up for another query to the same peer.
+	 */
+	struct cds_lfht **udps;
+
+	/*
+	 * Outstanding query IDs, one table per loop: a dispatch and its
+	 * responses are only ever used from the loop that owns them, so
+	 * the tables are never contended.
+	 */
+	struct cds_lfht **qids;
 
 	in_port_t *v4ports;    /*%< available ports for IPv4 */
 	unsigned int nv4ports; /*%< # of available ports for IPv4 */
@@ -97,6 +110,8 @@ struct dns_dispentry {
 	dispatch_cb_t response;
 	void *arg;
 	bool reading;
+	bool reusable;	    /*%< the socket has seen our response */
+	unsigned int uses; /*%< earlier queries sent from 'handle' */
 	isc_result_t result;
 	ISC_LINK(dns_dispentry_t) alink;
 	ISC_LINK(dns_dispentry_t) plink;
@@ -117,11 +132,13 @@ struct dns_dispatch {
 	isc_nmhandle_t *handle; /*%< netmgr handle for TCP connection */
 	isc_sockaddr_t local;	/*%< local address */
 	isc_sockaddr_t peer;	/*%< peer address (TCP) */
+	dns_transport_t *transport; /*%< transport of the TCP connection */
 
 	dns_dispatchopt_t options;
 	dns_dispatchstate_t state;
 
 	bool reading;
+	bool idle; /*%< TCP connection kept open for reuse */
 
 	dns_displist_t pending;
 	dns_displist_t active;
@@ -134,6 +151,24 @@ struct dns_dispatch {
 	struct rcu_head rcu_head;
 };
 
+/*
+ * A connected UDP socket parked in the manager after its last response
+ * has been read, until it is reused or UDPSOCK_IDLE milliseconds pass.
+ */
+typedef struct dispatch_udpsock {
+	isc_mem_t *mctx;
+	dns_dispatchmgr_t *mgr;
+	uint32_t tid;
+	isc_nmhandle_t *handle;
+	isc_sockaddr_t local;
+	isc_sockaddr_t peer;
+	unsigned int uses; /*%< queries sent from 'handle' so far */
+	struct cds_lfht_node ht_node;
+	struct rcu_head rcu_head;
+} dispatch_udpsock_t;
+
+#define UDPSOCK_IDLE 2000
+
 #define RESPONSE_MAGIC	  ISC_MAGIC('D', 'r', 's', 'p')
 #define VALID_RESPONSE(e) ISC_MAGIC_VALID((e), RESPONSE_MAGIC)
 
@@ -196,6 +231,11 @@ tcp_dispatch_getnext(dns_dispatch_t *disp, dns_dispentry_t *resp,
 		     int32_t timeout);
 static void
 udp_dispatch_getnext(dns_dispentry_t *resp, int32_t timeout);
+static bool
+udpsock_get(dns_dispatch_t *disp, dns_dispentry_t *resp,
+	    const isc_sockaddr_t *dest);
+static void
+udpsock_park(dns_dispentry_t *resp);
 
 static const char *
 socktype2str(dns_dispentry_t *resp) {
@@ -424,6 +464,10 @@ dispentry_destroy(dns_dispentry_t *resp) {
 
 	dispentry_log(resp, ISC_LOG_DEBUG(90), "destroying");
 
+	if (disp->socktype == isc_socktype_udp && resp->handle != NULL) {
+		udpsock_park(resp);
+	}
+
 	if (resp->handle != NULL) {
 		dispentry_log(resp, ISC_LOG_DEBUG(90),
 			      "detaching handle %p from %p", resp->handle,
@@ -583,8 +627,10 @@ udp_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	}
 
 	/*
-	 * We have the right resp, so call the caller back.
+	 * We have the right resp, so call the caller back.  The socket is
+	 * now known to work and can be handed to the next query.
 	 */
+	resp->reusable = true;
 	goto done;
 
 next:
@@ -686,8 +732,8 @@ tcp_recv_success(dns_dispatch_t *disp, isc_region_t *region,
 		.port = isc_sockaddr_getport(&disp->local),
 	};
 	struct cds_lfht_iter iter;
-	cds_lfht_lookup(disp->mgr->qids, qid_hash(&key), qid_match, &key,
-			&iter);
+	cds_lfht_lookup(disp->mgr->qids[disp->tid], qid_hash(&key), qid_match,
+			&key, &iter);
 
 	dns_dispentry_t *resp = cds_lfht_entry(cds_lfht_iter_get_node(&iter),
 					       dns_dispentry_t, ht_node);
@@ -735,6 +781,7 @@ tcp_recv_shutdown(dns_dispatch_t *disp, dns_displist_t *resps,
 		tcp_recv_add(resps, resp, result);
 	}
 	disp->state = DNS_DISPATCHSTATE_CANCELED;
+	disp->idle = false;
 }
 
 static void
@@ -794,6 +841,16 @@ tcp_recv(isc_nmhandle_t *handle, isc_result_t result, isc_region_t *region,
 	 */
 	switch (result) {
 	case ISC_R_TIMEDOUT:
+		if (disp->idle) {
+			/*
+			 * The idle connection has not been reused in time,
+			 * close it.
+			 */
+			INSIST(ISC_LIST_EMPTY(disp->active));
+			inc_stats(disp->mgr, dns_resstatscounter_tcpidleclose);
+			result = ISC_R_CANCELED;
+			break;
+		}
 		/*
 		 * Time out the oldest response in the active queue.
 		 */
@@ -821,7 +878,12 @@ tcp_recv(isc_nmhandle_t *handle, isc_result_t result, isc_region_t *region,
 			/* There was active query that timed-out before */
 			disp->timedout--;
 		} else {
-			result = ISC_R_UNEXPECTED;
+			/*
+			 * Most likely a late answer to a query that has
+			 * been canceled; the connection may be shared by
+			 * other queries, so just ignore it.
+			 */
+			inc_stats(disp->mgr, dns_resstatscounter_mismatch);
 		}
 	}
 
@@ -883,6 +945,8 @@ tcp_recv(isc_nmhandle_t *handle, isc_result_t result, isc_region_t *region,
 		INSIST(timeout > 0);
 		tcp_startrecv(disp, resp);
 		isc_nmhandle_settimeout(handle, timeout);
+	} else if (disp->idle) {
+		tcp_startrecv(disp, NULL);
 	}
 
 	rcu_read_unlock();
@@ -988,10 +1052,18 @@ dns_dispatchmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 	isc_nm_attach(nm, &mgr->nm);
 
 	mgr->tcps = isc_mem_cget(mgr->mctx, mgr->nloops, sizeof(mgr->tcps[0]));
+	mgr->udps = isc_mem_cget(mgr->mctx, mgr->nloops, sizeof(mgr->udps[0]));
+	mgr->qids = isc_mem_cget(mgr->mctx, mgr->nloops, sizeof(mgr->qids[0]));
 	for (size_t i = 0; i < mgr->nloops; i++) {
 		mgr->tcps[i] = cds_lfht_new(
 			2, 2, 0, CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
 			NULL);
+		mgr->udps[i] = cds_lfht_new(
+			2, 2, 0, CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+			NULL);
+		mgr->qids[i] = cds_lfht_new(
+			QIDS_INIT_SIZE, QIDS_MIN_SIZE, 0,
+			CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING, NULL);
 	}
 
 	create_default_portset(mgr->mctx, AF_INET, &v4portset);
@@ -1002,10 +1074,6 @@ dns_dispatchmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 	isc_portset_destroy(mgr->mctx, &v4portset);
 	isc_portset_destroy(mgr->mctx, &v6portset);
 
-	mgr->qids = cds_lfht_new(QIDS_INIT_SIZE, QIDS_MIN_SIZE, 0,
-				 CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
-				 NULL);
-
 	mgr->magic = DNS_DISPATCHMGR_MAGIC;
 
 	*mgrp = mgr;
@@ -1033,6 +1101,18 @@ dns_dispatchmgr_getblackhole(dns_dispatchmgr_t *mgr) {
 	return (mgr->blackhole);
 }
 
+void
+dns_dispatchmgr_settcpreuse(dns_dispatchmgr_t *mgr, uint32_t timeout) {
+	REQUIRE(VALID_DISPATCHMGR(mgr));
+	mgr->tcpreuse = timeout;
+}
+
+void
+dns_dispatchmgr_setudpreuse(dns_dispatchmgr_t *mgr, uint32_t queries) {
+	REQUIRE(VALID_DISPATCHMGR(mgr));
+	mgr->udpreuse = queries;
+}
+
 isc_result_t
 dns_dispatchmgr_setavailports(dns_dispatchmgr_t *mgr, isc_portset_t *v4portset,
 			      isc_portset_t *v6portset) {
@@ -1048,12 +1128,14 @@ dispatchmgr_destroy(dns_dispatchmgr_t *mgr) {
 
 	mgr->magic = 0;
 
-	RUNTIME_CHECK(!cds_lfht_destroy(mgr->qids, NULL));
-
 	for (size_t i = 0; i < mgr->nloops; i++) {
+		RUNTIME_CHECK(!cds_lfht_destroy(mgr->qids[i], NULL));
 		RUNTIME_CHECK(!cds_lfht_destroy(mgr->tcps[i], NULL));
+		RUNTIME_CHECK(!cds_lfht_destroy(mgr->udps[i], NULL));
 	}
+	isc_mem_cput(mgr->mctx, mgr->qids, mgr->nloops, sizeof(mgr->qids[0]));
 	isc_mem_cput(mgr->mctx, mgr->tcps, mgr->nloops, sizeof(mgr->tcps[0]));
+	isc_mem_cput(mgr->mctx, mgr->udps, mgr->nloops, sizeof(mgr->udps[0]));
 
 	if (mgr->blackhole != NULL) {
 		dns_acl_detach(&mgr->blackhole);
@@ -1125,6 +1207,7 @@ dispatch_allocate(dns_dispatchmgr_t *mgr, isc_socktype_t type, uint32_t tid,
 struct dispatch_key {
 	const isc_sockaddr_t *local;
 	const isc_sockaddr_t *peer;
+	const dns_transport_t *transport;
 };
 
 static uint32_t
@@ -1152,8 +1235,180 @@ dispatch_match(struct cds_lfht_node *node, const void *key0) {
 		peer = disp->peer;
 	}
 
-	return (isc_sockaddr_equal(&peer, key->peer) &&
-		(key->local == NULL || isc_sockaddr_equal(&local, key->local)));
+	if (disp->transport != key->transport ||
+	    !isc_sockaddr_equal(&peer, key->peer))
+	{
+		return (false);
+	}
+
+	if (key->local == NULL) {
+		return (true);
+	}
+
+	/* Any local port will do if none has been asked for. */
+	if (isc_sockaddr_getport(key->local) == 0) {
+		return (isc_sockaddr_eqaddr(&local, key->local));
+	}
+
+	return (isc_sockaddr_equal(&local, key->local));
+}
+
+static int
+udpsock_match(struct cds_lfht_node *node, const void *key0) {
+	dispatch_udpsock_t *udpsock = caa_container_of(node, dispatch_udpsock_t,
+						       ht_node);
+	const struct dispatch_key *key = key0;
+
+	if (!isc_sockaddr_equal(&udpsock->peer, key->peer)) {
+		return (false);
+	}
+
+	if (isc_sockaddr_getport(key->local) == 0) {
+		return (isc_sockaddr_eqaddr(&udpsock->local, key->local));
+	}
+
+	return (isc_sockaddr_equal(&udpsock->local, key->local));
+}
+
+static void
+udpsock_destroy_rcu(struct rcu_head *rcu_head) {
+	dispatch_udpsock_t *udpsock = caa_container_of(
+		rcu_head, dispatch_udpsock_t, rcu_head);
+	isc_mem_putanddetach(&udpsock->mctx, udpsock, sizeof(*udpsock));
+}
+
+static void
+udpsock_destroy(dispatch_udpsock_t *udpsock) {
+	if (udpsock->handle != NULL) {
+		isc_nmhandle_detach(&udpsock->handle);
+	}
+	dns_dispatchmgr_detach(&udpsock->mgr);
+	call_rcu(&udpsock->rcu_head, udpsock_destroy_rcu);
+}
+
+/*
+ * Read callback of a parked socket.  Anything that arrives now is a late
+ * or spoofed answer to an earlier query and is dropped; the idle timeout,
+ * a network error or shutdown closes the socket.
+ */
+static void
+udpsock_recv(isc_nmhandle_t *handle, isc_result_t eresult,
+	     isc_region_t *region ISC_ATTR_UNUSED, void *arg) {
+	dispatch_udpsock_t *udpsock = arg;
+	dns_dispatchmgr_t *mgr = udpsock->mgr;
+
+	REQUIRE(udpsock->tid == isc_tid());
+
+	if (eresult == ISC_R_SUCCESS) {
+		inc_stats(mgr, dns_resstatscounter_mismatch);
+		isc_nm_read(handle, udpsock_recv, udpsock);
+		return;
+	}
+
+	rcu_read_lock();
+	(void)cds_lfht_del(mgr->udps[udpsock->tid], &udpsock->ht_node);
+	rcu_read_unlock();
+
+	udpsock_destroy(udpsock);
+}
+
+/*
+ * Keep the socket of a finished UDP query open for the next query to
+ * the same peer, unless it has already been used for 'udpreuse' queries.
+ * Every socket still starts out on a random port; reusing it for a few
+ * consecutive queries saves the socket(), bind(), connect() and close()
+ * calls that each of them would otherwise cost.
+ */
+static void
+udpsock_park(dns_dispentry_t *resp) {
+	dns_dispatch_t *disp = resp->disp;
+	dns_dispatchmgr_t *mgr = disp->mgr;
+	dispatch_udpsock_t *udpsock = NULL;
+	struct dispatch_key key = {
+		.local = &resp->local,
+		.peer = &resp->peer,
+	};
+
+	if (!resp->reusable || resp->reading ||
+	    resp->uses + 1 >= mgr->udpreuse)
+	{
+		return;
+	}
+
+	udpsock = isc_mem_get(mgr->mctx, sizeof(*udpsock));
+	*udpsock = (dispatch_udpsock_t){
+		.tid = disp->tid,
+		.local = resp->local,
+		.peer = resp->peer,
+		.uses = resp->uses + 1,
+	};
+	isc_mem_attach(mgr->mctx, &udpsock->mctx);
+	dns_dispatchmgr_attach(mgr, &udpsock->mgr);
+
+	/* Take over the handle from the response */
+	udpsock->handle = resp->handle;
+	resp->handle = NULL;
+
+	dispentry_log(resp, ISC_LOG_DEBUG(90), "parking UDP socket %p",
+		      udpsock->handle);
+
+	rcu_read_lock();
+	cds_lfht_add(mgr->udps[disp->tid], dispatch_hash(&key),
+		     &udpsock->ht_node);
+	rcu_read_unlock();
+
+	isc_nmhandle_settimeout(udpsock->handle, UDPSOCK_IDLE);
+	isc_nm_read(udpsock->handle, udpsock_recv, udpsock);
+}
+
+/*
+ * Hand a parked socket connected to 'dest' over to 'resp'.
+ */
+static bool
+udpsock_get(dns_dispatch_t *disp, dns_dispentry_t *resp,
+	    const isc_sockaddr_t *dest) {
+	dns_dispatchmgr_t *mgr = disp->mgr;
+	dispatch_udpsock_t *udpsock = NULL;
+	struct cds_lfht_iter iter;
+	struct dispatch_key key = {
+		.local = &disp->local,
+		.peer = dest,
+	};
+
+	if (mgr->udpreuse <= 1) {
+		return (false);
+	}
+
+	rcu_read_lock();
+	cds_lfht_lookup(mgr->udps[disp->tid], dispatch_hash(&key),
+			udpsock_match, &key, &iter);
+	struct cds_lfht_node *node = cds_lfht_iter_get_node(&iter);
+	if (node != NULL) {
+		udpsock = caa_container_of(node, dispatch_udpsock_t, ht_node);
+		(void)cds_lfht_del(mgr->udps[disp->tid], node);
+	}
+	rcu_read_unlock();
+
+	if (udpsock == NULL) {
+		return (false);
+	}
+
+	INSIST(udpsock->tid == isc_tid());
+
+	isc_nm_read_stop(udpsock->handle);
+
+	resp->handle = udpsock->handle;
+	udpsock->handle = NULL;
+	resp->local = udpsock->local;
+	resp->peer = *dest;
+	resp->port = isc_sockaddr_getport(&udpsock->local);
+	resp->uses = udpsock->uses;
+
+	udpsock_destroy(udpsock);
+
+	inc_stats(mgr, dns_resstatscounter_udpreuse);
+
+	return (true);
 }
 
 isc_result_t
@@ -1213,7 +1468,8 @@ dns_dispatch_createtcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *localaddr,
 
 isc_result_t
 dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
-		    const isc_sockaddr_t *localaddr, dns_dispatch_t **dispp) {
+		    const isc_sockaddr_t *localaddr, dns_transport_t *transport,
+		    dns_dispatch_t **dispp) {
 	dns_dispatch_t *disp_connected = NULL;
 	dns_dispatch_t *disp_fallback = NULL;
 	isc_result_t result = ISC_R_NOTFOUND;
@@ -1226,6 +1482,7 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 	struct dispatch_key key = {
 		.local = localaddr,
 		.peer = destaddr,
+		.transport = transport,
 	};
 
 	rcu_read_lock();
@@ -1242,7 +1499,7 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 			/* A dispatch in indeterminate state, skip it */
 			break;
 		case DNS_DISPATCHSTATE_CONNECTED:
-			if (ISC_LIST_EMPTY(disp->active)) {
+			if (ISC_LIST_EMPTY(disp->active) && !disp->idle) {
 				/* Ignore dispatch with no responses */
 				break;
 			}
@@ -1290,6 +1547,10 @@ dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
 		result = ISC_R_SUCCESS;
 	}
 
+	if (result == ISC_R_SUCCESS) {
+		inc_stats(mgr, dns_resstatscounter_tcpreuse);
+	}
+
 	return (result);
 }
 
@@ -1388,6 +1649,9 @@ dispatch_destroy(dns_dispatch_t *disp) {
 			     &disp->handle);
 		isc_nmhandle_detach(&disp->handle);
 	}
+	if (disp->transport != NULL) {
+		dns_transport_detach(&disp->transport);
+	}
 	dns_dispatchmgr_detach(&disp->mgr);
 
 	call_rcu(&disp->rcu_head, dispatch_destroy_rcu);
@@ -1444,7 +1708,9 @@ dns_dispatch_add(dns_dispatch_t *disp, isc_loop_t *loop,
 #endif
 	isc_refcount_init(&resp->references, 1); /* DISPENTRY000 */
 
-	if (disp->socktype == isc_socktype_udp) {
+	if (disp->socktype == isc_socktype_udp &&
+	    !udpsock_get(disp, resp, dest))
+	{
 		isc_result_t result = setup_socket(disp, resp, dest,
 						   &localport);
 		if (result != ISC_R_SUCCESS) {
@@ -1468,8 +1734,9 @@ dns_dispatch_add(dns_dispatch_t *disp, isc_loop_t *loop,
 				   : (dns_messageid_t)isc_random16();
 
 		struct cds_lfht_node *node =
-			cds_lfht_add_unique(disp->mgr->qids, qid_hash(resp),
-					    qid_match, resp, &resp->ht_node);
+			cds_lfht_add_unique(disp->mgr->qids[disp->tid],
+					    qid_hash(resp), qid_match, resp,
+					    &resp->ht_node);
 
 		if (node != &resp->ht_node) {
 			if ((options & DNS_DISPATCHOPT_FIXEDID) != 0) {
@@ -1486,6 +1753,9 @@ dns_dispatch_add(dns_dispatch_t *disp, isc_loop_t *loop,
 	} while (i++ < QID_MAX_TRIES);
 fail:
 	if (result != ISC_R_SUCCESS) {
+		if (resp->handle != NULL) {
+			isc_nmhandle_detach(&resp->handle);
+		}
 		isc_mem_put(disp->mctx, resp, sizeof(*resp));
 		return (result);
 	}
@@ -1599,7 +1869,7 @@ udp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 
 	dec_stats(disp->mgr, dns_resstatscounter_disprequdp);
 
-	(void)cds_lfht_del(disp->mgr->qids, &resp->ht_node);
+	(void)cds_lfht_del(disp->mgr->qids[disp->tid], &resp->ht_node);
 
 	resp->state = DNS_DISPATCHSTATE_CANCELED;
 
@@ -1650,40 +1920,36 @@ tcp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 		if (ISC_LIST_EMPTY(disp->active)) {
 			INSIST(disp->handle != NULL);
 
-#if DISPATCH_TCP_KEEPALIVE
-			/*
-			 * This is an experimental code that keeps the TCP
-			 * connection open for 1 second before it is finally
-			 * closed.  By keeping the TCP connection open, it can
-			 * be reused by dns_request that uses
-			 * dns_dispatch_gettcp() to join existing TCP
-			 * connections.
-			 *
-			 * It is disabled for now, because it changes the
-			 * behaviour, but I am keeping the code here for future
-			 * reference when we improve the dns_dispatch to reuse
-			 * the TCP connections also in the resolver.
-			 *
-			 * The TCP connection reuse should be seamless and not
-			 * require any extra handling on the client side though.
-			 */
-			isc_nmhandle_cleartimeout(disp->handle);
-			isc_nmhandle_settimeout(disp->handle, 1000);
-
-			if (!disp->reading) {
-				dispentry_log(resp, ISC_LOG_DEBUG(90),
-					      "final 1 second timeout on %p",
-					      disp->handle);
-				tcp_startrecv(disp, NULL);
-			}
-#else
-			if (disp->reading) {
+			if (disp->mgr->tcpreuse > 0 && disp->timedout == 0 &&
+			    disp->state == DNS_DISPATCHSTATE_CONNECTED &&
+			    (disp->options & DNS_DISPATCHOPT_UNSHARED) == 0)
+			{
+				/*
+				 * Keep the connection open for a while, so
+				 * that dns_dispatch_gettcp() can hand it out
+				 * again.  The pending read holds a reference
+				 * to the dispatch; if the connection is not
+				 * reused before the read times out, tcp_recv()
+				 * closes it.
+				 */
+				disp->idle = true;
+				isc_nmhandle_cleartimeout(disp->handle);
+				isc_nmhandle_settimeout(disp->handle,
+							disp->mgr->tcpreuse);
+
+				if (!disp->reading) {
+					dispentry_log(resp, ISC_LOG_DEBUG(90),
+						      "keeping %p open for "
+						      "reuse",
+						      disp->handle);
+					tcp_startrecv(disp, NULL);
+				}
+			} else if (disp->reading) {
 				dispentry_log(resp, ISC_LOG_DEBUG(90),
 					      "canceling read on %p",
 					      disp->handle);
 				isc_nm_cancelread(disp->handle);
 			}
-#endif
 		}
 		break;
 
@@ -1696,7 +1962,7 @@ tcp_dispentry_cancel(dns_dispentry_t *resp, isc_result_t result) {
 
 	dec_stats(disp->mgr, dns_resstatscounter_dispreqtcp);
 
-	(void)cds_lfht_del(disp->mgr->qids, &resp->ht_node);
+	(void)cds_lfht_del(disp->mgr->qids[disp->tid], &resp->ht_node);
 
 	resp->state = DNS_DISPATCHSTATE_CANCELED;
 
@@ -1749,13 +2015,17 @@ static void
 udp_startrecv(isc_nmhandle_t *handle, dns_dispentry_t *resp) {
 	REQUIRE(VALID_RESPONSE(resp));
 
-	dispentry_log(resp, ISC_LOG_DEBUG(90), "attaching handle %p to %p",
-		      handle, &resp->handle);
-	isc_nmhandle_attach(handle, &resp->handle);
+	if (resp->handle == NULL) {
+		dispentry_log(resp, ISC_LOG_DEBUG(90),
+			      "attaching handle %p to %p", handle,
+			      &resp->handle);
+		isc_nmhandle_attach(handle, &resp->handle);
+	}
 	dns_dispentry_ref(resp); /* DISPENTRY003 */
 	dispentry_log(resp, ISC_LOG_DEBUG(90), "reading");
 	isc_nm_read(resp->handle, udp_recv, resp);
 	resp->reading = true;
+	resp->reusable = false;
 }
 
 static void
@@ -1919,6 +2189,16 @@ detach:
 	dns_dispentry_detach(&resp); /* DISPENTRY004 */
 }
 
+static void
+udp_reconnected(void *arg) {
+	dns_dispentry_t *resp = (dns_dispentry_t *)arg;
+
+	if (resp->state == DNS_DISPATCHSTATE_CONNECTING) {
+		isc_nmhandle_settimeout(resp->handle, resp->timeout);
+	}
+	udp_connected(resp->handle, ISC_R_SUCCESS, resp);
+}
+
 static void
 udp_dispatch_connect(dns_dispatch_t *disp, dns_dispentry_t *resp) {
 	REQUIRE(disp->tid == isc_tid());
@@ -1927,6 +2207,12 @@ udp_dispatch_connect(dns_dispatch_t *disp, dns_dispentry_t *resp) {
 	dns_dispentry_ref(resp); /* DISPENTRY004 */
 	ISC_LIST_APPEND(disp->pending, resp, plink);
 
+	if (resp->handle != NULL) {
+		/* A parked socket, it is connected already */
+		isc_async_run(resp->loop, udp_reconnected, resp);
+		return;
+	}
+
 	isc_nm_udpconnect(disp->mgr->nm, &resp->local, &resp->peer,
 			  udp_connected, resp, resp->timeout);
 }
@@ -1973,6 +2259,10 @@ tcp_dispatch_connect(dns_dispatch_t *disp, dns_dispentry_t *resp) {
 		isc_sockaddr_format(&disp->peer, peerbuf,
 				    ISC_SOCKADDR_FORMATSIZE);
 
+		if (resp->transport != NULL) {
+			dns_transport_attach(resp->transport, &disp->transport);
+		}
+
 		dns_dispatch_ref(disp); /* DISPATCH003 */
 		dispentry_log(resp, ISC_LOG_DEBUG(90),
 			      "connecting from %s to %s, timeout %u", localbuf,
@@ -1996,6 +2286,13 @@ tcp_dispatch_connect(dns_dispatch_t *disp, dns_dispentry_t *resp) {
 		resp->state = DNS_DISPATCHSTATE_CONNECTED;
 		resp->start = isc_loop_now(resp->loop);
 
+		if (disp->idle) {
+			/* The idle read is now waiting for this response */
+			INSIST(ISC_LIST_EMPTY(disp->active));
+			disp->idle = false;
+			isc_nmhandle_settimeout(disp->handle, resp->timeout);
+		}
+
 		/* Add the resp to the reading list */
 		ISC_LIST_APPEND(disp->active, resp, alink);
 		dispentry_log(resp, ISC_LOG_DEBUG(90),
@@ -2104,6 +2401,7 @@ udp_dispatch_getnext(dns_dispentry_t *resp, int32_t timeout) {
 	dns_dispentry_ref(resp); /* DISPENTRY003 */
 	isc_nm_read(resp->handle, udp_recv, resp);
 	resp->reading = true;
+	resp->reusable = false;
 }
 
 void
@@ -126,37 +126,54 @@ dns_dns64_destroy(dns_dns64_t **dns64p) {
 	isc_mem_putanddetach(&dns64->mctx, dns64, sizeof(*dns64));
 }
 
-isc_result_t
-dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
-		    const dns_name_t *reqsigner, dns_aclenv_t *env,
-		    unsigned int flags, unsigned char *a, unsigned char *aaaa) {
-	unsigned int nbytes, i;
+bool
+dns_dns64_applies(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		  const dns_name_t *reqsigner, dns_aclenv_t *env,
+		  unsigned int flags) {
 	isc_result_t result;
 	int match;
 
 	if ((dns64->flags & DNS_DNS64_RECURSIVE_ONLY) != 0 &&
 	    (flags & DNS_DNS64_RECURSIVE) == 0)
 	{
-		return (DNS_R_DISALLOWED);
+		return (false);
 	}
 
 	if ((dns64->flags & DNS_DNS64_BREAK_DNSSEC) == 0 &&
 	    (flags & DNS_DNS64_DNSSEC) != 0)
 	{
-		return (DNS_R_DISALLOWED);
+		return (false);
 	}
 
 	if (dns64->clients != NULL && reqaddr != NULL) {
 		result = dns_acl_match(reqaddr, reqsigner, dns64->clients, env,
 				       &match, NULL);
-		if (result != ISC_R_SUCCESS) {
-			return (result);
-		}
-		if (match <= 0) {
-			return (DNS_R_DISALLOWED);
+		if (result != ISC_R_SUCCESS || match <= 0) {
+			return (false);
 		}
 	}
 
+	return (true);
+}
+
+isc_result_t
+dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		    const dns_name_t *reqsigner, dns_aclenv_t *env,
+		    unsigned int flags, unsigned char *a, unsigned char *aaaa) {
+	if (!dns_dns64_applies(dns64, reqaddr, reqsigner, env, flags)) {
+		return (DNS_R_DISALLOWED);
+	}
+
+	return (dns_dns64_synthesize(dns64, env, a, aaaa));
+}
+
+isc_result_t
+dns_dns64_synthesize(const dns_dns64_t *dns64, dns_aclenv_t *env,
+		     const unsigned char *a, unsigned char *aaaa) {
+	unsigned int nbytes, i;
+	isc_result_t result;
+	int match;
+
 	if (dns64->mapped != NULL) {
 		struct in_addr ina;
 		isc_netaddr_t netaddr;
@@ -37,6 +37,7 @@
 #include <dns/rdata.h>
 #include <dns/rdatalist.h>
 #include <dns/rdataset.h>
+#include <dns/rdataslab.h>
 #include <dns/rdatastruct.h>
 #include <dns/stats.h>
 #include <dns/tsig.h> /* for DNS_TSIG_FUDGE */
@@ -65,6 +66,10 @@ static isc_result_t
 rdataset_to_sortedarray(dns_rdataset_t *set, isc_mem_t *mctx,
 			dns_rdata_t **rdata, int *nrdata);
 
+static isc_result_t
+digest_rdataset(dst_context_t *ctx, dns_rdataset_t *set, isc_mem_t *mctx,
+		isc_region_t *envelope);
+
 static isc_result_t
 digest_callback(void *arg, isc_region_t *data) {
 	dst_context_t *ctx = arg;
@@ -130,6 +135,107 @@ rdataset_to_sortedarray(dns_rdataset_t *set, isc_mem_t *mctx,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Digest one rdata in canonical form, preceded by the envelope and
+ * the rdata length.
+ */
+static isc_result_t
+digest_rdata(dst_context_t *ctx, isc_region_t *envelope, dns_rdata_t *rdata) {
+	isc_result_t ret;
+	uint16_t len;
+	isc_buffer_t lenbuf;
+	isc_region_t lenr;
+
+	/*
+	 * Digest the envelope.
+	 */
+	ret = dst_context_adddata(ctx, envelope);
+	if (ret != ISC_R_SUCCESS) {
+		return (ret);
+	}
+
+	/*
+	 * Digest the length of the rdata.
+	 */
+	isc_buffer_init(&lenbuf, &len, sizeof(len));
+	INSIST(rdata->length < 65536);
+	isc_buffer_putuint16(&lenbuf, (uint16_t)rdata->length);
+	isc_buffer_usedregion(&lenbuf, &lenr);
+	ret = dst_context_adddata(ctx, &lenr);
+	if (ret != ISC_R_SUCCESS) {
+		return (ret);
+	}
+
+	/*
+	 * Digest the rdata.
+	 */
+	return (dns_rdata_digest(rdata, digest_callback, ctx));
+}
+
+/*
+ * Digest the RRset in DNSSEC canonical order, without duplicates.
+ */
+static isc_result_t
+digest_rdataset(dst_context_t *ctx, dns_rdataset_t *set, isc_mem_t *mctx,
+		isc_region_t *envelope) {
+	isc_result_t ret;
+	dns_rdata_t *rdatas = NULL;
+	int nrdatas, i;
+
+	/*
+	 * A slab keeps its rdata sorted with dns_rdata_compare() and
+	 * without duplicates, so unless it is being iterated in load
+	 * order it can be digested as it is.
+	 */
+	if (set->methods == &dns_rdataslab_rdatasetmethods &&
+	    (set->attributes & DNS_RDATASETATTR_LOADORDER) == 0)
+	{
+		dns_rdataset_t rdataset;
+
+		dns_rdataset_init(&rdataset);
+		dns_rdataset_clone(set, &rdataset);
+		for (ret = dns_rdataset_first(&rdataset); ret == ISC_R_SUCCESS;
+		     ret = dns_rdataset_next(&rdataset))
+		{
+			dns_rdata_t rdata = DNS_RDATA_INIT;
+
+			dns_rdataset_current(&rdataset, &rdata);
+			ret = digest_rdata(ctx, envelope, &rdata);
+			if (ret != ISC_R_SUCCESS) {
+				break;
+			}
+		}
+		dns_rdataset_disassociate(&rdataset);
+		if (ret == ISC_R_NOMORE) {
+			ret = ISC_R_SUCCESS;
+		}
+		return (ret);
+	}
+
+	ret = rdataset_to_sortedarray(set, mctx, &rdatas, &nrdatas);
+	if (ret != ISC_R_SUCCESS) {
+		return (ret);
+	}
+
+	for (i = 0; i < nrdatas; i++) {
+		/*
+		 * Skip duplicates.
+		 */
+		if (i > 0 && dns_rdata_compare(&rdatas[i], &rdatas[i - 1]) == 0)
+		{
+			continue;
+		}
+
+		ret = digest_rdata(ctx, envelope, &rdatas[i]);
+		if (ret != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	isc_mem_cput(mctx, rdatas, nrdatas, sizeof(dns_rdata_t));
+	return (ret);
+}
+
 isc_result_t
 dns_dnssec_keyfromrdata(const dns_name_t *name, const dns_rdata_t *rdata,
 			isc_mem_t *mctx, dst_key_t **key) {
@@ -185,8 +291,6 @@ dns_dnssec_sign(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 		isc_mem_t *mctx, isc_buffer_t *buffer, dns_rdata_t *sigrdata) {
 	dns_rdata_rrsig_t sig;
 	dns_rdata_t tmpsigrdata;
-	dns_rdata_t *rdatas;
-	int nrdatas, i;
 	isc_buffer_t sigbuf, envbuf;
 	isc_region_t r;
 	dst_context_t *ctx = NULL;
@@ -296,70 +400,27 @@ dns_dnssec_sign(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	isc_buffer_putuint16(&envbuf, set->rdclass);
 	isc_buffer_putuint32(&envbuf, set->ttl);
 
-	ret = rdataset_to_sortedarray(set, mctx, &rdatas, &nrdatas);
-	if (ret != ISC_R_SUCCESS) {
-		goto cleanup_context;
-	}
 	isc_buffer_usedregion(&envbuf, &r);
 
-	for (i = 0; i < nrdatas; i++) {
-		uint16_t len;
-		isc_buffer_t lenbuf;
-		isc_region_t lenr;
-
-		/*
-		 * Skip duplicates.
-		 */
-		if (i > 0 && dns_rdata_compare(&rdatas[i], &rdatas[i - 1]) == 0)
-		{
-			continue;
-		}
-
-		/*
-		 * Digest the envelope.
-		 */
-		ret = dst_context_adddata(ctx, &r);
-		if (ret != ISC_R_SUCCESS) {
-			goto cleanup_array;
-		}
-
-		/*
-		 * Digest the length of the rdata.
-		 */
-		isc_buffer_init(&lenbuf, &len, sizeof(len));
-		INSIST(rdatas[i].length < 65536);
-		isc_buffer_putuint16(&lenbuf, (uint16_t)rdatas[i].length);
-		isc_buffer_usedregion(&lenbuf, &lenr);
-		ret = dst_context_adddata(ctx, &lenr);
-		if (ret != ISC_R_SUCCESS) {
-			goto cleanup_array;
-		}
-
-		/*
-		 * Digest the rdata.
-		 */
-		ret = dns_rdata_digest(&rdatas[i], digest_callback, ctx);
-		if (ret != ISC_R_SUCCESS) {
-			goto cleanup_array;
-		}
+	ret = digest_rdataset(ctx, set, mctx, &r);
+	if (ret != ISC_R_SUCCESS) {
+		goto cleanup_context;
 	}
 
 	isc_buffer_init(&sigbuf, sig.signature, sig.siglen);
 	ret = dst_context_sign(ctx, &sigbuf);
 	if (ret != ISC_R_SUCCESS) {
-		goto cleanup_array;
+		goto cleanup_context;
 	}
 	isc_buffer_usedregion(&sigbuf, &r);
 	if (r.length != sig.siglen) {
 		ret = ISC_R_NOSPACE;
-		goto cleanup_array;
+		goto cleanup_context;
 	}
 
 	ret = dns_rdata_fromstruct(sigrdata, sig.common.rdclass,
 				   sig.common.rdtype, &sig, buffer);
 
-cleanup_array:
-	isc_mem_cput(mctx, rdatas, nrdatas, sizeof(dns_rdata_t));
 cleanup_context:
 	dst_context_destroy(&ctx);
 cleanup_databuf:
@@ -377,8 +438,6 @@ dns_dnssec_verify(const dns_name_t *name, dns_rdataset_t *set, dst_key_t *key,
 	dns_fixedname_t fnewname;
 	isc_region_t r;
 	isc_buffer_t envbuf;
-	dns_rdata_t *rdatas;
-	int nrdatas, i;
 	isc_stdtime_t now;
 	isc_result_t ret;
 	unsigned char data[300];
@@ -507,53 +566,11 @@ again:
 	isc_buffer_putuint16(&envbuf, set->rdclass);
 	isc_buffer_putuint32(&envbuf, sig.originalttl);
 
-	ret = rdataset_to_sortedarray(set, mctx, &rdatas, &nrdatas);
-	if (ret != ISC_R_SUCCESS) {
-		goto cleanup_context;
-	}
-
 	isc_buffer_usedregion(&envbuf, &r);
 
-	for (i = 0; i < nrdatas; i++) {
-		uint16_t len;
-		isc_buffer_t lenbuf;
-		isc_region_t lenr;
-
-		/*
-		 * Skip duplicates.
-		 */
-		if (i > 0 && dns_rdata_compare(&rdatas[i], &rdatas[i - 1]) == 0)
-		{
-			continue;
-		}
-
-		/*
-		 * Digest the envelope.
-		 */
-		ret = dst_context_adddata(ctx, &r);
-		if (ret != ISC_R_SUCCESS) {
-			goto cleanup_array;
-		}
-
-		/*
-		 * Digest the rdata length.
-		 */
-		isc_buffer_init(&lenbuf, &len, sizeof(len));
-		INSIST(rdatas[i].length < 65536);
-		isc_buffer_putuint16(&lenbuf, (uint16_t)rdatas[i].length);
-		isc_buffer_usedregion(&lenbuf, &lenr);
-
-		/*
-		 * Digest the rdata.
-		 */
-		ret = dst_context_adddata(ctx, &lenr);
-		if (ret != ISC_R_SUCCESS) {
-			goto cleanup_array;
-		}
-		ret = dns_rdata_digest(&rdatas[i], digest_callback, ctx);
-		if (ret != ISC_R_SUCCESS) {
-			goto cleanup_array;
-		}
+	ret = digest_rdataset(ctx, set, mctx, &r);
+	if (ret != ISC_R_SUCCESS) {
+		goto cleanup_context;
 	}
 
 	r.base = sig.signature;
@@ -572,8 +589,6 @@ again:
 		inc_stat(dns_dnssecstats_asis);
 	}
 
-cleanup_array:
-	isc_mem_cput(mctx, rdatas, nrdatas, sizeof(dns_rdata_t));
 cleanup_context:
 	dst_context_destroy(&ctx);
 	if (ret == DST_R_VERIFYFAILURE && !downcase) {
@@ -1225,117 +1240,169 @@ dns_dnssec_get_hints(dns_dnsseckey_t *key, isc_stdtime_t now) {
 	}
 }
 
-static isc_result_t
-findmatchingkeys(const char *directory, char *namebuf, unsigned int len,
-		 isc_mem_t *mctx, isc_stdtime_t now,
-		 dns_dnsseckeylist_t *list) {
-	isc_result_t result = ISC_R_SUCCESS;
-	isc_dir_t dir;
-	bool dir_open = false;
+/*
+ * Check that 'name' is a private key file name for 'namebuf':
+ * K<name>+<3 digit algorithm>+<5 digit key tag>.private.
+ */
+static bool
+keyfilename_matches(const char *name, size_t length, const char *namebuf,
+		    unsigned int len, unsigned int *algp) {
 	unsigned int i, alg;
-	dns_dnsseckey_t *key = NULL;
-	dst_key_t *dstkey = NULL;
 
-	isc_dir_init(&dir);
-	if (directory == NULL) {
-		directory = ".";
+	if (name[0] != 'K' || length < len + 1 || name[len + 1] != '+' ||
+	    strncasecmp(name + 1, namebuf, len) != 0)
+	{
+		return (false);
 	}
-	RETERR(isc_dir_open(&dir, directory));
-	dir_open = true;
 
-	while (isc_dir_read(&dir) == ISC_R_SUCCESS) {
-		if (dir.entry.name[0] != 'K' || dir.entry.length < len + 1 ||
-		    dir.entry.name[len + 1] != '+' ||
-		    strncasecmp(dir.entry.name + 1, namebuf, len) != 0)
-		{
-			continue;
+	alg = 0;
+	for (i = len + 1 + 1; i < length; i++) {
+		if (!isdigit((unsigned char)name[i])) {
+			break;
 		}
+		alg *= 10;
+		alg += name[i] - '0';
+	}
 
-		alg = 0;
-		for (i = len + 1 + 1; i < dir.entry.length; i++) {
-			if (!isdigit((unsigned char)dir.entry.name[i])) {
-				break;
-			}
-			alg *= 10;
-			alg += dir.entry.name[i] - '0';
-		}
+	/*
+	 * Did we not read exactly 3 digits?
+	 * Did we overflow?
+	 * Did we correctly terminate?
+	 */
+	if (i != len + 1 + 1 + 3 || i >= length || name[i] != '+') {
+		return (false);
+	}
 
-		/*
-		 * Did we not read exactly 3 digits?
-		 * Did we overflow?
-		 * Did we correctly terminate?
-		 */
-		if (i != len + 1 + 1 + 3 || i >= dir.entry.length ||
-		    dir.entry.name[i] != '+')
-		{
-			continue;
+	for (i++; i < length; i++) {
+		if (!isdigit((unsigned char)name[i])) {
+			break;
 		}
+	}
 
-		for (i++; i < dir.entry.length; i++) {
-			if (!isdigit((unsigned char)dir.entry.name[i])) {
-				break;
-			}
-		}
+	/*
+	 * Did we not read exactly 5 more digits?
+	 * Did we overflow?
+	 * Did we correctly terminate?
+	 */
+	if (i != len + 1 + 1 + 3 + 1 + 5 || i >= length ||
+	    strcmp(name + i, ".private") != 0)
+	{
+		return (false);
+	}
 
-		/*
-		 * Did we not read exactly 5 more digits?
-		 * Did we overflow?
-		 * Did we correctly terminate?
-		 */
-		if (i != len + 1 + 1 + 3 + 1 + 5 || i >= dir.entry.length ||
-		    strcmp(dir.entry.name + i, ".private") != 0)
-		{
-			continue;
-		}
+	*algp = alg;
+	return (true);
+}
 
-		dstkey = NULL;
-		result = dst_key_fromnamedfile(
-			dir.entry.name, directory,
-			DST_TYPE_PUBLIC | DST_TYPE_PRIVATE | DST_TYPE_STATE,
-			mctx, &dstkey);
-
-		switch (alg) {
-		case DST_ALG_HMACMD5:
-		case DST_ALG_HMACSHA1:
-		case DST_ALG_HMACSHA224:
-		case DST_ALG_HMACSHA256:
-		case DST_ALG_HMACSHA384:
-		case DST_ALG_HMACSHA512:
-			if (result == DST_R_BADKEYTYPE) {
-				continue;
-			}
-		}
+static void
+addkeyfile(const char *name, const char *directory, unsigned int alg,
+	   isc_mem_t *mctx, isc_stdtime_t now, dns_dnsseckeylist_t *list) {
+	isc_result_t result;
+	dns_dnsseckey_t *key = NULL;
+	dst_key_t *dstkey = NULL;
 
-		if (result != ISC_R_SUCCESS) {
-			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
-				      DNS_LOGMODULE_DNSSEC, ISC_LOG_WARNING,
-				      "dns_dnssec_findmatchingkeys: "
-				      "error reading key file %s: %s",
-				      dir.entry.name,
-				      isc_result_totext(result));
-			continue;
+	result = dst_key_fromnamedfile(
+		name, directory,
+		DST_TYPE_PUBLIC | DST_TYPE_PRIVATE | DST_TYPE_STATE, mctx,
+		&dstkey);
+
+	switch (alg) {
+	case DST_ALG_HMACMD5:
+	case DST_ALG_HMACSHA1:
+	case DST_ALG_HMACSHA224:
+	case DST_ALG_HMACSHA256:
+	case DST_ALG_HMACSHA384:
+	case DST_ALG_HMACSHA512:
+		if (result == DST_R_BADKEYTYPE) {
+			return;
 		}
+	}
+
+	if (result != ISC_R_SUCCESS) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_DNSSEC, ISC_LOG_WARNING,
+			      "dns_dnssec_findmatchingkeys: "
+			      "error reading key file %s: %s",
+			      name, isc_result_totext(result));
+		return;
+	}
 
-		dns_dnsseckey_create(mctx, &dstkey, &key);
-		key->source = dns_keysource_repository;
-		dns_dnssec_get_hints(key, now);
+	dns_dnsseckey_create(mctx, &dstkey, &key);
+	key->source = dns_keysource_repository;
+	dns_dnssec_get_hints(key, now);
 
-		if (key->legacy) {
-			dns_dnsseckey_destroy(mctx, &key);
-		} else {
-			ISC_LIST_APPEND(*list, key, link);
-			key = NULL;
+	if (key->legacy) {
+		dns_dnsseckey_destroy(mctx, &key);
+	} else {
+		ISC_LIST_APPEND(*list, key, link);
+	}
+}
+
+/*
+ * Look up the key files of a zone in the keystore's index of the
+ * directory, rather than reading the whole directory for each zone.
+ */
+static isc_result_t
+findkeystorekeys(dns_keystore_t *keystore, const char *directory,
+		 char *namebuf, unsigned int len, isc_mem_t *mctx,
+		 isc_stdtime_t now, dns_dnsseckeylist_t *list) {
+	isc_result_t result;
+	char prefix[DNS_NAME_FORMATSIZE + 2];
+	char **files = NULL;
+	size_t count = 0;
+	unsigned int alg;
+
+	if (directory == NULL) {
+		directory = ".";
+	}
+
+	snprintf(prefix, sizeof(prefix), "K%s+", namebuf);
+	result = dns_keystore_keyfiles(keystore, directory, prefix, mctx,
+				       &files, &count);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		if (keyfilename_matches(files[i], strlen(files[i]), namebuf,
+					len, &alg))
+		{
+			addkeyfile(files[i], directory, alg, mctx, now, list);
 		}
 	}
 
-failure:
-	if (dir_open) {
-		isc_dir_close(&dir);
+	dns_keystore_freekeyfiles(mctx, &files, count);
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+findmatchingkeys(const char *directory, char *namebuf, unsigned int len,
+		 isc_mem_t *mctx, isc_stdtime_t now,
+		 dns_dnsseckeylist_t *list) {
+	isc_result_t result;
+	isc_dir_t dir;
+	unsigned int alg;
+
+	isc_dir_init(&dir);
+	if (directory == NULL) {
+		directory = ".";
 	}
-	if (dstkey != NULL) {
-		dst_key_free(&dstkey);
+	result = isc_dir_open(&dir, directory);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
 	}
-	return (result);
+
+	while (isc_dir_read(&dir) == ISC_R_SUCCESS) {
+		if (keyfilename_matches(dir.entry.name, dir.entry.length,
+					namebuf, len, &alg))
+		{
+			addkeyfile(dir.entry.name, directory, alg, mctx, now,
+				   list);
+		}
+	}
+
+	isc_dir_close(&dir);
+	return (ISC_R_SUCCESS);
 }
 
 /*%
@@ -1378,9 +1445,9 @@ dns_dnssec_findmatchingkeys(const dns_name_t *origin, dns_kasp_t *kasp,
 					const char *directory =
 						dns_keystore_directory(keystore,
 								       keydir);
-					RETERR(findmatchingkeys(
-						directory, namebuf, len, mctx,
-						now, &list));
+					RETERR(findkeystorekeys(
+						keystore, directory, namebuf,
+						len, mctx, now, &list));
 					break;
 				}
 			}
@@ -57,6 +57,8 @@
 #include <isc/async.h>
 #include <isc/buffer.h>
 #include <isc/file.h>
+#include <isc/hash.h>
+#include <isc/histo.h>
 #include <isc/log.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
@@ -72,6 +74,7 @@
 #include <dns/log.h>
 #include <dns/message.h>
 #include <dns/name.h>
+#include <dns/rcode.h>
 #include <dns/rdataset.h>
 #include <dns/stats.h>
 #include <dns/types.h>
@@ -82,8 +85,13 @@
 #define DTENV_MAGIC	 ISC_MAGIC('D', 't', 'n', 'v')
 #define VALID_DTENV(env) ISC_MAGIC_VALID(env, DTENV_MAGIC)
 
-#define DNSTAP_CONTENT_TYPE	"protobuf:dnstap.Dnstap"
-#define DNSTAP_INITIAL_BUF_SIZE 256
+#define DNSTAP_CONTENT_TYPE "protobuf:dnstap.Dnstap"
+
+/*
+ * The precision of the response latency histogram: 4 significant bits
+ * give quantiles which are within about 6% of the exact values.
+ */
+#define DNSTAP_LATENCY_SIGBITS 4
 
 struct dns_dtmsg {
 	void *buf;
@@ -110,6 +118,7 @@ struct dns_dtenv {
 
 	isc_mutex_t reopen_lock; /* locks 'reopen_queued' */
 	bool reopen_queued;
+	atomic_uint_fast32_t size_checked; /* last file size check (s) */
 
 	isc_region_t identity;
 	isc_region_t version;
@@ -119,6 +128,14 @@ struct dns_dtenv {
 	int rolls;
 	isc_log_rollsuffix_t suffix;
 	isc_stats_t *stats;
+
+	uint32_t sample;		 /* log 1 in 'sample' messages */
+	uint32_t summary_interval;	 /* seconds, 0 for no summaries */
+	atomic_uint_fast32_t summarized; /* time of the last summary (s) */
+	atomic_uint_fast64_t seen;	 /* messages seen */
+	atomic_uint_fast64_t logged;	 /* messages sampled and logged */
+	atomic_uint_fast64_t rcodes[16]; /* responses per response code */
+	isc_histo_t *latency;		 /* response latency (us) */
 };
 
 #define CHECK(x)                             \
@@ -169,6 +186,7 @@ dns_dt_create(isc_mem_t *mctx, dns_dtmode_t mode, const char *path,
 	env->path = isc_mem_strdup(env->mctx, path);
 	isc_refcount_init(&env->refcount, 1);
 	isc_stats_create(env->mctx, &env->stats, dns_dnstapcounter_max);
+	isc_histo_create(env->mctx, DNSTAP_LATENCY_SIGBITS, &env->latency);
 
 	fwopt = fstrm_writer_options_init();
 	if (fwopt == NULL) {
@@ -238,6 +256,7 @@ cleanup:
 		if (env->stats != NULL) {
 			isc_stats_detach(&env->stats);
 		}
+		isc_histo_destroy(&env->latency);
 		isc_mem_putanddetach(&env->mctx, env, sizeof(dns_dtenv_t));
 	}
 
@@ -422,6 +441,20 @@ dns_dt_setversion(dns_dtenv_t *env, const char *version) {
 	return (toregion(env, &env->version, version));
 }
 
+void
+dns_dt_setsample(dns_dtenv_t *env, uint32_t rate) {
+	REQUIRE(VALID_DTENV(env));
+
+	env->sample = rate;
+}
+
+void
+dns_dt_setsummary(dns_dtenv_t *env, uint32_t interval) {
+	REQUIRE(VALID_DTENV(env));
+
+	env->summary_interval = interval;
+}
+
 static void
 set_dt_ioq(unsigned int generation, struct fstrm_iothr_queue *ioq) {
 	dt_ioq.generation = generation;
@@ -501,6 +534,7 @@ destroy(dns_dtenv_t *env) {
 	if (env->stats != NULL) {
 		isc_stats_detach(&env->stats);
 	}
+	isc_histo_destroy(&env->latency);
 
 	isc_mem_putanddetach(&env->mctx, env, sizeof(*env));
 }
@@ -519,28 +553,25 @@ dns_dt_detach(dns_dtenv_t **envp) {
 
 static isc_result_t
 pack_dt(const Dnstap__Dnstap *d, void **buf, size_t *sz) {
-	ProtobufCBufferSimple sbuf;
+	size_t len;
 
 	REQUIRE(d != NULL);
 	REQUIRE(sz != NULL);
 
-	memset(&sbuf, 0, sizeof(sbuf));
-	sbuf.base.append = protobuf_c_buffer_simple_append;
-	sbuf.len = 0;
-	sbuf.alloced = DNSTAP_INITIAL_BUF_SIZE;
+	/*
+	 * Size the buffer up front, so the message is encoded in a single
+	 * pass instead of being copied each time the buffer has to grow.
+	 */
+	len = dnstap__dnstap__get_packed_size(d);
 
-	/* Need to use malloc() here because protobuf uses free() */
-	sbuf.data = malloc(sbuf.alloced);
-	if (sbuf.data == NULL) {
+	/* Need to use malloc() here because fstrm uses free() */
+	*buf = malloc(len);
+	if (*buf == NULL) {
 		return (ISC_R_NOMEMORY);
 	}
-	sbuf.must_free_data = 1;
 
-	*sz = dnstap__dnstap__pack_to_buffer(d, (ProtobufCBuffer *)&sbuf);
-	if (sbuf.data == NULL) {
-		return (ISC_R_FAILURE);
-	}
-	*buf = sbuf.data;
+	*sz = dnstap__dnstap__pack(d, *buf);
+	INSIST(*sz == len);
 
 	return (ISC_R_SUCCESS);
 }
@@ -699,14 +730,28 @@ perform_reopen(void *arg) {
  * actual roll happens asynchronously).
  */
 static void
-check_file_size_and_maybe_reopen(dns_dtenv_t *env) {
+check_file_size_and_maybe_reopen(dns_dtenv_t *env, isc_time_t *now) {
 	struct stat statbuf;
+	uint_fast32_t checked = atomic_load_relaxed(&env->size_checked);
+	uint_fast32_t seconds = isc_time_seconds(now);
 
 	/* If a loopmgr wasn't specified, abort. */
 	if (env->loop == NULL) {
 		return;
 	}
 
+	/*
+	 * Calling stat() for every message would be expensive; check the
+	 * file size at most once per second, in whichever thread gets
+	 * here first.
+	 */
+	if (checked == seconds ||
+	    !atomic_compare_exchange_strong_relaxed(&env->size_checked,
+						    &checked, seconds))
+	{
+		return;
+	}
+
 	/*
 	 * If an output file roll is not currently queued, check the current
 	 * size of the output file to see whether a roll is needed.  Return if
@@ -730,6 +775,120 @@ unlock_and_return:
 	UNLOCK(&env->reopen_lock);
 }
 
+/*%
+ * Decide whether to log a message, based on its ID so that a query and
+ * its response get the same treatment.
+ */
+static bool
+sampled(dns_dtenv_t *env, isc_buffer_t *buf) {
+	isc_region_t r;
+
+	if (env->sample <= 1) {
+		return (true);
+	}
+
+	isc_buffer_usedregion(buf, &r);
+	if (r.length < 2) {
+		return (true);
+	}
+
+	return (isc_hash32(r.base, 2, true) % env->sample == 0);
+}
+
+/*%
+ * Account for a message in the summary statistics.
+ */
+static void
+summary_add(dns_dtenv_t *env, dns_dtmsgtype_t msgtype, isc_buffer_t *buf,
+	    isc_time_t *qtime, isc_time_t *rtime) {
+	isc_region_t r;
+
+	atomic_fetch_add_relaxed(&env->seen, 1);
+
+	if ((msgtype & DNS_DTTYPE_RESPONSE) == 0) {
+		return;
+	}
+
+	isc_buffer_usedregion(buf, &r);
+	if (r.length >= 4) {
+		atomic_fetch_add_relaxed(&env->rcodes[r.base[3] & 0x0f], 1);
+	}
+
+	if (qtime != NULL && isc_time_compare(rtime, qtime) >= 0) {
+		isc_histo_inc(env->latency, isc_time_microdiff(rtime, qtime));
+	}
+}
+
+/*%
+ * Log the summary statistics, if the summary interval has elapsed.
+ * Just like the file size check, only one thread gets to do it.
+ */
+static void
+summary_maybe_log(dns_dtenv_t *env, isc_time_t *now) {
+	static const double fractions[] = { 0.99, 0.9, 0.5 };
+	uint64_t quantiles[ARRAY_SIZE(fractions)];
+	uint_fast32_t last = atomic_load_relaxed(&env->summarized);
+	uint_fast32_t seconds = isc_time_seconds(now);
+	char rcodes[256], latency[128];
+	isc_buffer_t b;
+
+	if (last == 0) {
+		/* Start counting the interval from the first message */
+		(void)atomic_compare_exchange_strong_relaxed(
+			&env->summarized, &last, seconds);
+		return;
+	}
+
+	if (seconds - last < env->summary_interval ||
+	    !atomic_compare_exchange_strong_relaxed(&env->summarized, &last,
+						    seconds))
+	{
+		return;
+	}
+
+	isc_buffer_init(&b, rcodes, sizeof(rcodes));
+	for (dns_rcode_t rcode = 0; rcode < ARRAY_SIZE(env->rcodes); rcode++)
+	{
+		uint64_t count = atomic_load_relaxed(&env->rcodes[rcode]);
+		char num[32];
+
+		if (count == 0) {
+			continue;
+		}
+		if (isc_buffer_availablelength(&b) < sizeof(num) + 16 ||
+		    dns_rcode_totext(rcode, &b) != ISC_R_SUCCESS)
+		{
+			break;
+		}
+		snprintf(num, sizeof(num), " %" PRIu64 ", ", count);
+		isc_buffer_putstr(&b, num);
+	}
+	if (isc_buffer_usedlength(&b) >= 2) {
+		/* Drop the trailing separator */
+		isc_buffer_subtract(&b, 2);
+	}
+	isc_buffer_putuint8(&b, 0);
+
+	if (isc_histo_quantiles(env->latency, ARRAY_SIZE(fractions), fractions,
+				quantiles) == ISC_R_SUCCESS)
+	{
+		snprintf(latency, sizeof(latency),
+			 "; response latency median %" PRIu64 "us, "
+			 "90%% %" PRIu64 "us, 99%% %" PRIu64 "us",
+			 quantiles[2], quantiles[1], quantiles[0]);
+	} else {
+		latency[0] = '\0';
+	}
+
+	isc_log_write(dns_lctx, DNS_LOGCATEGORY_DNSTAP, DNS_LOGMODULE_DNSTAP,
+		      ISC_LOG_INFO,
+		      "dnstap summary: %" PRIu64 " messages, %" PRIu64
+		      " logged; responses: %s%s",
+		      atomic_load_relaxed(&env->seen),
+		      atomic_load_relaxed(&env->logged),
+		      isc_buffer_usedlength(&b) > 1 ? rcodes : "none", latency);
+}
+
 void
 dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 	    isc_sockaddr_t *raddr, bool tcp, isc_region_t *zone,
@@ -749,12 +908,25 @@ dns_dt_send(dns_view_t *view, dns_dtmsgtype_t msgtype, isc_sockaddr_t *qaddr,
 
 	REQUIRE(VALID_DTENV(view->dtenv));
 
+	now = isc_time_now();
+	t = &now;
+
 	if (view->dtenv->max_size != 0) {
-		check_file_size_and_maybe_reopen(view->dtenv);
+		check_file_size_and_maybe_reopen(view->dtenv, &now);
 	}
 
-	now = isc_time_now();
-	t = &now;
+	if (view->dtenv->summary_interval != 0) {
+		summary_add(view->dtenv, msgtype, buf, qtime,
+			    rtime != NULL ? rtime : &now);
+		summary_maybe_log(view->dtenv, &now);
+	}
+
+	if (!sampled(view->dtenv, buf)) {
+		return;
+	}
+	if (view->dtenv->summary_interval != 0) {
+		atomic_fetch_add_relaxed(&view->dtenv->logged, 1);
+	}
 
 	init_msg(view->dtenv, &dm, dnstap_type(msgtype));
 
@@ -37,6 +37,7 @@
 #include <openssl/objects.h>
 #include <openssl/rsa.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/hmac.h>
 #include <isc/lang.h>
@@ -101,6 +102,10 @@ struct dst_key {
 		struct {
 			EVP_PKEY *pub;
 			EVP_PKEY *priv;
+			/* initialized contexts to copy, see
+			 * dst__openssl_digestinit() */
+			atomic_ptr(EVP_MD_CTX) signctx;
+			atomic_ptr(EVP_MD_CTX) verifyctx;
 		} pkeypair;
 	} keydata; /*%< pointer to key in crypto pkg fmt */
 
@@ -59,4 +59,20 @@ dst__openssl_keypair_isprivate(const dst_key_t *key);
 void
 dst__openssl_keypair_destroy(dst_key_t *key);
 
+int
+dst__openssl_digestinit(dst_key_t *key, bool sign, const EVP_MD *type,
+			EVP_MD_CTX *ctx);
+/*%<
+ * Set up 'ctx' as EVP_DigestSignInit() or EVP_DigestVerifyInit() would
+ * with 'type' and the private or public key of 'key'.  A context that
+ * has been set up once is kept with the key, and later calls copy it,
+ * which is much cheaper than looking up the algorithm implementation
+ * and preparing the key again.
+ *
+ * Requires:
+ *\li	'type' is not NULL, and is the same in every call for a key.
+ *
+ * Returns 1 on success and 0 on failure, like the OpenSSL functions.
+ */
+
 ISC_LANG_ENDDECLS
@@ -24,6 +24,7 @@
 #include <maxminddb.h>
 #include <netinet/in.h>
 
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/once.h>
 #include <isc/sockaddr.h>
@@ -36,66 +37,82 @@
 #include <dns/log.h>
 
 /*
- * This structure preserves state from the previous GeoIP lookup,
- * so that successive lookups for the same data from the same IP
- * address will not require repeated database lookups.
- * This should improve performance somewhat.
+ * Results of recent GeoIP lookups are kept in a small cache in thread
+ * specific memory, so that evaluating several geoip ACL elements, or
+ * the match-clients of several views, for the same client does not
+ * walk the database tree each time.  Each worker thread runs a single
+ * event loop, so this is effectively a per-loop cache.
  *
- * For all lookups we preserve pointers to the MMDB_lookup_result_s
- * and MMDB_entry_s structures, a pointer to the database from which
- * the lookup was answered, and a copy of the request address.
+ * For each lookup we preserve the database it was answered from, a
+ * copy of the request address, and the MMDB_entry_s the address maps
+ * to, or the fact that it is not in the database.  The cache is set
+ * associative: an address hashes to one set, and within a set the
+ * entries are kept in least recently used order.
  *
- * If the next geoip ACL lookup is for the same database and from the
- * same address, we can reuse the MMDB entry without repeating the lookup.
- * This is for the case when a single query has to process multiple
- * geoip ACLs: for example, when there are multiple views with
- * match-clients statements that search for different countries.
- *
- * (XXX: Currently the persistent state is stored in thread specific
- * memory, but it could more simply be stored in the client object.
- * Also multiple entries could be stored in case the ACLs require
- * searching in more than one GeoIP database.)
+ * The databases are only closed at shutdown, so a cached entry stays
+ * valid for as long as its database pointer matches.
  */
 
+#define GEOIP_CACHE_SETS 64
+#define GEOIP_CACHE_WAYS 4
+
 typedef struct geoip_state {
-	uint16_t subtype;
 	const MMDB_s *db;
 	isc_netaddr_t addr;
-	MMDB_lookup_result_s mmresult;
+	bool found;
 	MMDB_entry_s entry;
 } geoip_state_t;
 
-static thread_local geoip_state_t geoip_state = { 0 };
-
-static void
-set_state(const MMDB_s *db, const isc_netaddr_t *addr,
-	  MMDB_lookup_result_s mmresult, MMDB_entry_s entry) {
-	geoip_state.db = db;
-	geoip_state.addr = *addr;
-	geoip_state.mmresult = mmresult;
-	geoip_state.entry = entry;
-}
+static thread_local geoip_state_t geoip_cache[GEOIP_CACHE_SETS]
+					    [GEOIP_CACHE_WAYS];
 
 static geoip_state_t *
 get_entry_for(MMDB_s *const db, const isc_netaddr_t *addr) {
+	geoip_state_t *set = NULL, state;
 	isc_sockaddr_t sa;
 	MMDB_lookup_result_s match;
+	uint32_t hashval;
+	size_t i;
 	int err;
 
-	if (db == geoip_state.db && isc_netaddr_equal(addr, &geoip_state.addr))
-	{
-		return (&geoip_state);
+	if (addr->family == AF_INET6) {
+		hashval = isc_hash32(&addr->type.in6, sizeof(addr->type.in6),
+				     true);
+	} else {
+		hashval = isc_hash32(&addr->type.in, sizeof(addr->type.in),
+				     true);
 	}
+	set = geoip_cache[hashval % GEOIP_CACHE_SETS];
 
-	isc_sockaddr_fromnetaddr(&sa, addr, 0);
-	match = MMDB_lookup_sockaddr(db, &sa.type.sa, &err);
-	if (err != MMDB_SUCCESS || !match.found_entry) {
-		return (NULL);
+	for (i = 0; i < GEOIP_CACHE_WAYS; i++) {
+		if (set[i].db == db && isc_netaddr_equal(addr, &set[i].addr)) {
+			break;
+		}
+	}
+
+	if (i < GEOIP_CACHE_WAYS) {
+		state = set[i];
+	} else {
+		isc_sockaddr_fromnetaddr(&sa, addr, 0);
+		match = MMDB_lookup_sockaddr(db, &sa.type.sa, &err);
+		if (err != MMDB_SUCCESS) {
+			return (NULL);
+		}
+
+		state = (geoip_state_t){
+			.db = db,
+			.addr = *addr,
+			.found = match.found_entry,
+			.entry = match.entry,
+		};
+		i = GEOIP_CACHE_WAYS - 1;
 	}
 
-	set_state(db, addr, match, match.entry);
+	/* Make this the most recently used entry in the set. */
+	memmove(&set[1], &set[0], i * sizeof(set[0]));
+	set[0] = state;
 
-	return (&geoip_state);
+	return (set[0].found ? &set[0] : NULL);
 }
 
 static dns_geoip_subtype_t
@@ -30,6 +30,7 @@
 #include <arpa/inet.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/buffer.h>
 #include <isc/hmac.h>
 #include <isc/lex.h>
@@ -154,6 +155,8 @@ hmac_fromdns(const isc_md_type_t *type, dst_key_t *key, isc_buffer_t *data);
 
 struct dst_hmac_key {
 	uint8_t key[ISC_MAX_BLOCK_SIZE];
+	/* set up with the key; copied for each context */
+	atomic_ptr(isc_hmac_t) ctx;
 };
 
 static isc_result_t
@@ -173,11 +176,35 @@ static isc_result_t
 hmac_createctx(const isc_md_type_t *type, const dst_key_t *key,
 	       dst_context_t *dctx) {
 	isc_result_t result;
-	const dst_hmac_key_t *hkey = key->keydata.hmac_key;
+	dst_hmac_key_t *hkey = key->keydata.hmac_key;
 	isc_hmac_t *ctx = isc_hmac_new(); /* Either returns or abort()s */
+	isc_hmac_t *keyed = atomic_load_acquire(&hkey->ctx);
+
+	/*
+	 * Setting up an HMAC context with a key is much more expensive
+	 * than copying one that has been set up already, so keep one
+	 * with the key.
+	 */
+	if (keyed == NULL) {
+		isc_hmac_t *expected = NULL;
+
+		keyed = isc_hmac_new();
+		result = isc_hmac_init(keyed, hkey->key,
+				       isc_md_type_get_block_size(type), type);
+		if (result != ISC_R_SUCCESS) {
+			isc_hmac_free(keyed);
+			isc_hmac_free(ctx);
+			return (DST_R_UNSUPPORTEDALG);
+		}
+		if (!atomic_compare_exchange_strong_acq_rel(&hkey->ctx,
+							    &expected, keyed))
+		{
+			isc_hmac_free(keyed);
+			keyed = expected;
+		}
+	}
 
-	result = isc_hmac_init(ctx, hkey->key, isc_md_type_get_block_size(type),
-			       type);
+	result = isc_hmac_copy(ctx, keyed);
 	if (result != ISC_R_SUCCESS) {
 		isc_hmac_free(ctx);
 		return (DST_R_UNSUPPORTEDALG);
@@ -315,6 +342,7 @@ hmac_isprivate(const dst_key_t *key) {
 static void
 hmac_destroy(dst_key_t *key) {
 	dst_hmac_key_t *hkey = key->keydata.hmac_key;
+	isc_hmac_free(atomic_load_acquire(&hkey->ctx));
 	isc_safe_memwipe(hkey, sizeof(*hkey));
 	isc_mem_put(key->mctx, hkey, sizeof(*hkey));
 	key->keydata.hmac_key = NULL;
@@ -347,8 +375,7 @@ hmac_fromdns(const isc_md_type_t *type, dst_key_t *key, isc_buffer_t *data) {
 	}
 
 	hkey = isc_mem_get(key->mctx, sizeof(dst_hmac_key_t));
-
-	memset(hkey->key, 0, sizeof(hkey->key));
+	*hkey = (dst_hmac_key_t){ .ctx = NULL };
 
 	/* Hash the key if the key is longer then chosen MD block size */
 	if (r.length > (unsigned int)isc_md_type_get_block_size(type)) {
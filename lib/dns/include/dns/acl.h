@@ -30,6 +30,7 @@
 
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/lang.h>
 #include <isc/magic.h>
 #include <isc/netaddr.h>
@@ -105,6 +106,12 @@ struct dns_aclenv {
 	dns_acl_t *localhost;
 	dns_acl_t *localnets;
 
+	/*%
+	 * Bumped whenever the environment changes, so that callers
+	 * caching ACL decisions can tell when they are stale.
+	 */
+	atomic_uint_fast32_t generation;
+
 	bool match_mapped;
 #if defined(HAVE_GEOIP2)
 	dns_geoip_databases_t *geoip;
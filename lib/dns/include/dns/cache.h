@@ -215,7 +215,9 @@ isc_result_t
 dns_cache_flushnode(dns_cache_t *cache, const dns_name_t *name, bool tree);
 /*
  * Flush a given name from the cache.  If 'tree' is true, then
- * also flush all names under 'name'.
+ * also flush all names under 'name'.  'name' itself is flushed before
+ * this returns; the names under it are flushed in the thread pool,
+ * and errors doing so are logged.
  *
  * Requires:
  *\li	'cache' to be valid.
@@ -243,12 +245,61 @@ dns_cache_flushname(dns_cache_t *cache, const dns_name_t *name);
  *\li	other error returns.
  */
 
+isc_result_t
+dns_cache_save(dns_cache_t *cache, const char *filename);
+/*%<
+ * Write a binary snapshot of the positive, unexpired contents of the
+ * cache to 'filename', recording for each rdataset its remaining TTL
+ * and trust level.  The snapshot is written to a temporary file which
+ * then replaces 'filename'.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' is not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	file I/O errors.
+ */
+
+isc_result_t
+dns_cache_restore(dns_cache_t *cache, const char *filename);
+/*%<
+ * Add the contents of a snapshot written by dns_cache_save() to the
+ * cache.  The TTLs are reduced by the time that has passed since the
+ * snapshot was taken, and records whose TTL ran out in the meantime
+ * are skipped.  Records already cached with a higher trust level are
+ * left alone.
+ *
+ * Requires:
+ *\li	'cache' to be valid.
+ *\li	'filename' is not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_FILENOTFOUND if there is no snapshot.
+ *\li	#ISC_R_NOTIMPLEMENTED if the file is not a snapshot in a
+ *	format this version understands.
+ *\li	#DNS_R_BADCLASS if the snapshot is for another class.
+ *\li	#DNS_R_FORMERR, #ISC_R_UNEXPECTEDEND or #ISC_R_RANGE if the
+ *	file is corrupt.  Records before the damage have been added.
+ *\li	other errors.
+ */
+
 isc_stats_t *
 dns_cache_getstats(dns_cache_t *cache);
 /*
  * Return a pointer to the stats collection object for 'cache'
  */
 
+dns_sigcache_t *
+dns_cache_getsigcache(dns_cache_t *cache);
+/*
+ * Return a pointer to the verified signature cache of 'cache'.  It is
+ * flushed together with the cache, and remains valid for as long as
+ * 'cache' is attached.
+ */
+
 void
 dns_cache_dumpstats(dns_cache_t *cache, FILE *fp);
 /*
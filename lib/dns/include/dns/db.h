@@ -77,6 +77,15 @@ extern unsigned int dns_pps;
 ***** Types
 *****/
 
+/*%
+ * An RRset due to be re-signed; see dns_db_getsigningtimes().
+ */
+typedef struct dns_dbsigning {
+	dns_fixedname_t name;
+	dns_rdatatype_t covers;
+	isc_stdtime_t	resign;
+} dns_dbsigning_t;
+
 typedef struct dns_dbmethods {
 	void (*destroy)(dns_db_t *db);
 	isc_result_t (*beginload)(dns_db_t	       *db,
@@ -181,6 +190,27 @@ typedef struct dns_dbmethods {
 	void (*deletedata)(dns_db_t *db, dns_dbnode_t *node, void *data);
 	isc_result_t (*nodefullname)(dns_db_t *db, dns_dbnode_t *node,
 				     dns_name_t *name);
+	isc_result_t (*getrendered)(dns_db_t *db, dns_dbversion_t *version,
+				    const isc_region_t *key,
+				    isc_region_t       *data);
+	isc_result_t (*addrendered)(dns_db_t *db, dns_dbversion_t *version,
+				    const isc_region_t *key,
+				    const isc_region_t *data,
+				    unsigned int	ndata);
+	isc_result_t (*getnsec3hash)(dns_db_t *db, dns_dbversion_t *version,
+				     const dns_name_t *name,
+				     dns_name_t	*hashname);
+	isc_result_t (*addnsec3hash)(dns_db_t *db, dns_dbversion_t *version,
+				     const dns_name_t *name,
+				     const dns_name_t *hashname);
+	isc_result_t (*setreplicas)(dns_db_t *db, unsigned int groups);
+	isc_result_t (*getsigningtimes)(dns_db_t *db, isc_stdtime_t until,
+					dns_dbsigning_t *entries,
+					size_t		*countp);
+	size_t (*memoryusage)(dns_db_t *db);
+	isc_result_t (*findnodes)(dns_db_t *db, const dns_name_t **names,
+				  size_t	  count,
+				  dns_dbnode_t **nodes DNS__DB_FLARG);
 } dns_dbmethods_t;
 
 typedef isc_result_t (*dns_dbcreatefunc_t)(isc_mem_t	    *mctx,
@@ -220,6 +250,7 @@ struct dns_db {
 enum {
 	DNS_DBATTR_CACHE = 1 << 0,
 	DNS_DBATTR_STUB = 1 << 1,
+	DNS_DBATTR_PARALLELUPDATE = 1 << 2,
 };
 
 struct dns_dbonupdatelistener {
@@ -418,6 +449,21 @@ dns_db_isstub(dns_db_t *db);
  * \li	#false	otherwise
  */
 
+bool
+dns_db_parallelupdate(dns_db_t *db);
+/*%<
+ * Can several threads update the same open version of 'db' at once,
+ * provided that each of them modifies a different set of nodes?
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * Returns:
+ * \li	#true	concurrent updates of distinct nodes are safe
+ * \li	#false	otherwise
+ */
+
 bool
 dns_db_issecure(dns_db_t *db);
 /*%<
@@ -736,6 +782,41 @@ dns__db_findnodeext(dns_db_t *db, const dns_name_t *name, bool create,
  *	implementation used.
  */
 
+#define dns_db_findnodes(db, names, count, nodes) \
+	dns__db_findnodes(db, names, count, nodes DNS__DB_FILELINE)
+isc_result_t
+dns__db_findnodes(dns_db_t *db, const dns_name_t **names, size_t count,
+		  dns_dbnode_t **nodes DNS__DB_FLARG);
+/*%<
+ * Find or create the nodes for 'count' names at once, as
+ * dns_db_findnode() with 'create' set to true would.  Databases that
+ * support it look up all of the names under one acquisition of their
+ * tree lock, and add any missing ones under one exclusive acquisition,
+ * which is cheaper than finding each name separately when caching a
+ * whole response.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * \li	'names' points to 'count' valid, non-empty, absolute names.
+ *
+ * \li	'nodes' points to 'count' node pointers, all of them NULL.
+ *
+ * Ensures:
+ *
+ * \li	On success, nodes[i] is attached to the node with name names[i].
+ *
+ * \li	On failure, no nodes are attached.
+ *
+ * Returns:
+ *
+ * \li	#ISC_R_SUCCESS
+ *
+ * \li	Other results are possible, depending upon the database
+ *	implementation used.
+ */
+
 #define dns_db_find(db, name, version, type, options, now, nodep, foundname,  \
 		    rdataset, sigrdataset)                                    \
 	dns__db_find(db, name, version, type, options, now, nodep, foundname, \
@@ -1390,6 +1471,22 @@ dns_db_nodecount(dns_db_t *db, dns_dbtree_t tree);
  * \li	The number of nodes in the database
  */
 
+size_t
+dns_db_memoryusage(dns_db_t *db);
+/*%<
+ * Report the number of bytes of record data currently held by 'db',
+ * counting every version still retained.  This is a single counter
+ * read and may be called at any time.
+ *
+ * Requires:
+ *
+ * \li	'db' is a valid database.
+ *
+ * Returns:
+ * \li	The number of bytes, or 0 if the implementation does not keep
+ *	track of it.
+ */
+
 size_t
 dns_db_hashsize(dns_db_t *db);
 /*%<
@@ -1604,6 +1701,30 @@ dns__db_getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
  * \li	#ISC_R_NOTFOUND - No dataset exists.
  */
 
+isc_result_t
+dns_db_getsigningtimes(dns_db_t *db, isc_stdtime_t until,
+		       dns_dbsigning_t *entries, size_t *countp);
+/*%<
+ * Find up to '*countp' RRsets whose re-signing time is no later than
+ * 'until', store their owner names, covered types and re-signing times
+ * in 'entries' sorted by re-signing time, and set '*countp' to the
+ * number found.  If several RRsets are due, these are the earliest,
+ * in the order dns_db_getsigningtime() would have returned them had
+ * each been re-signed in turn; this lets a caller process a batch of
+ * them with a single lookup.
+ *
+ * Databases that do not implement this return the single RRset found
+ * by dns_db_getsigningtime().
+ *
+ * Requires:
+ * \li	'db' is a valid zone database.
+ * \li	'entries' has room for '*countp' entries, and '*countp' > 0.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND - No RRset is due by 'until'.
+ */
+
 dns_stats_t *
 dns_db_getrrsetstats(dns_db_t *db);
 /*%<
@@ -1769,6 +1890,109 @@ dns_db_addglue(dns_db_t *db, dns_dbversion_t *version, dns_rdataset_t *rdataset,
  *\li	Any error that dns_rdata_additionaldata() can return.
  */
 
+isc_result_t
+dns_db_getrendered(dns_db_t *db, dns_dbversion_t *version,
+		   const isc_region_t *key, isc_region_t *data);
+/*%<
+ * Look up pre-rendered response data previously stored in 'version'
+ * of 'db' under 'key' with dns_db_addrendered().
+ *
+ * The data is owned by the database version; it stays valid and
+ * unchanged while 'version' remains open, and is discarded together
+ * with the version, so it never outlives the zone data it was rendered
+ * from.
+ *
+ * Requires:
+ * \li	'db' is a valid database with 'zone' semantics.
+ * \li	'version' is a valid open read-only version.
+ * \li	'key' and 'data' are not NULL.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
+isc_result_t
+dns_db_addrendered(dns_db_t *db, dns_dbversion_t *version,
+		   const isc_region_t *key, const isc_region_t *data,
+		   unsigned int ndata);
+/*%<
+ * Store a copy of the pre-rendered response data in the 'ndata'
+ * regions of 'data', concatenated, in 'version' of 'db' under 'key'.
+ * Entries are never replaced or removed while the version is open.
+ *
+ * Requires:
+ * \li	'db' is a valid database with 'zone' semantics.
+ * \li	'version' is a valid open read-only version.
+ * \li	'key' is not NULL.
+ * \li	'data' is an array of 'ndata' regions.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_EXISTS		data is already stored under 'key'
+ * \li	#ISC_R_NOSPACE		the per-version limits have been reached
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
+isc_result_t
+dns_db_getnsec3hash(dns_db_t *db, dns_dbversion_t *version,
+		    const dns_name_t *name, dns_name_t *hashname);
+/*%<
+ * Look up the NSEC3 owner name that 'name' hashes to with the NSEC3
+ * parameters of 'version' of 'db', previously stored with
+ * dns_db_addnsec3hash(), and copy it to 'hashname'.  The comparison
+ * of 'name' is case insensitive.
+ *
+ * Requires:
+ * \li	'db' is a valid database with 'zone' semantics.
+ * \li	'version' is a valid open version.
+ * \li	'name' is a valid absolute name.
+ * \li	'hashname' is a valid name with a dedicated buffer.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOTFOUND
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
+isc_result_t
+dns_db_addnsec3hash(dns_db_t *db, dns_dbversion_t *version,
+		    const dns_name_t *name, const dns_name_t *hashname);
+/*%<
+ * Remember in 'version' of 'db' that 'name' hashes to the NSEC3 owner
+ * name 'hashname'.  Entries are discarded together with the version,
+ * whose NSEC3 parameters they were computed with.
+ *
+ * Requires:
+ * \li	'db' is a valid database with 'zone' semantics.
+ * \li	'version' is a valid open read-only version.
+ * \li	'name' and 'hashname' are valid absolute names.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_EXISTS		a hash is already stored for 'name'
+ * \li	#ISC_R_NOSPACE		the per-version limit has been reached
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
+isc_result_t
+dns_db_setreplicas(dns_db_t *db, unsigned int groups);
+/*%<
+ * Keep a separate copy of the database's name tree for each of 'groups'
+ * groups of loop threads, so that lookups in a hot zone read memory
+ * that is local to the thread's group.  See dns_qpmulti_replicate().
+ *
+ * Requires:
+ * \li	'db' is a valid database with 'zone' semantics.
+ * \li	'groups' > 0.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_EXISTS		the database is already replicated
+ * \li	#ISC_R_NOTIMPLEMENTED
+ */
+
 void
 dns_db_expiredata(dns_db_t *db, dns_dbnode_t *node, void *data);
 /*%<
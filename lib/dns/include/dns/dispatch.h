@@ -138,6 +138,31 @@ dns_dispatchmgr_getblackhole(dns_dispatchmgr_t *mgr);
  *\li	A pointer to the current blackhole list, or NULL.
  */
 
+void
+dns_dispatchmgr_settcpreuse(dns_dispatchmgr_t *mgr, uint32_t timeout);
+/*%<
+ * Keep shared TCP connections open for 'timeout' milliseconds after
+ * their last outstanding response, so that they can be picked up again
+ * by dns_dispatch_gettcp().  Zero (the default) closes them right away.
+ * Connections on which a response has timed out are never kept.
+ *
+ * Requires:
+ *\li	mgr is a valid dispatchmgr
+ */
+
+void
+dns_dispatchmgr_setudpreuse(dns_dispatchmgr_t *mgr, uint32_t queries);
+/*%<
+ * Send up to 'queries' consecutive UDP queries to the same peer from one
+ * randomly chosen local port.  Once the response to a query has been
+ * received, its connected socket is kept open for a short while and
+ * handed to the next dns_dispatch_add() for the same peer on the same
+ * loop.  Zero or one (the default) uses a new socket for every query.
+ *
+ * Requires:
+ *\li	mgr is a valid dispatchmgr
+ */
+
 isc_result_t
 dns_dispatchmgr_setavailports(dns_dispatchmgr_t *mgr, isc_portset_t *v4portset,
 			      isc_portset_t *v6portset);
@@ -255,9 +280,14 @@ dns_dispatch_resume(dns_dispentry_t *resp, uint16_t timeout);
 
 isc_result_t
 dns_dispatch_gettcp(dns_dispatchmgr_t *mgr, const isc_sockaddr_t *destaddr,
-		    const isc_sockaddr_t *localaddr, dns_dispatch_t **dispp);
+		    const isc_sockaddr_t *localaddr, dns_transport_t *transport,
+		    dns_dispatch_t **dispp);
 /*
- * Attempt to connect to a existing TCP connection.
+ * Attempt to connect to a existing TCP connection to 'destaddr' using
+ * 'transport' (NULL for plain TCP), from 'localaddr' if it is not NULL.
+ * If 'localaddr' has port 0, a connection from any local port matches.
+ * Connections kept open after their last response (see
+ * dns_dispatchmgr_settcpreuse()) are also considered.
  */
 
 typedef void (*dispatch_cb_t)(isc_result_t eresult, isc_region_t *region,
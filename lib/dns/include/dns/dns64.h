@@ -129,6 +129,44 @@ dns_dns64_aaaafroma(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
  *	DNS_R_DISALLOWED	if there is no match.
  */
 
+bool
+dns_dns64_applies(const dns_dns64_t *dns64, const isc_netaddr_t *reqaddr,
+		  const dns_name_t *reqsigner, dns_aclenv_t *env,
+		  unsigned int flags);
+/*
+ * Determine whether 'dns64' applies to a query with 'flags' from
+ * 'reqaddr' signed by 'reqsigner'.  These are the checks made by
+ * dns_dns64_aaaafroma() before looking at the A record, so a caller
+ * synthesising from every record of an A RRset can make them once
+ * per 'dns64' and then use dns_dns64_synthesize().
+ *
+ * If 'reqaddr' is NULL the 'client' acl is ignored.
+ *
+ * Requires:
+ *	'dns64'		to be valid.
+ *	'reqaddr'	to be NULL or valid
+ *	'reqsigner'	to be NULL or valid.
+ *	'env'		to be valid.
+ */
+
+isc_result_t
+dns_dns64_synthesize(const dns_dns64_t *dns64, dns_aclenv_t *env,
+		     const unsigned char *a, unsigned char *aaaa);
+/*
+ * Synthesise an AAAA address from 'a' using 'dns64', without checking
+ * whether 'dns64' applies to the client; see dns_dns64_applies().
+ *
+ * Requires:
+ *	'dns64'		to be valid.
+ *	'env'		to be valid.
+ *	'a'		to point to a IPv4 address in network order.
+ *	'aaaa'		to point to a IPv6 address buffer in network order.
+ *
+ * Returns:
+ *	ISC_R_SUCCESS		if synthesis was performed.
+ *	DNS_R_DISALLOWED	if 'a' is not in the 'mapped' acl.
+ */
+
 dns_dns64_t *
 dns_dns64_next(dns_dns64_t *dns64);
 /*
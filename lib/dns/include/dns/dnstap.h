@@ -212,6 +212,32 @@ dns_dt_setversion(dns_dtenv_t *env, const char *version);
  *\li	'env' is a valid dnstap environment.
  */
 
+void
+dns_dt_setsample(dns_dtenv_t *env, uint32_t rate);
+/*%<
+ * Only log one in 'rate' messages.  The choice depends on the DNS
+ * message ID alone, so that queries and their responses are either
+ * both logged or both skipped.  A 'rate' of 0 or 1 logs every message.
+ *
+ * Requires:
+ *
+ *\li	'env' is a valid dnstap environment.
+ */
+
+void
+dns_dt_setsummary(dns_dtenv_t *env, uint32_t interval);
+/*%<
+ * Log a summary of the messages seen by the dnstap environment every
+ * 'interval' seconds: how many there were and how many of them were
+ * logged, response code counts and response latency percentiles.
+ * The summary covers every message, whether sampled or not.  An
+ * 'interval' of 0 disables the summary.
+ *
+ * Requires:
+ *
+ *\li	'env' is a valid dnstap environment.
+ */
+
 void
 dns_dt_attach(dns_dtenv_t *source, dns_dtenv_t **destp);
 /*%<
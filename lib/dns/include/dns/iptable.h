@@ -16,6 +16,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/lang.h>
 #include <isc/magic.h>
 #include <isc/radix.h>
@@ -23,11 +24,15 @@
 
 #include <dns/types.h>
 
+typedef struct dns_iptable_compiled dns_iptable_compiled_t;
+typedef struct dns_iptableset dns_iptableset_t;
+
 struct dns_iptable {
 	unsigned int	  magic;
 	isc_mem_t	 *mctx;
 	isc_refcount_t	  references;
 	isc_radix_tree_t *radix;
+	atomic_ptr(dns_iptable_compiled_t) compiled;
 	ISC_LINK(dns_iptable_t) nextincache;
 };
 
@@ -61,6 +66,54 @@ dns_iptable_merge(dns_iptable_t *tab, dns_iptable_t *source, bool pos);
  * Merge one IP table into another one.
  */
 
+void
+dns_iptable_compile(dns_iptable_t *tab);
+/*
+ * Flatten the prefixes in the IP table into sorted arrays of address
+ * ranges, one per address family, each with the first-match result
+ * precomputed, so that dns_iptable_match() is a binary search over
+ * contiguous memory instead of a radix tree walk.  This is done on the
+ * first dns_iptable_match() if it has not been done before; adding
+ * prefixes to the table discards the compiled form.
+ */
+
+int
+dns_iptable_match(dns_iptable_t *tab, const isc_netaddr_t *addr);
+/*
+ * Look up the host address 'addr' in the IP table.  Returns the node
+ * number of the first prefix (in the order in which the prefixes were
+ * added) that contains 'addr', negated if that prefix is negative, or
+ * 0 if no prefix contains it; this is the same answer as a radix tree
+ * search.
+ */
+
+void
+dns_iptableset_create(isc_mem_t *mctx, dns_iptable_t *const *tabs,
+		      size_t ntables, dns_iptableset_t **setp);
+/*
+ * Merge the compiled forms of the 'ntables' IP tables in 'tabs' into
+ * one set, so that all of them can be matched against an address with
+ * a single binary search.  Entries of 'tabs' may be NULL; their results
+ * are always 0.  The set does not refer to the tables once it has been
+ * created.
+ */
+
+void
+dns_iptableset_destroy(dns_iptableset_t **setp);
+/*
+ * Free an IP table set.
+ */
+
+const int8_t *
+dns_iptableset_match(const dns_iptableset_t *set, const isc_netaddr_t *addr);
+/*
+ * Look up the host address 'addr' in all the tables of 'set' at once.
+ * Returns an array with, for each table in the order passed to
+ * dns_iptableset_create(), 1 if dns_iptable_match() would return a
+ * positive match, -1 if it would return a negative one, and 0 if no
+ * prefix contains 'addr'.
+ */
+
 #if DNS_IPTABLE_TRACE
 #define dns_iptable_ref(ptr) dns_iptable__ref(ptr, __func__, __FILE__, __LINE__)
 #define dns_iptable_unref(ptr) \
@@ -45,6 +45,7 @@
 #define DNS_JOURNAL_READ   0x00000000 /* false */
 #define DNS_JOURNAL_CREATE 0x00000001 /* true */
 #define DNS_JOURNAL_WRITE  0x00000002
+#define DNS_JOURNAL_RAW	   0x00000004
 
 #define DNS_JOURNAL_SIZE_MAX INT32_MAX
 #define DNS_JOURNAL_SIZE_MIN 4096
@@ -70,6 +71,7 @@
  * not be used for both purposes.
  */
 typedef struct dns_journal dns_journal_t;
+typedef struct dns_journalcompact dns_journalcompact_t;
 
 /***
  *** Functions
@@ -112,6 +114,11 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
  * the journal if it does not exist.
  * DNS_JOURNAL_WRITE open the journal for reading and writing.
  * DNS_JOURNAL_READ open the journal for reading only.
+ *
+ * If DNS_JOURNAL_RAW is also set, the rdata of RRs other than SOA
+ * returned by dns_journal_current_rr() refers to the journal data as
+ * it is, instead of being checked and copied by dns_rdata_fromwire().
+ * This is for callers that only pass the rdata on in wire format.
  */
 
 void
@@ -177,6 +184,25 @@ dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff);
  *       in arbitrary order.
  */
 
+isc_result_t
+dns_journal_write_transactions(dns_journal_t *j, dns_diff_t **diffs,
+			       unsigned int ndiffs);
+/*%
+ * Write 'ndiffs' consecutive transactions to a journal file as if by
+ * dns_journal_write_transaction(), but commit them to stable storage
+ * together: the transaction data is synced once for the whole group
+ * before the journal header is updated and synced.
+ *
+ * On failure none of the transactions are visible in the journal.
+ *
+ * Requires:
+ *\li      'j' is open for writing.
+ *
+ * \li	'diffs' points to 'ndiffs' > 0 diffs, each of which meets the
+ *	requirements of dns_journal_write_transaction(), and each of
+ *	which starts at the serial number the previous one ends at.
+ */
+
 /**************************************************************************/
 /*
  * Reading transactions from journals.
@@ -324,6 +350,37 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
  * Other errors may be returned from file operations.
  */
 
+isc_result_t
+dns_journal_compact_prepare(isc_mem_t *mctx, const char *filename,
+			    uint32_t serial, uint32_t flags,
+			    uint32_t target_size,
+			    dns_journalcompact_t **compactp);
+isc_result_t
+dns_journal_compact_finish(dns_journalcompact_t **compactp);
+void
+dns_journal_compact_cancel(dns_journalcompact_t **compactp);
+/*%<
+ * dns_journal_compact() split in two, so that the expensive part can
+ * run while the journal is still being written to.
+ *
+ * dns_journal_compact_prepare() takes the same arguments and does all
+ * of the copying into a new file, but does not replace the journal.
+ * It does not need to be serialized with writers of the journal.  If
+ * there is no work to do, '*compactp' is left NULL.
+ *
+ * dns_journal_compact_finish() appends whatever transactions were
+ * written to the journal in the meantime, writes the header and index
+ * of the new file and renames it over the journal.  It must not run
+ * concurrently with writers of the journal.  If the journal was
+ * replaced in the meantime, ISC_R_CANCELED is returned and it is left
+ * alone.  dns_journal_compact_cancel() discards the new file instead.
+ * Both free '*compactp'.
+ *
+ * Requires:
+ *\li	'compactp' is not NULL; '*compactp' is NULL for
+ *	dns_journal_compact_prepare() and was set by it otherwise.
+ */
+
 bool
 dns_journal_get_sourceserial(dns_journal_t *j, uint32_t *sourceserial);
 void
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/keycache.h
+ * \brief
+ * Defines dns_keycache_t, the verified zone key cache.
+ *
+ * Notes:
+ *\li	A key cache is a bounded LRU table, indexed by signer name, of
+ *	the zone keys from DNSKEY RRsets which the validator has found
+ *	to be secure, already converted to dst keys, together with the
+ *	time until which they may be used.  When validating an RRSIG
+ *	made by such a signer, the validator takes the key from here
+ *	instead of looking up the DNSKEY RRset in the cache, checking
+ *	its trust and parsing its records again.
+ *
+ *\li	Whether a key is secure depends on the trust anchors of a view,
+ *	so each view has its own key cache.
+ *
+ *\li	The cache is safe to use from multiple threads.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <isc/mem.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+dns_keycache_t *
+dns_keycache_new(isc_mem_t *mctx, unsigned int size);
+/*%
+ * Allocate and initialize a key cache holding the keys of at most
+ * 'size' signers.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	size > 0
+ */
+
+void
+dns_keycache_destroy(dns_keycache_t **kcp);
+/*%
+ * Flush and then free the key cache in 'kcp'.  '*kcp' is set to NULL
+ * on return.
+ *
+ * Requires:
+ * \li	'*kcp' to be a valid key cache
+ */
+
+void
+dns_keycache_add(dns_keycache_t *kc, const dns_name_t *name,
+		 dns_rdataset_t *keyset, isc_stdtime_t expire);
+/*%
+ * Record that the DNSKEY RRset 'keyset' owned by 'name' is secure, and
+ * that its keys may be used until 'expire'.  The zone keys in 'keyset'
+ * which have not been revoked are converted to dst keys and replace any
+ * keys previously cached for 'name'.  If the cache is full, the least
+ * recently used signer is evicted.
+ *
+ * Requires:
+ * \li	kc to be a valid key cache.
+ * \li	name to be a valid absolute name.
+ * \li	keyset to be a valid DNSKEY rdataset.
+ */
+
+isc_result_t
+dns_keycache_find(dns_keycache_t *kc, const dns_name_t *name,
+		  dns_secalg_t alg, dns_keytag_t id, unsigned int n,
+		  isc_stdtime_t now, dst_key_t **keyp);
+/*%
+ * Find the 'n'th (counting from zero) cached key of 'name' with the
+ * algorithm 'alg' and the key tag 'id', and attach it to '*keyp'.
+ * An entry which has expired by 'now' is removed.
+ *
+ * Requires:
+ * \li	kc to be a valid key cache.
+ * \li	name to be a valid absolute name.
+ * \li	keyp != NULL && *keyp == NULL
+ *
+ * Returns:
+ * \li	ISC_R_SUCCESS
+ * \li	ISC_R_NOTFOUND	no unexpired keys are cached for 'name'
+ * \li	ISC_R_NOMORE	fewer than 'n' + 1 of the keys cached for 'name'
+ *			match 'alg' and 'id'
+ */
+
+void
+dns_keycache_flush(dns_keycache_t *kc);
+/*%
+ * Flush the entire key cache.
+ *
+ * Requires:
+ * \li	kc to be a valid key cache
+ */
+
+void
+dns_keycache_flushname(dns_keycache_t *kc, const dns_name_t *name);
+/*%
+ * Flush the keys of 'name' from the key cache.
+ *
+ * Requires:
+ * \li	kc to be a valid key cache
+ * \li	name to be a valid absolute name.
+ */
+
+void
+dns_keycache_flushtree(dns_keycache_t *kc, const dns_name_t *name);
+/*%
+ * Flush the keys of 'name' and of all the names below it from the key
+ * cache.
+ *
+ * Requires:
+ * \li	kc to be a valid key cache
+ * \li	name to be a valid absolute name.
+ */
+
+ISC_LANG_ENDDECLS
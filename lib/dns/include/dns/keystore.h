@@ -27,6 +27,7 @@
 /* Add -DDNS_KEYSTORE_TRACE=1 to CFLAGS for detailed reference tracing */
 
 #include <isc/lang.h>
+#include <isc/list.h>
 #include <isc/magic.h>
 #include <isc/mutex.h>
 #include <isc/refcount.h>
@@ -47,6 +48,9 @@ struct dns_keystore {
 	/* Internals. */
 	isc_mutex_t lock;
 
+	/* Locked by lock. */
+	ISC_LIST(struct dns_keyfileindex) keyfiles;
+
 	/* Locked by themselves. */
 	isc_refcount_t references;
 
@@ -162,6 +166,45 @@ dns_keystore_setpkcs11uri(dns_keystore_t *keystore, const char *uri);
  *
  */
 
+isc_result_t
+dns_keystore_keyfiles(dns_keystore_t *keystore, const char *directory,
+		      const char *prefix, isc_mem_t *mctx, char ***filesp,
+		      size_t *countp);
+/*%<
+ * Find the private key files in 'directory' whose names start with
+ * 'prefix', compared case-insensitively.  The names are returned in
+ * '*filesp', an array of '*countp' strings allocated from 'mctx' that
+ * the caller frees with dns_keystore_freekeyfiles().
+ *
+ * The keystore keeps an index of the private key files in each
+ * directory it has been asked about, and reads a directory again only
+ * after its modification time has changed, so that looking up the keys
+ * of many zones does not read a large key directory once per zone.
+ *
+ * Requires:
+ *
+ *\li   'keystore' is a valid keystore.
+ *
+ *\li   'prefix' and 'mctx' are not NULL.
+ *
+ *\li	'filesp' is not NULL and '*filesp' is NULL.
+ *
+ *\li	'countp' is not NULL.
+ *
+ * Returns:
+ *
+ *\li   #ISC_R_SUCCESS, possibly with no files found.
+ *
+ *\li   Errors from opening or reading 'directory'.
+ */
+
+void
+dns_keystore_freekeyfiles(isc_mem_t *mctx, char ***filesp, size_t count);
+/*%<
+ * Free an array of 'count' file names returned by
+ * dns_keystore_keyfiles().
+ */
+
 isc_result_t
 dns_keystore_keygen(dns_keystore_t *keystore, const dns_name_t *origin,
 		    const char *policy, dns_rdataclass_t rdclass,
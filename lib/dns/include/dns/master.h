@@ -155,6 +155,11 @@ dns_master_loadfileasync(const char *master_file, dns_name_t *top,
  * If 'DNS_MASTER_AGETTL' is set and the master file contains one or more
  * $DATE directives, the TTLs of the data will be aged accordingly.
  *
+ * Large text files loaded with dns_master_loadfile() or
+ * dns_master_loadfileasync() may be parsed by several threads at once;
+ * 'callbacks->add' is still only called from the loading thread, in
+ * file order.
+ *
  * 'callbacks->commit' is assumed to call 'callbacks->error' or
  * 'callbacks->warn' to generate any error messages required.
  *
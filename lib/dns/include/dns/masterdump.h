@@ -305,6 +305,9 @@ dns_master_dump(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
  *
  * Temporary dynamic memory may be allocated from 'mctx'.
  *
+ * Large zone and cache databases may be formatted by several threads;
+ * the output is the same as when dumping with a single thread.
+ *
  * Returns:
  *\li	ISC_R_SUCCESS
  *\li	ISC_R_NOMEMORY
@@ -240,6 +240,7 @@ typedef enum dns_message_intent {
 /* Obsolete: DNS_MESSAGERENDER_FILTER_AAAA	0x0020	*/
 
 typedef struct dns_msgblock dns_msgblock_t;
+typedef ISC_LIST(dns_msgblock_t) dns_msgblocklist_t;
 
 struct dns_sortlist_arg {
 	dns_aclenv_t	       *env;
@@ -309,9 +310,9 @@ struct dns_message {
 	isc_bufferlist_t scratchpad;
 	isc_bufferlist_t cleanup;
 
-	ISC_LIST(dns_msgblock_t) rdatas;
-	ISC_LIST(dns_msgblock_t) rdatalists;
-	ISC_LIST(dns_msgblock_t) offsets;
+	dns_msgblocklist_t rdatas;
+	dns_msgblocklist_t rdatalists;
+	dns_msgblocklist_t offsets;
 
 	ISC_LIST(dns_rdata_t) freerdata;
 	ISC_LIST(dns_rdatalist_t) freerdatalist;
@@ -582,6 +583,33 @@ dns_message_parse(dns_message_t *msg, isc_buffer_t *source,
  *\li	Many other errors possible XXXMLG
  */
 
+isc_result_t
+dns_message_parsequery(dns_message_t *msg, isc_buffer_t *source);
+/*%<
+ * Parse raw wire data in 'source' as a DNS message, if and only if it is
+ * a simple query: opcode QUERY, QR clear, a single question whose name
+ * is not compressed, no answer or authority records, and at most one
+ * additional record which must be an OPT owned by the root name.
+ *
+ * The message is first validated in place without allocating anything;
+ * only then are the question and the OPT record built, skipping the
+ * name and rdataset lookups that dns_message_parse() has to do.  The
+ * result is indistinguishable from a dns_message_parse() with no options.
+ *
+ * Requires:
+ *\li	"msg" be valid, freshly created or reset with
+ *	#DNS_MESSAGE_INTENTPARSE.
+ *
+ *\li	"source" be a wire format buffer.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- all is well
+ *\li	#ISC_R_NOTIMPLEMENTED	-- the message is not a simple query, or
+ *				   it is malformed; 'msg' and 'source' are
+ *				   left untouched and the caller should
+ *				   fall back to dns_message_parse()
+ */
+
 isc_result_t
 dns_message_renderbegin(dns_message_t *msg, dns_compress_t *cctx,
 			isc_buffer_t *buffer);
@@ -695,6 +723,60 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t section,
  *				   are records remaining for this section.
  */
 
+isc_result_t
+dns_message_renderraw(dns_message_t *msg, const isc_region_t *wire,
+		      unsigned int ancount, unsigned int nscount,
+		      unsigned int arcount);
+/*%<
+ * Append 'wire', the answer, authority and additional sections of a
+ * previously rendered response holding 'ancount', 'nscount' and
+ * 'arcount' records respectively, to the message being rendered.
+ *
+ * The data is copied verbatim, so it must not contain compression
+ * pointers referring to anything but the header and the question
+ * section, which must be identical to those it was rendered with.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	'wire' is not NULL.
+ *
+ *\li	dns_message_renderbegin() was called, and only the question
+ *	section has been rendered so far.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- the data was written.
+ *\li	#ISC_R_NOSPACE		-- Not enough room in the buffer; nothing
+ *				   was written.
+ */
+
+isc_result_t
+dns_message_renderrr(dns_message_t *msg, dns_section_t section,
+		     const dns_name_t *owner, dns_ttl_t ttl,
+		     const dns_rdata_t *rdata);
+/*%<
+ * Render a single RR to 'section' of the message being rendered,
+ * without adding it to the message.  The owner name is compressed, but
+ * 'rdata' is copied verbatim, so any names in it are left uncompressed.
+ *
+ * Sections must be rendered in order, so no section after 'section'
+ * may have been rendered yet.
+ *
+ * Requires:
+ *\li	'msg' be valid.
+ *
+ *\li	'section' be a valid section.
+ *
+ *\li	'owner' and 'rdata' are not NULL.
+ *
+ *\li	dns_message_renderbegin() was called.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS		-- the RR was written.
+ *\li	#ISC_R_NOSPACE		-- Not enough room in the buffer; nothing
+ *				   was written.
+ */
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target);
 /*%<
@@ -93,6 +93,24 @@ dns_nsec3_hashname(dns_fixedname_t *result,
  * the raw hash is stored there.
  */
 
+isc_result_t
+dns_nsec3_hashnames(unsigned char *const hashes[], size_t *hash_length,
+		    const dns_name_t *const names[], size_t count,
+		    dns_hash_t hashalg, unsigned int iterations,
+		    const unsigned char *salt, size_t saltlength);
+/*%<
+ * Compute the raw NSEC3 hashes of 'count' names at once, storing the
+ * hash of 'names[i]' in 'hashes[i]', which must have room for
+ * NSEC3_MAX_HASH_LENGTH octets.  The hashes are the same as those
+ * dns_nsec3_hashname() computes, but several names are hashed in
+ * parallel by isc_iterated_hash_multi().
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS, with the length of the hashes in '*hash_length'
+ *	if 'hash_length' is not NULL.
+ *\li	#DNS_R_BADALG if 'hashalg' is not supported.
+ */
+
 unsigned int
 dns_nsec3_hashlength(dns_hash_t hash);
 /*%<
@@ -112,6 +130,13 @@ dns_nsec3_addnsec3(dns_db_t *db, dns_dbversion_t *version,
 		   const dns_rdata_nsec3param_t *nsec3param, dns_ttl_t nsecttl,
 		   bool unsecure, dns_diff_t *diff);
 
+isc_result_t
+dns_nsec3_addnsec3hashed(dns_db_t *db, dns_dbversion_t *version,
+			 const dns_name_t		*name,
+			 const dns_rdata_nsec3param_t *nsec3param,
+			 const unsigned char *namehash, size_t namehash_length,
+			 dns_ttl_t nsecttl, bool unsecure, dns_diff_t *diff);
+
 isc_result_t
 dns_nsec3_addnsec3s(dns_db_t *db, dns_dbversion_t *version,
 		    const dns_name_t *name, dns_ttl_t nsecttl, bool unsecure,
@@ -127,7 +152,9 @@ dns_nsec3_addnsec3sx(dns_db_t *db, dns_dbversion_t *version,
  * The existing NSEC3 records are removed.
  *
  * dns_nsec3_addnsec3() will only add records to the chain identified by
- * 'nsec3param'.
+ * 'nsec3param'.  dns_nsec3_addnsec3hashed() does the same, but if
+ * 'namehash' is not NULL it is used as the hash of 'name' rather than
+ * computing it again (see dns_nsec3_hashnames()).
  *
  * 'unsecure' should be set to reflect if this is a potentially
  * unsecure delegation (no DS record).
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/qlog.h
+ * \brief
+ * Encoding and decoding of binary query log records.
+ *
+ * Notes:
+ *\li	A binary query log is a sequence of records, each describing one
+ *	answered query: when it was received, the client address, the
+ *	question, the response flags and rcode, and how long it took to
+ *	answer.  The records are much cheaper to produce than the text
+ *	query log, and can be converted to text or replayed against a
+ *	server by named-qlog.
+ *
+ *\li	Each record starts with its length and a version number, so a
+ *	reader can skip records of versions it does not understand.  All
+ *	integers are in network byte order.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/buffer.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+
+#include <dns/types.h>
+
+/*%
+ * The current record version.
+ */
+#define DNS_QLOG_VERSION 1
+
+/*%
+ * The largest possible encoded record.
+ */
+#define DNS_QLOG_MAXRECORD 512
+
+typedef struct dns_qlogrecord {
+	isc_time_t	  time;	   /*%< When the query was received */
+	isc_sockaddr_t	  client;  /*%< Client address and port */
+	bool		  tcp;	   /*%< Query was received over TCP */
+	uint32_t	  latency; /*%< Microseconds until the response */
+	const dns_name_t *qname;
+	dns_rdatatype_t	  qtype;
+	dns_rdataclass_t  qclass;
+	uint16_t	  flags; /*%< Response header flags */
+	dns_rcode_t	  rcode; /*%< Response (extended) rcode */
+} dns_qlogrecord_t;
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+isc_result_t
+dns_qlog_encode(const dns_qlogrecord_t *record, isc_buffer_t *target);
+/*%<
+ * Append the binary encoding of 'record' to 'target'.
+ *
+ * Requires:
+ * \li	'record' is not NULL, and record->qname is a valid absolute name.
+ * \li	'target' is a valid buffer.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOSPACE	'target' is too small; it is not changed.
+ */
+
+isc_result_t
+dns_qlog_decode(isc_buffer_t *source, dns_qlogrecord_t *record,
+		dns_name_t *qname);
+/*%<
+ * Decode the record at the start of the active region of 'source'
+ * into 'record'.  The query name is stored in 'qname', which must have
+ * a dedicated buffer (for example, from a dns_fixedname_t), and
+ * record->qname is set to point to it.
+ *
+ * Requires:
+ * \li	'source' is a valid buffer.
+ * \li	'record' is not NULL.
+ * \li	'qname' is a valid name with a dedicated buffer.
+ *
+ * Ensures:
+ * \li	Unless #ISC_R_NOMORE or #ISC_R_UNEXPECTEDEND is returned, the
+ *	current position of 'source' is advanced past the record.
+ *
+ * Returns:
+ * \li	#ISC_R_SUCCESS
+ * \li	#ISC_R_NOMORE		'source' has no remaining data.
+ * \li	#ISC_R_UNEXPECTEDEND	'source' ends within a record.
+ * \li	#ISC_R_NOTIMPLEMENTED	the record has an unknown version.
+ * \li	#DNS_R_FORMERR		the record is malformed.
+ */
+
+ISC_LANG_ENDDECLS
@@ -100,6 +100,12 @@ typedef struct dns_qp dns_qp_t;
  */
 typedef struct dns_qpmulti dns_qpmulti_t;
 
+/*%
+ * A `dns_qpbulk_t` builds a qp-trie from leaves that are supplied in
+ * key order; see `dns_qp_bulkload()`.
+ */
+typedef struct dns_qpbulk dns_qpbulk_t;
+
 /*%
  * Read-only parts of a qp-trie.
  *
@@ -392,7 +398,8 @@ dns_qp_compact(dns_qp_t *qp, dns_qpgc_t mode);
  * Defragment the qp-trie and release unused memory.
  *
  * When modifications make a trie too fragmented, it is automatically
- * compacted. However, automatic compaction is limited when a
+ * compacted, a bounded step at a time, over the following
+ * modifications. However, automatic compaction is limited when a
  * multithreaded trie has lots of immutable memory from past
  * transactions, and lightweight write transactions do not compact on
  * commit like heavyweight update transactions.
@@ -526,6 +533,44 @@ dns_qp_getname(dns_qpreadable_t qpr, const dns_name_t *name, void **pval_r,
  * \li  ISC_R_SUCCESS if the leaf was found
  */
 
+void
+dns_qp_getkeys(dns_qpreadable_t qpr, size_t count, const dns_qpkey_t *keys,
+	       const size_t *keylens, void **pval_r, uint32_t *ival_r,
+	       isc_result_t *result_r);
+/*%<
+ * Find the leaves in a qp-trie that match each of `count` search keys.
+ *
+ * This does the same as calling dns_qp_getkey() for each key, except
+ * that several searches are run side by side: each one takes a step
+ * down the trie in turn, after prefetching the memory it will need for
+ * the next step. That way the cache misses of the searches overlap
+ * instead of each having to wait for the previous one.
+ *
+ * The result of the search for `keys[i]` is stored in `result_r[i]`.
+ * When it is ISC_R_SUCCESS, the leaf values are also stored in
+ * `pval_r[i]` and `ival_r[i]`, for whichever of `pval_r` and `ival_r`
+ * are not null.
+ *
+ * Requires:
+ * \li  `qpr` is a pointer to a readable qp-trie
+ * \li  `keys`, `keylens` and `result_r` are arrays of `count` elements
+ * \li	`keylens[i] < sizeof(dns_qpkey_t)` for each key
+ */
+
+void
+dns_qp_getnames(dns_qpreadable_t qpr, size_t count,
+		const dns_name_t *const *names, void **pval_r,
+		uint32_t *ival_r, isc_result_t *result_r);
+/*%<
+ * Find the leaves in a qp-trie that match each of `count` DNS names,
+ * in the same way as dns_qp_getkeys().
+ *
+ * Requires:
+ * \li  `qpr` is a pointer to a readable qp-trie
+ * \li  `names` and `result_r` are arrays of `count` elements
+ * \li  each of `names` is a pointer to a valid `dns_name_t`
+ */
+
 isc_result_t
 dns_qp_lookup(dns_qpreadable_t qpr, const dns_name_t *name,
 	      dns_name_t *foundname, dns_qpiter_t *iter, dns_qpchain_t *chain,
@@ -618,6 +663,52 @@ dns_qp_deletename(dns_qp_t *qp, const dns_name_t *name, void **pval_r,
  * \li  ISC_R_SUCCESS if the leaf was deleted from the trie
  */
 
+void
+dns_qp_bulkload(dns_qp_t *qp, dns_qpbulk_t **bulkp);
+/*%<
+ * Start building an empty qp-trie from leaves in sorted order.
+ *
+ * The leaves are added with `dns_qpbulk_add()` in ascending key order
+ * (which is DNSSEC order for keys made by `dns_qpkey_fromname()`). The
+ * trie is built bottom-up: each branch is allocated once, when its
+ * last leaf has been added, so there is no search from the root per
+ * leaf and the result is already compact.
+ *
+ * The trie must not be used for anything else until the build is
+ * completed with `dns_qpbulk_finish()`.
+ *
+ * Requires:
+ * \li  `qp` is a pointer to a valid qp-trie with no leaves
+ * \li  `bulkp != NULL && *bulkp == NULL`
+ */
+
+isc_result_t
+dns_qpbulk_add(dns_qpbulk_t *bulk, void *pval, uint32_t ival);
+/*%<
+ * Add a leaf to a qp-trie that is being bulk loaded. Its key must sort
+ * after the keys of all the leaves added so far.
+ *
+ * Requires:
+ * \li  `bulk` is a pointer to a valid bulk loader
+ * \li  `pval != NULL`
+ * \li  `alignof(pval) >= 4`
+ *
+ * Returns:
+ * \li  ISC_R_EXISTS if the key is the same as the previous leaf's key
+ * \li  ISC_R_RANGE if the key sorts before the previous leaf's key
+ * \li  ISC_R_SUCCESS if the leaf was added to the trie
+ */
+
+void
+dns_qpbulk_finish(dns_qpbulk_t **bulkp);
+/*%<
+ * Complete a bulk load, making the leaves visible in the trie, and
+ * free the bulk loader.
+ *
+ * Requires:
+ * \li  `bulkp` is a pointer to a valid bulk loader
+ */
+
 void
 dns_qpiter_init(dns_qpreadable_t qpr, dns_qpiter_t *qpi);
 /*%<
@@ -738,6 +829,29 @@ dns_qpmulti_query(dns_qpmulti_t *multi, dns_qpread_t *qpr);
  * \li  `qpr` is a valid read-only qp-trie handle
  */
 
+void
+dns_qpmulti_replicate(dns_qpmulti_t *multi, unsigned int groups);
+/*%<
+ * Give each of `groups` groups of loop threads its own copy of the
+ * trie for `dns_qpmulti_query()`.
+ *
+ * The loop threads are divided into groups of consecutive thread IDs.
+ * After a commit, the first query in each group copies the interior
+ * nodes of the new version of the trie, and the group's later queries
+ * read the copy instead of the shared trie. The copy is allocated by a
+ * thread in the group, so when the groups match the NUMA nodes the
+ * queries read memory that is local to them. The leaf values are
+ * shared, not copied.
+ *
+ * This is intended for small tries that are read much more often than
+ * they are modified, because each copy is remade after every commit.
+ *
+ * Requires:
+ * \li  `multi` is a pointer to a valid multi-threaded qp-trie
+ * \li  `dns_qpmulti_replicate()` has not already been called on `multi`
+ * \li  `groups > 0`
+ */
+
 void
 dns_qpmulti_lockedread(dns_qpmulti_t *multi, dns_qpread_t *qpr);
 /*%<
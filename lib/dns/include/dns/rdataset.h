@@ -99,6 +99,8 @@ typedef struct dns_rdatasetmethods {
 	void (*getownercase)(const dns_rdataset_t *rdataset, dns_name_t *name);
 	isc_result_t (*addglue)(dns_rdataset_t	*rdataset,
 				dns_dbversion_t *version, dns_message_t *msg);
+	uint64_t (*getrpztag)(const dns_rdataset_t *rdataset);
+	void (*setrpztag)(dns_rdataset_t *rdataset, uint64_t tag);
 } dns_rdatasetmethods_t;
 
 #define DNS_RDATASET_MAGIC	ISC_MAGIC('D', 'N', 'S', 'R')
@@ -652,6 +654,17 @@ dns_rdataset_setownercase(dns_rdataset_t *rdataset, const dns_name_t *name);
  * the rdataset is used later. This sets the CASESET attribute.
  */
 
+uint64_t
+dns_rdataset_getrpztag(const dns_rdataset_t *rdataset);
+void
+dns_rdataset_setrpztag(dns_rdataset_t *rdataset, uint64_t tag);
+/*%<
+ * Get or set a tag kept with 'rdataset' in the underlying database,
+ * with which response policy processing marks an rdataset that it has
+ * not rewritten.  A tag of 0 means none has been set; it is always 0
+ * for rdatasets that are not kept in a database.
+ */
+
 void
 dns_rdataset_getownercase(const dns_rdataset_t *rdataset, dns_name_t *name);
 /*%<
@@ -70,36 +70,15 @@ struct dns_slabheader_proof {
 struct dns_slabheader {
 	/*%
 	 * Locked by the owning node's lock.
+	 *
+	 * The fields needed to find and bind an rdataset come first, so
+	 * that on 64-bit platforms they share the first cache line.
 	 */
-	uint32_t	      serial;
-	dns_ttl_t	      ttl;
-	dns_typepair_t	      type;
 	atomic_uint_least16_t attributes;
 	dns_trust_t	      trust;
-
-	unsigned int heap_index;
-	/*%<
-	 * Used for TTL-based cache cleaning.
-	 */
-
-	isc_stdtime_t resign;
-	unsigned int  resign_lsb : 1;
-
-	atomic_uint_fast16_t count;
-	/*%<
-	 * Monotonically increased every time this rdataset is bound so that
-	 * it is used as the base of the starting point in DNS responses
-	 * when the "cyclic" rrset-order is required.
-	 */
-
-	atomic_uint_fast32_t last_refresh_fail_ts;
-
-	dns_slabheader_proof_t *noqname;
-	dns_slabheader_proof_t *closest;
-	/*%<
-	 * We don't use the LIST macros, because the LIST structure has
-	 * both head and tail pointers, and is doubly linked.
-	 */
+	dns_typepair_t	      type;
+	dns_ttl_t	      ttl;
+	uint32_t	      serial;
 
 	struct dns_slabheader *next;
 	/*%<
@@ -122,8 +101,24 @@ struct dns_slabheader {
 	 * this rdataset, if any.
 	 */
 
+	uint16_t count;
+	/*%<
+	 * Set when the header is created and used, together with a
+	 * per-thread counter, as the base of the starting point in DNS
+	 * responses when the "cyclic" rrset-order is required; see
+	 * dns_slabheader_cycle().
+	 */
+
+	unsigned int resign_lsb : 1;
+
+	unsigned int heap_index;
+	/*%<
+	 * Used for re-signing in a zone.  In a cache, this is one more
+	 * than the TTL wheel slot the header is on, or 0 if none.
+	 */
+
+	isc_stdtime_t resign;
 	isc_stdtime_t last_used;
-	ISC_LINK(struct dns_slabheader) link;
 
 	/*%
 	 * Case vector.  If the bit is set then the corresponding
@@ -132,9 +127,44 @@ struct dns_slabheader {
 	 */
 	unsigned char upper[32];
 
-	isc_heap_t	   *heap;
-	dns_glue_t	   *glue_list;
-	struct cds_wfs_node wfs_node;
+	isc_heap_t *heap;
+	ISC_LINK(struct dns_slabheader) link;
+
+	atomic_uint_least64_t rpztag;
+	/*%<
+	 * Set by dns_rdataset_setrpztag() to record that the rdataset
+	 * was not rewritten by a version of the response policy zones.
+	 */
+
+	/*%
+	 * A header belongs to either a zone or a cache database, never
+	 * both, so the fields only one of them uses share storage;
+	 * dns_slabheader_reset() initializes the right ones.  Every
+	 * cached RRset carries a header, so this adds directly to the
+	 * number of RRsets that fit in max-cache-size.
+	 */
+	union {
+		/*%
+		 * Used by zone databases only.
+		 */
+		struct {
+			dns_glue_t	   *glue_list;
+			struct cds_wfs_node wfs_node;
+		};
+
+		/*%
+		 * Used by cache databases only, for TTL-based cache
+		 * cleaning.
+		 */
+		ISC_LINK(struct dns_slabheader) ttllink;
+	};
+
+	/*%
+	 * Used by cache databases only.
+	 */
+	atomic_uint_least32_t	last_refresh_fail_ts;
+	dns_slabheader_proof_t *noqname;
+	dns_slabheader_proof_t *closest;
 };
 
 enum {
@@ -152,6 +182,7 @@ enum {
 	DNS_SLABHEADERATTR_CASEFULLYLOWER = 1 << 11,
 	DNS_SLABHEADERATTR_ANCIENT = 1 << 12,
 	DNS_SLABHEADERATTR_STALE_WINDOW = 1 << 13,
+	DNS_SLABHEADERATTR_VISITED = 1 << 14,
 };
 
 #define DNS_SLABHEADER_GETATTR(header, attribute) \
@@ -282,6 +313,19 @@ dns_slabheader_raw(dns_slabheader_t *header);
  * Returns the address of the raw memory following a dns_slabheader.
  */
 
+uint32_t
+dns_slabheader_cycle(const dns_slabheader_t *header);
+/*%<
+ * Return the starting point for the "cyclic" rrset-order the next time
+ * the rdataset stored in 'header' is bound.
+ *
+ * Successive calls for the same header on the same thread return
+ * successive values.  The counters are kept per thread, in a small
+ * table indexed by a hash of the header address, so that binding a
+ * popular rdataset from many threads at once does not make them all
+ * write to the same cache line.
+ */
+
 void
 dns_slabheader_setownercase(dns_slabheader_t *header, const dns_name_t *name);
 /*%<
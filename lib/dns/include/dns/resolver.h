@@ -607,6 +607,21 @@ dns_resolver_getmaxqueries(dns_resolver_t *resolver);
  * \li	resolver to be valid.
  */
 
+void
+dns_resolver_sethedging(dns_resolver_t *resolver, unsigned int percentile,
+			unsigned int quota);
+/*%
+ * Enable hedged queries: when a UDP query has not been answered within
+ * the 'percentile'th percentile of the server's round trip times, send
+ * it to the next server as well.  At most 'quota' hedged queries are
+ * outstanding at a time (0 means no limit).  A 'percentile' of 0
+ * disables hedging.
+ *
+ * Requires:
+ * \li	resolver to be valid.
+ * \li	'percentile' is less than 100.
+ */
+
 void
 dns_resolver_setquotaresponse(dns_resolver_t *resolver, dns_quotatype_t which,
 			      isc_result_t resp);
@@ -634,6 +649,31 @@ dns_resolver_dumpfetches(dns_resolver_t *resolver, isc_statsformat_t format,
 isc_result_t
 dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t **buf);
 
+#ifdef HAVE_LIBXML2
+int
+dns_resolver_renderxml(dns_resolver_t *res, void *writer);
+/*%<
+ * Render the query latency histograms of 'res' in XML for 'writer':
+ * the round trip time per transport, per upstream server and per zone
+ * cut, and the time spent in each phase of a fetch, all in microseconds.
+ *
+ * Requires:
+ * \li	'res' is valid.
+ */
+#endif /* HAVE_LIBXML2 */
+
+#ifdef HAVE_JSON_C
+isc_result_t
+dns_resolver_renderjson(dns_resolver_t *res, void *latency);
+/*%<
+ * Render the query latency histograms of 'res' in JSON into the object
+ * 'latency'.
+ *
+ * Requires:
+ * \li	'res' is valid.
+ */
+#endif /* HAVE_JSON_C */
+
 #ifdef ENABLE_AFL
 /*%
  * Enable fuzzing of resolver, changes behaviour and eliminates retries
@@ -642,6 +682,30 @@ void
 dns_resolver_setfuzzing(void);
 #endif /* ifdef ENABLE_AFL */
 
+void
+dns_resolver_sharefetches(dns_resolver_t *res, dns_resolver_t *source);
+/*%<
+ * Make 'res' use the table of the active fetches of 'source', so that
+ * identical fetches started through either resolver are coalesced
+ * into a single fetch context whose answer is delivered to the callers
+ * of both.
+ *
+ * Notes:
+ *
+ *\li	The fetch contexts are keyed by name, type and options only; the
+ *	fetch is carried out with the configuration of the resolver that
+ *	created it.  This is only meant for the resolvers of views that
+ *	share a cache, which already use each other's answers.
+ *
+ * Requires:
+ *
+ *\li	'res' and 'source' are valid resolvers.
+ *
+ *\li	'res' is not frozen.
+ *
+ *\li	The views of 'res' and 'source' use the same cache.
+ */
+
 void
 dns_resolver_setstats(dns_resolver_t *res, isc_stats_t *stats);
 /*%<
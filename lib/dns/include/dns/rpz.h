@@ -18,7 +18,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
-#include <isc/ht.h>
+#include <isc/hashmap.h>
 #include <isc/lang.h>
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
@@ -150,7 +150,7 @@ struct dns_rpz_zone {
 
 	uint32_t min_update_interval;	/* minimal interval between
 					 * updates */
-	isc_ht_t	*nodes;		/* entries in zone */
+	isc_hashmap_t	*nodes;		/* entries in zone */
 	dns_rpz_zones_t *rpzs;		/* owner */
 	isc_time_t	 lastupdated;	/* last time the zone was processed
 					 * */
@@ -164,6 +164,9 @@ struct dns_rpz_zone {
 					 * on */
 	bool	     addsoa;		/* add soa to the additional section */
 	isc_timer_t *updatetimer;
+	char	    *journal;	  /* journal of the policy zone */
+	uint32_t     serial;	  /* serial of the last processed version */
+	bool	     serialvalid; /* 'serial' can be used with 'journal' */
 };
 
 /*
@@ -229,6 +232,13 @@ struct dns_rpz_zones {
 	 */
 	int rpz_ver;
 
+	/*
+	 * Changed whenever the summary data changes, and unique across
+	 * all dns_rpz_zones objects, so that results of policy checks
+	 * can be kept with cached data.  Protected by 'search_lock'.
+	 */
+	uint64_t generation;
+
 	dns_rpz_zbits_t defined;
 
 	/*
@@ -269,6 +279,20 @@ struct dns_rpz_zones {
 	dns_rpz_cidr_node_t *cidr;
 	dns_qpmulti_t	    *table;
 
+	/*
+	 * Bloom filter over the trigger names in 'table' and the
+	 * prefixes in 'cidr', used to skip searching them for most
+	 * names and addresses that do not match any trigger.
+	 */
+	struct dns_rpz_filter *filter;
+
+	/*
+	 * Read-only copy of 'cidr' used for lookups, rebuilt when
+	 * 'cidrchanged' after an update and replaced using RCU.
+	 */
+	struct dns_rpz_trie *trie;
+	bool		     cidrchanged;
+
 	/*
 	 * DNSRPZ librpz configuration string and handle on librpz connection
 	 */
@@ -405,6 +429,15 @@ dns_rpz_dbupdate_unregister(dns_db_t *db, dns_rpz_zone_t *rpz);
 void
 dns_rpz_dbupdate_register(dns_db_t *db, dns_rpz_zone_t *rpz);
 
+void
+dns_rpz_zone_setjournal(dns_rpz_zone_t *rpz, const char *journal);
+/*%<
+ * Set the name of the journal of the policy zone 'rpz', or NULL if it
+ * has none.  When the zone changes, the owner names recorded in the
+ * journal since the last processed version are used to update the
+ * policy summary, instead of comparing all the names in the zone.
+ */
+
 void
 dns_rpz_zones_shutdown(dns_rpz_zones_t *rpzs);
 
@@ -21,6 +21,7 @@
 #include <stdbool.h>
 
 #include <isc/lang.h>
+#include <isc/mutex.h>
 
 #include <dns/fixedname.h>
 #include <dns/rdata.h>
@@ -193,26 +194,21 @@ struct dns_rrl_rate {
 };
 
 /*
- * Per-view query rate limit parameters and a pointer to database.
+ * The rate limit state is split into shards, each with its own lock.
+ * The shard is chosen by a hash of the client address prefix, so all of
+ * the entries for a client address block, including its all-per-second
+ * and TCP entries, are kept in the same shard and keep the exact token
+ * bucket semantics, while responses to different clients rarely contend
+ * for the same lock.  The total queries per second rate used for
+ * qps-scale is estimated from the traffic seen by each shard.
  */
-typedef struct dns_rrl dns_rrl_t;
-struct dns_rrl {
-	isc_mutex_t lock;
-	isc_mem_t  *mctx;
-
-	bool	       log_only;
-	dns_rrl_rate_t responses_per_second;
-	dns_rrl_rate_t referrals_per_second;
-	dns_rrl_rate_t nodata_per_second;
-	dns_rrl_rate_t nxdomains_per_second;
-	dns_rrl_rate_t errors_per_second;
-	dns_rrl_rate_t all_per_second;
-	dns_rrl_rate_t slip;
-	int	       window;
-	double	       qps_scale;
-	int	       max_entries;
+#define DNS_RRL_SHARDS	 16
+#define DNS_RRL_TS_BASES (1 << DNS_RRL_TS_GEN_BITS)
+#define DNS_RRL_QNAMES	 (1 << DNS_RRL_QNAMES_BITS)
 
-	dns_acl_t *exempt;
+typedef struct dns_rrl_shard dns_rrl_shard_t;
+struct dns_rrl_shard {
+	isc_mutex_t lock;
 
 	int num_entries;
 
@@ -220,6 +216,12 @@ struct dns_rrl {
 	isc_stdtime_t qps_time;
 	double	      qps;
 
+	/*
+	 * Rates scaled by qps-scale, or 0 when not scaled.
+	 */
+	int scaled[DNS_RRL_RTYPE_ALL + 1];
+	int slip_scaled;
+
 	unsigned int probes;
 	unsigned int searches;
 
@@ -230,24 +232,46 @@ struct dns_rrl {
 	dns_rrl_hash_t *old_hash;
 	unsigned int	hash_gen;
 
-	unsigned int ts_gen;
-#define DNS_RRL_TS_BASES (1 << DNS_RRL_TS_GEN_BITS)
+	unsigned int  ts_gen;
 	isc_stdtime_t ts_bases[DNS_RRL_TS_BASES];
 
-	int	 ipv4_prefixlen;
-	uint32_t ipv4_mask;
-	int	 ipv6_prefixlen;
-	uint32_t ipv6_mask[4];
-
 	isc_stdtime_t	 log_stops_time;
 	dns_rrl_entry_t *last_logged;
 	int		 num_logged;
 	int		 num_qnames;
 	ISC_LIST(dns_rrl_qname_buf_t) qname_free;
-#define DNS_RRL_QNAMES (1 << DNS_RRL_QNAMES_BITS)
 	dns_rrl_qname_buf_t *qnames[DNS_RRL_QNAMES];
 };
 
+/*
+ * Per-view query rate limit parameters and a pointer to database.
+ */
+typedef struct dns_rrl dns_rrl_t;
+struct dns_rrl {
+	isc_mem_t *mctx;
+
+	bool	       log_only;
+	dns_rrl_rate_t responses_per_second;
+	dns_rrl_rate_t referrals_per_second;
+	dns_rrl_rate_t nodata_per_second;
+	dns_rrl_rate_t nxdomains_per_second;
+	dns_rrl_rate_t errors_per_second;
+	dns_rrl_rate_t all_per_second;
+	dns_rrl_rate_t slip;
+	int	       window;
+	double	       qps_scale;
+	int	       max_entries;
+
+	dns_acl_t *exempt;
+
+	int	 ipv4_prefixlen;
+	uint32_t ipv4_mask;
+	int	 ipv6_prefixlen;
+	uint32_t ipv6_mask[4];
+
+	dns_rrl_shard_t shards[DNS_RRL_SHARDS];
+};
+
 typedef enum {
 	DNS_RRL_RESULT_OK,
 	DNS_RRL_RESULT_DROP,
@@ -353,4 +353,22 @@ dns_sdlz_setdb_t dns_sdlz_setdb;
  * Create the database pointers for a writeable SDLZ zone
  */
 
+void
+dns_sdlz_setcache(dns_dlzdb_t *dlzdatabase, unsigned int size,
+		  dns_ttl_t maxttl, dns_ttl_t maxncachettl);
+/*%<
+ * Cache the results of driver lookups made for queries to the zones in
+ * 'dlzdatabase', keyed by zone, name and client address.  At most
+ * 'size' results are kept.  A result is kept for no longer than the
+ * lowest TTL of the records found and 'maxttl', or for 'maxncachettl'
+ * if no records were found; a lifetime of 0 disables that kind of
+ * caching.  The cache is flushed whenever an update is committed.
+ *
+ * Must be called before 'dlzdatabase' is first searched.  A 'size' of
+ * 0 leaves caching disabled.
+ *
+ * Requires:
+ * \li	'dlzdatabase' is a valid DLZ database using an SDLZ driver.
+ */
+
 ISC_LANG_ENDDECLS
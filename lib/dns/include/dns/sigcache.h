@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*****
+***** Module Info
+*****/
+
+/*! \file dns/sigcache.h
+ * \brief
+ * Defines dns_sigcache_t, the verified signature cache.
+ *
+ * Notes:
+ *\li	A signature cache is a bounded LRU table of digests, each of
+ *	which identifies an RRSIG, the DNSKEY which verified it and the
+ *	RRset it covers, together with the time until which the
+ *	verification result may be reused.  The validator consults it
+ *	before performing the public key operation, so that an RRset
+ *	which is fetched again (after being evicted from the cache, when
+ *	refreshing stale data, or by another view sharing the cache) is
+ *	not verified over and over again.
+ *
+ *\li	The cache is safe to use from multiple threads.
+ */
+
+/***
+ ***	Imports
+ ***/
+
+#include <stdbool.h>
+
+#include <isc/mem.h>
+#include <isc/stdtime.h>
+
+#include <dns/types.h>
+
+/*%
+ * The length of the (SHA-256) digests stored in the cache.
+ */
+#define DNS_SIGCACHE_DIGESTLENGTH 32
+
+ISC_LANG_BEGINDECLS
+
+/***
+ ***	Functions
+ ***/
+
+dns_sigcache_t *
+dns_sigcache_new(isc_mem_t *mctx, unsigned int size);
+/*%
+ * Allocate and initialize a signature cache holding at most 'size'
+ * entries.
+ *
+ * Requires:
+ * \li	mctx != NULL
+ * \li	size > 0
+ */
+
+void
+dns_sigcache_destroy(dns_sigcache_t **scp);
+/*%
+ * Flush and then free the signature cache in 'scp'.  '*scp' is set to
+ * NULL on return.
+ *
+ * Requires:
+ * \li	'*scp' to be a valid signature cache
+ */
+
+void
+dns_sigcache_add(dns_sigcache_t *sc, const unsigned char *digest,
+		 isc_stdtime_t expire);
+/*%
+ * Record that the signature identified by 'digest' has been verified,
+ * and that the result may be reused until 'expire'.  If an entry for
+ * 'digest' already exists, its expiration time is updated.  If the
+ * cache is full, the least recently used entry is evicted.
+ *
+ * Requires:
+ * \li	sc to be a valid signature cache.
+ * \li	digest points to DNS_SIGCACHE_DIGESTLENGTH bytes.
+ */
+
+bool
+dns_sigcache_find(dns_sigcache_t *sc, const unsigned char *digest,
+		  isc_stdtime_t now);
+/*%
+ * Returns true if the signature identified by 'digest' is in the
+ * cache 'sc' with an expiration time later than 'now'.  Expired
+ * entries found during the lookup are removed.
+ *
+ * Requires:
+ * \li	sc to be a valid signature cache.
+ * \li	digest points to DNS_SIGCACHE_DIGESTLENGTH bytes.
+ */
+
+void
+dns_sigcache_flush(dns_sigcache_t *sc);
+/*%
+ * Flush the entire signature cache.
+ *
+ * Requires:
+ * \li	sc to be a valid signature cache
+ */
+
+ISC_LANG_ENDDECLS
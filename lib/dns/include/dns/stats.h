@@ -74,7 +74,12 @@ enum {
 	dns_resstatscounter_clientquota = 43,
 	dns_resstatscounter_nextitem = 44,
 	dns_resstatscounter_priming = 45,
-	dns_resstatscounter_max = 46,
+	dns_resstatscounter_tcpreuse = 46,
+	dns_resstatscounter_tcpidleclose = 47,
+	dns_resstatscounter_udpreuse = 48,
+	dns_resstatscounter_hedge = 49,
+	dns_resstatscounter_failcache = 50,
+	dns_resstatscounter_max = 51,
 
 	/*
 	 * DNSSEC stats.
@@ -103,6 +103,7 @@ typedef ISC_LIST(dns_kasp_digest_t) dns_kasp_digestlist_t;
 typedef struct dns_kasp_key dns_kasp_key_t;
 typedef ISC_LIST(dns_kasp_key_t) dns_kasp_keylist_t;
 typedef struct dns_kasp_nsec3param dns_kasp_nsec3param_t;
+typedef struct dns_keycache	   dns_keycache_t;
 typedef uint16_t		   dns_keyflags_t;
 typedef struct dns_keynode	   dns_keynode_t;
 typedef ISC_LIST(dns_keynode_t) dns_keynodelist_t;
@@ -154,6 +155,7 @@ typedef struct dns_qpnode     dns_qpnode_t;
 typedef uint8_t		      dns_secalg_t;
 typedef uint8_t		      dns_secproto_t;
 typedef struct dns_signature  dns_signature_t;
+typedef struct dns_sigcache   dns_sigcache_t;
 typedef struct dns_slabheader dns_slabheader_t;
 typedef ISC_LIST(dns_slabheader_t) dns_slabheaderlist_t;
 typedef struct dns_sortlist_arg	  dns_sortlist_arg_t;
@@ -429,6 +431,10 @@ typedef struct {
  */
 typedef void (*dns_dumpdonefunc_t)(void *, isc_result_t);
 
+typedef void (*dns_journaldonefunc_t)(void *, isc_result_t);
+
+typedef void (*dns_zonebatchfunc_t)(dns_zone_t *, void **, size_t);
+
 typedef void (*dns_loaddonefunc_t)(void *, isc_result_t);
 
 typedef void (*dns_rawdatafunc_t)(dns_zone_t *, dns_masterrawheader_t *);
@@ -128,6 +128,7 @@ struct dns_validator {
 	dns_validator_t	  *parent;
 	dns_keytable_t	  *keytable;
 	dst_key_t	  *key;
+	unsigned int	   keyidx;
 	dns_rdata_rrsig_t *siginfo;
 	unsigned int	   labels;
 	dns_rdataset_t	  *nxset;
@@ -57,10 +57,12 @@
 #include <stdbool.h>
 #include <stdio.h>
 
+#include <isc/hashmap.h>
 #include <isc/lang.h>
 #include <isc/magic.h>
 #include <isc/mutex.h>
 #include <isc/net.h>
+#include <isc/quota.h>
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
 #include <isc/stdtime.h>
@@ -86,6 +88,7 @@ struct dns_view {
 	isc_mem_t	  *mctx;
 	dns_rdataclass_t   rdclass;
 	char		  *name;
+	uint32_t	   instance; /*%< unique per dns_view_create() */
 	dns_zt_t	  *zonetable;
 	dns_resolver_t	  *resolver;
 	dns_adb_t	  *adb;
@@ -93,6 +96,8 @@ struct dns_view {
 	dns_dispatchmgr_t *dispatchmgr;
 	dns_cache_t	  *cache;
 	dns_db_t	  *cachedb;
+	dns_cache_t	  *delegcache;
+	dns_db_t	  *delegdb;
 	dns_db_t	  *hints;
 
 	/*
@@ -159,6 +164,10 @@ struct dns_view {
 	char		     *nta_file;
 	dns_ttl_t	      prefetch_trigger;
 	dns_ttl_t	      prefetch_eligible;
+	isc_quota_t	      prefetchquota;
+	isc_quota_t	      stalerefreshquota;
+	isc_mutex_t	      stalerefreshlock;
+	isc_hashmap_t	     *stalerefreshes; /* in progress */
 	in_port_t	      dstport;
 	dns_aclenv_t	     *aclenv;
 	dns_rdatatype_t	      preferred_glue;
@@ -182,6 +191,7 @@ struct dns_view {
 	dns_dlzdblist_t	      dlz_unsearched;
 	uint32_t	      fail_ttl;
 	dns_badcache_t	     *failcache;
+	dns_keycache_t	     *keycache;
 	unsigned int	      udpsize;
 
 	/*
@@ -410,6 +420,22 @@ dns_view_setcache(dns_view_t *view, dns_cache_t *cache, bool shared);
  *	view, then previously set cache is detached.
  */
 
+void
+dns_view_setdelegationcache(dns_view_t *view, dns_cache_t *cache);
+/*%<
+ * Set the view's delegation cache.  Referral NS RRsets learned by the
+ * resolver are stored here as well as in the main cache, so that the
+ * zone cuts found by dns_view_findzonecut() survive when the main cache
+ * is cleaned under memory pressure.  The delegation cache is private to
+ * the view and is cleaned by its own LRU when it exceeds its size limit.
+ *
+ * Requires:
+ *
+ *\li	'view' is a valid, unfrozen view.
+ *
+ *\li	'cache' is a valid cache, or NULL to disable the delegation cache.
+ */
+
 void
 dns_view_sethints(dns_view_t *view, dns_db_t *hints);
 /*%<
@@ -702,7 +728,9 @@ dns_view_findzonecut(dns_view_t *view, const dns_name_t *name,
  *	it will be searched last.
  *
  *\li	If 'use_cache' is true, and the view has a cache, then it will be
- *	searched.
+ *	searched.  If the view also has a delegation cache, it is searched
+ *	too, and its zonecut is used when it is deeper than the one found
+ *	in the main cache.
  *
  *\li	If 'sigrdataset' is not NULL, and there is a SIG rdataset which
  *	covers 'type', then 'sigrdataset' will be bound to it.
@@ -102,6 +102,9 @@ typedef enum {
 	DNS_ZONEOPT_CHECKTTL = 1 << 28,	      /*%< check max-zone-ttl */
 	DNS_ZONEOPT_AUTOEMPTY = 1 << 29,      /*%< automatic empty zone */
 	DNS_ZONEOPT_CHECKSVCB = 1 << 30,      /*%< check SVBC records */
+	DNS_ZONEOPT_CACHERENDERED = 1ULL << 31, /*%< cache-rendered-answers */
+	DNS_ZONEOPT_UPDGROUPCOMMIT = 1ULL << 32, /*%< update-group-commit */
+	DNS_ZONEOPT_LOADONDEMAND = 1ULL << 33,	 /*%< load-on-demand */
 	DNS_ZONEOPT___MAX = UINT64_MAX, /* trick to make the ENUM 64-bit wide */
 } dns_zoneopt_t;
 
@@ -126,6 +129,7 @@ typedef enum {
 	DNS_ZONESTATE_SOAQUERY,
 	DNS_ZONESTATE_ANY,
 	DNS_ZONESTATE_AUTOMATIC,
+	DNS_ZONESTATE_LOADING,
 } dns_zonestate_t;
 
 #ifndef DNS_ZONE_MINREFRESH
@@ -365,6 +369,29 @@ dns_zone_setmaxttl(dns_zone_t *zone, uint32_t maxttl);
  *\li	void
  */
 
+void
+dns_zone_setidletime(dns_zone_t *zone, uint32_t idletime);
+/*%<
+ * 	Sets the number of seconds a load-on-demand zone may go without
+ *	being queried before it is unloaded.  0 means never.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
+void
+dns_zone_touch(dns_zone_t *zone);
+/*%<
+ *	Note that 'zone' is about to be used to answer a query.  For a
+ *	zone with the DNS_ZONEOPT_LOADONDEMAND option set, this records
+ *	the access time used to decide when the zone is idle, and starts
+ *	loading the zone asynchronously if it is not loaded.  Does
+ *	nothing for other zones.
+ *
+ * Requires:
+ *\li	'zone' to be valid initialised zone.
+ */
+
 dns_ttl_t
 dns_zone_getmaxttl(dns_zone_t *zone);
 /*%<
@@ -1283,6 +1310,42 @@ dns_zone_getjournal(dns_zone_t *zone);
  *\li	'zone' to be valid initialised zone.
  */
 
+void
+dns_zone_journalcommit(dns_zone_t *zone, dns_diff_t *diff,
+		       dns_journaldonefunc_t done, void *arg);
+/*%<
+ * Queue the transaction in 'diff', which must already have been
+ * committed to the zone database, to be written to the zone journal
+ * together with any other transactions queued before the zone's loop
+ * gets to run the group commit.  The tuples are moved out of 'diff'.
+ *
+ * Once the group has been committed to stable storage, 'done' is called
+ * with 'arg' and the result, the zone is marked dirty and secondaries
+ * are notified.  If the group could not be written, the journal is
+ * removed and the zone is scheduled to be dumped.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'diff' to be a valid diff holding one complete transaction that
+ *	follows on from the previously queued one.
+ *\li	'done' is not NULL.
+ *\li	the caller to be running on the zone's loop.
+ */
+
+void
+dns_zone_queueupdate(dns_zone_t *zone, dns_zonebatchfunc_t func, void *arg);
+/*%<
+ * Queue 'arg' to be passed to 'func' on the zone's loop, together with
+ * everything else queued before the loop gets to it, so that a burst of
+ * dynamic updates can be applied to the zone as a batch.  'func' is
+ * called with arrays of at most DNS_UPDATE_BATCH_MAX arguments, in the
+ * order they were queued.
+ *
+ * Requires:
+ *\li	'zone' to be a valid zone.
+ *\li	'func' is not NULL, and the same for all queued arguments.
+ */
+
 dns_zonetype_t
 dns_zone_gettype(dns_zone_t *zone);
 /*%<
@@ -1839,6 +1902,17 @@ dns_zonemgr_setstartupnotifyrate(dns_zonemgr_t *zmgr, unsigned int value);
  *\li	'zmgr' to be a valid zone manager
  */
 
+void
+dns_zonemgr_setnotifypipelining(dns_zonemgr_t *zmgr, bool value);
+/*%<
+ *	If 'value' is true, send NOTIFY messages over TCP, so that
+ *	messages to the same destination are pipelined over a shared
+ *	connection, and do not subject them to the notify rate limits.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager
+ */
+
 void
 dns_zonemgr_setserialqueryrate(dns_zonemgr_t *zmgr, unsigned int value);
 /*%<
@@ -1848,6 +1922,18 @@ dns_zonemgr_setserialqueryrate(dns_zonemgr_t *zmgr, unsigned int value);
  *\li	'zmgr' to be a valid zone manager
  */
 
+void
+dns_zonemgr_setserialquerypipelining(dns_zonemgr_t *zmgr, bool value);
+/*%<
+ *	If 'value' is true, send refresh SOA queries over TCP, so that
+ *	queries to the same primary are pipelined over a shared
+ *	connection, and do not subject them to the serial query rate
+ *	limit.
+ *
+ * Requires:
+ *\li	'zmgr' to be a valid zone manager
+ */
+
 unsigned int
 dns_zonemgr_getnotifyrate(dns_zonemgr_t *zmgr);
 /*%<
@@ -2170,6 +2256,26 @@ dns_zone_getnotifydelay(dns_zone_t *zone);
  *	'zone' to be valid.
  */
 
+void
+dns_zone_settriereplicas(dns_zone_t *zone, uint32_t replicas);
+/*%<
+ * Set the number of groups of threads that get their own copy of the
+ * zone's name tree when the zone database is next attached; zero
+ * disables replication.  See dns_db_setreplicas().
+ *
+ * Requires:
+ *	'zone' to be valid.
+ */
+
+uint32_t
+dns_zone_gettriereplicas(dns_zone_t *zone);
+/*%<
+ * Get the number of copies of the zone's name tree for readers.
+ *
+ * Requires:
+ *	'zone' to be valid.
+ */
+
 void
 dns_zone_setisself(dns_zone_t *zone, dns_isselffunc_t isself, void *arg);
 /*%<
@@ -39,7 +39,10 @@ ISC_LANG_BEGINDECLS
  * zone apex as secure.
  *
  * If 'secroots' is not NULL, mark the DNSKEY RRset as secure if it is
- * correctly signed by at least one key present in 'secroots'.
+ * correctly signed by at least one key present in 'secroots'. *
+ * In larger zones the RRset signatures are checked by several threads,
+ * so errors about them may be logged after other errors found later in
+ * the zone walk.
  */
 isc_result_t
 dns_zoneverify_dnssec(dns_zone_t *zone, dns_db_t *db, dns_dbversion_t *ver,
@@ -13,13 +13,47 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <isc/mem.h>
+#include <isc/netaddr.h>
 #include <isc/radix.h>
 #include <isc/util.h>
 
 #include <dns/acl.h>
 
+/*
+ * A compiled IP table: for each address family, the address space is
+ * cut into consecutive ranges, sorted by their first address, and each
+ * range carries the signed node number of the first prefix covering it
+ * (0 if none does).  A lookup is a binary search over 'start'.
+ */
+typedef struct iptable_key {
+	uint64_t hi;
+	uint64_t lo;
+} iptable_key_t;
+
+struct dns_iptable_compiled {
+	int unspec; /* the result for non-IP addresses */
+	unsigned int count4;
+	uint32_t *start4;
+	int *match4;
+	unsigned int count6;
+	iptable_key_t *start6;
+	int *match6;
+};
+
+typedef struct iptable_entry {
+	iptable_key_t start;
+	iptable_key_t end;
+	unsigned int bitlen;
+	int match;
+} iptable_entry_t;
+
+static void
+iptable_invalidate(dns_iptable_t *tab);
+
 /*
  * Create a new IP table and the underlying radix structure
  */
@@ -56,6 +90,8 @@ dns_iptable_addprefix(dns_iptable_t *tab, const isc_netaddr_t *addr,
 
 	NETADDR_TO_PREFIX_T(addr, pfx, bitlen);
 
+	iptable_invalidate(tab);
+
 	result = isc_radix_insert(tab->radix, &node, NULL, &pfx);
 	if (result != ISC_R_SUCCESS) {
 		isc_refcount_destroy(&pfx.refcount);
@@ -94,6 +130,8 @@ dns_iptable_merge(dns_iptable_t *tab, dns_iptable_t *source, bool pos) {
 	isc_radix_node_t *node, *new_node;
 	int i, max_node = 0;
 
+	iptable_invalidate(tab);
+
 	RADIX_WALK(source->radix->head, node) {
 		new_node = NULL;
 		result = isc_radix_insert(tab->radix, &new_node, node, NULL);
@@ -127,12 +165,566 @@ dns_iptable_merge(dns_iptable_t *tab, dns_iptable_t *source, bool pos) {
 	return (ISC_R_SUCCESS);
 }
 
+static int
+key_cmp(const iptable_key_t *a, const iptable_key_t *b) {
+	if (a->hi != b->hi) {
+		return ((a->hi < b->hi) ? -1 : 1);
+	}
+	if (a->lo != b->lo) {
+		return ((a->lo < b->lo) ? -1 : 1);
+	}
+	return (0);
+}
+
+static iptable_key_t
+key_next(iptable_key_t key) {
+	key.lo++;
+	if (key.lo == 0) {
+		key.hi++;
+	}
+	return (key);
+}
+
+static uint64_t
+get_uint64(const unsigned char *p) {
+	uint64_t v = 0;
+
+	for (size_t i = 0; i < 8; i++) {
+		v = (v << 8) | p[i];
+	}
+	return (v);
+}
+
+static int
+entry_cmp(const void *a, const void *b) {
+	const iptable_entry_t *ea = a, *eb = b;
+	int cmp = key_cmp(&ea->start, &eb->start);
+
+	if (cmp != 0) {
+		return (cmp);
+	}
+	return ((int)ea->bitlen - (int)eb->bitlen);
+}
+
+/*
+ * Convert the radix tree prefix of 'node' into the range of addresses
+ * it covers in family 'fam'.  IPv4 addresses use only the low 32 bits.
+ */
+static void
+entry_fromnode(const isc_radix_node_t *node, int fam, iptable_entry_t *e) {
+	const unsigned char *p = isc_prefix_touchar(node->prefix);
+	unsigned int bitlen = node->prefix->bitlen;
+	uint64_t mhi, mlo;
+
+	*e = (iptable_entry_t){
+		.bitlen = bitlen,
+		.match = *(bool *)node->data[fam] ? node->node_num[fam]
+						  : -node->node_num[fam],
+	};
+
+	if (fam == RADIX_V4) {
+		uint32_t mask = (bitlen == 0) ? 0 : (~0U << (32 - bitlen));
+		uint32_t addr = ((uint32_t)p[0] << 24) | (p[1] << 16) |
+				(p[2] << 8) | p[3];
+
+		e->start.lo = addr & mask;
+		e->end.lo = e->start.lo | (uint32_t)~mask;
+		return;
+	}
+
+	if (bitlen <= 64) {
+		mhi = (bitlen == 0) ? 0 : (~UINT64_C(0) << (64 - bitlen));
+		mlo = 0;
+	} else {
+		mhi = ~UINT64_C(0);
+		mlo = ~UINT64_C(0) << (128 - bitlen);
+	}
+	e->start.hi = get_uint64(p) & mhi;
+	e->start.lo = get_uint64(p + 8) & mlo;
+	e->end.hi = e->start.hi | ~mhi;
+	e->end.lo = e->start.lo | ~mlo;
+}
+
+static void
+emit(iptable_key_t *start, int *match, unsigned int *count,
+     iptable_key_t key, int value) {
+	if (*count > 0 && key_cmp(&start[*count - 1], &key) == 0) {
+		(*count)--;
+	}
+	if (*count > 0 && match[*count - 1] == value) {
+		return;
+	}
+	start[*count] = key;
+	match[*count] = value;
+	(*count)++;
+}
+
+/*
+ * Prefixes are either nested or disjoint, so sorting them by first
+ * address (and the shorter prefix first on ties) and sweeping with a
+ * stack of the enclosing prefixes yields the ranges in order.  Each
+ * stack entry carries the best (lowest numbered) match of itself and
+ * of the prefixes enclosing it.  'start' and 'match' must have room
+ * for 2 * count + 1 ranges.
+ */
+static unsigned int
+flatten(iptable_entry_t *entries, unsigned int count, iptable_key_t last,
+	iptable_key_t *start, int *match) {
+	struct {
+		iptable_key_t end;
+		int match;
+	} stack[RADIX_MAXBITS + 1];
+	unsigned int depth = 0, n = 0;
+
+	qsort(entries, count, sizeof(entries[0]), entry_cmp);
+
+	emit(start, match, &n, (iptable_key_t){ 0, 0 }, 0);
+	for (unsigned int i = 0; i < count; i++) {
+		iptable_entry_t *e = &entries[i];
+		int value = e->match;
+
+		while (depth > 0 &&
+		       key_cmp(&stack[depth - 1].end, &e->start) < 0)
+		{
+			depth--;
+			emit(start, match, &n, key_next(stack[depth].end),
+			     (depth > 0) ? stack[depth - 1].match : 0);
+		}
+
+		if (depth > 0 && abs(stack[depth - 1].match) < abs(value)) {
+			value = stack[depth - 1].match;
+		}
+
+		INSIST(depth < ARRAY_SIZE(stack));
+		stack[depth].end = e->end;
+		stack[depth].match = value;
+		depth++;
+
+		emit(start, match, &n, e->start, value);
+	}
+
+	while (depth > 0) {
+		depth--;
+		if (key_cmp(&stack[depth].end, &last) != 0) {
+			emit(start, match, &n, key_next(stack[depth].end),
+			     (depth > 0) ? stack[depth - 1].match : 0);
+		}
+	}
+
+	return (n);
+}
+
+static dns_iptable_compiled_t *
+compile(dns_iptable_t *tab) {
+	dns_iptable_compiled_t *compiled = NULL;
+	isc_radix_node_t *node = NULL;
+	iptable_entry_t *entries[RADIX_FAMILIES] = { NULL };
+	unsigned int count[RADIX_FAMILIES] = { 0 };
+	unsigned int nodes = 0;
+	iptable_key_t *start = NULL;
+	int *match = NULL;
+	unsigned int n;
+
+	compiled = isc_mem_get(tab->mctx, sizeof(*compiled));
+	*compiled = (dns_iptable_compiled_t){ 0 };
+
+	RADIX_WALK(tab->radix->head, node) {
+		nodes++;
+	}
+	RADIX_WALK_END;
+
+	for (int fam = 0; fam < RADIX_FAMILIES; fam++) {
+		entries[fam] = isc_mem_cget(tab->mctx, nodes + 1,
+					    sizeof(entries[fam][0]));
+	}
+
+	RADIX_WALK(tab->radix->head, node) {
+		for (int fam = 0; fam < RADIX_FAMILIES; fam++) {
+			iptable_entry_t *e = &entries[fam][count[fam]];
+
+			if (node->node_num[fam] == -1 ||
+			    (fam == RADIX_V4 && node->prefix->bitlen > 32))
+			{
+				continue;
+			}
+			INSIST(node->data[fam] != NULL);
+
+			entry_fromnode(node, fam, e);
+			count[fam]++;
+
+			if (fam == RADIX_V4 && e->bitlen == 0 &&
+			    (compiled->unspec == 0 ||
+			     abs(e->match) < abs(compiled->unspec)))
+			{
+				compiled->unspec = e->match;
+			}
+		}
+	}
+	RADIX_WALK_END;
+
+	n = 2 * ISC_MAX(count[RADIX_V4], count[RADIX_V6]) + 1;
+	start = isc_mem_cget(tab->mctx, n, sizeof(start[0]));
+	match = isc_mem_cget(tab->mctx, n, sizeof(match[0]));
+
+	compiled->count4 = flatten(entries[RADIX_V4], count[RADIX_V4],
+				   (iptable_key_t){ 0, UINT32_MAX }, start,
+				   match);
+	compiled->start4 = isc_mem_cget(tab->mctx, compiled->count4,
+					sizeof(compiled->start4[0]));
+	compiled->match4 = isc_mem_cget(tab->mctx, compiled->count4,
+					sizeof(compiled->match4[0]));
+	for (unsigned int i = 0; i < compiled->count4; i++) {
+		compiled->start4[i] = (uint32_t)start[i].lo;
+		compiled->match4[i] = match[i];
+	}
+
+	compiled->count6 = flatten(entries[RADIX_V6], count[RADIX_V6],
+				   (iptable_key_t){ UINT64_MAX, UINT64_MAX },
+				   start, match);
+	compiled->start6 = isc_mem_cget(tab->mctx, compiled->count6,
+					sizeof(compiled->start6[0]));
+	compiled->match6 = isc_mem_cget(tab->mctx, compiled->count6,
+					sizeof(compiled->match6[0]));
+	memmove(compiled->start6, start,
+		compiled->count6 * sizeof(compiled->start6[0]));
+	memmove(compiled->match6, match,
+		compiled->count6 * sizeof(compiled->match6[0]));
+
+	isc_mem_cput(tab->mctx, start, n, sizeof(start[0]));
+	isc_mem_cput(tab->mctx, match, n, sizeof(match[0]));
+	for (int fam = 0; fam < RADIX_FAMILIES; fam++) {
+		isc_mem_cput(tab->mctx, entries[fam], nodes + 1,
+			     sizeof(entries[fam][0]));
+	}
+
+	return (compiled);
+}
+
+static void
+compiled_free(isc_mem_t *mctx, dns_iptable_compiled_t *compiled) {
+	isc_mem_cput(mctx, compiled->start4, compiled->count4,
+		     sizeof(compiled->start4[0]));
+	isc_mem_cput(mctx, compiled->match4, compiled->count4,
+		     sizeof(compiled->match4[0]));
+	isc_mem_cput(mctx, compiled->start6, compiled->count6,
+		     sizeof(compiled->start6[0]));
+	isc_mem_cput(mctx, compiled->match6, compiled->count6,
+		     sizeof(compiled->match6[0]));
+	isc_mem_put(mctx, compiled, sizeof(*compiled));
+}
+
+/*
+ * Adding prefixes happens while an ACL is being built, before it is
+ * shared, so the compiled form can simply be dropped.
+ */
+static void
+iptable_invalidate(dns_iptable_t *tab) {
+	dns_iptable_compiled_t *compiled =
+		atomic_exchange_acq_rel(&tab->compiled, NULL);
+
+	if (compiled != NULL) {
+		compiled_free(tab->mctx, compiled);
+	}
+}
+
+static dns_iptable_compiled_t *
+iptable_compiled(dns_iptable_t *tab) {
+	dns_iptable_compiled_t *compiled = atomic_load_acquire(&tab->compiled);
+	dns_iptable_compiled_t *expected = NULL;
+
+	if (compiled != NULL) {
+		return (compiled);
+	}
+
+	/*
+	 * Several threads may race to compile the same table; the first
+	 * one wins and the others throw their work away.
+	 */
+	compiled = compile(tab);
+	if (!atomic_compare_exchange_strong_acq_rel(&tab->compiled, &expected,
+						    compiled))
+	{
+		compiled_free(tab->mctx, compiled);
+		compiled = expected;
+	}
+
+	return (compiled);
+}
+
+void
+dns_iptable_compile(dns_iptable_t *tab) {
+	REQUIRE(DNS_IPTABLE_VALID(tab));
+
+	(void)iptable_compiled(tab);
+}
+
+/*
+ * The index of the last range in 'start' that begins at or before 'key'.
+ * The first range always begins at the lowest address.
+ */
+static unsigned int
+find4(const uint32_t *start, unsigned int count, uint32_t key) {
+	unsigned int lo = 0, hi = count;
+
+	while (hi - lo > 1) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (start[mid] <= key) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return (lo);
+}
+
+static unsigned int
+find6(const iptable_key_t *start, unsigned int count, iptable_key_t key) {
+	unsigned int lo = 0, hi = count;
+
+	while (hi - lo > 1) {
+		unsigned int mid = lo + (hi - lo) / 2;
+		if (key_cmp(&start[mid], &key) <= 0) {
+			lo = mid;
+		} else {
+			hi = mid;
+		}
+	}
+	return (lo);
+}
+
+static iptable_key_t
+key_fromaddr6(const isc_netaddr_t *addr) {
+	return ((iptable_key_t){
+		.hi = get_uint64(addr->type.in6.s6_addr),
+		.lo = get_uint64(addr->type.in6.s6_addr + 8),
+	});
+}
+
+int
+dns_iptable_match(dns_iptable_t *tab, const isc_netaddr_t *addr) {
+	dns_iptable_compiled_t *compiled = NULL;
+
+	REQUIRE(DNS_IPTABLE_VALID(tab));
+	REQUIRE(addr != NULL);
+
+	compiled = iptable_compiled(tab);
+
+	switch (addr->family) {
+	case AF_INET:
+		return (compiled->match4[find4(compiled->start4,
+					       compiled->count4,
+					       ntohl(addr->type.in.s_addr))]);
+	case AF_INET6:
+		return (compiled->match6[find6(compiled->start6,
+					       compiled->count6,
+					       key_fromaddr6(addr))]);
+	default:
+		return (compiled->unspec);
+	}
+}
+
+/*
+ * A set of compiled IP tables merged into one: the ranges of all the
+ * tables are cut where any of them starts a new range, and each range
+ * carries a vector with the sign of every table's match for it.
+ */
+struct dns_iptableset {
+	isc_mem_t *mctx;
+	size_t ntables;
+	int8_t *unspec;
+	unsigned int alloc4, count4;
+	uint32_t *start4;
+	int8_t *match4;
+	unsigned int alloc6, count6;
+	iptable_key_t *start6;
+	int8_t *match6;
+};
+
+static int8_t
+match_sign(int match) {
+	return ((match > 0) - (match < 0));
+}
+
+static int
+start4_cmp(const void *a, const void *b) {
+	uint32_t ka = *(const uint32_t *)a, kb = *(const uint32_t *)b;
+
+	return ((ka > kb) - (ka < kb));
+}
+
+static int
+start6_cmp(const void *a, const void *b) {
+	return (key_cmp(a, b));
+}
+
+/*
+ * Whether the match vector 'vec', written after the 'n' vectors in
+ * 'match', differs from the last of them and so starts a new range.
+ */
+static bool
+vector_append(int8_t *match, unsigned int n, const int8_t *vec,
+	      size_t ntables) {
+	return (n == 0 ||
+		memcmp(&match[(n - 1) * ntables], vec, ntables) != 0);
+}
+
+void
+dns_iptableset_create(isc_mem_t *mctx, dns_iptable_t *const *tabs,
+		      size_t ntables, dns_iptableset_t **setp) {
+	dns_iptableset_t *set = NULL;
+	dns_iptable_compiled_t **compiled = NULL;
+	unsigned int total4 = 1, total6 = 1, n;
+	uint32_t *keys4 = NULL;
+	iptable_key_t *keys6 = NULL;
+	int8_t *vec = NULL;
+
+	REQUIRE(setp != NULL && *setp == NULL);
+	REQUIRE(ntables == 0 || tabs != NULL);
+
+	compiled = isc_mem_cget(mctx, ntables + 1, sizeof(compiled[0]));
+	for (size_t i = 0; i < ntables; i++) {
+		if (tabs[i] != NULL) {
+			REQUIRE(DNS_IPTABLE_VALID(tabs[i]));
+			compiled[i] = iptable_compiled(tabs[i]);
+			total4 += compiled[i]->count4;
+			total6 += compiled[i]->count6;
+		}
+	}
+
+	set = isc_mem_get(mctx, sizeof(*set));
+	*set = (dns_iptableset_t){ .ntables = ntables };
+	isc_mem_attach(mctx, &set->mctx);
+
+	set->unspec = isc_mem_cget(mctx, ntables + 1, sizeof(set->unspec[0]));
+	for (size_t i = 0; i < ntables; i++) {
+		if (compiled[i] != NULL) {
+			set->unspec[i] = match_sign(compiled[i]->unspec);
+		}
+	}
+
+	/*
+	 * Every table's result is constant between two consecutive
+	 * range starts of the union, so one lookup per table at each of
+	 * them gives the merged ranges.
+	 */
+	keys4 = isc_mem_cget(mctx, total4, sizeof(keys4[0]));
+	n = 1;
+	for (size_t i = 0; i < ntables; i++) {
+		if (compiled[i] != NULL) {
+			memmove(&keys4[n], compiled[i]->start4,
+				compiled[i]->count4 * sizeof(keys4[0]));
+			n += compiled[i]->count4;
+		}
+	}
+	qsort(keys4, total4, sizeof(keys4[0]), start4_cmp);
+
+	set->alloc4 = total4;
+	set->start4 = isc_mem_cget(mctx, total4, sizeof(set->start4[0]));
+	set->match4 = isc_mem_cget(mctx, total4, ntables + 1);
+	for (unsigned int k = 0; k < total4; k++) {
+		if (k > 0 && keys4[k] == keys4[k - 1]) {
+			continue;
+		}
+		vec = &set->match4[set->count4 * ntables];
+		for (size_t i = 0; i < ntables; i++) {
+			const dns_iptable_compiled_t *c = compiled[i];
+			vec[i] = (c == NULL) ? 0
+					     : match_sign(c->match4[find4(
+						       c->start4, c->count4,
+						       keys4[k])]);
+		}
+		if (vector_append(set->match4, set->count4, vec, ntables)) {
+			set->start4[set->count4++] = keys4[k];
+		}
+	}
+	isc_mem_cput(mctx, keys4, total4, sizeof(keys4[0]));
+
+	keys6 = isc_mem_cget(mctx, total6, sizeof(keys6[0]));
+	n = 1;
+	for (size_t i = 0; i < ntables; i++) {
+		if (compiled[i] != NULL) {
+			memmove(&keys6[n], compiled[i]->start6,
+				compiled[i]->count6 * sizeof(keys6[0]));
+			n += compiled[i]->count6;
+		}
+	}
+	qsort(keys6, total6, sizeof(keys6[0]), start6_cmp);
+
+	set->alloc6 = total6;
+	set->start6 = isc_mem_cget(mctx, total6, sizeof(set->start6[0]));
+	set->match6 = isc_mem_cget(mctx, total6, ntables + 1);
+	for (unsigned int k = 0; k < total6; k++) {
+		if (k > 0 && key_cmp(&keys6[k], &keys6[k - 1]) == 0) {
+			continue;
+		}
+		vec = &set->match6[set->count6 * ntables];
+		for (size_t i = 0; i < ntables; i++) {
+			const dns_iptable_compiled_t *c = compiled[i];
+			vec[i] = (c == NULL) ? 0
+					     : match_sign(c->match6[find6(
+						       c->start6, c->count6,
+						       keys6[k])]);
+		}
+		if (vector_append(set->match6, set->count6, vec, ntables)) {
+			set->start6[set->count6++] = keys6[k];
+		}
+	}
+	isc_mem_cput(mctx, keys6, total6, sizeof(keys6[0]));
+
+	isc_mem_cput(mctx, compiled, ntables + 1, sizeof(compiled[0]));
+
+	*setp = set;
+}
+
+void
+dns_iptableset_destroy(dns_iptableset_t **setp) {
+	dns_iptableset_t *set = NULL;
+	size_t width;
+
+	REQUIRE(setp != NULL && *setp != NULL);
+
+	set = *setp;
+	*setp = NULL;
+
+	width = set->ntables + 1;
+	isc_mem_cput(set->mctx, set->unspec, width, sizeof(set->unspec[0]));
+	isc_mem_cput(set->mctx, set->start4, set->alloc4,
+		     sizeof(set->start4[0]));
+	isc_mem_cput(set->mctx, set->match4, set->alloc4, width);
+	isc_mem_cput(set->mctx, set->start6, set->alloc6,
+		     sizeof(set->start6[0]));
+	isc_mem_cput(set->mctx, set->match6, set->alloc6, width);
+	isc_mem_putanddetach(&set->mctx, set, sizeof(*set));
+}
+
+const int8_t *
+dns_iptableset_match(const dns_iptableset_t *set, const isc_netaddr_t *addr) {
+	unsigned int i;
+
+	REQUIRE(set != NULL);
+	REQUIRE(addr != NULL);
+
+	switch (addr->family) {
+	case AF_INET:
+		i = find4(set->start4, set->count4,
+			  ntohl(addr->type.in.s_addr));
+		return (&set->match4[i * set->ntables]);
+	case AF_INET6:
+		i = find6(set->start6, set->count6, key_fromaddr6(addr));
+		return (&set->match6[i * set->ntables]);
+	default:
+		return (set->unspec);
+	}
+}
+
 static void
 dns__iptable_destroy(dns_iptable_t *dtab) {
 	REQUIRE(DNS_IPTABLE_VALID(dtab));
 
 	dtab->magic = 0;
 
+	iptable_invalidate(dtab);
+
 	if (dtab->radix != NULL) {
 		isc_radix_destroy(dtab->radix, NULL);
 		dtab->radix = NULL;
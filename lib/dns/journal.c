@@ -17,6 +17,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <isc/dir.h>
 #include <isc/file.h>
 #include <isc/mem.h>
@@ -331,6 +334,8 @@ struct dns_journal {
 	char *filename;		     /*%< Journal file name */
 	FILE *fp;		     /*%< File handle */
 	off_t offset;		     /*%< Current file offset */
+	unsigned char *map;	     /*%< Read-only mapping of the file */
+	size_t maplen;		     /*%< Length of the mapping */
 	journal_xhdr_t curxhdr;	     /*%< Current transaction header */
 	journal_header_t header;     /*%< In-core journal header */
 	unsigned char *rawindex;     /*%< In-core buffer for journal index
@@ -361,12 +366,33 @@ struct dns_journal {
 		unsigned int xsize;	 /*%< Size of transaction data */
 		unsigned int xpos;	 /*%< Current position in it */
 		isc_result_t result;	 /*%< Result of last call */
+		bool raw;		 /*%< Refer to rdata in place */
 	} it;
 };
 
 #define DNS_JOURNAL_MAGIC    ISC_MAGIC('J', 'O', 'U', 'R')
 #define DNS_JOURNAL_VALID(t) ISC_MAGIC_VALID(t, DNS_JOURNAL_MAGIC)
 
+/*%
+ * A compaction in progress: the retained part of the journal has been
+ * copied to 'newname' but not yet swapped in.
+ */
+struct dns_journalcompact {
+	isc_mem_t *mctx;
+	char *filename;
+	char newname[PATH_MAX];
+	char backup[PATH_MAX];
+	bool is_backup;
+	bool rewrite;
+	uint32_t serial;	  /*%< As passed, for starting over */
+	uint32_t flags;		  /*%< As passed, for starting over */
+	uint32_t target_size;	  /*%< As passed, for starting over */
+	unsigned int indexend;	  /*%< First transaction offset */
+	journal_pos_t begin;	  /*%< Start of the source when copied */
+	journal_pos_t end;	  /*%< End of the source when copied */
+	dns_journal_t *j2;	  /*%< The new journal */
+};
+
 static void
 journal_pos_decode(journal_rawpos_t *raw, journal_pos_t *cooked) {
 	cooked->serial = decode_uint32(raw->serial);
@@ -416,6 +442,11 @@ static isc_result_t
 journal_seek(dns_journal_t *j, uint32_t offset) {
 	isc_result_t result;
 
+	if (j->map != NULL) {
+		j->offset = offset;
+		return (ISC_R_SUCCESS);
+	}
+
 	result = isc_stdio_seek(j->fp, (off_t)offset, SEEK_SET);
 	if (result != ISC_R_SUCCESS) {
 		isc_log_write(JOURNAL_COMMON_LOGARGS, ISC_LOG_ERROR,
@@ -431,6 +462,17 @@ static isc_result_t
 journal_read(dns_journal_t *j, void *mem, size_t nbytes) {
 	isc_result_t result;
 
+	if (j->map != NULL) {
+		if (j->offset < 0 || (size_t)j->offset > j->maplen ||
+		    nbytes > j->maplen - (size_t)j->offset)
+		{
+			return (ISC_R_NOMORE);
+		}
+		memmove(mem, j->map + j->offset, nbytes);
+		j->offset += (off_t)nbytes;
+		return (ISC_R_SUCCESS);
+	}
+
 	result = isc_stdio_read(mem, 1, nbytes, j->fp, NULL);
 	if (result != ISC_R_SUCCESS) {
 		if (result == ISC_R_EOF) {
@@ -560,6 +602,35 @@ journal_read_rrhdr(dns_journal_t *j, journal_rrhdr_t *rrhdr) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Map a journal opened for reading, so that transactions can be walked
+ * and RRs decoded straight from the page cache instead of being read
+ * through stdio.  Journals are only ever appended to in place; they are
+ * compacted or recreated by renaming a new file over them, so the
+ * mapped part of the file stays valid for as long as it is mapped.  If
+ * the file can't be mapped, reads fall back to stdio.
+ */
+static void
+journal_map(dns_journal_t *j) {
+	struct stat sb;
+	void *map = NULL;
+
+	if (fstat(fileno(j->fp), &sb) != 0 || !S_ISREG(sb.st_mode) ||
+	    sb.st_size <= 0 || (uintmax_t)sb.st_size > UINT32_MAX)
+	{
+		return;
+	}
+
+	map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE,
+		   fileno(j->fp), 0);
+	if (map == MAP_FAILED) {
+		return;
+	}
+
+	j->map = map;
+	j->maplen = (size_t)sb.st_size;
+}
+
 static isc_result_t
 journal_file_create(isc_mem_t *mctx, bool downgrade, const char *filename) {
 	FILE *fp = NULL;
@@ -740,6 +811,10 @@ journal_open(isc_mem_t *mctx, const char *filename, bool writable, bool create,
 	isc_buffer_init(&j->it.target, NULL, 0);
 	j->it.dctx = DNS_DECOMPRESS_NEVER;
 
+	if (!writable) {
+		journal_map(j);
+	}
+
 	j->state = writable ? JOURNAL_STATE_WRITE : JOURNAL_STATE_READ;
 
 	*journalp = j;
@@ -791,6 +866,9 @@ dns_journal_open(isc_mem_t *mctx, const char *filename, unsigned int mode,
 		result = journal_open(mctx, backup, writable, writable, false,
 				      journalp);
 	}
+	if (result == ISC_R_SUCCESS) {
+		(*journalp)->it.raw = ((mode & DNS_JOURNAL_RAW) != 0);
+	}
 	return (result);
 }
 
@@ -1280,8 +1358,45 @@ failure:
 	return (result);
 }
 
-isc_result_t
-dns_journal_commit(dns_journal_t *j) {
+/*
+ * Write the on-disk journal header and index, and commit them to
+ * stable storage.  The transaction data they describe must already
+ * have been synced.
+ */
+static isc_result_t
+journal_write_header(dns_journal_t *j) {
+	isc_result_t result;
+	journal_rawheader_t rawheader;
+
+	journal_header_encode(&j->header, &rawheader);
+	CHECK(journal_seek(j, 0));
+	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
+
+	/*
+	 * Convert the index into on-disk format and write
+	 * it to disk.
+	 */
+	CHECK(index_to_disk(j));
+
+	/*
+	 * Commit the header to stable storage.
+	 */
+	CHECK(journal_fsync(j));
+
+	result = ISC_R_SUCCESS;
+
+failure:
+	return (result);
+}
+
+/*
+ * Commit the current transaction.  If 'sync' is false the transaction
+ * header is written but neither the data nor the journal header are
+ * committed to stable storage; the caller is expected to do that once
+ * for a group of transactions.
+ */
+static isc_result_t
+journal_commit(dns_journal_t *j, bool sync) {
 	isc_result_t result;
 	journal_rawheader_t rawheader;
 	uint64_t total;
@@ -1289,6 +1404,7 @@ dns_journal_commit(dns_journal_t *j) {
 	REQUIRE(DNS_JOURNAL_VALID(j));
 	REQUIRE(j->state == JOURNAL_STATE_TRANSACTION ||
 		j->state == JOURNAL_STATE_INLINE);
+	REQUIRE(sync || j->state == JOURNAL_STATE_TRANSACTION);
 
 	/*
 	 * Just write out a updated header.
@@ -1366,7 +1482,9 @@ dns_journal_commit(dns_journal_t *j) {
 	/*
 	 * Commit the transaction data to stable storage.
 	 */
-	CHECK(journal_fsync(j));
+	if (sync) {
+		CHECK(journal_fsync(j));
+	}
 
 	if (j->state == JOURNAL_STATE_TRANSACTION) {
 		off_t offset;
@@ -1389,25 +1507,15 @@ dns_journal_commit(dns_journal_t *j) {
 		j->header.begin = j->x.pos[0];
 	}
 	j->header.end = j->x.pos[1];
-	journal_header_encode(&j->header, &rawheader);
-	CHECK(journal_seek(j, 0));
-	CHECK(journal_write(j, &rawheader, sizeof(rawheader)));
 
 	/*
 	 * Update the index.
 	 */
 	index_add(j, &j->x.pos[0]);
 
-	/*
-	 * Convert the index into on-disk format and write
-	 * it to disk.
-	 */
-	CHECK(index_to_disk(j));
-
-	/*
-	 * Commit the header to stable storage.
-	 */
-	CHECK(journal_fsync(j));
+	if (sync) {
+		CHECK(journal_write_header(j));
+	}
 
 	/*
 	 * We no longer have a transaction open.
@@ -1420,6 +1528,11 @@ failure:
 	return (result);
 }
 
+isc_result_t
+dns_journal_commit(dns_journal_t *j) {
+	return (journal_commit(j, true));
+}
+
 isc_result_t
 dns_journal_write_transaction(dns_journal_t *j, dns_diff_t *diff) {
 	isc_result_t result;
@@ -1433,6 +1546,33 @@ failure:
 	return (result);
 }
 
+isc_result_t
+dns_journal_write_transactions(dns_journal_t *j, dns_diff_t **diffs,
+			       unsigned int ndiffs) {
+	isc_result_t result;
+
+	REQUIRE(DNS_JOURNAL_VALID(j));
+	REQUIRE(diffs != NULL && ndiffs > 0);
+
+	for (unsigned int i = 0; i < ndiffs; i++) {
+		CHECK(dns_diff_sort(diffs[i], ixfr_order));
+		CHECK(dns_journal_begin_transaction(j));
+		CHECK(dns_journal_writediff(j, diffs[i]));
+		CHECK(journal_commit(j, false));
+	}
+
+	/*
+	 * Commit the transaction data of the whole group to stable
+	 * storage, and only then make it visible in the header.
+	 */
+	CHECK(journal_fsync(j));
+	CHECK(journal_write_header(j));
+
+	result = ISC_R_SUCCESS;
+failure:
+	return (result);
+}
+
 void
 dns_journal_destroy(dns_journal_t **journalp) {
 	dns_journal_t *j = NULL;
@@ -1456,9 +1596,12 @@ dns_journal_destroy(dns_journal_t **journalp) {
 	if (j->it.target.base != NULL) {
 		isc_mem_put(j->mctx, j->it.target.base, j->it.target.length);
 	}
-	if (j->it.source.base != NULL) {
+	if (j->it.source.base != NULL && j->map == NULL) {
 		isc_mem_put(j->mctx, j->it.source.base, j->it.source.length);
 	}
+	if (j->map != NULL) {
+		RUNTIME_CHECK(munmap(j->map, j->maplen) == 0);
+	}
 	if (j->filename != NULL) {
 		isc_mem_free(j->mctx, j->filename);
 	}
@@ -2018,8 +2161,21 @@ read_one_rr(dns_journal_t *j) {
 		FAIL(ISC_R_UNEXPECTED);
 	}
 
-	CHECK(size_buffer(j->mctx, &j->it.source, rrhdr.size));
-	CHECK(journal_read(j, j->it.source.base, rrhdr.size));
+	if (j->map != NULL) {
+		/*
+		 * Decode the RR in place from the mapped file.
+		 */
+		if ((size_t)j->offset > j->maplen ||
+		    rrhdr.size > j->maplen - (size_t)j->offset)
+		{
+			FAIL(ISC_R_NOMORE);
+		}
+		isc_buffer_init(&j->it.source, j->map + j->offset, rrhdr.size);
+		j->offset += rrhdr.size;
+	} else {
+		CHECK(size_buffer(j->mctx, &j->it.source, rrhdr.size));
+		CHECK(journal_read(j, j->it.source.base, rrhdr.size));
+	}
 	isc_buffer_add(&j->it.source, rrhdr.size);
 
 	/*
@@ -2068,8 +2224,17 @@ read_one_rr(dns_journal_t *j) {
 	}
 	isc_buffer_setactive(&j->it.source, rdlen);
 	dns_rdata_reset(&j->it.rdata);
-	CHECK(dns_rdata_fromwire(&j->it.rdata, rdclass, rdtype, &j->it.source,
-				 j->it.dctx, &j->it.target));
+	if (j->it.raw && rdtype != dns_rdatatype_soa) {
+		isc_region_t r;
+
+		isc_buffer_activeregion(&j->it.source, &r);
+		dns_rdata_fromregion(&j->it.rdata, rdclass, rdtype, &r);
+		isc_buffer_forward(&j->it.source, rdlen);
+	} else {
+		CHECK(dns_rdata_fromwire(&j->it.rdata, rdclass, rdtype,
+					 &j->it.source, j->it.dctx,
+					 &j->it.target));
+	}
 	j->it.ttl = ttl;
 
 	j->it.xpos += sizeof(journal_rawrrhdr_t) + rrhdr.size;
@@ -2460,14 +2625,17 @@ check_delta(unsigned char *buf, size_t size) {
 }
 
 isc_result_t
-dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
-		    uint32_t flags, uint32_t target_size) {
+dns_journal_compact_prepare(isc_mem_t *mctx, const char *filename,
+			    uint32_t serial, uint32_t flags,
+			    uint32_t target_size,
+			    dns_journalcompact_t **compactp) {
 	unsigned int i;
 	journal_pos_t best_guess;
 	journal_pos_t current_pos;
 	dns_journal_t *j1 = NULL;
 	dns_journal_t *j2 = NULL;
-	journal_rawheader_t rawheader;
+	dns_journalcompact_t *c = NULL;
+	uint32_t first_serial = serial;
 	unsigned int len;
 	size_t namelen;
 	unsigned char *buf = NULL;
@@ -2481,6 +2649,7 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 	bool downgrade = false;
 
 	REQUIRE(filename != NULL);
+	REQUIRE(compactp != NULL && *compactp == NULL);
 
 	namelen = strlen(filename);
 	if (namelen > 4U && strcmp(filename + namelen - 4, ".jnl") == 0) {
@@ -2749,32 +2918,155 @@ dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
 		CHECK(journal_fsync(j2));
 
 		/*
-		 * Update the journal header.
-		 */
-		journal_header_encode(&j2->header, &rawheader);
-		CHECK(journal_seek(j2, 0));
-		CHECK(journal_write(j2, &rawheader, sizeof(rawheader)));
-		CHECK(journal_fsync(j2));
-
-		/*
-		 * Build new index.
+		 * Build the new index.  The header and the index are
+		 * written out by dns_journal_compact_finish().
 		 */
 		current_pos = j2->header.begin;
 		while (current_pos.serial != j2->header.end.serial) {
 			index_add(j2, &current_pos);
 			CHECK(journal_next(j2, &current_pos));
 		}
+	}
+
+	c = isc_mem_get(mctx, sizeof(*c));
+	*c = (dns_journalcompact_t){
+		.filename = isc_mem_strdup(mctx, filename),
+		.serial = first_serial,
+		.flags = flags,
+		.target_size = target_size,
+		.is_backup = is_backup,
+		.rewrite = rewrite,
+		.indexend = indexend,
+		.begin = j1->header.begin,
+		.end = j1->header.end,
+		.j2 = j2,
+	};
+	isc_mem_attach(mctx, &c->mctx);
+	strlcpy(c->newname, newname, sizeof(c->newname));
+	strlcpy(c->backup, backup, sizeof(c->backup));
+	j2 = NULL;
+
+	*compactp = c;
+	result = ISC_R_SUCCESS;
+
+failure:
+	if (result != ISC_R_SUCCESS) {
+		(void)isc_file_remove(newname);
+	}
+	if (buf != NULL) {
+		isc_mem_put(mctx, buf, size);
+	}
+	if (j1 != NULL) {
+		dns_journal_destroy(&j1);
+	}
+	if (j2 != NULL) {
+		dns_journal_destroy(&j2);
+	}
+	return (result);
+}
+
+isc_result_t
+dns_journal_compact_finish(dns_journalcompact_t **compactp) {
+	dns_journalcompact_t *c = NULL;
+	isc_mem_t *mctx = NULL;
+	dns_journal_t *j1 = NULL;
+	dns_journal_t *j2 = NULL;
+	journal_pos_t pos;
+	unsigned char *buf = NULL;
+	unsigned int size = 0;
+	unsigned int len;
+	isc_result_t result;
+	char *filename = NULL, *newname = NULL, *backup = NULL;
+	bool is_backup;
+
+	REQUIRE(compactp != NULL && *compactp != NULL);
+
+	c = *compactp;
+	*compactp = NULL;
+
+	mctx = c->mctx;
+	filename = c->filename;
+	newname = c->newname;
+	backup = c->backup;
+	is_backup = c->is_backup;
+	j2 = c->j2;
+	c->j2 = NULL;
+
+	/*
+	 * Look at the journal as it is now: transactions may have been
+	 * appended since the copy was made, but nothing before the end
+	 * of the copy may have changed.
+	 */
+	CHECK(journal_open(mctx, is_backup ? backup : filename, false, false,
+			   false, &j1));
+	if (j1->header.begin.serial != c->begin.serial ||
+	    j1->header.begin.offset != c->begin.offset ||
+	    j1->header.end.offset < c->end.offset)
+	{
+		isc_log_write(JOURNAL_DEBUG_LOGARGS(3),
+			      "%s: journal replaced during compaction",
+			      j1->filename);
+		CHECK(ISC_R_CANCELED);
+	}
+
+	len = j1->header.end.offset - c->end.offset;
+	if (len != 0 && c->rewrite) {
+		/*
+		 * Transactions appended to a journal that is being
+		 * rewritten cannot be copied verbatim; start over.
+		 */
+		dns_journal_destroy(&j1);
+		dns_journal_destroy(&j2);
+		(void)isc_file_remove(newname);
+		result = dns_journal_compact(mctx, filename, c->serial,
+					     c->flags, c->target_size);
+		goto cleanup;
+	}
 
+	if (len != 0) {
 		/*
-		 * Write index.
+		 * Append the transactions written since the copy was
+		 * made.  The transaction data does not depend on where
+		 * it is in the file.
 		 */
-		CHECK(index_to_disk(j2));
+		pos.serial = c->end.serial;
+		pos.offset = JOURNAL_EMPTY(&j2->header) ? c->indexend
+							: j2->header.end.offset;
+		if (JOURNAL_EMPTY(&j2->header)) {
+			j2->header.begin = pos;
+		}
+
+		CHECK(journal_seek(j1, c->end.offset));
+		CHECK(journal_seek(j2, pos.offset));
+		size = ISC_MIN(64 * 1024, len);
+		buf = isc_mem_get(mctx, size);
+		for (unsigned int i = 0; i < len; i += size) {
+			unsigned int blob = ISC_MIN(size, len - i);
+			CHECK(journal_read(j1, buf, blob));
+			CHECK(journal_write(j2, buf, blob));
+		}
+
+		j2->header.end.serial = j1->header.end.serial;
+		j2->header.end.offset = pos.offset + len;
+
+		while (pos.serial != j2->header.end.serial) {
+			index_add(j2, &pos);
+			CHECK(journal_next(j2, &pos));
+		}
+
 		CHECK(journal_fsync(j2));
+	}
 
-		indexend = j2->header.end.offset;
-		POST(indexend);
+	if (!JOURNAL_EMPTY(&j2->header)) {
+		j2->header.sourceserial = j1->header.sourceserial;
+		j2->header.serialset = j1->header.serialset;
 	}
 
+	/*
+	 * Update the journal header and the index.
+	 */
+	CHECK(journal_write_header(j2));
+
 	/*
 	 * Close both journals before trying to rename files.
 	 */
@@ -2827,6 +3119,39 @@ failure:
 	if (j2 != NULL) {
 		dns_journal_destroy(&j2);
 	}
+
+cleanup:
+	isc_mem_free(mctx, c->filename);
+	isc_mem_putanddetach(&c->mctx, c, sizeof(*c));
+	return (result);
+}
+
+void
+dns_journal_compact_cancel(dns_journalcompact_t **compactp) {
+	dns_journalcompact_t *c = NULL;
+
+	REQUIRE(compactp != NULL && *compactp != NULL);
+
+	c = *compactp;
+	*compactp = NULL;
+
+	dns_journal_destroy(&c->j2);
+	(void)isc_file_remove(c->newname);
+	isc_mem_free(c->mctx, c->filename);
+	isc_mem_putanddetach(&c->mctx, c, sizeof(*c));
+}
+
+isc_result_t
+dns_journal_compact(isc_mem_t *mctx, char *filename, uint32_t serial,
+		    uint32_t flags, uint32_t target_size) {
+	isc_result_t result;
+	dns_journalcompact_t *c = NULL;
+
+	result = dns_journal_compact_prepare(mctx, filename, serial, flags,
+					     target_size, &c);
+	if (result == ISC_R_SUCCESS && c != NULL) {
+		result = dns_journal_compact_finish(&c);
+	}
 	return (result);
 }
 
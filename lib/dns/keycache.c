@@ -0,0 +1,304 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+
+#include <isc/buffer.h>
+#include <isc/hashmap.h>
+#include <isc/list.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/keycache.h>
+#include <dns/keyvalues.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+#include <dns/types.h>
+
+#include <dst/dst.h>
+
+typedef struct dns_kcentry dns_kcentry_t;
+
+struct dns_kcentry {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	isc_stdtime_t expire;
+	dst_key_t **keys;
+	unsigned int nkeys;
+	unsigned int size;
+	ISC_LINK(dns_kcentry_t) link;
+};
+
+struct dns_keycache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_mutex_t lock;
+
+	/* Locked by 'lock'. */
+	isc_hashmap_t *hashmap;
+	ISC_LIST(dns_kcentry_t) lru;
+	unsigned int count;
+	unsigned int size;
+};
+
+#define KEYCACHE_MAGIC	  ISC_MAGIC('K', 'y', 'C', 'a')
+#define VALID_KEYCACHE(m) ISC_MAGIC_VALID(m, KEYCACHE_MAGIC)
+
+#define KEYCACHE_HASHBITS 8
+
+static bool
+kcentry_match(void *node, const void *key) {
+	dns_kcentry_t *entry = node;
+
+	return (dns_name_equal(entry->name, key));
+}
+
+static void
+kcentry_free(isc_mem_t *mctx, dns_kcentry_t *entry) {
+	for (unsigned int i = 0; i < entry->nkeys; i++) {
+		dst_key_free(&entry->keys[i]);
+	}
+	if (entry->keys != NULL) {
+		isc_mem_cput(mctx, entry->keys, entry->size,
+			     sizeof(entry->keys[0]));
+	}
+	isc_mem_put(mctx, entry, sizeof(*entry));
+}
+
+static void
+kcentry_destroy(dns_keycache_t *kc, dns_kcentry_t *entry) {
+	isc_result_t result;
+
+	result = isc_hashmap_delete(kc->hashmap, dns_name_hash(entry->name),
+				    kcentry_match, entry->name);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_UNLINK(kc->lru, entry, link);
+	INSIST(kc->count > 0);
+	kc->count--;
+
+	kcentry_free(kc->mctx, entry);
+}
+
+dns_keycache_t *
+dns_keycache_new(isc_mem_t *mctx, unsigned int size) {
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+
+	dns_keycache_t *kc = isc_mem_get(mctx, sizeof(*kc));
+	*kc = (dns_keycache_t){
+		.magic = KEYCACHE_MAGIC,
+		.size = size,
+		.lru = ISC_LIST_INITIALIZER,
+	};
+
+	isc_mem_attach(mctx, &kc->mctx);
+	isc_mutex_init(&kc->lock);
+	isc_hashmap_create(kc->mctx, KEYCACHE_HASHBITS, &kc->hashmap);
+
+	return (kc);
+}
+
+void
+dns_keycache_destroy(dns_keycache_t **kcp) {
+	dns_keycache_t *kc = NULL;
+
+	REQUIRE(kcp != NULL && VALID_KEYCACHE(*kcp));
+
+	kc = *kcp;
+	*kcp = NULL;
+
+	dns_keycache_flush(kc);
+
+	kc->magic = 0;
+	isc_hashmap_destroy(&kc->hashmap);
+	isc_mutex_destroy(&kc->lock);
+	isc_mem_putanddetach(&kc->mctx, kc, sizeof(*kc));
+}
+
+void
+dns_keycache_add(dns_keycache_t *kc, const dns_name_t *name,
+		 dns_rdataset_t *keyset, isc_stdtime_t expire) {
+	isc_result_t result;
+	dns_kcentry_t *entry = NULL, *old = NULL;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	uint32_t hashval;
+
+	REQUIRE(VALID_KEYCACHE(kc));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(DNS_RDATASET_VALID(keyset));
+	REQUIRE(keyset->type == dns_rdatatype_dnskey);
+
+	/*
+	 * Convert the keys before taking the lock.
+	 */
+	entry = isc_mem_get(kc->mctx, sizeof(*entry));
+	*entry = (dns_kcentry_t){
+		.expire = expire,
+		.size = dns_rdataset_count(keyset),
+		.link = ISC_LINK_INITIALIZER,
+	};
+	entry->name = dns_fixedname_initname(&entry->fname);
+	dns_name_copy(name, entry->name);
+	if (entry->size > 0) {
+		entry->keys = isc_mem_cget(kc->mctx, entry->size,
+					   sizeof(entry->keys[0]));
+	}
+
+	dns_rdataset_clone(keyset, &rdataset);
+	for (result = dns_rdataset_first(&rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(&rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dst_key_t *key = NULL;
+		isc_buffer_t b;
+
+		dns_rdataset_current(&rdataset, &rdata);
+		isc_buffer_init(&b, rdata.data, rdata.length);
+		isc_buffer_add(&b, rdata.length);
+		if (dst_key_fromdns(name, rdata.rdclass, &b, kc->mctx, &key) !=
+		    ISC_R_SUCCESS)
+		{
+			continue;
+		}
+		if (!dst_key_iszonekey(key) ||
+		    (dst_key_flags(key) & DNS_KEYFLAG_REVOKE) != 0 ||
+		    entry->nkeys == entry->size)
+		{
+			dst_key_free(&key);
+			continue;
+		}
+		entry->keys[entry->nkeys++] = key;
+	}
+	dns_rdataset_disassociate(&rdataset);
+
+	hashval = dns_name_hash(name);
+
+	LOCK(&kc->lock);
+	result = isc_hashmap_find(kc->hashmap, hashval, kcentry_match, name,
+				  (void **)&old);
+	if (result == ISC_R_SUCCESS) {
+		kcentry_destroy(kc, old);
+	} else if (kc->count >= kc->size) {
+		kcentry_destroy(kc, ISC_LIST_TAIL(kc->lru));
+	}
+
+	result = isc_hashmap_add(kc->hashmap, hashval, kcentry_match,
+				 entry->name, entry, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_PREPEND(kc->lru, entry, link);
+	kc->count++;
+	UNLOCK(&kc->lock);
+}
+
+isc_result_t
+dns_keycache_find(dns_keycache_t *kc, const dns_name_t *name,
+		  dns_secalg_t alg, dns_keytag_t id, unsigned int n,
+		  isc_stdtime_t now, dst_key_t **keyp) {
+	isc_result_t result;
+	dns_kcentry_t *entry = NULL;
+
+	REQUIRE(VALID_KEYCACHE(kc));
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(keyp != NULL && *keyp == NULL);
+
+	LOCK(&kc->lock);
+	result = isc_hashmap_find(kc->hashmap, dns_name_hash(name),
+				  kcentry_match, name, (void **)&entry);
+	if (result != ISC_R_SUCCESS) {
+		result = ISC_R_NOTFOUND;
+		goto unlock;
+	}
+
+	if (entry->expire <= now) {
+		kcentry_destroy(kc, entry);
+		result = ISC_R_NOTFOUND;
+		goto unlock;
+	}
+
+	if (entry != ISC_LIST_HEAD(kc->lru)) {
+		ISC_LIST_UNLINK(kc->lru, entry, link);
+		ISC_LIST_PREPEND(kc->lru, entry, link);
+	}
+
+	result = ISC_R_NOMORE;
+	for (unsigned int i = 0; i < entry->nkeys; i++) {
+		dst_key_t *key = entry->keys[i];
+
+		if (dst_key_alg(key) != alg || dst_key_id(key) != id) {
+			continue;
+		}
+		if (n-- == 0) {
+			dst_key_attach(key, keyp);
+			result = ISC_R_SUCCESS;
+			break;
+		}
+	}
+
+unlock:
+	UNLOCK(&kc->lock);
+
+	return (result);
+}
+
+void
+dns_keycache_flush(dns_keycache_t *kc) {
+	REQUIRE(VALID_KEYCACHE(kc));
+
+	LOCK(&kc->lock);
+	while (!ISC_LIST_EMPTY(kc->lru)) {
+		kcentry_destroy(kc, ISC_LIST_HEAD(kc->lru));
+	}
+	UNLOCK(&kc->lock);
+}
+
+void
+dns_keycache_flushname(dns_keycache_t *kc, const dns_name_t *name) {
+	isc_result_t result;
+	dns_kcentry_t *entry = NULL;
+
+	REQUIRE(VALID_KEYCACHE(kc));
+	REQUIRE(dns_name_isabsolute(name));
+
+	LOCK(&kc->lock);
+	result = isc_hashmap_find(kc->hashmap, dns_name_hash(name),
+				  kcentry_match, name, (void **)&entry);
+	if (result == ISC_R_SUCCESS) {
+		kcentry_destroy(kc, entry);
+	}
+	UNLOCK(&kc->lock);
+}
+
+void
+dns_keycache_flushtree(dns_keycache_t *kc, const dns_name_t *name) {
+	dns_kcentry_t *entry = NULL, *next = NULL;
+
+	REQUIRE(VALID_KEYCACHE(kc));
+	REQUIRE(dns_name_isabsolute(name));
+
+	LOCK(&kc->lock);
+	for (entry = ISC_LIST_HEAD(kc->lru); entry != NULL; entry = next) {
+		next = ISC_LIST_NEXT(entry, link);
+		if (dns_name_issubdomain(entry->name, name)) {
+			kcentry_destroy(kc, entry);
+		}
+	}
+	UNLOCK(&kc->lock);
+}
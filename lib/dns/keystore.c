@@ -13,10 +13,14 @@
 
 /*! \file */
 
+#include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 
 #include <isc/assertions.h>
 #include <isc/buffer.h>
+#include <isc/dir.h>
+#include <isc/file.h>
 #include <isc/mem.h>
 #include <isc/time.h>
 #include <isc/util.h>
@@ -25,6 +29,201 @@
 #include <dns/keystore.h>
 #include <dns/keyvalues.h>
 
+/*
+ * The private key files found in one directory, sorted by name without
+ * regard to case.
+ */
+typedef struct dns_keyfileindex {
+	char *directory;
+	isc_time_t modtime; /* of the directory when it was read */
+	isc_time_t readtime;
+	bool valid;
+	char **files;
+	size_t count;
+	size_t size;
+	ISC_LINK(struct dns_keyfileindex) link;
+} keyfileindex_t;
+
+#define PRIVATE_SUFFIX ".private"
+
+static void
+keyfileindex_clear(isc_mem_t *mctx, keyfileindex_t *kfi) {
+	for (size_t i = 0; i < kfi->count; i++) {
+		isc_mem_free(mctx, kfi->files[i]);
+	}
+	if (kfi->files != NULL) {
+		isc_mem_cput(mctx, kfi->files, kfi->size,
+			     sizeof(kfi->files[0]));
+	}
+	kfi->files = NULL;
+	kfi->count = kfi->size = 0;
+	kfi->valid = false;
+}
+
+static int
+keyfile_compare(const void *a, const void *b) {
+	return (strcasecmp(*(char *const *)a, *(char *const *)b));
+}
+
+static isc_result_t
+keyfileindex_read(isc_mem_t *mctx, keyfileindex_t *kfi,
+		  const isc_time_t *modtime) {
+	isc_result_t result;
+	isc_dir_t dir;
+	size_t suffixlen = strlen(PRIVATE_SUFFIX);
+
+	keyfileindex_clear(mctx, kfi);
+
+	kfi->readtime = isc_time_now();
+	kfi->modtime = *modtime;
+
+	isc_dir_init(&dir);
+	result = isc_dir_open(&dir, kfi->directory);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	while (isc_dir_read(&dir) == ISC_R_SUCCESS) {
+		if (dir.entry.name[0] != 'K' || dir.entry.length <= suffixlen ||
+		    strcmp(dir.entry.name + dir.entry.length - suffixlen,
+			   PRIVATE_SUFFIX) != 0)
+		{
+			continue;
+		}
+		if (kfi->count == kfi->size) {
+			size_t size = ISC_MAX(16, kfi->size * 2);
+			kfi->files = isc_mem_creget(mctx, kfi->files,
+						    kfi->size, size,
+						    sizeof(kfi->files[0]));
+			kfi->size = size;
+		}
+		kfi->files[kfi->count++] = isc_mem_strdup(mctx, dir.entry.name);
+	}
+	isc_dir_close(&dir);
+
+	if (kfi->count > 1) {
+		qsort(kfi->files, kfi->count, sizeof(kfi->files[0]),
+		      keyfile_compare);
+	}
+	kfi->valid = true;
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * The listing can be used while the directory has not been modified
+ * since it was read.  Modification times may be as coarse as a second,
+ * so a listing read within a second of the last modification is not
+ * trusted: a file added just after it was read may not have changed
+ * the modification time.
+ */
+static bool
+keyfileindex_current(keyfileindex_t *kfi, const isc_time_t *modtime) {
+	return (isc_time_compare(&kfi->modtime, modtime) == 0 &&
+		isc_time_seconds(modtime) + 1 <
+			isc_time_seconds(&kfi->readtime));
+}
+
+isc_result_t
+dns_keystore_keyfiles(dns_keystore_t *keystore, const char *directory,
+		      const char *prefix, isc_mem_t *mctx, char ***filesp,
+		      size_t *countp) {
+	isc_result_t result;
+	keyfileindex_t *kfi = NULL;
+	isc_time_t modtime;
+	size_t prefixlen, lo, hi, count = 0;
+	char **files = NULL;
+
+	REQUIRE(DNS_KEYSTORE_VALID(keystore));
+	REQUIRE(prefix != NULL);
+	REQUIRE(mctx != NULL);
+	REQUIRE(filesp != NULL && *filesp == NULL);
+	REQUIRE(countp != NULL);
+
+	if (directory == NULL) {
+		directory = ".";
+	}
+
+	result = isc_file_getmodtime(directory, &modtime);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	LOCK(&keystore->lock);
+	for (kfi = ISC_LIST_HEAD(keystore->keyfiles); kfi != NULL;
+	     kfi = ISC_LIST_NEXT(kfi, link))
+	{
+		if (strcmp(kfi->directory, directory) == 0) {
+			break;
+		}
+	}
+	if (kfi == NULL) {
+		kfi = isc_mem_get(keystore->mctx, sizeof(*kfi));
+		*kfi = (keyfileindex_t){
+			.directory = isc_mem_strdup(keystore->mctx, directory),
+			.link = ISC_LINK_INITIALIZER,
+		};
+		ISC_LIST_APPEND(keystore->keyfiles, kfi, link);
+	}
+	if (!kfi->valid || !keyfileindex_current(kfi, &modtime)) {
+		result = keyfileindex_read(keystore->mctx, kfi, &modtime);
+		if (result != ISC_R_SUCCESS) {
+			keyfileindex_clear(keystore->mctx, kfi);
+			goto unlock;
+		}
+	}
+
+	/* Find the first file not sorting before 'prefix' */
+	prefixlen = strlen(prefix);
+	lo = 0;
+	hi = kfi->count;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (strncasecmp(kfi->files[mid], prefix, prefixlen) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+	while (hi < kfi->count &&
+	       strncasecmp(kfi->files[hi], prefix, prefixlen) == 0)
+	{
+		hi++;
+	}
+
+	count = hi - lo;
+	if (count > 0) {
+		files = isc_mem_cget(mctx, count, sizeof(files[0]));
+		for (size_t i = 0; i < count; i++) {
+			files[i] = isc_mem_strdup(mctx, kfi->files[lo + i]);
+		}
+	}
+
+unlock:
+	UNLOCK(&keystore->lock);
+
+	*filesp = files;
+	*countp = count;
+	return (result);
+}
+
+void
+dns_keystore_freekeyfiles(isc_mem_t *mctx, char ***filesp, size_t count) {
+	char **files = NULL;
+
+	REQUIRE(filesp != NULL);
+
+	files = *filesp;
+	*filesp = NULL;
+	if (files == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < count; i++) {
+		isc_mem_free(mctx, files[i]);
+	}
+	isc_mem_cput(mctx, files, count, sizeof(files[0]));
+}
+
 isc_result_t
 dns_keystore_create(isc_mem_t *mctx, const char *name, const char *engine,
 		    dns_keystore_t **kspp) {
@@ -40,6 +239,7 @@ dns_keystore_create(isc_mem_t *mctx, const char *name, const char *engine,
 
 	keystore->name = isc_mem_strdup(mctx, name);
 	isc_mutex_init(&keystore->lock);
+	ISC_LIST_INIT(keystore->keyfiles);
 
 	isc_refcount_init(&keystore->references, 1);
 
@@ -60,6 +260,13 @@ dns__keystore_destroy(dns_keystore_t *keystore) {
 
 	REQUIRE(!ISC_LINK_LINKED(keystore, link));
 
+	while (!ISC_LIST_EMPTY(keystore->keyfiles)) {
+		keyfileindex_t *kfi = ISC_LIST_HEAD(keystore->keyfiles);
+		ISC_LIST_UNLINK(keystore->keyfiles, kfi, link);
+		keyfileindex_clear(keystore->mctx, kfi);
+		isc_mem_free(keystore->mctx, kfi->directory);
+		isc_mem_put(keystore->mctx, kfi, sizeof(*kfi));
+	}
 	isc_mutex_destroy(&keystore->lock);
 	name = UNCONST(keystore->name);
 	isc_mem_free(keystore->mctx, name);
@@ -13,24 +13,35 @@
 
 /*! \file */
 
+#include <errno.h>
+#include <fcntl.h>
 #include <inttypes.h>
+#include <limits.h>
 #include <stdbool.h>
+#include <unistd.h>
 
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/condition.h>
 #include <isc/lex.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/serial.h>
 #include <isc/stdio.h>
 #include <isc/stdtime.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <dns/callbacks.h>
 #include <dns/fixedname.h>
 #include <dns/master.h>
@@ -87,6 +98,17 @@
 #define DNS_MASTER_LHS 2048
 #define DNS_MASTER_RHS MINTSIZ
 
+/*%
+ * Text files of at least PARALLEL_MINSIZE bytes are split into chunks
+ * of about PARALLEL_CHUNK bytes which are parsed by up to
+ * PARALLEL_MAXWORKERS threads; see load_parallel().
+ */
+#define PARALLEL_CHUNK	    (32 * 1024 * 1024)
+#define PARALLEL_MINSIZE    (4 * PARALLEL_CHUNK)
+#define PARALLEL_MAXWORKERS 16
+#define PARALLEL_OUTSIZE    (1024 * 1024)
+#define PARALLEL_SCANSIZE   (64 * 1024)
+
 #define CHECKNAMESFAIL(x) (((x) & DNS_MASTER_CHECKNAMESFAIL) != 0)
 
 typedef ISC_LIST(dns_rdatalist_t) rdatalist_head_t;
@@ -127,12 +149,17 @@ struct dns_loadctx {
 	uint32_t default_ttl;
 	dns_rdataclass_t zclass;
 	dns_fixedname_t fixed_top;
-	dns_name_t *top; /*%< top of zone */
+	dns_name_t *top;   /*%< top of zone */
+	char *master_file; /*%< set if the file may be split up */
+	uint64_t filesize;
 
 	/* Members specific to the raw format: */
 	FILE *f;
 	bool first;
 	dns_masterrawheader_t header;
+	unsigned char *map; /*%< read-only mapping of 'f', if any */
+	size_t maplen;
+	isc_buffer_t mapbuf; /*%< unread part of 'map' */
 
 	/* Which fixed buffers we are using? */
 	isc_result_t result;
@@ -177,6 +204,9 @@ openfile_text(dns_loadctx_t *lctx, const char *master_file);
 static isc_result_t
 load_text(dns_loadctx_t *lctx);
 
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx);
+
 static isc_result_t
 openfile_raw(dns_loadctx_t *lctx, const char *master_file);
 
@@ -432,6 +462,10 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 		incctx_destroy(lctx->mctx, lctx->inc);
 	}
 
+	if (lctx->map != NULL) {
+		RUNTIME_CHECK(munmap(lctx->map, lctx->maplen) == 0);
+	}
+
 	if (lctx->f != NULL) {
 		isc_result_t result = isc_stdio_close(lctx->f);
 		if (result != ISC_R_SUCCESS) {
@@ -445,6 +479,10 @@ loadctx_destroy(dns_loadctx_t *lctx) {
 		isc_lex_destroy(&lctx->lex);
 	}
 
+	if (lctx->master_file != NULL) {
+		isc_mem_free(lctx->mctx, lctx->master_file);
+	}
+
 	isc_mem_putanddetach(&lctx->mctx, lctx, sizeof(*lctx));
 }
 
@@ -986,7 +1024,28 @@ check_wildcard(dns_incctx_t *ictx, const char *source, unsigned long line,
 
 static isc_result_t
 openfile_text(dns_loadctx_t *lctx, const char *master_file) {
-	return (isc_lex_openfile(lctx->lex, master_file));
+	isc_result_t result;
+	struct stat sb;
+
+	result = isc_lex_openfile(lctx->lex, master_file);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	/*
+	 * Large top level files may be parsed by several threads.
+	 * Included files are always read by the including load.
+	 */
+	if (!lctx->seen_include && isc_os_ncpus() > 1 &&
+	    stat(master_file, &sb) == 0 && S_ISREG(sb.st_mode) &&
+	    sb.st_size >= PARALLEL_MINSIZE)
+	{
+		lctx->master_file = isc_mem_strdup(lctx->mctx, master_file);
+		lctx->filesize = (uint64_t)sb.st_size;
+		lctx->load = load_parallel;
+	}
+
+	return (ISC_R_SUCCESS);
 }
 
 static int
@@ -2161,6 +2220,571 @@ cleanup:
 	return (result);
 }
 
+/*
+ * Parallel loading of large text files.
+ *
+ * The file is first scanned for lines that start a new owner name
+ * outside of parentheses, roughly every PARALLEL_CHUNK bytes, while
+ * tracking $ORIGIN and $TTL so that every chunk can be parsed on its
+ * own.  Worker threads then run load_text() over the chunks, storing
+ * the resulting rdatasets in a per-chunk buffer, and the loading thread
+ * adds them to the database in file order.  Only a window of chunks is
+ * parsed ahead of the one being added, to bound the memory used.
+ *
+ * Files using $INCLUDE, $GENERATE or $DATE, or that rely on the SOA
+ * MINIMUM or RFC 1035 TTL semantics instead of $TTL, are loaded by
+ * load_text() alone.
+ */
+
+typedef struct loadchunk {
+	uint64_t start;
+	uint64_t end;
+	unsigned long line;
+	dns_fixedname_t origin;
+	uint32_t ttl;
+	bool ttl_known;
+	isc_buffer_t *out;
+	isc_result_t result;
+	bool done;
+} loadchunk_t;
+
+typedef struct loadparallel {
+	dns_loadctx_t *lctx;
+	loadchunk_t *chunks;
+	size_t nchunks;
+	size_t maxchunks;
+	int fd;
+	isc_mutex_t lock;
+	isc_condition_t cond;
+	size_t next;   /*%< next chunk to parse */
+	size_t merged; /*%< chunks added to the database */
+	size_t window;
+	bool abort;
+} loadparallel_t;
+
+static void
+chunk_begin(loadparallel_t *lp, uint64_t start, unsigned long line,
+	    const dns_name_t *origin, uint32_t ttl, bool ttl_known) {
+	loadchunk_t *chunk = NULL;
+
+	INSIST(lp->nchunks < lp->maxchunks);
+
+	if (lp->nchunks > 0) {
+		lp->chunks[lp->nchunks - 1].end = start;
+	}
+
+	chunk = &lp->chunks[lp->nchunks++];
+	*chunk = (loadchunk_t){
+		.start = start,
+		.line = line,
+		.ttl = ttl,
+		.ttl_known = ttl_known,
+		.result = ISC_R_SUCCESS,
+	};
+	dns_name_copy(origin, dns_fixedname_initname(&chunk->origin));
+}
+
+/*
+ * Apply a $ORIGIN or $TTL directive found while splitting the file.
+ * Anything else prevents the file from being split.
+ */
+static isc_result_t
+split_directive(char *text, dns_name_t *origin, uint32_t *ttlp,
+		bool *ttl_knownp) {
+	char *directive = NULL, *arg = NULL, *last = NULL, *comment = NULL;
+	isc_result_t result;
+
+	comment = strchr(text, ';');
+	if (comment != NULL) {
+		*comment = '\0';
+	}
+
+	directive = strtok_r(text, " \t\r", &last);
+	arg = strtok_r(NULL, " \t\r", &last);
+	if (directive == NULL || arg == NULL ||
+	    strtok_r(NULL, " \t\r", &last) != NULL)
+	{
+		return (ISC_R_NOTFOUND);
+	}
+
+	if (strcasecmp(directive, "$ORIGIN") == 0) {
+		dns_fixedname_t fixed;
+		dns_name_t *name = dns_fixedname_initname(&fixed);
+		isc_buffer_t b;
+
+		isc_buffer_constinit(&b, arg, strlen(arg));
+		isc_buffer_add(&b, strlen(arg));
+		result = dns_name_fromtext(name, &b, origin, 0, NULL);
+		if (result == ISC_R_SUCCESS) {
+			dns_name_copy(name, origin);
+		}
+		return (result);
+	} else if (strcasecmp(directive, "$TTL") == 0) {
+		isc_textregion_t r = { .base = arg, .length = strlen(arg) };
+		uint32_t ttl;
+
+		result = dns_ttl_fromtext(&r, &ttl);
+		if (result == ISC_R_SUCCESS) {
+			/* See limit_ttl() */
+			*ttlp = (ttl > 0x7fffffffUL) ? 0 : ttl;
+			*ttl_knownp = true;
+		}
+		return (result);
+	}
+
+	return (ISC_R_NOTFOUND);
+}
+
+/*
+ * Find the chunk boundaries.  Returns ISC_R_NOTFOUND if the file can't
+ * be split.
+ */
+static isc_result_t
+split_file(loadparallel_t *lp) {
+	dns_loadctx_t *lctx = lp->lctx;
+	isc_result_t result;
+	FILE *f = NULL;
+	unsigned char *buf = NULL;
+	char text[1024];
+	size_t len, textlen = 0;
+	dns_fixedname_t fixed;
+	dns_name_t *origin = dns_fixedname_initname(&fixed);
+	uint32_t ttl = lctx->default_ttl;
+	bool ttl_known = lctx->default_ttl_known;
+	bool bol = true, directive = false, escape = false, quote = false;
+	bool comment = false;
+	unsigned int depth = 0;
+	unsigned long line = 1;
+	uint64_t pos = 0;
+
+	result = isc_stdio_open(lctx->master_file, "rb", &f);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	dns_name_copy(lctx->inc->origin, origin);
+	lp->maxchunks = lctx->filesize / PARALLEL_CHUNK + 2;
+	lp->chunks = isc_mem_cget(lctx->mctx, lp->maxchunks,
+				  sizeof(lp->chunks[0]));
+	chunk_begin(lp, 0, line, origin, ttl, ttl_known);
+
+	buf = isc_mem_get(lctx->mctx, PARALLEL_SCANSIZE);
+	while ((len = fread(buf, 1, PARALLEL_SCANSIZE, f)) > 0) {
+		for (size_t i = 0; i < len; i++, pos++) {
+			unsigned char c = buf[i];
+
+			if (bol && depth == 0) {
+				if (c == '$') {
+					directive = true;
+					textlen = 0;
+				} else if (ttl_known &&
+					   pos >= lp->chunks[lp->nchunks - 1]
+								  .start +
+							  PARALLEL_CHUNK &&
+					   strchr(" \t\r\n;\"()", c) == NULL)
+				{
+					chunk_begin(lp, pos, line, origin, ttl,
+						    ttl_known);
+				}
+			}
+			bol = false;
+
+			if (directive && c != '\n') {
+				if (textlen == sizeof(text) - 1) {
+					result = ISC_R_NOSPACE;
+					goto cleanup;
+				}
+				text[textlen++] = c;
+			}
+
+			if (escape) {
+				escape = false;
+			} else if (comment) {
+				comment = (c != '\n');
+			} else if (quote) {
+				if (c == '\\') {
+					escape = true;
+				} else if (c == '"') {
+					quote = false;
+				}
+			} else if (c == '\\') {
+				escape = true;
+			} else if (c == '"') {
+				quote = true;
+			} else if (c == ';') {
+				comment = true;
+			} else if (c == '(') {
+				depth++;
+			} else if (c == ')' && depth > 0) {
+				depth--;
+			}
+
+			if (c == '\n') {
+				line++;
+				bol = true;
+				quote = false;
+				if (directive && depth == 0) {
+					directive = false;
+					text[textlen] = '\0';
+					result = split_directive(text, origin,
+								 &ttl,
+								 &ttl_known);
+					if (result != ISC_R_SUCCESS) {
+						goto cleanup;
+					}
+				}
+			}
+		}
+	}
+	if (ferror(f)) {
+		result = ISC_R_IOERROR;
+		goto cleanup;
+	}
+	lp->chunks[lp->nchunks - 1].end = pos;
+
+	result = ISC_R_SUCCESS;
+	for (size_t i = 0; i < lp->nchunks; i++) {
+		if (lp->chunks[i].end - lp->chunks[i].start >= UINT_MAX) {
+			result = ISC_R_NOTFOUND;
+		}
+	}
+	if (lp->nchunks < 2) {
+		result = ISC_R_NOTFOUND;
+	}
+
+cleanup:
+	isc_mem_put(lctx->mctx, buf, PARALLEL_SCANSIZE);
+	(void)isc_stdio_close(f);
+	if (result != ISC_R_SUCCESS) {
+		isc_mem_cput(lctx->mctx, lp->chunks, lp->maxchunks,
+			     sizeof(lp->chunks[0]));
+		lp->chunks = NULL;
+	}
+	return (result);
+}
+
+/*
+ * 'add' callback for the loads of the chunks: append the rdataset to
+ * the chunk's output buffer.
+ */
+static isc_result_t
+chunk_add(void *arg, const dns_name_t *owner,
+	  dns_rdataset_t *rdataset DNS__DB_FLARG) {
+	loadchunk_t *chunk = arg;
+	isc_buffer_t *out = chunk->out;
+	isc_region_t r;
+	isc_result_t result;
+
+	dns_name_toregion(owner, &r);
+	isc_buffer_putuint8(out, r.length);
+	isc_buffer_putmem(out, r.base, r.length);
+	isc_buffer_putuint16(out, rdataset->type);
+	isc_buffer_putuint16(out, rdataset->covers);
+	isc_buffer_putuint16(out, rdataset->rdclass);
+	isc_buffer_putuint32(out, rdataset->ttl);
+	isc_buffer_putuint8(
+		out, (rdataset->attributes & DNS_RDATASETATTR_RESIGN) != 0);
+	isc_buffer_putuint32(out, rdataset->resign);
+	isc_buffer_putuint32(out, dns_rdataset_count(rdataset));
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(rdataset, &rdata);
+		isc_buffer_putuint16(out, rdata.length);
+		isc_buffer_putmem(out, rdata.data, rdata.length);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static isc_result_t
+chunk_load(loadparallel_t *lp, loadchunk_t *chunk) {
+	dns_loadctx_t *lctx = lp->lctx;
+	dns_loadctx_t *cctx = NULL;
+	dns_rdatacallbacks_t callbacks;
+	size_t len = chunk->end - chunk->start, done = 0;
+	unsigned char *data = NULL;
+	isc_buffer_t source;
+	isc_result_t result;
+
+	data = isc_mem_get(lctx->mctx, len);
+	while (done < len) {
+		ssize_t n = pread(lp->fd, data + done, len - done,
+				  (off_t)(chunk->start + done));
+		if (n < 0 && errno == EINTR) {
+			continue;
+		} else if (n <= 0) {
+			result = ISC_R_IOERROR;
+			goto cleanup;
+		}
+		done += n;
+	}
+
+	dns_rdatacallbacks_init(&callbacks);
+	callbacks.add = chunk_add;
+	callbacks.add_private = chunk;
+	callbacks.error = lctx->callbacks->error;
+	callbacks.warn = lctx->callbacks->warn;
+	callbacks.error_private = lctx->callbacks->error_private;
+	callbacks.warn_private = lctx->callbacks->warn_private;
+	callbacks.zone = lctx->callbacks->zone;
+
+	isc_buffer_allocate(lctx->mctx, &chunk->out, PARALLEL_OUTSIZE);
+
+	loadctx_create(dns_masterformat_text, lctx->mctx, lctx->options,
+		       lctx->resign, lctx->top, lctx->zclass,
+		       dns_fixedname_name(&chunk->origin), &callbacks, NULL,
+		       NULL, NULL, NULL, NULL, &cctx);
+	cctx->maxttl = lctx->maxttl;
+	cctx->ttl = cctx->default_ttl = chunk->ttl;
+	cctx->ttl_known = cctx->default_ttl_known = chunk->ttl_known;
+
+	isc_buffer_init(&source, data, (unsigned int)len);
+	isc_buffer_add(&source, (unsigned int)len);
+	result = isc_lex_openbuffer(cctx->lex, &source);
+	if (result == ISC_R_SUCCESS) {
+		(void)isc_lex_setsourcename(cctx->lex, lctx->master_file);
+		(void)isc_lex_setsourceline(cctx->lex, chunk->line);
+		result = (cctx->load)(cctx);
+	}
+	dns_loadctx_detach(&cctx);
+
+cleanup:
+	isc_mem_put(lctx->mctx, data, len);
+	return (result);
+}
+
+static void *
+chunk_worker(void *arg) {
+	loadparallel_t *lp = arg;
+
+	LOCK(&lp->lock);
+	while (true) {
+		loadchunk_t *chunk = NULL;
+		isc_result_t result;
+
+		while (!lp->abort && lp->next < lp->nchunks &&
+		       lp->next >= lp->merged + lp->window)
+		{
+			WAIT(&lp->cond, &lp->lock);
+		}
+		if (lp->abort || lp->next == lp->nchunks) {
+			break;
+		}
+		chunk = &lp->chunks[lp->next++];
+		UNLOCK(&lp->lock);
+
+		result = chunk_load(lp, chunk);
+
+		LOCK(&lp->lock);
+		chunk->result = result;
+		chunk->done = true;
+		BROADCAST(&lp->cond);
+	}
+	UNLOCK(&lp->lock);
+
+	return (NULL);
+}
+
+/*
+ * Add the rdatasets parsed from 'chunk' to the database.
+ */
+static isc_result_t
+chunk_commit(loadparallel_t *lp, loadchunk_t *chunk, dns_rdata_t **rdatap,
+	     size_t *rdata_sizep) {
+	dns_loadctx_t *lctx = lp->lctx;
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	isc_buffer_t *out = chunk->out;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	while (isc_buffer_remaininglength(out) > 0) {
+		dns_fixedname_t fixed;
+		dns_name_t *owner = dns_fixedname_initname(&fixed);
+		dns_rdatalist_t rdatalist;
+		dns_rdataset_t dataset;
+		isc_region_t r;
+		bool resign;
+		uint32_t resign_time, count;
+
+		r.length = isc_buffer_getuint8(out);
+		r.base = isc_buffer_current(out);
+		isc_buffer_forward(out, r.length);
+		dns_name_fromregion(owner, &r);
+
+		dns_rdatalist_init(&rdatalist);
+		rdatalist.type = isc_buffer_getuint16(out);
+		rdatalist.covers = isc_buffer_getuint16(out);
+		rdatalist.rdclass = isc_buffer_getuint16(out);
+		rdatalist.ttl = isc_buffer_getuint32(out);
+		resign = (isc_buffer_getuint8(out) != 0);
+
+		resign_time = isc_buffer_getuint32(out);
+
+		count = isc_buffer_getuint32(out);
+		if (count > *rdata_sizep) {
+			if (*rdatap != NULL) {
+				isc_mem_cput(lctx->mctx, *rdatap, *rdata_sizep,
+					     sizeof(dns_rdata_t));
+			}
+			*rdata_sizep = ISC_MAX(count, 2 * *rdata_sizep);
+			*rdatap = isc_mem_cget(lctx->mctx, *rdata_sizep,
+					       sizeof(dns_rdata_t));
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			dns_rdata_t *rdata = &(*rdatap)[i];
+
+			r.length = isc_buffer_getuint16(out);
+			r.base = isc_buffer_current(out);
+			isc_buffer_forward(out, r.length);
+			dns_rdata_init(rdata);
+			dns_rdata_fromregion(rdata, rdatalist.rdclass,
+					     rdatalist.type, &r);
+			ISC_LIST_APPEND(rdatalist.rdata, rdata, link);
+		}
+
+		dns_rdataset_init(&dataset);
+		dns_rdatalist_tordataset(&rdatalist, &dataset);
+		dataset.trust = dns_trust_ultimate;
+		if (resign) {
+			dataset.attributes |= DNS_RDATASETATTR_RESIGN;
+			dataset.resign = resign_time;
+		}
+		result = callbacks->add(callbacks->add_private, owner,
+					&dataset DNS__DB_FILELINE);
+		if (result != ISC_R_SUCCESS) {
+			char namebuf[DNS_NAME_FORMATSIZE];
+
+			dns_name_format(owner, namebuf, sizeof(namebuf));
+			(*callbacks->error)(callbacks, "%s: %s: %s: %s",
+					    "dns_master_load",
+					    lctx->master_file, namebuf,
+					    isc_result_totext(result));
+		}
+		if (MANYERRS(lctx, result)) {
+			SETRESULT(lctx, result);
+		} else if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	return (result);
+}
+
+static isc_result_t
+load_parallel(dns_loadctx_t *lctx) {
+	loadparallel_t lp = { .lctx = lctx, .fd = -1 };
+	dns_rdatacallbacks_t *callbacks = lctx->callbacks;
+	isc_thread_t *threads = NULL;
+	size_t nthreads;
+	dns_rdata_t *rdata = NULL;
+	size_t rdata_size = 0;
+	isc_result_t result;
+
+	REQUIRE(DNS_LCTX_VALID(lctx));
+
+	result = split_file(&lp);
+	if (result == ISC_R_SUCCESS) {
+		lp.fd = open(lctx->master_file, O_RDONLY);
+	}
+	if (lp.fd == -1) {
+		if (lp.chunks != NULL) {
+			isc_mem_cput(lctx->mctx, lp.chunks, lp.maxchunks,
+				     sizeof(lp.chunks[0]));
+		}
+		return (load_text(lctx));
+	}
+
+	nthreads = ISC_MIN(isc_os_ncpus(), PARALLEL_MAXWORKERS);
+	nthreads = ISC_MIN(nthreads, lp.nchunks);
+	lp.window = 2 * nthreads;
+	isc_mutex_init(&lp.lock);
+	isc_condition_init(&lp.cond);
+
+	threads = isc_mem_cget(lctx->mctx, nthreads, sizeof(threads[0]));
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_create(chunk_worker, &lp, &threads[i]);
+	}
+
+	/* open a database transaction */
+	if (callbacks->setup != NULL) {
+		callbacks->setup(callbacks->add_private);
+	}
+
+	for (size_t i = 0; i < lp.nchunks; i++) {
+		loadchunk_t *chunk = &lp.chunks[i];
+
+		LOCK(&lp.lock);
+		while (!chunk->done) {
+			WAIT(&lp.cond, &lp.lock);
+		}
+		UNLOCK(&lp.lock);
+
+		if (atomic_load_acquire(&lctx->canceled)) {
+			result = ISC_R_CANCELED;
+			break;
+		}
+
+		result = chunk->result;
+		if (chunk->out != NULL) {
+			isc_result_t tresult = chunk_commit(&lp, chunk, &rdata,
+							    &rdata_size);
+			if (tresult != ISC_R_SUCCESS &&
+			    !MANYERRS(lctx, tresult))
+			{
+				result = tresult;
+			}
+			isc_buffer_free(&chunk->out);
+		}
+		if (MANYERRS(lctx, result)) {
+			SETRESULT(lctx, result);
+		} else if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		LOCK(&lp.lock);
+		lp.merged = i + 1;
+		BROADCAST(&lp.cond);
+		UNLOCK(&lp.lock);
+	}
+
+	LOCK(&lp.lock);
+	lp.abort = true;
+	BROADCAST(&lp.cond);
+	UNLOCK(&lp.lock);
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	/* commit the database transaction */
+	if (callbacks->commit != NULL) {
+		callbacks->commit(callbacks->add_private);
+	}
+
+	if (result == ISC_R_SUCCESS && lctx->result != ISC_R_SUCCESS) {
+		result = lctx->result;
+	}
+
+	for (size_t i = 0; i < lp.nchunks; i++) {
+		if (lp.chunks[i].out != NULL) {
+			isc_buffer_free(&lp.chunks[i].out);
+		}
+	}
+	if (rdata != NULL) {
+		isc_mem_cput(lctx->mctx, rdata, rdata_size, sizeof(rdata[0]));
+	}
+	isc_mem_cput(lctx->mctx, threads, nthreads, sizeof(threads[0]));
+	isc_mem_cput(lctx->mctx, lp.chunks, lp.maxchunks,
+		     sizeof(lp.chunks[0]));
+	isc_condition_destroy(&lp.cond);
+	isc_mutex_destroy(&lp.lock);
+	(void)close(lp.fd);
+
+	return (result);
+}
+
 static isc_result_t
 pushfile(const char *master_file, dns_name_t *origin, dns_loadctx_t *lctx) {
 	isc_result_t result;
@@ -2240,6 +2864,26 @@ read_and_check(bool do_read, isc_buffer_t *buffer, size_t len, FILE *f,
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Read 'len' bytes of raw format data, from the mapped file if there
+ * is one.
+ */
+static isc_result_t
+read_raw(dns_loadctx_t *lctx, void *data, size_t len) {
+	if (lctx->map == NULL) {
+		return (isc_stdio_read(data, 1, len, lctx->f, NULL));
+	}
+
+	if (isc_buffer_remaininglength(&lctx->mapbuf) < len) {
+		isc_buffer_forward(&lctx->mapbuf,
+				   isc_buffer_remaininglength(&lctx->mapbuf));
+		return (ISC_R_EOF);
+	}
+	memmove(data, isc_buffer_current(&lctx->mapbuf), len);
+	isc_buffer_forward(&lctx->mapbuf, (unsigned int)len);
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 load_header(dns_loadctx_t *lctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -2262,7 +2906,7 @@ load_header(dns_loadctx_t *lctx) {
 	INSIST(commonlen <= sizeof(header));
 	isc_buffer_init(&target, data, sizeof(data));
 
-	result = isc_stdio_read(data, 1, commonlen, lctx->f, NULL);
+	result = read_raw(lctx, data, commonlen);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR("isc_stdio_read failed: %s",
 				 isc_result_totext(result));
@@ -2294,7 +2938,7 @@ load_header(dns_loadctx_t *lctx) {
 		return (ISC_R_NOTIMPLEMENTED);
 	}
 
-	result = isc_stdio_read(data + commonlen, 1, remainder, lctx->f, NULL);
+	result = read_raw(lctx, data + commonlen, remainder);
 	if (result != ISC_R_SUCCESS) {
 		UNEXPECTED_ERROR("isc_stdio_read failed: %s",
 				 isc_result_totext(result));
@@ -2318,14 +2962,46 @@ load_header(dns_loadctx_t *lctx) {
 static isc_result_t
 openfile_raw(dns_loadctx_t *lctx, const char *master_file) {
 	isc_result_t result;
+	struct stat sb;
+	void *map;
 
 	result = isc_stdio_open(master_file, "rb", &lctx->f);
-	if (result != ISC_R_SUCCESS && result != ISC_R_FILENOTFOUND) {
-		UNEXPECTED_ERROR("isc_stdio_open() failed: %s",
-				 isc_result_totext(result));
+	if (result != ISC_R_SUCCESS) {
+		if (result != ISC_R_FILENOTFOUND) {
+			UNEXPECTED_ERROR("isc_stdio_open() failed: %s",
+					 isc_result_totext(result));
+		}
+		return (result);
 	}
 
-	return (result);
+	/*
+	 * Map regular files so that the RRsets can be decoded straight
+	 * from the page cache, without copying them into a read buffer
+	 * first.  Raw files are replaced by renaming a new file over them,
+	 * so the mapped file is not truncated underneath us.  If the file
+	 * can't be mapped, fall back to reading it with stdio.
+	 */
+	if (fstat(fileno(lctx->f), &sb) != 0 || !S_ISREG(sb.st_mode) ||
+	    sb.st_size <= 0 || (uintmax_t)sb.st_size > UINT_MAX)
+	{
+		return (ISC_R_SUCCESS);
+	}
+
+	map = mmap(NULL, (size_t)sb.st_size, PROT_READ, MAP_PRIVATE,
+		   fileno(lctx->f), 0);
+	if (map == MAP_FAILED) {
+		return (ISC_R_SUCCESS);
+	}
+#ifdef MADV_SEQUENTIAL
+	(void)madvise(map, (size_t)sb.st_size, MADV_SEQUENTIAL);
+#endif /* ifdef MADV_SEQUENTIAL */
+
+	lctx->map = map;
+	lctx->maplen = (size_t)sb.st_size;
+	isc_buffer_constinit(&lctx->mapbuf, lctx->map, lctx->maplen);
+	isc_buffer_add(&lctx->mapbuf, (unsigned int)lctx->maplen);
+
+	return (ISC_R_SUCCESS);
 }
 
 static isc_result_t
@@ -2341,7 +3017,7 @@ load_raw(dns_loadctx_t *lctx) {
 	dns_rdata_t *rdata = NULL;
 	unsigned int rdata_size = 0;
 	int target_size = TSIZ;
-	isc_buffer_t target, buf;
+	isc_buffer_t target, buf, rrset;
 	unsigned char *target_mem = NULL;
 	dns_decompress_t dctx;
 
@@ -2386,12 +3062,12 @@ load_raw(dns_loadctx_t *lctx) {
 		uint32_t totallen;
 		size_t minlen, readlen;
 		bool sequential_read = false;
+		isc_buffer_t *source = &target;
 
 		/* Read the data length */
 		isc_buffer_clear(&target);
 		INSIST(isc_buffer_availablelength(&target) >= sizeof(totallen));
-		result = isc_stdio_read(target.base, 1, sizeof(totallen),
-					lctx->f, NULL);
+		result = read_raw(lctx, target.base, sizeof(totallen));
 		if (result == ISC_R_EOF) {
 			result = ISC_R_SUCCESS;
 			break;
@@ -2416,7 +3092,25 @@ load_raw(dns_loadctx_t *lctx) {
 		totallen -= sizeof(totallen);
 
 		isc_buffer_clear(&target);
-		if (totallen > isc_buffer_availablelength(&target)) {
+		if (lctx->map != NULL) {
+			/*
+			 * The whole RRset is in the mapped file: decode it
+			 * from there, into 'target'.
+			 */
+			if (totallen >
+			    isc_buffer_remaininglength(&lctx->mapbuf))
+			{
+				result = ISC_R_RANGE;
+				goto cleanup;
+			}
+			isc_buffer_init(&rrset,
+					isc_buffer_current(&lctx->mapbuf),
+					totallen);
+			isc_buffer_add(&rrset, totallen);
+			isc_buffer_forward(&lctx->mapbuf, totallen);
+			source = &rrset;
+			readlen = totallen;
+		} else if (totallen > isc_buffer_availablelength(&target)) {
 			/*
 			 * The default buffer size should typically be large
 			 * enough to store the entire RRset.  We could try to
@@ -2438,50 +3132,53 @@ load_raw(dns_loadctx_t *lctx) {
 			 */
 			readlen = totallen;
 		}
-		result = isc_stdio_read(target.base, 1, readlen, lctx->f, NULL);
-		if (result != ISC_R_SUCCESS) {
-			goto cleanup;
+		if (source == &target) {
+			result = isc_stdio_read(target.base, 1, readlen,
+						lctx->f, NULL);
+			if (result != ISC_R_SUCCESS) {
+				goto cleanup;
+			}
+			isc_buffer_add(&target, (unsigned int)readlen);
 		}
-		isc_buffer_add(&target, (unsigned int)readlen);
 		totallen -= (uint32_t)readlen;
 
 		/* Construct RRset headers */
 		dns_rdatalist_init(&rdatalist);
-		rdatalist.rdclass = isc_buffer_getuint16(&target);
+		rdatalist.rdclass = isc_buffer_getuint16(source);
 		if (lctx->zclass != rdatalist.rdclass) {
 			result = DNS_R_BADCLASS;
 			goto cleanup;
 		}
-		rdatalist.type = isc_buffer_getuint16(&target);
-		rdatalist.covers = isc_buffer_getuint16(&target);
-		rdatalist.ttl = isc_buffer_getuint32(&target);
-		rdcount = isc_buffer_getuint32(&target);
+		rdatalist.type = isc_buffer_getuint16(source);
+		rdatalist.covers = isc_buffer_getuint16(source);
+		rdatalist.ttl = isc_buffer_getuint32(source);
+		rdcount = isc_buffer_getuint32(source);
 		if (rdcount == 0 || rdcount > 0xffff) {
 			result = ISC_R_RANGE;
 			goto cleanup;
 		}
-		INSIST(isc_buffer_consumedlength(&target) <= readlen);
+		INSIST(isc_buffer_consumedlength(source) <= readlen);
 
 		/* Owner name: length followed by name */
-		result = read_and_check(sequential_read, &target,
+		result = read_and_check(sequential_read, source,
 					sizeof(namelen), lctx->f, &totallen);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
-		namelen = isc_buffer_getuint16(&target);
+		namelen = isc_buffer_getuint16(source);
 		if (namelen > sizeof(namebuf)) {
 			result = ISC_R_RANGE;
 			goto cleanup;
 		}
 
-		result = read_and_check(sequential_read, &target, namelen,
+		result = read_and_check(sequential_read, source, namelen,
 					lctx->f, &totallen);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
 
-		isc_buffer_setactive(&target, (unsigned int)namelen);
-		result = dns_name_fromwire(name, &target, dctx, NULL);
+		isc_buffer_setactive(source, (unsigned int)namelen);
+		result = dns_name_fromwire(name, source, dctx, NULL);
 		if (result != ISC_R_SUCCESS) {
 			goto cleanup;
 		}
@@ -2518,7 +3215,7 @@ load_raw(dns_loadctx_t *lctx) {
 
 			dns_rdata_init(&rdata[i]);
 
-			if (sequential_read &&
+			if ((sequential_read || source != &target) &&
 			    isc_buffer_availablelength(&target) < MINTSIZ)
 			{
 				unsigned int j;
@@ -2547,32 +3244,49 @@ load_raw(dns_loadctx_t *lctx) {
 			}
 
 			/* rdata length */
-			result = read_and_check(sequential_read, &target,
+			result = read_and_check(sequential_read, source,
 						sizeof(rdlen), lctx->f,
 						&totallen);
 			if (result != ISC_R_SUCCESS) {
 				goto cleanup;
 			}
-			rdlen = isc_buffer_getuint16(&target);
+			rdlen = isc_buffer_getuint16(source);
 
 			/* rdata */
-			result = read_and_check(sequential_read, &target, rdlen,
+			result = read_and_check(sequential_read, source, rdlen,
 						lctx->f, &totallen);
 			if (result != ISC_R_SUCCESS) {
 				goto cleanup;
 			}
-			isc_buffer_setactive(&target, (unsigned int)rdlen);
-			/*
-			 * It is safe to have the source active region and
-			 * the target available region be the same if
-			 * decompression is disabled (see dctx above) and we
-			 * are not downcasing names (options == 0).
-			 */
-			isc_buffer_init(&buf, isc_buffer_current(&target),
-					(unsigned int)rdlen);
+			isc_buffer_setactive(source, (unsigned int)rdlen);
+			if (source != &target) {
+				/*
+				 * Decode from the mapped file into the
+				 * unused part of the target buffer.
+				 */
+				if (rdlen > isc_buffer_availablelength(&target))
+				{
+					result = ISC_R_RANGE;
+					goto cleanup;
+				}
+				isc_buffer_init(&buf, isc_buffer_used(&target),
+						(unsigned int)rdlen);
+				isc_buffer_add(&target, (unsigned int)rdlen);
+			} else {
+				/*
+				 * It is safe to have the source active region
+				 * and the target available region be the same
+				 * if decompression is disabled (see dctx
+				 * above) and we are not downcasing names
+				 * (options == 0).
+				 */
+				isc_buffer_init(&buf,
+						isc_buffer_current(&target),
+						(unsigned int)rdlen);
+			}
 			result = dns_rdata_fromwire(
 				&rdata[i], rdatalist.rdclass, rdatalist.type,
-				&target, dctx, &buf);
+				source, dctx, &buf);
 			if (result != ISC_R_SUCCESS) {
 				goto cleanup;
 			}
@@ -2584,7 +3298,7 @@ load_raw(dns_loadctx_t *lctx) {
 		 * necessarily critical, but it very likely indicates broken
 		 * or malformed data.
 		 */
-		if (isc_buffer_remaininglength(&target) != 0 || totallen != 0) {
+		if (isc_buffer_remaininglength(source) != 0 || totallen != 0) {
 			result = ISC_R_RANGE;
 			goto cleanup;
 		}
@@ -2705,7 +3419,7 @@ dns_master_loadfileasync(const char *master_file, dns_name_t *top,
 	}
 
 	dns_loadctx_attach(lctx, lctxp);
-	isc_work_enqueue(loop, load, load_done, lctx);
+	isc_work_enqueueclass(loop, isc_workclass_bulk, load, load_done, lctx);
 
 	return (ISC_R_SUCCESS);
 }
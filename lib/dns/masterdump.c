@@ -15,19 +15,24 @@
 
 #include <inttypes.h>
 #include <stdbool.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include <isc/async.h>
 #include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/condition.h>
 #include <isc/file.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/stdio.h>
 #include <isc/string.h>
+#include <isc/thread.h>
 #include <isc/time.h>
 #include <isc/types.h>
 #include <isc/util.h>
@@ -101,6 +106,8 @@ typedef struct dns_totext_ctx {
 	dns_fixedname_t origin_fixname;
 	uint32_t current_ttl;
 	bool current_ttl_valid;
+	long first_ttl_offset; /*%< where the first $TTL was written */
+	uint32_t first_ttl;
 	dns_ttl_t serve_stale_ttl;
 	dns_indent_t indent;
 } dns_totext_ctx_t;
@@ -437,6 +444,8 @@ totext_ctx_init(const dns_master_style_t *style, const dns_indent_t *indentctx,
 	ctx->neworigin = NULL;
 	ctx->current_ttl = 0;
 	ctx->current_ttl_valid = false;
+	ctx->first_ttl_offset = -1;
+	ctx->first_ttl = 0;
 	ctx->serve_stale_ttl = 0;
 	ctx->indent = *indentctx;
 
@@ -941,6 +950,10 @@ dump_rdataset(isc_mem_t *mctx, const dns_name_t *name, dns_rdataset_t *rdataset,
 		if (!ctx->current_ttl_valid ||
 		    ctx->current_ttl != rdataset->ttl)
 		{
+			if (!ctx->current_ttl_valid) {
+				ctx->first_ttl_offset = ftell(f);
+				ctx->first_ttl = rdataset->ttl;
+			}
 			if ((ctx->style.flags & DNS_STYLEFLAG_COMMENT) != 0) {
 				isc_buffer_clear(buffer);
 				result = dns_ttl_totext(rdataset->ttl, true,
@@ -1669,6 +1682,459 @@ writeheader(dns_dumpctx_t *dctx) {
 	return (result);
 }
 
+/*
+ * Large zones and caches are dumped by several threads.  The names of
+ * the database are split into ranges of about DUMP_RANGE_NODES nodes,
+ * which are formatted by up to DUMP_MAXWORKERS threads into separate
+ * memory streams and then written out in order.  Names are never
+ * removed from a zone database tree, and names added since have no
+ * data in the version being dumped.  Cache nodes can be removed while
+ * the dump runs, so each range holds a reference to its first node
+ * until the worker has found it, and ends at the first name that sorts
+ * at or after the start of the next range.
+ */
+#define DUMP_RANGE_NODES (64 * 1024)
+#define DUMP_MINNODES	 (4 * DUMP_RANGE_NODES)
+#define DUMP_MAXWORKERS	 16
+
+typedef struct dumprange {
+	dns_fixedname_t start;
+	dns_dbnode_t *startnode;
+	dns_fixedname_t end; /*%< start of the next range */
+	bool last;	     /*%< runs to the end of its tree */
+	unsigned int options;
+	char *out;
+	size_t outlen;
+	long ttl_offset; /*%< where the leading $TTL was written */
+	uint32_t first_ttl;
+	uint32_t ttl;
+	bool ttl_valid;
+	isc_result_t result;
+	bool done;
+} dumprange_t;
+
+typedef struct dumpparallel {
+	dns_dumpctx_t *dctx;
+	dumprange_t *ranges;
+	size_t window;
+	isc_mutex_t lock;
+	isc_condition_t cond;
+	dns_dbiterator_t *splitter;
+	unsigned int phase;
+	dns_fixedname_t next; /*%< where the next range starts */
+	dns_dbnode_t *nextnode;
+	bool havenext;
+	bool exhausted;
+	size_t claimed;	  /*%< ranges handed to workers */
+	size_t committed; /*%< ranges written out */
+	isc_result_t result;
+	/* output state, only used by the committing thread */
+	bool printed;
+	uint32_t ttl;
+	bool ttl_valid;
+} dumpparallel_t;
+
+/*
+ * The main tree is dumped before the NSEC3 tree.
+ */
+static const unsigned int dump_phases[] = { DNS_DB_NONSEC3,
+					    DNS_DB_NSEC3ONLY };
+
+static bool
+dump_parallel_ok(dns_dumpctx_t *dctx) {
+	dns_masterstyle_flags_t flags = dctx->tctx.style.flags;
+
+	if (isc_os_ncpus() < 2) {
+		return (false);
+	}
+	if (!dns_db_iscache(dctx->db) &&
+	    (dctx->version == NULL || !dns_db_iszone(dctx->db)))
+	{
+		return (false);
+	}
+
+	/*
+	 * Without $TTL directives, whether the first record of a
+	 * range shows its TTL would depend on the range before it.
+	 */
+	if (dctx->format == dns_masterformat_text &&
+	    (flags & DNS_STYLEFLAG_TTL) == 0 &&
+	    (flags & DNS_STYLEFLAG_OMIT_TTL) != 0)
+	{
+		return (false);
+	}
+
+	return (dns_db_nodecount(dctx->db, dns_dbtree_main) +
+			dns_db_nodecount(dctx->db, dns_dbtree_nsec3) >=
+		DUMP_MINNODES);
+}
+
+/*
+ * Set up the next range of names to dump.  Called with the lock held.
+ */
+static isc_result_t
+dump_claim(dumpparallel_t *p, dumprange_t *range) {
+	dns_dumpctx_t *dctx = p->dctx;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	while (!p->havenext) {
+		if (p->splitter != NULL) {
+			dns_dbiterator_destroy(&p->splitter);
+		}
+		if (p->phase == ARRAY_SIZE(dump_phases)) {
+			return (ISC_R_NOMORE);
+		}
+		RETERR(dns_db_createiterator(dctx->db, dump_phases[p->phase++],
+					     &p->splitter));
+		result = dns_dbiterator_first(p->splitter);
+		if (result == ISC_R_NOMORE) {
+			continue;
+		}
+		RETERR(result);
+		RETERR(dns_dbiterator_current(p->splitter, &p->nextnode,
+					      dns_fixedname_name(&p->next)));
+		p->havenext = true;
+	}
+
+	*range = (dumprange_t){
+		.startnode = p->nextnode,
+		.options = dump_phases[p->phase - 1],
+		.ttl_offset = -1,
+		.result = ISC_R_SUCCESS,
+	};
+	p->nextnode = NULL;
+	dns_name_copy(dns_fixedname_name(&p->next),
+		      dns_fixedname_initname(&range->start));
+	dns_fixedname_init(&range->end);
+
+	for (size_t n = 0; n < DUMP_RANGE_NODES; n++) {
+		result = dns_dbiterator_next(p->splitter);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		range->last = true;
+		p->havenext = false;
+		return (ISC_R_SUCCESS);
+	}
+	RETERR(result);
+
+	RETERR(dns_dbiterator_current(p->splitter, &p->nextnode,
+				      dns_fixedname_name(&p->next)));
+	RUNTIME_CHECK(dns_dbiterator_pause(p->splitter) == ISC_R_SUCCESS);
+	dns_name_copy(dns_fixedname_name(&p->next),
+		      dns_fixedname_name(&range->end));
+
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Dump the names of 'range' to 'f'.
+ */
+static isc_result_t
+dump_range(dns_dumpctx_t *dctx, dumprange_t *range, dns_totext_ctx_t *ctx,
+	   isc_buffer_t *buffer, FILE *f) {
+	dns_dbiterator_t *dbiter = NULL;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+	dns_name_t *start = dns_fixedname_name(&range->start);
+	dns_name_t *end = dns_fixedname_name(&range->end);
+	unsigned int options = DNS_DB_STALEOK;
+	isc_result_t result;
+
+	if ((ctx->style.flags & DNS_STYLEFLAG_EXPIRED) != 0) {
+		options |= DNS_DB_EXPIREDOK;
+	}
+
+	RETERR(dns_db_createiterator(dctx->db, range->options, &dbiter));
+
+	result = dns_dbiterator_seek(dbiter, start);
+	if (range->startnode != NULL) {
+		dns_db_detachnode(dctx->db, &range->startnode);
+	}
+	if (result == DNS_R_PARTIALMATCH) {
+		/*
+		 * A range is dumped again by dump_commit() after its
+		 * first node has been released, and a cache may have
+		 * removed it since; the iterator is then at an
+		 * ancestor, and names before the start are skipped.
+		 */
+		result = ISC_R_SUCCESS;
+	} else if (result == ISC_R_NOTFOUND) {
+		result = dns_dbiterator_first(dbiter);
+	}
+	while (result == ISC_R_SUCCESS) {
+		dns_rdatasetiter_t *rdsiter = NULL;
+		dns_dbnode_t *node = NULL;
+
+		result = dns_dbiterator_current(dbiter, &node, name);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		if (!range->last && dns_name_compare(name, end) >= 0) {
+			dns_db_detachnode(dctx->db, &node);
+			break;
+		}
+
+		result = dns_dbiterator_pause(dbiter);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+
+		if (dns_name_compare(name, start) >= 0) {
+			result = dns_db_allrdatasets(dctx->db, node,
+						     dctx->version, options,
+						     dctx->now, &rdsiter);
+		}
+		if (rdsiter != NULL) {
+			result = (dctx->dumpsets)(dctx->mctx, name, rdsiter,
+						  ctx, buffer, f);
+			dns_rdatasetiter_destroy(&rdsiter);
+		}
+		dns_db_detachnode(dctx->db, &node);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_dbiterator_next(dbiter);
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+	}
+
+	dns_dbiterator_destroy(&dbiter);
+	return (result);
+}
+
+static void
+dump_initctx(dns_dumpctx_t *dctx, dns_totext_ctx_t *ctx) {
+	*ctx = dctx->tctx;
+	if (ctx->linebreak != NULL) {
+		ctx->linebreak = ctx->linebreak_buf;
+	}
+}
+
+static void *
+dump_worker(void *arg) {
+	dumpparallel_t *p = arg;
+	dns_dumpctx_t *dctx = p->dctx;
+	isc_buffer_t buffer;
+
+	isc_buffer_init(&buffer, isc_mem_get(dctx->mctx, initial_buffer_length),
+			initial_buffer_length);
+
+	LOCK(&p->lock);
+	while (true) {
+		dumprange_t *range = NULL;
+		dns_totext_ctx_t ctx;
+		isc_result_t result;
+		FILE *f = NULL;
+		size_t idx;
+
+		while (p->result == ISC_R_SUCCESS && !p->exhausted &&
+		       p->claimed >= p->committed + p->window)
+		{
+			WAIT(&p->cond, &p->lock);
+		}
+		if (p->result != ISC_R_SUCCESS || p->exhausted) {
+			break;
+		}
+		idx = p->claimed;
+		range = &p->ranges[idx % p->window];
+		result = dump_claim(p, range);
+		if (result == ISC_R_NOMORE) {
+			p->exhausted = true;
+			BROADCAST(&p->cond);
+			break;
+		} else if (result != ISC_R_SUCCESS) {
+			p->result = result;
+			BROADCAST(&p->cond);
+			break;
+		}
+		p->claimed++;
+		UNLOCK(&p->lock);
+
+		/*
+		 * Unless this is the first range, assume the class has
+		 * already been printed; dump_commit() checks that.
+		 */
+		dump_initctx(dctx, &ctx);
+		ctx.class_printed = (idx > 0);
+
+		f = open_memstream(&range->out, &range->outlen);
+		if (f == NULL) {
+			result = ISC_R_NOMEMORY;
+		} else {
+			result = dump_range(dctx, range, &ctx, &buffer, f);
+			if (fclose(f) != 0 && result == ISC_R_SUCCESS) {
+				result = ISC_R_NOMEMORY;
+			}
+		}
+		range->ttl_offset = ctx.first_ttl_offset;
+		range->first_ttl = ctx.first_ttl;
+		range->ttl = ctx.current_ttl;
+		range->ttl_valid = ctx.current_ttl_valid;
+
+		LOCK(&p->lock);
+		range->result = result;
+		range->done = true;
+		BROADCAST(&p->cond);
+	}
+	UNLOCK(&p->lock);
+
+	isc_mem_put(dctx->mctx, buffer.base, buffer.length);
+
+	return (NULL);
+}
+
+/*
+ * Write out the text formatted for range 'idx', adjusting it to
+ * the state left by the ranges before it.
+ */
+static isc_result_t
+dump_commit(dumpparallel_t *p, size_t idx, dumprange_t *range,
+	    isc_buffer_t *buffer) {
+	dns_dumpctx_t *dctx = p->dctx;
+	dns_masterstyle_flags_t flags = dctx->tctx.style.flags;
+	char *out = range->out;
+	size_t len = range->outlen;
+
+	if (len == 0) {
+		return (ISC_R_SUCCESS);
+	}
+
+	if (dctx->format == dns_masterformat_text) {
+		if (idx > 0 && !p->printed &&
+		    (flags & DNS_STYLEFLAG_OMIT_CLASS) != 0 &&
+		    (flags & DNS_STYLEFLAG_CLASS_PERNAME) == 0)
+		{
+			/*
+			 * Nothing was printed before this range, so
+			 * it has to show the class after all.
+			 */
+			dns_totext_ctx_t ctx;
+			isc_result_t result;
+
+			dump_initctx(dctx, &ctx);
+			result = dump_range(dctx, range, &ctx, buffer, dctx->f);
+			p->printed = true;
+			p->ttl = ctx.current_ttl;
+			p->ttl_valid = ctx.current_ttl_valid;
+			return (result);
+		}
+
+		/*
+		 * Drop the $TTL directive the range starts with if
+		 * that TTL is already in effect.
+		 */
+		if ((flags & DNS_STYLEFLAG_TTL) != 0 &&
+		    range->ttl_offset >= 0 && p->ttl_valid &&
+		    p->ttl == range->first_ttl)
+		{
+			size_t off = range->ttl_offset;
+			char *eol = memchr(out + off, '\n', len - off);
+
+			INSIST(eol != NULL);
+			RETERR(isc_stdio_write(out, 1, off, dctx->f, NULL));
+			len -= eol + 1 - out;
+			out = eol + 1;
+		}
+		if (range->ttl_valid) {
+			p->ttl = range->ttl;
+			p->ttl_valid = true;
+		}
+	}
+
+	p->printed = true;
+	return (isc_stdio_write(out, 1, len, dctx->f, NULL));
+}
+
+static isc_result_t
+dump_parallel(dns_dumpctx_t *dctx, isc_buffer_t *buffer) {
+	dumpparallel_t p = { .dctx = dctx, .result = ISC_R_SUCCESS };
+	isc_thread_t *threads = NULL;
+	size_t nthreads;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	nthreads = isc_os_ncpus();
+	if (dns_db_iscache(dctx->db)) {
+		/* Leave half of the CPUs to query processing. */
+		nthreads = ISC_MAX(nthreads / 2, 1);
+	}
+	nthreads = ISC_MIN(nthreads, DUMP_MAXWORKERS);
+	p.window = 2 * nthreads;
+	p.ranges = isc_mem_cget(dctx->mctx, p.window, sizeof(p.ranges[0]));
+	isc_mutex_init(&p.lock);
+	isc_condition_init(&p.cond);
+
+	threads = isc_mem_cget(dctx->mctx, nthreads, sizeof(threads[0]));
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_create(dump_worker, &p, &threads[i]);
+	}
+
+	for (size_t idx = 0;; idx++) {
+		dumprange_t *range = &p.ranges[idx % p.window];
+
+		LOCK(&p.lock);
+		while (p.result == ISC_R_SUCCESS &&
+		       !(idx < p.claimed && range->done) &&
+		       !(p.exhausted && idx == p.claimed))
+		{
+			WAIT(&p.cond, &p.lock);
+		}
+		result = p.result;
+		if (result != ISC_R_SUCCESS || idx == p.claimed) {
+			UNLOCK(&p.lock);
+			break;
+		}
+		UNLOCK(&p.lock);
+
+		if (atomic_load_acquire(&dctx->canceled)) {
+			result = ISC_R_CANCELED;
+		} else {
+			result = range->result;
+		}
+		if (result == ISC_R_SUCCESS) {
+			result = dump_commit(&p, idx, range, buffer);
+		}
+		free(range->out);
+		range->out = NULL;
+
+		LOCK(&p.lock);
+		if (result != ISC_R_SUCCESS) {
+			p.result = result;
+		} else {
+			p.committed = idx + 1;
+		}
+		BROADCAST(&p.cond);
+		UNLOCK(&p.lock);
+
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i], NULL);
+	}
+
+	for (size_t i = 0; i < p.window; i++) {
+		if (p.ranges[i].startnode != NULL) {
+			dns_db_detachnode(dctx->db, &p.ranges[i].startnode);
+		}
+		free(p.ranges[i].out);
+	}
+	if (p.nextnode != NULL) {
+		dns_db_detachnode(dctx->db, &p.nextnode);
+	}
+	if (p.splitter != NULL) {
+		dns_dbiterator_destroy(&p.splitter);
+	}
+	isc_mem_cput(dctx->mctx, threads, nthreads, sizeof(threads[0]));
+	isc_mem_cput(dctx->mctx, p.ranges, p.window, sizeof(p.ranges[0]));
+	isc_condition_destroy(&p.cond);
+	isc_mutex_destroy(&p.lock);
+
+	return (result);
+}
+
 static isc_result_t
 dumptostream(dns_dumpctx_t *dctx) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -1690,6 +2156,11 @@ dumptostream(dns_dumpctx_t *dctx) {
 
 	CHECK(writeheader(dctx));
 
+	if (dump_parallel_ok(dctx)) {
+		result = dump_parallel(dctx, &buffer);
+		goto cleanup;
+	}
+
 	result = dns_dbiterator_first(dctx->dbiter);
 	if (result != ISC_R_SUCCESS && result != ISC_R_NOMORE) {
 		goto cleanup;
@@ -1767,7 +2238,8 @@ dns_master_dumptostreamasync(isc_mem_t *mctx, dns_db_t *db,
 	dctx->done_arg = done_arg;
 
 	dns_dumpctx_attach(dctx, dctxp);
-	isc_work_enqueue(loop, master_dump_cb, master_dump_done_cb, dctx);
+	isc_work_enqueueclass(loop, isc_workclass_bulk, master_dump_cb,
+			      master_dump_done_cb, dctx);
 
 	return (ISC_R_SUCCESS);
 }
@@ -1862,7 +2334,8 @@ dns_master_dumpasync(isc_mem_t *mctx, dns_db_t *db, dns_dbversion_t *version,
 	dctx->tmpfile = tempname;
 
 	dns_dumpctx_attach(dctx, dctxp);
-	isc_work_enqueue(loop, master_dump_cb, master_dump_done_cb, dctx);
+	isc_work_enqueueclass(loop, isc_workclass_bulk, master_dump_cb,
+			      master_dump_done_cb, dctx);
 
 	return (ISC_R_SUCCESS);
 
@@ -112,6 +112,8 @@ hexdump(const char *msg, const char *msg2, void *base, size_t len) {
  * XXXMLG These should come from a config setting.
  */
 #define SCRATCHPAD_SIZE	   1232
+#define SCRATCHPAD_MAXKEEP (8 * SCRATCHPAD_SIZE)
+#define MSGBLOCK_MAXSIZE   8192
 #define NAME_FILLCOUNT	   1024
 #define NAME_FREEMAX	   8 * NAME_FILLCOUNT
 #define OFFSET_COUNT	   4
@@ -120,6 +122,14 @@ hexdump(const char *msg, const char *msg2, void *base, size_t len) {
 #define RDATASET_FILLCOUNT 1024
 #define RDATASET_FREEMAX   8 * RDATASET_FILLCOUNT
 
+/*%
+ * Sections with up to this many records are searched linearly for
+ * duplicate names and rdatasets while parsing; only larger ones get
+ * hash tables.  Almost all responses fall below it, and building the
+ * tables would cost more allocations than the search saves.
+ */
+#define PARSE_LINEAR_MAX 16
+
 /*%
  * Text representation of the different items, for message_totext
  * functions.
@@ -177,9 +187,6 @@ struct dns_msgblock {
 static dns_msgblock_t *
 msgblock_allocate(isc_mem_t *, unsigned int, unsigned int);
 
-#define msgblock_get(block, type) \
-	((type *)msgblock_internalget(block, sizeof(type)))
-
 /*
  * This function differs from public dns_message_puttemprdataset() that it
  * requires the *rdatasetp to be associated, and it will disassociate and
@@ -198,6 +205,13 @@ msgblock_reset(dns_msgblock_t *);
 static void
 msgblock_free(isc_mem_t *, dns_msgblock_t *, unsigned int);
 
+static void *
+msgblock_listget(isc_mem_t *, dns_msgblocklist_t *, unsigned int,
+		 unsigned int);
+
+static void
+msgblock_resetlist(isc_mem_t *, dns_msgblocklist_t *, unsigned int, bool);
+
 static void
 logfmtpacket(dns_message_t *message, const char *description,
 	     const isc_sockaddr_t *address, isc_logcategory_t *category,
@@ -264,6 +278,66 @@ msgblock_free(isc_mem_t *mctx, dns_msgblock_t *block,
 	isc_mem_put(mctx, block, length);
 }
 
+/*
+ * Return an element from the last block on 'list', allocating a new
+ * block if that one is used up.  A new block holds twice as many
+ * elements as the one before it (but at least 'count', and no more than
+ * MSGBLOCK_MAXSIZE bytes' worth), so a large message needs only a few
+ * allocations.
+ */
+static void *
+msgblock_listget(isc_mem_t *mctx, dns_msgblocklist_t *list,
+		 unsigned int sizeof_type, unsigned int count) {
+	dns_msgblock_t *block = ISC_LIST_TAIL(*list);
+	void *ptr = msgblock_internalget(block, sizeof_type);
+
+	if (ptr == NULL) {
+		if (block != NULL) {
+			unsigned int max = MSGBLOCK_MAXSIZE / sizeof_type;
+			count = ISC_MAX(count, ISC_MIN(2 * block->count, max));
+		}
+		block = msgblock_allocate(mctx, sizeof_type, count);
+		ISC_LIST_APPEND(*list, block, link);
+
+		ptr = msgblock_internalget(block, sizeof_type);
+	}
+
+	return (ptr);
+}
+
+/*
+ * Free the blocks on 'list'.  Unless 'everything' is set, a single
+ * block is kept for the next use of the message; if more than one
+ * block was needed, they are replaced by one block large enough for
+ * all of their elements (up to MSGBLOCK_MAXSIZE bytes), so that a
+ * message that is reused for similar traffic stops allocating.
+ */
+static void
+msgblock_resetlist(isc_mem_t *mctx, dns_msgblocklist_t *list,
+		   unsigned int sizeof_type, bool everything) {
+	dns_msgblock_t *block = NULL, *next_block = NULL;
+	unsigned int count = 0;
+
+	block = ISC_LIST_HEAD(*list);
+	if (!everything && block != NULL && ISC_LIST_NEXT(block, link) == NULL)
+	{
+		msgblock_reset(block);
+		return;
+	}
+
+	ISC_LIST_FOREACH_SAFE (*list, block, link, next_block) {
+		count += block->count;
+		ISC_LIST_UNLINK(*list, block, link);
+		msgblock_free(mctx, block, sizeof_type);
+	}
+
+	if (!everything && count > 0) {
+		count = ISC_MIN(count, MSGBLOCK_MAXSIZE / sizeof_type);
+		block = msgblock_allocate(mctx, sizeof_type, count);
+		ISC_LIST_APPEND(*list, block, link);
+	}
+}
+
 /*
  * Allocate a new dynamic buffer, and attach it to this message as the
  * "current" buffer.  (which is always the last on the list, for our
@@ -297,7 +371,6 @@ releaserdata(dns_message_t *msg, dns_rdata_t *rdata) {
 
 static dns_rdata_t *
 newrdata(dns_message_t *msg) {
-	dns_msgblock_t *msgblock;
 	dns_rdata_t *rdata;
 
 	rdata = ISC_LIST_HEAD(msg->freerdata);
@@ -306,16 +379,8 @@ newrdata(dns_message_t *msg) {
 		return (rdata);
 	}
 
-	msgblock = ISC_LIST_TAIL(msg->rdatas);
-	rdata = msgblock_get(msgblock, dns_rdata_t);
-	if (rdata == NULL) {
-		msgblock = msgblock_allocate(msg->mctx, sizeof(dns_rdata_t),
-					     RDATA_COUNT);
-		ISC_LIST_APPEND(msg->rdatas, msgblock, link);
-
-		rdata = msgblock_get(msgblock, dns_rdata_t);
-	}
-
+	rdata = msgblock_listget(msg->mctx, &msg->rdatas, sizeof(dns_rdata_t),
+				 RDATA_COUNT);
 	dns_rdata_init(rdata);
 	return (rdata);
 }
@@ -327,7 +392,6 @@ releaserdatalist(dns_message_t *msg, dns_rdatalist_t *rdatalist) {
 
 static dns_rdatalist_t *
 newrdatalist(dns_message_t *msg) {
-	dns_msgblock_t *msgblock;
 	dns_rdatalist_t *rdatalist;
 
 	rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
@@ -336,15 +400,8 @@ newrdatalist(dns_message_t *msg) {
 		goto out;
 	}
 
-	msgblock = ISC_LIST_TAIL(msg->rdatalists);
-	rdatalist = msgblock_get(msgblock, dns_rdatalist_t);
-	if (rdatalist == NULL) {
-		msgblock = msgblock_allocate(msg->mctx, sizeof(dns_rdatalist_t),
-					     RDATALIST_COUNT);
-		ISC_LIST_APPEND(msg->rdatalists, msgblock, link);
-
-		rdatalist = msgblock_get(msgblock, dns_rdatalist_t);
-	}
+	rdatalist = msgblock_listget(msg->mctx, &msg->rdatalists,
+				     sizeof(dns_rdatalist_t), RDATALIST_COUNT);
 out:
 	dns_rdatalist_init(rdatalist);
 	return (rdatalist);
@@ -352,20 +409,8 @@ out:
 
 static dns_offsets_t *
 newoffsets(dns_message_t *msg) {
-	dns_msgblock_t *msgblock;
-	dns_offsets_t *offsets;
-
-	msgblock = ISC_LIST_TAIL(msg->offsets);
-	offsets = msgblock_get(msgblock, dns_offsets_t);
-	if (offsets == NULL) {
-		msgblock = msgblock_allocate(msg->mctx, sizeof(dns_offsets_t),
-					     OFFSET_COUNT);
-		ISC_LIST_APPEND(msg->offsets, msgblock, link);
-
-		offsets = msgblock_get(msgblock, dns_offsets_t);
-	}
-
-	return (offsets);
+	return (msgblock_listget(msg->mctx, &msg->offsets,
+				 sizeof(dns_offsets_t), OFFSET_COUNT));
 }
 
 static void
@@ -526,7 +571,6 @@ msgresetsigs(dns_message_t *msg, bool replying) {
  */
 static void
 msgreset(dns_message_t *msg, bool everything) {
-	dns_msgblock_t *msgblock = NULL, *next_msgblock = NULL;
 	isc_buffer_t *dynbuf = NULL, *next_dynbuf = NULL;
 	dns_rdata_t *rdata = NULL;
 	dns_rdatalist_t *rdatalist = NULL;
@@ -555,58 +599,35 @@ msgreset(dns_message_t *msg, bool everything) {
 		rdatalist = ISC_LIST_HEAD(msg->freerdatalist);
 	}
 
+	/*
+	 * As with the message blocks, keep a single scratchpad buffer,
+	 * large enough for what this use of the message needed.
+	 */
 	dynbuf = ISC_LIST_HEAD(msg->scratchpad);
 	INSIST(dynbuf != NULL);
-	if (!everything) {
+	if (!everything && ISC_LIST_NEXT(dynbuf, link) == NULL) {
 		isc_buffer_clear(dynbuf);
-		dynbuf = ISC_LIST_NEXT(dynbuf, link);
-	}
-	while (dynbuf != NULL) {
-		next_dynbuf = ISC_LIST_NEXT(dynbuf, link);
-		ISC_LIST_UNLINK(msg->scratchpad, dynbuf, link);
-		isc_buffer_free(&dynbuf);
-		dynbuf = next_dynbuf;
-	}
-
-	msgblock = ISC_LIST_HEAD(msg->rdatas);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->rdatas, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdata_t));
-		msgblock = next_msgblock;
-	}
-
-	/*
-	 * rdatalists could be empty.
-	 */
+	} else {
+		unsigned int size = 0;
 
-	msgblock = ISC_LIST_HEAD(msg->rdatalists);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->rdatalists, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_rdatalist_t));
-		msgblock = next_msgblock;
+		ISC_LIST_FOREACH_SAFE (msg->scratchpad, dynbuf, link,
+				       next_dynbuf)
+		{
+			size += isc_buffer_length(dynbuf);
+			ISC_LIST_UNLINK(msg->scratchpad, dynbuf, link);
+			isc_buffer_free(&dynbuf);
+		}
+		if (!everything) {
+			newbuffer(msg, ISC_MIN(size, SCRATCHPAD_MAXKEEP));
+		}
 	}
 
-	msgblock = ISC_LIST_HEAD(msg->offsets);
-	if (!everything && msgblock != NULL) {
-		msgblock_reset(msgblock);
-		msgblock = ISC_LIST_NEXT(msgblock, link);
-	}
-	while (msgblock != NULL) {
-		next_msgblock = ISC_LIST_NEXT(msgblock, link);
-		ISC_LIST_UNLINK(msg->offsets, msgblock, link);
-		msgblock_free(msg->mctx, msgblock, sizeof(dns_offsets_t));
-		msgblock = next_msgblock;
-	}
+	msgblock_resetlist(msg->mctx, &msg->rdatas, sizeof(dns_rdata_t),
+			   everything);
+	msgblock_resetlist(msg->mctx, &msg->rdatalists,
+			   sizeof(dns_rdatalist_t), everything);
+	msgblock_resetlist(msg->mctx, &msg->offsets, sizeof(dns_offsets_t),
+			   everything);
 
 	if (msg->tsigkey != NULL) {
 		dns_tsigkey_detach(&msg->tsigkey);
@@ -824,6 +845,25 @@ rds_match(void *node, const void *key0) {
 		rds->covers == key->covers);
 }
 
+/*
+ * Linear counterpart of adding 'key' to a name's rdataset hash table:
+ * ISC_R_EXISTS with the matching rdataset, or ISC_R_SUCCESS if none.
+ */
+static isc_result_t
+findrdataset(dns_rdataset_t **foundrdataset, const dns_rdataset_t *key,
+	     dns_name_t *name) {
+	dns_rdataset_t *rds = NULL;
+
+	ISC_LIST_FOREACH_REV (name->list, rds, link) {
+		if (rds_match(rds, key)) {
+			*foundrdataset = rds;
+			return (ISC_R_EXISTS);
+		}
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 dns_message_findtype(const dns_name_t *name, dns_rdatatype_t type,
 		     dns_rdatatype_t covers, dns_rdataset_t **rdatasetp) {
@@ -974,7 +1014,7 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 	bool free_hashmaps = false;
 	isc_hashmap_t *name_map = NULL;
 
-	if (msg->counts[DNS_SECTION_QUESTION] > 1) {
+	if (msg->counts[DNS_SECTION_QUESTION] > PARSE_LINEAR_MAX) {
 		isc_hashmap_create(msg->mctx, 1, &name_map);
 	}
 
@@ -994,18 +1034,19 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 			goto cleanup;
 		}
 
-		/* If there is only one QNAME, skip the duplicity checks */
-		if (name_map == NULL) {
-			result = ISC_R_SUCCESS;
-			goto skip_name_check;
-		}
-
 		/*
 		 * Run through the section, looking to see if this name
 		 * is already there.  If it is found, put back the allocated
 		 * name since we no longer need it, and set our name pointer
 		 * to point to the name we found.
 		 */
+		if (name_map == NULL) {
+			result = findname(&found_name, name, section);
+			result = (result == ISC_R_SUCCESS) ? ISC_R_EXISTS
+							   : ISC_R_SUCCESS;
+			goto skip_name_check;
+		}
+
 		result = isc_hashmap_add(name_map, dns_name_hash(name),
 					 name_match, name, name,
 					 (void **)&found_name);
@@ -1096,6 +1137,16 @@ getquestions(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 		/*
 		 * Can't ask the same question twice.
 		 */
+		if (name_map == NULL) {
+			dns_rdataset_t *found_rdataset = NULL;
+
+			result = findrdataset(&found_rdataset, rdataset, name);
+			if (result == ISC_R_EXISTS) {
+				DO_ERROR(DNS_R_FORMERR);
+			}
+			goto skip_rds_check;
+		}
+
 		if (name->hashmap == NULL) {
 			isc_hashmap_create(msg->mctx, 1, &name->hashmap);
 			free_hashmaps = true;
@@ -1237,7 +1288,7 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 	bool isedns, issigzero, istsig;
 	isc_hashmap_t *name_map = NULL;
 
-	if (msg->counts[sectionid] > 1) {
+	if (msg->counts[sectionid] > PARSE_LINEAR_MAX) {
 		isc_hashmap_create(msg->mctx, 1, &name_map);
 	}
 
@@ -1483,25 +1534,27 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 				free_name = false;
 			}
 		} else {
-			if (name_map == NULL) {
-				result = ISC_R_SUCCESS;
-				goto skip_name_check;
-			}
-
 			/*
 			 * Run through the section, looking to see if this name
 			 * is already there.  If it is found, put back the
 			 * allocated name since we no longer need it, and set
 			 * our name pointer to point to the name we found.
 			 */
-			result = isc_hashmap_add(name_map, dns_name_hash(name),
-						 name_match, name, name,
-						 (void **)&found_name);
+			if (name_map == NULL) {
+				result = findname(&found_name, name, section);
+				result = (result == ISC_R_SUCCESS)
+						 ? ISC_R_EXISTS
+						 : ISC_R_SUCCESS;
+			} else {
+				result = isc_hashmap_add(
+					name_map, dns_name_hash(name),
+					name_match, name, name,
+					(void **)&found_name);
+			}
 
 			/*
 			 * If it is a new name, append to the section.
 			 */
-		skip_name_check:
 			switch (result) {
 			case ISC_R_SUCCESS:
 				ISC_LIST_APPEND(*section, name, link);
@@ -1554,6 +1607,12 @@ getsection(isc_buffer_t *source, dns_message_t *msg, dns_decompress_t dctx,
 				goto skip_rds_check;
 			}
 
+			if (name_map == NULL) {
+				result = findrdataset(&found_rdataset,
+						      rdataset, name);
+				goto skip_rds_check;
+			}
+
 			if (name->hashmap == NULL) {
 				isc_hashmap_create(msg->mctx, 1,
 						   &name->hashmap);
@@ -1843,6 +1902,206 @@ truncated:
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Check whether the wire data in 'r' is a simple query, without
+ * allocating anything.  On success, '*qnamelen' is set to the length of
+ * the uncompressed QNAME, and '*hasopt' tells whether the single
+ * additional record (which is always an OPT) is present.
+ */
+static bool
+simplequery(const isc_region_t *r, unsigned int *qnamelen, bool *hasopt) {
+	const unsigned char *p = r->base;
+	unsigned int length = r->length;
+	unsigned int pos, arcount, rdlen;
+	uint16_t flags;
+
+	if (length < DNS_MESSAGE_HEADERLEN) {
+		return (false);
+	}
+
+	flags = (p[2] << 8) | p[3];
+	if ((flags & DNS_MESSAGEFLAG_QR) != 0 ||
+	    ((flags & DNS_MESSAGE_OPCODE_MASK) >> DNS_MESSAGE_OPCODE_SHIFT) !=
+		    dns_opcode_query)
+	{
+		return (false);
+	}
+
+	/* QDCOUNT == 1, ANCOUNT == 0, NSCOUNT == 0, ARCOUNT <= 1 */
+	if (p[4] != 0 || p[5] != 1 || p[6] != 0 || p[7] != 0 || p[8] != 0 ||
+	    p[9] != 0 || p[10] != 0 || p[11] > 1)
+	{
+		return (false);
+	}
+	arcount = p[11];
+
+	/* QNAME: uncompressed labels only */
+	pos = DNS_MESSAGE_HEADERLEN;
+	for (;;) {
+		unsigned int labellen;
+
+		if (pos >= length) {
+			return (false);
+		}
+		labellen = p[pos];
+		if (labellen > 63) {
+			return (false);
+		}
+		pos += labellen + 1;
+		if (pos - DNS_MESSAGE_HEADERLEN > DNS_NAME_MAXWIRE) {
+			return (false);
+		}
+		if (labellen == 0) {
+			break;
+		}
+	}
+	*qnamelen = pos - DNS_MESSAGE_HEADERLEN;
+
+	/* QTYPE and QCLASS; TKEY queries need the full parser */
+	if (length - pos < 4 ||
+	    ((p[pos] << 8) | p[pos + 1]) == dns_rdatatype_tkey)
+	{
+		return (false);
+	}
+	pos += 4;
+
+	*hasopt = (arcount == 1);
+	if (arcount == 0) {
+		return (pos == length);
+	}
+
+	/* OPT: root owner, type, class, ttl, rdlen, rdata to the end */
+	if (length - pos < 11 || p[pos] != 0 ||
+	    ((p[pos + 1] << 8) | p[pos + 2]) != dns_rdatatype_opt)
+	{
+		return (false);
+	}
+	rdlen = (p[pos + 9] << 8) | p[pos + 10];
+	return (length - pos - 11 == rdlen);
+}
+
+isc_result_t
+dns_message_parsequery(dns_message_t *msg, isc_buffer_t *source) {
+	isc_region_t r;
+	isc_buffer_t origsource;
+	isc_result_t result;
+	unsigned int qnamelen;
+	bool hasopt;
+	uint16_t tmpflags;
+	dns_name_t *name = NULL;
+	dns_rdatalist_t *rdatalist = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	dns_rdata_t *rdata = NULL;
+	dns_rdatatype_t rdtype;
+	dns_rdataclass_t rdclass;
+	dns_ttl_t ttl;
+	unsigned int rdatalen;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(source != NULL);
+	REQUIRE(msg->from_to_wire == DNS_MESSAGE_INTENTPARSE);
+	REQUIRE(ISC_LIST_EMPTY(msg->sections[DNS_SECTION_QUESTION]));
+	REQUIRE(msg->opt == NULL);
+
+	isc_buffer_remainingregion(source, &r);
+	if (!simplequery(&r, &qnamelen, &hasopt)) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+
+	origsource = *source;
+	isc_buffer_usedregion(&origsource, &msg->saved);
+
+	msg->id = isc_buffer_getuint16(source);
+	tmpflags = isc_buffer_getuint16(source);
+	msg->opcode = ((tmpflags & DNS_MESSAGE_OPCODE_MASK) >>
+		       DNS_MESSAGE_OPCODE_SHIFT);
+	msg->rcode = (dns_rcode_t)(tmpflags & DNS_MESSAGE_RCODE_MASK);
+	msg->flags = (tmpflags & DNS_MESSAGE_FLAG_MASK);
+	msg->counts[DNS_SECTION_QUESTION] = isc_buffer_getuint16(source);
+	msg->counts[DNS_SECTION_ANSWER] = isc_buffer_getuint16(source);
+	msg->counts[DNS_SECTION_AUTHORITY] = isc_buffer_getuint16(source);
+	msg->counts[DNS_SECTION_ADDITIONAL] = isc_buffer_getuint16(source);
+
+	msg->header_ok = 1;
+	msg->state = DNS_SECTION_QUESTION;
+
+	/*
+	 * The question.  The name is known to be well formed and not
+	 * compressed, so there is nothing to look up.
+	 */
+	dns_message_gettempname(msg, &name);
+	name->offsets = (unsigned char *)newoffsets(msg);
+	isc_buffer_setactive(source, qnamelen);
+	result = getname(name, source, msg, DNS_DECOMPRESS_ALWAYS);
+	if (result != ISC_R_SUCCESS) {
+		dns_message_puttempname(msg, &name);
+		goto fallback;
+	}
+	ISC_LIST_APPEND(msg->sections[DNS_SECTION_QUESTION], name, link);
+
+	rdtype = isc_buffer_getuint16(source);
+	rdclass = isc_buffer_getuint16(source);
+	msg->rdclass = rdclass;
+	msg->rdclass_set = 1;
+
+	rdatalist = newrdatalist(msg);
+	rdatalist->type = rdtype;
+	rdatalist->rdclass = rdclass;
+	rdatalist->covers = 0;
+
+	dns_message_gettemprdataset(msg, &rdataset);
+	dns_rdatalist_tordataset(rdatalist, rdataset);
+	rdataset->attributes |= DNS_RDATASETATTR_QUESTION;
+	ISC_LIST_APPEND(name->list, rdataset, link);
+	rdataset = NULL;
+
+	msg->question_ok = 1;
+
+	if (!hasopt) {
+		return (ISC_R_SUCCESS);
+	}
+
+	/*
+	 * The OPT record.  Its owner is the root name and it runs to the
+	 * end of the message; only its RDATA still needs checking.
+	 */
+	isc_buffer_forward(source, 1);
+	rdtype = isc_buffer_getuint16(source);
+	rdclass = isc_buffer_getuint16(source);
+	ttl = isc_buffer_getuint32(source);
+	rdatalen = isc_buffer_getuint16(source);
+
+	rdata = newrdata(msg);
+	result = getrdata(source, msg, DNS_DECOMPRESS_ALWAYS, rdclass, rdtype,
+			  rdatalen, rdata);
+	if (result != ISC_R_SUCCESS) {
+		releaserdata(msg, rdata);
+		goto fallback;
+	}
+	rdata->rdclass = rdclass;
+
+	rdatalist = newrdatalist(msg);
+	rdatalist->type = rdtype;
+	rdatalist->covers = 0;
+	rdatalist->rdclass = rdclass;
+	rdatalist->ttl = ttl;
+	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+
+	dns_message_gettemprdataset(msg, &rdataset);
+	dns_rdatalist_tordataset(rdatalist, rdataset);
+	dns_rdataset_setownercase(rdataset, dns_rootname);
+
+	msg->opt = rdataset;
+	msg->rcode |= (dns_rcode_t)((ttl & DNS_MESSAGE_EDNSRCODE_MASK) >> 20);
+
+	return (ISC_R_SUCCESS);
+
+fallback:
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+	*source = origsource;
+	return (ISC_R_NOTIMPLEMENTED);
+}
+
 isc_result_t
 dns_message_renderbegin(dns_message_t *msg, dns_compress_t *cctx,
 			isc_buffer_t *buffer) {
@@ -2234,6 +2493,76 @@ dns_message_rendersection(dns_message_t *msg, dns_section_t sectionid,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+dns_message_renderraw(dns_message_t *msg, const isc_region_t *wire,
+		      unsigned int ancount, unsigned int nscount,
+		      unsigned int arcount) {
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(wire != NULL);
+
+	if (msg->buffer->length - msg->buffer->used <
+	    msg->reserved + wire->length)
+	{
+		return (ISC_R_NOSPACE);
+	}
+
+	isc_buffer_putmem(msg->buffer, wire->base, wire->length);
+	msg->counts[DNS_SECTION_ANSWER] += ancount;
+	msg->counts[DNS_SECTION_AUTHORITY] += nscount;
+	msg->counts[DNS_SECTION_ADDITIONAL] += arcount;
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_message_renderrr(dns_message_t *msg, dns_section_t sectionid,
+		     const dns_name_t *owner, dns_ttl_t ttl,
+		     const dns_rdata_t *rdata) {
+	isc_buffer_t st; /* for rollbacks */
+	isc_result_t result;
+
+	REQUIRE(DNS_MESSAGE_VALID(msg));
+	REQUIRE(msg->buffer != NULL);
+	REQUIRE(VALID_NAMED_SECTION(sectionid));
+	REQUIRE(owner != NULL && rdata != NULL);
+
+	st = *(msg->buffer);
+
+	/*
+	 * Shrink the space in the buffer by the reserved amount.
+	 */
+	if (msg->buffer->length - msg->buffer->used < msg->reserved) {
+		return (ISC_R_NOSPACE);
+	}
+	msg->buffer->length -= msg->reserved;
+
+	dns_compress_setpermitted(msg->cctx, true);
+	result = dns_name_towire(owner, msg->cctx, msg->buffer, NULL);
+	if (result == ISC_R_SUCCESS &&
+	    isc_buffer_availablelength(msg->buffer) < 10 + rdata->length)
+	{
+		result = ISC_R_NOSPACE;
+	}
+	if (result != ISC_R_SUCCESS) {
+		INSIST(st.used < 65536);
+		dns_compress_rollback(msg->cctx, (uint16_t)st.used);
+		*(msg->buffer) = st; /* rollback */
+		return (result);
+	}
+
+	isc_buffer_putuint16(msg->buffer, rdata->type);
+	isc_buffer_putuint16(msg->buffer, rdata->rdclass);
+	isc_buffer_putuint32(msg->buffer, ttl);
+	isc_buffer_putuint16(msg->buffer, (uint16_t)rdata->length);
+	isc_buffer_putmem(msg->buffer, rdata->data, rdata->length);
+
+	msg->buffer->length += msg->reserved;
+	msg->counts[sectionid]++;
+
+	return (ISC_R_SUCCESS);
+}
+
 void
 dns_message_renderheader(dns_message_t *msg, isc_buffer_t *target) {
 	uint16_t tmp;
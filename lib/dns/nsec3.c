@@ -239,6 +239,28 @@ dns_nsec3_generate_salt(unsigned char *salt, size_t saltlen) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Make the NSEC3 owner name for 'hash' under 'origin'.
+ */
+static isc_result_t
+hashtoname(dns_fixedname_t *result, const unsigned char *hash, size_t len,
+	   const dns_name_t *origin) {
+	unsigned char nametext[DNS_NAME_FORMATSIZE];
+	isc_buffer_t namebuffer;
+	isc_region_t region;
+
+	/* convert the hash to base32hex non-padded */
+	region.base = UNCONST(hash);
+	region.length = (unsigned int)len;
+	isc_buffer_init(&namebuffer, nametext, sizeof nametext);
+	isc_base32hexnp_totext(&region, 1, "", &namebuffer);
+
+	/* convert the hex to a domain name */
+	dns_fixedname_init(result);
+	return (dns_name_fromtext(dns_fixedname_name(result), &namebuffer,
+				  origin, 0, NULL));
+}
+
 isc_result_t
 dns_nsec3_hashname(dns_fixedname_t *result,
 		   unsigned char rethash[NSEC3_MAX_HASH_LENGTH],
@@ -247,11 +269,8 @@ dns_nsec3_hashname(dns_fixedname_t *result,
 		   unsigned int iterations, const unsigned char *salt,
 		   size_t saltlength) {
 	unsigned char hash[NSEC3_MAX_HASH_LENGTH];
-	unsigned char nametext[DNS_NAME_FORMATSIZE];
 	dns_fixedname_t fixed;
 	dns_name_t *downcased;
-	isc_buffer_t namebuffer;
-	isc_region_t region;
 	size_t len;
 
 	if (rethash == NULL) {
@@ -273,16 +292,44 @@ dns_nsec3_hashname(dns_fixedname_t *result,
 
 	SET_IF_NOT_NULL(hash_length, len);
 
-	/* convert the hash to base32hex non-padded */
-	region.base = rethash;
-	region.length = (unsigned int)len;
-	isc_buffer_init(&namebuffer, nametext, sizeof nametext);
-	isc_base32hexnp_totext(&region, 1, "", &namebuffer);
+	return (hashtoname(result, rethash, len, origin));
+}
 
-	/* convert the hex to a domain name */
-	dns_fixedname_init(result);
-	return (dns_name_fromtext(dns_fixedname_name(result), &namebuffer,
-				  origin, 0, NULL));
+isc_result_t
+dns_nsec3_hashnames(unsigned char *const hashes[], size_t *hash_length,
+		    const dns_name_t *const names[], size_t count,
+		    dns_hash_t hashalg, unsigned int iterations,
+		    const unsigned char *salt, size_t saltlength) {
+	dns_fixedname_t fixed[ISC_ITERATED_HASH_LANES];
+	const unsigned char *in[ISC_ITERATED_HASH_LANES];
+	int inlength[ISC_ITERATED_HASH_LANES];
+	size_t len = 0;
+
+	REQUIRE(count > 0);
+
+	for (size_t i = 0; i < count; i += ISC_ITERATED_HASH_LANES) {
+		size_t n = ISC_MIN(count - i, ISC_ITERATED_HASH_LANES);
+
+		for (size_t j = 0; j < n; j++) {
+			dns_name_t *downcased =
+				dns_fixedname_initname(&fixed[j]);
+			dns_name_downcase(names[i + j], downcased, NULL);
+			in[j] = downcased->ndata;
+			inlength[j] = downcased->length;
+			memset(hashes[i + j], 0, NSEC3_MAX_HASH_LENGTH);
+		}
+
+		len = isc_iterated_hash_multi(&hashes[i], hashalg, iterations,
+					      salt, (int)saltlength, in,
+					      inlength, n);
+		if (len == 0U) {
+			return (DNS_R_BADALG);
+		}
+	}
+
+	SET_IF_NOT_NULL(hash_length, len);
+
+	return (ISC_R_SUCCESS);
 }
 
 unsigned int
@@ -539,6 +586,16 @@ dns_nsec3_addnsec3(dns_db_t *db, dns_dbversion_t *version,
 		   const dns_name_t *name,
 		   const dns_rdata_nsec3param_t *nsec3param, dns_ttl_t nsecttl,
 		   bool unsecure, dns_diff_t *diff) {
+	return (dns_nsec3_addnsec3hashed(db, version, name, nsec3param, NULL,
+					 0, nsecttl, unsecure, diff));
+}
+
+isc_result_t
+dns_nsec3_addnsec3hashed(dns_db_t *db, dns_dbversion_t *version,
+			 const dns_name_t *name,
+			 const dns_rdata_nsec3param_t *nsec3param,
+			 const unsigned char *namehash, size_t namehash_length,
+			 dns_ttl_t nsecttl, bool unsecure, dns_diff_t *diff) {
 	dns_dbiterator_t *dbit = NULL;
 	dns_dbnode_t *node = NULL;
 	dns_dbnode_t *newnode = NULL;
@@ -593,9 +650,17 @@ dns_nsec3_addnsec3(dns_db_t *db, dns_dbversion_t *version,
 	 * If this is the first NSEC3 in the chain nexthash will
 	 * remain pointing to itself.
 	 */
-	next_length = sizeof(nexthash);
-	CHECK(dns_nsec3_hashname(&fixed, nexthash, &next_length, name, origin,
-				 hash, iterations, salt, salt_length));
+	if (namehash != NULL) {
+		INSIST(namehash_length <= sizeof(nexthash));
+		memmove(nexthash, namehash, namehash_length);
+		next_length = namehash_length;
+		CHECK(hashtoname(&fixed, nexthash, next_length, origin));
+	} else {
+		next_length = sizeof(nexthash);
+		CHECK(dns_nsec3_hashname(&fixed, nexthash, &next_length, name,
+					 origin, hash, iterations, salt,
+					 salt_length));
+	}
 	INSIST(next_length <= sizeof(nexthash));
 
 	/*
@@ -46,6 +46,7 @@ struct dns_ntatable {
 	isc_loopmgr_t *loopmgr;
 	isc_refcount_t references;
 	dns_qpmulti_t *table;
+	atomic_uint_fast32_t count;
 	atomic_bool shuttingdown;
 };
 
@@ -314,6 +315,9 @@ dns_ntatable_add(dns_ntatable_t *ntatable, const dns_name_t *name, bool force,
 	nta->forced = force;
 
 	result = dns_qp_insert(qp, nta, 0);
+	if (result == ISC_R_SUCCESS) {
+		atomic_fetch_add_release(&ntatable->count, 1);
+	}
 	switch (result) {
 	case ISC_R_EXISTS:
 		result = dns_qp_getname(qp, &nta->name, &pval, NULL);
@@ -358,6 +362,7 @@ dns_ntatable_delete(dns_ntatable_t *ntatable, const dns_name_t *name) {
 	result = dns_qp_deletename(qp, name, &pval, NULL);
 	if (result == ISC_R_SUCCESS) {
 		dns__nta_t *n = pval;
+		atomic_fetch_sub_release(&ntatable->count, 1);
 		dns__nta_shutdown(n);
 		dns__nta_detach(&n);
 	}
@@ -389,6 +394,7 @@ delete_expired(void *arg) {
 			      DNS_LOGMODULE_NTA, ISC_LOG_INFO,
 			      "deleting expired NTA at %s", nb);
 		dns_qp_deletename(qp, &nta->name, NULL, NULL);
+		atomic_fetch_sub_release(&ntatable->count, 1);
 		dns__nta_shutdown(nta);
 		dns__nta_unref(nta);
 	}
@@ -411,6 +417,14 @@ dns_ntatable_covered(dns_ntatable_t *ntatable, isc_stdtime_t now,
 	REQUIRE(VALID_NTATABLE(ntatable));
 	REQUIRE(dns_name_isabsolute(name));
 
+	/*
+	 * Most views have no NTAs at all; this is asked for nearly every
+	 * name that is validated, so avoid the lock and the trie walk.
+	 */
+	if (atomic_load_acquire(&ntatable->count) == 0) {
+		return (false);
+	}
+
 	RWLOCK(&ntatable->rwlock, isc_rwlocktype_read);
 	dns_qpmulti_query(ntatable->table, &qpr);
 	result = dns_qp_lookup(&qpr, name, NULL, NULL, NULL, &pval, NULL);
@@ -385,8 +385,71 @@ dst__openssl_keypair_isprivate(const dst_key_t *key) {
 	return (key->keydata.pkeypair.priv != NULL);
 }
 
+static int
+digestinit(bool sign, const EVP_MD *type, EVP_PKEY *pkey, EVP_MD_CTX *ctx) {
+	if (sign) {
+		return (EVP_DigestSignInit(ctx, NULL, type, NULL, pkey));
+	}
+	return (EVP_DigestVerifyInit(ctx, NULL, type, NULL, pkey));
+}
+
+int
+dst__openssl_digestinit(dst_key_t *key, bool sign, const EVP_MD *type,
+			EVP_MD_CTX *ctx) {
+	atomic_ptr(EVP_MD_CTX) *cachep = NULL;
+	EVP_PKEY *pkey = NULL;
+	EVP_MD_CTX *cached = NULL;
+
+	REQUIRE(type != NULL);
+
+	if (sign) {
+		cachep = &key->keydata.pkeypair.signctx;
+		pkey = key->keydata.pkeypair.priv;
+	} else {
+		cachep = &key->keydata.pkeypair.verifyctx;
+		pkey = key->keydata.pkeypair.pub;
+	}
+
+	cached = atomic_load_acquire(cachep);
+
+	if (cached == NULL) {
+		EVP_MD_CTX *expected = NULL;
+
+		cached = EVP_MD_CTX_new();
+		if (cached == NULL) {
+			return (0);
+		}
+		if (digestinit(sign, type, pkey, cached) != 1) {
+			EVP_MD_CTX_free(cached);
+			return (0);
+		}
+		if (!atomic_compare_exchange_strong_acq_rel(cachep, &expected,
+							    cached))
+		{
+			/* Another thread got there first */
+			EVP_MD_CTX_free(cached);
+			cached = expected;
+		}
+	}
+
+	if (EVP_MD_CTX_copy_ex(ctx, cached) == 1) {
+		return (1);
+	}
+
+	/*
+	 * Not every provider can duplicate a signature context; set up
+	 * this one from scratch.
+	 */
+	ERR_clear_error();
+	return (digestinit(sign, type, pkey, ctx));
+}
+
 void
 dst__openssl_keypair_destroy(dst_key_t *key) {
+	EVP_MD_CTX_free(atomic_exchange_acq_rel(&key->keydata.pkeypair.signctx,
+						NULL));
+	EVP_MD_CTX_free(atomic_exchange_acq_rel(
+		&key->keydata.pkeypair.verifyctx, NULL));
 	if (key->keydata.pkeypair.priv != key->keydata.pkeypair.pub) {
 		EVP_PKEY_free(key->keydata.pkeypair.priv);
 	}
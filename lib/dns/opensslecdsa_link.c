@@ -666,8 +666,8 @@ opensslecdsa_createctx(dst_key_t *key, dst_context_t *dctx) {
 	}
 
 	if (dctx->use == DO_SIGN) {
-		if (EVP_DigestSignInit(evp_md_ctx, NULL, type, NULL,
-				       dctx->key->keydata.pkeypair.priv) != 1)
+		if (dst__openssl_digestinit(dctx->key, true, type,
+					    evp_md_ctx) != 1)
 		{
 			EVP_MD_CTX_destroy(evp_md_ctx);
 			DST_RET(dst__openssl_toresult3(dctx->category,
@@ -675,8 +675,8 @@ opensslecdsa_createctx(dst_key_t *key, dst_context_t *dctx) {
 						       ISC_R_FAILURE));
 		}
 	} else {
-		if (EVP_DigestVerifyInit(evp_md_ctx, NULL, type, NULL,
-					 dctx->key->keydata.pkeypair.pub) != 1)
+		if (dst__openssl_digestinit(dctx->key, false, type,
+					    evp_md_ctx) != 1)
 		{
 			EVP_MD_CTX_destroy(evp_md_ctx);
 			DST_RET(dst__openssl_toresult3(dctx->category,
@@ -0,0 +1,195 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/buffer.h>
+#include <isc/netaddr.h>
+#include <isc/region.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/name.h>
+#include <dns/qlog.h>
+#include <dns/result.h>
+
+/*
+ * Record layout, following the 16-bit length:
+ *
+ *	version		8 bits
+ *	attributes	8 bits (QLOG_TCP, QLOG_INET6)
+ *	seconds		32 bits
+ *	nanoseconds	32 bits
+ *	latency		32 bits
+ *	address		32 or 128 bits
+ *	port		16 bits
+ *	qtype		16 bits
+ *	qclass		16 bits
+ *	flags		16 bits
+ *	rcode		16 bits
+ *	qname		uncompressed wire format
+ */
+#define QLOG_TCP   0x01
+#define QLOG_INET6 0x02
+
+#define QLOG_FIXEDSIZE (1 + 1 + 4 + 4 + 4 + 2 + 2 + 2 + 2 + 2)
+
+isc_result_t
+dns_qlog_encode(const dns_qlogrecord_t *record, isc_buffer_t *target) {
+	isc_netaddr_t netaddr;
+	isc_region_t r;
+	unsigned int length;
+	uint8_t attributes = 0;
+
+	REQUIRE(record != NULL);
+	REQUIRE(DNS_NAME_VALID(record->qname));
+	REQUIRE(dns_name_isabsolute(record->qname));
+	REQUIRE(ISC_BUFFER_VALID(target));
+
+	isc_netaddr_fromsockaddr(&netaddr, &record->client);
+
+	length = QLOG_FIXEDSIZE + record->qname->length;
+	switch (netaddr.family) {
+	case AF_INET:
+		length += 4;
+		break;
+	case AF_INET6:
+		attributes |= QLOG_INET6;
+		length += 16;
+		break;
+	default:
+		UNREACHABLE();
+	}
+	if (record->tcp) {
+		attributes |= QLOG_TCP;
+	}
+
+	if (isc_buffer_availablelength(target) < length + 2) {
+		return (ISC_R_NOSPACE);
+	}
+
+	isc_buffer_putuint16(target, length);
+	isc_buffer_putuint8(target, DNS_QLOG_VERSION);
+	isc_buffer_putuint8(target, attributes);
+	isc_buffer_putuint32(target, isc_time_seconds(&record->time));
+	isc_buffer_putuint32(target, isc_time_nanoseconds(&record->time));
+	isc_buffer_putuint32(target, record->latency);
+	if (netaddr.family == AF_INET) {
+		isc_buffer_putmem(target,
+				  (const unsigned char *)&netaddr.type.in, 4);
+	} else {
+		isc_buffer_putmem(target,
+				  (const unsigned char *)&netaddr.type.in6, 16);
+	}
+	isc_buffer_putuint16(target, isc_sockaddr_getport(&record->client));
+	isc_buffer_putuint16(target, record->qtype);
+	isc_buffer_putuint16(target, record->qclass);
+	isc_buffer_putuint16(target, record->flags);
+	isc_buffer_putuint16(target, record->rcode);
+	dns_name_toregion(record->qname, &r);
+	isc_buffer_putmem(target, r.base, r.length);
+
+	return (ISC_R_SUCCESS);
+}
+
+isc_result_t
+dns_qlog_decode(isc_buffer_t *source, dns_qlogrecord_t *record,
+		dns_name_t *qname) {
+	isc_buffer_t b;
+	isc_region_t r;
+	isc_result_t result;
+	unsigned int length, addrlength, seconds, nanoseconds;
+	uint8_t attributes;
+	struct in_addr in;
+	struct in6_addr in6;
+
+	REQUIRE(ISC_BUFFER_VALID(source));
+	REQUIRE(record != NULL);
+	REQUIRE(DNS_NAME_VALID(qname));
+
+	if (isc_buffer_remaininglength(source) == 0) {
+		return (ISC_R_NOMORE);
+	}
+	if (isc_buffer_remaininglength(source) < 2) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+
+	isc_buffer_remainingregion(source, &r);
+	length = (r.base[0] << 8) | r.base[1];
+	if (r.length - 2 < length) {
+		return (ISC_R_UNEXPECTEDEND);
+	}
+	isc_buffer_forward(source, length + 2);
+
+	isc_buffer_init(&b, r.base + 2, length);
+	isc_buffer_add(&b, length);
+
+	if (length < 1) {
+		return (DNS_R_FORMERR);
+	}
+	if (isc_buffer_getuint8(&b) != DNS_QLOG_VERSION) {
+		return (ISC_R_NOTIMPLEMENTED);
+	}
+	if (length < QLOG_FIXEDSIZE) {
+		return (DNS_R_FORMERR);
+	}
+	attributes = isc_buffer_getuint8(&b);
+	addrlength = ((attributes & QLOG_INET6) != 0) ? 16 : 4;
+	if (isc_buffer_remaininglength(&b) < QLOG_FIXEDSIZE - 2 + addrlength) {
+		return (DNS_R_FORMERR);
+	}
+
+	seconds = isc_buffer_getuint32(&b);
+	nanoseconds = isc_buffer_getuint32(&b);
+	if (nanoseconds >= NS_PER_SEC) {
+		return (DNS_R_FORMERR);
+	}
+	isc_time_set(&record->time, seconds, nanoseconds);
+	record->latency = isc_buffer_getuint32(&b);
+	record->tcp = ((attributes & QLOG_TCP) != 0);
+
+	isc_buffer_remainingregion(&b, &r);
+	isc_buffer_forward(&b, addrlength);
+	if (addrlength == 16) {
+		memmove(&in6, r.base, sizeof(in6));
+		isc_sockaddr_fromin6(&record->client, &in6,
+				     isc_buffer_getuint16(&b));
+	} else {
+		memmove(&in, r.base, sizeof(in));
+		isc_sockaddr_fromin(&record->client, &in,
+				    isc_buffer_getuint16(&b));
+	}
+
+	record->qtype = isc_buffer_getuint16(&b);
+	record->qclass = isc_buffer_getuint16(&b);
+	record->flags = isc_buffer_getuint16(&b);
+	record->rcode = isc_buffer_getuint16(&b);
+
+	result = dns_name_fromwire(qname, &b, DNS_DECOMPRESS_NEVER, NULL);
+	if (result != ISC_R_SUCCESS) {
+		return (DNS_R_FORMERR);
+	}
+	record->qname = qname;
+	if (isc_buffer_remaininglength(&b) != 0) {
+		return (DNS_R_FORMERR);
+	}
+
+	return (ISC_R_SUCCESS);
+}
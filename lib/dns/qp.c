@@ -21,7 +21,7 @@
 #include <stdint.h>
 #include <string.h>
 
-#if FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION
+#if FUZZING_BUILD_MODE_UNSAFE_FOR_PRODUCTION || ENABLE_QP_HUGEPAGES
 #include <sys/mman.h>
 #include <unistd.h>
 #endif
@@ -46,6 +46,7 @@
 #include <dns/qp.h>
 #include <dns/types.h>
 
+#include "probes.h"
 #include "qp_p.h"
 
 #ifndef DNS_QP_LOG_STATS
@@ -437,6 +438,133 @@ write_protect(dns_qp_t *qp, dns_qpchunk_t chunk) {
 
 #endif
 
+#if ENABLE_QP_HUGEPAGES
+
+/*
+ * Optionally, the chunks of a large multithreaded trie are carved out
+ * of 2 MiB regions backed by huge pages, so that lookups in a big zone
+ * need far fewer TLB entries. Regions are only released when the trie
+ * is destroyed; free chunks are kept on a list for reuse.
+ *
+ * Small tries, and single-threaded tries (as used by the cache, whose
+ * size limit depends on the memory context), use the ordinary
+ * allocator. Tries with `write_protect` set need their own mappings
+ * for mprotect(), so they do not use huge pages either.
+ */
+#define QP_HUGE_REGION	   (2U << 20)
+#define QP_HUGE_SLOT	   ((QP_CHUNK_BYTES + 63) & ~(size_t)63)
+#define QP_HUGE_MIN_CHUNKS 64
+
+typedef struct qp_hugepages {
+	void **region;
+	size_t count;
+	void *free;
+	char *next, *end;
+} qp_hugepages_t;
+
+static void *
+huge_region(void) {
+#if defined(MAP_HUGETLB) && defined(MAP_HUGE_SHIFT)
+	/* explicitly 2 MiB pages (1 << 21), not the default size */
+	void *ptr = mmap(NULL, QP_HUGE_REGION, PROT_READ | PROT_WRITE,
+			 MAP_ANON | MAP_PRIVATE | MAP_HUGETLB |
+				 (21 << MAP_HUGE_SHIFT),
+			 -1, 0);
+	if (ptr != MAP_FAILED) {
+		return (ptr);
+	}
+#endif
+
+	/*
+	 * No huge pages are reserved, so ask for transparent huge pages,
+	 * which need a suitably aligned region.
+	 */
+	char *raw = mmap(NULL, 2 * QP_HUGE_REGION, PROT_READ | PROT_WRITE,
+			 MAP_ANON | MAP_PRIVATE, -1, 0);
+	RUNTIME_CHECK(raw != MAP_FAILED);
+	char *start = (char *)(((uintptr_t)raw + QP_HUGE_REGION - 1) &
+			       ~(uintptr_t)(QP_HUGE_REGION - 1));
+	char *end = start + QP_HUGE_REGION;
+	if (start > raw) {
+		RUNTIME_CHECK(munmap(raw, start - raw) == 0);
+	}
+	if (end < raw + 2 * QP_HUGE_REGION) {
+		RUNTIME_CHECK(munmap(end, raw + 2 * QP_HUGE_REGION - end) ==
+			      0);
+	}
+#ifdef MADV_HUGEPAGE
+	(void)madvise(start, QP_HUGE_REGION, MADV_HUGEPAGE);
+#endif
+	return (start);
+}
+
+/*
+ * Returns NULL if the trie should use the ordinary allocator.
+ */
+static void *
+huge_chunk_get(dns_qp_t *qp) {
+	if (qp->transaction_mode == QP_NONE || qp->write_protect ||
+	    qp->chunk_max < QP_HUGE_MIN_CHUNKS)
+	{
+		return (NULL);
+	}
+
+	qp_hugepages_t *hp = qp->hugepages;
+	if (hp == NULL) {
+		hp = isc_mem_get(qp->mctx, sizeof(*hp));
+		*hp = (qp_hugepages_t){ 0 };
+		qp->hugepages = hp;
+	}
+
+	if (hp->free != NULL) {
+		void *ptr = hp->free;
+		hp->free = *(void **)ptr;
+		return (ptr);
+	}
+
+	if (hp->next == hp->end) {
+		hp->region = isc_mem_creget(qp->mctx, hp->region, hp->count,
+					    hp->count + 1, sizeof(void *));
+		hp->next = hp->region[hp->count++] = huge_region();
+		hp->end = hp->next +
+			  QP_HUGE_REGION / QP_HUGE_SLOT * QP_HUGE_SLOT;
+	}
+
+	void *ptr = hp->next;
+	hp->next += QP_HUGE_SLOT;
+	return (ptr);
+}
+
+static void
+huge_chunk_put(dns_qp_t *qp, void *ptr) {
+	qp_hugepages_t *hp = qp->hugepages;
+	INSIST(hp != NULL);
+	*(void **)ptr = hp->free;
+	hp->free = ptr;
+}
+
+static void
+huge_destroy(dns_qp_t *qp) {
+	qp_hugepages_t *hp = qp->hugepages;
+	if (hp == NULL) {
+		return;
+	}
+	for (size_t i = 0; i < hp->count; i++) {
+		RUNTIME_CHECK(munmap(hp->region[i], QP_HUGE_REGION) == 0);
+	}
+	isc_mem_cput(qp->mctx, hp->region, hp->count, sizeof(void *));
+	isc_mem_put(qp->mctx, hp, sizeof(*hp));
+	qp->hugepages = NULL;
+}
+
+#else
+
+#define huge_chunk_get(qp)	NULL
+#define huge_chunk_put(qp, ptr) UNREACHABLE()
+#define huge_destroy(qp)
+
+#endif
+
 /***********************************************************************
  *
  *  allocator
@@ -466,8 +594,18 @@ chunk_alloc(dns_qp_t *qp, dns_qpchunk_t chunk, dns_qpweight_t size) {
 	INSIST(qp->usage[chunk].used == 0);
 	INSIST(qp->usage[chunk].free == 0);
 
-	qp->base->ptr[chunk] = chunk_get_raw(qp);
-	qp->usage[chunk] = (qp_usage_t){ .exists = true, .used = size };
+	void *ptr = huge_chunk_get(qp);
+	bool huge = (ptr != NULL);
+	if (!huge) {
+		ptr = chunk_get_raw(qp);
+	}
+
+	qp->base->ptr[chunk] = ptr;
+	qp->usage[chunk] = (qp_usage_t){
+		.exists = true,
+		.used = size,
+		.huge = huge,
+	};
 	qp->used_count += size;
 	qp->bump = chunk;
 	qp->fender = 0;
@@ -655,7 +793,11 @@ chunk_free(dns_qp_t *qp, dns_qpchunk_t chunk) {
 		}
 	}
 	chunk_discount(qp, chunk);
-	chunk_free_raw(qp, qp->base->ptr[chunk]);
+	if (qp->usage[chunk].huge) {
+		huge_chunk_put(qp, qp->base->ptr[chunk]);
+	} else {
+		chunk_free_raw(qp, qp->base->ptr[chunk]);
+	}
 	qp->base->ptr[chunk] = NULL;
 	qp->usage[chunk] = (qp_usage_t){};
 }
@@ -892,42 +1034,84 @@ make_twigs_mutable(dns_qp_t *qp, dns_qpnode_t *n) {
  * nothing. So the evacuation check is the only place that the
  * algorithm introduces ref changes, that then bubble up towards the
  * root through the logic inside the loop.
+ *
+ * An incremental step stops before a child in the top QP_COMPACT_DEPTH
+ * levels when its budget runs out, and records the child's position in
+ * `compact_cursor`. The ref changes made so far still bubble up. The
+ * next step follows the cursor back down (with `resume` set) to carry
+ * on. If the trie was modified in between, the cursor can skip or
+ * repeat some subtries, which only delays their compaction.
  */
+typedef struct qp_compact {
+	size_t budget; /* branch nodes left to visit */
+	bool suspended;
+} qp_compact_t;
+
 static dns_qpref_t
-compact_recursive(dns_qp_t *qp, dns_qpnode_t *parent) {
+compact_recursive(dns_qp_t *qp, dns_qpnode_t *parent, qp_compact_t *gc,
+		  unsigned int depth, bool resume) {
 	dns_qpweight_t size = branch_twigs_size(parent);
 	dns_qpref_t twigs_ref = branch_twigs_ref(parent);
 	dns_qpchunk_t chunk = ref_chunk(twigs_ref);
+	dns_qpweight_t start = 0;
 
 	if (qp->compact_all ||
 	    (chunk != qp->bump && chunk_usage(qp, chunk) < QP_MIN_USED))
 	{
 		twigs_ref = evacuate(qp, parent);
 	}
+	if (gc->budget > 0) {
+		gc->budget--;
+	}
+	if (depth < QP_COMPACT_DEPTH) {
+		if (resume) {
+			start = ISC_MIN(qp->compact_cursor[depth], size);
+		}
+		qp->compact_cursor[depth] = 0;
+	}
 	bool immutable = cells_immutable(qp, twigs_ref);
-	for (dns_qpweight_t pos = 0; pos < size; pos++) {
+	for (dns_qpweight_t pos = start; pos < size; pos++) {
 		dns_qpnode_t *child = ref_ptr(qp, twigs_ref) + pos;
 		if (!is_branch(child)) {
 			continue;
 		}
+		if (depth < QP_COMPACT_DEPTH && gc->budget == 0) {
+			gc->suspended = true;
+			qp->compact_cursor[depth] = pos;
+			memset(&qp->compact_cursor[depth + 1], 0,
+			       QP_COMPACT_DEPTH - depth - 1);
+			break;
+		}
 		dns_qpref_t old_grandtwigs = branch_twigs_ref(child);
-		dns_qpref_t new_grandtwigs = compact_recursive(qp, child);
-		if (old_grandtwigs == new_grandtwigs) {
-			continue;
+		dns_qpref_t new_grandtwigs = compact_recursive(
+			qp, child, gc, depth + 1, resume && pos == start);
+		if (old_grandtwigs != new_grandtwigs) {
+			if (immutable) {
+				twigs_ref = evacuate(qp, parent);
+				/* the twigs have moved */
+				child = ref_ptr(qp, twigs_ref) + pos;
+				immutable = false;
+			}
+			*child = make_node(branch_index(child), new_grandtwigs);
 		}
-		if (immutable) {
-			twigs_ref = evacuate(qp, parent);
-			/* the twigs have moved */
-			child = ref_ptr(qp, twigs_ref) + pos;
-			immutable = false;
+		if (gc->suspended) {
+			/* the child stopped part way */
+			qp->compact_cursor[depth] = pos;
+			break;
 		}
-		*child = make_node(branch_index(child), new_grandtwigs);
 	}
 	return (twigs_ref);
 }
 
-static void
-compact(dns_qp_t *qp) {
+/*
+ * Compact the trie within the budget; a budget of SIZE_MAX compacts the
+ * whole trie from the start. Returns true if the compaction is complete.
+ */
+static bool
+compact_budget(dns_qp_t *qp, size_t budget) {
+	qp_compact_t gc = { .budget = budget };
+	bool resume = qp->compacting && budget != SIZE_MAX;
+
 	LOG_STATS("qp compact before leaf %u live %u used %u free %u hold %u",
 		  qp->leaf_count, qp->used_count - qp->free_count,
 		  qp->used_count, qp->free_count, qp->hold_count);
@@ -939,9 +1123,13 @@ compact(dns_qp_t *qp) {
 	}
 
 	if (qp->leaf_count > 0) {
-		qp->root_ref = compact_recursive(qp, MOVABLE_ROOT(qp));
+		qp->root_ref = compact_recursive(qp, MOVABLE_ROOT(qp), &gc, 0,
+						 resume);
+	}
+	qp->compacting = gc.suspended;
+	if (!gc.suspended) {
+		qp->compact_all = false;
 	}
-	qp->compact_all = false;
 
 	isc_nanosecs_t time = isc_time_monotonic() - start;
 	atomic_fetch_add_relaxed(&compact_time, time);
@@ -950,6 +1138,13 @@ compact(dns_qp_t *qp) {
 		  "leaf %u live %u used %u free %u hold %u",
 		  time, qp->leaf_count, qp->used_count - qp->free_count,
 		  qp->used_count, qp->free_count, qp->hold_count);
+
+	return (!gc.suspended);
+}
+
+static void
+compact(dns_qp_t *qp) {
+	compact_budget(qp, SIZE_MAX);
 }
 
 void
@@ -983,14 +1178,15 @@ dns_qp_compact(dns_qp_t *qp, dns_qpgc_t mode) {
  * when garbage collection might be worthwhile. Hence we can trigger
  * collection when garbage passes a threshold.
  *
- * XXXFANF: If we need to avoid latency outliers caused by compaction in
- * write transactions, we can check qp->transaction_mode here.
+ * To avoid latency outliers, each modification only does one step of
+ * an incremental compaction; while the trie stays fragmented, the
+ * following modifications do the rest.
  */
 static inline bool
 squash_twigs(dns_qp_t *qp, dns_qpref_t twigs, dns_qpweight_t size) {
 	bool destroyed = free_twigs(qp, twigs, size);
 	if (destroyed && QP_AUTOGC(qp)) {
-		compact(qp);
+		bool complete = compact_budget(qp, QP_COMPACT_STEP);
 		recycle(qp);
 		/*
 		 * This shouldn't happen if the garbage collector is
@@ -998,7 +1194,7 @@ squash_twigs(dns_qp_t *qp, dns_qpref_t twigs, dns_qpweight_t size) {
 		 * time and space, but recovery should be cheaper than
 		 * letting compact+recycle fail repeatedly.
 		 */
-		if (QP_AUTOGC(qp)) {
+		if (complete && QP_AUTOGC(qp)) {
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
 				      DNS_LOGMODULE_QP, ISC_LOG_NOTICE,
 				      "qp %p uctx \"%s\" compact/recycle "
@@ -1223,9 +1419,12 @@ dns_qpmulti_commit(dns_qpmulti_t *multi, dns_qp_t **qptp) {
 		/* minimize memory overhead */
 		compact(qp);
 		multi->reader_ref = alloc_twigs(qp, READER_SIZE);
-		qp->base->ptr[qp->bump] = chunk_shrink_raw(
-			qp, qp->base->ptr[qp->bump],
-			qp->usage[qp->bump].used * sizeof(dns_qpnode_t));
+		if (!qp->usage[qp->bump].huge) {
+			qp->base->ptr[qp->bump] = chunk_shrink_raw(
+				qp, qp->base->ptr[qp->bump],
+				qp->usage[qp->bump].used *
+					sizeof(dns_qpnode_t));
+		}
 	} else {
 		multi->reader_ref = alloc_twigs(qp, READER_SIZE);
 	}
@@ -1237,6 +1436,8 @@ dns_qpmulti_commit(dns_qpmulti_t *multi, dns_qp_t **qptp) {
 	isc_refcount_increment(&qp->base->refcount);
 
 	rcu_assign_pointer(multi->reader, reader); /* COMMIT */
+	/* paired with dns_qpmulti_query(); invalidates the replicas */
+	atomic_fetch_add_release(&multi->generation, 1);
 
 	/* clean up what we can right now */
 	if (qp->transaction_mode == QP_UPDATE || QP_NEEDGC(qp)) {
@@ -1294,7 +1495,14 @@ dns_qpmulti_rollback(dns_qpmulti_t *multi, dns_qp_t **qptp) {
 
 	/* reset allocator state */
 	INSIST(multi->rollback != NULL);
+#if ENABLE_QP_HUGEPAGES
+	/* the regions outlive the transaction */
+	struct qp_hugepages *hugepages = qp->hugepages;
 	memmove(qp, multi->rollback, sizeof(*qp));
+	qp->hugepages = hugepages;
+#else
+	memmove(qp, multi->rollback, sizeof(*qp));
+#endif
 	isc_mem_free(qp->mctx, multi->rollback);
 	INSIST(multi->rollback == NULL);
 
@@ -1324,6 +1532,166 @@ reader_open(dns_qpmulti_t *multi, dns_qpreadable_t qpr) {
 	return (multi);
 }
 
+/*
+ * Count the cells that a copy of the subtrie below branch `n` needs.
+ */
+static dns_qpref_t
+replica_cells(dns_qpreadable_t qp, dns_qpnode_t *n) {
+	dns_qpweight_t size = branch_twigs_size(n);
+	dns_qpnode_t *twigs = branch_twigs(qp, n);
+	dns_qpref_t cells = size;
+
+	for (dns_qpweight_t pos = 0; pos < size; pos++) {
+		if (is_branch(&twigs[pos])) {
+			cells += replica_cells(qp, &twigs[pos]);
+		}
+	}
+	return (cells);
+}
+
+/*
+ * Copy the twigs of `n`, which is already in the replica but still
+ * refers to the trie's twigs, depth first from cell `*next`.
+ */
+static void
+replica_copy(dns_qpreadable_t qp, dns_qpnode_t *nodes, dns_qpnode_t *n,
+	     dns_qpref_t *next) {
+	dns_qpweight_t size = branch_twigs_size(n);
+	dns_qpref_t ref = *next;
+
+	move_twigs(&nodes[ref], branch_twigs(qp, n), size);
+	*n = make_node(branch_index(n), ref);
+	*next += size;
+
+	for (dns_qpweight_t pos = 0; pos < size; pos++) {
+		if (is_branch(&nodes[ref + pos])) {
+			replica_copy(qp, nodes, &nodes[ref + pos], next);
+		}
+	}
+}
+
+static qp_replica_t *
+replica_make(dns_qpmulti_t *multi, dns_qpreadable_t qp, uint64_t generation) {
+	isc_mem_t *mctx = multi->writer.mctx;
+	dns_qpnode_t *root = get_root(qp);
+	dns_qpref_t cells = 1;
+	dns_qpref_t next = 1;
+
+	if (is_branch(root)) {
+		cells += replica_cells(qp, root);
+	}
+
+	dns_qpchunk_t chunks = (cells + QP_CHUNK_SIZE - 1) / QP_CHUNK_SIZE;
+	qp_replica_t *replica = isc_mem_get(mctx, sizeof(*replica));
+	*replica = (qp_replica_t){
+		.generation = generation,
+		.root_ref = 0,
+		.cells = cells,
+		.nodes = isc_mem_cget(mctx, cells, sizeof(dns_qpnode_t)),
+		.base = isc_mem_allocate(mctx,
+					 STRUCT_FLEX_SIZE(replica->base, ptr,
+							  chunks)),
+	};
+	isc_mem_attach(mctx, &replica->mctx);
+
+	replica->base->magic = QPBASE_MAGIC;
+	isc_refcount_init(&replica->base->refcount, 0);
+	for (dns_qpchunk_t chunk = 0; chunk < chunks; chunk++) {
+		replica->base->ptr[chunk] =
+			&replica->nodes[chunk * QP_CHUNK_SIZE];
+	}
+
+	replica->nodes[0] = *root;
+	if (is_branch(root)) {
+		replica_copy(qp, replica->nodes, &replica->nodes[0], &next);
+	}
+	INSIST(next == cells);
+
+	return (replica);
+}
+
+static void
+replica_free(qp_replica_t *replica) {
+	isc_refcount_destroy(&replica->base->refcount);
+	isc_mem_free(replica->mctx, replica->base);
+	isc_mem_cput(replica->mctx, replica->nodes, replica->cells,
+		     sizeof(dns_qpnode_t));
+	isc_mem_putanddetach(&replica->mctx, replica, sizeof(*replica));
+}
+
+static void
+replica_free_cb(struct rcu_head *arg) {
+	qp_replica_t *replica = caa_container_of(arg, qp_replica_t,
+						 rcu_head);
+	replica_free(replica);
+}
+
+/*
+ * Switch a query to its thread group's replica, making a new replica
+ * first if the group's copy is out of date.
+ *
+ * The reader was opened after `generation` was loaded, so it is either
+ * that version or the next one, if a commit has published its reader
+ * but not yet bumped the generation. If we check the generation has
+ * not changed after the reader was opened, a replica of the reader is
+ * safe to use for queries that see `generation`: their RCU critical
+ * sections started before the next commit, so the leaves of either
+ * version cannot be reclaimed underneath them.
+ */
+static void
+replica_open(dns_qpmulti_t *multi, qp_replicas_t *replicas, dns_qpread_t *qp,
+	     uint64_t generation) {
+	if (qp->tid == ISC_TID_UNKNOWN || qp->root_ref == INVALID_REF) {
+		return;
+	}
+
+	unsigned int i = (uint64_t)qp->tid * replicas->count / isc_tid_count();
+	qp_replica_t *replica = rcu_dereference(replicas->group[i].replica);
+
+	if (replica == NULL || replica->generation != generation) {
+		if (atomic_exchange_acquire(&replicas->group[i].busy, true)) {
+			/* another thread in this group is making a copy */
+			return;
+		}
+		if (generation != atomic_load_acquire(&multi->generation)) {
+			atomic_store_release(&replicas->group[i].busy, false);
+			return;
+		}
+		replica = replica_make(multi, qp, generation);
+		qp_replica_t *old = rcu_xchg_pointer(
+			&replicas->group[i].replica, replica);
+		if (old != NULL) {
+			call_rcu(&old->rcu_head, replica_free_cb);
+		}
+		atomic_store_release(&replicas->group[i].busy, false);
+	}
+
+	qp->base = replica->base;
+	qp->root_ref = replica->root_ref;
+}
+
+void
+dns_qpmulti_replicate(dns_qpmulti_t *multi, unsigned int groups) {
+	REQUIRE(QPMULTI_VALID(multi));
+	REQUIRE(groups > 0);
+
+	dns_qp_t *qp = &multi->writer;
+	qp_replicas_t *replicas = NULL;
+
+	replicas = isc_mem_get(qp->mctx,
+			       STRUCT_FLEX_SIZE(replicas, group, groups));
+	replicas->count = groups;
+	for (unsigned int i = 0; i < groups; i++) {
+		replicas->group[i].replica = NULL;
+		atomic_init(&replicas->group[i].busy, false);
+	}
+
+	LOCK(&multi->mutex);
+	REQUIRE(multi->replicas == NULL);
+	rcu_assign_pointer(multi->replicas, replicas);
+	UNLOCK(&multi->mutex);
+}
+
 /*
  * a query is light
  */
@@ -1336,8 +1704,14 @@ dns_qpmulti_query(dns_qpmulti_t *multi, dns_qpread_t *qp) {
 	qp->tid = isc_tid();
 	rcu_read_lock();
 
+	uint64_t generation = atomic_load_acquire(&multi->generation);
 	dns_qpmulti_t *whence = reader_open(multi, qp);
 	INSIST(whence == multi);
+
+	qp_replicas_t *replicas = rcu_dereference(multi->replicas);
+	if (replicas != NULL) {
+		replica_open(multi, replicas, qp, generation);
+	}
 }
 
 void
@@ -1478,6 +1852,7 @@ destroy_guts(dns_qp_t *qp) {
 	ENSURE(qp->used_count == 0);
 	ENSURE(qp->free_count == 0);
 	ENSURE(isc_refcount_current(&qp->base->refcount) == 1);
+	huge_destroy(qp);
 	isc_mem_free(qp->mctx, qp->base);
 	isc_mem_free(qp->mctx, qp->usage);
 	qp->magic = 0;
@@ -1517,6 +1892,17 @@ qpmulti_destroy_cb(struct rcu_head *arg) {
 
 	destroy_guts(qp);
 
+	if (multi->replicas != NULL) {
+		qp_replicas_t *replicas = multi->replicas;
+		for (unsigned int i = 0; i < replicas->count; i++) {
+			if (replicas->group[i].replica != NULL) {
+				replica_free(replicas->group[i].replica);
+			}
+		}
+		isc_mem_put(qp->mctx, replicas,
+			    STRUCT_FLEX_SIZE(replicas, group, replicas->count));
+	}
+
 	UNLOCK(&multi->mutex);
 
 	isc_mutex_destroy(&multi->mutex);
@@ -1767,6 +2153,176 @@ dns_qp_deletename(dns_qp_t *qp, const dns_name_t *name, void **pval_r,
 	return (dns_qp_deletekey(qp, key, keylen, pval_r, ival_r));
 }
 
+/***********************************************************************
+ *
+ *  bulk loading
+ */
+
+/*
+ * When leaves arrive in key order, the only part of the trie that can
+ * still change is the path to the most recent leaf. The bulk loader
+ * keeps that path as a stack of unfinished branches whose twigs are
+ * accumulated in one growable vector, with each branch's twigs after
+ * those of its parent. The most recently finished subtree (initially
+ * the previous leaf) is held in `pending` until we know which branch
+ * it belongs to; its twig is identified by the previous leaf's key.
+ */
+struct dns_qpbulk {
+	unsigned int magic;
+	dns_qp_t *qp;
+	dns_qpnode_t pending;
+	uint32_t leaf_count;
+	size_t depth;
+	size_t twigs_count;
+	size_t twigs_size;
+	dns_qpnode_t *twigs;
+	size_t keylen;
+	dns_qpkey_t key;
+	struct {
+		uint64_t index;
+		size_t base;
+	} level[DNS_QP_MAXKEY];
+};
+
+/*
+ * Add the pending subtree as a twig of the innermost unfinished branch.
+ */
+static void
+bulk_push_twig(dns_qpbulk_t *bulk) {
+	uint64_t *index = &bulk->level[bulk->depth - 1].index;
+	size_t offset = (size_t)(*index >> SHIFT_OFFSET);
+	dns_qpshift_t bit = qpkey_bit(bulk->key, bulk->keylen, offset);
+
+	*index |= 1ULL << bit;
+	if (bulk->twigs_count == bulk->twigs_size) {
+		size_t size = GROWTH_FACTOR(bulk->twigs_size);
+		bulk->twigs = isc_mem_creget(bulk->qp->mctx, bulk->twigs,
+					     bulk->twigs_size, size,
+					     sizeof(bulk->twigs[0]));
+		bulk->twigs_size = size;
+	}
+	bulk->twigs[bulk->twigs_count++] = bulk->pending;
+}
+
+/*
+ * The innermost unfinished branch has all its twigs, so copy them into
+ * the trie and make the branch node the pending subtree.
+ */
+static void
+bulk_pop_branch(dns_qpbulk_t *bulk) {
+	dns_qp_t *qp = bulk->qp;
+
+	bulk_push_twig(bulk);
+	bulk->depth--;
+
+	uint64_t index = bulk->level[bulk->depth].index;
+	size_t base = bulk->level[bulk->depth].base;
+	dns_qpweight_t size = bulk->twigs_count - base;
+	dns_qpref_t ref = alloc_twigs(qp, size);
+
+	move_twigs(ref_ptr(qp, ref), &bulk->twigs[base], size);
+	bulk->twigs_count = base;
+	bulk->pending = make_node(index, ref);
+}
+
+void
+dns_qp_bulkload(dns_qp_t *qp, dns_qpbulk_t **bulkp) {
+	REQUIRE(QP_VALID(qp));
+	REQUIRE(qp->leaf_count == 0);
+	REQUIRE(bulkp != NULL && *bulkp == NULL);
+
+	dns_qpbulk_t *bulk = isc_mem_get(qp->mctx, sizeof(*bulk));
+	*bulk = (dns_qpbulk_t){
+		.magic = QPBULK_MAGIC,
+		.qp = qp,
+	};
+	*bulkp = bulk;
+}
+
+isc_result_t
+dns_qpbulk_add(dns_qpbulk_t *bulk, void *pval, uint32_t ival) {
+	dns_qpnode_t new_leaf;
+	dns_qpkey_t new_key;
+	size_t new_keylen, offset;
+
+	REQUIRE(QPBULK_VALID(bulk));
+
+	new_leaf = make_leaf(pval, ival);
+	new_keylen = leaf_qpkey(bulk->qp, &new_leaf, new_key);
+
+	if (bulk->leaf_count > 0) {
+		offset = qpkey_compare(new_key, new_keylen, bulk->key,
+				       bulk->keylen);
+		if (offset == QPKEY_EQUAL) {
+			return (ISC_R_EXISTS);
+		}
+		if (qpkey_bit(new_key, new_keylen, offset) <
+		    qpkey_bit(bulk->key, bulk->keylen, offset))
+		{
+			return (ISC_R_RANGE);
+		}
+
+		/*
+		 * Branches below the point where the keys differ will
+		 * get no more twigs. If there is no branch at that point
+		 * we need a new one.
+		 */
+		while (bulk->depth > 0 &&
+		       offset < (bulk->level[bulk->depth - 1].index >>
+				 SHIFT_OFFSET))
+		{
+			bulk_pop_branch(bulk);
+		}
+		if (bulk->depth == 0 ||
+		    offset > (bulk->level[bulk->depth - 1].index >>
+			      SHIFT_OFFSET))
+		{
+			bulk->level[bulk->depth].index =
+				BRANCH_TAG | ((uint64_t)offset << SHIFT_OFFSET);
+			bulk->level[bulk->depth].base = bulk->twigs_count;
+			bulk->depth++;
+		}
+		bulk_push_twig(bulk);
+	}
+
+	attach_leaf(bulk->qp, &new_leaf);
+	bulk->leaf_count++;
+	bulk->pending = new_leaf;
+	bulk->keylen = new_keylen;
+	memmove(bulk->key, new_key, new_keylen);
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+dns_qpbulk_finish(dns_qpbulk_t **bulkp) {
+	dns_qpbulk_t *bulk = NULL;
+	dns_qp_t *qp = NULL;
+
+	REQUIRE(bulkp != NULL);
+	REQUIRE(QPBULK_VALID(*bulkp));
+
+	bulk = *bulkp;
+	*bulkp = NULL;
+	qp = bulk->qp;
+
+	while (bulk->depth > 0) {
+		bulk_pop_branch(bulk);
+	}
+	if (bulk->leaf_count > 0) {
+		qp->root_ref = alloc_twigs(qp, 1);
+		*ref_ptr(qp, qp->root_ref) = bulk->pending;
+		qp->leaf_count = bulk->leaf_count;
+	}
+
+	if (bulk->twigs != NULL) {
+		isc_mem_cput(qp->mctx, bulk->twigs, bulk->twigs_size,
+			     sizeof(bulk->twigs[0]));
+	}
+	bulk->magic = 0;
+	isc_mem_put(qp->mctx, bulk, sizeof(*bulk));
+}
+
 /***********************************************************************
  *  chains
  */
@@ -2017,6 +2573,126 @@ dns_qp_getname(dns_qpreadable_t qpr, const dns_name_t *name, void **pval_r,
 	return (dns_qp_getkey(qpr, key, keylen, pval_r, ival_r));
 }
 
+/*
+ * The number of searches that dns_qp_getkeys() runs side by side. While
+ * one search waits for its next twig vector to arrive from memory, the
+ * others can make progress.
+ */
+#define QP_BATCH 8
+
+void
+dns_qp_getkeys(dns_qpreadable_t qpr, size_t count, const dns_qpkey_t *keys,
+	       const size_t *keylens, void **pval_r, uint32_t *ival_r,
+	       isc_result_t *result_r) {
+	dns_qpreader_t *qp = dns_qpreader(qpr);
+	dns_qpnode_t *root = NULL;
+
+	REQUIRE(QP_VALID(qp));
+	REQUIRE(count == 0 ||
+		(keys != NULL && keylens != NULL && result_r != NULL));
+
+	root = get_root(qp);
+
+	for (size_t base = 0; base < count; base += QP_BATCH) {
+		dns_qpnode_t *node[QP_BATCH];
+		size_t batch = ISC_MIN(count - base, QP_BATCH);
+		size_t active = 0;
+
+		for (size_t i = 0; i < batch; i++) {
+			REQUIRE(keylens[base + i] < sizeof(dns_qpkey_t));
+			node[i] = root;
+		}
+		if (root != NULL && is_branch(root)) {
+			prefetch_twigs(qp, root);
+			active = batch;
+		}
+
+		/*
+		 * Take one step down the trie for each search in turn, and
+		 * prefetch the twigs for its next step, so that the cache
+		 * misses of the different searches overlap.
+		 */
+		while (active > 0) {
+			for (size_t i = 0; i < batch; i++) {
+				const uint8_t *key = keys[base + i];
+				size_t keylen = keylens[base + i];
+				dns_qpnode_t *n = node[i];
+				dns_qpshift_t bit;
+
+				if (n == NULL || !is_branch(n)) {
+					continue;
+				}
+
+				bit = branch_keybit(n, key, keylen);
+				if (!branch_has_twig(n, bit)) {
+					node[i] = NULL;
+					active--;
+					continue;
+				}
+
+				n = branch_twig_ptr(qp, n, bit);
+				if (is_branch(n)) {
+					prefetch_twigs(qp, n);
+				} else {
+					__builtin_prefetch(leaf_pval(n));
+					active--;
+				}
+				node[i] = n;
+			}
+		}
+
+		for (size_t i = 0; i < batch; i++) {
+			size_t k = base + i;
+			dns_qpnode_t *n = node[i];
+			dns_qpkey_t found_key;
+			size_t found_keylen;
+
+			result_r[k] = ISC_R_NOTFOUND;
+			if (n == NULL) {
+				continue;
+			}
+
+			found_keylen = leaf_qpkey(qp, n, found_key);
+			if (qpkey_compare(keys[k], keylens[k], found_key,
+					  found_keylen) != QPKEY_EQUAL)
+			{
+				continue;
+			}
+
+			result_r[k] = ISC_R_SUCCESS;
+			if (pval_r != NULL) {
+				pval_r[k] = leaf_pval(n);
+			}
+			if (ival_r != NULL) {
+				ival_r[k] = leaf_ival(n);
+			}
+		}
+	}
+}
+
+void
+dns_qp_getnames(dns_qpreadable_t qpr, size_t count,
+		const dns_name_t *const *names, void **pval_r,
+		uint32_t *ival_r, isc_result_t *result_r) {
+	dns_qpkey_t keys[QP_BATCH];
+	size_t keylens[QP_BATCH];
+
+	REQUIRE(count == 0 || (names != NULL && result_r != NULL));
+
+	for (size_t base = 0; base < count; base += QP_BATCH) {
+		size_t batch = ISC_MIN(count - base, QP_BATCH);
+
+		for (size_t i = 0; i < batch; i++) {
+			keylens[i] = dns_qpkey_fromname(keys[i],
+							names[base + i]);
+		}
+		dns_qp_getkeys(qpr, batch, keys, keylens,
+			       pval_r != NULL ? pval_r + base : NULL,
+			       ival_r != NULL ? ival_r + base : NULL,
+			       result_r + base);
+	}
+}
+
 static inline void
 add_link(dns_qpchain_t *chain, dns_qpnode_t *node, size_t offset) {
 	/* prevent duplication */
@@ -2195,11 +2871,48 @@ fix_iterator(dns_qpreader_t *qp, dns_qpiter_t *iter, dns_qpnode_t *start,
 	return (n);
 }
 
-isc_result_t
-dns_qp_lookup(dns_qpreadable_t qpr, const dns_name_t *name,
-	      dns_name_t *foundname, dns_qpiter_t *iter, dns_qpchain_t *chain,
-	      void **pval_r, uint32_t *ival_r) {
-	dns_qpreader_t *qp = dns_qpreader(qpr);
+/*
+ * A single query looks up its QNAME in several tries one after the
+ * other (zone table, RPZ, forwarders, cache, ...) and each lookup used
+ * to convert the name into a key from scratch. Remember the last
+ * search key computed on this thread, so that repeated lookups of the
+ * same name only need a comparison of the wire format and a copy.
+ */
+static thread_local struct {
+	size_t namelen;
+	size_t keylen;
+	uint8_t ndata[DNS_NAME_MAXWIRE];
+	dns_qpkey_t key;
+} lookup_memo = { 0 };
+
+static size_t
+lookup_key(dns_qpkey_t key, const dns_name_t *name) {
+	size_t keylen;
+
+	REQUIRE(ISC_MAGIC_VALID(name, DNS_NAME_MAGIC));
+
+	if (name->length != 0 && name->length == lookup_memo.namelen &&
+	    memcmp(name->ndata, lookup_memo.ndata, name->length) == 0)
+	{
+		/* include the trailing double NOBYTE */
+		memmove(key, lookup_memo.key, lookup_memo.keylen + 1);
+		return (lookup_memo.keylen);
+	}
+
+	keylen = dns_qpkey_fromname(key, name);
+	if (name->length != 0 && name->length <= DNS_NAME_MAXWIRE) {
+		memmove(lookup_memo.ndata, name->ndata, name->length);
+		memmove(lookup_memo.key, key, keylen + 1);
+		lookup_memo.namelen = name->length;
+		lookup_memo.keylen = keylen;
+	}
+	return (keylen);
+}
+
+static isc_result_t
+qp_lookup(dns_qpreader_t *qp, const dns_name_t *name, dns_name_t *foundname,
+	  dns_qpiter_t *iter, dns_qpchain_t *chain, void **pval_r,
+	  uint32_t *ival_r) {
 	dns_qpkey_t search, found;
 	size_t searchlen, foundlen;
 	size_t offset = 0;
@@ -2213,7 +2926,7 @@ dns_qp_lookup(dns_qpreadable_t qpr, const dns_name_t *name,
 	REQUIRE(QP_VALID(qp));
 	REQUIRE(foundname == NULL || ISC_MAGIC_VALID(name, DNS_NAME_MAGIC));
 
-	searchlen = dns_qpkey_fromname(search, name);
+	searchlen = lookup_key(search, name);
 
 	if (chain == NULL) {
 		chain = &oc;
@@ -2355,4 +3068,18 @@ dns_qp_lookup(dns_qpreadable_t qpr, const dns_name_t *name,
 	return (ISC_R_NOTFOUND);
 }
 
+isc_result_t
+dns_qp_lookup(dns_qpreadable_t qpr, const dns_name_t *name,
+	      dns_name_t *foundname, dns_qpiter_t *iter, dns_qpchain_t *chain,
+	      void **pval_r, uint32_t *ival_r) {
+	dns_qpreader_t *qp = dns_qpreader(qpr);
+	isc_result_t result;
+
+	LIBDNS_QP_LOOKUP_BEGIN(qp, (void *)name);
+	result = qp_lookup(qp, name, foundname, iter, chain, pval_r, ival_r);
+	LIBDNS_QP_LOOKUP_END(qp, (void *)name, result);
+
+	return (result);
+}
+
 /**********************************************************************/
@@ -183,6 +183,17 @@ STATIC_ASSERT(6 <= QP_CHUNK_LOG && QP_CHUNK_LOG <= 20,
 #define QP_NEEDGC(qp) QP_GC_HEURISTIC(qp, (qp)->free_count)
 #define QP_AUTOGC(qp) QP_GC_HEURISTIC(qp, (qp)->free_count - (qp)->hold_count)
 
+/*
+ * Automatic compaction is incremental, so that the time it adds to a
+ * modification does not depend on the size of the trie. Each step
+ * visits about QP_COMPACT_STEP branch nodes, and can stop at any of
+ * the top QP_COMPACT_DEPTH levels of the trie; the subtries below are
+ * compacted in one go. A step records where it stopped, and the next
+ * one carries on from there.
+ */
+#define QP_COMPACT_STEP	 4096
+#define QP_COMPACT_DEPTH 16
+
 /*
  * The chunk base and usage arrays are resized geometically and start off
  * with two entries.
@@ -280,6 +291,8 @@ typedef struct qp_usage {
 	bool snapfree : 1;
 	/*% for mark/sweep snapshot flag updates [MT] */
 	bool snapmark : 1;
+	/*% allocated from a huge page region [MT] */
+	bool huge : 1;
 } qp_usage_t;
 
 /*
@@ -324,6 +337,36 @@ typedef struct qp_rcuctx {
 	dns_qpchunk_t chunk[];
 } qp_rcuctx_t;
 
+/*
+ * A read-only copy of the interior nodes of one version of a
+ * multithreaded trie, used by the readers in one group of threads; see
+ * `dns_qpmulti_replicate()`. The nodes are a single contiguous
+ * allocation, so the `base` array just points into it at intervals of
+ * `QP_CHUNK_SIZE` cells. The leaf values are shared with the trie.
+ */
+typedef struct qp_replica {
+	struct rcu_head rcu_head;
+	isc_mem_t *mctx;
+	uint64_t generation;
+	dns_qpref_t root_ref;
+	dns_qpref_t cells;
+	dns_qpnode_t *nodes;
+	dns_qpbase_t *base;
+} qp_replica_t;
+
+/*
+ * The replicas of a trie, one per group of threads. A thread that finds
+ * its group's replica is out of date sets `busy` while it makes a new
+ * one, so the other threads in the group do not duplicate the work.
+ */
+typedef struct qp_replicas {
+	unsigned int count;
+	struct {
+		qp_replica_t *replica;
+		atomic_bool busy;
+	} group[];
+} qp_replicas_t;
+
 /*
  * Returns true when the base array can be free()d.
  */
@@ -356,6 +399,7 @@ ref_ptr(dns_qpreadable_t qpr, dns_qpref_t ref) {
 #define QPREADER_MAGIC ISC_MAGIC('q', 'p', 'r', 'x')
 #define QPBASE_MAGIC   ISC_MAGIC('q', 'p', 'b', 'p')
 #define QPRCU_MAGIC    ISC_MAGIC('q', 'p', 'c', 'b')
+#define QPBULK_MAGIC   ISC_MAGIC('q', 'p', 'b', 'l')
 
 #define QP_VALID(qp)	  ISC_MAGIC_VALID(qp, QP_MAGIC)
 #define QPITER_VALID(qp)  ISC_MAGIC_VALID(qp, QPITER_MAGIC)
@@ -363,6 +407,7 @@ ref_ptr(dns_qpreadable_t qpr, dns_qpref_t ref) {
 #define QPMULTI_VALID(qp) ISC_MAGIC_VALID(qp, QPMULTI_MAGIC)
 #define QPBASE_VALID(qp)  ISC_MAGIC_VALID(qp, QPBASE_MAGIC)
 #define QPRCU_VALID(qp)	  ISC_MAGIC_VALID(qp, QPRCU_MAGIC)
+#define QPBULK_VALID(qp)  ISC_MAGIC_VALID(qp, QPBULK_MAGIC)
 
 /*
  * Polymorphic initialization of the `dns_qpreader_t` prefix.
@@ -446,6 +491,10 @@ struct dns_qpsnap {
  *    normal compaction failed to clear the QP_MAX_GARBAGE() condition.
  *    (This emergency is a bug even tho we have a rescue mechanism.)
  *
+ *  - The `compacting` flag is set when an incremental compaction has
+ *    stopped part way through the trie. The `compact_cursor` holds the
+ *    twig position to resume from at each of the top levels.
+ *
  *  - When a qp-trie is destroyed while it has pending cleanup work, its
  *    `destroy` flag is set so that it is destroyed by the reclaim worker.
  *    (Because items cannot be removed from the middle of the cleanup list.)
@@ -477,10 +526,18 @@ struct dns_qp {
 	dns_qpcell_t used_count, free_count;
 	/*% free cells that cannot be recovered right now */
 	dns_qpcell_t hold_count;
+#if ENABLE_QP_HUGEPAGES
+	/*% huge page regions for chunks [MT] */
+	struct qp_hugepages *hugepages;
+#endif
+	/*% where an incremental compaction resumes */
+	uint8_t compact_cursor[QP_COMPACT_DEPTH];
 	/*% what kind of transaction was most recently started [MT] */
 	enum { QP_NONE, QP_WRITE, QP_UPDATE } transaction_mode : 2;
 	/*% compact the entire trie [MT] */
 	bool compact_all : 1;
+	/*% an incremental compaction is in progress */
+	bool compacting : 1;
 	/*% optionally when compiled with fuzzing support [MT] */
 	bool write_protect : 1;
 };
@@ -521,6 +578,10 @@ struct dns_qpmulti {
 	dns_qp_t *rollback;
 	/*% all snapshots of this trie */
 	ISC_LIST(dns_qpsnap_t) snapshots;
+	/*% incremented after each commit */
+	atomic_uint_fast64_t generation;
+	/*% RCU-protected pointer to per-thread-group copies for readers */
+	qp_replicas_t *replicas;
 };
 
 /***********************************************************************
@@ -24,7 +24,6 @@
 #include <isc/file.h>
 #include <isc/hash.h>
 #include <isc/hashmap.h>
-#include <isc/heap.h>
 #include <isc/hex.h>
 #include <isc/loop.h>
 #include <isc/mem.h>
@@ -62,6 +61,7 @@
 #include <dns/zonekey.h>
 
 #include "db_p.h"
+#include "probes.h"
 #include "qpcache_p.h"
 
 #define CHECK(op)                            \
@@ -107,6 +107,9 @@
 #define STATCOUNT(header)                              \
 	((atomic_load_acquire(&(header)->attributes) & \
 	  DNS_SLABHEADERATTR_STATCOUNT) != 0)
+#define VISITED(header)                                \
+	((atomic_load_acquire(&(header)->attributes) & \
+	  DNS_SLABHEADERATTR_VISITED) != 0)
 
 #define STALE_TTL(header, qpdb) \
 	(NXDOMAIN(header) ? 0 : qpdb->common.serve_stale_ttl)
@@ -144,6 +147,22 @@
  */
 #define QPDB_VIRTUAL 300
 
+/*%
+ * Whether to evict cache entries using SIEVE rather than LRU.
+ *
+ * With SIEVE, the per-bucket lists are kept in insertion order and a
+ * cache hit only sets the "visited" attribute of the header; entries
+ * never move on access, so hits do not need the node write lock.  When
+ * the cache is over its memory limit, a "hand" walks each list from the
+ * oldest entry towards the newest, clearing the attribute of visited
+ * entries and evicting the first unvisited one.  Entries that were
+ * looked up only once, such as the names of a random subdomain attack,
+ * are evicted before entries that are in regular use.
+ */
+#ifndef DNS_QPDB_SIEVE
+#define DNS_QPDB_SIEVE 1
+#endif
+
 /*%
  * Whether to rate-limit updating the LRU to avoid possible thread contention.
  * Updating LRU requires write locking, so we don't do it every time the
@@ -159,7 +178,7 @@
 #define DNS_QPDB_LRUUPDATE_REGULAR 600
 
 /*%
- * Number of buckets for cache DB entries (locks, LRU lists, TTL heaps).
+ * Number of buckets for cache DB entries (locks, LRU lists, TTL wheels).
  * There is a tradeoff issue about configuring this value: if this is too
  * small, it may cause heavier contention between threads; if this is too large,
  * LRU purge algorithm won't work well (entries tend to be purged prematurely).
@@ -186,6 +205,19 @@
  */
 #define DNS_QPDB_EXPIRE_TTL_COUNT 10
 
+/*%
+ * Each bucket keeps its headers on a TTL wheel: DNS_QPDB_WHEEL_SLOTS
+ * lists, each holding the headers that expire within the same period of
+ * DNS_QPDB_WHEEL_GRANULARITY seconds.  Headers that expire more than
+ * DNS_QPDB_WHEEL_SPAN seconds ahead share a slot with sooner ones, and
+ * are left in place when that slot is swept.  Adding a header or changing
+ * its TTL is a constant time list operation.
+ */
+#define DNS_QPDB_WHEEL_SLOTS	   256
+#define DNS_QPDB_WHEEL_GRANULARITY 16
+#define DNS_QPDB_WHEEL_SPAN \
+	(DNS_QPDB_WHEEL_SLOTS * DNS_QPDB_WHEEL_GRANULARITY)
+
 /*%
  * This is the structure that is used for each node in the qp trie of trees.
  * For now it is a copy of the dns_rbtnode structure.
@@ -213,6 +245,7 @@ struct dns_qpdata {
 	unsigned int		   : 0; /* start of bitfields c/o tree lock */
 	unsigned int find_callback : 1; /*%< range is 0..1 */
 	unsigned int nsec	   : 2; /*%< range is 0..3 */
+	unsigned int has_nsec3	   : 1; /*%< range is 0..1 */
 	unsigned int		   : 0; /* end of bitfields c/o tree lock */
 	/*@}*/
 
@@ -254,6 +287,35 @@ struct dns_qpdata {
 	/*@}*/
 };
 
+/*%
+ * Node lock buckets.  This is db_nodelock_t with a cache line of padding
+ * at the end: on a busy cache every lookup takes one of these locks and
+ * updates its reference count, and without the padding the counters of
+ * one bucket share a cache line with the lock word of the next one, so
+ * threads working in different buckets would still keep bouncing the
+ * same cache lines between CPUs.
+ */
+typedef struct qpcache_nodelock {
+	isc_rwlock_t lock;
+	/* Protected in the refcount routines. */
+	isc_refcount_t references;
+	/* Locked by lock. */
+	bool exiting;
+	uint8_t __padding[ISC_OS_CACHELINE_SIZE];
+} qpcache_nodelock_t;
+
+typedef struct qpcache_wheel {
+	/*
+	 * The start of the oldest period that has not been swept yet,
+	 * and the next header to look at in its slot (or NULL to start
+	 * from the head of the slot).
+	 */
+	isc_stdtime_t	  swept;
+	dns_slabheader_t *cursor;
+
+	dns_slabheaderlist_t slots[DNS_QPDB_WHEEL_SLOTS];
+} qpcache_wheel_t;
+
 typedef struct qpdb_changed {
 	dns_qpdata_t *node;
 	bool dirty;
@@ -271,7 +333,7 @@ struct dns_qpdb {
 	isc_rwlock_t tree_lock;
 	/* Locks for individual tree nodes */
 	unsigned int node_lock_count;
-	db_nodelock_t *node_locks;
+	qpcache_nodelock_t *node_locks;
 	dns_qpdata_t *origin_node;
 	dns_qpdata_t *nsec3_origin_node;
 	dns_stats_t *rrsetstats;     /* cache DB only */
@@ -301,6 +363,14 @@ struct dns_qpdb {
 	 */
 	dns_slabheaderlist_t *lru;
 
+#if DNS_QPDB_SIEVE
+	/*
+	 * The SIEVE hand for each of the lists above: the next header to
+	 * be considered for eviction, or NULL to start from the tail.
+	 */
+	dns_slabheader_t **hand;
+#endif /* DNS_QPDB_SIEVE */
+
 	/*
 	 * Start point % node_lock_count for next LRU cleanup.
 	 */
@@ -319,13 +389,12 @@ struct dns_qpdb {
 	dns_qpdatalist_t *deadnodes;
 
 	/*
-	 * Heaps.  These are used for TTL based expiry in a cache,
-	 * or for zone resigning in a zone DB.  hmctx is the memory
-	 * context to use for the heap (which differs from the main
-	 * database memory context in the case of a cache).
+	 * TTL wheels, one per bucket, used for TTL based expiry.  hmctx
+	 * is the memory context to use for them (which differs from the
+	 * main database memory context).
 	 */
 	isc_mem_t *hmctx;
-	isc_heap_t **heaps;
+	qpcache_wheel_t *wheels;
 
 	/* Locked by tree_lock. */
 	dns_qp_t *tree;
@@ -533,6 +602,9 @@ static atomic_uint_fast16_t init_count = 0;
  * may cause external queries at a higher level zone, involving more
  * transactions).
  *
+ * If DNS_QPDB_SIEVE is non 0, the entry is marked as visited, which
+ * is all that SIEVE needs, and this function always returns false.
+ *
  * Caller must hold the node (read or write) lock.
  */
 static bool
@@ -544,7 +616,17 @@ need_headerupdate(dns_slabheader_t *header, isc_stdtime_t now) {
 		return (false);
 	}
 
-#if DNS_QPDB_LIMITLRUUPDATE
+#if DNS_QPDB_SIEVE
+	UNUSED(now);
+
+	/*
+	 * Only write to the header the first time it is visited.
+	 */
+	if (!VISITED(header)) {
+		DNS_SLABHEADER_SETATTR(header, DNS_SLABHEADERATTR_VISITED);
+	}
+	return (false);
+#elif DNS_QPDB_LIMITLRUUPDATE
 	if (header->type == dns_rdatatype_ns ||
 	    (header->trust == dns_trust_glue &&
 	     (header->type == dns_rdatatype_a ||
@@ -571,11 +653,13 @@ need_headerupdate(dns_slabheader_t *header, isc_stdtime_t now) {
 
 /*%
  * Update the timestamp of a given cache entry and move it to the head
- * of the corresponding LRU list.
+ * of the corresponding LRU list.  With SIEVE, the entry is marked as
+ * visited instead and stays where it is.
  *
  * Caller must hold the node (write) lock.
  *
- * Note that the we do NOT touch the heap here, as the TTL has not changed.
+ * Note that the we do NOT touch the TTL wheel here, as the TTL has not
+ * changed.
  */
 static void
 update_header(dns_qpdb_t *qpdb, dns_slabheader_t *header, isc_stdtime_t now) {
@@ -584,11 +668,34 @@ update_header(dns_qpdb_t *qpdb, dns_slabheader_t *header, isc_stdtime_t now) {
 	/* To be checked: can we really assume this? XXXMLG */
 	INSIST(ISC_LINK_LINKED(header, link));
 
+	header->last_used = now;
+#if DNS_QPDB_SIEVE
+	if (!VISITED(header)) {
+		DNS_SLABHEADER_SETATTR(header, DNS_SLABHEADERATTR_VISITED);
+	}
+#else
 	ISC_LIST_UNLINK(qpdb->lru[QPDB_HEADERNODE(header)->locknum], header,
 			link);
-	header->last_used = now;
 	ISC_LIST_PREPEND(qpdb->lru[QPDB_HEADERNODE(header)->locknum], header,
 			 link);
+#endif /* DNS_QPDB_SIEVE */
+}
+
+/*%
+ * Remove a header from its LRU list, moving the SIEVE hand past it.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+unlink_header(dns_qpdb_t *qpdb, dns_slabheader_t *header) {
+	unsigned int locknum = QPDB_HEADERNODE(header)->locknum;
+
+#if DNS_QPDB_SIEVE
+	if (qpdb->hand[locknum] == header) {
+		qpdb->hand[locknum] = ISC_LIST_PREV(header, link);
+	}
+#endif /* DNS_QPDB_SIEVE */
+	ISC_LIST_UNLINK(qpdb->lru[locknum], header, link);
 }
 
 /*
@@ -673,6 +780,22 @@ delete_node(dns_qpdb_t *qpdb, dns_qpdata_t *node) {
 			      printname, node->locknum);
 	}
 
+	if (node->has_nsec3) {
+		/*
+		 * Delete the corresponding node from the auxiliary NSEC3
+		 * tree as well.
+		 */
+		result = dns_qp_deletename(qpdb->nsec3, &node->name, NULL,
+					   NULL);
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+				      DNS_LOGMODULE_CACHE, ISC_LOG_WARNING,
+				      "delete_node(): "
+				      "dns_qp_deletename: %s",
+				      isc_result_totext(result));
+		}
+	}
+
 	switch (node->nsec) {
 	case DNS_DB_NSEC_HAS_NSEC:
 		/*
@@ -771,7 +894,7 @@ decref(dns_qpdb_t *qpdb, dns_qpdata_t *node, uint32_t least_serial,
 	isc_result_t result;
 	bool locked = *tlocktypep != isc_rwlocktype_none;
 	bool write_locked = false;
-	db_nodelock_t *nodelock = NULL;
+	qpcache_nodelock_t *nodelock = NULL;
 	int bucket = node->locknum;
 	bool no_reference = true;
 	uint_fast32_t refs;
@@ -981,6 +1104,49 @@ mark(dns_slabheader_t *header, uint_least16_t flag) {
 	}
 }
 
+static unsigned int
+wheel_slot(isc_stdtime_t when) {
+	return ((when / DNS_QPDB_WHEEL_GRANULARITY) % DNS_QPDB_WHEEL_SLOTS);
+}
+
+/*
+ * Put a header on the TTL wheel of its bucket, in the slot for time
+ * 'when', or in the slot being swept if 'when' has already been swept.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+wheel_insert(dns_qpdb_t *qpdb, dns_slabheader_t *header, isc_stdtime_t when) {
+	qpcache_wheel_t *wheel =
+		&qpdb->wheels[QPDB_HEADERNODE(header)->locknum];
+	unsigned int slot;
+
+	if (when < wheel->swept) {
+		when = wheel->swept;
+	}
+	slot = wheel_slot(when);
+	ISC_LIST_APPEND(wheel->slots[slot], header, ttllink);
+	header->heap_index = slot + 1;
+}
+
+/*
+ * Take a header off its TTL wheel, moving the sweep cursor past it.
+ *
+ * Caller must hold the node (write) lock.
+ */
+static void
+wheel_unlink(dns_qpdb_t *qpdb, dns_slabheader_t *header) {
+	qpcache_wheel_t *wheel =
+		&qpdb->wheels[QPDB_HEADERNODE(header)->locknum];
+
+	if (wheel->cursor == header) {
+		wheel->cursor = ISC_LIST_NEXT(header, ttllink);
+	}
+	ISC_LIST_UNLINK(wheel->slots[header->heap_index - 1], header,
+			ttllink);
+	header->heap_index = 0;
+}
+
 static void
 setttl(dns_slabheader_t *header, dns_ttl_t newttl) {
 	dns_ttl_t oldttl = header->ttl;
@@ -992,21 +1158,18 @@ setttl(dns_slabheader_t *header, dns_ttl_t newttl) {
 	}
 
 	/*
-	 * This is a cache. Adjust the heaps if necessary.
+	 * This is a cache. Move the header to its new wheel slot.
 	 */
-	if (header->heap == NULL || header->heap_index == 0 || newttl == oldttl)
-	{
+	if (header->heap_index == 0 || newttl == oldttl) {
 		return;
 	}
 
-	if (newttl < oldttl) {
-		isc_heap_increased(header->heap, header->heap_index);
-	} else {
-		isc_heap_decreased(header->heap, header->heap_index);
-	}
-
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)header->db;
 	if (newttl == 0) {
-		isc_heap_delete(header->heap, header->heap_index);
+		wheel_unlink(qpdb, header);
+	} else if (wheel_slot(newttl) != header->heap_index - 1) {
+		wheel_unlink(qpdb, header);
+		wheel_insert(qpdb, header, newttl);
 	}
 }
 
@@ -1164,7 +1327,7 @@ bindrdataset(dns_qpdb_t *qpdb, dns_qpdata_t *node, dns_slabheader_t *header,
 		rdataset->ttl = header->ttl;
 	}
 
-	rdataset->count = atomic_fetch_add_relaxed(&header->count, 1);
+	rdataset->count = dns_slabheader_cycle(header);
 
 	rdataset->slab.db = (dns_db_t *)qpdb;
 	rdataset->slab.node = (dns_dbnode_t *)node;
@@ -1533,11 +1696,15 @@ find_deepest_zonecut(qpdb_search_t *search, dns_qpdata_t *node,
  * the potential NSEC owner. If found, we update 'foundname', 'nodep',
  * 'rdataset' and 'sigrdataset', and return DNS_R_COVERINGNSEC.
  * Otherwise, return ISC_R_NOTFOUND.
+ *
+ * If 'type' is NSEC3, 'name' is a hashed owner name, and the auxiliary
+ * NSEC3 tree is used instead to find the NSEC3 record that precedes it.
  */
 static isc_result_t
 find_coveringnsec(qpdb_search_t *search, const dns_name_t *name,
-		  dns_dbnode_t **nodep, isc_stdtime_t now,
-		  dns_name_t *foundname, dns_rdataset_t *rdataset,
+		  dns_rdatatype_t type, dns_dbnode_t **nodep,
+		  isc_stdtime_t now, dns_name_t *foundname,
+		  dns_rdataset_t *rdataset,
 		  dns_rdataset_t *sigrdataset DNS__DB_FLARG) {
 	dns_fixedname_t fpredecessor, fixed;
 	dns_name_t *predecessor = NULL, *fname = NULL;
@@ -1550,20 +1717,35 @@ find_coveringnsec(qpdb_search_t *search, const dns_name_t *name,
 	dns_slabheader_t *found = NULL, *foundsig = NULL;
 	dns_slabheader_t *header = NULL;
 	dns_slabheader_t *header_next = NULL, *header_prev = NULL;
+	dns_qp_t *tree = search->qpdb->nsec;
+
+	if (type != dns_rdatatype_nsec3) {
+		type = dns_rdatatype_nsec;
+	} else {
+		tree = search->qpdb->nsec3;
+	}
 
 	/*
 	 * Look for the node in the auxilary tree.
 	 */
-	result = dns_qp_lookup(search->qpdb->nsec, name, NULL, &iter, NULL,
-			       (void **)&node, NULL);
+	result = dns_qp_lookup(tree, name, NULL, &iter, NULL, (void **)&node,
+			       NULL);
+	if (result == ISC_R_NOTFOUND && type == dns_rdatatype_nsec3) {
+		/*
+		 * The NSEC3 tree holds no zone apex to match as an
+		 * ancestor, but the iterator still points to the
+		 * predecessor of 'name'.
+		 */
+		result = DNS_R_PARTIALMATCH;
+	}
 	if (result != DNS_R_PARTIALMATCH) {
 		return (ISC_R_NOTFOUND);
 	}
 
 	fname = dns_fixedname_initname(&fixed);
 	predecessor = dns_fixedname_initname(&fpredecessor);
-	matchtype = DNS_TYPEPAIR_VALUE(dns_rdatatype_nsec, 0);
-	sigmatchtype = DNS_SIGTYPE(dns_rdatatype_nsec);
+	matchtype = DNS_TYPEPAIR_VALUE(type, 0);
+	sigmatchtype = DNS_SIGTYPE(type);
 
 	/*
 	 * Extract predecessor from iterator.
@@ -1659,7 +1841,7 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	REQUIRE(version == NULL);
 
 	if (now == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	search = (qpdb_search_t){
@@ -1719,8 +1901,8 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		     search.zonecut_header->type != dns_rdatatype_dname))
 		{
 			result = find_coveringnsec(
-				&search, name, nodep, now, foundname, rdataset,
-				sigrdataset DNS__DB_FLARG_PASS);
+				&search, name, type, nodep, now, foundname,
+				rdataset, sigrdataset DNS__DB_FLARG_PASS);
 			if (result == DNS_R_COVERINGNSEC) {
 				goto tree_exit;
 			}
@@ -1881,8 +2063,8 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		NODE_UNLOCK(lock, &nlocktype);
 		if ((search.options & DNS_DBFIND_COVERINGNSEC) != 0) {
 			result = find_coveringnsec(
-				&search, name, nodep, now, foundname, rdataset,
-				sigrdataset DNS__DB_FLARG_PASS);
+				&search, name, type, nodep, now, foundname,
+				rdataset, sigrdataset DNS__DB_FLARG_PASS);
 			if (result == DNS_R_COVERINGNSEC) {
 				goto tree_exit;
 			}
@@ -1937,8 +2119,8 @@ find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 		{
 			NODE_UNLOCK(lock, &nlocktype);
 			result = find_coveringnsec(
-				&search, name, nodep, now, foundname, rdataset,
-				sigrdataset DNS__DB_FLARG_PASS);
+				&search, name, type, nodep, now, foundname,
+				rdataset, sigrdataset DNS__DB_FLARG_PASS);
 			if (result == DNS_R_COVERINGNSEC) {
 				goto tree_exit;
 			}
@@ -2088,7 +2270,7 @@ findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 	REQUIRE(VALID_QPDB((dns_qpdb_t *)db));
 
 	if (now == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	search = (qpdb_search_t){
@@ -2264,7 +2446,7 @@ findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	result = ISC_R_SUCCESS;
 
 	if (now == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	lock = &qpdb->node_locks[qpnode->locknum].lock;
@@ -2435,6 +2617,46 @@ rdataset_size(dns_slabheader_t *header) {
 	return (sizeof(*header));
 }
 
+#if DNS_QPDB_SIEVE
+static size_t
+expire_lru_headers(dns_qpdb_t *qpdb, unsigned int locknum,
+		   isc_rwlocktype_t *tlocktypep,
+		   size_t purgesize DNS__DB_FLARG) {
+	dns_slabheader_t *header = NULL;
+	size_t purged = 0;
+
+	while (purged <= purgesize) {
+		header = qpdb->hand[locknum];
+		if (header == NULL) {
+			header = ISC_LIST_TAIL(qpdb->lru[locknum]);
+			if (header == NULL) {
+				break;
+			}
+		}
+
+		/*
+		 * Move the hand before expiring the header: cleaning up
+		 * the node may free other headers in this list, and
+		 * unlink_header() keeps the hand valid when that happens.
+		 */
+		qpdb->hand[locknum] = ISC_LIST_PREV(header, link);
+
+		if (VISITED(header)) {
+			DNS_SLABHEADER_CLRATTR(header,
+					       DNS_SLABHEADERATTR_VISITED);
+			continue;
+		}
+
+		size_t header_size = rdataset_size(header);
+		ISC_LIST_UNLINK(qpdb->lru[locknum], header, link);
+		expireheader(header, tlocktypep,
+			     dns_expire_lru DNS__DB_FLARG_PASS);
+		purged += header_size;
+	}
+
+	return (purged);
+}
+#else  /* DNS_QPDB_SIEVE */
 static size_t
 expire_lru_headers(dns_qpdb_t *qpdb, unsigned int locknum,
 		   isc_rwlocktype_t *tlocktypep,
@@ -2464,6 +2686,7 @@ expire_lru_headers(dns_qpdb_t *qpdb, unsigned int locknum,
 
 	return (purged);
 }
+#endif /* DNS_QPDB_SIEVE */
 
 /*%
  * Purge some expired and/or stale (i.e. unused for some period) cache entries
@@ -2472,6 +2695,7 @@ expire_lru_headers(dns_qpdb_t *qpdb, unsigned int locknum,
  * the overmem; this is accessible via newheader.
  *
  * The LRU lists tails are processed in LRU order to the nearest second.
+ * With SIEVE, each list is swept by its own hand instead.
  *
  * A write lock on the tree must be held.
  */
@@ -2495,6 +2719,7 @@ again:
 					     purgesize -
 						     purged DNS__DB_FLARG_PASS);
 
+#if !DNS_QPDB_SIEVE
 		/*
 		 * Work out the oldest remaining last_used values of the list
 		 * tails as we walk across the array of lru lists.
@@ -2505,6 +2730,7 @@ again:
 		{
 			min_last_used = header->last_used;
 		}
+#endif /* !DNS_QPDB_SIEVE */
 		NODE_UNLOCK(&qpdb->node_locks[locknum].lock, &nlocktype);
 		locknum = (locknum + 1) % qpdb->node_lock_count;
 	} while (locknum != locknum_start && purged <= purgesize);
@@ -2547,28 +2773,6 @@ prio_type(dns_typepair_t type) {
 	return (false);
 }
 
-/*%
- * These functions allow the heap code to rank the priority of each
- * element.  It returns true if v1 happens "sooner" than v2.
- */
-static bool
-ttl_sooner(void *v1, void *v2) {
-	dns_slabheader_t *h1 = v1;
-	dns_slabheader_t *h2 = v2;
-
-	return (h1->ttl < h2->ttl);
-}
-
-/*%
- * This function sets the heap index into the header.
- */
-static void
-set_index(void *what, unsigned int idx) {
-	dns_slabheader_t *h = what;
-
-	h->heap_index = idx;
-}
-
 static void
 free_qpdb(dns_qpdb_t *qpdb, bool log) {
 	unsigned int i;
@@ -2642,6 +2846,12 @@ free_qpdb(dns_qpdb_t *qpdb, bool log) {
 			     qpdb->node_lock_count,
 			     sizeof(dns_slabheaderlist_t));
 	}
+#if DNS_QPDB_SIEVE
+	if (qpdb->hand != NULL) {
+		isc_mem_cput(qpdb->common.mctx, qpdb->hand,
+			     qpdb->node_lock_count, sizeof(qpdb->hand[0]));
+	}
+#endif /* DNS_QPDB_SIEVE */
 	/*
 	 * Clean up dead node buckets.
 	 */
@@ -2653,14 +2863,17 @@ free_qpdb(dns_qpdb_t *qpdb, bool log) {
 			     qpdb->node_lock_count, sizeof(dns_qpdatalist_t));
 	}
 	/*
-	 * Clean up heap objects.
+	 * Clean up TTL wheels.
 	 */
-	if (qpdb->heaps != NULL) {
+	if (qpdb->wheels != NULL) {
 		for (i = 0; i < qpdb->node_lock_count; i++) {
-			isc_heap_destroy(&qpdb->heaps[i]);
+			qpcache_wheel_t *wheel = &qpdb->wheels[i];
+			for (size_t j = 0; j < DNS_QPDB_WHEEL_SLOTS; j++) {
+				INSIST(ISC_LIST_EMPTY(wheel->slots[j]));
+			}
 		}
-		isc_mem_cput(qpdb->hmctx, qpdb->heaps, qpdb->node_lock_count,
-			     sizeof(isc_heap_t *));
+		isc_mem_cput(qpdb->hmctx, qpdb->wheels, qpdb->node_lock_count,
+			     sizeof(qpcache_wheel_t));
 	}
 
 	if (qpdb->rrsetstats != NULL) {
@@ -2674,7 +2887,7 @@ free_qpdb(dns_qpdb_t *qpdb, bool log) {
 	}
 
 	isc_mem_cput(qpdb->common.mctx, qpdb->node_locks, qpdb->node_lock_count,
-		     sizeof(db_nodelock_t));
+		     sizeof(qpcache_nodelock_t));
 	TREE_DESTROYLOCK(&qpdb->tree_lock);
 	isc_refcount_destroy(&qpdb->common.references);
 	if (qpdb->loop != NULL) {
@@ -2912,6 +3125,73 @@ unlock:
 	return (result);
 }
 
+/*
+ * Find or create the nodes for a set of names, such as all the owner
+ * names in a response that is being cached: the names that are already
+ * in the tree are looked up under one read lock, and any that are
+ * missing are then added under one write lock.
+ */
+static isc_result_t
+findnodes(dns_db_t *db, const dns_name_t **names, size_t count,
+	  dns_dbnode_t **nodes DNS__DB_FLARG) {
+	dns_qpdb_t *qpdb = (dns_qpdb_t *)db;
+	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	size_t missing = 0;
+
+	REQUIRE(VALID_QPDB(qpdb));
+
+	TREE_RDLOCK(&qpdb->tree_lock, &tlocktype);
+	for (size_t i = 0; i < count; i++) {
+		dns_qpdata_t *node = NULL;
+		isc_result_t result;
+
+		REQUIRE(nodes[i] == NULL);
+
+		result = dns_qp_lookup(qpdb->tree, names[i], NULL, NULL, NULL,
+				       (void **)&node, NULL);
+		if (result != ISC_R_SUCCESS) {
+			missing++;
+			continue;
+		}
+
+		/*
+		 * Take the reference now, as the tree lock may be dropped
+		 * while it is being upgraded below.
+		 */
+		reactivate_node(qpdb, node, tlocktype DNS__DB_FLARG_PASS);
+		nodes[i] = (dns_dbnode_t *)node;
+	}
+
+	if (missing > 0) {
+		TREE_FORCEUPGRADE(&qpdb->tree_lock, &tlocktype);
+		for (size_t i = 0; i < count; i++) {
+			dns_qpdata_t *node = NULL;
+			isc_result_t result;
+
+			if (nodes[i] != NULL) {
+				continue;
+			}
+
+			result = dns_qp_lookup(qpdb->tree, names[i], NULL,
+					       NULL, NULL, (void **)&node,
+					       NULL);
+			if (result != ISC_R_SUCCESS) {
+				node = new_qpdata(qpdb, names[i]);
+				result = dns_qp_insert(qpdb->tree, node, 0);
+				INSIST(result == ISC_R_SUCCESS);
+				dns_qpdata_unref(node);
+			}
+
+			reactivate_node(qpdb, node,
+					tlocktype DNS__DB_FLARG_PASS);
+			nodes[i] = (dns_dbnode_t *)node;
+		}
+	}
+	TREE_UNLOCK(&qpdb->tree_lock, &tlocktype);
+
+	return (ISC_R_SUCCESS);
+}
+
 static void
 attachnode(dns_db_t *db, dns_dbnode_t *source,
 	   dns_dbnode_t **targetp DNS__DB_FLARG) {
@@ -2932,7 +3212,7 @@ detachnode(dns_db_t *db, dns_dbnode_t **targetp DNS__DB_FLARG) {
 	dns_qpdata_t *node = NULL;
 	bool want_free = false;
 	bool inactive = false;
-	db_nodelock_t *nodelock = NULL;
+	qpcache_nodelock_t *nodelock = NULL;
 	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
 	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
 
@@ -3013,7 +3293,11 @@ createiterator(dns_db_t *db, unsigned int options,
 	} else if ((options & DNS_DB_NONSEC3) != 0) {
 		qpdbiter->nsec3mode = nonsec3;
 	} else {
-		qpdbiter->nsec3mode = full;
+		/*
+		 * All cached data lives in the main tree; the NSEC3 tree
+		 * only indexes its NSEC3 nodes.
+		 */
+		qpdbiter->nsec3mode = nonsec3;
 	}
 	dns_qpiter_init(qpdb->tree, &qpdbiter->iter);
 	dns_qpiter_init(qpdb->nsec3, &qpdbiter->nsec3iter);
@@ -3042,7 +3326,7 @@ allrdatasets(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	iterator = isc_mem_get(qpdb->common.mctx, sizeof(*iterator));
 
 	if (now == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	iterator->common.magic = DNS_RDATASETITER_MAGIC;
@@ -3253,15 +3537,7 @@ find_header:
 				setttl(header, newheader->ttl);
 			}
 			if (header->last_used != now) {
-				ISC_LIST_UNLINK(
-					qpdb->lru[QPDB_HEADERNODE(header)
-							  ->locknum],
-					header, link);
-				header->last_used = now;
-				ISC_LIST_PREPEND(
-					qpdb->lru[QPDB_HEADERNODE(header)
-							  ->locknum],
-					header, link);
+				update_header(qpdb, header, now);
 			}
 			if (header->noqname == NULL &&
 			    newheader->noqname != NULL)
@@ -3317,15 +3593,7 @@ find_header:
 				setttl(header, newheader->ttl);
 			}
 			if (header->last_used != now) {
-				ISC_LIST_UNLINK(
-					qpdb->lru[QPDB_HEADERNODE(header)
-							  ->locknum],
-					header, link);
-				header->last_used = now;
-				ISC_LIST_PREPEND(
-					qpdb->lru[QPDB_HEADERNODE(header)
-							  ->locknum],
-					header, link);
+				update_header(qpdb, header, now);
 			}
 			if (header->noqname == NULL &&
 			    newheader->noqname != NULL)
@@ -3359,9 +3627,7 @@ find_header:
 				ISC_LIST_PREPEND(qpdb->lru[idx], newheader,
 						 link);
 			}
-			INSIST(qpdb->heaps != NULL);
-			isc_heap_insert(qpdb->heaps[idx], newheader);
-			newheader->heap = qpdb->heaps[idx];
+			wheel_insert(qpdb, newheader, newheader->ttl);
 
 			/*
 			 * There are no other references to 'header' when
@@ -3378,9 +3644,7 @@ find_header:
 			dns_slabheader_destroy(&header);
 		} else {
 			idx = QPDB_HEADERNODE(newheader)->locknum;
-			INSIST(qpdb->heaps != NULL);
-			isc_heap_insert(qpdb->heaps[idx], newheader);
-			newheader->heap = qpdb->heaps[idx];
+			wheel_insert(qpdb, newheader, newheader->ttl);
 			if (ZEROTTL(newheader)) {
 				newheader->last_used = qpdb->last_used + 1;
 				ISC_LIST_APPEND(qpdb->lru[idx], newheader,
@@ -3418,8 +3682,7 @@ find_header:
 		}
 
 		idx = QPDB_HEADERNODE(newheader)->locknum;
-		isc_heap_insert(qpdb->heaps[idx], newheader);
-		newheader->heap = qpdb->heaps[idx];
+		wheel_insert(qpdb, newheader, newheader->ttl);
 		if (ZEROTTL(newheader)) {
 			ISC_LIST_APPEND(qpdb->lru[idx], newheader, link);
 		} else {
@@ -3568,6 +3831,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	isc_result_t result;
 	bool delegating = false;
 	bool newnsec;
+	bool newnsec3;
 	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
 	isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
 	bool cache_is_overmem = false;
@@ -3577,13 +3841,16 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	REQUIRE(VALID_QPDB(qpdb));
 	REQUIRE(version == NULL);
 
+	LIBDNS_QPCACHE_ADDRDATASET_BEGIN(db, node);
+
 	if (now == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	result = dns_rdataslab_fromrdataset(rdataset, qpdb->common.mctx,
 					    &region, sizeof(dns_slabheader_t));
 	if (result != ISC_R_SUCCESS) {
+		LIBDNS_QPCACHE_ADDRDATASET_END(db, node, result);
 		return (result);
 	}
 
@@ -3604,8 +3871,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	if (rdataset->ttl == 0U) {
 		DNS_SLABHEADER_SETATTR(newheader, DNS_SLABHEADERATTR_ZEROTTL);
 	}
-	atomic_init(&newheader->count,
-		    atomic_fetch_add_relaxed(&init_count, 1));
+	newheader->count = atomic_fetch_add_relaxed(&init_count, 1);
 	newheader->serial = 1;
 	if ((rdataset->attributes & DNS_RDATASETATTR_PREFETCH) != 0) {
 		DNS_SLABHEADER_SETATTR(newheader, DNS_SLABHEADERATTR_PREFETCH);
@@ -3623,6 +3889,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		result = addnoqname(qpdb->common.mctx, newheader, rdataset);
 		if (result != ISC_R_SUCCESS) {
 			dns_slabheader_destroy(&newheader);
+			LIBDNS_QPCACHE_ADDRDATASET_END(db, node, result);
 			return (result);
 		}
 	}
@@ -3630,6 +3897,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		result = addclosest(qpdb->common.mctx, newheader, rdataset);
 		if (result != ISC_R_SUCCESS) {
 			dns_slabheader_destroy(&newheader);
+			LIBDNS_QPCACHE_ADDRDATASET_END(db, node, result);
 			return (result);
 		}
 	}
@@ -3644,7 +3912,8 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	}
 
 	/*
-	 * Add to the auxiliary NSEC tree if we're adding an NSEC record.
+	 * Add to the auxiliary NSEC or NSEC3 tree if we're adding an NSEC
+	 * or NSEC3 record.
 	 */
 	TREE_RDLOCK(&qpdb->tree_lock, &tlocktype);
 	if (qpnode->nsec != DNS_DB_NSEC_HAS_NSEC &&
@@ -3654,10 +3923,12 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	} else {
 		newnsec = false;
 	}
+	newnsec3 = (!qpnode->has_nsec3 &&
+		    rdataset->type == dns_rdatatype_nsec3);
 	TREE_UNLOCK(&qpdb->tree_lock, &tlocktype);
 
 	/*
-	 * If we're adding a delegation type, adding to the auxiliary NSEC
+	 * If we're adding a delegation type, adding to an auxiliary
 	 * tree, or the DB is a cache in an overmem state, hold an
 	 * exclusive lock on the tree.  In the latter case the lock does
 	 * not necessarily have to be acquired but it will help purge
@@ -3666,7 +3937,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	if (isc_mem_isovermem(qpdb->common.mctx)) {
 		cache_is_overmem = true;
 	}
-	if (delegating || newnsec || cache_is_overmem) {
+	if (delegating || newnsec || newnsec3 || cache_is_overmem) {
 		TREE_WRLOCK(&qpdb->tree_lock, &tlocktype);
 	}
 
@@ -3695,7 +3966,9 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	 * cleaning, we can release it now.  However, we still need the
 	 * node lock.
 	 */
-	if (tlocktype == isc_rwlocktype_write && !delegating && !newnsec) {
+	if (tlocktype == isc_rwlocktype_write && !delegating && !newnsec &&
+	    !newnsec3)
+	{
 		TREE_UNLOCK(&qpdb->tree_lock, &tlocktype);
 	}
 
@@ -3717,6 +3990,22 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 		}
 		qpnode->nsec = DNS_DB_NSEC_HAS_NSEC;
 	}
+	if (newnsec3) {
+		dns_qpdata_t *nsecnode = NULL;
+
+		result = dns_qp_getname(qpdb->nsec3, name, (void **)&nsecnode,
+					NULL);
+		if (result != ISC_R_SUCCESS) {
+			INSIST(nsecnode == NULL);
+			nsecnode = new_qpdata(qpdb, name);
+			nsecnode->nsec = DNS_DB_NSEC_NSEC3;
+			result = dns_qp_insert(qpdb->nsec3, nsecnode, 0);
+			INSIST(result == ISC_R_SUCCESS);
+			dns_qpdata_detach(&nsecnode);
+		}
+		qpnode->has_nsec3 = 1;
+		result = ISC_R_SUCCESS;
+	}
 
 	if (result == ISC_R_SUCCESS) {
 		result = add(qpdb, qpnode, name, newheader, options, false,
@@ -3733,6 +4022,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	}
 	INSIST(tlocktype == isc_rwlocktype_none);
 
+	LIBDNS_QPCACHE_ADDRDATASET_END(db, node, result);
 	return (result);
 }
 
@@ -3873,7 +4163,8 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	isc_refcount_init(&qpdb->common.references, 1);
 
 	/*
-	 * If argv[0] exists, it points to a memory context to use for heap
+	 * If argv[0] exists, it points to a memory context to use for the
+	 * TTL wheels
 	 */
 	if (argc != 0) {
 		hmctx = (isc_mem_t *)argv[0];
@@ -3896,7 +4187,7 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	}
 	INSIST(qpdb->node_lock_count < (1 << DNS_RBT_LOCKLENGTH));
 	qpdb->node_locks = isc_mem_cget(mctx, qpdb->node_lock_count,
-					sizeof(db_nodelock_t));
+					sizeof(qpcache_nodelock_t));
 
 	qpdb->common.update_listeners = cds_lfht_new(16, 16, 0, 0, NULL);
 
@@ -3906,19 +4197,23 @@ dns__qpcache_create(isc_mem_t *mctx, const dns_name_t *origin,
 	for (i = 0; i < (int)qpdb->node_lock_count; i++) {
 		ISC_LIST_INIT(qpdb->lru[i]);
 	}
+#if DNS_QPDB_SIEVE
+	qpdb->hand = isc_mem_cget(mctx, qpdb->node_lock_count,
+				  sizeof(qpdb->hand[0]));
+#endif /* DNS_QPDB_SIEVE */
 
 	/*
-	 * Create the heaps.
+	 * Create the TTL wheels.
 	 */
-	qpdb->heaps = isc_mem_cget(hmctx, qpdb->node_lock_count,
-				   sizeof(isc_heap_t *));
-	for (i = 0; i < (int)qpdb->node_lock_count; i++) {
-		qpdb->heaps[i] = NULL;
-	}
-
+	isc_stdtime_t swept = isc_stdtime_now() - QPDB_VIRTUAL;
+	swept -= swept % DNS_QPDB_WHEEL_GRANULARITY;
+	qpdb->wheels = isc_mem_cget(hmctx, qpdb->node_lock_count,
+				    sizeof(qpcache_wheel_t));
 	for (i = 0; i < (int)qpdb->node_lock_count; i++) {
-		isc_heap_create(hmctx, ttl_sooner, set_index, 0,
-				&qpdb->heaps[i]);
+		qpdb->wheels[i].swept = swept;
+		for (size_t j = 0; j < DNS_QPDB_WHEEL_SLOTS; j++) {
+			ISC_LIST_INIT(qpdb->wheels[i].slots[j]);
+		}
 	}
 
 	/*
@@ -4698,16 +4993,15 @@ deletedata(dns_db_t *db ISC_ATTR_UNUSED, dns_dbnode_t *node ISC_ATTR_UNUSED,
 	dns_slabheader_t *header = data;
 	dns_qpdb_t *qpdb = (dns_qpdb_t *)header->db;
 
-	if (header->heap != NULL && header->heap_index != 0) {
-		isc_heap_delete(header->heap, header->heap_index);
+	if (header->heap_index != 0) {
+		wheel_unlink(qpdb, header);
 	}
 
 	update_rrsetstats(qpdb->rrsetstats, header->type,
 			  atomic_load_acquire(&header->attributes), false);
 
 	if (ISC_LINK_LINKED(header, link)) {
-		int idx = QPDB_HEADERNODE(header)->locknum;
-		ISC_LIST_UNLINK(qpdb->lru[idx], header, link);
+		unlink_header(qpdb, header);
 	}
 
 	if (header->noqname != NULL) {
@@ -4725,16 +5019,42 @@ static void
 expire_ttl_headers(dns_qpdb_t *qpdb, unsigned int locknum,
 		   isc_rwlocktype_t *tlocktypep, isc_stdtime_t now,
 		   bool cache_is_overmem DNS__DB_FLARG) {
-	isc_heap_t *heap = qpdb->heaps[locknum];
+	qpcache_wheel_t *wheel = &qpdb->wheels[locknum];
+	isc_stdtime_t limit = now - QPDB_VIRTUAL;
+	size_t visited = 0;
 
-	for (size_t i = 0; i < DNS_QPDB_EXPIRE_TTL_COUNT; i++) {
-		dns_slabheader_t *header = isc_heap_element(heap, 1);
+	if (limit > wheel->swept + DNS_QPDB_WHEEL_SPAN) {
+		/*
+		 * Nothing was added to this bucket for a while; sweeping
+		 * the last rotation of the wheel visits every slot.
+		 */
+		wheel->swept = limit - DNS_QPDB_WHEEL_SPAN;
+		wheel->swept -= wheel->swept % DNS_QPDB_WHEEL_GRANULARITY;
+		wheel->cursor = NULL;
+	}
+
+	while (wheel->swept + DNS_QPDB_WHEEL_GRANULARITY <= limit &&
+	       visited < DNS_QPDB_EXPIRE_TTL_COUNT)
+	{
+		unsigned int slot = wheel_slot(wheel->swept);
+		dns_slabheader_t *header = wheel->cursor;
 
 		if (header == NULL) {
-			/* No headers left on this TTL heap; exit cleaning */
-			return;
+			header = ISC_LIST_HEAD(wheel->slots[slot]);
+			if (header == NULL) {
+				wheel->swept += DNS_QPDB_WHEEL_GRANULARITY;
+				continue;
+			}
 		}
 
+		/*
+		 * Move the cursor first: expiring the header may free
+		 * other headers in this bucket, and wheel_unlink() keeps
+		 * the cursor valid when that happens.
+		 */
+		wheel->cursor = ISC_LIST_NEXT(header, ttllink);
+		visited++;
+
 		dns_ttl_t ttl = header->ttl;
 
 		if (!cache_is_overmem) {
@@ -4742,24 +5062,28 @@ expire_ttl_headers(dns_qpdb_t *qpdb, unsigned int locknum,
 			ttl += STALE_TTL(header, qpdb);
 		}
 
-		if (ttl >= now - QPDB_VIRTUAL) {
+		if (ttl < limit) {
+			expireheader(header, tlocktypep,
+				     dns_expire_ttl DNS__DB_FLARG_PASS);
+		} else if (wheel_slot(ttl) != slot) {
 			/*
-			 * The header at the top of this TTL heap is not yet
-			 * eligible for expiry, so none of the other headers on
-			 * the same heap can be eligible for expiry, either;
-			 * exit cleaning.
+			 * Still serving stale, or beyond the span of the
+			 * wheel; move it to the slot where it is due.
 			 */
-			return;
+			wheel_unlink(qpdb, header);
+			wheel_insert(qpdb, header, ttl);
 		}
 
-		expireheader(header, tlocktypep,
-			     dns_expire_ttl DNS__DB_FLARG_PASS);
+		if (wheel->cursor == NULL) {
+			wheel->swept += DNS_QPDB_WHEEL_GRANULARITY;
+		}
 	}
 }
 
 static dns_dbmethods_t qpdb_cachemethods = {
 	.destroy = qpdb_destroy,
 	.findnode = findnode,
+	.findnodes = findnodes,
 	.find = find,
 	.findzonecut = findzonecut,
 	.attachnode = attachnode,
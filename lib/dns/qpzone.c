@@ -22,6 +22,7 @@
 #include <isc/atomic.h>
 #include <isc/crc64.h>
 #include <isc/file.h>
+#include <isc/hashmap.h>
 #include <isc/heap.h>
 #include <isc/hex.h>
 #include <isc/loop.h>
@@ -146,10 +147,72 @@ struct qpdb_version {
 	uint64_t xfrsize;
 
 	struct cds_wfs_stack glue_stack;
+
+	/*
+	 * Pre-rendered response data, see dns_db_addrendered().
+	 * The table is created on first use.
+	 */
+	struct cds_lfht *rendered;
+	atomic_uint_fast32_t rendered_count;
+	atomic_size_t rendered_bytes;
+
+	/*
+	 * NSEC3 hashes of owner names, see dns_db_addnsec3hash().
+	 * The table is created on first use.
+	 */
+	struct cds_lfht *nsec3hashes;
+	atomic_uint_fast32_t nsec3hashes_count;
 };
 
 typedef ISC_LIST(qpdb_version_t) qpdb_versionlist_t;
 
+/*%
+ * A pre-rendered response data entry; the key is stored immediately
+ * followed by the data in 'buf'.
+ */
+typedef struct qpdb_rendered {
+	struct cds_lfht_node ht_node;
+	unsigned int keylen;
+	unsigned int datalen;
+	unsigned char buf[];
+} qpdb_rendered_t;
+
+/*%
+ * Limits on the pre-rendered response data kept per database version.
+ */
+#define QPDB_RENDERED_MAXENTRIES 4096
+#define QPDB_RENDERED_MAXBYTES	 (4 * 1024 * 1024)
+
+/*%
+ * An NSEC3 hash entry; the owner name is stored immediately followed
+ * by the hashed owner name in 'buf', both in uncompressed wire format.
+ */
+typedef struct qpdb_nsec3hash {
+	struct cds_lfht_node ht_node;
+	unsigned int namelen;
+	unsigned int hashlen;
+	unsigned char buf[];
+} qpdb_nsec3hash_t;
+
+/*%
+ * Limit on the NSEC3 hashes kept per database version.
+ */
+#define QPDB_NSEC3HASH_MAXENTRIES 1024
+
+/*%
+ * When a version with at most this many changed nodes is committed,
+ * the glue of the previous version is carried forward and the glue of
+ * changed delegations is computed; see update_glue().
+ */
+#define QPDB_GLUE_UPDATE_MAXCHANGES 65536
+
+/*%
+ * Closing a version cleans up at most this many changed nodes in the
+ * caller's context; the rest are cleaned up in slices of the same size
+ * on the database's loop.
+ */
+#define QPDB_CLEANUP_QUANTUM 1024
+
 struct qpdata {
 	dns_name_t name;
 	isc_mem_t *mctx;
@@ -179,6 +242,7 @@ struct qpzonedb {
 	/* Locked by lock. */
 	unsigned int active;
 	unsigned int attributes;
+	bool replicated;
 	uint32_t current_serial;
 	uint32_t least_serial;
 	uint32_t next_serial;
@@ -186,10 +250,18 @@ struct qpzonedb {
 	qpdb_version_t *future_version;
 	qpdb_versionlist_t open_versions;
 	isc_loop_t *loop;
+	/* Changed nodes awaiting cleanup on cleanup_loop. */
+	qpdb_changedlist_t deferred;
+	isc_loop_t *cleanup_loop;
+	size_t deferred_cleaned;
+	unsigned int deferred_slices;
 	struct rcu_head rcu_head;
 
 	isc_heap_t **heaps; /* Resigning heaps, one per nodelock bucket */
 
+	/* Bytes held by the slab headers linked into the nodes. */
+	atomic_size_t memory;
+
 	dns_qpmulti_t *tree;  /* Main QP trie for data storage */
 	dns_qpmulti_t *nsec;  /* NSEC nodes only */
 	dns_qpmulti_t *nsec3; /* NSEC3 nodes only */
@@ -257,6 +329,9 @@ static dns_qpmethods_t qpmethods = {
 	qp_triename,
 };
 
+static void
+update_glue(qpzonedb_t *qpdb, qpdb_version_t *version);
+
 static void
 rdatasetiter_destroy(dns_rdatasetiter_t **iteratorp DNS__DB_FLARG);
 static isc_result_t
@@ -454,6 +529,52 @@ free_gluetable(struct cds_wfs_stack *glue_stack) {
 	rcu_read_unlock();
 }
 
+static void
+free_renderedtable(qpzonedb_t *qpdb, qpdb_version_t *version) {
+	struct cds_lfht_iter iter;
+	qpdb_rendered_t *entry = NULL;
+
+	if (version->rendered == NULL) {
+		return;
+	}
+
+	/*
+	 * This is only called when the version is no longer referenced,
+	 * so there cannot be any concurrent readers.
+	 */
+	cds_lfht_for_each_entry(version->rendered, &iter, entry, ht_node) {
+		INSIST(!cds_lfht_del(version->rendered, &entry->ht_node));
+		isc_mem_put(qpdb->common.mctx, entry,
+			    STRUCT_FLEX_SIZE(entry, buf,
+					     entry->keylen + entry->datalen));
+	}
+	INSIST(!cds_lfht_destroy(version->rendered, NULL));
+	version->rendered = NULL;
+}
+
+static void
+free_nsec3hashtable(qpzonedb_t *qpdb, qpdb_version_t *version) {
+	struct cds_lfht_iter iter;
+	qpdb_nsec3hash_t *entry = NULL;
+
+	if (version->nsec3hashes == NULL) {
+		return;
+	}
+
+	/*
+	 * This is only called when the version is no longer referenced,
+	 * so there cannot be any concurrent readers.
+	 */
+	cds_lfht_for_each_entry(version->nsec3hashes, &iter, entry, ht_node) {
+		INSIST(!cds_lfht_del(version->nsec3hashes, &entry->ht_node));
+		isc_mem_put(qpdb->common.mctx, entry,
+			    STRUCT_FLEX_SIZE(entry, buf,
+					     entry->namelen + entry->hashlen));
+	}
+	INSIST(!cds_lfht_destroy(version->nsec3hashes, NULL));
+	version->nsec3hashes = NULL;
+}
+
 static void
 free_db_rcu(struct rcu_head *rcu_head) {
 	qpzonedb_t *qpdb = caa_container_of(rcu_head, qpzonedb_t, rcu_head);
@@ -507,6 +628,7 @@ free_qpdb(qpzonedb_t *qpdb, bool log) {
 
 	isc_refcount_destroy(&qpdb->current_version->references);
 	UNLINK(qpdb->open_versions, qpdb->current_version, link);
+	free_renderedtable(qpdb, qpdb->current_version);
 	cds_wfs_destroy(&qpdb->current_version->glue_stack);
 	isc_rwlock_destroy(&qpdb->current_version->rwlock);
 	isc_mem_put(qpdb->common.mctx, qpdb->current_version,
@@ -648,11 +770,13 @@ dns__qpzone_create(isc_mem_t *mctx, const dns_name_t *origin, dns_dbtype_t type,
 		.least_serial = 1,
 		.next_serial = 2,
 		.open_versions = ISC_LIST_INITIALIZER,
+		.deferred = ISC_LIST_INITIALIZER,
 	};
 
 	isc_refcount_init(&qpdb->common.references, 1);
 
 	qpdb->common.methods = &qpdb_zonemethods;
+	qpdb->common.attributes |= DNS_DBATTR_PARALLELUPDATE;
 	if (type == dns_dbtype_stub) {
 		qpdb->common.attributes |= DNS_DBATTR_STUB;
 	}
@@ -792,6 +916,26 @@ newref(qpzonedb_t *qpdb, qpdata_t *node DNS__DB_FLARG) {
 	}
 }
 
+static size_t
+header_memory(dns_slabheader_t *header) {
+	if (NONEXISTENT(header)) {
+		return (sizeof(*header));
+	}
+	return (dns_rdataslab_size((unsigned char *)header, sizeof(*header)));
+}
+
+/*
+ * Destroy a header that add() linked into a node, returning its bytes
+ * to the database memory counter.
+ */
+static void
+free_header(dns_slabheader_t **headerp) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)(*headerp)->db;
+
+	atomic_fetch_sub_relaxed(&qpdb->memory, header_memory(*headerp));
+	dns_slabheader_destroy(headerp);
+}
+
 static void
 clean_zone_node(qpdata_t *node, uint32_t least_serial) {
 	dns_slabheader_t *current = NULL, *dcurrent = NULL;
@@ -825,7 +969,7 @@ clean_zone_node(qpdata_t *node, uint32_t least_serial) {
 					down_next->next = dparent;
 				}
 				dparent->down = down_next;
-				dns_slabheader_destroy(&dcurrent);
+				free_header(&dcurrent);
 			} else {
 				dparent = dcurrent;
 			}
@@ -843,7 +987,7 @@ clean_zone_node(qpdata_t *node, uint32_t least_serial) {
 				} else {
 					node->data = current->next;
 				}
-				dns_slabheader_destroy(&current);
+				free_header(&current);
 				/*
 				 * current no longer exists, so we can
 				 * just continue with the loop.
@@ -860,7 +1004,7 @@ clean_zone_node(qpdata_t *node, uint32_t least_serial) {
 					node->data = down_next;
 				}
 				down_next->next = top_next;
-				dns_slabheader_destroy(&current);
+				free_header(&current);
 				current = down_next;
 			}
 		}
@@ -888,7 +1032,7 @@ clean_zone_node(qpdata_t *node, uint32_t least_serial) {
 			do {
 				down_next = dcurrent->down;
 				INSIST(dcurrent->serial <= least_serial);
-				dns_slabheader_destroy(&dcurrent);
+				free_header(&dcurrent);
 				dcurrent = down_next;
 			} while (dcurrent != NULL);
 			dparent->down = NULL;
@@ -1022,7 +1166,7 @@ bindrdataset(qpzonedb_t *qpdb, qpdata_t *node, dns_slabheader_t *header,
 		rdataset->attributes |= DNS_RDATASETATTR_OPTOUT;
 	}
 
-	rdataset->count = atomic_fetch_add_relaxed(&header->count, 1);
+	rdataset->count = dns_slabheader_cycle(header);
 
 	rdataset->slab.db = (dns_db_t *)qpdb;
 	rdataset->slab.node = (dns_dbnode_t *)node;
@@ -1301,7 +1445,11 @@ resigndelete(qpzonedb_t *qpdb, qpdb_version_t *version,
 				header->heap_index);
 		header->heap_index = 0;
 		newref(qpdb, HEADERNODE(header) DNS__DB_FLARG_PASS);
+
+		/* Nodes with different locks may be updated in parallel */
+		RWLOCK(&version->rwlock, isc_rwlocktype_write);
 		ISC_LIST_APPEND(version->resigned_list, header, link);
+		RWUNLOCK(&version->rwlock, isc_rwlocktype_write);
 	}
 }
 
@@ -1344,15 +1492,122 @@ rollback_node(qpdata_t *node, uint32_t serial) {
 	}
 }
 
+/*
+ * Release up to 'max' changed nodes from 'list', rolling back the
+ * changes made in version 'serial' first if 'rollback' is set.
+ */
+static void
+cleanup_changed(qpzonedb_t *qpdb, qpdb_changedlist_t *list, uint32_t serial,
+		bool rollback, uint32_t least_serial,
+		unsigned int max DNS__DB_FLARG) {
+	qpdb_changed_t *changed = NULL;
+
+	for (changed = HEAD(*list); changed != NULL && max > 0;
+	     changed = HEAD(*list), max--)
+	{
+		qpdata_t *node = changed->node;
+		isc_rwlock_t *lock = &qpdb->node_locks[node->locknum].lock;
+		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+
+		UNLINK(*list, changed, link);
+
+		NODE_WRLOCK(lock, &nlocktype);
+		if (rollback) {
+			rollback_node(node, serial);
+		}
+		decref(qpdb, node, least_serial, &nlocktype DNS__DB_FLARG_PASS);
+
+		NODE_UNLOCK(lock, &nlocktype);
+
+		isc_mem_put(qpdb->common.mctx, changed, sizeof(*changed));
+	}
+}
+
+static void
+cleanup_deferred(void *arg) {
+	qpzonedb_t *qpdb = arg;
+	qpdb_changedlist_t list = ISC_LIST_INITIALIZER;
+	qpdb_changed_t *changed = NULL;
+	isc_loop_t *loop = NULL;
+	uint32_t least_serial;
+	unsigned int n = 0;
+	bool again = true;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	while (n < QPDB_CLEANUP_QUANTUM &&
+	       (changed = HEAD(qpdb->deferred)) != NULL)
+	{
+		UNLINK(qpdb->deferred, changed, link);
+		APPEND(list, changed, link);
+		n++;
+	}
+	least_serial = qpdb->least_serial;
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	cleanup_changed(qpdb, &list, 0, false, least_serial,
+			QPDB_CLEANUP_QUANTUM DNS__DB_FILELINE);
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	qpdb->deferred_cleaned += n;
+	qpdb->deferred_slices++;
+	if (EMPTY(qpdb->deferred)) {
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_DATABASE,
+			      DNS_LOGMODULE_DB, ISC_LOG_DEBUG(1),
+			      "cleaned up %zu changed nodes in %u slices",
+			      qpdb->deferred_cleaned, qpdb->deferred_slices);
+		qpdb->deferred_cleaned = 0;
+		qpdb->deferred_slices = 0;
+		again = false;
+	}
+	loop = qpdb->cleanup_loop;
+	if (!again) {
+		qpdb->cleanup_loop = NULL;
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	if (again) {
+		isc_async_run(loop, cleanup_deferred, qpdb);
+	} else {
+		isc_loop_detach(&loop);
+		dns_db_detach((dns_db_t **)&qpdb);
+	}
+}
+
+/*
+ * Hand the changed nodes in 'list' over to cleanup_deferred() on the
+ * database's loop, or release them now if there is no loop.
+ */
+static void
+defer_cleanup(qpzonedb_t *qpdb, qpdb_changedlist_t *list,
+	      uint32_t least_serial DNS__DB_FLARG) {
+	bool schedule = false;
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	if (qpdb->cleanup_loop == NULL && qpdb->loop != NULL) {
+		isc_loop_attach(qpdb->loop, &qpdb->cleanup_loop);
+		schedule = true;
+	}
+	if (qpdb->cleanup_loop != NULL) {
+		APPENDLIST(qpdb->deferred, *list, link);
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	if (schedule) {
+		isc_refcount_increment(&qpdb->common.references);
+		isc_async_run(qpdb->cleanup_loop, cleanup_deferred, qpdb);
+	} else if (!EMPTY(*list)) {
+		cleanup_changed(qpdb, list, 0, false, least_serial,
+				UINT_MAX DNS__DB_FLARG_PASS);
+	}
+}
+
 static void
 closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 	     bool commit DNS__DB_FLARG) {
 	qpzonedb_t *qpdb = (qpzonedb_t *)db;
 	qpdb_version_t *version = NULL, *cleanup_version = NULL;
 	qpdb_version_t *least_greater = NULL;
-	qpdata_t *node = NULL;
 	bool rollback = false;
-	qpdb_changed_t *changed = NULL, *next_changed = NULL;
 	qpdb_changedlist_t cleanup_list;
 	dns_slabheaderlist_t resigned_list;
 	dns_slabheader_t *header = NULL;
@@ -1376,6 +1631,9 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 	 */
 	if (version->writer && commit) {
 		setsecure(db, version, qpdb->origin);
+		if (!IS_STUB(qpdb)) {
+			update_glue(qpdb, version);
+		}
 	}
 
 	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
@@ -1518,6 +1776,8 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 		INSIST(EMPTY(cleanup_version->changed_list));
 		free_gluetable(&cleanup_version->glue_stack);
 		cds_wfs_destroy(&cleanup_version->glue_stack);
+		free_renderedtable(qpdb, cleanup_version);
+		free_nsec3hashtable(qpdb, cleanup_version);
 		isc_rwlock_destroy(&cleanup_version->rwlock);
 		isc_mem_put(qpdb->common.mctx, cleanup_version,
 			    sizeof(*cleanup_version));
@@ -1544,30 +1804,24 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 		NODE_UNLOCK(lock, &nlocktype);
 	}
 
-	if (EMPTY(cleanup_list)) {
-		*versionp = NULL;
-		return;
-	}
-
-	for (changed = HEAD(cleanup_list); changed != NULL;
-	     changed = next_changed)
-	{
-		isc_rwlock_t *lock = NULL;
-		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
-
-		next_changed = NEXT(changed, link);
-		node = changed->node;
-		lock = &qpdb->node_locks[node->locknum].lock;
-
-		NODE_WRLOCK(lock, &nlocktype);
-		if (rollback) {
-			rollback_node(node, serial);
+	/*
+	 * A rollback must be complete before the next writer reuses the
+	 * serial number, but after a commit only the first slice of the
+	 * changed nodes is released here and the rest are deferred, so
+	 * that closing a version after a large transfer or update does
+	 * not stall the caller.
+	 */
+	if (rollback) {
+		cleanup_changed(qpdb, &cleanup_list, serial, true, least_serial,
+				UINT_MAX DNS__DB_FILELINE);
+	} else {
+		cleanup_changed(qpdb, &cleanup_list, serial, false,
+				least_serial,
+				QPDB_CLEANUP_QUANTUM DNS__DB_FILELINE);
+		if (!EMPTY(cleanup_list)) {
+			defer_cleanup(qpdb, &cleanup_list,
+				      least_serial DNS__DB_FILELINE);
 		}
-		decref(qpdb, node, least_serial, &nlocktype DNS__DB_FILELINE);
-
-		NODE_UNLOCK(lock, &nlocktype);
-
-		isc_mem_put(qpdb->common.mctx, changed, sizeof(*changed));
 	}
 
 	*versionp = NULL;
@@ -1971,7 +2225,7 @@ add(qpzonedb_t *qpdb, qpdata_t *node, const dns_name_t *nodename,
 			newheader->next = topheader->next;
 			maybe_update_recordsandsize(false, version, header,
 						    nodename->length);
-			dns_slabheader_destroy(&header);
+			free_header(&header);
 		} else {
 			idx = HEADERNODE(newheader)->locknum;
 			if (RESIGN(newheader)) {
@@ -2059,6 +2313,7 @@ add(qpzonedb_t *qpdb, qpdata_t *node, const dns_name_t *nodename,
 	}
 
 	maybe_update_recordsandsize(true, version, newheader, nodename->length);
+	atomic_fetch_add_relaxed(&qpdb->memory, header_memory(newheader));
 
 	/*
 	 * Check if the node now contains CNAME and other data.
@@ -2528,6 +2783,128 @@ getsigningtime(dns_db_t *db, dns_rdataset_t *rdataset,
 	return (result);
 }
 
+typedef struct signingkey {
+	uint64_t resign;
+	bool soa;
+	size_t slot;
+} signingkey_t;
+
+/*
+ * Order RRsets the way resign_sooner() does.
+ */
+static int
+signingkey_cmp(const void *v1, const void *v2) {
+	const signingkey_t *k1 = v1, *k2 = v2;
+
+	if (k1->resign != k2->resign) {
+		return (k1->resign < k2->resign ? -1 : 1);
+	}
+	return ((int)k1->soa - (int)k2->soa);
+}
+
+static isc_result_t
+getsigningtimes(dns_db_t *db, isc_stdtime_t until, dns_dbsigning_t *entries,
+		size_t *countp) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	uint64_t limit = dns_time64_from32(until);
+	size_t max = *countp, count = 0, worst = 0;
+	signingkey_t *keys = NULL;
+	dns_dbsigning_t *found = NULL;
+	unsigned int stack[2 * 8 * sizeof(unsigned int)];
+
+	REQUIRE(VALID_QPZONE(qpdb));
+
+	keys = isc_mem_cget(qpdb->common.mctx, max, sizeof(keys[0]));
+	found = isc_mem_cget(qpdb->common.mctx, max, sizeof(found[0]));
+
+	/*
+	 * Walk each heap from the top.  A heap is ordered, so when an
+	 * RRset is not due by 'until', or is not among the 'max' earliest
+	 * found so far, neither is anything below it.
+	 */
+	for (int i = 0; i < qpdb->node_lock_count; i++) {
+		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+		size_t sp = 0;
+
+		NODE_RDLOCK(&qpdb->node_locks[i].lock, &nlocktype);
+		stack[sp++] = 1;
+		while (sp > 0) {
+			unsigned int idx = stack[--sp];
+			dns_slabheader_t *header = NULL;
+			dns_dbsigning_t *entry = NULL;
+			signingkey_t key;
+			size_t k;
+
+			header = isc_heap_element(qpdb->heaps[i], idx);
+			if (header == NULL) {
+				continue;
+			}
+
+			key = (signingkey_t){
+				.resign = ((uint64_t)header->resign << 1) |
+					  header->resign_lsb,
+				.soa = (header->type ==
+					DNS_SIGTYPE(dns_rdatatype_soa)),
+			};
+			if (key.resign > limit ||
+			    (count == max &&
+			     signingkey_cmp(&key, &keys[worst]) >= 0))
+			{
+				continue;
+			}
+
+			if (count < max) {
+				k = count++;
+				key.slot = k;
+			} else {
+				k = worst;
+				key.slot = keys[worst].slot;
+			}
+			keys[k] = key;
+			entry = &found[key.slot];
+			dns_name_copy(&HEADERNODE(header)->name,
+				      dns_fixedname_initname(&entry->name));
+			entry->covers = DNS_TYPEPAIR_COVERS(header->type);
+			entry->resign = (header->resign << 1) |
+					header->resign_lsb;
+
+			if (count == max) {
+				worst = 0;
+				for (size_t j = 1; j < count; j++) {
+					if (signingkey_cmp(&keys[j],
+							   &keys[worst]) > 0)
+					{
+						worst = j;
+					}
+				}
+			}
+
+			if (idx <= UINT_MAX / 2 - 1) {
+				INSIST(sp + 2 <= ARRAY_SIZE(stack));
+				stack[sp++] = 2 * idx + 1;
+				stack[sp++] = 2 * idx;
+			}
+		}
+		NODE_UNLOCK(&qpdb->node_locks[i].lock, &nlocktype);
+	}
+
+	qsort(keys, count, sizeof(keys[0]), signingkey_cmp);
+	for (size_t j = 0; j < count; j++) {
+		dns_dbsigning_t *from = &found[keys[j].slot];
+
+		dns_name_copy(dns_fixedname_name(&from->name),
+			      dns_fixedname_initname(&entries[j].name));
+		entries[j].covers = from->covers;
+		entries[j].resign = from->resign;
+	}
+
+	isc_mem_cput(qpdb->common.mctx, found, max, sizeof(found[0]));
+	isc_mem_cput(qpdb->common.mctx, keys, max, sizeof(keys[0]));
+
+	*countp = count;
+	return (count > 0 ? ISC_R_SUCCESS : ISC_R_NOTFOUND);
+}
+
 static isc_result_t
 setgluecachestats(dns_db_t *db, isc_stats_t *stats) {
 	qpzonedb_t *qpdb = (qpzonedb_t *)db;
@@ -2540,6 +2917,26 @@ setgluecachestats(dns_db_t *db, isc_stats_t *stats) {
 	return (ISC_R_SUCCESS);
 }
 
+static isc_result_t
+setreplicas(dns_db_t *db, unsigned int groups) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	isc_result_t result = ISC_R_EXISTS;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+
+	RWLOCK(&qpdb->lock, isc_rwlocktype_write);
+	if (!qpdb->replicated) {
+		dns_qpmulti_replicate(qpdb->tree, groups);
+		dns_qpmulti_replicate(qpdb->nsec, groups);
+		dns_qpmulti_replicate(qpdb->nsec3, groups);
+		qpdb->replicated = true;
+		result = ISC_R_SUCCESS;
+	}
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_write);
+
+	return (result);
+}
+
 static isc_result_t
 findnodeintree(qpzonedb_t *qpdb, const dns_name_t *name, bool create,
 	       bool nsec3, dns_dbnode_t **nodep DNS__DB_FLARG) {
@@ -4014,6 +4411,15 @@ nodecount(dns_db_t *db, dns_dbtree_t tree) {
 	return (mu.leaves);
 }
 
+static size_t
+memoryusage(dns_db_t *db) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+
+	return (atomic_load_relaxed(&qpdb->memory));
+}
+
 static void
 setloop(dns_db_t *db, isc_loop_t *loop) {
 	qpzonedb_t *qpdb = NULL;
@@ -4800,8 +5206,7 @@ addrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
 	if (rdataset->ttl == 0U) {
 		DNS_SLABHEADER_SETATTR(newheader, DNS_SLABHEADERATTR_ZEROTTL);
 	}
-	atomic_init(&newheader->count,
-		    atomic_fetch_add_relaxed(&init_count, 1));
+	newheader->count = atomic_fetch_add_relaxed(&init_count, 1);
 	if (version != NULL) {
 		newheader->serial = version->serial;
 
@@ -4939,8 +5344,7 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
 	newheader->trust = 0;
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
-	atomic_init(&newheader->count,
-		    atomic_fetch_add_relaxed(&init_count, 1));
+	newheader->count = atomic_fetch_add_relaxed(&init_count, 1);
 	newheader->last_used = 0;
 	newheader->node = node;
 	newheader->db = (dns_db_t *)qpdb;
@@ -5054,6 +5458,8 @@ subtractrdataset(dns_db_t *db, dns_dbnode_t *dbnode, dns_dbversion_t *dbversion,
 		topheader->next = newheader;
 		node->dirty = 1;
 		changed->dirty = true;
+		atomic_fetch_add_relaxed(&qpdb->memory,
+					 header_memory(newheader));
 		resigndelete(qpdb, version, header DNS__DB_FLARG_PASS);
 	} else {
 		/*
@@ -5380,6 +5786,180 @@ newglue(qpzonedb_t *qpdb, qpdb_version_t *version, qpdata_t *node,
 	return (ctx.glue_list);
 }
 
+/*
+ * Install glue computed for 'version' on an NS header that is current in
+ * 'version', replacing 'old_glue' from an older version.  If 'old_glue'
+ * is NULL, a query may be caching glue on the header at the same time;
+ * in that case its glue is kept and ours is discarded.
+ */
+static void
+replaceglue(qpzonedb_t *qpdb, qpdb_version_t *version, qpdata_t *node,
+	    dns_rdataset_t *rdataset, dns_glue_t *old_glue) {
+	dns_slabheader_t *header = dns_slabheader_fromrdataset(rdataset);
+	dns_glue_t *glue = newglue(qpdb, version, node, rdataset);
+	dns_glue_t *found = rcu_cmpxchg_pointer(
+		&header->glue_list, old_glue, (glue) ? glue : (void *)-1);
+
+	if (found != old_glue) {
+		freeglue(glue);
+		return;
+	}
+	if (old_glue != NULL && old_glue != (void *)-1) {
+		call_rcu(&old_glue->rcu_head, free_gluelist_rcu);
+	}
+	if (glue != NULL) {
+		cds_wfs_push(&version->glue_stack, &header->wfs_node);
+	}
+}
+
+static bool
+changed_match(void *node, const void *key) {
+	return (dns_name_equal(&((qpdata_t *)node)->name, key));
+}
+
+static bool
+changed_name(isc_hashmap_t *changed, const dns_name_t *name) {
+	void *found = NULL;
+	return (isc_hashmap_find(changed, dns_name_hash(name), changed_match,
+				 name, &found) == ISC_R_SUCCESS);
+}
+
+/*
+ * Does the glue for this NS RRset depend on any of the changed names?
+ */
+static bool
+glue_changed(isc_hashmap_t *changed, dns_rdataset_t *rdataset) {
+	isc_result_t result;
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+		dns_rdata_ns_t ns;
+
+		dns_rdataset_current(rdataset, &rdata);
+		result = dns_rdata_tostruct(&rdata, &ns, NULL);
+		RUNTIME_CHECK(result == ISC_R_SUCCESS);
+		if (changed_name(changed, &ns.name)) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+/*
+ * Called before 'version' is committed, to save the first referral
+ * through each delegation from computing glue after every update.
+ *
+ * Glue cached while the current version was in use is carried forward
+ * unless the delegation's NS RRset or the owner of one of its NS targets
+ * has changed; glue that depends on a changed name is recomputed. Glue
+ * for delegations that changed in 'version' is computed now instead of
+ * on the first query. Glue that is not carried forward stays with the
+ * current version and is freed with it.
+ */
+static void
+update_glue(qpzonedb_t *qpdb, qpdb_version_t *version) {
+	qpdb_version_t *current = NULL;
+	isc_hashmap_t *changed = NULL;
+	qpdb_changed_t *change = NULL;
+	struct cds_wfs_head *head = NULL;
+	struct cds_wfs_node *wnode = NULL, *next = NULL;
+	unsigned int count = 0;
+
+	for (change = HEAD(version->changed_list); change != NULL;
+	     change = NEXT(change, link))
+	{
+		if (++count > QPDB_GLUE_UPDATE_MAXCHANGES) {
+			return;
+		}
+	}
+
+	/*
+	 * Only committing a writer replaces the current version, so it
+	 * stays put while we are working.
+	 */
+	RWLOCK(&qpdb->lock, isc_rwlocktype_read);
+	current = qpdb->current_version;
+	RWUNLOCK(&qpdb->lock, isc_rwlocktype_read);
+
+	isc_hashmap_create(qpdb->common.mctx, 1, &changed);
+	for (change = HEAD(version->changed_list); change != NULL;
+	     change = NEXT(change, link))
+	{
+		qpdata_t *node = change->node;
+		(void)isc_hashmap_add(changed, dns_name_hash(&node->name),
+				      changed_match, &node->name, node, NULL);
+	}
+
+	rcu_read_lock();
+	head = __cds_wfs_pop_all(&current->glue_stack);
+	cds_wfs_for_each_blocking_safe(head, wnode, next) {
+		dns_slabheader_t *header =
+			caa_container_of(wnode, dns_slabheader_t, wfs_node);
+		qpdata_t *node = (qpdata_t *)header->node;
+		dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+		isc_result_t result;
+
+		/*
+		 * Only glue for an NS RRset that is the same in both
+		 * versions can move to the new version.
+		 */
+		result = findrdataset((dns_db_t *)qpdb, (dns_dbnode_t *)node,
+				      (dns_dbversion_t *)version,
+				      dns_rdatatype_ns, 0, 0, &rdataset,
+				      NULL DNS__DB_FILELINE);
+		if (result != ISC_R_SUCCESS ||
+		    dns_slabheader_fromrdataset(&rdataset) != header)
+		{
+			cds_wfs_push(&current->glue_stack, wnode);
+		} else if (glue_changed(changed, &rdataset)) {
+			replaceglue(qpdb, version, node, &rdataset,
+				    rcu_dereference(header->glue_list));
+		} else {
+			cds_wfs_push(&version->glue_stack, wnode);
+		}
+		if (dns_rdataset_isassociated(&rdataset)) {
+			dns_rdataset_disassociate(&rdataset);
+		}
+	}
+
+	/*
+	 * Compute the glue of the delegations that changed.
+	 */
+	for (change = HEAD(version->changed_list); change != NULL;
+	     change = NEXT(change, link))
+	{
+		qpdata_t *node = change->node;
+		dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+		dns_slabheader_t *header = NULL;
+		dns_glue_t *glue = NULL;
+		isc_result_t result;
+
+		if (!node->delegating || node == qpdb->origin) {
+			continue;
+		}
+		result = findrdataset((dns_db_t *)qpdb, (dns_dbnode_t *)node,
+				      (dns_dbversion_t *)version,
+				      dns_rdatatype_ns, 0, 0, &rdataset,
+				      NULL DNS__DB_FILELINE);
+		if (result != ISC_R_SUCCESS) {
+			continue;
+		}
+		header = dns_slabheader_fromrdataset(&rdataset);
+		glue = rcu_dereference(header->glue_list);
+		if (glue == NULL ||
+		    (glue == (void *)-1 && glue_changed(changed, &rdataset)))
+		{
+			replaceglue(qpdb, version, node, &rdataset, glue);
+		}
+		dns_rdataset_disassociate(&rdataset);
+	}
+	rcu_read_unlock();
+
+	isc_hashmap_destroy(&changed);
+}
+
 static isc_result_t
 addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
 	dns_message_t *msg) {
@@ -5435,6 +6015,248 @@ addglue(dns_db_t *db, dns_dbversion_t *dbversion, dns_rdataset_t *rdataset,
 	return (ISC_R_SUCCESS);
 }
 
+static int
+rendered_match(struct cds_lfht_node *ht_node, const void *key0) {
+	const qpdb_rendered_t *entry =
+		caa_container_of(ht_node, qpdb_rendered_t, ht_node);
+	const isc_region_t *key = key0;
+
+	return (entry->keylen == key->length &&
+		memcmp(entry->buf, key->base, key->length) == 0);
+}
+
+static isc_result_t
+getrendered(dns_db_t *db, dns_dbversion_t *dbversion, const isc_region_t *key,
+	    isc_region_t *data) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	qpdb_version_t *version = dbversion;
+	struct cds_lfht *ht = NULL;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *ht_node = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+	REQUIRE(version->qpdb == qpdb);
+
+	rcu_read_lock();
+	ht = rcu_dereference(version->rendered);
+	if (ht != NULL) {
+		cds_lfht_lookup(ht, isc_hash32(key->base, key->length, true),
+				rendered_match, key, &iter);
+		ht_node = cds_lfht_iter_get_node(&iter);
+	}
+	if (ht_node != NULL) {
+		qpdb_rendered_t *entry =
+			caa_container_of(ht_node, qpdb_rendered_t, ht_node);
+
+		/*
+		 * Entries are only freed together with the version,
+		 * so the data stays valid after leaving the critical
+		 * section.
+		 */
+		data->base = entry->buf + entry->keylen;
+		data->length = entry->datalen;
+		result = ISC_R_SUCCESS;
+	}
+	rcu_read_unlock();
+
+	return (result);
+}
+
+static isc_result_t
+addrendered(dns_db_t *db, dns_dbversion_t *dbversion, const isc_region_t *key,
+	    const isc_region_t *data, unsigned int ndata) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	qpdb_version_t *version = dbversion;
+	qpdb_rendered_t *entry = NULL;
+	struct cds_lfht *ht = NULL;
+	struct cds_lfht_node *ht_node = NULL;
+	unsigned int datalen = 0;
+	unsigned char *cp = NULL;
+	size_t size;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+	REQUIRE(version->qpdb == qpdb);
+	REQUIRE(!version->writer);
+
+	for (unsigned int i = 0; i < ndata; i++) {
+		datalen += data[i].length;
+	}
+
+	size = STRUCT_FLEX_SIZE(entry, buf, key->length + datalen);
+
+	if (atomic_fetch_add_relaxed(&version->rendered_count, 1) >=
+	    QPDB_RENDERED_MAXENTRIES)
+	{
+		atomic_fetch_sub_relaxed(&version->rendered_count, 1);
+		return (ISC_R_NOSPACE);
+	}
+	if (atomic_fetch_add_relaxed(&version->rendered_bytes, size) + size >
+	    QPDB_RENDERED_MAXBYTES)
+	{
+		atomic_fetch_sub_relaxed(&version->rendered_bytes, size);
+		atomic_fetch_sub_relaxed(&version->rendered_count, 1);
+		return (ISC_R_NOSPACE);
+	}
+
+	entry = isc_mem_get(qpdb->common.mctx, size);
+	*entry = (qpdb_rendered_t){
+		.keylen = key->length,
+		.datalen = datalen,
+	};
+	memmove(entry->buf, key->base, key->length);
+	cp = entry->buf + key->length;
+	for (unsigned int i = 0; i < ndata; i++) {
+		memmove(cp, data[i].base, data[i].length);
+		cp += data[i].length;
+	}
+
+	rcu_read_lock();
+	ht = rcu_dereference(version->rendered);
+	if (ht == NULL) {
+		struct cds_lfht *old = NULL;
+
+		ht = cds_lfht_new(16, 16, 0,
+				  CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+				  NULL);
+		old = rcu_cmpxchg_pointer(&version->rendered, NULL, ht);
+		if (old != NULL) {
+			/* Somebody else was faster */
+			INSIST(!cds_lfht_destroy(ht, NULL));
+			ht = old;
+		}
+	}
+	ht_node = cds_lfht_add_unique(ht,
+				      isc_hash32(key->base, key->length, true),
+				      rendered_match, key, &entry->ht_node);
+	rcu_read_unlock();
+
+	if (ht_node != &entry->ht_node) {
+		atomic_fetch_sub_relaxed(&version->rendered_bytes, size);
+		atomic_fetch_sub_relaxed(&version->rendered_count, 1);
+		isc_mem_put(qpdb->common.mctx, entry, size);
+		return (ISC_R_EXISTS);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
+static int
+nsec3hash_match(struct cds_lfht_node *ht_node, const void *key) {
+	const qpdb_nsec3hash_t *entry =
+		caa_container_of(ht_node, qpdb_nsec3hash_t, ht_node);
+	const dns_name_t *name = key;
+	dns_name_t owner = DNS_NAME_INITEMPTY;
+	isc_region_t r = {
+		.base = (unsigned char *)entry->buf,
+		.length = entry->namelen,
+	};
+
+	if (entry->namelen != name->length) {
+		return (0);
+	}
+	dns_name_fromregion(&owner, &r);
+	return (dns_name_equal(&owner, name));
+}
+
+static isc_result_t
+getnsec3hash(dns_db_t *db, dns_dbversion_t *dbversion, const dns_name_t *name,
+	     dns_name_t *hashname) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	qpdb_version_t *version = dbversion;
+	struct cds_lfht *ht = NULL;
+	struct cds_lfht_iter iter;
+	struct cds_lfht_node *ht_node = NULL;
+	isc_result_t result = ISC_R_NOTFOUND;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+	REQUIRE(version->qpdb == qpdb);
+
+	rcu_read_lock();
+	ht = rcu_dereference(version->nsec3hashes);
+	if (ht != NULL) {
+		cds_lfht_lookup(ht, dns_name_hash(name), nsec3hash_match, name,
+				&iter);
+		ht_node = cds_lfht_iter_get_node(&iter);
+	}
+	if (ht_node != NULL) {
+		qpdb_nsec3hash_t *entry =
+			caa_container_of(ht_node, qpdb_nsec3hash_t, ht_node);
+		dns_name_t hashed = DNS_NAME_INITEMPTY;
+		isc_region_t r = {
+			.base = entry->buf + entry->namelen,
+			.length = entry->hashlen,
+		};
+
+		dns_name_fromregion(&hashed, &r);
+		dns_name_copy(&hashed, hashname);
+		result = ISC_R_SUCCESS;
+	}
+	rcu_read_unlock();
+
+	return (result);
+}
+
+static isc_result_t
+addnsec3hash(dns_db_t *db, dns_dbversion_t *dbversion, const dns_name_t *name,
+	     const dns_name_t *hashname) {
+	qpzonedb_t *qpdb = (qpzonedb_t *)db;
+	qpdb_version_t *version = dbversion;
+	qpdb_nsec3hash_t *entry = NULL;
+	struct cds_lfht *ht = NULL;
+	struct cds_lfht_node *ht_node = NULL;
+	size_t size;
+
+	REQUIRE(VALID_QPZONE(qpdb));
+	REQUIRE(version->qpdb == qpdb);
+	REQUIRE(!version->writer);
+	REQUIRE(dns_name_isabsolute(name));
+	REQUIRE(dns_name_isabsolute(hashname));
+
+	if (atomic_fetch_add_relaxed(&version->nsec3hashes_count, 1) >=
+	    QPDB_NSEC3HASH_MAXENTRIES)
+	{
+		atomic_fetch_sub_relaxed(&version->nsec3hashes_count, 1);
+		return (ISC_R_NOSPACE);
+	}
+
+	size = STRUCT_FLEX_SIZE(entry, buf, name->length + hashname->length);
+	entry = isc_mem_get(qpdb->common.mctx, size);
+	*entry = (qpdb_nsec3hash_t){
+		.namelen = name->length,
+		.hashlen = hashname->length,
+	};
+	memmove(entry->buf, name->ndata, name->length);
+	memmove(entry->buf + name->length, hashname->ndata, hashname->length);
+
+	rcu_read_lock();
+	ht = rcu_dereference(version->nsec3hashes);
+	if (ht == NULL) {
+		struct cds_lfht *old = NULL;
+
+		ht = cds_lfht_new(16, 16, 0,
+				  CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+				  NULL);
+		old = rcu_cmpxchg_pointer(&version->nsec3hashes, NULL, ht);
+		if (old != NULL) {
+			/* Somebody else was faster */
+			INSIST(!cds_lfht_destroy(ht, NULL));
+			ht = old;
+		}
+	}
+	ht_node = cds_lfht_add_unique(ht, dns_name_hash(name), nsec3hash_match,
+				      name, &entry->ht_node);
+	rcu_read_unlock();
+
+	if (ht_node != &entry->ht_node) {
+		atomic_fetch_sub_relaxed(&version->nsec3hashes_count, 1);
+		isc_mem_put(qpdb->common.mctx, entry, size);
+		return (ISC_R_EXISTS);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 static dns_dbmethods_t qpdb_zonemethods = {
 	.destroy = qpdb_destroy,
 	.beginload = beginload,
@@ -5461,6 +6283,7 @@ static dns_dbmethods_t qpdb_zonemethods = {
 	.findnsec3node = findnsec3node,
 	.setsigningtime = setsigningtime,
 	.getsigningtime = getsigningtime,
+	.getsigningtimes = getsigningtimes,
 	.getsize = getsize,
 	.setgluecachestats = setgluecachestats,
 	.locknode = locknode,
@@ -5468,6 +6291,12 @@ static dns_dbmethods_t qpdb_zonemethods = {
 	.addglue = addglue,
 	.deletedata = deletedata,
 	.nodefullname = nodefullname,
+	.getrendered = getrendered,
+	.addrendered = addrendered,
+	.getnsec3hash = getnsec3hash,
+	.addnsec3hash = addnsec3hash,
+	.setreplicas = setreplicas,
+	.memoryusage = memoryusage,
 };
 
 static void
@@ -5481,10 +6310,10 @@ destroy_qpdata(qpdata_t *node) {
 
 		for (down = current->down; down != NULL; down = down_next) {
 			down_next = down->down;
-			dns_slabheader_destroy(&down);
+			free_header(&down);
 		}
 
-		dns_slabheader_destroy(&current);
+		free_header(&current);
 	}
 
 	dns_name_free(&node->name, node->mctx);
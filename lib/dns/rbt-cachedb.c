@@ -787,7 +787,7 @@ cache_find(dns_db_t *db, const dns_name_t *name, dns_dbversion_t *version,
 	REQUIRE(version == NULL);
 
 	if (now == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	search = (rbtdb_search_t){
@@ -1199,7 +1199,7 @@ cache_findzonecut(dns_db_t *db, const dns_name_t *name, unsigned int options,
 	REQUIRE(VALID_RBTDB((dns_rbtdb_t *)db));
 
 	if (now == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	search = (rbtdb_search_t){
@@ -1372,7 +1372,7 @@ cache_findrdataset(dns_db_t *db, dns_dbnode_t *node, dns_dbversion_t *version,
 	result = ISC_R_SUCCESS;
 
 	if (now == 0) {
-		now = isc_stdtime_now();
+		now = isc_loop_stdtime();
 	}
 
 	lock = &rbtdb->node_locks[rbtnode->locknum].lock;
@@ -2228,7 +2228,7 @@ dns__rbtdb_bindrdataset(dns_rbtdb_t *rbtdb, dns_rbtnode_t *node,
 		rdataset->ttl = header->ttl;
 	}
 
-	rdataset->count = atomic_fetch_add_relaxed(&header->count, 1);
+	rdataset->count = dns_slabheader_cycle(header);
 
 	rdataset->slab.db = (dns_db_t *)rbtdb;
 	rdataset->slab.node = (dns_dbnode_t *)node;
@@ -3294,8 +3294,7 @@ dns__rbtdb_addrdataset(dns_db_t *db, dns_dbnode_t *node,
 	if (rdataset->ttl == 0U) {
 		DNS_SLABHEADER_SETATTR(newheader, DNS_SLABHEADERATTR_ZEROTTL);
 	}
-	atomic_init(&newheader->count,
-		    atomic_fetch_add_relaxed(&init_count, 1));
+	newheader->count = atomic_fetch_add_relaxed(&init_count, 1);
 	if (rbtversion != NULL) {
 		newheader->serial = rbtversion->serial;
 		now = 0;
@@ -3501,8 +3500,7 @@ dns__rbtdb_subtractrdataset(dns_db_t *db, dns_dbnode_t *node,
 	newheader->trust = 0;
 	newheader->noqname = NULL;
 	newheader->closest = NULL;
-	atomic_init(&newheader->count,
-		    atomic_fetch_add_relaxed(&init_count, 1));
+	newheader->count = atomic_fetch_add_relaxed(&init_count, 1);
 	newheader->last_used = 0;
 	newheader->node = rbtnode;
 	newheader->db = (dns_db_t *)rbtdb;
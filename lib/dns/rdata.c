@@ -189,6 +189,9 @@ name_length(const dns_name_t *name);
 static isc_result_t
 str_totext(const char *source, isc_buffer_t *target);
 
+static isc_result_t
+uint_totext(uint32_t value, isc_buffer_t *target);
+
 static isc_result_t
 inet_totext(int af, uint32_t flags, isc_region_t *src, isc_buffer_t *target);
 
@@ -697,6 +700,27 @@ dns_rdata_clone(const dns_rdata_t *src, dns_rdata_t *target) {
  *** Comparisons
  ***/
 
+/*
+ * Frequently seen types whose RDATA contains no domain names, so that
+ * the type specific towire(), compare() and casecompare() methods are
+ * equivalent to copying or comparing the uncompressed wire format.
+ * These skip the generated dispatch switches altogether.
+ */
+static inline bool
+rdata_isopaque(dns_rdataclass_t rdclass, dns_rdatatype_t type) {
+	switch (type) {
+	case dns_rdatatype_a:
+		return (rdclass == dns_rdataclass_in);
+	case dns_rdatatype_aaaa:
+	case dns_rdatatype_txt:
+	case dns_rdatatype_ds:
+	case dns_rdatatype_nsec3:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
 int
 dns_rdata_compare(const dns_rdata_t *rdata1, const dns_rdata_t *rdata2) {
 	int result = 0;
@@ -717,7 +741,11 @@ dns_rdata_compare(const dns_rdata_t *rdata1, const dns_rdata_t *rdata2) {
 		return (rdata1->type < rdata2->type ? -1 : 1);
 	}
 
-	COMPARESWITCH
+	if (rdata_isopaque(rdata1->rdclass, rdata1->type)) {
+		use_default = true;
+	} else {
+		COMPARESWITCH
+	}
 
 	if (use_default) {
 		isc_region_t r1;
@@ -750,7 +778,11 @@ dns_rdata_casecompare(const dns_rdata_t *rdata1, const dns_rdata_t *rdata2) {
 		return (rdata1->type < rdata2->type ? -1 : 1);
 	}
 
-	CASECOMPARESWITCH
+	if (rdata_isopaque(rdata1->rdclass, rdata1->type)) {
+		use_default = true;
+	} else {
+		CASECOMPARESWITCH
+	}
 
 	if (use_default) {
 		isc_region_t r1;
@@ -885,7 +917,11 @@ dns_rdata_towire(dns_rdata_t *rdata, dns_compress_t *cctx,
 
 	st = *target;
 
-	TOWIRESWITCH
+	if (rdata_isopaque(rdata->rdclass, rdata->type)) {
+		use_default = true;
+	} else {
+		TOWIRESWITCH
+	}
 
 	if (use_default) {
 		isc_buffer_availableregion(target, &tr);
@@ -1907,6 +1943,30 @@ str_totext(const char *source, isc_buffer_t *target) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Append 'value' in decimal; this is used for most numeric fields, so
+ * it avoids the cost of snprintf().
+ */
+static isc_result_t
+uint_totext(uint32_t value, isc_buffer_t *target) {
+	char digits[sizeof("4294967295")];
+	char *cp = digits + sizeof(digits);
+	unsigned int l;
+
+	do {
+		*--cp = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+
+	l = digits + sizeof(digits) - cp;
+	if (l > isc_buffer_availablelength(target)) {
+		return (ISC_R_NOSPACE);
+	}
+	memmove(isc_buffer_used(target), cp, l);
+	isc_buffer_add(target, l);
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 inet_totext(int af, uint32_t flags, isc_region_t *src, isc_buffer_t *target) {
 	char tmpbuf[64];
@@ -182,16 +182,15 @@ totext_any_tsig(ARGS_TOTEXT) {
 	 */
 	n = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Signature Size.
 	 */
 	n = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
-	snprintf(buf, sizeof(buf), "%u", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
 
 	/*
 	 * Signature.
@@ -225,8 +224,8 @@ totext_any_tsig(ARGS_TOTEXT) {
 	 */
 	n = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Error.
@@ -145,8 +145,8 @@ totext_amtrelay(ARGS_TOTEXT) {
 	dns_rdata_toregion(rdata, &region);
 	precedence = uint8_fromregion(&region);
 	isc_region_consume(&region, 1);
-	snprintf(buf, sizeof(buf), "%u ", precedence);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(precedence, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Discovery and Gateway type.
@@ -331,7 +331,6 @@ static isc_result_t
 totext_caa(ARGS_TOTEXT) {
 	isc_region_t region;
 	uint8_t flags;
-	char buf[256];
 
 	UNUSED(tctx);
 
@@ -345,8 +344,8 @@ totext_caa(ARGS_TOTEXT) {
 	 * Flags
 	 */
 	flags = uint8_consume_fromregion(&region);
-	snprintf(buf, sizeof(buf), "%u ", flags);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(flags, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Tag
@@ -64,7 +64,6 @@ fromtext_cert(ARGS_FROMTEXT) {
 static isc_result_t
 totext_cert(ARGS_TOTEXT) {
 	isc_region_t sr;
-	char buf[sizeof("64000 ")];
 	unsigned int n;
 
 	REQUIRE(rdata->type == dns_rdatatype_cert);
@@ -87,8 +86,8 @@ totext_cert(ARGS_TOTEXT) {
 	 */
 	n = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Algorithm.
@@ -73,7 +73,6 @@ fromtext_doa(ARGS_FROMTEXT) {
 
 static isc_result_t
 totext_doa(ARGS_TOTEXT) {
-	char buf[sizeof("4294967295 ")];
 	isc_region_t region;
 	uint32_t n;
 
@@ -90,24 +89,24 @@ totext_doa(ARGS_TOTEXT) {
 	 */
 	n = uint32_fromregion(&region);
 	isc_region_consume(&region, 4);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * DOA-TYPE
 	 */
 	n = uint32_fromregion(&region);
 	isc_region_consume(&region, 4);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * DOA-LOCATION
 	 */
 	n = uint8_fromregion(&region);
 	isc_region_consume(&region, 1);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * DOA-MEDIA-TYPE
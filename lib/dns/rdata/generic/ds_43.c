@@ -92,7 +92,6 @@ fromtext_ds(ARGS_FROMTEXT) {
 static isc_result_t
 generic_totext_ds(ARGS_TOTEXT) {
 	isc_region_t sr;
-	char buf[sizeof("64000 ")];
 	unsigned int n;
 
 	REQUIRE(rdata->length != 0);
@@ -106,24 +105,23 @@ generic_totext_ds(ARGS_TOTEXT) {
 	 */
 	n = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Algorithm.
 	 */
 	n = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Digest type.
 	 */
 	n = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
 
 	/*
 	 * Digest.
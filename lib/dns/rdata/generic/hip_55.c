@@ -122,7 +122,6 @@ totext_hip(ARGS_TOTEXT) {
 	dns_name_t name;
 	unsigned int length, key_len, hit_len;
 	unsigned char algorithm;
-	char buf[sizeof("225 ")];
 
 	REQUIRE(rdata->type == dns_rdatatype_hip);
 	REQUIRE(rdata->length != 0);
@@ -145,8 +144,8 @@ totext_hip(ARGS_TOTEXT) {
 	/*
 	 * Algorithm
 	 */
-	snprintf(buf, sizeof(buf), "%u ", algorithm);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(algorithm, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * HIT.
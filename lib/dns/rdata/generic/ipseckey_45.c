@@ -125,7 +125,6 @@ static isc_result_t
 totext_ipseckey(ARGS_TOTEXT) {
 	isc_region_t region;
 	dns_name_t name;
-	char buf[sizeof("255 ")];
 	unsigned short num;
 	unsigned short gateway;
 
@@ -148,24 +147,24 @@ totext_ipseckey(ARGS_TOTEXT) {
 	dns_rdata_toregion(rdata, &region);
 	num = uint8_fromregion(&region);
 	isc_region_consume(&region, 1);
-	snprintf(buf, sizeof(buf), "%u ", num);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(num, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Gateway type.
 	 */
 	gateway = uint8_fromregion(&region);
 	isc_region_consume(&region, 1);
-	snprintf(buf, sizeof(buf), "%u ", gateway);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(gateway, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Algorithm.
 	 */
 	num = uint8_fromregion(&region);
 	isc_region_consume(&region, 1);
-	snprintf(buf, sizeof(buf), "%u ", num);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(num, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Gateway.
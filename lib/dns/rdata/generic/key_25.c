@@ -124,8 +124,7 @@ generic_totext_key(ARGS_TOTEXT) {
 	/* flags */
 	flags = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
-	snprintf(buf, sizeof(buf), "%u", flags);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(flags, target));
 	RETERR(str_totext(" ", target));
 	if ((flags & DNS_KEYFLAG_KSK) != 0) {
 		if (flags & DNS_KEYFLAG_REVOKE) {
@@ -220,8 +219,7 @@ generic_totext_key(ARGS_TOTEXT) {
 		RETERR(str_totext(algbuf, target));
 		RETERR(str_totext(" ; key id = ", target));
 		dns_rdata_toregion(rdata, &tmpr);
-		snprintf(buf, sizeof(buf), "%u", dst_region_computeid(&tmpr));
-		RETERR(str_totext(buf, target));
+		RETERR(uint_totext(dst_region_computeid(&tmpr), target));
 	}
 	return (ISC_R_SUCCESS);
 }
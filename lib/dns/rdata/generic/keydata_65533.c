@@ -125,8 +125,7 @@ totext_keydata(ARGS_TOTEXT) {
 	/* flags */
 	flags = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
-	snprintf(buf, sizeof(buf), "%u", flags);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(flags, target));
 	RETERR(str_totext(" ", target));
 	if ((flags & DNS_KEYFLAG_KSK) != 0) {
 		if ((flags & DNS_KEYFLAG_REVOKE) != 0) {
@@ -203,8 +202,7 @@ totext_keydata(ARGS_TOTEXT) {
 		dns_rdata_toregion(rdata, &tmpr);
 		/* Skip over refresh, addhd, and removehd */
 		isc_region_consume(&tmpr, 12);
-		snprintf(buf, sizeof(buf), "%u", dst_region_computeid(&tmpr));
-		RETERR(str_totext(buf, target));
+		RETERR(uint_totext(dst_region_computeid(&tmpr), target));
 
 		if ((tctx->flags & DNS_STYLEFLAG_MULTILINE) != 0) {
 			isc_stdtime_t now = isc_stdtime_now();
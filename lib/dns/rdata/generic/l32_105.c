@@ -59,7 +59,6 @@ fromtext_l32(ARGS_FROMTEXT) {
 static isc_result_t
 totext_l32(ARGS_TOTEXT) {
 	isc_region_t region;
-	char buf[sizeof("65000")];
 	unsigned short num;
 
 	REQUIRE(rdata->type == dns_rdatatype_l32);
@@ -70,8 +69,7 @@ totext_l32(ARGS_TOTEXT) {
 	dns_rdata_toregion(rdata, &region);
 	num = uint16_fromregion(&region);
 	isc_region_consume(&region, 2);
-	snprintf(buf, sizeof(buf), "%u", num);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(num, target));
 
 	RETERR(str_totext(" ", target));
 
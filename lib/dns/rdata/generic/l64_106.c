@@ -63,8 +63,7 @@ totext_l64(ARGS_TOTEXT) {
 	dns_rdata_toregion(rdata, &region);
 	num = uint16_fromregion(&region);
 	isc_region_consume(&region, 2);
-	snprintf(buf, sizeof(buf), "%u", num);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(num, target));
 
 	RETERR(str_totext(" ", target));
 
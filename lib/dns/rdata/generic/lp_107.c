@@ -56,7 +56,6 @@ totext_lp(ARGS_TOTEXT) {
 	dns_name_t name;
 	dns_name_t prefix;
 	unsigned int opts;
-	char buf[sizeof("64000")];
 	unsigned short num;
 
 	REQUIRE(rdata->type == dns_rdatatype_lp);
@@ -68,8 +67,7 @@ totext_lp(ARGS_TOTEXT) {
 	dns_rdata_toregion(rdata, &region);
 	num = uint16_fromregion(&region);
 	isc_region_consume(&region, 2);
-	snprintf(buf, sizeof(buf), "%u", num);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(num, target));
 
 	RETERR(str_totext(" ", target));
 
@@ -245,7 +245,6 @@ totext_naptr(ARGS_TOTEXT) {
 	dns_name_t name;
 	dns_name_t prefix;
 	unsigned int opts;
-	char buf[sizeof("64000")];
 	unsigned short num;
 
 	REQUIRE(rdata->type == dns_rdatatype_naptr);
@@ -261,8 +260,7 @@ totext_naptr(ARGS_TOTEXT) {
 	 */
 	num = uint16_fromregion(&region);
 	isc_region_consume(&region, 2);
-	snprintf(buf, sizeof(buf), "%u", num);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(num, target));
 	RETERR(str_totext(" ", target));
 
 	/*
@@ -270,8 +268,7 @@ totext_naptr(ARGS_TOTEXT) {
 	 */
 	num = uint16_fromregion(&region);
 	isc_region_consume(&region, 2);
-	snprintf(buf, sizeof(buf), "%u", num);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(num, target));
 	RETERR(str_totext(" ", target));
 
 	/*
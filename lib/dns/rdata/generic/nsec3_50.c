@@ -111,7 +111,6 @@ totext_nsec3(ARGS_TOTEXT) {
 	unsigned int i, j;
 	unsigned char hash;
 	unsigned char flags;
-	char buf[sizeof("TYPE65535")];
 	uint32_t iterations;
 
 	REQUIRE(rdata->type == dns_rdatatype_nsec3);
@@ -122,20 +121,20 @@ totext_nsec3(ARGS_TOTEXT) {
 	/* Hash */
 	hash = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u ", hash);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(hash, target));
+	RETERR(str_totext(" ", target));
 
 	/* Flags */
 	flags = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u ", flags);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(flags, target));
+	RETERR(str_totext(" ", target));
 
 	/* Iterations */
 	iterations = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
-	snprintf(buf, sizeof(buf), "%u ", iterations);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(iterations, target));
+	RETERR(str_totext(" ", target));
 
 	/* Salt */
 	j = uint8_fromregion(&sr);
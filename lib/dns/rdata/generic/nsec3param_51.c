@@ -96,7 +96,6 @@ totext_nsec3param(ARGS_TOTEXT) {
 	unsigned int i, j;
 	unsigned char hash;
 	unsigned char flags;
-	char buf[sizeof("65535 ")];
 	uint32_t iterations;
 
 	REQUIRE(rdata->type == dns_rdatatype_nsec3param);
@@ -115,14 +114,14 @@ totext_nsec3param(ARGS_TOTEXT) {
 	iterations = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
 
-	snprintf(buf, sizeof(buf), "%u ", hash);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(hash, target));
+	RETERR(str_totext(" ", target));
 
-	snprintf(buf, sizeof(buf), "%u ", flags);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(flags, target));
+	RETERR(str_totext(" ", target));
 
-	snprintf(buf, sizeof(buf), "%u ", iterations);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(iterations, target));
+	RETERR(str_totext(" ", target));
 
 	j = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
@@ -211,17 +211,15 @@ totext_rrsig(ARGS_TOTEXT) {
 	/*
 	 * Algorithm.
 	 */
-	snprintf(buf, sizeof(buf), "%u", sr.base[0]);
+	RETERR(uint_totext(sr.base[0], target));
 	isc_region_consume(&sr, 1);
-	RETERR(str_totext(buf, target));
 	RETERR(str_totext(" ", target));
 
 	/*
 	 * Labels.
 	 */
-	snprintf(buf, sizeof(buf), "%u", sr.base[0]);
+	RETERR(uint_totext(sr.base[0], target));
 	isc_region_consume(&sr, 1);
-	RETERR(str_totext(buf, target));
 	RETERR(str_totext(" ", target));
 
 	/*
@@ -229,8 +227,7 @@ totext_rrsig(ARGS_TOTEXT) {
 	 */
 	ttl = uint32_fromregion(&sr);
 	isc_region_consume(&sr, 4);
-	snprintf(buf, sizeof(buf), "%lu", ttl);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(ttl, target));
 
 	if ((tctx->flags & DNS_STYLEFLAG_MULTILINE) != 0) {
 		RETERR(str_totext(" (", target));
@@ -258,8 +255,7 @@ totext_rrsig(ARGS_TOTEXT) {
 	 */
 	foot = uint16_fromregion(&sr);
 	isc_region_consume(&sr, 2);
-	snprintf(buf, sizeof(buf), "%lu", foot);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(foot, target));
 	RETERR(str_totext(" ", target));
 
 	/*
@@ -66,7 +66,6 @@ totext_rt(ARGS_TOTEXT) {
 	dns_name_t name;
 	dns_name_t prefix;
 	unsigned int opts;
-	char buf[sizeof("64000")];
 	unsigned short num;
 
 	REQUIRE(rdata->type == dns_rdatatype_rt);
@@ -78,8 +77,7 @@ totext_rt(ARGS_TOTEXT) {
 	dns_rdata_toregion(rdata, &region);
 	num = uint16_fromregion(&region);
 	isc_region_consume(&region, 2);
-	snprintf(buf, sizeof(buf), "%u", num);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(num, target));
 	RETERR(str_totext(" ", target));
 	dns_name_fromregion(&name, &region);
 	opts = name_prefix(&name, tctx->origin, &prefix) ? DNS_NAME_OMITFINALDOT
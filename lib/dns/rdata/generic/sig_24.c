@@ -169,8 +169,7 @@ totext_sig(ARGS_TOTEXT) {
 	if (dns_rdatatype_isknown(covered) && covered != 0) {
 		RETERR(dns_rdatatype_totext(covered, target));
 	} else {
-		snprintf(buf, sizeof(buf), "%u", covered);
-		RETERR(str_totext(buf, target));
+		RETERR(uint_totext(covered, target));
 	}
 	RETERR(str_totext(" ", target));
 
@@ -134,8 +134,12 @@ totext_soa(ARGS_TOTEXT) {
 		unsigned long num;
 		num = uint32_fromregion(&dregion);
 		isc_region_consume(&dregion, 4);
-		snprintf(buf, sizeof(buf), comm ? "%-10lu ; " : "%lu", num);
-		RETERR(str_totext(buf, target));
+		if (comm) {
+			snprintf(buf, sizeof(buf), "%-10lu ; ", num);
+			RETERR(str_totext(buf, target));
+		} else {
+			RETERR(uint_totext(num, target));
+		}
 		if (comm) {
 			RETERR(str_totext(soa_fieldnames[i], target));
 			/* Print times in week/day/hour/minute/second form */
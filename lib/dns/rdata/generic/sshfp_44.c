@@ -74,7 +74,6 @@ fromtext_sshfp(ARGS_FROMTEXT) {
 static isc_result_t
 totext_sshfp(ARGS_TOTEXT) {
 	isc_region_t sr;
-	char buf[sizeof("64000 ")];
 	unsigned int n;
 
 	REQUIRE(rdata->type == dns_rdatatype_sshfp);
@@ -89,16 +88,15 @@ totext_sshfp(ARGS_TOTEXT) {
 	 */
 	n = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Digest type.
 	 */
 	n = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
 
 	if (sr.length == 0U) {
 		return (ISC_R_SUCCESS);
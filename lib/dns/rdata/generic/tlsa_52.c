@@ -67,7 +67,6 @@ generic_fromtext_tlsa(ARGS_FROMTEXT) {
 static isc_result_t
 generic_totext_tlsa(ARGS_TOTEXT) {
 	isc_region_t sr;
-	char buf[sizeof("64000 ")];
 	unsigned int n;
 
 	REQUIRE(rdata->length != 0);
@@ -81,24 +80,23 @@ generic_totext_tlsa(ARGS_TOTEXT) {
 	 */
 	n = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Selector.
 	 */
 	n = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u ", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Matching type.
 	 */
 	n = uint8_fromregion(&sr);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u", n);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(n, target));
 
 	/*
 	 * Certificate Association Data.
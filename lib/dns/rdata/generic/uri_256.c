@@ -64,7 +64,6 @@ static isc_result_t
 totext_uri(ARGS_TOTEXT) {
 	isc_region_t region;
 	unsigned short priority, weight;
-	char buf[sizeof("65000 ")];
 
 	UNUSED(tctx);
 
@@ -78,16 +77,16 @@ totext_uri(ARGS_TOTEXT) {
 	 */
 	priority = uint16_fromregion(&region);
 	isc_region_consume(&region, 2);
-	snprintf(buf, sizeof(buf), "%u ", priority);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(priority, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Weight
 	 */
 	weight = uint16_fromregion(&region);
 	isc_region_consume(&region, 2);
-	snprintf(buf, sizeof(buf), "%u ", weight);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(weight, target));
+	RETERR(str_totext(" ", target));
 
 	/*
 	 * Target URI
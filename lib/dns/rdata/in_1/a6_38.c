@@ -103,7 +103,6 @@ totext_in_a6(ARGS_TOTEXT) {
 	unsigned char prefixlen;
 	unsigned char octets;
 	unsigned char mask;
-	char buf[sizeof("128")];
 	dns_name_t name;
 	dns_name_t prefix;
 	unsigned int opts;
@@ -116,8 +115,7 @@ totext_in_a6(ARGS_TOTEXT) {
 	prefixlen = sr.base[0];
 	INSIST(prefixlen <= 128);
 	isc_region_consume(&sr, 1);
-	snprintf(buf, sizeof(buf), "%u", prefixlen);
-	RETERR(str_totext(buf, target));
+	RETERR(uint_totext(prefixlen, target));
 	RETERR(str_totext(" ", target));
 
 	if (prefixlen != 128) {
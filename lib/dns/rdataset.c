@@ -620,6 +620,27 @@ dns_rdataset_clearprefetch(dns_rdataset_t *rdataset) {
 	}
 }
 
+uint64_t
+dns_rdataset_getrpztag(const dns_rdataset_t *rdataset) {
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(rdataset->methods != NULL);
+
+	if (rdataset->methods->getrpztag != NULL) {
+		return ((rdataset->methods->getrpztag)(rdataset));
+	}
+	return (0);
+}
+
+void
+dns_rdataset_setrpztag(dns_rdataset_t *rdataset, uint64_t tag) {
+	REQUIRE(DNS_RDATASET_VALID(rdataset));
+	REQUIRE(rdataset->methods != NULL);
+
+	if (rdataset->methods->setrpztag != NULL) {
+		(rdataset->methods->setrpztag)(rdataset, tag);
+	}
+}
+
 void
 dns_rdataset_setownercase(dns_rdataset_t *rdataset, const dns_name_t *name) {
 	REQUIRE(DNS_RDATASET_VALID(rdataset));
@@ -18,10 +18,13 @@
 #include <stdlib.h>
 
 #include <isc/ascii.h>
+#include <isc/hash.h>
 #include <isc/mem.h>
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/string.h>
+#include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #include <dns/db.h>
@@ -89,6 +92,13 @@ struct xrdata {
 #endif /* if DNS_RDATASET_FIXED */
 };
 
+/*%
+ * Most RRsets are small, so dns_rdataslab_fromrdataset() keeps its
+ * working arrays on the stack up to this many records, and only
+ * allocates them for larger RRsets.
+ */
+#define XRDATA_STACK 32
+
 static void
 rdataset_disassociate(dns_rdataset_t *rdataset DNS__DB_FLARG);
 static isc_result_t
@@ -117,6 +127,10 @@ static void
 rdataset_setownercase(dns_rdataset_t *rdataset, const dns_name_t *name);
 static void
 rdataset_getownercase(const dns_rdataset_t *rdataset, dns_name_t *name);
+static uint64_t
+rdataset_getrpztag(const dns_rdataset_t *rdataset);
+static void
+rdataset_setrpztag(dns_rdataset_t *rdataset, uint64_t tag);
 
 /*% Note: the "const void *" are just to make qsort happy.  */
 static int
@@ -126,6 +140,34 @@ compare_rdata(const void *p1, const void *p2) {
 	return (dns_rdata_compare(&x1->rdata, &x2->rdata));
 }
 
+/*
+ * Put the records into DNSSEC order.  The rdata in an rdataset built
+ * from a message, or in one that came from another slab, is often in
+ * order already, which an insertion sort handles in a single pass.
+ */
+static void
+sort_rdata(struct xrdata *x, unsigned int n) {
+	if (n > XRDATA_STACK) {
+		qsort(x, n, sizeof(struct xrdata), compare_rdata);
+		return;
+	}
+
+	for (unsigned int i = 1; i < n; i++) {
+		struct xrdata tmp;
+		unsigned int j = i;
+
+		if (compare_rdata(&x[i - 1], &x[i]) <= 0) {
+			continue;
+		}
+		tmp = x[i];
+		do {
+			x[j] = x[j - 1];
+			j--;
+		} while (j > 0 && compare_rdata(&x[j - 1], &tmp) > 0);
+		x[j] = tmp;
+	}
+}
+
 #if DNS_RDATASET_FIXED
 static void
 fillin_offsets(unsigned char *offsetbase, unsigned int *offsettable,
@@ -165,6 +207,7 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	 * rdata as rdata.data == NULL is valid.
 	 */
 	static unsigned char removed;
+	struct xrdata xstack[XRDATA_STACK];
 	struct xrdata *x = NULL;
 	unsigned char *rawbuf = NULL;
 	unsigned int buflen;
@@ -174,6 +217,7 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	unsigned int length;
 	unsigned int i;
 #if DNS_RDATASET_FIXED
+	unsigned int offsetstack[XRDATA_STACK];
 	unsigned char *offsetbase = NULL;
 	unsigned int *offsettable = NULL;
 #endif /* if DNS_RDATASET_FIXED */
@@ -207,7 +251,11 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	 * Remember the original number of items.
 	 */
 	nalloc = nitems;
-	x = isc_mem_cget(mctx, nalloc, sizeof(struct xrdata));
+	if (nalloc <= XRDATA_STACK) {
+		x = xstack;
+	} else {
+		x = isc_mem_cget(mctx, nalloc, sizeof(struct xrdata));
+	}
 
 	/*
 	 * Save all of the rdata members into an array.
@@ -241,7 +289,7 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	 * Put into DNSSEC order.
 	 */
 	if (nalloc > 1U) {
-		qsort(x, nalloc, sizeof(struct xrdata), compare_rdata);
+		sort_rdata(x, nalloc);
 	}
 
 	/*
@@ -315,8 +363,13 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 	rawbuf = isc_mem_cget(mctx, 1, buflen);
 
 #if DNS_RDATASET_FIXED
-	/* Allocate temporary offset table. */
-	offsettable = isc_mem_cget(mctx, nalloc, sizeof(unsigned int));
+	/* Set up the temporary offset table. */
+	if (nalloc <= XRDATA_STACK) {
+		offsettable = offsetstack;
+		memset(offsettable, 0, nalloc * sizeof(unsigned int));
+	} else {
+		offsettable = isc_mem_cget(mctx, nalloc, sizeof(unsigned int));
+	}
 #endif /* if DNS_RDATASET_FIXED */
 
 	region->base = rawbuf;
@@ -369,13 +422,17 @@ dns_rdataslab_fromrdataset(dns_rdataset_t *rdataset, isc_mem_t *mctx,
 
 #if DNS_RDATASET_FIXED
 	fillin_offsets(offsetbase, offsettable, nalloc);
-	isc_mem_cput(mctx, offsettable, nalloc, sizeof(unsigned int));
+	if (offsettable != offsetstack) {
+		isc_mem_cput(mctx, offsettable, nalloc, sizeof(unsigned int));
+	}
 #endif /* if DNS_RDATASET_FIXED */
 
 	result = ISC_R_SUCCESS;
 
 free_rdatas:
-	isc_mem_cput(mctx, x, nalloc, sizeof(struct xrdata));
+	if (x != xstack) {
+		isc_mem_cput(mctx, x, nalloc, sizeof(struct xrdata));
+	}
 	return (result);
 }
 
@@ -1093,19 +1150,41 @@ dns_slabheader_copycase(dns_slabheader_t *dest, dns_slabheader_t *src) {
 	}
 }
 
+/*
+ * Per-thread rotation counters for the "cyclic" rrset-order.  Headers
+ * that hash to the same slot share a counter, which only makes their
+ * rotation skip ahead now and then.
+ */
+#define CYCLE_BITS 8
+
+static thread_local uint16_t cycle_counts[1 << CYCLE_BITS];
+
+uint32_t
+dns_slabheader_cycle(const dns_slabheader_t *header) {
+	uint32_t slot = isc_hash_bits32((uint32_t)((uintptr_t)header >> 4),
+					CYCLE_BITS);
+
+	return (header->count + (uint32_t)isc_tid() + cycle_counts[slot]++);
+}
+
 void
 dns_slabheader_reset(dns_slabheader_t *h, dns_db_t *db, dns_dbnode_t *node) {
 	ISC_LINK_INIT(h, link);
 	h->heap_index = 0;
 	h->heap = NULL;
-	h->glue_list = NULL;
 	h->db = db;
 	h->node = node;
 
 	atomic_init(&h->attributes, 0);
 	atomic_init(&h->last_refresh_fail_ts, 0);
+	atomic_init(&h->rpztag, 0);
 
-	cds_wfs_node_init(&h->wfs_node);
+	if (dns_db_iscache(db)) {
+		ISC_LINK_INIT(h, ttllink);
+	} else {
+		h->glue_list = NULL;
+		cds_wfs_node_init(&h->wfs_node);
+	}
 
 	STATIC_ASSERT((sizeof(h->attributes) == 2),
 		      "The .attributes field of dns_slabheader_t needs to be "
@@ -1176,6 +1255,8 @@ dns_rdatasetmethods_t dns_rdataslab_rdatasetmethods = {
 	.clearprefetch = rdataset_clearprefetch,
 	.setownercase = rdataset_setownercase,
 	.getownercase = rdataset_getownercase,
+	.getrpztag = rdataset_getrpztag,
+	.setrpztag = rdataset_setrpztag,
 };
 
 /* Fixed RRSet helper macros */
@@ -1501,3 +1582,17 @@ rdataset_getownercase(const dns_rdataset_t *rdataset, dns_name_t *name) {
 unlock:
 	dns_db_unlocknode(header->db, header->node, isc_rwlocktype_read);
 }
+
+static uint64_t
+rdataset_getrpztag(const dns_rdataset_t *rdataset) {
+	dns_slabheader_t *header = dns_slabheader_fromrdataset(rdataset);
+
+	return (atomic_load_relaxed(&header->rpztag));
+}
+
+static void
+rdataset_setrpztag(dns_rdataset_t *rdataset, uint64_t tag) {
+	dns_slabheader_t *header = dns_slabheader_fromrdataset(rdataset);
+
+	atomic_store_relaxed(&header->rpztag, tag);
+}
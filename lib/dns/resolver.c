@@ -23,9 +23,11 @@
 #include <isc/counter.h>
 #include <isc/hash.h>
 #include <isc/hashmap.h>
+#include <isc/histo.h>
 #include <isc/log.h>
 #include <isc/loop.h>
 #include <isc/mutex.h>
+#include <isc/quota.h>
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
@@ -36,6 +38,7 @@
 #include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/timer.h>
+#include <isc/urcu.h>
 #include <isc/util.h>
 
 #include <dns/acl.h>
@@ -74,6 +77,15 @@
 #include <dns/validator.h>
 #include <dns/zone.h>
 
+#ifdef HAVE_JSON_C
+#include <json_object.h>
+#endif /* HAVE_JSON_C */
+
+#ifdef HAVE_LIBXML2
+#include <libxml/xmlwriter.h>
+#define ISC_XMLCHAR (const xmlChar *)
+#endif /* HAVE_LIBXML2 */
+
 #ifdef WANT_QUERYTRACE
 #define RTRACE(m)                                                             \
 	isc_log_write(dns_lctx, DNS_LOGCATEGORY_RESOLVER,                     \
@@ -248,6 +260,20 @@ STATIC_ASSERT(NS_PROCESSING_LIMIT > NS_RR_LIMIT,
 
 typedef struct fetchctx fetchctx_t;
 
+/*%
+ * The table of the active fetch contexts.  It is normally private to
+ * one resolver, but the resolvers of the views sharing a cache can also
+ * share the table (see dns_resolver_sharefetches()), so that the same
+ * name and type fetched from several views results in a single fetch
+ * context whose answer is delivered to all the waiters.
+ */
+typedef struct fctxtable {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	isc_hashmap_t *hashmap;
+	isc_rwlock_t lock;
+} fctxtable_t;
+
 typedef struct query {
 	/* Locked by loop event serialization. */
 	unsigned int magic;
@@ -258,6 +284,7 @@ typedef struct query {
 	dns_dispatch_t *dispatch;
 	dns_adbaddrinfo_t *addrinfo;
 	isc_time_t start;
+	isc_time_t sent;
 	dns_messageid_t id;
 	dns_dispentry_t *dispentry;
 	ISC_LINK(struct query) link;
@@ -293,6 +320,7 @@ struct tried {
 #define VALID_QUERY(query) ISC_MAGIC_VALID(query, QUERY_MAGIC)
 
 #define RESQUERY_ATTR_CANCELED 0x02
+#define RESQUERY_ATTR_HEDGED	0x04
 
 #define RESQUERY_CONNECTING(q) ((q)->connects > 0)
 #define RESQUERY_CANCELED(q)   (((q)->attributes & RESQUERY_ATTR_CANCELED) != 0)
@@ -317,15 +345,23 @@ typedef struct fctxcount fctxcount_t;
 struct fctxcount {
 	unsigned int magic;
 	isc_mem_t *mctx;
-	isc_mutex_t lock;
 	dns_fixedname_t dfname;
 	dns_name_t *domain;
-	uint_fast32_t count;
-	uint_fast32_t allowed;
-	uint_fast32_t dropped;
-	isc_stdtime_t logged;
+	atomic_uint_fast32_t count;
+	atomic_uint_fast32_t allowed;
+	atomic_uint_fast32_t dropped;
+	_Atomic(isc_stdtime_t) logged;
+
+	struct cds_lfht_node ht_node;
+	struct rcu_head rcu_head;
 };
 
+/*
+ * The count of a counter that dropped to zero and is being removed from
+ * the table; fcount_incr() must not use it any more.
+ */
+#define FCTXCOUNT_DEAD UINT32_MAX
+
 struct fetchctx {
 	/*% Not locked. */
 	unsigned int magic;
@@ -360,6 +396,7 @@ struct fetchctx {
 	dns_rdataset_t nameservers;
 	atomic_uint_fast32_t attributes;
 	isc_timer_t *timer;
+	isc_timer_t *hedgetimer;
 	isc_time_t expires;
 	isc_time_t next_timeout;
 	isc_interval_t interval;
@@ -380,7 +417,6 @@ struct fetchctx {
 	dns_fwdpolicy_t fwdpolicy;
 	isc_sockaddrlist_t bad;
 	ISC_LIST(struct tried) edns;
-	isc_sockaddrlist_t bad_edns;
 	dns_validator_t *validator;
 	ISC_LIST(dns_validator_t) validators;
 	dns_db_t *cache;
@@ -451,6 +487,7 @@ struct fetchctx {
 	isc_result_t result;  /*%< fetch result */
 	isc_result_t vresult; /*%< validation result */
 	isc_time_t start;
+	isc_time_t addrwait;
 	uint64_t duration;
 	bool logged;
 	unsigned int querysent;
@@ -507,8 +544,66 @@ struct fetchctx {
 typedef struct {
 	dns_adbaddrinfo_t *addrinfo;
 	fetchctx_t *fctx;
+	isc_time_t start;
 } dns_valarg_t;
 
+/*%
+ * Query latency histograms, in microseconds.  Round trip times are
+ * recorded per transport, per upstream server and per zone cut, and the
+ * time spent in each phase of a fetch per phase.  The per-server and
+ * per-zone cut tables stop growing once they are full, so that they
+ * stay small however many servers the resolver talks to.
+ */
+#define RES_LATENCY_SIGBITS    4
+#define RES_LATENCY_HASH_BITS  8
+#define RES_LATENCY_MAXSERVERS 1024
+#define RES_LATENCY_MAXZONES   1024
+
+/*%
+ * Hedged queries are timed by the server's round trip time histogram
+ * once it has this many samples, and by its SRTT until then.
+ */
+#define RES_HEDGE_MINSAMPLES 16
+
+typedef enum {
+	latency_udp4 = 0,
+	latency_udp6,
+	latency_tcp4,
+	latency_tcp6,
+	latency_transport_max
+} latency_transport_t;
+
+static const char *latency_transport_names[latency_transport_max] = {
+	"UDPv4",
+	"UDPv6",
+	"TCPv4",
+	"TCPv6",
+};
+
+typedef enum {
+	latency_adbwait = 0,
+	latency_send,
+	latency_response,
+	latency_validation,
+	latency_fetch,
+	latency_phase_max
+} latency_phase_t;
+
+static const char *latency_phase_names[latency_phase_max] = {
+	"ADBWait",
+	"Send",
+	"Response",
+	"Validation",
+	"Fetch",
+};
+
+typedef struct reslatency {
+	isc_sockaddr_t addr;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	isc_histo_t *hg;
+} reslatency_t;
+
 struct dns_fetch {
 	unsigned int magic;
 	isc_mem_t *mctx;
@@ -547,11 +642,9 @@ struct dns_resolver {
 	dns_dispatchset_t *dispatches4;
 	dns_dispatchset_t *dispatches6;
 
-	isc_hashmap_t *fctxs;
-	isc_rwlock_t fctxs_lock;
+	fctxtable_t *fctxs;
 
-	isc_hashmap_t *counters;
-	isc_rwlock_t counters_lock;
+	struct cds_lfht *counters;
 
 	uint32_t lame_ttl;
 	ISC_LIST(alternate_t) alternates;
@@ -569,6 +662,17 @@ struct dns_resolver {
 	isc_stats_t *stats;
 	dns_stats_t *querystats;
 
+	/* Latency histograms; the tables are locked by latency_lock. */
+	isc_histomulti_t *transport_latency[latency_transport_max];
+	isc_histomulti_t *phase_latency[latency_phase_max];
+	isc_hashmap_t *server_latency;
+	isc_hashmap_t *zone_latency;
+	isc_rwlock_t latency_lock;
+
+	/* Hedged queries. */
+	unsigned int hedgepercentile;
+	isc_quota_t hedgequota;
+
 	/* Additions for serve-stale feature. */
 	unsigned int retryinterval; /* in milliseconds */
 	unsigned int nonbackofftries;
@@ -585,7 +689,9 @@ struct dns_resolver {
 	/* Locked by lock. */
 	unsigned int spillat; /* clients-per-query */
 
-	dns_badcache_t *badcache; /* Bad cache. */
+	dns_badcache_t *badcache;  /* Bad cache. */
+	dns_badcache_t *failcache; /* Recently failed fetches. */
+	dns_badcache_t *qmincache; /* Zones seen with no cuts below. */
 
 	/* Locked by primelock. */
 	dns_fetch_t *primefetch;
@@ -603,7 +709,9 @@ struct dns_resolver {
 #define VALID_RESOLVER(res) ISC_MAGIC_VALID(res, RES_MAGIC)
 
 /*%
- * Private addrinfo flags.
+ * Private addrinfo flags.  Those that describe what a server supports
+ * are also recorded in its ADB entry with dns_adb_changeflags(), so
+ * that later fetches start from what earlier ones have learned.
  */
 enum {
 	FCTX_ADDRINFO_MARK = 1 << 0,
@@ -613,6 +721,7 @@ enum {
 	FCTX_ADDRINFO_BADCOOKIE = 1 << 4,
 	FCTX_ADDRINFO_DUALSTACK = 1 << 5,
 	FCTX_ADDRINFO_NOEDNS0 = 1 << 6,
+	FCTX_ADDRINFO_BADEDNS = 1 << 7,
 };
 
 #define UNMARKED(a)    (((a)->flags & FCTX_ADDRINFO_MARK) == 0)
@@ -621,6 +730,7 @@ enum {
 #define EDNSOK(a)      (((a)->flags & FCTX_ADDRINFO_EDNSOK) != 0)
 #define BADCOOKIE(a)   (((a)->flags & FCTX_ADDRINFO_BADCOOKIE) != 0)
 #define ISDUALSTACK(a) (((a)->flags & FCTX_ADDRINFO_DUALSTACK) != 0)
+#define BADEDNS(a)     (((a)->flags & FCTX_ADDRINFO_BADEDNS) != 0)
 
 #define NXDOMAIN(r) (((r)->attributes & DNS_RDATASETATTR_NXDOMAIN) != 0)
 #define NEGATIVE(r) (((r)->attributes & DNS_RDATASETATTR_NEGATIVE) != 0)
@@ -692,6 +802,8 @@ ISC_REFCOUNT_TRACE_DECL(fetchctx);
 ISC_REFCOUNT_DECL(fetchctx);
 #endif
 
+ISC_REFCOUNT_DECL(fctxtable);
+
 static bool
 fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 	   const char *file, unsigned int line);
@@ -964,6 +1076,7 @@ valcreate(fetchctx_t *fctx, dns_message_t *message, dns_adbaddrinfo_t *addrinfo,
 	valarg = isc_mem_get(fctx->mctx, sizeof(*valarg));
 	*valarg = (dns_valarg_t){
 		.addrinfo = addrinfo,
+		.start = isc_time_now(),
 	};
 
 	fetchctx_attach(fctx, &valarg->fctx);
@@ -1022,6 +1135,10 @@ resquery_destroy(resquery_t *query) {
 		dns_message_detach(&query->rmessage);
 	}
 
+	if ((query->attributes & RESQUERY_ATTR_HEDGED) != 0) {
+		isc_quota_release(&fctx->res->hedgequota);
+	}
+
 	isc_mem_put(fctx->mctx, query, sizeof(*query));
 
 	fetchctx_detach(&fctx);
@@ -1084,6 +1201,140 @@ fctx_stoptimer(fetchctx_t *fctx) {
 	isc_timer_stop(fctx->timer);
 }
 
+static void
+latency_phase(dns_resolver_t *res, latency_phase_t phase,
+	      const isc_time_t *start, const isc_time_t *finish) {
+	isc_histomulti_inc(res->phase_latency[phase],
+			   isc_time_microdiff(finish, start));
+}
+
+static bool
+server_latency_match(void *node, const void *key) {
+	const reslatency_t *entry = node;
+
+	return (isc_sockaddr_equal(&entry->addr, key));
+}
+
+static bool
+zone_latency_match(void *node, const void *key) {
+	const reslatency_t *entry = node;
+
+	return (dns_name_equal(entry->name, key));
+}
+
+/*
+ * Find the histogram for 'addr' or 'name' in the latency table 'map',
+ * adding it if there is room.
+ */
+static isc_histo_t *
+latency_find(dns_resolver_t *res, isc_hashmap_t *map, unsigned int max,
+	     const isc_sockaddr_t *addr, const dns_name_t *name) {
+	isc_rwlocktype_t locktype = isc_rwlocktype_read;
+	isc_hashmap_match_fn match = NULL;
+	reslatency_t *entry = NULL;
+	const void *key = NULL;
+	uint32_t hashval;
+	isc_result_t result;
+
+	if (addr != NULL) {
+		hashval = isc_sockaddr_hash(addr, false);
+		match = server_latency_match;
+		key = addr;
+	} else {
+		hashval = dns_name_hash(name);
+		match = zone_latency_match;
+		key = name;
+	}
+
+	RWLOCK(&res->latency_lock, locktype);
+	result = isc_hashmap_find(map, hashval, match, key, (void **)&entry);
+	if (result == ISC_R_NOTFOUND) {
+		UPGRADELOCK(&res->latency_lock, locktype);
+		result = isc_hashmap_find(map, hashval, match, key,
+					  (void **)&entry);
+	}
+	if (result == ISC_R_NOTFOUND && isc_hashmap_count(map) < max) {
+		entry = isc_mem_get(res->mctx, sizeof(*entry));
+		*entry = (reslatency_t){ 0 };
+		isc_histo_create(res->mctx, RES_LATENCY_SIGBITS, &entry->hg);
+		if (addr != NULL) {
+			entry->addr = *addr;
+			key = &entry->addr;
+		} else {
+			entry->name = dns_fixedname_initname(&entry->fname);
+			dns_name_copy(name, entry->name);
+			key = entry->name;
+		}
+		result = isc_hashmap_add(map, hashval, match, key, entry,
+					 NULL);
+		INSIST(result == ISC_R_SUCCESS);
+	}
+	RWUNLOCK(&res->latency_lock, locktype);
+
+	/*
+	 * Entries are only freed when the resolver is destroyed, and
+	 * the histograms are safe to update without the lock.
+	 */
+	return (result == ISC_R_SUCCESS ? entry->hg : NULL);
+}
+
+/*
+ * Record the round trip time of 'query', which got a response at
+ * 'finish'.
+ */
+static void
+latency_rtt(resquery_t *query, const isc_time_t *finish, uint64_t rtt) {
+	fetchctx_t *fctx = query->fctx;
+	dns_resolver_t *res = fctx->res;
+	latency_transport_t transport;
+	isc_histo_t *hg = NULL;
+
+	if ((query->options & DNS_FETCHOPT_TCP) != 0) {
+		transport = latency_tcp4;
+	} else {
+		transport = latency_udp4;
+	}
+	if (isc_sockaddr_pf(&query->addrinfo->sockaddr) == AF_INET6) {
+		transport++;
+	}
+	isc_histomulti_inc(res->transport_latency[transport], rtt);
+
+	if (!isc_time_isepoch(&query->sent)) {
+		latency_phase(res, latency_response, &query->sent, finish);
+	}
+
+	hg = latency_find(res, res->server_latency, RES_LATENCY_MAXSERVERS,
+			  &query->addrinfo->sockaddr, NULL);
+	if (hg != NULL) {
+		isc_histo_inc(hg, rtt);
+	}
+
+	hg = latency_find(res, res->zone_latency, RES_LATENCY_MAXZONES, NULL,
+			  fctx->domain);
+	if (hg != NULL) {
+		isc_histo_inc(hg, rtt);
+	}
+}
+
+static void
+latency_destroy(dns_resolver_t *res, isc_hashmap_t **mapp) {
+	isc_hashmap_iter_t *it = NULL;
+	isc_result_t result;
+
+	isc_hashmap_iter_create(*mapp, &it);
+	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_delcurrent_next(it))
+	{
+		reslatency_t *entry = NULL;
+		isc_hashmap_iter_current(it, (void **)&entry);
+
+		isc_histo_destroy(&entry->hg);
+		isc_mem_put(res->mctx, entry, sizeof(*entry));
+	}
+	isc_hashmap_iter_destroy(&it);
+	isc_hashmap_destroy(mapp);
+}
+
 static void
 fctx_cancelquery(resquery_t **queryp, isc_time_t *finish, bool no_response,
 		 bool age_untried) {
@@ -1123,6 +1374,8 @@ fctx_cancelquery(resquery_t **queryp, isc_time_t *finish, bool no_response,
 			rttms = rtt / US_PER_MS;
 			factor = DNS_ADB_RTTADJDEFAULT;
 
+			latency_rtt(query, finish, rtt);
+
 			if (rttms < DNS_RESOLVER_QRYRTTCLASS0) {
 				inc_stats(fctx->res,
 					  dns_resstatscounter_queryrtt0);
@@ -1360,19 +1613,22 @@ static void
 fcount_logspill(fetchctx_t *fctx, fctxcount_t *counter, bool final) {
 	char dbuf[DNS_NAME_FORMATSIZE];
 	isc_stdtime_t now;
+	uint_fast32_t allowed, dropped;
 
 	if (!isc_log_wouldlog(dns_lctx, ISC_LOG_INFO)) {
 		return;
 	}
 
 	/* Do not log a message if there were no dropped fetches. */
-	if (counter->dropped == 0) {
+	dropped = atomic_load_relaxed(&counter->dropped);
+	if (dropped == 0) {
 		return;
 	}
+	allowed = atomic_load_relaxed(&counter->allowed);
 
 	/* Do not log the cumulative message if the previous log is recent. */
 	now = isc_stdtime_now();
-	if (!final && counter->logged > now - 60) {
+	if (!final && atomic_load_relaxed(&counter->logged) > now - 60) {
 		return;
 	}
 
@@ -1384,38 +1640,53 @@ fcount_logspill(fetchctx_t *fctx, fctxcount_t *counter, bool final) {
 			      "too many simultaneous fetches for %s "
 			      "(allowed %" PRIuFAST32 " spilled %" PRIuFAST32
 			      "; %s)",
-			      dbuf, counter->allowed, counter->dropped,
-			      counter->dropped == 1 ? "initial trigger event"
-						    : "cumulative since "
-						      "initial trigger event");
+			      dbuf, allowed, dropped,
+			      dropped == 1 ? "initial trigger event"
+					   : "cumulative since "
+					     "initial trigger event");
 	} else {
 		isc_log_write(dns_lctx, DNS_LOGCATEGORY_SPILL,
 			      DNS_LOGMODULE_RESOLVER, ISC_LOG_INFO,
 			      "fetch counters for %s now being discarded "
 			      "(allowed %" PRIuFAST32 " spilled %" PRIuFAST32
 			      "; cumulative since initial trigger event)",
-			      dbuf, counter->allowed, counter->dropped);
+			      dbuf, allowed, dropped);
 	}
 
-	counter->logged = now;
+	atomic_store_relaxed(&counter->logged, now);
 }
 
-static bool
-fcount_match(void *node, const void *key) {
-	const fctxcount_t *counter = node;
+static int
+fcount_match(struct cds_lfht_node *ht_node, const void *key) {
+	const fctxcount_t *counter = caa_container_of(ht_node, fctxcount_t,
+						      ht_node);
 	const dns_name_t *domain = key;
 
 	return (dns_name_equal(counter->domain, domain));
 }
 
+static void
+fcount_destroy(struct rcu_head *rcu_head) {
+	fctxcount_t *counter = caa_container_of(rcu_head, fctxcount_t,
+						rcu_head);
+
+	counter->magic = 0;
+	isc_mem_putanddetach(&counter->mctx, counter, sizeof(*counter));
+}
+
+/*
+ * Take a slot from the fetch counter of the fetch's domain.  The counters
+ * live in a lock-free hash table; a counter is removed from it by the
+ * fetch that releases its last slot, and fetches that find it while it is
+ * going away simply look it up again.
+ */
 static isc_result_t
 fcount_incr(fetchctx_t *fctx, bool force) {
 	isc_result_t result = ISC_R_SUCCESS;
 	dns_resolver_t *res = NULL;
 	fctxcount_t *counter = NULL;
 	uint32_t hashval;
-	uint_fast32_t spill;
-	isc_rwlocktype_t locktype = isc_rwlocktype_read;
+	uint_fast32_t spill, count;
 
 	REQUIRE(fctx != NULL);
 	res = fctx->res;
@@ -1429,58 +1700,53 @@ fcount_incr(fetchctx_t *fctx, bool force) {
 
 	hashval = dns_name_hash(fctx->domain);
 
-	RWLOCK(&res->counters_lock, locktype);
-	result = isc_hashmap_find(res->counters, hashval, fcount_match,
-				  fctx->domain, (void **)&counter);
-	switch (result) {
-	case ISC_R_SUCCESS:
-		break;
-	case ISC_R_NOTFOUND:
-		counter = isc_mem_get(fctx->mctx, sizeof(*counter));
-		*counter = (fctxcount_t){
+	rcu_read_lock();
+again:
+	counter = NULL;
+	struct cds_lfht_iter iter;
+	cds_lfht_lookup(res->counters, hashval, fcount_match, fctx->domain,
+			&iter);
+	struct cds_lfht_node *ht_node = cds_lfht_iter_get_node(&iter);
+	if (ht_node == NULL) {
+		fctxcount_t *new = isc_mem_get(fctx->mctx, sizeof(*new));
+		*new = (fctxcount_t){
 			.magic = FCTXCOUNT_MAGIC,
-			.count = 0,
-			.allowed = 0,
 		};
-		isc_mem_attach(fctx->mctx, &counter->mctx);
-		isc_mutex_init(&counter->lock);
-		counter->domain = dns_fixedname_initname(&counter->dfname);
-		dns_name_copy(fctx->domain, counter->domain);
+		isc_mem_attach(fctx->mctx, &new->mctx);
+		new->domain = dns_fixedname_initname(&new->dfname);
+		dns_name_copy(fctx->domain, new->domain);
 
-		UPGRADELOCK(&res->counters_lock, locktype);
-
-		void *found = NULL;
-		result = isc_hashmap_add(res->counters, hashval, fcount_match,
-					 counter->domain, counter, &found);
-		if (result == ISC_R_EXISTS) {
-			isc_mutex_destroy(&counter->lock);
-			isc_mem_putanddetach(&counter->mctx, counter,
-					     sizeof(*counter));
-			counter = found;
-			result = ISC_R_SUCCESS;
+		ht_node = cds_lfht_add_unique(res->counters, hashval,
+					      fcount_match, new->domain,
+					      &new->ht_node);
+		if (ht_node != &new->ht_node) {
+			/* Somebody else added it first. */
+			isc_mem_putanddetach(&new->mctx, new, sizeof(*new));
 		}
-
-		INSIST(result == ISC_R_SUCCESS);
-		break;
-	default:
-		UNREACHABLE();
 	}
+	counter = caa_container_of(ht_node, fctxcount_t, ht_node);
 	INSIST(VALID_FCTXCOUNT(counter));
 
 	INSIST(spill > 0);
-	LOCK(&counter->lock);
-	if (++counter->count > spill) {
-		counter->count--;
-		INSIST(counter->count > 0);
-		counter->dropped++;
-		fcount_logspill(fctx, counter, false);
-		result = ISC_R_QUOTA;
-	} else {
-		counter->allowed++;
-		fctx->counter = counter;
-	}
-	UNLOCK(&counter->lock);
-	RWUNLOCK(&res->counters_lock, locktype);
+	count = atomic_load_acquire(&counter->count);
+	do {
+		if (count == FCTXCOUNT_DEAD) {
+			goto again;
+		}
+		if (count >= spill) {
+			atomic_fetch_add_relaxed(&counter->dropped, 1);
+			fcount_logspill(fctx, counter, false);
+			result = ISC_R_QUOTA;
+			goto unlock;
+		}
+	} while (!atomic_compare_exchange_weak_acq_rel(&counter->count, &count,
+						       count + 1));
+
+	atomic_fetch_add_relaxed(&counter->allowed, 1);
+	fctx->counter = counter;
+
+unlock:
+	rcu_read_unlock();
 
 	return (result);
 }
@@ -1500,35 +1766,31 @@ fcount_decr(fetchctx_t *fctx) {
 	}
 	fctx->counter = NULL;
 
-	/*
-	 * FIXME: This should not require a write lock, but should be
-	 * implemented using reference counting later, otherwise we would could
-	 * encounter ABA problem here - the count could go up and down when we
-	 * switch from read to write lock.
-	 */
-	RWLOCK(&fctx->res->counters_lock, isc_rwlocktype_write);
-
-	LOCK(&counter->lock);
 	INSIST(VALID_FCTXCOUNT(counter));
-	INSIST(counter->count > 0);
-	if (--counter->count > 0) {
-		UNLOCK(&counter->lock);
-		RWUNLOCK(&fctx->res->counters_lock, isc_rwlocktype_write);
+	uint_fast32_t count = atomic_fetch_sub_release(&counter->count, 1);
+	INSIST(count > 0 && count != FCTXCOUNT_DEAD);
+	if (count > 1) {
 		return;
 	}
 
-	isc_result_t result = isc_hashmap_delete(fctx->res->counters,
-						 dns_name_hash(counter->domain),
-						 match_ptr, counter);
-	INSIST(result == ISC_R_SUCCESS);
+	/*
+	 * This was the last slot.  Unless a new fetch has taken one in the
+	 * meantime, retire the counter; the memory is freed once no reader
+	 * can still see it.
+	 */
+	count = 0;
+	if (!atomic_compare_exchange_strong_acq_rel(&counter->count, &count,
+						    FCTXCOUNT_DEAD))
+	{
+		return;
+	}
 
 	fcount_logspill(fctx, counter, true);
-	UNLOCK(&counter->lock);
 
-	isc_mutex_destroy(&counter->lock);
-	isc_mem_putanddetach(&counter->mctx, counter, sizeof(*counter));
-
-	RWUNLOCK(&fctx->res->counters_lock, isc_rwlocktype_write);
+	rcu_read_lock();
+	INSIST(!cds_lfht_del(fctx->res->counters, &counter->ht_node));
+	rcu_read_unlock();
+	call_rcu(&counter->rcu_head, fcount_destroy);
 }
 
 static void
@@ -1537,6 +1799,7 @@ spillattimer_countdown(void *arg);
 static void
 fctx_sendevents(fetchctx_t *fctx, isc_result_t result) {
 	dns_fetchresponse_t *resp = NULL, *next = NULL;
+	isc_asyncbatch_t batch;
 	unsigned int count = 0;
 	bool logit = false;
 	isc_time_t now;
@@ -1559,7 +1822,9 @@ fctx_sendevents(fetchctx_t *fctx, isc_result_t result) {
 	fctx->result = result;
 	now = isc_time_now();
 	fctx->duration = isc_time_microdiff(&now, &fctx->start);
+	latency_phase(fctx->res, latency_fetch, &fctx->start, &now);
 
+	isc_async_batchinit(&batch);
 	for (resp = ISC_LIST_HEAD(fctx->resps); resp != NULL; resp = next) {
 		next = ISC_LIST_NEXT(resp, link);
 		ISC_LIST_UNLINK(fctx->resps, resp, link);
@@ -1588,8 +1853,9 @@ fctx_sendevents(fetchctx_t *fctx, isc_result_t result) {
 		}
 
 		FCTXTRACE("post response event");
-		isc_async_run(resp->loop, resp->cb, resp);
+		isc_async_batchadd(&batch, resp->loop, resp->cb, resp);
 	}
+	isc_async_batchrun(&batch);
 	UNLOCK(&fctx->lock);
 
 	if (HAVE_ANSWER(fctx) && fctx->spilled &&
@@ -1635,6 +1901,57 @@ fctx_sendevents(fetchctx_t *fctx, isc_result_t result) {
 	}
 }
 
+/*
+ * Remember for servfail-ttl seconds that this fetch failed, so that
+ * fetches with the same key arriving during an outage fail at once
+ * rather than each starting a new fetch context.
+ */
+static void
+fctx_addfailcache(fetchctx_t *fctx) {
+	dns_resolver_t *res = fctx->res;
+	uint32_t ttl = res->view->fail_ttl;
+
+	if (ttl == 0) {
+		return;
+	}
+
+#ifdef ENABLE_AFL
+	if (dns_fuzzing_resolver) {
+		return;
+	}
+#endif /* ifdef ENABLE_AFL */
+
+	dns_badcache_add(res->failcache, fctx->name, fctx->type, true,
+			 fctx->options, isc_stdtime_now() + ttl);
+}
+
+/*
+ * An authoritative answer for the full QNAME from the servers of
+ * fctx->domain, at least two labels below it, means there was no zone
+ * cut on the way down.  Remember the zone for as long as its NS RRset
+ * may be cached, so that later lookups below it can skip the NS queries
+ * of QNAME minimization; see fctx_minimize_qname().
+ */
+static void
+fctx_addqmincache(respctx_t *rctx) {
+	fetchctx_t *fctx = rctx->fctx;
+
+	if ((fctx->options & DNS_FETCHOPT_QMINIMIZE) == 0 ||
+	    (fctx->options & DNS_FETCHOPT_QMIN_STRICT) != 0 ||
+	    fctx->minimized || fctx->forwarding || !fctx->ns_ttl_ok ||
+	    fctx->ns_ttl == 0 ||
+	    (rctx->query->rmessage->flags & DNS_MESSAGEFLAG_AA) == 0 ||
+	    dns_name_equal(fctx->domain, dns_rootname) ||
+	    dns_name_countlabels(fctx->name) <
+		    dns_name_countlabels(fctx->domain) + 2)
+	{
+		return;
+	}
+
+	dns_badcache_add(fctx->res->qmincache, fctx->domain, dns_rdatatype_ns,
+			 false, 0, fctx->now + fctx->ns_ttl);
+}
+
 static bool
 fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 	   const char *file, unsigned int line) {
@@ -1694,6 +2011,10 @@ fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 
 	fctx->qmin_warning = ISC_R_SUCCESS;
 
+	if (result == ISC_R_TIMEDOUT || result == DNS_R_SERVFAIL) {
+		fctx_addfailcache(fctx);
+	}
+
 	fctx_cancelqueries(fctx, no_response, age_untried);
 	fctx_stoptimer(fctx);
 
@@ -1720,6 +2041,9 @@ fctx__done(fetchctx_t *fctx, isc_result_t result, const char *func,
 	fctx_cleanup(fctx);
 
 	isc_timer_destroy(&fctx->timer);
+	if (fctx->hedgetimer != NULL) {
+		isc_timer_destroy(&fctx->hedgetimer);
+	}
 
 	return (true);
 }
@@ -1749,6 +2073,11 @@ resquery_senddone(isc_result_t eresult, isc_region_t *region, void *arg) {
 	 */
 	switch (eresult) {
 	case ISC_R_SUCCESS:
+		query->sent = isc_time_now();
+		latency_phase(fctx->res, latency_send, &query->start,
+			      &query->sent);
+		break;
+
 	case ISC_R_CANCELED:
 	case ISC_R_SHUTTINGDOWN:
 		break;
@@ -1863,8 +2192,8 @@ fctx_setretryinterval(fetchctx_t *fctx, unsigned int rtt) {
 }
 
 static isc_result_t
-fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
-	   unsigned int options) {
+fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo, unsigned int options,
+	   bool hedged) {
 	isc_result_t result;
 	dns_resolver_t *res = NULL;
 	dns_dns64_t *dns64 = NULL;
@@ -1923,6 +2252,7 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 	query = isc_mem_get(fctx->mctx, sizeof(*query));
 	*query = (resquery_t){
 		.options = options,
+		.attributes = hedged ? RESQUERY_ATTR_HEDGED : 0,
 		.addrinfo = addrinfo,
 		.dispatchmgr = res->view->dispatchmgr,
 		.link = ISC_LINK_INITIALIZER,
@@ -2028,14 +2358,26 @@ fctx_query(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
 		}
 		isc_sockaddr_setport(&addr, 0);
 
-		result = dns_dispatch_createtcp(
-			res->view->dispatchmgr, &addr, &sockaddr,
-			DNS_DISPATCHOPT_UNSHARED, &query->dispatch);
-		if (result != ISC_R_SUCCESS) {
-			goto cleanup_query;
-		}
+		/*
+		 * Pipeline the query over an existing connection to the
+		 * server if there is one, so that forwarding over TCP or
+		 * TLS does not pay for the connection setup every time.
+		 */
+		result = dns_dispatch_gettcp(res->view->dispatchmgr, &sockaddr,
+					     &addr, addrinfo->transport,
+					     &query->dispatch);
+		if (result == ISC_R_SUCCESS) {
+			FCTXTRACE("reusing TCP connection");
+		} else {
+			result = dns_dispatch_createtcp(res->view->dispatchmgr,
+							&addr, &sockaddr, 0,
+							&query->dispatch);
+			if (result != ISC_R_SUCCESS) {
+				goto cleanup_query;
+			}
 
-		FCTXTRACE("connecting via TCP");
+			FCTXTRACE("connecting via TCP");
+		}
 	} else {
 		if (have_addr) {
 			result = dns_dispatch_createudp(res->view->dispatchmgr,
@@ -2161,38 +2503,24 @@ cleanup_query:
 	return (result);
 }
 
-static bool
-bad_edns(fetchctx_t *fctx, isc_sockaddr_t *address) {
-	isc_sockaddr_t *sa;
-
-	for (sa = ISC_LIST_HEAD(fctx->bad_edns); sa != NULL;
-	     sa = ISC_LIST_NEXT(sa, link))
-	{
-		if (isc_sockaddr_equal(sa, address)) {
-			return (true);
-		}
-	}
-
-	return (false);
-}
-
+/*
+ * Remember in the ADB that this server failed an EDNS query, so that a
+ * plain DNS answer from it, in this fetch or a later one, confirms that
+ * it does not support EDNS.
+ */
 static void
-add_bad_edns(fetchctx_t *fctx, isc_sockaddr_t *address) {
-	isc_sockaddr_t *sa;
-
+add_bad_edns(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo) {
 #ifdef ENABLE_AFL
 	if (dns_fuzzing_resolver) {
 		return;
 	}
 #endif /* ifdef ENABLE_AFL */
-	if (bad_edns(fctx, address)) {
+	if (BADEDNS(addrinfo) || EDNSOK(addrinfo)) {
 		return;
 	}
 
-	sa = isc_mem_get(fctx->mctx, sizeof(*sa));
-
-	*sa = *address;
-	ISC_LIST_INITANDAPPEND(fctx->bad_edns, sa, link);
+	dns_adb_changeflags(fctx->adb, addrinfo, FCTX_ADDRINFO_BADEDNS,
+			    FCTX_ADDRINFO_BADEDNS);
 }
 
 static struct tried *
@@ -2899,6 +3227,12 @@ fctx_finddone(void *arg) {
 
 	dns_adb_destroyfind(&find);
 
+	if (want_done || want_try) {
+		isc_time_t now = isc_time_now();
+		latency_phase(fctx->res, latency_adbwait, &fctx->addrwait,
+			      &now);
+	}
+
 	if (want_done) {
 		FCTXTRACE("fetch failed in finddone(); return "
 			  "ISC_R_FAILURE");
@@ -3933,6 +4267,118 @@ fctx_nextaddress(fetchctx_t *fctx) {
 	return (addrinfo);
 }
 
+/*
+ * Hedged queries: when a UDP query has gone unanswered for longer than
+ * the configured percentile of the server's round trip times, the same
+ * query is also sent to the next server, and whichever response comes
+ * first is used.
+ */
+static bool
+hedge_interval(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo,
+	       isc_interval_t *interval) {
+	dns_resolver_t *res = fctx->res;
+	double fraction = res->hedgepercentile / 100.0;
+	uint64_t us = 2 * (uint64_t)addrinfo->srtt;
+	isc_histo_t *hg = NULL;
+	double count = 0;
+
+	hg = latency_find(res, res->server_latency, RES_LATENCY_MAXSERVERS,
+			  &addrinfo->sockaddr, NULL);
+	if (hg != NULL) {
+		isc_histo_moments(hg, &count, NULL, NULL);
+	}
+	if (count >= RES_HEDGE_MINSAMPLES) {
+		(void)isc_histo_quantiles(hg, 1, &fraction, &us);
+	}
+
+	/*
+	 * Don't bother if the query will have timed out by then.
+	 */
+	if (us >= (uint64_t)isc_interval_ms(&fctx->interval) * US_PER_MS) {
+		return (false);
+	}
+
+	us = ISC_MAX(us, US_PER_MS);
+	isc_interval_set(interval, us / US_PER_SEC,
+			 (us % US_PER_SEC) * NS_PER_US);
+	return (true);
+}
+
+static void
+fctx_hedge(void *arg) {
+	fetchctx_t *fctx = (fetchctx_t *)arg;
+	dns_adbaddrinfo_t *addrinfo = NULL;
+	isc_result_t result;
+	bool hedge;
+
+	REQUIRE(VALID_FCTX(fctx));
+	REQUIRE(fctx->tid == isc_tid());
+
+	/*
+	 * Only hedge a query that is still the only one outstanding.
+	 */
+	LOCK(&fctx->lock);
+	hedge = !SHUTTINGDOWN(fctx) && !ADDRWAIT(fctx) &&
+		!ISC_LIST_EMPTY(fctx->queries) &&
+		ISC_LIST_HEAD(fctx->queries) == ISC_LIST_TAIL(fctx->queries) &&
+		ISC_LIST_EMPTY(fctx->validators);
+	UNLOCK(&fctx->lock);
+	if (!hedge) {
+		return;
+	}
+
+	if (isc_quota_acquire(&fctx->res->hedgequota) != ISC_R_SUCCESS) {
+		return;
+	}
+
+	addrinfo = fctx_nextaddress(fctx);
+	while (addrinfo != NULL && (addrinfo->transport != NULL ||
+				    dns_adb_overquota(fctx->adb, addrinfo)))
+	{
+		addrinfo = fctx_nextaddress(fctx);
+	}
+	if (addrinfo == NULL) {
+		isc_quota_release(&fctx->res->hedgequota);
+		return;
+	}
+
+	result = isc_counter_increment(fctx->qc);
+	if (result == ISC_R_SUCCESS) {
+		FCTXTRACE("hedge");
+		result = fctx_query(fctx, addrinfo, fctx->options, true);
+	}
+	if (result != ISC_R_SUCCESS) {
+		isc_quota_release(&fctx->res->hedgequota);
+		return;
+	}
+	inc_stats(fctx->res, dns_resstatscounter_hedge);
+}
+
+/*
+ * Start the hedge timer for the query just sent to 'addrinfo'.
+ */
+static void
+fctx_armhedge(fetchctx_t *fctx, dns_adbaddrinfo_t *addrinfo) {
+	isc_interval_t interval;
+
+	if (fctx->res->hedgepercentile == 0 ||
+	    (fctx->options & DNS_FETCHOPT_TCP) != 0 ||
+	    addrinfo->transport != NULL)
+	{
+		return;
+	}
+
+	if (!hedge_interval(fctx, addrinfo, &interval)) {
+		return;
+	}
+
+	if (fctx->hedgetimer == NULL) {
+		isc_timer_create(fctx->loop, fctx_hedge, fctx,
+				 &fctx->hedgetimer);
+	}
+	isc_timer_start(fctx->hedgetimer, isc_timertype_once, &interval);
+}
+
 static void
 fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 	isc_result_t result;
@@ -3976,6 +4422,7 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 		case DNS_R_WAIT:
 			/* Sleep waiting for addresses. */
 			FCTXTRACE("addrwait");
+			fctx->addrwait = isc_time_now();
 			FCTX_ATTR_SET(fctx, FCTX_ATTR_ADDRWAIT);
 			return;
 		default:
@@ -4069,13 +4516,14 @@ fctx_try(fetchctx_t *fctx, bool retrying, bool badcache) {
 		goto done;
 	}
 
-	result = fctx_query(fctx, addrinfo, fctx->options);
+	result = fctx_query(fctx, addrinfo, fctx->options, false);
 	if (result != ISC_R_SUCCESS) {
 		goto done;
 	}
 	if (retrying) {
 		inc_stats(res, dns_resstatscounter_retry);
 	}
+	fctx_armhedge(fctx, addrinfo);
 
 done:
 	if (result != ISC_R_SUCCESS) {
@@ -4281,12 +4729,6 @@ fctx_destroy(fetchctx_t *fctx) {
 		isc_mem_put(fctx->mctx, tried, sizeof(*tried));
 	}
 
-	for (sa = ISC_LIST_HEAD(fctx->bad_edns); sa != NULL; sa = next_sa) {
-		next_sa = ISC_LIST_NEXT(sa, link);
-		ISC_LIST_UNLINK(fctx->bad_edns, sa, link);
-		isc_mem_put(fctx->mctx, sa, sizeof(*sa));
-	}
-
 	isc_counter_detach(&fctx->qc);
 	fcount_decr(fctx);
 	dns_message_detach(&fctx->qmessage);
@@ -4511,7 +4953,6 @@ fctx_create(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 	ISC_LIST_INIT(fctx->forwarders);
 	ISC_LIST_INIT(fctx->bad);
 	ISC_LIST_INIT(fctx->edns);
-	ISC_LIST_INIT(fctx->bad_edns);
 	ISC_LIST_INIT(fctx->validators);
 
 	atomic_init(&fctx->attributes, 0);
@@ -5089,6 +5530,9 @@ validated(void *arg) {
 	res = fctx->res;
 	addrinfo = valarg->addrinfo;
 
+	isc_time_t vfinish = isc_time_now();
+	latency_phase(res, latency_validation, &valarg->start, &vfinish);
+
 	message = val->message;
 	fctx->vresult = val->result;
 
@@ -5396,7 +5840,8 @@ validated(void *arg) {
 answer_response:
 
 	/*
-	 * Cache any SOA/NS/NSEC records that happened to be validated.
+	 * Cache any SOA/NS/NSEC/NSEC3 records that happened to be
+	 * validated.
 	 */
 	result = dns_message_firstname(message, DNS_SECTION_AUTHORITY);
 	while (result == ISC_R_SUCCESS) {
@@ -5407,7 +5852,8 @@ answer_response:
 		{
 			if ((rdataset->type != dns_rdatatype_ns &&
 			     rdataset->type != dns_rdatatype_soa &&
-			     rdataset->type != dns_rdatatype_nsec) ||
+			     rdataset->type != dns_rdatatype_nsec &&
+			     rdataset->type != dns_rdatatype_nsec3) ||
 			    rdataset->trust != dns_trust_secure)
 			{
 				continue;
@@ -5716,9 +6162,36 @@ findnoqname(fetchctx_t *fctx, dns_message_t *message, dns_name_t *name,
 	return (result);
 }
 
+/*
+ * Store a referral NS rdataset (or its signature) in the view's
+ * delegation cache as well, so the zone cut outlives the main cache
+ * entry when the main cache is cleaned.
+ */
+static void
+cache_delegation(fetchctx_t *fctx, dns_name_t *name, dns_rdataset_t *rdataset,
+		 isc_stdtime_t now) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+
+	if (fctx->res->view->delegcache == NULL) {
+		return;
+	}
+
+	dns_cache_attachdb(fctx->res->view->delegcache, &db);
+	result = dns_db_findnode(db, name, true, &node);
+	if (result == ISC_R_SUCCESS) {
+		(void)dns_db_addrdataset(db, node, NULL, now, rdataset,
+					 DNS_DBADD_FORCE, NULL);
+		dns_db_detachnode(db, &node);
+	}
+	dns_db_detach(&db);
+}
+
 static isc_result_t
-cache_name(fetchctx_t *fctx, dns_name_t *name, dns_message_t *message,
-	   dns_adbaddrinfo_t *addrinfo, isc_stdtime_t now) {
+cache_name(fetchctx_t *fctx, dns_name_t *name, dns_dbnode_t **nodep,
+	   dns_message_t *message, dns_adbaddrinfo_t *addrinfo,
+	   isc_stdtime_t now) {
 	dns_rdataset_t *rdataset = NULL, *sigrdataset = NULL;
 	dns_rdataset_t *addedrdataset = NULL;
 	dns_rdataset_t *ardataset = NULL, *asigrdataset = NULL;
@@ -5797,13 +6270,10 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_message_t *message,
 	}
 
 	/*
-	 * Find or create the cache node.
+	 * Take over the cache node found by cache_message().
 	 */
-	node = NULL;
-	result = dns_db_findnode(fctx->cache, name, true, &node);
-	if (result != ISC_R_SUCCESS) {
-		return (result);
-	}
+	node = *nodep;
+	*nodep = NULL;
 
 	/*
 	 * Cache or validate each cacheable rdataset.
@@ -6100,6 +6570,7 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_message_t *message,
 				 * over the existing cache contents.
 				 */
 				options = DNS_DBADD_FORCE;
+				cache_delegation(fctx, name, rdataset, now);
 			} else if ((fctx->options & DNS_FETCHOPT_PREFETCH) != 0)
 			{
 				options = DNS_DBADD_PREFETCH;
@@ -6199,44 +6670,88 @@ cache_name(fetchctx_t *fctx, dns_name_t *name, dns_message_t *message,
 	return (result);
 }
 
+/*
+ * Store the names in the message that are to be cached in 'names', in
+ * message order, and return how many there are.  If 'names' is NULL,
+ * only count them.
+ */
+static size_t
+cachenames(dns_message_t *message, const dns_name_t **names) {
+	size_t count = 0;
+
+	for (dns_section_t section = DNS_SECTION_ANSWER;
+	     section <= DNS_SECTION_ADDITIONAL; section++)
+	{
+		isc_result_t result = dns_message_firstname(message, section);
+		while (result == ISC_R_SUCCESS) {
+			dns_name_t *name = NULL;
+			dns_message_currentname(message, section, &name);
+			if (name->attributes.cache) {
+				if (names != NULL) {
+					names[count] = name;
+				}
+				count++;
+			}
+			result = dns_message_nextname(message, section);
+		}
+	}
+
+	return (count);
+}
+
 static isc_result_t
 cache_message(fetchctx_t *fctx, dns_message_t *message,
 	      dns_adbaddrinfo_t *addrinfo, isc_stdtime_t now) {
 	isc_result_t result;
-	dns_section_t section;
-	dns_name_t *name;
+	const dns_name_t **names = NULL;
+	dns_dbnode_t **nodes = NULL;
+	size_t count;
 
 	FCTXTRACE("cache_message");
 
 	FCTX_ATTR_CLR(fctx, FCTX_ATTR_WANTCACHE);
 
-	LOCK(&fctx->lock);
+	count = cachenames(message, NULL);
+	if (count == 0) {
+		return (ISC_R_SUCCESS);
+	}
 
-	for (section = DNS_SECTION_ANSWER; section <= DNS_SECTION_ADDITIONAL;
-	     section++)
-	{
-		result = dns_message_firstname(message, section);
-		while (result == ISC_R_SUCCESS) {
-			name = NULL;
-			dns_message_currentname(message, section, &name);
-			if (name->attributes.cache) {
-				result = cache_name(fctx, name, message,
-						    addrinfo, now);
-				if (result != ISC_R_SUCCESS) {
-					break;
-				}
-			}
-			result = dns_message_nextname(message, section);
-		}
-		if (result != ISC_R_NOMORE) {
+	/*
+	 * Find or create the cache nodes for all the names at once, so
+	 * that the cache takes its tree lock once per response rather
+	 * than once per name.
+	 */
+	names = isc_mem_cget(fctx->mctx, count, sizeof(names[0]));
+	nodes = isc_mem_cget(fctx->mctx, count, sizeof(nodes[0]));
+	(void)cachenames(message, names);
+
+	result = dns_db_findnodes(fctx->cache, names, count, nodes);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	LOCK(&fctx->lock);
+	for (size_t i = 0; i < count; i++) {
+		result = cache_name(fctx, UNCONST(names[i]), &nodes[i],
+				    message, addrinfo, now);
+		if (result != ISC_R_SUCCESS) {
 			break;
 		}
 	}
-	if (result == ISC_R_NOMORE) {
-		result = ISC_R_SUCCESS;
+	UNLOCK(&fctx->lock);
+
+	/*
+	 * Release the nodes of the names that were not cached.
+	 */
+	for (size_t i = 0; i < count; i++) {
+		if (nodes[i] != NULL) {
+			dns_db_detachnode(fctx->cache, &nodes[i]);
+		}
 	}
 
-	UNLOCK(&fctx->lock);
+cleanup:
+	isc_mem_cput(fctx->mctx, nodes, count, sizeof(nodes[0]));
+	isc_mem_cput(fctx->mctx, names, count, sizeof(names[0]));
 
 	return (result);
 }
@@ -6911,11 +7426,26 @@ fctx_match(void *node, const void *key) {
 	const fetchctx_t *fctx0 = node;
 	const fetchctx_t *fctx1 = key;
 
+	/*
+	 * The fetch contexts of a resolver that is shutting down must not
+	 * be joined by the views sharing the table with it.
+	 */
 	return (fctx0->options == fctx1->options &&
 		fctx0->type == fctx1->type &&
-		dns_name_equal(fctx0->name, fctx1->name));
+		dns_name_equal(fctx0->name, fctx1->name) &&
+		!atomic_load_acquire(&fctx0->res->exiting));
+}
+
+static void
+fctxtable_destroy(fctxtable_t *table) {
+	INSIST(isc_hashmap_count(table->hashmap) == 0);
+	isc_hashmap_destroy(&table->hashmap);
+	isc_rwlock_destroy(&table->lock);
+	isc_mem_putanddetach(&table->mctx, table, sizeof(*table));
 }
 
+ISC_REFCOUNT_IMPL(fctxtable, fctxtable_destroy);
+
 /* Must be fctx locked */
 static void
 release_fctx(fetchctx_t *fctx) {
@@ -6926,12 +7456,12 @@ release_fctx(fetchctx_t *fctx) {
 		return;
 	}
 
-	RWLOCK(&res->fctxs_lock, isc_rwlocktype_write);
-	result = isc_hashmap_delete(res->fctxs, fctx_hash(fctx), match_ptr,
-				    fctx);
+	RWLOCK(&res->fctxs->lock, isc_rwlocktype_write);
+	result = isc_hashmap_delete(res->fctxs->hashmap, fctx_hash(fctx),
+				    match_ptr, fctx);
 	INSIST(result == ISC_R_SUCCESS);
 	fctx->hashed = false;
-	RWUNLOCK(&res->fctxs_lock, isc_rwlocktype_write);
+	RWUNLOCK(&res->fctxs->lock, isc_rwlocktype_write);
 }
 
 static void
@@ -7851,7 +8381,7 @@ rctx_parse(respctx_t *rctx) {
 			 */
 			rctx->retryopts |= DNS_FETCHOPT_NOEDNS0;
 			rctx->resend = true;
-			add_bad_edns(fctx, &query->addrinfo->sockaddr);
+			add_bad_edns(fctx, query->addrinfo);
 			inc_stats(fctx->res, dns_resstatscounter_edns0fail);
 		} else {
 			rctx->broken_server = result;
@@ -7869,7 +8399,7 @@ rctx_parse(respctx_t *rctx) {
 			 */
 			rctx->retryopts |= DNS_FETCHOPT_NOEDNS0;
 			rctx->resend = true;
-			add_bad_edns(fctx, &query->addrinfo->sockaddr);
+			add_bad_edns(fctx, query->addrinfo);
 			inc_stats(fctx->res, dns_resstatscounter_edns0fail);
 		} else {
 			rctx->broken_server = DNS_R_UNEXPECTEDRCODE;
@@ -7994,7 +8524,7 @@ rctx_edns(respctx_t *rctx) {
 	     query->rmessage->rcode == dns_rcode_nxdomain ||
 	     query->rmessage->rcode == dns_rcode_refused ||
 	     query->rmessage->rcode == dns_rcode_yxdomain) &&
-	    bad_edns(fctx, &query->addrinfo->sockaddr))
+	    BADEDNS(query->addrinfo))
 	{
 		dns_message_logpacket(
 			query->rmessage, "received packet (bad edns) from",
@@ -8002,7 +8532,8 @@ rctx_edns(respctx_t *rctx) {
 			DNS_LOGMODULE_RESOLVER, ISC_LOG_DEBUG(3), fctx->mctx);
 		dns_adb_changeflags(fctx->adb, query->addrinfo,
 				    FCTX_ADDRINFO_NOEDNS0,
-				    FCTX_ADDRINFO_NOEDNS0);
+				    FCTX_ADDRINFO_NOEDNS0 |
+					    FCTX_ADDRINFO_BADEDNS);
 	} else if (rctx->opt == NULL &&
 		   (query->rmessage->flags & DNS_MESSAGEFLAG_TC) == 0 &&
 		   !EDNSOK(query->addrinfo) &&
@@ -8043,7 +8574,9 @@ rctx_edns(respctx_t *rctx) {
 	     query->rmessage->rcode == dns_rcode_yxdomain))
 	{
 		dns_adb_changeflags(fctx->adb, query->addrinfo,
-				    FCTX_ADDRINFO_EDNSOK, FCTX_ADDRINFO_EDNSOK);
+				    FCTX_ADDRINFO_EDNSOK,
+				    FCTX_ADDRINFO_EDNSOK |
+					    FCTX_ADDRINFO_BADEDNS);
 	}
 }
 
@@ -8239,6 +8772,8 @@ rctx_answer_positive(respctx_t *rctx) {
 
 	log_ns_ttl(fctx, "rctx_answer");
 
+	fctx_addqmincache(rctx);
+
 	if (rctx->ns_rdataset != NULL &&
 	    dns_name_equal(fctx->domain, rctx->ns_name) &&
 	    !dns_name_equal(rctx->ns_name, dns_rootname))
@@ -9217,6 +9752,14 @@ rctx_referral(respctx_t *rctx) {
 		dns_rdataset_disassociate(&fctx->nameservers);
 	}
 
+	if ((fctx->options & DNS_FETCHOPT_QMINIMIZE) != 0 && !fctx->minimized) {
+		/*
+		 * The full QNAME was sent and we were referred: any
+		 * hint that the zone has no cuts below it is wrong.
+		 */
+		dns_badcache_flushname(fctx->res->qmincache, fctx->domain);
+	}
+
 	dns_name_copy(rctx->ns_name, fctx->domain);
 
 	if ((fctx->options & DNS_FETCHOPT_QMINIMIZE) != 0) {
@@ -9400,7 +9943,7 @@ rctx_resend(respctx_t *rctx, dns_adbaddrinfo_t *addrinfo) {
 
 	FCTXTRACE("resend");
 	inc_stats(fctx->res, dns_resstatscounter_retry);
-	result = fctx_query(fctx, addrinfo, rctx->retryopts);
+	result = fctx_query(fctx, addrinfo, rctx->retryopts, false);
 	if (result != ISC_R_SUCCESS) {
 		fctx_done_detach(&rctx->fctx, result);
 	}
@@ -9630,14 +10173,17 @@ rctx_badserver(respctx_t *rctx, isc_result_t result) {
 		/*
 		 * Remember that they may not like EDNS0.
 		 */
-		add_bad_edns(fctx, &query->addrinfo->sockaddr);
+		add_bad_edns(fctx, query->addrinfo);
 		inc_stats(fctx->res, dns_resstatscounter_edns0fail);
 	} else if (rcode == dns_rcode_formerr) {
 		if (query->rmessage->cc_echoed) {
 			/*
-			 * Retry without DNS COOKIE.
+			 * Retry without DNS COOKIE, and don't send one
+			 * to this server in later fetches either.
 			 */
-			query->addrinfo->flags |= FCTX_ADDRINFO_NOCOOKIE;
+			dns_adb_changeflags(fctx->adb, query->addrinfo,
+					    FCTX_ADDRINFO_NOCOOKIE,
+					    FCTX_ADDRINFO_NOCOOKIE);
 			rctx->resend = true;
 			log_formerr(fctx, "server sent FORMERR with echoed DNS "
 					  "COOKIE");
@@ -9775,13 +10321,21 @@ dns_resolver__destroy(dns_resolver_t *res) {
 	isc_mutex_destroy(&res->primelock);
 	isc_mutex_destroy(&res->lock);
 
-	INSIST(isc_hashmap_count(res->fctxs) == 0);
-	isc_hashmap_destroy(&res->fctxs);
-	isc_rwlock_destroy(&res->fctxs_lock);
+	fctxtable_detach(&res->fctxs);
+
+	RUNTIME_CHECK(!cds_lfht_destroy(res->counters, NULL));
+
+	for (size_t i = 0; i < latency_transport_max; i++) {
+		isc_histomulti_destroy(&res->transport_latency[i]);
+	}
+	for (size_t i = 0; i < latency_phase_max; i++) {
+		isc_histomulti_destroy(&res->phase_latency[i]);
+	}
+	latency_destroy(res, &res->server_latency);
+	latency_destroy(res, &res->zone_latency);
+	isc_rwlock_destroy(&res->latency_lock);
 
-	INSIST(isc_hashmap_count(res->counters) == 0);
-	isc_hashmap_destroy(&res->counters);
-	isc_rwlock_destroy(&res->counters_lock);
+	isc_quota_destroy(&res->hedgequota);
 
 	if (res->dispatches4 != NULL) {
 		dns_dispatchset_destroy(&res->dispatches4);
@@ -9797,6 +10351,8 @@ dns_resolver__destroy(dns_resolver_t *res) {
 		isc_mem_put(res->mctx, a, sizeof(*a));
 	}
 	dns_badcache_destroy(&res->badcache);
+	dns_badcache_destroy(&res->failcache);
+	dns_badcache_destroy(&res->qmincache);
 
 	dns_view_weakdetach(&res->view);
 
@@ -9891,12 +10447,38 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 	isc_refcount_init(&res->references, 1);
 
 	res->badcache = dns_badcache_new(res->mctx);
-
-	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS, &res->fctxs);
-	isc_rwlock_init(&res->fctxs_lock);
-
-	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS, &res->counters);
-	isc_rwlock_init(&res->counters_lock);
+	res->failcache = dns_badcache_new(res->mctx);
+	res->qmincache = dns_badcache_new(res->mctx);
+
+	res->fctxs = isc_mem_get(view->mctx, sizeof(*res->fctxs));
+	*res->fctxs = (fctxtable_t){ 0 };
+	isc_mem_attach(view->mctx, &res->fctxs->mctx);
+	isc_refcount_init(&res->fctxs->references, 1);
+	isc_hashmap_create(view->mctx, RES_DOMAIN_HASH_BITS,
+			   &res->fctxs->hashmap);
+	isc_rwlock_init(&res->fctxs->lock);
+
+	res->counters = cds_lfht_new(1 << RES_DOMAIN_HASH_BITS,
+				     1 << RES_DOMAIN_HASH_BITS, 0,
+				     CDS_LFHT_AUTO_RESIZE | CDS_LFHT_ACCOUNTING,
+				     NULL);
+	INSIST(res->counters != NULL);
+
+	for (size_t i = 0; i < latency_transport_max; i++) {
+		isc_histomulti_create(view->mctx, RES_LATENCY_SIGBITS,
+				      &res->transport_latency[i]);
+	}
+	for (size_t i = 0; i < latency_phase_max; i++) {
+		isc_histomulti_create(view->mctx, RES_LATENCY_SIGBITS,
+				      &res->phase_latency[i]);
+	}
+	isc_hashmap_create(view->mctx, RES_LATENCY_HASH_BITS,
+			   &res->server_latency);
+	isc_hashmap_create(view->mctx, RES_LATENCY_HASH_BITS,
+			   &res->zone_latency);
+	isc_rwlock_init(&res->latency_lock);
+
+	isc_quota_init(&res->hedgequota, 0);
 
 	if (dispatchv4 != NULL) {
 		dns_dispatchset_create(res->mctx, dispatchv4, &res->dispatches4,
@@ -9928,6 +10510,8 @@ dns_resolver_create(dns_view_t *view, isc_loopmgr_t *loopmgr, isc_nm_t *nm,
 
 		dns_message_createpools(pool_mctx, &res->namepools[i],
 					&res->rdspools[i]);
+		isc_mempool_settid(res->namepools[i], i);
+		isc_mempool_settid(res->rdspools[i], i);
 	}
 
 	res->magic = RES_MAGIC;
@@ -10055,8 +10639,8 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 
 		RTRACE("exiting");
 
-		RWLOCK(&res->fctxs_lock, isc_rwlocktype_write);
-		isc_hashmap_iter_create(res->fctxs, &it);
+		RWLOCK(&res->fctxs->lock, isc_rwlocktype_write);
+		isc_hashmap_iter_create(res->fctxs->hashmap, &it);
 		for (result = isc_hashmap_iter_first(it);
 		     result == ISC_R_SUCCESS;
 		     result = isc_hashmap_iter_next(it))
@@ -10066,11 +10650,16 @@ dns_resolver_shutdown(dns_resolver_t *res) {
 			isc_hashmap_iter_current(it, (void **)&fctx);
 			INSIST(fctx != NULL);
 
+			/* Skip the fetches of the other resolvers */
+			if (fctx->res != res) {
+				continue;
+			}
+
 			fetchctx_ref(fctx);
 			isc_async_run(fctx->loop, fctx_shutdown, fctx);
 		}
 		isc_hashmap_iter_destroy(&it);
-		RWUNLOCK(&res->fctxs_lock, isc_rwlocktype_write);
+		RWUNLOCK(&res->fctxs->lock, isc_rwlocktype_write);
 
 		LOCK(&res->lock);
 		if (res->spillattimer != NULL) {
@@ -10155,6 +10744,21 @@ fctx_minimize_qname(fetchctx_t *fctx) {
 		fctx->qmin_labels = DNS_NAME_MAXLABELS;
 	}
 
+	/*
+	 * In relaxed mode, if the servers for the deepest known zone cut
+	 * have recently answered for a name two or more labels below it
+	 * without referring us, assume there are no further cuts and
+	 * send the full QNAME rather than walking down label by label.
+	 */
+	if (fctx->qmin_labels < nlabels &&
+	    (fctx->options & DNS_FETCHOPT_QMIN_STRICT) == 0 &&
+	    dns_badcache_find(fctx->res->qmincache, fctx->qmindcname,
+			      dns_rdatatype_ns, NULL,
+			      fctx->now) == ISC_R_SUCCESS)
+	{
+		fctx->qmin_labels = nlabels;
+	}
+
 	if (fctx->qmin_labels < nlabels) {
 		dns_rdataset_t rdataset;
 		dns_fixedname_t fixed;
@@ -10229,9 +10833,9 @@ get_attached_fctx(dns_resolver_t *res, isc_loop_t *loop, const dns_name_t *name,
 	uint32_t hashval = fctx_hash(&key);
 
 again:
-	RWLOCK(&res->fctxs_lock, locktype);
-	result = isc_hashmap_find(res->fctxs, hashval, fctx_match, &key,
-				  (void **)&fctx);
+	RWLOCK(&res->fctxs->lock, locktype);
+	result = isc_hashmap_find(res->fctxs->hashmap, hashval, fctx_match,
+				  &key, (void **)&fctx);
 	switch (result) {
 	case ISC_R_SUCCESS:
 		break;
@@ -10242,11 +10846,11 @@ again:
 			goto unlock;
 		}
 
-		UPGRADELOCK(&res->fctxs_lock, locktype);
+		UPGRADELOCK(&res->fctxs->lock, locktype);
 
 		void *found = NULL;
-		result = isc_hashmap_add(res->fctxs, hashval, fctx_match, fctx,
-					 fctx, &found);
+		result = isc_hashmap_add(res->fctxs->hashmap, hashval,
+					 fctx_match, fctx, fctx, &found);
 		if (result == ISC_R_SUCCESS) {
 			*new_fctx = true;
 			fctx->hashed = true;
@@ -10262,7 +10866,7 @@ again:
 	}
 	fetchctx_ref(fctx);
 unlock:
-	RWUNLOCK(&res->fctxs_lock, locktype);
+	RWUNLOCK(&res->fctxs->lock, locktype);
 	if (result == ISC_R_SUCCESS) {
 		LOCK(&fctx->lock);
 		if (SHUTTINGDOWN(fctx) || fctx->cloned) {
@@ -10326,6 +10930,24 @@ dns_resolver_createfetch(dns_resolver_t *res, const dns_name_t *name,
 
 	log_fetch(name, type);
 
+	/*
+	 * If an identical fetch failed within the last servfail-ttl
+	 * seconds, fail this one too without creating or joining a
+	 * fetch context; the caller then answers from stale data or
+	 * with SERVFAIL.
+	 */
+	if ((options & DNS_FETCHOPT_UNSHARED) == 0) {
+		uint32_t flags = 0;
+
+		if (dns_badcache_find(res->failcache, name, type, &flags,
+				      isc_stdtime_now()) == ISC_R_SUCCESS &&
+		    flags == options)
+		{
+			inc_stats(res, dns_resstatscounter_failcache);
+			return (DNS_R_SERVFAIL);
+		}
+	}
+
 	fetch = isc_mem_get(mctx, sizeof(*fetch));
 	*fetch = (dns_fetch_t){ 0 };
 
@@ -10588,14 +11210,20 @@ void
 dns_resolver_flushbadcache(dns_resolver_t *resolver, const dns_name_t *name) {
 	if (name != NULL) {
 		dns_badcache_flushname(resolver->badcache, name);
+		dns_badcache_flushname(resolver->failcache, name);
+		dns_badcache_flushname(resolver->qmincache, name);
 	} else {
 		dns_badcache_flush(resolver->badcache);
+		dns_badcache_flush(resolver->failcache);
+		dns_badcache_flush(resolver->qmincache);
 	}
 }
 
 void
 dns_resolver_flushbadnames(dns_resolver_t *resolver, const dns_name_t *name) {
 	dns_badcache_flushtree(resolver->badcache, name);
+	dns_badcache_flushtree(resolver->failcache, name);
+	dns_badcache_flushtree(resolver->qmincache, name);
 }
 
 void
@@ -10815,38 +11443,48 @@ dns_resolver_getmaxqueries(dns_resolver_t *resolver) {
 	return (resolver->maxqueries);
 }
 
+void
+dns_resolver_sethedging(dns_resolver_t *resolver, unsigned int percentile,
+			unsigned int quota) {
+	REQUIRE(VALID_RESOLVER(resolver));
+	REQUIRE(percentile < 100);
+
+	resolver->hedgepercentile = percentile;
+	isc_quota_max(&resolver->hedgequota, quota);
+}
+
 void
 dns_resolver_dumpfetches(dns_resolver_t *res, isc_statsformat_t format,
 			 FILE *fp) {
-	isc_result_t result;
-	isc_hashmap_iter_t *it = NULL;
+	fctxcount_t *counter = NULL;
+	struct cds_lfht_iter iter;
 
 	REQUIRE(VALID_RESOLVER(res));
 	REQUIRE(fp != NULL);
 	REQUIRE(format == isc_statsformat_file);
 
-	RWLOCK(&res->counters_lock, isc_rwlocktype_read);
-	isc_hashmap_iter_create(res->counters, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_next(it))
-	{
-		fctxcount_t *counter = NULL;
-		isc_hashmap_iter_current(it, (void **)&counter);
+	rcu_read_lock();
+	cds_lfht_for_each_entry(res->counters, &iter, counter, ht_node) {
+		uint_fast32_t count = atomic_load_relaxed(&counter->count);
+		if (count == FCTXCOUNT_DEAD) {
+			continue;
+		}
 
 		dns_name_print(counter->domain, fp);
 		fprintf(fp,
 			": %" PRIuFAST32 " active (%" PRIuFAST32
 			" spilled, %" PRIuFAST32 " allowed)\n",
-			counter->count, counter->dropped, counter->allowed);
+			count, atomic_load_relaxed(&counter->dropped),
+			atomic_load_relaxed(&counter->allowed));
 	}
-	RWUNLOCK(&res->counters_lock, isc_rwlocktype_read);
-	isc_hashmap_iter_destroy(&it);
+	rcu_read_unlock();
 }
 
 isc_result_t
 dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t **buf) {
-	isc_result_t result;
-	isc_hashmap_iter_t *it = NULL;
+	isc_result_t result = ISC_R_SUCCESS;
+	fctxcount_t *counter = NULL;
+	struct cds_lfht_iter iter;
 	uint_fast32_t spill;
 
 	REQUIRE(VALID_RESOLVER(res));
@@ -10856,25 +11494,17 @@ dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t **buf) {
 		return (ISC_R_SUCCESS);
 	}
 
-	RWLOCK(&res->counters_lock, isc_rwlocktype_read);
-	isc_hashmap_iter_create(res->counters, &it);
-	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_hashmap_iter_next(it))
-	{
-		fctxcount_t *counter = NULL;
+	rcu_read_lock();
+	cds_lfht_for_each_entry(res->counters, &iter, counter, ht_node) {
 		uint_fast32_t count, dropped, allowed;
 		char nb[DNS_NAME_FORMATSIZE];
 		char text[DNS_NAME_FORMATSIZE + BUFSIZ];
 
-		isc_hashmap_iter_current(it, (void **)&counter);
+		count = atomic_load_relaxed(&counter->count);
+		dropped = atomic_load_relaxed(&counter->dropped);
+		allowed = atomic_load_relaxed(&counter->allowed);
 
-		LOCK(&counter->lock);
-		count = counter->count;
-		dropped = counter->dropped;
-		allowed = counter->allowed;
-		UNLOCK(&counter->lock);
-
-		if (count < spill) {
+		if (count < spill || count == FCTXCOUNT_DEAD) {
 			continue;
 		}
 
@@ -10890,16 +11520,239 @@ dns_resolver_dumpquota(dns_resolver_t *res, isc_buffer_t **buf) {
 		}
 		isc_buffer_putstr(*buf, text);
 	}
-	if (result == ISC_R_NOMORE) {
-		result = ISC_R_SUCCESS;
-	}
 
 cleanup:
-	RWUNLOCK(&res->counters_lock, isc_rwlocktype_read);
+	rcu_read_unlock();
+	return (result);
+}
+
+#if defined(HAVE_LIBXML2) || defined(HAVE_JSON_C)
+typedef struct latency_summary {
+	uint64_t count;
+	uint64_t mean;
+	uint64_t p50;
+	uint64_t p90;
+	uint64_t p99;
+} latency_summary_t;
+
+typedef isc_result_t (*latency_renderfn_t)(const char *category,
+					   const char *name,
+					   const latency_summary_t *summary,
+					   void *arg);
+
+/*
+ * Summarize a stable copy of 'hg' for 'render', consuming the copy.
+ * Empty histograms are skipped.
+ */
+static isc_result_t
+latency_summarize(isc_histo_t **hgp, const char *category, const char *name,
+		  latency_renderfn_t render, void *arg) {
+	static const double fraction[] = { 0.99, 0.90, 0.50 };
+	uint64_t value[ARRAY_SIZE(fraction)];
+	latency_summary_t summary;
+	double count, mean;
+	isc_result_t result;
+
+	result = isc_histo_quantiles(*hgp, ARRAY_SIZE(fraction), fraction,
+				     value);
+	if (result != ISC_R_SUCCESS) {
+		isc_histo_destroy(hgp);
+		return (ISC_R_SUCCESS);
+	}
+	isc_histo_moments(*hgp, &count, &mean, NULL);
+	isc_histo_destroy(hgp);
+
+	summary = (latency_summary_t){
+		.count = (uint64_t)count,
+		.mean = (uint64_t)mean,
+		.p99 = value[0],
+		.p90 = value[1],
+		.p50 = value[2],
+	};
+	return (render(category, name, &summary, arg));
+}
+
+static isc_result_t
+latency_walktable(dns_resolver_t *res, isc_hashmap_t *map,
+		  const char *category, latency_renderfn_t render, void *arg) {
+	isc_hashmap_iter_t *it = NULL;
+	isc_result_t result;
+
+	RWLOCK(&res->latency_lock, isc_rwlocktype_read);
+	isc_hashmap_iter_create(map, &it);
+	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(it))
+	{
+		char buf[ISC_MAX(ISC_SOCKADDR_FORMATSIZE, DNS_NAME_FORMATSIZE)];
+		reslatency_t *entry = NULL;
+		isc_histo_t *hg = NULL;
+
+		isc_hashmap_iter_current(it, (void **)&entry);
+		if (entry->name != NULL) {
+			dns_name_format(entry->name, buf, sizeof(buf));
+		} else {
+			isc_sockaddr_format(&entry->addr, buf, sizeof(buf));
+		}
+
+		isc_histo_merge(&hg, entry->hg);
+		result = latency_summarize(&hg, category, buf, render, arg);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+	}
+	RWUNLOCK(&res->latency_lock, isc_rwlocktype_read);
 	isc_hashmap_iter_destroy(&it);
+
+	return (result == ISC_R_NOMORE ? ISC_R_SUCCESS : result);
+}
+
+/*
+ * Call 'render' for each non-empty latency histogram of 'res'.
+ */
+static isc_result_t
+latency_walk(dns_resolver_t *res, latency_renderfn_t render, void *arg) {
+	isc_result_t result;
+
+	for (size_t i = 0; i < latency_transport_max; i++) {
+		isc_histo_t *hg = NULL;
+		isc_histomulti_merge(&hg, res->transport_latency[i]);
+		result = latency_summarize(&hg, "transport",
+					   latency_transport_names[i], render,
+					   arg);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	for (size_t i = 0; i < latency_phase_max; i++) {
+		isc_histo_t *hg = NULL;
+		isc_histomulti_merge(&hg, res->phase_latency[i]);
+		result = latency_summarize(&hg, "phase", latency_phase_names[i],
+					   render, arg);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	result = latency_walktable(res, res->server_latency, "server", render,
+				   arg);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	return (latency_walktable(res, res->zone_latency, "zonecut", render,
+				  arg));
+}
+#endif /* defined(HAVE_LIBXML2) || defined(HAVE_JSON_C) */
+
+#ifdef HAVE_LIBXML2
+#define TRY0(a)                     \
+	do {                        \
+		xmlrc = (a);        \
+		if (xmlrc < 0)      \
+			goto error; \
+	} while (0)
+
+static isc_result_t
+latency_renderxml(const char *category, const char *name,
+		  const latency_summary_t *summary, void *arg) {
+	xmlTextWriterPtr writer = (xmlTextWriterPtr)arg;
+	int xmlrc;
+
+	TRY0(xmlTextWriterStartElement(writer, ISC_XMLCHAR "histogram"));
+	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "type",
+					 ISC_XMLCHAR category));
+	TRY0(xmlTextWriterWriteAttribute(writer, ISC_XMLCHAR "name",
+					 ISC_XMLCHAR name));
+	TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "count",
+					     "%" PRIu64, summary->count));
+	TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "mean",
+					     "%" PRIu64, summary->mean));
+	TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "p50",
+					     "%" PRIu64, summary->p50));
+	TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "p90",
+					     "%" PRIu64, summary->p90));
+	TRY0(xmlTextWriterWriteFormatElement(writer, ISC_XMLCHAR "p99",
+					     "%" PRIu64, summary->p99));
+	TRY0(xmlTextWriterEndElement(writer)); /* histogram */
+
+	return (ISC_R_SUCCESS);
+
+error:
+	return (ISC_R_FAILURE);
+}
+
+int
+dns_resolver_renderxml(dns_resolver_t *res, void *writer) {
+	isc_result_t result;
+
+	REQUIRE(VALID_RESOLVER(res));
+
+	result = latency_walk(res, latency_renderxml, writer);
+	return (result == ISC_R_SUCCESS ? 0 : -1);
+}
+#undef TRY0
+#endif /* HAVE_LIBXML2 */
+
+#ifdef HAVE_JSON_C
+#define CHECKMEM(m)                              \
+	do {                                     \
+		if (m == NULL) {                 \
+			result = ISC_R_NOMEMORY; \
+			goto error;              \
+		}                                \
+	} while (0)
+
+static isc_result_t
+latency_renderjson(const char *category, const char *name,
+		   const latency_summary_t *summary, void *arg) {
+	isc_result_t result = ISC_R_SUCCESS;
+	json_object *latency = (json_object *)arg;
+	json_object *cat = NULL, *histo = NULL, *obj = NULL;
+
+	if (!json_object_object_get_ex(latency, category, &cat)) {
+		cat = json_object_new_object();
+		CHECKMEM(cat);
+		json_object_object_add(latency, category, cat);
+	}
+
+	histo = json_object_new_object();
+	CHECKMEM(histo);
+	json_object_object_add(cat, name, histo);
+
+	obj = json_object_new_int64(summary->count);
+	CHECKMEM(obj);
+	json_object_object_add(histo, "count", obj);
+
+	obj = json_object_new_int64(summary->mean);
+	CHECKMEM(obj);
+	json_object_object_add(histo, "mean", obj);
+
+	obj = json_object_new_int64(summary->p50);
+	CHECKMEM(obj);
+	json_object_object_add(histo, "p50", obj);
+
+	obj = json_object_new_int64(summary->p90);
+	CHECKMEM(obj);
+	json_object_object_add(histo, "p90", obj);
+
+	obj = json_object_new_int64(summary->p99);
+	CHECKMEM(obj);
+	json_object_object_add(histo, "p99", obj);
+
+error:
 	return (result);
 }
 
+isc_result_t
+dns_resolver_renderjson(dns_resolver_t *res, void *latency) {
+	REQUIRE(VALID_RESOLVER(res));
+
+	return (latency_walk(res, latency_renderjson, latency));
+}
+#undef CHECKMEM
+#endif /* HAVE_JSON_C */
+
 void
 dns_resolver_setquotaresponse(dns_resolver_t *resolver, dns_quotatype_t which,
 			      isc_result_t resp) {
@@ -10918,6 +11771,25 @@ dns_resolver_getquotaresponse(dns_resolver_t *resolver, dns_quotatype_t which) {
 	return (resolver->quotaresp[which]);
 }
 
+void
+dns_resolver_sharefetches(dns_resolver_t *res, dns_resolver_t *source) {
+	REQUIRE(VALID_RESOLVER(res));
+	REQUIRE(VALID_RESOLVER(source));
+	REQUIRE(!res->frozen);
+	REQUIRE(res->view->cache == source->view->cache);
+
+	if (res->fctxs == source->fctxs) {
+		return;
+	}
+
+	RWLOCK(&res->fctxs->lock, isc_rwlocktype_read);
+	INSIST(isc_hashmap_count(res->fctxs->hashmap) == 0);
+	RWUNLOCK(&res->fctxs->lock, isc_rwlocktype_read);
+
+	fctxtable_detach(&res->fctxs);
+	fctxtable_attach(source->fctxs, &res->fctxs);
+}
+
 void
 dns_resolver_setstats(dns_resolver_t *res, isc_stats_t *stats) {
 	REQUIRE(VALID_RESOLVER(res));
@@ -19,7 +19,10 @@
 #include <stdlib.h>
 
 #include <isc/async.h>
+#include <isc/atomic.h>
 #include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
@@ -29,6 +32,7 @@
 #include <isc/result.h>
 #include <isc/rwlock.h>
 #include <isc/string.h>
+#include <isc/urcu.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
@@ -36,6 +40,7 @@
 #include <dns/dbiterator.h>
 #include <dns/dnsrps.h>
 #include <dns/fixedname.h>
+#include <dns/journal.h>
 #include <dns/log.h>
 #include <dns/qp.h>
 #include <dns/rdata.h>
@@ -45,6 +50,8 @@
 #include <dns/rpz.h>
 #include <dns/view.h>
 
+#include "rpz_p.h"
+
 #define DNS_RPZ_ZONE_MAGIC  ISC_MAGIC('r', 'p', 'z', ' ')
 #define DNS_RPZ_ZONES_MAGIC ISC_MAGIC('r', 'p', 'z', 's')
 
@@ -89,6 +96,10 @@
  *
  * Names for IPv4 addresses are distinguished from IPv6 addresses by having
  * 5 labels all of which are numbers, and a prefix between 1 and 32.
+ *
+ * The radix tree is only used to maintain the set of addresses.  Lookups
+ * use a multibit trie that is rebuilt from the radix tree in bulk when an
+ * update of a policy zone has been applied, and replaced using RCU.
  */
 
 /*
@@ -97,6 +108,11 @@
 #define DNS_RPZ_HTSIZE_MAX 24
 #define DNS_RPZ_HTSIZE_DIV 3
 
+/*
+ * Source of dns_rpz_zones_t generation numbers.
+ */
+static atomic_uint_fast64_t rpz_generation = 0;
+
 static isc_result_t
 dns__rpz_shuttingdown(dns_rpz_zones_t *rpzs);
 static void
@@ -104,18 +120,6 @@ dns__rpz_timer_cb(void *);
 static void
 dns__rpz_timer_start(dns_rpz_zone_t *rpz);
 
-/*
- * Use a private definition of IPv6 addresses because s6_addr32 is not
- * always defined and our IPv6 addresses are in non-standard byte order
- */
-typedef uint32_t dns_rpz_cidr_word_t;
-#define DNS_RPZ_CIDR_WORD_BITS ((int)sizeof(dns_rpz_cidr_word_t) * 8)
-#define DNS_RPZ_CIDR_KEY_BITS  ((int)sizeof(dns_rpz_cidr_key_t) * 8)
-#define DNS_RPZ_CIDR_WORDS     (128 / DNS_RPZ_CIDR_WORD_BITS)
-typedef struct {
-	dns_rpz_cidr_word_t w[DNS_RPZ_CIDR_WORDS];
-} dns_rpz_cidr_key_t;
-
 #define ADDR_V4MAPPED 0xffff
 #define KEY_IS_IPV4(prefix, ip)                                  \
 	((prefix) >= 96 && (ip)->w[0] == 0 && (ip)->w[1] == 0 && \
@@ -133,17 +137,6 @@ typedef struct {
 	(1 & ((ip)->w[(n) / DNS_RPZ_CIDR_WORD_BITS] >> \
 	      (DNS_RPZ_CIDR_WORD_BITS - 1 - ((n) % DNS_RPZ_CIDR_WORD_BITS))))
 
-/*
- * A triplet of arrays of bits flagging the existence of
- * client-IP, IP, and NSIP policy triggers.
- */
-typedef struct dns_rpz_addr_zbits dns_rpz_addr_zbits_t;
-struct dns_rpz_addr_zbits {
-	dns_rpz_zbits_t client_ip;
-	dns_rpz_zbits_t ip;
-	dns_rpz_zbits_t nsip;
-};
-
 /*
  * A CIDR or radix tree node.
  */
@@ -1349,6 +1342,671 @@ search(dns_rpz_zones_t *rpzs, const dns_rpz_cidr_key_t *tgt_ip,
 	}
 }
 
+/*
+ * Return the node after 'cur' in a preorder walk of the radix tree, which
+ * visits the nodes in the order of their addresses and then their prefix
+ * lengths.
+ */
+static dns_rpz_cidr_node_t *
+cidr_next(dns_rpz_cidr_node_t *cur) {
+	if (cur->child[0] != NULL) {
+		return (cur->child[0]);
+	}
+	if (cur->child[1] != NULL) {
+		return (cur->child[1]);
+	}
+	while (cur->parent != NULL &&
+	       (cur->parent->child[1] == cur || cur->parent->child[1] == NULL))
+	{
+		cur = cur->parent;
+	}
+	return ((cur->parent != NULL) ? cur->parent->child[1] : NULL);
+}
+
+/*
+ * Mask an IP address to its first 'prefix' bits.
+ */
+static void
+mask_key(const dns_rpz_cidr_key_t *ip, dns_rpz_prefix_t prefix,
+	 dns_rpz_cidr_key_t *masked) {
+	for (int i = 0; i < DNS_RPZ_CIDR_WORDS; i++) {
+		int bits = prefix - i * DNS_RPZ_CIDR_WORD_BITS;
+		if (bits >= DNS_RPZ_CIDR_WORD_BITS) {
+			masked->w[i] = ip->w[i];
+		} else if (bits > 0) {
+			masked->w[i] = ip->w[i] & DNS_RPZ_WORD_MASK(bits);
+		} else {
+			masked->w[i] = 0;
+		}
+	}
+}
+
+/*
+ * The lookup trie is a multibit trie with a stride of 8 bits, laid out
+ * in three arrays when it is built, in the style of a tree bitmap.
+ *
+ * The node at depth 'd' on the path of an address holds the triggers with
+ * prefix lengths 8*d+1 through 8*d+8 in a bitmap of 510 positions, one
+ * for each possible value of each of those lengths.  The zone bits of the
+ * triggers are in the 'prefixes' array, starting at 'prefixbase' in the
+ * order of the positions, so the index of a trigger is the number of bits
+ * set before its position in the bitmap.  Longer triggers are below the
+ * children of the node, one for each value of the byte of the address
+ * at depth 'd', found the same way using 'nodes' and 'nodebase'.  A
+ * child with a single trigger below it is replaced by that trigger in
+ * 'leaves', to avoid long chains of nodes for sparse host addresses.
+ */
+#define TRIE_STRIDE	8
+#define TRIE_POSITIONS	((2 << TRIE_STRIDE) - 2)
+#define TRIE_CHILDREN	(1 << TRIE_STRIDE)
+#define TRIE_WORDS(bits) (((bits) + 63) / 64)
+
+typedef struct trienode {
+	uint64_t prefixes[TRIE_WORDS(TRIE_POSITIONS)];
+	uint64_t nodes[TRIE_WORDS(TRIE_CHILDREN)];
+	uint64_t leaves[TRIE_WORDS(TRIE_CHILDREN)];
+	uint32_t prefixbase;
+	uint32_t nodebase;
+	uint32_t leafbase;
+} trienode_t;
+
+struct dns_rpz_trie {
+	isc_mem_t *mctx;
+	struct rcu_head rcu_head;
+	bool haszero;
+	dns_rpz_addr_zbits_t zero; /* triggers with prefix length 0 */
+	trienode_t *nodes;
+	size_t nnodes, nodealloc;
+	dns_rpz_addr_zbits_t *prefixes;
+	size_t nprefixes, prefixalloc;
+	dns_rpz_trieentry_t *leaves;
+	size_t nleaves, leafalloc;
+};
+
+static unsigned int
+trie_byte(const dns_rpz_cidr_key_t *ip, unsigned int depth) {
+	return ((ip->w[depth / 4] >> (24 - 8 * (depth % 4))) & 0xff);
+}
+
+/*
+ * The position of the first 'bits' (1 to 8) bits of 'byte'.
+ */
+static unsigned int
+trie_position(unsigned int byte, unsigned int bits) {
+	return ((1U << bits) - 2 + (byte >> (TRIE_STRIDE - bits)));
+}
+
+static bool
+bitmap_isset(const uint64_t *bitmap, unsigned int bit) {
+	return (((bitmap[bit / 64] >> (bit % 64)) & 1) != 0);
+}
+
+static void
+bitmap_set(uint64_t *bitmap, unsigned int bit) {
+	bitmap[bit / 64] |= UINT64_C(1) << (bit % 64);
+}
+
+/*
+ * The number of bits set in 'bitmap' before 'bit'.
+ */
+static unsigned int
+bitmap_rank(const uint64_t *bitmap, unsigned int bit) {
+	unsigned int rank = 0;
+
+	for (unsigned int i = 0; i < bit / 64; i++) {
+		rank += __builtin_popcountll(bitmap[i]);
+	}
+	return (rank + __builtin_popcountll(bitmap[bit / 64] &
+					    ((UINT64_C(1) << (bit % 64)) - 1)));
+}
+
+static size_t
+trie_reserve(isc_mem_t *mctx, void **arrayp, size_t *countp, size_t *allocp,
+	     size_t count, size_t size) {
+	size_t base = *countp;
+
+	if (base + count > *allocp) {
+		size_t alloc = ISC_MAX(*allocp * 2, base + count);
+		*arrayp = isc_mem_creget(mctx, *arrayp, *allocp, alloc, size);
+		*allocp = alloc;
+	}
+	*countp += count;
+	return (base);
+}
+
+/*
+ * Return the end of the run of entries from 'i' that are below the same
+ * child of a node at 'depth'.  The sort order ensures that a trigger
+ * held by the node itself never sorts between them.
+ */
+static size_t
+trie_child_end(const dns_rpz_trieentry_t *entries, size_t i, size_t end,
+	       unsigned int depth) {
+	unsigned int byte = trie_byte(&entries[i].ip, depth);
+
+	while (++i < end && entries[i].prefix > (depth + 1) * TRIE_STRIDE &&
+	       trie_byte(&entries[i].ip, depth) == byte)
+	{
+	}
+	return (i);
+}
+
+/*
+ * Build node 'n' at 'depth' from the entries from 'start' to 'end', which
+ * share the first 8*depth bits and have longer prefixes.
+ */
+static void
+trie_build(dns_rpz_trie_t *trie, const dns_rpz_trieentry_t *entries,
+	   size_t start, size_t end, unsigned int depth, size_t n) {
+	trienode_t node = { 0 };
+	unsigned int limit = (depth + 1) * TRIE_STRIDE;
+	unsigned int nprefixes = 0, nnodes = 0, nleaves = 0, bits, pos;
+	size_t i, next;
+
+	for (i = start; i < end; i = next) {
+		unsigned int byte = trie_byte(&entries[i].ip, depth);
+
+		if (entries[i].prefix <= limit) {
+			bits = entries[i].prefix - depth * TRIE_STRIDE;
+			bitmap_set(node.prefixes, trie_position(byte, bits));
+			nprefixes++;
+			next = i + 1;
+			continue;
+		}
+		next = trie_child_end(entries, i, end, depth);
+		if (next - i == 1) {
+			bitmap_set(node.leaves, byte);
+			nleaves++;
+		} else {
+			bitmap_set(node.nodes, byte);
+			nnodes++;
+		}
+	}
+
+	node.prefixbase = trie_reserve(trie->mctx, (void **)&trie->prefixes,
+				       &trie->nprefixes, &trie->prefixalloc,
+				       nprefixes, sizeof(trie->prefixes[0]));
+	node.leafbase = trie_reserve(trie->mctx, (void **)&trie->leaves,
+				     &trie->nleaves, &trie->leafalloc, nleaves,
+				     sizeof(trie->leaves[0]));
+	node.nodebase = trie_reserve(trie->mctx, (void **)&trie->nodes,
+				     &trie->nnodes, &trie->nodealloc, nnodes,
+				     sizeof(trie->nodes[0]));
+	trie->nodes[n] = node;
+
+	for (i = start; i < end; i = next) {
+		unsigned int byte = trie_byte(&entries[i].ip, depth);
+
+		if (entries[i].prefix <= limit) {
+			bits = entries[i].prefix - depth * TRIE_STRIDE;
+			pos = bitmap_rank(node.prefixes,
+					  trie_position(byte, bits));
+			trie->prefixes[node.prefixbase + pos] = entries[i].set;
+			next = i + 1;
+			continue;
+		}
+		next = trie_child_end(entries, i, end, depth);
+		if (next - i == 1) {
+			pos = node.leafbase + bitmap_rank(node.leaves, byte);
+			trie->leaves[pos] = entries[i];
+		} else {
+			pos = node.nodebase + bitmap_rank(node.nodes, byte);
+			trie_build(trie, entries, i, next, depth + 1, pos);
+		}
+	}
+}
+
+void
+dns__rpz_trie_create(isc_mem_t *mctx, const dns_rpz_trieentry_t *entries,
+		     size_t count, dns_rpz_trie_t **triep) {
+	dns_rpz_trie_t *trie = NULL;
+	size_t start = 0;
+
+	REQUIRE(triep != NULL && *triep == NULL);
+
+	trie = isc_mem_get(mctx, sizeof(*trie));
+	*trie = (dns_rpz_trie_t){ 0 };
+	isc_mem_attach(mctx, &trie->mctx);
+
+	if (count > 0 && entries[0].prefix == 0) {
+		trie->haszero = true;
+		trie->zero = entries[0].set;
+		start = 1;
+	}
+	if (start < count) {
+		(void)trie_reserve(mctx, (void **)&trie->nodes, &trie->nnodes,
+				   &trie->nodealloc, 1, sizeof(trie->nodes[0]));
+		trie_build(trie, entries, start, count, 0, 0);
+	}
+
+	/* The trie is not changed after it is built. */
+	trie->nodes = isc_mem_creget(mctx, trie->nodes, trie->nodealloc,
+				     trie->nnodes, sizeof(trie->nodes[0]));
+	trie->nodealloc = trie->nnodes;
+	trie->prefixes = isc_mem_creget(mctx, trie->prefixes,
+					trie->prefixalloc, trie->nprefixes,
+					sizeof(trie->prefixes[0]));
+	trie->prefixalloc = trie->nprefixes;
+	trie->leaves = isc_mem_creget(mctx, trie->leaves, trie->leafalloc,
+				      trie->nleaves, sizeof(trie->leaves[0]));
+	trie->leafalloc = trie->nleaves;
+
+	*triep = trie;
+}
+
+void
+dns__rpz_trie_destroy(dns_rpz_trie_t **triep) {
+	dns_rpz_trie_t *trie = NULL;
+
+	REQUIRE(triep != NULL && *triep != NULL);
+
+	trie = *triep;
+	*triep = NULL;
+
+	isc_mem_cput(trie->mctx, trie->nodes, trie->nodealloc,
+		     sizeof(trie->nodes[0]));
+	isc_mem_cput(trie->mctx, trie->prefixes, trie->prefixalloc,
+		     sizeof(trie->prefixes[0]));
+	isc_mem_cput(trie->mctx, trie->leaves, trie->leafalloc,
+		     sizeof(trie->leaves[0]));
+	isc_mem_putanddetach(&trie->mctx, trie, sizeof(*trie));
+}
+
+static void
+trie_destroy_rcu(struct rcu_head *rcu_head) {
+	dns_rpz_trie_t *trie = caa_container_of(rcu_head, dns_rpz_trie_t,
+						rcu_head);
+	dns__rpz_trie_destroy(&trie);
+}
+
+/*
+ * Like search(), keep the longest trigger that is in the zones of 'set',
+ * after dropping the zones numbered higher than the first hit.
+ */
+static void
+trie_match(const dns_rpz_addr_zbits_t *entry, dns_rpz_prefix_t prefix,
+	   dns_rpz_addr_zbits_t *set, const dns_rpz_addr_zbits_t **foundp,
+	   dns_rpz_prefix_t *prefixp) {
+	if ((entry->client_ip & set->client_ip) == 0 &&
+	    (entry->ip & set->ip) == 0 && (entry->nsip & set->nsip) == 0)
+	{
+		return;
+	}
+	*foundp = entry;
+	*prefixp = prefix;
+	set->client_ip = trim_zbits(set->client_ip, entry->client_ip);
+	set->ip = trim_zbits(set->ip, entry->ip);
+	set->nsip = trim_zbits(set->nsip, entry->nsip);
+}
+
+isc_result_t
+dns__rpz_trie_find(const dns_rpz_trie_t *trie, const dns_rpz_cidr_key_t *ip,
+		   const dns_rpz_addr_zbits_t *tgt_set,
+		   dns_rpz_addr_zbits_t *found_set, dns_rpz_prefix_t *prefixp) {
+	const trienode_t *node = NULL;
+	const dns_rpz_addr_zbits_t *found = NULL;
+	dns_rpz_addr_zbits_t set = *tgt_set;
+	dns_rpz_prefix_t prefix = 0;
+
+	if (trie->haszero) {
+		trie_match(&trie->zero, 0, &set, &found, &prefix);
+	}
+
+	node = (trie->nnodes > 0) ? &trie->nodes[0] : NULL;
+	for (unsigned int depth = 0; node != NULL; depth++) {
+		unsigned int byte = trie_byte(ip, depth);
+
+		for (unsigned int bits = 1; bits <= TRIE_STRIDE; bits++) {
+			unsigned int pos = trie_position(byte, bits);
+			if (bitmap_isset(node->prefixes, pos)) {
+				pos = node->prefixbase +
+				      bitmap_rank(node->prefixes, pos);
+				trie_match(&trie->prefixes[pos],
+					   depth * TRIE_STRIDE + bits, &set,
+					   &found, &prefix);
+			}
+		}
+
+		if (bitmap_isset(node->leaves, byte)) {
+			const dns_rpz_trieentry_t *leaf =
+				&trie->leaves[node->leafbase +
+					      bitmap_rank(node->leaves, byte)];
+			dns_rpz_cidr_key_t masked;
+
+			mask_key(ip, leaf->prefix, &masked);
+			if (memcmp(&masked, &leaf->ip, sizeof(masked)) == 0) {
+				trie_match(&leaf->set, leaf->prefix, &set,
+					   &found, &prefix);
+			}
+			break;
+		}
+		if (!bitmap_isset(node->nodes, byte)) {
+			break;
+		}
+		node = &trie->nodes[node->nodebase +
+				    bitmap_rank(node->nodes, byte)];
+	}
+
+	if (found == NULL) {
+		return (ISC_R_NOTFOUND);
+	}
+
+	found_set->client_ip = found->client_ip & set.client_ip;
+	found_set->ip = found->ip & set.ip;
+	found_set->nsip = found->nsip & set.nsip;
+	*prefixp = prefix;
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Replace the lookup trie with one built from the radix tree, if the
+ * tree has changed since the last one was built.
+ */
+static void
+trie_update(dns_rpz_zones_t *rpzs) {
+	dns_rpz_trie_t *trie = NULL;
+	dns_rpz_trieentry_t *entries = NULL;
+	dns_rpz_cidr_node_t *cur = NULL;
+	size_t count = 0, i = 0;
+
+	if (!rpzs->cidrchanged) {
+		return;
+	}
+	rpzs->cidrchanged = false;
+
+	for (cur = rpzs->cidr; cur != NULL; cur = cidr_next(cur)) {
+		if (cur->set.client_ip != 0 || cur->set.ip != 0 ||
+		    cur->set.nsip != 0)
+		{
+			count++;
+		}
+	}
+
+	entries = isc_mem_cget(rpzs->mctx, count, sizeof(entries[0]));
+	for (cur = rpzs->cidr; cur != NULL; cur = cidr_next(cur)) {
+		if (cur->set.client_ip != 0 || cur->set.ip != 0 ||
+		    cur->set.nsip != 0)
+		{
+			entries[i++] = (dns_rpz_trieentry_t){
+				.ip = cur->ip,
+				.prefix = cur->prefix,
+				.set = cur->set,
+			};
+		}
+	}
+	INSIST(i == count);
+
+	dns__rpz_trie_create(rpzs->mctx, entries, count, &trie);
+	isc_mem_cput(rpzs->mctx, entries, count, sizeof(entries[0]));
+
+	trie = rcu_xchg_pointer(&rpzs->trie, trie);
+	if (trie != NULL) {
+		call_rcu(&trie->rcu_head, trie_destroy_rcu);
+	}
+}
+
+/*
+ * The summary filter is a blocked Bloom filter: each key sets one bit
+ * in each of the eight words of a single 64-byte block, so a lookup
+ * touches one cache line.  It covers the trigger names in the summary
+ * database and the prefixes in the radix tree.  Keys are only added;
+ * deleted triggers are left in place until there are enough of them to
+ * rebuild the filter, as are keys added when it is full.  A filter is
+ * replaced, never changed, by a rebuild, and freed after an RCU grace
+ * period.  Like all summary changes, additions and rebuilds are done
+ * with 'maint_lock' held.
+ */
+#define FILTER_BLOCKWORDS   8
+#define FILTER_KEYSPERBLOCK 32 /* 16 bits per key */
+#define FILTER_MINBLOCKS    64
+#define FILTER_MAXPREFIXES  16 /* larger sets of prefix lengths skip it */
+
+typedef struct dns_rpz_filter dns_rpz_filter_t;
+struct dns_rpz_filter {
+	isc_mem_t *mctx;
+	struct rcu_head rcu_head;
+	size_t nblocks; /* power of two */
+	size_t capacity;
+	size_t nkeys;
+	size_t stale;
+	atomic_uint_fast64_t prefixes[3]; /* prefix lengths 0..128 */
+	atomic_uint_fast64_t bits[];
+};
+
+static void
+filter_destroy(dns_rpz_filter_t *filter) {
+	isc_mem_putanddetach(&filter->mctx, filter,
+			     STRUCT_FLEX_SIZE(filter, bits,
+					      filter->nblocks *
+						      FILTER_BLOCKWORDS));
+}
+
+static void
+filter_destroy_rcu(struct rcu_head *rcu_head) {
+	dns_rpz_filter_t *filter = caa_container_of(rcu_head,
+						    dns_rpz_filter_t, rcu_head);
+	filter_destroy(filter);
+}
+
+static void
+filter_set(dns_rpz_filter_t *filter, uint64_t hash) {
+	atomic_uint_fast64_t *block =
+		&filter->bits[(hash & (filter->nblocks - 1)) *
+			      FILTER_BLOCKWORDS];
+	uint64_t bits = hash * 0x9e3779b97f4a7c15ULL;
+
+	for (size_t i = 0; i < FILTER_BLOCKWORDS; i++) {
+		uint64_t bit = UINT64_C(1) << ((bits >> (6 * i)) & 63);
+		atomic_fetch_or_relaxed(&block[i], bit);
+	}
+	filter->nkeys++;
+}
+
+static bool
+filter_test(const dns_rpz_filter_t *filter, uint64_t hash) {
+	const atomic_uint_fast64_t *block =
+		&filter->bits[(hash & (filter->nblocks - 1)) *
+			      FILTER_BLOCKWORDS];
+	uint64_t bits = hash * 0x9e3779b97f4a7c15ULL;
+
+	for (size_t i = 0; i < FILTER_BLOCKWORDS; i++) {
+		uint64_t bit = UINT64_C(1) << ((bits >> (6 * i)) & 63);
+		if ((atomic_load_relaxed(&block[i]) & bit) == 0) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+static uint64_t
+filter_namehash(const unsigned char *ndata, size_t length) {
+	return (isc_hash64(ndata, length, false));
+}
+
+static uint64_t
+filter_iphash(const dns_rpz_cidr_key_t *ip, dns_rpz_prefix_t prefix) {
+	struct {
+		dns_rpz_cidr_key_t ip;
+		uint32_t prefix;
+	} key = { .prefix = prefix };
+
+	mask_key(ip, prefix, &key.ip);
+	return (isc_hash64(&key, sizeof(key), true));
+}
+
+static void
+filter_setip(dns_rpz_filter_t *filter, const dns_rpz_cidr_key_t *ip,
+	     dns_rpz_prefix_t prefix) {
+	atomic_fetch_or_relaxed(&filter->prefixes[prefix / 64],
+				UINT64_C(1) << (prefix % 64));
+	filter_set(filter, filter_iphash(ip, prefix));
+}
+
+/*
+ * Replace the filter with a new one holding all the current triggers,
+ * sized for 'extra' more.
+ */
+static void
+filter_rebuild(dns_rpz_zones_t *rpzs, size_t extra) {
+	dns_rpz_filter_t *filter = NULL;
+	dns_rpz_cidr_node_t *cur = NULL;
+	dns_qpread_t qpr;
+	dns_qpiter_t iter;
+	nmdata_t *data = NULL;
+	size_t keys = extra, nblocks = FILTER_MINBLOCKS;
+
+	keys += dns_qpmulti_memusage(rpzs->table).leaves;
+	for (cur = rpzs->cidr; cur != NULL; cur = cidr_next(cur)) {
+		keys++;
+	}
+
+	/* Leave room to grow to twice the current size. */
+	while (nblocks * FILTER_KEYSPERBLOCK < keys * 2) {
+		nblocks *= 2;
+	}
+
+	filter = isc_mem_get(rpzs->mctx,
+			     STRUCT_FLEX_SIZE(filter, bits,
+					      nblocks * FILTER_BLOCKWORDS));
+	*filter = (dns_rpz_filter_t){
+		.nblocks = nblocks,
+		.capacity = nblocks * FILTER_KEYSPERBLOCK,
+	};
+	isc_mem_attach(rpzs->mctx, &filter->mctx);
+	for (size_t i = 0; i < ARRAY_SIZE(filter->prefixes); i++) {
+		atomic_init(&filter->prefixes[i], 0);
+	}
+	for (size_t i = 0; i < nblocks * FILTER_BLOCKWORDS; i++) {
+		atomic_init(&filter->bits[i], 0);
+	}
+
+	dns_qpmulti_lockedread(rpzs->table, &qpr);
+	dns_qpiter_init(&qpr, &iter);
+	while (dns_qpiter_next(&iter, NULL, (void **)&data, NULL) ==
+	       ISC_R_SUCCESS)
+	{
+		filter_set(filter, filter_namehash(data->name.ndata,
+						   data->name.length));
+	}
+	dns_qpread_destroy(rpzs->table, &qpr);
+
+	for (cur = rpzs->cidr; cur != NULL; cur = cidr_next(cur)) {
+		if (cur->set.client_ip != 0 || cur->set.ip != 0 ||
+		    cur->set.nsip != 0)
+		{
+			filter_setip(filter, &cur->ip, cur->prefix);
+		}
+	}
+
+	filter = rcu_xchg_pointer(&rpzs->filter, filter);
+	if (filter != NULL) {
+		call_rcu(&filter->rcu_head, filter_destroy_rcu);
+	}
+}
+
+/*
+ * Get the filter that a new trigger is to be added to, rebuilding it
+ * first if it is full.
+ */
+static dns_rpz_filter_t *
+filter_get(dns_rpz_zones_t *rpzs) {
+	dns_rpz_filter_t *filter = rcu_dereference(rpzs->filter);
+
+	if (filter == NULL || filter->nkeys >= filter->capacity) {
+		filter_rebuild(rpzs, 1);
+		filter = rcu_dereference(rpzs->filter);
+	}
+	return (filter);
+}
+
+/*
+ * Account for a deleted trigger, and rebuild the filter once half of
+ * its keys are stale.
+ */
+static void
+filter_deleted(dns_rpz_zones_t *rpzs) {
+	dns_rpz_filter_t *filter = rcu_dereference(rpzs->filter);
+
+	if (filter == NULL) {
+		return;
+	}
+	if (++filter->stale > filter->nkeys / 2 &&
+	    filter->nkeys > FILTER_MINBLOCKS * FILTER_KEYSPERBLOCK)
+	{
+		filter_rebuild(rpzs, 0);
+	}
+}
+
+/*
+ * Can 'name' or any of its ancestors be a trigger name?
+ */
+static bool
+filter_name(dns_rpz_zones_t *rpzs, const dns_name_t *name) {
+	dns_rpz_filter_t *filter = NULL;
+	const unsigned char *ndata = name->ndata;
+	const unsigned char *end = name->ndata + name->length;
+	bool maybe = false;
+
+	REQUIRE(dns_name_isabsolute(name));
+
+	rcu_read_lock();
+	filter = rcu_dereference(rpzs->filter);
+	if (filter == NULL) {
+		maybe = true;
+	}
+	while (!maybe) {
+		uint64_t hash = filter_namehash(ndata, end - ndata);
+		maybe = filter_test(filter, hash);
+		if (*ndata == 0) {
+			break;
+		}
+		ndata += *ndata + 1;
+	}
+	rcu_read_unlock();
+
+	return (maybe);
+}
+
+/*
+ * Can any prefix of 'ip' be a trigger?
+ */
+static bool
+filter_ip(dns_rpz_zones_t *rpzs, const dns_rpz_cidr_key_t *ip) {
+	dns_rpz_filter_t *filter = NULL;
+	dns_rpz_prefix_t prefixes[FILTER_MAXPREFIXES];
+	unsigned int count = 0;
+	bool maybe = false;
+
+	rcu_read_lock();
+	filter = rcu_dereference(rpzs->filter);
+	if (filter == NULL) {
+		maybe = true;
+		goto unlock;
+	}
+
+	for (dns_rpz_prefix_t prefix = 0; prefix <= 128; prefix++) {
+		uint64_t bit = UINT64_C(1) << (prefix % 64);
+		if ((atomic_load_relaxed(&filter->prefixes[prefix / 64]) &
+		     bit) == 0)
+		{
+			continue;
+		}
+		if (count == FILTER_MAXPREFIXES) {
+			maybe = true;
+			goto unlock;
+		}
+		prefixes[count++] = prefix;
+	}
+	for (unsigned int i = 0; !maybe && i < count; i++) {
+		maybe = filter_test(filter, filter_iphash(ip, prefixes[i]));
+	}
+
+unlock:
+	rcu_read_unlock();
+
+	return (maybe);
+}
+
 /*
  * Add an IP address to the radix tree.
  */
@@ -1370,6 +2028,8 @@ add_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 		return (ISC_R_SUCCESS);
 	}
 
+	filter_setip(filter_get(rpz->rpzs), &tgt_ip, tgt_prefix);
+
 	RWLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
 	result = search(rpz->rpzs, &tgt_ip, tgt_prefix, &set, true, &found);
 	if (result != ISC_R_SUCCESS) {
@@ -1396,6 +2056,7 @@ add_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	}
 
 	adj_trigger_cnt(rpz, rpz_type, &tgt_ip, tgt_prefix, true);
+	rpz->rpzs->cidrchanged = true;
 done:
 	RWUNLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
 	return (result);
@@ -1477,6 +2138,9 @@ add_name(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	trig_name = dns_fixedname_initname(&trig_namef);
 	name2data(rpz, rpz_type, src_name, trig_name, &new_data);
 
+	filter_set(filter_get(rpz->rpzs),
+		   filter_namehash(trig_name->ndata, trig_name->length));
+
 	result = add_nm(rpz->rpzs, trig_name, &new_data);
 
 	/*
@@ -1516,6 +2180,7 @@ dns_rpz_new_zones(dns_view_t *view, isc_loopmgr_t *loopmgr, char *rps_cstr,
 		.rps_cstr = rps_cstr,
 		.rps_cstr_size = rps_cstr_size,
 		.loopmgr = loopmgr,
+		.generation = atomic_fetch_add_relaxed(&rpz_generation, 1) + 1,
 		.magic = DNS_RPZ_ZONES_MAGIC,
 	};
 
@@ -1584,7 +2249,7 @@ dns_rpz_new_zone(dns_rpz_zones_t *rpzs, dns_rpz_zone_t **rpzp) {
 	 * simplifies update_from_db().
 	 */
 
-	isc_ht_init(&rpz->nodes, rpzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	isc_hashmap_create(rpzs->mctx, 1, &rpz->nodes);
 
 	dns_name_init(&rpz->origin, NULL);
 	dns_name_init(&rpz->client_ip, NULL);
@@ -1623,6 +2288,9 @@ dns_rpz_dbupdate_callback(dns_db_t *db, void *fn_arg) {
 
 	/* New zone came as AXFR */
 	if (rpz->db != NULL && rpz->db != db) {
+		/* The journal does not lead to the new database. */
+		rpz->serialvalid = false;
+
 		/* We need to clean up the old DB */
 		if (rpz->dbversion != NULL) {
 			dns_db_closeversion(rpz->db, &rpz->dbversion, false);
@@ -1678,6 +2346,20 @@ dns_rpz_dbupdate_register(dns_db_t *db, dns_rpz_zone_t *rpz) {
 
 	dns_db_updatenotify_register(db, dns_rpz_dbupdate_callback, rpz);
 }
+
+void
+dns_rpz_zone_setjournal(dns_rpz_zone_t *rpz, const char *journal) {
+	REQUIRE(DNS_RPZ_ZONE_VALID(rpz));
+
+	LOCK(&rpz->rpzs->maint_lock);
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpz->rpzs->mctx, rpz->journal);
+	}
+	if (journal != NULL) {
+		rpz->journal = isc_mem_strdup(rpz->rpzs->mctx, journal);
+	}
+	UNLOCK(&rpz->rpzs->maint_lock);
+}
 static void
 dns__rpz_timer_start(dns_rpz_zone_t *rpz) {
 	uint64_t tdiff;
@@ -1751,8 +2433,82 @@ update_rpz_done_cb(void *data) {
 	dns_rpz_zones_unref(rpz->rpzs);
 }
 
+/*
+ * The owner names with data in a policy zone are kept in a hashmap of
+ * names allocated from the zones' memory context.
+ */
+static bool
+nodes_match(void *node, const void *key) {
+	return (dns_name_equal(node, key));
+}
+
+static void
+nodes_freename(isc_mem_t *mctx, dns_name_t **namep) {
+	dns_name_t *name = *namep;
+
+	*namep = NULL;
+	dns_name_free(name, mctx);
+	isc_mem_put(mctx, name, sizeof(*name));
+}
+
+static isc_result_t
+nodes_add(isc_mem_t *mctx, isc_hashmap_t *nodes, const dns_name_t *name) {
+	isc_result_t result;
+	dns_name_t *copy = isc_mem_get(mctx, sizeof(*copy));
+
+	dns_name_init(copy, NULL);
+	dns_name_dup(name, mctx, copy);
+
+	result = isc_hashmap_add(nodes, dns_name_hash(copy), nodes_match, copy,
+				 copy, NULL);
+	if (result != ISC_R_SUCCESS) {
+		nodes_freename(mctx, &copy);
+	}
+
+	return (result);
+}
+
+static bool
+nodes_find(isc_hashmap_t *nodes, const dns_name_t *name) {
+	return (isc_hashmap_find(nodes, dns_name_hash(name), nodes_match, name,
+				 NULL) == ISC_R_SUCCESS);
+}
+
+static void
+nodes_delete(isc_mem_t *mctx, isc_hashmap_t *nodes, const dns_name_t *name) {
+	isc_result_t result;
+	uint32_t hashval = dns_name_hash(name);
+	dns_name_t *found = NULL;
+
+	result = isc_hashmap_find(nodes, hashval, nodes_match, name,
+				  (void **)&found);
+	if (result == ISC_R_SUCCESS) {
+		result = isc_hashmap_delete(nodes, hashval, nodes_match, name);
+		INSIST(result == ISC_R_SUCCESS);
+		nodes_freename(mctx, &found);
+	}
+}
+
+static void
+nodes_destroy(isc_mem_t *mctx, isc_hashmap_t **nodesp) {
+	isc_result_t result;
+	isc_hashmap_iter_t *iter = NULL;
+
+	isc_hashmap_iter_create(*nodesp, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;)
+	{
+		dns_name_t *name = NULL;
+
+		isc_hashmap_iter_current(iter, (void **)&name);
+		result = isc_hashmap_iter_delcurrent_next(iter);
+		nodes_freename(mctx, &name);
+	}
+	isc_hashmap_iter_destroy(&iter);
+	isc_hashmap_destroy(nodesp);
+}
+
 static isc_result_t
-update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
+update_nodes(dns_rpz_zone_t *rpz, isc_hashmap_t *newnodes) {
 	isc_result_t result;
 	dns_dbiterator_t *updbit = NULL;
 	dns_name_t *name = NULL;
@@ -1835,22 +2591,21 @@ update_nodes(dns_rpz_zone_t *rpz, isc_ht_t *newnodes) {
 		dns_name_downcase(name, name, NULL);
 
 		/* Add entry to the new nodes table */
-		result = isc_ht_add(newnodes, name->ndata, name->length, rpz);
+		result = nodes_add(rpz->rpzs->mctx, newnodes, name);
 		if (result != ISC_R_SUCCESS) {
 			dns_name_format(name, namebuf, sizeof(namebuf));
 			isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
 				      DNS_LOGMODULE_MASTER, ISC_LOG_ERROR,
-				      "rpz: %s, adding node %s to HT error %s",
+				      "rpz: %s, adding node %s to hashmap "
+				      "error %s",
 				      domain, namebuf,
 				      isc_result_totext(result));
 			goto next;
 		}
 
 		/* Does the entry exist in the old nodes table? */
-		result = isc_ht_find(rpz->nodes, name->ndata, name->length,
-				     NULL);
-		if (result == ISC_R_SUCCESS) { /* found */
-			isc_ht_delete(rpz->nodes, name->ndata, name->length);
+		if (nodes_find(rpz->nodes, name)) {
+			nodes_delete(rpz->rpzs->mctx, rpz->nodes, name);
 			goto next;
 		}
 
@@ -1896,41 +2651,181 @@ cleanup:
 static isc_result_t
 cleanup_nodes(dns_rpz_zone_t *rpz) {
 	isc_result_t result;
-	isc_ht_iter_t *iter = NULL;
-	dns_name_t *name = NULL;
-	dns_fixedname_t fixname;
-
-	name = dns_fixedname_initname(&fixname);
+	isc_hashmap_iter_t *iter = NULL;
 
-	isc_ht_iter_create(rpz->nodes, &iter);
+	isc_hashmap_iter_create(rpz->nodes, &iter);
 
-	for (result = isc_ht_iter_first(iter); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(iter))
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;)
 	{
-		isc_region_t region;
-		unsigned char *key = NULL;
-		size_t keysize;
+		dns_name_t *name = NULL;
 
 		result = dns__rpz_shuttingdown(rpz->rpzs);
 		if (result != ISC_R_SUCCESS) {
 			break;
 		}
 
-		isc_ht_iter_currentkey(iter, &key, &keysize);
-		region.base = key;
-		region.length = (unsigned int)keysize;
-		dns_name_fromregion(name, &region);
+		isc_hashmap_iter_current(iter, (void **)&name);
 
 		LOCK(&rpz->rpzs->maint_lock);
 		rpz_del(rpz, name);
 		UNLOCK(&rpz->rpzs->maint_lock);
+
+		result = isc_hashmap_iter_delcurrent_next(iter);
+		nodes_freename(rpz->rpzs->mctx, &name);
 	}
 	INSIST(result != ISC_R_SUCCESS);
 	if (result == ISC_R_NOMORE) {
 		result = ISC_R_SUCCESS;
 	}
 
-	isc_ht_iter_destroy(&iter);
+	isc_hashmap_iter_destroy(&iter);
+
+	return (result);
+}
+
+/*
+ * Does 'name' have any data in the version of the policy zone that is
+ * being processed?  Empty non-terminals do not count.
+ */
+static bool
+node_hasdata(dns_rpz_zone_t *rpz, const dns_name_t *name) {
+	isc_result_t result;
+	dns_dbnode_t *node = NULL;
+	dns_rdatasetiter_t *rdsiter = NULL;
+
+	result = dns_db_findnode(rpz->updb, name, false, &node);
+	if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+
+	result = dns_db_allrdatasets(rpz->updb, node, rpz->updbversion, 0, 0,
+				     &rdsiter);
+	if (result == ISC_R_SUCCESS) {
+		result = dns_rdatasetiter_first(rdsiter);
+		dns_rdatasetiter_destroy(&rdsiter);
+	}
+	dns_db_detachnode(rpz->updb, &node);
+
+	return (result == ISC_R_SUCCESS);
+}
+
+/*
+ * Update the summary data from the journal of the policy zone instead
+ * of the whole database: only the owner names that have records in the
+ * journal between the last processed serial and 'serial' are looked up
+ * in the new version, and added or deleted.  A journal that does not
+ * cover the serials makes this fail, so that the caller falls back to
+ * comparing all the names in the zone.
+ */
+static isc_result_t
+update_incremental(dns_rpz_zone_t *rpz, const char *journalfile,
+		   uint32_t serial) {
+	isc_result_t result;
+	isc_mem_t *mctx = rpz->rpzs->mctx;
+	dns_journal_t *journal = NULL;
+	isc_hashmap_t *changed = NULL;
+	isc_hashmap_iter_t *iter = NULL;
+	dns_fixedname_t fixname;
+	dns_name_t *name = dns_fixedname_initname(&fixname);
+	char domain[DNS_NAME_FORMATSIZE];
+	char namebuf[DNS_NAME_FORMATSIZE];
+	unsigned int added = 0, deleted = 0;
+
+	result = dns_journal_open(mctx, journalfile, DNS_JOURNAL_READ,
+				  &journal);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	result = dns_journal_iter_init(journal, rpz->serial, serial, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	/*
+	 * Collect the owner names that have changed.
+	 */
+	isc_hashmap_create(mctx, 1, &changed);
+	for (result = dns_journal_first_rr(journal); result == ISC_R_SUCCESS;
+	     result = dns_journal_next_rr(journal))
+	{
+		dns_name_t *jname = NULL;
+		dns_rdata_t *rdata = NULL;
+		uint32_t ttl;
+
+		dns_journal_current_rr(journal, &jname, &ttl, &rdata);
+		dns_name_downcase(jname, name, NULL);
+		(void)nodes_add(mctx, changed, name);
+	}
+	if (result != ISC_R_NOMORE) {
+		goto cleanup;
+	}
+
+	dns_name_format(&rpz->origin, domain, DNS_NAME_FORMATSIZE);
+
+	isc_hashmap_iter_create(changed, &iter);
+	for (result = isc_hashmap_iter_first(iter); result == ISC_R_SUCCESS;
+	     result = isc_hashmap_iter_next(iter))
+	{
+		bool exists, existed;
+
+		result = dns__rpz_shuttingdown(rpz->rpzs);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+
+		name = NULL;
+		isc_hashmap_iter_current(iter, (void **)&name);
+
+		exists = node_hasdata(rpz, name);
+		existed = nodes_find(rpz->nodes, name);
+
+		if (exists && !existed) {
+			result = nodes_add(mctx, rpz->nodes, name);
+			if (result != ISC_R_SUCCESS) {
+				break;
+			}
+
+			LOCK(&rpz->rpzs->maint_lock);
+			result = rpz_add(rpz, name);
+			UNLOCK(&rpz->rpzs->maint_lock);
+
+			if (result != ISC_R_SUCCESS) {
+				dns_name_format(name, namebuf, sizeof(namebuf));
+				isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+					      DNS_LOGMODULE_MASTER,
+					      ISC_LOG_ERROR,
+					      "rpz: %s: adding node %s "
+					      "to RPZ error %s",
+					      domain, namebuf,
+					      isc_result_totext(result));
+			}
+			added++;
+		} else if (!exists && existed) {
+			nodes_delete(mctx, rpz->nodes, name);
+
+			LOCK(&rpz->rpzs->maint_lock);
+			rpz_del(rpz, name);
+			UNLOCK(&rpz->rpzs->maint_lock);
+			deleted++;
+		}
+	}
+	if (result == ISC_R_NOMORE) {
+		result = ISC_R_SUCCESS;
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(1),
+			      "rpz: %s: %u names changed in the journal, "
+			      "%u added, %u deleted",
+			      domain, isc_hashmap_count(changed), added,
+			      deleted);
+	}
+	isc_hashmap_iter_destroy(&iter);
+
+cleanup:
+	if (changed != NULL) {
+		nodes_destroy(mctx, &changed);
+	}
+	dns_journal_destroy(&journal);
 
 	return (result);
 }
@@ -1954,7 +2849,11 @@ static void
 update_rpz_cb(void *data) {
 	dns_rpz_zone_t *rpz = (dns_rpz_zone_t *)data;
 	isc_result_t result = ISC_R_SUCCESS;
-	isc_ht_t *newnodes = NULL;
+	isc_hashmap_t *newnodes = NULL;
+	char *journal = NULL;
+	uint32_t serial = 0;
+	bool haveserial, incremental = false;
+	char domain[DNS_NAME_FORMATSIZE];
 
 	REQUIRE(rpz->nodes != NULL);
 
@@ -1963,7 +2862,38 @@ update_rpz_cb(void *data) {
 		goto shuttingdown;
 	}
 
-	isc_ht_init(&newnodes, rpz->rpzs->mctx, 1, ISC_HT_CASE_SENSITIVE);
+	haveserial = (dns_db_getsoaserial(rpz->updb, rpz->updbversion,
+					  &serial) == ISC_R_SUCCESS);
+
+	/*
+	 * If the previous version of this database has been processed,
+	 * try to process only the names that changed since then.
+	 */
+	LOCK(&rpz->rpzs->maint_lock);
+	if (haveserial && rpz->serialvalid && rpz->db == rpz->updb &&
+	    rpz->journal != NULL)
+	{
+		journal = isc_mem_strdup(rpz->rpzs->mctx, rpz->journal);
+		incremental = true;
+	}
+	UNLOCK(&rpz->rpzs->maint_lock);
+
+	if (incremental) {
+		result = update_incremental(rpz, journal, serial);
+		isc_mem_free(rpz->rpzs->mctx, journal);
+		if (result == ISC_R_SUCCESS || result == ISC_R_SHUTTINGDOWN) {
+			goto done;
+		}
+
+		dns_name_format(&rpz->origin, domain, DNS_NAME_FORMATSIZE);
+		isc_log_write(dns_lctx, DNS_LOGCATEGORY_GENERAL,
+			      DNS_LOGMODULE_MASTER, ISC_LOG_DEBUG(1),
+			      "rpz: %s: can not be updated from the "
+			      "journal (%s), processing all names",
+			      domain, isc_result_totext(result));
+	}
+
+	isc_hashmap_create(rpz->rpzs->mctx, 1, &newnodes);
 
 	result = update_nodes(rpz, newnodes);
 	if (result != ISC_R_SUCCESS) {
@@ -1979,7 +2909,19 @@ update_rpz_cb(void *data) {
 	ISC_SWAP(rpz->nodes, newnodes);
 
 cleanup:
-	isc_ht_destroy(&newnodes);
+	nodes_destroy(rpz->rpzs->mctx, &newnodes);
+
+done:
+	LOCK(&rpz->rpzs->maint_lock);
+	trie_update(rpz->rpzs);
+	RWLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
+	rpz->rpzs->generation = atomic_fetch_add_relaxed(&rpz_generation, 1) +
+				1;
+	RWUNLOCK(&rpz->rpzs->search_lock, isc_rwlocktype_write);
+	rpz->serial = serial;
+	rpz->serialvalid = (result == ISC_R_SUCCESS && haveserial &&
+			    rpz->db == rpz->updb);
+	UNLOCK(&rpz->rpzs->maint_lock);
 
 shuttingdown:
 	rpz->updateresult = result;
@@ -2015,7 +2957,8 @@ dns__rpz_timer_cb(void *arg) {
 		      ISC_LOG_INFO, "rpz: %s: reload start", domain);
 
 	dns_rpz_zones_ref(rpz->rpzs);
-	isc_work_enqueue(rpz->loop, update_rpz_cb, update_rpz_done_cb, rpz);
+	isc_work_enqueueclass(rpz->loop, isc_workclass_bulk, update_rpz_cb,
+			      update_rpz_done_cb, rpz);
 
 	isc_timer_destroy(&rpz->updatetimer);
 	rpz->loop = NULL;
@@ -2118,7 +3061,11 @@ dns_rpz_zone_destroy(dns_rpz_zone_t **rpzp) {
 	}
 	INSIST(!rpz->updaterunning);
 
-	isc_ht_destroy(&rpz->nodes);
+	if (rpz->journal != NULL) {
+		isc_mem_free(rpzs->mctx, rpz->journal);
+	}
+
+	nodes_destroy(rpzs->mctx, &rpz->nodes);
 
 	isc_mem_put(rpzs->mctx, rpz, sizeof(*rpz));
 }
@@ -2147,6 +3094,12 @@ dns__rpz_zones_destroy(dns_rpz_zones_t *rpzs) {
 	if (rpzs->table != NULL) {
 		dns_qpmulti_destroy(&rpzs->table);
 	}
+	if (rpzs->filter != NULL) {
+		filter_destroy(rpzs->filter);
+	}
+	if (rpzs->trie != NULL) {
+		dns__rpz_trie_destroy(&rpzs->trie);
+	}
 
 	isc_mutex_destroy(&rpzs->maint_lock);
 	isc_rwlock_destroy(&rpzs->search_lock);
@@ -2261,6 +3214,7 @@ del_cidr(dns_rpz_zone_t *rpz, dns_rpz_type_t rpz_type,
 	set_sum_pair(tgt);
 
 	adj_trigger_cnt(rpz, rpz_type, &tgt_ip, tgt_prefix, false);
+	rpz->rpzs->cidrchanged = true;
 
 	/*
 	 * We might need to delete 2 nodes.
@@ -2402,11 +3356,13 @@ rpz_del(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 	case DNS_RPZ_TYPE_QNAME:
 	case DNS_RPZ_TYPE_NSDNAME:
 		del_name(rpz, rpz_type, src_name);
+		filter_deleted(rpzs);
 		break;
 	case DNS_RPZ_TYPE_CLIENT_IP:
 	case DNS_RPZ_TYPE_IP:
 	case DNS_RPZ_TYPE_NSIP:
 		del_cidr(rpz, rpz_type, src_name);
+		filter_deleted(rpzs);
 		break;
 	case DNS_RPZ_TYPE_BAD:
 		break;
@@ -2414,7 +3370,7 @@ rpz_del(dns_rpz_zone_t *rpz, const dns_name_t *src_name) {
 }
 
 /*
- * Search the summary radix tree to get a relative owner name in a
+ * Search the summary lookup trie to get a relative owner name in a
  * policy zone relevant to a triggering IP address.
  *	rpz_type and zbits limit the search for IP address netaddr
  *	return the policy zone's number or DNS_RPZ_INVALID_NUM
@@ -2425,9 +3381,9 @@ dns_rpz_num_t
 dns_rpz_find_ip(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 		dns_rpz_zbits_t zbits, const isc_netaddr_t *netaddr,
 		dns_name_t *ip_name, dns_rpz_prefix_t *prefixp) {
-	dns_rpz_cidr_key_t tgt_ip;
-	dns_rpz_addr_zbits_t tgt_set;
-	dns_rpz_cidr_node_t *found = NULL;
+	dns_rpz_cidr_key_t tgt_ip, found_ip;
+	dns_rpz_addr_zbits_t tgt_set, found_set;
+	dns_rpz_trie_t *trie = NULL;
 	isc_result_t result;
 	dns_rpz_num_t rpz_num = 0;
 	dns_rpz_have_t have;
@@ -2489,41 +3445,44 @@ dns_rpz_find_ip(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 		return (DNS_RPZ_INVALID_NUM);
 	}
 
-	if (zbits == 0) {
+	if (zbits == 0 || !filter_ip(rpzs, &tgt_ip)) {
 		return (DNS_RPZ_INVALID_NUM);
 	}
 	make_addr_set(&tgt_set, zbits, rpz_type);
 
-	RWLOCK(&rpzs->search_lock, isc_rwlocktype_read);
-	result = search(rpzs, &tgt_ip, 128, &tgt_set, false, &found);
-	if (result == ISC_R_NOTFOUND) {
+	rcu_read_lock();
+	trie = rcu_dereference(rpzs->trie);
+	if (trie == NULL ||
+	    dns__rpz_trie_find(trie, &tgt_ip, &tgt_set, &found_set, prefixp) !=
+		    ISC_R_SUCCESS)
+	{
 		/*
 		 * There are no eligible zones for this IP address.
 		 */
-		RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
+		rcu_read_unlock();
 		return (DNS_RPZ_INVALID_NUM);
 	}
+	rcu_read_unlock();
 
 	/*
 	 * Construct the trigger name for the longest matching trigger
 	 * in the first eligible zone with a match.
 	 */
-	*prefixp = found->prefix;
 	switch (rpz_type) {
 	case DNS_RPZ_TYPE_CLIENT_IP:
-		rpz_num = zbit_to_num(found->set.client_ip & tgt_set.client_ip);
+		rpz_num = zbit_to_num(found_set.client_ip);
 		break;
 	case DNS_RPZ_TYPE_IP:
-		rpz_num = zbit_to_num(found->set.ip & tgt_set.ip);
+		rpz_num = zbit_to_num(found_set.ip);
 		break;
 	case DNS_RPZ_TYPE_NSIP:
-		rpz_num = zbit_to_num(found->set.nsip & tgt_set.nsip);
+		rpz_num = zbit_to_num(found_set.nsip);
 		break;
 	default:
 		UNREACHABLE();
 	}
-	result = ip2name(&found->ip, found->prefix, dns_rootname, ip_name);
-	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
+	mask_key(&tgt_ip, *prefixp, &found_ip);
+	result = ip2name(&found_ip, *prefixp, dns_rootname, ip_name);
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * bin/tests/system/rpz/tests.sh looks for "rpz.*failed".
@@ -2552,7 +3511,7 @@ dns_rpz_find_name(dns_rpz_zones_t *rpzs, dns_rpz_type_t rpz_type,
 	dns_qpread_t qpr;
 	int i;
 
-	if (zbits == 0) {
+	if (zbits == 0 || !filter_name(rpzs, trig_name)) {
 		return (0);
 	}
 
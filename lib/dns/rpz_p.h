@@ -0,0 +1,100 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#pragma once
+
+/*! \file */
+
+#include <isc/lang.h>
+#include <isc/mem.h>
+#include <isc/result.h>
+
+#include <dns/rpz.h>
+
+/*%
+ *     Types and functions below not be used outside this module and its
+ *     associated unit tests and benchmarks.
+ */
+
+ISC_LANG_BEGINDECLS
+
+/*
+ * Use a private definition of IPv6 addresses because s6_addr32 is not
+ * always defined and our IPv6 addresses are in non-standard byte order
+ */
+typedef uint32_t dns_rpz_cidr_word_t;
+#define DNS_RPZ_CIDR_WORD_BITS ((int)sizeof(dns_rpz_cidr_word_t) * 8)
+#define DNS_RPZ_CIDR_KEY_BITS  ((int)sizeof(dns_rpz_cidr_key_t) * 8)
+#define DNS_RPZ_CIDR_WORDS     (128 / DNS_RPZ_CIDR_WORD_BITS)
+typedef struct {
+	dns_rpz_cidr_word_t w[DNS_RPZ_CIDR_WORDS];
+} dns_rpz_cidr_key_t;
+
+/*
+ * A triplet of arrays of bits flagging the existence of
+ * client-IP, IP, and NSIP policy triggers.
+ */
+typedef struct dns_rpz_addr_zbits dns_rpz_addr_zbits_t;
+struct dns_rpz_addr_zbits {
+	dns_rpz_zbits_t client_ip;
+	dns_rpz_zbits_t ip;
+	dns_rpz_zbits_t nsip;
+};
+
+/*
+ * An IP address trigger to be loaded into a multibit trie: the address
+ * masked to 'prefix' bits, and the policy zones that have it.
+ */
+typedef struct dns_rpz_trieentry {
+	dns_rpz_cidr_key_t   ip;
+	dns_rpz_prefix_t     prefix;
+	dns_rpz_addr_zbits_t set;
+} dns_rpz_trieentry_t;
+
+typedef struct dns_rpz_trie dns_rpz_trie_t;
+
+void
+dns__rpz_trie_create(isc_mem_t *mctx, const dns_rpz_trieentry_t *entries,
+		     size_t count, dns_rpz_trie_t **triep);
+/*%<
+ * Build a read-only multibit trie holding 'count' IP address triggers.
+ *
+ * Requires:
+ *\li	'entries' are sorted by address and then by prefix length, with
+ *	no two entries having the same address and prefix length.
+ *\li	'triep' is not NULL and '*triep' is NULL.
+ */
+
+void
+dns__rpz_trie_destroy(dns_rpz_trie_t **triep);
+/*%<
+ * Free a trie created by dns__rpz_trie_create().
+ */
+
+isc_result_t
+dns__rpz_trie_find(const dns_rpz_trie_t *trie, const dns_rpz_cidr_key_t *ip,
+		   const dns_rpz_addr_zbits_t *tgt_set,
+		   dns_rpz_addr_zbits_t *found_set, dns_rpz_prefix_t *prefixp);
+/*%<
+ * Find the policy zone with the lowest number that has a trigger
+ * covering 'ip' among the zones in 'tgt_set', and that zone's longest
+ * such trigger.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS, with the prefix length of the trigger in
+ *	'*prefixp', and in '*found_set' the zones of 'tgt_set' that have
+ *	the trigger and no lower numbered match.
+ *\li	#ISC_R_NOTFOUND
+ */
+
+ISC_LANG_ENDDECLS
@@ -54,11 +54,16 @@
 
 #include <isc/ascii.h>
 #include <isc/buffer.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
 #include <isc/lex.h>
 #include <isc/log.h>
+#include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/netaddr.h>
 #include <isc/once.h>
+#include <isc/refcount.h>
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/rwlock.h>
@@ -84,6 +89,9 @@
  * Private Types
  */
 
+typedef struct sdlz_cache sdlz_cache_t;
+typedef struct sdlz_cacheentry sdlz_cacheentry_t;
+
 struct dns_sdlzimplementation {
 	const dns_sdlzmethods_t *methods;
 	isc_mem_t *mctx;
@@ -91,13 +99,52 @@ struct dns_sdlzimplementation {
 	unsigned int flags;
 	isc_mutex_t driverlock;
 	dns_dlzimplementation_t *dlz_imp;
+
+	/* Lookup caches of the databases using this driver */
+	isc_rwlock_t cachelock;
+	ISC_LIST(sdlz_cache_t) caches;
 };
 
+/*
+ * A cache of driver lookup results for one DLZ database.  Each entry
+ * holds what a lookup for a zone, name and client put into the node,
+ * in wire format, or a negative answer.
+ */
+struct sdlz_cacheentry {
+	isc_region_t key;
+	uint32_t hashval;
+	isc_stdtime_t expire;
+	isc_result_t result;
+	isc_region_t data;
+	size_t size;
+	ISC_LINK(sdlz_cacheentry_t) link;
+};
+
+struct sdlz_cache {
+	isc_mem_t *mctx;
+	void *dbdata;
+	isc_refcount_t references;
+	unsigned int size;
+	dns_ttl_t maxttl;
+	dns_ttl_t maxncachettl;
+	ISC_LINK(sdlz_cache_t) link;
+
+	/* Locked by lock */
+	isc_rwlock_t lock;
+	isc_hashmap_t *table;
+	ISC_LIST(sdlz_cacheentry_t) entries; /* oldest first */
+	unsigned int count;
+};
+
+/* Zone origin, name, wildcard flag, client address and ECS option */
+#define SDLZ_CACHE_KEYSIZE (2 * (DNS_NAME_MAXWIRE + 1) + 1 + 2 * 17 + 1)
+
 struct dns_sdlz_db {
 	/* Unlocked */
 	dns_db_t common;
 	void *dbdata;
 	dns_sdlzimplementation_t *dlzimp;
+	sdlz_cache_t *cache;
 
 	/* Locked */
 	dns_dbversion_t *future_version;
@@ -218,6 +265,294 @@ static dns_dbiteratormethods_t dbiterator_methods = {
 	dbiterator_current, dbiterator_pause, dbiterator_origin
 };
 
+/*
+ * Lookup cache
+ */
+
+static bool
+cache_match(void *node, const void *key) {
+	const sdlz_cacheentry_t *entry = node;
+	const isc_region_t *region = key;
+
+	return (entry->key.length == region->length &&
+		memcmp(entry->key.base, region->base, region->length) == 0);
+}
+
+static void
+cache_putname(isc_buffer_t *b, const dns_name_t *name) {
+	dns_fixedname_t fixed;
+	dns_name_t *lname = dns_fixedname_initname(&fixed);
+	isc_region_t r;
+
+	dns_name_downcase(name, lname, NULL);
+	dns_name_toregion(lname, &r);
+	isc_buffer_putuint8(b, r.length);
+	isc_buffer_putmem(b, r.base, r.length);
+}
+
+static void
+cache_putaddr(isc_buffer_t *b, const isc_netaddr_t *addr) {
+	switch (addr->family) {
+	case AF_INET:
+		isc_buffer_putuint8(b, 4);
+		isc_buffer_putmem(b, (const unsigned char *)&addr->type.in, 4);
+		break;
+	case AF_INET6:
+		isc_buffer_putuint8(b, 16);
+		isc_buffer_putmem(b, (const unsigned char *)&addr->type.in6,
+				  16);
+		break;
+	default:
+		isc_buffer_putuint8(b, 0);
+		break;
+	}
+}
+
+/*
+ * Build the cache key for a lookup of 'name'.  Drivers may answer
+ * differently depending on the client, so its address and ECS option
+ * are part of the key.
+ */
+static void
+cache_key(dns_sdlz_db_t *sdlz, const dns_name_t *name, unsigned int options,
+	  dns_clientinfomethods_t *methods, dns_clientinfo_t *clientinfo,
+	  isc_buffer_t *b) {
+	isc_sockaddr_t *src = NULL;
+	isc_netaddr_t netaddr;
+
+	cache_putname(b, &sdlz->common.origin);
+	cache_putname(b, name);
+	isc_buffer_putuint8(b, (options & DNS_DBFIND_NOWILD) != 0);
+
+	if (methods != NULL && methods->sourceip != NULL &&
+	    methods->sourceip(clientinfo, &src) == ISC_R_SUCCESS)
+	{
+		isc_netaddr_fromsockaddr(&netaddr, src);
+		cache_putaddr(b, &netaddr);
+	} else {
+		isc_buffer_putuint8(b, 0);
+	}
+
+	if (clientinfo->ecs.source != 0) {
+		cache_putaddr(b, &clientinfo->ecs.addr);
+		isc_buffer_putuint8(b, clientinfo->ecs.source);
+	} else {
+		isc_buffer_putuint8(b, 0);
+	}
+}
+
+static void
+cache_unlink(sdlz_cache_t *cache, sdlz_cacheentry_t *entry) {
+	isc_result_t result;
+
+	result = isc_hashmap_delete(cache->table, entry->hashval, cache_match,
+				    &entry->key);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_UNLINK(cache->entries, entry, link);
+	cache->count--;
+	isc_mem_put(cache->mctx, entry, entry->size);
+}
+
+static void
+cache_flush(sdlz_cache_t *cache) {
+	RWLOCK(&cache->lock, isc_rwlocktype_write);
+	while (!ISC_LIST_EMPTY(cache->entries)) {
+		cache_unlink(cache, ISC_LIST_HEAD(cache->entries));
+	}
+	RWUNLOCK(&cache->lock, isc_rwlocktype_write);
+}
+
+static void
+cache_attach(sdlz_cache_t *source, sdlz_cache_t **targetp) {
+	isc_refcount_increment(&source->references);
+	*targetp = source;
+}
+
+static void
+cache_detach(sdlz_cache_t **cachep) {
+	sdlz_cache_t *cache = *cachep;
+
+	*cachep = NULL;
+
+	if (isc_refcount_decrement(&cache->references) == 1) {
+		isc_refcount_destroy(&cache->references);
+		cache_flush(cache);
+		isc_hashmap_destroy(&cache->table);
+		isc_rwlock_destroy(&cache->lock);
+		isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+	}
+}
+
+/*
+ * Look for a live entry matching 'key'.  On a hit, return true with
+ * the cached result in '*resultp', and fill 'node' with the cached
+ * rdatasets.
+ */
+static bool
+cache_get(sdlz_cache_t *cache, const isc_region_t *key, uint32_t hashval,
+	  isc_stdtime_t now, dns_sdlznode_t *node, isc_result_t *resultp) {
+	isc_mem_t *mctx = node->sdlz->common.mctx;
+	sdlz_cacheentry_t *entry = NULL;
+	isc_buffer_t *b = NULL;
+	bool found = false;
+
+	RWLOCK(&cache->lock, isc_rwlocktype_read);
+	if (isc_hashmap_find(cache->table, hashval, cache_match, key,
+			     (void **)&entry) == ISC_R_SUCCESS &&
+	    entry->expire > now)
+	{
+		found = true;
+		*resultp = entry->result;
+		if (entry->data.length > 0) {
+			isc_buffer_allocate(mctx, &b, entry->data.length);
+			isc_buffer_putmem(b, entry->data.base,
+					  entry->data.length);
+		}
+	}
+	RWUNLOCK(&cache->lock, isc_rwlocktype_read);
+
+	if (b == NULL) {
+		return (found);
+	}
+
+	ISC_LIST_APPEND(node->buffers, b, link);
+	while (isc_buffer_remaininglength(b) > 0) {
+		dns_rdatalist_t *rdatalist = NULL;
+		unsigned int count;
+
+		rdatalist = isc_mem_get(mctx, sizeof(*rdatalist));
+		dns_rdatalist_init(rdatalist);
+		rdatalist->rdclass = node->sdlz->common.rdclass;
+		rdatalist->type = isc_buffer_getuint16(b);
+		rdatalist->ttl = isc_buffer_getuint32(b);
+		count = isc_buffer_getuint16(b);
+		ISC_LIST_APPEND(node->lists, rdatalist, link);
+
+		while (count-- > 0) {
+			dns_rdata_t *rdata = NULL;
+			isc_region_t r;
+
+			r.length = isc_buffer_getuint16(b);
+			r.base = isc_buffer_current(b);
+			isc_buffer_forward(b, r.length);
+
+			rdata = isc_mem_get(mctx, sizeof(*rdata));
+			dns_rdata_init(rdata);
+			dns_rdata_fromregion(rdata, rdatalist->rdclass,
+					     rdatalist->type, &r);
+			ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+		}
+	}
+
+	return (found);
+}
+
+/*
+ * Store what a driver lookup produced: the rdatasets in 'node', or a
+ * negative answer if 'node' is NULL.  Positive entries live no longer
+ * than the lowest TTL among them.
+ */
+static void
+cache_put(sdlz_cache_t *cache, const isc_region_t *key, uint32_t hashval,
+	  isc_stdtime_t now, dns_sdlznode_t *node) {
+	sdlz_cacheentry_t *entry = NULL, *old = NULL;
+	dns_rdatalist_t *rdatalist = NULL;
+	dns_rdata_t *rdata = NULL;
+	dns_ttl_t ttl = cache->maxncachettl;
+	unsigned int datalen = 0;
+	isc_buffer_t b;
+	isc_result_t result;
+
+	if (node != NULL) {
+		ttl = cache->maxttl;
+		for (rdatalist = ISC_LIST_HEAD(node->lists); rdatalist != NULL;
+		     rdatalist = ISC_LIST_NEXT(rdatalist, link))
+		{
+			ttl = ISC_MIN(ttl, rdatalist->ttl);
+			datalen += 8;
+			for (rdata = ISC_LIST_HEAD(rdatalist->rdata);
+			     rdata != NULL; rdata = ISC_LIST_NEXT(rdata, link))
+			{
+				datalen += 2 + rdata->length;
+			}
+		}
+	}
+
+	if (ttl == 0) {
+		return;
+	}
+
+	entry = isc_mem_get(cache->mctx,
+			    sizeof(*entry) + key->length + datalen);
+	*entry = (sdlz_cacheentry_t){
+		.key = { (unsigned char *)(entry + 1), key->length },
+		.hashval = hashval,
+		.expire = now + ttl,
+		.result = (node != NULL) ? ISC_R_SUCCESS : ISC_R_NOTFOUND,
+		.size = sizeof(*entry) + key->length + datalen,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	entry->data = (isc_region_t){ entry->key.base + key->length, datalen };
+	memmove(entry->key.base, key->base, key->length);
+
+	isc_buffer_init(&b, entry->data.base, datalen);
+	for (rdatalist = (node != NULL) ? ISC_LIST_HEAD(node->lists) : NULL;
+	     rdatalist != NULL; rdatalist = ISC_LIST_NEXT(rdatalist, link))
+	{
+		unsigned int count = 0;
+
+		for (rdata = ISC_LIST_HEAD(rdatalist->rdata); rdata != NULL;
+		     rdata = ISC_LIST_NEXT(rdata, link))
+		{
+			count++;
+		}
+
+		isc_buffer_putuint16(&b, rdatalist->type);
+		isc_buffer_putuint32(&b, rdatalist->ttl);
+		isc_buffer_putuint16(&b, count);
+		for (rdata = ISC_LIST_HEAD(rdatalist->rdata); rdata != NULL;
+		     rdata = ISC_LIST_NEXT(rdata, link))
+		{
+			isc_buffer_putuint16(&b, rdata->length);
+			isc_buffer_putmem(&b, rdata->data, rdata->length);
+		}
+	}
+
+	RWLOCK(&cache->lock, isc_rwlocktype_write);
+	if (isc_hashmap_find(cache->table, hashval, cache_match, key,
+			     (void **)&old) == ISC_R_SUCCESS)
+	{
+		cache_unlink(cache, old);
+	}
+	while (cache->count >= cache->size) {
+		cache_unlink(cache, ISC_LIST_HEAD(cache->entries));
+	}
+	result = isc_hashmap_add(cache->table, hashval, cache_match,
+				 &entry->key, entry, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_APPEND(cache->entries, entry, link);
+	cache->count++;
+	RWUNLOCK(&cache->lock, isc_rwlocktype_write);
+}
+
+/*
+ * Find the cache configured for the driver instance 'dbdata', if any.
+ */
+static void
+cache_find(dns_sdlzimplementation_t *imp, void *dbdata,
+	   sdlz_cache_t **cachep) {
+	RWLOCK(&imp->cachelock, isc_rwlocktype_read);
+	for (sdlz_cache_t *cache = ISC_LIST_HEAD(imp->caches); cache != NULL;
+	     cache = ISC_LIST_NEXT(cache, link))
+	{
+		if (cache->dbdata == dbdata) {
+			cache_attach(cache, cachep);
+			break;
+		}
+	}
+	RWUNLOCK(&imp->cachelock, isc_rwlocktype_read);
+}
+
 /*
  * Utility functions
  */
@@ -306,6 +641,10 @@ destroy(dns_db_t *db) {
 	sdlz->common.magic = 0;
 	sdlz->common.impmagic = 0;
 
+	if (sdlz->cache != NULL) {
+		cache_detach(&sdlz->cache);
+	}
+
 	dns_name_free(&sdlz->common.origin, sdlz->common.mctx);
 
 	isc_refcount_destroy(&sdlz->common.references);
@@ -387,6 +726,14 @@ closeversion(dns_db_t *db, dns_dbversion_t **versionp,
 			 origin);
 	}
 
+	/*
+	 * The update may have changed anything in the zone; start over
+	 * rather than serve cached answers that predate it.
+	 */
+	if (commit && sdlz->cache != NULL) {
+		cache_flush(sdlz->cache);
+	}
+
 	sdlz->future_version = NULL;
 }
 
@@ -466,6 +813,12 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	char zonestr[DNS_NAME_MAXTEXT + 1];
 	bool isorigin;
 	dns_sdlzauthorityfunc_t authority;
+	unsigned char keybuf[SDLZ_CACHE_KEYSIZE];
+	isc_buffer_t keyb;
+	isc_region_t key;
+	uint32_t hashval = 0;
+	isc_stdtime_t now = 0;
+	bool usecache = false;
 
 	REQUIRE(VALID_SDLZDB(sdlz));
 	REQUIRE(nodep != NULL && *nodep == NULL);
@@ -474,6 +827,21 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 		REQUIRE(!create);
 	}
 
+	/*
+	 * Only plain queries are answered from the cache; lookups made
+	 * on behalf of an update, or to create a node, go to the driver.
+	 */
+	if (sdlz->cache != NULL && !create && clientinfo != NULL &&
+	    clientinfo->dbversion == NULL)
+	{
+		isc_buffer_init(&keyb, keybuf, sizeof(keybuf));
+		cache_key(sdlz, name, options, methods, clientinfo, &keyb);
+		isc_buffer_usedregion(&keyb, &key);
+		hashval = isc_hash32(key.base, key.length, true);
+		now = isc_loop_stdtime();
+		usecache = true;
+	}
+
 	isc_buffer_init(&b, namestr, sizeof(namestr));
 	if ((sdlz->dlzimp->flags & DNS_SDLZFLAG_RELATIVEOWNER) != 0) {
 		dns_name_t relname;
@@ -508,6 +876,17 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 		return (result);
 	}
 
+	if (usecache &&
+	    cache_get(sdlz->cache, &key, hashval, now, node, &result))
+	{
+		if (result != ISC_R_SUCCESS) {
+			isc_refcount_decrementz(&node->references);
+			destroynode(node);
+			return (result);
+		}
+		goto found;
+	}
+
 	isorigin = dns_name_equal(name, &sdlz->common.origin);
 
 	/* make sure strings are always lowercase */
@@ -583,6 +962,9 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 	}
 
 	if (result != ISC_R_SUCCESS) {
+		if (usecache && result == ISC_R_NOTFOUND) {
+			cache_put(sdlz->cache, &key, hashval, now, NULL);
+		}
 		isc_refcount_decrementz(&node->references);
 		destroynode(node);
 		return (result);
@@ -601,6 +983,11 @@ getnodedata(dns_db_t *db, const dns_name_t *name, bool create,
 		}
 	}
 
+	if (usecache) {
+		cache_put(sdlz->cache, &key, hashval, now, node);
+	}
+
+found:
 	if (node->name == NULL) {
 		node->name = isc_mem_get(sdlz->common.mctx, sizeof(dns_name_t));
 		dns_name_init(node->name, NULL);
@@ -1389,6 +1776,9 @@ dns_sdlzcreateDBP(isc_mem_t *mctx, void *driverarg, void *dbdata,
 	/* attach to the memory context */
 	isc_mem_attach(mctx, &sdlzdb->common.mctx);
 
+	/* use the lookup cache of this driver instance, if it has one */
+	cache_find(imp, dbdata, &sdlzdb->cache);
+
 	/* mark structure as valid */
 	sdlzdb->common.magic = DNS_DB_MAGIC;
 	sdlzdb->common.impmagic = SDLZDB_MAGIC;
@@ -1516,6 +1906,19 @@ dns_sdlzdestroy(void *driverdata, void **dbdata) {
 
 	imp = driverdata;
 
+	/* Drop the lookup cache of this driver instance. */
+	RWLOCK(&imp->cachelock, isc_rwlocktype_write);
+	for (sdlz_cache_t *cache = ISC_LIST_HEAD(imp->caches); cache != NULL;
+	     cache = ISC_LIST_NEXT(cache, link))
+	{
+		if (cache->dbdata == (void *)dbdata) {
+			ISC_LIST_UNLINK(imp->caches, cache, link);
+			cache_detach(&cache);
+			break;
+		}
+	}
+	RWUNLOCK(&imp->cachelock, isc_rwlocktype_write);
+
 	/* If the destroy method exists, call it. */
 	if (imp->methods->destroy != NULL) {
 		MAYBE_LOCK(imp);
@@ -1901,6 +2304,8 @@ dns_sdlzregister(const char *drivername, const dns_sdlzmethods_t *methods,
 	 * (used if a driver does not support multiple threads)
 	 */
 	isc_mutex_init(&imp->driverlock);
+	isc_rwlock_init(&imp->cachelock);
+	ISC_LIST_INIT(imp->caches);
 
 	/*
 	 * register the DLZ driver.  Pass in our "extra" sdlz information as
@@ -1923,6 +2328,7 @@ dns_sdlzregister(const char *drivername, const dns_sdlzmethods_t *methods,
 cleanup_mutex:
 	/* destroy the driver lock, we don't need it anymore */
 	isc_mutex_destroy(&imp->driverlock);
+	isc_rwlock_destroy(&imp->cachelock);
 
 	/*
 	 * return the memory back to the available memory pool and
@@ -1952,6 +2358,12 @@ dns_sdlzunregister(dns_sdlzimplementation_t **sdlzimp) {
 
 	/* destroy the driver lock, we don't need it anymore */
 	isc_mutex_destroy(&imp->driverlock);
+	while (!ISC_LIST_EMPTY(imp->caches)) {
+		sdlz_cache_t *cache = ISC_LIST_HEAD(imp->caches);
+		ISC_LIST_UNLINK(imp->caches, cache, link);
+		cache_detach(&cache);
+	}
+	isc_rwlock_destroy(&imp->cachelock);
 
 	/*
 	 * return the memory back to the available memory pool and
@@ -1970,3 +2382,41 @@ dns_sdlz_setdb(dns_dlzdb_t *dlzdatabase, dns_rdataclass_t rdclass,
 				   dlzdatabase->dbdata, name, rdclass, dbp);
 	return (result);
 }
+
+void
+dns_sdlz_setcache(dns_dlzdb_t *dlzdatabase, unsigned int size,
+		  dns_ttl_t maxttl, dns_ttl_t maxncachettl) {
+	dns_sdlzimplementation_t *imp = NULL;
+	sdlz_cache_t *cache = NULL;
+	uint8_t bits = 1;
+
+	REQUIRE(DNS_DLZ_VALID(dlzdatabase));
+
+	if (size == 0) {
+		return;
+	}
+
+	imp = dlzdatabase->implementation->driverarg;
+
+	while (bits < 16 && (1U << bits) < size) {
+		bits++;
+	}
+
+	cache = isc_mem_get(dlzdatabase->mctx, sizeof(*cache));
+	*cache = (sdlz_cache_t){
+		.dbdata = dlzdatabase->dbdata,
+		.size = size,
+		.maxttl = maxttl,
+		.maxncachettl = maxncachettl,
+		.entries = ISC_LIST_INITIALIZER,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	isc_mem_attach(dlzdatabase->mctx, &cache->mctx);
+	isc_refcount_init(&cache->references, 1);
+	isc_rwlock_init(&cache->lock);
+	isc_hashmap_create(cache->mctx, bits, &cache->table);
+
+	RWLOCK(&imp->cachelock, isc_rwlocktype_write);
+	ISC_LIST_APPEND(imp->caches, cache, link);
+	RWUNLOCK(&imp->cachelock, isc_rwlocktype_write);
+}
@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*! \file */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include <isc/hashmap.h>
+#include <isc/list.h>
+#include <isc/magic.h>
+#include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/sigcache.h>
+#include <dns/types.h>
+
+typedef struct dns_scentry dns_scentry_t;
+
+struct dns_scentry {
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t expire;
+	ISC_LINK(dns_scentry_t) link;
+};
+
+struct dns_sigcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_mutex_t lock;
+
+	/* Locked by 'lock'. */
+	isc_hashmap_t *hashmap;
+	ISC_LIST(dns_scentry_t) lru;
+	unsigned int count;
+	unsigned int size;
+};
+
+#define SIGCACHE_MAGIC	  ISC_MAGIC('S', 'g', 'C', 'a')
+#define VALID_SIGCACHE(m) ISC_MAGIC_VALID(m, SIGCACHE_MAGIC)
+
+#define SIGCACHE_HASHBITS 12
+
+static bool
+scentry_match(void *node, const void *key) {
+	dns_scentry_t *entry = node;
+
+	return (memcmp(entry->digest, key, sizeof(entry->digest)) == 0);
+}
+
+/*
+ * The digests are already uniformly distributed, so their leading
+ * bytes serve as the hash value.
+ */
+static uint32_t
+scentry_hash(const unsigned char *digest) {
+	return ((uint32_t)digest[0] << 24 | (uint32_t)digest[1] << 16 |
+		(uint32_t)digest[2] << 8 | (uint32_t)digest[3]);
+}
+
+static void
+scentry_destroy(dns_sigcache_t *sc, dns_scentry_t *entry) {
+	isc_result_t result;
+
+	result = isc_hashmap_delete(sc->hashmap, scentry_hash(entry->digest),
+				    scentry_match, entry->digest);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_UNLINK(sc->lru, entry, link);
+	INSIST(sc->count > 0);
+	sc->count--;
+
+	isc_mem_put(sc->mctx, entry, sizeof(*entry));
+}
+
+dns_sigcache_t *
+dns_sigcache_new(isc_mem_t *mctx, unsigned int size) {
+	REQUIRE(mctx != NULL);
+	REQUIRE(size > 0);
+
+	dns_sigcache_t *sc = isc_mem_get(mctx, sizeof(*sc));
+	*sc = (dns_sigcache_t){
+		.magic = SIGCACHE_MAGIC,
+		.size = size,
+		.lru = ISC_LIST_INITIALIZER,
+	};
+
+	isc_mem_attach(mctx, &sc->mctx);
+	isc_mutex_init(&sc->lock);
+	isc_hashmap_create(sc->mctx, SIGCACHE_HASHBITS, &sc->hashmap);
+
+	return (sc);
+}
+
+void
+dns_sigcache_destroy(dns_sigcache_t **scp) {
+	dns_sigcache_t *sc = NULL;
+
+	REQUIRE(scp != NULL && VALID_SIGCACHE(*scp));
+
+	sc = *scp;
+	*scp = NULL;
+
+	dns_sigcache_flush(sc);
+
+	sc->magic = 0;
+	isc_hashmap_destroy(&sc->hashmap);
+	isc_mutex_destroy(&sc->lock);
+	isc_mem_putanddetach(&sc->mctx, sc, sizeof(*sc));
+}
+
+void
+dns_sigcache_add(dns_sigcache_t *sc, const unsigned char *digest,
+		 isc_stdtime_t expire) {
+	isc_result_t result;
+	dns_scentry_t *entry = NULL;
+	uint32_t hashval;
+
+	REQUIRE(VALID_SIGCACHE(sc));
+	REQUIRE(digest != NULL);
+
+	hashval = scentry_hash(digest);
+
+	LOCK(&sc->lock);
+	result = isc_hashmap_find(sc->hashmap, hashval, scentry_match, digest,
+				  (void **)&entry);
+	if (result == ISC_R_SUCCESS) {
+		entry->expire = expire;
+		ISC_LIST_UNLINK(sc->lru, entry, link);
+		ISC_LIST_PREPEND(sc->lru, entry, link);
+		goto unlock;
+	}
+
+	if (sc->count >= sc->size) {
+		scentry_destroy(sc, ISC_LIST_TAIL(sc->lru));
+	}
+
+	entry = isc_mem_get(sc->mctx, sizeof(*entry));
+	*entry = (dns_scentry_t){
+		.expire = expire,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	memmove(entry->digest, digest, sizeof(entry->digest));
+
+	result = isc_hashmap_add(sc->hashmap, hashval, scentry_match,
+				 entry->digest, entry, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+	ISC_LIST_PREPEND(sc->lru, entry, link);
+	sc->count++;
+
+unlock:
+	UNLOCK(&sc->lock);
+}
+
+bool
+dns_sigcache_find(dns_sigcache_t *sc, const unsigned char *digest,
+		  isc_stdtime_t now) {
+	isc_result_t result;
+	dns_scentry_t *entry = NULL;
+	bool found = false;
+
+	REQUIRE(VALID_SIGCACHE(sc));
+	REQUIRE(digest != NULL);
+
+	LOCK(&sc->lock);
+	result = isc_hashmap_find(sc->hashmap, scentry_hash(digest),
+				  scentry_match, digest, (void **)&entry);
+	if (result != ISC_R_SUCCESS) {
+		goto unlock;
+	}
+
+	if (entry->expire <= now) {
+		scentry_destroy(sc, entry);
+		goto unlock;
+	}
+
+	if (entry != ISC_LIST_HEAD(sc->lru)) {
+		ISC_LIST_UNLINK(sc->lru, entry, link);
+		ISC_LIST_PREPEND(sc->lru, entry, link);
+	}
+	found = true;
+
+unlock:
+	UNLOCK(&sc->lock);
+
+	return (found);
+}
+
+void
+dns_sigcache_flush(dns_sigcache_t *sc) {
+	REQUIRE(VALID_SIGCACHE(sc));
+
+	LOCK(&sc->lock);
+	while (!ISC_LIST_EMPTY(sc->lru)) {
+		scentry_destroy(sc, ISC_LIST_HEAD(sc->lru));
+	}
+	UNLOCK(&sc->lock);
+}
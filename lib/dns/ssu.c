@@ -15,6 +15,7 @@
 
 #include <stdbool.h>
 
+#include <isc/hashmap.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netaddr.h>
@@ -47,7 +48,19 @@ struct dns_ssurule {
 	dns_ssuruletype_t *types;     /*%< the data types.  Can include */
 				      /*   ANY. if NULL, defaults to all */
 				      /*   types except SIG, SOA, and NS */
+	unsigned int order;	      /*%< position in the table */
 	ISC_LINK(dns_ssurule_t) link;
+	ISC_LINK(dns_ssurule_t) idlink; /*%< identity or unindexed list */
+};
+
+/*%
+ * The rules whose identity must equal the signer, for one identity.
+ */
+typedef struct ssu_identity ssu_identity_t;
+struct ssu_identity {
+	const dns_name_t *name;
+	ISC_LIST(dns_ssurule_t) rules;
+	ISC_LINK(ssu_identity_t) link;
 };
 
 struct dns_ssutable {
@@ -56,6 +69,18 @@ struct dns_ssutable {
 	isc_refcount_t references;
 	dns_dlzdb_t *dlzdatabase;
 	ISC_LIST(dns_ssurule_t) rules;
+
+	/*
+	 * Rules that only apply to one literal signer are indexed by that
+	 * identity; all the others are kept in 'unindexed'.  Both lists
+	 * are in table order, so merging the signer's list with
+	 * 'unindexed' by 'order' visits the applicable rules in the same
+	 * order as a scan of 'rules' would.
+	 */
+	unsigned int nrules;
+	isc_hashmap_t *identities;
+	ISC_LIST(ssu_identity_t) idlist;
+	ISC_LIST(dns_ssurule_t) unindexed;
 };
 
 void
@@ -66,10 +91,14 @@ dns_ssutable_create(isc_mem_t *mctx, dns_ssutable_t **tablep) {
 	REQUIRE(mctx != NULL);
 
 	table = isc_mem_get(mctx, sizeof(*table));
+	*table = (dns_ssutable_t){
+		.rules = ISC_LIST_INITIALIZER,
+		.idlist = ISC_LIST_INITIALIZER,
+		.unindexed = ISC_LIST_INITIALIZER,
+	};
 	isc_refcount_init(&table->references, 1);
-	table->mctx = NULL;
 	isc_mem_attach(mctx, &table->mctx);
-	ISC_LIST_INIT(table->rules);
+	isc_hashmap_create(mctx, 4, &table->identities);
 	table->magic = SSUTABLEMAGIC;
 	*tablep = table;
 }
@@ -100,6 +129,12 @@ destroy(dns_ssutable_t *table) {
 		rule->magic = 0;
 		isc_mem_put(mctx, rule, sizeof(dns_ssurule_t));
 	}
+	while (!ISC_LIST_EMPTY(table->idlist)) {
+		ssu_identity_t *id = ISC_LIST_HEAD(table->idlist);
+		ISC_LIST_UNLINK(table->idlist, id, link);
+		isc_mem_put(mctx, id, sizeof(*id));
+	}
+	isc_hashmap_destroy(&table->identities);
 	isc_refcount_destroy(&table->references);
 	table->magic = 0;
 	isc_mem_putanddetach(&table->mctx, table, sizeof(dns_ssutable_t));
@@ -129,6 +164,66 @@ dns_ssutable_detach(dns_ssutable_t **tablep) {
 	}
 }
 
+static bool
+identity_match(void *node, const void *key) {
+	const ssu_identity_t *id = node;
+
+	return (dns_name_equal(id->name, key));
+}
+
+/*
+ * Rules of these types can only match a signer equal to their
+ * identity, if the identity is not a wildcard.
+ */
+static bool
+indexable(const dns_ssurule_t *rule) {
+	switch (rule->matchtype) {
+	case dns_ssumatchtype_local:
+	case dns_ssumatchtype_name:
+	case dns_ssumatchtype_self:
+	case dns_ssumatchtype_selfsub:
+	case dns_ssumatchtype_selfwild:
+	case dns_ssumatchtype_subdomain:
+	case dns_ssumatchtype_wildcard:
+		return (!dns_name_iswildcard(rule->identity));
+	default:
+		return (false);
+	}
+}
+
+static void
+appendrule(dns_ssutable_t *table, dns_ssurule_t *rule) {
+	ssu_identity_t *id = NULL;
+	isc_result_t result;
+	uint32_t hashval;
+
+	rule->order = table->nrules++;
+	ISC_LINK_INIT(rule, idlink);
+	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+
+	if (!indexable(rule)) {
+		ISC_LIST_APPEND(table->unindexed, rule, idlink);
+		return;
+	}
+
+	hashval = dns_name_hash(rule->identity);
+	result = isc_hashmap_find(table->identities, hashval, identity_match,
+				  rule->identity, (void **)&id);
+	if (result != ISC_R_SUCCESS) {
+		id = isc_mem_get(table->mctx, sizeof(*id));
+		*id = (ssu_identity_t){
+			.name = rule->identity,
+			.rules = ISC_LIST_INITIALIZER,
+			.link = ISC_LINK_INITIALIZER,
+		};
+		result = isc_hashmap_add(table->identities, hashval,
+					 identity_match, id->name, id, NULL);
+		INSIST(result == ISC_R_SUCCESS);
+		ISC_LIST_APPEND(table->idlist, id, link);
+	}
+	ISC_LIST_APPEND(id->rules, rule, idlink);
+}
+
 void
 dns_ssutable_addrule(dns_ssutable_t *table, bool grant,
 		     const dns_name_t *identity, dns_ssumatchtype_t matchtype,
@@ -176,7 +271,7 @@ dns_ssutable_addrule(dns_ssutable_t *table, bool grant,
 	}
 
 	rule->magic = SSURULEMAGIC;
-	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+	appendrule(table, rule);
 }
 
 static bool
@@ -285,7 +380,8 @@ dns_ssutable_checkrules(dns_ssutable_t *table, const dns_name_t *signer,
 	dns_name_t *stfself;
 	dns_name_t *tcpself;
 	dns_name_t *wildcard;
-	dns_ssurule_t *rule;
+	dns_ssurule_t *rule, *idrule = NULL, *other = NULL;
+	ssu_identity_t *id = NULL;
 	const dns_name_t *tname;
 	int match;
 	isc_result_t result;
@@ -300,9 +396,26 @@ dns_ssutable_checkrules(dns_ssutable_t *table, const dns_name_t *signer,
 		return (false);
 	}
 
-	for (rule = ISC_LIST_HEAD(table->rules); rule != NULL;
-	     rule = ISC_LIST_NEXT(rule, link))
+	if (signer != NULL &&
+	    isc_hashmap_find(table->identities, dns_name_hash(signer),
+			     identity_match, signer,
+			     (void **)&id) == ISC_R_SUCCESS)
 	{
+		idrule = ISC_LIST_HEAD(id->rules);
+	}
+	other = ISC_LIST_HEAD(table->unindexed);
+
+	while (idrule != NULL || other != NULL) {
+		if (other == NULL ||
+		    (idrule != NULL && idrule->order < other->order))
+		{
+			rule = idrule;
+			idrule = ISC_LIST_NEXT(idrule, idlink);
+		} else {
+			rule = other;
+			other = ISC_LIST_NEXT(other, idlink);
+		}
+
 		switch (rule->matchtype) {
 		case dns_ssumatchtype_local:
 		case dns_ssumatchtype_name:
@@ -663,7 +776,7 @@ dns_ssutable_createdlz(isc_mem_t *mctx, dns_ssutable_t **tablep,
 	rule->types = NULL;
 	rule->magic = SSURULEMAGIC;
 
-	ISC_LIST_INITANDAPPEND(table->rules, rule, link);
+	appendrule(table, rule);
 	*tablep = table;
 }
 
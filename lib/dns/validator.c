@@ -21,15 +21,19 @@
 #include <isc/mem.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
+#include <isc/serial.h>
+#include <isc/stdtime.h>
 #include <isc/string.h>
 #include <isc/tid.h>
 #include <isc/util.h>
 #include <isc/work.h>
 
+#include <dns/cache.h>
 #include <dns/client.h>
 #include <dns/db.h>
 #include <dns/dnssec.h>
 #include <dns/ds.h>
+#include <dns/keycache.h>
 #include <dns/keytable.h>
 #include <dns/keyvalues.h>
 #include <dns/log.h>
@@ -41,9 +45,12 @@
 #include <dns/rdataset.h>
 #include <dns/rdatatype.h>
 #include <dns/resolver.h>
+#include <dns/sigcache.h>
 #include <dns/validator.h>
 #include <dns/view.h>
 
+#include "probes.h"
+
 /*! \file
  * \brief
  * Basic processing sequences:
@@ -231,6 +238,8 @@ validator_done(dns_validator_t *val, isc_result_t result) {
 	val->attributes |= VALATTR_COMPLETE;
 	val->result = result;
 
+	LIBDNS_VALIDATOR_DONE(val, result);
+
 	isc_async_run(val->loop, val->cb, val);
 }
 
@@ -358,6 +367,16 @@ resume_answer_with_key(void *arg) {
 	dns_validator_t *val = arg;
 	dns_rdataset_t *rdataset = &val->frdataset;
 
+	/*
+	 * Remember the keys of a secure keyset, so that the following
+	 * signatures by the same signer need not look it up and parse
+	 * it again.
+	 */
+	if (rdataset->trust >= dns_trust_secure) {
+		dns_keycache_add(val->view->keycache, &val->siginfo->signer,
+				 rdataset, isc_stdtime_now() + rdataset->ttl);
+	}
+
 	isc_result_t result = select_signing_key(val, rdataset);
 	if (result == ISC_R_SUCCESS) {
 		val->keyset = &val->frdataset;
@@ -1055,6 +1074,23 @@ done:
 	return (result);
 }
 
+/*%
+ * Replace the cached key in val->key, which did not verify the signature
+ * in val->siginfo, with the next cached key that may have generated it.
+ *
+ * Returns ISC_R_SUCCESS if another possible key has been found.
+ */
+static isc_result_t
+select_cached_key(dns_validator_t *val) {
+	dns_rdata_rrsig_t *siginfo = val->siginfo;
+
+	dst_key_free(&val->key);
+	return (dns_keycache_find(val->view->keycache, &siginfo->signer,
+				  siginfo->algorithm, siginfo->keyid,
+				  ++val->keyidx, isc_stdtime_now(),
+				  &val->key));
+}
+
 /*%
  * Get the key that generated the signature in val->siginfo.
  */
@@ -1117,6 +1153,21 @@ seek_dnskey(dns_validator_t *val) {
 		}
 	}
 
+	/*
+	 * Has the signer's keyset recently been found to be secure?
+	 */
+	val->keyidx = 0;
+	result = dns_keycache_find(val->view->keycache, &siginfo->signer,
+				   siginfo->algorithm, siginfo->keyid, 0,
+				   isc_stdtime_now(), &val->key);
+	if (result == ISC_R_SUCCESS) {
+		validator_log(val, ISC_LOG_DEBUG(3),
+			      "using cached key (keyid=%u)", siginfo->keyid);
+		disassociate_rdatasets(val);
+		val->keyset = NULL;
+		return (ISC_R_SUCCESS);
+	}
+
 	/*
 	 * Do we know about this key?
 	 */
@@ -1368,11 +1419,115 @@ selfsigned_dnskey(dns_validator_t *val) {
 	return (DNS_R_NOKEYMATCH);
 }
 
+static int
+rdata_compare(const void *rdata1, const void *rdata2) {
+	return (dns_rdata_compare((const dns_rdata_t *)rdata1,
+				  (const dns_rdata_t *)rdata2));
+}
+
+/*%
+ * Compute the digest under which the verification of the RRSIG 'rdata'
+ * by 'key' over 'val->rdataset' is stored in the verified signature
+ * cache.  It covers the owner name, class and type of the RRset, the
+ * RRSIG, the DNSKEY and the records of the RRset in DNSSEC order.
+ */
+static isc_result_t
+sigcache_digest(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
+		unsigned char *digest) {
+	isc_result_t result;
+	isc_md_t *md = NULL;
+	isc_buffer_t b;
+	isc_region_t r;
+	unsigned char keydata[DST_KEY_MAXSIZE];
+	unsigned char header[4];
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	dns_rdata_t *rdatas = NULL;
+	unsigned int i, n = 0;
+	unsigned int digestlen;
+
+	isc_buffer_init(&b, keydata, sizeof(keydata));
+	result = dst_key_todns(key, &b);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	md = isc_md_new();
+	result = isc_md_init(md, ISC_MD_SHA256);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	dns_name_toregion(val->name, &r);
+	result = isc_md_update(md, r.base, r.length);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	ISC_U16TO8_BE(header, val->rdataset->rdclass);
+	ISC_U16TO8_BE(header + 2, val->rdataset->type);
+	result = isc_md_update(md, header, sizeof(header));
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	result = isc_md_update(md, rdata->data, rdata->length);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	isc_buffer_usedregion(&b, &r);
+	result = isc_md_update(md, r.base, r.length);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	n = dns_rdataset_count(val->rdataset);
+	rdatas = isc_mem_cget(val->view->mctx, n, sizeof(rdatas[0]));
+	dns_rdataset_clone(val->rdataset, &rdataset);
+	for (i = 0, result = dns_rdataset_first(&rdataset);
+	     i < n && result == ISC_R_SUCCESS;
+	     i++, result = dns_rdataset_next(&rdataset))
+	{
+		dns_rdata_init(&rdatas[i]);
+		dns_rdataset_current(&rdataset, &rdatas[i]);
+	}
+	dns_rdataset_disassociate(&rdataset);
+	INSIST(i == n);
+	qsort(rdatas, n, sizeof(rdatas[0]), rdata_compare);
+
+	for (i = 0; i < n; i++) {
+		ISC_U16TO8_BE(header, rdatas[i].length);
+		result = isc_md_update(md, header, 2);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		result = isc_md_update(md, rdatas[i].data, rdatas[i].length);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+	}
+
+	result = isc_md_final(md, digest, &digestlen);
+	INSIST(result != ISC_R_SUCCESS ||
+	       digestlen == DNS_SIGCACHE_DIGESTLENGTH);
+
+cleanup:
+	if (rdatas != NULL) {
+		isc_mem_cput(val->view->mctx, rdatas, n, sizeof(rdatas[0]));
+	}
+	isc_md_free(md);
+	return (result);
+}
+
 /*%
  * Attempt to verify the rdataset using the given key and rdata (RRSIG).
  * The signature was good and from a wildcard record and the QNAME does
  * not match the wildcard we need to look for a NOQNAME proof.
  *
+ * Signatures which are verified without the help of 'acceptexpired'
+ * and not from a wildcard are remembered in the cache's verified
+ * signature cache until they expire, and are not verified again.
+ *
  * Returns:
  * \li	ISC_R_SUCCESS if the verification succeeds.
  * \li	Others if the verification fails.
@@ -1384,9 +1539,24 @@ verify(dns_validator_t *val, dst_key_t *key, dns_rdata_t *rdata,
 	dns_fixedname_t fixed;
 	bool ignore = false;
 	dns_name_t *wild;
+	dns_sigcache_t *sigcache = NULL;
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
 
 	val->attributes |= VALATTR_TRIEDVERIFY;
 	wild = dns_fixedname_initname(&fixed);
+
+	if (val->view->cache != NULL &&
+	    sigcache_digest(val, key, rdata, digest) == ISC_R_SUCCESS)
+	{
+		sigcache = dns_cache_getsigcache(val->view->cache);
+		if (dns_sigcache_find(sigcache, digest, isc_stdtime_now())) {
+			validator_log(val, ISC_LOG_DEBUG(3),
+				      "verify rdataset (keyid=%u): "
+				      "cached success",
+				      keyid);
+			return (ISC_R_SUCCESS);
+		}
+	}
 again:
 	if (over_max_validations(val)) {
 		return (ISC_R_QUOTA);
@@ -1401,6 +1571,17 @@ again:
 		goto again;
 	}
 
+	if (result == ISC_R_SUCCESS && !ignore && sigcache != NULL) {
+		dns_rdata_rrsig_t sig;
+		isc_stdtime_t now = isc_stdtime_now();
+
+		RUNTIME_CHECK(dns_rdata_tostruct(rdata, &sig, NULL) ==
+			      ISC_R_SUCCESS);
+		if (isc_serial_gt(sig.timeexpire, now)) {
+			dns_sigcache_add(sigcache, digest, sig.timeexpire);
+		}
+	}
+
 	if (ignore && (result == ISC_R_SUCCESS || result == DNS_R_FROMWILDCARD))
 	{
 		validator_log(val, ISC_LOG_INFO,
@@ -1514,40 +1695,47 @@ cleanup:
 static void
 validate_answer_finish(void *arg);
 
+/*%
+ * Verify the current RRSIG against every candidate key in 'val->keyset',
+ * or in the view's key cache if 'val->keyset' is NULL, that matches its
+ * key tag and algorithm.  All the candidates are tried
+ * within a single offloaded work item, so a key tag collision or a
+ * failed verification does not cost a round trip through the loop for
+ * each remaining key.
+ */
 static void
 validate_answer_signing_key(void *arg) {
 	dns_validator_t *val = arg;
-	isc_result_t result = ISC_R_NOTFOUND;
+	isc_result_t result;
 
-	if (CANCELED(val)) {
-		val->result = ISC_R_CANCELED;
-	} else {
-		val->result = verify(val, val->key, &val->rdata,
-				     val->siginfo->keyid);
-	}
+	do {
+		if (CANCELED(val)) {
+			val->result = ISC_R_CANCELED;
+		} else {
+			val->result = verify(val, val->key, &val->rdata,
+					     val->siginfo->keyid);
+		}
 
-	switch (val->result) {
-	case ISC_R_CANCELED:	 /* Validation was canceled */
-	case ISC_R_SHUTTINGDOWN: /* Server shutting down */
-	case ISC_R_QUOTA:	 /* Validation fails quota reached */
-	case ISC_R_SUCCESS: /* We found our valid signature, we are done! */
-		if (val->key != NULL) {
+		switch (val->result) {
+		case ISC_R_CANCELED:	 /* Validation was canceled */
+		case ISC_R_SHUTTINGDOWN: /* Server shutting down */
+		case ISC_R_QUOTA:	 /* Validation fails quota reached */
+		case ISC_R_SUCCESS:	 /* We found our valid signature */
 			dst_key_free(&val->key);
 			val->key = NULL;
+			return;
+		default:
+			/* Select next signing key */
+			if (val->keyset == NULL) {
+				result = select_cached_key(val);
+			} else {
+				result = select_signing_key(val, val->keyset);
+			}
+			break;
 		}
+	} while (result == ISC_R_SUCCESS);
 
-		break;
-	default:
-		/* Select next signing key */
-		result = select_signing_key(val, val->keyset);
-		break;
-	}
-
-	if (result == ISC_R_SUCCESS) {
-		INSIST(val->key != NULL);
-	} else {
-		INSIST(val->key == NULL);
-	}
+	INSIST(val->key == NULL);
 }
 
 static void
@@ -1556,11 +1744,6 @@ validate_answer_signing_key_done(void *arg) {
 
 	if (CANCELED(val)) {
 		val->result = ISC_R_CANCELED;
-	} else if (val->key != NULL) {
-		/* Process with next key if we selected one */
-		isc_work_enqueue(val->loop, validate_answer_signing_key,
-				 validate_answer_signing_key_done, val);
-		return;
 	}
 
 	validate_answer_finish(val);
@@ -3225,6 +3408,7 @@ validator_start(void *arg) {
 		goto cleanup;
 	}
 
+	LIBDNS_VALIDATOR_START(val);
 	validator_log(val, ISC_LOG_DEBUG(3), "starting");
 
 	if (val->rdataset != NULL && val->sigrdataset != NULL) {
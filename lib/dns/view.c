@@ -43,6 +43,7 @@
 #include <dns/dns64.h>
 #include <dns/dnssec.h>
 #include <dns/forward.h>
+#include <dns/keycache.h>
 #include <dns/keytable.h>
 #include <dns/keyvalues.h>
 #include <dns/master.h>
@@ -79,6 +80,14 @@
  */
 #define DEFAULT_EDNS_BUFSIZE 1232
 
+/*%
+ * How many signers' verified zone keys are remembered by the view's
+ * key cache.
+ */
+#define DNS_VIEW_KEYCACHESIZE 1024U
+
+static atomic_uint_fast32_t view_instance = 0;
+
 isc_result_t
 dns_view_create(isc_mem_t *mctx, dns_dispatchmgr_t *dispatchmgr,
 		dns_rdataclass_t rdclass, const char *name,
@@ -99,6 +108,7 @@ dns_view_create(isc_mem_t *mctx, dns_dispatchmgr_t *dispatchmgr,
 	*view = (dns_view_t){
 		.rdclass = rdclass,
 		.name = isc_mem_strdup(mctx, name),
+		.instance = atomic_fetch_add_relaxed(&view_instance, 1),
 		.nta_file = isc_mem_strdup(mctx, buffer),
 		.recursion = true,
 		.enablevalidation = true,
@@ -144,6 +154,7 @@ dns_view_create(isc_mem_t *mctx, dns_dispatchmgr_t *dispatchmgr,
 	dns_tsigkeyring_create(view->mctx, &view->dynamickeys);
 
 	view->failcache = dns_badcache_new(view->mctx);
+	view->keycache = dns_keycache_new(view->mctx, DNS_VIEW_KEYCACHESIZE);
 
 	isc_mutex_init(&view->new_zone_lock);
 
@@ -161,6 +172,11 @@ dns_view_create(isc_mem_t *mctx, dns_dispatchmgr_t *dispatchmgr,
 
 	dns_nametree_create(view->mctx, DNS_NAMETREE_COUNT, "sfd", &view->sfd);
 
+	isc_quota_init(&view->prefetchquota, 0);
+	isc_quota_init(&view->stalerefreshquota, 0);
+	isc_mutex_init(&view->stalerefreshlock);
+	isc_hashmap_create(view->mctx, 4, &view->stalerefreshes);
+
 	view->magic = DNS_VIEW_MAGIC;
 	*viewp = view;
 
@@ -174,6 +190,7 @@ cleanup_order:
 cleanup_new_zone_lock:
 	isc_mutex_destroy(&view->new_zone_lock);
 	dns_badcache_destroy(&view->failcache);
+	dns_keycache_destroy(&view->keycache);
 
 	if (view->dynamickeys != NULL) {
 		dns_tsigkeyring_detach(&view->dynamickeys);
@@ -291,6 +308,12 @@ destroy(dns_view_t *view) {
 	if (view->cache != NULL) {
 		dns_cache_detach(&view->cache);
 	}
+	if (view->delegdb != NULL) {
+		dns_db_detach(&view->delegdb);
+	}
+	if (view->delegcache != NULL) {
+		dns_cache_detach(&view->delegcache);
+	}
 	if (view->nocasecompress != NULL) {
 		dns_acl_detach(&view->nocasecompress);
 	}
@@ -404,6 +427,14 @@ destroy(dns_view_t *view) {
 	if (view->failcache != NULL) {
 		dns_badcache_destroy(&view->failcache);
 	}
+	if (view->keycache != NULL) {
+		dns_keycache_destroy(&view->keycache);
+	}
+	isc_quota_destroy(&view->prefetchquota);
+	INSIST(isc_hashmap_count(view->stalerefreshes) == 0);
+	isc_hashmap_destroy(&view->stalerefreshes);
+	isc_mutex_destroy(&view->stalerefreshlock);
+	isc_quota_destroy(&view->stalerefreshquota);
 	isc_mutex_destroy(&view->new_zone_lock);
 	isc_mutex_destroy(&view->lock);
 	isc_refcount_destroy(&view->references);
@@ -606,7 +637,11 @@ dns_view_createresolver(dns_view_t *view, isc_loopmgr_t *loopmgr,
 		return (result);
 	}
 
-	isc_mem_create(&mctx);
+	/*
+	 * ADB entries come and go all the time, so keep freed pages
+	 * around for longer than the cache does before releasing them.
+	 */
+	isc_mem_create_decay(&mctx, 10000, 0);
 	isc_mem_setname(mctx, "ADB");
 	dns_adb_create(mctx, view, loopmgr, &view->adb);
 	isc_mem_detach(&mctx);
@@ -645,6 +680,22 @@ dns_view_setcache(dns_view_t *view, dns_cache_t *cache, bool shared) {
 	INSIST(DNS_DB_VALID(view->cachedb));
 }
 
+void
+dns_view_setdelegationcache(dns_view_t *view, dns_cache_t *cache) {
+	REQUIRE(DNS_VIEW_VALID(view));
+	REQUIRE(!view->frozen);
+
+	if (view->delegcache != NULL) {
+		dns_db_detach(&view->delegdb);
+		dns_cache_detach(&view->delegcache);
+	}
+	if (cache != NULL) {
+		dns_cache_attach(cache, &view->delegcache);
+		dns_cache_attachdb(cache, &view->delegdb);
+		INSIST(DNS_DB_VALID(view->delegdb));
+	}
+}
+
 bool
 dns_view_iscacheshared(dns_view_t *view) {
 	REQUIRE(DNS_VIEW_VALID(view));
@@ -1072,6 +1123,72 @@ dns_view_simplefind(dns_view_t *view, const dns_name_t *name,
 	return (result);
 }
 
+/*
+ * Look for a zone cut for 'name' in the delegation cache, and use it in
+ * place of the one found in the main cache if it is deeper, or if the
+ * main cache had none.  'result' is what the main cache lookup returned.
+ */
+static isc_result_t
+finddelegation(dns_view_t *view, const dns_name_t *name, unsigned int options,
+	       isc_stdtime_t now, isc_result_t result, dns_name_t *fname,
+	       dns_name_t *dcname, dns_rdataset_t *rdataset,
+	       dns_rdataset_t *sigrdataset) {
+	isc_result_t dresult;
+	dns_fixedname_t dfixed;
+	dns_name_t *dname = dns_fixedname_initname(&dfixed);
+	dns_rdataset_t drdataset, dsigrdataset;
+
+	if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) {
+		return (result);
+	}
+
+	dns_rdataset_init(&drdataset);
+	dns_rdataset_init(&dsigrdataset);
+	dresult = dns_db_findzonecut(view->delegdb, name, options, now, NULL,
+				    dname, NULL, &drdataset,
+				    sigrdataset != NULL ? &dsigrdataset : NULL);
+	if (dresult != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+
+	if (result == ISC_R_SUCCESS) {
+		if (dns_name_countlabels(dname) <= dns_name_countlabels(fname))
+		{
+			/*
+			 * The main cache is at least as good.
+			 */
+			goto cleanup;
+		}
+		dns_rdataset_disassociate(rdataset);
+		if (sigrdataset != NULL &&
+		    dns_rdataset_isassociated(sigrdataset))
+		{
+			dns_rdataset_disassociate(sigrdataset);
+		}
+	}
+
+	dns_name_copy(dname, fname);
+	if (dcname != NULL &&
+	    dns_name_countlabels(dname) > dns_name_countlabels(dcname))
+	{
+		dns_name_copy(dname, dcname);
+	}
+	dns_rdataset_clone(&drdataset, rdataset);
+	if (sigrdataset != NULL && dns_rdataset_isassociated(&dsigrdataset)) {
+		dns_rdataset_clone(&dsigrdataset, sigrdataset);
+	}
+	result = ISC_R_SUCCESS;
+
+cleanup:
+	if (dns_rdataset_isassociated(&drdataset)) {
+		dns_rdataset_disassociate(&drdataset);
+	}
+	if (dns_rdataset_isassociated(&dsigrdataset)) {
+		dns_rdataset_disassociate(&dsigrdataset);
+	}
+	return (result);
+}
+
 isc_result_t
 dns_view_findzonecut(dns_view_t *view, const dns_name_t *name,
 		     dns_name_t *fname, dns_name_t *dcname, isc_stdtime_t now,
@@ -1178,6 +1295,11 @@ db_find:
 	} else {
 		result = dns_db_findzonecut(db, name, options, now, NULL, fname,
 					    dcname, rdataset, sigrdataset);
+		if (view->delegdb != NULL) {
+			result = finddelegation(view, name, options, now,
+						result, fname, dcname, rdataset,
+						sigrdataset);
+		}
 		if (result == ISC_R_SUCCESS) {
 			if (zfname != NULL &&
 			    (!dns_name_issubdomain(fname, zfname) ||
@@ -1455,12 +1577,23 @@ dns_view_flushcache(dns_view_t *view, bool fixuponly) {
 	}
 	dns_db_detach(&view->cachedb);
 	dns_cache_attachdb(view->cache, &view->cachedb);
+	if (view->delegcache != NULL) {
+		result = dns_cache_flush(view->delegcache);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+		dns_db_detach(&view->delegdb);
+		dns_cache_attachdb(view->delegcache, &view->delegdb);
+	}
 	if (view->resolver != NULL) {
 		dns_resolver_flushbadcache(view->resolver, NULL);
 	}
 	if (view->failcache != NULL) {
 		dns_badcache_flush(view->failcache);
 	}
+	if (view->keycache != NULL) {
+		dns_keycache_flush(view->keycache);
+	}
 
 	rcu_read_lock();
 	adb = rcu_dereference(view->adb);
@@ -1497,6 +1630,9 @@ dns_view_flushnode(dns_view_t *view, const dns_name_t *name, bool tree) {
 		if (view->failcache != NULL) {
 			dns_badcache_flushtree(view->failcache, name);
 		}
+		if (view->keycache != NULL) {
+			dns_keycache_flushtree(view->keycache, name);
+		}
 	} else {
 		rcu_read_lock();
 		adb = rcu_dereference(view->adb);
@@ -1510,8 +1646,14 @@ dns_view_flushnode(dns_view_t *view, const dns_name_t *name, bool tree) {
 		if (view->failcache != NULL) {
 			dns_badcache_flushname(view->failcache, name);
 		}
+		if (view->keycache != NULL) {
+			dns_keycache_flushname(view->keycache, name);
+		}
 	}
 
+	if (view->delegcache != NULL) {
+		(void)dns_cache_flushnode(view->delegcache, name, tree);
+	}
 	if (view->cache != NULL) {
 		result = dns_cache_flushnode(view->cache, name, tree);
 	}
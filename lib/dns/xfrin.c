@@ -18,6 +18,7 @@
 
 #include <isc/atomic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/random.h>
 #include <isc/result.h>
 #include <isc/string.h>
@@ -134,6 +135,8 @@ struct dns_xfrin {
 	bool diff_running;
 	struct __cds_wfcq_head diff_head;
 	struct cds_wfcq_tail diff_tail;
+	atomic_uint_fast32_t diff_pending; /*%< Queued AXFR chunks */
+	bool reading_paused;		   /*%< Waiting for the queue */
 
 	_Atomic xfrin_state_t state;
 	uint32_t expireopt;
@@ -202,6 +205,56 @@ typedef struct xfrin_work {
 	isc_result_t result;
 } xfrin_work_t;
 
+/*%
+ * A chunk of database changes queued for a worker thread.
+ */
+typedef struct xfrin_apply_data {
+	dns_diff_t diff; /*%< Pending database changes */
+	struct cds_wfcq_node wfcq_node;
+} xfrin_apply_data_t;
+
+/*%
+ * AXFR data is loaded into the new database as each message arrives.
+ * Reading the next message is postponed while more than this many
+ * messages are waiting to be loaded, so the memory used for buffering
+ * stays bounded however fast the primary sends.
+ */
+#define AXFR_MAXPENDING 16
+
+/*%
+ * Difference sequences large enough to give each partition at least
+ * this many tuples are split by owner name, and the partitions applied
+ * to the database in parallel.
+ */
+#define IXFR_PARTITION_MINTUPLES 1024
+
+typedef struct ixfr_apply ixfr_apply_t;
+
+/*%
+ * The tuples of a difference sequence whose owner names hash into the
+ * same partition.  As all the changes to a given name are in the same
+ * partition, the partitions touch disjoint sets of nodes.
+ */
+typedef struct ixfr_partition {
+	ixfr_apply_t *apply;
+	dns_diff_t diff;
+	isc_result_t result;
+} ixfr_partition_t;
+
+/*%
+ * A difference sequence being applied to the database.
+ */
+struct ixfr_apply {
+	dns_xfrin_t *xfr;
+	xfrin_apply_data_t *data;
+	dns_difftuple_t **tuples; /*%< The tuples in their original order */
+	size_t ntuples;
+	ixfr_partition_t *parts;
+	size_t nparts;
+	size_t running; /*%< Partitions still being applied */
+	isc_result_t result;
+};
+
 /**************************************************************************/
 /*
  * Forward declarations.
@@ -225,6 +278,8 @@ axfr_putdata(dns_xfrin_t *xfr, dns_diffop_t op, dns_name_t *name, dns_ttl_t ttl,
 	     dns_rdata_t *rdata);
 static void
 axfr_commit(dns_xfrin_t *xfr);
+static void
+xfrin_readnext(dns_xfrin_t *xfr);
 static isc_result_t
 axfr_finalize(dns_xfrin_t *xfr);
 
@@ -327,7 +382,7 @@ failure:
 }
 
 /*
- * Store a set of AXFR RRs in the database.
+ * Store the queued sets of AXFR RRs in the database.
  */
 static void
 axfr_apply(void *arg) {
@@ -338,22 +393,43 @@ axfr_apply(void *arg) {
 
 	REQUIRE(VALID_XFRIN(xfr));
 
-	if (atomic_load(&xfr->shuttingdown)) {
-		result = ISC_R_SHUTTINGDOWN;
-		goto failure;
+	struct __cds_wfcq_head diff_head;
+	struct cds_wfcq_tail diff_tail;
+
+	/* Initialize local wfcqueue */
+	__cds_wfcq_init(&diff_head, &diff_tail);
+
+	enum cds_wfcq_ret ret = __cds_wfcq_splice_blocking(
+		&diff_head, &diff_tail, &xfr->diff_head, &xfr->diff_tail);
+	INSIST(ret == CDS_WFCQ_RET_DEST_EMPTY);
+
+	struct cds_wfcq_node *node, *next;
+	__cds_wfcq_for_each_blocking_safe(&diff_head, &diff_tail, node, next) {
+		xfrin_apply_data_t *data =
+			caa_container_of(node, xfrin_apply_data_t, wfcq_node);
+
+		if (atomic_load(&xfr->shuttingdown)) {
+			result = ISC_R_SHUTTINGDOWN;
+		}
+
+		/* Load only until first failure */
+		if (result == ISC_R_SUCCESS) {
+			result = dns_diff_load(&data->diff, &xfr->axfr);
+		}
+
+		/* We need to clear and free all data chunks */
+		dns_diff_clear(&data->diff);
+		isc_mem_put(xfr->mctx, data, sizeof(*data));
+		atomic_fetch_sub_release(&xfr->diff_pending, 1);
 	}
 
-	CHECK(dns_diff_load(&xfr->diff, &xfr->axfr));
-	if (xfr->maxrecords != 0U) {
+	if (result == ISC_R_SUCCESS && xfr->maxrecords != 0U) {
 		result = dns_db_getsize(xfr->db, xfr->ver, &records, NULL);
 		if (result == ISC_R_SUCCESS && records > xfr->maxrecords) {
 			result = DNS_R_TOOMANYRECORDS;
-			goto failure;
 		}
 	}
 
-failure:
-	dns_diff_clear(&xfr->diff);
 	work->result = result;
 }
 
@@ -369,12 +445,31 @@ axfr_apply_done(void *arg) {
 		result = ISC_R_SHUTTINGDOWN;
 	}
 
-	if (result == ISC_R_SUCCESS) {
+	if (result != ISC_R_SUCCESS) {
+		(void)dns_db_endload(xfr->db, &xfr->axfr);
+		goto failure;
+	}
+
+	/* Resume reading once the queue has drained */
+	if (xfr->reading_paused &&
+	    atomic_load_acquire(&xfr->diff_pending) <= AXFR_MAXPENDING / 2)
+	{
+		xfr->reading_paused = false;
+		dns_xfrin_ref(xfr);
+		xfrin_readnext(xfr);
+	}
+
+	/* Reschedule */
+	if (!cds_wfcq_empty(&xfr->diff_head, &xfr->diff_tail)) {
+		isc_work_enqueueclass(xfr->loop, isc_workclass_bulk, axfr_apply,
+				      axfr_apply_done, work);
+		return;
+	}
+
+	if (atomic_load(&xfr->state) == XFRST_AXFR_END) {
 		CHECK(dns_db_endload(xfr->db, &xfr->axfr));
 		CHECK(dns_zone_verifydb(xfr->zone, xfr->db, NULL));
 		CHECK(axfr_finalize(xfr));
-	} else {
-		(void)dns_db_endload(xfr->db, &xfr->axfr);
 	}
 
 failure:
@@ -393,17 +488,33 @@ failure:
 	dns_xfrin_detach(&xfr);
 }
 
+/*
+ * Queue the AXFR RRs received so far to be loaded into the database.
+ */
 static void
 axfr_commit(dns_xfrin_t *xfr) {
-	REQUIRE(!xfr->diff_running);
+	xfrin_apply_data_t *data = isc_mem_get(xfr->mctx, sizeof(*data));
 
-	xfrin_work_t *work = isc_mem_get(xfr->mctx, sizeof(*work));
-	*work = (xfrin_work_t){
-		.xfr = dns_xfrin_ref(xfr),
-		.result = ISC_R_UNSET,
-	};
-	xfr->diff_running = true;
-	isc_work_enqueue(xfr->loop, axfr_apply, axfr_apply_done, work);
+	*data = (xfrin_apply_data_t){ 0 };
+	cds_wfcq_node_init(&data->wfcq_node);
+
+	dns_diff_init(xfr->mctx, &data->diff);
+	ISC_LIST_MOVE(data->diff.tuples, xfr->diff.tuples);
+
+	atomic_fetch_add_relaxed(&xfr->diff_pending, 1);
+	(void)cds_wfcq_enqueue(&xfr->diff_head, &xfr->diff_tail,
+			       &data->wfcq_node);
+
+	if (!xfr->diff_running) {
+		xfrin_work_t *work = isc_mem_get(xfr->mctx, sizeof(*work));
+		*work = (xfrin_work_t){
+			.xfr = dns_xfrin_ref(xfr),
+			.result = ISC_R_UNSET,
+		};
+		xfr->diff_running = true;
+		isc_work_enqueueclass(xfr->loop, isc_workclass_bulk, axfr_apply,
+				      axfr_apply_done, work);
+	}
 }
 
 static isc_result_t
@@ -422,11 +533,6 @@ axfr_finalize(dns_xfrin_t *xfr) {
  * IXFR handling
  */
 
-typedef struct ixfr_apply_data {
-	dns_diff_t diff; /*%< Pending database changes */
-	struct cds_wfcq_node wfcq_node;
-} ixfr_apply_data_t;
-
 static isc_result_t
 ixfr_init(dns_xfrin_t *xfr) {
 	isc_result_t result;
@@ -497,14 +603,58 @@ failure:
 	return (result);
 }
 
-static isc_result_t
-ixfr_apply_one(dns_xfrin_t *xfr, ixfr_apply_data_t *data) {
+static void
+ixfr_apply_free(ixfr_apply_t *apply) {
+	dns_xfrin_t *xfr = apply->xfr;
+
+	dns_diff_clear(&apply->data->diff);
+	isc_mem_put(xfr->mctx, apply->data, sizeof(*apply->data));
+
+	if (apply->tuples != NULL) {
+		isc_mem_cput(xfr->mctx, apply->tuples, apply->ntuples,
+			     sizeof(apply->tuples[0]));
+	}
+	isc_mem_cput(xfr->mctx, apply->parts, apply->nparts,
+		     sizeof(apply->parts[0]));
+	isc_mem_put(xfr->mctx, apply, sizeof(*apply));
+}
+
+/*
+ * Called on the transfer's loop when the queue of difference sequences
+ * has been drained, or when applying one of them failed.  This drops
+ * the reference held while the queue was being processed.
+ */
+static void
+ixfr_apply_finish(dns_xfrin_t *xfr, isc_result_t result) {
+	xfr->diff_running = false;
+
+	if (result == ISC_R_SUCCESS) {
+		dns_db_closeversion(xfr->db, &xfr->ver, true);
+		dns_zone_markdirty(xfr->zone);
+
+		if (atomic_load(&xfr->state) == XFRST_IXFR_END) {
+			xfrin_end(xfr, result);
+		}
+	} else {
+		dns_db_closeversion(xfr->db, &xfr->ver, false);
+
+		xfrin_fail(xfr, result, "failed while processing responses");
+	}
+
+	dns_xfrin_detach(&xfr);
+}
+
+/*
+ * Check the size of the updated zone, and record the difference
+ * sequence in the journal.
+ */
+static void
+ixfr_apply_journal(void *arg) {
+	ixfr_apply_t *apply = arg;
+	dns_xfrin_t *xfr = apply->xfr;
 	isc_result_t result = ISC_R_SUCCESS;
 	uint64_t records;
 
-	CHECK(ixfr_begin_transaction(xfr));
-
-	CHECK(dns_diff_apply(&data->diff, xfr->db, xfr->ver));
 	if (xfr->maxrecords != 0U) {
 		result = dns_db_getsize(xfr->db, xfr->ver, &records, NULL);
 		if (result == ISC_R_SUCCESS && records > xfr->maxrecords) {
@@ -512,102 +662,207 @@ ixfr_apply_one(dns_xfrin_t *xfr, ixfr_apply_data_t *data) {
 			goto failure;
 		}
 	}
+
+	CHECK(ixfr_begin_transaction(xfr));
 	if (xfr->ixfr.journal != NULL) {
-		CHECK(dns_journal_writediff(xfr->ixfr.journal, &data->diff));
+		result = dns_journal_writediff(xfr->ixfr.journal,
+					       &apply->data->diff);
+		if (result != ISC_R_SUCCESS) {
+			/*
+			 * We need to end the transaction, but keep the
+			 * previous error
+			 */
+			(void)ixfr_end_transaction(xfr);
+			goto failure;
+		}
 	}
 
 	result = ixfr_end_transaction(xfr);
-
-	return (result);
 failure:
-	/* We need to end the transaction, but keep the previous error */
-	(void)ixfr_end_transaction(xfr);
-
-	return (result);
+	apply->result = result;
 }
 
 static void
-ixfr_apply(void *arg) {
-	xfrin_work_t *work = arg;
-	dns_xfrin_t *xfr = work->xfr;
-	isc_result_t result = ISC_R_SUCCESS;
+ixfr_apply_next(dns_xfrin_t *xfr);
+
+static void
+ixfr_apply_journal_done(void *arg) {
+	ixfr_apply_t *apply = arg;
+	dns_xfrin_t *xfr = apply->xfr;
+	isc_result_t result = apply->result;
 
 	REQUIRE(VALID_XFRIN(xfr));
 
-	struct __cds_wfcq_head diff_head;
-	struct cds_wfcq_tail diff_tail;
+	ixfr_apply_free(apply);
 
-	/* Initialize local wfcqueue */
-	__cds_wfcq_init(&diff_head, &diff_tail);
+	if (atomic_load(&xfr->shuttingdown)) {
+		result = ISC_R_SHUTTINGDOWN;
+	}
 
-	enum cds_wfcq_ret ret = __cds_wfcq_splice_blocking(
-		&diff_head, &diff_tail, &xfr->diff_head, &xfr->diff_tail);
-	INSIST(ret == CDS_WFCQ_RET_DEST_EMPTY);
+	if (result != ISC_R_SUCCESS) {
+		ixfr_apply_finish(xfr, result);
+		return;
+	}
 
-	struct cds_wfcq_node *node, *next;
-	__cds_wfcq_for_each_blocking_safe(&diff_head, &diff_tail, node, next) {
-		ixfr_apply_data_t *data =
-			caa_container_of(node, ixfr_apply_data_t, wfcq_node);
+	ixfr_apply_next(xfr);
+}
 
-		if (atomic_load(&xfr->shuttingdown)) {
-			result = ISC_R_SHUTTINGDOWN;
-		}
+static void
+ixfr_apply_partition(void *arg) {
+	ixfr_partition_t *part = arg;
+	dns_xfrin_t *xfr = part->apply->xfr;
 
-		/* Apply only until first failure */
-		if (result == ISC_R_SUCCESS) {
-			/* This also checks for shuttingdown condition */
-			result = ixfr_apply_one(xfr, data);
-		}
+	REQUIRE(VALID_XFRIN(xfr));
 
-		/* We need to clear and free all data chunks */
-		dns_diff_clear(&data->diff);
-		isc_mem_put(xfr->mctx, data, sizeof(*data));
+	if (atomic_load(&xfr->shuttingdown)) {
+		part->result = ISC_R_SHUTTINGDOWN;
+		return;
 	}
 
-	work->result = result;
+	part->result = dns_diff_apply(&part->diff, xfr->db, xfr->ver);
 }
 
 static void
-ixfr_apply_done(void *arg) {
-	xfrin_work_t *work = arg;
-	dns_xfrin_t *xfr = work->xfr;
-	isc_result_t result = work->result;
+ixfr_apply_partition_done(void *arg) {
+	ixfr_partition_t *part = arg;
+	ixfr_apply_t *apply = part->apply;
+	dns_xfrin_t *xfr = apply->xfr;
+	dns_diff_t *diff = &apply->data->diff;
+	isc_result_t result;
 
 	REQUIRE(VALID_XFRIN(xfr));
 
+	/* Keep the first error */
+	if (apply->result == ISC_R_SUCCESS) {
+		apply->result = part->result;
+	}
+
+	INSIST(apply->running > 0);
+	if (--apply->running > 0) {
+		return;
+	}
+
+	/*
+	 * All the partitions have been applied; put the tuples back
+	 * together in their original order, which is the one the journal
+	 * must record.
+	 */
+	if (apply->tuples == NULL) {
+		ISC_LIST_MOVE(diff->tuples, apply->parts[0].diff.tuples);
+	} else {
+		for (size_t i = 0; i < apply->nparts; i++) {
+			ISC_LIST_INIT(apply->parts[i].diff.tuples);
+		}
+		for (size_t i = 0; i < apply->ntuples; i++) {
+			dns_difftuple_t *tuple = apply->tuples[i];
+
+			ISC_LINK_INIT(tuple, link);
+			ISC_LIST_APPEND(diff->tuples, tuple, link);
+		}
+	}
+
+	result = apply->result;
 	if (atomic_load(&xfr->shuttingdown)) {
 		result = ISC_R_SHUTTINGDOWN;
 	}
 
 	if (result != ISC_R_SUCCESS) {
-		goto failure;
+		ixfr_apply_free(apply);
+		ixfr_apply_finish(xfr, result);
+		return;
 	}
 
-	/* Reschedule */
-	if (!cds_wfcq_empty(&xfr->diff_head, &xfr->diff_tail)) {
-		isc_work_enqueue(xfr->loop, ixfr_apply, ixfr_apply_done, work);
-		return;
+	isc_work_enqueueclass(xfr->loop, isc_workclass_bulk, ixfr_apply_journal,
+			      ixfr_apply_journal_done, apply);
+}
+
+/*
+ * Apply a difference sequence to the open version of the database.
+ *
+ * When the database allows it and the sequence is large, its tuples
+ * are partitioned by owner name and each partition is applied by a
+ * separate worker, all of them updating the same version; the changes
+ * still become visible at once, when the version is committed.
+ */
+static void
+ixfr_apply_start(dns_xfrin_t *xfr, xfrin_apply_data_t *data) {
+	ixfr_apply_t *apply = isc_mem_get(xfr->mctx, sizeof(*apply));
+	dns_difftuple_t *tuple = NULL;
+	size_t ntuples = 0, nparts = 1;
+
+	for (tuple = ISC_LIST_HEAD(data->diff.tuples); tuple != NULL;
+	     tuple = ISC_LIST_NEXT(tuple, link))
+	{
+		ntuples++;
 	}
 
-failure:
-	xfr->diff_running = false;
+	if (dns_db_parallelupdate(xfr->db)) {
+		nparts = ISC_MIN(ntuples / IXFR_PARTITION_MINTUPLES,
+				 isc_os_ncpus());
+		nparts = ISC_MAX(nparts, 1);
+	}
 
-	isc_mem_put(xfr->mctx, work, sizeof(*work));
+	*apply = (ixfr_apply_t){
+		.xfr = xfr,
+		.data = data,
+		.ntuples = ntuples,
+		.nparts = nparts,
+		.running = nparts,
+		.result = ISC_R_SUCCESS,
+	};
 
-	if (result == ISC_R_SUCCESS) {
-		dns_db_closeversion(xfr->db, &xfr->ver, true);
-		dns_zone_markdirty(xfr->zone);
+	apply->parts = isc_mem_cget(xfr->mctx, nparts, sizeof(apply->parts[0]));
+	for (size_t i = 0; i < nparts; i++) {
+		apply->parts[i] = (ixfr_partition_t){
+			.apply = apply,
+			.result = ISC_R_UNSET,
+		};
+		dns_diff_init(xfr->mctx, &apply->parts[i].diff);
+	}
 
-		if (atomic_load(&xfr->state) == XFRST_IXFR_END) {
-			xfrin_end(xfr, result);
-		}
+	if (nparts == 1) {
+		ISC_LIST_MOVE(apply->parts[0].diff.tuples, data->diff.tuples);
 	} else {
-		dns_db_closeversion(xfr->db, &xfr->ver, false);
+		size_t i = 0;
+
+		apply->tuples = isc_mem_cget(xfr->mctx, ntuples,
+					     sizeof(apply->tuples[0]));
+		while ((tuple = ISC_LIST_HEAD(data->diff.tuples)) != NULL) {
+			ixfr_partition_t *part =
+				&apply->parts[dns_name_hash(&tuple->name) %
+					      nparts];
+
+			ISC_LIST_UNLINK(data->diff.tuples, tuple, link);
+			ISC_LIST_APPEND(part->diff.tuples, tuple, link);
+			apply->tuples[i++] = tuple;
+		}
+		INSIST(i == ntuples);
+	}
 
-		xfrin_fail(xfr, result, "failed while processing responses");
+	for (size_t i = 0; i < nparts; i++) {
+		isc_work_enqueueclass(xfr->loop, isc_workclass_bulk,
+				      ixfr_apply_partition,
+				      ixfr_apply_partition_done,
+				      &apply->parts[i]);
 	}
+}
 
-	dns_xfrin_detach(&xfr);
+/*
+ * Start applying the next queued difference sequence, or close the
+ * version when there are none left.
+ */
+static void
+ixfr_apply_next(dns_xfrin_t *xfr) {
+	struct cds_wfcq_node *node = NULL;
+
+	node = __cds_wfcq_dequeue_blocking(&xfr->diff_head, &xfr->diff_tail);
+	if (node == NULL) {
+		ixfr_apply_finish(xfr, ISC_R_SUCCESS);
+		return;
+	}
+
+	ixfr_apply_start(xfr,
+			 caa_container_of(node, xfrin_apply_data_t, wfcq_node));
 }
 
 /*
@@ -616,9 +871,9 @@ failure:
 static isc_result_t
 ixfr_commit(dns_xfrin_t *xfr) {
 	isc_result_t result = ISC_R_SUCCESS;
-	ixfr_apply_data_t *data = isc_mem_get(xfr->mctx, sizeof(*data));
+	xfrin_apply_data_t *data = isc_mem_get(xfr->mctx, sizeof(*data));
 
-	*data = (ixfr_apply_data_t){ 0 };
+	*data = (xfrin_apply_data_t){ 0 };
 	cds_wfcq_node_init(&data->wfcq_node);
 
 	if (xfr->ver == NULL) {
@@ -633,13 +888,8 @@ ixfr_commit(dns_xfrin_t *xfr) {
 			       &data->wfcq_node);
 
 	if (!xfr->diff_running) {
-		xfrin_work_t *work = isc_mem_get(xfr->mctx, sizeof(*work));
-		*work = (xfrin_work_t){
-			.xfr = dns_xfrin_ref(xfr),
-			.result = ISC_R_UNSET,
-		};
 		xfr->diff_running = true;
-		isc_work_enqueue(xfr->loop, ixfr_apply, ixfr_apply_done, work);
+		ixfr_apply_next(dns_xfrin_ref(xfr));
 	}
 
 failure:
@@ -1170,6 +1420,7 @@ xfrin_create(isc_mem_t *mctx, dns_zone_t *zone, dns_db_t *db, isc_loop_t *loop,
 	__cds_wfcq_init(&xfr->diff_head, &xfr->diff_tail);
 
 	atomic_init(&xfr->is_ixfr, false);
+	atomic_init(&xfr->diff_pending, 0);
 
 	if (db != NULL) {
 		dns_db_attach(db, &xfr->db);
@@ -1948,19 +2199,28 @@ xfrin_recv_done(isc_result_t result, isc_region_t *region, void *arg) {
 		isc_timer_stop(xfr->max_time_timer);
 		xfrin_cancelio(xfr);
 		break;
+	case XFRST_AXFR:
+		/*
+		 * Queue the records of this message to be loaded, and
+		 * read the next one unless too many are already waiting.
+		 */
+		if (!ISC_LIST_EMPTY(xfr->diff.tuples)) {
+			axfr_commit(xfr);
+		}
+		if (atomic_load_acquire(&xfr->diff_pending) > AXFR_MAXPENDING)
+		{
+			xfrin_log(xfr, ISC_LOG_DEBUG(3),
+				  "pausing until queued data is loaded");
+			xfr->reading_paused = true;
+			break;
+		}
+		FALLTHROUGH;
 	default:
 		/*
 		 * Read the next message.
 		 */
 		dns_message_detach(&msg);
-		dns_dispatch_getnext(xfr->dispentry);
-
-		isc_interval_t interval;
-		isc_interval_set(&interval, dns_zone_getidlein(xfr->zone), 0);
-		isc_timer_start(xfr->max_idle_timer, isc_timertype_once,
-				&interval);
-
-		LIBDNS_XFRIN_READ(xfr, xfr->info, result);
+		xfrin_readnext(xfr);
 		return;
 	}
 
@@ -1976,6 +2236,22 @@ failure:
 	LIBDNS_XFRIN_RECV_DONE(xfr, xfr->info, result);
 }
 
+/*
+ * Read the next message, and restart the idle timer.  The caller's
+ * reference to 'xfr' is passed on to xfrin_recv_done().
+ */
+static void
+xfrin_readnext(dns_xfrin_t *xfr) {
+	isc_interval_t interval;
+
+	dns_dispatch_getnext(xfr->dispentry);
+
+	isc_interval_set(&interval, dns_zone_getidlein(xfr->zone), 0);
+	isc_timer_start(xfr->max_idle_timer, isc_timertype_once, &interval);
+
+	LIBDNS_XFRIN_READ(xfr, xfr->info, ISC_R_SUCCESS);
+}
+
 static void
 xfrin_destroy(dns_xfrin_t *xfr) {
 	uint64_t msecs, persec;
@@ -2016,18 +2292,18 @@ xfrin_destroy(dns_xfrin_t *xfr) {
 		  (unsigned int)(msecs / 1000), (unsigned int)(msecs % 1000),
 		  (unsigned int)persec, atomic_load_relaxed(&xfr->end_serial));
 
-	/* Cleanup unprocessed IXFR data */
+	/* Cleanup unprocessed AXFR and IXFR data */
 	struct cds_wfcq_node *node, *next;
 	__cds_wfcq_for_each_blocking_safe(&xfr->diff_head, &xfr->diff_tail,
 					  node, next) {
-		ixfr_apply_data_t *data =
-			caa_container_of(node, ixfr_apply_data_t, wfcq_node);
+		xfrin_apply_data_t *data =
+			caa_container_of(node, xfrin_apply_data_t, wfcq_node);
 		/* We need to clear and free all data chunks */
 		dns_diff_clear(&data->diff);
 		isc_mem_put(xfr->mctx, data, sizeof(*data));
 	}
 
-	/* Cleanup unprocessed AXFR data */
+	/* Cleanup data not yet queued */
 	dns_diff_clear(&xfr->diff);
 
 	xfrin_cancelio(xfr);
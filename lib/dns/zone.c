@@ -19,13 +19,16 @@
 
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/condition.h>
 #include <isc/file.h>
 #include <isc/hash.h>
+#include <isc/heap.h>
 #include <isc/hashmap.h>
 #include <isc/hex.h>
 #include <isc/loop.h>
 #include <isc/md.h>
 #include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/overflow.h>
 #include <isc/random.h>
 #include <isc/ratelimiter.h>
@@ -42,6 +45,7 @@
 #include <isc/timer.h>
 #include <isc/tls.h>
 #include <isc/util.h>
+#include <isc/work.h>
 
 #include <dns/acl.h>
 #include <dns/adb.h>
@@ -165,6 +169,14 @@
 #define DNS_DUMP_DELAY 900 /*%< 15 minutes */
 #endif			   /* ifndef DNS_DUMP_DELAY */
 
+#ifndef DNS_JOURNAL_GROUP_MAX
+#define DNS_JOURNAL_GROUP_MAX 1024 /*%< transactions per group commit */
+#endif				   /* ifndef DNS_JOURNAL_GROUP_MAX */
+
+#ifndef DNS_UPDATE_BATCH_MAX
+#define DNS_UPDATE_BATCH_MAX 64 /*%< queued updates handled at once */
+#endif				/* ifndef DNS_UPDATE_BATCH_MAX */
+
 typedef struct dns_notify dns_notify_t;
 typedef struct dns_checkds dns_checkds_t;
 typedef struct dns_stub dns_stub_t;
@@ -271,7 +283,8 @@ struct dns_zone {
 	dns_zonemgr_t *zmgr;
 	ISC_LINK(dns_zone_t) link; /* Used by zmgr. */
 	isc_loop_t *loop;
-	isc_timer_t *timer;
+	isc_time_t timernext;	   /* next maintenance, when queued */
+	unsigned int timer_index; /* position in the zmgr timer queue */
 	isc_refcount_t irefs;
 	dns_name_t origin;
 	char *masterfile;
@@ -308,6 +321,8 @@ struct dns_zone {
 	uint32_t minimum;
 	isc_stdtime_t key_expiry;
 	isc_stdtime_t log_key_expired_timer;
+	atomic_uint_fast32_t lastaccess;
+	uint32_t idletime;
 	char *keydirectory;
 	dns_keyfileio_t *kfio;
 	dns_keystorelist_t *keystores;
@@ -393,6 +408,7 @@ struct dns_zone {
 	dns_stats_t *rcvquerystats;
 	dns_stats_t *dnssecsignstats;
 	uint32_t notifydelay;
+	uint32_t triereplicas;
 	dns_isselffunc_t isself;
 	void *isselfarg;
 
@@ -414,6 +430,18 @@ struct dns_zone {
 	 * List of outstanding NSEC3PARAM change requests.
 	 */
 	ISC_LIST(struct np3) setnsec3param_queue;
+	/*%
+	 * Dynamic update transactions waiting for the next journal
+	 * group commit.
+	 */
+	ISC_LIST(struct journalwrite) journalwrites;
+	unsigned int njournalwrites;
+	/*%
+	 * Dynamic updates waiting to be applied as a batch.
+	 */
+	ISC_LIST(struct queuedupdate) queuedupdates;
+	unsigned int nqueuedupdates;
+	dns_zonebatchfunc_t batchfunc;
 	/*%
 	 * Signing / re-signing quantum stopping parameters.
 	 */
@@ -555,6 +583,8 @@ typedef enum {
 						      * just being loaded for
 						      * the first time. */
 	DNS_ZONEFLG_FIRSTREFRESH = 0x100000000U, /*%< First refresh pending */
+	DNS_ZONEFLG_COMPACTING = 0x200000000U,	 /*%< Journal compaction in
+						  * progress */
 	DNS_ZONEFLG___MAX = UINT64_MAX, /* trick to make the ENUM 64-bit wide */
 } dns_zoneflg_t;
 
@@ -592,6 +622,24 @@ struct dns_unreachable {
 	uint32_t count;
 };
 
+/*%
+ * Per-loop zone maintenance timers.  Instead of every zone arming a timer
+ * of its own, the zones of a loop are queued by their next maintenance
+ * time and a single timer per loop runs all zones that are due.
+ */
+typedef struct zonemgr_timerq {
+	isc_heap_t *heap;
+	isc_timer_t *timer;
+	isc_time_t next;     /* when 'timer' fires */
+	unsigned int nzones; /* managed zones on this loop; locked by rwlock */
+} zonemgr_timerq_t;
+
+/*%
+ * Maximum number of zones run from a single timer callback before the
+ * rest is deferred to the next loop iteration.
+ */
+#define ZONEMGR_TIMER_BATCH 1000
+
 struct dns_zonemgr {
 	unsigned int magic;
 	isc_mem_t *mctx;
@@ -600,6 +648,7 @@ struct dns_zonemgr {
 	isc_nm_t *netmgr;
 	uint32_t workers;
 	isc_mem_t **mctxpool;
+	zonemgr_timerq_t *timerqs;
 	isc_ratelimiter_t *checkdsrl;
 	isc_ratelimiter_t *notifyrl;
 	isc_ratelimiter_t *refreshrl;
@@ -607,11 +656,20 @@ struct dns_zonemgr {
 	isc_ratelimiter_t *startuprefreshrl;
 	isc_rwlock_t rwlock;
 	isc_rwlock_t urlock;
+	isc_mutex_t keyfetchlock;
+
+	/* Locked by keyfetchlock. */
+	ISC_LIST(dns_keyfetch_t) keyfetches;
 
 	/* Locked by rwlock. */
 	dns_zonelist_t zones;
 	dns_zonelist_t waiting_for_xfrin;
 	dns_zonelist_t xfrin_in_progress;
+	/*
+	 * Zones queued urgently wait at the head of 'waiting_for_xfrin';
+	 * this is the last of them, or NULL if there are none.
+	 */
+	dns_zone_t *xfrin_urgent;
 
 	/* Configuration data. */
 	uint32_t transfersin;
@@ -619,8 +677,10 @@ struct dns_zonemgr {
 	unsigned int checkdsrate;
 	unsigned int notifyrate;
 	unsigned int startupnotifyrate;
+	bool notifypipelining;
 	unsigned int serialqueryrate;
 	unsigned int startupserialqueryrate;
+	bool serialquerypipelining;
 
 	/* Locked by urlock. */
 	/* LRU cache */
@@ -734,6 +794,50 @@ struct dns_signing {
 	ISC_LINK(dns_signing_t) link;
 };
 
+/*%
+ * The signatures to be generated by one run of zone_sign().  They are
+ * queued while walking the zone, computed in parallel by the zone's
+ * loop and by isc_work workers, and then added to the zone version in
+ * the order in which they were queued.
+ */
+typedef struct signjob {
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdataset_t rdataset;
+	dst_key_t *key;
+	isc_result_t result;
+	dns_rdata_t rdata;
+	unsigned char data[1024]; /* XXX */
+} signjob_t;
+
+typedef struct signbatch {
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	isc_stdtime_t inception;
+	isc_stdtime_t expire;
+	signjob_t **jobs;
+	size_t njobs;
+	size_t size;
+	atomic_size_t next;
+
+	/* Locked by lock */
+	isc_mutex_t lock;
+	isc_condition_t cond;
+	size_t completed;
+} signbatch_t;
+
+/*%
+ * Don't start a worker for less than this many signatures.
+ */
+#define SIGNBATCH_MINJOBS 8
+
+#define NSEC3CHAIN_LOOKAHEAD 32
+
+/*%
+ * Number of RRsets zone_resigninc() fetches from the database at a time.
+ */
+#define RESIGN_BATCH 64
+
 struct dns_nsec3chain {
 	unsigned int magic;
 	dns_db_t *db;
@@ -744,6 +848,13 @@ struct dns_nsec3chain {
 	bool seen_nsec;
 	bool delete_nsec;
 	bool save_delete_nsec;
+	struct {
+		dns_fixedname_t name;
+		unsigned char hash[NSEC3_MAX_HASH_LENGTH];
+	} lookahead[NSEC3CHAIN_LOOKAHEAD];
+	size_t hash_length;
+	unsigned int nlookahead;
+	unsigned int nextlookahead;
 	ISC_LINK(dns_nsec3chain_t) link;
 };
 
@@ -767,6 +878,11 @@ struct dns_nsec3chain {
  *
  * 'save_delete_nsec' is used to store the initial state of 'delete_nsec'
  * so it can be recovered in the event of a error.
+ *
+ * 'lookahead' holds the names at and after the iterator position, up to
+ * 'nlookahead' of them, together with their hashes for the new chain,
+ * which are computed together by nsec3chain_hash().  'nextlookahead' is
+ * the first entry not yet used.
  */
 
 struct dns_keyfetch {
@@ -778,6 +894,16 @@ struct dns_keyfetch {
 	dns_zone_t *zone;
 	dns_db_t *db;
 	dns_fetch_t *fetch;
+	isc_result_t result;
+
+	/*
+	 * Key fetches for the same trust anchor name in other views'
+	 * key zones wait for this one and share its result; see
+	 * keyfetch_join().  Locked by zmgr->keyfetchlock.
+	 */
+	dns_zonemgr_t *zmgr;
+	ISC_LIST(dns_keyfetch_t) waiters;
+	ISC_LINK(dns_keyfetch_t) link;
 };
 
 struct dns_nsfetch {
@@ -824,12 +950,7 @@ unsigned int dns_zone_mkey_month = MONTH;
 #define SEND_BUFFER_SIZE 2048
 
 static void
-zone_timer_set(dns_zone_t *zone, isc_time_t *next, isc_time_t *now);
-
-typedef struct zone_settimer {
-	dns_zone_t *zone;
-	isc_time_t now;
-} zone_settimer_t;
+zone_timer_set(dns_zone_t *zone, isc_time_t *next);
 
 static void
 zone_settimer(dns_zone_t *, isc_time_t *);
@@ -852,6 +973,8 @@ update_one_rr(dns_db_t *db, dns_dbversion_t *ver, dns_diff_t *diff,
 	      dns_rdata_t *rdata);
 static void
 zone_unload(dns_zone_t *zone);
+static isc_stdtime_t
+zone_idletime(dns_zone_t *zone);
 static void
 zone_expire(dns_zone_t *zone);
 static void
@@ -945,6 +1068,8 @@ zmgr_start_xfrin_ifquota(dns_zonemgr_t *zmgr, dns_zone_t *zone);
 static void
 zmgr_resume_xfrs(dns_zonemgr_t *zmgr, bool multi);
 static void
+zmgr_unlink_xfrin(dns_zonemgr_t *zmgr, dns_zone_t *zone);
+static void
 zonemgr_free(dns_zonemgr_t *zmgr);
 static void
 rss_post(void *arg);
@@ -983,6 +1108,14 @@ static void
 setrl(isc_ratelimiter_t *rl, unsigned int *rate, unsigned int value);
 static void
 zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial);
+static void
+zone_journal_flush(dns_zone_t *zone);
+static void
+zone_journal_compact_log(dns_zone_t *zone, isc_result_t result);
+static void
+zone_journal_compact_work(void *arg);
+static void
+zone_journal_compact_done(void *arg);
 static isc_result_t
 zone_journal_rollforward(dns_zone_t *zone, dns_db_t *db, bool *needdump,
 			 bool *fixjournal);
@@ -1057,6 +1190,27 @@ struct np3 {
 	ISC_LINK(struct np3) link;
 };
 
+struct journalcompact {
+	dns_zone_t *zone;
+	char *journal;
+	uint32_t serial;
+	int32_t journalsize;
+	dns_journalcompact_t *compact;
+	isc_result_t result;
+};
+
+struct journalwrite {
+	dns_diff_t diff;
+	dns_journaldonefunc_t done;
+	void *arg;
+	ISC_LINK(struct journalwrite) link;
+};
+
+struct queuedupdate {
+	void *arg;
+	ISC_LINK(struct queuedupdate) link;
+};
+
 struct setserial {
 	dns_zone_t *zone;
 	uint32_t serial;
@@ -1140,6 +1294,8 @@ dns_zone_create(dns_zone_t **zonep, isc_mem_t *mctx, unsigned int tid) {
 		.signing = ISC_LIST_INITIALIZER,
 		.nsec3chain = ISC_LIST_INITIALIZER,
 		.setnsec3param_queue = ISC_LIST_INITIALIZER,
+		.journalwrites = ISC_LIST_INITIALIZER,
+		.queuedupdates = ISC_LIST_INITIALIZER,
 		.forwards = ISC_LIST_INITIALIZER,
 		.link = ISC_LINK_INITIALIZER,
 		.statelink = ISC_LINK_INITIALIZER,
@@ -1200,7 +1356,7 @@ zone_free(dns_zone_t *zone) {
 
 	REQUIRE(DNS_ZONE_VALID(zone));
 	REQUIRE(!LOCKED_ZONE(zone));
-	REQUIRE(zone->timer == NULL);
+	REQUIRE(zone->timer_index == 0);
 	REQUIRE(zone->zmgr == NULL);
 
 	isc_refcount_destroy(&zone->references);
@@ -1215,6 +1371,8 @@ zone_free(dns_zone_t *zone) {
 	INSIST(zone->statelist == NULL);
 	INSIST(zone->view == NULL);
 	INSIST(zone->prev_view == NULL);
+	INSIST(ISC_LIST_EMPTY(zone->journalwrites));
+	INSIST(ISC_LIST_EMPTY(zone->queuedupdates));
 
 	/* Unmanaged objects */
 	for (struct np3 *npe = ISC_LIST_HEAD(zone->setnsec3param_queue);
@@ -1901,6 +2059,8 @@ dns_zone_rpz_enable_db(dns_zone_t *zone, dns_db_t *db) {
 		return;
 	}
 	REQUIRE(zone->rpzs != NULL);
+	dns_rpz_zone_setjournal(zone->rpzs->zones[zone->rpz_num],
+				zone->journal);
 	dns_rpz_dbupdate_register(db, zone->rpzs->zones[zone->rpz_num]);
 }
 
@@ -3588,6 +3748,8 @@ zone_addnsec3chain(dns_zone_t *zone, dns_rdata_nsec3param_t *nsec3param) {
 	nsec3chain->seen_nsec = false;
 	nsec3chain->delete_nsec = false;
 	nsec3chain->save_delete_nsec = false;
+	nsec3chain->nlookahead = 0;
+	nsec3chain->nextlookahead = 0;
 
 	/*
 	 * Log NSEC3 parameters defined by supplied NSEC3PARAM RDATA.
@@ -4357,6 +4519,15 @@ zone_journal(dns_zone_t *zone, dns_diff_t *diff, uint32_t *sourceserial,
 	unsigned int mode = DNS_JOURNAL_CREATE | DNS_JOURNAL_WRITE;
 
 	ENTER;
+
+	/*
+	 * Transactions queued for a group commit come first.  The queue
+	 * is only touched from the zone's loop, so peeking is safe.
+	 */
+	if (!ISC_LIST_EMPTY(zone->journalwrites)) {
+		zone_journal_flush(zone);
+	}
+
 	journalfile = dns_zone_getjournal(zone);
 	if (journalfile != NULL) {
 		result = dns_journal_open(zone->mctx, journalfile, mode,
@@ -4384,6 +4555,198 @@ zone_journal(dns_zone_t *zone, dns_diff_t *diff, uint32_t *sourceserial,
 	return (result);
 }
 
+/*
+ * Write all queued dynamic update transactions to the journal with a
+ * single group commit, and tell their submitters the outcome.
+ */
+static void
+zone_journal_flush(dns_zone_t *zone) {
+	ISC_LIST(struct journalwrite) writes = ISC_LIST_INITIALIZER;
+	struct journalwrite *jw = NULL, *next = NULL;
+	dns_diff_t **diffs = NULL;
+	dns_journal_t *journal = NULL;
+	const char *journalfile = NULL;
+	unsigned int n, i = 0;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	LOCK_ZONE(zone);
+	ISC_LIST_MOVE(writes, zone->journalwrites);
+	n = zone->njournalwrites;
+	zone->njournalwrites = 0;
+	UNLOCK_ZONE(zone);
+
+	if (n == 0) {
+		return;
+	}
+
+	journalfile = dns_zone_getjournal(zone);
+	if (journalfile != NULL) {
+		diffs = isc_mem_cget(zone->mctx, n, sizeof(diffs[0]));
+		ISC_LIST_FOREACH (writes, jw, link) {
+			diffs[i++] = &jw->diff;
+		}
+		INSIST(i == n);
+
+		result = dns_journal_open(zone->mctx, journalfile,
+					  DNS_JOURNAL_CREATE, &journal);
+		if (result == ISC_R_SUCCESS) {
+			result = dns_journal_write_transactions(journal, diffs,
+								n);
+			dns_journal_destroy(&journal);
+		}
+		isc_mem_cput(zone->mctx, diffs, n, sizeof(diffs[0]));
+	}
+
+	if (result == ISC_R_SUCCESS) {
+		dns_zone_log(zone, ISC_LOG_DEBUG(3),
+			     "journal group commit of %u transactions", n);
+	} else {
+		/*
+		 * The changes are already in the in-memory database,
+		 * so the journal can no longer be used to bring the
+		 * zone up-to-date.  Remove it and get the changes onto
+		 * disk by dumping the zone instead.
+		 */
+		dns_zone_log(zone, ISC_LOG_ERROR,
+			     "journal group commit of %u transactions "
+			     "failed: %s",
+			     n, isc_result_totext(result));
+		if (remove(journalfile) < 0 && errno != ENOENT) {
+			char strbuf[ISC_STRERRORSIZE];
+			strerror_r(errno, strbuf, sizeof(strbuf));
+			dns_zone_log(zone, ISC_LOG_WARNING,
+				     "unable to remove journal '%s': '%s'",
+				     journalfile, strbuf);
+		}
+		LOCK_ZONE(zone);
+		zone_needdump(zone, 0);
+		UNLOCK_ZONE(zone);
+	}
+
+	ISC_LIST_FOREACH_SAFE (writes, jw, link, next) {
+		ISC_LIST_UNLINK(writes, jw, link);
+		dns_diff_clear(&jw->diff);
+		(jw->done)(jw->arg, result);
+		isc_mem_put(zone->mctx, jw, sizeof(*jw));
+	}
+
+	/*
+	 * Only now that the group is in the journal may secondaries
+	 * (and an inline-signing secure zone) be told about it.
+	 */
+	dns_zone_markdirty(zone);
+	dns_zone_notify(zone);
+}
+
+static void
+zone_journal_group(void *arg) {
+	dns_zone_t *zone = arg;
+
+	zone_journal_flush(zone);
+	dns_zone_idetach(&zone);
+}
+
+void
+dns_zone_journalcommit(dns_zone_t *zone, dns_diff_t *diff,
+		       dns_journaldonefunc_t done, void *arg) {
+	struct journalwrite *jw = NULL;
+	bool flush = false;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(DNS_DIFF_VALID(diff));
+	REQUIRE(done != NULL);
+	REQUIRE(zone->tid == isc_tid());
+
+	jw = isc_mem_get(zone->mctx, sizeof(*jw));
+	*jw = (struct journalwrite){
+		.done = done,
+		.arg = arg,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	dns_diff_init(zone->mctx, &jw->diff);
+	ISC_LIST_APPENDLIST(jw->diff.tuples, diff->tuples, link);
+
+	LOCK_ZONE(zone);
+	if (zone->njournalwrites++ == 0) {
+		/*
+		 * The group is closed by a job queued behind everything
+		 * that is already waiting to run on the zone's loop,
+		 * which includes any other pending updates.
+		 */
+		zone_iattach(zone, &(dns_zone_t *){ NULL });
+		isc_async_run(zone->loop, zone_journal_group, zone);
+	}
+	ISC_LIST_APPEND(zone->journalwrites, jw, link);
+	flush = (zone->njournalwrites >= DNS_JOURNAL_GROUP_MAX);
+	UNLOCK_ZONE(zone);
+
+	if (flush) {
+		zone_journal_flush(zone);
+	}
+}
+
+/*
+ * Hand the queued dynamic updates to the batch function, at most
+ * DNS_UPDATE_BATCH_MAX at a time.
+ */
+static void
+zone_update_batch(void *arg) {
+	dns_zone_t *zone = arg;
+	ISC_LIST(struct queuedupdate) queue = ISC_LIST_INITIALIZER;
+	struct queuedupdate *qu = NULL;
+	dns_zonebatchfunc_t func = NULL;
+	void *args[DNS_UPDATE_BATCH_MAX];
+
+	LOCK_ZONE(zone);
+	ISC_LIST_MOVE(queue, zone->queuedupdates);
+	zone->nqueuedupdates = 0;
+	func = zone->batchfunc;
+	UNLOCK_ZONE(zone);
+
+	while (!ISC_LIST_EMPTY(queue)) {
+		size_t n = 0;
+
+		while (n < DNS_UPDATE_BATCH_MAX &&
+		       (qu = ISC_LIST_HEAD(queue)) != NULL)
+		{
+			ISC_LIST_UNLINK(queue, qu, link);
+			args[n++] = qu->arg;
+			isc_mem_put(zone->mctx, qu, sizeof(*qu));
+		}
+		(func)(zone, args, n);
+	}
+
+	dns_zone_idetach(&zone);
+}
+
+void
+dns_zone_queueupdate(dns_zone_t *zone, dns_zonebatchfunc_t func, void *arg) {
+	struct queuedupdate *qu = NULL;
+
+	REQUIRE(DNS_ZONE_VALID(zone));
+	REQUIRE(func != NULL);
+
+	qu = isc_mem_get(zone->mctx, sizeof(*qu));
+	*qu = (struct queuedupdate){
+		.arg = arg,
+		.link = ISC_LINK_INITIALIZER,
+	};
+
+	LOCK_ZONE(zone);
+	INSIST(zone->nqueuedupdates == 0 || zone->batchfunc == func);
+	if (zone->nqueuedupdates++ == 0) {
+		/*
+		 * Everything queued before the batch job gets to run on
+		 * the zone's loop is handled by it.
+		 */
+		zone->batchfunc = func;
+		zone_iattach(zone, &(dns_zone_t *){ NULL });
+		isc_async_run(zone->loop, zone_update_batch, zone);
+	}
+	ISC_LIST_APPEND(zone->queuedupdates, qu, link);
+	UNLOCK_ZONE(zone);
+}
+
 /*
  * Create an SOA record for a newly-created zone
  */
@@ -5135,6 +5498,7 @@ zone_postload(dns_zone_t *zone, dns_db_t *db, isc_time_t loadtime,
 		ZONEDB_UNLOCK(&zone->dblock, isc_rwlocktype_write);
 		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_LOADED |
 					       DNS_ZONEFLG_NEEDSTARTUPNOTIFY);
+		atomic_store_relaxed(&zone->lastaccess, isc_stdtime_now());
 		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_SENDSECURE) &&
 		    inline_raw(zone))
 		{
@@ -6040,6 +6404,29 @@ dns_zone_getdb(dns_zone_t *zone, dns_db_t **dpb) {
 	return (result);
 }
 
+void
+dns_zone_touch(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_LOADONDEMAND)) {
+		return;
+	}
+
+	/*
+	 * Only write the access time once a second, so that a busy
+	 * zone's cache line is not written by every query; this also
+	 * limits how often a zone that fails to load is retried.
+	 */
+	isc_stdtime_t now = isc_stdtime_now();
+	if (atomic_exchange_relaxed(&zone->lastaccess, now) == now) {
+		return;
+	}
+
+	if (!DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED)) {
+		(void)dns_zone_asyncload(zone, false, NULL, NULL);
+	}
+}
+
 void
 dns_zone_setdb(dns_zone_t *zone, dns_db_t *db) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -6917,9 +7304,8 @@ zone_resigninc(dns_zone_t *zone) {
 	dns_dbversion_t *version = NULL;
 	dns_diff_t _sig_diff;
 	dns__zonediff_t zonediff;
-	dns_fixedname_t fixed;
+	dns_dbsigning_t *entries = NULL;
 	dns_name_t *name;
-	dns_rdataset_t rdataset;
 	dns_rdatatype_t covers;
 	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
 	isc_result_t result;
@@ -6928,10 +7314,11 @@ zone_resigninc(dns_zone_t *zone) {
 	unsigned int i;
 	unsigned int nkeys = 0;
 	unsigned int resign;
+	size_t count = 0;
+	bool done = false;
 
 	ENTER;
 
-	dns_rdataset_init(&rdataset);
 	dns_diff_init(zone->mctx, &_sig_diff);
 	zonediff_init(&zonediff, &_sig_diff);
 
@@ -7006,69 +7393,79 @@ zone_resigninc(dns_zone_t *zone) {
 	}
 	stop = now + 5;
 
-	name = dns_fixedname_initname(&fixed);
-	result = dns_db_getsigningtime(db, &rdataset, name);
-	if (result != ISC_R_SUCCESS && result != ISC_R_NOTFOUND) {
-		dns_zone_log(zone, ISC_LOG_ERROR,
-			     "zone_resigninc:dns_db_getsigningtime -> %s",
-			     isc_result_totext(result));
-	}
-
+	/*
+	 * Fetch the RRsets that are due in batches, rather than looking
+	 * up the earliest one again after each is re-signed.
+	 */
+	entries = isc_mem_cget(zone->mctx, RESIGN_BATCH, sizeof(entries[0]));
 	i = 0;
-	while (result == ISC_R_SUCCESS) {
-		resign = rdataset.resign -
-			 dns_zone_getsigresigninginterval(zone);
-		covers = rdataset.covers;
-		dns_rdataset_disassociate(&rdataset);
-
-		/*
-		 * Stop if we hit the SOA as that means we have walked the
-		 * entire zone.  The SOA record should always be the most
-		 * recent signature.
-		 */
-		/* XXXMPA increase number of RRsets signed pre call */
-		if ((covers == dns_rdatatype_soa &&
-		     dns_name_equal(name, &zone->origin)) ||
-		    i++ > zone->signatures || resign > stop)
-		{
+	while (!done) {
+		count = RESIGN_BATCH;
+		result = dns_db_getsigningtimes(
+			db, stop + dns_zone_getsigresigninginterval(zone),
+			entries, &count);
+		if (nkeys == 0 && i > 0 && result == ISC_R_NOTFOUND) {
+			result = ISC_R_SUCCESS;
 			break;
 		}
-
-		result = del_sigs(zone, db, version, name, covers, &zonediff,
-				  zone_keys, nkeys, now, true);
 		if (result != ISC_R_SUCCESS) {
-			dns_zone_log(zone, ISC_LOG_ERROR,
-				     "zone_resigninc:del_sigs -> %s",
-				     isc_result_totext(result));
+			if (i > 0 || result != ISC_R_NOTFOUND) {
+				dns_zone_log(zone, ISC_LOG_ERROR,
+					     "zone_resigninc:"
+					     "dns_db_getsigningtimes -> %s",
+					     isc_result_totext(result));
+			}
 			break;
 		}
 
-		/*
-		 * If re-signing is over 5 minutes late use 'fullexpire'
-		 * to redistribute the signature over the complete
-		 * re-signing window, otherwise only add a small amount
-		 * of jitter.
-		 */
-		result = add_sigs(db, version, name, zone, covers,
-				  zonediff.diff, zone_keys, nkeys, zone->mctx,
-				  now, inception,
-				  resign > (now - 300) ? expire : fullexpire);
-		if (result != ISC_R_SUCCESS) {
-			dns_zone_log(zone, ISC_LOG_ERROR,
-				     "zone_resigninc:add_sigs -> %s",
-				     isc_result_totext(result));
-			break;
-		}
-		result = dns_db_getsigningtime(db, &rdataset, name);
-		if (nkeys == 0 && result == ISC_R_NOTFOUND) {
-			result = ISC_R_SUCCESS;
-			break;
-		}
-		if (result != ISC_R_SUCCESS) {
-			dns_zone_log(zone, ISC_LOG_ERROR,
-				     "zone_resigninc:dns_db_getsigningtime -> "
-				     "%s",
-				     isc_result_totext(result));
+		for (size_t j = 0; j < count; j++) {
+			name = dns_fixedname_name(&entries[j].name);
+			resign = entries[j].resign -
+				 dns_zone_getsigresigninginterval(zone);
+			covers = entries[j].covers;
+
+			/*
+			 * Stop if we hit the SOA as that means we have walked
+			 * the entire zone.  The SOA record should always be
+			 * the most recent signature.
+			 */
+			if ((covers == dns_rdatatype_soa &&
+			     dns_name_equal(name, &zone->origin)) ||
+			    i++ > zone->signatures || resign > stop)
+			{
+				done = true;
+				break;
+			}
+
+			result = del_sigs(zone, db, version, name, covers,
+					  &zonediff, zone_keys, nkeys, now,
+					  true);
+			if (result != ISC_R_SUCCESS) {
+				dns_zone_log(zone, ISC_LOG_ERROR,
+					     "zone_resigninc:del_sigs -> %s",
+					     isc_result_totext(result));
+				done = true;
+				break;
+			}
+
+			/*
+			 * If re-signing is over 5 minutes late use
+			 * 'fullexpire' to redistribute the signature over
+			 * the complete re-signing window, otherwise only
+			 * add a small amount of jitter.
+			 */
+			result = add_sigs(db, version, name, zone, covers,
+					  zonediff.diff, zone_keys, nkeys,
+					  zone->mctx, now, inception,
+					  resign > (now - 300) ? expire
+							       : fullexpire);
+			if (result != ISC_R_SUCCESS) {
+				dns_zone_log(zone, ISC_LOG_ERROR,
+					     "zone_resigninc:add_sigs -> %s",
+					     isc_result_totext(result));
+				done = true;
+				break;
+			}
 		}
 	}
 
@@ -7129,6 +7526,10 @@ zone_resigninc(dns_zone_t *zone) {
 	dns_db_closeversion(db, &version, true);
 
 failure:
+	if (entries != NULL) {
+		isc_mem_cput(zone->mctx, entries, RESIGN_BATCH,
+			     sizeof(entries[0]));
+	}
 	dns_diff_clear(&_sig_diff);
 	for (i = 0; i < nkeys; i++) {
 		dst_key_free(&zone_keys[i]);
@@ -7344,13 +7745,207 @@ failure:
 	return (result);
 }
 
+static void
+signbatch_create(isc_mem_t *mctx, isc_stdtime_t inception,
+		 isc_stdtime_t expire, signbatch_t **batchp) {
+	signbatch_t *batch = isc_mem_get(mctx, sizeof(*batch));
+
+	*batch = (signbatch_t){
+		.inception = inception,
+		.expire = expire,
+	};
+	isc_mem_attach(mctx, &batch->mctx);
+	isc_refcount_init(&batch->references, 1);
+	atomic_init(&batch->next, 0);
+	isc_mutex_init(&batch->lock);
+	isc_condition_init(&batch->cond);
+
+	*batchp = batch;
+}
+
+static void
+signbatch_destroy(signbatch_t *batch) {
+	isc_refcount_destroy(&batch->references);
+	isc_condition_destroy(&batch->cond);
+	isc_mutex_destroy(&batch->lock);
+	for (size_t i = 0; i < batch->njobs; i++) {
+		isc_mem_put(batch->mctx, batch->jobs[i],
+			    sizeof(*batch->jobs[i]));
+	}
+	if (batch->jobs != NULL) {
+		isc_mem_cput(batch->mctx, batch->jobs, batch->size,
+			     sizeof(batch->jobs[0]));
+	}
+	isc_mem_putanddetach(&batch->mctx, batch, sizeof(*batch));
+}
+
+static void
+signbatch_detach(signbatch_t **batchp) {
+	signbatch_t *batch = *batchp;
+
+	*batchp = NULL;
+	if (isc_refcount_decrement(&batch->references) == 1) {
+		signbatch_destroy(batch);
+	}
+}
+
+/*
+ * Release the rdatasets held by the batch and detach from it.  This
+ * must be called on the zone's loop before the zone version is closed;
+ * a worker that has not run yet can still hold a reference to the
+ * batch, but it won't touch the jobs anymore.
+ */
+static void
+signbatch_release(signbatch_t **batchp) {
+	signbatch_t *batch = *batchp;
+
+	for (size_t i = 0; i < batch->njobs; i++) {
+		if (dns_rdataset_isassociated(&batch->jobs[i]->rdataset)) {
+			dns_rdataset_disassociate(&batch->jobs[i]->rdataset);
+		}
+	}
+
+	signbatch_detach(batchp);
+}
+
+static void
+signbatch_add(signbatch_t *batch, const dns_name_t *name,
+	      dns_rdataset_t *rdataset, dst_key_t *key) {
+	signjob_t *job = NULL;
+
+	if (batch->njobs == batch->size) {
+		size_t size = (batch->size == 0) ? 64 : batch->size * 2;
+		batch->jobs = isc_mem_creget(batch->mctx, batch->jobs,
+					     batch->size, size,
+					     sizeof(batch->jobs[0]));
+		batch->size = size;
+	}
+
+	job = isc_mem_get(batch->mctx, sizeof(*job));
+	batch->jobs[batch->njobs++] = job;
+	*job = (signjob_t){
+		.key = key,
+		.result = ISC_R_UNSET,
+		.rdata = DNS_RDATA_INIT,
+	};
+	job->name = dns_fixedname_initname(&job->fname);
+	dns_name_copy(name, job->name);
+	dns_rdataset_init(&job->rdataset);
+	dns_rdataset_clone(rdataset, &job->rdataset);
+}
+
+/*
+ * Compute the queued signatures until there are none left.  This runs
+ * both on the zone's loop and on the isc_work threads.
+ */
+static void
+signbatch_work(void *arg) {
+	signbatch_t *batch = arg;
+	size_t i;
+
+	while ((i = atomic_fetch_add_relaxed(&batch->next, 1)) < batch->njobs)
+	{
+		signjob_t *job = batch->jobs[i];
+		isc_stdtime_t inception = batch->inception;
+		isc_stdtime_t expire = batch->expire;
+		isc_buffer_t buffer;
+
+		isc_buffer_init(&buffer, job->data, sizeof(job->data));
+		job->result = dns_dnssec_sign(job->name, &job->rdataset,
+					      job->key, &inception, &expire,
+					      batch->mctx, &buffer,
+					      &job->rdata);
+
+		LOCK(&batch->lock);
+		if (++batch->completed == batch->njobs) {
+			SIGNAL(&batch->cond);
+		}
+		UNLOCK(&batch->lock);
+	}
+}
+
+static void
+signbatch_done(void *arg) {
+	signbatch_t *batch = arg;
+
+	signbatch_detach(&batch);
+}
+
+/*
+ * Compute all the queued signatures, using up to one isc_work worker
+ * per CPU besides the zone's loop, which takes part too; so the batch
+ * completes even when the workers don't get to run.
+ */
+static void
+signbatch_run(signbatch_t *batch, isc_loop_t *loop) {
+	size_t nworkers = batch->njobs / SIGNBATCH_MINJOBS;
+
+	if (batch->njobs == 0) {
+		return;
+	}
+
+	nworkers = ISC_MIN(nworkers, isc_os_ncpus() - 1);
+	for (size_t i = 0; i < nworkers; i++) {
+		isc_refcount_increment(&batch->references);
+		isc_work_enqueueclass(loop, isc_workclass_bulk,
+				      signbatch_work, signbatch_done, batch);
+	}
+
+	signbatch_work(batch);
+
+	LOCK(&batch->lock);
+	while (batch->completed < batch->njobs) {
+		WAIT(&batch->cond, &batch->lock);
+	}
+	UNLOCK(&batch->lock);
+}
+
+/*
+ * Add the computed signatures to the database and journal, in order.
+ */
+static isc_result_t
+signbatch_apply(signbatch_t *batch, dns_zone_t *zone, dns_db_t *db,
+		dns_dbversion_t *version, dns_diff_t *diff) {
+	isc_result_t result = ISC_R_SUCCESS;
+	dns_stats_t *dnssecsignstats = dns_zone_getdnssecsignstats(zone);
+
+	for (size_t i = 0; i < batch->njobs; i++) {
+		signjob_t *job = batch->jobs[i];
+
+		CHECK(job->result);
+
+		/* XXX inefficient - will cause dataset merging */
+		CHECK(update_one_rr(db, version, diff, DNS_DIFFOP_ADDRESIGN,
+				    job->name, job->rdataset.ttl,
+				    &job->rdata));
+		dns_rdataset_disassociate(&job->rdataset);
+
+		/* Update DNSSEC sign statistics. */
+		if (dnssecsignstats != NULL) {
+			/* Generated a new signature. */
+			dns_dnssecsignstats_increment(dnssecsignstats,
+						      ID(job->key),
+						      ALG(job->key),
+						      dns_dnssecsignstats_sign);
+			/* This is a refresh. */
+			dns_dnssecsignstats_increment(
+				dnssecsignstats, ID(job->key), ALG(job->key),
+				dns_dnssecsignstats_refresh);
+		}
+	}
+
+failure:
+	return (result);
+}
+
 static isc_result_t
 sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 	    dns_dbnode_t *node, dns_dbversion_t *version, bool build_nsec3,
 	    bool build_nsec, dst_key_t *key, isc_stdtime_t now,
 	    isc_stdtime_t inception, isc_stdtime_t expire, dns_ttl_t nsecttl,
 	    bool both, bool is_ksk, bool is_zsk, bool is_bottom_of_zone,
-	    dns_diff_t *diff, int32_t *signatures, isc_mem_t *mctx) {
+	    dns_diff_t *diff, int32_t *signatures, signbatch_t *batch,
+	    isc_mem_t *mctx) {
 	isc_result_t result;
 	dns_rdatasetiter_t *iterator = NULL;
 	dns_rdataset_t rdataset;
@@ -7462,6 +8057,16 @@ sign_a_node(dns_db_t *db, dns_zone_t *zone, dns_name_t *name,
 			goto next_rdataset;
 		}
 
+		if (batch != NULL) {
+			/*
+			 * Queue the signature; it is added to the database
+			 * and journal by signbatch_apply().
+			 */
+			signbatch_add(batch, name, &rdataset, key);
+			(*signatures)--;
+			goto next_rdataset;
+		}
+
 		/* Calculate the signature, creating a RRSIG RDATA. */
 		isc_buffer_clear(&buffer);
 		CHECK(dns_dnssec_sign(name, &rdataset, key, &inception, &expire,
@@ -8116,6 +8721,78 @@ dns__zone_updatesigs(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *version,
  * Incrementally build and sign a new NSEC3 chain using the parameters
  * requested.
  */
+/*%
+ * Return the hash of 'name' for the NSEC3 chain being built by
+ * 'nsec3chain'.  When it has not been computed yet, the hashes of
+ * 'name' and of the names following it in the zone are all computed at
+ * once.  Returns NULL if that fails, in which case the caller should
+ * hash 'name' itself.
+ */
+static const unsigned char *
+nsec3chain_hash(dns_db_t *db, dns_nsec3chain_t *nsec3chain,
+		const dns_name_t *name) {
+	const dns_name_t *names[NSEC3CHAIN_LOOKAHEAD];
+	unsigned char *hashes[NSEC3CHAIN_LOOKAHEAD];
+	dns_dbiterator_t *dbit = NULL;
+	dns_dbnode_t *node = NULL;
+	isc_result_t result;
+	unsigned int n = 0;
+
+	while (nsec3chain->nextlookahead < nsec3chain->nlookahead) {
+		unsigned int i = nsec3chain->nextlookahead;
+		int order = dns_name_compare(
+			dns_fixedname_name(&nsec3chain->lookahead[i].name),
+			name);
+		if (order == 0) {
+			return (nsec3chain->lookahead[i].hash);
+		} else if (order > 0) {
+			break;
+		}
+		nsec3chain->nextlookahead++;
+	}
+
+	nsec3chain->nlookahead = 0;
+	nsec3chain->nextlookahead = 0;
+
+	result = dns_db_createiterator(db, DNS_DB_NONSEC3, &dbit);
+	if (result != ISC_R_SUCCESS) {
+		return (NULL);
+	}
+	for (result = dns_dbiterator_seek(dbit, name);
+	     result == ISC_R_SUCCESS && n < NSEC3CHAIN_LOOKAHEAD;
+	     result = dns_dbiterator_next(dbit))
+	{
+		dns_name_t *found =
+			dns_fixedname_initname(&nsec3chain->lookahead[n].name);
+
+		result = dns_dbiterator_current(dbit, &node, found);
+		if (result != ISC_R_SUCCESS) {
+			break;
+		}
+		dns_db_detachnode(db, &node);
+		names[n] = found;
+		hashes[n] = nsec3chain->lookahead[n].hash;
+		n++;
+	}
+	dns_dbiterator_destroy(&dbit);
+
+	if (n == 0 || !dns_name_equal(names[0], name)) {
+		return (NULL);
+	}
+
+	result = dns_nsec3_hashnames(
+		hashes, &nsec3chain->hash_length, names, n,
+		nsec3chain->nsec3param.hash, nsec3chain->nsec3param.iterations,
+		nsec3chain->nsec3param.salt,
+		nsec3chain->nsec3param.salt_length);
+	if (result != ISC_R_SUCCESS) {
+		return (NULL);
+	}
+
+	nsec3chain->nlookahead = n;
+	return (nsec3chain->lookahead[0].hash);
+}
+
 static void
 zone_nsec3chain(dns_zone_t *zone) {
 	dns_db_t *db = NULL;
@@ -8149,6 +8826,7 @@ zone_nsec3chain(dns_zone_t *zone) {
 	bool buildnsecchain;
 	bool updatensec = false;
 	dns_rdatatype_t privatetype = zone->privatetype;
+	const unsigned char *nsec3hash = NULL;
 
 	ENTER;
 
@@ -8384,9 +9062,11 @@ zone_nsec3chain(dns_zone_t *zone) {
 		 * Process one node.
 		 */
 		dns_dbiterator_pause(nsec3chain->dbiterator);
-		result = dns_nsec3_addnsec3(
-			db, version, name, &nsec3chain->nsec3param,
-			zone_nsecttl(zone), unsecure, &nsec3_diff);
+		nsec3hash = nsec3chain_hash(db, nsec3chain, name);
+		result = dns_nsec3_addnsec3hashed(
+			db, version, name, &nsec3chain->nsec3param, nsec3hash,
+			nsec3chain->hash_length, zone_nsecttl(zone), unsecure,
+			&nsec3_diff);
 		if (result != ISC_R_SUCCESS) {
 			dnssec_log(zone, ISC_LOG_ERROR,
 				   "zone_nsec3chain:"
@@ -9228,6 +9908,7 @@ zone_sign(dns_zone_t *zone) {
 	dns_rdataset_t rdataset;
 	dns_signing_t *signing, *nextsigning;
 	dns_signinglist_t cleanup;
+	signbatch_t *batch = NULL;
 	dst_key_t *zone_keys[DNS_MAXZONEKEYS];
 	int32_t signatures;
 	bool is_ksk, is_zsk;
@@ -9319,6 +10000,8 @@ zone_sign(dns_zone_t *zone) {
 		expire = soaexpire - 1;
 	}
 
+	signbatch_create(zone->mctx, inception, expire, &batch);
+
 	/*
 	 * We keep pulling nodes off each iterator in turn until
 	 * we have no more nodes to pull off or we reach the limits
@@ -9543,12 +10226,18 @@ zone_sign(dns_zone_t *zone) {
 				continue;
 			}
 
+			/*
+			 * When deleting, whether a key still has to sign an
+			 * RRset depends on the signatures made by the other
+			 * keys for the same node, so sign inline.
+			 */
 			CHECK(sign_a_node(
 				db, zone, name, node, version, build_nsec3,
 				build_nsec, zone_keys[i], now, inception,
 				expire, zone_nsecttl(zone), both, is_ksk,
 				is_zsk, is_bottom_of_zone, zonediff.diff,
-				&signatures, zone->mctx));
+				&signatures, signing->deleteit ? NULL : batch,
+				zone->mctx));
 			/*
 			 * If we are adding we are done.  Look for other keys
 			 * of the same algorithm if deleting.
@@ -9633,6 +10322,20 @@ zone_sign(dns_zone_t *zone) {
 		first = true;
 	}
 
+	/*
+	 * Generate the signatures queued for the nodes visited above and
+	 * add them to the new version.
+	 */
+	signbatch_run(batch, zone->loop);
+	result = signbatch_apply(batch, zone, db, version, zonediff.diff);
+	if (result != ISC_R_SUCCESS) {
+		dnssec_log(zone, ISC_LOG_ERROR,
+			   "zone_sign:signbatch_apply -> %s",
+			   isc_result_totext(result));
+		goto cleanup;
+	}
+	signbatch_release(&batch);
+
 	if (ISC_LIST_HEAD(post_diff.tuples) != NULL) {
 		result = dns__zone_updatesigs(&post_diff, db, version,
 					      zone_keys, nkeys, zone, inception,
@@ -9772,6 +10475,10 @@ cleanup:
 		dns_db_detachnode(db, &node);
 	}
 
+	if (batch != NULL) {
+		signbatch_release(&batch);
+	}
+
 	if (version != NULL) {
 		dns_db_closeversion(db, &version, false);
 		dns_db_detach(&db);
@@ -10077,10 +10784,8 @@ revocable(dns_keyfetch_t *kfetch, dns_rdata_keydata_t *keydata) {
  * local trust anchors according to RFC5011.
  */
 static void
-keyfetch_done(void *arg) {
-	dns_fetchresponse_t *resp = (dns_fetchresponse_t *)arg;
+keyfetch_process(dns_keyfetch_t *kfetch) {
 	isc_result_t result, eresult;
-	dns_keyfetch_t *kfetch = NULL;
 	dns_zone_t *zone = NULL;
 	isc_mem_t *mctx = NULL;
 	dns_keytable_t *secroots = NULL;
@@ -10108,12 +10813,6 @@ keyfetch_done(void *arg) {
 	dns_rdataset_t *dnskeys = NULL, *dnskeysigs = NULL;
 	dns_rdataset_t *keydataset = NULL, dsset;
 
-	INSIST(resp != NULL);
-
-	kfetch = resp->arg;
-
-	INSIST(kfetch != NULL);
-
 	zone = kfetch->zone;
 	mctx = kfetch->mctx;
 	keyname = dns_fixedname_name(&kfetch->name);
@@ -10121,17 +10820,7 @@ keyfetch_done(void *arg) {
 	dnskeysigs = &kfetch->dnskeysigset;
 	keydataset = &kfetch->keydataset;
 
-	eresult = resp->result;
-
-	/* Free resources which are not of interest */
-	if (resp->node != NULL) {
-		dns_db_detachnode(resp->db, &resp->node);
-	}
-	if (resp->db != NULL) {
-		dns_db_detach(&resp->db);
-	}
-
-	dns_resolver_destroyfetch(&kfetch->fetch);
+	eresult = kfetch->result;
 
 	LOCK_ZONE(zone);
 	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING) || zone->view == NULL) {
@@ -10721,22 +11410,139 @@ cleanup:
 		dns_rdataset_disassociate(dnskeysigs);
 	}
 
+	if (kfetch->zmgr != NULL) {
+		dns_zonemgr_detach(&kfetch->zmgr);
+	}
 	dns_name_free(keyname, mctx);
 	isc_mem_putanddetach(&kfetch->mctx, kfetch, sizeof(dns_keyfetch_t));
-	isc_mem_putanddetach(&resp->mctx, resp, sizeof(*resp));
 
 	if (secroots != NULL) {
 		dns_keytable_detach(&secroots);
 	}
 
-	free_needed = exit_check(zone);
-	UNLOCK_ZONE(zone);
+	free_needed = exit_check(zone);
+	UNLOCK_ZONE(zone);
+
+	if (free_needed) {
+		zone_free(zone);
+	}
+
+	INSIST(ver == NULL);
+}
+
+static void
+keyfetch_waited(void *arg) {
+	keyfetch_process(arg);
+}
+
+/*
+ * The fetch for 'kfetch' has finished: pass its result to the key
+ * fetches of other views that were waiting for it.  Each of them checks
+ * the DNSKEY set against its own trust anchors in keyfetch_process().
+ */
+static void
+keyfetch_share(dns_keyfetch_t *kfetch) {
+	dns_zonemgr_t *zmgr = kfetch->zmgr;
+	ISC_LIST(dns_keyfetch_t) waiters = { 0 };
+	dns_keyfetch_t *waiter = NULL, *next = NULL;
+
+	if (zmgr == NULL) {
+		return;
+	}
+
+	LOCK(&zmgr->keyfetchlock);
+	if (ISC_LINK_LINKED(kfetch, link)) {
+		ISC_LIST_UNLINK(zmgr->keyfetches, kfetch, link);
+	}
+	ISC_LIST_MOVEUNSAFE(waiters, kfetch->waiters);
+	UNLOCK(&zmgr->keyfetchlock);
+
+	for (waiter = ISC_LIST_HEAD(waiters); waiter != NULL; waiter = next) {
+		next = ISC_LIST_NEXT(waiter, link);
+		ISC_LIST_UNLINK(waiters, waiter, link);
+
+		waiter->result = kfetch->result;
+		if (dns_rdataset_isassociated(&kfetch->dnskeyset)) {
+			dns_rdataset_clone(&kfetch->dnskeyset,
+					   &waiter->dnskeyset);
+		}
+		if (dns_rdataset_isassociated(&kfetch->dnskeysigset)) {
+			dns_rdataset_clone(&kfetch->dnskeysigset,
+					   &waiter->dnskeysigset);
+		}
+		isc_async_run(waiter->zone->loop, keyfetch_waited, waiter);
+	}
+}
+
+static void
+keyfetch_done(void *arg) {
+	dns_fetchresponse_t *resp = (dns_fetchresponse_t *)arg;
+	dns_keyfetch_t *kfetch = NULL;
+
+	INSIST(resp != NULL);
+
+	kfetch = resp->arg;
+
+	INSIST(kfetch != NULL);
+
+	kfetch->result = resp->result;
+
+	/* Free resources which are not of interest */
+	if (resp->node != NULL) {
+		dns_db_detachnode(resp->db, &resp->node);
+	}
+	if (resp->db != NULL) {
+		dns_db_detach(&resp->db);
+	}
+	isc_mem_putanddetach(&resp->mctx, resp, sizeof(*resp));
+
+	dns_resolver_destroyfetch(&kfetch->fetch);
+
+	keyfetch_share(kfetch);
+	keyfetch_process(kfetch);
+}
+
+/*
+ * If another view is already fetching the DNSKEY set of the same trust
+ * anchor, wait for its result instead of fetching it again; otherwise
+ * let later key fetches for the name wait for this one.
+ */
+static bool
+keyfetch_join(dns_keyfetch_t *kfetch) {
+	dns_zonemgr_t *zmgr = kfetch->zmgr;
+	dns_name_t *kname = dns_fixedname_name(&kfetch->name);
+	dns_keyfetch_t *leader = NULL;
+
+	if (zmgr == NULL) {
+		return (false);
+	}
+
+	LOCK(&zmgr->keyfetchlock);
+	for (leader = ISC_LIST_HEAD(zmgr->keyfetches); leader != NULL;
+	     leader = ISC_LIST_NEXT(leader, link))
+	{
+		if (leader->zone->rdclass == kfetch->zone->rdclass &&
+		    dns_name_equal(dns_fixedname_name(&leader->name), kname))
+		{
+			break;
+		}
+	}
+	if (leader != NULL) {
+		ISC_LIST_APPEND(leader->waiters, kfetch, link);
+	} else {
+		ISC_LIST_APPEND(zmgr->keyfetches, kfetch, link);
+	}
+	UNLOCK(&zmgr->keyfetchlock);
 
-	if (free_needed) {
-		zone_free(zone);
+	if (leader != NULL && isc_log_wouldlog(dns_lctx, ISC_LOG_DEBUG(3))) {
+		char namebuf[DNS_NAME_FORMATSIZE];
+		dns_name_format(kname, namebuf, sizeof(namebuf));
+		dnssec_log(kfetch->zone, ISC_LOG_DEBUG(3),
+			   "Sharing key fetch for '%s' with another view",
+			   namebuf);
 	}
 
-	INSIST(ver == NULL);
+	return (leader != NULL);
 }
 
 static void
@@ -10758,6 +11564,9 @@ retry_keyfetch(dns_keyfetch_t *kfetch, dns_name_t *kname) {
 	isc_refcount_decrement(&zone->irefs);
 	dns_db_detach(&kfetch->db);
 	dns_rdataset_disassociate(&kfetch->keydataset);
+	if (kfetch->zmgr != NULL) {
+		dns_zonemgr_detach(&kfetch->zmgr);
+	}
 	dns_name_free(kname, zone->mctx);
 	isc_mem_putanddetach(&kfetch->mctx, kfetch, sizeof(*kfetch));
 
@@ -10797,6 +11606,10 @@ do_keyfetch(void *arg) {
 		goto retry;
 	}
 
+	if (keyfetch_join(kfetch)) {
+		return;
+	}
+
 	result = dns_view_getresolver(zone->view, &resolver);
 	if (result != ISC_R_SUCCESS) {
 		goto retry;
@@ -10821,6 +11634,8 @@ do_keyfetch(void *arg) {
 		return;
 	}
 retry:
+	kfetch->result = result;
+	keyfetch_share(kfetch);
 	retry_keyfetch(kfetch, kname);
 }
 
@@ -10927,8 +11742,14 @@ zone_refreshkeys(dns_zone_t *zone) {
 
 			kfetch = isc_mem_get(zone->mctx,
 					     sizeof(dns_keyfetch_t));
-			*kfetch = (dns_keyfetch_t){ .zone = zone };
+			*kfetch = (dns_keyfetch_t){
+				.zone = zone,
+				.link = ISC_LINK_INITIALIZER,
+			};
 			isc_mem_attach(zone->mctx, &kfetch->mctx);
+			if (zone->zmgr != NULL) {
+				dns_zonemgr_attach(zone->zmgr, &kfetch->zmgr);
+			}
 
 			zone->refreshkeycount++;
 			isc_refcount_increment0(&zone->irefs);
@@ -11119,6 +11940,23 @@ zone_maintenance(dns_zone_t *zone) {
 		break;
 	}
 
+	/*
+	 * Unload load-on-demand zones that have not been queried for
+	 * a while; the next query loads them again.
+	 */
+	if (zone->type == dns_zone_primary) {
+		isc_stdtime_t idle;
+
+		LOCK_ZONE(zone);
+		idle = zone_idletime(zone);
+		if (idle != 0 && idle <= isc_time_seconds(&now)) {
+			dns_zone_log(zone, ISC_LOG_DEBUG(1),
+				     "unloading idle zone");
+			zone_unload(zone);
+		}
+		UNLOCK_ZONE(zone);
+	}
+
 	/*
 	 * Primary/redirect zones send notifies now, if needed
 	 */
@@ -11504,6 +12342,11 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 			journalsize = (int32_t)dbsize * 2;
 		}
 	}
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_COMPACTING)) {
+		zone_debuglog(zone, __func__, 1,
+			      "journal compaction already in progress");
+		return;
+	}
 	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_FIXJOURNAL)) {
 		options |= DNS_JOURNAL_COMPACTALL;
 		DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_FIXJOURNAL);
@@ -11512,8 +12355,28 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 		zone_debuglog(zone, __func__, 1, "target journal size %d",
 			      journalsize);
 	}
+	if (options == 0 && zone->loop != NULL) {
+		struct journalcompact *jc = isc_mem_get(zone->mctx,
+							sizeof(*jc));
+		*jc = (struct journalcompact){
+			.journal = isc_mem_strdup(zone->mctx, zone->journal),
+			.serial = serial,
+			.journalsize = journalsize,
+		};
+		zone_iattach(zone, &jc->zone);
+		DNS_ZONE_SETFLAG(zone, DNS_ZONEFLG_COMPACTING);
+		isc_work_enqueueclass(zone->loop, isc_workclass_background,
+				      zone_journal_compact_work,
+				      zone_journal_compact_done, jc);
+		return;
+	}
 	result = dns_journal_compact(zone->mctx, zone->journal, serial, options,
 				     journalsize);
+	zone_journal_compact_log(zone, result);
+}
+
+static void
+zone_journal_compact_log(dns_zone_t *zone, isc_result_t result) {
 	switch (result) {
 	case ISC_R_SUCCESS:
 	case ISC_R_NOSPACE:
@@ -11529,6 +12392,54 @@ zone_journal_compact(dns_zone_t *zone, dns_db_t *db, uint32_t serial) {
 	}
 }
 
+/*
+ * Copy the retained part of the journal off the zone's loop, so that
+ * updates and outgoing transfers are not held up by it.
+ */
+static void
+zone_journal_compact_work(void *arg) {
+	struct journalcompact *jc = arg;
+
+	jc->result = dns_journal_compact_prepare(
+		jc->zone->mctx, jc->journal, jc->serial, 0, jc->journalsize,
+		&jc->compact);
+}
+
+/*
+ * Back on the zone's loop, where the journal is written, pick up the
+ * transactions added in the meantime and swap the new journal in.
+ */
+static void
+zone_journal_compact_done(void *arg) {
+	struct journalcompact *jc = arg;
+	dns_zone_t *zone = jc->zone;
+	isc_result_t result = jc->result;
+
+	if (jc->compact != NULL) {
+		bool same;
+
+		LOCK_ZONE(zone);
+		same = (zone->journal != NULL &&
+			strcmp(zone->journal, jc->journal) == 0);
+		UNLOCK_ZONE(zone);
+
+		if (same) {
+			result = dns_journal_compact_finish(&jc->compact);
+		} else {
+			dns_journal_compact_cancel(&jc->compact);
+		}
+	}
+	zone_journal_compact_log(zone, result);
+
+	LOCK_ZONE(zone);
+	DNS_ZONE_CLRFLAG(zone, DNS_ZONEFLG_COMPACTING);
+	UNLOCK_ZONE(zone);
+
+	isc_mem_free(zone->mctx, jc->journal);
+	isc_mem_put(zone->mctx, jc, sizeof(*jc));
+	dns_zone_idetach(&zone);
+}
+
 isc_result_t
 dns_zone_flush(dns_zone_t *zone) {
 	isc_result_t result = ISC_R_SUCCESS;
@@ -12033,6 +12944,45 @@ zone_unload(dns_zone_t *zone) {
 	}
 }
 
+/*
+ * Return the time at which a load-on-demand zone that is not queried
+ * again may be unloaded, or 0 if it must stay loaded: there is still
+ * work to do that needs the database, or the zone is not one that can
+ * be reloaded from its file as it was.
+ */
+static isc_stdtime_t
+zone_idletime(dns_zone_t *zone) {
+	/*
+	 * 'zone' locked by caller.
+	 */
+
+	REQUIRE(LOCKED_ZONE(zone));
+
+	if (!DNS_ZONE_OPTION(zone, DNS_ZONEOPT_LOADONDEMAND) ||
+	    zone->idletime == 0 || zone->type != dns_zone_primary ||
+	    zone->raw != NULL || zone->secure != NULL ||
+	    !DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDDUMP) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_DUMPING) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDNOTIFY) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_NEEDSTARTUPNOTIFY) ||
+	    !isc_time_isepoch(&zone->resigntime) ||
+	    !isc_time_isepoch(&zone->signingtime) ||
+	    !isc_time_isepoch(&zone->nsec3chaintime))
+	{
+		return (0);
+	}
+
+	return (atomic_load_relaxed(&zone->lastaccess) + zone->idletime);
+}
+
+void
+dns_zone_setidletime(dns_zone_t *zone, uint32_t idletime) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	zone->idletime = idletime;
+}
+
 void
 dns_zone_setminrefreshtime(dns_zone_t *zone, uint32_t val) {
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -12317,6 +13267,17 @@ destroy:
 
 static isc_result_t
 notify_send_queue(dns_notify_t *notify, bool startup) {
+	/*
+	 * Pipelined NOTIFY messages to the same destination share one
+	 * TCP connection, so they are sent right away instead of being
+	 * spread out by the notify rate limiters.
+	 */
+	if (notify->zone->zmgr->notifypipelining) {
+		notify->flags |= DNS_NOTIFY_TCP;
+		isc_async_run(notify->zone->loop, notify_send_toaddr, notify);
+		return (ISC_R_SUCCESS);
+	}
+
 	return (isc_ratelimiter_enqueue(
 		startup ? notify->zone->zmgr->startupnotifyrl
 			: notify->zone->zmgr->notifyrl,
@@ -12343,7 +13304,7 @@ notify_send_toaddr(void *arg) {
 	isc_sockaddr_format(&notify->dst, addrbuf, sizeof(addrbuf));
 
 	if (DNS_ZONE_FLAG(notify->zone, DNS_ZONEFLG_LOADED) == 0 ||
-	    notify->rlevent->canceled ||
+	    (notify->rlevent != NULL && notify->rlevent->canceled) ||
 	    DNS_ZONE_FLAG(notify->zone, DNS_ZONEFLG_EXITING) ||
 	    notify->zone->view->requestmgr == NULL || notify->zone->db == NULL)
 	{
@@ -14147,6 +15108,17 @@ queue_soa_query(dns_zone_t *zone) {
 	 * Attach so that we won't clean up until the event is delivered.
 	 */
 	zone_iattach(zone, &sq->zone);
+
+	/*
+	 * Pipelined SOA queries share one TCP connection per primary,
+	 * so there is no burst of UDP packets to spread out; send them
+	 * right away instead of through the serial-query-rate limiter.
+	 */
+	if (zone->zmgr->serialquerypipelining) {
+		isc_async_run(zone->loop, soa_query, sq);
+		return;
+	}
+
 	result = isc_ratelimiter_enqueue(zone->zmgr->refreshrl, zone->loop,
 					 soa_query, sq, &sq->rlevent);
 	if (result != ISC_R_SUCCESS) {
@@ -14178,7 +15150,8 @@ soa_query(void *arg) {
 	ENTER;
 
 	LOCK_ZONE(zone);
-	if (sq->rlevent->canceled || DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING) ||
+	if ((sq->rlevent != NULL && sq->rlevent->canceled) ||
+	    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING) ||
 	    zone->view->requestmgr == NULL)
 	{
 		if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING)) {
@@ -14244,6 +15217,9 @@ again:
 
 	options = DNS_ZONE_FLAG(zone, DNS_ZONEFLG_USEVC) ? DNS_REQUESTOPT_TCP
 							 : 0;
+	if (zone->zmgr->serialquerypipelining) {
+		options |= DNS_REQUESTOPT_TCP;
+	}
 	reqnsid = zone->view->requestnsid;
 	reqexpire = zone->requestexpire;
 	if (zone->view->peers != NULL) {
@@ -14374,7 +15350,9 @@ cleanup:
 	if (do_queue_xfrin) {
 		queue_xfrin(zone);
 	}
-	isc_rlevent_free(&sq->rlevent);
+	if (sq->rlevent != NULL) {
+		isc_rlevent_free(&sq->rlevent);
+	}
 	isc_mem_put(zone->mctx, sq, sizeof(*sq));
 	dns_zone_idetach(&zone);
 	return;
@@ -14666,10 +15644,8 @@ zone_shutdown(void *arg) {
 	if (zone->zmgr != NULL) {
 		RWLOCK(&zone->zmgr->rwlock, isc_rwlocktype_write);
 		if (zone->statelist == &zone->zmgr->waiting_for_xfrin) {
-			ISC_LIST_UNLINK(zone->zmgr->waiting_for_xfrin, zone,
-					statelink);
+			zmgr_unlink_xfrin(zone->zmgr, zone);
 			linked = true;
-			zone->statelist = NULL;
 		}
 		if (zone->statelist == &zone->zmgr->xfrin_in_progress) {
 			ISC_LIST_UNLINK(zone->zmgr->xfrin_in_progress, zone,
@@ -14731,11 +15707,6 @@ zone_shutdown(void *arg) {
 
 	forward_cancel(zone);
 
-	if (zone->timer != NULL) {
-		isc_refcount_decrement(&zone->irefs);
-		isc_timer_destroy(&zone->timer);
-	}
-
 	/*
 	 * We have now canceled everything set the flag to allow exit_check()
 	 * to succeed.	We must not unlock between setting this flag and
@@ -14777,50 +15748,129 @@ zone_shutdown(void *arg) {
 	}
 }
 
-static void
-zone_timer(void *arg) {
-	dns_zone_t *zone = (dns_zone_t *)arg;
-
-	REQUIRE(DNS_ZONE_VALID(zone));
+static bool
+zone_timer_less(void *v1, void *v2) {
+	dns_zone_t *zone1 = v1;
+	dns_zone_t *zone2 = v2;
 
-	zone_maintenance(zone);
+	return (isc_time_compare(&zone1->timernext, &zone2->timernext) < 0);
 }
 
 static void
-zone_timer_stop(dns_zone_t *zone) {
-	zone_debuglog(zone, __func__, 10, "stop zone timer");
-	if (zone->timer != NULL) {
-		isc_timer_stop(zone->timer);
-	}
+zone_timer_index(void *what, unsigned int idx) {
+	dns_zone_t *zone = what;
+
+	zone->timer_index = idx;
 }
 
+/*
+ * Arm the loop timer for the zone at the head of the queue.
+ */
 static void
-zone_timer_set(dns_zone_t *zone, isc_time_t *next, isc_time_t *now) {
+zonemgr_timer_rearm(zonemgr_timerq_t *timerq) {
+	dns_zone_t *zone = isc_heap_element(timerq->heap, 1);
 	isc_interval_t interval;
+	isc_time_t now;
+
+	if (zone == NULL) {
+		isc_timer_stop(timerq->timer);
+		isc_time_settoepoch(&timerq->next);
+		return;
+	}
+
+	if (isc_time_compare(&zone->timernext, &timerq->next) == 0) {
+		return;
+	}
 
-	if (isc_time_compare(next, now) <= 0) {
+	now = isc_time_now();
+	if (isc_time_compare(&zone->timernext, &now) <= 0) {
 		isc_interval_set(&interval, 0, 0);
 	} else {
-		isc_time_subtract(next, now, &interval);
+		isc_time_subtract(&zone->timernext, &now, &interval);
+	}
+
+	timerq->next = zone->timernext;
+	isc_timer_start(timerq->timer, isc_timertype_once, &interval);
+}
+
+static void
+zonemgr_timer(void *arg) {
+	zonemgr_timerq_t *timerq = arg;
+	dns_zone_t *zone = NULL;
+	isc_time_t now = isc_time_now();
+
+	isc_time_settoepoch(&timerq->next);
+
+	for (size_t i = 0; i < ZONEMGR_TIMER_BATCH; i++) {
+		zone = isc_heap_element(timerq->heap, 1);
+		if (zone == NULL ||
+		    isc_time_compare(&zone->timernext, &now) > 0)
+		{
+			break;
+		}
+
+		isc_heap_delete(timerq->heap, 1);
+		zone_maintenance(zone);
+		isc_refcount_decrement(&zone->irefs);
+	}
+
+	zonemgr_timer_rearm(timerq);
+}
+
+static void
+zone_timer_remove(dns_zone_t *zone) {
+	zonemgr_timerq_t *timerq = NULL;
+
+	if (zone->timer_index == 0) {
+		return;
 	}
 
+	timerq = &zone->zmgr->timerqs[zone->tid];
+	isc_heap_delete(timerq->heap, zone->timer_index);
+	isc_refcount_decrement(&zone->irefs);
+}
+
+static void
+zone_timer_stop(dns_zone_t *zone) {
+	zone_debuglog(zone, __func__, 10, "stop zone timer");
+	zone_timer_remove(zone);
+}
+
+static void
+zone_timer_set(dns_zone_t *zone, isc_time_t *next) {
+	zonemgr_timerq_t *timerq = NULL;
+
 	if (zone->loop == NULL) {
 		zone_debuglog(zone, __func__, 10, "zone is not managed");
-	} else if (zone->timer == NULL) {
-		isc_refcount_increment0(&zone->irefs);
-		isc_timer_create(zone->loop, zone_timer, zone, &zone->timer);
+		return;
+	}
+
+	timerq = &zone->zmgr->timerqs[zone->tid];
+	if (timerq->timer == NULL) {
+		isc_timer_create(zone->loop, zonemgr_timer, timerq,
+				 &timerq->timer);
 	}
-	if (zone->timer != NULL) {
-		isc_timer_start(zone->timer, isc_timertype_once, &interval);
+
+	if (zone->timer_index == 0) {
+		zone->timernext = *next;
+		isc_refcount_increment0(&zone->irefs);
+		isc_heap_insert(timerq->heap, zone);
+	} else if (isc_time_compare(next, &zone->timernext) < 0) {
+		zone->timernext = *next;
+		isc_heap_increased(timerq->heap, zone->timer_index);
+	} else {
+		zone->timernext = *next;
+		isc_heap_decreased(timerq->heap, zone->timer_index);
 	}
+
+	zonemgr_timer_rearm(timerq);
 }
 
 static void
 zone__settimer(void *arg) {
-	zone_settimer_t *data = arg;
-	dns_zone_t *zone = data->zone;
-	isc_time_t *now = &data->now;
+	dns_zone_t *zone = (dns_zone_t *)arg;
 	isc_time_t next;
+	isc_stdtime_t idletime;
 	bool free_needed = false;
 
 	REQUIRE(DNS_ZONE_VALID(zone));
@@ -14894,6 +15944,17 @@ zone__settimer(void *arg) {
 				next = zone->nsec3chaintime;
 			}
 		}
+		idletime = zone_idletime(zone);
+		if (idletime != 0) {
+			isc_time_t idle;
+
+			isc_time_set(&idle, idletime, 0);
+			if (isc_time_isepoch(&next) ||
+			    isc_time_compare(&idle, &next) < 0)
+			{
+				next = idle;
+			}
+		}
 		break;
 
 	case dns_zone_secondary:
@@ -14967,11 +16028,10 @@ zone__settimer(void *arg) {
 	if (isc_time_isepoch(&next)) {
 		zone_timer_stop(zone);
 	} else {
-		zone_timer_set(zone, &next, now);
+		zone_timer_set(zone, &next);
 	}
 
 free:
-	isc_mem_put(zone->mctx, data, sizeof(*data));
 	isc_refcount_decrement(&zone->irefs);
 	free_needed = exit_check(zone);
 	UNLOCK_ZONE(zone);
@@ -14982,17 +16042,18 @@ free:
 
 static void
 zone_settimer(dns_zone_t *zone, isc_time_t *now) {
+	UNUSED(now);
+
 	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_EXITING)) {
 		return;
 	}
 
-	zone_settimer_t *arg = isc_mem_get(zone->mctx, sizeof(*arg));
-	*arg = (zone_settimer_t){
-		.zone = zone,
-		.now = *now,
-	};
+	/*
+	 * The timer is armed relative to the time zone__settimer() runs,
+	 * not to 'now'.
+	 */
 	isc_refcount_increment0(&zone->irefs);
-	isc_async_run(zone->loop, zone__settimer, arg);
+	isc_async_run(zone->loop, zone__settimer, zone);
 }
 
 static void
@@ -17531,6 +18592,9 @@ static void
 zone_attachdb(dns_zone_t *zone, dns_db_t *db) {
 	REQUIRE(zone->db == NULL && db != NULL);
 
+	if (zone->triereplicas > 0 && dns_db_iszone(db)) {
+		(void)dns_db_setreplicas(db, zone->triereplicas);
+	}
 	dns_db_attach(db, &zone->db);
 }
 
@@ -18040,23 +19104,86 @@ dns_zone_getxfrintime(const dns_zone_t *zone) {
 	return (zone->xfrintime);
 }
 
+/*
+ * A transfer is urgent if the zone has no data to serve, or if its data
+ * expires before the next regular refresh would be due.
+ */
+static bool
+xfrin_isurgent(dns_zone_t *zone) {
+	isc_time_t now, soon;
+	bool urgent = true;
+
+	LOCK_ZONE(zone);
+	if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADED)) {
+		now = isc_time_now();
+		DNS_ZONE_TIME_ADD(&now, zone->refresh, &soon);
+		urgent = (isc_time_compare(&zone->expiretime, &soon) <= 0);
+	}
+	UNLOCK_ZONE(zone);
+
+	return (urgent);
+}
+
+/*
+ * Add 'zone' to the zones waiting for a transfer: urgent zones after
+ * the other urgent zones at the head of the queue, and all others at
+ * its tail.
+ *
+ * Requires:
+ *	The zone manager is write locked by the caller.
+ */
+static void
+zmgr_queue_xfrin(dns_zonemgr_t *zmgr, dns_zone_t *zone, bool urgent) {
+	if (!urgent) {
+		ISC_LIST_APPEND(zmgr->waiting_for_xfrin, zone, statelink);
+	} else if (zmgr->xfrin_urgent == NULL) {
+		ISC_LIST_PREPEND(zmgr->waiting_for_xfrin, zone, statelink);
+		zmgr->xfrin_urgent = zone;
+	} else {
+		ISC_LIST_INSERTAFTER(zmgr->waiting_for_xfrin,
+				     zmgr->xfrin_urgent, zone, statelink);
+		zmgr->xfrin_urgent = zone;
+	}
+	zone->statelist = &zmgr->waiting_for_xfrin;
+}
+
+/*
+ * Remove 'zone' from the zones waiting for a transfer.
+ *
+ * Requires:
+ *	The zone manager is write locked by the caller.
+ */
+static void
+zmgr_unlink_xfrin(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
+	INSIST(zone->statelist == &zmgr->waiting_for_xfrin);
+
+	if (zmgr->xfrin_urgent == zone) {
+		/* The urgent zones are a prefix of the queue */
+		zmgr->xfrin_urgent = ISC_LIST_PREV(zone, statelink);
+	}
+	ISC_LIST_UNLINK(zmgr->waiting_for_xfrin, zone, statelink);
+	zone->statelist = NULL;
+}
+
 static void
 queue_xfrin(dns_zone_t *zone) {
 	isc_result_t result;
 	dns_zonemgr_t *zmgr = zone->zmgr;
+	bool urgent;
 
 	ENTER;
 
 	INSIST(zone->statelist == NULL);
 
+	urgent = xfrin_isurgent(zone);
+
 	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
-	ISC_LIST_APPEND(zmgr->waiting_for_xfrin, zone, statelink);
+	zmgr_queue_xfrin(zmgr, zone, urgent);
 	isc_refcount_increment0(&zone->irefs);
-	zone->statelist = &zmgr->waiting_for_xfrin;
 	result = zmgr_start_xfrin_ifquota(zmgr, zone);
 	RWUNLOCK(&zmgr->rwlock, isc_rwlocktype_write);
 
-	if (result == ISC_R_QUOTA) {
+	if (result == ISC_R_QUOTA || result == ISC_R_SOFTQUOTA) {
 		dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN, ISC_LOG_INFO,
 			      "zone transfer deferred due to quota");
 	} else if (result != ISC_R_SUCCESS) {
@@ -18790,6 +19917,7 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t *netmgr,
 	ISC_LIST_INIT(zmgr->zones);
 	ISC_LIST_INIT(zmgr->waiting_for_xfrin);
 	ISC_LIST_INIT(zmgr->xfrin_in_progress);
+	ISC_LIST_INIT(zmgr->keyfetches);
 	memset(zmgr->unreachable, 0, sizeof(zmgr->unreachable));
 	for (size_t i = 0; i < UNREACH_CACHE_SIZE; i++) {
 		atomic_init(&zmgr->unreachable[i].expire, 0);
@@ -18799,6 +19927,8 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t *netmgr,
 	/* Unreachable lock. */
 	isc_rwlock_init(&zmgr->urlock);
 
+	isc_mutex_init(&zmgr->keyfetchlock);
+
 	isc_ratelimiter_create(loop, &zmgr->checkdsrl);
 	isc_ratelimiter_create(loop, &zmgr->notifyrl);
 	isc_ratelimiter_create(loop, &zmgr->refreshrl);
@@ -18808,10 +19938,21 @@ dns_zonemgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t *netmgr,
 	zmgr->mctxpool = isc_mem_cget(zmgr->mctx, zmgr->workers,
 				      sizeof(zmgr->mctxpool[0]));
 	for (size_t i = 0; i < zmgr->workers; i++) {
-		isc_mem_create(&zmgr->mctxpool[i]);
+		/*
+		 * Zone data is freed in bulk when a zone is reloaded or
+		 * removed; release it to the operating system soon after.
+		 */
+		isc_mem_create_decay(&zmgr->mctxpool[i], 5000, 0);
 		isc_mem_setname(zmgr->mctxpool[i], "zonemgr-mctxpool");
 	}
 
+	zmgr->timerqs = isc_mem_cget(zmgr->mctx, zmgr->workers,
+				     sizeof(zmgr->timerqs[0]));
+	for (size_t i = 0; i < zmgr->workers; i++) {
+		isc_heap_create(zmgr->mctx, zone_timer_less, zone_timer_index,
+				0, &zmgr->timerqs[i].heap);
+	}
+
 	/* Key file I/O locks. */
 	zonemgr_keymgmt_init(zmgr);
 
@@ -18866,11 +20007,12 @@ dns_zonemgr_managezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 
 	RWLOCK(&zmgr->rwlock, isc_rwlocktype_write);
 	LOCK_ZONE(zone);
-	REQUIRE(zone->timer == NULL);
+	REQUIRE(zone->timer_index == 0);
 	REQUIRE(zone->zmgr == NULL);
 
 	isc_loop_t *loop = isc_loop_get(zmgr->loopmgr, zone->tid);
 	isc_loop_attach(loop, &zone->loop);
+	zmgr->timerqs[zone->tid].nzones++;
 
 	zonemgr_keymgmt_add(zmgr, zone, &zone->kfio);
 	INSIST(zone->kfio != NULL);
@@ -18901,9 +20043,18 @@ dns_zonemgr_releasezone(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 		ENSURE(zone->kfio == NULL);
 	}
 
-	if (zone->timer != NULL) {
-		isc_refcount_decrement(&zone->irefs);
-		isc_timer_destroy(&zone->timer);
+	zone_timer_remove(zone);
+
+	zonemgr_timerq_t *timerq = &zmgr->timerqs[zone->tid];
+	INSIST(timerq->nzones > 0);
+	if (--timerq->nzones == 0 && timerq->timer != NULL) {
+		/* The last zone on this loop is gone */
+		if (zone->loop == isc_loop_current(zmgr->loopmgr)) {
+			isc_timer_destroy(&timerq->timer);
+		} else {
+			isc_timer_async_destroy(&timerq->timer);
+		}
+		isc_time_settoepoch(&timerq->next);
 	}
 
 	isc_loop_detach(&zone->loop);
@@ -19022,6 +20173,16 @@ zonemgr_free(dns_zonemgr_t *zmgr) {
 	isc_mem_cput(zmgr->mctx, zmgr->mctxpool, zmgr->workers,
 		     sizeof(zmgr->mctxpool[0]));
 
+	for (size_t i = 0; i < zmgr->workers; i++) {
+		INSIST(zmgr->timerqs[i].nzones == 0);
+		INSIST(zmgr->timerqs[i].timer == NULL);
+		isc_heap_destroy(&zmgr->timerqs[i].heap);
+	}
+	isc_mem_cput(zmgr->mctx, zmgr->timerqs, zmgr->workers,
+		     sizeof(zmgr->timerqs[0]));
+
+	INSIST(ISC_LIST_EMPTY(zmgr->keyfetches));
+	isc_mutex_destroy(&zmgr->keyfetchlock);
 	isc_rwlock_destroy(&zmgr->urlock);
 	isc_rwlock_destroy(&zmgr->rwlock);
 	isc_rwlock_destroy(&zmgr->tlsctx_cache_rwlock);
@@ -19088,14 +20249,18 @@ zmgr_resume_xfrs(dns_zonemgr_t *zmgr, bool multi) {
 			 * We successfully filled the slot.  We're done.
 			 */
 			break;
-		} else if (result == ISC_R_QUOTA) {
+		} else if (result == ISC_R_SOFTQUOTA) {
 			/*
-			 * Not enough quota.  This is probably the per-server
-			 * quota, because we usually get called when a unit of
-			 * global quota has just been freed.  Try the next
-			 * zone, it may succeed if it uses another primary.
+			 * The primary of this zone is at its quota.  Try
+			 * the next zone, it may use another primary.
 			 */
 			continue;
+		} else if (result == ISC_R_QUOTA) {
+			/*
+			 * No transfer can start until another one ends;
+			 * don't walk the rest of a possibly long queue.
+			 */
+			break;
 		} else {
 			dns_zone_logc(zone, DNS_LOGCATEGORY_XFER_IN,
 				      ISC_LOG_DEBUG(1),
@@ -19117,6 +20282,8 @@ zmgr_resume_xfrs(dns_zonemgr_t *zmgr, bool multi) {
  *			start a transfer.  zone_xfrdone() has been or will
  *			be called.
  *	ISC_R_QUOTA	Not enough quota.
+ *	ISC_R_SOFTQUOTA	Not enough quota for the primary of the zone, but
+ *			transfers from other primaries may start.
  *	Others		Failure.
  */
 static isc_result_t
@@ -19188,7 +20355,7 @@ zmgr_start_xfrin_ifquota(dns_zonemgr_t *zmgr, dns_zone_t *zone) {
 	}
 
 	if (nxfrsperns >= maxtransfersperns) {
-		return (ISC_R_QUOTA);
+		return (ISC_R_SOFTQUOTA);
 	}
 
 gotquota:
@@ -19197,8 +20364,7 @@ gotquota:
 	 * list and start the actual transfer asynchronously.
 	 */
 	LOCK_ZONE(zone);
-	INSIST(zone->statelist == &zmgr->waiting_for_xfrin);
-	ISC_LIST_UNLINK(zmgr->waiting_for_xfrin, zone, statelink);
+	zmgr_unlink_xfrin(zmgr, zone);
 	ISC_LIST_APPEND(zmgr->xfrin_in_progress, zone, statelink);
 	zone->statelist = &zmgr->xfrin_in_progress;
 	isc_async_run(zone->loop, got_transfer_quota, zone);
@@ -19301,6 +20467,20 @@ dns_zonemgr_setserialqueryrate(dns_zonemgr_t *zmgr, unsigned int value) {
 	setrl(zmgr->startuprefreshrl, &zmgr->startupserialqueryrate, value);
 }
 
+void
+dns_zonemgr_setserialquerypipelining(dns_zonemgr_t *zmgr, bool value) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	zmgr->serialquerypipelining = value;
+}
+
+void
+dns_zonemgr_setnotifypipelining(dns_zonemgr_t *zmgr, bool value) {
+	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
+
+	zmgr->notifypipelining = value;
+}
+
 unsigned int
 dns_zonemgr_getnotifyrate(dns_zonemgr_t *zmgr) {
 	REQUIRE(DNS_ZONEMGR_VALID(zmgr));
@@ -19725,6 +20905,17 @@ dns_zonemgr_getcount(dns_zonemgr_t *zmgr, dns_zonestate_t state) {
 			}
 		}
 		break;
+	case DNS_ZONESTATE_LOADING:
+		for (zone = ISC_LIST_HEAD(zmgr->zones); zone != NULL;
+		     zone = ISC_LIST_NEXT(zone, link))
+		{
+			if (DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADPENDING) ||
+			    DNS_ZONE_FLAG(zone, DNS_ZONEFLG_LOADING))
+			{
+				count++;
+			}
+		}
+		break;
 	default:
 		UNREACHABLE();
 	}
@@ -19921,6 +21112,22 @@ dns_zone_getnotifydelay(dns_zone_t *zone) {
 	return (zone->notifydelay);
 }
 
+void
+dns_zone_settriereplicas(dns_zone_t *zone, uint32_t replicas) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	LOCK_ZONE(zone);
+	zone->triereplicas = replicas;
+	UNLOCK_ZONE(zone);
+}
+
+uint32_t
+dns_zone_gettriereplicas(dns_zone_t *zone) {
+	REQUIRE(DNS_ZONE_VALID(zone));
+
+	return (zone->triereplicas);
+}
+
 isc_result_t
 dns_zone_signwithkey(dns_zone_t *zone, dns_secalg_t algorithm, uint16_t keyid,
 		     bool deleteit) {
@@ -21,12 +21,16 @@
 
 #include <isc/base32.h>
 #include <isc/buffer.h>
+#include <isc/condition.h>
 #include <isc/heap.h>
 #include <isc/iterated_hash.h>
 #include <isc/log.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
+#include <isc/os.h>
 #include <isc/region.h>
 #include <isc/result.h>
+#include <isc/thread.h>
 #include <isc/types.h>
 #include <isc/util.h>
 
@@ -52,6 +56,17 @@
 
 #include <dst/dst.h>
 
+/*
+ * In zones with at least VERIFY_MINNODES nodes, the RRset signatures
+ * are checked by up to VERIFY_MAXWORKERS threads while the zone is
+ * walked; see verifyset_submit().
+ */
+#define VERIFY_MINNODES	  1024
+#define VERIFY_MAXWORKERS 16
+#define VERIFY_JOBS	  64 /*%< jobs in flight per worker */
+
+typedef struct verifypool verifypool_t;
+
 typedef struct vctx {
 	isc_mem_t *mctx;
 	dns_zone_t *zone;
@@ -79,8 +94,39 @@ typedef struct vctx {
 	unsigned char act_algorithms[256];
 	isc_heap_t *expected_chains;
 	isc_heap_t *found_chains;
+	verifypool_t *pool;
 } vctx_t;
 
+/*
+ * An RRset whose signatures are being checked by a worker thread.
+ * Its messages and bad algorithms are reported in submission order.
+ */
+typedef struct verifyjob {
+	dns_rdataset_t rdataset;
+	dns_fixedname_t name;
+	dns_dbnode_t *node;
+	isc_buffer_t *log; /*%< NUL terminated messages */
+	unsigned char bad_algorithms[256];
+	isc_result_t result;
+	bool done;
+} verifyjob_t;
+
+struct verifypool {
+	verifyjob_t *jobs;
+	size_t window;
+	dst_key_t **dstkeys;
+	size_t nkeys;
+	isc_thread_t *threads;
+	size_t nthreads;
+	isc_mutex_t lock;
+	isc_condition_t cond;
+	size_t submitted;
+	size_t taken;
+	size_t committed;
+	bool shutdown;
+	vctx_t *vctx;
+};
+
 struct nsec3_chain_fixed {
 	uint8_t hash;
 	uint8_t salt_length;
@@ -112,10 +158,7 @@ chain_length(struct nsec3_chain_fixed *chain) {
  * respectively.
  */
 static void
-zoneverify_log_error(const vctx_t *vctx, const char *fmt, ...) {
-	va_list ap;
-
-	va_start(ap, fmt);
+zoneverify_logv(const vctx_t *vctx, const char *fmt, va_list ap) {
 	if (vctx->zone != NULL) {
 		dns_zone_logv(vctx->zone, DNS_LOGCATEGORY_GENERAL,
 			      ISC_LOG_ERROR, NULL, fmt, ap);
@@ -123,6 +166,34 @@ zoneverify_log_error(const vctx_t *vctx, const char *fmt, ...) {
 		vfprintf(stderr, fmt, ap);
 		fprintf(stderr, "\n");
 	}
+}
+
+static void
+zoneverify_log_error(const vctx_t *vctx, const char *fmt, ...) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	zoneverify_logv(vctx, fmt, ap);
+	va_end(ap);
+}
+
+/*%
+ * Log an error found while checking an RRset, or if 'job' is not NULL,
+ * save it to be logged when the job is committed.
+ */
+static void
+verifyset_log(const vctx_t *vctx, verifyjob_t *job, const char *fmt, ...) {
+	char msg[2 * DNS_NAME_FORMATSIZE + 100];
+	va_list ap;
+
+	va_start(ap, fmt);
+	if (job == NULL) {
+		zoneverify_logv(vctx, fmt, ap);
+	} else {
+		vsnprintf(msg, sizeof(msg), fmt, ap);
+		isc_buffer_putmem(job->log, (unsigned char *)msg,
+				  strlen(msg) + 1);
+	}
 	va_end(ap);
 }
 
@@ -807,8 +878,11 @@ verifynsec3s(const vctx_t *vctx, const dns_name_t *name,
 
 static isc_result_t
 verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
-	  dns_dbnode_t *node, dst_key_t **dstkeys, size_t nkeys) {
+	  dns_dbnode_t *node, dst_key_t **dstkeys, size_t nkeys,
+	  verifyjob_t *job) {
 	unsigned char set_algorithms[256] = { 0 };
+	unsigned char *bad_algorithms = (job != NULL) ? job->bad_algorithms
+						      : vctx->bad_algorithms;
 	char namebuf[DNS_NAME_FORMATSIZE];
 	char algbuf[DNS_SECALG_FORMATSIZE];
 	char typebuf[DNS_RDATATYPE_FORMATSIZE];
@@ -819,8 +893,8 @@ verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 	dns_rdataset_init(&sigrdataset);
 	result = dns_db_allrdatasets(vctx->db, node, vctx->ver, 0, 0, &rdsiter);
 	if (result != ISC_R_SUCCESS) {
-		zoneverify_log_error(vctx, "dns_db_allrdatasets(): %s",
-				     isc_result_totext(result));
+		verifyset_log(vctx, job, "dns_db_allrdatasets(): %s",
+			      isc_result_totext(result));
 		return (result);
 	}
 	for (result = dns_rdatasetiter_first(rdsiter); result == ISC_R_SUCCESS;
@@ -837,11 +911,11 @@ verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 	if (result != ISC_R_SUCCESS) {
 		dns_name_format(name, namebuf, sizeof(namebuf));
 		dns_rdatatype_format(rdataset->type, typebuf, sizeof(typebuf));
-		zoneverify_log_error(vctx, "No signatures for %s/%s", namebuf,
-				     typebuf);
+		verifyset_log(vctx, job, "No signatures for %s/%s", namebuf,
+			      typebuf);
 		for (size_t i = 0; i < ARRAY_SIZE(set_algorithms); i++) {
 			if (vctx->act_algorithms[i] != 0) {
-				vctx->bad_algorithms[i] = 1;
+				bad_algorithms[i] = 1;
 			}
 		}
 		result = ISC_R_SUCCESS;
@@ -861,10 +935,10 @@ verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 			dns_name_format(name, namebuf, sizeof(namebuf));
 			dns_rdatatype_format(rdataset->type, typebuf,
 					     sizeof(typebuf));
-			zoneverify_log_error(vctx,
-					     "TTL mismatch for "
-					     "%s %s keytag %u",
-					     namebuf, typebuf, sig.keyid);
+			verifyset_log(vctx, job,
+				      "TTL mismatch for "
+				      "%s %s keytag %u",
+				      namebuf, typebuf, sig.keyid);
 			continue;
 		}
 		if ((set_algorithms[sig.algorithm] != 0) ||
@@ -890,11 +964,11 @@ verifyset(vctx_t *vctx, dns_rdataset_t *rdataset, const dns_name_t *name,
 			    (set_algorithms[i] == 0))
 			{
 				dns_secalg_format(i, algbuf, sizeof(algbuf));
-				zoneverify_log_error(vctx,
-						     "No correct %s signature "
-						     "for %s %s",
-						     algbuf, namebuf, typebuf);
-				vctx->bad_algorithms[i] = 1;
+				verifyset_log(vctx, job,
+					      "No correct %s signature "
+					      "for %s %s",
+					      algbuf, namebuf, typebuf);
+				bad_algorithms[i] = 1;
 			}
 		}
 	}
@@ -908,6 +982,189 @@ done:
 	return (result);
 }
 
+static void *
+verify_worker(void *arg) {
+	verifypool_t *pool = arg;
+
+	LOCK(&pool->lock);
+	while (true) {
+		verifyjob_t *job = NULL;
+		isc_result_t result;
+
+		while (!pool->shutdown && pool->taken == pool->submitted) {
+			WAIT(&pool->cond, &pool->lock);
+		}
+		if (pool->taken == pool->submitted) {
+			break;
+		}
+		job = &pool->jobs[pool->taken++ % pool->window];
+		UNLOCK(&pool->lock);
+
+		result = verifyset(pool->vctx, &job->rdataset,
+				   dns_fixedname_name(&job->name), job->node,
+				   pool->dstkeys, pool->nkeys, job);
+
+		LOCK(&pool->lock);
+		job->result = result;
+		job->done = true;
+		BROADCAST(&pool->cond);
+	}
+	UNLOCK(&pool->lock);
+
+	return (NULL);
+}
+
+static void
+verify_pool_create(vctx_t *vctx, dst_key_t **dstkeys, size_t nkeys) {
+	verifypool_t *pool = NULL;
+	size_t nthreads = ISC_MIN(isc_os_ncpus(), VERIFY_MAXWORKERS);
+
+	if (nthreads < 2 ||
+	    dns_db_nodecount(vctx->db, dns_dbtree_main) < VERIFY_MINNODES)
+	{
+		return;
+	}
+
+	pool = isc_mem_get(vctx->mctx, sizeof(*pool));
+	*pool = (verifypool_t){
+		.window = VERIFY_JOBS * nthreads,
+		.dstkeys = dstkeys,
+		.nkeys = nkeys,
+		.nthreads = nthreads,
+		.vctx = vctx,
+	};
+	pool->jobs = isc_mem_cget(vctx->mctx, pool->window,
+				  sizeof(pool->jobs[0]));
+	for (size_t i = 0; i < pool->window; i++) {
+		dns_rdataset_init(&pool->jobs[i].rdataset);
+		isc_buffer_allocate(vctx->mctx, &pool->jobs[i].log, 256);
+	}
+	isc_mutex_init(&pool->lock);
+	isc_condition_init(&pool->cond);
+
+	pool->threads = isc_mem_cget(vctx->mctx, nthreads,
+				     sizeof(pool->threads[0]));
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_create(verify_worker, pool, &pool->threads[i]);
+	}
+
+	vctx->pool = pool;
+}
+
+/*
+ * Wait for the oldest job, then report its results as verifyset()
+ * would have.
+ */
+static isc_result_t
+verify_commit(vctx_t *vctx) {
+	verifypool_t *pool = vctx->pool;
+	verifyjob_t *job = &pool->jobs[pool->committed % pool->window];
+	isc_region_t r;
+
+	LOCK(&pool->lock);
+	while (!job->done) {
+		WAIT(&pool->cond, &pool->lock);
+	}
+	UNLOCK(&pool->lock);
+
+	isc_buffer_usedregion(job->log, &r);
+	for (char *msg = (char *)r.base; msg < (char *)r.base + r.length;
+	     msg += strlen(msg) + 1)
+	{
+		zoneverify_log_error(vctx, "%s", msg);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(job->bad_algorithms); i++) {
+		if (job->bad_algorithms[i] != 0) {
+			vctx->bad_algorithms[i] = 1;
+		}
+	}
+
+	dns_rdataset_disassociate(&job->rdataset);
+	dns_db_detachnode(vctx->db, &job->node);
+	pool->committed++;
+
+	return (job->result);
+}
+
+/*
+ * Commit all outstanding jobs and stop the worker threads.  Returns
+ * the first error reported by a job.
+ */
+static isc_result_t
+verify_pool_destroy(vctx_t *vctx) {
+	verifypool_t *pool = vctx->pool;
+	isc_result_t result = ISC_R_SUCCESS;
+
+	while (pool->committed < pool->submitted) {
+		isc_result_t tresult = verify_commit(vctx);
+		if (result == ISC_R_SUCCESS) {
+			result = tresult;
+		}
+	}
+
+	LOCK(&pool->lock);
+	pool->shutdown = true;
+	BROADCAST(&pool->cond);
+	UNLOCK(&pool->lock);
+	for (size_t i = 0; i < pool->nthreads; i++) {
+		isc_thread_join(pool->threads[i], NULL);
+	}
+
+	for (size_t i = 0; i < pool->window; i++) {
+		isc_buffer_free(&pool->jobs[i].log);
+	}
+	isc_mem_cput(vctx->mctx, pool->threads, pool->nthreads,
+		     sizeof(pool->threads[0]));
+	isc_mem_cput(vctx->mctx, pool->jobs, pool->window,
+		     sizeof(pool->jobs[0]));
+	isc_condition_destroy(&pool->cond);
+	isc_mutex_destroy(&pool->lock);
+	isc_mem_put(vctx->mctx, pool, sizeof(*pool));
+	vctx->pool = NULL;
+
+	return (result);
+}
+
+/*
+ * Check the signatures of 'rdataset', in a worker thread if there is
+ * a pool.  Errors from earlier jobs may be returned instead.
+ */
+static isc_result_t
+verifyset_submit(vctx_t *vctx, dns_rdataset_t *rdataset,
+		 const dns_name_t *name, dns_dbnode_t *node,
+		 dst_key_t **dstkeys, size_t nkeys) {
+	verifypool_t *pool = vctx->pool;
+	verifyjob_t *job = NULL;
+
+	if (pool == NULL) {
+		return (verifyset(vctx, rdataset, name, node, dstkeys, nkeys,
+				  NULL));
+	}
+
+	if (pool->submitted - pool->committed == pool->window) {
+		isc_result_t result = verify_commit(vctx);
+		if (result != ISC_R_SUCCESS) {
+			return (result);
+		}
+	}
+
+	job = &pool->jobs[pool->submitted % pool->window];
+	dns_rdataset_clone(rdataset, &job->rdataset);
+	dns_name_copy(name, dns_fixedname_initname(&job->name));
+	dns_db_attachnode(vctx->db, node, &job->node);
+	isc_buffer_clear(job->log);
+	memset(job->bad_algorithms, 0, sizeof(job->bad_algorithms));
+	job->result = ISC_R_UNSET;
+	job->done = false;
+
+	LOCK(&pool->lock);
+	pool->submitted++;
+	SIGNAL(&pool->cond);
+	UNLOCK(&pool->lock);
+
+	return (ISC_R_SUCCESS);
+}
+
 static isc_result_t
 verifynode(vctx_t *vctx, const dns_name_t *name, dns_dbnode_t *node,
 	   bool delegation, dst_key_t **dstkeys, size_t nkeys,
@@ -944,8 +1201,8 @@ verifynode(vctx_t *vctx, const dns_name_t *name, dns_dbnode_t *node,
 		    (!delegation || rdataset.type == dns_rdatatype_ds ||
 		     rdataset.type == dns_rdatatype_nsec))
 		{
-			result = verifyset(vctx, &rdataset, name, node, dstkeys,
-					   nkeys);
+			result = verifyset_submit(vctx, &rdataset, name, node,
+						  dstkeys, nkeys);
 			if (result != ISC_R_SUCCESS) {
 				dns_rdataset_disassociate(&rdataset);
 				dns_rdatasetiter_destroy(&rdsiter);
@@ -1724,6 +1981,8 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 		}
 	}
 
+	verify_pool_create(vctx, dstkeys, nkeys);
+
 	result = dns_db_createiterator(vctx->db, DNS_DB_NONSEC3, &dbiter);
 	if (result != ISC_R_SUCCESS) {
 		zoneverify_log_error(vctx, "dns_db_createiterator(): %s",
@@ -1897,6 +2156,12 @@ verify_nodes(vctx_t *vctx, isc_result_t *vresult) {
 	result = ISC_R_SUCCESS;
 
 done:
+	if (vctx->pool != NULL) {
+		isc_result_t tresult = verify_pool_destroy(vctx);
+		if (result == ISC_R_SUCCESS) {
+			result = tresult;
+		}
+	}
 	while (nkeys-- > 0U) {
 		dst_key_free(&dstkeys[nkeys]);
 	}
@@ -53,6 +53,18 @@ struct zt_load_params {
 	bool newonly;
 };
 
+struct zt_load_zone {
+	dns_zone_t *zone;
+	off_t size;
+};
+
+struct zt_load_list {
+	isc_mem_t *mctx;
+	struct zt_load_zone *zones;
+	size_t count;
+	size_t alloc;
+};
+
 struct zt_freeze_params {
 	dns_view_t *view;
 	bool freeze;
@@ -275,9 +287,25 @@ dns_zt_flush(dns_zt_t *zt) {
 	atomic_store_release(&zt->flush, true);
 }
 
+/*
+ * Load-on-demand zones are loaded by the first query for them, not
+ * along with the rest of the table; but one that is already in
+ * memory is reloaded like any other zone so that it picks up changes.
+ */
+static bool
+ondemand(dns_zone_t *zone) {
+	return ((dns_zone_getoptions(zone) & DNS_ZONEOPT_LOADONDEMAND) != 0 &&
+		!dns_zone_isloaded(zone));
+}
+
 static isc_result_t
 load(dns_zone_t *zone, void *uap) {
 	isc_result_t result;
+
+	if (ondemand(zone)) {
+		return (ISC_R_SUCCESS);
+	}
+
 	result = dns_zone_load(zone, uap != NULL);
 	if (result == DNS_R_CONTINUE || result == DNS_R_UPTODATE ||
 	    result == DNS_R_DYNAMIC)
@@ -338,6 +366,10 @@ asyncload(dns_zone_t *zone, void *uap) {
 	REQUIRE(VALID_ZT(zt));
 	REQUIRE(zone != NULL);
 
+	if (ondemand(zone)) {
+		return (ISC_R_SUCCESS);
+	}
+
 	isc_refcount_increment(&zt->references);
 	isc_refcount_increment(&zt->loads_pending);
 
@@ -353,12 +385,57 @@ asyncload(dns_zone_t *zone, void *uap) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Add 'zone' to the list of zones to be loaded, along with the size of
+ * its zone file.
+ */
+static isc_result_t
+collectzone(dns_zone_t *zone, void *uap) {
+	struct zt_load_list *list = uap;
+	const char *file = NULL;
+	off_t size = 0;
+
+	if (list->count == list->alloc) {
+		size_t alloc = ISC_MAX(list->alloc * 2, 64);
+		list->zones = isc_mem_creget(list->mctx, list->zones,
+					     list->alloc, alloc,
+					     sizeof(list->zones[0]));
+		list->alloc = alloc;
+	}
+
+	file = dns_zone_getfile(zone);
+	if (file == NULL || isc_file_getsize(file, &size) != ISC_R_SUCCESS) {
+		size = 0;
+	}
+
+	list->zones[list->count].zone = NULL;
+	dns_zone_attach(zone, &list->zones[list->count].zone);
+	list->zones[list->count].size = size;
+	list->count++;
+
+	return (ISC_R_SUCCESS);
+}
+
+static int
+zonesize_cmp(const void *a, const void *b) {
+	const struct zt_load_zone *za = a, *zb = b;
+
+	if (za->size > zb->size) {
+		return (-1);
+	}
+	if (za->size < zb->size) {
+		return (1);
+	}
+	return (0);
+}
+
 isc_result_t
 dns_zt_asyncload(dns_zt_t *zt, bool newonly, dns_zt_callback_t *loaddone,
 		 void *arg) {
 	isc_result_t result;
 	uint_fast32_t loads_pending;
 	struct zt_load_params *params = NULL;
+	struct zt_load_list list = { .mctx = zt->mctx };
 
 	REQUIRE(VALID_ZT(zt));
 
@@ -378,7 +455,22 @@ dns_zt_asyncload(dns_zt_t *zt, bool newonly, dns_zt_callback_t *loaddone,
 		.loaddone_arg = arg,
 	};
 
-	result = dns_zt_apply(zt, false, NULL, asyncload, params);
+	/*
+	 * Start the biggest zones first, so that a few large zones
+	 * don't end up being loaded on their own after all the small
+	 * ones are done.
+	 */
+	result = dns_zt_apply(zt, false, NULL, collectzone, &list);
+	if (list.zones != NULL) {
+		qsort(list.zones, list.count, sizeof(list.zones[0]),
+		      zonesize_cmp);
+		for (size_t i = 0; i < list.count; i++) {
+			(void)asyncload(list.zones[i].zone, params);
+			dns_zone_detach(&list.zones[i].zone);
+		}
+		isc_mem_cput(zt->mctx, list.zones, list.alloc,
+			     sizeof(list.zones[0]));
+	}
 
 	/*
 	 * Have all the loads completed?
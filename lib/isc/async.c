@@ -24,6 +24,7 @@
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
+#include <isc/pause.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/signal.h>
@@ -37,11 +38,19 @@
 #include "job_p.h"
 #include "loop_p.h"
 
-void
-isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
-	REQUIRE(VALID_LOOP(loop));
-	REQUIRE(cb != NULL);
+/*
+ * When a wakeup finds at least ASYNC_BUSY_JOBS jobs, other loops are
+ * keeping this one busy: rather than go back to polling for events and
+ * wait to be woken up again, spin for up to ASYNC_BUSY_SPINS iterations
+ * for more jobs, at most ASYNC_BUSY_ROUNDS times in a row so that I/O
+ * is not starved.
+ */
+#define ASYNC_BUSY_JOBS	  64
+#define ASYNC_BUSY_SPINS  256
+#define ASYNC_BUSY_ROUNDS 8
 
+static isc_job_t *
+async_newjob(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	isc_job_t *job = isc_mem_get(loop->mctx, sizeof(*job));
 	*job = (isc_job_t){
 		.cb = cb,
@@ -50,6 +59,16 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 
 	cds_wfcq_node_init(&job->wfcq_node);
 
+	return (job);
+}
+
+void
+isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
+	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(cb != NULL);
+
+	isc_job_t *job = async_newjob(loop, cb, cbarg);
+
 	/*
 	 * cds_wfcq_enqueue() is non-blocking and enqueues the job to async
 	 * queue.
@@ -66,11 +85,61 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 }
 
 void
-isc__async_cb(uv_async_t *handle) {
-	isc_loop_t *loop = uv_handle_get_data(handle);
-	isc_jobqueue_t jobs;
+isc_async_batchinit(isc_asyncbatch_t *batch) {
+	REQUIRE(batch != NULL);
+
+	batch->loop = NULL;
+	__cds_wfcq_init(&batch->head, &batch->tail);
+}
 
+void
+isc_async_batchadd(isc_asyncbatch_t *batch, isc_loop_t *loop, isc_job_cb cb,
+		   void *cbarg) {
+	REQUIRE(batch != NULL);
 	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(cb != NULL);
+
+	if (batch->loop != loop) {
+		isc_async_batchrun(batch);
+		batch->loop = loop;
+	}
+
+	isc_job_t *job = async_newjob(loop, cb, cbarg);
+
+	(void)cds_wfcq_enqueue(&batch->head, &batch->tail, &job->wfcq_node);
+}
+
+void
+isc_async_batchrun(isc_asyncbatch_t *batch) {
+	REQUIRE(batch != NULL);
+
+	isc_loop_t *loop = batch->loop;
+	if (loop == NULL) {
+		return;
+	}
+	batch->loop = NULL;
+
+	/*
+	 * Splicing the batch into the async queue is safe against
+	 * concurrent cds_wfcq_enqueue() and against the loop splicing the
+	 * queue out, just like the enqueue in isc_async_run(); and as
+	 * there, the loop only needs to be woken up if the queue was
+	 * empty.
+	 */
+	enum cds_wfcq_ret ret = __cds_wfcq_splice_blocking(
+		&loop->async_jobs.head, &loop->async_jobs.tail, &batch->head,
+		&batch->tail);
+	INSIST(ret != CDS_WFCQ_RET_WOULDBLOCK);
+	if (ret == CDS_WFCQ_RET_DEST_EMPTY) {
+		int r = uv_async_send(&loop->async_trigger);
+		UV_RUNTIME_CHECK(uv_async_send, r);
+	}
+}
+
+static size_t
+async_runjobs(isc_loop_t *loop) {
+	isc_jobqueue_t jobs;
+	size_t njobs = 0;
 
 	/* Initialize local wfcqueue */
 	__cds_wfcq_init(&jobs.head, &jobs.tail);
@@ -84,9 +153,10 @@ isc__async_cb(uv_async_t *handle) {
 	 * it needs to block, unlike __cds_wfcq_splice_nonblocking().
 	 *
 	 * The reason we can use __cds_wfcq_splice_blocking() is that the
-	 * only other function we use is cds_wfcq_enqueue() which doesn't
-	 * require any synchronization (see the table in urcu/wfcqueue.h
-	 * for more details).
+	 * only other functions we use are cds_wfcq_enqueue() and splicing
+	 * into the queue in isc_async_batchrun(), which don't require any
+	 * synchronization (see the table in urcu/wfcqueue.h for more
+	 * details).
 	 */
 	enum cds_wfcq_ret ret = __cds_wfcq_splice_blocking(
 		&jobs.head, &jobs.tail, &loop->async_jobs.head,
@@ -97,7 +167,7 @@ isc__async_cb(uv_async_t *handle) {
 		 * Nothing to do, the source queue was empty - most
 		 * probably we were called from isc__async_close() below.
 		 */
-		return;
+		return (0);
 	}
 
 	/*
@@ -111,6 +181,38 @@ isc__async_cb(uv_async_t *handle) {
 		job->cb(job->cbarg);
 
 		isc_mem_put(loop->mctx, job, sizeof(*job));
+		njobs++;
+	}
+
+	return (njobs);
+}
+
+static bool
+async_busywait(isc_loop_t *loop) {
+	for (size_t spins = 0; spins < ASYNC_BUSY_SPINS; spins++) {
+		if (!cds_wfcq_empty(&loop->async_jobs.head,
+				    &loop->async_jobs.tail))
+		{
+			return (true);
+		}
+		isc_pause();
+	}
+
+	return (false);
+}
+
+void
+isc__async_cb(uv_async_t *handle) {
+	isc_loop_t *loop = uv_handle_get_data(handle);
+
+	REQUIRE(VALID_LOOP(loop));
+
+	size_t njobs = async_runjobs(loop);
+	for (size_t round = 0; round < ASYNC_BUSY_ROUNDS; round++) {
+		if (njobs < ASYNC_BUSY_JOBS || !async_busywait(loop)) {
+			break;
+		}
+		njobs = async_runjobs(loop);
 	}
 }
 
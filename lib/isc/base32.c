@@ -47,6 +47,63 @@ static const char base32[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZ234567="
 static const char base32hex[] = "0123456789ABCDEFGHIJKLMNOPQRSTUV="
 				"0123456789abcdefghijklmnopqrstuv";
 
+/*
+ * The value of each base32 digit in either case, 32 for the "="
+ * pad, or 0xff.
+ */
+static const uint8_t base32_val[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x20, 0xff, 0xff, 0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12,
+	0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a,
+	0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16,
+	0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff
+};
+
+/*
+ * The same for base32hex.
+ */
+static const uint8_t base32hex_val[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0xff, 0xff,
+	0xff, 0x20, 0xff, 0xff, 0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10,
+	0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c,
+	0x1d, 0x1e, 0x1f, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14,
+	0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff
+};
+
 static isc_result_t
 base32_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 	      isc_buffer_t *target, const char base[], char pad) {
@@ -96,7 +153,11 @@ base32_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 		buf[6] = base[((source->base[3] << 3) & 0x18) | /* 2 = 8 */
 			      ((source->base[4] >> 5) & 0x07)]; /* 3 + */
 		buf[7] = base[source->base[4] & 0x1f];		/* 5 = 8 */
-		RETERR(str_totext(buf, target));
+		if (isc_buffer_availablelength(target) < 8) {
+			return (ISC_R_NOSPACE);
+		}
+		memmove(isc_buffer_used(target), buf, 8);
+		isc_buffer_add(target, 8);
 		isc_region_consume(source, 5);
 
 		loops++;
@@ -143,7 +204,7 @@ typedef struct {
 	int digits;	      /*%< Number of buffered base32 digits */
 	bool seen_end;	      /*%< True if "=" end marker seen */
 	int val[8];
-	const char *base; /*%< Which encoding we are using */
+	const uint8_t *base; /*%< Digit values of the encoding in use */
 	int seen_32;	  /*%< Number of significant bytes if non
 			   * zero */
 	bool pad;	  /*%< Expect padding */
@@ -151,23 +212,15 @@ typedef struct {
 
 static isc_result_t
 base32_decode_char(base32_decode_ctx_t *ctx, int c) {
-	const char *s;
 	unsigned int last;
 
 	if (ctx->seen_end) {
 		return (ISC_R_BADBASE32);
 	}
-	if ((s = strchr(ctx->base, c)) == NULL) {
+	last = ctx->base[(uint8_t)c];
+	if (last == 0xff) {
 		return (ISC_R_BADBASE32);
 	}
-	last = (unsigned int)(s - ctx->base);
-
-	/*
-	 * Handle lower case.
-	 */
-	if (last > 32) {
-		last -= 33;
-	}
 
 	/*
 	 * Check that padding is contiguous.
@@ -257,6 +310,51 @@ base32_decode_char(base32_decode_ctx_t *ctx, int c) {
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * Decode whole groups of eight digits without padding straight into the
+ * target, for as long as there is room, leaving anything else to
+ * base32_decode_char().  Returns the number of characters consumed.
+ */
+static unsigned int
+base32_decode_fast(base32_decode_ctx_t *ctx, const unsigned char *src,
+		   unsigned int len) {
+	unsigned int n = 0;
+
+	if (ctx->digits != 0 || ctx->seen_end || ctx->seen_32 != 0) {
+		return (0);
+	}
+
+	while (len - n >= 8 && (ctx->length < 0 || ctx->length >= 5) &&
+	       isc_buffer_availablelength(ctx->target) >= 5)
+	{
+		uint8_t v[8], any = 0;
+		uint8_t *cp = NULL;
+
+		for (int i = 0; i < 8; i++) {
+			v[i] = ctx->base[src[n + i]];
+			any |= v[i];
+		}
+		/* Pad and invalid characters both have bit 5 set */
+		if ((any & 0x20) != 0) {
+			break;
+		}
+
+		cp = isc_buffer_used(ctx->target);
+		cp[0] = (v[0] << 3) | (v[1] >> 2);
+		cp[1] = (v[1] << 6) | (v[2] << 1) | (v[3] >> 4);
+		cp[2] = (v[3] << 4) | (v[4] >> 1);
+		cp[3] = (v[4] << 7) | (v[5] << 2) | (v[6] >> 3);
+		cp[4] = (v[6] << 5) | v[7];
+		isc_buffer_add(ctx->target, 5);
+		if (ctx->length >= 0) {
+			ctx->length -= 5;
+		}
+		n += 8;
+	}
+
+	return (n);
+}
+
 static isc_result_t
 base32_decode_finish(base32_decode_ctx_t *ctx) {
 	if (ctx->length > 0) {
@@ -278,7 +376,7 @@ base32_decode_finish(base32_decode_ctx_t *ctx) {
 }
 
 static isc_result_t
-base32_tobuffer(isc_lex_t *lexer, const char base[], bool pad,
+base32_tobuffer(isc_lex_t *lexer, const uint8_t base[], bool pad,
 		isc_buffer_t *target, int length) {
 	unsigned int before, after;
 	base32_decode_ctx_t ctx = {
@@ -305,7 +403,9 @@ base32_tobuffer(isc_lex_t *lexer, const char base[], bool pad,
 			break;
 		}
 		tr = &token.value.as_textregion;
-		for (i = 0; i < tr->length; i++) {
+		i = base32_decode_fast(&ctx, (unsigned char *)tr->base,
+				       tr->length);
+		for (; i < tr->length; i++) {
 			RETERR(base32_decode_char(&ctx, tr->base[i]));
 		}
 	}
@@ -322,31 +422,36 @@ base32_tobuffer(isc_lex_t *lexer, const char base[], bool pad,
 
 isc_result_t
 isc_base32_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
-	return (base32_tobuffer(lexer, base32, true, target, length));
+	return (base32_tobuffer(lexer, base32_val, true, target, length));
 }
 
 isc_result_t
 isc_base32hex_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
-	return (base32_tobuffer(lexer, base32hex, true, target, length));
+	return (base32_tobuffer(lexer, base32hex_val, true, target, length));
 }
 
 isc_result_t
 isc_base32hexnp_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
-	return (base32_tobuffer(lexer, base32hex, false, target, length));
+	return (base32_tobuffer(lexer, base32hex_val, false, target, length));
 }
 
 static isc_result_t
-base32_decodestring(const char *cstr, const char base[], bool pad,
+base32_decodestring(const char *cstr, const uint8_t base[], bool pad,
 		    isc_buffer_t *target) {
 	base32_decode_ctx_t ctx = {
 		.length = -1, .base = base, .target = target, .pad = pad
 	};
+	const char *end = cstr + strlen(cstr);
+
+	while (cstr < end) {
+		int c;
 
-	for (;;) {
-		int c = *cstr++;
-		if (c == '\0') {
+		cstr += base32_decode_fast(&ctx, (const unsigned char *)cstr,
+					   end - cstr);
+		if (cstr == end) {
 			break;
 		}
+		c = *cstr++;
 		if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
 			continue;
 		}
@@ -358,26 +463,28 @@ base32_decodestring(const char *cstr, const char base[], bool pad,
 
 isc_result_t
 isc_base32_decodestring(const char *cstr, isc_buffer_t *target) {
-	return (base32_decodestring(cstr, base32, true, target));
+	return (base32_decodestring(cstr, base32_val, true, target));
 }
 
 isc_result_t
 isc_base32hex_decodestring(const char *cstr, isc_buffer_t *target) {
-	return (base32_decodestring(cstr, base32hex, true, target));
+	return (base32_decodestring(cstr, base32hex_val, true, target));
 }
 
 isc_result_t
 isc_base32hexnp_decodestring(const char *cstr, isc_buffer_t *target) {
-	return (base32_decodestring(cstr, base32hex, false, target));
+	return (base32_decodestring(cstr, base32hex_val, false, target));
 }
 
 static isc_result_t
-base32_decoderegion(isc_region_t *source, const char base[], bool pad,
+base32_decoderegion(isc_region_t *source, const uint8_t base[], bool pad,
 		    isc_buffer_t *target) {
 	base32_decode_ctx_t ctx = {
 		.length = -1, .base = base, .target = target, .pad = pad
 	};
 
+	isc_region_consume(source, base32_decode_fast(&ctx, source->base,
+						      source->length));
 	while (source->length != 0) {
 		int c = *source->base;
 		RETERR(base32_decode_char(&ctx, c));
@@ -389,17 +496,17 @@ base32_decoderegion(isc_region_t *source, const char base[], bool pad,
 
 isc_result_t
 isc_base32_decoderegion(isc_region_t *source, isc_buffer_t *target) {
-	return (base32_decoderegion(source, base32, true, target));
+	return (base32_decoderegion(source, base32_val, true, target));
 }
 
 isc_result_t
 isc_base32hex_decoderegion(isc_region_t *source, isc_buffer_t *target) {
-	return (base32_decoderegion(source, base32hex, true, target));
+	return (base32_decoderegion(source, base32hex_val, true, target));
 }
 
 isc_result_t
 isc_base32hexnp_decoderegion(isc_region_t *source, isc_buffer_t *target) {
-	return (base32_decoderegion(source, base32hex, false, target));
+	return (base32_decoderegion(source, base32hex_val, false, target));
 }
 
 static isc_result_t
@@ -43,6 +43,34 @@ static const char base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvw"
 			     "xyz0123456789+/=";
 /*@}*/
 
+/*
+ * The value of each base64 digit, 64 for the "=" pad, or 0xff.
+ */
+static const uint8_t base64_val[256] = {
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x3e, 0xff, 0xff, 0xff, 0x3f,
+	0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x3b, 0x3c, 0x3d, 0xff, 0xff,
+	0xff, 0x40, 0xff, 0xff, 0xff, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06,
+	0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12,
+	0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0x1a, 0x1b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22, 0x23, 0x24,
+	0x25, 0x26, 0x27, 0x28, 0x29, 0x2a, 0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30,
+	0x31, 0x32, 0x33, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff
+};
+
 isc_result_t
 isc_base64_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 		  isc_buffer_t *target) {
@@ -55,13 +83,19 @@ isc_base64_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 
 	memset(buf, 0, sizeof(buf));
 	while (source->length > 2) {
-		buf[0] = base64[(source->base[0] >> 2) & 0x3f];
-		buf[1] = base64[((source->base[0] << 4) & 0x30) |
-				((source->base[1] >> 4) & 0x0f)];
-		buf[2] = base64[((source->base[1] << 2) & 0x3c) |
-				((source->base[2] >> 6) & 0x03)];
-		buf[3] = base64[source->base[2] & 0x3f];
-		RETERR(str_totext(buf, target));
+		unsigned char *cp = NULL;
+
+		if (isc_buffer_availablelength(target) < 4) {
+			return (ISC_R_NOSPACE);
+		}
+		cp = isc_buffer_used(target);
+		cp[0] = base64[(source->base[0] >> 2) & 0x3f];
+		cp[1] = base64[((source->base[0] << 4) & 0x30) |
+			       ((source->base[1] >> 4) & 0x0f)];
+		cp[2] = base64[((source->base[1] << 2) & 0x3c) |
+			       ((source->base[2] >> 6) & 0x03)];
+		cp[3] = base64[source->base[2] & 0x3f];
+		isc_buffer_add(target, 4);
 		isc_region_consume(source, 3);
 
 		loops++;
@@ -110,15 +144,16 @@ base64_decode_init(base64_decode_ctx_t *ctx, int length, isc_buffer_t *target) {
 
 static isc_result_t
 base64_decode_char(base64_decode_ctx_t *ctx, int c) {
-	const char *s;
+	uint8_t val;
 
 	if (ctx->seen_end) {
 		return (ISC_R_BADBASE64);
 	}
-	if ((s = strchr(base64, c)) == NULL) {
+	val = base64_val[(uint8_t)c];
+	if (val == 0xff) {
 		return (ISC_R_BADBASE64);
 	}
-	ctx->val[ctx->digits++] = (int)(s - base64);
+	ctx->val[ctx->digits++] = val;
 	if (ctx->digits == 4) {
 		int n;
 		unsigned char buf[3];
@@ -167,6 +202,48 @@ base64_decode_char(base64_decode_ctx_t *ctx, int c) {
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * Decode whole groups of four digits without padding straight into the
+ * target, for as long as there is room, leaving anything else to
+ * base64_decode_char().  Returns the number of characters consumed.
+ */
+static unsigned int
+base64_decode_fast(base64_decode_ctx_t *ctx, const unsigned char *src,
+		   unsigned int len) {
+	unsigned int n = 0;
+
+	if (ctx->digits != 0 || ctx->seen_end) {
+		return (0);
+	}
+
+	while (len - n >= 4 && (ctx->length < 0 || ctx->length >= 3) &&
+	       isc_buffer_availablelength(ctx->target) >= 3)
+	{
+		uint8_t a = base64_val[src[n]];
+		uint8_t b = base64_val[src[n + 1]];
+		uint8_t c = base64_val[src[n + 2]];
+		uint8_t d = base64_val[src[n + 3]];
+		uint8_t *cp = NULL;
+
+		/* Pad and invalid characters both have bit 6 set */
+		if (((a | b | c | d) & 0x40) != 0) {
+			break;
+		}
+
+		cp = isc_buffer_used(ctx->target);
+		cp[0] = (a << 2) | (b >> 4);
+		cp[1] = (b << 4) | (c >> 2);
+		cp[2] = (c << 6) | d;
+		isc_buffer_add(ctx->target, 3);
+		if (ctx->length >= 0) {
+			ctx->length -= 3;
+		}
+		n += 4;
+	}
+
+	return (n);
+}
+
 static isc_result_t
 base64_decode_finish(base64_decode_ctx_t *ctx) {
 	if (ctx->length > 0) {
@@ -205,7 +282,9 @@ isc_base64_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
 			break;
 		}
 		tr = &token.value.as_textregion;
-		for (i = 0; i < tr->length; i++) {
+		i = base64_decode_fast(&ctx, (unsigned char *)tr->base,
+				       tr->length);
+		for (; i < tr->length; i++) {
 			RETERR(base64_decode_char(&ctx, tr->base[i]));
 		}
 	}
@@ -223,13 +302,18 @@ isc_base64_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
 isc_result_t
 isc_base64_decodestring(const char *cstr, isc_buffer_t *target) {
 	base64_decode_ctx_t ctx;
+	const char *end = cstr + strlen(cstr);
 
 	base64_decode_init(&ctx, -1, target);
-	for (;;) {
-		int c = *cstr++;
-		if (c == '\0') {
+	while (cstr < end) {
+		int c;
+
+		cstr += base64_decode_fast(&ctx, (const unsigned char *)cstr,
+					   end - cstr);
+		if (cstr == end) {
 			break;
 		}
+		c = *cstr++;
 		if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
 			continue;
 		}
@@ -59,18 +59,22 @@ static const char hex[] = "0123456789ABCDEF";
 isc_result_t
 isc_hex_totext(isc_region_t *source, int wordlength, const char *wordbreak,
 	       isc_buffer_t *target) {
-	char buf[3];
 	unsigned int loops = 0;
 
 	if (wordlength < 2) {
 		wordlength = 2;
 	}
 
-	memset(buf, 0, sizeof(buf));
 	while (source->length > 0) {
-		buf[0] = hex[(source->base[0] >> 4) & 0xf];
-		buf[1] = hex[(source->base[0]) & 0xf];
-		RETERR(str_totext(buf, target));
+		unsigned char *cp = NULL;
+
+		if (isc_buffer_availablelength(target) < 2) {
+			return (ISC_R_NOSPACE);
+		}
+		cp = isc_buffer_used(target);
+		cp[0] = hex[(source->base[0] >> 4) & 0xf];
+		cp[1] = hex[(source->base[0]) & 0xf];
+		isc_buffer_add(target, 2);
 		isc_region_consume(source, 1);
 
 		loops++;
@@ -126,6 +130,46 @@ hex_decode_char(hex_decode_ctx_t *ctx, int c) {
 	return (ISC_R_SUCCESS);
 }
 
+/*%
+ * Decode pairs of digits straight into the target, for as long as
+ * there is room, leaving anything else to hex_decode_char().  Returns
+ * the number of characters consumed.
+ */
+static unsigned int
+hex_decode_fast(hex_decode_ctx_t *ctx, const unsigned char *src,
+		unsigned int len) {
+	unsigned int n = 0, count;
+	uint8_t *cp = NULL;
+
+	if (ctx->digits != 0) {
+		return (0);
+	}
+
+	count = ISC_MIN(len / 2, isc_buffer_availablelength(ctx->target));
+	if (ctx->length >= 0) {
+		count = ISC_MIN(count, (unsigned int)ctx->length);
+	}
+
+	cp = isc_buffer_used(ctx->target);
+	for (unsigned int i = 0; i < count; i++) {
+		uint8_t hi = isc_hex_char(src[n]);
+		uint8_t lo = isc_hex_char(src[n + 1]);
+
+		if (hi == 0 || lo == 0) {
+			count = i;
+			break;
+		}
+		cp[i] = ((src[n] - hi) << 4) | (src[n + 1] - lo);
+		n += 2;
+	}
+	isc_buffer_add(ctx->target, count);
+	if (ctx->length >= 0) {
+		ctx->length -= count;
+	}
+
+	return (n);
+}
+
 static isc_result_t
 hex_decode_finish(hex_decode_ctx_t *ctx) {
 	if (ctx->length > 0) {
@@ -164,7 +208,9 @@ isc_hex_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
 			break;
 		}
 		tr = &token.value.as_textregion;
-		for (i = 0; i < tr->length; i++) {
+		i = hex_decode_fast(&ctx, (unsigned char *)tr->base,
+				    tr->length);
+		for (; i < tr->length; i++) {
 			RETERR(hex_decode_char(&ctx, tr->base[i]));
 		}
 	}
@@ -182,13 +228,18 @@ isc_hex_tobuffer(isc_lex_t *lexer, isc_buffer_t *target, int length) {
 isc_result_t
 isc_hex_decodestring(const char *cstr, isc_buffer_t *target) {
 	hex_decode_ctx_t ctx;
+	const char *end = cstr + strlen(cstr);
 
 	hex_decode_init(&ctx, -1, target);
-	for (;;) {
-		int c = *cstr++;
-		if (c == '\0') {
+	while (cstr < end) {
+		int c;
+
+		cstr += hex_decode_fast(&ctx, (const unsigned char *)cstr,
+					end - cstr);
+		if (cstr == end) {
 			break;
 		}
+		c = *cstr++;
 		if (c == ' ' || c == '\t' || c == '\n' || c == '\r') {
 			continue;
 		}
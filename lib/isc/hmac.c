@@ -71,6 +71,19 @@ isc_hmac_init(isc_hmac_t *hmac_st, const void *key, const size_t keylen,
 	return (ISC_R_SUCCESS);
 }
 
+isc_result_t
+isc_hmac_copy(isc_hmac_t *to, const isc_hmac_t *from) {
+	REQUIRE(to != NULL);
+	REQUIRE(from != NULL);
+
+	if (EVP_MD_CTX_copy_ex(to, from) != 1) {
+		ERR_clear_error();
+		return (ISC_R_CRYPTOFAILURE);
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 isc_result_t
 isc_hmac_reset(isc_hmac_t *hmac_st) {
 	REQUIRE(hmac_st != NULL);
@@ -127,21 +127,44 @@ isc__ascii_load8(const uint8_t *ptr) {
 	return (bytes);
 }
 
+/*
+ * Same for 4 bytes
+ */
+static inline uint32_t
+isc__ascii_load4(const uint8_t *ptr) {
+	uint32_t bytes = 0;
+	memmove(&bytes, ptr, sizeof(bytes));
+	return (bytes);
+}
+
 /*
  * Compare `len` bytes at `a` and `b` for case-insensitive equality
+ *
+ * The bytes that do not fill a whole word are not compared one at a
+ * time: when there are at least 4 of them in all, the last word is
+ * loaded so that it ends at `len`, overlapping bytes that were already
+ * found to be equal.
  */
 static inline bool
 isc_ascii_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
-	uint64_t a8 = 0, b8 = 0;
-	while (len >= 8) {
-		a8 = isc_ascii_tolower8(isc__ascii_load8(a));
-		b8 = isc_ascii_tolower8(isc__ascii_load8(b));
-		if (a8 != b8) {
-			return (false);
+	if (len >= 8) {
+		unsigned int last = len - 8;
+		for (unsigned int i = 0; i < last; i += 8) {
+			if (isc_ascii_tolower8(isc__ascii_load8(a + i)) !=
+			    isc_ascii_tolower8(isc__ascii_load8(b + i)))
+			{
+				return (false);
+			}
 		}
-		len -= 8;
-		a += 8;
-		b += 8;
+		return (isc_ascii_tolower8(isc__ascii_load8(a + last)) ==
+			isc_ascii_tolower8(isc__ascii_load8(b + last)));
+	}
+	if (len >= 4) {
+		unsigned int last = len - 4;
+		return (isc_ascii_tolower4(isc__ascii_load4(a)) ==
+				isc_ascii_tolower4(isc__ascii_load4(b)) &&
+			isc_ascii_tolower4(isc__ascii_load4(a + last)) ==
+				isc_ascii_tolower4(isc__ascii_load4(b + last)));
 	}
 	while (len-- > 0) {
 		if (isc_ascii_tolower(*a++) != isc_ascii_tolower(*b++)) {
@@ -156,19 +179,38 @@ isc_ascii_lowerequal(const uint8_t *a, const uint8_t *b, unsigned int len) {
  * Unlike the previous functions (which do not need to care about byte
  * order) here we need to ensure the comparisons are lexicographic,
  * i.e. they treat the strings as big-endian numbers.
+ *
+ * The overlapping last word works here too: its leading bytes are equal,
+ * so the first difference in it decides the order.
  */
 static inline int
 isc_ascii_lowercmp(const uint8_t *a, const uint8_t *b, unsigned int len) {
 	uint64_t a8 = 0, b8 = 0;
-	while (len >= 8) {
-		a8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(a)));
-		b8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(b)));
+	if (len >= 8) {
+		const uint8_t *a_end = a + len - 8, *b_end = b + len - 8;
+		while (a < a_end) {
+			a8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(a)));
+			b8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(b)));
+			if (a8 != b8) {
+				goto ret;
+			}
+			a += 8;
+			b += 8;
+		}
+		a8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(a_end)));
+		b8 = isc_ascii_tolower8(htobe64(isc__ascii_load8(b_end)));
+		goto ret;
+	}
+	if (len >= 4) {
+		const uint8_t *a_end = a + len - 4, *b_end = b + len - 4;
+		a8 = isc_ascii_tolower4(htobe32(isc__ascii_load4(a)));
+		b8 = isc_ascii_tolower4(htobe32(isc__ascii_load4(b)));
 		if (a8 != b8) {
 			goto ret;
 		}
-		len -= 8;
-		a += 8;
-		b += 8;
+		a8 = isc_ascii_tolower4(htobe32(isc__ascii_load4(a_end)));
+		b8 = isc_ascii_tolower4(htobe32(isc__ascii_load4(b_end)));
+		goto ret;
 	}
 	while (len-- > 0) {
 		a8 = isc_ascii_tolower(*a++);
@@ -30,6 +30,18 @@
 #include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/types.h>
+#include <isc/urcu.h>
+
+/*%
+ * A batch of jobs to be handed to an event loop at once, with a single
+ * enqueue and at most one wakeup.  Jobs for another loop can be added
+ * too; the jobs batched so far are then sent first.
+ */
+typedef struct isc_asyncbatch {
+	isc_loop_t	      *loop;
+	struct __cds_wfcq_head head;
+	struct cds_wfcq_tail   tail;
+} isc_asyncbatch_t;
 
 ISC_LANG_BEGINDECLS
 
@@ -51,4 +63,39 @@ isc_async_run(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
  * Helper macro to run the job on the current loop
  */
 
+void
+isc_async_batchinit(isc_asyncbatch_t *batch);
+/*%<
+ * Initialize an empty batch.
+ */
+
+void
+isc_async_batchadd(isc_asyncbatch_t *batch, isc_loop_t *loop, isc_job_cb cb,
+		   void *cbarg);
+/*%<
+ * Add the job callback 'cb' to be run on the 'loop' event loop to
+ * 'batch'.  If the batch holds jobs for a different loop, they are sent
+ * with isc_async_batchrun() first.
+ *
+ * Jobs added to a batch run in the order they were added, after the
+ * jobs already scheduled on 'loop' with isc_async_run().
+ *
+ * Requires:
+ *
+ *\li	'batch' is an initialized batch
+ *\li	'loop' is a valid isc event loop
+ *\li	'cb' is a callback function, must be non-NULL
+ */
+
+void
+isc_async_batchrun(isc_asyncbatch_t *batch);
+/*%<
+ * Schedule all the jobs in 'batch' on their loop, and leave the batch
+ * empty.  Does nothing if the batch is empty.
+ *
+ * Requires:
+ *
+ *\li	'batch' is an initialized batch
+ */
+
 ISC_LANG_ENDDECLS
@@ -80,6 +80,19 @@ isc_result_t
 isc_hmac_init(isc_hmac_t *hmac, const void *key, const size_t keylen,
 	      const isc_md_type_t *type);
 
+/**
+ * isc_hmac_copy:
+ * @to: HMAC context
+ * @from: HMAC context
+ *
+ * This function makes @to a copy of @from, including its key and any data
+ * already passed to isc_hmac_update().  Copying a context that has been set
+ * up with isc_hmac_init() is cheaper than setting up another one with the
+ * same key.
+ */
+isc_result_t
+isc_hmac_copy(isc_hmac_t *to, const isc_hmac_t *from);
+
 /**
  * isc_hmac_reset:
  * @hmac: HMAC context
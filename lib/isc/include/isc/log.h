@@ -65,7 +65,7 @@
 #define ISC_LOG_PRINTALL      0x0003F
 #define ISC_LOG_BUFFERED      0x00040
 #define ISC_LOG_DEBUGONLY     0x01000
-#define ISC_LOG_OPENERR	      0x08000 /* internal */
+#define ISC_LOG_BINARY	      0x08000 /* isc_log_writebinary() records */
 #define ISC_LOG_ISO8601	      0x10000 /* if PRINTTIME, use ISO8601 */
 #define ISC_LOG_UTC	      0x20000 /* if PRINTTIME, use UTC */
 /*@}*/
@@ -414,6 +414,9 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
  *	debug level of the logging context (see isc_log_setdebuglevel)
  *	is non-zero.
  *
+ *	#ISC_LOG_BINARY will mark the channel as receiving only the
+ *	records written with isc_log_writebinary().
+ *
  * Requires:
  *\li	lcfg is a valid logging configuration.
  *
@@ -427,7 +430,9 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
  *\li	level is >= #ISC_LOG_CRITICAL (the most negative logging level).
  *
  *\li	flags does not include any bits aside from the ISC_LOG_PRINT* bits,
- *	#ISC_LOG_DEBUGONLY or #ISC_LOG_BUFFERED.
+ *	#ISC_LOG_DEBUGONLY, #ISC_LOG_BUFFERED or #ISC_LOG_BINARY.
+ *
+ *\li	#ISC_LOG_BINARY is only set for #ISC_LOG_TOFILE channels.
  *
  * Ensures:
  *\li	#ISC_R_SUCCESS
@@ -639,6 +644,62 @@ isc_log_getdebuglevel(isc_log_t *lctx);
  *\li	The current logging debugging level is returned.
  */
 
+void
+isc_log_setasync(isc_log_t *lctx, unsigned int maxqueued);
+/*%<
+ * Set the number of lines destined for file channels which may wait
+ * for a dedicated writer thread to write them.
+ *
+ * Notes:
+ *\li	When 'maxqueued' is greater than zero, messages are still
+ *	formatted by the thread logging them, but the file I/O happens
+ *	in the writer thread, which is started if necessary.  When the
+ *	queue is full, further messages are dropped, and the number of
+ *	dropped messages is logged to the channel once there is room
+ *	again.  Syslog channels are always written synchronously.
+ *
+ *\li	Setting 'maxqueued' to 0 writes out the queued lines, stops the
+ *	writer thread and restores synchronous writing.
+ *
+ *\li	This function must not be called concurrently with itself.
+ *
+ * Requires:
+ *\li	lctx is a valid logging context.
+ */
+
+bool
+isc_log_wantbinary(isc_log_t *lctx);
+/*%<
+ * Return true if the current logging configuration uses any channel
+ * with the #ISC_LOG_BINARY flag, so callers can avoid building binary
+ * records that would not be written.
+ *
+ * Requires:
+ *\li	lctx is a valid logging context or NULL.
+ */
+
+void
+isc_log_writebinary(isc_log_t *lctx, isc_logcategory_t *category,
+		    isc_logmodule_t *module, const void *data, size_t size);
+/*%<
+ * Write the binary record of 'size' bytes at 'data' to the
+ * #ISC_LOG_BINARY channels configured for 'category' and 'module'.
+ *
+ * Notes:
+ *\li	Binary records are written verbatim, so they must carry their
+ *	own framing.  They are not subject to severity levels and are
+ *	never sent to ordinary channels, nor are text messages written
+ *	to binary channels.
+ *
+ *\li	Like text messages, binary records are written by the writer
+ *	thread when one has been enabled with isc_log_setasync().
+ *
+ * Requires:
+ *\li	lctx is a valid logging context or NULL.
+ *\li	category and module are registered with lctx.
+ *\li	data is not NULL.
+ */
+
 bool
 isc_log_wouldlog(isc_log_t *lctx, int level);
 /*%<
@@ -19,6 +19,7 @@
 #include <isc/lang.h>
 #include <isc/mem.h>
 #include <isc/refcount.h>
+#include <isc/stdtime.h>
 #include <isc/types.h>
 
 typedef void (*isc_job_cb)(void *);
@@ -97,6 +98,18 @@ isc_loopmgr_resume(isc_loopmgr_t *loopmgr);
 uint32_t
 isc_loopmgr_nloops(isc_loopmgr_t *loopmgr);
 
+void
+isc_loopmgr_setaffinity(isc_loopmgr_t *loopmgr, const int *cpus);
+/*%<
+ * Bind the thread running each loop 'i' to processor 'cpus[i]' when the
+ * loop manager is started; a negative value leaves that loop unbound.
+ * Failures to bind are logged and otherwise ignored.
+ *
+ * Requires:
+ *\li	'loopmgr' is a valid loop manager that has not been started.
+ *\li	'cpus' has an entry for each of the loops.
+ */
+
 isc_job_t *
 isc_loop_setup(isc_loop_t *loop, isc_job_cb cb, void *cbarg);
 isc_job_t *
@@ -215,4 +228,17 @@ isc_loop_now(isc_loop_t *loop);
  *
  * \li 'loop' is a valid loop.
  */
+
+isc_stdtime_t
+isc_loop_stdtime(void);
+/*%<
+ * Returns the wall clock time in seconds, like isc_stdtime_now(), but
+ * on a loop thread the clock is only read once per loop tick and the
+ * cached value is returned for the rest of the tick.  On any other
+ * thread this is isc_stdtime_now().
+ *
+ * This is meant for hot paths that compare against TTLs and other
+ * expiry times in seconds, where the time the current tick started
+ * is precise enough.
+ */
 ISC_LANG_ENDDECLS
@@ -79,6 +79,8 @@ extern unsigned int isc_mem_defaultflags;
 #define ISC_MEMFLAG_RESERVED2 0x00000002 /* reserved, obsoleted, don't use */
 #define ISC_MEMFLAG_FILL \
 	0x00000004 /* fill with pattern after alloc and frees */
+#define ISC_MEMFLAG_ARENAS \
+	0x00000008 /* dedicated jemalloc arenas for loops and subsystems */
 
 /*%
  * Define ISC_MEM_DEFAULTFILL=1 to turn filling the memory with pattern
@@ -232,6 +234,33 @@ isc__mem_create_arena(isc_mem_t **_ISC_MEM_FLARG);
  * mctxp != NULL && *mctxp == NULL */
 /*@}*/
 
+#define isc_mem_create_decay(cp, dirty, muzzy) \
+	isc__mem_create_decay((cp), (dirty), (muzzy)_ISC_MEM_FILELINE)
+void
+isc__mem_create_decay(isc_mem_t **mctxp, const ssize_t dirty_decay_ms,
+		      const ssize_t muzzy_decay_ms _ISC_MEM_FLARG);
+/*!<
+ * \brief Create a memory context for a subsystem with its own memory
+ * release policy.  When #ISC_MEMFLAG_ARENAS is set in
+ * isc_mem_defaultflags, this is isc_mem_create_arena() followed by
+ * setting the arena's dirty and muzzy decay times (a negative value
+ * keeps the jemalloc default); otherwise it is isc_mem_create().
+ *
+ * Requires:
+ * mctxp != NULL && *mctxp == NULL */
+/*@}*/
+
+void
+isc_mem_thread_arena(void);
+/*!<
+ * \brief When #ISC_MEMFLAG_ARENAS is set in isc_mem_defaultflags, create
+ * a jemalloc arena and make it the default arena of the calling thread,
+ * with the thread cache enabled, so that every allocation made by the
+ * thread stays in memory owned by that thread.  The arena lives for as
+ * long as the process.  Otherwise, or when jemalloc is not available,
+ * this is a no-op.
+ */
+
 isc_result_t
 isc_mem_arena_set_muzzy_decay_ms(isc_mem_t *mctx, const ssize_t decay_ms);
 
@@ -303,6 +332,14 @@ isc_mem_inuse(isc_mem_t *mctx);
  * allocated from the system but not yet used.
  */
 
+size_t
+isc_mem_allocations(isc_mem_t *mctx);
+/*%<
+ * Get the number of allocations made from 'mctx' since it was created,
+ * including reallocations.  Memory pool gets that are satisfied from
+ * the pool's free list are not counted.
+ */
+
 bool
 isc_mem_isovermem(isc_mem_t *mctx);
 /*%<
@@ -436,6 +473,22 @@ isc_mempool_setname(isc_mempool_t *restrict mpctx, const char *name);
  *\li	name != NULL;
  */
 
+void
+isc_mempool_settid(isc_mempool_t *restrict mpctx, uint32_t tid);
+/*%<
+ * Bind the pool to the loop with thread ID 'tid'.
+ *
+ * Items can only be taken from a bound pool on that loop, but they can
+ * be returned with isc_mempool_put() from any thread.  Items returned
+ * on other threads are pushed onto a lock-free list, and the owning
+ * loop recycles them the next time its own free list runs empty,
+ * instead of them going back to the memory context.
+ *
+ * Requires:
+ *\li	mpctx is a valid pool that has not given out any items yet.
+ *\li	tid is a valid thread ID.
+ */
+
 /*
  * The following functions get/set various parameters.  Note that due to
  * the unlocked nature of pools these are potentially random values
@@ -31,6 +31,11 @@
 #define HAVE_SO_REUSEPORT_LB 1
 #endif
 
+#if HAVE_SO_REUSEPORT_LB && defined(__linux__) && \
+	defined(SO_ATTACH_REUSEPORT_CBPF)
+#define HAVE_SO_ATTACH_REUSEPORT_CBPF 1
+#endif
+
 /*
  * Convenience macros to specify on how many threads should socket listen
  */
@@ -363,7 +368,9 @@ isc_nm_read(isc_nmhandle_t *handle, isc_nm_recv_cb_t cb, void *cbarg);
 void
 isc_nm_read_stop(isc_nmhandle_t *handle);
 /*%<
- * Stop reading on this handle's socket.
+ * Stop reading on this handle's socket.  The read callback is not
+ * called.  For UDP, this is only supported on client (connected)
+ * sockets, which are left open for a subsequent isc_nm_read().
  *
  * Requires:
  * \li	'handle' is a valid netmgr handle.
@@ -569,6 +576,42 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, bool enabled);
  * \li	'mgr' is a valid netmgr.
  */
 
+bool
+isc_nm_getcpusteering(isc_nm_t *mgr);
+void
+isc_nm_setcpusteering(isc_nm_t *mgr, bool enabled);
+/*%<
+ * Get and set whether load balanced listening sockets steer incoming
+ * packets and connections by the CPU that received them, instead of by
+ * the hash of the connection 4-tuple.  All traffic received on one CPU
+ * is then handled by the same networking thread.  This has no effect
+ * unless load balancing of the sockets is enabled, and it is only
+ * supported on Linux.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
+void
+isc_nm_gettcplistenopts(isc_nm_t *mgr, uint32_t *defer_accept,
+			uint32_t *fastopen);
+void
+isc_nm_settcplistenopts(isc_nm_t *mgr, uint32_t defer_accept,
+			uint32_t fastopen);
+/*%<
+ * Get and set the options of the TCP listening sockets created after
+ * the call.  If 'defer_accept' is not 0, a new connection is only
+ * accepted once the client has sent data on it, or after
+ * 'defer_accept' seconds, so the reading timer and the TCP quota are
+ * only taken for connections that carry a query.  If 'fastopen' is not
+ * 0, server-side TCP Fast Open is enabled with a queue of at most
+ * 'fastopen' pending requests.  Options that the system does not
+ * support are logged and ignored when listening.
+ *
+ * Requires:
+ * \li	'mgr' is a valid netmgr.
+ */
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised);
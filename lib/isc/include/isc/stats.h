@@ -80,6 +80,9 @@ enum {
 	isc_sockstatscounter_tcp4clients,
 	isc_sockstatscounter_tcp6clients,
 
+	isc_sockstatscounter_tlshandshake,
+	isc_sockstatscounter_tlsresumed,
+
 	isc_sockstatscounter_max,
 };
 
@@ -107,6 +110,27 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters);
  *\li	'statsp' != NULL && '*statsp' == NULL.
  */
 
+void
+isc_stats_create_pertid(isc_mem_t *mctx, isc_stats_t **statsp,
+			int ncounters);
+/*%<
+ * Like isc_stats_create(), but the counters are also kept per thread:
+ * each loop thread updates its own copy of the counters, on its own
+ * cache lines, without atomic read-modify-write operations, and the
+ * copies are only summed up when the counters are read.  This is meant
+ * for the few server-wide sets of counters that are updated for every
+ * request; it uses ncounters * sizeof(isc_statscounter_t) bytes of
+ * memory per thread.
+ *
+ * The threads that are not loop threads, or if the loop manager has not
+ * been created yet, update the shared counters as usual.
+ *
+ * Requires:
+ *\li	'mctx' must be a valid memory context.
+ *
+ *\li	'statsp' != NULL && '*statsp' == NULL.
+ */
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp);
 /*%<
@@ -54,6 +54,18 @@ isc_thread_yield(void);
 void
 isc_thread_setname(isc_thread_t thread, const char *name);
 
+isc_result_t
+isc_thread_setaffinity(int cpu);
+/*%<
+ * Bind the calling thread to processor 'cpu'.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOTIMPLEMENTED if the system has no way to do it
+ *\li	Other errors if the processor does not exist or is not available
+ *	to the process.
+ */
+
 #define isc_thread_self (uintptr_t) pthread_self
 
 ISC_LANG_ENDDECLS
@@ -607,6 +607,82 @@ isc_tlsctx_set_random_session_id_context(isc_tlsctx_t *ctx);
  *\li   'ctx' - a valid non-NULL pointer;
  */
 
+typedef struct isc_tlsctx_ticketkeys isc_tlsctx_ticketkeys_t;
+/*%<
+ * A set of keys used to encrypt and decrypt stateless TLS session
+ * tickets (RFC 5077, RFC 8446), which can be shared between any number
+ * of server-side TLS contexts.  The key used to issue new tickets is
+ * replaced every 'lifetime' seconds; tickets issued with one of the
+ * two keys preceding it are still accepted, but are renewed.
+ */
+
+void
+isc_tlsctx_ticketkeys_create(isc_mem_t *mctx, uint32_t lifetime,
+			     isc_tlsctx_ticketkeys_t **keysp);
+/*%<
+ * Create a new set of session ticket keys, rotated every 'lifetime'
+ * seconds.
+ *
+ * Requires:
+ *\li	'mctx' is a valid memory context;
+ *\li	'lifetime' > 0;
+ *\li	'keysp' is a valid pointer to a pointer containing 'NULL'.
+ */
+
+void
+isc_tlsctx_ticketkeys_attach(isc_tlsctx_ticketkeys_t  *source,
+			     isc_tlsctx_ticketkeys_t **targetp);
+/*%<
+ * Create a reference to the session ticket keys.
+ *
+ * Requires:
+ *\li	'source' is valid session ticket keys;
+ *\li	'targetp' is a valid pointer to a pointer containing 'NULL'.
+ */
+
+void
+isc_tlsctx_ticketkeys_detach(isc_tlsctx_ticketkeys_t **keysp);
+/*%<
+ * Remove a reference to the session ticket keys, destroying them when
+ * the last reference is gone.
+ *
+ * Requires:
+ *\li	'keysp' is a valid pointer to valid session ticket keys.
+ */
+
+void
+isc_tlsctx_ticketkeys_setlifetime(isc_tlsctx_ticketkeys_t *keys,
+				  uint32_t		   lifetime);
+/*%<
+ * Change how often the session ticket keys are rotated.  The new
+ * lifetime applies to the key currently in use as well.
+ *
+ * Requires:
+ *\li	'keys' is valid session ticket keys;
+ *\li	'lifetime' > 0.
+ */
+
+void
+isc_tlsctx_set_ticketkeys(isc_tlsctx_t *ctx, isc_tlsctx_ticketkeys_t *keys,
+			  const char *context);
+/*%<
+ * Make the server-side TLS context 'ctx' issue and accept session
+ * tickets encrypted with 'keys' instead of the per-context keys
+ * OpenSSL generates.  The session ID context of 'ctx' is derived from
+ * 'keys' and 'context', overriding the one set by
+ * isc_tlsctx_set_random_session_id_context(): sessions established
+ * through one context can be resumed through any other context which
+ * uses the same keys and 'context' string.  Contexts with different
+ * peer verification settings must therefore use different 'context'
+ * strings.
+ *
+ * Requires:
+ *\li	'ctx' is a valid server-side TLS context which does not use
+ *	session ticket keys yet;
+ *\li	'keys' is valid session ticket keys;
+ *\li	'context' is a valid, NUL-terminated string.
+ */
+
 void
 isc__tls_initialize(void);
 
@@ -22,20 +22,66 @@ typedef void (*isc_work_cb)(void *arg);
 typedef void (*isc_after_work_cb)(void *arg);
 typedef struct isc_work isc_work_t;
 
+/*%
+ * Classes of offloaded work.  Interactive work, such as signature
+ * verification that a client is waiting for, is handed to the thread
+ * pool at once.  Bulk work (zone loads and dumps, transfers, policy
+ * zone updates) may only occupy part of the pool, and background work
+ * (maintenance such as journal compaction) a smaller part still and
+ * only when no bulk work is waiting; the rest is held back in FIFO
+ * order until a thread of the class becomes free.
+ */
+typedef enum {
+	isc_workclass_interactive = 0,
+	isc_workclass_bulk,
+	isc_workclass_background,
+	isc_workclass_max,
+} isc_workclass_t;
+
 ISC_LANG_BEGINDECLS
 
 void
 isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
 		 isc_after_work_cb after_work_cb, void *cbarg);
 /*%<
- * Schedules work to be handled by the libuv thread pool (see uv_work_t).
- * The function specified in `work_cb` will be run by a thread in the
- * thread pool; when complete, the `after_work_cb` function will run
- * in 'loop' to inform the caller that the work was completed.
+ * Schedules interactive work to be handled by the libuv thread pool
+ * (see uv_work_t).  The function specified in `work_cb` will be run by
+ * a thread in the thread pool; when complete, the `after_work_cb`
+ * function will run in 'loop' to inform the caller that the work was
+ * completed.
+ *
+ * Requires:
+ * \li 'loop' is a valid event loop.
+ * \li 'work_cb' and 'after_work_cb' are not NULL.
+ */
+
+void
+isc_work_enqueueclass(isc_loop_t *loop, isc_workclass_t workclass,
+		      isc_work_cb work_cb, isc_after_work_cb after_work_cb,
+		      void *cbarg);
+/*%<
+ * Like isc_work_enqueue(), but for work of class 'workclass'.  Bulk and
+ * background work may wait before it is handed to the thread pool;
+ * 'after_work_cb' still runs in 'loop'.
  *
  * Requires:
  * \li 'loop' is a valid event loop.
+ * \li 'workclass' is a valid work class.
  * \li 'work_cb' and 'after_work_cb' are not NULL.
  */
 
+void
+isc_work_stats(isc_loopmgr_t *loopmgr, isc_workclass_t workclass,
+	       uint32_t *runningp, uint32_t *waitingp);
+/*%<
+ * Return the number of jobs of class 'workclass' that are in the thread
+ * pool (queued there or running) in '*runningp', and the number held
+ * back waiting for their turn in '*waitingp'.
+ *
+ * Requires:
+ * \li 'loopmgr' is a valid loop manager.
+ * \li 'workclass' is a valid work class.
+ * \li 'runningp' and 'waitingp' are not NULL.
+ */
+
 ISC_LANG_ENDDECLS
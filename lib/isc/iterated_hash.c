@@ -12,11 +12,14 @@
  */
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include <openssl/err.h>
 #include <openssl/opensslv.h>
 
+#include <isc/endian.h>
 #include <isc/iterated_hash.h>
 #include <isc/thread.h>
 #include <isc/util.h>
@@ -175,3 +178,197 @@ isc__iterated_hash_shutdown(void) {
 }
 
 #endif /* HAVE_SHA1_INIT */
+
+/*
+ * Multi-buffer SHA-1.
+ *
+ * The SHA-1 computations of ISC_ITERATED_HASH_LANES independent inputs
+ * are interleaved lanewise, one lane per 32-bit element of a vector,
+ * so that the message schedule and the compression rounds of all of
+ * them are carried out by the same instructions.  The vectors are
+ * expressed with the compiler's generic vector extensions, which are
+ * mapped onto SSE2, AVX or NEON registers as available, without any
+ * architecture specific code.
+ */
+
+#define SHA1_BLOCKSIZE	16 /* 32-bit words */
+#define SHA1_DIGESTSIZE 20 /* bytes */
+
+/*
+ * The longest input is a 255 octet owner name followed by a 255 octet
+ * salt, plus the 0x80 terminator and the 64-bit message length.
+ */
+#define SHA1_MAXBLOCKS ((255 + 255 + 9 + 63) / 64)
+
+#define SHA1_VECSIZE (ISC_ITERATED_HASH_LANES * sizeof(uint32_t))
+
+typedef uint32_t sha1_vec_t __attribute__((vector_size(SHA1_VECSIZE)));
+
+typedef struct sha1_multi {
+	unsigned char buf[ISC_ITERATED_HASH_LANES][SHA1_MAXBLOCKS * 64];
+	size_t nblocks[ISC_ITERATED_HASH_LANES];
+} sha1_multi_t;
+
+#define ROL(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+/*
+ * SHA-1 rounds 'from' to 'to' - 1, which all use the function 'f' of
+ * 'b', 'c' and 'd' and the constant 'k'.
+ */
+#define SHA1_ROUNDS(from, to, f, k)                                       \
+	for (unsigned int t = (from); t < (to); t++) {                    \
+		sha1_vec_t tmp;                                           \
+		if (t >= SHA1_BLOCKSIZE) {                                \
+			tmp = w[(t - 3) & 15] ^ w[(t - 8) & 15] ^         \
+			      w[(t - 14) & 15] ^ w[t & 15];               \
+			w[t & 15] = ROL(tmp, 1);                          \
+		}                                                         \
+		tmp = ROL(a, 5) + (f) + e + (uint32_t)(k) + w[t & 15];    \
+		e = d;                                                    \
+		d = c;                                                    \
+		c = ROL(b, 30);                                           \
+		b = a;                                                    \
+		a = tmp;                                                  \
+	}
+
+/*
+ * Store 'data' followed by 'salt', padded as SHA-1 requires, as the
+ * message of 'lane'.
+ */
+static void
+sha1_multi_load(sha1_multi_t *m, unsigned int lane, const unsigned char *data,
+		size_t datalen, const unsigned char *salt, size_t saltlen) {
+	unsigned char *buf = m->buf[lane];
+	size_t len = datalen + saltlen;
+	size_t padded = (len + 9 + 63) & ~(size_t)63;
+	uint64_t bits = (uint64_t)len * 8;
+
+	INSIST(padded <= sizeof(m->buf[lane]));
+
+	memmove(buf, data, datalen);
+	if (saltlen > 0) {
+		memmove(buf + datalen, salt, saltlen);
+	}
+	buf[len] = 0x80;
+	memset(buf + len + 1, 0, padded - len - 9);
+	ISC_U32TO8_BE(buf + padded - 8, (uint32_t)(bits >> 32));
+	ISC_U32TO8_BE(buf + padded - 4, (uint32_t)bits);
+
+	m->nblocks[lane] = padded / 64;
+}
+
+/*
+ * Compute the SHA-1 digests of the messages of all the lanes and
+ * store them in 'out'.
+ */
+static void
+sha1_multi_digest(sha1_multi_t *m,
+		  unsigned char *const out[ISC_ITERATED_HASH_LANES]) {
+	sha1_vec_t h0 = (sha1_vec_t){ 0 } + 0x67452301;
+	sha1_vec_t h1 = (sha1_vec_t){ 0 } + 0xefcdab89;
+	sha1_vec_t h2 = (sha1_vec_t){ 0 } + 0x98badcfe;
+	sha1_vec_t h3 = (sha1_vec_t){ 0 } + 0x10325476;
+	sha1_vec_t h4 = (sha1_vec_t){ 0 } + 0xc3d2e1f0;
+	size_t maxblocks = 0;
+
+	for (unsigned int lane = 0; lane < ISC_ITERATED_HASH_LANES; lane++) {
+		maxblocks = ISC_MAX(maxblocks, m->nblocks[lane]);
+	}
+
+	for (size_t block = 0; block < maxblocks; block++) {
+		sha1_vec_t w[SHA1_BLOCKSIZE];
+		sha1_vec_t mask = { 0 };
+		sha1_vec_t a = h0, b = h1, c = h2, d = h3, e = h4;
+
+		for (unsigned int lane = 0; lane < ISC_ITERATED_HASH_LANES;
+		     lane++)
+		{
+			/*
+			 * Lanes whose message is shorter process their
+			 * first block again, and the result is discarded.
+			 */
+			size_t offset = 0;
+			if (block < m->nblocks[lane]) {
+				offset = block * 64;
+				mask[lane] = UINT32_MAX;
+			}
+			for (unsigned int t = 0; t < SHA1_BLOCKSIZE; t++) {
+				w[t][lane] = ISC_U8TO32_BE(m->buf[lane] +
+							   offset + t * 4);
+			}
+		}
+
+		SHA1_ROUNDS(0, 20, d ^ (b & (c ^ d)), 0x5a827999);
+		SHA1_ROUNDS(20, 40, b ^ c ^ d, 0x6ed9eba1);
+		SHA1_ROUNDS(40, 60, (b & c) | (d & (b | c)), 0x8f1bbcdc);
+		SHA1_ROUNDS(60, 80, b ^ c ^ d, 0xca62c1d6);
+
+		h0 += a & mask;
+		h1 += b & mask;
+		h2 += c & mask;
+		h3 += d & mask;
+		h4 += e & mask;
+	}
+
+	for (unsigned int lane = 0; lane < ISC_ITERATED_HASH_LANES; lane++) {
+		ISC_U32TO8_BE(out[lane], h0[lane]);
+		ISC_U32TO8_BE(out[lane] + 4, h1[lane]);
+		ISC_U32TO8_BE(out[lane] + 8, h2[lane]);
+		ISC_U32TO8_BE(out[lane] + 12, h3[lane]);
+		ISC_U32TO8_BE(out[lane] + 16, h4[lane]);
+	}
+}
+
+int
+isc_iterated_hash_multi(unsigned char *const out[], const unsigned int hashalg,
+			const int iterations, const unsigned char *salt,
+			const int saltlength, const unsigned char *const in[],
+			const int inlength[], const size_t count) {
+	REQUIRE(count == 0 || (out != NULL && in != NULL && inlength != NULL));
+	REQUIRE(iterations >= 0);
+	REQUIRE(saltlength >= 0 && saltlength <= 255);
+
+	if (hashalg != 1) {
+		return (0);
+	}
+
+	for (size_t start = 0; start < count; start += ISC_ITERATED_HASH_LANES)
+	{
+		size_t n = ISC_MIN(ISC_ITERATED_HASH_LANES, count - start);
+		unsigned char spare[ISC_ITERATED_HASH_LANES][SHA1_DIGESTSIZE];
+		unsigned char *lout[ISC_ITERATED_HASH_LANES];
+		sha1_multi_t m;
+
+		/*
+		 * When there are fewer inputs than lanes left, the
+		 * remaining lanes hash the first input again into
+		 * 'spare'.
+		 */
+		for (unsigned int lane = 0; lane < ISC_ITERATED_HASH_LANES;
+		     lane++)
+		{
+			size_t i = start + (lane < n ? lane : 0);
+
+			REQUIRE(out[i] != NULL && in[i] != NULL);
+			REQUIRE(inlength[i] >= 0 && inlength[i] <= 255);
+
+			lout[lane] = (lane < n) ? out[i] : spare[lane];
+			sha1_multi_load(&m, lane, in[i], inlength[i], salt,
+					saltlength);
+		}
+		sha1_multi_digest(&m, lout);
+
+		for (int iteration = 0; iteration < iterations; iteration++) {
+			for (unsigned int lane = 0;
+			     lane < ISC_ITERATED_HASH_LANES; lane++)
+			{
+				sha1_multi_load(&m, lane, lout[lane],
+						SHA1_DIGESTSIZE, salt,
+						saltlength);
+			}
+			sha1_multi_digest(&m, lout);
+		}
+	}
+
+	return (SHA1_DIGESTSIZE);
+}
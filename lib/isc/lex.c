@@ -36,7 +36,9 @@ typedef struct inputsource {
 	bool need_close;
 	bool at_eof;
 	bool last_was_eol;
+	bool readahead;
 	isc_buffer_t *pushback;
+	unsigned int start;
 	unsigned int ignored;
 	void *input;
 	char *name;
@@ -45,6 +47,12 @@ typedef struct inputsource {
 	ISC_LINK(struct inputsource) link;
 } inputsource;
 
+/*
+ * Files opened by the lexer itself are read in chunks of this size into
+ * the pushback buffer, instead of one character at a time.
+ */
+#define LEX_READAHEAD 4096
+
 #define LEX_MAGIC    ISC_MAGIC('L', 'e', 'x', '!')
 #define VALID_LEX(l) ISC_MAGIC_VALID(l, LEX_MAGIC)
 
@@ -190,11 +198,21 @@ new_source(isc_lex_t *lex, bool is_file, bool need_close, void *input,
 	source->need_close = need_close;
 	source->at_eof = false;
 	source->last_was_eol = lex->last_was_eol;
+	/*
+	 * Only read ahead from streams we own; a stream passed in by the
+	 * caller may be interactive, or may be read from again after the
+	 * lexer is done with it.
+	 */
+	source->readahead = is_file && need_close;
 	source->input = input;
 	source->name = isc_mem_strdup(lex->mctx, name);
 	source->pushback = NULL;
 	isc_buffer_allocate(lex->mctx, &source->pushback,
-			    (unsigned int)lex->max_token);
+			    source->readahead
+				    ? ISC_MAX((unsigned int)lex->max_token,
+					      2 * LEX_READAHEAD)
+				    : (unsigned int)lex->max_token);
+	source->start = 0;
 	source->ignored = 0;
 	source->line = 1;
 	ISC_LIST_INITANDPREPEND(lex->sources, source, link);
@@ -336,6 +354,98 @@ pushandgrow(isc_lex_t *lex, inputsource *source, int c) {
 	return (ISC_R_SUCCESS);
 }
 
+/*
+ * Fill the pushback buffer from a file opened by the lexer.
+ */
+static isc_result_t
+readahead(inputsource *source) {
+	isc_buffer_t *pushback = source->pushback;
+	size_t n;
+
+	RUNTIME_CHECK(isc_buffer_reserve(pushback, LEX_READAHEAD) ==
+		      ISC_R_SUCCESS);
+	n = fread(isc_buffer_used(pushback), 1, LEX_READAHEAD, source->input);
+	if (n == 0) {
+		if (ferror((FILE *)source->input)) {
+			return (isc__errno2result(errno));
+		}
+		source->at_eof = true;
+		return (ISC_R_SUCCESS);
+	}
+	isc_buffer_add(pushback, (unsigned int)n);
+	return (ISC_R_SUCCESS);
+}
+
+/*
+ * Characters that can be appended to a string token without going
+ * through the state machine.  Anything that might end the token, start
+ * a comment or an escape, or split a key-value pair is left to it.
+ */
+static bool
+plainchar(isc_lex_t *lex, unsigned int options, unsigned char c) {
+	switch (c) {
+	case ' ':
+	case '\t':
+	case '\r':
+	case '\n':
+	case '\\':
+	case ';':
+	case '/':
+	case '#':
+		return (false);
+	case '=':
+		return ((options & ISC_LEXOPT_VPAIR) == 0);
+	default:
+		return (!lex->specials[c]);
+	}
+}
+
+/*
+ * Append the run of plain characters that follows in the input to the
+ * current string token.
+ */
+static void
+stringrun(isc_lex_t *lex, inputsource *source, unsigned int options,
+	  char **currp, char **prevp, size_t *remainingp) {
+	isc_buffer_t *input = NULL;
+	unsigned char *base;
+	unsigned int avail, n = 0;
+
+	if (isc_buffer_remaininglength(source->pushback) != 0) {
+		base = isc_buffer_current(source->pushback);
+		avail = isc_buffer_remaininglength(source->pushback);
+	} else if (!source->is_file) {
+		input = source->input;
+		base = isc_buffer_current(input);
+		avail = isc_buffer_remaininglength(input);
+	} else {
+		return;
+	}
+
+	while (n < avail && plainchar(lex, options, base[n])) {
+		n++;
+	}
+	if (n == 0) {
+		return;
+	}
+
+	while (*remainingp < n) {
+		(void)grow_data(lex, remainingp, currp, prevp);
+	}
+	memmove(*currp, base, n);
+	*currp += n;
+	**currp = '\0';
+	*remainingp -= n;
+
+	if (input != NULL) {
+		RUNTIME_CHECK(isc_buffer_reserve(source->pushback, n) ==
+			      ISC_R_SUCCESS);
+		isc_buffer_putmem(source->pushback, base, n);
+		isc_buffer_forward(input, n);
+	}
+	isc_buffer_forward(source->pushback, n);
+}
+
 isc_result_t
 isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 	inputsource *source;
@@ -396,7 +506,19 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 		return (ISC_R_EOF);
 	}
 
-	isc_buffer_compact(source->pushback);
+	/*
+	 * The pushback buffer holds the text of the current token, so that
+	 * it can be ungotten, followed by any input read ahead.  Discard
+	 * the text of earlier tokens once it takes up half the buffer.
+	 */
+	if (isc_buffer_remaininglength(source->pushback) == 0) {
+		isc_buffer_clear(source->pushback);
+	} else if (isc_buffer_consumedlength(source->pushback) >
+		   isc_buffer_length(source->pushback) / 2)
+	{
+		isc_buffer_compact(source->pushback);
+	}
+	source->start = isc_buffer_consumedlength(source->pushback);
 
 	saved_options = options;
 	if ((options & ISC_LEXOPT_DNSMULTILINE) != 0 && lex->paren_count > 0) {
@@ -416,7 +538,20 @@ isc_lex_gettoken(isc_lex_t *lex, unsigned int options, isc_token_t *tokenp) {
 #endif /* ifdef HAVE_FLOCKFILE */
 
 	do {
-		if (isc_buffer_remaininglength(source->pushback) == 0) {
+		if (state == lexstate_string && !escaped) {
+			stringrun(lex, source, options, &curr, &prev,
+				  &remaining);
+		}
+
+		if (isc_buffer_remaininglength(source->pushback) == 0 &&
+		    source->readahead)
+		{
+			source->result = readahead(source);
+			if (source->result != ISC_R_SUCCESS) {
+				result = source->result;
+				goto done;
+			}
+		} else if (isc_buffer_remaininglength(source->pushback) == 0) {
 			if (source->is_file) {
 				stream = source->input;
 
@@ -1026,12 +1161,12 @@ isc_lex_ungettoken(isc_lex_t *lex, isc_token_t *tokenp) {
 	source = HEAD(lex->sources);
 	REQUIRE(source != NULL);
 	REQUIRE(tokenp != NULL);
-	REQUIRE(isc_buffer_consumedlength(source->pushback) != 0 ||
+	REQUIRE(isc_buffer_consumedlength(source->pushback) != source->start ||
 		tokenp->type == isc_tokentype_eof);
 
 	UNUSED(tokenp);
 
-	isc_buffer_first(source->pushback);
+	source->pushback->current = source->start;
 	lex->paren_count = lex->saved_paren_count;
 	source->line = source->saved_line;
 	source->at_eof = false;
@@ -1045,7 +1180,7 @@ isc_lex_getlasttokentext(isc_lex_t *lex, isc_token_t *tokenp, isc_region_t *r) {
 	source = HEAD(lex->sources);
 	REQUIRE(source != NULL);
 	REQUIRE(tokenp != NULL);
-	REQUIRE(isc_buffer_consumedlength(source->pushback) != 0 ||
+	REQUIRE(isc_buffer_consumedlength(source->pushback) != source->start ||
 		tokenp->type == isc_tokentype_eof);
 
 	UNUSED(tokenp);
@@ -24,6 +24,7 @@
 #include <unistd.h>
 
 #include <isc/atomic.h>
+#include <isc/condition.h>
 #include <isc/dir.h>
 #include <isc/errno.h>
 #include <isc/file.h>
@@ -50,6 +51,11 @@ static thread_local bool forcelog = false;
  */
 #define LOG_BUFFER_SIZE (8 * 1024)
 
+/*
+ * Room for a formatted message together with its prefixes.
+ */
+#define LOG_LINE_SIZE (LOG_BUFFER_SIZE + 512)
+
 /*!
  * This is the structure that holds each named channel.  A simple linked
  * list chains all of the channels together, so an individual channel is
@@ -68,6 +74,8 @@ struct isc_logchannel {
 	unsigned int flags;
 	isc_logdestination_t destination;
 	ISC_LINK(isc_logchannel_t) link;
+	unsigned int dropped; /*%< Locked by isc_log lock */
+	bool openerr;	      /*%< Locked by isc_log iolock */
 };
 
 /*!
@@ -98,6 +106,19 @@ struct isc_logmessage {
 	ISC_LINK(isc_logmessage_t) link;
 };
 
+/*!
+ * A formatted line, or a binary record, waiting for the writer thread
+ * to write it to a file channel.
+ */
+typedef struct isc_logentry isc_logentry_t;
+
+struct isc_logentry {
+	isc_logchannel_t *channel;
+	size_t size;
+	ISC_LINK(isc_logentry_t) link;
+	unsigned char data[];
+};
+
 /*!
  * The isc_logconfig structure is used to store the configurable information
  * about where messages are actually supposed to be sent -- the information
@@ -115,6 +136,7 @@ struct isc_logconfig {
 	int_fast32_t highest_level;
 	char *tag;
 	bool dynamic;
+	bool binary;
 };
 
 /*!
@@ -133,6 +155,13 @@ struct isc_logconfig {
  * This is because in the usual case, only one isc_log_t is ever created
  * in a program, and the category/module registration happens only once.
  * XXXDCL it might be wise to add more locking overall.
+ *
+ * When asynchronous writing is enabled with isc_log_setasync(), lines
+ * destined for file channels are queued instead of written, and a
+ * writer thread writes them out, so the threads logging the messages
+ * never wait for file I/O.  The file streams are protected by the
+ * separate 'iolock', which is all the writer thread holds while
+ * writing.
  */
 struct isc_log {
 	/* Not locked. */
@@ -148,9 +177,20 @@ struct isc_log {
 	isc_mutex_t lock;
 	/* Locked by isc_log lock. */
 	char buffer[LOG_BUFFER_SIZE];
+	char line[LOG_LINE_SIZE];
 	ISC_LIST(isc_logmessage_t) messages;
 	atomic_bool dynamic;
+	atomic_bool binary;
 	atomic_int_fast32_t highest_level;
+	unsigned int maxqueued; /*%< 0 when writing synchronously */
+	unsigned int queued;	/*%< Lines not yet written */
+	ISC_LIST(isc_logentry_t) queue;
+	bool writer_running;
+	isc_thread_t writer;
+	isc_condition_t wakeup;
+	isc_condition_t drained;
+	/* Serializes the use of the file channels' streams */
+	isc_mutex_t iolock;
 };
 
 /*!
@@ -222,6 +262,9 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	     isc_logmodule_t *module, int level, bool write_once,
 	     const char *format, va_list args) ISC_FORMAT_PRINTF(6, 0);
 
+static void
+log_drain(isc_log_t *lctx);
+
 /*@{*/
 /*!
  * Convenience macros.
@@ -263,10 +306,14 @@ isc_log_create(isc_mem_t *mctx, isc_log_t **lctxp, isc_logconfig_t **lcfgp) {
 	*lctx = (isc_log_t){
 		.magic = LCTX_MAGIC,
 		.messages = ISC_LIST_INITIALIZER,
+		.queue = ISC_LIST_INITIALIZER,
 	};
 
 	isc_mem_attach(mctx, &lctx->mctx);
 	isc_mutex_init(&lctx->lock);
+	isc_mutex_init(&lctx->iolock);
+	isc_condition_init(&lctx->wakeup);
+	isc_condition_init(&lctx->drained);
 	isc_log_registercategories(lctx, isc_categories);
 	isc_log_registermodules(lctx, isc_modules);
 	isc_logconfig_create(lctx, &lcfg);
@@ -276,6 +323,7 @@ isc_log_create(isc_mem_t *mctx, isc_log_t **lctxp, isc_logconfig_t **lcfgp) {
 
 	atomic_init(&lctx->highest_level, lcfg->highest_level);
 	atomic_init(&lctx->dynamic, lcfg->dynamic);
+	atomic_init(&lctx->binary, lcfg->binary);
 
 	*lctxp = lctx;
 	SET_IF_NOT_NULL(lcfgp, lcfg);
@@ -355,6 +403,9 @@ isc_logconfig_use(isc_log_t *lctx, isc_logconfig_t *lcfg) {
 	sync_highest_level(lctx, lcfg);
 	synchronize_rcu();
 
+	/* The queued lines may refer to the old channels */
+	log_drain(lctx);
+
 	isc_logconfig_destroy(&old_cfg);
 }
 
@@ -371,10 +422,14 @@ isc_log_destroy(isc_log_t **lctxp) {
 	*lctxp = NULL;
 	mctx = lctx->mctx;
 
+	/* Write out the queued lines and stop the writer thread */
+	isc_log_setasync(lctx, 0);
+
 	/* Stop the logging as a first thing */
 	atomic_store_release(&lctx->debug_level, 0);
 	atomic_store_release(&lctx->highest_level, 0);
 	atomic_store_release(&lctx->dynamic, false);
+	atomic_store_release(&lctx->binary, false);
 
 	lcfg = rcu_xchg_pointer(&lctx->logconfig, NULL);
 	synchronize_rcu();
@@ -383,6 +438,9 @@ isc_log_destroy(isc_log_t **lctxp) {
 		isc_logconfig_destroy(&lcfg);
 	}
 
+	isc_condition_destroy(&lctx->drained);
+	isc_condition_destroy(&lctx->wakeup);
+	isc_mutex_destroy(&lctx->iolock);
 	isc_mutex_destroy(&lctx->lock);
 
 	while ((message = ISC_LIST_HEAD(lctx->messages)) != NULL) {
@@ -464,6 +522,7 @@ isc_logconfig_destroy(isc_logconfig_t **lcfgp) {
 	}
 
 	lcfg->dynamic = false;
+	lcfg->binary = false;
 	if (lcfg->tag != NULL) {
 		isc_mem_free(lcfg->lctx->mctx, lcfg->tag);
 	}
@@ -626,7 +685,7 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
 	isc_mem_t *mctx;
 	unsigned int permitted = ISC_LOG_PRINTALL | ISC_LOG_DEBUGONLY |
 				 ISC_LOG_BUFFERED | ISC_LOG_ISO8601 |
-				 ISC_LOG_UTC;
+				 ISC_LOG_UTC | ISC_LOG_BINARY;
 
 	REQUIRE(VALID_CONFIG(lcfg));
 	REQUIRE(name != NULL);
@@ -635,6 +694,7 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
 	REQUIRE(destination != NULL || type == ISC_LOG_TONULL);
 	REQUIRE(level >= ISC_LOG_CRITICAL);
 	REQUIRE((flags & ~permitted) == 0);
+	REQUIRE((flags & ISC_LOG_BINARY) == 0 || type == ISC_LOG_TOFILE);
 
 	/* XXXDCL find duplicate names? */
 
@@ -647,6 +707,8 @@ isc_log_createchannel(isc_logconfig_t *lcfg, const char *name,
 	channel->type = type;
 	channel->level = level;
 	channel->flags = flags;
+	channel->dropped = 0;
+	channel->openerr = false;
 	ISC_LINK_INIT(channel, link);
 
 	switch (type) {
@@ -891,6 +953,7 @@ isc_log_closefilelogs(isc_log_t *lctx) {
 	isc_logconfig_t *lcfg = rcu_dereference(lctx->logconfig);
 	if (lcfg != NULL) {
 		LOCK(&lctx->lock);
+		LOCK(&lctx->iolock);
 		for (isc_logchannel_t *channel = ISC_LIST_HEAD(lcfg->channels);
 		     channel != NULL; channel = ISC_LIST_NEXT(channel, link))
 		{
@@ -901,6 +964,7 @@ isc_log_closefilelogs(isc_log_t *lctx) {
 				FILE_STREAM(channel) = NULL;
 			}
 		}
+		UNLOCK(&lctx->iolock);
 		UNLOCK(&lctx->lock);
 	}
 	rcu_read_unlock();
@@ -948,6 +1012,9 @@ assignchannel(isc_logconfig_t *lcfg, unsigned int category_id,
 		if (channel->level == ISC_LOG_DYNAMIC) {
 			lcfg->dynamic = true;
 		}
+		if ((channel->flags & ISC_LOG_BINARY) != 0) {
+			lcfg->binary = true;
+		}
 	}
 }
 
@@ -978,6 +1045,7 @@ static void
 sync_highest_level(isc_log_t *lctx, isc_logconfig_t *lcfg) {
 	atomic_store(&lctx->highest_level, lcfg->highest_level);
 	atomic_store(&lctx->dynamic, lcfg->dynamic);
+	atomic_store(&lctx->binary, lcfg->binary);
 }
 
 static isc_result_t
@@ -1410,13 +1478,13 @@ isc_log_open(isc_logchannel_t *channel) {
 		}
 		result = isc_logfile_roll(&channel->destination.file);
 		if (result != ISC_R_SUCCESS) {
-			if ((channel->flags & ISC_LOG_OPENERR) == 0) {
+			if (!channel->openerr) {
 				syslog(LOG_ERR,
 				       "isc_log_open: isc_logfile_roll '%s' "
 				       "failed: %s",
 				       FILE_NAME(channel),
 				       isc_result_totext(result));
-				channel->flags |= ISC_LOG_OPENERR;
+				channel->openerr = true;
 			}
 			return (result);
 		}
@@ -1460,6 +1528,289 @@ isc_log_wouldlog(isc_log_t *lctx, int level) {
 	return (false);
 }
 
+/*
+ * Write a formatted line or a binary record to a file channel.  Must be
+ * called with the iolock held.
+ */
+static void
+log_tofile(isc_logchannel_t *channel, const void *data, size_t size) {
+	struct stat statbuf;
+	isc_result_t result;
+
+	if (channel->type == ISC_LOG_TOFILE) {
+		if (FILE_MAXREACHED(channel)) {
+			/*
+			 * If the file can be rolled, OR
+			 * If the file no longer exists, OR
+			 * If the file is less than the maximum
+			 * size, (such as if it had been renamed
+			 * and a new one touched, or it was
+			 * truncated in place)
+			 * ... then close it to trigger
+			 * reopening.
+			 */
+			if (FILE_VERSIONS(channel) != ISC_LOG_ROLLNEVER ||
+			    (stat(FILE_NAME(channel), &statbuf) != 0 &&
+			     errno == ENOENT) ||
+			    statbuf.st_size < FILE_MAXSIZE(channel))
+			{
+				(void)fclose(FILE_STREAM(channel));
+				FILE_STREAM(channel) = NULL;
+				FILE_MAXREACHED(channel) = false;
+			} else {
+				/*
+				 * Eh, skip it.
+				 */
+				return;
+			}
+		}
+
+		if (FILE_STREAM(channel) == NULL) {
+			result = isc_log_open(channel);
+			if (result != ISC_R_SUCCESS &&
+			    result != ISC_R_MAXSIZE && !channel->openerr)
+			{
+				syslog(LOG_ERR,
+				       "isc_log_open '%s' "
+				       "failed: %s",
+				       FILE_NAME(channel),
+				       isc_result_totext(result));
+				channel->openerr = true;
+			}
+			if (result != ISC_R_SUCCESS) {
+				return;
+			}
+			channel->openerr = false;
+		}
+	}
+
+	(void)fwrite(data, 1, size, FILE_STREAM(channel));
+
+	if ((channel->flags & ISC_LOG_BUFFERED) == 0) {
+		fflush(FILE_STREAM(channel));
+	}
+
+	/*
+	 * If the file now exceeds its maximum size
+	 * threshold, note it so that it will not be
+	 * logged to any more.
+	 */
+	if (FILE_MAXSIZE(channel) > 0) {
+		INSIST(channel->type == ISC_LOG_TOFILE);
+
+		/* XXXDCL NT fstat/fileno */
+		/* XXXDCL complain if fstat fails? */
+		if (fstat(fileno(FILE_STREAM(channel)), &statbuf) >= 0 &&
+		    statbuf.st_size > FILE_MAXSIZE(channel))
+		{
+			FILE_MAXREACHED(channel) = true;
+		}
+	}
+}
+
+static void
+log_append(isc_log_t *lctx, isc_logchannel_t *channel, const void *data,
+	   size_t size) {
+	isc_logentry_t *entry = isc_mem_get(lctx->mctx,
+					    sizeof(*entry) + size);
+
+	*entry = (isc_logentry_t){
+		.channel = channel,
+		.size = size,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	memmove(entry->data, data, size);
+
+	if (lctx->queued == 0) {
+		SIGNAL(&lctx->wakeup);
+	}
+	ISC_LIST_APPEND(lctx->queue, entry, link);
+	lctx->queued++;
+}
+
+/*
+ * Queue a formatted line or binary record for the writer thread.  When
+ * the queue is full the message is dropped and counted, and the count
+ * is reported once there is room again: in the channel itself for text
+ * channels, and to syslog for binary ones.  Must be called with the
+ * isc_log lock held.
+ */
+static void
+log_enqueue(isc_log_t *lctx, isc_logchannel_t *channel, const void *data,
+	    size_t size) {
+	char note[64];
+	int n;
+
+	if (lctx->queued >= lctx->maxqueued) {
+		channel->dropped++;
+		return;
+	}
+
+	if (channel->dropped > 0) {
+		if ((channel->flags & ISC_LOG_BINARY) != 0) {
+			syslog(LOG_WARNING,
+			       "%u binary log records dropped from '%s'",
+			       channel->dropped, FILE_NAME(channel));
+		} else {
+			n = snprintf(note, sizeof(note),
+				     "%u log messages dropped\n",
+				     channel->dropped);
+			log_append(lctx, channel, note, n);
+		}
+		channel->dropped = 0;
+	}
+
+	log_append(lctx, channel, data, size);
+}
+
+static void *
+log_writer(void *arg) {
+	isc_log_t *lctx = arg;
+	ISC_LIST(isc_logentry_t) batch = ISC_LIST_INITIALIZER;
+	isc_logentry_t *entry = NULL, *next = NULL;
+	unsigned int count;
+
+	LOCK(&lctx->lock);
+	for (;;) {
+		while (ISC_LIST_EMPTY(lctx->queue) && lctx->maxqueued > 0) {
+			WAIT(&lctx->wakeup, &lctx->lock);
+		}
+		if (ISC_LIST_EMPTY(lctx->queue)) {
+			break;
+		}
+
+		/* Take the whole queue and write it without the lock */
+		ISC_LIST_MOVE(batch, lctx->queue);
+		UNLOCK(&lctx->lock);
+
+		count = 0;
+		LOCK(&lctx->iolock);
+		for (entry = ISC_LIST_HEAD(batch); entry != NULL;
+		     entry = next)
+		{
+			next = ISC_LIST_NEXT(entry, link);
+			log_tofile(entry->channel, entry->data, entry->size);
+			isc_mem_put(lctx->mctx, entry,
+				    sizeof(*entry) + entry->size);
+			count++;
+		}
+		UNLOCK(&lctx->iolock);
+		ISC_LIST_INIT(batch);
+
+		LOCK(&lctx->lock);
+		INSIST(lctx->queued >= count);
+		lctx->queued -= count;
+		if (lctx->queued == 0) {
+			BROADCAST(&lctx->drained);
+		}
+	}
+	UNLOCK(&lctx->lock);
+
+	return (NULL);
+}
+
+/*
+ * Write to a file channel, or queue the message for the writer thread.
+ * Must be called with the isc_log lock held.
+ */
+static void
+log_write(isc_log_t *lctx, isc_logchannel_t *channel, const void *data,
+	  size_t size) {
+	if (lctx->maxqueued > 0) {
+		log_enqueue(lctx, channel, data, size);
+	} else {
+		LOCK(&lctx->iolock);
+		log_tofile(channel, data, size);
+		UNLOCK(&lctx->iolock);
+	}
+}
+
+/*
+ * Wait until the writer thread has written all the queued lines.
+ */
+static void
+log_drain(isc_log_t *lctx) {
+	LOCK(&lctx->lock);
+	while (lctx->queued > 0) {
+		WAIT(&lctx->drained, &lctx->lock);
+	}
+	UNLOCK(&lctx->lock);
+}
+
+void
+isc_log_setasync(isc_log_t *lctx, unsigned int maxqueued) {
+	REQUIRE(VALID_CONTEXT(lctx));
+
+	LOCK(&lctx->lock);
+	lctx->maxqueued = maxqueued;
+	if (maxqueued > 0 && !lctx->writer_running) {
+		lctx->writer_running = true;
+		UNLOCK(&lctx->lock);
+		isc_thread_create(log_writer, lctx, &lctx->writer);
+		return;
+	}
+	if (maxqueued > 0 || !lctx->writer_running) {
+		UNLOCK(&lctx->lock);
+		return;
+	}
+
+	/* The writer exits once it has emptied the queue */
+	lctx->writer_running = false;
+	SIGNAL(&lctx->wakeup);
+	UNLOCK(&lctx->lock);
+
+	isc_thread_join(lctx->writer, NULL);
+	INSIST(lctx->queued == 0);
+}
+
+bool
+isc_log_wantbinary(isc_log_t *lctx) {
+	REQUIRE(lctx == NULL || VALID_CONTEXT(lctx));
+
+	return (lctx != NULL && atomic_load_acquire(&lctx->binary));
+}
+
+void
+isc_log_writebinary(isc_log_t *lctx, isc_logcategory_t *category,
+		    isc_logmodule_t *module, const void *data, size_t size) {
+	isc_logchannellist_t *item = NULL;
+
+	REQUIRE(lctx == NULL || VALID_CONTEXT(lctx));
+	REQUIRE(category != NULL);
+	REQUIRE(module != NULL);
+	REQUIRE(data != NULL);
+
+	if (!isc_log_wantbinary(lctx)) {
+		return;
+	}
+
+	REQUIRE(category->id < lctx->category_count);
+	REQUIRE(module->id < lctx->module_count);
+
+	rcu_read_lock();
+	LOCK(&lctx->lock);
+
+	isc_logconfig_t *lcfg = rcu_dereference(lctx->logconfig);
+
+	/*
+	 * Binary records only go to the binary channels explicitly
+	 * configured for the category; there is no default.
+	 */
+	for (item = ISC_LIST_HEAD(lcfg->channellists[category->id]);
+	     item != NULL; item = ISC_LIST_NEXT(item, link))
+	{
+		if ((item->channel->flags & ISC_LOG_BINARY) == 0 ||
+		    (item->module != NULL && item->module != module))
+		{
+			continue;
+		}
+		log_write(lctx, item->channel, data, size);
+	}
+
+	UNLOCK(&lctx->lock);
+	rcu_read_unlock();
+}
+
 static void
 isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	     isc_logmodule_t *module, int level, bool write_once,
@@ -1470,14 +1821,13 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 	char iso8601z_string[64];
 	char iso8601l_string[64];
 	char level_string[24] = { 0 };
-	struct stat statbuf;
 	bool matched = false;
 	bool printtime, iso8601, utc, printtag, printcolon;
-	bool printcategory, printmodule, printlevel, buffered;
+	bool printcategory, printmodule, printlevel;
 	isc_logchannel_t *channel;
 	isc_logchannellist_t *category_channels;
 	int_fast32_t dlevel;
-	isc_result_t result;
+	int n;
 
 	REQUIRE(lctx == NULL || VALID_CONTEXT(lctx));
 	REQUIRE(category != NULL);
@@ -1560,6 +1910,10 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 		channel = category_channels->channel;
 		category_channels = ISC_LIST_NEXT(category_channels, link);
 
+		if ((channel->flags & ISC_LOG_BINARY) != 0) {
+			continue;
+		}
+
 		if (!forcelog) {
 			dlevel = atomic_load_acquire(&lctx->debug_level);
 			if (((channel->flags & ISC_LOG_DEBUGONLY) != 0) &&
@@ -1727,7 +2081,6 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 		printcategory = ((channel->flags & ISC_LOG_PRINTCATEGORY) != 0);
 		printmodule = ((channel->flags & ISC_LOG_PRINTMODULE) != 0);
 		printlevel = ((channel->flags & ISC_LOG_PRINTLEVEL) != 0);
-		buffered = ((channel->flags & ISC_LOG_BUFFERED) != 0);
 
 		if (printtime) {
 			if (iso8601) {
@@ -1745,56 +2098,10 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 
 		switch (channel->type) {
 		case ISC_LOG_TOFILE:
-			if (FILE_MAXREACHED(channel)) {
-				/*
-				 * If the file can be rolled, OR
-				 * If the file no longer exists, OR
-				 * If the file is less than the maximum
-				 * size, (such as if it had been renamed
-				 * and a new one touched, or it was
-				 * truncated in place)
-				 * ... then close it to trigger
-				 * reopening.
-				 */
-				if (FILE_VERSIONS(channel) !=
-					    ISC_LOG_ROLLNEVER ||
-				    (stat(FILE_NAME(channel), &statbuf) != 0 &&
-				     errno == ENOENT) ||
-				    statbuf.st_size < FILE_MAXSIZE(channel))
-				{
-					(void)fclose(FILE_STREAM(channel));
-					FILE_STREAM(channel) = NULL;
-					FILE_MAXREACHED(channel) = false;
-				} else {
-					/*
-					 * Eh, skip it.
-					 */
-					break;
-				}
-			}
-
-			if (FILE_STREAM(channel) == NULL) {
-				result = isc_log_open(channel);
-				if (result != ISC_R_SUCCESS &&
-				    result != ISC_R_MAXSIZE &&
-				    (channel->flags & ISC_LOG_OPENERR) == 0)
-				{
-					syslog(LOG_ERR,
-					       "isc_log_open '%s' "
-					       "failed: %s",
-					       FILE_NAME(channel),
-					       isc_result_totext(result));
-					channel->flags |= ISC_LOG_OPENERR;
-				}
-				if (result != ISC_R_SUCCESS) {
-					break;
-				}
-				channel->flags &= ~ISC_LOG_OPENERR;
-			}
-			FALLTHROUGH;
-
 		case ISC_LOG_TOFILEDESC:
-			fprintf(FILE_STREAM(channel), "%s%s%s%s%s%s%s%s%s%s\n",
+			n = snprintf(
+				lctx->line, sizeof(lctx->line),
+				"%s%s%s%s%s%s%s%s%s%s\n",
 				printtime ? time_string : "",
 				printtime ? " " : "", printtag ? lcfg->tag : "",
 				printcolon ? ": " : "",
@@ -1805,29 +2112,15 @@ isc_log_doit(isc_log_t *lctx, isc_logcategory_t *category,
 					    : "",
 				printmodule ? ": " : "",
 				printlevel ? level_string : "", lctx->buffer);
-
-			if (!buffered) {
-				fflush(FILE_STREAM(channel));
-			}
-
-			/*
-			 * If the file now exceeds its maximum size
-			 * threshold, note it so that it will not be
-			 * logged to any more.
-			 */
-			if (FILE_MAXSIZE(channel) > 0) {
-				INSIST(channel->type == ISC_LOG_TOFILE);
-
-				/* XXXDCL NT fstat/fileno */
-				/* XXXDCL complain if fstat fails? */
-				if (fstat(fileno(FILE_STREAM(channel)),
-					  &statbuf) >= 0 &&
-				    statbuf.st_size > FILE_MAXSIZE(channel))
-				{
-					FILE_MAXREACHED(channel) = true;
-				}
+			if (n < 0) {
+				break;
+			} else if ((size_t)n >= sizeof(lctx->line)) {
+				/* Keep the line terminated when truncated */
+				n = sizeof(lctx->line) - 1;
+				lctx->line[n - 1] = '\n';
 			}
 
+			log_write(lctx, channel, lctx->line, n);
 			break;
 
 		case ISC_LOG_TOSYSLOG:
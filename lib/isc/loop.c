@@ -29,6 +29,7 @@
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/signal.h>
+#include <isc/stdtime.h>
 #include <isc/strerr.h>
 #include <isc/thread.h>
 #include <isc/tid.h>
@@ -86,6 +87,14 @@ isc__loopmgr_signal(void *arg, int signum) {
 	}
 }
 
+/*
+ * The loop running on this thread, and the wall clock time cached
+ * for its current tick by isc_loop_stdtime().
+ */
+static thread_local isc_loop_t *loop_local = NULL;
+static thread_local uint64_t stdtime_tick = UINT64_MAX;
+static thread_local isc_stdtime_t stdtime_cached = 0;
+
 static void
 pause_loop(isc_loop_t *loop) {
 	isc_loopmgr_t *loopmgr = loop->loopmgr;
@@ -103,6 +112,9 @@ resume_loop(isc_loop_t *loop) {
 	(void)isc_barrier_wait(&loopmgr->resuming);
 	loop->paused = false;
 
+	/* The tick has lasted for the whole pause */
+	stdtime_tick = UINT64_MAX;
+
 	rcu_thread_online();
 }
 
@@ -187,6 +199,7 @@ static void
 loop_init(isc_loop_t *loop, isc_loopmgr_t *loopmgr, uint32_t tid) {
 	*loop = (isc_loop_t){
 		.tid = tid,
+		.cpu = -1,
 		.loopmgr = loopmgr,
 		.run_jobs = ISC_LIST_INITIALIZER,
 	};
@@ -267,6 +280,25 @@ loop_thread(void *arg) {
 	/* Initialize the thread_local variable */
 
 	isc__tid_init(loop->tid);
+	loop_local = loop;
+
+	/*
+	 * Bind the thread before it allocates anything, so that the
+	 * memory it touches first is local to its processor.
+	 */
+	if (loop->cpu >= 0) {
+		isc_result_t result = isc_thread_setaffinity(loop->cpu);
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(isc_lctx, ISC_LOGCATEGORY_GENERAL,
+				      ISC_LOGMODULE_OTHER, ISC_LOG_WARNING,
+				      "unable to bind loop %" PRIu32
+				      " to CPU %d: %s",
+				      loop->tid, loop->cpu,
+				      isc_result_totext(result));
+		}
+	}
+
+	isc_mem_thread_arena();
 
 	int r = uv_prepare_start(&loop->quiescent, quiescent_cb);
 	UV_RUNTIME_CHECK(uv_prepare_start, r);
@@ -286,6 +318,7 @@ loop_thread(void *arg) {
 
 	/* Invalidate the loop early */
 	loop->magic = 0;
+	loop_local = NULL;
 
 	isc_barrier_wait(&loop->loopmgr->stopping);
 
@@ -296,7 +329,7 @@ loop_thread(void *arg) {
  * Public
  */
 
-static void
+static uint32_t
 threadpool_initialize(uint32_t workers) {
 	char buf[11];
 	int r = uv_os_getenv("UV_THREADPOOL_SIZE", buf,
@@ -304,6 +337,31 @@ threadpool_initialize(uint32_t workers) {
 	if (r == UV_ENOENT) {
 		snprintf(buf, sizeof(buf), "%" PRIu32, workers);
 		uv_os_setenv("UV_THREADPOOL_SIZE", buf);
+	} else if (r == 0) {
+		/* libuv clamps the size the same way */
+		unsigned long size = strtoul(buf, NULL, 10);
+		workers = ISC_CLAMP(size, 1, 1024);
+	}
+
+	return (workers);
+}
+
+/*
+ * Bulk and background work together may use all the thread pool but a
+ * quarter of it, so that interactive work never queues behind them;
+ * background work may use half of that.
+ */
+static void
+work_initialize(isc_loopmgr_t *loopmgr, uint32_t workers) {
+	uint32_t bulk = ISC_MAX(workers - workers / 4, 1);
+
+	isc_mutex_init(&loopmgr->work_lock);
+	loopmgr->work_limit[isc_workclass_interactive] = UINT32_MAX;
+	loopmgr->work_limit[isc_workclass_bulk] = bulk;
+	loopmgr->work_limit[isc_workclass_background] = ISC_MAX(bulk / 2, 1);
+	for (size_t i = 0; i < isc_workclass_max; i++) {
+		atomic_init(&loopmgr->work_running[i], 0);
+		ISC_LIST_INIT(loopmgr->work_waiting[i]);
 	}
 }
 
@@ -326,7 +384,7 @@ isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp) {
 	REQUIRE(loopmgrp != NULL && *loopmgrp == NULL);
 	REQUIRE(nloops > 0);
 
-	threadpool_initialize(nloops);
+	uint32_t workers = threadpool_initialize(nloops);
 	isc__tid_initcount(nloops);
 
 	loopmgr = isc_mem_get(mctx, sizeof(*loopmgr));
@@ -336,6 +394,8 @@ isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp) {
 
 	isc_mem_attach(mctx, &loopmgr->mctx);
 
+	work_initialize(loopmgr, workers);
+
 	isc_barrier_init(&loopmgr->pausing, loopmgr->nloops);
 	isc_barrier_init(&loopmgr->resuming, loopmgr->nloops);
 	isc_barrier_init(&loopmgr->starting, loopmgr->nloops);
@@ -361,6 +421,18 @@ isc_loopmgr_create(isc_mem_t *mctx, uint32_t nloops, isc_loopmgr_t **loopmgrp) {
 	*loopmgrp = loopmgr;
 }
 
+void
+isc_loopmgr_setaffinity(isc_loopmgr_t *loopmgr, const int *cpus) {
+	REQUIRE(VALID_LOOPMGR(loopmgr));
+	REQUIRE(cpus != NULL);
+	REQUIRE(!atomic_load(&loopmgr->running));
+
+	for (size_t i = 0; i < loopmgr->nloops; i++) {
+		REQUIRE(cpus[i] >= -1);
+		loopmgr->loops[i].cpu = cpus[i];
+	}
+}
+
 isc_job_t *
 isc_loop_setup(isc_loop_t *loop, isc_job_cb cb, void *cbarg) {
 	REQUIRE(VALID_LOOP(loop));
@@ -543,6 +615,12 @@ isc_loopmgr_destroy(isc_loopmgr_t **loopmgrp) {
 	isc_barrier_destroy(&loopmgr->resuming);
 	isc_barrier_destroy(&loopmgr->pausing);
 
+	for (size_t i = 0; i < isc_workclass_max; i++) {
+		INSIST(ISC_LIST_EMPTY(loopmgr->work_waiting[i]));
+		INSIST(atomic_load(&loopmgr->work_running[i]) == 0);
+	}
+	isc_mutex_destroy(&loopmgr->work_lock);
+
 	isc_mem_putanddetach(&loopmgr->mctx, loopmgr, sizeof(*loopmgr));
 }
 
@@ -617,3 +695,23 @@ isc_loop_now(isc_loop_t *loop) {
 
 	return (t);
 }
+
+isc_stdtime_t
+isc_loop_stdtime(void) {
+	if (loop_local == NULL || loop_local->paused) {
+		return (isc_stdtime_now());
+	}
+
+	/*
+	 * libuv updates the loop time once per tick (and after polling),
+	 * so reading it is just a load; the wall clock is read again
+	 * only when it has changed.
+	 */
+	uint64_t tick = uv_now(&loop_local->loop);
+	if (tick != stdtime_tick) {
+		stdtime_tick = tick;
+		stdtime_cached = isc_stdtime_now();
+	}
+
+	return (stdtime_cached);
+}
@@ -15,12 +15,15 @@
 
 #include <inttypes.h>
 
+#include <isc/atomic.h>
 #include <isc/barrier.h>
 #include <isc/job.h>
 #include <isc/lang.h>
+#include <isc/list.h>
 #include <isc/loop.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/mutex.h>
 #include <isc/refcount.h>
 #include <isc/result.h>
 #include <isc/signal.h>
@@ -48,6 +51,7 @@ struct isc_loop {
 
 	uv_loop_t loop;
 	uint32_t tid;
+	int cpu;
 
 	isc_mem_t *mctx;
 
@@ -110,6 +114,13 @@ struct isc_loopmgr {
 
 	/* per-thread objects */
 	isc_loop_t *loops;
+
+	/* offloaded work */
+	isc_mutex_t work_lock;
+	uint32_t work_limit[isc_workclass_max];
+	atomic_uint_fast32_t work_running[isc_workclass_max];
+	uint32_t work_nwaiting[isc_workclass_max];
+	ISC_LIST(isc_work_t) work_waiting[isc_workclass_max];
 };
 
 /*
@@ -139,9 +150,11 @@ struct isc_signal {
 struct isc_work {
 	uv_work_t work;
 	isc_loop_t *loop;
+	isc_workclass_t workclass;
 	isc_work_cb work_cb;
 	isc_after_work_cb after_work_cb;
 	void *cbarg;
+	ISC_LINK(isc_work_t) link;
 };
 
 #define DEFAULT_LOOP(loopmgr) (&(loopmgr)->loops[0])
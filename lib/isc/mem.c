@@ -31,6 +31,7 @@
 #include <isc/refcount.h>
 #include <isc/strerr.h>
 #include <isc/string.h>
+#include <isc/tid.h>
 #include <isc/types.h>
 #include <isc/urcu.h>
 #include <isc/util.h>
@@ -128,6 +129,7 @@ struct isc_mem {
 	isc_refcount_t references;
 	char name[16];
 	atomic_size_t inuse;
+	atomic_size_t allocations;
 	atomic_bool hi_called;
 	atomic_bool is_overmem;
 	atomic_size_t hi_water;
@@ -157,6 +159,9 @@ struct isc_mempool {
 	size_t freecount;	      /*%< # of items on reserved list */
 	size_t freemax;		      /*%< # of items allowed on free list */
 	size_t fillcount;	      /*%< # of items to fetch on each fill */
+	uint32_t tid;		      /*%< owning loop, if bound */
+	/*%< Items returned from other threads. */
+	_Atomic(element *) remote;
 	/*%< Stats only. */
 	size_t gets; /*%< # of requests to this pool */
 	/*%< Debugging only. */
@@ -360,6 +365,7 @@ mem_realloc(isc_mem_t *ctx, void *old_ptr, size_t old_size, size_t new_size,
 static void
 mem_getstats(isc_mem_t *ctx, size_t size) {
 	atomic_fetch_add_relaxed(&ctx->inuse, size);
+	atomic_fetch_add_relaxed(&ctx->allocations, 1);
 }
 
 /*!
@@ -478,6 +484,7 @@ mem_create(isc_mem_t **ctxp, unsigned int debugging, unsigned int flags,
 	isc_refcount_init(&ctx->references, 1);
 
 	atomic_init(&ctx->inuse, 0);
+	atomic_init(&ctx->allocations, 0);
 	atomic_init(&ctx->hi_water, 0);
 	atomic_init(&ctx->lo_water, 0);
 	atomic_init(&ctx->hi_called, false);
@@ -942,6 +949,13 @@ isc_mem_inuse(isc_mem_t *ctx) {
 	return (atomic_load_relaxed(&ctx->inuse));
 }
 
+size_t
+isc_mem_allocations(isc_mem_t *ctx) {
+	REQUIRE(VALID_CONTEXT(ctx));
+
+	return (atomic_load_relaxed(&ctx->allocations));
+}
+
 void
 isc_mem_clearwater(isc_mem_t *mctx) {
 	isc_mem_setwater(mctx, 0, 0);
@@ -1057,6 +1071,7 @@ isc__mempool_create(isc_mem_t *restrict mctx, const size_t element_size,
 		.size = size,
 		.freemax = 1,
 		.fillcount = 1,
+		.tid = ISC_TID_UNKNOWN,
 	};
 
 #if ISC_MEM_TRACKLINES
@@ -1085,6 +1100,47 @@ isc_mempool_setname(isc_mempool_t *restrict mpctx, const char *name) {
 	strlcpy(mpctx->name, name, sizeof(mpctx->name));
 }
 
+void
+isc_mempool_settid(isc_mempool_t *restrict mpctx, uint32_t tid) {
+	REQUIRE(VALID_MEMPOOL(mpctx));
+	REQUIRE(tid != ISC_TID_UNKNOWN);
+	REQUIRE(mpctx->allocated == 0);
+
+	mpctx->tid = tid;
+}
+
+/*
+ * Take over the items that other threads have returned to a bound pool.
+ * The whole list is detached at once, so the pushers never race with a
+ * pop of a single item and there is no ABA problem.
+ */
+static void
+mempool_reclaim(isc_mempool_t *restrict mpctx) {
+	element *item = atomic_exchange_acquire(&mpctx->remote, NULL);
+#if !__SANITIZE_ADDRESS__
+	const size_t freemax = mpctx->freemax;
+#else
+	const size_t freemax = 0;
+#endif
+
+	while (item != NULL) {
+		element *next = item->next;
+
+		INSIST(mpctx->allocated > 0);
+		mpctx->allocated--;
+
+		if (mpctx->freecount >= freemax) {
+			mem_putstats(mpctx->mctx, mpctx->size);
+			mem_put(mpctx->mctx, item, mpctx->size, 0);
+		} else {
+			item->next = mpctx->items;
+			mpctx->items = item;
+			mpctx->freecount++;
+		}
+		item = next;
+	}
+}
+
 void
 isc__mempool_destroy(isc_mempool_t **restrict mpctxp FLARG) {
 	isc_mempool_t *restrict mpctx = NULL;
@@ -1106,6 +1162,8 @@ isc__mempool_destroy(isc_mempool_t **restrict mpctxp FLARG) {
 	}
 #endif
 
+	mempool_reclaim(mpctx);
+
 	if (mpctx->allocated > 0) {
 		UNEXPECTED_ERROR("mempool %s leaked memory", mpctx->name);
 	}
@@ -1144,6 +1202,12 @@ isc__mempool_get(isc_mempool_t *restrict mpctx FLARG) {
 
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
+	if (mpctx->items == NULL &&
+	    atomic_load_relaxed(&mpctx->remote) != NULL)
+	{
+		mempool_reclaim(mpctx);
+	}
+
 	mpctx->allocated++;
 
 	if (mpctx->items == NULL) {
@@ -1187,6 +1251,22 @@ isc__mempool_put(isc_mempool_t *restrict mpctx, void *mem FLARG) {
 	REQUIRE(VALID_MEMPOOL(mpctx));
 	REQUIRE(mem != NULL);
 
+	if (mpctx->tid != ISC_TID_UNKNOWN && mpctx->tid != isc_tid()) {
+		/*
+		 * Another loop owns this pool; hand the item back to it
+		 * through the remote list.
+		 */
+		item = (element *)mem;
+		DELETE_TRACE(mpctx->mctx, mem, mpctx->size, file, line);
+		item->next = atomic_load_relaxed(&mpctx->remote);
+		while (!atomic_compare_exchange_weak_acq_rel(
+			&mpctx->remote, &item->next, item))
+		{
+			/* retry with the updated head in item->next */
+		}
+		return;
+	}
+
 	isc_mem_t *mctx = mpctx->mctx;
 	const size_t freecount = mpctx->freecount;
 #if !__SANITIZE_ADDRESS__
@@ -1247,6 +1327,9 @@ unsigned int
 isc_mempool_getallocated(isc_mempool_t *restrict mpctx) {
 	REQUIRE(VALID_MEMPOOL(mpctx));
 
+	/* don't count the items that have already been returned remotely */
+	mempool_reclaim(mpctx);
+
 	return (mpctx->allocated);
 }
 
@@ -1567,6 +1650,50 @@ isc__mem_create_arena(isc_mem_t **mctxp FLARG) {
 #endif /* ISC_MEM_TRACKLINES */
 }
 
+void
+isc__mem_create_decay(isc_mem_t **mctxp, const ssize_t dirty_decay_ms,
+		      const ssize_t muzzy_decay_ms FLARG) {
+	if ((isc_mem_defaultflags & ISC_MEMFLAG_ARENAS) == 0) {
+		isc__mem_create(mctxp FLARG_PASS);
+		return;
+	}
+
+	isc__mem_create_arena(mctxp FLARG_PASS);
+	if (dirty_decay_ms >= 0) {
+		(void)isc_mem_arena_set_dirty_decay_ms(*mctxp, dirty_decay_ms);
+	}
+	if (muzzy_decay_ms >= 0) {
+		(void)isc_mem_arena_set_muzzy_decay_ms(*mctxp, muzzy_decay_ms);
+	}
+}
+
+void
+isc_mem_thread_arena(void) {
+#ifdef JEMALLOC_API_SUPPORTED
+	unsigned int arena_no = ISC_MEM_ILLEGAL_ARENA;
+	bool enabled = true;
+
+	if ((isc_mem_defaultflags & ISC_MEMFLAG_ARENAS) == 0) {
+		return;
+	}
+
+	RUNTIME_CHECK(mem_jemalloc_arena_create(&arena_no));
+	RUNTIME_CHECK(mallctl("thread.arena", NULL, NULL, &arena_no,
+			      sizeof(arena_no)) == 0);
+
+	/*
+	 * Unlike the subsystem arenas, which bypass the thread cache, a
+	 * thread arena is only ever used by its own thread, so the thread
+	 * cache can be kept without mixing objects from different arenas.
+	 * Flush whatever the thread cached from the automatic arena before
+	 * it was rebound.
+	 */
+	(void)mallctl("thread.tcache.enabled", NULL, NULL, &enabled,
+		      sizeof(enabled));
+	(void)mallctl("thread.tcache.flush", NULL, NULL, NULL, 0);
+#endif /* JEMALLOC_API_SUPPORTED */
+}
+
 #ifdef JEMALLOC_API_SUPPORTED
 static bool
 jemalloc_set_ssize_value(const char *valname, ssize_t newval) {
@@ -155,6 +155,10 @@ struct isc_nm_http_session {
 
 	isc__nm_http_pending_callbacks_t pending_write_callbacks;
 	isc_buffer_t *pending_write_data;
+
+	bool borrowed;	 /* some request bodies are borrowed, see below */
+	bool flushing;	 /* flushjob has been scheduled */
+	isc_job_t flushjob;
 };
 
 typedef enum isc_http_error_responses {
@@ -560,6 +564,26 @@ on_server_data_chunk_recv_callback(int32_t stream_id, const uint8_t *data,
 
 	while (h2 != NULL) {
 		if (stream_id == h2->stream_id) {
+			if (isc_buffer_base(&h2->rbuf) == NULL &&
+			    len == h2->content_length &&
+			    len <= MAX_DNS_MESSAGE_SIZE)
+			{
+				/*
+				 * The whole body has arrived in one chunk,
+				 * which is the usual case for a DNS query.
+				 * Borrow it from the read buffer instead of
+				 * copying it: the request is very likely to
+				 * be completed before
+				 * nghttp2_session_mem_recv() returns, and if
+				 * it is not, server_unborrow_request_data()
+				 * makes a copy.
+				 */
+				isc_buffer_init(&h2->rbuf, UNCONST(data), len);
+				isc_buffer_add(&h2->rbuf, len);
+				h2->rbuf_borrowed = true;
+				session->borrowed = true;
+				break;
+			}
 			if (isc_buffer_base(&h2->rbuf) == NULL) {
 				isc_buffer_init(
 					&h2->rbuf,
@@ -569,7 +593,8 @@ on_server_data_chunk_recv_callback(int32_t stream_id, const uint8_t *data,
 			}
 			size_t new_bufsize = isc_buffer_usedlength(&h2->rbuf) +
 					     len;
-			if (new_bufsize <= MAX_DNS_MESSAGE_SIZE &&
+			if (!h2->rbuf_borrowed &&
+			    new_bufsize <= MAX_DNS_MESSAGE_SIZE &&
 			    new_bufsize <= h2->content_length)
 			{
 				isc_buffer_putmem(&h2->rbuf, data, len);
@@ -587,6 +612,49 @@ on_server_data_chunk_recv_callback(int32_t stream_id, const uint8_t *data,
 	return (0);
 }
 
+/*
+ * Forget a borrowed request body, or free an owned one.
+ */
+static void
+server_release_request_data(isc_nmsocket_h2_t *h2, isc_mem_t *mctx) {
+	void *base = isc_buffer_base(&h2->rbuf);
+
+	if (base != NULL && !h2->rbuf_borrowed) {
+		isc_mem_free(mctx, base);
+	}
+	isc_buffer_initnull(&h2->rbuf);
+	h2->rbuf_borrowed = false;
+}
+
+/*
+ * Copy the request bodies borrowed during the last call to
+ * nghttp2_session_mem_recv() whose requests have not been completed
+ * yet, as the data they point to is about to go away.
+ */
+static void
+server_unborrow_request_data(isc_nm_http_session_t *session) {
+	isc_nmsocket_h2_t *h2 = NULL;
+
+	if (!session->borrowed) {
+		return;
+	}
+
+	ISC_LIST_FOREACH (session->sstreams, h2, link) {
+		if (h2->rbuf_borrowed) {
+			isc_mem_t *mctx = h2->psock->worker->mctx;
+			isc_region_t r;
+
+			isc_buffer_usedregion(&h2->rbuf, &r);
+			isc_buffer_init(&h2->rbuf,
+					isc_mem_allocate(mctx, r.length),
+					r.length);
+			isc_buffer_putmem(&h2->rbuf, r.base, r.length);
+			h2->rbuf_borrowed = false;
+		}
+	}
+	session->borrowed = false;
+}
+
 static int
 on_data_chunk_recv_callback(nghttp2_session *ngsession, uint8_t flags,
 			    int32_t stream_id, const uint8_t *data, size_t len,
@@ -998,6 +1066,7 @@ http_readcb(isc_nmhandle_t *handle ISC_ATTR_UNUSED, isc_result_t result,
 
 	readlen = nghttp2_session_mem_recv(session->ngsession, region->base,
 					   region->length);
+	server_unborrow_request_data(session);
 	if (readlen < 0) {
 		failed_read_cb(ISC_R_UNEXPECTED, session);
 		return;
@@ -1278,6 +1347,7 @@ http_do_bio(isc_nm_http_session_t *session, isc_nmhandle_t *send_httphandle,
 			size_t readlen = nghttp2_session_mem_recv(
 				session->ngsession,
 				isc_buffer_current(session->buf), remaining);
+			server_unborrow_request_data(session);
 
 			if (readlen == remaining) {
 				isc_buffer_free(&session->buf);
@@ -2052,15 +2122,9 @@ log_server_error_response(const isc_nmsocket_t *socket,
 static isc_result_t
 server_send_error_response(const isc_http_error_responses_t error,
 			   nghttp2_session *ngsession, isc_nmsocket_t *socket) {
-	void *base;
-
 	REQUIRE(error != ISC_HTTP_ERROR_SUCCESS);
 
-	base = isc_buffer_base(&socket->h2->rbuf);
-	if (base != NULL) {
-		isc_mem_free(socket->h2->session->mctx, base);
-		isc_buffer_initnull(&socket->h2->rbuf);
-	}
+	server_release_request_data(socket->h2, socket->h2->session->mctx);
 
 	/* We do not want the error response to be cached anywhere. */
 	socket->h2->min_ttl = 0;
@@ -2117,7 +2181,6 @@ server_on_request_recv(nghttp2_session *ngsession,
 	isc_result_t result;
 	isc_http_error_responses_t code = ISC_HTTP_ERROR_SUCCESS;
 	isc_region_t data;
-	uint8_t tmp_buf[MAX_DNS_MESSAGE_SIZE];
 
 	code = socket->h2->headers_error_code;
 	if (code != ISC_HTTP_ERROR_SUCCESS) {
@@ -2168,8 +2231,13 @@ server_on_request_recv(nghttp2_session *ngsession,
 	}
 
 	if (socket->h2->request_type == ISC_HTTP_REQ_GET) {
+		/*
+		 * Decode the query in place: the decoder never writes
+		 * ahead of the character it is reading.
+		 */
 		isc_buffer_t decoded_buf;
-		isc_buffer_init(&decoded_buf, tmp_buf, sizeof(tmp_buf));
+		isc_buffer_init(&decoded_buf, socket->h2->query_data,
+				socket->h2->query_data_len);
 		if (isc_base64_decodestring(socket->h2->query_data,
 					    &decoded_buf) != ISC_R_SUCCESS)
 		{
@@ -2186,6 +2254,10 @@ server_on_request_recv(nghttp2_session *ngsession,
 
 	server_call_cb(socket, session, ISC_R_SUCCESS, &data);
 
+	if (socket->h2->rbuf_borrowed) {
+		server_release_request_data(socket->h2, session->mctx);
+	}
+
 	return (0);
 
 error:
@@ -2255,6 +2327,30 @@ client_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 	isc__nm_uvreq_put(&req);
 }
 
+static void
+server_flush_cb(void *arg) {
+	isc_nm_http_session_t *session = arg;
+
+	REQUIRE(VALID_HTTP2_SESSION(session));
+
+	session->flushing = false;
+	http_do_bio(session, NULL, NULL, NULL);
+	isc__nm_httpsession_detach(&session);
+}
+
+static void
+server_schedule_flush(isc_nm_http_session_t *session, isc_loop_t *loop) {
+	isc_nm_http_session_t *tmpsess = NULL;
+
+	if (session->flushing) {
+		return;
+	}
+
+	session->flushing = true;
+	isc__nm_httpsession_attach(session, &tmpsess);
+	isc_job_run(loop, &session->flushjob, server_flush_cb, tmpsess);
+}
+
 static void
 server_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 		isc__nm_uvreq_t *req) {
@@ -2302,12 +2398,21 @@ server_httpsend(isc_nmhandle_t *handle, isc_nmsocket_t *sock,
 				      sock->h2->stream_id, hdrs,
 				      sizeof(hdrs) / sizeof(nghttp2_nv), sock);
 
-	if (result == ISC_R_SUCCESS) {
-		http_do_bio(handle->httpsession, handle, cb, cbarg);
-	} else {
+	if (result != ISC_R_SUCCESS) {
 		cb(handle, result, cbarg);
+		isc__nm_uvreq_put(&req);
+		return;
 	}
-	isc__nm_uvreq_put(&req);
+
+	/*
+	 * Do not write the response right away: the responses to the
+	 * other requests read along with this one are likely to be sent
+	 * during the same loop iteration, so queue the callback and let
+	 * server_flush_cb() write them all at once.
+	 */
+	ISC_LIST_APPEND(handle->httpsession->pending_write_callbacks, req,
+			link);
+	server_schedule_flush(handle->httpsession, sock->worker->loop);
 }
 
 static void
@@ -3261,11 +3366,7 @@ isc__nm_http_cleanup_data(isc_nmsocket_t *sock) {
 
 		INSIST(sock->h2->connect.cstream == NULL);
 
-		if (isc_buffer_base(&sock->h2->rbuf) != NULL) {
-			void *base = isc_buffer_base(&sock->h2->rbuf);
-			isc_mem_free(sock->worker->mctx, base);
-			isc_buffer_initnull(&sock->h2->rbuf);
-		}
+		server_release_request_data(sock->h2, sock->worker->mctx);
 		FALLTHROUGH;
 	case isc_nm_proxystreamlistener:
 	case isc_nm_proxystreamsocket:
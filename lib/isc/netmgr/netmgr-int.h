@@ -60,6 +60,19 @@
 #define ISC_NETMGR_UDP_RECVBUF_SIZE UINT16_MAX
 #endif
 
+/*
+ * The maximum number of UDP datagrams that will be handed to a single
+ * sendmmsg(2) call when flushing the per-socket send queue.
+ */
+#define ISC_NETMGR_UDP_SENDMMSG_MAX 64
+
+/*
+ * The maximum number of DNS messages that will be written to a TCP
+ * socket with a single writev(2) call when flushing the per-socket send
+ * queue; each takes two iovecs, one for the length prefix.
+ */
+#define ISC_NETMGR_TCP_SENDQ_MAX 64
+
 /*
  * The TCP receive buffer can fit one maximum sized DNS message plus its size,
  * the receive buffer here affects TCP, DoT and DoH.
@@ -332,6 +345,14 @@ struct isc_nm {
 	atomic_uint_fast32_t maxudp;
 
 	bool load_balance_sockets;
+	bool cpu_steering;
+
+	/*
+	 * TCP_DEFER_ACCEPT timeout (in seconds) and TCP Fast Open queue
+	 * length of the TCP listening sockets; 0 disables the option.
+	 */
+	uint32_t tcp_defer_accept;
+	uint32_t tcp_fastopen;
 
 	/*
 	 * Active connections are being closed and new connections are
@@ -444,6 +465,7 @@ typedef struct isc_nmsocket_h2 {
 
 	isc_buffer_t rbuf;
 	isc_buffer_t wbuf;
+	bool rbuf_borrowed; /* rbuf points into the session's read data */
 
 	int32_t stream_id;
 	isc_nm_http_session_t *session;
@@ -541,6 +563,8 @@ struct isc_nmsocket {
 		isc_nmsocket_t *sock;
 		size_t nsending;
 		void *send_req;
+		unsigned int batching;
+		void *batch;
 		bool dot_alpn_negotiated;
 		const char *tls_verify_error;
 	} streamdns;
@@ -665,6 +689,21 @@ struct isc_nmsocket {
 	ISC_LIST(isc_nmhandle_t) active_handles;
 	ISC_LIST(isc__nm_uvreq_t) active_uvreqs;
 
+	/*%
+	 * UDP send requests queued during the current event loop
+	 * iteration; they are flushed together with sendmmsg(2)
+	 * from 'udp_sendjob'.
+	 */
+	ISC_LIST(isc__nm_uvreq_t) udp_sendq;
+	isc_job_t udp_sendjob;
+
+	/*%
+	 * Likewise, DNS messages sent over TCP during the current event
+	 * loop iteration; they are written together from 'tcp_sendjob'.
+	 */
+	ISC_LIST(isc__nm_uvreq_t) tcp_sendq;
+	isc_job_t tcp_sendjob;
+
 	/*%
 	 * Used to pass a result back from listen or connect events.
 	 */
@@ -842,6 +881,13 @@ isc__nm_udp_read(isc_nmhandle_t *handle, isc_nm_recv_cb_t cb, void *cbarg);
  * Back-end implementation of isc_nm_read() for UDP handles.
  */
 
+void
+isc__nm_udp_read_stop(isc_nmhandle_t *handle);
+/*%<
+ * Stop reading on this UDP handle without calling the read callback;
+ * the socket stays open and can be read from again.
+ */
+
 void
 isc__nm_udp_close(isc_nmsocket_t *sock);
 /*%<
@@ -1320,6 +1366,29 @@ isc__nm_socket_incoming_cpu(uv_os_sock_t fd);
  * Set the SO_INCOMING_CPU socket option on the fd if available
  */
 
+isc_result_t
+isc__nm_socket_steer_cpu(uv_os_sock_t fd, uint32_t nsockets);
+/*%<
+ * Attach a classic BPF program to the SO_REUSEPORT group of the fd that
+ * selects the socket by the number of the receiving CPU modulo
+ * 'nsockets', if available
+ */
+
+isc_result_t
+isc__nm_socket_tcp_defer_accept(uv_os_sock_t fd, uint32_t timeout);
+/*%<
+ * Make the listening fd complete the accept only when data has arrived
+ * on the new connection, or after 'timeout' seconds, if available
+ * (TCP_DEFER_ACCEPT, or the "dataready" accept filter)
+ */
+
+isc_result_t
+isc__nm_socket_tcp_fastopen(uv_os_sock_t fd, uint32_t qlen);
+/*%<
+ * Enable server-side TCP Fast Open on the listening fd with at most
+ * 'qlen' pending Fast Open requests, if available
+ */
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family);
 /*%<
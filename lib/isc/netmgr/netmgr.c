@@ -191,6 +191,9 @@ isc_netmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t **netmgrp) {
 #else
 	netmgr->load_balance_sockets = false;
 #endif
+	netmgr->cpu_steering = false;
+	netmgr->tcp_defer_accept = 0;
+	netmgr->tcp_fastopen = 0;
 
 	/*
 	 * Default TCP timeout values.
@@ -231,6 +234,9 @@ isc_netmgr_create(isc_mem_t *mctx, isc_loopmgr_t *loopmgr, isc_nm_t **netmgrp) {
 				   &worker->uvreq_pool);
 		isc_mempool_setfreemax(worker->uvreq_pool, ISC_NM_UVREQS_MAX);
 
+		isc_mempool_settid(worker->nmsocket_pool, i);
+		isc_mempool_settid(worker->uvreq_pool, i);
+
 		isc_loop_attach(loop, &worker->loop);
 		isc_loop_teardown(loop, networker_teardown, worker);
 		isc_refcount_init(&worker->references, 1);
@@ -375,6 +381,41 @@ isc_nm_setloadbalancesockets(isc_nm_t *mgr, ISC_ATTR_UNUSED bool enabled) {
 #endif
 }
 
+bool
+isc_nm_getcpusteering(isc_nm_t *mgr) {
+	REQUIRE(VALID_NM(mgr));
+
+	return (mgr->cpu_steering);
+}
+
+void
+isc_nm_setcpusteering(isc_nm_t *mgr, ISC_ATTR_UNUSED bool enabled) {
+	REQUIRE(VALID_NM(mgr));
+
+#if HAVE_SO_ATTACH_REUSEPORT_CBPF
+	mgr->cpu_steering = enabled;
+#endif
+}
+
+void
+isc_nm_gettcplistenopts(isc_nm_t *mgr, uint32_t *defer_accept,
+			uint32_t *fastopen) {
+	REQUIRE(VALID_NM(mgr));
+	REQUIRE(defer_accept != NULL && fastopen != NULL);
+
+	*defer_accept = mgr->tcp_defer_accept;
+	*fastopen = mgr->tcp_fastopen;
+}
+
+void
+isc_nm_settcplistenopts(isc_nm_t *mgr, uint32_t defer_accept,
+			uint32_t fastopen) {
+	REQUIRE(VALID_NM(mgr));
+
+	mgr->tcp_defer_accept = defer_accept;
+	mgr->tcp_fastopen = fastopen;
+}
+
 void
 isc_nm_gettimeouts(isc_nm_t *mgr, uint32_t *initial, uint32_t *idle,
 		   uint32_t *keepalive, uint32_t *advertised) {
@@ -688,6 +729,8 @@ isc___nmsocket_init(isc_nmsocket_t *sock, isc__networker_t *worker,
 		.inactive_handles = ISC_LIST_INITIALIZER,
 		.result = ISC_R_UNSET,
 		.active_handles = ISC_LIST_INITIALIZER,
+		.udp_sendq = ISC_LIST_INITIALIZER,
+		.tcp_sendq = ISC_LIST_INITIALIZER,
 		.active_link = ISC_LINK_INITIALIZER,
 		.active = true,
 	};
@@ -1729,6 +1772,9 @@ isc_nm_read_stop(isc_nmhandle_t *handle) {
 	isc_nmsocket_t *sock = handle->sock;
 
 	switch (sock->type) {
+	case isc_nm_udpsocket:
+		isc__nm_udp_read_stop(handle);
+		break;
 	case isc_nm_tcpsocket:
 		isc__nm_tcp_read_stop(handle);
 		break;
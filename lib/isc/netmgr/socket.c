@@ -11,6 +11,12 @@
  * information regarding copyright ownership.
  */
 
+#ifdef __linux__
+#include <linux/filter.h>
+#endif /* __linux__ */
+
+#include <limits.h>
+
 #include <isc/errno.h>
 #include <isc/uv.h>
 
@@ -232,6 +238,102 @@ isc__nm_socket_incoming_cpu(uv_os_sock_t fd) {
 	return (ISC_R_NOTIMPLEMENTED);
 }
 
+isc_result_t
+isc__nm_socket_steer_cpu(uv_os_sock_t fd, uint32_t nsockets) {
+	/*
+	 * The program is shared by every socket in the SO_REUSEPORT
+	 * group and returns the index of the socket that should receive
+	 * the packet (or the connection).  Sockets are indexed in the
+	 * order in which they joined the group, so all traffic arriving
+	 * on one CPU (i.e. one NIC receive queue) is always delivered to
+	 * the same networking thread.
+	 */
+#if HAVE_SO_ATTACH_REUSEPORT_CBPF
+	struct sock_filter code[] = {
+		/* A = the number of the receiving CPU */
+		{ BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+		/* A = A % nsockets */
+		{ BPF_ALU | BPF_MOD | BPF_K, 0, 0, nsockets },
+		/* return A */
+		{ BPF_RET | BPF_A, 0, 0, 0 },
+	};
+	struct sock_fprog prog = {
+		.len = ARRAY_SIZE(code),
+		.filter = code,
+	};
+
+	REQUIRE(nsockets > 0);
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog,
+		       sizeof(prog)) == -1)
+	{
+		return (isc_errno_toresult(errno));
+	}
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(fd);
+	UNUSED(nsockets);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
+isc_result_t
+isc__nm_socket_tcp_defer_accept(uv_os_sock_t fd, uint32_t timeout) {
+#if defined(TCP_DEFER_ACCEPT)
+	int value = (int)ISC_MIN(timeout, (uint32_t)INT_MAX);
+
+	if (setsockopt(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &value,
+		       sizeof(value)) == -1)
+	{
+		return (isc_errno_toresult(errno));
+	}
+	return (ISC_R_SUCCESS);
+#elif defined(SO_ACCEPTFILTER)
+	/*
+	 * The "dataready" filter has no timeout of its own; connections
+	 * that never send anything wait in the listen queue.
+	 */
+	struct accept_filter_arg afa = { .af_name = "dataready" };
+
+	UNUSED(timeout);
+
+	if (setsockopt(fd, SOL_SOCKET, SO_ACCEPTFILTER, &afa, sizeof(afa)) ==
+	    -1)
+	{
+		return (isc_errno_toresult(errno));
+	}
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(fd);
+	UNUSED(timeout);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
+isc_result_t
+isc__nm_socket_tcp_fastopen(uv_os_sock_t fd, uint32_t qlen) {
+#if defined(TCP_FASTOPEN)
+	/*
+	 * On Linux the value is the length of the queue of connections
+	 * that have not completed the handshake yet; elsewhere any
+	 * non-zero value enables Fast Open.  The kernel generates and
+	 * rotates the cookies.
+	 */
+	int value = (int)ISC_MIN(qlen, (uint32_t)INT_MAX);
+
+	if (setsockopt(fd, IPPROTO_TCP, TCP_FASTOPEN, &value, sizeof(value)) ==
+	    -1)
+	{
+		return (isc_errno_toresult(errno));
+	}
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(fd);
+	UNUSED(qlen);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
 isc_result_t
 isc__nm_socket_disable_pmtud(uv_os_sock_t fd, sa_family_t sa_family) {
 	/*
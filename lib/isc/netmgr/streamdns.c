@@ -12,10 +12,13 @@
  */
 
 #include <limits.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <isc/async.h>
 #include <isc/atomic.h>
+#include <isc/endian.h>
+#include <isc/mem.h>
 #include <isc/result.h>
 #include <isc/thread.h>
 
@@ -58,16 +61,44 @@
  * 'streamdns_get_send_req()' and 'streamdns_put_send_req()' which are
  * responsible for send requests allocation/reuse and initialisation.
  *
+ * On the server side, responses sent while the messages from one
+ * chunk of incoming data are being processed (which is the case for
+ * every answer that does not need recursion) are not written right
+ * away but collected into a batch, which is written as a single
+ * buffer once the processing is done (see
+ * 'streamdns_handle_incoming_data()' and 'streamdns_flush_batch()').
+ * That turns a burst of pipelined queries into one write system call,
+ * or one TLS record, instead of one per response.
+ *
  * The rest of the code is mostly wrapping code to expose the
  * functionality of the underlying transport, which at the moment
  * could be either TCP or TLS.
  */
 
-typedef struct streamdns_send_req {
+typedef struct streamdns_send_req streamdns_send_req_t;
+struct streamdns_send_req {
 	isc_nm_cb_t cb;		   /* send callback */
 	void *cbarg;		   /* send callback argument */
 	isc_nmhandle_t *dnshandle; /* Stream DNS socket handle */
-} streamdns_send_req_t;
+	isc_region_t data;	   /* message data, while batched */
+	ISC_LINK(streamdns_send_req_t) link;
+};
+
+/*
+ * Do not let a batch of responses grow beyond this many bytes; a
+ * larger batch is written in several parts.
+ */
+#define STREAMDNS_BATCH_MAX (64 * 1024)
+
+typedef struct streamdns_batch {
+	isc_nmsocket_t *sock; /* attached while being written */
+	ISC_LIST(streamdns_send_req_t) reqs;
+	size_t len; /* bytes on the wire, with length prefixes */
+	unsigned char *buf;
+} streamdns_batch_t;
+
+static void
+streamdns_flush_batch(isc_nmsocket_t *sock);
 
 static streamdns_send_req_t *
 streamdns_get_send_req(isc_nmsocket_t *sock, isc_mem_t *mctx,
@@ -238,8 +269,17 @@ streamdns_handle_incoming_data(isc_nmsocket_t *sock,
 	 * Try to process the received data or, when 'data == NULL' and
 	 * 'len == 0', try to resume processing of the data within the
 	 * internal buffers or resume reading, if there is no any.
+	 *
+	 * Responses sent while that happens are batched on the server
+	 * side and written together afterwards.
 	 */
+	if (!sock->client) {
+		sock->streamdns.batching++;
+	}
 	isc_dnsstream_assembler_incoming(dnsasm, transphandle, data, len);
+	if (!sock->client && --sock->streamdns.batching == 0) {
+		streamdns_flush_batch(sock);
+	}
 	streamdns_try_close_unused(sock);
 }
 
@@ -594,6 +634,7 @@ streamdns_get_send_req(isc_nmsocket_t *sock, isc_mem_t *mctx,
 	/* Initialise the send request object */
 	send_req->cb = req->cb.send;
 	send_req->cbarg = req->cbarg;
+	ISC_LINK_INIT(send_req, link);
 	isc_nmhandle_attach(req->handle, &send_req->dnshandle);
 
 	sock->streamdns.nsending++;
@@ -650,6 +691,105 @@ streamdns_writecb(isc_nmhandle_t *handle, isc_result_t result, void *cbarg) {
 	isc_nmhandle_detach(&dnshandle);
 }
 
+static void
+streamdns_batch_writecb(isc_nmhandle_t *handle, isc_result_t result,
+			void *cbarg) {
+	streamdns_batch_t *batch = (streamdns_batch_t *)cbarg;
+	isc_nmsocket_t *sock = batch->sock;
+	isc_mem_t *mctx = sock->worker->mctx;
+	streamdns_send_req_t *send_req = NULL;
+
+	REQUIRE(VALID_NMHANDLE(handle));
+	REQUIRE(sock->tid == isc_tid());
+
+	while ((send_req = ISC_LIST_HEAD(batch->reqs)) != NULL) {
+		ISC_LIST_UNLINK(batch->reqs, send_req, link);
+		streamdns_writecb(handle, result, send_req);
+	}
+
+	isc_mem_put(mctx, batch->buf, batch->len);
+	isc_mem_put(mctx, batch, sizeof(*batch));
+	isc__nmsocket_detach(&sock);
+}
+
+/*
+ * Write the responses collected while processing incoming data: a
+ * single one as it is, several of them copied, with their length
+ * prefixes, into one buffer.
+ */
+static void
+streamdns_flush_batch(isc_nmsocket_t *sock) {
+	streamdns_batch_t *batch = sock->streamdns.batch;
+	isc_mem_t *mctx = sock->worker->mctx;
+	streamdns_send_req_t *send_req = NULL;
+	isc_region_t data;
+	size_t pos = 0;
+
+	if (batch == NULL) {
+		return;
+	}
+	sock->streamdns.batch = NULL;
+
+	if (streamdns_closing(sock)) {
+		while ((send_req = ISC_LIST_HEAD(batch->reqs)) != NULL) {
+			isc__nm_uvreq_t *uvreq = isc__nm_uvreq_get(sock);
+
+			ISC_LIST_UNLINK(batch->reqs, send_req, link);
+			isc_nmhandle_attach(send_req->dnshandle,
+					    &uvreq->handle);
+			uvreq->cb.send = send_req->cb;
+			uvreq->cbarg = send_req->cbarg;
+			streamdns_put_send_req(mctx, send_req, false);
+			isc__nm_failed_send_cb(sock, uvreq, ISC_R_CANCELED,
+					       true);
+		}
+		isc_mem_put(mctx, batch, sizeof(*batch));
+		return;
+	}
+
+	send_req = ISC_LIST_HEAD(batch->reqs);
+	if (ISC_LIST_NEXT(send_req, link) == NULL) {
+		ISC_LIST_UNLINK(batch->reqs, send_req, link);
+		isc_mem_put(mctx, batch, sizeof(*batch));
+		isc__nm_senddns(sock->outerhandle, &send_req->data,
+				streamdns_writecb, (void *)send_req);
+		return;
+	}
+
+	batch->buf = isc_mem_get(mctx, batch->len);
+	ISC_LIST_FOREACH (batch->reqs, send_req, link) {
+		ISC_U16TO8_BE(batch->buf + pos, send_req->data.length);
+		memmove(batch->buf + pos + 2, send_req->data.base,
+			send_req->data.length);
+		pos += 2 + send_req->data.length;
+	}
+	INSIST(pos == batch->len);
+
+	isc__nmsocket_attach(sock, &batch->sock);
+	data = (isc_region_t){ .base = batch->buf, .length = batch->len };
+	isc_nm_send(sock->outerhandle, &data, streamdns_batch_writecb, batch);
+}
+
+static void
+streamdns_batch_add(isc_nmsocket_t *sock, streamdns_send_req_t *send_req) {
+	streamdns_batch_t *batch = sock->streamdns.batch;
+	size_t len = 2 + send_req->data.length;
+
+	if (batch != NULL && batch->len + len > STREAMDNS_BATCH_MAX) {
+		streamdns_flush_batch(sock);
+		batch = NULL;
+	}
+
+	if (batch == NULL) {
+		batch = isc_mem_get(sock->worker->mctx, sizeof(*batch));
+		*batch = (streamdns_batch_t){ .reqs = ISC_LIST_INITIALIZER };
+		sock->streamdns.batch = batch;
+	}
+
+	ISC_LIST_APPEND(batch->reqs, send_req, link);
+	batch->len += len;
+}
+
 static bool
 streamdns_closing(isc_nmsocket_t *sock) {
 	return (isc__nmsocket_closing(sock) || isc__nm_closing(sock->worker) ||
@@ -829,6 +969,7 @@ isc__nm_streamdns_cleanup_data(isc_nmsocket_t *sock) {
 	case isc_nm_streamdnssocket:
 		isc_dnsstream_assembler_free(&sock->streamdns.input);
 		INSIST(sock->streamdns.nsending == 0);
+		INSIST(sock->streamdns.batch == NULL);
 		if (sock->streamdns.send_req != NULL) {
 			isc_mem_t *mctx = sock->worker->mctx;
 			streamdns_put_send_req(mctx,
@@ -940,7 +1081,6 @@ isc__nm_streamdns_send(isc_nmhandle_t *handle, const isc_region_t *region,
 	isc_nmsocket_t *sock = NULL;
 	streamdns_send_req_t *send_req;
 	isc_mem_t *mctx;
-	isc_region_t data = { 0 };
 
 	REQUIRE(VALID_NMHANDLE(handle));
 	REQUIRE(VALID_NMSOCK(handle->sock));
@@ -970,12 +1110,17 @@ isc__nm_streamdns_send(isc_nmhandle_t *handle, const isc_region_t *region,
 	 */
 	mctx = sock->worker->mctx;
 	send_req = streamdns_get_send_req(sock, mctx, uvreq);
-	data.base = (unsigned char *)uvreq->uvbuf.base;
-	data.length = uvreq->uvbuf.len;
-	isc__nm_senddns(sock->outerhandle, &data, streamdns_writecb,
-			(void *)send_req);
-
+	send_req->data.base = (unsigned char *)uvreq->uvbuf.base;
+	send_req->data.length = uvreq->uvbuf.len;
 	isc__nm_uvreq_put(&uvreq);
+
+	if (sock->streamdns.batching > 0) {
+		streamdns_batch_add(sock, send_req);
+		return;
+	}
+
+	isc__nm_senddns(sock->outerhandle, &send_req->data, streamdns_writecb,
+			(void *)send_req);
 }
 
 static void
@@ -57,6 +57,13 @@ tcp_connect_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req);
 
 static isc_result_t
 tcp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req);
+static isc_result_t
+tcp_send_write(isc_nmsocket_t *sock, isc__nm_uvreq_t *req, uv_buf_t *bufs,
+	       size_t nbufs);
+static void
+tcp_send_flush(void *arg);
+static void
+tcp_flush_sendq(isc_nmsocket_t *sock, bool async);
 static void
 tcp_connect_cb(uv_connect_t *uvreq, int status);
 static void
@@ -301,6 +308,52 @@ isc__nm_tcp_lb_socket(isc_nm_t *mgr, sa_family_t sa_family) {
 	return (sock);
 }
 
+static void
+tcp_steer_cpu(isc_nmsocket_t *sock) {
+	isc_result_t result = isc__nm_socket_steer_cpu(
+		sock->fd, sock->parent->nchildren);
+	if (result != ISC_R_SUCCESS) {
+		isc__nmsocket_log(sock, ISC_LOG_WARNING,
+				  "unable to steer TCP connections by CPU: %s",
+				  isc_result_totext(result));
+	}
+}
+
+static void
+tcp_listen_options(isc_nmsocket_t *sock) {
+	isc_nm_t *mgr = sock->worker->netmgr;
+	isc_result_t result;
+
+	/*
+	 * Without load balancing, all the children share the socket
+	 * of the first one.
+	 */
+	if (!mgr->load_balance_sockets && sock->tid != 0) {
+		return;
+	}
+
+	if (mgr->tcp_defer_accept > 0) {
+		result = isc__nm_socket_tcp_defer_accept(sock->fd,
+							 mgr->tcp_defer_accept);
+		if (result != ISC_R_SUCCESS && sock->tid == 0) {
+			isc__nmsocket_log(sock, ISC_LOG_WARNING,
+					  "unable to defer accepting TCP "
+					  "connections: %s",
+					  isc_result_totext(result));
+		}
+	}
+
+	if (mgr->tcp_fastopen > 0) {
+		result = isc__nm_socket_tcp_fastopen(sock->fd,
+						     mgr->tcp_fastopen);
+		if (result != ISC_R_SUCCESS && sock->tid == 0) {
+			isc__nmsocket_log(sock, ISC_LOG_WARNING,
+					  "unable to enable TCP Fast Open: %s",
+					  isc_result_totext(result));
+		}
+	}
+}
+
 static void
 start_tcp_child_job(void *arg) {
 	isc_nmsocket_t *sock = arg;
@@ -364,9 +417,14 @@ start_tcp_child_job(void *arg) {
 	isc__nm_set_network_buffers(sock->worker->netmgr,
 				    &sock->uv_handle.handle);
 
+	tcp_listen_options(sock);
+
 	/*
 	 * The callback will run in the same thread uv_listen() was called
 	 * from, so a race with tcp_connection_cb() isn't possible.
+	 * libuv accepts all the pending connections each time the socket
+	 * becomes readable, so they are handled in one batch per loop
+	 * iteration.
 	 */
 	r = uv_listen((uv_stream_t *)&sock->uv_handle.tcp, sock->backlog,
 		      tcp_connection_cb);
@@ -377,6 +435,16 @@ start_tcp_child_job(void *arg) {
 		goto done;
 	}
 
+	/*
+	 * The SO_REUSEPORT group of a TCP socket is only formed by
+	 * listen(), so the steering program is attached afterwards.
+	 */
+	if (sock->worker->netmgr->load_balance_sockets &&
+	    sock->worker->netmgr->cpu_steering && sock->tid == 0)
+	{
+		tcp_steer_cpu(sock);
+	}
+
 	if (sock->tid == 0) {
 		r = uv_tcp_getsockname(&sock->uv_handle.tcp,
 				       (struct sockaddr *)&ss,
@@ -975,6 +1043,23 @@ tcp_send(isc_nmhandle_t *handle, const isc_region_t *region, isc_nm_cb_t cb,
 				: atomic_load_relaxed(&netmgr->idle);
 	}
 
+	/*
+	 * DNS messages are collected and written together at the end of
+	 * the event loop iteration.  Anything else is written right away,
+	 * after the messages queued before it.
+	 */
+	if (dnsmsg) {
+		if (ISC_LIST_EMPTY(sock->tcp_sendq)) {
+			isc__nmsocket_attach(sock, &(isc_nmsocket_t *){ NULL });
+			isc_job_run(sock->worker->loop, &sock->tcp_sendjob,
+				    tcp_send_flush, sock);
+		}
+		ISC_LIST_APPEND(sock->tcp_sendq, uvreq, link);
+		return;
+	}
+
+	tcp_flush_sendq(sock, true);
+
 	result = tcp_send_direct(sock, uvreq);
 	if (result != ISC_R_SUCCESS) {
 		isc__nm_incstats(sock, STATID_SENDFAIL);
@@ -1079,6 +1164,18 @@ tcp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
 		}
 	}
 
+	return (tcp_send_write(sock, req, bufs, nbufs));
+}
+
+/*
+ * Hand the unwritten part of a request over to libuv, which will queue
+ * it and write it when the socket becomes writable.
+ */
+static isc_result_t
+tcp_send_write(isc_nmsocket_t *sock, isc__nm_uvreq_t *req, uv_buf_t *bufs,
+	       size_t nbufs) {
+	int r;
+
 	r = uv_write(&req->uv_req.write, &sock->uv_handle.stream, bufs, nbufs,
 		     tcp_send_cb);
 	if (r < 0) {
@@ -1094,6 +1191,121 @@ tcp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *req) {
 	return (ISC_R_SUCCESS);
 }
 
+static void
+tcp_send_failed(isc_nmsocket_t *sock, isc__nm_uvreq_t *req,
+		isc_result_t result, bool async) {
+	isc__nm_incstats(sock, STATID_SENDFAIL);
+	isc__nm_failed_send_cb(sock, req, result, async);
+}
+
+/*
+ * Write the DNS messages queued on the socket, with their length
+ * prefixes, using as few writev(2) calls as possible.  The messages
+ * that the kernel accepts are completed right away; the rest are
+ * handed over to libuv one by one, as if they had been sent directly.
+ * The callbacks are only run once all of the messages have been
+ * written or queued, so that any data they send goes out after them;
+ * 'async' is false when we are already running from a loop job.
+ */
+static void
+tcp_flush_sendq(isc_nmsocket_t *sock, bool async) {
+	isc__nm_uvreq_t *reqs[ISC_NETMGR_TCP_SENDQ_MAX];
+	uv_buf_t bufs[2 * ISC_NETMGR_TCP_SENDQ_MAX];
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	while (!ISC_LIST_EMPTY(sock->tcp_sendq)) {
+		isc__nm_uvreq_t *req = NULL;
+		isc_result_t result;
+		unsigned int n = 0, done = 0, i;
+		size_t written;
+		int r;
+
+		while (n < ISC_NETMGR_TCP_SENDQ_MAX &&
+		       (req = ISC_LIST_HEAD(sock->tcp_sendq)) != NULL)
+		{
+			ISC_LIST_UNLINK(sock->tcp_sendq, req, link);
+			bufs[2 * n] = uv_buf_init(req->tcplen, 2);
+			bufs[2 * n + 1] = uv_buf_init(req->uvbuf.base,
+						      req->uvbuf.len);
+			reqs[n++] = req;
+		}
+
+		if (n == 1) {
+			result = tcp_send_direct(sock, reqs[0]);
+			if (result != ISC_R_SUCCESS) {
+				tcp_send_failed(sock, reqs[0], result, async);
+			}
+			continue;
+		}
+
+		if (isc__nmsocket_closing(sock)) {
+			for (i = 0; i < n; i++) {
+				tcp_send_failed(sock, reqs[i], ISC_R_CANCELED,
+						async);
+			}
+			continue;
+		}
+
+		r = uv_try_write(&sock->uv_handle.stream, bufs, 2 * n);
+		if (r == UV_ENOSYS || r == UV_EAGAIN) {
+			r = 0;
+		} else if (r < 0) {
+			for (i = 0; i < n; i++) {
+				tcp_send_failed(sock, reqs[i],
+						isc_uverr2result(r), async);
+			}
+			continue;
+		}
+
+		written = (size_t)r;
+		while (done < n && written >= 2 + reqs[done]->uvbuf.len) {
+			/* Wrote all of this message */
+			written -= 2 + reqs[done]->uvbuf.len;
+			done++;
+		}
+
+		for (i = done; i < n; i++) {
+			uv_buf_t *rbufs = &bufs[2 * i];
+			size_t nbufs = 2;
+
+			if (written == 0) {
+				result = tcp_send_direct(sock, reqs[i]);
+			} else {
+				/* Partial write of this message */
+				if (written < 2) {
+					rbufs[0].base += written;
+					rbufs[0].len -= written;
+				} else {
+					rbufs[1].base += written - 2;
+					rbufs[1].len -= written - 2;
+					rbufs++;
+					nbufs = 1;
+				}
+				written = 0;
+				result = tcp_send_write(sock, reqs[i], rbufs,
+							nbufs);
+			}
+			if (result != ISC_R_SUCCESS) {
+				tcp_send_failed(sock, reqs[i], result, async);
+			}
+		}
+
+		for (i = 0; i < done; i++) {
+			isc__nm_sendcb(sock, reqs[i], ISC_R_SUCCESS, async);
+		}
+	}
+}
+
+static void
+tcp_send_flush(void *arg) {
+	isc_nmsocket_t *sock = arg;
+
+	tcp_flush_sendq(sock, false);
+	isc__nmsocket_detach(&sock);
+}
+
 static void
 tcp_close_sock(isc_nmsocket_t *sock) {
 	REQUIRE(VALID_NMSOCK(sock));
@@ -33,6 +33,7 @@
 #include <isc/region.h>
 #include <isc/result.h>
 #include <isc/sockaddr.h>
+#include <isc/stats.h>
 #include <isc/stdtime.h>
 #include <isc/thread.h>
 #include <isc/util.h>
@@ -348,14 +349,79 @@ async_tls_do_bio(isc_nmsocket_t *sock) {
 	isc_async_run(sock->worker->loop, tls_do_bio_cb, sock);
 }
 
+/*
+ * Rather than staging the encrypted data in a memory BIO and copying it
+ * out again for every send, OpenSSL writes the TLS records straight
+ * into the buffer of the send request that is going to carry them to
+ * the network.
+ */
+static BIO_METHOD *tls_outbio_method = NULL;
+static isc_once_t tls_outbio_once = ISC_ONCE_INIT;
+
+static int
+tls_outbio_write(BIO *bio, const char *data, int dlen) {
+	isc_nmsocket_t *sock = BIO_get_data(bio);
+	isc_nmsocket_tls_send_req_t *send_req = NULL;
+
+	REQUIRE(VALID_NMSOCK(sock));
+
+	BIO_clear_retry_flags(bio);
+	if (dlen <= 0) {
+		return (0);
+	}
+
+	/* Try to reuse previously allocated object */
+	send_req = sock->tlsstream.send_req;
+	if (send_req == NULL) {
+		send_req = isc_mem_get(sock->worker->mctx, sizeof(*send_req));
+		*send_req = (isc_nmsocket_tls_send_req_t){ 0 };
+		isc_buffer_init(&send_req->data, &send_req->smallbuf,
+				sizeof(send_req->smallbuf));
+		isc_buffer_setmctx(&send_req->data, sock->worker->mctx);
+		sock->tlsstream.send_req = send_req;
+	}
+
+	isc_buffer_putmem(&send_req->data, (const unsigned char *)data, dlen);
+
+	return (dlen);
+}
+
+static long
+tls_outbio_ctrl(BIO *bio, int cmd, long num, void *ptr) {
+	isc_nmsocket_t *sock = BIO_get_data(bio);
+
+	UNUSED(num);
+	UNUSED(ptr);
+
+	switch (cmd) {
+	case BIO_CTRL_FLUSH:
+		return (1);
+	case BIO_CTRL_WPENDING:
+		if (sock->tlsstream.send_req == NULL) {
+			return (0);
+		}
+		return (isc_buffer_remaininglength(
+			&sock->tlsstream.send_req->data));
+	default:
+		return (0);
+	}
+}
+
+static void
+tls_outbio_initialize(void) {
+	tls_outbio_method = BIO_meth_new(BIO_TYPE_SOURCE_SINK, "isc netmgr");
+	RUNTIME_CHECK(tls_outbio_method != NULL);
+	RUNTIME_CHECK(BIO_meth_set_write(tls_outbio_method,
+					 tls_outbio_write) == 1);
+	RUNTIME_CHECK(BIO_meth_set_ctrl(tls_outbio_method, tls_outbio_ctrl) ==
+		      1);
+}
+
 static int
 tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
 		  isc_nm_cb_t cb, void *cbarg) {
 	isc_nmsocket_tls_send_req_t *send_req = NULL;
 	int pending;
-	int rv;
-	size_t len = 0;
-	bool new_send_req = false;
 	isc_region_t used_region = { 0 };
 	bool shutting_down = isc__nm_closing(sock->worker);
 
@@ -374,28 +440,21 @@ tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
 		tls_keep_client_tls_session(sock);
 	}
 
-	pending = BIO_pending(sock->tlsstream.bio_out);
-	if (pending <= 0) {
-		return (pending);
+	/*
+	 * The encrypted data has already been written into the buffer of
+	 * the send request by tls_outbio_write().
+	 */
+	send_req = sock->tlsstream.send_req;
+	if (send_req == NULL) {
+		return (0);
 	}
-
-	/* Try to reuse previously allocated object */
-	if (sock->tlsstream.send_req != NULL) {
-		send_req = sock->tlsstream.send_req;
-		send_req->finish = finish;
-		sock->tlsstream.send_req = NULL;
-	} else {
-		send_req = isc_mem_get(sock->worker->mctx, sizeof(*send_req));
-		*send_req = (isc_nmsocket_tls_send_req_t){ .finish = finish };
-		new_send_req = true;
+	pending = isc_buffer_remaininglength(&send_req->data);
+	if (pending == 0) {
+		return (0);
 	}
 
-	if (new_send_req) {
-		isc_buffer_init(&send_req->data, &send_req->smallbuf,
-				sizeof(send_req->smallbuf));
-		isc_buffer_setmctx(&send_req->data, sock->worker->mctx);
-	}
-	INSIST(isc_buffer_remaininglength(&send_req->data) == 0);
+	sock->tlsstream.send_req = NULL;
+	send_req->finish = finish;
 
 	isc__nmsocket_attach(sock, &send_req->tlssock);
 	if (cb != NULL) {
@@ -404,14 +463,6 @@ tls_send_outgoing(isc_nmsocket_t *sock, bool finish, isc_nmhandle_t *tlshandle,
 		isc_nmhandle_attach(tlshandle, &send_req->handle);
 	}
 
-	RUNTIME_CHECK(isc_buffer_reserve(&send_req->data, pending) ==
-		      ISC_R_SUCCESS);
-	isc_buffer_add(&send_req->data, pending);
-	rv = BIO_read_ex(sock->tlsstream.bio_out,
-			 isc_buffer_base(&send_req->data), pending, &len);
-	/* There's something pending, read must succeed */
-	RUNTIME_CHECK(rv == 1 && len == (size_t)pending);
-
 	INSIST(VALID_NMHANDLE(sock->outerhandle));
 
 	sock->tlsstream.nsending++;
@@ -447,6 +498,20 @@ tls_process_outgoing(isc_nmsocket_t *sock, bool finish,
 	return (pending);
 }
 
+static void
+tls_update_handshake_stats(isc_nmsocket_t *sock) {
+	isc_stats_t *stats = sock->worker->netmgr->stats;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	isc_stats_increment(stats, isc_sockstatscounter_tlshandshake);
+	if (SSL_session_reused(sock->tlsstream.tls) == 1) {
+		isc_stats_increment(stats, isc_sockstatscounter_tlsresumed);
+	}
+}
+
 static int
 tls_try_handshake(isc_nmsocket_t *sock, isc_result_t *presult) {
 	REQUIRE(sock->tlsstream.state == TLS_HANDSHAKE);
@@ -472,6 +537,8 @@ tls_try_handshake(isc_nmsocket_t *sock, isc_result_t *presult) {
 		}
 
 		if (sock->tlsstream.server) {
+			tls_update_handshake_stats(sock);
+
 			/*
 			 * The listening sockets are now closed from outer
 			 * to inner order, which means that this function
@@ -844,22 +911,24 @@ static isc_result_t
 initialize_tls(isc_nmsocket_t *sock, bool server) {
 	REQUIRE(sock->tid == isc_tid());
 
+	isc_once_do(&tls_outbio_once, tls_outbio_initialize);
+
 	sock->tlsstream.bio_in = BIO_new(BIO_s_mem());
 	if (sock->tlsstream.bio_in == NULL) {
 		isc_tls_free(&sock->tlsstream.tls);
 		return (ISC_R_TLSERROR);
 	}
-	sock->tlsstream.bio_out = BIO_new(BIO_s_mem());
+	sock->tlsstream.bio_out = BIO_new(tls_outbio_method);
 	if (sock->tlsstream.bio_out == NULL) {
 		BIO_free_all(sock->tlsstream.bio_in);
 		sock->tlsstream.bio_in = NULL;
 		isc_tls_free(&sock->tlsstream.tls);
 		return (ISC_R_TLSERROR);
 	}
+	BIO_set_data(sock->tlsstream.bio_out, sock);
+	BIO_set_init(sock->tlsstream.bio_out, 1);
 
-	if (BIO_set_mem_eof_return(sock->tlsstream.bio_in, EOF) != 1 ||
-	    BIO_set_mem_eof_return(sock->tlsstream.bio_out, EOF) != 1)
-	{
+	if (BIO_set_mem_eof_return(sock->tlsstream.bio_in, EOF) != 1) {
 		goto error;
 	}
 
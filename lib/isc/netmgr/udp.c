@@ -11,6 +11,7 @@
  * information regarding copyright ownership.
  */
 
+#include <errno.h>
 #include <unistd.h>
 
 #include <isc/async.h>
@@ -19,6 +20,7 @@
 #include <isc/buffer.h>
 #include <isc/condition.h>
 #include <isc/errno.h>
+#include <isc/log.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
 #include <isc/netmgr.h>
@@ -89,6 +91,17 @@ isc__nm_udp_lb_socket(isc_nm_t *mgr, sa_family_t sa_family) {
 	return (sock);
 }
 
+static void
+udp_steer_cpu(isc_nmsocket_t *sock) {
+	isc_result_t result = isc__nm_socket_steer_cpu(
+		sock->fd, sock->parent->nchildren);
+	if (result != ISC_R_SUCCESS) {
+		isc__nmsocket_log(sock, ISC_LOG_WARNING,
+				  "unable to steer UDP packets by CPU: %s",
+				  isc_result_totext(result));
+	}
+}
+
 /*
  * Asynchronous 'udplisten' call handler: start listening on a UDP socket.
  */
@@ -143,6 +156,9 @@ start_udp_child_job(void *arg) {
 			isc__nm_incstats(sock, STATID_BINDFAIL);
 			goto done;
 		}
+		if (mgr->cpu_steering && sock->tid == 0) {
+			udp_steer_cpu(sock);
+		}
 	} else if (sock->tid == 0) {
 		/* This thread is first, bind the socket */
 		r = isc__nm_udp_freebind(&sock->uv_handle.udp,
@@ -641,21 +657,156 @@ udp_send_cb(uv_udp_send_t *req, int status) {
 	isc__nm_sendcb(sock, uvreq, result, false);
 }
 
+static void
+udp_send_direct(isc_nmsocket_t *sock, isc__nm_uvreq_t *uvreq) {
+	const struct sockaddr *sa = NULL;
+	isc_result_t result;
+	int r;
+
+	sa = sock->connected ? NULL : &uvreq->peer.type.sa;
+
+	r = uv_udp_send(&uvreq->uv_req.udp_send, &sock->uv_handle.udp,
+			&uvreq->uvbuf, 1, sa, udp_send_cb);
+	if (r < 0) {
+		isc__nm_incstats(sock, STATID_SENDFAIL);
+		result = isc_uverr2result(r);
+		isc__nm_failed_send_cb(sock, uvreq, result, true);
+	}
+}
+
+#if HAVE_SENDMMSG
+/*
+ * Flush the datagrams queued on the socket during the last event loop
+ * iteration.  Everything that sendmmsg(2) accepts is completed right away;
+ * whatever the kernel did not take (e.g. because the socket buffer is
+ * full) is handed over to libuv, which will queue it and retry when the
+ * socket becomes writable again.
+ */
+static void
+udp_send_flush(void *arg) {
+	isc_nmsocket_t *sock = arg;
+	isc__nm_uvreq_t *reqs[ISC_NETMGR_UDP_SENDMMSG_MAX];
+	struct mmsghdr msgs[ISC_NETMGR_UDP_SENDMMSG_MAX];
+	struct iovec iovs[ISC_NETMGR_UDP_SENDMMSG_MAX];
+	isc_result_t result = ISC_R_SUCCESS;
+	uv_os_fd_t fd = -1;
+	int r;
+
+	REQUIRE(VALID_NMSOCK(sock));
+	REQUIRE(sock->tid == isc_tid());
+
+	if (isc__nm_closing(sock->worker)) {
+		result = ISC_R_SHUTTINGDOWN;
+	} else if (isc__nmsocket_closing(sock)) {
+		result = ISC_R_CANCELED;
+	} else {
+		r = uv_fileno(&sock->uv_handle.handle, &fd);
+		if (r < 0) {
+			result = isc_uverr2result(r);
+		}
+	}
+
+	while (!ISC_LIST_EMPTY(sock->udp_sendq)) {
+		isc__nm_uvreq_t *uvreq = NULL;
+		unsigned int n = 0;
+		int sent;
+
+		while (n < ISC_NETMGR_UDP_SENDMMSG_MAX &&
+		       (uvreq = ISC_LIST_HEAD(sock->udp_sendq)) != NULL)
+		{
+			ISC_LIST_UNLINK(sock->udp_sendq, uvreq, link);
+
+			if (result != ISC_R_SUCCESS) {
+				isc__nm_failed_send_cb(sock, uvreq, result,
+						       false);
+				continue;
+			}
+
+			iovs[n] = (struct iovec){
+				.iov_base = uvreq->uvbuf.base,
+				.iov_len = uvreq->uvbuf.len,
+			};
+			msgs[n] = (struct mmsghdr){
+				.msg_hdr = {
+					.msg_iov = &iovs[n],
+					.msg_iovlen = 1,
+				},
+			};
+			if (!sock->connected) {
+				msgs[n].msg_hdr.msg_name =
+					&uvreq->peer.type.sa;
+				msgs[n].msg_hdr.msg_namelen =
+					uvreq->peer.length;
+			}
+			reqs[n++] = uvreq;
+		}
+
+		if (n == 0) {
+			break;
+		}
+
+		do {
+			sent = sendmmsg(fd, msgs, n, 0);
+		} while (sent < 0 && errno == EINTR);
+
+		if (sent < 0) {
+			switch (errno) {
+			case EAGAIN:
+#if defined(EWOULDBLOCK) && EWOULDBLOCK != EAGAIN
+			case EWOULDBLOCK:
+#endif
+			case ENOBUFS:
+				/* Let libuv queue and retry the lot */
+				sent = 0;
+				break;
+			default:
+				/*
+				 * sendmmsg(2) only reports an error when
+				 * the very first datagram could not be sent.
+				 */
+				isc__nm_incstats(sock, STATID_SENDFAIL);
+				isc__nm_failed_send_cb(
+					sock, reqs[0],
+					isc_errno_toresult(errno), false);
+				sent = 1;
+				reqs[0] = NULL;
+			}
+		}
+
+		for (unsigned int i = 0; i < n; i++) {
+			if (reqs[i] == NULL) {
+				continue;
+			}
+			if (i < (unsigned int)sent) {
+				isc__nm_sendcb(sock, reqs[i], ISC_R_SUCCESS,
+					       false);
+			} else {
+				udp_send_direct(sock, reqs[i]);
+			}
+		}
+	}
+
+	isc__nmsocket_detach(&sock);
+}
+#endif /* HAVE_SENDMMSG */
+
 /*
  * Send the data in 'region' to a peer via a UDP socket. We try to find
  * a proper sibling/child socket so that we won't have to jump to
  * another thread.
+ *
+ * On the listening sockets, the datagrams produced during a single event
+ * loop iteration are collected and later flushed with a single sendmmsg(2)
+ * call, unless libuv already has writes pending on the socket.
  */
 void
 isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		 isc_nm_cb_t cb, void *cbarg) {
 	isc_nmsocket_t *sock = handle->sock;
 	const isc_sockaddr_t *peer = &handle->peer;
-	const struct sockaddr *sa = NULL;
 	isc__nm_uvreq_t *uvreq = NULL;
 	isc__networker_t *worker = NULL;
 	uint32_t maxudp;
-	int r;
 	isc_result_t result;
 
 	REQUIRE(VALID_NMSOCK(sock));
@@ -664,7 +815,6 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 
 	worker = sock->worker;
 	maxudp = atomic_load(&worker->netmgr->maxudp);
-	sa = sock->connected ? NULL : &peer->type.sa;
 
 	/*
 	 * We're simulating a firewall blocking UDP packets bigger than
@@ -682,6 +832,7 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 	uvreq = isc__nm_uvreq_get(sock);
 	uvreq->uvbuf.base = (char *)region->base;
 	uvreq->uvbuf.len = region->length;
+	uvreq->peer = *peer;
 
 	isc_nmhandle_attach(handle, &uvreq->handle);
 
@@ -698,13 +849,21 @@ isc__nm_udp_send(isc_nmhandle_t *handle, const isc_region_t *region,
 		goto fail;
 	}
 
-	r = uv_udp_send(&uvreq->uv_req.udp_send, &sock->uv_handle.udp,
-			&uvreq->uvbuf, 1, sa, udp_send_cb);
-	if (r < 0) {
-		isc__nm_incstats(sock, STATID_SENDFAIL);
-		result = isc_uverr2result(r);
-		goto fail;
+#if HAVE_SENDMMSG
+	if (sock->parent != NULL &&
+	    uv_udp_get_send_queue_count(&sock->uv_handle.udp) == 0)
+	{
+		if (ISC_LIST_EMPTY(sock->udp_sendq)) {
+			isc__nmsocket_attach(sock, &(isc_nmsocket_t *){ NULL });
+			isc_job_run(worker->loop, &sock->udp_sendjob,
+				    udp_send_flush, sock);
+		}
+		ISC_LIST_APPEND(sock->udp_sendq, uvreq, link);
+		return;
 	}
+#endif /* HAVE_SENDMMSG */
+
+	udp_send_direct(sock, uvreq);
 	return;
 fail:
 	isc__nm_failed_send_cb(sock, uvreq, result, true);
@@ -924,6 +1083,23 @@ fail:
 	isc__nm_failed_read_cb(sock, result, true);
 }
 
+void
+isc__nm_udp_read_stop(isc_nmhandle_t *handle) {
+	REQUIRE(VALID_NMHANDLE(handle));
+	REQUIRE(VALID_NMSOCK(handle->sock));
+
+	isc_nmsocket_t *sock = handle->sock;
+
+	REQUIRE(sock->type == isc_nm_udpsocket);
+	REQUIRE(sock->client);
+	REQUIRE(sock->tid == isc_tid());
+
+	isc__nmsocket_timer_stop(sock);
+	isc__nm_stop_reading(sock);
+	isc__nmsocket_clearcb(sock);
+	sock->reading = false;
+}
+
 static void
 udp_close_cb(uv_handle_t *handle) {
 	isc_nmsocket_t *sock = uv_handle_get_data(handle);
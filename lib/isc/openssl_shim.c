@@ -125,6 +125,45 @@ BIO_write_ex(BIO *b, const void *data, size_t dlen, size_t *written) {
 }
 #endif
 
+#if !HAVE_BIO_METH_NEW
+BIO_METHOD *
+BIO_meth_new(int type, const char *name) {
+	BIO_METHOD *biom = OPENSSL_zalloc(sizeof(*biom));
+	if (biom != NULL) {
+		biom->type = type;
+		biom->name = name;
+	}
+	return (biom);
+}
+
+int
+BIO_meth_set_write(BIO_METHOD *biom, int (*write)(BIO *, const char *, int)) {
+	biom->bwrite = write;
+	return (1);
+}
+
+int
+BIO_meth_set_ctrl(BIO_METHOD *biom, long (*ctrl)(BIO *, int, long, void *)) {
+	biom->ctrl = ctrl;
+	return (1);
+}
+
+void *
+BIO_get_data(BIO *a) {
+	return (a->ptr);
+}
+
+void
+BIO_set_data(BIO *a, void *ptr) {
+	a->ptr = ptr;
+}
+
+void
+BIO_set_init(BIO *a, int init) {
+	a->init = init;
+}
+#endif /* !HAVE_BIO_METH_NEW */
+
 #if !HAVE_OPENSSL_INIT_CRYPTO
 int
 OPENSSL_init_crypto(uint64_t opts, const void *settings) {
@@ -86,6 +86,26 @@ int
 BIO_write_ex(BIO *b, const void *data, size_t dlen, size_t *written);
 #endif
 
+#if !HAVE_BIO_METH_NEW
+BIO_METHOD *
+BIO_meth_new(int type, const char *name);
+
+int
+BIO_meth_set_write(BIO_METHOD *biom, int (*write)(BIO *, const char *, int));
+
+int
+BIO_meth_set_ctrl(BIO_METHOD *biom, long (*ctrl)(BIO *, int, long, void *));
+
+void *
+BIO_get_data(BIO *a);
+
+void
+BIO_set_data(BIO *a, void *ptr);
+
+void
+BIO_set_init(BIO *a, int init);
+#endif /* !HAVE_BIO_METH_NEW */
+
 #if !HAVE_OPENSSL_INIT_CRYPTO
 
 #define OPENSSL_INIT_NO_LOAD_CRYPTO_STRINGS 0x00000001L
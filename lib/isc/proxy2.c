@@ -1053,6 +1053,99 @@ isc_proxy2_tlv_data_verify(const isc_region_t *restrict tlv_data) {
 	return (cbarg.verify_result);
 }
 
+/*
+ * Nearly every header a load balancer sends is a PROXY command for TCP
+ * or UDP over IPv4 or IPv6 without any TLVs. Those have a fixed shape,
+ * so they can be decoded without going through the state machine.
+ * Returns false if the header has any other shape, in which case it is
+ * left for the generic code to process.
+ */
+static inline bool
+proxy2_handle_fixed_header(const isc_region_t *restrict header_data,
+			   const isc_proxy2_handler_cb_t cb, void *cbarg) {
+	const uint8_t *p = header_data->base;
+	isc_sockaddr_t src_addr, dst_addr;
+	isc_region_t extra_data = { 0 };
+	size_t addr_size, header_size;
+	uint16_t len, src_port, dst_port;
+	int socktype;
+
+	if (header_data->length < ISC_PROXY2_HEADER_SIZE ||
+	    memcmp(p, ISC_PROXY2_HEADER_SIGNATURE,
+		   ISC_PROXY2_HEADER_SIGNATURE_SIZE) != 0)
+	{
+		return (false);
+	}
+	p += ISC_PROXY2_HEADER_SIGNATURE_SIZE;
+
+	/* version 2, PROXY command */
+	if (p[0] != 0x21) {
+		return (false);
+	}
+
+	switch (p[1] & 0xFU) {
+	case ISC_PROXY2_SOCK_STREAM:
+		socktype = SOCK_STREAM;
+		break;
+	case ISC_PROXY2_SOCK_DGRAM:
+		socktype = SOCK_DGRAM;
+		break;
+	default:
+		return (false);
+	}
+
+	switch ((p[1] & 0xF0U) >> 4) {
+	case ISC_PROXY2_AF_INET:
+		header_size = ISC_PROXY2_MIN_AF_INET_SIZE;
+		addr_size = sizeof(src_addr.type.sin.sin_addr.s_addr);
+		break;
+	case ISC_PROXY2_AF_INET6:
+		header_size = ISC_PROXY2_MIN_AF_INET6_SIZE;
+		addr_size = sizeof(src_addr.type.sin6.sin6_addr);
+		break;
+	default:
+		return (false);
+	}
+
+	len = (uint16_t)(p[2] << 8 | p[3]);
+	if (len != header_size - ISC_PROXY2_HEADER_SIZE ||
+	    header_data->length < header_size)
+	{
+		return (false);
+	}
+	p += 4;
+
+	src_port = (uint16_t)(p[2 * addr_size] << 8 | p[2 * addr_size + 1]);
+	dst_port = (uint16_t)(p[2 * addr_size + 2] << 8 |
+			      p[2 * addr_size + 3]);
+
+	if (addr_size == sizeof(src_addr.type.sin.sin_addr.s_addr)) {
+		struct in_addr src, dst;
+
+		memmove(&src, p, addr_size);
+		memmove(&dst, p + addr_size, addr_size);
+		isc_sockaddr_fromin(&src_addr, &src, src_port);
+		isc_sockaddr_fromin(&dst_addr, &dst, dst_port);
+	} else {
+		struct in6_addr src, dst;
+
+		memmove(&src, p, addr_size);
+		memmove(&dst, p + addr_size, addr_size);
+		isc_sockaddr_fromin6(&src_addr, &src, src_port);
+		isc_sockaddr_fromin6(&dst_addr, &dst, dst_port);
+	}
+
+	if (header_data->length > header_size) {
+		extra_data.base = header_data->base + header_size;
+		extra_data.length = header_data->length - header_size;
+	}
+
+	cb(ISC_R_SUCCESS, ISC_PROXY2_CMD_PROXY, socktype, &src_addr, &dst_addr,
+	   NULL, extra_data.length == 0 ? NULL : &extra_data, cbarg);
+
+	return (true);
+}
+
 isc_result_t
 isc_proxy2_header_handle_directly(const isc_region_t *restrict header_data,
 				  const isc_proxy2_handler_cb_t cb,
@@ -1063,6 +1156,10 @@ isc_proxy2_header_handle_directly(const isc_region_t *restrict header_data,
 	REQUIRE(header_data != NULL);
 	REQUIRE(cb != NULL);
 
+	if (proxy2_handle_fixed_header(header_data, cb, cbarg)) {
+		return (ISC_R_SUCCESS);
+	}
+
 	isc__proxy2_handler_init_direct(&handler, 0, header_data, cb, cbarg);
 
 	result = isc__proxy2_handler_process_data(&handler);
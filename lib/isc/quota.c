@@ -66,13 +66,21 @@ isc_quota_getused(isc_quota_t *quota) {
 
 void
 isc_quota_release(isc_quota_t *quota) {
+	struct cds_wfcq_node *node = NULL;
+
 	/*
+	 * The waiting queue is almost always empty, so peek at it
+	 * first without taking the internal dequeue mutex; otherwise
+	 * every release from every thread would serialize on it.
+	 *
 	 * We are using the cds_wfcq_dequeue_blocking() variant here that
 	 * has an internal mutex because we need synchronization on
 	 * multiple dequeues running from different threads.
 	 */
-	struct cds_wfcq_node *node =
-		cds_wfcq_dequeue_blocking(&quota->jobs.head, &quota->jobs.tail);
+	if (!cds_wfcq_empty(&quota->jobs.head, &quota->jobs.tail)) {
+		node = cds_wfcq_dequeue_blocking(&quota->jobs.head,
+						 &quota->jobs.tail);
+	}
 	if (node == NULL) {
 		uint_fast32_t used = atomic_fetch_sub_relaxed(&quota->used, 1);
 		INSIST(used > 0);
@@ -89,10 +97,23 @@ isc_quota_acquire_cb(isc_quota_t *quota, isc_job_t *job, isc_job_cb cb,
 	REQUIRE(VALID_QUOTA(quota));
 	REQUIRE(job == NULL || cb != NULL);
 
-	uint_fast32_t used = atomic_fetch_add_relaxed(&quota->used, 1);
 	uint_fast32_t max = atomic_load_relaxed(&quota->max);
+
+	/*
+	 * When the quota is exhausted (e.g. a TCP connection flood),
+	 * check with a plain load first, so that rejected callers on
+	 * all threads only share the cache line instead of bouncing it
+	 * with an increment and a decrement each.
+	 */
+	uint_fast32_t used = atomic_load_relaxed(&quota->used);
+	if (max == 0 || used < max) {
+		used = atomic_fetch_add_relaxed(&quota->used, 1);
+		if (max != 0 && used >= max) {
+			(void)atomic_fetch_sub_relaxed(&quota->used, 1);
+		}
+	}
+
 	if (max != 0 && used >= max) {
-		(void)atomic_fetch_sub_relaxed(&quota->used, 1);
 		if (job != NULL) {
 			job->cb = cb;
 			job->cbarg = cbarg;
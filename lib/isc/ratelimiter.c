@@ -221,6 +221,7 @@ isc__ratelimiter_tick(void *arg) {
 	isc_rlevent_t *rle = NULL;
 	uint32_t pertic;
 	ISC_LIST(isc_rlevent_t) pending;
+	isc_asyncbatch_t batch;
 
 	REQUIRE(VALID_RATELIMITER(rl));
 
@@ -263,10 +264,12 @@ isc__ratelimiter_tick(void *arg) {
 unlock:
 	UNLOCK(&rl->lock);
 
+	isc_async_batchinit(&batch);
 	while ((rle = ISC_LIST_HEAD(pending)) != NULL) {
 		ISC_LIST_UNLINK(pending, rle, link);
-		isc_async_run(rle->loop, rle->cb, rle->arg);
+		isc_async_batchadd(&batch, rle->loop, rle->cb, rle->arg);
 	}
+	isc_async_batchrun(&batch);
 }
 
 void
@@ -290,6 +293,7 @@ void
 isc_ratelimiter_shutdown(isc_ratelimiter_t *restrict rl) {
 	isc_rlevent_t *rle = NULL;
 	ISC_LIST(isc_rlevent_t) pending;
+	isc_asyncbatch_t batch;
 
 	REQUIRE(VALID_RATELIMITER(rl));
 
@@ -304,11 +308,13 @@ isc_ratelimiter_shutdown(isc_ratelimiter_t *restrict rl) {
 	}
 	UNLOCK(&rl->lock);
 
+	isc_async_batchinit(&batch);
 	while ((rle = ISC_LIST_HEAD(pending)) != NULL) {
 		ISC_LIST_UNLINK(pending, rle, link);
 		rle->canceled = true;
-		isc_async_run(rl->loop, rle->cb, rle->arg);
+		isc_async_batchadd(&batch, rl->loop, rle->cb, rle->arg);
 	}
+	isc_async_batchrun(&batch);
 }
 
 static void
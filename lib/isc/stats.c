@@ -20,8 +20,10 @@
 #include <isc/buffer.h>
 #include <isc/magic.h>
 #include <isc/mem.h>
+#include <isc/os.h>
 #include <isc/refcount.h>
 #include <isc/stats.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #define ISC_STATS_MAGIC	   ISC_MAGIC('S', 't', 'a', 't')
@@ -43,8 +45,81 @@ struct isc_stats {
 	isc_refcount_t references;
 	int ncounters;
 	isc_atomic_statscounter_t *counters;
+
+	/*
+	 * Optional per-thread counters (see isc_stats_create_pertid()).
+	 * Each thread owns a row of 'stride' counters starting on its own
+	 * cache line and is the only writer of the row, so the updates
+	 * need no atomic read-modify-write operations.  The value of a
+	 * counter is the sum of the shared counter and of all the rows.
+	 */
+	uint32_t ntids;
+	size_t stride;
+	void *pertid_mem;
+	size_t pertid_size;
+	isc_atomic_statscounter_t *pertid;
 };
 
+#define COUNTERS_PER_LINE \
+	(ISC_OS_CACHELINE_SIZE / sizeof(isc_atomic_statscounter_t))
+
+static void
+pertid_create(isc_stats_t *stats) {
+	size_t ncounters;
+
+	stats->stride = ISC_ALIGN((size_t)stats->ncounters, COUNTERS_PER_LINE);
+	ncounters = stats->stride * stats->ntids;
+	stats->pertid_size = ncounters * sizeof(isc_atomic_statscounter_t) +
+			     ISC_OS_CACHELINE_SIZE;
+	stats->pertid_mem = isc_mem_get(stats->mctx, stats->pertid_size);
+	stats->pertid = (isc_atomic_statscounter_t *)ISC_ALIGN(
+		(uintptr_t)stats->pertid_mem, ISC_OS_CACHELINE_SIZE);
+	for (size_t i = 0; i < ncounters; i++) {
+		atomic_init(&stats->pertid[i], 0);
+	}
+}
+
+static void
+pertid_destroy(isc_stats_t *stats) {
+	if (stats->pertid_mem != NULL) {
+		isc_mem_put(stats->mctx, stats->pertid_mem,
+			    stats->pertid_size);
+		stats->pertid_mem = NULL;
+		stats->pertid = NULL;
+	}
+}
+
+/*%
+ * Return the counter owned by the current thread, or NULL when the
+ * shared counter has to be used.
+ */
+static isc_atomic_statscounter_t *
+pertid_counter(isc_stats_t *stats, isc_statscounter_t counter) {
+	uint32_t tid = isc_tid();
+
+	if (stats->pertid == NULL || tid >= stats->ntids) {
+		return (NULL);
+	}
+
+	return (&stats->pertid[tid * stats->stride + counter]);
+}
+
+static isc_statscounter_t
+pertid_sum(isc_stats_t *stats, isc_statscounter_t counter) {
+	isc_statscounter_t sum = 0;
+
+	if (stats->pertid == NULL) {
+		return (0);
+	}
+
+	for (uint32_t tid = 0; tid < stats->ntids; tid++) {
+		sum += atomic_load_relaxed(
+			&stats->pertid[tid * stats->stride + counter]);
+	}
+
+	return (sum);
+}
+
 void
 isc_stats_attach(isc_stats_t *stats, isc_stats_t **statsp) {
 	REQUIRE(ISC_STATS_VALID(stats));
@@ -65,6 +140,7 @@ isc_stats_detach(isc_stats_t **statsp) {
 
 	if (isc_refcount_decrement(&stats->references) == 1) {
 		isc_refcount_destroy(&stats->references);
+		pertid_destroy(stats);
 		isc_mem_cput(stats->mctx, stats->counters, stats->ncounters,
 			     sizeof(isc_atomic_statscounter_t));
 		isc_mem_putanddetach(&stats->mctx, stats, sizeof(*stats));
@@ -85,23 +161,45 @@ isc_stats_create(isc_mem_t *mctx, isc_stats_t **statsp, int ncounters) {
 	isc_stats_t *stats = isc_mem_get(mctx, sizeof(*stats));
 	size_t counters_alloc_size = sizeof(isc_atomic_statscounter_t) *
 				     ncounters;
+	*stats = (isc_stats_t){
+		.ncounters = ncounters,
+	};
 	stats->counters = isc_mem_get(mctx, counters_alloc_size);
 	isc_refcount_init(&stats->references, 1);
 	for (int i = 0; i < ncounters; i++) {
 		atomic_init(&stats->counters[i], 0);
 	}
-	stats->mctx = NULL;
 	isc_mem_attach(mctx, &stats->mctx);
-	stats->ncounters = ncounters;
 	stats->magic = ISC_STATS_MAGIC;
 	*statsp = stats;
 }
 
+void
+isc_stats_create_pertid(isc_mem_t *mctx, isc_stats_t **statsp,
+			int ncounters) {
+	isc_stats_t *stats = NULL;
+
+	isc_stats_create(mctx, &stats, ncounters);
+
+	stats->ntids = isc_tid_count();
+	if (stats->ntids > 0) {
+		pertid_create(stats);
+	}
+
+	*statsp = stats;
+}
+
 void
 isc_stats_increment(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+	isc_atomic_statscounter_t *local = pertid_counter(stats, counter);
+	if (local != NULL) {
+		atomic_store_relaxed(local, atomic_load_relaxed(local) + 1);
+		return;
+	}
+
 	atomic_fetch_add_relaxed(&stats->counters[counter], 1);
 }
 
@@ -109,8 +207,25 @@ void
 isc_stats_decrement(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
+
+	/*
+	 * A gauge might be incremented on one thread and decremented on
+	 * another, so the per-thread counters can go negative; only their
+	 * sum is meaningful.
+	 */
+	isc_atomic_statscounter_t *local = pertid_counter(stats, counter);
+	if (local != NULL) {
+#if ISC_STATS_CHECKUNDERFLOW
+		REQUIRE(isc_stats_get_counter(stats, counter) > 0);
+#endif
+		atomic_store_relaxed(local, atomic_load_relaxed(local) - 1);
+		return;
+	}
+
 #if ISC_STATS_CHECKUNDERFLOW
-	REQUIRE(atomic_fetch_sub_release(&stats->counters[counter], 1) > 0);
+	REQUIRE(atomic_fetch_sub_release(&stats->counters[counter], 1) +
+			pertid_sum(stats, counter) >
+		0);
 #else
 	atomic_fetch_sub_release(&stats->counters[counter], 1);
 #endif
@@ -124,8 +239,7 @@ isc_stats_dump(isc_stats_t *stats, isc_stats_dumper_t dump_fn, void *arg,
 	REQUIRE(ISC_STATS_VALID(stats));
 
 	for (i = 0; i < stats->ncounters; i++) {
-		isc_statscounter_t counter =
-			atomic_load_acquire(&stats->counters[i]);
+		isc_statscounter_t counter = isc_stats_get_counter(stats, i);
 		if ((options & ISC_STATSDUMP_VERBOSE) == 0 && counter == 0) {
 			continue;
 		}
@@ -138,7 +252,13 @@ isc_stats_set(isc_stats_t *stats, uint64_t val, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	atomic_store_release(&stats->counters[counter], val);
+	/*
+	 * The per-thread counters aren't reset here, so the shared counter
+	 * is set to the difference; this is not atomic with respect to the
+	 * concurrent updates from the other threads.
+	 */
+	atomic_store_release(&stats->counters[counter],
+			     val - pertid_sum(stats, counter));
 }
 
 void
@@ -147,14 +267,15 @@ isc_stats_update_if_greater(isc_stats_t *stats, isc_statscounter_t counter,
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
+	isc_statscounter_t local = pertid_sum(stats, counter);
 	isc_statscounter_t curr_value =
 		atomic_load_acquire(&stats->counters[counter]);
 	do {
-		if (curr_value >= value) {
+		if (curr_value + local >= value) {
 			break;
 		}
 	} while (!atomic_compare_exchange_weak_acq_rel(
-		&stats->counters[counter], &curr_value, value));
+		&stats->counters[counter], &curr_value, value - local));
 }
 
 isc_statscounter_t
@@ -162,7 +283,8 @@ isc_stats_get_counter(isc_stats_t *stats, isc_statscounter_t counter) {
 	REQUIRE(ISC_STATS_VALID(stats));
 	REQUIRE(counter < stats->ncounters);
 
-	return (atomic_load_acquire(&stats->counters[counter]));
+	return (atomic_load_acquire(&stats->counters[counter]) +
+		pertid_sum(stats, counter));
 }
 
 void
@@ -188,11 +310,17 @@ isc_stats_resize(isc_stats_t **statsp, int ncounters) {
 		atomic_init(&newcounters[i], 0);
 	}
 	for (int i = 0; i < stats->ncounters; i++) {
-		uint32_t counter = atomic_load_acquire(&stats->counters[i]);
+		isc_statscounter_t counter = isc_stats_get_counter(stats, i);
 		atomic_store_release(&newcounters[i], counter);
 	}
 	isc_mem_cput(stats->mctx, stats->counters, stats->ncounters,
 		     sizeof(isc_atomic_statscounter_t));
 	stats->counters = newcounters;
 	stats->ncounters = ncounters;
+
+	/* The old per-thread counters were folded into the shared ones */
+	if (stats->pertid != NULL) {
+		pertid_destroy(stats);
+		pertid_create(stats);
+	}
 }
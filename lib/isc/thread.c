@@ -17,10 +17,10 @@
 #include <sched.h>
 #endif /* if defined(HAVE_SCHED_H) */
 
-#if defined(HAVE_CPUSET_H)
-#include <sys/cpuset.h>
+#if defined(HAVE_SYS_CPUSET_H)
 #include <sys/param.h>
-#endif /* if defined(HAVE_CPUSET_H) */
+#include <sys/cpuset.h>
+#endif /* if defined(HAVE_SYS_CPUSET_H) */
 
 #if defined(HAVE_SYS_PROCSET_H)
 #include <sys/processor.h>
@@ -28,9 +28,11 @@
 #include <sys/types.h>
 #endif /* if defined(HAVE_SYS_PROCSET_H) */
 
+#include <errno.h>
 #include <stdlib.h>
 
 #include <isc/atomic.h>
+#include <isc/errno.h>
 #include <isc/iterated_hash.h>
 #include <isc/strerr.h>
 #include <isc/thread.h>
@@ -169,6 +171,60 @@ isc_thread_setname(isc_thread_t thread, const char *name) {
 #endif /* if defined(HAVE_PTHREAD_SETNAME_NP) && !defined(__APPLE__) */
 }
 
+isc_result_t
+isc_thread_setaffinity(int cpu) {
+	REQUIRE(cpu >= 0);
+
+#if defined(HAVE_CPUSET_SETAFFINITY)
+	cpuset_t cpuset;
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	if (cpuset_setaffinity(CPU_LEVEL_WHICH, CPU_WHICH_TID, -1,
+			       sizeof(cpuset), &cpuset) != 0)
+	{
+		return (isc_errno_toresult(errno));
+	}
+	return (ISC_R_SUCCESS);
+#elif defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(__NetBSD__)
+	cpuset_t *cpuset = cpuset_create();
+	int ret;
+
+	if (cpuset == NULL) {
+		return (ISC_R_NOMEMORY);
+	}
+	cpuset_set(cpu, cpuset);
+	ret = pthread_setaffinity_np(pthread_self(), cpuset_size(cpuset),
+				     cpuset);
+	cpuset_destroy(cpuset);
+	if (ret != 0) {
+		return (isc_errno_toresult(ret));
+	}
+	return (ISC_R_SUCCESS);
+#elif defined(HAVE_PTHREAD_SETAFFINITY_NP) && defined(CPU_SETSIZE)
+	cpu_set_t cpuset;
+	int ret;
+
+	if (cpu >= CPU_SETSIZE) {
+		return (ISC_R_RANGE);
+	}
+	CPU_ZERO(&cpuset);
+	CPU_SET(cpu, &cpuset);
+	ret = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+	if (ret != 0) {
+		return (isc_errno_toresult(ret));
+	}
+	return (ISC_R_SUCCESS);
+#elif defined(HAVE_PROCESSOR_BIND)
+	if (processor_bind(P_LWPID, P_MYID, cpu, NULL) != 0) {
+		return (isc_errno_toresult(errno));
+	}
+	return (ISC_R_SUCCESS);
+#else
+	UNUSED(cpu);
+	return (ISC_R_NOTIMPLEMENTED);
+#endif
+}
+
 void
 isc_thread_yield(void) {
 #if defined(HAVE_SCHED_YIELD)
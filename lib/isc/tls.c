@@ -27,16 +27,23 @@
 #include <openssl/dh.h>
 #include <openssl/err.h>
 #include <openssl/evp.h>
+#include <openssl/hmac.h>
 #include <openssl/opensslv.h>
 #include <openssl/rand.h>
 #include <openssl/rsa.h>
 #include <openssl/x509_vfy.h>
 #include <openssl/x509v3.h>
+#if !defined(LIBRESSL_VERSION_NUMBER) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+#include <openssl/core_names.h>
+#endif
 
 #include <isc/atomic.h>
-#include <isc/ht.h>
+#include <isc/hash.h>
+#include <isc/hashmap.h>
+#include <isc/hmac.h>
 #include <isc/log.h>
 #include <isc/magic.h>
+#include <isc/md.h>
 #include <isc/mem.h>
 #include <isc/mutex.h>
 #include <isc/mutexblock.h>
@@ -44,7 +51,9 @@
 #include <isc/random.h>
 #include <isc/refcount.h>
 #include <isc/rwlock.h>
+#include <isc/safe.h>
 #include <isc/sockaddr.h>
+#include <isc/stdtime.h>
 #include <isc/thread.h>
 #include <isc/tls.h>
 #include <isc/util.h>
@@ -56,6 +65,12 @@
 
 static isc_mem_t *isc__tls_mctx = NULL;
 
+static int ticketkeys_index = -1;
+
+static void
+ticketkeys_ex_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx,
+		   long argl, void *argp);
+
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
 static isc_mutex_t *locks = NULL;
 static int nlocks;
@@ -204,6 +219,10 @@ isc__tls_initialize(void) {
 			    "cannot be initialized (see the `PRNG not "
 			    "seeded' message in the OpenSSL FAQ)");
 	}
+
+	ticketkeys_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL,
+						    ticketkeys_ex_free);
+	RUNTIME_CHECK(ticketkeys_index >= 0);
 }
 
 void
@@ -1195,6 +1214,7 @@ isc_tls_cert_store_free(isc_tls_cert_store_t **pstore) {
 	ISC_MAGIC_VALID(t, TLSCTX_CLIENT_SESSION_CACHE_MAGIC)
 
 typedef struct isc_tlsctx_cache_entry {
+	char *name;
 	/*
 	 * We need a TLS context entry for each transport on both IPv4 and
 	 * IPv6 in order to avoid cluttering a context-specific
@@ -1216,9 +1236,16 @@ struct isc_tlsctx_cache {
 	isc_mem_t *mctx;
 
 	isc_rwlock_t rwlock;
-	isc_ht_t *data;
+	isc_hashmap_t *data;
 };
 
+static bool
+tlsctx_cache_entry_match(void *node, const void *key) {
+	isc_tlsctx_cache_entry_t *entry = node;
+
+	return (strcmp(entry->name, key) == 0);
+}
+
 void
 isc_tlsctx_cache_create(isc_mem_t *mctx, isc_tlsctx_cache_t **cachep) {
 	isc_tlsctx_cache_t *nc;
@@ -1230,7 +1257,7 @@ isc_tlsctx_cache_create(isc_mem_t *mctx, isc_tlsctx_cache_t **cachep) {
 	isc_refcount_init(&nc->references, 1);
 	isc_mem_attach(mctx, &nc->mctx);
 
-	isc_ht_init(&nc->data, mctx, 5, ISC_HT_CASE_SENSITIVE);
+	isc_hashmap_create(mctx, 5, &nc->data);
 	isc_rwlock_init(&nc->rwlock);
 
 	*cachep = nc;
@@ -1266,29 +1293,29 @@ tlsctx_cache_entry_destroy(isc_mem_t *mctx, isc_tlsctx_cache_entry_t *entry) {
 	if (entry->ca_store != NULL) {
 		isc_tls_cert_store_free(&entry->ca_store);
 	}
+	isc_mem_free(mctx, entry->name);
 	isc_mem_put(mctx, entry, sizeof(*entry));
 }
 
 static void
 tlsctx_cache_destroy(isc_tlsctx_cache_t *cache) {
-	isc_ht_iter_t *it = NULL;
+	isc_hashmap_iter_t *it = NULL;
 	isc_result_t result;
 
 	cache->magic = 0;
 
 	isc_refcount_destroy(&cache->references);
 
-	isc_ht_iter_create(cache->data, &it);
-	for (result = isc_ht_iter_first(it); result == ISC_R_SUCCESS;
-	     result = isc_ht_iter_delcurrent_next(it))
-	{
+	isc_hashmap_iter_create(cache->data, &it);
+	for (result = isc_hashmap_iter_first(it); result == ISC_R_SUCCESS;) {
 		isc_tlsctx_cache_entry_t *entry = NULL;
-		isc_ht_iter_current(it, (void **)&entry);
+		isc_hashmap_iter_current(it, (void **)&entry);
+		result = isc_hashmap_iter_delcurrent_next(it);
 		tlsctx_cache_entry_destroy(cache->mctx, entry);
 	}
 
-	isc_ht_iter_destroy(&it);
-	isc_ht_destroy(&cache->data);
+	isc_hashmap_iter_destroy(&it);
+	isc_hashmap_destroy(&cache->data);
 	isc_rwlock_destroy(&cache->rwlock);
 	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
 }
@@ -1318,7 +1345,8 @@ isc_tlsctx_cache_add(
 	isc_tlsctx_t **pfound, isc_tls_cert_store_t **pfound_store,
 	isc_tlsctx_client_session_cache_t **pfound_client_sess_cache) {
 	isc_result_t result = ISC_R_FAILURE;
-	size_t name_len, tr_offset;
+	size_t tr_offset;
+	uint32_t hashval;
 	isc_tlsctx_cache_entry_t *entry = NULL;
 	bool ipv6;
 
@@ -1336,9 +1364,10 @@ isc_tlsctx_cache_add(
 
 	RWLOCK(&cache->rwlock, isc_rwlocktype_write);
 
-	name_len = strlen(name);
-	result = isc_ht_find(cache->data, (const uint8_t *)name, name_len,
-			     (void **)&entry);
+	hashval = isc_hash32(name, strlen(name), true);
+	result = isc_hashmap_find(cache->data, hashval,
+				  tlsctx_cache_entry_match, name,
+				  (void **)&entry);
 	if (result == ISC_R_SUCCESS && entry->ctx[tr_offset][ipv6] != NULL) {
 		isc_tlsctx_client_session_cache_t *found_client_sess_cache;
 		/* The entry exists. */
@@ -1386,14 +1415,16 @@ isc_tlsctx_cache_add(
 		INSIST(result != ISC_R_SUCCESS);
 		entry = isc_mem_get(cache->mctx, sizeof(*entry));
 		*entry = (isc_tlsctx_cache_entry_t){
+			.name = isc_mem_strdup(cache->mctx, name),
 			.ca_store = store,
 		};
 
 		entry->ctx[tr_offset][ipv6] = ctx;
 		entry->client_sess_cache[tr_offset][ipv6] = client_sess_cache;
-		RUNTIME_CHECK(isc_ht_add(cache->data, (const uint8_t *)name,
-					 name_len,
-					 (void *)entry) == ISC_R_SUCCESS);
+		RUNTIME_CHECK(isc_hashmap_add(cache->data, hashval,
+					      tlsctx_cache_entry_match,
+					      entry->name, entry,
+					      NULL) == ISC_R_SUCCESS);
 		result = ISC_R_SUCCESS;
 	}
 
@@ -1425,8 +1456,10 @@ isc_tlsctx_cache_find(
 
 	RWLOCK(&cache->rwlock, isc_rwlocktype_read);
 
-	result = isc_ht_find(cache->data, (const uint8_t *)name, strlen(name),
-			     (void **)&entry);
+	result = isc_hashmap_find(cache->data,
+				  isc_hash32(name, strlen(name), true),
+				  tlsctx_cache_entry_match, name,
+				  (void **)&entry);
 
 	if (result == ISC_R_SUCCESS && pstore != NULL &&
 	    entry->ca_store != NULL)
@@ -1475,6 +1508,18 @@ struct client_session_cache_entry {
 	ISC_LINK(client_session_cache_entry_t) cache_link;
 };
 
+static uint32_t
+bucket_hash(const char *key, size_t len) {
+	return (isc_hash32(key, len, true));
+}
+
+static bool
+client_cache_bucket_match(void *node, const void *key) {
+	client_session_cache_bucket_t *bucket = node;
+
+	return (strcmp(bucket->bucket_key, key) == 0);
+}
+
 struct isc_tlsctx_client_session_cache {
 	uint32_t magic;
 	isc_refcount_t references;
@@ -1494,7 +1539,7 @@ struct isc_tlsctx_client_session_cache {
 	 * might want to establish multiple TLS connections to the remote
 	 * server at once.
 	 */
-	isc_ht_t *buckets;
+	isc_hashmap_t *buckets;
 
 	/*
 	 * The list of all current entries within the cache maintained in
@@ -1527,7 +1572,7 @@ isc_tlsctx_client_session_cache_create(
 	isc_mem_attach(mctx, &nc->mctx);
 	isc_tlsctx_attach(ctx, &nc->ctx);
 
-	isc_ht_init(&nc->buckets, mctx, 5, ISC_HT_CASE_SENSITIVE);
+	isc_hashmap_create(mctx, 5, &nc->buckets);
 	ISC_LIST_INIT(nc->lru_entries);
 	isc_mutex_init(&nc->lock);
 
@@ -1562,9 +1607,11 @@ client_cache_entry_delete(isc_tlsctx_client_session_cache_t *restrict cache,
 
 	/* The bucket is empty - let's remove it */
 	if (ISC_LIST_EMPTY(bucket->entries)) {
-		RUNTIME_CHECK(isc_ht_delete(cache->buckets,
-					    (const uint8_t *)bucket->bucket_key,
-					    bucket->bucket_key_len) ==
+		uint32_t hashval = bucket_hash(bucket->bucket_key,
+					       bucket->bucket_key_len);
+		RUNTIME_CHECK(isc_hashmap_delete(cache->buckets, hashval,
+						 client_cache_bucket_match,
+						 bucket->bucket_key) ==
 			      ISC_R_SUCCESS);
 
 		isc_mem_free(cache->mctx, bucket->bucket_key);
@@ -1600,8 +1647,8 @@ isc_tlsctx_client_session_cache_detach(
 		entry = next;
 	}
 
-	RUNTIME_CHECK(isc_ht_count(cache->buckets) == 0);
-	isc_ht_destroy(&cache->buckets);
+	RUNTIME_CHECK(isc_hashmap_count(cache->buckets) == 0);
+	isc_hashmap_destroy(&cache->buckets);
 
 	isc_mutex_destroy(&cache->lock);
 	isc_tlsctx_free(&cache->ctx);
@@ -1639,6 +1686,7 @@ void
 isc_tlsctx_client_session_cache_keep(isc_tlsctx_client_session_cache_t *cache,
 				     char *remote_peer_name, isc_tls_t *tls) {
 	size_t name_len;
+	uint32_t hashval;
 	isc_result_t result;
 	SSL_SESSION *sess;
 	client_session_cache_bucket_t *restrict bucket = NULL;
@@ -1660,8 +1708,10 @@ isc_tlsctx_client_session_cache_keep(isc_tlsctx_client_session_cache_t *cache,
 	isc_mutex_lock(&cache->lock);
 
 	name_len = strlen(remote_peer_name);
-	result = isc_ht_find(cache->buckets, (const uint8_t *)remote_peer_name,
-			     name_len, (void **)&bucket);
+	hashval = bucket_hash(remote_peer_name, name_len);
+	result = isc_hashmap_find(cache->buckets, hashval,
+				  client_cache_bucket_match, remote_peer_name,
+				  (void **)&bucket);
 
 	if (result != ISC_R_SUCCESS) {
 		/* Let's create a new bucket */
@@ -1673,10 +1723,10 @@ isc_tlsctx_client_session_cache_keep(isc_tlsctx_client_session_cache_t *cache,
 			.bucket_key_len = name_len
 		};
 		ISC_LIST_INIT(bucket->entries);
-		RUNTIME_CHECK(isc_ht_add(cache->buckets,
-					 (const uint8_t *)remote_peer_name,
-					 name_len,
-					 (void *)bucket) == ISC_R_SUCCESS);
+		RUNTIME_CHECK(isc_hashmap_add(cache->buckets, hashval,
+					      client_cache_bucket_match,
+					      bucket->bucket_key, bucket,
+					      NULL) == ISC_R_SUCCESS);
 	}
 
 	/* Let's add a new cache entry to the new/found bucket */
@@ -1722,8 +1772,10 @@ isc_tlsctx_client_session_cache_reuse(isc_tlsctx_client_session_cache_t *cache,
 
 	/* Let's find the bucket */
 	name_len = strlen(remote_peer_name);
-	result = isc_ht_find(cache->buckets, (const uint8_t *)remote_peer_name,
-			     name_len, (void **)&bucket);
+	result = isc_hashmap_find(cache->buckets,
+				  bucket_hash(remote_peer_name, name_len),
+				  client_cache_bucket_match, remote_peer_name,
+				  (void **)&bucket);
 
 	if (result != ISC_R_SUCCESS) {
 		goto exit;
@@ -1790,3 +1842,303 @@ isc_tlsctx_set_random_session_id_context(isc_tlsctx_t *ctx) {
 	RUNTIME_CHECK(
 		SSL_CTX_set_session_id_context(ctx, session_id_ctx, len) == 1);
 }
+
+#define TLSCTX_TICKETKEYS_MAGIC	   ISC_MAGIC('T', 'l', 'T', 'k')
+#define VALID_TLSCTX_TICKETKEYS(t) ISC_MAGIC_VALID(t, TLSCTX_TICKETKEYS_MAGIC)
+
+/*
+ * The key currently used to issue tickets, and the ones it replaced.
+ * Tickets issued with a previous key are still accepted, but get
+ * replaced with a fresh one.
+ */
+#define TICKETKEYS_COUNT 3
+
+typedef struct ticketkey {
+	unsigned char name[16];
+	unsigned char aeskey[32];
+	unsigned char hmackey[32];
+	isc_stdtime_t created;
+} ticketkey_t;
+
+struct isc_tlsctx_ticketkeys {
+	uint32_t magic;
+	isc_refcount_t references;
+	isc_mem_t *mctx;
+
+	isc_rwlock_t rwlock;
+	atomic_uint_fast32_t lifetime;
+	unsigned char secret[32];
+	size_t current;
+	ticketkey_t keys[TICKETKEYS_COUNT];
+};
+
+static void
+ticketkey_generate(ticketkey_t *key, isc_stdtime_t now) {
+	RUNTIME_CHECK(RAND_bytes(key->name, sizeof(key->name)) == 1);
+	RUNTIME_CHECK(RAND_bytes(key->aeskey, sizeof(key->aeskey)) == 1);
+	RUNTIME_CHECK(RAND_bytes(key->hmackey, sizeof(key->hmackey)) == 1);
+	key->created = now;
+}
+
+void
+isc_tlsctx_ticketkeys_create(isc_mem_t *mctx, uint32_t lifetime,
+			     isc_tlsctx_ticketkeys_t **keysp) {
+	isc_tlsctx_ticketkeys_t *keys = NULL;
+	isc_stdtime_t now = isc_stdtime_now();
+
+	REQUIRE(keysp != NULL && *keysp == NULL);
+	REQUIRE(lifetime > 0);
+
+	keys = isc_mem_get(mctx, sizeof(*keys));
+	*keys = (isc_tlsctx_ticketkeys_t){
+		.magic = TLSCTX_TICKETKEYS_MAGIC,
+		.lifetime = lifetime,
+	};
+	isc_refcount_init(&keys->references, 1);
+	isc_mem_attach(mctx, &keys->mctx);
+	isc_rwlock_init(&keys->rwlock);
+
+	RUNTIME_CHECK(RAND_bytes(keys->secret, sizeof(keys->secret)) == 1);
+	ticketkey_generate(&keys->keys[keys->current], now);
+
+	*keysp = keys;
+}
+
+void
+isc_tlsctx_ticketkeys_attach(isc_tlsctx_ticketkeys_t *source,
+			     isc_tlsctx_ticketkeys_t **targetp) {
+	REQUIRE(VALID_TLSCTX_TICKETKEYS(source));
+	REQUIRE(targetp != NULL && *targetp == NULL);
+
+	isc_refcount_increment(&source->references);
+
+	*targetp = source;
+}
+
+void
+isc_tlsctx_ticketkeys_detach(isc_tlsctx_ticketkeys_t **keysp) {
+	isc_tlsctx_ticketkeys_t *keys = NULL;
+
+	REQUIRE(keysp != NULL && VALID_TLSCTX_TICKETKEYS(*keysp));
+
+	keys = *keysp;
+	*keysp = NULL;
+
+	if (isc_refcount_decrement(&keys->references) == 1) {
+		isc_refcount_destroy(&keys->references);
+		keys->magic = 0;
+		isc_rwlock_destroy(&keys->rwlock);
+		isc_safe_memwipe(keys->keys, sizeof(keys->keys));
+		isc_safe_memwipe(keys->secret, sizeof(keys->secret));
+		isc_mem_putanddetach(&keys->mctx, keys, sizeof(*keys));
+	}
+}
+
+void
+isc_tlsctx_ticketkeys_setlifetime(isc_tlsctx_ticketkeys_t *keys,
+				  uint32_t lifetime) {
+	REQUIRE(VALID_TLSCTX_TICKETKEYS(keys));
+	REQUIRE(lifetime > 0);
+
+	atomic_store_relaxed(&keys->lifetime, lifetime);
+}
+
+/*
+ * Return the key to issue new tickets with, replacing the oldest key
+ * with a new one if the current key has been used for long enough.
+ * The rotation happens on whichever loop first notices that it is
+ * due; all the others keep using the keys under the read lock.
+ */
+static ticketkey_t *
+ticketkeys_current(isc_tlsctx_ticketkeys_t *keys, ticketkey_t *key) {
+	isc_stdtime_t now = isc_stdtime_now();
+	uint32_t lifetime = atomic_load_relaxed(&keys->lifetime);
+	bool expired;
+
+	RWLOCK(&keys->rwlock, isc_rwlocktype_read);
+	expired = (now - keys->keys[keys->current].created >= lifetime);
+	if (!expired) {
+		*key = keys->keys[keys->current];
+	}
+	RWUNLOCK(&keys->rwlock, isc_rwlocktype_read);
+
+	if (expired) {
+		RWLOCK(&keys->rwlock, isc_rwlocktype_write);
+		if (now - keys->keys[keys->current].created >= lifetime) {
+			keys->current = (keys->current + 1) % TICKETKEYS_COUNT;
+			ticketkey_generate(&keys->keys[keys->current], now);
+		}
+		*key = keys->keys[keys->current];
+		RWUNLOCK(&keys->rwlock, isc_rwlocktype_write);
+	}
+
+	return (key);
+}
+
+/*
+ * Look up the key a ticket was issued with.  Keys which are too old
+ * to have been used within the last TICKETKEYS_COUNT lifetimes are
+ * ignored even if they are still in the ring.
+ */
+static ticketkey_t *
+ticketkeys_find(isc_tlsctx_ticketkeys_t *keys, const unsigned char *name,
+		ticketkey_t *key, bool *currentp) {
+	isc_stdtime_t now = isc_stdtime_now();
+	uint32_t lifetime = atomic_load_relaxed(&keys->lifetime);
+	ticketkey_t *found = NULL;
+
+	RWLOCK(&keys->rwlock, isc_rwlocktype_read);
+	for (size_t i = 0; i < TICKETKEYS_COUNT; i++) {
+		ticketkey_t *k = &keys->keys[i];
+
+		if (k->created == 0 ||
+		    memcmp(k->name, name, sizeof(k->name)) != 0)
+		{
+			continue;
+		}
+		if (now - k->created >= (uint64_t)lifetime * TICKETKEYS_COUNT) {
+			break;
+		}
+		*key = *k;
+		*currentp = (i == keys->current &&
+			     now - k->created < lifetime);
+		found = key;
+		break;
+	}
+	RWUNLOCK(&keys->rwlock, isc_rwlocktype_read);
+
+	return (found);
+}
+
+static void
+ticketkeys_ex_free(void *parent, void *ptr, CRYPTO_EX_DATA *ad, int idx,
+		   long argl, void *argp) {
+	isc_tlsctx_ticketkeys_t *keys = ptr;
+
+	UNUSED(parent);
+	UNUSED(ad);
+	UNUSED(idx);
+	UNUSED(argl);
+	UNUSED(argp);
+
+	if (keys != NULL) {
+		isc_tlsctx_ticketkeys_detach(&keys);
+	}
+}
+
+#if !defined(LIBRESSL_VERSION_NUMBER) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+static int
+ticketkeys_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+	      EVP_CIPHER_CTX *cctx, EVP_MAC_CTX *hctx, int enc)
+#else
+static int
+ticketkeys_cb(SSL *ssl, unsigned char *key_name, unsigned char *iv,
+	      EVP_CIPHER_CTX *cctx, HMAC_CTX *hctx, int enc)
+#endif
+{
+	isc_tlsctx_ticketkeys_t *keys = NULL;
+	ticketkey_t key;
+	bool current = true;
+	int ret = 1;
+
+	keys = SSL_CTX_get_ex_data(SSL_get_SSL_CTX(ssl), ticketkeys_index);
+	INSIST(VALID_TLSCTX_TICKETKEYS(keys));
+
+	if (enc) {
+		(void)ticketkeys_current(keys, &key);
+		if (RAND_bytes(iv, EVP_CIPHER_iv_length(EVP_aes_256_cbc())) !=
+		    1)
+		{
+			ret = -1;
+			goto cleanup;
+		}
+		memmove(key_name, key.name, sizeof(key.name));
+		if (EVP_EncryptInit_ex(cctx, EVP_aes_256_cbc(), NULL,
+				       key.aeskey, iv) != 1)
+		{
+			ret = -1;
+			goto cleanup;
+		}
+	} else {
+		if (ticketkeys_find(keys, key_name, &key, &current) == NULL) {
+			/* Unknown or expired key: do a full handshake */
+			ret = 0;
+			goto cleanup;
+		}
+		if (EVP_DecryptInit_ex(cctx, EVP_aes_256_cbc(), NULL,
+				       key.aeskey, iv) != 1)
+		{
+			ret = -1;
+			goto cleanup;
+		}
+	}
+
+#if !defined(LIBRESSL_VERSION_NUMBER) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+	OSSL_PARAM params[] = {
+		OSSL_PARAM_construct_octet_string(OSSL_MAC_PARAM_KEY,
+						  key.hmackey,
+						  sizeof(key.hmackey)),
+		OSSL_PARAM_construct_utf8_string(OSSL_MAC_PARAM_DIGEST,
+						 (char *)"SHA256", 0),
+		OSSL_PARAM_construct_end(),
+	};
+	if (EVP_MAC_CTX_set_params(hctx, params) != 1) {
+		ret = -1;
+		goto cleanup;
+	}
+#else
+	if (HMAC_Init_ex(hctx, key.hmackey, sizeof(key.hmackey), EVP_sha256(),
+			 NULL) != 1)
+	{
+		ret = -1;
+		goto cleanup;
+	}
+#endif
+
+	/* Ask for the ticket to be renewed if it uses an old key */
+	if (!enc && !current) {
+		ret = 2;
+	}
+
+cleanup:
+	isc_safe_memwipe(&key, sizeof(key));
+	return (ret);
+}
+
+void
+isc_tlsctx_set_ticketkeys(isc_tlsctx_t *ctx, isc_tlsctx_ticketkeys_t *keys,
+			  const char *context) {
+	isc_tlsctx_ticketkeys_t *ctxkeys = NULL;
+	unsigned char session_id_ctx[ISC_MAX_MD_SIZE];
+	unsigned int len = sizeof(session_id_ctx);
+
+	REQUIRE(ctx != NULL);
+	REQUIRE(VALID_TLSCTX_TICKETKEYS(keys));
+	REQUIRE(context != NULL);
+	REQUIRE(SSL_CTX_get_ex_data(ctx, ticketkeys_index) == NULL);
+
+	/*
+	 * Sessions are only resumed within the same session ID context,
+	 * so derive it from the context name instead of making it up:
+	 * that way a ticket stays usable on every TLS context created
+	 * for the same configuration, including after a reload.
+	 */
+	RUNTIME_CHECK(isc_hmac(ISC_MD_SHA256, keys->secret,
+			       sizeof(keys->secret),
+			       (const unsigned char *)context, strlen(context),
+			       session_id_ctx, &len) == ISC_R_SUCCESS);
+	len = ISC_MIN(len, SSL_MAX_SID_CTX_LENGTH);
+	RUNTIME_CHECK(SSL_CTX_set_session_id_context(ctx, session_id_ctx,
+						     len) == 1);
+
+	isc_tlsctx_ticketkeys_attach(keys, &ctxkeys);
+	RUNTIME_CHECK(SSL_CTX_set_ex_data(ctx, ticketkeys_index, ctxkeys) ==
+		      1);
+#if !defined(LIBRESSL_VERSION_NUMBER) && OPENSSL_VERSION_NUMBER >= 0x30000000L
+	RUNTIME_CHECK(SSL_CTX_set_tlsext_ticket_key_evp_cb(ctx,
+							   ticketkeys_cb) == 1);
+#else
+	RUNTIME_CHECK(SSL_CTX_set_tlsext_ticket_key_cb(ctx, ticketkeys_cb) ==
+		      1);
+#endif
+}
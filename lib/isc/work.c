@@ -13,6 +13,7 @@
 
 #include <stdlib.h>
 
+#include <isc/async.h>
 #include <isc/job.h>
 #include <isc/loop.h>
 #include <isc/urcu.h>
@@ -32,13 +33,75 @@ isc__work_cb(uv_work_t *req) {
 	rcu_unregister_thread();
 }
 
+static void
+work_submit(void *arg);
+
+/*
+ * Whether bulk or background work may be handed to the thread pool now.
+ * Must be called with the work lock held.
+ */
+static bool
+work_admit(isc_loopmgr_t *loopmgr, isc_workclass_t workclass) {
+	atomic_uint_fast32_t *running = loopmgr->work_running;
+	uint32_t *limit = loopmgr->work_limit;
+	uint32_t bulk, background;
+
+	background = atomic_load_relaxed(&running[isc_workclass_background]);
+	bulk = atomic_load_relaxed(&running[isc_workclass_bulk]) + background;
+	if (bulk >= limit[isc_workclass_bulk]) {
+		return (false);
+	}
+
+	if (workclass == isc_workclass_background) {
+		return (background < limit[isc_workclass_background] &&
+			ISC_LIST_EMPTY(
+				loopmgr->work_waiting[isc_workclass_bulk]));
+	}
+
+	return (true);
+}
+
+/*
+ * A bulk or background job has finished: start the oldest waiting job
+ * that may run now, on the loop that queued it.  Must be called with
+ * the work lock held.
+ */
+static void
+work_next(isc_loopmgr_t *loopmgr) {
+	for (isc_workclass_t c = isc_workclass_bulk; c < isc_workclass_max;
+	     c++)
+	{
+		isc_work_t *work = ISC_LIST_HEAD(loopmgr->work_waiting[c]);
+		if (work == NULL || !work_admit(loopmgr, c)) {
+			continue;
+		}
+
+		ISC_LIST_UNLINK(loopmgr->work_waiting[c], work, link);
+		loopmgr->work_nwaiting[c]--;
+		atomic_fetch_add_relaxed(&loopmgr->work_running[c], 1);
+		isc_async_run(work->loop, work_submit, work);
+		return;
+	}
+}
+
 static void
 isc__after_work_cb(uv_work_t *req, int status) {
 	isc_work_t *work = uv_req_get_data((uv_req_t *)req);
 	isc_loop_t *loop = work->loop;
+	isc_loopmgr_t *loopmgr = loop->loopmgr;
+	isc_workclass_t workclass = work->workclass;
 
 	UV_RUNTIME_CHECK(uv_after_work_cb, status);
 
+	if (workclass == isc_workclass_interactive) {
+		atomic_fetch_sub_relaxed(&loopmgr->work_running[workclass], 1);
+	} else {
+		LOCK(&loopmgr->work_lock);
+		atomic_fetch_sub_relaxed(&loopmgr->work_running[workclass], 1);
+		work_next(loopmgr);
+		UNLOCK(&loopmgr->work_lock);
+	}
+
 	work->after_work_cb(work->cbarg);
 
 	isc_mem_put(loop->mctx, work, sizeof(*work));
@@ -46,28 +109,86 @@ isc__after_work_cb(uv_work_t *req, int status) {
 	isc_loop_detach(&loop);
 }
 
+static void
+work_submit(void *arg) {
+	isc_work_t *work = arg;
+	int r;
+
+	r = uv_queue_work(&work->loop->loop, &work->work, isc__work_cb,
+			  isc__after_work_cb);
+	UV_RUNTIME_CHECK(uv_queue_work, r);
+}
+
 void
-isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
-		 isc_after_work_cb after_work_cb, void *cbarg) {
+isc_work_enqueueclass(isc_loop_t *loop, isc_workclass_t workclass,
+		      isc_work_cb work_cb, isc_after_work_cb after_work_cb,
+		      void *cbarg) {
+	isc_loopmgr_t *loopmgr = NULL;
 	isc_work_t *work = NULL;
-	int r;
 
 	REQUIRE(VALID_LOOP(loop));
+	REQUIRE(workclass >= isc_workclass_interactive &&
+		workclass < isc_workclass_max);
 	REQUIRE(work_cb != NULL);
 	REQUIRE(after_work_cb != NULL);
 
+	loopmgr = loop->loopmgr;
+
 	work = isc_mem_get(loop->mctx, sizeof(*work));
 	*work = (isc_work_t){
+		.workclass = workclass,
 		.work_cb = work_cb,
 		.after_work_cb = after_work_cb,
 		.cbarg = cbarg,
+		.link = ISC_LINK_INITIALIZER,
 	};
 
 	isc_loop_attach(loop, &work->loop);
 
 	uv_req_set_data((uv_req_t *)&work->work, work);
 
-	r = uv_queue_work(&loop->loop, &work->work, isc__work_cb,
-			  isc__after_work_cb);
-	UV_RUNTIME_CHECK(uv_queue_work, r);
+	if (workclass == isc_workclass_interactive) {
+		atomic_fetch_add_relaxed(&loopmgr->work_running[workclass], 1);
+		work_submit(work);
+		return;
+	}
+
+	/*
+	 * Bulk and background work waits in line if its share of the
+	 * thread pool is in use, or if older work of its class is already
+	 * waiting.
+	 */
+	LOCK(&loopmgr->work_lock);
+	if (ISC_LIST_EMPTY(loopmgr->work_waiting[workclass]) &&
+	    work_admit(loopmgr, workclass))
+	{
+		atomic_fetch_add_relaxed(&loopmgr->work_running[workclass], 1);
+		UNLOCK(&loopmgr->work_lock);
+		work_submit(work);
+		return;
+	}
+	ISC_LIST_APPEND(loopmgr->work_waiting[workclass], work, link);
+	loopmgr->work_nwaiting[workclass]++;
+	UNLOCK(&loopmgr->work_lock);
+}
+
+void
+isc_work_enqueue(isc_loop_t *loop, isc_work_cb work_cb,
+		 isc_after_work_cb after_work_cb, void *cbarg) {
+	isc_work_enqueueclass(loop, isc_workclass_interactive, work_cb,
+			      after_work_cb, cbarg);
+}
+
+void
+isc_work_stats(isc_loopmgr_t *loopmgr, isc_workclass_t workclass,
+	       uint32_t *runningp, uint32_t *waitingp) {
+	REQUIRE(VALID_LOOPMGR(loopmgr));
+	REQUIRE(workclass >= isc_workclass_interactive &&
+		workclass < isc_workclass_max);
+	REQUIRE(runningp != NULL && waitingp != NULL);
+
+	LOCK(&loopmgr->work_lock);
+	*runningp = atomic_load_relaxed(&loopmgr->work_running[workclass]);
+	*waitingp = loopmgr->work_nwaiting[workclass];
+	UNLOCK(&loopmgr->work_lock);
 }
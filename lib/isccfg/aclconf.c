@@ -971,6 +971,9 @@ cfg_acl_fromconfig(const cfg_obj_t *acl_data, const cfg_obj_t *cctx,
 		INSIST(dacl->length <= dacl->alloc);
 	}
 
+	/* Flatten the IP table now rather than on the first query */
+	dns_iptable_compile(dacl->iptable);
+
 	dns_acl_attach(dacl, target);
 	result = ISC_R_SUCCESS;
 
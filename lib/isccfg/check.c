@@ -1386,6 +1386,16 @@ check_options(const cfg_obj_t *options, const cfg_obj_t *config,
 		}
 	}
 
+	obj = NULL;
+	(void)cfg_map_get(options, "resolver-hedge-percentile", &obj);
+	if (obj != NULL && cfg_obj_asuint32(obj) > 99) {
+		cfg_obj_log(obj, logctx, ISC_LOG_ERROR,
+			    "resolver-hedge-percentile '%u' is out of range "
+			    "(0..99)",
+			    cfg_obj_asuint32(obj));
+		result = ISC_R_RANGE;
+	}
+
 	/*
 	 * Check key-store.
 	 */
@@ -5856,6 +5866,7 @@ check_logging(const cfg_obj_t *config, isc_log_t *logctx, isc_mem_t *mctx) {
 	const cfg_obj_t *syslogobj = NULL;
 	const cfg_obj_t *nullobj = NULL;
 	const cfg_obj_t *stderrobj = NULL;
+	const cfg_obj_t *binaryobj = NULL;
 	const cfg_obj_t *logobj = NULL;
 	isc_result_t result = ISC_R_SUCCESS;
 	isc_result_t tresult;
@@ -5913,6 +5924,17 @@ check_logging(const cfg_obj_t *config, isc_log_t *logctx, isc_mem_t *mctx) {
 				    channelname);
 			result = ISC_R_FAILURE;
 		}
+		binaryobj = NULL;
+		(void)cfg_map_get(channel, "binary", &binaryobj);
+		if (binaryobj != NULL && cfg_obj_asboolean(binaryobj) &&
+		    fileobj == NULL)
+		{
+			cfg_obj_log(channel, logctx, ISC_LOG_ERROR,
+				    "channel '%s': binary requires a file "
+				    "destination",
+				    channelname);
+			result = ISC_R_FAILURE;
+		}
 		tresult = isc_symtab_define(symtab, channelname, 1, symvalue,
 					    isc_symexists_replace);
 		RUNTIME_CHECK(tresult == ISC_R_SUCCESS);
@@ -44,6 +44,7 @@
 #include <dns/edns.h>
 #include <dns/message.h>
 #include <dns/peer.h>
+#include <dns/qlog.h>
 #include <dns/rcode.h>
 #include <dns/rdata.h>
 #include <dns/rdataclass.h>
@@ -95,8 +96,9 @@
 
 #define TCP_CLIENT(c) (((c)->attributes & NS_CLIENTATTR_TCP) != 0)
 
-#define COOKIE_SIZE 24U /* 8 + 4 + 4 + 8 */
-#define ECS_SIZE    20U /* 2 + 1 + 1 + [0..16] */
+#define COOKIE_SIZE  24U  /* 8 + 4 + 4 + 8 */
+#define COOKIE_REUSE 1800 /* seconds a server cookie may be returned */
+#define ECS_SIZE     20U  /* 2 + 1 + 1 + [0..16] */
 
 #define WANTNSID(x)	(((x)->attributes & NS_CLIENTATTR_WANTNSID) != 0)
 #define WANTEXPIRE(x)	(((x)->attributes & NS_CLIENTATTR_WANTEXPIRE) != 0)
@@ -120,6 +122,8 @@ clientmgr_destroy_cb(void *arg);
 static void
 ns_client_dumpmessage(ns_client_t *client, const char *reason);
 static void
+aclcache_flush(ns_client_t *client);
+static void
 compute_cookie(ns_client_t *client, uint32_t when, const unsigned char *secret,
 	       isc_buffer_t *buf);
 
@@ -136,11 +140,28 @@ ns_client_recursing(ns_client_t *client) {
 
 void
 ns_client_killoldestquery(ns_client_t *client) {
-	ns_client_t *oldest;
+	ns_server_t *sctx = NULL;
+	ns_client_t *oldest = NULL;
+
 	REQUIRE(NS_CLIENT_VALID(client));
 
+	sctx = client->manager->sctx;
+
 	LOCK(&client->manager->reclock);
-	oldest = ISC_LIST_HEAD(client->manager->recursing);
+	/*
+	 * Prefer the oldest query from a network that holds more than
+	 * its share of the recursive clients.
+	 */
+	for (oldest = ISC_LIST_HEAD(client->manager->recursing);
+	     oldest != NULL; oldest = ISC_LIST_NEXT(oldest, rlink))
+	{
+		if (ns_server_recursionovershare(sctx, &oldest->peeraddr)) {
+			break;
+		}
+	}
+	if (oldest == NULL) {
+		oldest = ISC_LIST_HEAD(client->manager->recursing);
+	}
 	if (oldest != NULL) {
 		ISC_LIST_UNLINK(client->manager->recursing, oldest, rlink);
 		ns_query_cancel(oldest);
@@ -332,9 +353,7 @@ client_allocsendbuf(ns_client_t *client, isc_buffer_t *buffer,
 
 	if (TCP_CLIENT(client)) {
 		INSIST(client->tcpbuf == NULL);
-		client->tcpbuf = isc_mem_get(client->manager->send_mctx,
-					     NS_CLIENT_TCP_BUFFER_SIZE);
-		client->tcpbuf_size = NS_CLIENT_TCP_BUFFER_SIZE;
+		client->tcpbuf = isc_mempool_get(client->manager->tcpbufpool);
 		data = client->tcpbuf;
 		isc_buffer_init(buffer, data, NS_CLIENT_TCP_BUFFER_SIZE);
 	} else {
@@ -367,17 +386,12 @@ client_sendpkg(ns_client_t *client, isc_buffer_t *buffer) {
 
 	REQUIRE(client->sendhandle == NULL);
 
-	if (isc_buffer_base(buffer) == client->tcpbuf) {
-		size_t used = isc_buffer_usedlength(buffer);
-		client->tcpbuf = isc_mem_creget(
-			client->manager->send_mctx, client->tcpbuf,
-			client->tcpbuf_size, used, sizeof(char));
-		client->tcpbuf_size = used;
-		r.base = client->tcpbuf;
-		r.length = used;
-	} else {
-		isc_buffer_usedregion(buffer, &r);
-	}
+	/*
+	 * The message has been rendered directly into the send buffer,
+	 * which stays owned by the client until the request ends, so it
+	 * can be handed to the network manager as is.
+	 */
+	isc_buffer_usedregion(buffer, &r);
 	isc_nmhandle_attach(client->handle, &client->sendhandle);
 
 	if (isc_nm_is_http_handle(client->handle)) {
@@ -447,13 +461,51 @@ ns_client_sendraw(ns_client_t *client, dns_message_t *message) {
 	return;
 done:
 	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->manager->send_mctx, client->tcpbuf,
-			    client->tcpbuf_size);
+		isc_mempool_put(client->manager->tcpbufpool, client->tcpbuf);
 	}
 
 	ns_client_drop(client, result);
 }
 
+/*
+ * Write a binary record of the response to the query-records category.
+ */
+static void
+client_qlog(ns_client_t *client) {
+	dns_qlogrecord_t record;
+	unsigned char data[DNS_QLOG_MAXRECORD];
+	isc_buffer_t buffer;
+	isc_time_t now;
+	isc_result_t result;
+
+	if (!isc_log_wantbinary(ns_lctx)) {
+		return;
+	}
+
+	now = isc_time_now();
+	record = (dns_qlogrecord_t){
+		.time = client->requesttime,
+		.client = client->peeraddr,
+		.tcp = TCP_CLIENT(client),
+		.latency = isc_time_microdiff(&now, &client->requesttime),
+		.qname = client->query.origqname != NULL
+				 ? client->query.origqname
+				 : dns_rootname,
+		.qtype = client->query.qtype,
+		.qclass = client->message->rdclass,
+		.flags = client->message->flags,
+		.rcode = client->message->rcode,
+	};
+
+	isc_buffer_init(&buffer, data, sizeof(data));
+	result = dns_qlog_encode(&record, &buffer);
+	if (result == ISC_R_SUCCESS) {
+		isc_log_writebinary(ns_lctx, NS_LOGCATEGORY_QUERY_RECORDS,
+				    NS_LOGMODULE_CLIENT, data,
+				    isc_buffer_usedlength(&buffer));
+	}
+}
+
 void
 ns_client_send(ns_client_t *client) {
 	isc_result_t result;
@@ -467,6 +519,7 @@ ns_client_send(ns_client_t *client) {
 	unsigned int preferred_glue;
 	bool opt_included = false;
 	size_t respsize;
+	unsigned int wirestart;
 	dns_aclenv_t *env = NULL;
 #ifdef HAVE_DNSTAP
 	unsigned char zone[DNS_NAME_MAXWIRE];
@@ -581,6 +634,23 @@ ns_client_send(ns_client_t *client) {
 	if ((client->message->flags & DNS_MESSAGEFLAG_TC) != 0) {
 		goto renderend;
 	}
+	/*
+	 * Copy a pre-rendered answer found by the query code verbatim.
+	 */
+	if (client->query.rendered.data.base != NULL) {
+		result = dns_message_renderraw(
+			client->message, &client->query.rendered.data,
+			client->query.rendered.ancount,
+			client->query.rendered.nscount,
+			client->query.rendered.arcount);
+		if (result == ISC_R_NOSPACE) {
+			client->message->flags |= DNS_MESSAGEFLAG_TC;
+		} else if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		goto renderend;
+	}
+	wirestart = isc_buffer_usedlength(&buffer);
 	result = dns_message_rendersection(client->message, DNS_SECTION_ANSWER,
 					   DNS_MESSAGERENDER_PARTIAL |
 						   render_opts);
@@ -607,6 +677,13 @@ ns_client_send(ns_client_t *client) {
 	if (result != ISC_R_SUCCESS && result != ISC_R_NOSPACE) {
 		goto cleanup;
 	}
+	if (result == ISC_R_SUCCESS && client->query.rendered.store) {
+		isc_region_t wire;
+
+		isc_buffer_usedregion(&buffer, &wire);
+		isc_region_consume(&wire, wirestart);
+		ns_query_storerendered(client, &wire);
+	}
 renderend:
 	result = dns_message_renderend(client->message);
 	if (result != ISC_R_SUCCESS) {
@@ -725,14 +802,15 @@ renderend:
 				   ns_statscounter_truncatedresp);
 	}
 
+	client_qlog(client);
+
 	client->query.attributes |= NS_QUERYATTR_ANSWERED;
 
 	return;
 
 cleanup:
 	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->manager->send_mctx, client->tcpbuf,
-			    client->tcpbuf_size);
+		isc_mempool_put(client->manager->tcpbufpool, client->tcpbuf);
 	}
 
 	if (cleanup_cctx) {
@@ -1007,8 +1085,13 @@ no_nsid:
 
 		isc_buffer_init(&buf, cookie, sizeof(cookie));
 
-		compute_cookie(client, now, client->manager->sctx->secret,
-			       &buf);
+		if ((client->attributes & NS_CLIENTATTR_REUSECOOKIE) != 0) {
+			isc_buffer_putmem(&buf, client->cookie, 8);
+			isc_buffer_putmem(&buf, client->servercookie, 16);
+		} else {
+			compute_cookie(client, now,
+				       client->manager->sctx->secret, &buf);
+		}
 
 		INSIST(count < DNS_EDNSOPTIONS);
 		ednsopts[count].code = DNS_OPT_COOKIE;
@@ -1260,6 +1343,20 @@ process_cookie(ns_client_t *client, isc_buffer_t *buf, size_t optlen) {
 		ns_stats_increment(client->manager->sctx->nsstats,
 				   ns_statscounter_cookiematch);
 		client->attributes |= NS_CLIENTATTR_HAVECOOKIE;
+
+		/*
+		 * A server cookie made with the current secret and less
+		 * than half an hour ago can be returned as it is
+		 * (RFC 9018, section 4.3), which saves computing a new
+		 * one for the reply.
+		 */
+		if (!isc_serial_gt(when, now) &&
+		    !isc_serial_lt(when, now - COOKIE_REUSE))
+		{
+			memmove(client->servercookie, dbuf + 8,
+				sizeof(client->servercookie));
+			client->attributes |= NS_CLIENTATTR_REUSECOOKIE;
+		}
 		return;
 	}
 
@@ -1571,8 +1668,7 @@ ns__client_reset_cb(void *client0) {
 
 	ns_client_endrequest(client);
 	if (client->tcpbuf != NULL) {
-		isc_mem_put(client->manager->send_mctx, client->tcpbuf,
-			    client->tcpbuf_size);
+		isc_mempool_put(client->manager->tcpbufpool, client->tcpbuf);
 	}
 
 	if (client->keytag != NULL) {
@@ -1588,6 +1684,28 @@ ns__client_reset_cb(void *client0) {
 #endif /* WANT_SINGLETRACE */
 }
 
+static void
+client_free(ns_clientmgr_t *manager, ns_client_t *client) {
+	/*
+	 * Call this first because it requires a valid client.
+	 */
+	ns_query_free(client);
+
+	client->magic = 0;
+
+	isc_mem_put(manager->send_mctx, client->sendbuf,
+		    NS_CLIENT_SEND_BUFFER_SIZE);
+	dns_message_detach(&client->message);
+
+	/*
+	 * Destroy the fetchlock mutex that was created in
+	 * ns_query_init().
+	 */
+	isc_mutex_destroy(&client->query.fetchlock);
+
+	isc_mem_put(manager->mctx, client, sizeof(*client));
+}
+
 void
 ns__client_put_cb(void *client0) {
 	ns_client_t *client = client0;
@@ -1600,31 +1718,31 @@ ns__client_put_cb(void *client0) {
 	ns_client_log(client, DNS_LOGCATEGORY_SECURITY, NS_LOGMODULE_CLIENT,
 		      ISC_LOG_DEBUG(3), "freeing client");
 
-	/*
-	 * Call this first because it requires a valid client.
-	 */
-	ns_query_free(client);
 	client_extendederror_reset(client);
+	aclcache_flush(client);
 
-	client->magic = 0;
-
-	isc_mem_put(manager->send_mctx, client->sendbuf,
-		    NS_CLIENT_SEND_BUFFER_SIZE);
 	if (client->opt != NULL) {
 		INSIST(dns_rdataset_isassociated(client->opt));
 		dns_rdataset_disassociate(client->opt);
 		dns_message_puttemprdataset(client->message, &client->opt);
 	}
 
-	dns_message_detach(&client->message);
-
 	/*
-	 * Destroy the fetchlock mutex that was created in
-	 * ns_query_init().
+	 * Keep the client as it is, with its message, send buffer and
+	 * query state, for the next request on this loop that arrives on
+	 * a handle without a client; it only needs the same reset as a
+	 * client whose handle is reused.  The pooled client does not hold
+	 * a reference to the manager.
 	 */
-	isc_mutex_destroy(&client->query.fetchlock);
-
-	isc_mem_put(manager->mctx, client, sizeof(*client));
+	if (manager->tid == isc_tid() &&
+	    manager->nclients < NS_CLIENT_FREEMAX &&
+	    isc_refcount_current(&client->message->references) == 1)
+	{
+		client->manager = NULL;
+		manager->clients[manager->nclients++] = client;
+	} else {
+		client_free(manager, client);
+	}
 
 	ns_clientmgr_detach(&manager);
 }
@@ -1686,9 +1804,14 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 		INSIST(VALID_MANAGER(clientmgr));
 		INSIST(clientmgr->tid == isc_tid());
 
-		client = isc_mem_get(clientmgr->mctx, sizeof(*client));
-
-		result = ns__client_setup(client, clientmgr, true);
+		if (clientmgr->nclients > 0) {
+			client = clientmgr->clients[--clientmgr->nclients];
+			ns_clientmgr_attach(clientmgr, &client->manager);
+			result = ns__client_setup(client, NULL, false);
+		} else {
+			client = isc_mem_get(clientmgr->mctx, sizeof(*client));
+			result = ns__client_setup(client, clientmgr, true);
+		}
 		if (result != ISC_R_SUCCESS) {
 			return;
 		}
@@ -1838,9 +1961,13 @@ ns_client_request(isc_nmhandle_t *handle, isc_result_t eresult,
 	}
 
 	/*
-	 * It's a request.  Parse it.
+	 * It's a request.  Parse it, trying the fast path for simple
+	 * queries first.
 	 */
-	result = dns_message_parse(client->message, buffer, 0);
+	result = dns_message_parsequery(client->message, buffer);
+	if (result == ISC_R_NOTIMPLEMENTED) {
+		result = dns_message_parse(client->message, buffer, 0);
+	}
 	if (result != ISC_R_SUCCESS) {
 		/*
 		 * Parsing the request failed.  Send a response
@@ -2307,9 +2434,7 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 
 		ns_clientmgr_attach(mgr, &client->manager);
 
-		dns_message_create(client->manager->mctx,
-				   client->manager->namepool,
-				   client->manager->rdspool,
+		dns_message_create(mgr->mctx, mgr->namepool, mgr->rdspool,
 				   DNS_MESSAGE_INTENTPARSE, &client->message);
 
 		client->sendbuf = isc_mem_get(client->manager->send_mctx,
@@ -2337,6 +2462,7 @@ ns__client_setup(ns_client_t *client, ns_clientmgr_t *mgr, bool new) {
 			.sendbuf = client->sendbuf,
 			.message = client->message,
 			.query = client->query,
+			.aclcache = client->aclcache,
 		};
 	}
 
@@ -2376,6 +2502,12 @@ clientmgr_destroy_cb(void *arg) {
 	ns_clientmgr_t *manager = (ns_clientmgr_t *)arg;
 	MTRACE("clientmgr_destroy");
 
+	while (manager->nclients > 0) {
+		ns_client_t *client = manager->clients[--manager->nclients];
+		client->manager = manager;
+		client_free(manager, client);
+	}
+
 	manager->magic = 0;
 
 	isc_loop_detach(&manager->loop);
@@ -2388,6 +2520,7 @@ clientmgr_destroy_cb(void *arg) {
 
 	dns_message_destroypools(&manager->rdspool, &manager->namepool);
 
+	isc_mempool_destroy(&manager->tcpbufpool);
 	isc_mem_detach(&manager->send_mctx);
 
 	isc_mem_putanddetach(&manager->mctx, manager, sizeof(*manager));
@@ -2423,6 +2556,8 @@ ns_clientmgr_create(ns_server_t *sctx, isc_loopmgr_t *loopmgr,
 	ns_server_attach(sctx, &manager->sctx);
 
 	dns_message_createpools(mctx, &manager->namepool, &manager->rdspool);
+	isc_mempool_settid(manager->namepool, tid);
+	isc_mempool_settid(manager->rdspool, tid);
 
 	/*
 	 * We create specialised per-worker memory context specifically
@@ -2479,6 +2614,18 @@ ns_clientmgr_create(ns_server_t *sctx, isc_loopmgr_t *loopmgr,
 	 */
 	(void)isc_mem_arena_set_muzzy_decay_ms(manager->send_mctx, 0);
 
+	/*
+	 * TCP responses are rendered straight into a full sized buffer
+	 * taken from this pool and sent from there, so there is no need
+	 * to allocate and then shrink (and possibly copy) a buffer for
+	 * every response.
+	 */
+	isc_mempool_create(manager->send_mctx, NS_CLIENT_TCP_BUFFER_SIZE,
+			   &manager->tcpbufpool);
+	isc_mempool_setname(manager->tcpbufpool, "tcpbufs");
+	isc_mempool_setfreemax(manager->tcpbufpool,
+			       NS_CLIENT_TCP_BUFFERS_FREEMAX);
+
 	manager->magic = MANAGER_MAGIC;
 
 	MTRACE("create");
@@ -2515,6 +2662,15 @@ ns_client_getdestaddr(ns_client_t *client) {
 	return (&client->destsockaddr);
 }
 
+static void
+aclcache_flush(ns_client_t *client) {
+	for (unsigned int i = 0; i < client->aclcache.count; i++) {
+		dns_acl_detach(&client->aclcache.acl[i]);
+	}
+	client->aclcache.count = 0;
+	client->aclcache.allowed = 0;
+}
+
 isc_result_t
 ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 			 dns_acl_t *acl, bool default_allow) {
@@ -2523,6 +2679,11 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 	isc_netaddr_t tmpnetaddr;
 	int match;
 	isc_sockaddr_t local;
+	in_port_t port;
+	isc_nmsocket_type_t transport;
+	bool encrypted;
+	bool cacheable = false;
+	uint_fast32_t generation = 0;
 
 	if (acl == NULL) {
 		if (default_allow) {
@@ -2532,17 +2693,63 @@ ns_client_checkaclsilent(ns_client_t *client, isc_netaddr_t *netaddr,
 		}
 	}
 
+	local = isc_nmhandle_localaddr(client->handle);
+	port = isc_sockaddr_getport(&local);
+	transport = isc_nm_socket_type(client->handle);
+	encrypted = isc_nm_has_encryption(client->handle);
+
+	/*
+	 * Only decisions about the peer address of an unsigned request
+	 * are cached; the TSIG signer may differ from one request to the
+	 * next.
+	 */
 	if (netaddr == NULL) {
 		isc_netaddr_fromsockaddr(&tmpnetaddr, &client->peeraddr);
 		netaddr = &tmpnetaddr;
+		cacheable = (client->signer == NULL);
 	}
 
-	local = isc_nmhandle_localaddr(client->handle);
-	result = dns_acl_match_port_transport(
-		netaddr, isc_sockaddr_getport(&local),
-		isc_nm_socket_type(client->handle),
-		isc_nm_has_encryption(client->handle), client->signer, acl, env,
-		&match, NULL);
+	if (cacheable) {
+		generation = atomic_load_acquire(&env->generation);
+		if (client->aclcache.generation != generation ||
+		    client->aclcache.port != port ||
+		    client->aclcache.transport != transport ||
+		    client->aclcache.encrypted != encrypted ||
+		    !isc_netaddr_equal(&client->aclcache.peer, netaddr))
+		{
+			aclcache_flush(client);
+			client->aclcache.peer = *netaddr;
+			client->aclcache.port = port;
+			client->aclcache.transport = transport;
+			client->aclcache.encrypted = encrypted;
+			client->aclcache.generation = generation;
+		}
+
+		for (unsigned int i = 0; i < client->aclcache.count; i++) {
+			if (client->aclcache.acl[i] == acl) {
+				if ((client->aclcache.allowed & (1U << i)) != 0)
+				{
+					goto allow;
+				}
+				goto deny;
+			}
+		}
+	}
+
+	result = dns_acl_match_port_transport(netaddr, port, transport,
+					      encrypted, client->signer, acl,
+					      env, &match, NULL);
+
+	if (cacheable && result == ISC_R_SUCCESS &&
+	    client->aclcache.count < NS_CLIENT_ACLCACHE_SIZE)
+	{
+		unsigned int i = client->aclcache.count++;
+
+		dns_acl_attach(acl, &client->aclcache.acl[i]);
+		if (match > 0) {
+			client->aclcache.allowed |= (1U << i);
+		}
+	}
 
 	if (result != ISC_R_SUCCESS) {
 		goto deny; /* Internal error, already logged. */
@@ -2989,3 +3196,80 @@ ns_client_findversion(ns_client_t *client, dns_db_t *db) {
 
 	return (dbversion);
 }
+
+void *
+ns_client_gethookdata(ns_client_t *client, const void *key) {
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(key != NULL);
+
+	for (size_t i = 0; i < NS_CLIENT_HOOKDATA_MAX; i++) {
+		if (client->hookdata[i].key == key) {
+			return (client->hookdata[i].data);
+		}
+	}
+
+	return (NULL);
+}
+
+isc_result_t
+ns_client_sethookdata(ns_client_t *client, const void *key, void *data,
+		      ns_client_hookfree_t freedata) {
+	size_t slot = NS_CLIENT_HOOKDATA_MAX;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(key != NULL);
+
+	for (size_t i = 0; i < NS_CLIENT_HOOKDATA_MAX; i++) {
+		if (client->hookdata[i].key == key) {
+			slot = i;
+			break;
+		}
+		if (client->hookdata[i].key == NULL &&
+		    slot == NS_CLIENT_HOOKDATA_MAX)
+		{
+			slot = i;
+		}
+	}
+
+	if (data == NULL) {
+		if (slot < NS_CLIENT_HOOKDATA_MAX) {
+			client->hookdata[slot].key = NULL;
+			client->hookdata[slot].data = NULL;
+			client->hookdata[slot].freedata = NULL;
+		}
+		return (ISC_R_SUCCESS);
+	}
+
+	if (slot == NS_CLIENT_HOOKDATA_MAX) {
+		return (ISC_R_NOSPACE);
+	}
+
+	client->hookdata[slot].key = key;
+	client->hookdata[slot].data = data;
+	client->hookdata[slot].freedata = freedata;
+
+	return (ISC_R_SUCCESS);
+}
+
+void
+ns__client_freehookdata(ns_client_t *client) {
+	REQUIRE(NS_CLIENT_VALID(client));
+
+	for (size_t i = 0; i < NS_CLIENT_HOOKDATA_MAX; i++) {
+		const void *key = client->hookdata[i].key;
+		void *data = client->hookdata[i].data;
+		ns_client_hookfree_t freedata = client->hookdata[i].freedata;
+
+		if (key == NULL) {
+			continue;
+		}
+
+		client->hookdata[i].key = NULL;
+		client->hookdata[i].data = NULL;
+		client->hookdata[i].freedata = NULL;
+
+		if (freedata != NULL) {
+			freedata(key, data);
+		}
+	}
+}
@@ -83,6 +83,27 @@
 #define NS_CLIENT_TCP_BUFFER_SIZE  65535
 #define NS_CLIENT_SEND_BUFFER_SIZE 4096
 
+/*%
+ * How many idle TCP send buffers a client manager keeps for reuse.
+ */
+#define NS_CLIENT_TCP_BUFFERS_FREEMAX 16
+
+/*%
+ * How many freed clients a client manager keeps, fully initialized, to
+ * be handed to new requests on the same loop.
+ */
+#define NS_CLIENT_FREEMAX 32
+
+/*%
+ * How many hook module instances can keep data with a client.
+ */
+#define NS_CLIENT_HOOKDATA_MAX 8
+
+/*%
+ * How many ACL decisions a client remembers for its peer address.
+ */
+#define NS_CLIENT_ACLCACHE_SIZE 8
+
 /*!
  * Client object states.  Ordering is significant: higher-numbered
  * states are generally "more active", meaning that the client can
@@ -138,6 +159,9 @@ typedef enum {
 
 typedef ISC_LIST(ns_client_t) client_list_t;
 
+/*% Frees data a hook module stored with a client */
+typedef void (*ns_client_hookfree_t)(const void *key, void *data);
+
 /*% nameserver client manager structure */
 struct ns_clientmgr {
 	/* Unlocked. */
@@ -147,6 +171,7 @@ struct ns_clientmgr {
 	isc_mem_t     *send_mctx;
 	isc_mempool_t *namepool;
 	isc_mempool_t *rdspool;
+	isc_mempool_t *tcpbufpool;
 
 	ns_server_t   *sctx;
 	isc_refcount_t references;
@@ -155,6 +180,10 @@ struct ns_clientmgr {
 
 	dns_aclenv_t *aclenv;
 
+	/* Only used on the manager's loop. */
+	ns_client_t *clients[NS_CLIENT_FREEMAX];
+	unsigned int nclients;
+
 	/* Lock covers the recursing list */
 	isc_mutex_t   reclock;
 	client_list_t recursing; /*%< Recursing clients */
@@ -176,7 +205,6 @@ struct ns_client {
 	isc_nmhandle_t *updatehandle;  /* Waiting for update callback */
 	isc_nmhandle_t *restarthandle; /* Waiting for restart callback */
 	unsigned char  *tcpbuf;
-	size_t		tcpbuf_size;
 	dns_message_t  *message;
 	unsigned char  *sendbuf;
 	dns_rdataset_t *opt;
@@ -212,11 +240,38 @@ struct ns_client {
 		dns_messageid_t id;
 	} formerrcache;
 
+	/*%
+	 * Results of ns_client_checkaclsilent() for the peer address,
+	 * kept while the client is reused for the same peer, local port
+	 * and transport (such as pipelined queries on a TCP connection)
+	 * and the ACL environment does not change.  Each cached ACL is
+	 * referenced, so a reconfiguration, which creates new ACLs,
+	 * can never be confused with the old one.
+	 */
+	struct {
+		isc_netaddr_t	     peer;
+		in_port_t	     port;
+		isc_nmsocket_type_t  transport;
+		bool		     encrypted;
+		uint_fast32_t	     generation;
+		unsigned int	     count;
+		uint32_t	     allowed;
+		dns_acl_t	    *acl[NS_CLIENT_ACLCACHE_SIZE];
+	} aclcache;
+
 	/*% Callback function to send a response when unit testing */
 	void (*sendcb)(isc_buffer_t *buf);
 
+	/*% Data kept by hook modules, keyed by module instance */
+	struct {
+		const void	   *key;
+		void		   *data;
+		ns_client_hookfree_t freedata;
+	} hookdata[NS_CLIENT_HOOKDATA_MAX];
+
 	ISC_LINK(ns_client_t) rlink;
 	unsigned char  cookie[8];
+	unsigned char  servercookie[16]; /*%< verified, for the reply */
 	uint32_t       expire;
 	unsigned char *keytag;
 	uint16_t       keytag_len;
@@ -253,6 +308,8 @@ struct ns_client {
 #define NS_CLIENTATTR_USEKEEPALIVE 0x10000 /*%< use TCP keepalive */
 
 #define NS_CLIENTATTR_NOSETFC 0x20000 /*%< don't set servfail cache */
+#define NS_CLIENTATTR_REUSECOOKIE \
+	0x40000 /*%< reply with the server cookie presented */
 
 /*
  * Flag to use with the SERVFAIL cache to indicate
@@ -424,7 +481,10 @@ ns_client_recursing(ns_client_t *client);
 void
 ns_client_killoldestquery(ns_client_t *client);
 /*%<
- * Kill the oldest recursive query (recursing list head).
+ * Kill the oldest recursive query from a client network that holds more
+ * than its share of the recursive clients (see
+ * ns_server_recursionovershare()), or failing that the oldest recursive
+ * query (recursing list head).
  */
 
 void
@@ -534,6 +594,49 @@ ns_client_findversion(ns_client_t *client, dns_db_t *db);
  * allocated by ns_client_newdbversion().
  */
 
+void *
+ns_client_gethookdata(ns_client_t *client, const void *key);
+/*%<
+ * Return the data that the hook module instance 'key' stored with
+ * 'client' by ns_client_sethookdata(), or NULL if there is none.
+ *
+ * Requires:
+ *\li	'client' is valid.
+ *\li	'key' is not NULL.
+ */
+
+isc_result_t
+ns_client_sethookdata(ns_client_t *client, const void *key, void *data,
+		      ns_client_hookfree_t freedata);
+/*%<
+ * Store 'data' with 'client' for the hook module instance 'key',
+ * replacing any data it stored before, or remove it if 'data' is NULL.
+ * This is lockless per-client storage for hook modules, which run on
+ * the client's loop.
+ *
+ * Data that is replaced or removed is not freed.  If 'freedata' is not
+ * NULL, it is called with 'key' and 'data' for data that is still
+ * stored when the client's query state is reset at the end of the
+ * request, or when the client is freed; the slot is emptied then.
+ *
+ * Requires:
+ *\li	'client' is valid.
+ *\li	'key' is not NULL.
+ *
+ * Returns:
+ *\li	#ISC_R_SUCCESS
+ *\li	#ISC_R_NOSPACE	if NS_CLIENT_HOOKDATA_MAX module instances
+ *			already keep data with 'client'
+ */
+
+void
+ns__client_freehookdata(ns_client_t *client);
+/*%<
+ * Free the hook module data still stored with 'client', using the
+ * functions passed to ns_client_sethookdata(), and empty all slots.
+ * Called when the query state of 'client' is reset.
+ */
+
 ISC_REFCOUNT_DECL(ns_clientmgr);
 
 isc_result_t
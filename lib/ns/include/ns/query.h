@@ -19,6 +19,7 @@
 
 #include <isc/buffer.h>
 #include <isc/netaddr.h>
+#include <isc/time.h>
 #include <isc/types.h>
 
 #include <dns/rdataset.h>
@@ -45,7 +46,6 @@ typedef enum {
 	RECTYPE_NORMAL,
 	RECTYPE_PREFETCH,
 	RECTYPE_RPZ,
-	RECTYPE_STALE_REFRESH,
 	RECTYPE_HOOK,
 	RECTYPE_COUNT,
 } ns_query_rectype_t;
@@ -60,8 +60,6 @@ typedef enum {
 	((client)->query.recursions[RECTYPE_PREFETCH].handle)
 #define HANDLE_RECTYPE_RPZ(client) \
 	((client)->query.recursions[RECTYPE_RPZ].handle)
-#define HANDLE_RECTYPE_STALE_REFRESH(client) \
-	((client)->query.recursions[RECTYPE_STALE_REFRESH].handle)
 #define HANDLE_RECTYPE_HOOK(client) \
 	((client)->query.recursions[RECTYPE_HOOK].handle)
 
@@ -75,11 +73,15 @@ typedef enum {
 	((client)->query.recursions[RECTYPE_PREFETCH].fetch)
 #define FETCH_RECTYPE_RPZ(client) \
 	((client)->query.recursions[RECTYPE_RPZ].fetch)
-#define FETCH_RECTYPE_STALE_REFRESH(client) \
-	((client)->query.recursions[RECTYPE_STALE_REFRESH].fetch)
 #define FETCH_RECTYPE_HOOK(client) \
 	((client)->query.recursions[RECTYPE_HOOK].fetch)
 
+/*%
+ * Maximum length of the lookup key for a pre-rendered answer: view
+ * instance, query type and flags, followed by the query name.
+ */
+#define NS_QUERY_RENDEREDKEY_SIZE (7 + DNS_NAME_MAXWIRE)
+
 /*%
  * nameserver recursion parameters, to uniquely identify a recursion
  * query; this is used to detect a recursion loop
@@ -103,6 +105,7 @@ struct ns_query {
 	unsigned int	 dboptions;
 	unsigned int	 fetchoptions;
 	dns_db_t	*gluedb;
+	unsigned int	 addsize; /*%< estimated rendered size (UDP) */
 	dns_db_t	*authdb;
 	dns_zone_t	*authzone;
 	bool		 authdbset;
@@ -140,10 +143,41 @@ struct ns_query {
 	} recursions[RECTYPE_COUNT];
 
 	ns_query_recparam_t recparam;
+	isc_nanosecs_t	    recursestart; /*%< when the fetch was started */
+
+	/*
+	 * Microseconds spent in each stage of this request, for the
+	 * slow query log; see query_latency().
+	 */
+	struct {
+		uint64_t     setup;
+		uint64_t     lookup;
+		uint64_t     recursion;
+		unsigned int lookups;
+		unsigned int fetches;
+	} timing;
 
 	dns_keytag_t root_key_sentinel_keyid;
 	bool	     root_key_sentinel_is_ta;
 	bool	     root_key_sentinel_not_ta;
+
+	/*
+	 * Pre-rendered answer state, see ns_query_storerendered().
+	 * 'db' and 'version' are not attached; they are kept open by
+	 * 'activeversions' for the lifetime of the query.
+	 */
+	struct {
+		dns_db_t	*db;
+		dns_dbversion_t *version;
+		bool		 store;
+		bool		 hasanswer;
+		isc_region_t	 data;
+		unsigned int	 ancount;
+		unsigned int	 nscount;
+		unsigned int	 arcount;
+		unsigned int	 keylen;
+		unsigned char	 key[NS_QUERY_RENDEREDKEY_SIZE];
+	} rendered;
 };
 
 #define NS_QUERYATTR_RECURSIONOK     0x000001
@@ -299,6 +333,18 @@ ns_query_start(ns_client_t *client, isc_nmhandle_t *handle);
 void
 ns_query_cancel(ns_client_t *client);
 
+void
+ns_query_storerendered(ns_client_t *client, const isc_region_t *wire);
+/*%<
+ * Called by ns_client_send() after the answer, authority and
+ * additional sections of a response have been rendered without
+ * truncation into 'wire'.  If the query was marked as eligible for
+ * the zone's pre-rendered answer cache, and the response is
+ * deterministic, store a copy of 'wire' in the zone database version
+ * so that subsequent identical queries can be answered by copying it
+ * verbatim.
+ */
+
 /*
  * The following functions are expected to be used only within query.c
  * and query modules.
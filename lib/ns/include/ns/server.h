@@ -18,6 +18,7 @@
 #include <inttypes.h>
 #include <stdbool.h>
 
+#include <isc/atomic.h>
 #include <isc/fuzz.h>
 #include <isc/histo.h>
 #include <isc/log.h>
@@ -30,6 +31,7 @@
 #include <dns/acl.h>
 #include <dns/types.h>
 
+#include <ns/stats.h>
 #include <ns/types.h>
 
 #define NS_SERVER_LOGQUERIES	 0x00000001U /*%< log queries */
@@ -50,6 +52,11 @@
 #define NS_SERVER_TRANSFERSLOWLY 0x00010000U /*%< -T transferslowly */
 #define NS_SERVER_TRANSFERSTUCK	 0x00020000U /*%< -T transferstuck */
 
+/*%
+ * Number of buckets in which recursive clients are counted per network.
+ */
+#define NS_SERVER_RECURSIONPREFIXES 1024
+
 /*%
  * Type for callback function to get hostname.
  */
@@ -91,6 +98,14 @@ struct ns_server {
 	ISC_LIST(isc_quota_t) http_quotas;
 	isc_mutex_t http_quotas_lock;
 
+	/*%
+	 * Recursive clients per client network, counted in a table of
+	 * buckets indexed by a hash of the network prefix, and the number
+	 * of buckets in use.
+	 */
+	atomic_uint_fast32_t recursionprefixes[NS_SERVER_RECURSIONPREFIXES];
+	atomic_uint_fast32_t recursionnetworks;
+
 	/*% Test options and other configurables */
 	uint32_t options;
 
@@ -126,6 +141,17 @@ struct ns_server {
 	isc_histomulti_t *tcpoutstats4;
 	isc_histomulti_t *tcpinstats6;
 	isc_histomulti_t *tcpoutstats6;
+
+	isc_histomulti_t *latency[ns_latency_max];
+
+	/*% Queries slower than this many milliseconds are logged (0: off) */
+	uint32_t slowquery_ms;
+
+	/*% Pre-rendered outgoing AXFR messages */
+	isc_mutex_t xfrcache_lock;
+	ISC_LIST(ns_xfrcache_t) xfrcache;
+	size_t xfrcache_size;
+	size_t xfrcache_max;
 };
 
 struct ns_altsecret {
@@ -189,6 +215,32 @@ ns_server_getoption(ns_server_t *sctx, unsigned int option);
  *\li	'sctx' is valid.
  */
 
+void
+ns_server_recursionstarted(ns_server_t *sctx, const isc_sockaddr_t *peer);
+void
+ns_server_recursionended(ns_server_t *sctx, const isc_sockaddr_t *peer);
+/*%<
+ * Count a recursive client from the network of 'peer' (its /24 for
+ * IPv4, its /56 for IPv6) starting or ending recursion.
+ *
+ * Requires:
+ *\li	'sctx' is valid.
+ *\li	'peer' is not NULL.
+ */
+
+bool
+ns_server_recursionovershare(ns_server_t *sctx, const isc_sockaddr_t *peer);
+/*%<
+ * Returns true if the network of 'peer' holds more than an equal share
+ * of the recursive clients in use among the networks that have any;
+ * such a network is the first to lose a recursion slot when the
+ * recursive-clients quota runs short.
+ *
+ * Requires:
+ *\li	'sctx' is valid.
+ *\li	'peer' is not NULL.
+ */
+
 void
 ns_server_append_http_quota(ns_server_t *sctx, isc_quota_t *http_quota);
 /*%<
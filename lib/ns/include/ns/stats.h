@@ -115,6 +115,21 @@ enum {
 	ns_statscounter_max = 68,
 };
 
+/*%
+ * Stages of query processing whose latency is recorded in the
+ * server's histograms, in microseconds.
+ */
+typedef enum {
+	ns_latency_setup = 0,	  /*%< request received to query start */
+	ns_latency_lookup = 1,	  /*%< local database lookup */
+	ns_latency_recursion = 2, /*%< waiting for a recursive fetch */
+	ns_latency_send = 3,	  /*%< rendering and sending the response */
+	ns_latency_total = 4,	  /*%< request received to response sent */
+	ns_latency_max = 5,
+} ns_latency_t;
+
+#define NS_LATENCY_SIGBITS 3
+
 void
 ns_stats_attach(ns_stats_t *stats, ns_stats_t **statsp);
 
@@ -27,6 +27,7 @@ typedef struct ns_query	       ns_query_t;
 typedef struct ns_server       ns_server_t;
 typedef struct ns_stats	       ns_stats_t;
 typedef struct ns_hookasync    ns_hookasync_t;
+typedef struct ns_xfrcache     ns_xfrcache_t;
 
 typedef enum { ns_cookiealg_siphash24 } ns_cookiealg_t;
 
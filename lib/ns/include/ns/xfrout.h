@@ -28,3 +28,15 @@
 
 void
 ns_xfr_start(ns_client_t *client, dns_rdatatype_t xfrtype);
+
+void
+ns_xfr_setcachesize(ns_server_t *sctx, size_t size);
+/*%<
+ * Set the amount of memory that may be used to keep the messages of
+ * outgoing AXFRs for reuse by later transfers of the same zone
+ * version.  Zero disables the cache.  Cached transfers that no longer
+ * fit are discarded; transfers still sending them are not affected.
+ *
+ * Requires:
+ *\li	'sctx' is valid.
+ */
@@ -44,6 +44,8 @@
 
 #if defined(HAVE_LINUX_NETLINK_H) && defined(HAVE_LINUX_RTNETLINK_H)
 #define LINUX_NETLINK_AVAILABLE
+#include <net/if.h>
+
 #include <linux/netlink.h>
 #include <linux/rtnetlink.h>
 #if defined(RTM_NEWADDR) && defined(RTM_DELADDR)
@@ -61,6 +63,15 @@
 #define IFMGR_COMMON_LOGARGS \
 	ns_lctx, NS_LOGCATEGORY_NETWORK, NS_LOGMODULE_INTERFACEMGR
 
+#ifdef LINUX_NETLINK_AVAILABLE
+/*% an address found by the last interface scan */
+typedef struct ns_ifaddr ns_ifaddr_t;
+struct ns_ifaddr {
+	isc_interface_t interface;
+	ISC_LINK(ns_ifaddr_t) link;
+};
+#endif /* LINUX_NETLINK_AVAILABLE */
+
 /*% nameserver interface manager structure */
 struct ns_interfacemgr {
 	unsigned int magic; /*%< Magic number */
@@ -82,8 +93,33 @@ struct ns_interfacemgr {
 	atomic_bool shuttingdown;    /*%< Interfacemgr shutting down */
 	ns_clientmgr_t **clientmgrs; /*%< Client managers */
 	isc_nmhandle_t *route;
+#ifdef LINUX_NETLINK_AVAILABLE
+	/*
+	 * The addresses found by the last full scan, kept up to date
+	 * from the routing socket.  Only used from the main loop.
+	 */
+	ISC_LIST(ns_ifaddr_t) addrs;
+	bool addrs_valid;
+#endif /* LINUX_NETLINK_AVAILABLE */
 };
 
+/*%
+ * State shared by the addresses examined during one scan.
+ */
+typedef struct scan_ctx {
+	bool verbose;
+	bool config;
+	bool scan_ipv4;
+	bool scan_ipv6;
+	bool ipv6only;
+	bool ipv6pktinfo;
+	bool log_explicit;
+	bool tried_listening;
+	bool all_addresses_in_use;
+	dns_acl_t *localhost; /*%< NULL if not rebuilding the ACLs */
+	dns_acl_t *localnets;
+} scan_ctx_t;
+
 static void
 purge_old_interfaces(ns_interfacemgr_t *mgr);
 
@@ -91,111 +127,13 @@ static void
 clearlistenon(ns_interfacemgr_t *mgr);
 
 static bool
-need_rescan(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
-	if (rtm->MSGTYPE != RTM_NEWADDR && rtm->MSGTYPE != RTM_DELADDR) {
-		return (false);
-	}
-
-#ifndef LINUX_NETLINK_AVAILABLE
-	UNUSED(mgr);
-	UNUSED(len);
-	/* On most systems, any NEWADDR or DELADDR means we rescan */
-	return (true);
-#else  /* LINUX_NETLINK_AVAILABLE */
-	/* ...but on linux we need to check the messages more carefully */
-	for (struct MSGHDR *nlh = rtm;
-	     NLMSG_OK(nlh, len) && nlh->nlmsg_type != NLMSG_DONE;
-	     nlh = NLMSG_NEXT(nlh, len))
-	{
-		struct ifaddrmsg *ifa = (struct ifaddrmsg *)NLMSG_DATA(nlh);
-		struct rtattr *rth = IFA_RTA(ifa);
-		size_t rtl = IFA_PAYLOAD(nlh);
+route_update(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len);
 
-		while (rtl > 0 && RTA_OK(rth, rtl)) {
-			/*
-			 * Look for IFA_ADDRESS to detect IPv6 interface
-			 * state changes.
-			 */
-			if (rth->rta_type == IFA_ADDRESS &&
-			    ifa->ifa_family == AF_INET6)
-			{
-				bool existed = false;
-				bool was_listening = false;
-				isc_netaddr_t addr = { 0 };
-				ns_interface_t *ifp = NULL;
-
-				isc_netaddr_fromin6(&addr, RTA_DATA(rth));
-				INSIST(isc_netaddr_getzone(&addr) == 0);
-
-				/*
-				 * Check whether we were listening on the
-				 * address. We need to do this as the
-				 * Linux kernel seems to issue messages
-				 * containing IFA_ADDRESS far more often
-				 * than the actual state changes (on
-				 * router advertisements?)
-				 */
-				LOCK(&mgr->lock);
-				for (ifp = ISC_LIST_HEAD(mgr->interfaces);
-				     ifp != NULL;
-				     ifp = ISC_LIST_NEXT(ifp, link))
-				{
-					isc_netaddr_t tmp = { 0 };
-					isc_netaddr_fromsockaddr(&tmp,
-								 &ifp->addr);
-					if (tmp.family != AF_INET6) {
-						continue;
-					}
-
-					/*
-					 * We have to nullify the zone (IPv6
-					 * scope ID) because we haven't got one
-					 * from the kernel. Otherwise match
-					 * could fail even for an existing
-					 * address.
-					 */
-					isc_netaddr_setzone(&tmp, 0);
-					if (isc_netaddr_equal(&tmp, &addr)) {
-						was_listening = LISTENING(ifp);
-						existed = true;
-						break;
-					}
-				}
-				UNLOCK(&mgr->lock);
-
-				/*
-				 * Do rescan if the state of the interface
-				 * has changed.
-				 */
-				if ((!existed && rtm->MSGTYPE == RTM_NEWADDR) ||
-				    (existed && was_listening &&
-				     rtm->MSGTYPE == RTM_DELADDR))
-				{
-					return (true);
-				}
-			} else if (rth->rta_type == IFA_ADDRESS &&
-				   ifa->ifa_family == AF_INET)
-			{
-				/*
-				 * It seems that the IPv4 P2P link state
-				 * has changed.
-				 */
-				return (true);
-			} else if (rth->rta_type == IFA_LOCAL) {
-				/*
-				 * Local address state has changed - do
-				 * rescan.
-				 */
-				return (true);
-			}
-			rth = RTA_NEXT(rth, rtl);
-		}
-	}
+#ifdef LINUX_NETLINK_AVAILABLE
+static void
+clearaddrs(ns_interfacemgr_t *mgr);
 #endif /* LINUX_NETLINK_AVAILABLE */
 
-	return (false);
-}
-
 static void
 route_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	   void *arg) {
@@ -241,7 +179,7 @@ route_recv(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 
 	REQUIRE(mgr->route != NULL);
 
-	if (need_rescan(mgr, rtm, rtmlen) && mgr->sctx->interface_auto) {
+	if (mgr->sctx->interface_auto && route_update(mgr, rtm, rtmlen)) {
 		ns_interfacemgr_scan(mgr, false, false);
 	}
 
@@ -298,6 +236,9 @@ ns_interfacemgr_create(isc_mem_t *mctx, ns_server_t *sctx,
 
 	ISC_LIST_INIT(mgr->interfaces);
 	ISC_LIST_INIT(mgr->listenon);
+#ifdef LINUX_NETLINK_AVAILABLE
+	ISC_LIST_INIT(mgr->addrs);
+#endif /* LINUX_NETLINK_AVAILABLE */
 
 	/*
 	 * The listen-on lists are initially empty.
@@ -361,6 +302,9 @@ ns_interfacemgr_destroy(ns_interfacemgr_t *mgr) {
 	ns_listenlist_detach(&mgr->listenon4);
 	ns_listenlist_detach(&mgr->listenon6);
 	clearlistenon(mgr);
+#ifdef LINUX_NETLINK_AVAILABLE
+	clearaddrs(mgr);
+#endif /* LINUX_NETLINK_AVAILABLE */
 	isc_mutex_destroy(&mgr->lock);
 	for (size_t i = 0; i < mgr->ncpus; i++) {
 		ns_clientmgr_detach(&mgr->clientmgrs[i]);
@@ -1071,28 +1015,19 @@ interface_update_or_shutdown(ns_interfacemgr_t *mgr, ns_interface_t *ifp,
 	return (false);
 }
 
-static isc_result_t
-do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
-	isc_interfaceiter_t *iter = NULL;
-	bool scan_ipv4 = false;
-	bool scan_ipv6 = false;
-	bool ipv6only = true;
-	bool ipv6pktinfo = true;
-	isc_result_t result;
-	isc_netaddr_t zero_address, zero_address6;
-	ns_listenelt_t *le = NULL;
-	isc_sockaddr_t listen_addr;
-	ns_interface_t *ifp = NULL;
-	bool log_explicit = false;
-	bool dolistenon;
-	char sabuf[ISC_SOCKADDR_FORMATSIZE];
-	bool tried_listening;
-	bool all_addresses_in_use;
-	dns_acl_t *localhost = NULL;
-	dns_acl_t *localnets = NULL;
+static void
+scan_ctx_init(ns_interfacemgr_t *mgr, scan_ctx_t *ctx, bool verbose,
+	      bool config) {
+	*ctx = (scan_ctx_t){
+		.verbose = verbose,
+		.config = config,
+		.ipv6only = true,
+		.ipv6pktinfo = true,
+		.all_addresses_in_use = true,
+	};
 
 	if (isc_net_probeipv6() == ISC_R_SUCCESS) {
-		scan_ipv6 = true;
+		ctx->scan_ipv6 = true;
 	} else if ((mgr->sctx->options & NS_SERVER_DISABLE6) == 0) {
 		isc_log_write(IFMGR_COMMON_LOGARGS,
 			      verbose ? ISC_LOG_INFO : ISC_LOG_DEBUG(1),
@@ -1100,13 +1035,490 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	}
 
 	if (isc_net_probeipv4() == ISC_R_SUCCESS) {
-		scan_ipv4 = true;
+		ctx->scan_ipv4 = true;
 	} else if ((mgr->sctx->options & NS_SERVER_DISABLE4) == 0) {
 		isc_log_write(IFMGR_COMMON_LOGARGS,
 			      verbose ? ISC_LOG_INFO : ISC_LOG_DEBUG(1),
 			      "no IPv4 interfaces found");
 	}
 
+	if (ctx->scan_ipv6 && isc_net_probe_ipv6only() != ISC_R_SUCCESS) {
+		ctx->ipv6only = false;
+		ctx->log_explicit = true;
+	}
+	if (ctx->scan_ipv6 && isc_net_probe_ipv6pktinfo() != ISC_R_SUCCESS) {
+		ctx->ipv6pktinfo = false;
+		ctx->log_explicit = true;
+	}
+}
+
+static bool
+interface_wanted(scan_ctx_t *ctx, isc_interface_t *interface) {
+	isc_netaddr_t zero_address;
+	unsigned int family = interface->address.family;
+
+	if (family != AF_INET && family != AF_INET6) {
+		return (false);
+	}
+	if (!ctx->scan_ipv4 && family == AF_INET) {
+		return (false);
+	}
+	if (!ctx->scan_ipv6 && family == AF_INET6) {
+		return (false);
+	}
+
+	/*
+	 * Test for the address being nonzero rather than testing
+	 * INTERFACE_F_UP, because on some systems the latter
+	 * follows the media state and we could end up ignoring
+	 * the interface for an entire rescan interval due to
+	 * a temporary media glitch at rescan time.
+	 */
+	if (family == AF_INET) {
+		isc_netaddr_any(&zero_address);
+	} else {
+		isc_netaddr_any6(&zero_address);
+	}
+	return (!isc_netaddr_equal(&interface->address, &zero_address));
+}
+
+/*%
+ * Set up the listeners for the address of 'interface' that the
+ * listen-on statements ask for, and add it to the localhost and
+ * localnets ACLs being built in 'ctx'.
+ */
+static void
+scan_interface(ns_interfacemgr_t *mgr, scan_ctx_t *ctx,
+	       isc_interface_t *interface) {
+	isc_result_t result;
+	unsigned int family = interface->address.family;
+	ns_listenlist_t *ll = NULL;
+	ns_listenelt_t *le = NULL;
+	ns_interface_t *ifp = NULL;
+	bool dolistenon = true;
+	char sabuf[ISC_SOCKADDR_FORMATSIZE];
+
+	/*
+	 * If running with -T fixedlocal, then we only
+	 * want 127.0.0.1 and ::1 in the localhost ACL.
+	 */
+	if (ctx->localhost != NULL &&
+	    ((mgr->sctx->options & NS_SERVER_FIXEDLOCAL) == 0 ||
+	     isc_netaddr_isloopback(&interface->address)))
+	{
+		result = setup_locals(interface, ctx->localhost,
+				      ctx->localnets);
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "ignoring %s interface %s: %s",
+				      (family == AF_INET) ? "IPv4" : "IPv6",
+				      interface->name,
+				      isc_result_totext(result));
+			return;
+		}
+	}
+
+	ll = (family == AF_INET) ? mgr->listenon4 : mgr->listenon6;
+	for (le = ISC_LIST_HEAD(ll->elts); le != NULL;
+	     le = ISC_LIST_NEXT(le, link))
+	{
+		int match;
+		bool addr_in_use = false;
+		bool ipv6_wildcard = false;
+		isc_sockaddr_t listen_sockaddr;
+
+		isc_sockaddr_fromnetaddr(&listen_sockaddr, &interface->address,
+					 le->port);
+
+		/*
+		 * See if the address matches the listen-on statement;
+		 * if not, ignore the interface, but store it in
+		 * the interface table so we know we've seen it
+		 * before.
+		 */
+		(void)dns_acl_match(&interface->address, NULL, le->acl,
+				    mgr->aclenv, &match, NULL);
+		if (match <= 0) {
+			ifp = find_matching_interface(mgr, &listen_sockaddr);
+			if (ifp != NULL && !LISTENING(ifp)) {
+				LOCK(&mgr->lock);
+				ifp->generation = mgr->generation;
+				UNLOCK(&mgr->lock);
+			} else if (ifp == NULL ||
+				   ifp->generation != mgr->generation)
+			{
+				ifp = NULL;
+				ns_interface_create(mgr, &listen_sockaddr,
+						    interface->name, &ifp);
+			}
+			continue;
+		}
+
+		if (dolistenon) {
+			setup_listenon(mgr, interface, le->port);
+			dolistenon = false;
+		}
+
+		/*
+		 * The case of "any" IPv6 address will require
+		 * special considerations later, so remember it.
+		 */
+		if (family == AF_INET6 && ctx->ipv6only && ctx->ipv6pktinfo &&
+		    listenon_is_ip6_any(le))
+		{
+			ipv6_wildcard = true;
+		}
+
+		ifp = find_matching_interface(mgr, &listen_sockaddr);
+		if (ifp != NULL) {
+			bool cont = interface_update_or_shutdown(mgr, ifp, le,
+								 ctx->config);
+			if (cont) {
+				continue;
+			}
+		}
+
+		if (ipv6_wildcard) {
+			continue;
+		}
+
+		if (ctx->log_explicit && family == AF_INET6 &&
+		    listenon_is_ip6_any(le))
+		{
+			isc_log_write(IFMGR_COMMON_LOGARGS,
+				      ctx->verbose ? ISC_LOG_INFO
+						   : ISC_LOG_DEBUG(1),
+				      "IPv6 socket API is "
+				      "incomplete; explicitly "
+				      "binding to each IPv6 "
+				      "address separately");
+			ctx->log_explicit = false;
+		}
+		isc_sockaddr_format(&listen_sockaddr, sabuf, sizeof(sabuf));
+		isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_INFO,
+			      "listening on %s interface "
+			      "%s, %s",
+			      (family == AF_INET) ? "IPv4" : "IPv6",
+			      interface->name, sabuf);
+
+		result = interface_setup(mgr, &listen_sockaddr,
+					 interface->name, &ifp, le,
+					 &addr_in_use);
+
+		ctx->tried_listening = true;
+		if (!addr_in_use) {
+			ctx->all_addresses_in_use = false;
+		}
+
+		if (result != ISC_R_SUCCESS) {
+			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
+				      "creating %s interface "
+				      "%s failed; interface ignored",
+				      (family == AF_INET) ? "IPv4" : "IPv6",
+				      interface->name);
+		}
+		/* Continue. */
+	}
+}
+
+#ifdef LINUX_NETLINK_AVAILABLE
+static void
+clearaddrs(ns_interfacemgr_t *mgr) {
+	ns_ifaddr_t *ia = NULL;
+
+	mgr->addrs_valid = false;
+	while ((ia = ISC_LIST_HEAD(mgr->addrs)) != NULL) {
+		ISC_LIST_UNLINK(mgr->addrs, ia, link);
+		isc_mem_put(mgr->mctx, ia, sizeof(*ia));
+	}
+}
+
+static void
+addaddr(ns_interfacemgr_t *mgr, isc_interface_t *interface) {
+	ns_ifaddr_t *ia = isc_mem_get(mgr->mctx, sizeof(*ia));
+
+	*ia = (ns_ifaddr_t){
+		.interface = *interface,
+		.link = ISC_LINK_INITIALIZER,
+	};
+	ISC_LIST_APPEND(mgr->addrs, ia, link);
+}
+
+static bool
+findaddr(ns_interfacemgr_t *mgr, isc_netaddr_t *addr) {
+	for (ns_ifaddr_t *ia = ISC_LIST_HEAD(mgr->addrs); ia != NULL;
+	     ia = ISC_LIST_NEXT(ia, link))
+	{
+		if (isc_netaddr_equal(&ia->interface.address, addr)) {
+			return (true);
+		}
+	}
+	return (false);
+}
+
+/*%
+ * Forget the address 'addr', and stop listening on it on any port.
+ * Returns true if the address was known.
+ */
+static bool
+removeaddr(ns_interfacemgr_t *mgr, isc_netaddr_t *addr) {
+	ISC_LIST(ns_interface_t) interfaces;
+	ns_ifaddr_t *ia = NULL, *next_ia = NULL;
+	ns_interface_t *ifp = NULL, *next = NULL;
+	isc_sockaddr_t *sa = NULL, *next_sa = NULL;
+	isc_netaddr_t na;
+	bool found = false;
+
+	for (ia = ISC_LIST_HEAD(mgr->addrs); ia != NULL; ia = next_ia) {
+		next_ia = ISC_LIST_NEXT(ia, link);
+		if (isc_netaddr_equal(&ia->interface.address, addr)) {
+			ISC_LIST_UNLINK(mgr->addrs, ia, link);
+			isc_mem_put(mgr->mctx, ia, sizeof(*ia));
+			found = true;
+		}
+	}
+
+	ISC_LIST_INIT(interfaces);
+
+	LOCK(&mgr->lock);
+	for (ifp = ISC_LIST_HEAD(mgr->interfaces); ifp != NULL; ifp = next) {
+		next = ISC_LIST_NEXT(ifp, link);
+		isc_netaddr_fromsockaddr(&na, &ifp->addr);
+		if (isc_netaddr_equal(&na, addr)) {
+			ISC_LIST_UNLINK(mgr->interfaces, ifp, link);
+			ISC_LIST_APPEND(interfaces, ifp, link);
+		}
+	}
+	for (sa = ISC_LIST_HEAD(mgr->listenon); sa != NULL; sa = next_sa) {
+		next_sa = ISC_LIST_NEXT(sa, link);
+		isc_netaddr_fromsockaddr(&na, sa);
+		if (isc_netaddr_equal(&na, addr)) {
+			ISC_LIST_UNLINK(mgr->listenon, sa, link);
+			isc_mem_put(mgr->mctx, sa, sizeof(*sa));
+		}
+	}
+	UNLOCK(&mgr->lock);
+
+	for (ifp = ISC_LIST_HEAD(interfaces); ifp != NULL; ifp = next) {
+		next = ISC_LIST_NEXT(ifp, link);
+		if (LISTENING(ifp)) {
+			log_interface_shutdown(ifp);
+			ns_interface_shutdown(ifp);
+		}
+		ISC_LIST_UNLINK(interfaces, ifp, link);
+		interface_destroy(&ifp);
+	}
+
+	return (found);
+}
+
+/*%
+ * Rebuild the localhost and localnets ACLs from the known addresses.
+ */
+static void
+rebuild_locals(ns_interfacemgr_t *mgr) {
+	dns_acl_t *localhost = NULL;
+	dns_acl_t *localnets = NULL;
+
+	dns_acl_create(mgr->mctx, 0, &localhost);
+	dns_acl_create(mgr->mctx, 0, &localnets);
+
+	for (ns_ifaddr_t *ia = ISC_LIST_HEAD(mgr->addrs); ia != NULL;
+	     ia = ISC_LIST_NEXT(ia, link))
+	{
+		if ((mgr->sctx->options & NS_SERVER_FIXEDLOCAL) != 0 &&
+		    !isc_netaddr_isloopback(&ia->interface.address))
+		{
+			continue;
+		}
+		(void)setup_locals(&ia->interface, localhost, localnets);
+	}
+
+	dns_aclenv_set(mgr->aclenv, localhost, localnets);
+
+	dns_acl_detach(&localnets);
+	dns_acl_detach(&localhost);
+}
+
+/*%
+ * Fill in 'interface' from an RTM_NEWADDR or RTM_DELADDR message the
+ * same way getifaddrs() would.  Returns false if the message cannot
+ * be parsed.
+ */
+static bool
+route_getinterface(struct nlmsghdr *nlh, isc_interface_t *interface) {
+	struct ifaddrmsg *ifa = NLMSG_DATA(nlh);
+	struct rtattr *rth = IFA_RTA(ifa);
+	size_t rtl = IFA_PAYLOAD(nlh);
+	struct rtattr *address = NULL;
+	unsigned int prefixlen = ifa->ifa_prefixlen;
+	unsigned char mask[16] = { 0 };
+
+	if (nlh->nlmsg_len < NLMSG_LENGTH(sizeof(*ifa))) {
+		return (false);
+	}
+
+	while (rtl > 0 && RTA_OK(rth, rtl)) {
+		if (rth->rta_type == IFA_LOCAL ||
+		    (rth->rta_type == IFA_ADDRESS && address == NULL))
+		{
+			address = rth;
+		}
+		rth = RTA_NEXT(rth, rtl);
+	}
+	if (address == NULL) {
+		return (false);
+	}
+
+	*interface = (isc_interface_t){ .af = ifa->ifa_family };
+	if (if_indextoname(ifa->ifa_index, interface->name) == NULL) {
+		snprintf(interface->name, sizeof(interface->name), "if%u",
+			 ifa->ifa_index);
+	}
+
+	for (size_t i = 0; i < sizeof(mask) && prefixlen > 0; i++) {
+		if (prefixlen >= 8) {
+			mask[i] = 0xff;
+			prefixlen -= 8;
+		} else {
+			mask[i] = (0xff << (8 - prefixlen)) & 0xff;
+			prefixlen = 0;
+		}
+	}
+
+	switch (ifa->ifa_family) {
+	case AF_INET:
+		if (RTA_PAYLOAD(address) < sizeof(struct in_addr) ||
+		    ifa->ifa_prefixlen > 32)
+		{
+			return (false);
+		}
+		isc_netaddr_fromin(&interface->address, RTA_DATA(address));
+		isc_netaddr_fromin(&interface->netmask, (void *)mask);
+		break;
+	case AF_INET6:
+		if (RTA_PAYLOAD(address) < sizeof(struct in6_addr) ||
+		    ifa->ifa_prefixlen > 128)
+		{
+			return (false);
+		}
+		isc_netaddr_fromin6(&interface->address, RTA_DATA(address));
+		if (isc_netaddr_islinklocal(&interface->address)) {
+			isc_netaddr_setzone(&interface->address,
+					    ifa->ifa_index);
+		}
+		isc_netaddr_fromin6(&interface->netmask, (void *)mask);
+		break;
+	default:
+		return (false);
+	}
+
+	interface->flags = INTERFACE_F_UP;
+	return (true);
+}
+
+/*%
+ * Apply the address changes reported by the routing socket: open the
+ * listeners for an added address and close those of a removed one,
+ * without enumerating all the interfaces of the system.  Returns true
+ * if a full scan is needed instead, because no full scan has succeeded
+ * yet or a message could not be understood.
+ */
+static bool
+route_update(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
+	scan_ctx_t ctx;
+	bool changed = false;
+
+	if (!mgr->addrs_valid) {
+		return (true);
+	}
+
+	scan_ctx_init(mgr, &ctx, false, false);
+
+	/*
+	 * Update the known addresses, and the localhost and localnets
+	 * ACLs built from them, in a first pass, so that listen-on
+	 * statements using these ACLs see the new addresses in the
+	 * second pass.
+	 */
+	for (int pass = 0; pass < 2; pass++) {
+		size_t rtl = len;
+
+		for (struct MSGHDR *nlh = rtm;
+		     NLMSG_OK(nlh, rtl) && nlh->nlmsg_type != NLMSG_DONE;
+		     nlh = NLMSG_NEXT(nlh, rtl))
+		{
+			isc_interface_t interface;
+
+			switch (nlh->nlmsg_type) {
+			case RTM_NEWADDR:
+			case RTM_DELADDR:
+				break;
+			case NLMSG_ERROR:
+			case NLMSG_OVERRUN:
+				return (true);
+			default:
+				continue;
+			}
+
+			if (!route_getinterface(nlh, &interface)) {
+				return (true);
+			}
+			if (!interface_wanted(&ctx, &interface)) {
+				continue;
+			}
+
+			if (pass == 1) {
+				/*
+				 * The kernel repeats RTM_NEWADDR for
+				 * known addresses (on router
+				 * advertisements, or when duplicate
+				 * address detection completes); scanning
+				 * the address again only retries the
+				 * listeners that could not be opened.
+				 */
+				if (nlh->nlmsg_type == RTM_NEWADDR) {
+					scan_interface(mgr, &ctx, &interface);
+				}
+			} else if (nlh->nlmsg_type == RTM_DELADDR) {
+				if (removeaddr(mgr, &interface.address)) {
+					changed = true;
+				}
+			} else if (!findaddr(mgr, &interface.address)) {
+				addaddr(mgr, &interface);
+				changed = true;
+			}
+		}
+
+		if (pass == 0 && changed) {
+			rebuild_locals(mgr);
+		}
+	}
+
+	return (false);
+}
+#else  /* LINUX_NETLINK_AVAILABLE */
+static bool
+route_update(ns_interfacemgr_t *mgr, struct MSGHDR *rtm, size_t len) {
+	UNUSED(mgr);
+	UNUSED(len);
+
+	/* On most systems, any NEWADDR or DELADDR means we rescan */
+	return (rtm->MSGTYPE == RTM_NEWADDR || rtm->MSGTYPE == RTM_DELADDR);
+}
+#endif /* LINUX_NETLINK_AVAILABLE */
+
+static isc_result_t
+do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
+	isc_interfaceiter_t *iter = NULL;
+	isc_result_t result;
+	ns_listenelt_t *le = NULL;
+	isc_sockaddr_t listen_addr;
+	ns_interface_t *ifp = NULL;
+	scan_ctx_t ctx;
+
+	scan_ctx_init(mgr, &ctx, verbose, config);
+
 	/*
 	 * A special, but typical case; listen-on-v6 { any; }.
 	 * When we can make the socket IPv6-only, open a single wildcard
@@ -1115,15 +1527,7 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 	 * packets as the form of mapped addresses unintentionally
 	 * unless explicitly allowed.
 	 */
-	if (scan_ipv6 && isc_net_probe_ipv6only() != ISC_R_SUCCESS) {
-		ipv6only = false;
-		log_explicit = true;
-	}
-	if (scan_ipv6 && isc_net_probe_ipv6pktinfo() != ISC_R_SUCCESS) {
-		ipv6pktinfo = false;
-		log_explicit = true;
-	}
-	if (scan_ipv6 && ipv6only && ipv6pktinfo) {
+	if (ctx.scan_ipv6 && ctx.ipv6only && ctx.ipv6pktinfo) {
 		for (le = ISC_LIST_HEAD(mgr->listenon6->elts); le != NULL;
 		     le = ISC_LIST_NEXT(le, link))
 		{
@@ -1163,195 +1567,54 @@ do_scan(ns_interfacemgr_t *mgr, bool verbose, bool config) {
 		}
 	}
 
-	isc_netaddr_any(&zero_address);
-	isc_netaddr_any6(&zero_address6);
-
 	result = isc_interfaceiter_create(mgr->mctx, &iter);
 	if (result != ISC_R_SUCCESS) {
 		return (result);
 	}
 
-	dns_acl_create(mgr->mctx, 0, &localhost);
-	dns_acl_create(mgr->mctx, 0, &localnets);
+	dns_acl_create(mgr->mctx, 0, &ctx.localhost);
+	dns_acl_create(mgr->mctx, 0, &ctx.localnets);
 
 	clearlistenon(mgr);
+#ifdef LINUX_NETLINK_AVAILABLE
+	clearaddrs(mgr);
+#endif /* LINUX_NETLINK_AVAILABLE */
 
-	tried_listening = false;
-	all_addresses_in_use = true;
 	for (result = isc_interfaceiter_first(iter); result == ISC_R_SUCCESS;
 	     result = isc_interfaceiter_next(iter))
 	{
 		isc_interface_t interface;
-		ns_listenlist_t *ll = NULL;
-		unsigned int family;
 
 		result = isc_interfaceiter_current(iter, &interface);
 		if (result != ISC_R_SUCCESS) {
 			break;
 		}
 
-		family = interface.address.family;
-		if (family != AF_INET && family != AF_INET6) {
-			continue;
-		}
-		if (!scan_ipv4 && family == AF_INET) {
-			continue;
-		}
-		if (!scan_ipv6 && family == AF_INET6) {
-			continue;
-		}
-
-		/*
-		 * Test for the address being nonzero rather than testing
-		 * INTERFACE_F_UP, because on some systems the latter
-		 * follows the media state and we could end up ignoring
-		 * the interface for an entire rescan interval due to
-		 * a temporary media glitch at rescan time.
-		 */
-		if (family == AF_INET &&
-		    isc_netaddr_equal(&interface.address, &zero_address))
-		{
-			continue;
-		}
-		if (family == AF_INET6 &&
-		    isc_netaddr_equal(&interface.address, &zero_address6))
-		{
+		if (!interface_wanted(&ctx, &interface)) {
 			continue;
 		}
 
-		/*
-		 * If running with -T fixedlocal, then we only
-		 * want 127.0.0.1 and ::1 in the localhost ACL.
-		 */
-		if (((mgr->sctx->options & NS_SERVER_FIXEDLOCAL) != 0) &&
-		    !isc_netaddr_isloopback(&interface.address))
-		{
-			goto listenon;
-		}
-
-		result = setup_locals(&interface, localhost, localnets);
-		if (result != ISC_R_SUCCESS) {
-			goto ignore_interface;
-		}
-
-	listenon:
-		ll = (family == AF_INET) ? mgr->listenon4 : mgr->listenon6;
-		dolistenon = true;
-		for (le = ISC_LIST_HEAD(ll->elts); le != NULL;
-		     le = ISC_LIST_NEXT(le, link))
-		{
-			int match;
-			bool addr_in_use = false;
-			bool ipv6_wildcard = false;
-			isc_sockaddr_t listen_sockaddr;
-
-			isc_sockaddr_fromnetaddr(&listen_sockaddr,
-						 &interface.address, le->port);
-
-			/*
-			 * See if the address matches the listen-on statement;
-			 * if not, ignore the interface, but store it in
-			 * the interface table so we know we've seen it
-			 * before.
-			 */
-			(void)dns_acl_match(&interface.address, NULL, le->acl,
-					    mgr->aclenv, &match, NULL);
-			if (match <= 0) {
-				ns_interface_t *new = NULL;
-				ns_interface_create(mgr, &listen_sockaddr,
-						    interface.name, &new);
-				continue;
-			}
-
-			if (dolistenon) {
-				setup_listenon(mgr, &interface, le->port);
-				dolistenon = false;
-			}
-
-			/*
-			 * The case of "any" IPv6 address will require
-			 * special considerations later, so remember it.
-			 */
-			if (family == AF_INET6 && ipv6only && ipv6pktinfo &&
-			    listenon_is_ip6_any(le))
-			{
-				ipv6_wildcard = true;
-			}
-
-			ifp = find_matching_interface(mgr, &listen_sockaddr);
-			if (ifp != NULL) {
-				bool cont = interface_update_or_shutdown(
-					mgr, ifp, le, config);
-				if (cont) {
-					continue;
-				}
-			}
-
-			if (ipv6_wildcard) {
-				continue;
-			}
-
-			if (log_explicit && family == AF_INET6 &&
-			    listenon_is_ip6_any(le))
-			{
-				isc_log_write(IFMGR_COMMON_LOGARGS,
-					      verbose ? ISC_LOG_INFO
-						      : ISC_LOG_DEBUG(1),
-					      "IPv6 socket API is "
-					      "incomplete; explicitly "
-					      "binding to each IPv6 "
-					      "address separately");
-				log_explicit = false;
-			}
-			isc_sockaddr_format(&listen_sockaddr, sabuf,
-					    sizeof(sabuf));
-			isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_INFO,
-				      "listening on %s interface "
-				      "%s, %s",
-				      (family == AF_INET) ? "IPv4" : "IPv6",
-				      interface.name, sabuf);
-
-			result = interface_setup(mgr, &listen_sockaddr,
-						 interface.name, &ifp, le,
-						 &addr_in_use);
-
-			tried_listening = true;
-			if (!addr_in_use) {
-				all_addresses_in_use = false;
-			}
-
-			if (result != ISC_R_SUCCESS) {
-				isc_log_write(
-					IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
-					"creating %s interface "
-					"%s failed; interface ignored",
-					(family == AF_INET) ? "IPv4" : "IPv6",
-					interface.name);
-			}
-			/* Continue. */
-		}
-		continue;
-
-	ignore_interface:
-		isc_log_write(IFMGR_COMMON_LOGARGS, ISC_LOG_ERROR,
-			      "ignoring %s interface %s: %s",
-			      (family == AF_INET) ? "IPv4" : "IPv6",
-			      interface.name, isc_result_totext(result));
-		continue;
+#ifdef LINUX_NETLINK_AVAILABLE
+		addaddr(mgr, &interface);
+#endif /* LINUX_NETLINK_AVAILABLE */
+		scan_interface(mgr, &ctx, &interface);
 	}
 	if (result != ISC_R_NOMORE) {
 		UNEXPECTED_ERROR("interface iteration failed: %s",
 				 isc_result_totext(result));
 	} else {
-		result = ((tried_listening && all_addresses_in_use)
+		result = ((ctx.tried_listening && ctx.all_addresses_in_use)
 				  ? ISC_R_ADDRINUSE
 				  : ISC_R_SUCCESS);
+#ifdef LINUX_NETLINK_AVAILABLE
+		mgr->addrs_valid = true;
+#endif /* LINUX_NETLINK_AVAILABLE */
 	}
 
-	dns_aclenv_set(mgr->aclenv, localhost, localnets);
+	dns_aclenv_set(mgr->aclenv, ctx.localhost, ctx.localnets);
 
-	dns_acl_detach(&localnets);
-	dns_acl_detach(&localhost);
+	dns_acl_detach(&ctx.localnets);
+	dns_acl_detach(&ctx.localhost);
 
 	isc_interfaceiter_destroy(&iter);
 	return (result);
@@ -14,6 +14,7 @@
 /*! \file */
 
 #include <stdbool.h>
+#include <string.h>
 
 #include <isc/mem.h>
 #include <isc/netmgr.h>
@@ -151,6 +152,28 @@ listenelt_create(isc_mem_t *mctx, in_port_t port, dns_acl_t *acl,
 					sslctx, tls_params->session_tickets);
 			}
 
+			/*
+			 * Share the session ticket keys between all the
+			 * contexts created for this 'tls' statement, so that
+			 * sessions can be resumed regardless of the address
+			 * family, and across reconfigurations.
+			 */
+			if (tls_params->ticketkeys != NULL) {
+				const char *ca_file = tls_params->ca_file != NULL
+							      ? tls_params->ca_file
+							      : "";
+				size_t len = strlen(tls_params->name) +
+					     strlen(ca_file) + 2;
+				char *context = isc_mem_get(mctx, len);
+
+				snprintf(context, len, "%s:%s",
+					 tls_params->name, ca_file);
+				isc_tlsctx_set_ticketkeys(
+					sslctx, tls_params->ticketkeys,
+					context);
+				isc_mem_put(mctx, context, len);
+			}
+
 #ifdef HAVE_LIBNGHTTP2
 			if (is_http) {
 				isc_tlsctx_enable_http2server_alpn(sslctx);
@@ -34,6 +34,8 @@ isc_logcategory_t ns_categories[] = { { "client", 0 },
 				      { "query-errors", 0 },
 				      { "trust-anchor-telemetry", 0 },
 				      { "serve-stale", 0 },
+				      { "query-records", 0 },
+				      { "slow-queries", 0 },
 				      { NULL, 0 } };
 
 /*%
@@ -20,6 +20,7 @@
 #include <string.h>
 
 #include <isc/async.h>
+#include <isc/hash.h>
 #include <isc/hex.h>
 #include <isc/mem.h>
 #include <isc/once.h>
@@ -486,6 +487,9 @@ query_ncache(query_ctx_t *qctx, isc_result_t result);
 static isc_result_t
 query_coveringnsec(query_ctx_t *qctx);
 
+static bool
+query_synthnsec3(query_ctx_t *qctx);
+
 static isc_result_t
 query_zerottl_refetch(query_ctx_t *qctx);
 
@@ -561,9 +565,79 @@ inc_stats(ns_client_t *client, isc_statscounter_t counter) {
 	}
 }
 
+/*%
+ * Record the time taken by a stage of query processing, and add it to
+ * the totals of this request.
+ */
+static uint64_t
+query_latency(ns_client_t *client, ns_latency_t stage, isc_nanosecs_t start) {
+	isc_nanosecs_t now = isc_time_monotonic();
+	uint64_t us = (now > start) ? (now - start) / NS_PER_US : 0;
+
+	isc_histomulti_inc(client->manager->sctx->latency[stage], us);
+
+	switch (stage) {
+	case ns_latency_lookup:
+		client->query.timing.lookup += us;
+		client->query.timing.lookups++;
+		break;
+	case ns_latency_recursion:
+		client->query.timing.recursion += us;
+		client->query.timing.fetches++;
+		break;
+	default:
+		break;
+	}
+
+	return (us);
+}
+
+/*%
+ * Record the time since the request was received.
+ */
+static uint64_t
+query_reqlatency(ns_client_t *client, ns_latency_t stage) {
+	isc_time_t now = isc_time_now();
+	uint64_t us = isc_time_microdiff(&now, &client->requesttime);
+
+	isc_histomulti_inc(client->manager->sctx->latency[stage], us);
+
+	return (us);
+}
+
+/*%
+ * Log a request that took longer than "slow-query-threshold", with the
+ * time spent in each stage in milliseconds.
+ */
+static void
+query_logslow(ns_client_t *client, uint64_t send, uint64_t total) {
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
+
+	if (!isc_log_wouldlog(ns_lctx, ISC_LOG_INFO)) {
+		return;
+	}
+
+	dns_rdatatype_format(client->query.qtype, typebuf, sizeof(typebuf));
+	ns_client_log(client, NS_LOGCATEGORY_SLOW_QUERIES, NS_LOGMODULE_QUERY,
+		      ISC_LOG_INFO,
+		      "slow query %s: %.3f ms (setup %.3f, lookup %.3f in "
+		      "%u, recursion %.3f in %u, send %.3f)",
+		      typebuf, total / 1000.0,
+		      client->query.timing.setup / 1000.0,
+		      client->query.timing.lookup / 1000.0,
+		      client->query.timing.lookups,
+		      client->query.timing.recursion / 1000.0,
+		      client->query.timing.fetches, send / 1000.0);
+}
+
 static void
 query_send(ns_client_t *client) {
 	isc_statscounter_t counter;
+	isc_nanosecs_t start;
+	uint64_t send, total;
+	uint32_t slowquery_ms;
+
+	LIBNS_QUERY_SEND(client);
 
 	if ((client->message->flags & DNS_MESSAGEFLAG_AA) == 0) {
 		inc_stats(client, ns_statscounter_nonauthans);
@@ -573,7 +647,15 @@ query_send(ns_client_t *client) {
 
 	if (client->message->rcode == dns_rcode_noerror) {
 		dns_section_t answer = DNS_SECTION_ANSWER;
-		if (ISC_LIST_EMPTY(client->message->sections[answer])) {
+		if (client->query.rendered.data.base != NULL) {
+			if (client->query.rendered.hasanswer) {
+				counter = ns_statscounter_success;
+			} else if (client->query.isreferral) {
+				counter = ns_statscounter_referral;
+			} else {
+				counter = ns_statscounter_nxrrset;
+			}
+		} else if (ISC_LIST_EMPTY(client->message->sections[answer])) {
 			if (client->query.isreferral) {
 				counter = ns_statscounter_referral;
 			} else {
@@ -591,7 +673,16 @@ query_send(ns_client_t *client) {
 	}
 
 	inc_stats(client, counter);
+
+	start = isc_time_monotonic();
 	ns_client_send(client);
+	send = query_latency(client, ns_latency_send, start);
+	total = query_reqlatency(client, ns_latency_total);
+
+	slowquery_ms = client->manager->sctx->slowquery_ms;
+	if (slowquery_ms != 0 && total >= (uint64_t)slowquery_ms * 1000) {
+		query_logslow(client, send, total);
+	}
 
 	if (!client->nodetach) {
 		isc_nmhandle_detach(&client->reqhandle);
@@ -701,6 +792,11 @@ query_reset(ns_client_t *client, bool everything) {
 	 */
 	ns_query_cancel(client);
 
+	/*
+	 * Free any data hook modules left with the client.
+	 */
+	ns__client_freehookdata(client);
+
 	/*
 	 * Cleanup any active versions.
 	 */
@@ -750,13 +846,22 @@ query_reset(ns_client_t *client, bool everything) {
 
 	query_freefreeversions(client, everything);
 
+	/*
+	 * The name buffers are a bump allocator for the names of one
+	 * request: rewind the first one so the next request can reuse
+	 * it from the start, and only free the overflow buffers that a
+	 * large response needed.
+	 */
 	for (dbuf = ISC_LIST_HEAD(client->query.namebufs); dbuf != NULL;
 	     dbuf = dbuf_next)
 	{
 		dbuf_next = ISC_LIST_NEXT(dbuf, link);
-		if (dbuf_next != NULL || everything) {
+		if (dbuf != ISC_LIST_HEAD(client->query.namebufs) || everything)
+		{
 			ISC_LIST_UNLINK(client->query.namebufs, dbuf, link);
 			isc_buffer_free(&dbuf);
+		} else {
+			isc_buffer_clear(dbuf);
 		}
 	}
 
@@ -771,6 +876,7 @@ query_reset(ns_client_t *client, bool everything) {
 				    NS_QUERYATTR_CACHEOK | NS_QUERYATTR_SECURE);
 	client->query.restarts = 0;
 	client->query.timerset = false;
+	memset(&client->query.timing, 0, sizeof(client->query.timing));
 	if (client->query.rpz_st != NULL) {
 		rpz_st_clear(client);
 		if (everything) {
@@ -784,6 +890,7 @@ query_reset(ns_client_t *client, bool everything) {
 	client->query.dboptions = 0;
 	client->query.fetchoptions = 0;
 	client->query.gluedb = NULL;
+	client->query.addsize = 0;
 	client->query.authdbset = false;
 	client->query.isreferral = false;
 	client->query.dns64_options = 0;
@@ -792,6 +899,11 @@ query_reset(ns_client_t *client, bool everything) {
 	client->query.root_key_sentinel_keyid = 0;
 	client->query.root_key_sentinel_is_ta = false;
 	client->query.root_key_sentinel_not_ta = false;
+	client->query.rendered.db = NULL;
+	client->query.rendered.version = NULL;
+	client->query.rendered.store = false;
+	client->query.rendered.data = (isc_region_t){ 0 };
+	client->query.rendered.keylen = 0;
 }
 
 static void
@@ -1123,6 +1235,7 @@ query_getzonedb(ns_client_t *client, const dns_name_t *name,
 		partial = true;
 	}
 	if (result == ISC_R_SUCCESS || result == DNS_R_PARTIALMATCH) {
+		dns_zone_touch(zone);
 		result = dns_zone_getdb(zone, &db);
 	}
 
@@ -1137,6 +1250,14 @@ query_getzonedb(ns_client_t *client, const dns_name_t *name,
 		goto fail;
 	}
 
+	/*
+	 * A pre-rendered answer may only depend on the database it
+	 * is stored in.
+	 */
+	if (client->query.rendered.store && db != client->query.rendered.db) {
+		client->query.rendered.store = false;
+	}
+
 	/* Transfer ownership. */
 	*zonep = zone;
 	*dbp = db;
@@ -1340,6 +1461,8 @@ query_getcachedb(ns_client_t *client, const dns_name_t *name,
 		return (DNS_R_REFUSED);
 	}
 
+	client->query.rendered.store = false;
+
 	dns_db_attach(client->view->cachedb, &db);
 
 	result = query_checkcacheaccess(client, name, qtype, options);
@@ -1666,6 +1789,102 @@ query_additionalauth(query_ctx_t *qctx, const dns_name_t *name,
 	return (result);
 }
 
+/*
+ * Types whose RDATA holds domain names that may be compressed when
+ * rendered (RFC 3597, section 4).
+ */
+static bool
+rdatatype_compressible(dns_rdatatype_t type) {
+	switch (type) {
+	case dns_rdatatype_ns:
+	case dns_rdatatype_md:
+	case dns_rdatatype_mf:
+	case dns_rdatatype_cname:
+	case dns_rdatatype_soa:
+	case dns_rdatatype_mb:
+	case dns_rdatatype_mg:
+	case dns_rdatatype_mr:
+	case dns_rdatatype_ptr:
+	case dns_rdatatype_minfo:
+	case dns_rdatatype_mx:
+		return (true);
+	default:
+		return (false);
+	}
+}
+
+/*
+ * Add a lower bound of the rendered size of 'rdataset' to the estimated
+ * size of the response: every owner name is assumed to be compressed to
+ * a pointer, and so is any compressible name in the RDATA.
+ */
+static void
+query_addsize(ns_client_t *client, dns_rdataset_t *rdataset) {
+	bool compressible = rdatatype_compressible(rdataset->type);
+	isc_result_t result;
+
+	if (TCP(client)) {
+		return;
+	}
+
+	for (result = dns_rdataset_first(rdataset); result == ISC_R_SUCCESS;
+	     result = dns_rdataset_next(rdataset))
+	{
+		dns_rdata_t rdata = DNS_RDATA_INIT;
+
+		dns_rdataset_current(rdataset, &rdata);
+		client->query.addsize += 2 + 10;
+		client->query.addsize += compressible ? 2 : rdata.length;
+	}
+}
+
+/*
+ * Estimate how much of the UDP response buffer the records already in
+ * the message will take up when rendered.
+ */
+static void
+query_estimatesize(ns_client_t *client) {
+	dns_message_t *message = client->message;
+	dns_name_t *name = NULL;
+
+	client->query.addsize = DNS_MESSAGE_HEADERLEN;
+	if (TCP(client)) {
+		return;
+	}
+
+	name = ISC_LIST_HEAD(message->sections[DNS_SECTION_QUESTION]);
+	if (name != NULL) {
+		client->query.addsize += name->length + 4;
+	}
+
+	for (dns_section_t section = DNS_SECTION_ANSWER;
+	     section <= DNS_SECTION_ADDITIONAL; section++)
+	{
+		for (name = ISC_LIST_HEAD(message->sections[section]);
+		     name != NULL; name = ISC_LIST_NEXT(name, link))
+		{
+			dns_rdataset_t *rdataset = NULL;
+
+			for (rdataset = ISC_LIST_HEAD(name->list);
+			     rdataset != NULL;
+			     rdataset = ISC_LIST_NEXT(rdataset, link))
+			{
+				query_addsize(client, rdataset);
+			}
+		}
+	}
+}
+
+/*
+ * Return true if additional data found now would not fit into the UDP
+ * response anyway, so there is no point in looking for it.  Address
+ * records are still rendered first, as glue, by dns_message_render*().
+ */
+static bool
+query_additionalfull(ns_client_t *client) {
+	return (!TCP(client) && client->query.addsize >= client->udpsize);
+}
+
 static isc_result_t
 query_additional_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
 		    dns_rdataset_t *found DNS__DB_FLARG) {
@@ -1697,6 +1916,15 @@ query_additional_cb(void *arg, const dns_name_t *name, dns_rdatatype_t qtype,
 
 	CTRACE(ISC_LOG_DEBUG(3), "query_additional_cb");
 
+	/*
+	 * Don't bother looking up data that would be dropped when the
+	 * response is rendered.
+	 */
+	if (found == NULL && query_additionalfull(client)) {
+		CTRACE(ISC_LOG_DEBUG(3), "query_additional_cb: full");
+		return (ISC_R_SUCCESS);
+	}
+
 	dns_clientinfomethods_init(&cm, ns_client_sourceip);
 	dns_clientinfo_init(&ci, client, NULL);
 
@@ -1864,6 +2092,7 @@ found:
 			need_addname = true;
 		}
 		ISC_LIST_APPEND(fname->list, rdataset, link);
+		query_addsize(client, rdataset);
 		trdataset = rdataset;
 		rdataset = NULL;
 		added_something = true;
@@ -1876,6 +2105,7 @@ found:
 		    dns_rdataset_isassociated(sigrdataset))
 		{
 			ISC_LIST_APPEND(fname->list, sigrdataset, link);
+			query_addsize(client, sigrdataset);
 			sigrdataset = NULL;
 		}
 	}
@@ -1948,12 +2178,14 @@ found:
 					}
 				}
 				ISC_LIST_APPEND(fname->list, rdataset, link);
+				query_addsize(client, rdataset);
 				added_something = true;
 				if (sigrdataset != NULL &&
 				    dns_rdataset_isassociated(sigrdataset))
 				{
 					ISC_LIST_APPEND(fname->list,
 							sigrdataset, link);
+					query_addsize(client, sigrdataset);
 					sigrdataset =
 						ns_client_newrdataset(client);
 				}
@@ -2019,12 +2251,14 @@ found:
 					}
 				}
 				ISC_LIST_APPEND(fname->list, rdataset, link);
+				query_addsize(client, rdataset);
 				added_something = true;
 				if (sigrdataset != NULL &&
 				    dns_rdataset_isassociated(sigrdataset))
 				{
 					ISC_LIST_APPEND(fname->list,
 							sigrdataset, link);
+					query_addsize(client, sigrdataset);
 					sigrdataset = NULL;
 				}
 				rdataset = NULL;
@@ -2131,6 +2365,8 @@ query_additional(query_ctx_t *qctx, dns_name_t *name,
 		return;
 	}
 
+	query_estimatesize(client);
+
 	/*
 	 * Try to process glue directly.
 	 */
@@ -2507,6 +2743,7 @@ recursionquotatype_attach(ns_client_t *client, bool soft_limit) {
 
 	ns_stats_increment(client->manager->sctx->nsstats,
 			   ns_statscounter_recursclients);
+	ns_server_recursionstarted(client->manager->sctx, &client->peeraddr);
 
 	return (result);
 }
@@ -2523,100 +2760,18 @@ recursionquotatype_attach_soft(ns_client_t *client) {
 
 static void
 recursionquotatype_detach(ns_client_t *client) {
+	ns_server_recursionended(client->manager->sctx, &client->peeraddr);
 	isc_quota_release(&client->manager->sctx->recursionquota);
 	ns_stats_decrement(client->manager->sctx->nsstats,
 			   ns_statscounter_recursclients);
 }
 
-static void
-stale_refresh_aftermath(ns_client_t *client, isc_result_t result) {
-	dns_db_t *db = NULL;
-	unsigned int dboptions;
-	isc_buffer_t buffer;
-	query_ctx_t qctx;
-	dns_clientinfomethods_t cm;
-	dns_clientinfo_t ci;
-	char namebuf[DNS_NAME_FORMATSIZE];
-	char typebuf[DNS_RDATATYPE_FORMATSIZE];
-
-	/*
-	 * If refreshing a stale RRset failed, we need to set the
-	 * stale-refresh-time window, so that on future requests for this
-	 * RRset the stale entry may be used immediately.
-	 */
-	switch (result) {
-	case ISC_R_SUCCESS:
-	case DNS_R_GLUE:
-	case DNS_R_ZONECUT:
-	case ISC_R_NOTFOUND:
-	case DNS_R_DELEGATION:
-	case DNS_R_EMPTYNAME:
-	case DNS_R_NXRRSET:
-	case DNS_R_EMPTYWILD:
-	case DNS_R_NXDOMAIN:
-	case DNS_R_COVERINGNSEC:
-	case DNS_R_NCACHENXDOMAIN:
-	case DNS_R_NCACHENXRRSET:
-	case DNS_R_CNAME:
-	case DNS_R_DNAME:
-		break;
-	default:
-		dns_name_format(client->query.qname, namebuf, sizeof(namebuf));
-		dns_rdatatype_format(client->query.qtype, typebuf,
-				     sizeof(typebuf));
-		ns_client_log(client, NS_LOGCATEGORY_SERVE_STALE,
-			      NS_LOGMODULE_QUERY, ISC_LOG_NOTICE,
-			      "%s/%s stale refresh failed: timed out", namebuf,
-			      typebuf);
-
-		/*
-		 * Set up a short lived query context, solely to set the
-		 * last refresh failure time on the RRset in the cache
-		 * database, starting the stale-refresh-time window for it.
-		 * This is a condensed form of query_lookup().
-		 */
-		client->now = isc_stdtime_now();
-		client->query.attributes &= ~NS_QUERYATTR_RECURSIONOK;
-		qctx_init(client, NULL, 0, &qctx);
-
-		dns_clientinfomethods_init(&cm, ns_client_sourceip);
-		dns_clientinfo_init(&ci, qctx.client, NULL);
-		if (HAVEECS(qctx.client)) {
-			dns_clientinfo_setecs(&ci, &qctx.client->ecs);
-		}
-
-		result = qctx_prepare_buffers(&qctx, &buffer);
-		if (result != ISC_R_SUCCESS) {
-			goto cleanup;
-		}
-
-		dboptions = qctx.client->query.dboptions;
-		dboptions |= DNS_DBFIND_STALEOK;
-		dboptions |= DNS_DBFIND_STALESTART;
-
-		dns_db_attach(qctx.client->view->cachedb, &db);
-		(void)dns_db_findext(db, qctx.client->query.qname, NULL,
-				     qctx.client->query.qtype, dboptions,
-				     qctx.client->now, &qctx.node, qctx.fname,
-				     &cm, &ci, qctx.rdataset, qctx.sigrdataset);
-		if (qctx.node != NULL) {
-			dns_db_detachnode(db, &qctx.node);
-		}
-		dns_db_detach(&db);
-
-	cleanup:
-		qctx_freedata(&qctx);
-		qctx_destroy(&qctx);
-	}
-}
-
 static void
 cleanup_after_fetch(dns_fetchresponse_t *resp, const char *ctracestr,
 		    ns_query_rectype_t recursion_type) {
 	ns_client_t *client = resp->arg;
 	isc_nmhandle_t **handlep = NULL;
 	dns_fetch_t **fetchp = NULL;
-	isc_result_t result;
 
 	REQUIRE(NS_CLIENT_VALID(client));
 
@@ -2624,7 +2779,6 @@ cleanup_after_fetch(dns_fetchresponse_t *resp, const char *ctracestr,
 
 	handlep = &client->query.recursions[recursion_type].handle;
 	fetchp = &client->query.recursions[recursion_type].fetch;
-	result = resp->result;
 
 	LOCK(&client->query.fetchlock);
 	if (*fetchp != NULL) {
@@ -2634,8 +2788,12 @@ cleanup_after_fetch(dns_fetchresponse_t *resp, const char *ctracestr,
 	UNLOCK(&client->query.fetchlock);
 
 	/* Some type of recursions require a bit of aftermath. */
-	if (recursion_type == RECTYPE_STALE_REFRESH) {
-		stale_refresh_aftermath(client, result);
+	switch (recursion_type) {
+	case RECTYPE_PREFETCH:
+		isc_quota_release(&client->view->prefetchquota);
+		break;
+	default:
+		break;
 	}
 
 	recursionquotatype_detach(client);
@@ -2653,11 +2811,6 @@ rpzfetch_done(void *arg) {
 	cleanup_after_fetch(arg, "rpzfetch_done", RECTYPE_RPZ);
 }
 
-static void
-stale_refresh_done(void *arg) {
-	cleanup_after_fetch(arg, "stale_refresh_done", RECTYPE_STALE_REFRESH);
-}
-
 /*
  * Try initiating a fetch for the given 'qname' and 'qtype' (using the slot in
  * the 'recursions' array indicated by 'recursion_type') that will be
@@ -2699,10 +2852,6 @@ fetch_and_forget(ns_client_t *client, dns_name_t *qname, dns_rdatatype_t qtype,
 		options = client->query.fetchoptions;
 		cb = rpzfetch_done;
 		break;
-	case RECTYPE_STALE_REFRESH:
-		options = client->query.fetchoptions;
-		cb = stale_refresh_done;
-		break;
 	default:
 		UNREACHABLE();
 	}
@@ -2735,26 +2884,177 @@ query_prefetch(ns_client_t *client, dns_name_t *qname,
 		return;
 	}
 
+	/*
+	 * When too many prefetches are already running, leave the RRset
+	 * eligible for prefetching so that a later query can retry; this
+	 * spreads the refreshes over the trigger window when many popular
+	 * RRsets are about to expire at the same time.
+	 */
+	if (isc_quota_acquire(&client->view->prefetchquota) != ISC_R_SUCCESS) {
+		return;
+	}
+
 	fetch_and_forget(client, qname, rdataset->type, RECTYPE_PREFETCH);
+	if (FETCH_RECTYPE_PREFETCH(client) == NULL) {
+		isc_quota_release(&client->view->prefetchquota);
+	}
 
 	dns_rdataset_clearprefetch(rdataset);
 	ns_stats_increment(client->manager->sctx->nsstats,
 			   ns_statscounter_prefetch);
 }
 
+/*
+ * Stale RRsets are refreshed in the background, detached from the
+ * client that found them: the client has already been answered with
+ * the stale data, so it is neither kept waiting nor counted against
+ * recursive-clients while the refresh runs.  Each view limits the
+ * refreshes in progress with its own quota (max-stale-refreshes) and
+ * keeps a table of the names and types being refreshed, so that a
+ * popular stale RRset is only refreshed once at a time.
+ */
+typedef struct stale_refresh {
+	isc_mem_t *mctx;
+	dns_view_t *view;
+	dns_fetch_t *fetch;
+	dns_rdataset_t rdataset;
+	dns_fixedname_t fname;
+	dns_name_t *name;
+	dns_rdatatype_t type;
+	uint32_t hashval;
+} stale_refresh_t;
+
+static uint32_t
+stale_refresh_hash(const dns_name_t *name, dns_rdatatype_t type) {
+	isc_hash32_t hash32;
+
+	isc_hash32_init(&hash32);
+	isc_hash32_hash(&hash32, name->ndata, name->length, false);
+	isc_hash32_hash(&hash32, &type, sizeof(type), true);
+	return (isc_hash32_finalize(&hash32));
+}
+
+static bool
+stale_refresh_match(void *node, const void *key) {
+	const stale_refresh_t *refresh0 = node;
+	const stale_refresh_t *refresh1 = key;
+
+	return (refresh0->type == refresh1->type &&
+		dns_name_equal(refresh0->name, refresh1->name));
+}
+
 static void
-query_stale_refresh(ns_client_t *client) {
-	dns_name_t *qname;
+stale_refresh_aftermath(stale_refresh_t *refresh, isc_result_t result) {
+	dns_view_t *view = refresh->view;
+	dns_db_t *db = NULL;
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fixed;
+	dns_rdataset_t rdataset;
+	char namebuf[DNS_NAME_FORMATSIZE];
+	char typebuf[DNS_RDATATYPE_FORMATSIZE];
 
-	CTRACE(ISC_LOG_DEBUG(3), "query_stale_refresh");
+	/*
+	 * If refreshing a stale RRset failed, we need to set the
+	 * stale-refresh-time window, so that on future requests for this
+	 * RRset the stale entry may be used immediately.
+	 */
+	switch (result) {
+	case ISC_R_SUCCESS:
+	case DNS_R_GLUE:
+	case DNS_R_ZONECUT:
+	case ISC_R_NOTFOUND:
+	case DNS_R_DELEGATION:
+	case DNS_R_EMPTYNAME:
+	case DNS_R_NXRRSET:
+	case DNS_R_EMPTYWILD:
+	case DNS_R_NXDOMAIN:
+	case DNS_R_COVERINGNSEC:
+	case DNS_R_NCACHENXDOMAIN:
+	case DNS_R_NCACHENXRRSET:
+	case DNS_R_CNAME:
+	case DNS_R_DNAME:
+	case ISC_R_CANCELED:
+	case ISC_R_SHUTTINGDOWN:
+		return;
+	default:
+		break;
+	}
+
+	dns_name_format(refresh->name, namebuf, sizeof(namebuf));
+	dns_rdatatype_format(refresh->type, typebuf, sizeof(typebuf));
+	isc_log_write(ns_lctx, NS_LOGCATEGORY_SERVE_STALE, NS_LOGMODULE_QUERY,
+		      ISC_LOG_NOTICE, "%s/%s stale refresh failed: timed out",
+		      namebuf, typebuf);
 
-	if (FETCH_RECTYPE_STALE_REFRESH(client) != NULL) {
+	if (view->cachedb == NULL) {
 		return;
 	}
 
-	client->query.dboptions &= ~(DNS_DBFIND_STALETIMEOUT |
-				     DNS_DBFIND_STALEOK |
-				     DNS_DBFIND_STALEENABLED);
+	/*
+	 * Look the RRset up once more, solely to set the last refresh
+	 * failure time on it in the cache database, starting the
+	 * stale-refresh-time window for it.
+	 */
+	dns_fixedname_init(&fixed);
+	dns_rdataset_init(&rdataset);
+	dns_db_attach(view->cachedb, &db);
+	(void)dns_db_findext(db, refresh->name, NULL, refresh->type,
+			     DNS_DBFIND_STALEOK | DNS_DBFIND_STALESTART,
+			     isc_stdtime_now(), &node,
+			     dns_fixedname_name(&fixed), NULL, NULL, &rdataset,
+			     NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+	if (node != NULL) {
+		dns_db_detachnode(db, &node);
+	}
+	dns_db_detach(&db);
+}
+
+static void
+stale_refresh_done(void *arg) {
+	dns_fetchresponse_t *resp = arg;
+	stale_refresh_t *refresh = resp->arg;
+	dns_view_t *view = refresh->view;
+	isc_result_t result;
+
+	INSIST(resp->fetch == refresh->fetch);
+	refresh->fetch = NULL;
+
+	stale_refresh_aftermath(refresh, resp->result);
+
+	LOCK(&view->stalerefreshlock);
+	result = isc_hashmap_delete(view->stalerefreshes, refresh->hashval,
+				    stale_refresh_match, refresh);
+	UNLOCK(&view->stalerefreshlock);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	isc_quota_release(&view->stalerefreshquota);
+
+	dns_resolver_destroyfetch(&resp->fetch);
+	if (resp->node != NULL) {
+		dns_db_detachnode(resp->db, &resp->node);
+	}
+	if (resp->db != NULL) {
+		dns_db_detach(&resp->db);
+	}
+	if (dns_rdataset_isassociated(&refresh->rdataset)) {
+		dns_rdataset_disassociate(&refresh->rdataset);
+	}
+	isc_mem_putanddetach(&resp->mctx, resp, sizeof(*resp));
+
+	dns_view_weakdetach(&refresh->view);
+	isc_mem_putanddetach(&refresh->mctx, refresh, sizeof(*refresh));
+}
+
+static void
+query_stale_refresh(ns_client_t *client) {
+	dns_view_t *view = client->view;
+	stale_refresh_t *refresh = NULL;
+	dns_name_t *qname = NULL;
+	isc_result_t result;
+
+	CTRACE(ISC_LOG_DEBUG(3), "query_stale_refresh");
 
 	if (client->query.origqname != NULL) {
 		qname = client->query.origqname;
@@ -2762,8 +3062,49 @@ query_stale_refresh(ns_client_t *client) {
 		qname = client->query.qname;
 	}
 
-	fetch_and_forget(client, qname, client->query.qtype,
-			 RECTYPE_STALE_REFRESH);
+	if (isc_quota_acquire(&view->stalerefreshquota) != ISC_R_SUCCESS) {
+		return;
+	}
+
+	refresh = isc_mem_get(view->mctx, sizeof(*refresh));
+	*refresh = (stale_refresh_t){
+		.type = client->query.qtype,
+		.hashval = stale_refresh_hash(qname, client->query.qtype),
+	};
+	isc_mem_attach(view->mctx, &refresh->mctx);
+	refresh->name = dns_fixedname_initname(&refresh->fname);
+	dns_name_copy(qname, refresh->name);
+	dns_rdataset_init(&refresh->rdataset);
+
+	LOCK(&view->stalerefreshlock);
+	result = isc_hashmap_add(view->stalerefreshes, refresh->hashval,
+				 stale_refresh_match, refresh, refresh, NULL);
+	UNLOCK(&view->stalerefreshlock);
+	if (result != ISC_R_SUCCESS) {
+		/* Already being refreshed. */
+		goto cleanup;
+	}
+
+	dns_view_weakattach(view, &refresh->view);
+	result = dns_resolver_createfetch(
+		view->resolver, refresh->name, refresh->type, NULL, NULL, NULL,
+		NULL, 0, client->query.fetchoptions, 0, NULL,
+		client->manager->loop, stale_refresh_done, refresh,
+		&refresh->rdataset, NULL, &refresh->fetch);
+	if (result == ISC_R_SUCCESS) {
+		return;
+	}
+
+	LOCK(&view->stalerefreshlock);
+	result = isc_hashmap_delete(view->stalerefreshes, refresh->hashval,
+				    stale_refresh_match, refresh);
+	UNLOCK(&view->stalerefreshlock);
+	RUNTIME_CHECK(result == ISC_R_SUCCESS);
+	dns_view_weakdetach(&refresh->view);
+
+cleanup:
+	isc_mem_putanddetach(&refresh->mctx, refresh, sizeof(*refresh));
+	isc_quota_release(&view->stalerefreshquota);
 }
 
 static void
@@ -3927,6 +4268,51 @@ rpz_rewrite_ip_rrsets(ns_client_t *client, dns_name_t *name,
 	return (result);
 }
 
+/*
+ * Get the tag that marks the answer rdataset for the current name as not
+ * rewritten by the policy zones of 'generation' that apply to the client,
+ * or 0 if the result could depend on anything else: the client address
+ * or other rdatasets, such as the A and AAAA rdatasets of ANY queries
+ * and the NS rdatasets checked for NSDNAME and NSIP triggers.
+ */
+static uint64_t
+rpz_answertag(ns_client_t *client, dns_rdatatype_t qtype, isc_result_t qresult,
+	      dns_rdataset_t *ordataset, uint64_t generation) {
+	dns_rpz_st_t *st = client->query.rpz_st;
+	struct {
+		uint64_t generation;
+		dns_rpz_zbits_t qname;
+		dns_rpz_zbits_t ip;
+	} key;
+	uint64_t tag;
+
+	if (st->popt.dnsrps_enabled || qresult != ISC_R_SUCCESS ||
+	    ordataset == NULL || !dns_rdataset_isassociated(ordataset) ||
+	    ordataset->type != qtype || qtype == dns_rdatatype_any ||
+	    st->m.policy != DNS_RPZ_POLICY_MISS ||
+	    (st->state & (DNS_RPZ_DONE_QNAME | DNS_RPZ_DONE_QNAME_IP)) != 0)
+	{
+		return (0);
+	}
+
+	if (rpz_get_zbits(client, dns_rdatatype_none,
+			  DNS_RPZ_TYPE_CLIENT_IP) != 0 ||
+	    rpz_get_zbits(client, dns_rdatatype_any, DNS_RPZ_TYPE_NSDNAME) !=
+		    0 ||
+	    rpz_get_zbits(client, dns_rdatatype_any, DNS_RPZ_TYPE_NSIP) != 0)
+	{
+		return (0);
+	}
+
+	key.generation = generation;
+	key.qname = rpz_get_zbits(client, dns_rdatatype_none,
+				  DNS_RPZ_TYPE_QNAME);
+	key.ip = rpz_get_zbits(client, qtype, DNS_RPZ_TYPE_IP);
+	tag = isc_hash64(&key, sizeof(key), true);
+
+	return ((tag != 0) ? tag : 1);
+}
+
 /*
  * Try to rewrite a request for a qtype rdataset based on the trigger name
  * trig_name and rpz_type (DNS_RPZ_TYPE_QNAME or DNS_RPZ_TYPE_NSDNAME).
@@ -4140,6 +4526,7 @@ rpz_rewrite(ns_client_t *client, dns_rdatatype_t qtype, isc_result_t qresult,
 	dns_rpz_have_t have;
 	dns_rpz_popt_t popt;
 	int rpz_ver;
+	uint64_t generation, rpztag = 0;
 	unsigned int options;
 #ifdef USE_DNSRPS
 	librpz_emsg_t emsg;
@@ -4171,6 +4558,7 @@ rpz_rewrite(ns_client_t *client, dns_rdatatype_t qtype, isc_result_t qresult,
 	have = rpzs->have;
 	popt = rpzs->p;
 	rpz_ver = rpzs->rpz_ver;
+	generation = rpzs->generation;
 	RWUNLOCK(&rpzs->search_lock, isc_rwlocktype_read);
 
 #ifndef USE_DNSRPS
@@ -4265,6 +4653,17 @@ rpz_rewrite(ns_client_t *client, dns_rdatatype_t qtype, isc_result_t qresult,
 		return (ISC_R_SUCCESS);
 	}
 
+	/*
+	 * Skip the policy checks if they have already found nothing to
+	 * rewrite in this answer, usually from the cache.
+	 */
+	rpztag = rpz_answertag(client, qtype, qresult, ordataset, generation);
+	if (rpztag != 0 && dns_rdataset_getrpztag(ordataset) == rpztag) {
+		st->state |= DNS_RPZ_DONE_CLIENT_IP | DNS_RPZ_DONE_QNAME |
+			     DNS_RPZ_DONE_QNAME_IP;
+		return (ISC_R_SUCCESS);
+	}
+
 	rdataset = NULL;
 
 	if ((st->state & (DNS_RPZ_DONE_CLIENT_IP | DNS_RPZ_DONE_QNAME)) !=
@@ -4557,6 +4956,11 @@ cleanup:
 	{
 		st->m.policy = st->m.rpz->policy;
 	}
+	if (rpztag != 0 && result == ISC_R_SUCCESS &&
+	    st->m.policy == DNS_RPZ_POLICY_MISS)
+	{
+		dns_rdataset_setrpztag(ordataset, rpztag);
+	}
 	if (st->m.policy == DNS_RPZ_POLICY_MISS ||
 	    st->m.policy == DNS_RPZ_POLICY_PASSTHRU ||
 	    st->m.policy == DNS_RPZ_POLICY_ERROR)
@@ -4801,6 +5205,7 @@ query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 	dns_rdata_nsec3_t nsec3;
 	dns_rdata_t rdata = DNS_RDATA_INIT;
 	bool optout;
+	bool cached;
 	dns_clientinfomethods_t cm;
 	dns_clientinfo_t ci;
 
@@ -4825,12 +5230,22 @@ query_findclosestnsec3(dns_name_t *qname, dns_db_t *db,
 	}
 
 again:
+	/*
+	 * The closest encloser and wildcard names of negative answers
+	 * repeat across queries, so their hashes are remembered in the
+	 * database version.
+	 */
 	dns_fixedname_init(&fixed);
-	result = dns_nsec3_hashname(&fixed, NULL, NULL, &name,
-				    dns_db_origin(db), hash, iterations, salt,
-				    salt_length);
-	if (result != ISC_R_SUCCESS) {
-		return;
+	cached = (dns_db_getnsec3hash(db, version, &name,
+				      dns_fixedname_name(&fixed)) ==
+		  ISC_R_SUCCESS);
+	if (!cached) {
+		result = dns_nsec3_hashname(&fixed, NULL, NULL, &name,
+					    dns_db_origin(db), hash, iterations,
+					    salt, salt_length);
+		if (result != ISC_R_SUCCESS) {
+			return;
+		}
 	}
 
 	dboptions = client->query.dboptions | DNS_DBFIND_FORCENSEC3;
@@ -4838,6 +5253,18 @@ again:
 				dns_rdatatype_nsec3, dboptions, client->now,
 				NULL, fname, &cm, &ci, rdataset, sigrdataset);
 
+	/*
+	 * Only hashes of names that exist in the zone, and of wildcards,
+	 * are worth keeping; the hashes of the random names used in
+	 * attacks would just fill up the table.
+	 */
+	if (!cached &&
+	    (result == ISC_R_SUCCESS || dns_name_iswildcard(&name)))
+	{
+		(void)dns_db_addnsec3hash(db, version, &name,
+					  dns_fixedname_name(&fixed));
+	}
+
 	if (result == DNS_R_NXDOMAIN) {
 		if (!dns_rdataset_isassociated(rdataset)) {
 			return;
@@ -5582,16 +6009,230 @@ root_key_sentinel_detect(query_ctx_t *qctx) {
 		if (!get_root_key_sentinel_id(qctx, ndata + 26)) {
 			return;
 		}
-		qctx->client->query.root_key_sentinel_not_ta = true;
-		/*
-		 * Simplify processing by disabling aggressive
-		 * negative caching.
-		 */
-		qctx->findcoveringnsec = false;
-		ns_client_log(qctx->client, NS_LOGCATEGORY_TAT,
-			      NS_LOGMODULE_QUERY, ISC_LOG_INFO,
-			      "root-key-sentinel-not-ta query label found");
+		qctx->client->query.root_key_sentinel_not_ta = true;
+		/*
+		 * Simplify processing by disabling aggressive
+		 * negative caching.
+		 */
+		qctx->findcoveringnsec = false;
+		ns_client_log(qctx->client, NS_LOGCATEGORY_TAT,
+			      NS_LOGMODULE_QUERY, ISC_LOG_INFO,
+			      "root-key-sentinel-not-ta query label found");
+	}
+}
+
+/*%
+ * Layout of the header stored in front of a pre-rendered answer:
+ * message flags (AA and AD only), rcode, attributes, and the number
+ * of records in the answer, authority and additional sections.
+ */
+#define RENDERED_HEADERLEN	 10
+#define RENDERED_ATTR_REFERRAL	 0x01
+#define RENDERED_ATTR_HASANSWER	 0x02
+#define RENDERED_FLAG_DNSSEC	 0x01
+#define RENDERED_FLAG_AD	 0x02
+#define RENDERED_FLAG_CD	 0x04
+#define RENDERED_FLAG_RD	 0x08
+#define RENDERED_FLAG_TCP	 0x10
+#define RENDERED_FLAG_INET6	 0x20
+#define RENDERED_FLAG_OPT	 0x40
+
+/*%
+ * Look for a pre-rendered answer to the query in the zone database
+ * version found by query_getdb().  Returns true if one was found and
+ * the response is ready to be sent; otherwise, if the response is
+ * eligible for caching, mark it to be stored once it has been rendered
+ * (see ns_query_storerendered()) and return false.
+ *
+ * Only responses which depend on nothing but the zone contents, the
+ * view configuration and the key flags can be handled here, so
+ * anything which may alter the response on a per-client basis
+ * disables the cache.
+ */
+static bool
+query_rendered_lookup(query_ctx_t *qctx) {
+	ns_client_t *client = qctx->client;
+	dns_view_t *view = client->view;
+	dns_message_t *message = client->message;
+	isc_buffer_t b;
+	isc_region_t key, data;
+	isc_result_t result;
+	uint8_t flags = 0;
+	uint16_t msgflags;
+	uint8_t rcode, attrs;
+
+	if (!qctx->is_zone || qctx->zone == NULL || qctx->version == NULL ||
+	    (dns_zone_getoptions(qctx->zone) & DNS_ZONEOPT_CACHERENDERED) ==
+		    0 ||
+	    dns_zone_gettype(qctx->zone) == dns_zone_mirror ||
+	    client->query.restarts > 0 || RECURSIONOK(client) ||
+	    HAVEECS(client) || BADCOOKIE(client) ||
+	    message->tsigkey != NULL || message->sig0 != NULL ||
+	    dns_rdatatype_ismeta(qctx->qtype) ||
+	    client->query.root_key_sentinel_is_ta ||
+	    client->query.root_key_sentinel_not_ta)
+	{
+		return (false);
+	}
+
+	if (view->rpzs != NULL || !ISC_LIST_EMPTY(view->dns64) ||
+	    view->rrl != NULL || view->sortlist != NULL ||
+	    view->nocasecompress != NULL || view->redirect != NULL ||
+	    view->redirectzone != NULL || view->hooktable != NULL)
+	{
+		return (false);
+	}
+
+	if (WANTDNSSEC(client)) {
+		flags |= RENDERED_FLAG_DNSSEC;
+	}
+	if (WANTAD(client)) {
+		flags |= RENDERED_FLAG_AD;
+	}
+	if ((message->flags & DNS_MESSAGEFLAG_CD) != 0) {
+		flags |= RENDERED_FLAG_CD;
+	}
+	if ((message->flags & DNS_MESSAGEFLAG_RD) != 0) {
+		flags |= RENDERED_FLAG_RD;
+	}
+	if (TCP(client)) {
+		flags |= RENDERED_FLAG_TCP;
+	}
+	if (isc_sockaddr_pf(&client->peeraddr) == AF_INET6) {
+		flags |= RENDERED_FLAG_INET6;
+	}
+	if ((client->attributes & NS_CLIENTATTR_WANTOPT) != 0) {
+		flags |= RENDERED_FLAG_OPT;
+	}
+
+	dns_name_toregion(client->query.qname, &key);
+	isc_buffer_init(&b, client->query.rendered.key,
+			sizeof(client->query.rendered.key));
+	isc_buffer_putuint32(&b, view->instance);
+	isc_buffer_putuint16(&b, qctx->qtype);
+	isc_buffer_putuint8(&b, flags);
+	isc_buffer_putmem(&b, key.base, key.length);
+	isc_buffer_usedregion(&b, &key);
+	client->query.rendered.keylen = key.length;
+
+	result = dns_db_getrendered(qctx->db, qctx->version, &key, &data);
+	if (result == ISC_R_NOTFOUND) {
+		client->query.rendered.db = qctx->db;
+		client->query.rendered.version = qctx->version;
+		client->query.rendered.store = true;
+		return (false);
+	} else if (result != ISC_R_SUCCESS) {
+		return (false);
+	}
+
+	INSIST(data.length >= RENDERED_HEADERLEN);
+
+	isc_buffer_init(&b, data.base, data.length);
+	isc_buffer_add(&b, data.length);
+	msgflags = isc_buffer_getuint16(&b);
+	rcode = isc_buffer_getuint8(&b);
+	attrs = isc_buffer_getuint8(&b);
+	client->query.rendered.ancount = isc_buffer_getuint16(&b);
+	client->query.rendered.nscount = isc_buffer_getuint16(&b);
+	client->query.rendered.arcount = isc_buffer_getuint16(&b);
+	isc_buffer_remainingregion(&b, &client->query.rendered.data);
+
+	message->flags &= ~(DNS_MESSAGEFLAG_AA | DNS_MESSAGEFLAG_AD);
+	message->flags |= msgflags;
+	message->rcode = rcode;
+	client->query.isreferral = ((attrs & RENDERED_ATTR_REFERRAL) != 0);
+	client->query.rendered.hasanswer = ((attrs & RENDERED_ATTR_HASANSWER) !=
+					    0);
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_rendered_lookup: found");
+
+	return (true);
+}
+
+/*%
+ * Return false if any RRset in 'message' is shuffled when rendered,
+ * so that the response would differ each time.
+ */
+static bool
+rendered_isfixed(dns_message_t *message) {
+	for (dns_section_t section = DNS_SECTION_ANSWER;
+	     section <= DNS_SECTION_ADDITIONAL; section++)
+	{
+		dns_name_t *name = NULL;
+
+		for (name = ISC_LIST_HEAD(message->sections[section]);
+		     name != NULL; name = ISC_LIST_NEXT(name, link))
+		{
+			dns_rdataset_t *rdataset = NULL;
+
+			for (rdataset = ISC_LIST_HEAD(name->list);
+			     rdataset != NULL;
+			     rdataset = ISC_LIST_NEXT(rdataset, link))
+			{
+				if ((rdataset->attributes &
+				     (DNS_RDATASETATTR_RANDOMIZE |
+				      DNS_RDATASETATTR_CYCLIC)) != 0 &&
+				    rdataset->type != dns_rdatatype_rrsig &&
+				    dns_rdataset_count(rdataset) > 1)
+				{
+					return (false);
+				}
+			}
+		}
+	}
+
+	return (true);
+}
+
+void
+ns_query_storerendered(ns_client_t *client, const isc_region_t *wire) {
+	dns_message_t *message = NULL;
+	unsigned char header[RENDERED_HEADERLEN];
+	isc_buffer_t b;
+	isc_region_t key, data[2];
+	uint8_t attrs = 0;
+
+	REQUIRE(NS_CLIENT_VALID(client));
+	REQUIRE(wire != NULL);
+
+	if (!client->query.rendered.store) {
+		return;
+	}
+	client->query.rendered.store = false;
+
+	message = client->message;
+	if ((message->rcode != dns_rcode_noerror &&
+	     message->rcode != dns_rcode_nxdomain) ||
+	    (message->flags & DNS_MESSAGEFLAG_TC) != 0 || client->ede != NULL ||
+	    !rendered_isfixed(message))
+	{
+		return;
+	}
+
+	if (client->query.isreferral) {
+		attrs |= RENDERED_ATTR_REFERRAL;
 	}
+	if (!ISC_LIST_EMPTY(message->sections[DNS_SECTION_ANSWER])) {
+		attrs |= RENDERED_ATTR_HASANSWER;
+	}
+
+	isc_buffer_init(&b, header, sizeof(header));
+	isc_buffer_putuint16(&b, message->flags & (DNS_MESSAGEFLAG_AA |
+						   DNS_MESSAGEFLAG_AD));
+	isc_buffer_putuint8(&b, message->rcode);
+	isc_buffer_putuint8(&b, attrs);
+	isc_buffer_putuint16(&b, message->counts[DNS_SECTION_ANSWER]);
+	isc_buffer_putuint16(&b, message->counts[DNS_SECTION_AUTHORITY]);
+	isc_buffer_putuint16(&b, message->counts[DNS_SECTION_ADDITIONAL]);
+
+	isc_buffer_usedregion(&b, &data[0]);
+	data[1] = *wire;
+	key.base = client->query.rendered.key;
+	key.length = client->query.rendered.keylen;
+
+	(void)dns_db_addrendered(client->query.rendered.db,
+				 client->query.rendered.version, &key, data,
+				 2);
 }
 
 /*%
@@ -5814,6 +6455,10 @@ ns__query_start(query_ctx_t *qctx) {
 		qctx->options |= DNS_GETDB_STALEFIRST;
 	}
 
+	if (query_rendered_lookup(qctx)) {
+		return (ns_query_done(qctx));
+	}
+
 	result = query_lookup(qctx);
 
 	/*
@@ -5912,6 +6557,7 @@ query_lookup(query_ctx_t *qctx) {
 	bool stale_found = false;
 	bool stale_refresh_window = false;
 	uint16_t ede = 0;
+	isc_nanosecs_t start;
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_lookup");
 
@@ -5966,10 +6612,14 @@ query_lookup(query_ctx_t *qctx) {
 		dboptions |= DNS_DBFIND_STALEENABLED;
 	}
 
+	LIBNS_QUERY_LOOKUP_BEGIN(qctx->client);
+	start = isc_time_monotonic();
 	result = dns_db_findext(qctx->db, rpzqname, qctx->version, qctx->type,
 				dboptions, qctx->client->now, &qctx->node,
 				qctx->fname, &cm, &ci, qctx->rdataset,
 				qctx->sigrdataset);
+	query_latency(qctx->client, ns_latency_lookup, start);
+	LIBNS_QUERY_LOOKUP_END(qctx->client, result);
 
 	/*
 	 * Fixup fname and sigrdataset.
@@ -6246,6 +6896,8 @@ fetch_callback(void *arg) {
 		 */
 		INSIST(FETCH_RECTYPE_NORMAL(client) == resp->fetch);
 		FETCH_RECTYPE_NORMAL(client) = NULL;
+		query_latency(client, ns_latency_recursion,
+			      client->query.recursestart);
 
 		/*
 		 * Update client->now.
@@ -6389,10 +7041,16 @@ recursionquota_log(ns_client_t *client, atomic_uint_fast32_t *last_log_time,
 		      isc_quota_getsoft(quota), isc_quota_getmax(quota));
 }
 
-static atomic_uint_fast32_t last_soft, last_hard;
+static atomic_uint_fast32_t last_soft, last_hard, last_share;
 
 /*%
  * Check recursion quota before making the current client "recursing".
+ *
+ * Once the soft limit is exceeded, the recursive clients are shared
+ * out between client networks: a query from a network that already
+ * holds more than its share is refused rather than displacing
+ * someone else's, and otherwise the query displaced is the oldest one
+ * from a network over its share, if there is one.
  */
 static isc_result_t
 check_recursionquota(ns_client_t *client) {
@@ -6401,6 +7059,20 @@ check_recursionquota(ns_client_t *client) {
 	result = recursionquotatype_attach_soft(client);
 	switch (result) {
 	case ISC_R_SOFTQUOTA:
+		if (ns_server_recursionovershare(client->manager->sctx,
+						 &client->peeraddr))
+		{
+			recursionquota_log(
+				client, &last_share,
+				"recursive-clients soft limit exceeded "
+				"(%u/%u/%u), refusing query from a network "
+				"over its share",
+				&client->manager->sctx->recursionquota);
+			recursionquotatype_detach(client);
+			ns_stats_increment(client->manager->sctx->nsstats,
+					   ns_statscounter_reclimitdropped);
+			return (ISC_R_QUOTA);
+		}
 		recursionquota_log(client, &last_soft,
 				   "recursive-clients soft limit exceeded "
 				   "(%u/%u/%u), aborting oldest query",
@@ -6479,6 +7151,7 @@ ns_query_recurse(ns_client_t *client, dns_rdatatype_t qtype, dns_name_t *qname,
 	}
 
 	isc_nmhandle_attach(client->handle, &HANDLE_RECTYPE_NORMAL(client));
+	client->query.recursestart = isc_time_monotonic();
 	result = dns_resolver_createfetch(
 		client->view->resolver, qname, qtype, qdomain, nameservers,
 		NULL, peeraddr, client->message->id, client->query.fetchoptions,
@@ -7612,6 +8285,7 @@ query_gotanswer(query_ctx_t *qctx, isc_result_t result) {
 	char errmsg[256];
 
 	CCTRACE(ISC_LOG_DEBUG(3), "query_gotanswer");
+	LIBNS_QUERY_GOTANSWER(qctx->client, result);
 
 	CALL_HOOK(NS_QUERY_GOT_ANSWER_BEGIN, qctx);
 
@@ -8365,19 +9039,28 @@ query_dns64(query_ctx_t *qctx) {
 		flags |= DNS_DNS64_DNSSEC;
 	}
 
-	for (result = dns_rdataset_first(qctx->rdataset);
-	     result == ISC_R_SUCCESS;
-	     result = dns_rdataset_next(qctx->rdataset))
+	/*
+	 * Whether a dns64 entry applies to this client doesn't depend
+	 * on the A record, so check it once per entry rather than once
+	 * per entry and record.
+	 */
+	for (dns64 = ISC_LIST_HEAD(client->view->dns64); dns64 != NULL;
+	     dns64 = dns_dns64_next(dns64))
 	{
-		for (dns64 = ISC_LIST_HEAD(client->view->dns64); dns64 != NULL;
-		     dns64 = dns_dns64_next(dns64))
+		if (!dns_dns64_applies(dns64, &netaddr, client->signer, env,
+				       flags))
+		{
+			continue;
+		}
+		for (result = dns_rdataset_first(qctx->rdataset);
+		     result == ISC_R_SUCCESS;
+		     result = dns_rdataset_next(qctx->rdataset))
 		{
 			dns_rdataset_current(qctx->rdataset, &rdata);
 			isc_buffer_availableregion(buffer, &r);
 			INSIST(r.length >= 16);
-			result = dns_dns64_aaaafroma(dns64, &netaddr,
-						     client->signer, env, flags,
-						     rdata.data, r.base);
+			result = dns_dns64_synthesize(dns64, env, rdata.data,
+						      r.base);
 			if (result != ISC_R_SUCCESS) {
 				dns_rdata_reset(&rdata);
 				continue;
@@ -8394,9 +9077,9 @@ query_dns64(query_ctx_t *qctx) {
 			dns64_rdata = NULL;
 			dns_rdata_reset(&rdata);
 		}
-	}
-	if (result != ISC_R_NOMORE) {
-		goto cleanup;
+		if (result != ISC_R_NOMORE) {
+			goto cleanup;
+		}
 	}
 
 	if (ISC_LIST_EMPTY(dns64_rdatalist->rdata)) {
@@ -8844,6 +9527,10 @@ query_delegation(query_ctx_t *qctx) {
 		return (query_zone_delegation(qctx));
 	}
 
+	if (query_synthnsec3(qctx)) {
+		return (ns_query_done(qctx));
+	}
+
 	if (qctx->zfname != NULL &&
 	    (!dns_name_issubdomain(qctx->fname, qctx->zfname) ||
 	     (qctx->is_staticstub_zone &&
@@ -10250,6 +10937,424 @@ cleanup:
 	return (ns_query_done(qctx));
 }
 
+/*
+ * A name that sorts after every NSEC3 owner name of a zone, used to find
+ * some NSEC3 record of the zone and read its hash parameters.
+ */
+static unsigned char nsec3last_ndata[] = "\001w";
+static unsigned char nsec3last_offsets[] = { 0 };
+static dns_name_t const nsec3last =
+	DNS_NAME_INITNONABSOLUTE(nsec3last_ndata, nsec3last_offsets);
+
+/*
+ * Look up the cached NSEC3 record at 'hashname', or the one preceding it.
+ * The record must be secure, owned by a name directly below 'zone' and
+ * signed by 'zone'.
+ *
+ * Returns ISC_R_SUCCESS for an exact match, DNS_R_COVERINGNSEC for a
+ * preceding record, and ISC_R_NOTFOUND otherwise.
+ */
+static isc_result_t
+query_findnsec3(query_ctx_t *qctx, const dns_name_t *hashname,
+		const dns_name_t *zone, dns_name_t *foundname,
+		dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	dns_dbnode_t *node = NULL;
+	dns_fixedname_t fsigner;
+	dns_name_t *signer = dns_fixedname_initname(&fsigner);
+	isc_result_t result;
+
+	result = dns_db_find(qctx->db, hashname, qctx->version,
+			     dns_rdatatype_nsec3,
+			     qctx->client->query.dboptions |
+				     DNS_DBFIND_COVERINGNSEC,
+			     qctx->client->now, &node, foundname, rdataset,
+			     sigrdataset);
+	if (node != NULL) {
+		dns_db_detachnode(qctx->db, &node);
+	}
+	if ((result == ISC_R_SUCCESS || result == DNS_R_COVERINGNSEC) &&
+	    rdataset->type == dns_rdatatype_nsec3 &&
+	    rdataset->trust == dns_trust_secure &&
+	    dns_rdataset_isassociated(sigrdataset) &&
+	    sigrdataset->trust == dns_trust_secure &&
+	    dns_name_countlabels(foundname) == dns_name_countlabels(zone) + 1 &&
+	    dns_name_issubdomain(foundname, zone) &&
+	    checksignames(signer, sigrdataset) == ISC_R_SUCCESS &&
+	    dns_name_equal(signer, zone))
+	{
+		return (result);
+	}
+
+	if (dns_rdataset_isassociated(rdataset)) {
+		dns_rdataset_disassociate(rdataset);
+	}
+	if (dns_rdataset_isassociated(sigrdataset)) {
+		dns_rdataset_disassociate(sigrdataset);
+	}
+	return (ISC_R_NOTFOUND);
+}
+
+/*
+ * Check that the NSEC3 record 'rdataset' owned by 'owner' proves what
+ * we need about 'name': for 'exists', that 'name' is the closest
+ * encloser of 'qname'; otherwise that 'name' does not exist and is not
+ * in an opt-out range.
+ */
+static bool
+query_checknsec3(query_ctx_t *qctx, const dns_name_t *qname,
+		 const dns_name_t *name, const dns_name_t *owner,
+		 dns_rdataset_t *rdataset, bool exists) {
+	dns_fixedname_t fzone, ffound;
+	dns_name_t *zone = dns_fixedname_initname(&fzone);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	bool nexists = true, data = true, optout = true, set = false;
+	isc_result_t result;
+
+	if (exists) {
+		(void)dns_nsec3_noexistnodata(qctx->qtype, qname, owner,
+					      rdataset, zone, &nexists, &data,
+					      NULL, NULL, &set, NULL, found,
+					      NULL, log_noexistnodata, qctx);
+		return (set && dns_name_equal(found, name));
+	}
+
+	result = dns_nsec3_noexistnodata(qctx->qtype, name, owner, rdataset,
+					 zone, &nexists, &data, &optout, NULL,
+					 NULL, &set, NULL, found,
+					 log_noexistnodata, qctx);
+	return (result == ISC_R_SUCCESS && !nexists && !optout && set &&
+		dns_name_equal(found, name));
+}
+
+/*
+ * Add a copy of the NSEC3 record 'rdataset' owned by 'owner', and its
+ * signature, to the authority section.
+ */
+static void
+query_addnsec3(query_ctx_t *qctx, const dns_name_t *owner,
+	       dns_rdataset_t *rdataset, dns_rdataset_t *sigrdataset) {
+	dns_name_t *name = NULL;
+	dns_rdataset_t *cloneset = NULL, *clonesigset = NULL;
+	isc_buffer_t *dbuf, b;
+
+	dbuf = ns_client_getnamebuf(qctx->client);
+	name = ns_client_newname(qctx->client, dbuf, &b);
+	dns_name_copy(owner, name);
+
+	cloneset = ns_client_newrdataset(qctx->client);
+	clonesigset = ns_client_newrdataset(qctx->client);
+	dns_rdataset_clone(rdataset, cloneset);
+	dns_rdataset_clone(sigrdataset, clonesigset);
+
+	query_addrrset(qctx, &name, &cloneset, &clonesigset, dbuf,
+		       DNS_SECTION_AUTHORITY);
+
+	if (name != NULL) {
+		ns_client_releasename(qctx->client, &name);
+	}
+	if (cloneset != NULL) {
+		ns_client_putrdataset(qctx->client, &cloneset);
+	}
+	if (clonesigset != NULL) {
+		ns_client_putrdataset(qctx->client, &clonesigset);
+	}
+}
+
+/*%
+ * Synthesize a NXDOMAIN or NODATA response from cached NSEC3 records
+ * (RFC 8198), for a query that found only the cached delegation in
+ * 'qctx->fname'.  The zone's hash parameters are read from the last
+ * cached NSEC3 record of the zone; the auxiliary NSEC3 tree of the cache
+ * then gives the records matching or covering the hashed names of the
+ * closest encloser proof.
+ *
+ * Wildcard answers are not synthesized, nor are responses that rely on
+ * an opt-out range.  Returns true if the response was synthesized.
+ */
+static bool
+query_synthnsec3(query_ctx_t *qctx) {
+	enum { CLOSEST, NEXTCLOSER, WILDCARD, NPROOFS };
+	dns_fixedname_t fzone, fnamespace, fprobe, fhash, fname, fwild;
+	dns_fixedname_t fproof[NPROOFS];
+	dns_name_t *zone = NULL, *namespace = NULL, *probe = NULL;
+	dns_name_t *name = NULL, *wild = NULL, *hashname = NULL;
+	dns_name_t *soaname = NULL;
+	dns_name_t *proofname[NPROOFS];
+	dns_rdataset_t proof[NPROOFS], sigproof[NPROOFS];
+	dns_rdataset_t *soardataset = NULL, *sigsoardataset = NULL;
+	const dns_name_t *qname = qctx->client->query.qname;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdata_nsec3_t nsec3;
+	dns_dbnode_t *node = NULL;
+	isc_buffer_t *dbuf, b;
+	unsigned char salt[255];
+	size_t saltlen;
+	dns_hash_t hashalg;
+	unsigned int iterations;
+	unsigned int labels, qlabels, zlabels;
+	bool nodata, done = false;
+	isc_result_t result;
+	dns_ttl_t ttl;
+
+	if (qctx->is_zone || !qctx->findcoveringnsec || qctx->zfname != NULL ||
+	    qctx->fname == NULL || dns_rdatatype_atparent(qctx->qtype) ||
+	    qctx->qtype == dns_rdatatype_any ||
+	    (!ISC_LIST_EMPTY(qctx->view->dns64) &&
+	     (qctx->qtype == dns_rdatatype_a ||
+	      qctx->qtype == dns_rdatatype_aaaa)))
+	{
+		return (false);
+	}
+
+	CCTRACE(ISC_LOG_DEBUG(3), "query_synthnsec3");
+
+	zone = dns_fixedname_initname(&fzone);
+	dns_name_copy(qctx->fname, zone);
+	namespace = dns_fixedname_initname(&fnamespace);
+	dns_view_sfd_find(qctx->view, qname, namespace);
+	if (!dns_name_issubdomain(zone, namespace) ||
+	    !dns_name_issubdomain(qname, zone))
+	{
+		return (false);
+	}
+
+	for (int i = 0; i < NPROOFS; i++) {
+		proofname[i] = dns_fixedname_initname(&fproof[i]);
+		dns_rdataset_init(&proof[i]);
+		dns_rdataset_init(&sigproof[i]);
+	}
+
+	/*
+	 * Learn the zone's NSEC3 hash parameters.
+	 */
+	probe = dns_fixedname_initname(&fprobe);
+	result = dns_name_concatenate(&nsec3last, zone, probe, NULL);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	result = query_findnsec3(qctx, probe, zone, proofname[CLOSEST],
+				 &proof[CLOSEST], &sigproof[CLOSEST]);
+	if (result == ISC_R_NOTFOUND) {
+		goto cleanup;
+	}
+	result = dns_rdataset_first(&proof[CLOSEST]);
+	if (result != ISC_R_SUCCESS) {
+		goto cleanup;
+	}
+	dns_rdataset_current(&proof[CLOSEST], &rdata);
+	result = dns_rdata_tostruct(&rdata, &nsec3, NULL);
+	if (result != ISC_R_SUCCESS || !dns_nsec3_supportedhash(nsec3.hash) ||
+	    nsec3.iterations > DNS_NSEC3_MAXITERATIONS)
+	{
+		goto cleanup;
+	}
+	hashalg = nsec3.hash;
+	iterations = nsec3.iterations;
+	saltlen = nsec3.salt_length;
+	memmove(salt, nsec3.salt, saltlen);
+	dns_rdataset_disassociate(&proof[CLOSEST]);
+	dns_rdataset_disassociate(&sigproof[CLOSEST]);
+
+	/*
+	 * Walk up from QNAME until a hashed name matches an NSEC3 record;
+	 * that is the closest encloser, and the record covering the name
+	 * one label below it proves the next closer name does not exist.
+	 */
+	name = dns_fixedname_initname(&fname);
+	qlabels = dns_name_countlabels(qname);
+	zlabels = dns_name_countlabels(zone);
+	for (labels = qlabels; labels >= zlabels; labels--) {
+		dns_name_split(qname, labels, NULL, name);
+		result = dns_nsec3_hashname(&fhash, NULL, NULL, name, zone,
+					    hashalg, iterations, salt, saltlen);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		hashname = dns_fixedname_name(&fhash);
+
+		if (dns_rdataset_isassociated(&proof[WILDCARD])) {
+			dns_rdataset_disassociate(&proof[WILDCARD]);
+			dns_rdataset_disassociate(&sigproof[WILDCARD]);
+		}
+		result = query_findnsec3(qctx, hashname, zone,
+					 proofname[WILDCARD], &proof[WILDCARD],
+					 &sigproof[WILDCARD]);
+		if (result == ISC_R_SUCCESS) {
+			dns_name_copy(proofname[WILDCARD], proofname[CLOSEST]);
+			dns_rdataset_clone(&proof[WILDCARD], &proof[CLOSEST]);
+			dns_rdataset_clone(&sigproof[WILDCARD],
+					   &sigproof[CLOSEST]);
+			break;
+		} else if (result != DNS_R_COVERINGNSEC) {
+			goto cleanup;
+		}
+
+		if (dns_rdataset_isassociated(&proof[NEXTCLOSER])) {
+			dns_rdataset_disassociate(&proof[NEXTCLOSER]);
+			dns_rdataset_disassociate(&sigproof[NEXTCLOSER]);
+		}
+		dns_name_copy(proofname[WILDCARD], proofname[NEXTCLOSER]);
+		dns_rdataset_clone(&proof[WILDCARD], &proof[NEXTCLOSER]);
+		dns_rdataset_clone(&sigproof[WILDCARD], &sigproof[NEXTCLOSER]);
+	}
+	if (dns_rdataset_isassociated(&proof[WILDCARD])) {
+		dns_rdataset_disassociate(&proof[WILDCARD]);
+		dns_rdataset_disassociate(&sigproof[WILDCARD]);
+	}
+	if (!dns_rdataset_isassociated(&proof[CLOSEST])) {
+		goto cleanup;
+	}
+
+	nodata = (labels == qlabels);
+	if (nodata) {
+		dns_fixedname_t fnsec3zone;
+		dns_name_t *nsec3zone = dns_fixedname_initname(&fnsec3zone);
+		bool exists = false, data = true;
+
+		if (dns_rdataset_isassociated(&proof[NEXTCLOSER])) {
+			dns_rdataset_disassociate(&proof[NEXTCLOSER]);
+			dns_rdataset_disassociate(&sigproof[NEXTCLOSER]);
+		}
+		result = dns_nsec3_noexistnodata(
+			qctx->qtype, qname, proofname[CLOSEST],
+			&proof[CLOSEST], nsec3zone, &exists, &data, NULL, NULL,
+			NULL, NULL, NULL, NULL, log_noexistnodata, qctx);
+		if (result != ISC_R_SUCCESS || !exists || data) {
+			goto cleanup;
+		}
+	} else {
+		dns_fixedname_t fnextcloser;
+		dns_name_t *nextcloser = dns_fixedname_initname(&fnextcloser);
+
+		if (qctx->view->redirect != NULL ||
+		    qctx->view->redirectzone != NULL)
+		{
+			goto cleanup;
+		}
+
+		dns_name_split(qname, labels + 1, NULL, nextcloser);
+		if (!query_checknsec3(qctx, qname, name, proofname[CLOSEST],
+				      &proof[CLOSEST], true) ||
+		    !query_checknsec3(qctx, qname, nextcloser,
+				      proofname[NEXTCLOSER], &proof[NEXTCLOSER],
+				      false))
+		{
+			goto cleanup;
+		}
+
+		/*
+		 * The wildcard at the closest encloser must not exist.
+		 */
+		wild = dns_fixedname_initname(&fwild);
+		result = dns_name_concatenate(dns_wildcardname, name, wild,
+					      NULL);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		result = dns_nsec3_hashname(&fhash, NULL, NULL, wild, zone,
+					    hashalg, iterations, salt, saltlen);
+		if (result != ISC_R_SUCCESS) {
+			goto cleanup;
+		}
+		hashname = dns_fixedname_name(&fhash);
+		result = query_findnsec3(qctx, hashname, zone,
+					 proofname[WILDCARD], &proof[WILDCARD],
+					 &sigproof[WILDCARD]);
+		if (result != DNS_R_COVERINGNSEC ||
+		    !query_checknsec3(qctx, qname, wild, proofname[WILDCARD],
+				      &proof[WILDCARD], false))
+		{
+			goto cleanup;
+		}
+	}
+
+	/*
+	 * Look for the SOA record of the zone.
+	 */
+	soardataset = ns_client_newrdataset(qctx->client);
+	sigsoardataset = ns_client_newrdataset(qctx->client);
+	result = dns_db_find(qctx->db, zone, qctx->version, dns_rdatatype_soa,
+			     qctx->client->query.dboptions, qctx->client->now,
+			     &node, probe, soardataset, sigsoardataset);
+	if (node != NULL) {
+		dns_db_detachnode(qctx->db, &node);
+	}
+	if (result != ISC_R_SUCCESS ||
+	    !dns_rdataset_isassociated(sigsoardataset))
+	{
+		goto cleanup;
+	}
+
+	/*
+	 * The negative answer is valid as long as all of its parts are.
+	 */
+	ttl = ISC_MIN(soardataset->ttl, sigsoardataset->ttl);
+	for (int i = 0; i < NPROOFS; i++) {
+		if (dns_rdataset_isassociated(&proof[i])) {
+			ttl = ISC_MIN(ttl, proof[i].ttl);
+			ttl = ISC_MIN(ttl, sigproof[i].ttl);
+		}
+	}
+	soardataset->ttl = sigsoardataset->ttl = ttl;
+
+	/*
+	 * Add the SOA record, and the proofs if DNSSEC was requested.
+	 */
+	dbuf = ns_client_getnamebuf(qctx->client);
+	soaname = ns_client_newname(qctx->client, dbuf, &b);
+	dns_name_copy(zone, soaname);
+	query_addrrset(qctx, &soaname, &soardataset,
+		       WANTDNSSEC(qctx->client) ? &sigsoardataset : NULL, dbuf,
+		       DNS_SECTION_AUTHORITY);
+	if (soaname != NULL) {
+		ns_client_releasename(qctx->client, &soaname);
+	}
+
+	for (int i = 0; WANTDNSSEC(qctx->client) && i < NPROOFS; i++) {
+		bool dup = false;
+
+		if (!dns_rdataset_isassociated(&proof[i])) {
+			continue;
+		}
+		for (int j = 0; j < i; j++) {
+			if (dns_rdataset_isassociated(&proof[j]) &&
+			    dns_name_equal(proofname[i], proofname[j]))
+			{
+				dup = true;
+			}
+		}
+		if (!dup) {
+			query_addnsec3(qctx, proofname[i], &proof[i],
+				       &sigproof[i]);
+		}
+	}
+
+	if (nodata) {
+		inc_stats(qctx->client, ns_statscounter_nodatasynth);
+	} else {
+		qctx->client->message->rcode = dns_rcode_nxdomain;
+		inc_stats(qctx->client, ns_statscounter_nxdomainsynth);
+	}
+	done = true;
+
+cleanup:
+	for (int i = 0; i < NPROOFS; i++) {
+		if (dns_rdataset_isassociated(&proof[i])) {
+			dns_rdataset_disassociate(&proof[i]);
+		}
+		if (dns_rdataset_isassociated(&sigproof[i])) {
+			dns_rdataset_disassociate(&sigproof[i]);
+		}
+	}
+	if (soardataset != NULL) {
+		ns_client_putrdataset(qctx->client, &soardataset);
+	}
+	if (sigsoardataset != NULL) {
+		ns_client_putrdataset(qctx->client, &sigsoardataset);
+	}
+	return (done);
+}
+
 /*%
  * Handle negative cache responses, DNS_R_NCACHENXRRSET or
  * DNS_R_NCACHENXDOMAIN. (Note: may also be called with result
@@ -11402,6 +12507,15 @@ cleanup:
 static void
 query_addauth(query_ctx_t *qctx) {
 	CCTRACE(ISC_LOG_DEBUG(3), "query_addauth");
+
+	/*
+	 * With minimal responses and no DNSSEC wildcard proof to add,
+	 * the authority section stays empty; don't set anything up.
+	 */
+	if (NOAUTHORITY(qctx->client) && !qctx->need_wildcardproof) {
+		return;
+	}
+
 	/*
 	 * Add NS records to the authority section (if we haven't already
 	 * added them to the answer section).
@@ -11509,7 +12623,8 @@ query_glueanswer(query_ctx_t *qctx) {
 	dns_message_t *msg;
 	dns_rdataset_t *rdataset = NULL;
 
-	if (!ISC_LIST_EMPTY(secs[DNS_SECTION_ANSWER]) ||
+	if (ISC_LIST_EMPTY(secs[section]) ||
+	    !ISC_LIST_EMPTY(secs[DNS_SECTION_ANSWER]) ||
 	    qctx->client->message->rcode != dns_rcode_noerror ||
 	    (qctx->qtype != dns_rdatatype_a &&
 	     qctx->qtype != dns_rdatatype_aaaa))
@@ -11549,6 +12664,7 @@ ns_query_done(query_ctx_t *qctx) {
 	bool nodetach;
 
 	CCTRACE(ISC_LOG_DEBUG(3), "ns_query_done");
+	LIBNS_QUERY_DONE(qctx->client);
 
 	CALL_HOOK(NS_QUERY_DONE_BEGIN, qctx);
 
@@ -11639,7 +12755,9 @@ ns_query_done(query_ctx_t *qctx) {
 	 * to the AA bit if the auth-nxdomain config option
 	 * says so, then render and send the response.
 	 */
-	query_setup_sortlist(qctx);
+	if (qctx->client->view->sortlist != NULL) {
+		query_setup_sortlist(qctx);
+	}
 	query_glueanswer(qctx);
 
 	if (qctx->client->message->rcode == dns_rcode_nxdomain &&
@@ -11862,6 +12980,9 @@ ns_query_start(ns_client_t *client, isc_nmhandle_t *handle) {
 	saved_flags = client->message->flags;
 
 	CTRACE(ISC_LOG_DEBUG(3), "ns_query_start");
+	LIBNS_QUERY_START(client);
+	client->query.timing.setup = query_reqlatency(client,
+						      ns_latency_setup);
 
 	/*
 	 * Ensure that appropriate cleanups occur.
@@ -15,7 +15,9 @@
 
 #include <stdbool.h>
 
+#include <isc/hash.h>
 #include <isc/mem.h>
+#include <isc/netaddr.h>
 #include <isc/stats.h>
 #include <isc/util.h>
 
@@ -25,6 +27,7 @@
 #include <ns/query.h>
 #include <ns/server.h>
 #include <ns/stats.h>
+#include <ns/xfrout.h>
 
 #define SCTX_MAGIC    ISC_MAGIC('S', 'c', 't', 'x')
 #define SCTX_VALID(s) ISC_MAGIC_VALID(s, SCTX_MAGIC)
@@ -68,6 +71,8 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 	isc_quota_init(&sctx->updquota, 100);
 	ISC_LIST_INIT(sctx->http_quotas);
 	isc_mutex_init(&sctx->http_quotas_lock);
+	ISC_LIST_INIT(sctx->xfrcache);
+	isc_mutex_init(&sctx->xfrcache_lock);
 
 	ns_stats_create(mctx, ns_statscounter_max, &sctx->nsstats);
 
@@ -101,6 +106,11 @@ ns_server_create(isc_mem_t *mctx, ns_matchview_t matchingview,
 	isc_histomulti_create(mctx, DNS_SIZEHISTO_SIGBITSOUT,
 			      &sctx->tcpoutstats6);
 
+	for (int i = 0; i < ns_latency_max; i++) {
+		isc_histomulti_create(mctx, NS_LATENCY_SIGBITS,
+				      &sctx->latency[i]);
+	}
+
 	ISC_LIST_INIT(sctx->altsecrets);
 
 	sctx->magic = SCTX_MAGIC;
@@ -152,6 +162,9 @@ ns_server_detach(ns_server_t **sctxp) {
 		}
 		isc_mutex_destroy(&sctx->http_quotas_lock);
 
+		ns_xfr_setcachesize(sctx, 0);
+		isc_mutex_destroy(&sctx->xfrcache_lock);
+
 		if (sctx->server_id != NULL) {
 			isc_mem_free(sctx->mctx, sctx->server_id);
 		}
@@ -203,6 +216,12 @@ ns_server_detach(ns_server_t **sctxp) {
 			isc_histomulti_destroy(&sctx->tcpoutstats6);
 		}
 
+		for (int i = 0; i < ns_latency_max; i++) {
+			if (sctx->latency[i] != NULL) {
+				isc_histomulti_destroy(&sctx->latency[i]);
+			}
+		}
+
 		sctx->magic = 0;
 
 		isc_mem_putanddetach(&sctx->mctx, sctx, sizeof(*sctx));
@@ -242,6 +261,72 @@ ns_server_getoption(ns_server_t *sctx, unsigned int option) {
 	return ((sctx->options & option) != 0);
 }
 
+static atomic_uint_fast32_t *
+recursionprefix(ns_server_t *sctx, const isc_sockaddr_t *peer) {
+	isc_netaddr_t netaddr, v4addr;
+	uint32_t hash;
+
+	isc_netaddr_fromsockaddr(&netaddr, peer);
+	if (netaddr.family == AF_INET6 &&
+	    IN6_IS_ADDR_V4MAPPED(&netaddr.type.in6))
+	{
+		isc_netaddr_fromv4mapped(&v4addr, &netaddr);
+		netaddr = v4addr;
+	}
+
+	switch (netaddr.family) {
+	case AF_INET:
+		hash = isc_hash32(&netaddr.type.in, 3, true);
+		break;
+	case AF_INET6:
+		hash = isc_hash32(&netaddr.type.in6, 7, true);
+		break;
+	default:
+		hash = 0;
+		break;
+	}
+
+	return (&sctx->recursionprefixes[hash % NS_SERVER_RECURSIONPREFIXES]);
+}
+
+void
+ns_server_recursionstarted(ns_server_t *sctx, const isc_sockaddr_t *peer) {
+	REQUIRE(SCTX_VALID(sctx));
+	REQUIRE(peer != NULL);
+
+	if (atomic_fetch_add_relaxed(recursionprefix(sctx, peer), 1) == 0) {
+		atomic_fetch_add_relaxed(&sctx->recursionnetworks, 1);
+	}
+}
+
+void
+ns_server_recursionended(ns_server_t *sctx, const isc_sockaddr_t *peer) {
+	uint_fast32_t count;
+
+	REQUIRE(SCTX_VALID(sctx));
+	REQUIRE(peer != NULL);
+
+	count = atomic_fetch_sub_relaxed(recursionprefix(sctx, peer), 1);
+	INSIST(count > 0);
+	if (count == 1) {
+		atomic_fetch_sub_relaxed(&sctx->recursionnetworks, 1);
+	}
+}
+
+bool
+ns_server_recursionovershare(ns_server_t *sctx, const isc_sockaddr_t *peer) {
+	uint_fast32_t count, networks, used;
+
+	REQUIRE(SCTX_VALID(sctx));
+	REQUIRE(peer != NULL);
+
+	count = atomic_load_relaxed(recursionprefix(sctx, peer));
+	networks = atomic_load_relaxed(&sctx->recursionnetworks);
+	used = isc_quota_getused(&sctx->recursionquota);
+
+	return (networks > 1 && count * networks > used);
+}
+
 void
 ns_server_append_http_quota(ns_server_t *sctx, isc_quota_t *http_quota) {
 	REQUIRE(SCTX_VALID(sctx));
@@ -231,6 +231,7 @@ struct update {
 	dns_message_t *answer;
 	const dns_ssurule_t **rules;
 	size_t ruleslen;
+	update_t *next; /* next update sharing a group commit */
 };
 
 /*%
@@ -263,7 +264,11 @@ typedef struct {
 static void
 update_action(void *arg);
 static void
+update_commit(dns_zone_t *zone, void **args, size_t count);
+static void
 updatedone_action(void *arg);
+static void
+update_journaled(void *arg, isc_result_t result);
 static isc_result_t
 send_forward(ns_client_t *client, dns_zone_t *zone);
 static void
@@ -475,10 +480,11 @@ do_one_tuple(dns_difftuple_t **tuple, dns_db_t *db, dns_dbversion_t *ver,
 
 /*%
  * Perform the updates in 'updates' in version 'ver' of 'db' and log the
- * update in 'diff'.
+ * update in 'diff'.  On failure, 'diff' still logs the updates that
+ * were made.
  *
  * Ensures:
- * \li	'updates' is empty.
+ * \li	'updates' holds the updates that were not made.
  */
 static isc_result_t
 do_diff(dns_diff_t *updates, dns_db_t *db, dns_dbversion_t *ver,
@@ -492,6 +498,33 @@ do_diff(dns_diff_t *updates, dns_db_t *db, dns_dbversion_t *ver,
 	return (ISC_R_SUCCESS);
 
 failure:
+	return (result);
+}
+
+/*%
+ * Back out the changes logged in 'diff' from version 'ver' of 'db',
+ * newest first.
+ *
+ * Ensures:
+ * \li	'diff' is empty.
+ */
+static isc_result_t
+undo_diff(dns_diff_t *diff, dns_db_t *db, dns_dbversion_t *ver) {
+	isc_result_t result = ISC_R_SUCCESS;
+
+	while (result == ISC_R_SUCCESS && !ISC_LIST_EMPTY(diff->tuples)) {
+		dns_difftuple_t *t = ISC_LIST_TAIL(diff->tuples);
+		dns_diff_t temp_diff;
+
+		ISC_LIST_UNLINK(diff->tuples, t, link);
+		INSIST(t->op == DNS_DIFFOP_ADD || t->op == DNS_DIFFOP_DEL);
+		t->op = (t->op == DNS_DIFFOP_ADD) ? DNS_DIFFOP_DEL
+						  : DNS_DIFFOP_ADD;
+		dns_diff_init(diff->mctx, &temp_diff);
+		ISC_LIST_APPEND(temp_diff.tuples, t, link);
+		result = dns_diff_apply(&temp_diff, db, ver);
+		dns_diff_clear(&temp_diff);
+	}
 	dns_diff_clear(diff);
 	return (result);
 }
@@ -1901,7 +1934,11 @@ send_update(ns_client_t *client, dns_zone_t *zone) {
 	};
 
 	isc_nmhandle_attach(client->handle, &client->updatehandle);
-	isc_async_run(dns_zone_getloop(zone), update_action, uev);
+	if ((options & DNS_ZONEOPT_UPDGROUPCOMMIT) != 0) {
+		dns_zone_queueupdate(zone, update_commit, uev);
+	} else {
+		isc_async_run(dns_zone_getloop(zone), update_action, uev);
+	}
 	rules = NULL;
 
 failure:
@@ -2738,54 +2775,37 @@ isdnssec(dns_db_t *db, dns_dbversion_t *ver, dns_rdatatype_t privatetype) {
 	return (build_nsec || build_nsec3);
 }
 
-static void
-update_action(void *arg) {
-	update_t *uev = (update_t *)arg;
+/*%
+ * Check the prerequisites of the update request in 'uev' against version
+ * 'ver' of 'db' and, if they are met, perform its update section, logging
+ * the changes in 'diff'.  '*soa_serial_changed' is set if the request
+ * itself increments the SOA serial.
+ *
+ * On failure, 'diff' logs the changes that were made before it.
+ */
+static isc_result_t
+update_apply(update_t *uev, dns_db_t *db, dns_dbversion_t *ver,
+	     dns_diff_t *diff, bool *soa_serial_changed) {
 	dns_zone_t *zone = uev->zone;
 	ns_client_t *client = uev->client;
 	const dns_ssurule_t **rules = uev->rules;
 	size_t rule = 0, ruleslen = uev->ruleslen;
 	isc_result_t result;
-	dns_db_t *db = NULL;
-	dns_dbversion_t *oldver = NULL;
-	dns_dbversion_t *ver = NULL;
-	dns_diff_t diff; /* Pending updates. */
 	dns_diff_t temp; /* Pending RR existence assertions. */
-	bool soa_serial_changed = false;
 	isc_mem_t *mctx = client->manager->mctx;
 	dns_rdatatype_t covers;
 	dns_message_t *request = client->message;
-	dns_rdataclass_t zoneclass;
-	dns_name_t *zonename = NULL;
+	dns_rdataclass_t zoneclass = dns_db_class(db);
+	dns_name_t *zonename = dns_db_origin(db);
 	dns_ssutable_t *ssutable = NULL;
 	dns_fixedname_t tmpnamefixed;
 	dns_name_t *tmpname = NULL;
-	dns_zoneopt_t options;
-	bool had_dnskey;
+	dns_zoneopt_t options = dns_zone_getoptions(zone);
 	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
 	dns_ttl_t maxttl = 0;
-	uint32_t maxrecords;
-	uint64_t records;
-	bool is_inline, is_maintain, is_signing;
 
-	dns_diff_init(mctx, &diff);
 	dns_diff_init(mctx, &temp);
-
-	CHECK(dns_zone_getdb(zone, &db));
-	zonename = dns_db_origin(db);
-	zoneclass = dns_db_class(db);
 	dns_zone_getssutable(zone, &ssutable);
-	options = dns_zone_getoptions(zone);
-
-	is_inline = (!dns_zone_israw(zone) && dns_zone_issecure(zone));
-	is_maintain = ((dns_zone_getkeyopts(zone) & DNS_ZONEKEY_MAINTAIN) != 0);
-	is_signing = is_inline || (!is_inline && is_maintain);
-
-	/*
-	 * Get old and new versions now that queryacl has been checked.
-	 */
-	dns_db_currentversion(db, &oldver);
-	CHECK(dns_db_newversion(db, &ver));
 
 	/*
 	 * Check prerequisites.
@@ -3012,7 +3032,7 @@ update_action(void *arg) {
 						   "ignoring it");
 					continue;
 				}
-				soa_serial_changed = true;
+				*soa_serial_changed = true;
 			}
 
 			if (dns_rdatatype_atparent(rdata.type) &&
@@ -3132,7 +3152,7 @@ update_action(void *arg) {
 				add_rr_prepare_ctx_t ctx;
 				ctx.db = db;
 				ctx.ver = ver;
-				ctx.diff = &diff;
+				ctx.diff = diff;
 				ctx.name = name;
 				ctx.oldname = name;
 				ctx.update_rr = &rdata;
@@ -3149,18 +3169,18 @@ update_action(void *arg) {
 					dns_diff_clear(&ctx.add_diff);
 				} else {
 					result = do_diff(&ctx.del_diff, db, ver,
-							 &diff);
+							 diff);
 					if (result == ISC_R_SUCCESS) {
 						result = do_diff(&ctx.add_diff,
 								 db, ver,
-								 &diff);
+								 diff);
 					}
 					if (result != ISC_R_SUCCESS) {
 						dns_diff_clear(&ctx.del_diff);
 						dns_diff_clear(&ctx.add_diff);
 						goto failure;
 					}
-					CHECK(update_one_rr(db, ver, &diff,
+					CHECK(update_one_rr(db, ver, diff,
 							    DNS_DIFFOP_ADD,
 							    name, ttl, &rdata));
 				}
@@ -3183,12 +3203,12 @@ update_action(void *arg) {
 					CHECK(delete_if(type_not_soa_nor_ns_p,
 							db, ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				} else {
 					CHECK(delete_if(type_not_dnssec, db,
 							ver, name,
 							dns_rdatatype_any, 0,
-							&rdata, &diff));
+							&rdata, diff));
 				}
 			} else if (dns_name_equal(name, zonename) &&
 				   (rdata.type == dns_rdatatype_soa ||
@@ -3216,7 +3236,7 @@ update_action(void *arg) {
 				}
 				CHECK(delete_if(true_p, db, ver, name,
 						rdata.type, covers, &rdata,
-						&diff));
+						diff));
 			}
 		} else if (update_class == dns_rdataclass_none) {
 			char namestr[DNS_NAME_FORMATSIZE];
@@ -3283,13 +3303,104 @@ update_action(void *arg) {
 			update_log(client, zone, LOGLEVEL_PROTOCOL,
 				   "deleting an RR at %s %s", namestr, typestr);
 			CHECK(delete_if(rr_equal_p, db, ver, name, rdata.type,
-					covers, &rdata, &diff));
+					covers, &rdata, diff));
 		}
 	}
 	if (result != ISC_R_NOMORE) {
 		FAIL(result);
 	}
 
+	result = ISC_R_SUCCESS;
+
+failure:
+	dns_diff_clear(&temp);
+	if (ssutable != NULL) {
+		dns_ssutable_detach(&ssutable);
+	}
+	return (result);
+}
+
+static void
+update_action(void *arg) {
+	update_t *uev = (update_t *)arg;
+
+	update_commit(uev->zone, &arg, 1);
+}
+
+/*%
+ * Apply the update requests in 'args' to 'zone' in a single database
+ * version, so that they share one SOA serial increment, one round of
+ * re-signing and one journal transaction.  A request that fails has
+ * its own changes backed out without affecting the others.  If the
+ * checks made on the combined changes fail, the requests are retried
+ * one at a time so that each gets the result it would have had alone.
+ */
+static void
+update_commit(dns_zone_t *zone, void **args, size_t count) {
+	update_t *applied = NULL, **tailp = &applied;
+	ns_client_t *client = ((update_t *)args[0])->client;
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *oldver = NULL;
+	dns_dbversion_t *ver = NULL;
+	dns_diff_t diff; /* Pending updates. */
+	bool soa_serial_changed = false;
+	isc_mem_t *mctx = client->manager->mctx;
+	dns_name_t *zonename = NULL;
+	dns_zoneopt_t options;
+	bool had_dnskey;
+	dns_rdatatype_t privatetype = dns_zone_getprivatetype(zone);
+	uint32_t maxrecords;
+	uint64_t records;
+	bool is_inline, is_maintain, is_signing;
+	bool groupcommit = false, retry = false;
+
+	dns_diff_init(mctx, &diff);
+
+	CHECK(dns_zone_getdb(zone, &db));
+	zonename = dns_db_origin(db);
+	options = dns_zone_getoptions(zone);
+
+	is_inline = (!dns_zone_israw(zone) && dns_zone_issecure(zone));
+	is_maintain = ((dns_zone_getkeyopts(zone) & DNS_ZONEKEY_MAINTAIN) != 0);
+	is_signing = is_inline || (!is_inline && is_maintain);
+
+	/*
+	 * Get old and new versions now that queryacl has been checked.
+	 */
+	dns_db_currentversion(db, &oldver);
+	CHECK(dns_db_newversion(db, &ver));
+
+	for (size_t i = 0; i < count; i++) {
+		update_t *uev = args[i];
+		dns_diff_t udiff;
+		bool changed = false;
+
+		dns_diff_init(mctx, &udiff);
+		uev->result = update_apply(uev, db, ver, &udiff, &changed);
+		if (uev->result != ISC_R_SUCCESS && count == 1) {
+			dns_diff_clear(&udiff);
+			FAIL(uev->result);
+		} else if (uev->result != ISC_R_SUCCESS) {
+			CHECK(undo_diff(&udiff, db, ver));
+			continue;
+		}
+
+		while (!ISC_LIST_EMPTY(udiff.tuples)) {
+			dns_difftuple_t *t = ISC_LIST_HEAD(udiff.tuples);
+			ISC_LIST_UNLINK(udiff.tuples, t, link);
+			dns_diff_appendminimal(&diff, &t);
+		}
+		if (changed) {
+			soa_serial_changed = true;
+		}
+		*tailp = uev;
+		tailp = &uev->next;
+	}
+	if (applied != NULL) {
+		client = applied->client;
+	}
+
 	/*
 	 * Check that any changes to DNSKEY/NSEC3PARAM records make sense.
 	 * If they don't then back out all changes to DNSKEY/NSEC3PARAM
@@ -3399,6 +3510,23 @@ update_action(void *arg) {
 		}
 
 		journalfile = dns_zone_getjournal(zone);
+		if (journalfile != NULL &&
+		    (options & DNS_ZONEOPT_UPDGROUPCOMMIT) != 0)
+		{
+			/*
+			 * Commit to the database now so that the next
+			 * update builds on this one, but leave the journal
+			 * write, the notifies and the response to the
+			 * zone's next group commit.
+			 */
+			update_log(client, zone, LOGLEVEL_DEBUG,
+				   "committing update transaction, "
+				   "journal group commit pending");
+			dns_db_closeversion(db, &ver, true);
+			groupcommit = true;
+			result = ISC_R_SUCCESS;
+			goto common;
+		}
 		if (journalfile != NULL) {
 			update_log(client, zone, LOGLEVEL_DEBUG,
 				   "writing journal %s", journalfile);
@@ -3452,11 +3580,13 @@ failure:
 	if (ver != NULL) {
 		update_log(client, zone, LOGLEVEL_DEBUG, "rolling back");
 		dns_db_closeversion(db, &ver, false);
+		retry = (count > 1);
 	}
 
 common:
-	dns_diff_clear(&temp);
-	dns_diff_clear(&diff);
+	if (!groupcommit) {
+		dns_diff_clear(&diff);
+	}
 
 	if (oldver != NULL) {
 		dns_db_closeversion(db, &oldver, false);
@@ -3466,23 +3596,58 @@ common:
 		dns_db_detach(&db);
 	}
 
-	if (rules != NULL) {
-		isc_mem_cput(mctx, rules, ruleslen, sizeof(*rules));
+	if (retry) {
+		update_log(client, zone, LOGLEVEL_DEBUG,
+			   "retrying %zu updates one at a time", count);
+		for (size_t i = 0; i < count; i++) {
+			((update_t *)args[i])->next = NULL;
+			update_commit(zone, &args[i], 1);
+		}
+		return;
 	}
 
-	if (ssutable != NULL) {
-		dns_ssutable_detach(&ssutable);
-	}
+	for (size_t i = 0; i < count; i++) {
+		update_t *uev = args[i];
 
-	uev->result = result;
-	if (zone != NULL) {
 		INSIST(uev->zone == zone); /* we use this later */
+		if (result != ISC_R_SUCCESS) {
+			uev->result = result;
+		}
+		if (!groupcommit || uev->result != ISC_R_SUCCESS) {
+			isc_async_run(uev->client->manager->loop,
+				      updatedone_action, uev);
+		}
 	}
 
-	isc_async_run(client->manager->loop, updatedone_action, uev);
+	if (groupcommit) {
+		/*
+		 * The updates that were applied now belong to the group
+		 * commit; the tuples are moved out of 'diff'.
+		 */
+		dns_zone_journalcommit(zone, &diff, update_journaled, applied);
+	}
 	INSIST(ver == NULL);
 }
 
+static void
+update_journaled(void *arg, isc_result_t result) {
+	update_t *uev = (update_t *)arg, *next = NULL;
+
+	for (; uev != NULL; uev = next) {
+		ns_client_t *client = uev->client;
+
+		next = uev->next;
+		if (result != ISC_R_SUCCESS) {
+			update_log(client, uev->zone, LOGLEVEL_PROTOCOL,
+				   "error: journal write failed: %s",
+				   isc_result_totext(result));
+			uev->result = result;
+		}
+
+		isc_async_run(client->manager->loop, updatedone_action, uev);
+	}
+}
+
 static void
 updatedone_action(void *arg) {
 	update_t *uev = (update_t *)arg;
@@ -3505,6 +3670,10 @@ updatedone_action(void *arg) {
 	respond(client, uev->result);
 
 	isc_quota_release(&client->manager->sctx->updquota);
+	if (uev->rules != NULL) {
+		isc_mem_cput(client->manager->mctx, uev->rules, uev->ruleslen,
+			     sizeof(*uev->rules));
+	}
 	if (uev->zone != NULL) {
 		dns_zone_detach(&uev->zone);
 	}
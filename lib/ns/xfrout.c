@@ -222,16 +222,20 @@ ixfr_rrstream_destroy(rrstream_t **sp);
 static rrstream_methods_t ixfr_rrstream_methods;
 
 /*
+ * If 'raw' is true, the rdata of the stream refers to the journal data
+ * without being checked, so it must only be copied out verbatim.
+ *
  * Returns: anything dns_journal_open() or dns_journal_iter_init()
  * may return.
  */
 
 static isc_result_t
 ixfr_rrstream_create(isc_mem_t *mctx, const char *journal_filename,
-		     uint32_t begin_serial, uint32_t end_serial, size_t *sizep,
-		     rrstream_t **sp) {
+		     uint32_t begin_serial, uint32_t end_serial, bool raw,
+		     size_t *sizep, rrstream_t **sp) {
 	isc_result_t result;
 	ixfr_rrstream_t *s = NULL;
+	unsigned int mode = DNS_JOURNAL_READ;
 
 	INSIST(sp != NULL && *sp == NULL);
 
@@ -241,8 +245,10 @@ ixfr_rrstream_create(isc_mem_t *mctx, const char *journal_filename,
 	s->common.methods = &ixfr_rrstream_methods;
 	s->journal = NULL;
 
-	CHECK(dns_journal_open(mctx, journal_filename, DNS_JOURNAL_READ,
-			       &s->journal));
+	if (raw) {
+		mode |= DNS_JOURNAL_RAW;
+	}
+	CHECK(dns_journal_open(mctx, journal_filename, mode, &s->journal));
 	CHECK(dns_journal_iter_init(s->journal, begin_serial, end_serial,
 				    sizep));
 
@@ -655,14 +661,20 @@ typedef struct {
 	isc_buffer_t buf;    /* Buffer for message owner
 			      * names and rdatas */
 	isc_buffer_t txbuf;  /* Transmit message buffer */
-	size_t cbytes;	     /* Length of current message */
-	void *txmem;
+	size_t cbytes[2];    /* Lengths of messages being sent */
+	unsigned int txfirst; /* Half of txmem sent first */
+	void *txmem;	      /* Room for two messages */
 	unsigned int txmemlen;
 	dns_tsigkey_t *tsigkey; /* Key used to create TSIG */
 	isc_buffer_t *lasttsig; /* the last TSIG */
 	bool verified_tsig;	/* verified request MAC */
 	bool many_answers;
-	int sends; /* Send in progress */
+	bool direct; /* Render RRs straight into txbuf */
+	ns_xfrcache_t *cache;		/* Pre-rendered messages */
+	bool usecache;			/* Sending from 'cache' */
+	struct xfrcache_chunk *cachechunk; /* Next cached message */
+	size_t cacheoff;
+	int sends;   /* Sends in progress, at most two */
 	bool shuttingdown;
 	bool poll;
 	const char *mnemonic;	/* Style of transfer */
@@ -718,6 +730,323 @@ xfrout_log(xfrout_ctx_t *xfr, int level, const char *fmt, ...)
 static void
 xfrout_delayed_timeout(void *arg, isc_result_t result);
 
+/**************************************************************************/
+/*
+ * Pre-rendered AXFR messages.
+ *
+ * The first "many-answers" AXFR of a zone version sent over TCP saves
+ * the rendered answer section of each message it sends, so that later
+ * transfers of the same version can copy them into their own messages
+ * instead of walking and rendering the database again.  Each transfer
+ * still renders its own header, question, OPT and TSIG records.
+ *
+ * Entries are kept on a list in the server context, most recently used
+ * first, and are identified by the zone database, the SOA serial and
+ * the exact question name: owner names in the saved messages may be
+ * compressed against the question.  The list holds one reference, and
+ * each transfer building or sending an entry holds another, so entries
+ * dropped from the list stay usable until those transfers are done.
+ */
+
+#define XFRCACHE_MAGIC	  ISC_MAGIC('X', 'f', 'r', 'C')
+#define VALID_XFRCACHE(c) ISC_MAGIC_VALID(c, XFRCACHE_MAGIC)
+
+/*%
+ * Saved messages are appended to chunks of this size, each message
+ * preceded by its length and answer count.
+ */
+#define XFRCACHE_CHUNKSIZE 65536
+
+/*%
+ * Messages larger than this are not saved, so that there is always
+ * room left for the OPT and TSIG records of later transfers.
+ */
+#define XFRCACHE_MAXMESSAGE (65535 - 2048)
+
+typedef struct xfrcache_chunk xfrcache_chunk_t;
+struct xfrcache_chunk {
+	ISC_LINK(xfrcache_chunk_t) link;
+	size_t used;
+	unsigned char data[];
+};
+
+struct ns_xfrcache {
+	unsigned int magic;
+	isc_mem_t *mctx;
+	isc_refcount_t references;
+	ISC_LINK(ns_xfrcache_t) link;
+	bool linked;   /* On the server's list */
+	bool complete; /* All messages have been saved */
+	dns_db_t *db;
+	uint32_t serial;
+	dns_fixedname_t fqname;
+	dns_name_t *qname;
+	size_t size;
+	unsigned int nmsgs;
+	ISC_LIST(xfrcache_chunk_t) chunks;
+};
+
+static void
+xfrcache_detach(ns_xfrcache_t **cachep) {
+	ns_xfrcache_t *cache = *cachep;
+	xfrcache_chunk_t *chunk = NULL;
+
+	REQUIRE(VALID_XFRCACHE(cache));
+
+	*cachep = NULL;
+
+	if (isc_refcount_decrement(&cache->references) > 1) {
+		return;
+	}
+
+	INSIST(!cache->linked);
+	while ((chunk = ISC_LIST_HEAD(cache->chunks)) != NULL) {
+		ISC_LIST_UNLINK(cache->chunks, chunk, link);
+		isc_mem_put(cache->mctx, chunk,
+			    sizeof(*chunk) + XFRCACHE_CHUNKSIZE);
+	}
+	dns_db_detach(&cache->db);
+	cache->magic = 0;
+	isc_mem_putanddetach(&cache->mctx, cache, sizeof(*cache));
+}
+
+/*
+ * Drop 'cache' from the server's list.  Caller must hold the lock.
+ */
+static void
+xfrcache_unlink(ns_server_t *sctx, ns_xfrcache_t *cache) {
+	INSIST(cache->linked);
+
+	ISC_LIST_UNLINK(sctx->xfrcache, cache, link);
+	INSIST(sctx->xfrcache_size >= cache->size);
+	sctx->xfrcache_size -= cache->size;
+	cache->linked = false;
+	xfrcache_detach(&cache);
+}
+
+/*
+ * Drop least recently used entries other than 'keep' until 'need'
+ * more bytes fit within the configured size.  Caller must hold the
+ * lock.
+ */
+static bool
+xfrcache_prune(ns_server_t *sctx, ns_xfrcache_t *keep, size_t need) {
+	ns_xfrcache_t *cache = ISC_LIST_TAIL(sctx->xfrcache);
+
+	while (cache != NULL &&
+	       sctx->xfrcache_size + need > sctx->xfrcache_max)
+	{
+		ns_xfrcache_t *prev = ISC_LIST_PREV(cache, link);
+		if (cache != keep) {
+			xfrcache_unlink(sctx, cache);
+		}
+		cache = prev;
+	}
+
+	return (sctx->xfrcache_size + need <= sctx->xfrcache_max);
+}
+
+void
+ns_xfr_setcachesize(ns_server_t *sctx, size_t size) {
+	REQUIRE(sctx != NULL);
+
+	LOCK(&sctx->xfrcache_lock);
+	sctx->xfrcache_max = size;
+	(void)xfrcache_prune(sctx, NULL, 0);
+	UNLOCK(&sctx->xfrcache_lock);
+}
+
+/*
+ * Find the saved messages for the zone version sent by 'xfr', or, if
+ * there are none and no other transfer is saving them, make 'xfr'
+ * save them.
+ */
+static void
+xfrcache_start(xfrout_ctx_t *xfr) {
+	ns_server_t *sctx = xfr->client->manager->sctx;
+	ns_xfrcache_t *cache = NULL, *next = NULL;
+
+	if (sctx->xfrcache_max == 0) {
+		return;
+	}
+
+	LOCK(&sctx->xfrcache_lock);
+	for (cache = ISC_LIST_HEAD(sctx->xfrcache); cache != NULL;
+	     cache = next)
+	{
+		next = ISC_LIST_NEXT(cache, link);
+		if (cache->db != xfr->db) {
+			continue;
+		}
+		if (cache->serial != xfr->end_serial) {
+			/* Superseded by a newer version of the zone. */
+			if (cache->complete) {
+				xfrcache_unlink(sctx, cache);
+			}
+			continue;
+		}
+		if (!dns_name_caseequal(cache->qname, xfr->qname)) {
+			continue;
+		}
+		if (cache->complete) {
+			ISC_LIST_UNLINK(sctx->xfrcache, cache, link);
+			ISC_LIST_PREPEND(sctx->xfrcache, cache, link);
+			isc_refcount_increment(&cache->references);
+			xfr->cache = cache;
+			xfr->usecache = true;
+			xfr->cachechunk = ISC_LIST_HEAD(cache->chunks);
+			xfr->cacheoff = 0;
+		}
+		/* Otherwise another transfer is still saving it. */
+		UNLOCK(&sctx->xfrcache_lock);
+		return;
+	}
+
+	cache = isc_mem_get(sctx->mctx, sizeof(*cache));
+	*cache = (ns_xfrcache_t){
+		.serial = xfr->end_serial,
+		.link = ISC_LINK_INITIALIZER,
+		.linked = true,
+		.chunks = ISC_LIST_INITIALIZER,
+	};
+	isc_mem_attach(sctx->mctx, &cache->mctx);
+	isc_refcount_init(&cache->references, 2);
+	dns_db_attach(xfr->db, &cache->db);
+	cache->qname = dns_fixedname_initname(&cache->fqname);
+	dns_name_copy(xfr->qname, cache->qname);
+	cache->magic = XFRCACHE_MAGIC;
+	ISC_LIST_PREPEND(sctx->xfrcache, cache, link);
+	UNLOCK(&sctx->xfrcache_lock);
+
+	xfr->cache = cache;
+}
+
+/*
+ * Stop saving messages for later transfers.
+ */
+static void
+xfrcache_abandon(xfrout_ctx_t *xfr) {
+	ns_server_t *sctx = xfr->client->manager->sctx;
+
+	LOCK(&sctx->xfrcache_lock);
+	if (xfr->cache->linked) {
+		xfrcache_unlink(sctx, xfr->cache);
+	}
+	UNLOCK(&sctx->xfrcache_lock);
+
+	xfrcache_detach(&xfr->cache);
+}
+
+/*
+ * Save the rendered answer section 'r' of the message being sent.
+ */
+static void
+xfrcache_save(xfrout_ctx_t *xfr, const isc_region_t *r,
+	      unsigned int ancount) {
+	ns_server_t *sctx = xfr->client->manager->sctx;
+	ns_xfrcache_t *cache = xfr->cache;
+	xfrcache_chunk_t *chunk = ISC_LIST_TAIL(cache->chunks);
+	uint16_t hdr[2];
+
+	if (12 + xfr->qname->length + 4 + r->length > XFRCACHE_MAXMESSAGE) {
+		xfrcache_abandon(xfr);
+		return;
+	}
+
+	if (chunk == NULL ||
+	    XFRCACHE_CHUNKSIZE - chunk->used < sizeof(hdr) + r->length)
+	{
+		bool fits;
+
+		LOCK(&sctx->xfrcache_lock);
+		fits = cache->linked &&
+		       xfrcache_prune(sctx, cache, XFRCACHE_CHUNKSIZE);
+		if (fits) {
+			cache->size += XFRCACHE_CHUNKSIZE;
+			sctx->xfrcache_size += XFRCACHE_CHUNKSIZE;
+		}
+		UNLOCK(&sctx->xfrcache_lock);
+
+		if (!fits) {
+			xfrout_log(xfr, ISC_LOG_DEBUG(1),
+				   "transfer-cache-size reached, "
+				   "not saving messages");
+			xfrcache_abandon(xfr);
+			return;
+		}
+
+		chunk = isc_mem_get(cache->mctx,
+				    sizeof(*chunk) + XFRCACHE_CHUNKSIZE);
+		*chunk = (xfrcache_chunk_t){
+			.link = ISC_LINK_INITIALIZER,
+		};
+		ISC_LIST_APPEND(cache->chunks, chunk, link);
+	}
+
+	hdr[0] = (uint16_t)r->length;
+	hdr[1] = (uint16_t)ancount;
+	memmove(chunk->data + chunk->used, hdr, sizeof(hdr));
+	memmove(chunk->data + chunk->used + sizeof(hdr), r->base, r->length);
+	chunk->used += sizeof(hdr) + r->length;
+	cache->nmsgs++;
+}
+
+/*
+ * All messages have been saved; make them available to other
+ * transfers.
+ */
+static void
+xfrcache_finish(xfrout_ctx_t *xfr) {
+	ns_server_t *sctx = xfr->client->manager->sctx;
+	bool complete;
+
+	LOCK(&sctx->xfrcache_lock);
+	complete = xfr->cache->linked;
+	xfr->cache->complete = complete;
+	UNLOCK(&sctx->xfrcache_lock);
+
+	if (complete) {
+		xfrout_log(xfr, ISC_LOG_DEBUG(1),
+			   "saved %u messages (%zu bytes) for reuse",
+			   xfr->cache->nmsgs, xfr->cache->size);
+	}
+	xfrcache_detach(&xfr->cache);
+}
+
+/*
+ * Copy the next saved answer section into 'msg'.
+ */
+static isc_result_t
+xfrcache_render(xfrout_ctx_t *xfr, dns_message_t *msg) {
+	xfrcache_chunk_t *chunk = xfr->cachechunk;
+	isc_region_t r;
+	uint16_t hdr[2];
+	isc_result_t result;
+
+	INSIST(chunk != NULL && xfr->cacheoff < chunk->used);
+
+	memmove(hdr, chunk->data + xfr->cacheoff, sizeof(hdr));
+	r.base = chunk->data + xfr->cacheoff + sizeof(hdr);
+	r.length = hdr[0];
+
+	result = dns_message_renderraw(msg, &r, hdr[1], 0, 0);
+	if (result != ISC_R_SUCCESS) {
+		return (result);
+	}
+
+	xfr->stats.nrecs += hdr[1];
+	xfr->cacheoff += sizeof(hdr) + r.length;
+	if (xfr->cacheoff == chunk->used) {
+		xfr->cachechunk = ISC_LIST_NEXT(chunk, link);
+		xfr->cacheoff = 0;
+	}
+	if (xfr->cachechunk == NULL) {
+		xfr->end_of_stream = true;
+	}
+
+	return (ISC_R_SUCCESS);
+}
+
 /**************************************************************************/
 
 void
@@ -751,6 +1080,7 @@ ns_xfr_start(ns_client_t *client, dns_rdatatype_t reqtype) {
 	bool is_poll = false;
 	bool is_dlz = false;
 	bool is_ixfr = false;
+	bool is_tcp = ((client->attributes & NS_CLIENTATTR_TCP) != 0);
 	bool useviewacl = false;
 	uint32_t begin_serial = 0, current_serial;
 
@@ -1026,7 +1356,7 @@ got_soa:
 		if (journalfile != NULL) {
 			result = ixfr_rrstream_create(
 				mctx, journalfile, begin_serial, current_serial,
-				&jsize, &data_stream);
+				is_tcp, &jsize, &data_stream);
 		} else {
 			result = ISC_R_NOTFOUND;
 		}
@@ -1106,8 +1436,21 @@ have_stream:
 
 	xfr->end_serial = current_serial;
 	xfr->mnemonic = mnemonic;
+	/*
+	 * The journal data of an IXFR over TCP is copied into the
+	 * messages as it is, without going through dns_message_t.
+	 */
+	xfr->direct = is_ixfr && is_tcp;
 	stream = NULL;
 
+	/*
+	 * A full transfer may reuse, or save for reuse, the messages
+	 * of another transfer of the same zone version.
+	 */
+	if (!is_ixfr && !is_poll && !is_dlz && is_tcp && xfr->many_answers) {
+		xfrcache_start(xfr);
+	}
+
 	CHECK(xfr->stream->methods->first(xfr->stream));
 
 	if (xfr->tsigkey != NULL) {
@@ -1274,12 +1617,13 @@ xfrout_ctx_create(isc_mem_t *mctx, ns_client_t *client, unsigned int id,
 
 	/*
 	 * Allocate another temporary buffer for the compressed
-	 * response message.
+	 * response messages: over TCP, the next message is rendered
+	 * into one half while the other half is being sent.
 	 */
-	mem = isc_mem_get(mctx, len);
+	mem = isc_mem_get(mctx, 2 * len);
 	isc_buffer_init(&xfr->txbuf, (char *)mem, len);
 	xfr->txmem = mem;
-	xfr->txmemlen = len;
+	xfr->txmemlen = 2 * len;
 
 	/*
 	 * These MUST be after the last "goto failure;" / CHECK to
@@ -1296,20 +1640,23 @@ xfrout_send(xfrout_ctx_t *xfr) {
 			     0);
 
 	if (is_tcp) {
+		isc_nmhandle_t *sendhandle = NULL;
 		isc_region_t used;
 
 		isc_buffer_usedregion(&xfr->txbuf, &used);
 
-		isc_nmhandle_attach(xfr->client->handle,
-				    &xfr->client->sendhandle);
+		/*
+		 * Two messages may be in flight, so the handle reference
+		 * for each send is dropped by xfrout_senddone() rather than
+		 * kept in client->sendhandle.
+		 */
+		isc_nmhandle_attach(xfr->client->handle, &sendhandle);
 		if (xfr->idletime > 0) {
-			isc_nmhandle_setwritetimeout(xfr->client->sendhandle,
-						     xfr->idletime);
+			isc_nmhandle_setwritetimeout(sendhandle, xfr->idletime);
 		}
-		isc_nm_send(xfr->client->sendhandle, &used, xfrout_senddone,
-			    xfr);
+		isc_nm_send(sendhandle, &used, xfrout_senddone, xfr);
+		xfr->cbytes[(xfr->txfirst + xfr->sends) % 2] = used.length;
 		xfr->sends++;
-		xfr->cbytes = used.length;
 	} else {
 		ns_client_send(xfr->client);
 		xfr->stream->methods->pause(xfr->stream);
@@ -1380,9 +1727,14 @@ sendstream(xfrout_ctx_t *xfr) {
 	bool cleanup_cctx = false;
 	bool is_tcp;
 	int n_rrs;
+	unsigned int txlen = xfr->txmemlen / 2;
+	unsigned int txslot = (xfr->txfirst + xfr->sends) % 2;
 
 	isc_buffer_clear(&xfr->buf);
-	isc_buffer_clear(&xfr->txbuf);
+
+	/* Render into the half of txmem that is not being sent */
+	isc_buffer_init(&xfr->txbuf, (char *)xfr->txmem + txslot * txlen,
+			txlen);
 
 	is_tcp = ((xfr->client->attributes & NS_CLIENTATTR_TCP) != 0);
 	if (!is_tcp) {
@@ -1481,6 +1833,21 @@ sendstream(xfrout_ctx_t *xfr) {
 			isc_buffer_add(&xfr->buf, 12);
 			msg->tcp_continuation = 1;
 		}
+
+		if (xfr->direct || xfr->usecache) {
+			dns_compress_init(&cctx, xfr->mctx,
+					  DNS_COMPRESS_CASE |
+						  DNS_COMPRESS_LARGE);
+			cleanup_cctx = true;
+			CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
+			CHECK(dns_message_rendersection(
+				msg, DNS_SECTION_QUESTION, 0));
+		}
+
+		if (xfr->usecache) {
+			CHECK(xfrcache_render(xfr, msg));
+			goto render;
+		}
 	}
 
 	/*
@@ -1502,6 +1869,29 @@ sendstream(xfrout_ctx_t *xfr) {
 
 		xfr->stream->methods->current(xfr->stream, &name, &ttl, &rdata);
 		size = name->length + 10 + rdata->length;
+		if (xfr->direct) {
+			/*
+			 * Only the owner name is compressed; the rdata
+			 * goes out as it was stored in the journal.
+			 */
+			result = dns_message_renderrr(msg, DNS_SECTION_ANSWER,
+						      name, ttl, rdata);
+			if (result == ISC_R_NOSPACE && n_rrs != 0) {
+				break;
+			}
+			if (result == ISC_R_NOSPACE) {
+				xfrout_log(xfr, ISC_LOG_WARNING,
+					   "RR too large for zone transfer "
+					   "(%d bytes)",
+					   size);
+			}
+			CHECK(result);
+
+			if (isc_log_wouldlog(ns_lctx, XFROUT_RR_LOGLEVEL)) {
+				log_rr(name, rdata, ttl); /* XXX */
+			}
+			goto next;
+		}
 		isc_buffer_availableregion(&xfr->buf, &r);
 		if (size >= r.length) {
 			/*
@@ -1570,6 +1960,7 @@ sendstream(xfrout_ctx_t *xfr) {
 		dns_message_addname(msg, msgname, DNS_SECTION_ANSWER);
 		msgname = NULL;
 
+	next:
 		xfr->stats.nrecs++;
 
 		result = xfr->stream->methods->next(xfr->stream);
@@ -1587,7 +1978,8 @@ sendstream(xfrout_ctx_t *xfr) {
 		 * the message. Check if we want to clamp this message
 		 * here (TCP only).
 		 */
-		if ((isc_buffer_usedlength(&xfr->buf) >=
+		if ((isc_buffer_usedlength(xfr->direct ? &xfr->txbuf
+							: &xfr->buf) >=
 		     xfr->client->manager->sctx->transfer_tcp_message_size) &&
 		    is_tcp)
 		{
@@ -1595,13 +1987,34 @@ sendstream(xfrout_ctx_t *xfr) {
 		}
 	}
 
+render:
 	if (is_tcp) {
-		dns_compress_init(&cctx, xfr->mctx,
-				  DNS_COMPRESS_CASE | DNS_COMPRESS_LARGE);
-		cleanup_cctx = true;
-		CHECK(dns_message_renderbegin(msg, &cctx, &xfr->txbuf));
-		CHECK(dns_message_rendersection(msg, DNS_SECTION_QUESTION, 0));
-		CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER, 0));
+		if (!xfr->direct && !xfr->usecache) {
+			unsigned int answerstart;
+
+			dns_compress_init(&cctx, xfr->mctx,
+					  DNS_COMPRESS_CASE |
+						  DNS_COMPRESS_LARGE);
+			cleanup_cctx = true;
+			CHECK(dns_message_renderbegin(msg, &cctx,
+						      &xfr->txbuf));
+			CHECK(dns_message_rendersection(
+				msg, DNS_SECTION_QUESTION, 0));
+			answerstart = isc_buffer_usedlength(&xfr->txbuf);
+			CHECK(dns_message_rendersection(msg, DNS_SECTION_ANSWER,
+							0));
+			if (xfr->cache != NULL) {
+				isc_region_t answer;
+
+				isc_buffer_usedregion(&xfr->txbuf, &answer);
+				isc_region_consume(&answer, answerstart);
+				xfrcache_save(xfr, &answer,
+					      msg->counts[DNS_SECTION_ANSWER]);
+			}
+			if (xfr->cache != NULL && xfr->end_of_stream) {
+				xfrcache_finish(xfr);
+			}
+		}
 		CHECK(dns_message_renderend(msg));
 		dns_compress_invalidate(&cctx);
 		cleanup_cctx = false;
@@ -1636,6 +2049,17 @@ failure:
 	xfr->stream->methods->pause(xfr->stream);
 
 	if (result == ISC_R_SUCCESS) {
+		/*
+		 * Over TCP, render the next message while this one is
+		 * being sent, so that the connection does not sit idle
+		 * while we walk the database.  A delayed send (see
+		 * xfrout_enqueue_send()) has not been counted yet.
+		 */
+		if (xfr->sends == 1 && !xfr->end_of_stream &&
+		    !xfr->shuttingdown)
+		{
+			sendstream(xfr);
+		}
 		return;
 	}
 
@@ -1658,6 +2082,13 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 	if (xfr->stream != NULL) {
 		xfr->stream->methods->destroy(&xfr->stream);
 	}
+	if (xfr->cache != NULL) {
+		if (xfr->usecache) {
+			xfrcache_detach(&xfr->cache);
+		} else {
+			xfrcache_abandon(xfr);
+		}
+	}
 	if (xfr->buf.base != NULL) {
 		isc_mem_put(xfr->mctx, xfr->buf.base, xfr->buf.length);
 	}
@@ -1686,15 +2117,20 @@ xfrout_ctx_destroy(xfrout_ctx_t **xfrp) {
 static void
 xfrout_senddone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	xfrout_ctx_t *xfr = (xfrout_ctx_t *)arg;
+	isc_nmhandle_t *sendhandle = handle;
+	size_t cbytes;
 
 	REQUIRE((xfr->client->attributes & NS_CLIENTATTR_TCP) != 0);
 
 	INSIST(handle == xfr->client->handle);
+	INSIST(xfr->sends > 0);
 
+	/* Sends complete in the order they were made */
+	cbytes = xfr->cbytes[xfr->txfirst];
+	xfr->txfirst = (xfr->txfirst + 1) % 2;
 	xfr->sends--;
-	INSIST(xfr->sends == 0);
 
-	isc_nmhandle_detach(&xfr->client->sendhandle);
+	isc_nmhandle_detach(&sendhandle);
 
 	/*
 	 * Update transfer statistics if sending succeeded, accounting for the
@@ -1702,15 +2138,19 @@ xfrout_senddone(isc_nmhandle_t *handle, isc_result_t result, void *arg) {
 	 */
 	if (result == ISC_R_SUCCESS) {
 		xfr->stats.nmsg++;
-		xfr->stats.nbytes += xfr->cbytes;
+		xfr->stats.nbytes += cbytes;
 	}
 
 	if (xfr->shuttingdown) {
-		xfrout_maybe_destroy(xfr);
+		if (xfr->sends == 0) {
+			xfrout_maybe_destroy(xfr);
+		}
 	} else if (result != ISC_R_SUCCESS) {
 		xfrout_fail(xfr, result, "send");
 	} else if (!xfr->end_of_stream) {
 		sendstream(xfr);
+	} else if (xfr->sends > 0) {
+		/* Wait for the last message to be sent */
 	} else {
 		/* End of zone transfer stream. */
 		uint64_t msecs, persec;
@@ -1747,7 +2187,10 @@ xfrout_fail(xfrout_ctx_t *xfr, isc_result_t result, const char *msg) {
 	xfr->shuttingdown = true;
 	xfrout_log(xfr, ISC_LOG_ERROR, "%s: %s", msg,
 		   isc_result_totext(result));
-	xfrout_maybe_destroy(xfr);
+	if (xfr->sends == 0) {
+		/* Otherwise, xfrout_senddone() will clean up */
+		xfrout_maybe_destroy(xfr);
+	}
 }
 
 static void
@@ -0,0 +1,93 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <isc/base32.h>
+#include <isc/base64.h>
+#include <isc/buffer.h>
+#include <isc/hex.h>
+#include <isc/random.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+/*
+ * Encode and decode binary data of the sizes found in DNS records:
+ * NSEC3 hashes, TSIG secrets, and DNSKEY and RRSIG keys and signatures.
+ */
+
+#define ROUNDS 100000
+
+typedef isc_result_t
+totext_fn(isc_region_t *source, int wordlength, const char *wordbreak,
+	  isc_buffer_t *target);
+
+typedef isc_result_t
+decode_fn(const char *cstr, isc_buffer_t *target);
+
+static void
+bench(const char *name, totext_fn *totext, decode_fn *decode, size_t len) {
+	static uint8_t bytes[1024], decoded[1024];
+	static char text[4096];
+	isc_buffer_t buf;
+	isc_region_t region;
+	isc_nanosecs_t start, encode_ns, decode_ns;
+
+	isc_random_buf(bytes, len);
+
+	start = isc_time_monotonic();
+	for (size_t i = 0; i < ROUNDS; i++) {
+		region = (isc_region_t){ .base = bytes, .length = len };
+		isc_buffer_init(&buf, text, sizeof(text) - 1);
+		isc_result_t result = totext(&region, -1, "", &buf);
+		assert(result == ISC_R_SUCCESS);
+	}
+	encode_ns = isc_time_monotonic() - start;
+	text[isc_buffer_usedlength(&buf)] = '\0';
+
+	start = isc_time_monotonic();
+	for (size_t i = 0; i < ROUNDS; i++) {
+		isc_buffer_init(&buf, decoded, sizeof(decoded));
+		isc_result_t result = decode(text, &buf);
+		assert(result == ISC_R_SUCCESS);
+	}
+	decode_ns = isc_time_monotonic() - start;
+
+	assert(isc_buffer_usedlength(&buf) == len);
+	assert(memcmp(bytes, decoded, len) == 0);
+
+	printf("%-10s %4zu bytes: encode %7.1f ns, decode %7.1f ns\n", name,
+	       len, (double)encode_ns / ROUNDS, (double)decode_ns / ROUNDS);
+}
+
+int
+main(void) {
+	static const size_t sizes[] = { 20, 32, 64, 256, 512 };
+
+	for (size_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+		bench("base64", isc_base64_totext, isc_base64_decodestring,
+		      sizes[i]);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+		bench("base32hex", isc_base32hexnp_totext,
+		      isc_base32hexnp_decodestring, sizes[i]);
+	}
+	for (size_t i = 0; i < ARRAY_SIZE(sizes); i++) {
+		bench("hex", isc_hex_totext, isc_hex_decodestring, sizes[i]);
+	}
+
+	return (0);
+}
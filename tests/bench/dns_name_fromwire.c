@@ -13,6 +13,7 @@
 
 #include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 #include <isc/ascii.h>
@@ -142,4 +143,28 @@ main(void) {
 	}
 	printf("4 long sequential labels\n");
 	oldnew_bench(buf, p);
+
+	/*
+	 * Like the owner names and NS targets in a response: a question
+	 * name, then names that are a pointer to it or a label and a
+	 * pointer to its parent.
+	 */
+	static const char qname[] = "\003www\007example\003com";
+	memmove(buf, qname, sizeof(qname));
+	p = sizeof(qname);
+	for (unsigned int name = 0; name < 100 * NAMES; name++) {
+		if (name % 2 == 0) {
+			buf[p++] = 0xC0;
+			buf[p++] = 0;
+		} else {
+			buf[p++] = 3;
+			buf[p++] = 'n';
+			buf[p++] = 's';
+			buf[p++] = '0' + name % 10;
+			buf[p++] = 0xC0;
+			buf[p++] = 4;
+		}
+	}
+	printf("compressed response names\n");
+	oldnew_bench(buf, p);
 }
@@ -17,7 +17,6 @@
 #include <isc/barrier.h>
 #include <isc/file.h>
 #include <isc/hashmap.h>
-#include <isc/ht.h>
 #include <isc/list.h>
 #include <isc/rwlock.h>
 #include <isc/thread.h>
@@ -241,63 +240,6 @@ thread_hashmap(void *arg0) {
 	return (NULL);
 }
 
-/*
- * ht
- */
-
-static void *
-new_ht(isc_mem_t *mem) {
-	isc_ht_t *ht = NULL;
-	isc_ht_init(&ht, mem, 1, 0);
-	return (ht);
-}
-
-static isc_result_t
-add_ht(void *ht, size_t count) {
-	isc_result_t result = isc_ht_add(ht, item[count].fixed.name.ndata,
-					 item[count].fixed.name.length,
-					 &item[count]);
-	return (result);
-}
-
-static isc_result_t
-get_ht(void *ht, size_t count, void **pval) {
-	isc_result_t result = isc_ht_find(ht, item[count].fixed.name.ndata,
-					  item[count].fixed.name.length, pval);
-	return (result);
-}
-
-static void *
-thread_ht(void *arg0) {
-	struct thread_s *arg = arg0;
-
-	isc_barrier_wait(&barrier);
-
-	isc_time_t t0 = isc_time_now_hires();
-	WRLOCK(&rwl);
-	for (size_t n = arg->start; n < arg->end; n++) {
-		isc_result_t result = add_ht(arg->map, n);
-		CHECK(n, result);
-	}
-	WRUNLOCK(&rwl);
-
-	isc_time_t t1 = isc_time_now_hires();
-	RDLOCK(&rwl);
-	for (size_t n = arg->start; n < arg->end; n++) {
-		void *pval = NULL;
-		isc_result_t result = get_ht(arg->map, n, &pval);
-		CHECK(n, result);
-		assert(pval == &item[n]);
-	}
-	RDUNLOCK(&rwl);
-	isc_time_t t2 = isc_time_now_hires();
-
-	arg->d0 = isc_time_microdiff(&t1, &t0);
-	arg->d1 = isc_time_microdiff(&t2, &t1);
-
-	return (NULL);
-}
-
 /*
  * rbt
  */
@@ -461,7 +403,6 @@ thread_qp_brr(void *arg0) {
  */
 static struct fun fun_list[] = {
 	{ "lfht", new_lfht, thread_lfht },
-	{ "ht", new_ht, thread_ht },
 	{ "hashmap", new_hashmap, thread_hashmap },
 	{ "rbt", new_rbt, thread_rbt },
 	{ "qp", new_qp, thread_qp },
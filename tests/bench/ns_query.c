@@ -0,0 +1,384 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Push canned wire-format queries through ns_query_start() and the
+ * response renderer, with an in-memory server, view and zone and no
+ * network, and report the time and the number of memory allocations
+ * per query.
+ *
+ * The client object is reused between queries in the same way the
+ * network manager reuses it for successive requests on a socket, so the
+ * numbers reflect the steady state of a running server.
+ */
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <isc/buffer.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/netmgr.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/masterdump.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rcode.h>
+#include <dns/rdataset.h>
+#include <dns/view.h>
+#include <dns/zone.h>
+
+#include <ns/client.h>
+#include <ns/query.h>
+#include <ns/server.h>
+
+#include <tests/dns.h>
+
+#if ISC_NETMGR_TRACE
+#define FLARG                                                                 \
+	, const char *func ISC_ATTR_UNUSED, const char *file ISC_ATTR_UNUSED, \
+		unsigned int line ISC_ATTR_UNUSED
+#else
+#define FLARG
+#endif
+
+#define ZONE_ORIGIN "example"
+#define ZONE_FILE   TESTS_DIR "/ns_query.db"
+
+#define DEFAULT_REPEAT 100000
+
+static struct {
+	const char *name;
+	dns_rdatatype_t type;
+	const char *what;
+	unsigned char wire[512];
+	size_t length;
+} queries[] = {
+	{ "www.example", dns_rdatatype_a, "answer" },
+	{ "www.example", dns_rdatatype_aaaa, "nodata" },
+	{ "nonexistent.example", dns_rdatatype_a, "nxdomain" },
+	{ "alias.example", dns_rdatatype_a, "cname" },
+	{ "example", dns_rdatatype_mx, "additional" },
+	{ "host.wild.example", dns_rdatatype_a, "wildcard" },
+	{ "host.sub.example", dns_rdatatype_a, "referral" },
+};
+
+static unsigned int repeat = DEFAULT_REPEAT;
+
+static ns_server_t *server = NULL;
+static ns_clientmgr_t *clientmgr = NULL;
+static dns_view_t *view = NULL;
+static dns_zone_t *zone = NULL;
+static ns_client_t *client = NULL;
+
+/*
+ * The client's handle is the client itself, as in the libns unit tests;
+ * the functions below stand in for the network manager's reference
+ * counting so that no socket is needed.
+ */
+static unsigned int handle_refs = 0;
+
+static size_t response_size = 0;
+static dns_rcode_t response_rcode = 0;
+static uint64_t responses = 0;
+
+static void
+CHECKRESULT(isc_result_t result, const char *msg) {
+	if (result != ISC_R_SUCCESS) {
+		fprintf(stderr, "%s: %s\n", msg, isc_result_totext(result));
+		exit(EXIT_FAILURE);
+	}
+}
+
+#if ISC_NETMGR_TRACE
+void
+isc_nmhandle__attach(isc_nmhandle_t *source, isc_nmhandle_t **targetp FLARG) {
+#else
+void
+isc_nmhandle_attach(isc_nmhandle_t *source, isc_nmhandle_t **targetp) {
+#endif
+	INSIST(source == (isc_nmhandle_t *)client);
+	INSIST(handle_refs > 0);
+
+	handle_refs++;
+	*targetp = source;
+}
+
+#if ISC_NETMGR_TRACE
+void
+isc_nmhandle__detach(isc_nmhandle_t **handlep FLARG) {
+#else
+void
+isc_nmhandle_detach(isc_nmhandle_t **handlep) {
+#endif
+	INSIST(*handlep == (isc_nmhandle_t *)client);
+	INSIST(handle_refs > 0);
+
+	*handlep = NULL;
+	if (--handle_refs == 0) {
+		ns__client_reset_cb(client);
+	}
+}
+
+static void
+bench_send(isc_buffer_t *buffer) {
+	unsigned char *wire = isc_buffer_base(buffer);
+
+	response_size = isc_buffer_usedlength(buffer);
+	response_rcode = wire[3] & 0x0f;
+	responses++;
+}
+
+static void
+render_query(unsigned int i) {
+	dns_message_t *message = NULL;
+	dns_rdataset_t *qrdataset = NULL;
+	dns_name_t *qname = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER,
+			   &message);
+	message->id = i;
+	message->opcode = dns_opcode_query;
+
+	dns_message_gettempname(message, &qname);
+	dns_message_gettemprdataset(message, &qrdataset);
+	result = dns_name_fromstring(qname, queries[i].name, dns_rootname, 0,
+				     NULL);
+	CHECKRESULT(result, queries[i].name);
+	dns_rdataset_makequestion(qrdataset, dns_rdataclass_in,
+				  queries[i].type);
+	ISC_LIST_APPEND(qname->list, qrdataset, link);
+	dns_message_addname(message, qname, DNS_SECTION_QUESTION);
+
+	dns_compress_init(&cctx, mctx, 0);
+	isc_buffer_init(&buffer, queries[i].wire, sizeof(queries[i].wire));
+	result = dns_message_renderbegin(message, &cctx, &buffer);
+	CHECKRESULT(result, "dns_message_renderbegin");
+	result = dns_message_rendersection(message, DNS_SECTION_QUESTION, 0);
+	CHECKRESULT(result, "dns_message_rendersection");
+	result = dns_message_renderend(message);
+	CHECKRESULT(result, "dns_message_renderend");
+	dns_compress_invalidate(&cctx);
+
+	queries[i].length = isc_buffer_usedlength(&buffer);
+
+	dns_message_detach(&message);
+}
+
+/*
+ * Do what ns_client_request() does for a UDP query from an
+ * authoritative-only view, then hand the query to ns_query_start().
+ * The response is rendered into the client's send buffer and passed to
+ * bench_send() instead of the network manager.
+ */
+static void
+run_query(unsigned int i) {
+	isc_buffer_t buffer;
+	isc_result_t result;
+
+	result = ns__client_setup(client, NULL, false);
+	CHECKRESULT(result, "ns__client_setup");
+
+	client->state = NS_CLIENTSTATE_READY;
+	client->handle = (isc_nmhandle_t *)client;
+	handle_refs = 1;
+
+	isc_sockaddr_fromin(&client->peeraddr,
+			    &(struct in_addr){ htonl(INADDR_LOOPBACK) }, 53000);
+	client->peeraddr_valid = true;
+	client->destsockaddr = client->peeraddr;
+	client->sendcb = bench_send;
+
+	client->state = NS_CLIENTSTATE_WORKING;
+	client->requesttime = isc_time_now();
+	client->tnow = client->requesttime;
+	client->now = isc_time_seconds(&client->tnow);
+
+	isc_buffer_init(&buffer, queries[i].wire, queries[i].length);
+	isc_buffer_add(&buffer, queries[i].length);
+	result = dns_message_parse(client->message, &buffer, 0);
+	CHECKRESULT(result, "dns_message_parse");
+
+	dns_view_attach(view, &client->view);
+
+	ns_query_start(client, client->handle);
+
+	/* This is the reference held by the network manager. */
+	isc_nmhandle_t *handle = client->handle;
+	isc_nmhandle_detach(&handle);
+}
+
+static size_t
+allocations(void) {
+	return (isc_mem_allocations(mctx) +
+		isc_mem_allocations(clientmgr->mctx) +
+		isc_mem_allocations(clientmgr->send_mctx));
+}
+
+static void
+setup(void) {
+	isc_result_t result;
+	dns_aclenv_t *aclenv = NULL;
+	dns_db_t *db = NULL;
+
+	ns_server_create(mctx, NULL, &server);
+
+	dns_aclenv_create(mctx, &aclenv);
+	result = ns_clientmgr_create(server, loopmgr, aclenv, isc_tid(),
+				     &clientmgr);
+	dns_aclenv_detach(&aclenv);
+	CHECKRESULT(result, "ns_clientmgr_create");
+
+	result = dns_test_makeview("view", false, false, &view);
+	CHECKRESULT(result, "dns_test_makeview");
+	view->nocookieudp = 512;
+
+	result = dns_test_makezone(ZONE_ORIGIN, &zone, view, false);
+	CHECKRESULT(result, "dns_test_makezone");
+	dns_test_setupzonemgr();
+	result = dns_test_managezone(zone);
+	CHECKRESULT(result, "dns_test_managezone");
+	dns_zone_setfile(zone, ZONE_FILE, dns_masterformat_text,
+			 &dns_master_style_default);
+	result = dns_zone_load(zone, false);
+	CHECKRESULT(result, ZONE_FILE);
+	result = dns_zone_getdb(zone, &db);
+	CHECKRESULT(result, "dns_zone_getdb");
+	dns_db_detach(&db);
+
+	client = isc_mem_get(clientmgr->mctx, sizeof(*client));
+	result = ns__client_setup(client, clientmgr, true);
+	CHECKRESULT(result, "ns__client_setup");
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(queries); i++) {
+		render_query(i);
+	}
+}
+
+static void
+teardown(void) {
+	ns__client_put_cb(client);
+	client = NULL;
+
+	dns_test_releasezone(zone);
+	dns_test_closezonemgr();
+	dns_zone_detach(&zone);
+	dns_view_detach(&view);
+
+	ns_clientmgr_shutdown(clientmgr);
+	ns_clientmgr_detach(&clientmgr);
+	ns_server_detach(&server);
+}
+
+static void
+bench(void *arg ISC_ATTR_UNUSED) {
+	uint64_t total_ns = 0;
+	size_t total_allocs = 0;
+
+	setup();
+
+	printf("%-36s %8s %12s %6s %9s\n", "query", "ns/query",
+	       "allocs/query", "size", "rcode");
+
+	for (unsigned int i = 0; i < ARRAY_SIZE(queries); i++) {
+		char buf[DNS_NAME_FORMATSIZE + 64];
+		char rcode[16];
+		isc_buffer_t b;
+
+		/* Warm up the zone database and the client's pools. */
+		run_query(i);
+
+		responses = 0;
+		size_t allocs = allocations();
+		isc_nanosecs_t start = isc_time_monotonic();
+		for (unsigned int n = 0; n < repeat; n++) {
+			run_query(i);
+		}
+		isc_nanosecs_t stop = isc_time_monotonic();
+		allocs = allocations() - allocs;
+
+		if (responses != repeat) {
+			fprintf(stderr,
+				"%s: %" PRIu64 " responses to %u queries\n",
+				queries[i].name, responses, repeat);
+			exit(EXIT_FAILURE);
+		}
+
+		isc_buffer_init(&b, rcode, sizeof(rcode) - 1);
+		dns_rcode_totext(response_rcode, &b);
+		rcode[isc_buffer_usedlength(&b)] = '\0';
+
+		snprintf(buf, sizeof(buf), "%s/%u (%s)", queries[i].name,
+			 queries[i].type, queries[i].what);
+		printf("%-36s %8.1f %12.2f %6zu %9s\n", buf,
+		       (double)(stop - start) / repeat, (double)allocs / repeat,
+		       response_size, rcode);
+
+		total_ns += stop - start;
+		total_allocs += allocs;
+	}
+
+	printf("%-36s %8.1f %12.2f\n", "all",
+	       (double)total_ns / (repeat * ARRAY_SIZE(queries)),
+	       (double)total_allocs / (repeat * ARRAY_SIZE(queries)));
+
+	teardown();
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+usage(void) {
+	fprintf(stderr, "usage: ns_query [repeat]\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char *argv[]) {
+	if (argc > 2) {
+		usage();
+	} else if (argc == 2) {
+		char *end = NULL;
+		repeat = strtoul(argv[1], &end, 10);
+		if (*end != '\0' || repeat == 0) {
+			usage();
+		}
+	}
+
+	isc_mem_create(&mctx);
+	isc_loopmgr_create(mctx, 1, &loopmgr);
+	mainloop = isc_loop_main(loopmgr);
+	isc_netmgr_create(mctx, loopmgr, &netmgr);
+
+	isc_loop_setup(mainloop, bench, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	isc_netmgr_destroy(&netmgr);
+	isc_loopmgr_destroy(&loopmgr);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
@@ -16,7 +16,6 @@
 
 #include <isc/commandline.h>
 #include <isc/file.h>
-#include <isc/ht.h>
 #include <isc/rwlock.h>
 #include <isc/util.h>
 
@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Replay a resolver-like workload against a "qpcache" database from
+ * several threads at once: each thread looks up names drawn from a
+ * skewed popularity distribution and, on a miss, adds an A rdataset as
+ * a resolver would after a fetch. Names have a mix of TTLs, the cache
+ * clock runs faster than real time so that entries expire, and the
+ * memory context has a small high water mark so that overmem cleaning
+ * runs alongside the lookups.
+ *
+ * For each thread count the benchmark reports the throughput, the
+ * hit rate, the median and 99th percentile lookup latency, and the
+ * throughput per thread relative to a single thread, which falls as
+ * threads contend for the tree and node locks.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/barrier.h>
+#include <isc/histo.h>
+#include <isc/mem.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/stdtime.h>
+#include <isc/thread.h>
+#include <isc/time.h>
+#include <isc/urcu.h>
+#include <isc/util.h>
+
+#include <dns/db.h>
+#include <dns/fixedname.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+#define RUNTIME	  (2 * NS_PER_SEC)
+#define TIMESCALE 60 /* cache seconds per second of real time */
+
+static const char *tlds[] = { "com", "net", "org", "de", "uk", "io" };
+
+/* The TTLs of cached names, and how often they occur, in percent */
+static const struct {
+	dns_ttl_t ttl;
+	unsigned int percent;
+} ttls[] = { { 30, 20 }, { 60, 20 }, { 300, 30 }, { 3600, 20 }, { 86400, 10 } };
+
+struct item {
+	dns_fixedname_t fixed;
+	dns_ttl_t ttl;
+};
+
+static struct item *items = NULL;
+static size_t nitems = 100000;
+
+static dns_db_t *db = NULL;
+static isc_barrier_t barrier;
+static isc_stdtime_t basetime;
+
+struct thread_s {
+	isc_thread_t thread;
+	isc_mem_t *mctx;
+	isc_histo_t *latency;
+	uint64_t lookups;
+	uint64_t hits;
+	uint64_t adds;
+};
+
+static void
+random_name(dns_name_t *name) {
+	char text[DNS_NAME_FORMATSIZE];
+	unsigned int labels = 1 + isc_random_uniform(3);
+	size_t len = 0;
+
+	for (unsigned int l = 0; l < labels; l++) {
+		unsigned int n = 3 + isc_random_uniform(10);
+		for (unsigned int i = 0; i < n; i++) {
+			text[len++] = 'a' + isc_random_uniform(26);
+		}
+		text[len++] = '.';
+	}
+	snprintf(text + len, sizeof(text) - len, "%s.",
+		 tlds[isc_random_uniform(ARRAY_SIZE(tlds))]);
+
+	isc_result_t result = dns_name_fromstring(name, text, dns_rootname, 0,
+						  NULL);
+	assert(result == ISC_R_SUCCESS);
+}
+
+static dns_ttl_t
+random_ttl(void) {
+	unsigned int r = isc_random_uniform(100);
+
+	for (size_t i = 0; i < ARRAY_SIZE(ttls); i++) {
+		if (r < ttls[i].percent) {
+			return (ttls[i].ttl);
+		}
+		r -= ttls[i].percent;
+	}
+	UNREACHABLE();
+}
+
+/*
+ * Pick a name with a heavily skewed popularity, so that a small set of
+ * names gets most of the lookups.
+ */
+static struct item *
+random_item(void) {
+	double u = (double)isc_random32() / UINT32_MAX;
+
+	return (&items[(size_t)(u * u * u * (nitems - 1))]);
+}
+
+static void
+add_item(struct item *item, size_t idx, isc_stdtime_t now) {
+	dns_name_t *name = dns_fixedname_name(&item->fixed);
+	dns_dbnode_t *node = NULL;
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset;
+	unsigned char addr[4];
+	isc_result_t result;
+
+	memmove(addr, &(uint32_t){ (uint32_t)idx }, sizeof(addr));
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a,
+			     &(isc_region_t){ addr, sizeof(addr) });
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_a;
+	rdatalist.ttl = item->ttl;
+	ISC_LIST_APPEND(rdatalist.rdata, &rdata, link);
+
+	dns_rdataset_init(&rdataset);
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+	rdataset.trust = dns_trust_answer;
+
+	result = dns_db_findnode(db, name, true, &node);
+	assert(result == ISC_R_SUCCESS);
+	result = dns_db_addrdataset(db, node, NULL, now, &rdataset, 0, NULL);
+	assert(result == ISC_R_SUCCESS || result == DNS_R_UNCHANGED);
+	dns_db_detachnode(db, &node);
+}
+
+static void *
+worker(void *arg) {
+	struct thread_s *t = arg;
+	dns_fixedname_t ffound;
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+	isc_nanosecs_t begin, start, stop;
+
+	isc_histo_create(t->mctx, 3, &t->latency);
+
+	isc_barrier_wait(&barrier);
+
+	begin = stop = isc_time_monotonic();
+	while (stop - begin < RUNTIME) {
+		struct item *item = random_item();
+		isc_stdtime_t now = basetime +
+				    (isc_stdtime_t)((stop - begin) * TIMESCALE /
+						    NS_PER_SEC);
+		dns_dbnode_t *node = NULL;
+		dns_rdataset_t rdataset;
+		isc_result_t result;
+
+		dns_rdataset_init(&rdataset);
+
+		start = isc_time_monotonic();
+		result = dns_db_find(db, dns_fixedname_name(&item->fixed), NULL,
+				     dns_rdatatype_a, 0, now, &node, found,
+				     &rdataset, NULL);
+		if (dns_rdataset_isassociated(&rdataset)) {
+			dns_rdataset_disassociate(&rdataset);
+		}
+		if (node != NULL) {
+			dns_db_detachnode(db, &node);
+		}
+		stop = isc_time_monotonic();
+
+		isc_histo_inc(t->latency, stop - start);
+		t->lookups++;
+
+		if (result == ISC_R_SUCCESS) {
+			t->hits++;
+		} else {
+			add_item(item, item - items, now);
+			t->adds++;
+			stop = isc_time_monotonic();
+		}
+	}
+
+	return (NULL);
+}
+
+static double
+run(isc_mem_t *mctx, size_t maxcache, size_t nthreads) {
+	struct thread_s *threads = NULL;
+	isc_mem_t *dbmctx = NULL;
+	isc_histo_t *latency = NULL;
+	uint64_t lookups = 0, hits = 0, adds = 0;
+	uint64_t quantiles[2];
+	double qps;
+
+	isc_mem_create(&dbmctx);
+	isc_result_t result = dns_db_create(dbmctx, "qpcache", dns_rootname,
+					    dns_dbtype_cache,
+					    dns_rdataclass_in, 0, NULL, &db);
+	assert(result == ISC_R_SUCCESS);
+	isc_mem_setwater(dbmctx, maxcache - (maxcache >> 3),
+			 maxcache - (maxcache >> 2));
+	basetime = isc_stdtime_now();
+
+	threads = isc_mem_cget(mctx, nthreads, sizeof(threads[0]));
+	isc_barrier_init(&barrier, nthreads);
+	for (size_t i = 0; i < nthreads; i++) {
+		threads[i] = (struct thread_s){ .mctx = mctx };
+		isc_thread_create(worker, &threads[i], &threads[i].thread);
+	}
+
+	isc_histo_create(mctx, 3, &latency);
+	for (size_t i = 0; i < nthreads; i++) {
+		isc_thread_join(threads[i].thread, NULL);
+		isc_histo_merge(&latency, threads[i].latency);
+		isc_histo_destroy(&threads[i].latency);
+		lookups += threads[i].lookups;
+		hits += threads[i].hits;
+		adds += threads[i].adds;
+	}
+
+	result = isc_histo_quantiles(latency, 2, (double[]){ 0.99, 0.5 },
+				     quantiles);
+	assert(result == ISC_R_SUCCESS);
+
+	qps = (double)lookups * NS_PER_SEC / RUNTIME;
+	printf("%7zu | %10.0f | %6.1f%% | %10" PRIu64 " | %8" PRIu64
+	       " | %8" PRIu64 " | %7zu | ",
+	       nthreads, qps, 100.0 * hits / lookups, adds, quantiles[1],
+	       quantiles[0], isc_mem_inuse(dbmctx) / 1024);
+
+	isc_histo_destroy(&latency);
+	isc_barrier_destroy(&barrier);
+	isc_mem_cput(mctx, threads, nthreads, sizeof(threads[0]));
+
+	dns_db_detach(&db);
+	rcu_barrier();
+	isc_mem_destroy(&dbmctx);
+
+	return (qps / nthreads);
+}
+
+int
+main(int argc, char **argv) {
+	isc_mem_t *mctx = NULL;
+	size_t maxthreads = isc_os_ncpus();
+	size_t maxcache = 64 * 1024 * 1024;
+	double base = 0.0;
+
+	if (argc > 1) {
+		maxthreads = strtoul(argv[1], NULL, 0);
+	}
+	if (argc > 2) {
+		nitems = strtoul(argv[2], NULL, 0);
+	}
+	if (argc > 3) {
+		maxcache = strtoul(argv[3], NULL, 0) * 1024 * 1024;
+	}
+	if (maxthreads == 0 || nitems == 0 || maxcache == 0) {
+		fprintf(stderr, "usage: %s [threads [names [cache-MiB]]]\n",
+			argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	isc_mem_create(&mctx);
+
+	items = isc_mem_cget(mctx, nitems, sizeof(items[0]));
+	for (size_t i = 0; i < nitems; i++) {
+		random_name(dns_fixedname_initname(&items[i].fixed));
+		items[i].ttl = random_ttl();
+	}
+
+	printf("%zu names, %zu MiB cache, %u s per run, %ux cache clock\n\n",
+	       nitems, maxcache / (1024 * 1024),
+	       (unsigned int)(RUNTIME / NS_PER_SEC), TIMESCALE);
+	printf("%7s | %10s | %7s | %10s | %8s | %8s | %7s | %s\n", "threads",
+	       "lookups/s", "hits", "adds", "p50 ns", "p99 ns", "KiB",
+	       "per thread");
+
+	for (size_t nthreads = 1; nthreads <= maxthreads; nthreads *= 2) {
+		double perthread = run(mctx, maxcache, nthreads);
+		if (nthreads == 1) {
+			base = perthread;
+		}
+		printf("%5.1f%%\n", 100.0 * perthread / base);
+	}
+
+	isc_mem_cput(mctx, items, nitems, sizeof(items[0]));
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
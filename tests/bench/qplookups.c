@@ -16,7 +16,7 @@
 
 #include <isc/commandline.h>
 #include <isc/file.h>
-#include <isc/ht.h>
+#include <isc/random.h>
 #include <isc/rwlock.h>
 #include <isc/time.h>
 #include <isc/util.h>
@@ -202,6 +202,8 @@ main(int argc, char **argv) {
 	dns_fixedname_t *items = NULL;
 	dns_qpiter_t it = { 0 };
 	dns_name_t *name = NULL;
+	const dns_name_t **names = NULL;
+	isc_result_t *results = NULL;
 	size_t i = 0, n = 0;
 	char buf[BUFSIZ];
 
@@ -221,7 +223,7 @@ main(int argc, char **argv) {
 	snprintf(buf, sizeof(buf), "load %zd names:", n);
 	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
 
-	items = isc_mem_cget(mctx, n, sizeof(dns_fixedname_t));
+	items = isc_mem_cget(mctx, n + 1, sizeof(dns_fixedname_t));
 	dns_qpiter_init(qp, &it);
 
 	start = isc_time_monotonic();
@@ -247,6 +249,59 @@ main(int argc, char **argv) {
 	snprintf(buf, sizeof(buf), "look up %zd names (dns_qp_getname):", n);
 	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
 
+	/*
+	 * The names are in trie order, so consecutive searches share most
+	 * of their path. Shuffle them to compare one search at a time
+	 * with interleaved batches when the searches miss the cache.
+	 */
+	names = isc_mem_cget(mctx, n, sizeof(names[0]));
+	results = isc_mem_cget(mctx, n, sizeof(results[0]));
+	for (i = 0; i < n; i++) {
+		names[i] = dns_fixedname_name(&items[i]);
+	}
+
+	start = isc_time_monotonic();
+	dns_qp_getnames(qp, n, names, NULL, NULL, results);
+	stop = isc_time_monotonic();
+
+	snprintf(buf, sizeof(buf), "look up %zd names (dns_qp_getnames):", n);
+	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
+
+	for (i = n; i > 1; i--) {
+		size_t j = isc_random_uniform(i);
+		const dns_name_t *tmp = names[i - 1];
+		names[i - 1] = names[j];
+		names[j] = tmp;
+	}
+
+	start = isc_time_monotonic();
+	for (i = 0; i < n; i++) {
+		dns_qp_getname(qp, names[i], NULL, NULL);
+	}
+	stop = isc_time_monotonic();
+
+	snprintf(buf, sizeof(buf),
+		 "look up %zd shuffled names (dns_qp_getname):", n);
+	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
+
+	for (size_t batch = 4; batch <= 32; batch *= 2) {
+		start = isc_time_monotonic();
+		for (i = 0; i < n; i += batch) {
+			dns_qp_getnames(qp, ISC_MIN(batch, n - i), names + i,
+					NULL, NULL, results + i);
+		}
+		stop = isc_time_monotonic();
+
+		snprintf(buf, sizeof(buf),
+			 "look up %zd shuffled names (dns_qp_getnames/%zu):", n,
+			 batch);
+		printf("%-57s%7.3fsec\n", buf,
+		       (stop - start) / (double)NS_PER_SEC);
+	}
+
+	isc_mem_cput(mctx, results, n, sizeof(results[0]));
+	isc_mem_cput(mctx, names, n, sizeof(names[0]));
+
 	start = isc_time_monotonic();
 	for (i = 0; i < n; i++) {
 		name = dns_fixedname_name(&items[i]);
@@ -283,6 +338,6 @@ main(int argc, char **argv) {
 		 "look up %zd wrong names (dns_qp_lookup):", n);
 	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
 
-	isc_mem_cput(mctx, items, n, sizeof(dns_fixedname_t));
+	isc_mem_cput(mctx, items, n + 1, sizeof(dns_fixedname_t));
 	return (0);
 }
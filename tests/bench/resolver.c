@@ -0,0 +1,763 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+/*
+ * Drive the resolver at a fixed rate against a small hierarchy of
+ * authoritative servers that run in the same process, on loopback
+ * addresses and a private port:
+ *
+ *	127.0.0.1	the root zone, delegating "test." to 127.0.0.2
+ *	127.0.0.2	"test.", delegating each "zN.test." to 127.0.0.3
+ *	127.0.0.3	every "zN.test.", with an A record for any name
+ *
+ * Each reply is delayed, and some are dropped, according to a network
+ * profile, so that the resolver's retry, server selection and query
+ * coalescing logic run much as they would against the Internet. The
+ * names looked up are drawn from a skewed popularity distribution over
+ * a number of zones and hosts, so that some are answered from the cache.
+ *
+ * The benchmark reports the fetch latency, the fetch results, and the
+ * number of queries received by each server per fetch.
+ *
+ * The servers listen on 127.0.0.1 to 127.0.0.3, which requires that
+ * the whole of 127.0.0.0/8 is configured on the loopback interface.
+ */
+
+#include <assert.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include <isc/async.h>
+#include <isc/atomic.h>
+#include <isc/buffer.h>
+#include <isc/histo.h>
+#include <isc/loop.h>
+#include <isc/mem.h>
+#include <isc/netaddr.h>
+#include <isc/netmgr.h>
+#include <isc/os.h>
+#include <isc/random.h>
+#include <isc/result.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+#include <isc/timer.h>
+#include <isc/tls.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/db.h>
+#include <dns/dispatch.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+#include <dns/resolver.h>
+#include <dns/result.h>
+#include <dns/rootns.h>
+#include <dns/view.h>
+
+#include <tests/dns.h>
+
+#define PORT	53535
+#define LEVELS	3
+#define TICK_MS 1
+
+#define DELEGATION_TTL 86400
+#define ANSWER_TTL     300
+#define NEGATIVE_TTL   60
+
+/*
+ * The network between the resolver and each authoritative server:
+ * a base delay, a random jitter added to it, and a loss rate.
+ */
+static const struct profile {
+	const char *name;
+	unsigned int delay_ms;
+	unsigned int jitter_ms;
+	unsigned int loss_permille;
+} profiles[] = {
+	{ "local", 0, 0, 0 },
+	{ "lan", 1, 1, 0 },
+	{ "wan", 30, 20, 5 },
+	{ "lossy", 80, 60, 50 },
+};
+
+static const struct profile *profile = &profiles[2];
+
+/* One authoritative server per level of the hierarchy */
+static struct server {
+	isc_nmsocket_t *sock;
+	isc_sockaddr_t addr;
+	atomic_uint_fast64_t queries;
+	atomic_uint_fast64_t dropped;
+} servers[LEVELS];
+
+/* A delayed reply */
+struct reply {
+	isc_nmhandle_t *handle;
+	isc_timer_t *timer;
+	isc_buffer_t *buffer;
+};
+
+/* An outstanding fetch */
+struct fetch {
+	dns_fetch_t *fetch;
+	dns_fixedname_t fixed;
+	dns_rdataset_t rdataset;
+	dns_rdataset_t sigrdataset;
+	isc_nanosecs_t start;
+};
+
+/* The fetches started by one loop */
+struct driver {
+	isc_timer_t *timer;
+	uint64_t started;
+	uint64_t target;
+};
+
+static unsigned int rate = 1000;
+static unsigned int seconds = 10;
+static unsigned int nzones = 1000;
+static unsigned int nhosts = 100;
+
+static dns_view_t *view = NULL;
+static dns_resolver_t *resolver = NULL;
+static struct driver *drivers = NULL;
+static uint32_t ndrivers = 0;
+static isc_histo_t *latency = NULL;
+static char hintsfile[] = "/tmp/bench-resolver-hints.XXXXXX";
+
+static isc_nanosecs_t begin;
+static uint64_t target = 0;
+static atomic_uint_fast64_t finished = 0;
+static atomic_uint_fast32_t replies = 0;
+
+static atomic_uint_fast64_t results[4];
+static const char *result_names[] = { "answer", "nxdomain/nodata",
+				      "servfail", "other" };
+
+static dns_fixedname_t ftest;
+
+static void
+shutdown_check(void);
+
+/*
+ * Servers.
+ */
+
+static void
+putname(isc_buffer_t *buffer, const dns_name_t *name) {
+	isc_region_t r;
+
+	dns_name_toregion(name, &r);
+	isc_buffer_putmem(buffer, r.base, r.length);
+}
+
+static void
+add_record(dns_message_t *msg, dns_section_t section, const dns_name_t *owner,
+	   dns_rdatatype_t type, dns_ttl_t ttl, isc_buffer_t *buffer,
+	   unsigned int offset) {
+	dns_name_t *name = NULL;
+	dns_rdata_t *rdata = NULL;
+	dns_rdatalist_t *rdatalist = NULL;
+	dns_rdataset_t *rdataset = NULL;
+	isc_region_t r;
+
+	isc_buffer_usedregion(buffer, &r);
+	isc_region_consume(&r, offset);
+
+	dns_message_gettemprdata(msg, &rdata);
+	dns_rdata_fromregion(rdata, dns_rdataclass_in, type, &r);
+
+	dns_message_gettemprdatalist(msg, &rdatalist);
+	rdatalist->rdclass = dns_rdataclass_in;
+	rdatalist->type = type;
+	rdatalist->ttl = ttl;
+	ISC_LIST_APPEND(rdatalist->rdata, rdata, link);
+
+	dns_message_gettemprdataset(msg, &rdataset);
+	dns_rdatalist_tordataset(rdatalist, rdataset);
+
+	dns_message_gettempname(msg, &name);
+	dns_name_copy(owner, name);
+	ISC_LIST_APPEND(name->list, rdataset, link);
+	dns_message_addname(msg, name, section);
+}
+
+static void
+add_a(dns_message_t *msg, dns_section_t section, const dns_name_t *owner,
+      unsigned int level, dns_ttl_t ttl, isc_buffer_t *buffer) {
+	unsigned int offset = isc_buffer_usedlength(buffer);
+
+	isc_buffer_putmem(buffer, (const unsigned char *)"\177\0\0", 3);
+	isc_buffer_putuint8(buffer, level + 1);
+	add_record(msg, section, owner, dns_rdatatype_a, ttl, buffer, offset);
+}
+
+static void
+add_ns(dns_message_t *msg, dns_section_t section, const dns_name_t *owner,
+       const dns_name_t *ns, isc_buffer_t *buffer) {
+	unsigned int offset = isc_buffer_usedlength(buffer);
+
+	putname(buffer, ns);
+	add_record(msg, section, owner, dns_rdatatype_ns, DELEGATION_TTL,
+		   buffer, offset);
+}
+
+static void
+add_soa(dns_message_t *msg, const dns_name_t *apex, const dns_name_t *ns,
+	isc_buffer_t *buffer) {
+	unsigned int offset = isc_buffer_usedlength(buffer);
+
+	putname(buffer, ns);
+	putname(buffer, ns);
+	isc_buffer_putuint32(buffer, 1);
+	isc_buffer_putuint32(buffer, 3600);
+	isc_buffer_putuint32(buffer, 600);
+	isc_buffer_putuint32(buffer, 86400);
+	isc_buffer_putuint32(buffer, NEGATIVE_TTL);
+	add_record(msg, DNS_SECTION_AUTHORITY, apex, dns_rdatatype_soa,
+		   NEGATIVE_TTL, buffer, offset);
+}
+
+static bool
+is_ns(const dns_name_t *name) {
+	dns_label_t label;
+
+	dns_name_getlabel(name, 0, &label);
+	return (label.length == 3 && strncasecmp((char *)label.base + 1, "ns",
+						 2) == 0);
+}
+
+/*
+ * The server at 'level' is authoritative for the zone whose apex is the
+ * last 'level + 1' labels of the query name, and its name server is
+ * "ns." under that apex. The first two levels delegate everything
+ * below their apex apart from the name server itself.
+ */
+static void
+answer(dns_message_t *msg, unsigned int level, const dns_name_t *qname,
+       dns_rdatatype_t qtype, isc_buffer_t *buffer) {
+	unsigned int nlabels = dns_name_countlabels(qname);
+	dns_fixedname_t fapex, fchild, fns;
+	dns_name_t *apex = dns_fixedname_initname(&fapex);
+	dns_name_t *child = dns_fixedname_initname(&fchild);
+	dns_name_t *ns = dns_fixedname_initname(&fns);
+	dns_name_t *test = dns_fixedname_name(&ftest);
+	dns_name_t nslabel;
+	isc_result_t result;
+
+	dns_name_init(&nslabel, NULL);
+	dns_name_fromregion(&nslabel,
+			    &(isc_region_t){ (unsigned char *)"\002ns", 3 });
+
+	if (nlabels < level + 1) {
+		msg->rcode = dns_rcode_refused;
+		return;
+	}
+	dns_name_getlabelsequence(qname, nlabels - (level + 1), level + 1,
+				  apex);
+	if (level == 1 && !dns_name_equal(apex, test)) {
+		msg->rcode = dns_rcode_refused;
+		return;
+	}
+
+	if (level + 1 < LEVELS && nlabels > level + 1 &&
+	    (level != 0 || dns_name_issubdomain(qname, test)))
+	{
+		dns_name_getlabelsequence(qname, nlabels - (level + 2),
+					  level + 2, child);
+		if (nlabels > level + 2 || !is_ns(child)) {
+			/* Referral */
+			result = dns_name_concatenate(&nslabel, child, ns,
+						      NULL);
+			INSIST(result == ISC_R_SUCCESS);
+			add_ns(msg, DNS_SECTION_AUTHORITY, child, ns, buffer);
+			add_a(msg, DNS_SECTION_ADDITIONAL, ns, level + 1,
+			      DELEGATION_TTL, buffer);
+			return;
+		}
+	}
+
+	msg->flags |= DNS_MESSAGEFLAG_AA;
+	result = dns_name_concatenate(&nslabel, apex, ns, NULL);
+	INSIST(result == ISC_R_SUCCESS);
+
+	if (qtype == dns_rdatatype_ns && dns_name_equal(qname, apex)) {
+		add_ns(msg, DNS_SECTION_ANSWER, apex, ns, buffer);
+		add_a(msg, DNS_SECTION_ADDITIONAL, ns, level, DELEGATION_TTL,
+		      buffer);
+	} else if (qtype == dns_rdatatype_a &&
+		   (level == LEVELS - 1 || dns_name_equal(qname, ns)))
+	{
+		add_a(msg, DNS_SECTION_ANSWER, qname, level, ANSWER_TTL,
+		      buffer);
+	} else {
+		add_soa(msg, apex, ns, buffer);
+	}
+}
+
+static void
+reply_sent(isc_nmhandle_t *handle ISC_ATTR_UNUSED,
+	   isc_result_t eresult ISC_ATTR_UNUSED, void *arg) {
+	struct reply *reply = arg;
+
+	isc_nmhandle_detach(&reply->handle);
+	isc_buffer_free(&reply->buffer);
+	isc_mem_put(mctx, reply, sizeof(*reply));
+
+	atomic_fetch_sub_release(&replies, 1);
+	shutdown_check();
+}
+
+static void
+reply_send(void *arg) {
+	struct reply *reply = arg;
+	isc_region_t r;
+
+	if (reply->timer != NULL) {
+		isc_timer_destroy(&reply->timer);
+	}
+	isc_buffer_usedregion(reply->buffer, &r);
+	isc_nm_send(reply->handle, &r, reply_sent, reply);
+}
+
+static void
+server_recv(isc_nmhandle_t *handle, isc_result_t eresult,
+	    isc_region_t *region, void *arg) {
+	struct server *server = arg;
+	unsigned int level = server - servers;
+	unsigned char rdatabuf[1024];
+	dns_message_t *msg = NULL;
+	dns_name_t *qname = NULL;
+	dns_rdataset_t *qrds = NULL;
+	dns_compress_t cctx;
+	isc_buffer_t source, rdatas;
+	struct reply *reply = NULL;
+	unsigned int delay;
+	isc_result_t result;
+
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	atomic_fetch_add_relaxed(&server->queries, 1);
+	if (isc_random_uniform(1000) < profile->loss_permille) {
+		atomic_fetch_add_relaxed(&server->dropped, 1);
+		return;
+	}
+
+	isc_buffer_init(&source, region->base, region->length);
+	isc_buffer_add(&source, region->length);
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &msg);
+	result = dns_message_parse(msg, &source, 0);
+	if (result != ISC_R_SUCCESS ||
+	    dns_message_firstname(msg, DNS_SECTION_QUESTION) != ISC_R_SUCCESS)
+	{
+		dns_message_detach(&msg);
+		return;
+	}
+	dns_message_currentname(msg, DNS_SECTION_QUESTION, &qname);
+	qrds = ISC_LIST_HEAD(qname->list);
+
+	result = dns_message_reply(msg, true);
+	assert(result == ISC_R_SUCCESS);
+
+	isc_buffer_init(&rdatas, rdatabuf, sizeof(rdatabuf));
+	answer(msg, level, qname, qrds->type, &rdatas);
+
+	reply = isc_mem_get(mctx, sizeof(*reply));
+	*reply = (struct reply){ 0 };
+	isc_buffer_allocate(mctx, &reply->buffer, 512);
+
+	dns_compress_init(&cctx, mctx, 0);
+	result = dns_message_renderbegin(msg, &cctx, reply->buffer);
+	assert(result == ISC_R_SUCCESS);
+	for (dns_section_t section = DNS_SECTION_QUESTION;
+	     section < DNS_SECTION_MAX; section++)
+	{
+		result = dns_message_rendersection(msg, section, 0);
+		assert(result == ISC_R_SUCCESS);
+	}
+	result = dns_message_renderend(msg);
+	assert(result == ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+
+	isc_nmhandle_attach(handle, &reply->handle);
+	atomic_fetch_add_release(&replies, 1);
+
+	delay = profile->delay_ms;
+	if (profile->jitter_ms > 0) {
+		delay += isc_random_uniform(profile->jitter_ms + 1);
+	}
+	if (delay == 0) {
+		reply_send(reply);
+	} else {
+		isc_interval_t interval;
+
+		isc_interval_set(&interval, delay / 1000,
+				 (delay % 1000) * NS_PER_MS);
+		isc_timer_create(isc_loop_current(loopmgr), reply_send, reply,
+				 &reply->timer);
+		isc_timer_start(reply->timer, isc_timertype_once, &interval);
+	}
+}
+
+/*
+ * Resolver.
+ */
+
+static void
+fetch_done(void *arg) {
+	dns_fetchresponse_t *resp = arg;
+	struct fetch *f = resp->arg;
+	isc_nanosecs_t stop = isc_time_monotonic();
+
+	switch (resp->result) {
+	case ISC_R_SUCCESS:
+		atomic_fetch_add_relaxed(&results[0], 1);
+		break;
+	case DNS_R_NCACHENXDOMAIN:
+	case DNS_R_NCACHENXRRSET:
+	case DNS_R_NXDOMAIN:
+	case DNS_R_NXRRSET:
+		atomic_fetch_add_relaxed(&results[1], 1);
+		break;
+	case DNS_R_SERVFAIL:
+	case ISC_R_TIMEDOUT:
+		atomic_fetch_add_relaxed(&results[2], 1);
+		break;
+	default:
+		atomic_fetch_add_relaxed(&results[3], 1);
+		break;
+	}
+	isc_histo_inc(latency, stop - f->start);
+
+	if (dns_rdataset_isassociated(&f->rdataset)) {
+		dns_rdataset_disassociate(&f->rdataset);
+	}
+	if (dns_rdataset_isassociated(&f->sigrdataset)) {
+		dns_rdataset_disassociate(&f->sigrdataset);
+	}
+	if (resp->node != NULL) {
+		dns_db_detachnode(resp->db, &resp->node);
+	}
+	if (resp->db != NULL) {
+		dns_db_detach(&resp->db);
+	}
+	dns_resolver_destroyfetch(&f->fetch);
+	isc_mem_putanddetach(&resp->mctx, resp, sizeof(*resp));
+	isc_mem_put(mctx, f, sizeof(*f));
+
+	atomic_fetch_add_release(&finished, 1);
+	shutdown_check();
+}
+
+/*
+ * Pick a name with a skewed popularity, so that some zones and hosts
+ * are looked up much more often than others.
+ */
+static void
+random_name(dns_name_t *name) {
+	char text[DNS_NAME_FORMATSIZE];
+	double u = (double)isc_random32() / UINT32_MAX;
+	double v = (double)isc_random32() / UINT32_MAX;
+
+	snprintf(text, sizeof(text), "h%u.z%u.test.",
+		 (unsigned int)(v * v * (nhosts - 1)),
+		 (unsigned int)(u * u * u * (nzones - 1)));
+	isc_result_t result = dns_name_fromstring(name, text, dns_rootname, 0,
+						  NULL);
+	assert(result == ISC_R_SUCCESS);
+}
+
+static void
+start_fetch(void) {
+	struct fetch *f = isc_mem_get(mctx, sizeof(*f));
+	dns_name_t *name = NULL;
+	isc_result_t result;
+
+	*f = (struct fetch){ .start = isc_time_monotonic() };
+	name = dns_fixedname_initname(&f->fixed);
+	dns_rdataset_init(&f->rdataset);
+	dns_rdataset_init(&f->sigrdataset);
+	random_name(name);
+
+	result = dns_resolver_createfetch(
+		resolver, name, dns_rdatatype_a, NULL, NULL, NULL, NULL, 0, 0,
+		0, NULL, isc_loop_current(loopmgr), fetch_done, f,
+		&f->rdataset, &f->sigrdataset, &f->fetch);
+	if (result != ISC_R_SUCCESS) {
+		atomic_fetch_add_relaxed(&results[3], 1);
+		isc_mem_put(mctx, f, sizeof(*f));
+		atomic_fetch_add_release(&finished, 1);
+	}
+}
+
+/*
+ * Fetches are bound to the thread that creates them, so each loop
+ * starts its share of them from its own timer.
+ */
+static void
+tick(void *arg) {
+	struct driver *d = arg;
+	isc_nanosecs_t elapsed = isc_time_monotonic() - begin;
+	uint64_t due = ISC_MIN(d->target, d->target * elapsed /
+						  (seconds * NS_PER_SEC));
+
+	while (d->started < due) {
+		start_fetch();
+		d->started++;
+	}
+
+	if (d->started == d->target) {
+		isc_timer_destroy(&d->timer);
+		shutdown_check();
+	}
+}
+
+static void
+start_driver(void *arg) {
+	struct driver *d = arg;
+	isc_interval_t interval;
+
+	isc_interval_set(&interval, 0, TICK_MS * NS_PER_MS);
+	isc_timer_create(isc_loop_current(loopmgr), tick, d, &d->timer);
+	isc_timer_start(d->timer, isc_timertype_ticker, &interval);
+}
+
+/*
+ * Setup and teardown.
+ */
+
+static void
+report(void) {
+	isc_nanosecs_t elapsed = isc_time_monotonic() - begin;
+	uint64_t quantiles[3];
+	isc_result_t result;
+
+	printf("%" PRIu64 " fetches in %.2f s (%.0f/s), profile \"%s\" "
+	       "(%u ms + %u ms jitter, %.1f%% loss)\n\n",
+	       target, (double)elapsed / NS_PER_SEC,
+	       (double)target * NS_PER_SEC / elapsed, profile->name,
+	       profile->delay_ms, profile->jitter_ms,
+	       profile->loss_permille / 10.0);
+
+	result = isc_histo_quantiles(latency, 3, (double[]){ 0.99, 0.9, 0.5 },
+				     quantiles);
+	assert(result == ISC_R_SUCCESS);
+	printf("fetch latency: p50 %.3f ms, p90 %.3f ms, p99 %.3f ms\n\n",
+	       (double)quantiles[2] / NS_PER_MS,
+	       (double)quantiles[1] / NS_PER_MS,
+	       (double)quantiles[0] / NS_PER_MS);
+
+	for (size_t i = 0; i < ARRAY_SIZE(results); i++) {
+		printf("%-16s %10" PRIu64 "\n", result_names[i],
+		       (uint64_t)atomic_load_relaxed(&results[i]));
+	}
+	printf("\n%-16s %10s %10s %12s\n", "server", "queries", "dropped",
+	       "per fetch");
+	for (size_t i = 0; i < LEVELS; i++) {
+		char addr[ISC_SOCKADDR_FORMATSIZE];
+		uint64_t queries = atomic_load_relaxed(&servers[i].queries);
+
+		isc_sockaddr_format(&servers[i].addr, addr, sizeof(addr));
+		printf("%-16s %10" PRIu64 " %10" PRIu64 " %12.3f\n", addr,
+		       queries,
+		       (uint64_t)atomic_load_relaxed(&servers[i].dropped),
+		       (double)queries / target);
+	}
+}
+
+static void
+teardown(void *arg ISC_ATTR_UNUSED) {
+	report();
+
+	for (size_t i = 0; i < LEVELS; i++) {
+		isc_nm_stoplistening(servers[i].sock);
+		isc_nmsocket_close(&servers[i].sock);
+	}
+
+	dns_resolver_detach(&resolver);
+	dns_view_detach(&view);
+	isc_histo_destroy(&latency);
+	isc_mem_cput(mctx, drivers, ndrivers, sizeof(drivers[0]));
+	unlink(hintsfile);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/*
+ * Stop when every fetch has been started and has finished, and no
+ * delayed reply is still waiting to be sent.
+ */
+static void
+shutdown_check(void) {
+	static atomic_bool done = false;
+
+	if (atomic_load_acquire(&finished) == target &&
+	    atomic_load_acquire(&replies) == 0 &&
+	    atomic_compare_exchange_strong(&done, &(bool){ false }, true))
+	{
+		isc_async_run(mainloop, teardown, NULL);
+	}
+}
+
+static void
+write_hints(void) {
+	int fd = mkstemp(hintsfile);
+	FILE *fp = NULL;
+
+	if (fd < 0 || (fp = fdopen(fd, "w")) == NULL) {
+		perror(hintsfile);
+		exit(EXIT_FAILURE);
+	}
+	fprintf(fp, ".\t%u\tIN\tNS\tns.\n", DELEGATION_TTL);
+	fprintf(fp, "ns.\t%u\tIN\tA\t127.0.0.1\n", DELEGATION_TTL);
+	fclose(fp);
+}
+
+static void
+setup(void *arg ISC_ATTR_UNUSED) {
+	dns_dispatchmgr_t *dispatchmgr = NULL;
+	dns_dispatch_t *dispatch = NULL;
+	isc_tlsctx_cache_t *tlsctx_cache = NULL;
+	isc_sockaddr_t local;
+	dns_db_t *hints = NULL;
+	isc_result_t result;
+
+	for (size_t i = 0; i < LEVELS; i++) {
+		struct in_addr in4 = { .s_addr = htonl(0x7f000001 + i) };
+
+		isc_sockaddr_fromin(&servers[i].addr, &in4, PORT);
+		result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ALL,
+					  &servers[i].addr, server_recv,
+					  &servers[i], &servers[i].sock);
+		if (result != ISC_R_SUCCESS) {
+			fprintf(stderr, "listen on 127.0.0.%zu#%u: %s\n", i + 1,
+				PORT, isc_result_totext(result));
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	result = dns_test_makeview("bench", true, true, &view);
+	assert(result == ISC_R_SUCCESS);
+
+	dispatchmgr = dns_view_getdispatchmgr(view);
+	isc_sockaddr_any(&local);
+	result = dns_dispatch_createudp(dispatchmgr, &local, &dispatch);
+	assert(result == ISC_R_SUCCESS);
+	dns_dispatchmgr_detach(&dispatchmgr);
+
+	isc_tlsctx_cache_create(mctx, &tlsctx_cache);
+	result = dns_view_createresolver(view, loopmgr, netmgr, 0,
+					 tlsctx_cache, dispatch, NULL);
+	assert(result == ISC_R_SUCCESS);
+	isc_tlsctx_cache_detach(&tlsctx_cache);
+	dns_dispatch_detach(&dispatch);
+
+	write_hints();
+	result = dns_rootns_create(mctx, dns_rdataclass_in, hintsfile, &hints);
+	assert(result == ISC_R_SUCCESS);
+	dns_view_sethints(view, hints);
+	dns_db_detach(&hints);
+
+	dns_view_setdstport(view, PORT);
+	dns_view_freeze(view);
+	dns_view_getresolver(view, &resolver);
+
+	isc_histo_create(mctx, 3, &latency);
+
+	target = (uint64_t)rate * seconds;
+	ndrivers = isc_loopmgr_nloops(loopmgr);
+	drivers = isc_mem_cget(mctx, ndrivers, sizeof(drivers[0]));
+	for (uint32_t i = 0; i < ndrivers; i++) {
+		drivers[i].target = target / ndrivers +
+				    (i < target % ndrivers ? 1 : 0);
+	}
+
+	begin = isc_time_monotonic();
+	for (uint32_t i = 0; i < ndrivers; i++) {
+		isc_async_run(isc_loop_get(loopmgr, i), start_driver,
+			      &drivers[i]);
+	}
+}
+
+static void
+usage(const char *progname) {
+	fprintf(stderr,
+		"usage: %s [rate [seconds [profile [zones [hosts]]]]]\n"
+		"profiles:",
+		progname);
+	for (size_t i = 0; i < ARRAY_SIZE(profiles); i++) {
+		fprintf(stderr, " %s", profiles[i].name);
+	}
+	fprintf(stderr, "\n");
+	exit(EXIT_FAILURE);
+}
+
+int
+main(int argc, char **argv) {
+	isc_result_t result;
+
+	if (argc > 1) {
+		rate = strtoul(argv[1], NULL, 0);
+	}
+	if (argc > 2) {
+		seconds = strtoul(argv[2], NULL, 0);
+	}
+	if (argc > 3) {
+		profile = NULL;
+		for (size_t i = 0; i < ARRAY_SIZE(profiles); i++) {
+			if (strcmp(argv[3], profiles[i].name) == 0) {
+				profile = &profiles[i];
+			}
+		}
+	}
+	if (argc > 4) {
+		nzones = strtoul(argv[4], NULL, 0);
+	}
+	if (argc > 5) {
+		nhosts = strtoul(argv[5], NULL, 0);
+	}
+	if (argc > 6 || rate == 0 || seconds == 0 || profile == NULL ||
+	    nzones == 0 || nhosts == 0)
+	{
+		usage(argv[0]);
+	}
+
+	result = dns_name_fromstring(dns_fixedname_initname(&ftest), "test.",
+				     dns_rootname, 0, NULL);
+	assert(result == ISC_R_SUCCESS);
+
+	isc_mem_create(&mctx);
+	isc_loopmgr_create(mctx, isc_os_ncpus(), &loopmgr);
+	mainloop = isc_loop_main(loopmgr);
+	isc_netmgr_create(mctx, loopmgr, &netmgr);
+
+	isc_loop_setup(mainloop, setup, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	isc_netmgr_destroy(&netmgr);
+	isc_loopmgr_destroy(&loopmgr);
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
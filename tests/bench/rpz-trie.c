@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <isc/mem.h>
+#include <isc/random.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/rpz.h>
+
+#include "rpz_p.h"
+
+/*
+ * Load random IPv4 and IPv6 response policy triggers into the lookup
+ * trie, and look up addresses half of which are covered by a trigger.
+ * A sample of the lookups is checked against a linear search.
+ */
+
+#define ZONES 8
+
+static isc_mem_t *mctx = NULL;
+
+static void
+random_entry(dns_rpz_trieentry_t *e) {
+	dns_rpz_cidr_key_t ip;
+	dns_rpz_zbits_t zbit = DNS_RPZ_ZBIT(isc_random_uniform(ZONES));
+
+	isc_random_buf(&ip, sizeof(ip));
+	if (isc_random_uniform(4) != 0) {
+		/* IPv4, mostly host addresses */
+		ip.w[0] = ip.w[1] = 0;
+		ip.w[2] = 0xffff;
+		e->prefix = 96 + (isc_random_uniform(4) != 0
+					  ? 32
+					  : 8 + isc_random_uniform(24));
+	} else {
+		e->prefix = (isc_random_uniform(2) != 0)
+				    ? 128
+				    : 16 + isc_random_uniform(112);
+	}
+	for (int i = 0; i < 4; i++) {
+		int bits = e->prefix - i * 32;
+		if (bits >= 32) {
+			e->ip.w[i] = ip.w[i];
+		} else if (bits > 0) {
+			e->ip.w[i] = ip.w[i] & (0xffffffffU << (32 - bits));
+		} else {
+			e->ip.w[i] = 0;
+		}
+	}
+	e->set = (dns_rpz_addr_zbits_t){ 0 };
+	switch (isc_random_uniform(3)) {
+	case 0:
+		e->set.client_ip = zbit;
+		break;
+	case 1:
+		e->set.ip = zbit;
+		break;
+	default:
+		e->set.nsip = zbit;
+		break;
+	}
+}
+
+static int
+compare_entries(const void *va, const void *vb) {
+	const dns_rpz_trieentry_t *a = va, *b = vb;
+
+	for (int i = 0; i < 4; i++) {
+		if (a->ip.w[i] != b->ip.w[i]) {
+			return (a->ip.w[i] < b->ip.w[i] ? -1 : 1);
+		}
+	}
+	return (a->prefix - b->prefix);
+}
+
+static bool
+covers(const dns_rpz_trieentry_t *e, const dns_rpz_cidr_key_t *ip) {
+	for (int i = 0; i < 4; i++) {
+		int bits = e->prefix - i * 32;
+		uint32_t mask = (bits >= 32)  ? 0xffffffffU
+				: (bits > 0) ? (0xffffffffU << (32 - bits))
+					     : 0;
+		if ((ip->w[i] & mask) != e->ip.w[i]) {
+			return (false);
+		}
+	}
+	return (true);
+}
+
+/*
+ * The first zone with a trigger for 'ip', and the longest such trigger.
+ */
+static bool
+linear_find(const dns_rpz_trieentry_t *entries, size_t count,
+	    const dns_rpz_cidr_key_t *ip, dns_rpz_zbits_t *zbitp,
+	    dns_rpz_prefix_t *prefixp) {
+	dns_rpz_zbits_t zbit = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		dns_rpz_zbits_t ip_bits = entries[i].set.ip;
+		ip_bits &= ~ip_bits + 1;
+		if (ip_bits != 0 && covers(&entries[i], ip) &&
+		    (zbit == 0 || ip_bits < zbit ||
+		     (ip_bits == zbit && entries[i].prefix > *prefixp)))
+		{
+			zbit = ip_bits;
+			*prefixp = entries[i].prefix;
+		}
+	}
+	*zbitp = zbit;
+	return (zbit != 0);
+}
+
+int
+main(int argc, char **argv) {
+	dns_rpz_trieentry_t *entries = NULL;
+	dns_rpz_cidr_key_t *addrs = NULL;
+	dns_rpz_trie_t *trie = NULL;
+	dns_rpz_addr_zbits_t tgt_set = { .ip = DNS_RPZ_ALL_ZBITS };
+	size_t count = 1000000, lookups = 10000000, found = 0, n, i;
+	isc_nanosecs_t start, stop;
+	char buf[256];
+
+	if (argc > 1) {
+		count = strtoul(argv[1], NULL, 0);
+	}
+	if (argc > 2) {
+		lookups = strtoul(argv[2], NULL, 0);
+	}
+
+	isc_mem_create(&mctx);
+
+	entries = isc_mem_cget(mctx, count, sizeof(entries[0]));
+	for (i = 0; i < count; i++) {
+		random_entry(&entries[i]);
+	}
+	qsort(entries, count, sizeof(entries[0]), compare_entries);
+	for (i = n = 0; i < count; i++) {
+		if (n > 0 && compare_entries(&entries[n - 1], &entries[i]) == 0)
+		{
+			dns_rpz_addr_zbits_t *set = &entries[n - 1].set;
+			set->client_ip |= entries[i].set.client_ip;
+			set->ip |= entries[i].set.ip;
+			set->nsip |= entries[i].set.nsip;
+		} else {
+			entries[n++] = entries[i];
+		}
+	}
+
+	start = isc_time_monotonic();
+	dns__rpz_trie_create(mctx, entries, n, &trie);
+	stop = isc_time_monotonic();
+
+	snprintf(buf, sizeof(buf), "build trie of %zu triggers:", n);
+	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
+	printf("%-57s%7zuKiB\n", "memory in use:", isc_mem_inuse(mctx) / 1024);
+
+	addrs = isc_mem_cget(mctx, lookups, sizeof(addrs[0]));
+	for (i = 0; i < lookups; i++) {
+		isc_random_buf(&addrs[i], sizeof(addrs[i]));
+		if (n > 0 && isc_random_uniform(2) == 0) {
+			const dns_rpz_trieentry_t *e =
+				&entries[isc_random_uniform(n)];
+			for (int w = 0; w < 4; w++) {
+				int bits = e->prefix - w * 32;
+				if (bits >= 32) {
+					addrs[i].w[w] = e->ip.w[w];
+				} else if (bits > 0) {
+					uint32_t mask = 0xffffffffU
+							<< (32 - bits);
+					addrs[i].w[w] = e->ip.w[w] |
+							(addrs[i].w[w] & ~mask);
+				}
+			}
+		}
+	}
+
+	start = isc_time_monotonic();
+	for (i = 0; i < lookups; i++) {
+		dns_rpz_addr_zbits_t found_set;
+		dns_rpz_prefix_t prefix;
+
+		if (dns__rpz_trie_find(trie, &addrs[i], &tgt_set, &found_set,
+				       &prefix) == ISC_R_SUCCESS)
+		{
+			found++;
+		}
+	}
+	stop = isc_time_monotonic();
+
+	snprintf(buf, sizeof(buf), "look up %zu addresses (%zu found):",
+		 lookups, found);
+	printf("%-57s%7.3fsec\n", buf, (stop - start) / (double)NS_PER_SEC);
+	printf("%-57s%7.1fns\n", "per lookup:",
+	       (stop - start) / (double)lookups);
+
+	for (i = 0; i < ISC_MIN(lookups, 1000); i++) {
+		dns_rpz_addr_zbits_t found_set;
+		dns_rpz_prefix_t prefix = 0, lprefix = 0;
+		dns_rpz_zbits_t zbit;
+		isc_result_t result;
+		bool lfound;
+
+		result = dns__rpz_trie_find(trie, &addrs[i], &tgt_set,
+					    &found_set, &prefix);
+		lfound = linear_find(entries, n, &addrs[i], &zbit, &lprefix);
+		assert(lfound == (result == ISC_R_SUCCESS));
+		if (lfound) {
+			assert((found_set.ip & (~found_set.ip + 1)) == zbit);
+			assert(prefix == lprefix);
+		}
+	}
+
+	dns__rpz_trie_destroy(&trie);
+	isc_mem_cput(mctx, addrs, lookups, sizeof(addrs[0]));
+	isc_mem_cput(mctx, entries, count, sizeof(entries[0]));
+	isc_mem_destroy(&mctx);
+
+	return (0);
+}
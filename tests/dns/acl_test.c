@@ -24,10 +24,14 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/netaddr.h>
+#include <isc/radix.h>
+#include <isc/random.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
 #include <dns/acl.h>
+#include <dns/iptable.h>
 
 #include <tests/dns.h>
 
@@ -107,8 +111,148 @@ ISC_RUN_TEST_IMPL(dns_acl_isinsecure) {
 #endif /* HAVE_GEOIP2 */
 }
 
+#define PREFIXES  500
+#define LOOKUPS	  20000
+#define BASEBYTES 2
+
+/* what a radix tree search says about 'addr' */
+static int
+radix_match(dns_iptable_t *tab, const isc_netaddr_t *addr) {
+	isc_prefix_t pfx;
+	isc_radix_node_t *node = NULL;
+	isc_result_t result;
+	int match = 0;
+
+	NETADDR_TO_PREFIX_T(addr, pfx, (addr->family == AF_INET6) ? 128 : 32);
+	result = isc_radix_search(tab->radix, &node, &pfx);
+	if (result == ISC_R_SUCCESS && node != NULL) {
+		int fam = ISC_RADIX_FAMILY(&pfx);
+		match = node->node_num[fam];
+		if (!*(bool *)node->data[fam]) {
+			match = -match;
+		}
+	}
+	isc_refcount_destroy(&pfx.refcount);
+
+	return (match);
+}
+
+/*
+ * Random addresses sharing their first BASEBYTES bytes, so that the
+ * prefixes built from them overlap and nest.
+ */
+static void
+random_addr(isc_netaddr_t *addr, bool v6) {
+	unsigned char buf[16];
+
+	isc_random_buf(buf, sizeof(buf));
+	memset(buf, 0x0a, BASEBYTES);
+	if (v6) {
+		struct in6_addr in6;
+		memmove(in6.s6_addr, buf, sizeof(in6.s6_addr));
+		isc_netaddr_fromin6(addr, &in6);
+	} else {
+		struct in_addr in;
+		memmove(&in.s_addr, buf, sizeof(in.s_addr));
+		isc_netaddr_fromin(addr, &in);
+	}
+}
+
+/* the compiled IP table gives the same answers as the radix tree */
+ISC_RUN_TEST_IMPL(dns_iptable_match) {
+	dns_iptable_t *tab = NULL;
+	isc_netaddr_t addr;
+
+	dns_iptable_create(mctx, &tab);
+
+	/* An empty table matches nothing */
+	random_addr(&addr, false);
+	assert_int_equal(dns_iptable_match(tab, &addr), 0);
+
+	for (size_t i = 0; i < PREFIXES; i++) {
+		bool v6 = (isc_random_uniform(2) == 1);
+		uint16_t bitlen = 8 * BASEBYTES +
+				  isc_random_uniform((v6 ? 128 : 32) -
+						     8 * BASEBYTES + 1);
+
+		random_addr(&addr, v6);
+		assert_int_equal(dns_iptable_addprefix(tab, &addr, bitlen,
+						       isc_random_uniform(2)),
+				 ISC_R_SUCCESS);
+		if (i == PREFIXES / 2) {
+			/* Adding a prefix discards the compiled table */
+			assert_int_equal(dns_iptable_match(tab, &addr),
+					 radix_match(tab, &addr));
+			assert_int_equal(dns_iptable_addprefix(tab, NULL, 0,
+							       false),
+					 ISC_R_SUCCESS);
+		}
+	}
+
+	dns_iptable_compile(tab);
+
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		random_addr(&addr, (i % 2) == 1);
+		assert_int_equal(dns_iptable_match(tab, &addr),
+				 radix_match(tab, &addr));
+	}
+
+	dns_iptable_detach(&tab);
+}
+
+#define TABLES 8
+
+/* an IP table set gives the same answers as each of its tables */
+ISC_RUN_TEST_IMPL(dns_iptableset_match) {
+	dns_iptable_t *tabs[TABLES] = { NULL };
+	dns_iptableset_t *set = NULL;
+	isc_netaddr_t addr;
+
+	/* One table is left out of the set and always says 0 */
+	for (size_t t = 1; t < TABLES; t++) {
+		dns_iptable_create(mctx, &tabs[t]);
+		for (size_t i = 0; i < PREFIXES / TABLES; i++) {
+			bool v6 = (isc_random_uniform(2) == 1);
+			uint16_t bitlen =
+				8 * BASEBYTES +
+				isc_random_uniform((v6 ? 128 : 32) -
+						   8 * BASEBYTES + 1);
+
+			random_addr(&addr, v6);
+			assert_int_equal(
+				dns_iptable_addprefix(tabs[t], &addr, bitlen,
+						      isc_random_uniform(2)),
+				ISC_R_SUCCESS);
+		}
+	}
+	assert_int_equal(dns_iptable_addprefix(tabs[TABLES - 1], NULL, 0,
+					       true),
+			 ISC_R_SUCCESS);
+
+	dns_iptableset_create(mctx, tabs, TABLES, &set);
+
+	for (size_t i = 0; i < LOOKUPS; i++) {
+		const int8_t *match = NULL;
+
+		random_addr(&addr, (i % 2) == 1);
+		match = dns_iptableset_match(set, &addr);
+		assert_int_equal(match[0], 0);
+		for (size_t t = 1; t < TABLES; t++) {
+			int m = dns_iptable_match(tabs[t], &addr);
+			assert_int_equal(match[t], (m > 0) - (m < 0));
+		}
+	}
+
+	dns_iptableset_destroy(&set);
+	for (size_t t = 1; t < TABLES; t++) {
+		dns_iptable_detach(&tabs[t]);
+	}
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(dns_acl_isinsecure)
+ISC_TEST_ENTRY(dns_iptable_match)
+ISC_TEST_ENTRY(dns_iptableset_match)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -24,6 +24,7 @@
 
 #include <dns/db.h>
 #include <dns/dbiterator.h>
+#include <dns/fixedname.h>
 #include <dns/journal.h>
 #include <dns/name.h>
 #include <dns/rdatalist.h>
@@ -295,6 +296,54 @@ ISC_RUN_TEST_IMPL(dbtype) {
 	dns_db_detach(&db);
 }
 
+/* find or create several nodes at once */
+static void
+findnodes_test(const char *dbimpl, dns_dbtype_t dbtype) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_fixedname_t fa, fb;
+	const dns_name_t *names[3];
+	dns_dbnode_t *nodes[3] = { NULL };
+	dns_dbnode_t *node = NULL;
+
+	result = dns_db_create(mctx, dbimpl, dns_rootname, dbtype,
+			       dns_rdataclass_in, 0, NULL, &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_test_namefromstring("a.example.", &fa);
+	dns_test_namefromstring("b.example.", &fb);
+	names[0] = names[2] = dns_fixedname_name(&fa);
+	names[1] = dns_fixedname_name(&fb);
+
+	/* One name exists already, the other is new and repeated */
+	result = dns_db_findnode(db, names[1], true, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_db_findnodes(db, names, ARRAY_SIZE(names), nodes);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(nodes[1], node);
+	assert_non_null(nodes[0]);
+	assert_ptr_equal(nodes[0], nodes[2]);
+	dns_db_detachnode(db, &node);
+
+	result = dns_db_findnode(db, names[0], false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(nodes[0], node);
+	dns_db_detachnode(db, &node);
+
+	for (size_t i = 0; i < ARRAY_SIZE(nodes); i++) {
+		dns_db_detachnode(db, &nodes[i]);
+	}
+	dns_db_detach(&db);
+}
+
+ISC_RUN_TEST_IMPL(findnodes) {
+	UNUSED(state);
+
+	findnodes_test(CACHEDB_DEFAULT, dns_dbtype_cache);
+	findnodes_test(ZONEDB_DEFAULT, dns_dbtype_zone);
+}
+
 /* database versions */
 ISC_RUN_TEST_IMPL(version) {
 	isc_result_t result;
@@ -362,13 +411,204 @@ ISC_RUN_TEST_IMPL(version) {
 	dns_db_detach(&db);
 }
 
+/* pre-rendered response data */
+ISC_RUN_TEST_IMPL(rendered) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *ver = NULL, *new = NULL;
+	unsigned char keydata[] = "key";
+	unsigned char hdrdata[] = "header";
+	unsigned char wiredata[] = "wire";
+	isc_region_t key = { keydata, sizeof(keydata) - 1 };
+	isc_region_t data[2] = { { hdrdata, sizeof(hdrdata) - 1 },
+				 { wiredata, sizeof(wiredata) - 1 } };
+	isc_region_t found;
+
+	UNUSED(state);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 TESTS_DIR "/testdata/db/data.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(db, &ver);
+	result = dns_db_getrendered(db, ver, &key, &found);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	result = dns_db_addrendered(db, ver, &key, data, 2);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addrendered(db, ver, &key, data, 2);
+	assert_int_equal(result, ISC_R_EXISTS);
+
+	result = dns_db_getrendered(db, ver, &key, &found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(found.length, 10);
+	assert_memory_equal(found.base, "headerwire", 10);
+
+	/* A new version starts out empty */
+	result = dns_db_newversion(db, &new);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &new, true);
+	dns_db_closeversion(db, &ver, false);
+
+	dns_db_currentversion(db, &ver);
+	result = dns_db_getrendered(db, ver, &key, &found);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	dns_db_closeversion(db, &ver, false);
+
+	dns_db_detach(&db);
+}
+
+/* NSEC3 hashes of owner names */
+ISC_RUN_TEST_IMPL(nsec3hash) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbversion_t *ver = NULL, *new = NULL;
+	dns_fixedname_t fname, fhash, ffound;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *hashname = dns_fixedname_initname(&fhash);
+	dns_name_t *found = dns_fixedname_initname(&ffound);
+
+	UNUSED(state);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 TESTS_DIR "/testdata/db/data.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_name_fromstring(name, "Foo.Test.Test.", NULL, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_name_fromstring(
+		hashname, "2vptu5timamqttgl4luu9kg21e0aor3s.test.test.", NULL,
+		0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_db_currentversion(db, &ver);
+	result = dns_db_getnsec3hash(db, ver, name, found);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	result = dns_db_addnsec3hash(db, ver, name, hashname);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_addnsec3hash(db, ver, name, hashname);
+	assert_int_equal(result, ISC_R_EXISTS);
+
+	/* The lookup is case insensitive */
+	result = dns_name_fromstring(name, "foo.test.test.", NULL, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_getnsec3hash(db, ver, name, found);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_name_equal(found, hashname));
+
+	/* A new version starts out empty */
+	result = dns_db_newversion(db, &new);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	dns_db_closeversion(db, &new, true);
+	dns_db_closeversion(db, &ver, false);
+
+	dns_db_currentversion(db, &ver);
+	result = dns_db_getnsec3hash(db, ver, name, found);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	dns_db_closeversion(db, &ver, false);
+
+	dns_db_detach(&db);
+}
+
+static void
+setresign(dns_db_t *db, const char *owner, dns_rdatatype_t type,
+	  isc_stdtime_t resign) {
+	isc_result_t result;
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_dbnode_t *node = NULL;
+	dns_rdataset_t rdataset;
+
+	dns_rdataset_init(&rdataset);
+
+	result = dns_name_fromstring(name, owner, NULL, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_findnode(db, name, false, &node);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_findrdataset(db, node, NULL, type, 0, 0, &rdataset,
+				     NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	result = dns_db_setsigningtime(db, &rdataset, resign);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_rdataset_disassociate(&rdataset);
+	dns_db_detachnode(db, &node);
+}
+
+/* batches of RRsets due for re-signing */
+ISC_RUN_TEST_IMPL(signingtimes) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_dbsigning_t entries[4];
+	dns_fixedname_t fname;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	size_t count;
+
+	UNUSED(state);
+
+	result = dns_test_loaddb(&db, dns_dbtype_zone, "test.test",
+				 TESTS_DIR "/testdata/db/data.db");
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	count = ARRAY_SIZE(entries);
+	result = dns_db_getsigningtimes(db, 5000, entries, &count);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+	assert_int_equal(count, 0);
+
+	setresign(db, "test.test.", dns_rdatatype_soa, 1000);
+	setresign(db, "a.test.test.", dns_rdatatype_ns, 3000);
+	setresign(db, "b.test.test.", dns_rdatatype_a, 2000);
+
+	/* Nothing is due yet */
+	count = ARRAY_SIZE(entries);
+	result = dns_db_getsigningtimes(db, 999, entries, &count);
+	assert_int_equal(result, ISC_R_NOTFOUND);
+
+	/* Only RRsets due by 'until' are returned, earliest first */
+	count = ARRAY_SIZE(entries);
+	result = dns_db_getsigningtimes(db, 2500, entries, &count);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, 2);
+	assert_int_equal(entries[0].resign, 1000);
+	assert_int_equal(entries[1].resign, 2000);
+	result = dns_name_fromstring(name, "b.test.test.", NULL, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_name_equal(dns_fixedname_name(&entries[1].name),
+				   name));
+
+	/* A short array gets the earliest ones */
+	count = 2;
+	result = dns_db_getsigningtimes(db, 5000, entries, &count);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, 2);
+	assert_int_equal(entries[0].resign, 1000);
+	assert_int_equal(entries[1].resign, 2000);
+
+	count = ARRAY_SIZE(entries);
+	result = dns_db_getsigningtimes(db, 5000, entries, &count);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(count, 3);
+	assert_int_equal(entries[2].resign, 3000);
+	result = dns_name_fromstring(name, "a.test.test.", NULL, 0, NULL);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_true(dns_name_equal(dns_fixedname_name(&entries[2].name),
+				   name));
+
+	dns_db_detach(&db);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(getoriginnode)
 ISC_TEST_ENTRY(getsetservestalettl)
 ISC_TEST_ENTRY(dns_dbfind_staleok)
 ISC_TEST_ENTRY(class)
 ISC_TEST_ENTRY(dbtype)
+ISC_TEST_ENTRY(findnodes)
 ISC_TEST_ENTRY(version)
+ISC_TEST_ENTRY(rendered)
+ISC_TEST_ENTRY(nsec3hash)
+ISC_TEST_ENTRY(signingtimes)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -24,15 +24,18 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
 #include <isc/buffer.h>
 #include <isc/managers.h>
 #include <isc/refcount.h>
+#include <isc/stats.h>
 #include <isc/tls.h>
 #include <isc/util.h>
 #include <isc/uv.h>
 
 #include <dns/dispatch.h>
 #include <dns/name.h>
+#include <dns/stats.h>
 #include <dns/view.h>
 
 #include <tests/dns.h>
@@ -392,6 +395,23 @@ nameserver(isc_nmhandle_t *handle, isc_result_t eresult, isc_region_t *region,
 	isc_nm_send(handle, &response2, server_senddone, NULL);
 }
 
+static void
+echo_nameserver(isc_nmhandle_t *handle, isc_result_t eresult,
+		isc_region_t *region, void *arg ISC_ATTR_UNUSED) {
+	static unsigned char buf[16];
+
+	if (eresult != ISC_R_SUCCESS) {
+		return;
+	}
+
+	memmove(buf, region->base, 12);
+	memset(buf + 12, 0, 4);
+	buf[2] |= 0x80; /* qr=1 */
+
+	isc_nm_send(handle, &(isc_region_t){ buf, sizeof(buf) },
+		    server_senddone, NULL);
+}
+
 static isc_result_t
 accept_cb(isc_nmhandle_t *handle, isc_result_t eresult, void *arg) {
 	UNUSED(handle);
@@ -492,7 +512,7 @@ connected_gettcp(isc_result_t eresult ISC_ATTR_UNUSED,
 	};
 
 	result = dns_dispatch_gettcp(test2->dispatchmgr, &tcp_server_addr,
-				     &tcp_connect_addr, &test2->dispatch);
+				     &tcp_connect_addr, NULL, &test2->dispatch);
 	assert_int_equal(result, ISC_R_SUCCESS);
 
 	assert_ptr_equal(test1->dispatch, test2->dispatch);
@@ -521,7 +541,7 @@ connected_newtcp(isc_result_t eresult ISC_ATTR_UNUSED,
 		.dispatchmgr = dns_dispatchmgr_ref(test3->dispatchmgr),
 	};
 	result = dns_dispatch_gettcp(test4->dispatchmgr, &tcp_server_addr,
-				     &tcp_connect_addr, &test4->dispatch);
+				     &tcp_connect_addr, NULL, &test4->dispatch);
 	assert_int_equal(result, ISC_R_NOTFOUND);
 
 	result = dns_dispatch_createtcp(
@@ -807,6 +827,187 @@ ISC_LOOP_TEST_IMPL(dispatch_gettcp) {
 	dns_dispatch_connect(test->dispentry);
 }
 
+static void
+connected_reuse(isc_result_t eresult, isc_region_t *region ISC_ATTR_UNUSED,
+		void *arg) {
+	test_dispatch_t *test = arg;
+
+	REQUIRE(eresult == ISC_R_SUCCESS);
+
+	testdata.message[0] = (test->id >> 8) & 0xff;
+	testdata.message[1] = test->id & 0xff;
+
+	dns_dispatch_send(test->dispentry, &testdata.region);
+}
+
+static void
+response_reuse(isc_result_t eresult, isc_region_t *region ISC_ATTR_UNUSED,
+	       void *arg) {
+	test_dispatch_t *test1 = arg;
+	dns_dispatch_t *disp = test1->dispatch;
+	isc_result_t result;
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+
+	/* Client 2 */
+	test_dispatch_t *test2 = isc_mem_get(mctx, sizeof(*test2));
+	*test2 = (test_dispatch_t){
+		.dispatchmgr = dns_dispatchmgr_ref(test1->dispatchmgr),
+	};
+
+	/*
+	 * Once the first query is done and nothing else holds the
+	 * dispatch, the idle connection should still be handed out.
+	 */
+	test_dispatch_done(test1);
+
+	result = dns_dispatch_gettcp(test2->dispatchmgr, &tcp_server_addr,
+				     &tcp_connect_addr, NULL, &test2->dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_ptr_equal(test2->dispatch, disp);
+
+	result = dns_dispatch_add(test2->dispatch, isc_loop_main(loopmgr), 0,
+				  T_CLIENT_CONNECT, &tcp_server_addr, NULL,
+				  NULL, connected_reuse, client_senddone,
+				  response_shutdown, test2, &test2->id,
+				  &test2->dispentry);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_dispatch_connect(test2->dispentry);
+}
+
+ISC_LOOP_TEST_IMPL(dispatch_tcp_reuse) {
+	isc_result_t result;
+	test_dispatch_t *test = isc_mem_get(mctx, sizeof(*test));
+	*test = (test_dispatch_t){ 0 };
+
+	/* Server */
+	result = isc_nm_listenstreamdns(
+		netmgr, ISC_NM_LISTEN_ONE, &tcp_server_addr, echo_nameserver,
+		NULL, accept_cb, NULL, 0, NULL, NULL, ISC_NM_PROXY_NONE, &sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_loop_teardown(isc_loop_main(loopmgr), stop_listening, sock);
+
+	/* Client */
+	testdata.region.base = testdata.message;
+	testdata.region.length = sizeof(testdata.message);
+
+	result = dns_dispatchmgr_create(mctx, loopmgr, connect_nm,
+					&test->dispatchmgr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_dispatchmgr_settcpreuse(test->dispatchmgr, T_CLIENT_IDLE);
+
+	result = dns_dispatch_createtcp(test->dispatchmgr, &tcp_connect_addr,
+					&tcp_server_addr, 0, &test->dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_dispatch_add(test->dispatch, isc_loop_main(loopmgr), 0,
+				  T_CLIENT_CONNECT, &tcp_server_addr, NULL,
+				  NULL, connected_reuse, client_senddone,
+				  response_reuse, test, &test->id,
+				  &test->dispentry);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_dispatch_connect(test->dispentry);
+}
+
+static isc_stats_t *udp_reuse_stats = NULL;
+
+static void
+response_udp_reused(isc_result_t eresult, isc_region_t *region ISC_ATTR_UNUSED,
+		    void *arg) {
+	test_dispatch_t *test = arg;
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+	assert_int_equal(isc_stats_get_counter(udp_reuse_stats,
+					       dns_resstatscounter_udpreuse),
+			 1);
+	isc_stats_detach(&udp_reuse_stats);
+
+	test_dispatch_shutdown(test);
+}
+
+static void
+udp_reuse_second(void *arg) {
+	test_dispatch_t *test = arg;
+	isc_result_t result;
+
+	result = dns_dispatch_add(test->dispatch, isc_loop_main(loopmgr), 0,
+				  T_CLIENT_CONNECT, &udp_server_addr, NULL,
+				  NULL, connected_reuse, client_senddone,
+				  response_udp_reused, test, &test->id,
+				  &test->dispentry);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_dispatch_connect(test->dispentry);
+}
+
+static void
+response_udp_reuse(isc_result_t eresult, isc_region_t *region ISC_ATTR_UNUSED,
+		   void *arg) {
+	test_dispatch_t *test1 = arg;
+
+	assert_int_equal(eresult, ISC_R_SUCCESS);
+	assert_int_equal(isc_stats_get_counter(udp_reuse_stats,
+					       dns_resstatscounter_udpreuse),
+			 0);
+
+	/* Client 2 */
+	test_dispatch_t *test2 = isc_mem_get(mctx, sizeof(*test2));
+	*test2 = (test_dispatch_t){
+		.dispatchmgr = dns_dispatchmgr_ref(test1->dispatchmgr),
+		.dispatch = dns_dispatch_ref(test1->dispatch),
+	};
+
+	test_dispatch_done(test1);
+
+	/*
+	 * The socket is parked once this callback has returned, so the
+	 * second query has to be sent from a new event.
+	 */
+	isc_async_run(isc_loop_main(loopmgr), udp_reuse_second, test2);
+}
+
+ISC_LOOP_TEST_IMPL(dispatch_udp_reuse) {
+	isc_result_t result;
+	test_dispatch_t *test = isc_mem_get(mctx, sizeof(*test));
+	*test = (test_dispatch_t){ 0 };
+
+	/* Server */
+	result = isc_nm_listenudp(netmgr, ISC_NM_LISTEN_ONE, &udp_server_addr,
+				  echo_nameserver, NULL, &sock);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_loop_teardown(isc_loop_main(loopmgr), stop_listening, sock);
+
+	/* Client */
+	testdata.region.base = testdata.message;
+	testdata.region.length = sizeof(testdata.message);
+
+	result = dns_dispatchmgr_create(mctx, loopmgr, connect_nm,
+					&test->dispatchmgr);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	isc_stats_create(mctx, &udp_reuse_stats, dns_resstatscounter_max);
+	dns_dispatchmgr_setstats(test->dispatchmgr, udp_reuse_stats);
+	dns_dispatchmgr_setudpreuse(test->dispatchmgr, 2);
+
+	result = dns_dispatch_createudp(test->dispatchmgr, &udp_connect_addr,
+					&test->dispatch);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	result = dns_dispatch_add(test->dispatch, isc_loop_main(loopmgr), 0,
+				  T_CLIENT_CONNECT, &udp_server_addr, NULL,
+				  NULL, connected_reuse, client_senddone,
+				  response_udp_reuse, test, &test->id,
+				  &test->dispentry);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	dns_dispatch_connect(test->dispentry);
+}
+
 ISC_LOOP_TEST_IMPL(dispatch_newtcp) {
 	isc_result_t result;
 	test_dispatch_t *test = isc_mem_get(mctx, sizeof(*test));
@@ -843,6 +1044,8 @@ ISC_LOOP_TEST_IMPL(dispatch_newtcp) {
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(dispatch_gettcp, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_newtcp, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(dispatch_tcp_reuse, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(dispatch_udp_reuse, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatch_timeout_udp_response, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatchset_create, setup_test, teardown_test)
 ISC_TEST_ENTRY_CUSTOM(dispatchset_get, setup_test, teardown_test)
@@ -23,11 +23,13 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/mem.h>
 #include <isc/netaddr.h>
 #include <isc/result.h>
 #include <isc/string.h>
 #include <isc/util.h>
 
+#include <dns/acl.h>
 #include <dns/dns64.h>
 #include <dns/rdata.h>
 #include <dns/rdatalist.h>
@@ -227,8 +229,72 @@ ISC_RUN_TEST_IMPL(dns64_findprefix) {
 	multiple_prefixes();
 }
 
+/* Synthesise AAAA addresses, checking the client once per dns64 entry */
+ISC_RUN_TEST_IMPL(dns64_synthesize) {
+	struct {
+		unsigned int prefixlen;
+		unsigned char aaaa[16];
+	} tests[] = {
+		{ 96,
+		  { 0, 0x64, 0xff, 0x9b, 0, 0, 0, 0, 0, 0, 0, 0, 192, 0, 2,
+		    1 } },
+		{ 64,
+		  { 0, 0x64, 0xff, 0x9b, 0, 0, 0, 0, 0, 192, 0, 2, 1, 0, 0,
+		    0 } },
+		{ 32,
+		  { 0, 0x64, 0xff, 0x9b, 192, 0, 2, 1, 0, 0, 0, 0, 0, 0, 0,
+		    0 } },
+	};
+	unsigned char a[4] = { 192, 0, 2, 1 };
+	struct in6_addr in6 = { .s6_addr = { 0, 0x64, 0xff, 0x9b } };
+	isc_netaddr_t prefix, client;
+	dns_aclenv_t *env = NULL;
+	isc_result_t result;
+	size_t i;
+
+	UNUSED(state);
+
+	isc_netaddr_fromin6(&prefix, &in6);
+	isc_netaddr_fromin6(&client, &in6addr_loopback);
+	dns_aclenv_create(mctx, &env);
+
+	for (i = 0; i < ARRAY_SIZE(tests); i++) {
+		dns_dns64_t *dns64 = NULL;
+		unsigned char aaaa[16], aaaa2[16];
+
+		result = dns_dns64_create(mctx, &prefix, tests[i].prefixlen,
+					  NULL, NULL, NULL, NULL,
+					  DNS_DNS64_RECURSIVE_ONLY, &dns64);
+		assert_int_equal(result, ISC_R_SUCCESS);
+
+		assert_false(dns_dns64_applies(dns64, &client, NULL, env, 0));
+		assert_true(dns_dns64_applies(dns64, &client, NULL, env,
+					      DNS_DNS64_RECURSIVE));
+		assert_false(dns_dns64_applies(
+			dns64, &client, NULL, env,
+			DNS_DNS64_RECURSIVE | DNS_DNS64_DNSSEC));
+
+		result = dns_dns64_synthesize(dns64, env, a, aaaa);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_memory_equal(aaaa, tests[i].aaaa, 16);
+
+		result = dns_dns64_aaaafroma(dns64, &client, NULL, env, 0, a,
+					     aaaa2);
+		assert_int_equal(result, DNS_R_DISALLOWED);
+		result = dns_dns64_aaaafroma(dns64, &client, NULL, env,
+					     DNS_DNS64_RECURSIVE, a, aaaa2);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_memory_equal(aaaa2, aaaa, 16);
+
+		dns_dns64_destroy(&dns64);
+	}
+
+	dns_aclenv_detach(&env);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(dns64_findprefix)
+ISC_TEST_ENTRY(dns64_synthesize)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -0,0 +1,263 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/keycache.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdatalist.h>
+#include <dns/rdataset.h>
+
+#include <dst/dst.h>
+
+#include <tests/dns.h>
+
+#define ALG 15 /* Ed25519 */
+
+/*
+ * A zone key, the same key revoked, and a key that is not a zone key.
+ */
+static const char *keytext[] = {
+	"257 3 15 l02Woi0iS8Aa25FQkUd9RMzZHJpBoRQwAQEX1SxZJA4=",
+	"385 3 15 l02Woi0iS8Aa25FQkUd9RMzZHJpBoRQwAQEX1SxZJA4=",
+	"0 3 15 zPnZ/QwEe7S8C5SPz2OfS5RR40ATk2/rYnE9xHIEijs=",
+};
+
+#define NKEYS ARRAY_SIZE(keytext)
+
+static unsigned char keydata[NKEYS][DST_KEY_MAXSIZE];
+static dns_rdata_t keyrdata[NKEYS];
+static dns_keytag_t keytag[NKEYS];
+
+static int
+setup_test(void **state) {
+	UNUSED(state);
+
+	if (dst_lib_init(mctx, NULL) != ISC_R_SUCCESS) {
+		return (1);
+	}
+
+	for (size_t i = 0; i < NKEYS; i++) {
+		isc_region_t r;
+
+		dns_rdata_init(&keyrdata[i]);
+		if (dns_test_rdatafromstring(&keyrdata[i], dns_rdataclass_in,
+					     dns_rdatatype_dnskey, keydata[i],
+					     sizeof(keydata[i]), keytext[i],
+					     false) != ISC_R_SUCCESS)
+		{
+			return (1);
+		}
+		dns_rdata_toregion(&keyrdata[i], &r);
+		keytag[i] = dst_region_computeid(&r);
+	}
+
+	return (0);
+}
+
+static int
+teardown_test(void **state) {
+	UNUSED(state);
+
+	dst_lib_destroy();
+
+	return (0);
+}
+
+/*
+ * Add the keys 'first' to 'last' (inclusive) as the keyset of 'name'.
+ */
+static void
+addkeys(dns_keycache_t *kc, const dns_name_t *name, size_t first,
+	size_t last, isc_stdtime_t expire) {
+	dns_rdatalist_t rdatalist;
+	dns_rdataset_t rdataset = DNS_RDATASET_INIT;
+	dns_rdata_t rdata[NKEYS];
+
+	dns_rdatalist_init(&rdatalist);
+	rdatalist.rdclass = dns_rdataclass_in;
+	rdatalist.type = dns_rdatatype_dnskey;
+	rdatalist.ttl = 3600;
+	for (size_t i = first; i <= last; i++) {
+		dns_rdata_init(&rdata[i]);
+		dns_rdata_clone(&keyrdata[i], &rdata[i]);
+		ISC_LIST_APPEND(rdatalist.rdata, &rdata[i], link);
+	}
+	dns_rdatalist_tordataset(&rdatalist, &rdataset);
+
+	dns_keycache_add(kc, name, &rdataset, expire);
+
+	dns_rdataset_disassociate(&rdataset);
+}
+
+static isc_result_t
+findkey(dns_keycache_t *kc, const dns_name_t *name, size_t i,
+	unsigned int n, isc_stdtime_t now) {
+	isc_result_t result;
+	dst_key_t *key = NULL;
+
+	result = dns_keycache_find(kc, name, ALG, keytag[i], n, now, &key);
+	if (result == ISC_R_SUCCESS) {
+		assert_non_null(key);
+		assert_int_equal(dst_key_id(key), keytag[i]);
+		assert_true(dns_name_equal(dst_key_name(key), name));
+		dst_key_free(&key);
+	} else {
+		assert_null(key);
+	}
+
+	return (result);
+}
+
+ISC_RUN_TEST_IMPL(basic) {
+	dns_keycache_t *kc = NULL;
+	dns_fixedname_t f1, f2;
+	dns_name_t *name1 = dns_fixedname_initname(&f1);
+	dns_name_t *name2 = dns_fixedname_initname(&f2);
+	isc_stdtime_t now = isc_stdtime_now();
+
+	UNUSED(state);
+
+	dns_test_namefromstring("example.", &f1);
+	dns_test_namefromstring("example.net.", &f2);
+
+	kc = dns_keycache_new(mctx, 16);
+	addkeys(kc, name1, 0, NKEYS - 1, now + 60);
+
+	assert_int_equal(findkey(kc, name1, 0, 0, now), ISC_R_SUCCESS);
+	assert_int_equal(findkey(kc, name1, 0, 1, now), ISC_R_NOMORE);
+	assert_int_equal(findkey(kc, name2, 0, 0, now), ISC_R_NOTFOUND);
+
+	/* Revoked keys and keys that are not zone keys are not cached */
+	assert_int_equal(findkey(kc, name1, 1, 0, now), ISC_R_NOMORE);
+	assert_int_equal(findkey(kc, name1, 2, 0, now), ISC_R_NOMORE);
+
+	dns_keycache_flush(kc);
+	assert_int_equal(findkey(kc, name1, 0, 0, now), ISC_R_NOTFOUND);
+
+	dns_keycache_destroy(&kc);
+	assert_null(kc);
+}
+
+ISC_RUN_TEST_IMPL(expire) {
+	dns_keycache_t *kc = NULL;
+	dns_fixedname_t f;
+	dns_name_t *name = dns_fixedname_initname(&f);
+	isc_stdtime_t now = isc_stdtime_now();
+
+	UNUSED(state);
+
+	dns_test_namefromstring("example.", &f);
+
+	kc = dns_keycache_new(mctx, 16);
+	addkeys(kc, name, 0, 0, now + 60);
+
+	assert_int_equal(findkey(kc, name, 0, 0, now + 59), ISC_R_SUCCESS);
+	assert_int_equal(findkey(kc, name, 0, 0, now + 60), ISC_R_NOTFOUND);
+
+	/* The expired entry was removed by the previous lookup */
+	assert_int_equal(findkey(kc, name, 0, 0, now), ISC_R_NOTFOUND);
+
+	/* A new keyset replaces the old one */
+	addkeys(kc, name, 0, 0, now + 60);
+	addkeys(kc, name, 1, 2, now + 120);
+	assert_int_equal(findkey(kc, name, 0, 0, now), ISC_R_NOMORE);
+
+	dns_keycache_destroy(&kc);
+}
+
+ISC_RUN_TEST_IMPL(lru) {
+	dns_keycache_t *kc = NULL;
+	dns_fixedname_t f1, f2, f3;
+	dns_name_t *name1 = dns_fixedname_initname(&f1);
+	dns_name_t *name2 = dns_fixedname_initname(&f2);
+	dns_name_t *name3 = dns_fixedname_initname(&f3);
+	isc_stdtime_t now = isc_stdtime_now();
+
+	UNUSED(state);
+
+	dns_test_namefromstring("example.", &f1);
+	dns_test_namefromstring("example.net.", &f2);
+	dns_test_namefromstring("example.org.", &f3);
+
+	kc = dns_keycache_new(mctx, 2);
+	addkeys(kc, name1, 0, 0, now + 60);
+	addkeys(kc, name2, 0, 0, now + 60);
+
+	/* Using the first entry makes the second one the oldest */
+	assert_int_equal(findkey(kc, name1, 0, 0, now), ISC_R_SUCCESS);
+
+	addkeys(kc, name3, 0, 0, now + 60);
+	assert_int_equal(findkey(kc, name1, 0, 0, now), ISC_R_SUCCESS);
+	assert_int_equal(findkey(kc, name2, 0, 0, now), ISC_R_NOTFOUND);
+	assert_int_equal(findkey(kc, name3, 0, 0, now), ISC_R_SUCCESS);
+
+	dns_keycache_destroy(&kc);
+}
+
+ISC_RUN_TEST_IMPL(flush) {
+	dns_keycache_t *kc = NULL;
+	dns_fixedname_t f1, f2, f3;
+	dns_name_t *name1 = dns_fixedname_initname(&f1);
+	dns_name_t *name2 = dns_fixedname_initname(&f2);
+	dns_name_t *name3 = dns_fixedname_initname(&f3);
+	isc_stdtime_t now = isc_stdtime_now();
+
+	UNUSED(state);
+
+	dns_test_namefromstring("example.", &f1);
+	dns_test_namefromstring("sub.example.", &f2);
+	dns_test_namefromstring("example.net.", &f3);
+
+	kc = dns_keycache_new(mctx, 16);
+	addkeys(kc, name1, 0, 0, now + 60);
+	addkeys(kc, name2, 0, 0, now + 60);
+	addkeys(kc, name3, 0, 0, now + 60);
+
+	dns_keycache_flushname(kc, name1);
+	assert_int_equal(findkey(kc, name1, 0, 0, now), ISC_R_NOTFOUND);
+	assert_int_equal(findkey(kc, name2, 0, 0, now), ISC_R_SUCCESS);
+
+	addkeys(kc, name1, 0, 0, now + 60);
+	dns_keycache_flushtree(kc, name1);
+	assert_int_equal(findkey(kc, name1, 0, 0, now), ISC_R_NOTFOUND);
+	assert_int_equal(findkey(kc, name2, 0, 0, now), ISC_R_NOTFOUND);
+	assert_int_equal(findkey(kc, name3, 0, 0, now), ISC_R_SUCCESS);
+
+	dns_keycache_destroy(&kc);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY_CUSTOM(basic, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(expire, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(lru, setup_test, teardown_test)
+ISC_TEST_ENTRY_CUSTOM(flush, setup_test, teardown_test)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -0,0 +1,473 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/mem.h>
+#include <isc/util.h>
+
+#include <dns/compress.h>
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/rdata.h>
+#include <dns/rdataset.h>
+
+#include <tests/dns.h>
+
+#define RECORDS 40
+
+/*
+ * Build a response with one question and RECORDS A records, each with
+ * a long uncompressed owner name, so that parsing it needs several
+ * scratchpad buffers and several blocks of rdatas, rdatalists and
+ * name offsets.
+ */
+static void
+make_response(isc_buffer_t *b) {
+	static const unsigned char header[] = {
+		0x12, 0x34, 0x84, 0x00, 0x00, 0x01, 0x00, RECORDS, 0x00, 0x00,
+		0x00, 0x00,
+	};
+	static const unsigned char question[] = {
+		7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0, 0x00, 0x01, 0x00, 0x01,
+	};
+
+	isc_buffer_putmem(b, header, sizeof(header));
+	isc_buffer_putmem(b, question, sizeof(question));
+
+	for (unsigned int i = 0; i < RECORDS; i++) {
+		char label[51];
+
+		snprintf(label, sizeof(label), "%02u%048u", i, 0);
+		isc_buffer_putuint8(b, strlen(label));
+		isc_buffer_putmem(b, (unsigned char *)label, strlen(label));
+		isc_buffer_putmem(b, question, sizeof(question));
+		isc_buffer_putuint32(b, 3600);
+		isc_buffer_putuint16(b, 4);
+		isc_buffer_putuint32(b, 0xc0000200 + i);
+	}
+}
+
+static unsigned int
+count_answers(dns_message_t *msg) {
+	unsigned int count = 0;
+	isc_result_t result;
+
+	for (result = dns_message_firstname(msg, DNS_SECTION_ANSWER);
+	     result == ISC_R_SUCCESS;
+	     result = dns_message_nextname(msg, DNS_SECTION_ANSWER))
+	{
+		dns_name_t *name = NULL;
+		dns_rdataset_t *rdataset = NULL;
+
+		dns_message_currentname(msg, DNS_SECTION_ANSWER, &name);
+		ISC_LIST_FOREACH (name->list, rdataset, link) {
+			count += dns_rdataset_count(rdataset);
+		}
+	}
+
+	return (count);
+}
+
+static void
+parse(dns_message_t *msg, unsigned char *data, size_t length) {
+	isc_buffer_t source;
+
+	isc_buffer_init(&source, data, length);
+	isc_buffer_add(&source, length);
+	assert_int_equal(dns_message_parse(msg, &source, 0), ISC_R_SUCCESS);
+	assert_int_equal(count_answers(msg), RECORDS);
+}
+
+/* A reused message does not allocate for a message of a size it has seen */
+ISC_RUN_TEST_IMPL(reuse) {
+	static unsigned char data[8192];
+	dns_message_t *msg = NULL;
+	isc_buffer_t b;
+	size_t allocations;
+
+	isc_buffer_init(&b, data, sizeof(data));
+	make_response(&b);
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	parse(msg, data, isc_buffer_usedlength(&b));
+	dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+
+	allocations = isc_mem_allocations(mctx);
+	for (unsigned int i = 0; i < 3; i++) {
+		parse(msg, data, isc_buffer_usedlength(&b));
+		dns_message_reset(msg, DNS_MESSAGE_INTENTPARSE);
+	}
+	assert_int_equal(isc_mem_allocations(mctx), allocations);
+
+	dns_message_detach(&msg);
+}
+
+/* An A query for www.example with an EDNS OPT carrying a cookie */
+static unsigned char query[] = {
+	0xab, 0xcd, 0x01, 0x20, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x01, 3,    'w',  'w',  'w',  7,    'e',  'x',  'a',  'm',  'p',
+	'l',  'e',  0,    0x00, 0x01, 0x00, 0x01, 0,    0x00, 0x29, 0x04,
+	0xd0, 0x00, 0x00, 0x80, 0x00, 0x00, 0x0c, 0x00, 0x0a, 0x00, 0x08,
+	0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08,
+};
+
+static void
+check_question(dns_message_t *msg) {
+	dns_name_t *qname = NULL;
+	dns_rdataset_t *qrdataset = NULL;
+
+	assert_int_equal(dns_message_firstname(msg, DNS_SECTION_QUESTION),
+			 ISC_R_SUCCESS);
+	dns_message_currentname(msg, DNS_SECTION_QUESTION, &qname);
+	qrdataset = ISC_LIST_HEAD(qname->list);
+	assert_non_null(qrdataset);
+	assert_null(ISC_LIST_NEXT(qrdataset, link));
+	assert_int_equal(qrdataset->type, dns_rdatatype_a);
+	assert_int_equal(qrdataset->rdclass, dns_rdataclass_in);
+	assert_int_equal(dns_message_nextname(msg, DNS_SECTION_QUESTION),
+			 ISC_R_NOMORE);
+}
+
+/* The fast path builds the same message as the full parser */
+ISC_RUN_TEST_IMPL(parsequery) {
+	dns_message_t *fast = NULL, *full = NULL;
+	dns_name_t *fastname = NULL, *fullname = NULL;
+	dns_rdata_t fastopt = DNS_RDATA_INIT, fullopt = DNS_RDATA_INIT;
+	isc_buffer_t source;
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &fast);
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &full);
+
+	isc_buffer_init(&source, query, sizeof(query));
+	isc_buffer_add(&source, sizeof(query));
+	assert_int_equal(dns_message_parsequery(fast, &source), ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_remaininglength(&source), 0);
+
+	isc_buffer_init(&source, query, sizeof(query));
+	isc_buffer_add(&source, sizeof(query));
+	assert_int_equal(dns_message_parse(full, &source, 0), ISC_R_SUCCESS);
+
+	assert_int_equal(fast->id, full->id);
+	assert_int_equal(fast->flags, full->flags);
+	assert_int_equal(fast->opcode, full->opcode);
+	assert_int_equal(fast->rcode, full->rcode);
+	assert_int_equal(fast->rdclass, full->rdclass);
+	for (unsigned int i = 0; i < DNS_SECTION_MAX; i++) {
+		assert_int_equal(fast->counts[i], full->counts[i]);
+	}
+	assert_int_equal(dns_message_getrawmessage(fast)->length,
+			 dns_message_getrawmessage(full)->length);
+
+	check_question(fast);
+	check_question(full);
+	dns_message_currentname(fast, DNS_SECTION_QUESTION, &fastname);
+	dns_message_currentname(full, DNS_SECTION_QUESTION, &fullname);
+	assert_true(dns_name_equal(fastname, fullname));
+
+	assert_non_null(fast->opt);
+	assert_non_null(full->opt);
+	assert_int_equal(fast->opt->rdclass, full->opt->rdclass);
+	assert_int_equal(fast->opt->ttl, full->opt->ttl);
+	assert_int_equal(dns_rdataset_first(fast->opt), ISC_R_SUCCESS);
+	assert_int_equal(dns_rdataset_first(full->opt), ISC_R_SUCCESS);
+	dns_rdataset_current(fast->opt, &fastopt);
+	dns_rdataset_current(full->opt, &fullopt);
+	assert_int_equal(dns_rdata_compare(&fastopt, &fullopt), 0);
+
+	dns_message_detach(&fast);
+	dns_message_detach(&full);
+}
+
+/* Anything but a simple query is left for the full parser */
+ISC_RUN_TEST_IMPL(parsequery_fallback) {
+	static const struct {
+		unsigned int offset;
+		unsigned char value;
+	} changes[] = {
+		{ 2, 0x81 },  /* QR set */
+		{ 2, 0x29 },  /* opcode UPDATE */
+		{ 5, 0x02 },  /* two questions */
+		{ 7, 0x01 },  /* an answer */
+		{ 12, 0xc0 }, /* compressed QNAME */
+		{ 26, 0xf9 }, /* TKEY query */
+		{ 31, 0x01 }, /* OPT is not OPT */
+		{ 39, 0x0d }, /* OPT RDLENGTH overruns */
+	};
+	dns_message_t *msg = NULL;
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &msg);
+
+	for (size_t i = 0; i < ARRAY_SIZE(changes); i++) {
+		unsigned char data[sizeof(query)];
+		isc_buffer_t source;
+
+		memmove(data, query, sizeof(query));
+		data[changes[i].offset] = changes[i].value;
+		isc_buffer_init(&source, data, sizeof(data));
+		isc_buffer_add(&source, sizeof(data));
+		assert_int_equal(dns_message_parsequery(msg, &source),
+				 ISC_R_NOTIMPLEMENTED);
+		assert_int_equal(isc_buffer_consumedlength(&source), 0);
+		assert_null(msg->opt);
+		assert_int_equal(msg->header_ok, 0);
+	}
+
+	/* Trailing bytes */
+	{
+		unsigned char data[sizeof(query) + 1] = { 0 };
+		isc_buffer_t source;
+
+		memmove(data, query, sizeof(query));
+		isc_buffer_init(&source, data, sizeof(data));
+		isc_buffer_add(&source, sizeof(data));
+		assert_int_equal(dns_message_parsequery(msg, &source),
+				 ISC_R_NOTIMPLEMENTED);
+	}
+
+	dns_message_detach(&msg);
+}
+
+/*
+ * Records with the same owner and type are merged into one name and one
+ * rdataset, whether the answer section is small enough to be searched
+ * linearly or large enough to be hashed.
+ */
+ISC_RUN_TEST_IMPL(mergerrsets) {
+	static const unsigned int counts[] = { 2, 5, RECORDS };
+	static unsigned char data[8192];
+
+	for (size_t i = 0; i < ARRAY_SIZE(counts); i++) {
+		static const unsigned char question[] = {
+			7,    'e',  'x',  'a',  'm',  'p', 'l',
+			'e',  0,    0x00, 0x01, 0x00, 0x01,
+		};
+		static const unsigned char txtdata[] = { 3, 't', 'x', 't' };
+		dns_message_t *msg = NULL;
+		dns_name_t *name = NULL;
+		dns_rdataset_t *rdataset = NULL;
+		isc_buffer_t b;
+
+		isc_buffer_init(&b, data, sizeof(data));
+		isc_buffer_putuint16(&b, 0x1234);
+		isc_buffer_putuint16(&b, 0x8400);
+		isc_buffer_putuint16(&b, 1);
+		isc_buffer_putuint16(&b, counts[i] + 1);
+		isc_buffer_putuint16(&b, 0);
+		isc_buffer_putuint16(&b, 0);
+		isc_buffer_putmem(&b, question, sizeof(question));
+
+		/* counts[i] A records and one TXT record at the question */
+		for (unsigned int j = 0; j <= counts[i]; j++) {
+			bool txt = (j == counts[i] / 2);
+
+			isc_buffer_putuint16(&b, 0xc00c);
+			isc_buffer_putuint16(&b, txt ? dns_rdatatype_txt
+						     : dns_rdatatype_a);
+			isc_buffer_putuint16(&b, dns_rdataclass_in);
+			isc_buffer_putuint32(&b, 3600);
+			isc_buffer_putuint16(&b, 4);
+			if (txt) {
+				isc_buffer_putmem(&b, txtdata, sizeof(txtdata));
+			} else {
+				isc_buffer_putuint32(&b, 0xc0000200 + j);
+			}
+		}
+
+		dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE,
+				   &msg);
+		assert_int_equal(dns_message_parse(msg, &b, 0), ISC_R_SUCCESS);
+
+		assert_int_equal(dns_message_firstname(msg, DNS_SECTION_ANSWER),
+				 ISC_R_SUCCESS);
+		dns_message_currentname(msg, DNS_SECTION_ANSWER, &name);
+		assert_int_equal(dns_message_nextname(msg, DNS_SECTION_ANSWER),
+				 ISC_R_NOMORE);
+
+		rdataset = ISC_LIST_HEAD(name->list);
+		assert_non_null(rdataset);
+		assert_int_equal(rdataset->type, dns_rdatatype_a);
+		assert_int_equal(dns_rdataset_count(rdataset), counts[i]);
+		rdataset = ISC_LIST_NEXT(rdataset, link);
+		assert_non_null(rdataset);
+		assert_int_equal(rdataset->type, dns_rdatatype_txt);
+		assert_int_equal(dns_rdataset_count(rdataset), 1);
+		assert_null(ISC_LIST_NEXT(rdataset, link));
+
+		dns_message_detach(&msg);
+	}
+}
+
+/*
+ * A question section may ask for several types of the same name, but
+ * not for the same type twice or for a second name, whether it is
+ * small enough to be searched linearly or large enough to be hashed.
+ */
+ISC_RUN_TEST_IMPL(parsequestions) {
+	static const struct {
+		unsigned int count;
+		bool dupname;
+		bool duptype;
+		isc_result_t result;
+	} tests[] = {
+		{ 2, false, false, ISC_R_SUCCESS },
+		{ 2, false, true, DNS_R_FORMERR },
+		{ 2, true, false, DNS_R_FORMERR },
+		{ RECORDS, false, false, ISC_R_SUCCESS },
+		{ RECORDS, false, true, DNS_R_FORMERR },
+		{ RECORDS, true, false, DNS_R_FORMERR },
+	};
+	static unsigned char data[1024];
+
+	for (size_t i = 0; i < ARRAY_SIZE(tests); i++) {
+		static const unsigned char qname[] = {
+			7, 'e', 'x', 'a', 'm', 'p', 'l', 'e', 0,
+		};
+		dns_message_t *msg = NULL;
+		dns_name_t *name = NULL;
+		isc_buffer_t b;
+		isc_result_t result;
+
+		isc_buffer_init(&b, data, sizeof(data));
+		isc_buffer_putuint16(&b, 0x1234);
+		isc_buffer_putuint16(&b, 0x0000);
+		isc_buffer_putuint16(&b, tests[i].count);
+		isc_buffer_putuint16(&b, 0);
+		isc_buffer_putuint16(&b, 0);
+		isc_buffer_putuint16(&b, 0);
+		isc_buffer_putmem(&b, qname, sizeof(qname));
+		isc_buffer_putuint16(&b, 1);
+		isc_buffer_putuint16(&b, dns_rdataclass_in);
+
+		/* The last question repeats either the name or the type */
+		for (unsigned int j = 1; j < tests[i].count; j++) {
+			bool last = (j == tests[i].count - 1);
+
+			if (last && tests[i].dupname) {
+				isc_buffer_putuint8(&b, 1);
+				isc_buffer_putuint8(&b, 'x');
+				isc_buffer_putuint16(&b, 0xc00c);
+			} else {
+				isc_buffer_putuint16(&b, 0xc00c);
+			}
+			isc_buffer_putuint16(
+				&b, (last && tests[i].duptype) ? 1 : j + 1);
+			isc_buffer_putuint16(&b, dns_rdataclass_in);
+		}
+
+		dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE,
+				   &msg);
+		result = dns_message_parse(msg, &b, 0);
+		assert_int_equal(result, tests[i].result);
+
+		if (result == ISC_R_SUCCESS) {
+			result = dns_message_firstname(msg,
+						       DNS_SECTION_QUESTION);
+			assert_int_equal(result, ISC_R_SUCCESS);
+			dns_message_currentname(msg, DNS_SECTION_QUESTION,
+						&name);
+			assert_int_equal(ISC_LIST_TAIL(name->list)->type,
+					 tests[i].count);
+			result = dns_message_nextname(msg,
+						      DNS_SECTION_QUESTION);
+			assert_int_equal(result, ISC_R_NOMORE);
+		}
+
+		dns_message_detach(&msg);
+	}
+}
+
+/* RRs rendered one at a time have their owner names compressed */
+ISC_RUN_TEST_IMPL(renderrr) {
+	static unsigned char rdata_a[] = { 192, 0, 2, 1 };
+	static unsigned char data[512];
+	dns_message_t *msg = NULL;
+	dns_compress_t cctx;
+	dns_fixedname_t fixed;
+	dns_name_t *owner = dns_fixedname_initname(&fixed);
+	dns_rdata_t rdata = DNS_RDATA_INIT;
+	isc_region_t r = { rdata_a, sizeof(rdata_a) };
+	isc_buffer_t b;
+	size_t first;
+
+	assert_int_equal(dns_name_fromstring(owner, "www.example", NULL, 0,
+					     NULL),
+			 ISC_R_SUCCESS);
+	dns_rdata_fromregion(&rdata, dns_rdataclass_in, dns_rdatatype_a, &r);
+
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTRENDER, &msg);
+	msg->flags = DNS_MESSAGEFLAG_QR;
+	dns_compress_init(&cctx, mctx, 0);
+	isc_buffer_init(&b, data, sizeof(data));
+	assert_int_equal(dns_message_renderbegin(msg, &cctx, &b),
+			 ISC_R_SUCCESS);
+
+	assert_int_equal(dns_message_renderrr(msg, DNS_SECTION_ANSWER, owner,
+					      300, &rdata),
+			 ISC_R_SUCCESS);
+	first = isc_buffer_usedlength(&b);
+	assert_int_equal(first, DNS_MESSAGE_HEADERLEN + 13 + 10 + 4);
+	assert_int_equal(dns_message_renderrr(msg, DNS_SECTION_ANSWER, owner,
+					      300, &rdata),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_buffer_usedlength(&b) - first, 2 + 10 + 4);
+
+	/* Nothing is written if the RR does not fit */
+	first = isc_buffer_usedlength(&b);
+	assert_int_equal(dns_message_renderreserve(
+				 msg, isc_buffer_availablelength(&b) - 8),
+			 ISC_R_SUCCESS);
+	assert_int_equal(dns_message_renderrr(msg, DNS_SECTION_ANSWER, owner,
+					      300, &rdata),
+			 ISC_R_NOSPACE);
+	assert_int_equal(isc_buffer_usedlength(&b), first);
+	dns_message_renderrelease(msg, isc_buffer_availablelength(&b) - 8);
+
+	assert_int_equal(dns_message_renderend(msg), ISC_R_SUCCESS);
+	dns_compress_invalidate(&cctx);
+	dns_message_detach(&msg);
+
+	/* The rendered message parses back to both RRs */
+	dns_message_create(mctx, NULL, NULL, DNS_MESSAGE_INTENTPARSE, &msg);
+	isc_buffer_init(&b, data, sizeof(data));
+	isc_buffer_add(&b, first);
+	assert_int_equal(dns_message_parse(msg, &b, 0), ISC_R_SUCCESS);
+	assert_int_equal(msg->counts[DNS_SECTION_ANSWER], 2);
+	dns_message_detach(&msg);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(reuse)
+ISC_TEST_ENTRY(parsequery)
+ISC_TEST_ENTRY(parsequery_fallback)
+ISC_TEST_ENTRY(mergerrsets)
+ISC_TEST_ENTRY(parsequestions)
+ISC_TEST_ENTRY(renderrr)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -27,6 +27,7 @@
 #include <isc/util.h>
 
 #include <dns/db.h>
+#include <dns/fixedname.h>
 #include <dns/nsec3.h>
 
 #include <tests/dns.h>
@@ -147,9 +148,66 @@ ISC_RUN_TEST_IMPL(nsec3param_salttotext) {
 	}
 }
 
+/* check dns_nsec3_hashnames() against dns_nsec3_hashname() */
+ISC_RUN_TEST_IMPL(nsec3_hashnames) {
+	const char *texts[] = {
+		"example.",
+		"a.example.",
+		"ai.example.",
+		"NS1.Example.",
+		"*.w.example.",
+		"x.y.w.example.",
+		"a-much-longer-label-to-cross-a-block-boundary.example.",
+		"a.b.c.d.e.f.g.h.i.j.k.l.m.n.o.p.q.r.s.t.u.v.w.x.y.z.example.",
+		"xx.example.",
+	};
+	const unsigned char salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+	dns_fixedname_t fixed[ARRAY_SIZE(texts)];
+	const dns_name_t *names[ARRAY_SIZE(texts)];
+	unsigned char hashbuf[ARRAY_SIZE(texts)][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *hashes[ARRAY_SIZE(texts)];
+	isc_result_t result;
+	size_t length = 0;
+
+	UNUSED(state);
+
+	for (size_t i = 0; i < ARRAY_SIZE(texts); i++) {
+		dns_name_t *name = dns_fixedname_initname(&fixed[i]);
+
+		result = dns_name_fromstring(name, texts[i], dns_rootname, 0,
+					     NULL);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		names[i] = name;
+		hashes[i] = hashbuf[i];
+	}
+
+	for (size_t count = 1; count <= ARRAY_SIZE(texts); count++) {
+		result = dns_nsec3_hashnames(hashes, &length, names, count,
+					     dns_hash_sha1, 12, salt,
+					     sizeof(salt));
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(length, 20);
+
+		for (size_t i = 0; i < count; i++) {
+			unsigned char expected[NSEC3_MAX_HASH_LENGTH];
+			dns_fixedname_t hashname;
+			size_t explength = 0;
+
+			result = dns_nsec3_hashname(&hashname, expected,
+						    &explength, names[i],
+						    dns_rootname, dns_hash_sha1,
+						    12, salt, sizeof(salt));
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_int_equal(explength, length);
+			assert_memory_equal(hashes[i], expected, length);
+		}
+	}
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(max_iterations)
 ISC_TEST_ENTRY(nsec3param_salttotext)
+ISC_TEST_ENTRY(nsec3_hashnames)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
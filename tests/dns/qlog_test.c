@@ -0,0 +1,153 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/buffer.h>
+#include <isc/sockaddr.h>
+#include <isc/time.h>
+#include <isc/util.h>
+
+#include <dns/fixedname.h>
+#include <dns/message.h>
+#include <dns/name.h>
+#include <dns/qlog.h>
+#include <dns/result.h>
+
+#include <tests/dns.h>
+
+static void
+make_record(dns_qlogrecord_t *record, bool inet6) {
+	struct in_addr in4 = { .s_addr = htonl(0xc0000201) };
+	struct in6_addr in6 = IN6ADDR_LOOPBACK_INIT;
+
+	*record = (dns_qlogrecord_t){
+		.tcp = inet6,
+		.latency = 1234,
+		.qtype = dns_rdatatype_aaaa,
+		.qclass = dns_rdataclass_in,
+		.flags = DNS_MESSAGEFLAG_QR | DNS_MESSAGEFLAG_RD,
+		.rcode = dns_rcode_nxdomain,
+	};
+	isc_time_set(&record->time, 1700000000, 123456789);
+	if (inet6) {
+		isc_sockaddr_fromin6(&record->client, &in6, 5353);
+	} else {
+		isc_sockaddr_fromin(&record->client, &in4, 53000);
+	}
+}
+
+/* records survive being encoded and decoded */
+ISC_RUN_TEST_IMPL(roundtrip) {
+	unsigned char data[2 * DNS_QLOG_MAXRECORD];
+	isc_buffer_t b;
+	dns_fixedname_t fname, fdecoded;
+	dns_name_t *name = dns_fixedname_initname(&fname);
+	dns_name_t *decoded = dns_fixedname_initname(&fdecoded);
+	dns_qlogrecord_t record4, record6, out;
+
+	UNUSED(state);
+
+	dns_test_namefromstring("www.example.com.", &fname);
+
+	make_record(&record4, false);
+	record4.qname = name;
+	make_record(&record6, true);
+	record6.qname = dns_rootname;
+
+	isc_buffer_init(&b, data, sizeof(data));
+	assert_int_equal(dns_qlog_encode(&record4, &b), ISC_R_SUCCESS);
+	assert_int_equal(dns_qlog_encode(&record6, &b), ISC_R_SUCCESS);
+
+	assert_int_equal(dns_qlog_decode(&b, &out, decoded), ISC_R_SUCCESS);
+	assert_int_equal(isc_time_compare(&out.time, &record4.time), 0);
+	assert_true(isc_sockaddr_equal(&out.client, &record4.client));
+	assert_false(out.tcp);
+	assert_int_equal(out.latency, record4.latency);
+	assert_true(dns_name_equal(out.qname, name));
+	assert_int_equal(out.qtype, record4.qtype);
+	assert_int_equal(out.qclass, record4.qclass);
+	assert_int_equal(out.flags, record4.flags);
+	assert_int_equal(out.rcode, record4.rcode);
+
+	assert_int_equal(dns_qlog_decode(&b, &out, decoded), ISC_R_SUCCESS);
+	assert_true(isc_sockaddr_equal(&out.client, &record6.client));
+	assert_true(out.tcp);
+	assert_true(dns_name_equal(out.qname, dns_rootname));
+
+	assert_int_equal(dns_qlog_decode(&b, &out, decoded), ISC_R_NOMORE);
+}
+
+/* truncated and malformed records are rejected */
+ISC_RUN_TEST_IMPL(malformed) {
+	unsigned char data[DNS_QLOG_MAXRECORD];
+	isc_buffer_t b, source;
+	dns_fixedname_t fdecoded;
+	dns_name_t *decoded = dns_fixedname_initname(&fdecoded);
+	dns_qlogrecord_t record, out;
+	unsigned int length;
+
+	UNUSED(state);
+
+	make_record(&record, false);
+	record.qname = dns_rootname;
+
+	isc_buffer_init(&b, data, sizeof(data));
+	assert_int_equal(dns_qlog_encode(&record, &b), ISC_R_SUCCESS);
+	length = isc_buffer_usedlength(&b);
+
+	/* Too small a target */
+	isc_buffer_init(&source, data, length - 1);
+	assert_int_equal(dns_qlog_encode(&record, &source), ISC_R_NOSPACE);
+	assert_int_equal(isc_buffer_usedlength(&source), 0);
+
+	/* Ends within the record */
+	isc_buffer_init(&source, data, length - 1);
+	isc_buffer_add(&source, length - 1);
+	assert_int_equal(dns_qlog_decode(&source, &out, decoded),
+			 ISC_R_UNEXPECTEDEND);
+
+	/* Unknown version, skipped */
+	data[2] = DNS_QLOG_VERSION + 1;
+	isc_buffer_init(&source, data, length);
+	isc_buffer_add(&source, length);
+	assert_int_equal(dns_qlog_decode(&source, &out, decoded),
+			 ISC_R_NOTIMPLEMENTED);
+	assert_int_equal(isc_buffer_remaininglength(&source), 0);
+	data[2] = DNS_QLOG_VERSION;
+
+	/* Bad name */
+	data[length - 1] = 5;
+	isc_buffer_init(&source, data, length);
+	isc_buffer_add(&source, length);
+	assert_int_equal(dns_qlog_decode(&source, &out, decoded),
+			 DNS_R_FORMERR);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(roundtrip)
+ISC_TEST_ENTRY(malformed)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -196,6 +196,143 @@ const dns_qpmethods_t qpiter_methods = {
 	getname,
 };
 
+#define COMPACT_ITEMS 100000
+
+static void
+compact_check(void *uctx, void *pval, uint32_t ival) {
+	uint32_t *items = uctx;
+	assert_in_range(ival, 1, COMPACT_ITEMS - 1);
+	assert_ptr_equal(items + ival, pval);
+}
+
+static size_t
+compact_makekey(dns_qpkey_t key, void *uctx, void *pval, uint32_t ival) {
+	compact_check(uctx, pval, ival);
+
+	char str[8];
+	snprintf(str, sizeof(str), "%05u", ival);
+
+	size_t i = 0;
+	while (str[i] != '\0') {
+		key[i] = str[i] - '0' + SHIFT_BITMAP;
+		i++;
+	}
+	key[i++] = SHIFT_NOBYTE;
+
+	return (i);
+}
+
+const dns_qpmethods_t compact_methods = {
+	compact_check,
+	compact_check,
+	compact_makekey,
+	getname,
+};
+
+/*
+ * Automatic compaction of a large trie is spread over several
+ * modifications, and does not lose any leaves.
+ */
+ISC_RUN_TEST_IMPL(compact_steps) {
+	dns_qp_t *qp = NULL;
+	uint32_t *item = isc_mem_cget(mctx, COMPACT_ITEMS, sizeof(item[0]));
+	bool stepped = false;
+
+	dns_qp_create(mctx, &compact_methods, item, &qp);
+	for (uint32_t i = 1; i < COMPACT_ITEMS; i++) {
+		item[i] = i;
+		assert_int_equal(dns_qp_insert(qp, &item[i], i),
+				 ISC_R_SUCCESS);
+	}
+
+	for (uint32_t i = 1; i < COMPACT_ITEMS; i++) {
+		dns_qpkey_t key;
+		void *pval = NULL;
+		uint32_t ival = 0;
+
+		if (i % 4 == 0) {
+			continue;
+		}
+		size_t len = compact_makekey(key, item, &item[i], i);
+		assert_int_equal(dns_qp_deletekey(qp, key, len, &pval, &ival),
+				 ISC_R_SUCCESS);
+		item[i] = 0;
+		stepped = stepped || qp->compacting;
+	}
+	assert_true(stepped);
+
+	for (uint32_t i = 1; i < COMPACT_ITEMS; i++) {
+		dns_qpkey_t key;
+		void *pval = NULL;
+		uint32_t ival = 0;
+
+		size_t len = compact_makekey(key, item, &item[i], i);
+		isc_result_t result = dns_qp_getkey(qp, key, len, &pval, &ival);
+		if (i % 4 == 0) {
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_int_equal(ival, i);
+		} else {
+			assert_int_equal(result, ISC_R_NOTFOUND);
+		}
+	}
+
+	dns_qp_compact(qp, DNS_QPGC_MAYBE);
+	assert_false(dns_qp_memusage(qp).fragmented);
+
+	dns_qp_destroy(&qp);
+	isc_mem_cput(mctx, item, COMPACT_ITEMS, sizeof(item[0]));
+}
+
+/*
+ * A trie built from sorted leaves is complete and has no garbage.
+ */
+ISC_RUN_TEST_IMPL(bulkload) {
+	dns_qp_t *qp = NULL;
+	dns_qpbulk_t *bulk = NULL;
+	dns_qpiter_t qpi;
+	uint32_t *item = isc_mem_cget(mctx, COMPACT_ITEMS, sizeof(item[0]));
+	uint32_t expect = 0;
+	uint32_t ival = 0;
+	void *pval = NULL;
+
+	dns_qp_create(mctx, &compact_methods, item, &qp);
+	dns_qp_bulkload(qp, &bulk);
+	for (uint32_t i = 1; i < COMPACT_ITEMS; i++) {
+		item[i] = i;
+		assert_int_equal(dns_qpbulk_add(bulk, &item[i], i),
+				 ISC_R_SUCCESS);
+		if (i % 1000 == 0) {
+			assert_int_equal(dns_qpbulk_add(bulk, &item[i], i),
+					 ISC_R_EXISTS);
+			assert_int_equal(dns_qpbulk_add(bulk, &item[1], 1),
+					 ISC_R_RANGE);
+		}
+	}
+	dns_qpbulk_finish(&bulk);
+	assert_null(bulk);
+
+	dns_qp_memusage_t memusage = dns_qp_memusage(qp);
+	assert_int_equal(memusage.leaves, COMPACT_ITEMS - 1);
+	assert_int_equal(memusage.free, 0);
+
+	for (uint32_t i = 1; i < COMPACT_ITEMS; i++) {
+		dns_qpkey_t key;
+		size_t len = compact_makekey(key, item, &item[i], i);
+		assert_int_equal(dns_qp_getkey(qp, key, len, &pval, &ival),
+				 ISC_R_SUCCESS);
+		assert_int_equal(ival, i);
+	}
+
+	dns_qpiter_init(qp, &qpi);
+	while (dns_qpiter_next(&qpi, NULL, &pval, &ival) == ISC_R_SUCCESS) {
+		assert_int_equal(ival, ++expect);
+	}
+	assert_int_equal(expect, COMPACT_ITEMS - 1);
+
+	dns_qp_destroy(&qp);
+	isc_mem_cput(mctx, item, COMPACT_ITEMS, sizeof(item[0]));
+}
+
 ISC_RUN_TEST_IMPL(qpiter) {
 	dns_qp_t *qp = NULL;
 	uint32_t item[ITER_ITEMS] = { 0 };
@@ -495,6 +632,59 @@ ISC_RUN_TEST_IMPL(partialmatch) {
 	dns_qp_destroy(&qp);
 }
 
+ISC_RUN_TEST_IMPL(getnames) {
+	dns_qp_t *qp = NULL;
+	const char insert[][16] = {
+		"a.b.",	      "b.",	    "fo.bar.",	  "foo.bar.",
+		"fooo.bar.",  "x.y.z.",	    "y.z.",	  "z.",
+		"www.x.y.z.", "mail.z.",    "a.mail.z.",  "web.foo.bar.",
+	};
+	static const char *query[] = {
+		"a.b.",	      "b.c.",	    "bar.",	  "f.bar.",
+		"foo.bar.",   "foooo.bar.", "w.foo.bar.", "z.",
+		"y.z.",	      "www.x.y.z.", "mail.z.",	  "b.mail.z.",
+		"a.mail.z.",  "fooo.bar.",  "y.",	  "web.foo.bar.",
+		"x.y.z.",     "b.",	    "c.",
+	};
+	const size_t count = ARRAY_SIZE(query);
+	dns_fixedname_t fixed[ARRAY_SIZE(query)];
+	const dns_name_t *names[ARRAY_SIZE(query)];
+	isc_result_t results[ARRAY_SIZE(query)];
+	void *pvals[ARRAY_SIZE(query)];
+
+	dns_qp_create(mctx, &string_methods, NULL, &qp);
+
+	/* an empty trie finds nothing */
+	for (size_t i = 0; i < count; i++) {
+		dns_test_namefromstring(query[i], &fixed[i]);
+		names[i] = dns_fixedname_name(&fixed[i]);
+	}
+	dns_qp_getnames(qp, count, names, pvals, NULL, results);
+	for (size_t i = 0; i < count; i++) {
+		assert_int_equal(results[i], ISC_R_NOTFOUND);
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(insert); i++) {
+		insert_str(qp, insert[i]);
+	}
+
+	/* the batch must agree with one search at a time */
+	dns_qp_getnames(qp, count, names, pvals, NULL, results);
+	for (size_t i = 0; i < count; i++) {
+		isc_result_t result;
+		void *pval = NULL;
+
+		result = dns_qp_getname(qp, names[i], &pval, NULL);
+		assert_int_equal(results[i], result);
+		if (result == ISC_R_SUCCESS) {
+			assert_string_equal(pvals[i], query[i]);
+			assert_ptr_equal(pvals[i], pval);
+		}
+	}
+
+	dns_qp_destroy(&qp);
+}
+
 struct check_qpchain {
 	const char *query;
 	isc_result_t result;
@@ -802,9 +992,12 @@ ISC_TEST_ENTRY(qpkey_name)
 ISC_TEST_ENTRY(qpkey_sort)
 ISC_TEST_ENTRY(qpiter)
 ISC_TEST_ENTRY(partialmatch)
+ISC_TEST_ENTRY(getnames)
 ISC_TEST_ENTRY(qpchain)
 ISC_TEST_ENTRY(predecessors)
 ISC_TEST_ENTRY(fixiterator)
+ISC_TEST_ENTRY(compact_steps)
+ISC_TEST_ENTRY(bulkload)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -198,9 +198,141 @@ ISC_RUN_TEST_IMPL(overmempurge_longname) {
 	isc_mem_destroy(&mctx2);
 }
 
+/*
+ * Headers are taken off the TTL wheel once their TTL has passed.
+ */
+ISC_RUN_TEST_IMPL(ttlwheel_expire) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_qpdb_t *qpdb = NULL;
+	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	isc_stdtime_t now = isc_stdtime_now();
+	isc_stdtime_t later = now + 3600 + QPDB_VIRTUAL +
+			      2 * DNS_QPDB_WHEEL_GRANULARITY;
+	const int count = 64;
+
+	result = dns_db_create(mctx, CACHEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	qpdb = (dns_qpdb_t *)db;
+
+	for (int i = 0; i < count; i++) {
+		overmempurge_addrdataset(db, now, i, 50053, 0, false);
+	}
+
+	TREE_WRLOCK(&qpdb->tree_lock, &tlocktype);
+	for (unsigned int i = 0; i < qpdb->node_lock_count; i++) {
+		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+		qpcache_wheel_t *wheel = &qpdb->wheels[i];
+
+		NODE_WRLOCK(&qpdb->node_locks[i].lock, &nlocktype);
+
+		/* Each call does a bounded amount of work */
+		for (int j = 0; j < 2 * count; j++) {
+			expire_ttl_headers(qpdb, i, &tlocktype, later, false);
+		}
+		for (size_t j = 0; j < DNS_QPDB_WHEEL_SLOTS; j++) {
+			assert_true(ISC_LIST_EMPTY(wheel->slots[j]));
+		}
+		NODE_UNLOCK(&qpdb->node_locks[i].lock, &nlocktype);
+	}
+	TREE_UNLOCK(&qpdb->tree_lock, &tlocktype);
+
+	dns_db_detach(&db);
+}
+
+#if DNS_QPDB_SIEVE
+static isc_result_t
+sieve_find(dns_db_t *db, isc_stdtime_t now, int idx) {
+	isc_result_t result;
+	dns_fixedname_t fname, ffound;
+	dns_rdataset_t rdataset;
+	char namebuf[DNS_NAME_FORMATSIZE];
+
+	snprintf(namebuf, sizeof(namebuf), "%d.example.com.", idx);
+	dns_test_namefromstring(namebuf, &fname);
+	dns_fixedname_init(&ffound);
+	dns_rdataset_init(&rdataset);
+
+	result = dns_db_find(db, dns_fixedname_name(&fname), NULL, 50053, 0,
+			     now, NULL, dns_fixedname_name(&ffound), &rdataset,
+			     NULL);
+	if (dns_rdataset_isassociated(&rdataset)) {
+		dns_rdataset_disassociate(&rdataset);
+	}
+
+	return (result);
+}
+
+/*
+ * Entries that were looked up since they were added survive a SIEVE
+ * sweep that evicts as much as the entries that were never looked up.
+ */
+ISC_RUN_TEST_IMPL(sieve_visited) {
+	isc_result_t result;
+	dns_db_t *db = NULL;
+	dns_qpdb_t *qpdb = NULL;
+	isc_rwlocktype_t tlocktype = isc_rwlocktype_none;
+	isc_stdtime_t now = isc_stdtime_now();
+	const int count = 64;
+
+	result = dns_db_create(mctx, CACHEDB_DEFAULT, dns_rootname,
+			       dns_dbtype_cache, dns_rdataclass_in, 0, NULL,
+			       &db);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	qpdb = (dns_qpdb_t *)db;
+
+	for (int i = 0; i < count; i++) {
+		overmempurge_addrdataset(db, now, i, 50053, 0, false);
+	}
+	for (int i = 0; i < count; i += 2) {
+		assert_int_equal(sieve_find(db, now, i), ISC_R_SUCCESS);
+	}
+
+	TREE_WRLOCK(&qpdb->tree_lock, &tlocktype);
+	for (unsigned int i = 0; i < qpdb->node_lock_count; i++) {
+		isc_rwlocktype_t nlocktype = isc_rwlocktype_none;
+		dns_slabheader_t *header = NULL;
+		size_t unvisited = 0;
+
+		NODE_WRLOCK(&qpdb->node_locks[i].lock, &nlocktype);
+		for (header = ISC_LIST_HEAD(qpdb->lru[i]); header != NULL;
+		     header = ISC_LIST_NEXT(header, link))
+		{
+			if (!VISITED(header)) {
+				unvisited += rdataset_size(header);
+			}
+		}
+		if (unvisited > 0) {
+			assert_int_equal(expire_lru_headers(qpdb, i, &tlocktype,
+							    unvisited - 1),
+					 unvisited);
+		}
+		NODE_UNLOCK(&qpdb->node_locks[i].lock, &nlocktype);
+	}
+	TREE_UNLOCK(&qpdb->tree_lock, &tlocktype);
+
+	for (int i = 0; i < count; i++) {
+		result = sieve_find(db, now, i);
+		if (i % 2 == 0) {
+			assert_int_equal(result, ISC_R_SUCCESS);
+		} else {
+			assert_int_not_equal(result, ISC_R_SUCCESS);
+		}
+	}
+
+	dns_db_detach(&db);
+}
+#endif /* DNS_QPDB_SIEVE */
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(overmempurge_bigrdata)
 ISC_TEST_ENTRY(overmempurge_longname)
+ISC_TEST_ENTRY(ttlwheel_expire)
+#if DNS_QPDB_SIEVE
+ISC_TEST_ENTRY(sieve_visited)
+#endif /* DNS_QPDB_SIEVE */
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -367,11 +367,14 @@ one_transaction(dns_qpmulti_t *qpm) {
 
 static void
 many_transactions(void *arg) {
-	UNUSED(arg);
+	unsigned int *replicas = arg;
 
 	dns_qpmulti_t *qpm = NULL;
 	dns_qpmulti_create(mctx, &test_methods, NULL, &qpm);
 	qpm->writer.write_protect = true;
+	if (replicas != NULL) {
+		dns_qpmulti_replicate(qpm, *replicas);
+	}
 
 	for (size_t n = 0; n < TRANSACTION_COUNT; n++) {
 		TRACE("transaction %zu", n);
@@ -394,8 +397,25 @@ ISC_RUN_TEST_IMPL(qpmulti) {
 	isc_log_destroy(&dns_lctx);
 }
 
+/*
+ * The same, but queries read the thread's replica of the trie.
+ */
+ISC_RUN_TEST_IMPL(qpmulti_replicas) {
+	unsigned int replicas = 2;
+
+	setup_loopmgr(NULL);
+	setup_logging();
+	setup_items();
+	isc_loop_setup(isc_loop_main(loopmgr), many_transactions, &replicas);
+	isc_loopmgr_run(loopmgr);
+	rcu_barrier();
+	isc_loopmgr_destroy(&loopmgr);
+	isc_log_destroy(&dns_lctx);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(qpmulti)
+ISC_TEST_ENTRY(qpmulti_replicas)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
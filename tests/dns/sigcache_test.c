@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/mem.h>
+#include <isc/stdtime.h>
+#include <isc/util.h>
+
+#include <dns/sigcache.h>
+
+#include <tests/dns.h>
+
+ISC_RUN_TEST_IMPL(basic) {
+	dns_sigcache_t *sc = NULL;
+	unsigned char digest1[DNS_SIGCACHE_DIGESTLENGTH];
+	unsigned char digest2[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t now = isc_stdtime_now();
+
+	UNUSED(state);
+
+	memset(digest1, 1, sizeof(digest1));
+	memset(digest2, 2, sizeof(digest2));
+
+	sc = dns_sigcache_new(mctx, 16);
+	dns_sigcache_add(sc, digest1, now + 60);
+
+	assert_true(dns_sigcache_find(sc, digest1, now));
+	assert_false(dns_sigcache_find(sc, digest2, now));
+
+	dns_sigcache_flush(sc);
+	assert_false(dns_sigcache_find(sc, digest1, now));
+
+	dns_sigcache_destroy(&sc);
+	assert_null(sc);
+}
+
+ISC_RUN_TEST_IMPL(expire) {
+	dns_sigcache_t *sc = NULL;
+	unsigned char digest[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t now = isc_stdtime_now();
+
+	UNUSED(state);
+
+	memset(digest, 1, sizeof(digest));
+
+	sc = dns_sigcache_new(mctx, 16);
+	dns_sigcache_add(sc, digest, now + 60);
+
+	assert_true(dns_sigcache_find(sc, digest, now + 59));
+	assert_false(dns_sigcache_find(sc, digest, now + 60));
+
+	/* The expired entry was removed by the previous lookup */
+	assert_false(dns_sigcache_find(sc, digest, now));
+
+	dns_sigcache_add(sc, digest, now + 60);
+	dns_sigcache_add(sc, digest, now + 120);
+	assert_true(dns_sigcache_find(sc, digest, now + 90));
+
+	dns_sigcache_destroy(&sc);
+}
+
+ISC_RUN_TEST_IMPL(lru) {
+	dns_sigcache_t *sc = NULL;
+	unsigned char digest1[DNS_SIGCACHE_DIGESTLENGTH];
+	unsigned char digest2[DNS_SIGCACHE_DIGESTLENGTH];
+	unsigned char digest3[DNS_SIGCACHE_DIGESTLENGTH];
+	isc_stdtime_t now = isc_stdtime_now();
+
+	UNUSED(state);
+
+	memset(digest1, 1, sizeof(digest1));
+	memset(digest2, 2, sizeof(digest2));
+	memset(digest3, 3, sizeof(digest3));
+
+	sc = dns_sigcache_new(mctx, 2);
+	dns_sigcache_add(sc, digest1, now + 60);
+	dns_sigcache_add(sc, digest2, now + 60);
+
+	/* Using the first entry makes the second one the oldest */
+	assert_true(dns_sigcache_find(sc, digest1, now));
+
+	dns_sigcache_add(sc, digest3, now + 60);
+	assert_true(dns_sigcache_find(sc, digest1, now));
+	assert_false(dns_sigcache_find(sc, digest2, now));
+	assert_true(dns_sigcache_find(sc, digest3, now));
+
+	dns_sigcache_destroy(&sc);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(basic)
+ISC_TEST_ENTRY(expire)
+ISC_TEST_ENTRY(lru)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
@@ -86,6 +86,12 @@ struct {
 	{ "barsuffix", "foosuffix", -1 },
 	{ "prefixfoo", "prefixbar", +1 },
 	{ "prefixbar", "prefixfoo", -1 },
+	/* differences in the overlapping last word */
+	{ "abcde", "abcdf", -1 },
+	{ "ABCDF", "abcde", +1 },
+	{ "abcdefgh1", "ABCDEFGH2", -1 },
+	{ "exampleorg", "exampleorf", +1 },
+	{ "a0123456789abcdeX", "a0123456789ABCDEy", -1 },
 };
 
 ISC_RUN_TEST_IMPL(upperlower) {
@@ -101,9 +101,37 @@ ISC_RUN_TEST_IMPL(isc_async_multiple) {
 	assert_string_equal(string, "12345");
 }
 
+static void
+async_batch(void *arg) {
+	isc_loop_t *loop = isc_loop_current(loopmgr);
+	isc_asyncbatch_t batch;
+
+	UNUSED(arg);
+
+	isc_async_batchinit(&batch);
+	isc_async_run(loop, append, &n1);
+	isc_async_batchadd(&batch, loop, append, &n2);
+	isc_async_batchadd(&batch, loop, append, &n3);
+	isc_async_run(loop, append, &n4);
+	isc_async_batchrun(&batch);
+	isc_async_batchadd(&batch, loop, append, &n5);
+	isc_async_batchrun(&batch);
+	isc_async_batchrun(&batch);
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+/* Batched jobs run in order, after the jobs queued before the batch */
+ISC_RUN_TEST_IMPL(isc_async_batch) {
+	string[0] = '\0';
+	isc_loop_setup(isc_loop_main(loopmgr), async_batch, loopmgr);
+	isc_loopmgr_run(loopmgr);
+	assert_string_equal(string, "14235");
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_async_run, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_async_multiple, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_async_batch, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
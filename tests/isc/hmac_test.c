@@ -207,6 +207,42 @@ ISC_RUN_TEST_IMPL(isc_hmac_reset) {
 #endif /* if 0 */
 }
 
+ISC_RUN_TEST_IMPL(isc_hmac_copy) {
+	isc_hmac_t *hmac_st = *state;
+	isc_hmac_t *copy = isc_hmac_new();
+	unsigned char digest[ISC_MAX_MD_SIZE], copydigest[ISC_MAX_MD_SIZE];
+	unsigned int digestlen = sizeof(digest);
+	unsigned int copylen = sizeof(copydigest);
+	const unsigned char first[] = "what do ya ";
+	const unsigned char rest[] = "want for nothing?";
+
+	assert_non_null(hmac_st);
+
+	expect_assert_failure(isc_hmac_copy(NULL, hmac_st));
+	expect_assert_failure(isc_hmac_copy(copy, NULL));
+
+	assert_int_equal(isc_hmac_init(hmac_st, "Jefe", 4, ISC_MD_SHA256),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_hmac_update(hmac_st, first, sizeof(first) - 1),
+			 ISC_R_SUCCESS);
+
+	/* The copy carries on from where the original was */
+	assert_int_equal(isc_hmac_copy(copy, hmac_st), ISC_R_SUCCESS);
+	assert_int_equal(isc_hmac_update(hmac_st, rest, sizeof(rest) - 1),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_hmac_update(copy, rest, sizeof(rest) - 1),
+			 ISC_R_SUCCESS);
+
+	assert_int_equal(isc_hmac_final(hmac_st, digest, &digestlen),
+			 ISC_R_SUCCESS);
+	assert_int_equal(isc_hmac_final(copy, copydigest, &copylen),
+			 ISC_R_SUCCESS);
+	assert_int_equal(digestlen, copylen);
+	assert_memory_equal(digest, copydigest, digestlen);
+
+	isc_hmac_free(copy);
+}
+
 ISC_RUN_TEST_IMPL(isc_hmac_final) {
 	isc_hmac_t *hmac_st = *state;
 	assert_non_null(hmac_st);
@@ -930,6 +966,7 @@ ISC_TEST_ENTRY(isc_hmac_sha384)
 ISC_TEST_ENTRY(isc_hmac_sha512)
 
 ISC_TEST_ENTRY_CUSTOM(isc_hmac_update, _reset, _reset)
+ISC_TEST_ENTRY_CUSTOM(isc_hmac_copy, _reset, _reset)
 ISC_TEST_ENTRY_CUSTOM(isc_hmac_final, _reset, _reset)
 
 ISC_TEST_ENTRY(isc_hmac_free)
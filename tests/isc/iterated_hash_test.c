@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/iterated_hash.h>
+#include <isc/random.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+/* RFC 5155, Appendix A: salt aabbccdd, 12 additional iterations */
+static const unsigned char salt[] = { 0xaa, 0xbb, 0xcc, 0xdd };
+
+static const struct {
+	const char *name;
+	size_t namelen;
+	unsigned char hash[20];
+} vectors[] = {
+	{ "\007example",
+	  9,
+	  { 0x06, 0x53, 0x68, 0xab, 0xee, 0xd7, 0xec, 0x6e, 0x9f, 0xeb,
+	    0xa9, 0x6b, 0x8c, 0x8b, 0xc3, 0xe8, 0xb7, 0x91, 0xf7, 0x16 } },
+	{ "\001a\007example",
+	  11,
+	  { 0x19, 0x6d, 0xd8, 0xc3, 0x30, 0x67, 0x83, 0xa8, 0x19, 0x0f,
+	    0x52, 0xc2, 0x62, 0xd2, 0xb7, 0xe5, 0xe8, 0x36, 0xe7, 0xf5 } },
+	{ "\002ai\007example",
+	  12,
+	  { 0x84, 0xdd, 0xa7, 0x14, 0x46, 0xcd, 0x56, 0xf0, 0xc1, 0x16,
+	    0xa5, 0x72, 0x54, 0xba, 0xef, 0x69, 0xd0, 0x9b, 0xce, 0x12 } },
+	{ "\001w\007example",
+	  11,
+	  { 0xa2, 0x3c, 0xd7, 0x5b, 0xf9, 0x0c, 0xc4, 0xf3, 0xba, 0x06,
+	    0x9b, 0x97, 0x9e, 0x04, 0xff, 0xc8, 0xee, 0x89, 0x15, 0x11 } },
+	{ "\003ns2\007example",
+	  13,
+	  { 0xd0, 0x09, 0x3a, 0x31, 0xdf, 0xd7, 0xed, 0xe4, 0x17, 0x60,
+	    0x09, 0x18, 0x76, 0xd1, 0x6a, 0x1a, 0x30, 0x09, 0xc8, 0xbb } },
+};
+
+/* the known answers, with more inputs than lanes */
+ISC_RUN_TEST_IMPL(isc_iterated_hash_multi_vectors) {
+	unsigned char outbuf[ARRAY_SIZE(vectors)][NSEC3_MAX_HASH_LENGTH];
+	unsigned char *out[ARRAY_SIZE(vectors)];
+	const unsigned char *in[ARRAY_SIZE(vectors)];
+	int inlength[ARRAY_SIZE(vectors)];
+	int len;
+
+	UNUSED(state);
+
+	for (size_t i = 0; i < ARRAY_SIZE(vectors); i++) {
+		out[i] = outbuf[i];
+		in[i] = (const unsigned char *)vectors[i].name;
+		inlength[i] = vectors[i].namelen;
+	}
+
+	len = isc_iterated_hash_multi(out, 1, 12, salt, sizeof(salt), in,
+				      inlength, ARRAY_SIZE(vectors));
+	assert_int_equal(len, 20);
+
+	for (size_t i = 0; i < ARRAY_SIZE(vectors); i++) {
+		assert_memory_equal(out[i], vectors[i].hash, 20);
+	}
+
+	len = isc_iterated_hash_multi(out, 2, 12, salt, sizeof(salt), in,
+				      inlength, ARRAY_SIZE(vectors));
+	assert_int_equal(len, 0);
+}
+
+/* inputs of different lengths give the same hashes as one at a time */
+ISC_RUN_TEST_IMPL(isc_iterated_hash_multi_lengths) {
+	unsigned char data[ISC_ITERATED_HASH_LANES * 2][255];
+	unsigned char outbuf[ISC_ITERATED_HASH_LANES * 2][20];
+	unsigned char *out[ISC_ITERATED_HASH_LANES * 2];
+	const unsigned char *in[ISC_ITERATED_HASH_LANES * 2];
+	int inlength[ISC_ITERATED_HASH_LANES * 2];
+	unsigned char longsalt[255];
+	unsigned char expected[NSEC3_MAX_HASH_LENGTH];
+
+	UNUSED(state);
+
+	isc_random_buf(data, sizeof(data));
+	isc_random_buf(longsalt, sizeof(longsalt));
+
+	for (size_t i = 0; i < ARRAY_SIZE(out); i++) {
+		out[i] = outbuf[i];
+		in[i] = data[i];
+		inlength[i] = (i * 37) % 256;
+	}
+
+	for (int saltlength = 0; saltlength <= 255; saltlength += 51) {
+		int len = isc_iterated_hash_multi(out, 1, 3, longsalt,
+						  saltlength, in, inlength,
+						  ARRAY_SIZE(out));
+		assert_int_equal(len, 20);
+
+		for (size_t i = 0; i < ARRAY_SIZE(out); i++) {
+			len = isc_iterated_hash(expected, 1, 3, longsalt,
+						saltlength, in[i], inlength[i]);
+			assert_int_equal(len, 20);
+			assert_memory_equal(out[i], expected, 20);
+		}
+	}
+}
+
+ISC_TEST_LIST_START
+
+ISC_TEST_ENTRY(isc_iterated_hash_multi_vectors)
+ISC_TEST_ENTRY(isc_iterated_hash_multi_lengths)
+
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
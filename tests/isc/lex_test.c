@@ -16,6 +16,7 @@
 #include <setjmp.h>
 #include <stdarg.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
@@ -338,12 +339,94 @@ ISC_RUN_TEST_IMPL(lex_keypair) {
 	}
 }
 
+/*%
+ * read a file much larger than the lexer reads at a time, ungetting
+ * some of the tokens
+ */
+#define LEX_FILE  "lex.test"
+#define LEX_LINES 20000
+
+ISC_RUN_TEST_IMPL(lex_file) {
+	isc_lex_t *lex = NULL;
+	isc_result_t result;
+	isc_token_t token;
+	isc_region_t r;
+	char expect[64];
+	FILE *fp = NULL;
+	unsigned int i, n = 0;
+
+	UNUSED(state);
+
+	fp = fopen(LEX_FILE, "w");
+	assert_non_null(fp);
+	for (i = 0; i < LEX_LINES; i++) {
+		fprintf(fp, "name%u IN TXT \"text\\\" %u\" ; comment\n", i, i);
+	}
+	assert_int_equal(fclose(fp), 0);
+
+	isc_lex_create(mctx, 64, &lex);
+	isc_lex_setcomments(lex, ISC_LEXCOMMENT_DNSMASTERFILE);
+	result = isc_lex_openfile(lex, LEX_FILE);
+	assert_int_equal(result, ISC_R_SUCCESS);
+
+	for (i = 0; i < LEX_LINES; i++) {
+		result = isc_lex_getmastertoken(lex, &token,
+						isc_tokentype_string, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		snprintf(expect, sizeof(expect), "name%u", i);
+		assert_string_equal(AS_STR(token), expect);
+		assert_int_equal(isc_lex_getsourceline(lex), i + 1);
+
+		if (n++ % 7 == 0) {
+			isc_lex_ungettoken(lex, &token);
+			result = isc_lex_getmastertoken(
+				lex, &token, isc_tokentype_string, false);
+			assert_int_equal(result, ISC_R_SUCCESS);
+			assert_string_equal(AS_STR(token), expect);
+		}
+		isc_lex_getlasttokentext(lex, &token, &r);
+		assert_int_equal(r.length, strlen(expect));
+		assert_memory_equal(r.base, expect, r.length);
+
+		result = isc_lex_getmastertoken(lex, &token,
+						isc_tokentype_string, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_string_equal(AS_STR(token), "IN");
+		result = isc_lex_getmastertoken(lex, &token,
+						isc_tokentype_string, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_string_equal(AS_STR(token), "TXT");
+
+		result = isc_lex_getmastertoken(lex, &token,
+						isc_tokentype_qstring, false);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(token.type, isc_tokentype_qstring);
+		snprintf(expect, sizeof(expect), "text\" %u", i);
+		assert_string_equal(AS_STR(token), expect);
+
+		result = isc_lex_getmastertoken(lex, &token,
+						isc_tokentype_string, true);
+		assert_int_equal(result, ISC_R_SUCCESS);
+		assert_int_equal(token.type, isc_tokentype_eol);
+		assert_int_equal(isc_lex_getsourceline(lex), i + 2);
+	}
+
+	result = isc_lex_getmastertoken(lex, &token, isc_tokentype_string,
+					true);
+	assert_int_equal(result, ISC_R_SUCCESS);
+	assert_int_equal(token.type, isc_tokentype_eof);
+
+	isc_lex_destroy(&lex);
+	unlink(LEX_FILE);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY(lex_0xff)
 ISC_TEST_ENTRY(lex_keypair)
 ISC_TEST_ENTRY(lex_setline)
 ISC_TEST_ENTRY(lex_string)
 ISC_TEST_ENTRY(lex_qstring)
+ISC_TEST_ENTRY(lex_file)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -130,12 +130,48 @@ ISC_RUN_TEST_IMPL(isc_loopmgr_sigterm) {
 	isc_loopmgr_run(loopmgr);
 }
 
+static isc_stdtime_t stdtime_first = 0;
+
+static void
+stdtime_next(void *arg) {
+	UNUSED(arg);
+
+	/* A new tick reads the clock again */
+	assert_true(isc_loop_stdtime() > stdtime_first);
+
+	isc_loopmgr_shutdown(loopmgr);
+}
+
+static void
+stdtime_cached(void *arg) {
+	UNUSED(arg);
+
+	stdtime_first = isc_loop_stdtime();
+
+	/* Within a tick, the time is read only once */
+	usleep(1100000);
+	assert_int_equal(isc_loop_stdtime(), stdtime_first);
+
+	isc_async_current(loopmgr, stdtime_next, NULL);
+}
+
+ISC_RUN_TEST_IMPL(isc_loop_stdtime) {
+	isc_stdtime_t now = isc_stdtime_now();
+
+	/* Outside of a loop, it is the current time */
+	assert_true(isc_loop_stdtime() - now <= 1);
+
+	isc_loop_setup(mainloop, stdtime_cached, loopmgr);
+	isc_loopmgr_run(loopmgr);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_pause, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_runjob, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigint, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_ENTRY_CUSTOM(isc_loopmgr_sigterm, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_loop_stdtime, setup_loopmgr, teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN
@@ -32,6 +32,7 @@
 #include <isc/result.h>
 #include <isc/stdio.h>
 #include <isc/thread.h>
+#include <isc/tid.h>
 #include <isc/time.h>
 #include <isc/util.h>
 
@@ -126,6 +127,49 @@ ISC_RUN_TEST_IMPL(isc_mem_get) {
 	isc_mempool_destroy(&mp1);
 }
 
+/* items returned to a bound pool from another thread */
+ISC_RUN_TEST_IMPL(isc_mempool_remote) {
+	void *items[5];
+	void *tmp = NULL;
+	isc_mempool_t *mp = NULL;
+	uint32_t owner = (isc_tid() == 0) ? 1 : 0;
+	int rval;
+
+	isc_mempool_create(mctx, 24, &mp);
+	isc_mempool_setfreemax(mp, 10);
+	isc_mempool_settid(mp, owner);
+
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		items[i] = isc_mempool_get(mp);
+		assert_non_null(items[i]);
+	}
+
+	/*
+	 * We are not running on the owning loop, so the items go to
+	 * the remote list rather than to the free list.
+	 */
+	for (size_t i = 0; i < ARRAY_SIZE(items); i++) {
+		isc_mempool_put(mp, items[i]);
+	}
+	rval = isc_mempool_getfreecount(mp);
+	assert_int_equal(rval, 0);
+
+	/* they are taken back before being counted */
+	rval = isc_mempool_getallocated(mp);
+	assert_int_equal(rval, 0);
+
+#if !__SANITIZE_ADDRESS__
+	rval = isc_mempool_getfreecount(mp);
+	assert_int_equal(rval, ARRAY_SIZE(items));
+
+	tmp = isc_mempool_get(mp);
+	assert_ptr_equal(tmp, items[0]);
+	isc_mempool_put(mp, tmp);
+#endif /* !__SANITIZE_ADDRESS__ */
+
+	isc_mempool_destroy(&mp);
+}
+
 /* zeroed memory system tests */
 ISC_RUN_TEST_IMPL(isc_mem_cget_zero) {
 	uint8_t *ptr;
@@ -514,6 +558,7 @@ ISC_RUN_TEST_IMPL(isc_mem_benchmark) {
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_mem_get)
+ISC_TEST_ENTRY(isc_mempool_remote)
 ISC_TEST_ENTRY(isc_mem_cget_zero)
 ISC_TEST_ENTRY(isc_mem_callocate_zero)
 ISC_TEST_ENTRY(isc_mem_inuse)
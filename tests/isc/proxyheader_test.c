@@ -104,8 +104,6 @@ proxy2_handler_dummy(const isc_result_t result, const isc_proxy2_command_t cmd,
 		     const isc_region_t *restrict extra, void *cbarg) {
 	dummy_handler_cbarg_t *arg = (dummy_handler_cbarg_t *)cbarg;
 
-	UNUSED(extra);
-
 	if (result == ISC_R_NOMORE && arg != NULL) {
 		arg->no_more_calls++;
 		return;
@@ -130,6 +128,9 @@ proxy2_handler_dummy(const isc_result_t result, const isc_proxy2_command_t cmd,
 			arg->src_addr = *src_addr;
 			arg->dst_addr = *dst_addr;
 		}
+		if (extra != NULL) {
+			arg->extra = *extra;
+		}
 	}
 
 	if (tlv_blob) {
@@ -463,6 +464,70 @@ ISC_RUN_TEST_IMPL(proxyheader_direct_test) {
 	verify_proxy_v2_header_with_AF_UNIX(NULL, &cbarg);
 }
 
+ISC_RUN_TEST_IMPL(proxyheader_direct_fixed_test) {
+	isc_result_t result;
+	isc_buffer_t databuf;
+	uint8_t data[ISC_PROXY2_MAX_SIZE];
+	isc_region_t region = { 0 };
+	const uint8_t extra[] = { 0xde, 0xad, 0xbe, 0xef };
+	dummy_handler_cbarg_t cbarg = { 0 };
+	struct in_addr localhost4 = { 0 };
+	isc_sockaddr_t src_addrv4 = { 0 }, dst_addrv4 = { 0 },
+		       src_addrv6 = { 0 }, dst_addrv6 = { 0 };
+	const uint16_t src_port = 1236;
+	const uint16_t dst_port = 9582;
+
+	localhost4.s_addr = htonl(INADDR_LOOPBACK);
+
+	isc_sockaddr_fromin(&src_addrv4, &localhost4, src_port);
+	isc_sockaddr_fromin(&dst_addrv4, &localhost4, dst_port);
+	isc_sockaddr_fromin6(&src_addrv6, &in6addr_loopback, src_port);
+	isc_sockaddr_fromin6(&dst_addrv6, &in6addr_loopback, dst_port);
+
+	isc_buffer_init(&databuf, (void *)data, sizeof(data));
+
+	/* AF_INET, SOCK_DGRAM, no TLVs, followed by data */
+	result = isc_proxy2_make_header(&databuf, ISC_PROXY2_CMD_PROXY,
+					SOCK_DGRAM, &src_addrv4, &dst_addrv4,
+					NULL);
+	assert_true(result == ISC_R_SUCCESS);
+	isc_buffer_putmem(&databuf, extra, sizeof(extra));
+
+	isc_buffer_usedregion(&databuf, &region);
+	result = isc_proxy2_header_handle_directly(
+		&region, proxy2_handler_dummy, &cbarg);
+	assert_true(result == ISC_R_SUCCESS);
+	assert_true(cbarg.cmd == ISC_PROXY2_CMD_PROXY);
+	assert_true(cbarg.socktype == SOCK_DGRAM);
+	assert_true(isc_sockaddr_equal(&cbarg.src_addr, &src_addrv4));
+	assert_true(isc_sockaddr_equal(&cbarg.dst_addr, &dst_addrv4));
+	assert_true(cbarg.extra.length == sizeof(extra));
+	assert_true(memcmp(cbarg.extra.base, extra, sizeof(extra)) == 0);
+
+	/* AF_INET6, SOCK_STREAM, no TLVs, no data */
+	cbarg = (dummy_handler_cbarg_t){ 0 };
+	isc_buffer_clear(&databuf);
+	result = isc_proxy2_make_header(&databuf, ISC_PROXY2_CMD_PROXY,
+					SOCK_STREAM, &src_addrv6, &dst_addrv6,
+					NULL);
+	assert_true(result == ISC_R_SUCCESS);
+
+	isc_buffer_usedregion(&databuf, &region);
+	result = isc_proxy2_header_handle_directly(
+		&region, proxy2_handler_dummy, &cbarg);
+	assert_true(result == ISC_R_SUCCESS);
+	assert_true(cbarg.socktype == SOCK_STREAM);
+	assert_true(isc_sockaddr_equal(&cbarg.src_addr, &src_addrv6));
+	assert_true(isc_sockaddr_equal(&cbarg.dst_addr, &dst_addrv6));
+	assert_true(cbarg.extra.length == 0);
+
+	/* a truncated header must still be rejected */
+	region.length--;
+	result = isc_proxy2_header_handle_directly(
+		&region, proxy2_handler_dummy, NULL);
+	assert_true(result != ISC_R_SUCCESS);
+}
+
 ISC_RUN_TEST_IMPL(proxyheader_detect_bad_signature_test) {
 	isc_proxy2_handler_t *handler = (isc_proxy2_handler_t *)*state;
 
@@ -1184,6 +1249,8 @@ ISC_TEST_ENTRY_CUSTOM(proxyheader_generic_torn_apart_randomly_test,
 		      setup_test_proxy, teardown_test_proxy)
 ISC_TEST_ENTRY_CUSTOM(proxyheader_direct_test, setup_test_proxy,
 		      teardown_test_proxy)
+ISC_TEST_ENTRY_CUSTOM(proxyheader_direct_fixed_test, setup_test_proxy,
+		      teardown_test_proxy)
 ISC_TEST_ENTRY_CUSTOM(proxyheader_detect_bad_signature_test, setup_test_proxy,
 		      teardown_test_proxy)
 ISC_TEST_ENTRY_CUSTOM(proxyheader_extra_data_test, setup_test_proxy,
@@ -22,9 +22,12 @@
 #define UNIT_TESTING
 #include <cmocka.h>
 
+#include <isc/async.h>
+#include <isc/loop.h>
 #include <isc/mem.h>
 #include <isc/result.h>
 #include <isc/stats.h>
+#include <isc/tid.h>
 #include <isc/util.h>
 
 #include <tests/isc.h>
@@ -91,9 +94,74 @@ ISC_RUN_TEST_IMPL(isc_stats_basic) {
 	isc_stats_detach(&stats);
 }
 
+static isc_stats_t *pertid_stats = NULL;
+
+static void
+pertid_cb(void *arg) {
+	uint32_t tid = isc_tid();
+
+	UNUSED(arg);
+
+	/* Loop 'tid' counts tid + 1 events and releases one gauge */
+	for (uint32_t i = 0; i <= tid; i++) {
+		isc_stats_increment(pertid_stats, 0);
+	}
+	isc_stats_decrement(pertid_stats, 1);
+	isc_stats_update_if_greater(pertid_stats, 2, tid);
+
+	if (tid > 0) {
+		isc_loop_t *loop = isc_loop_get(loopmgr, tid - 1);
+		isc_async_run(loop, pertid_cb, NULL);
+	} else {
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+pertid_setup_cb(void *arg) {
+	uint32_t tid = isc_loopmgr_nloops(loopmgr) - 1;
+	isc_loop_t *loop = isc_loop_get(loopmgr, tid);
+
+	UNUSED(arg);
+
+	isc_async_run(loop, pertid_cb, NULL);
+}
+
+/* test per-thread stats */
+ISC_RUN_TEST_IMPL(isc_stats_pertid) {
+	uint32_t nloops = isc_loopmgr_nloops(loopmgr);
+
+	isc_stats_create_pertid(mctx, &pertid_stats, 3);
+	assert_int_equal(isc_stats_ncounters(pertid_stats), 3);
+
+	isc_stats_set(pertid_stats, nloops, 1);
+
+	isc_loop_setup(isc_loop_main(loopmgr), pertid_setup_cb, NULL);
+	isc_loopmgr_run(loopmgr);
+
+	/* The counters of all the loops are summed up when read */
+	assert_int_equal(isc_stats_get_counter(pertid_stats, 0),
+			 nloops * (nloops + 1) / 2);
+	assert_int_equal(isc_stats_get_counter(pertid_stats, 1), 0);
+	assert_int_equal(isc_stats_get_counter(pertid_stats, 2), nloops - 1);
+
+	/* Setting a counter overrides the per-thread values */
+	isc_stats_set(pertid_stats, 10, 0);
+	assert_int_equal(isc_stats_get_counter(pertid_stats, 0), 10);
+
+	/* Resizing keeps the summed up values */
+	isc_stats_resize(&pertid_stats, 4);
+	assert_int_equal(isc_stats_get_counter(pertid_stats, 0), 10);
+	assert_int_equal(isc_stats_get_counter(pertid_stats, 2), nloops - 1);
+	assert_int_equal(isc_stats_get_counter(pertid_stats, 3), 0);
+
+	isc_stats_detach(&pertid_stats);
+}
+
 ISC_TEST_LIST_START
 
 ISC_TEST_ENTRY(isc_stats_basic)
+ISC_TEST_ENTRY_CUSTOM(isc_stats_pertid, setup_loopmgr, teardown_loopmgr)
 
 ISC_TEST_LIST_END
 
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) Internet Systems Consortium, Inc. ("ISC")
+ *
+ * SPDX-License-Identifier: MPL-2.0
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, you can obtain one at https://mozilla.org/MPL/2.0/.
+ *
+ * See the COPYRIGHT file distributed with this work for additional
+ * information regarding copyright ownership.
+ */
+
+#include <inttypes.h>
+#include <sched.h> /* IWYU pragma: keep */
+#include <setjmp.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+ * As a workaround, include an OpenSSL header file before including cmocka.h,
+ * because OpenSSL 3.1.0 uses __attribute__(malloc), conflicting with a
+ * redefined malloc in cmocka.h.
+ */
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#define UNIT_TESTING
+#include <cmocka.h>
+
+#include <isc/tls.h>
+#include <isc/util.h>
+
+#include <tests/isc.h>
+
+static isc_tlsctx_t *
+server_ctx(isc_tlsctx_ticketkeys_t *keys, const char *context) {
+	isc_tlsctx_t *ctx = NULL;
+
+	assert_int_equal(isc_tlsctx_createserver(NULL, NULL, &ctx),
+			 ISC_R_SUCCESS);
+	isc_tlsctx_set_random_session_id_context(ctx);
+	isc_tlsctx_set_ticketkeys(ctx, keys, context);
+
+	return (ctx);
+}
+
+/*
+ * Connect a client to a server through a BIO pair, optionally offering
+ * a session to resume, and return whether the session was resumed.
+ * The session issued by the server is returned in 'sessp'.
+ */
+static bool
+handshake(isc_tlsctx_t *cctx, isc_tlsctx_t *sctx, SSL_SESSION *sess,
+	  SSL_SESSION **sessp) {
+	SSL *client = SSL_new(cctx), *server = SSL_new(sctx);
+	BIO *cbio = NULL, *sbio = NULL;
+	bool resumed;
+	char buf[1];
+	int done = 0;
+
+	assert_non_null(client);
+	assert_non_null(server);
+	assert_int_equal(BIO_new_bio_pair(&cbio, 0, &sbio, 0), 1);
+	SSL_set_bio(client, cbio, cbio);
+	SSL_set_bio(server, sbio, sbio);
+	SSL_set_connect_state(client);
+	SSL_set_accept_state(server);
+	if (sess != NULL) {
+		/* TLS 1.3 clients must not reuse a ticket */
+		SSL_SESSION *copy = SSL_SESSION_dup(sess);
+		assert_int_equal(SSL_set_session(client, copy), 1);
+		SSL_SESSION_free(copy);
+	}
+
+	for (size_t i = 0; i < 100 && done != 3; i++) {
+		if (SSL_do_handshake(client) == 1) {
+			done |= 1;
+		}
+		if (SSL_do_handshake(server) == 1) {
+			done |= 2;
+		}
+	}
+	assert_int_equal(done, 3);
+
+	/* Make the client process the tickets sent after the handshake */
+	assert_int_equal(SSL_write(server, "x", 1), 1);
+	assert_int_equal(SSL_read(client, buf, sizeof(buf)), 1);
+
+	resumed = (SSL_session_reused(server) == 1);
+	assert_int_equal(SSL_session_reused(client), resumed);
+
+	*sessp = SSL_get1_session(client);
+	assert_non_null(*sessp);
+
+	/* Sessions of connections not shut down cleanly are not resumable */
+	(void)SSL_shutdown(client);
+	(void)SSL_shutdown(server);
+	SSL_free(client);
+	SSL_free(server);
+
+	return (resumed);
+}
+
+/* Tickets are accepted by every context sharing the keys and context */
+ISC_RUN_TEST_IMPL(tlsctx_ticketkeys) {
+	isc_tlsctx_ticketkeys_t *keys = NULL, *otherkeys = NULL;
+	isc_tlsctx_t *cctx = NULL, *sctx1 = NULL, *sctx2 = NULL;
+	isc_tlsctx_t *othercontext = NULL, *otherkeysctx = NULL;
+	SSL_SESSION *sess = NULL, *newsess = NULL;
+
+	isc_tlsctx_ticketkeys_create(mctx, 3600, &keys);
+	isc_tlsctx_ticketkeys_create(mctx, 3600, &otherkeys);
+
+	assert_int_equal(isc_tlsctx_createclient(&cctx), ISC_R_SUCCESS);
+	sctx1 = server_ctx(keys, "test");
+	sctx2 = server_ctx(keys, "test");
+	othercontext = server_ctx(keys, "other");
+	otherkeysctx = server_ctx(otherkeys, "test");
+
+	/* The contexts hold their own references */
+	isc_tlsctx_ticketkeys_detach(&keys);
+	isc_tlsctx_ticketkeys_detach(&otherkeys);
+
+	assert_false(handshake(cctx, sctx1, NULL, &sess));
+
+	assert_true(handshake(cctx, sctx2, sess, &newsess));
+	SSL_SESSION_free(newsess);
+
+	assert_false(handshake(cctx, othercontext, sess, &newsess));
+	SSL_SESSION_free(newsess);
+
+	assert_false(handshake(cctx, otherkeysctx, sess, &newsess));
+	SSL_SESSION_free(newsess);
+
+	SSL_SESSION_free(sess);
+	isc_tlsctx_free(&cctx);
+	isc_tlsctx_free(&sctx1);
+	isc_tlsctx_free(&sctx2);
+	isc_tlsctx_free(&othercontext);
+	isc_tlsctx_free(&otherkeysctx);
+}
+
+ISC_TEST_LIST_START
+ISC_TEST_ENTRY(tlsctx_ticketkeys)
+ISC_TEST_LIST_END
+
+ISC_TEST_MAIN
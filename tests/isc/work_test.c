@@ -75,8 +75,89 @@ ISC_RUN_TEST_IMPL(isc_work_enqueue) {
 	assert_int_equal(atomic_load(&scheduled), 1);
 }
 
+#define BULKJOBS 64
+
+static atomic_uint inflight = 0;
+static atomic_uint maxinflight = 0;
+static atomic_uint completed = 0;
+
+static void
+bulk_work_cb(void *arg) {
+	unsigned int n = atomic_fetch_add(&inflight, 1) + 1;
+	unsigned int max = atomic_load(&maxinflight);
+
+	UNUSED(arg);
+
+	while (n > max && !atomic_compare_exchange_weak(&maxinflight, &max, n))
+	{
+	}
+
+	usleep(1000);
+
+	atomic_fetch_sub(&inflight, 1);
+}
+
+static void
+bulk_after_work_cb(void *arg) {
+	UNUSED(arg);
+
+	if (atomic_fetch_add(&completed, 1) + 1 == BULKJOBS + 1) {
+		isc_loopmgr_shutdown(loopmgr);
+	}
+}
+
+static void
+work_enqueueclass_cb(void *arg) {
+	isc_loop_t *loop = isc_loop_main(loopmgr);
+	uint32_t running, waiting, limit;
+
+	UNUSED(arg);
+
+	for (size_t i = 0; i < BULKJOBS; i++) {
+		isc_work_enqueueclass(loop, isc_workclass_bulk, bulk_work_cb,
+				      bulk_after_work_cb, NULL);
+	}
+
+	isc_work_stats(loopmgr, isc_workclass_bulk, &running, &waiting);
+	limit = loopmgr->work_limit[isc_workclass_bulk];
+	assert_int_equal(running, ISC_MIN(BULKJOBS, limit));
+	assert_int_equal(running + waiting, BULKJOBS);
+
+	/* Interactive work is not held back behind the bulk work */
+	isc_work_enqueue(loop, work_cb, bulk_after_work_cb, NULL);
+	isc_work_stats(loopmgr, isc_workclass_interactive, &running,
+		       &waiting);
+	assert_int_equal(running, 1);
+	assert_int_equal(waiting, 0);
+}
+
+/* Bulk work never takes more than its share of the thread pool */
+ISC_RUN_TEST_IMPL(isc_work_enqueueclass) {
+	uint32_t running, waiting;
+
+	atomic_init(&scheduled, 0);
+	atomic_init(&inflight, 0);
+	atomic_init(&maxinflight, 0);
+	atomic_init(&completed, 0);
+
+	isc_loop_setup(isc_loop_main(loopmgr), work_enqueueclass_cb, NULL);
+
+	isc_loopmgr_run(loopmgr);
+
+	assert_int_equal(atomic_load(&completed), BULKJOBS + 1);
+	assert_int_equal(atomic_load(&scheduled), 1);
+	assert_true(atomic_load(&maxinflight) <=
+		    loopmgr->work_limit[isc_workclass_bulk]);
+
+	isc_work_stats(loopmgr, isc_workclass_bulk, &running, &waiting);
+	assert_int_equal(running, 0);
+	assert_int_equal(waiting, 0);
+}
+
 ISC_TEST_LIST_START
 ISC_TEST_ENTRY_CUSTOM(isc_work_enqueue, setup_loopmgr, teardown_loopmgr)
+ISC_TEST_ENTRY_CUSTOM(isc_work_enqueueclass, setup_loopmgr,
+		      teardown_loopmgr)
 ISC_TEST_LIST_END
 
 ISC_TEST_MAIN